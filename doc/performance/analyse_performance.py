@@ -67,7 +67,7 @@ def format_throughput(kbps: int) -> str:
 # Events that are recorded even without an imaging session (background/startup events)
 BACKGROUND_EVENT_TYPES = {
     'osListFetch', 'osListParse', 'sublistFetch', 'networkConnectionStats',
-    'networkLatency', 'networkRetry', 'driveListPoll', 'fileDialogOpen'
+    'networkLatency', 'networkRetry', 'driveListPoll', 'fileDialogOpen', 'startupPhase'
 }
 
 def infer_session_state(data: dict) -> str:
@@ -102,9 +102,10 @@ Item {
     readonly property int focusOutlineMargin: -4
 
     // === FONTS ===
-    readonly property alias fontFamily: roboto.name
-    readonly property alias fontFamilyLight: robotoLight.name
-    readonly property alias fontFamilyBold: robotoBold.name
+    // Registered from the mapped resources before QML loads (see AppFonts)
+    readonly property string fontFamily: AppFonts.regular
+    readonly property string fontFamilyLight: AppFonts.light
+    readonly property string fontFamilyBold: AppFonts.bold
 
     // Font sizes (point sizes — DPI-aware, scaled by Qt based on screen logical DPI)
     // Additionally scaled by the OS accessibility text-scaling factor.
@@ -174,9 +175,4 @@ Item {
     readonly property int formRowSpacing: scaled(15)
     readonly property int stepContentMargins: scaled(24)
     readonly property int stepContentSpacing: scaled(16)
-
-    // Font loaders
-    FontLoader { id: roboto;      source: "fonts/Roboto-Regular.ttf" }
-    FontLoader { id: robotoLight; source: "fonts/Roboto-Light.ttf" }
-    FontLoader { id: robotoBold;  source: "fonts/Roboto-Bold.ttf" }
 }
@@ -11,20 +11,62 @@
 
 struct AcceleratedCryptographicHash
 {
+    /*
+     * Sequential: the plain hash of the data, e.g. for comparing against
+     * extract_sha256 from the OS list.
+     *
+     * Tree: the data is cut into kTreeBlockSize blocks which are hashed in
+     * parallel on a thread pool; the result is the hash of the list of
+     * block digests and the total length. It does not match the plain hash
+     * and is only comparable with another Tree hash, e.g. for checking the
+     * data read back from a device against what was written.
+     *
+     * Comparison: Tree, but each block's digest is its XXH64, which is
+     * several times faster than SHA-256 (and dozens of times where SHA-256
+     * has no CPU support) and keeps verification bound by the device. Not
+     * cryptographic, so only for comparing a write with its read back;
+     * images are checked against the OS list with the Sequential hash.
+     */
+    enum class Mode { Sequential, Tree, Comparison };
+    static constexpr int kTreeBlockSize = 4 * 1024 * 1024;
+
 private:
     struct impl;
+    struct TreeState;
     std::unique_ptr<impl> p_Impl;
+    // shared_ptr so the platform files need not see TreeState to destroy it
+    std::shared_ptr<TreeState> _tree;
     mutable QByteArray _cachedResult; // Cache the result to avoid multiple hash finalization calls
     mutable bool _resultCached = false;
     QCryptographicHash::Algorithm _algo;
 
+    // Shared by all platforms (acceleratedcryptographichash_tree.cpp)
+    static std::shared_ptr<TreeState> _makeTree(QCryptographicHash::Algorithm method, Mode mode);
+    void _resetTree();
+    void _treeAddData(const char *data, int length);
+    QByteArray _treeResult() const;
+
 public:
-    explicit AcceleratedCryptographicHash(QCryptographicHash::Algorithm method);
+    explicit AcceleratedCryptographicHash(QCryptographicHash::Algorithm method, Mode mode = Mode::Sequential);
     ~AcceleratedCryptographicHash();
     void addData(const char *data, int length);
     void addData(const QByteArray &data);
     QByteArray result() const;
     void reset();
+
+    /**
+     * @brief Threads hashing Tree blocks, shared by all Tree hashes
+     *
+     * Lets a write hand cores to decompression while hashing keeps up;
+     * 0 restores the default of one per core. Blocks already queued are
+     * still hashed, only with fewer threads.
+     */
+    static void setTreeThreads(int threads);
+
+    /**
+     * @brief Name of the SHA256 implementation in use, for diagnostics
+     */
+    static QString backendName();
 };
 
 #endif // ACCELERATEDCRYPTOGRAPHICHASH_H
@@ -0,0 +1,152 @@
+/*
+ * Tree (parallel) hashing mode, shared by all platform hash backends
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "acceleratedcryptographichash.h"
+#include "containerlimits.h"
+#include "threadcputime.h"
+#include "xxhash64.h"
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent/qtconcurrentrun.h>
+#include <QtEndian>
+#include <deque>
+
+namespace {
+
+/*
+ * Own pool rather than the global one: write-side hashing already runs in
+ * global pool tasks, which would deadlock waiting on blocks queued behind
+ * them.
+ */
+QThreadPool *treeHashPool()
+{
+    static QThreadPool *pool = [] {
+        auto *p = new QThreadPool();
+        p->setMaxThreadCount(ContainerLimits::cpuCount());
+        return p;
+    }();
+    return pool;
+}
+
+} // namespace
+
+struct AcceleratedCryptographicHash::TreeState {
+    TreeState(QCryptographicHash::Algorithm method, Mode mode)
+        : algo(method),
+          fastBlocks(mode == Mode::Comparison),
+          // Enough blocks in flight to keep every core busy, while bounding
+          // the memory held by copies of not yet hashed data
+          maxInFlight(2 * treeHashPool()->maxThreadCount())
+    {
+    }
+
+    ~TreeState()
+    {
+        for (auto &future : inFlight)
+            future.waitForFinished();
+    }
+
+    void submit(QByteArray block)
+    {
+        if (static_cast<int>(inFlight.size()) >= maxInFlight)
+            collectOldest();
+
+        const QCryptographicHash::Algorithm method = algo;
+        const bool fast = fastBlocks;
+        inFlight.push_back(QtConcurrent::run(treeHashPool(), [method, fast, block]() {
+            ThreadCpuTime::Task cpuTask(ThreadCpuTime::Stage::Hash);
+            if (fast)
+            {
+                const quint64 digest = qToLittleEndian(xxhash64(block.constData(), static_cast<size_t>(block.size())));
+                return QByteArray(reinterpret_cast<const char *>(&digest), sizeof(digest));
+            }
+            AcceleratedCryptographicHash hash(method);
+            hash.addData(block);
+            return hash.result();
+        }));
+    }
+
+    void collectOldest()
+    {
+        digests.append(inFlight.front().result());
+        inFlight.pop_front();
+    }
+
+    QCryptographicHash::Algorithm algo;
+    bool fastBlocks;        // XXH64 block digests (Mode::Comparison)
+    int maxInFlight;
+    QByteArray pending;     // Start of the next block
+    std::deque<QFuture<QByteArray>> inFlight;
+    QList<QByteArray> digests;
+    quint64 totalLength = 0;
+};
+
+void AcceleratedCryptographicHash::setTreeThreads(int threads)
+{
+    treeHashPool()->setMaxThreadCount(threads > 0 ? threads : ContainerLimits::cpuCount());
+}
+
+std::shared_ptr<AcceleratedCryptographicHash::TreeState> AcceleratedCryptographicHash::_makeTree(QCryptographicHash::Algorithm method, Mode mode)
+{
+    return std::make_shared<TreeState>(method, mode);
+}
+
+void AcceleratedCryptographicHash::_resetTree()
+{
+    _tree = _makeTree(_tree->algo, _tree->fastBlocks ? Mode::Comparison : Mode::Tree);
+}
+
+void AcceleratedCryptographicHash::_treeAddData(const char *data, int length)
+{
+    // Blocks are cut at fixed stream offsets, so the result does not depend
+    // on how the data is split across addData() calls
+    TreeState &tree = *_tree;
+    tree.totalLength += static_cast<quint64>(length);
+
+    while (length > 0)
+    {
+        if (tree.pending.isEmpty() && length >= kTreeBlockSize)
+        {
+            tree.submit(QByteArray(data, kTreeBlockSize));
+            data += kTreeBlockSize;
+            length -= kTreeBlockSize;
+            continue;
+        }
+
+        if (tree.pending.isEmpty())
+            tree.pending.reserve(kTreeBlockSize);
+        const int n = qMin(length, kTreeBlockSize - static_cast<int>(tree.pending.size()));
+        tree.pending.append(data, n);
+        data += n;
+        length -= n;
+
+        if (tree.pending.size() == kTreeBlockSize)
+        {
+            tree.submit(std::move(tree.pending));
+            tree.pending = QByteArray();
+        }
+    }
+}
+
+QByteArray AcceleratedCryptographicHash::_treeResult() const
+{
+    TreeState &tree = *_tree;
+    if (!tree.pending.isEmpty())
+    {
+        tree.submit(std::move(tree.pending));
+        tree.pending = QByteArray();
+    }
+    while (!tree.inFlight.empty())
+        tree.collectOldest();
+
+    AcceleratedCryptographicHash top(tree.algo);
+    for (const QByteArray &digest : std::as_const(tree.digests))
+        top.addData(digest);
+    const quint64 length = qToLittleEndian(tree.totalLength);
+    top.addData(reinterpret_cast<const char *>(&length), sizeof(length));
+    return top.result();
+}
@@ -0,0 +1,104 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "appfonts.h"
+#include <QByteArray>
+#include <QDebug>
+#include <QFile>
+#include <QFontDatabase>
+#include <QResource>
+
+QString AppFonts::_regular = QStringLiteral("Roboto");
+QString AppFonts::_light = QStringLiteral("Roboto");
+QString AppFonts::_bold = QStringLiteral("Roboto");
+bool AppFonts::_cjkFallbackTried = false;
+bool AppFonts::_cjkFallbackLoaded = false;
+
+namespace {
+
+constexpr const char *kResourceDir = ":/qt/qml/RpiImager/fonts/";
+
+// The full font bundled with embedded images first, then the distribution's
+constexpr const char *kCjkFallbackPaths[] = {
+    "/usr/share/fonts/truetype/droid/DroidSansFallbackFull.ttf",
+    "/usr/share/fonts/truetype/droid/DroidSansFallback.ttf",
+};
+
+} // namespace
+
+void AppFonts::registerBundled()
+{
+    _regular = _registerResource(QString::fromLatin1(kResourceDir) + "Roboto-Regular.ttf", _regular);
+    _light = _registerResource(QString::fromLatin1(kResourceDir) + "Roboto-Light.ttf", _light);
+    _bold = _registerResource(QString::fromLatin1(kResourceDir) + "Roboto-Bold.ttf", _bold);
+}
+
+QString AppFonts::_registerResource(const QString &path, const QString &fallbackFamily)
+{
+    // Stored uncompressed (see qml.qrc), the data is part of the mapped
+    // executable and FreeType reads it in place
+    QResource resource(path);
+    int id = -1;
+    if (resource.isValid() && resource.compressionAlgorithm() == QResource::NoCompression)
+    {
+        id = QFontDatabase::addApplicationFontFromData(
+            QByteArray::fromRawData(reinterpret_cast<const char *>(resource.data()), static_cast<qsizetype>(resource.size())));
+    }
+    else
+    {
+        id = QFontDatabase::addApplicationFont(path);
+    }
+
+    const QStringList families = QFontDatabase::applicationFontFamilies(id);
+    if (families.isEmpty())
+    {
+        qWarning() << "AppFonts: cannot register" << path;
+        return fallbackFamily;
+    }
+    return families.first();
+}
+
+bool AppFonts::isCjkLanguage(const QString &langcode)
+{
+    return langcode.startsWith(QLatin1String("zh")) || langcode.startsWith(QLatin1String("ja"))
+        || langcode.startsWith(QLatin1String("ko"));
+}
+
+bool AppFonts::containsCjk(QStringView text)
+{
+    for (const QChar c : text)
+    {
+        const char16_t u = c.unicode();
+        if ((u >= 0x2E80 && u <= 0x9FFF)      // Radicals, kana, CJK symbols and unified ideographs
+            || (u >= 0xAC00 && u <= 0xD7AF)   // Hangul syllables
+            || (u >= 0xF900 && u <= 0xFAFF)   // Compatibility ideographs
+            || (u >= 0xFF00 && u <= 0xFFEF))  // Half- and full-width forms
+            return true;
+    }
+    return false;
+}
+
+bool AppFonts::ensureCjkFallback()
+{
+    if (_cjkFallbackTried)
+        return _cjkFallbackLoaded;
+    _cjkFallbackTried = true;
+
+    for (const char *path : kCjkFallbackPaths)
+    {
+        const QString file = QString::fromLatin1(path);
+        if (!QFile::exists(file))
+            continue;
+
+        // A native path is not read here; FreeType opens the file when a glyph is needed
+        if (QFontDatabase::addApplicationFont(file) >= 0)
+        {
+            qDebug() << "AppFonts: registered CJK fallback" << file;
+            _cjkFallbackLoaded = true;
+            break;
+        }
+    }
+    return _cjkFallbackLoaded;
+}
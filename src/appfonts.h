@@ -0,0 +1,68 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef APPFONTS_H
+#define APPFONTS_H
+
+#include <QObject>
+#include <QString>
+#include <QQmlEngine>
+
+/**
+ * @brief The application's fonts, registered without copying them
+ *
+ * The Roboto faces are registered straight from the resource data that is
+ * mapped with the executable, rather than read into a copy as FontLoader
+ * and QFontDatabase::addApplicationFont() do for qrc paths. Style.qml
+ * takes the family names from here.
+ *
+ * On embedded systems, the CJK fallback font is several MB and costs
+ * startup time to index. It is registered only once the translation or
+ * the OS list needs CJK glyphs. It is registered by file name, so FreeType
+ * maps it itself instead of Qt reading it into memory.
+ */
+class AppFonts : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+    QML_SINGLETON
+    Q_PROPERTY(QString regular READ regular CONSTANT)
+    Q_PROPERTY(QString light READ light CONSTANT)
+    Q_PROPERTY(QString bold READ bold CONSTANT)
+
+public:
+    explicit AppFonts(QObject *parent = nullptr) : QObject(parent) {}
+
+    // Before the QML engine loads Style.qml
+    static void registerBundled();
+
+    static QString regular() { return _regular; }
+    static QString light() { return _light; }
+    static QString bold() { return _bold; }
+
+    // Whether a translation to langcode (e.g. "zh_CN") is written in CJK
+    static bool isCjkLanguage(const QString &langcode);
+
+    // Whether text has any CJK ideographs, kana or hangul
+    static bool containsCjk(QStringView text);
+
+    /**
+     * @brief Register the CJK fallback font, once, if the system has one
+     * @return whether it is registered now
+     */
+    static bool ensureCjkFallback();
+    static bool cjkFallbackTried() { return _cjkFallbackTried; }
+
+private:
+    static QString _registerResource(const QString &path, const QString &fallbackFamily);
+
+    static QString _regular;
+    static QString _light;
+    static QString _bold;
+    static bool _cjkFallbackTried;
+    static bool _cjkFallbackLoaded;
+};
+
+#endif // APPFONTS_H
@@ -4,14 +4,38 @@
  */
 
 #include "asynccachewriter.h"
+#include "fastboot/sparse_encoder.h"
+#include "threadplacement.h"
+#include "threadcputime.h"
 #include <QDebug>
 #include <QFileInfo>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+// Gaps are filled, and the file hashed after them, in pieces of this size
+static constexpr qint64 FILL_CHUNK_SIZE = 4 * 1024 * 1024;
+static constexpr int FILL_BUFFER_WAIT_MS = 5000;
+
+// Digests are fed in pieces that stay in the CPU cache between them
+static constexpr qint64 HASH_PIECE_SIZE = 256 * 1024;
 
 AsyncCacheWriter::AsyncCacheWriter(QObject *parent)
     : QThread(parent)
     , _maxQueueSize(32)
     , _maxQueueMemory(64 * 1024 * 1024)
+    , _baseMaxQueueSize(32)
+    , _baseMaxQueueMemory(64 * 1024 * 1024)
+    , _queuedSlots(0)
     , _hash(OSLIST_HASH_ALGORITHM)
+    , _sparse(false)
+    , _fileOffset(0)
+    , _bytesAccepted(0)
+    , _hashedBytes(0)
+    , _fileHashProvided(false)
     , _isActive(false)
     , _shouldStop(false)
     , _hasError(false)
@@ -50,10 +74,25 @@ void AsyncCacheWriter::_initializeQueueLimits()
         _maxQueueMemory = 128 * 1024 * 1024;  // 128MB max
     }
     
+    _baseMaxQueueSize = _maxQueueSize;
+    _baseMaxQueueMemory = _maxQueueMemory;
+
     qDebug() << "AsyncCacheWriter: Queue limits set to" << _maxQueueSize << "chunks,"
              << (_maxQueueMemory / (1024 * 1024)) << "MB for" << totalMemMB << "MB system";
 }
 
+void AsyncCacheWriter::setQueueScale(int percent)
+{
+    percent = qBound(1, percent, 100);
+    QMutexLocker lock(&_mutex);
+    _maxQueueSize = qMax(1, _baseMaxQueueSize * percent / 100);
+    _maxQueueMemory = qMax<qint64>(1024 * 1024, _baseMaxQueueMemory * percent / 100);
+    qDebug() << "AsyncCacheWriter: Queue limits scaled to" << _maxQueueSize << "chunks,"
+             << (_maxQueueMemory / (1024 * 1024)) << "MB";
+    // Growing the limits lets waiting writers in
+    _queueNotFull.wakeAll();
+}
+
 AsyncCacheWriter::~AsyncCacheWriter()
 {
     cancel();
@@ -69,14 +108,20 @@ bool AsyncCacheWriter::open(const QString &filename, qint64 preallocateSize)
     _filename = filename;
     _file.setFileName(filename);
     
-    if (!_file.open(QIODevice::WriteOnly)) {
+    // Read back to hash what follows a filled gap
+    if (!_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
         qDebug() << "AsyncCacheWriter: Failed to open" << filename << "-" << _file.errorString();
         return false;
     }
     
-    if (preallocateSize > 0) {
-        // Pre-allocate space to avoid fragmentation
-        if (!_file.resize(preallocateSize)) {
+    if (preallocateSize > 0 && !_sparse) {
+        // Pre-allocate space to avoid fragmentation. resize() alone leaves
+        // a hole that the file system allocates piecemeal as it fills
+        bool allocated = false;
+#ifdef Q_OS_LINUX
+        allocated = posix_fallocate(_file.handle(), 0, preallocateSize) == 0;
+#endif
+        if (!allocated && !_file.resize(preallocateSize)) {
             qDebug() << "AsyncCacheWriter: Failed to pre-allocate" << preallocateSize << "bytes";
             // Continue anyway, not fatal
         }
@@ -90,15 +135,23 @@ bool AsyncCacheWriter::open(const QString &filename, qint64 preallocateSize)
     _finishing = false;
     _bytesQueued = 0;
     _bytesWritten = 0;
+    _fileOffset = 0;
+    _bytesAccepted = 0;
+    _hashedBytes = 0;
+    _fileHash.clear();
+    _gaps.clear();
     _isActive = true;
     
     // Reset hash for fresh computation
     _hash.reset();
+    _checkpoint = _sparse ? nullptr : std::make_unique<CacheCheckpoint>();
+    CacheCheckpoint::remove(filename);
     
     // Clear any stale queue data
     {
         QMutexLocker lock(&_mutex);
         _queue.clear();
+        _queuedSlots = 0;
     }
     
     // Start the writer thread
@@ -115,25 +168,76 @@ bool AsyncCacheWriter::write(const char *data, size_t len)
         return false;
     }
     
+    // Create a copy of the data for async processing, from the shared pool
+    static constexpr int COPY_BUFFER_WAIT_MS = 500;
+    BufferPool::Buffer buffer = BufferPool::instance().acquire(len, 4096, COPY_BUFFER_WAIT_MS);
+    if (!buffer && _gapFiller) {
+        QMutexLocker lock(&_mutex);
+        _addGap(static_cast<qint64>(len));
+        return true;
+    }
+    if (!buffer) {
+        qDebug() << "AsyncCacheWriter: No buffer for" << len << "bytes, disabling caching";
+        _hasError = true;
+        return false;
+    }
+    memcpy(buffer.data(), data, len);
+    
+    WriteChunk chunk;
+    chunk.copy = std::make_shared<BufferPool::Buffer>(std::move(buffer));
+    chunk.length = len;
+    
+    return _enqueue(std::move(chunk), 0);
+}
+
+bool AsyncCacheWriter::write(const std::shared_ptr<RingBuffer> &ring, RingBuffer::Slot *slot, size_t len)
+{
+    if (!_isActive || _hasError || _shouldStop || !ring || !slot) {
+        return false;
+    }
+    
+    // The producer and the extractor share the rest of the ring
+    const int maxSlots = std::max(1, static_cast<int>(ring->numSlots() / 2));
+    
+    ring->retainSlot(slot);
+    WriteChunk chunk;
+    chunk.slot = std::shared_ptr<RingBuffer::Slot>(slot, [ring](RingBuffer::Slot *s) {
+        ring->releaseReadSlot(s);
+    });
+    chunk.length = len;
+    
+    // On failure the chunk goes out of scope and drops the retain
+    return _enqueue(std::move(chunk), maxSlots);
+}
+
+bool AsyncCacheWriter::_enqueue(WriteChunk &&chunk, int maxSlots)
+{
+    const bool isSlot = static_cast<bool>(chunk.slot);
+    const qint64 len = chunk.size();
+    
     {
         QMutexLocker lock(&_mutex);
         
+        // Retained slots cost no extra memory, but hold back the ring's producer
+        auto queueFull = [&]() {
+            return _queue.size() >= _maxQueueSize ||
+                   queueMemoryUsage() >= _maxQueueMemory ||
+                   (isSlot && _queuedSlots >= maxSlots);
+        };
+        
         // Check if queue is full - use non-blocking approach with graceful degradation
         // If queue is full, we have two options:
         // 1. Brief wait (up to 500ms) to see if space becomes available
         // 2. If still full, disable caching rather than blocking the download
         
-        if (_queue.size() >= _maxQueueSize || 
-            queueMemoryUsage() >= _maxQueueMemory) {
+        if (queueFull()) {
             
             // Try brief wait for space (don't block download for too long)
             static constexpr int MAX_BACKPRESSURE_WAIT_MS = 500;
             static constexpr int WAIT_INTERVAL_MS = 50;
             int waitedMs = 0;
             
-            while ((_queue.size() >= _maxQueueSize || 
-                    queueMemoryUsage() >= _maxQueueMemory) &&
-                   waitedMs < MAX_BACKPRESSURE_WAIT_MS) {
+            while (queueFull() && waitedMs < MAX_BACKPRESSURE_WAIT_MS) {
                 
                 if (_shouldStop || _hasError) {
                     return false;
@@ -143,9 +247,14 @@ bool AsyncCacheWriter::write(const char *data, size_t len)
                 waitedMs += WAIT_INTERVAL_MS;
             }
             
+            // Still full: with a filler, leave this span for finish()
+            if (queueFull() && _gapFiller) {
+                _addGap(len);
+                return true;
+            }
+            
             // If still full after waiting, cache I/O is too slow - disable caching
-            if (_queue.size() >= _maxQueueSize || 
-                queueMemoryUsage() >= _maxQueueMemory) {
+            if (queueFull()) {
                 qDebug() << "AsyncCacheWriter: Queue still full after" << waitedMs 
                          << "ms wait. Cache I/O too slow, disabling caching to avoid blocking download.";
                 _hasError = true;  // Signal error state
@@ -153,10 +262,11 @@ bool AsyncCacheWriter::write(const char *data, size_t len)
             }
         }
         
-        // Create a copy of the data for async processing
-        WriteChunk chunk;
-        chunk.data = QByteArray(data, static_cast<int>(len));
-        
+        if (isSlot) {
+            _queuedSlots++;
+        }
+        chunk.offset = _bytesAccepted;
+        _bytesAccepted += len;
         _queue.enqueue(std::move(chunk));
         _bytesQueued += len;
     }
@@ -167,7 +277,7 @@ bool AsyncCacheWriter::write(const char *data, size_t len)
     return true;
 }
 
-void AsyncCacheWriter::finish()
+void AsyncCacheWriter::finish(const QByteArray &fileHash)
 {
     if (!_isActive) {
         return;
@@ -184,6 +294,38 @@ void AsyncCacheWriter::finish()
     // Wait for thread to complete
     wait();
     
+    if (!_hasError && _sparse && !_file.resize(_bytesAccepted)) {
+        // A trailing run of zeros was skipped; without extending the file
+        // the cached image would be short
+        qDebug() << "AsyncCacheWriter: Failed to extend sparse file to" << _bytesAccepted << "bytes";
+        _hasError = true;
+        cleanup();
+    }
+
+    if (!_hasError) {
+        const bool filledGaps = !_gaps.isEmpty();
+        bool ok = _fillGaps();
+        if (!_fileHashProvided) {
+            ok = ok && _hashFrom(_hashedBytes, &_hash, _checkpoint.get());
+            _fileHash = _hash.result().toHex();
+        } else {
+            ok = ok && _hashFrom(_hashedBytes, nullptr, _checkpoint.get());
+            _fileHash = fileHash;
+            if (ok && (filledGaps || fileHash.isEmpty())) {
+                // The filled spans did not come from the hashed stream
+                _hash.reset();
+                ok = _hashFrom(0, &_hash, nullptr);
+                _fileHash = _hash.result().toHex();
+            }
+        }
+        if (!ok) {
+            qDebug() << "AsyncCacheWriter: Could not fill in data skipped under backpressure, discarding"
+                     << _filename;
+            _hasError = true;
+            cleanup();
+        }
+    }
+
     if (!_hasError) {
         // Flush and close the file
         _file.flush();
@@ -191,8 +333,14 @@ void AsyncCacheWriter::finish()
         
         qDebug() << "AsyncCacheWriter: Finished successfully, wrote" 
                  << _bytesWritten << "bytes";
+
+        if (_checkpoint) {
+            _checkpoint->finishChunks();
+            _checkpoint->fileHash = _fileHash;
+            _checkpoint->save(_filename);
+        }
         
-        emit finished(_hash.result().toHex());
+        emit finished(_fileHash);
     }
     
     _isActive = false;
@@ -241,6 +389,8 @@ void AsyncCacheWriter::cancel()
 void AsyncCacheWriter::run()
 {
     qDebug() << "AsyncCacheWriter: Thread started";
+    ThreadPlacement::apply(ThreadPlacement::Role::CacheWrite);
+    ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::CacheWrite);
     
     while (!_shouldStop) {
         WriteChunk chunk;
@@ -264,12 +414,29 @@ void AsyncCacheWriter::run()
         _queueNotFull.wakeOne();
         
         if (hasData) {
-            // Compute hash of the data
-            _hash.addData(chunk.data);
+            const char *data = chunk.constData();
+            const qint64 size = chunk.size();
+            
+            // Compute hash of the data, in stream order; past a gap,
+            // finish() hashes the rest from the file
+            if (chunk.offset == _hashedBytes) {
+                _hashData(_fileHashProvided ? nullptr : &_hash, _checkpoint.get(), data, size);
+                _hashedBytes += size;
+            }
+            
+            // Skip over any gap before the chunk
+            if (_file.pos() != chunk.offset && !_file.seek(chunk.offset)) {
+                qDebug() << "AsyncCacheWriter: Seek error -" << _file.errorString();
+                _hasError = true;
+                emit error(tr("Cache write error: %1").arg(_file.errorString()));
+                break;
+            }
+            _fileOffset = chunk.offset;
             
             // Write to file
-            qint64 written = _file.write(chunk.data);
-            if (written != chunk.data.size()) {
+            qint64 written = _sparse ? (_writeChunkSparse(data, size) ? size : -1)
+                                     : _file.write(data, size);
+            if (written != size) {
                 qDebug() << "AsyncCacheWriter: Write error -" << _file.errorString();
                 _hasError = true;
                 emit error(tr("Cache write error: %1").arg(_file.errorString()));
@@ -277,6 +444,14 @@ void AsyncCacheWriter::run()
             }
             
             _bytesWritten += written;
+            
+            if (chunk.slot) {
+                // Hand the slot back to the ring buffer
+                QMutexLocker lock(&_mutex);
+                chunk = WriteChunk();
+                _queuedSlots--;
+                _queueNotFull.wakeOne();
+            }
         }
         
         // Check if we're done (finishing and queue empty)
@@ -301,8 +476,9 @@ void AsyncCacheWriter::cleanup()
     // Use mutex to prevent double-cleanup from both cancel() and run()
     QMutexLocker lock(&_mutex);
     
-    // Clear the queue
+    // Clear the queue, releasing any retained ring buffer slots
     _queue.clear();
+    _queuedSlots = 0;
     
     // Close and remove the cache file (only once)
     if (_file.isOpen()) {
@@ -311,21 +487,159 @@ void AsyncCacheWriter::cleanup()
     
     if (!_filename.isEmpty() && QFileInfo::exists(_filename)) {
         QFile::remove(_filename);
+        CacheCheckpoint::remove(_filename);
         qDebug() << "AsyncCacheWriter: Removed cache file" << _filename;
         _filename.clear(); // Prevent double-removal
     }
 }
 
+bool AsyncCacheWriter::_writeChunkSparse(const char *data, qint64 len)
+{
+    constexpr qint64 BLK = fastboot::SPARSE_BLK_SZ;
+    const auto *p = reinterpret_cast<const uint8_t *>(data);
+    qint64 pos = 0;
+
+    while (pos < len) {
+        const qint64 blockOffset = (_fileOffset + pos) % BLK;
+
+        // Only whole zero blocks aligned to the file offset become holes
+        if (blockOffset == 0 && pos + BLK <= len && fastboot::isBlockZero(p + pos)) {
+            qint64 end = pos + BLK;
+            while (end + BLK <= len && fastboot::isBlockZero(p + end))
+                end += BLK;
+            if (!_file.seek(_fileOffset + end))
+                return false;
+            pos = end;
+            continue;
+        }
+
+        // Write up to the next block boundary plus any following data blocks
+        qint64 end = std::min(len, pos + BLK - blockOffset);
+        while (end + BLK <= len && !fastboot::isBlockZero(p + end))
+            end += BLK;
+
+        const qint64 n = end - pos;
+        if (_file.write(data + pos, n) != n)
+            return false;
+        pos = end;
+    }
+
+    _fileOffset += len;
+    return true;
+}
+
+void AsyncCacheWriter::_addGap(qint64 len)
+{
+    if (!_gaps.isEmpty() && _gaps.last().offset + _gaps.last().length == _bytesAccepted) {
+        _gaps.last().length += len;
+    } else {
+        qDebug() << "AsyncCacheWriter: Queue still full, leaving a gap at" << _bytesAccepted
+                 << "to fill in when finishing";
+        _gaps.append({_bytesAccepted, len});
+    }
+    _bytesAccepted += len;
+}
+
+bool AsyncCacheWriter::_fillGaps()
+{
+    if (_gaps.isEmpty()) {
+        return true;
+    }
+    
+    qint64 total = 0;
+    for (const Gap &gap : _gaps) {
+        total += gap.length;
+    }
+    qDebug() << "AsyncCacheWriter: Filling" << _gaps.size() << "gaps," << total << "bytes";
+    
+    BufferPool::Buffer buffer = BufferPool::instance().acquire(FILL_CHUNK_SIZE, 4096, FILL_BUFFER_WAIT_MS);
+    if (!buffer) {
+        return false;
+    }
+    
+    for (const Gap &gap : _gaps) {
+        for (qint64 pos = 0; pos < gap.length; ) {
+            if (_shouldStop) {
+                return false;
+            }
+            const qint64 offset = gap.offset + pos;
+            const qint64 n = std::min(FILL_CHUNK_SIZE, gap.length - pos);
+            if (!_gapFiller(offset, buffer.data(), n)) {
+                qDebug() << "AsyncCacheWriter: No data for" << n << "bytes at" << offset;
+                return false;
+            }
+            if (!_file.seek(offset)) {
+                return false;
+            }
+            _fileOffset = offset;
+            if (_sparse ? !_writeChunkSparse(buffer.data(), n) : _file.write(buffer.data(), n) != n) {
+                qDebug() << "AsyncCacheWriter: Write error -" << _file.errorString();
+                return false;
+            }
+            _bytesWritten += n;
+            pos += n;
+        }
+    }
+    
+    _gaps.clear();
+    return true;
+}
+
+void AsyncCacheWriter::_hashData(AcceleratedCryptographicHash *hash, CacheCheckpoint *checkpoint,
+                                 const char *data, qint64 len)
+{
+    // With both digests, each piece is read from memory once
+    for (qint64 pos = 0; pos < len; ) {
+        const qint64 n = std::min(HASH_PIECE_SIZE, len - pos);
+        if (hash) {
+            hash->addData(data + pos, static_cast<int>(n));
+        }
+        if (checkpoint) {
+            checkpoint->addData(data + pos, n);
+        }
+        pos += n;
+    }
+}
+
+bool AsyncCacheWriter::_hashFrom(qint64 offset, AcceleratedCryptographicHash *hash, CacheCheckpoint *checkpoint)
+{
+    if (offset >= _bytesAccepted || (!hash && !checkpoint)) {
+        return true;
+    }
+    
+    BufferPool::Buffer buffer = BufferPool::instance().acquire(FILL_CHUNK_SIZE, 4096, FILL_BUFFER_WAIT_MS);
+    if (!buffer || !_file.flush() || !_file.seek(offset)) {
+        return false;
+    }
+    
+    while (offset < _bytesAccepted) {
+        if (_shouldStop) {
+            return false;
+        }
+        const qint64 n = _file.read(buffer.data(), std::min(FILL_CHUNK_SIZE, _bytesAccepted - offset));
+        if (n <= 0) {
+            return false;
+        }
+        _hashData(hash, checkpoint, buffer.data(), n);
+        offset += n;
+    }
+    
+    _hashedBytes = offset;
+    return true;
+}
+
 QByteArray AsyncCacheWriter::hash() const
 {
-    return _hash.result().toHex();
+    return _fileHash.isEmpty() ? _hash.result().toHex() : _fileHash;
 }
 
 qint64 AsyncCacheWriter::queueMemoryUsage() const
 {
     qint64 total = 0;
     for (const auto &chunk : _queue) {
-        total += chunk.data.size();
+        if (chunk.copy) {
+            total += chunk.size();
+        }
     }
     return total;
 }
@@ -12,10 +12,15 @@
 #include <QWaitCondition>
 #include <QQueue>
 #include <QByteArray>
+#include <QVector>
 #include <atomic>
 #include <functional>
+#include <memory>
 #include "acceleratedcryptographichash.h"
+#include "bufferpool.h"
+#include "cachecheckpoint.h"
 #include "config.h"
+#include "ringbuffer.h"
 #include "systemmemorymanager.h"
 
 /**
@@ -50,6 +55,45 @@ public:
      */
     bool open(const QString &filename, qint64 preallocateSize = 0);
 
+    /**
+     * @brief Leave holes for zero-filled blocks instead of writing them
+     *
+     * Intended for caching decompressed disk images, which are mostly
+     * empty space. Aligned 4KB blocks of zeros are seeked over and the
+     * file is truncated to its full length in finish(), so the cache only
+     * occupies as much disk as the image's actual data. Zero blocks are
+     * still included in the hash. Must be called before open().
+     */
+    void setSparse(bool sparse) { _sparse = sparse; }
+
+    /**
+     * @brief Supplies data the writer could not keep up with
+     *
+     * Reads len bytes at offset (in the cached stream) into buf; returns
+     * false if it cannot.
+     */
+    using GapFiller = std::function<bool(qint64 offset, char *buf, qint64 len)>;
+
+    /**
+     * @brief Keep caching when the cache disk falls behind
+     *
+     * With a filler, data that finds the queue still full after the
+     * backpressure wait is dropped rather than disabling caching; its span
+     * is left as a gap and finish() fetches it through the filler (from the
+     * device just written, or a second range request), then hashes the
+     * file from the first gap on. Must be called before open().
+     */
+    void setGapFiller(GapFiller filler) { _gapFiller = std::move(filler); }
+
+    /**
+     * @brief The owner hashes the same stream, so do not hash it again
+     *
+     * The whole-file digest is then the one passed to finish(); only the
+     * checkpoint's chunk hashes are computed here. Must be called before
+     * the first write().
+     */
+    void setFileHashProvided(bool provided) { _fileHashProvided = provided; }
+
     /**
      * @brief Queue data for async writing
      * 
@@ -57,9 +101,11 @@ public:
      * 
      * Backpressure handling:
      * - If the queue is full, waits briefly (up to 500ms) for space
-     * - If still full after waiting, caching is disabled to avoid
-     *   blocking the download (returns false, sets error state)
-     * - The download continues without caching in this case
+     * - If still full after waiting and a gap filler is set, the data is
+     *   left for finish() to fill in (returns true)
+     * - Otherwise caching is disabled to avoid blocking the download
+     *   (returns false, sets error state); the download continues
+     *   without caching in this case
      * 
      * @param data Pointer to data buffer
      * @param len Length of data
@@ -68,12 +114,36 @@ public:
      */
     bool write(const char *data, size_t len);
 
+    /**
+     * @brief Queue a ring buffer slot for async writing without copying it
+     *
+     * Retains the slot (RingBuffer::retainSlot()) and releases it once its
+     * data has been hashed and written, so the slot's producer and this
+     * writer share one copy of the data. Must be called before the slot is
+     * committed. At most half of the ring is held at a time; beyond that
+     * the same backpressure rules as write() apply.
+     *
+     * @param ring Ring buffer owning the slot, kept alive while it is queued
+     * @param slot Acquired, not yet committed slot
+     * @param len Bytes of data in the slot
+     * @return true if the slot was queued, false if writer is in error state
+     *         or caching was disabled due to slow I/O
+     */
+    bool write(const std::shared_ptr<RingBuffer> &ring, RingBuffer::Slot *slot, size_t len);
+
     /**
      * @brief Flush all pending writes and close the file
      * 
-     * Blocks until all queued writes are complete.
+     * Blocks until all queued writes are complete and any gaps are
+     * filled. Unless in sparse mode, also writes a CacheCheckpoint sidecar
+     * so the file can later be trusted without rehashing it. If a gap
+     * cannot be filled the cache file is removed and hasError() is set.
+     *
+     * @param fileHash Hex digest of everything written, with
+     *        setFileHashProvided(); if empty, or if gaps were filled from
+     *        elsewhere, the file is hashed by reading it back
      */
-    void finish();
+    void finish(const QByteArray &fileHash = QByteArray());
 
     /**
      * @brief Cancel writing and discard pending data
@@ -82,6 +152,15 @@ public:
      */
     void cancel();
 
+    /**
+     * @brief Limit the queue to percent of its normal size
+     *
+     * Used under memory pressure (see MemoryPressureMonitor). Data already
+     * queued stays queued; writes wait, or leave gaps, until the queue has
+     * drained below the new limits.
+     */
+    void setQueueScale(int percent);
+
     /**
      * @brief Check if writer is in error state
      * @return true if an error occurred (including backpressure timeout)
@@ -134,12 +213,21 @@ private:
     // Queue management - initialized based on system memory
     int _maxQueueSize;       // Max pending write chunks
     qint64 _maxQueueMemory;  // Max memory in queue (bytes)
+    int _baseMaxQueueSize;   // The limits above before any setQueueScale()
+    qint64 _baseMaxQueueMemory;
     
     struct WriteChunk {
-        QByteArray data;
+        std::shared_ptr<BufferPool::Buffer> copy; // Copied data, unless slot is set
+        std::shared_ptr<RingBuffer::Slot> slot;   // Retained slot, released when the last copy goes
+        size_t length = 0;
+        qint64 offset = 0;                        // In the cached stream
+
+        const char *constData() const { return slot ? slot->data : copy->data(); }
+        qint64 size() const { return static_cast<qint64>(length); }
     };
     
     QQueue<WriteChunk> _queue;
+    int _queuedSlots;        // Ring buffer slots held in _queue
     
     // Initialize adaptive queue limits based on available system memory
     void _initializeQueueLimits();
@@ -150,9 +238,26 @@ private:
     // File state
     QFile _file;
     QString _filename;
+    bool _sparse;
+    qint64 _fileOffset;  // Logical end of data written so far (sparse mode)
     
-    // Hash computation
+    // Spans dropped under backpressure, filled in by finish()
+    struct Gap {
+        qint64 offset;
+        qint64 length;
+    };
+    GapFiller _gapFiller;
+    QVector<Gap> _gaps;      // In order, guarded by _mutex
+    qint64 _bytesAccepted;   // Stream offset of the next write(), queued or not
+    
+    // Hash computation, in stream order up to _hashedBytes
     AcceleratedCryptographicHash _hash;
+    qint64 _hashedBytes;
+    std::atomic<bool> _fileHashProvided;
+    QByteArray _fileHash;    // Hex, set by finish()
+
+    // Per-chunk hashes for the sidecar (non-sparse only)
+    std::unique_ptr<CacheCheckpoint> _checkpoint;
     
     // Control flags
     std::atomic<bool> _isActive;
@@ -166,6 +271,12 @@ private:
     
     // Helper methods
     void processQueue();
+    bool _enqueue(WriteChunk &&chunk, int maxSlots);
+    bool _writeChunkSparse(const char *data, qint64 len);
+    void _addGap(qint64 len);   // With _mutex held
+    bool _fillGaps();
+    void _hashData(AcceleratedCryptographicHash *hash, CacheCheckpoint *checkpoint, const char *data, qint64 len);
+    bool _hashFrom(qint64 offset, AcceleratedCryptographicHash *hash, CacheCheckpoint *checkpoint);
     void cleanup();
     qint64 queueMemoryUsage() const;
 };
@@ -0,0 +1,95 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "bandwidthscheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+BandwidthScheduler &BandwidthScheduler::instance()
+{
+    static BandwidthScheduler scheduler;
+    return scheduler;
+}
+
+void BandwidthScheduler::setLimit(qint64 bytesPerSecond)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _limit.store(std::max<qint64>(bytesPerSecond, 0), std::memory_order_relaxed);
+    // Start again from a full bucket at the new rate
+    _total = Bucket();
+    _yield.fill(Bucket());
+}
+
+BandwidthScheduler::Transfer::Transfer(Priority priority, BandwidthScheduler &scheduler)
+    : _scheduler(scheduler), _priority(priority)
+{
+    _scheduler._active[static_cast<size_t>(priority)]++;
+}
+
+BandwidthScheduler::Transfer::~Transfer()
+{
+    _scheduler._active[static_cast<size_t>(_priority)]--;
+}
+
+bool BandwidthScheduler::_higherActive(Priority priority) const
+{
+    for (int p = 0; p < static_cast<int>(priority); p++)
+    {
+        if (_active[static_cast<size_t>(p)].load(std::memory_order_relaxed) > 0)
+            return true;
+    }
+    return false;
+}
+
+qint64 BandwidthScheduler::rateFor(Priority priority) const
+{
+    const qint64 rate = limit();
+    if (rate <= 0 || !_higherActive(priority))
+        return rate;
+    return std::min(rate, std::max(static_cast<qint64>(double(rate) * kYieldShare), kMinYieldBytesPerSecond));
+}
+
+qint64 BandwidthScheduler::_charge(Bucket &bucket, qint64 rate, qint64 bytes, qint64 nowNs)
+{
+    const double capacity = double(rate) * kBurstMs / 1000;
+    if (bucket.lastNs < 0)
+        bucket.tokens = capacity;
+    else if (nowNs > bucket.lastNs)
+        bucket.tokens = std::min(capacity, bucket.tokens + double(nowNs - bucket.lastNs) * double(rate) / 1e9);
+    bucket.lastNs = std::max(nowNs, bucket.lastNs);
+
+    bucket.tokens -= double(bytes);
+    return bucket.tokens >= 0 ? 0 : static_cast<qint64>(-bucket.tokens * 1e9 / double(rate));
+}
+
+qint64 BandwidthScheduler::reserve(Priority priority, qint64 bytes, qint64 nowNs)
+{
+    const qint64 rate = limit();
+    if (rate <= 0)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    qint64 waitNs = _charge(_total, rate, bytes, nowNs);
+
+    Bucket &yield = _yield[static_cast<size_t>(priority)];
+    const qint64 share = rateFor(priority);
+    if (share < rate)
+        waitNs = std::max(waitNs, _charge(yield, share, bytes, nowNs));
+    else
+        yield = Bucket();  // Nothing above it: the share starts afresh next time
+    return waitNs;
+}
+
+void BandwidthScheduler::acquire(Priority priority, qint64 bytes)
+{
+    if (limit() <= 0)
+        return;
+
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    const qint64 waitNs = reserve(priority, bytes, std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+    if (waitNs > 0)
+        std::this_thread::sleep_for(std::chrono::nanoseconds(waitNs));
+}
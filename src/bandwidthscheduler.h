@@ -0,0 +1,104 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef BANDWIDTHSCHEDULER_H
+#define BANDWIDTHSCHEDULER_H
+
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+#include <mutex>
+
+/**
+ * @brief Shared download rate limit, with priority between kinds of transfer
+ *
+ * On a shared uplink, one imager downloading flat out starves everything
+ * else on it. With a limit set, every libcurl transfer draws from one token
+ * bucket: its write callback calls acquire(), which sleeps until the bytes
+ * just received fit in the limit. Sleeping in the write callback stops
+ * reading the socket, so TCP flow control slows the sender down.
+ *
+ * While a transfer of a higher priority is in progress, lower priorities
+ * are additionally held to kYieldShare of the limit, so the write in
+ * progress always gets the bandwidth first. They are never stopped
+ * outright, which would trip the stall detection (CURLOPT_LOW_SPEED_*).
+ *
+ * The write and the prefetch register as in progress (Transfer) for as
+ * long as they run; OS list, icon and telemetry fetches are short and only
+ * draw from the bucket. With no limit (the default), acquire() returns
+ * immediately.
+ */
+class BandwidthScheduler
+{
+public:
+    // Highest first
+    enum class Priority {
+        Foreground,   // The image being written
+        Interactive,  // OS list and icons the user is looking at
+        Prefetch,     // Speculative background download
+        Telemetry
+    };
+    static constexpr int kPriorityCount = 4;
+
+    // Share of the limit a priority gets while a higher one is transferring
+    static constexpr double kYieldShare = 0.05;
+    static constexpr qint64 kMinYieldBytesPerSecond = 8 * 1024;
+    // Bytes that may arrive at once after an idle period, in time at the limit
+    static constexpr qint64 kBurstMs = 250;
+
+    static BandwidthScheduler &instance();
+
+    BandwidthScheduler() = default;
+    BandwidthScheduler(const BandwidthScheduler &) = delete;
+    BandwidthScheduler &operator=(const BandwidthScheduler &) = delete;
+
+    // Bytes per second for all transfers together; 0 for no limit
+    void setLimit(qint64 bytesPerSecond);
+    qint64 limit() const { return _limit.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Marks a transfer of the given priority as in progress for its
+     * lifetime. Lower priorities yield while one exists.
+     */
+    class Transfer
+    {
+    public:
+        explicit Transfer(Priority priority, BandwidthScheduler &scheduler = instance());
+        ~Transfer();
+        Transfer(const Transfer &) = delete;
+        Transfer &operator=(const Transfer &) = delete;
+    private:
+        BandwidthScheduler &_scheduler;
+        Priority _priority;
+    };
+
+    // Sleep until bytes just received at priority fit in the limit
+    void acquire(Priority priority, qint64 bytes);
+
+    /**
+     * @brief Charge bytes to the buckets at nowNs (any monotonic clock)
+     * @return Nanoseconds the caller should wait
+     */
+    qint64 reserve(Priority priority, qint64 bytes, qint64 nowNs);
+
+    // The rate priority may use now: limit(), its yield share, or 0 for no limit
+    qint64 rateFor(Priority priority) const;
+
+private:
+    struct Bucket {
+        double tokens = 0;    // May go negative: bytes owed
+        qint64 lastNs = -1;
+    };
+    static qint64 _charge(Bucket &bucket, qint64 rate, qint64 bytes, qint64 nowNs);
+    bool _higherActive(Priority priority) const;
+
+    std::atomic<qint64> _limit{0};
+    std::array<std::atomic<int>, kPriorityCount> _active{};
+    std::mutex _mutex;
+    Bucket _total;
+    std::array<Bucket, kPriorityCount> _yield;
+};
+
+#endif // BANDWIDTHSCHEDULER_H
@@ -0,0 +1,213 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "batchmanifest.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <algorithm>
+#include <utility>
+
+bool BatchManifest::Job::isUrl() const
+{
+    return image.startsWith("http:", Qt::CaseInsensitive) || image.startsWith("https:", Qt::CaseInsensitive);
+}
+
+bool BatchManifest::DeviceRule::matches(const QString &driveDescription, quint64 size) const
+{
+    return description.match(driveDescription).hasMatch() && size >= minSize && (!maxSize || size <= maxSize);
+}
+
+bool BatchManifest::load(const QString &path)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+    {
+        _error = QString("Cannot open manifest %1: %2").arg(path, f.errorString());
+        return false;
+    }
+    return parse(f.readAll(), QFileInfo(path).absolutePath());
+}
+
+bool BatchManifest::_readFile(const QString &baseDir, const QString &name, QByteArray &contents)
+{
+    if (name.isEmpty())
+        return true;
+
+    QFile f(QDir(baseDir).absoluteFilePath(name));
+    if (!f.open(QIODevice::ReadOnly))
+    {
+        _error = QString("Cannot open %1: %2").arg(f.fileName(), f.errorString());
+        return false;
+    }
+    contents = f.readAll();
+    return true;
+}
+
+bool BatchManifest::parse(const QByteArray &json, const QString &baseDir)
+{
+    _jobs.clear();
+    _error.clear();
+
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(json, &parseError);
+    if (doc.isNull())
+    {
+        _error = "Invalid manifest: " + parseError.errorString();
+        return false;
+    }
+
+    const QJsonArray jobs = doc.object().value("jobs").toArray();
+    if (jobs.isEmpty())
+    {
+        _error = "Manifest has no jobs";
+        return false;
+    }
+
+    for (int i = 0; i < jobs.size(); i++)
+    {
+        const QJsonObject o = jobs[i].toObject();
+        Job job;
+        job.name = o.value("name").toString(QString("job %1").arg(i + 1));
+        job.image = o.value("image").toString();
+        job.sha256 = o.value("sha256").toString().toLatin1();
+        job.verify = o.value("verify").toBool(true);
+        job.verifyCoverage = o.value("verify-coverage").toDouble(100.0);
+
+        if (job.image.isEmpty())
+        {
+            _error = job.name + ": no image";
+            return false;
+        }
+        if (!job.isUrl())
+        {
+            job.image = QDir(baseDir).absoluteFilePath(job.image);
+            if (!QFileInfo(job.image).isFile())
+            {
+                _error = job.name + ": image is not a regular file: " + job.image;
+                return false;
+            }
+        }
+
+        for (const auto &device : o.value("devices").toArray())
+            job.devices.append(device.toString());
+
+        if (o.contains("match"))
+        {
+            const QJsonObject match = o.value("match").toObject();
+            job.hasRule = true;
+            job.rule.description = QRegularExpression(match.value("description").toString(),
+                                                      QRegularExpression::CaseInsensitiveOption);
+            job.rule.minSize = static_cast<quint64>(match.value("min-size").toDouble());
+            job.rule.maxSize = static_cast<quint64>(match.value("max-size").toDouble());
+            job.rule.count = match.value("count").toInt();
+            if (!job.rule.description.isValid())
+            {
+                _error = job.name + ": invalid description pattern: " + job.rule.description.errorString();
+                return false;
+            }
+        }
+
+        if (job.devices.isEmpty() && !job.hasRule)
+        {
+            _error = job.name + ": neither devices nor match given";
+            return false;
+        }
+
+        if (!_readFile(baseDir, o.value("first-run-script").toString(), job.firstRunScript) ||
+            !_readFile(baseDir, o.value("cloudinit-userdata").toString(), job.cloudInitUserData) ||
+            !_readFile(baseDir, o.value("cloudinit-networkconfig").toString(), job.cloudInitNetworkConfig))
+        {
+            _error = job.name + ": " + _error;
+            return false;
+        }
+
+        _jobs.append(job);
+    }
+
+    return true;
+}
+
+QList<BatchManifest::Write> BatchManifest::plan(const QList<Drive> &drives)
+{
+    _error.clear();
+
+    // Named devices first, so rules do not pick them for another job
+    QSet<QString> taken;
+    for (const Job &job : std::as_const(_jobs))
+    {
+        for (const QString &device : job.devices)
+        {
+            if (taken.contains(device))
+            {
+                _error = "Device " + device + " is used by more than one job";
+                return {};
+            }
+            taken.insert(device);
+        }
+    }
+
+    QList<QStringList> devicesOfJob;
+    for (const Job &job : std::as_const(_jobs))
+    {
+        QStringList devices = job.devices;
+        if (job.hasRule)
+        {
+            int picked = 0;
+            for (const Drive &drive : drives)
+            {
+                if (job.rule.count && picked == job.rule.count)
+                    break;
+                if (taken.contains(drive.device) || !job.rule.matches(drive.description, drive.size))
+                {
+                    continue;
+                }
+                devices.append(drive.device);
+                taken.insert(drive.device);
+                picked++;
+            }
+            if (!picked || picked < job.rule.count)
+            {
+                _error = QString("%1: %2 matching drive(s) found, %3 needed")
+                             .arg(job.name).arg(picked).arg(job.rule.count ? job.rule.count : 1);
+                return {};
+            }
+        }
+        devicesOfJob.append(devices);
+    }
+
+    // Jobs with the same image and customisation share one write
+    auto sameWrite = [](const Job &a, const Job &b) {
+        return a.image == b.image && a.sha256 == b.sha256 && a.verify == b.verify &&
+               a.verifyCoverage == b.verifyCoverage &&
+               a.firstRunScript == b.firstRunScript && a.cloudInitUserData == b.cloudInitUserData &&
+               a.cloudInitNetworkConfig == b.cloudInitNetworkConfig;
+    };
+
+    QList<Write> writes;
+    for (int i = 0; i < _jobs.size(); i++)
+    {
+        auto it = std::find_if(writes.begin(), writes.end(), [&](const Write &w) { return sameWrite(w.job, _jobs[i]); });
+        if (it == writes.end())
+        {
+            // Right after the last write of the same image, for its cache
+            auto after = std::find_if(writes.rbegin(), writes.rend(), [&](const Write &w) { return w.job.image == _jobs[i].image; });
+            Write write;
+            write.job = _jobs[i];
+            it = writes.insert(after == writes.rend() ? writes.end() : after.base(), write);
+        }
+        for (const QString &device : devicesOfJob[i])
+        {
+            it->devices.append(device);
+            it->jobOfDevice.append(_jobs[i].name);
+        }
+    }
+
+    return writes;
+}
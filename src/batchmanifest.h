@@ -0,0 +1,112 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef BATCHMANIFEST_H
+#define BATCHMANIFEST_H
+
+#include <QByteArray>
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief Jobs for the CLI's --manifest mode
+ *
+ * A JSON file lists jobs, each an image written to some devices:
+ *
+ *   {
+ *     "jobs": [
+ *       {
+ *         "name": "lab",
+ *         "image": "https://downloads.example.com/os.img.xz",
+ *         "sha256": "...",
+ *         "devices": ["/dev/sdb", "/dev/sdc"],
+ *         "first-run-script": "firstrun.sh"
+ *       },
+ *       {
+ *         "image": "os.img",
+ *         "match": { "description": "Card Reader", "min-size": 16000000000, "count": 2 },
+ *         "cloudinit-userdata": "user-data",
+ *         "verify-coverage": 5
+ *       }
+ *     ]
+ *   }
+ *
+ * "devices" names devices; "match" picks removable drives whose description
+ * matches the regular expression and whose size in bytes is in range
+ * ("count" of them, or all if not given). Files are relative to the
+ * manifest. "verify": false skips verification; "verify-coverage" reads
+ * back only that percentage of the image (see SampledVerify).
+ *
+ * plan() turns the jobs into writes. Jobs with the same image and
+ * customisation become a single write to all of their devices at once,
+ * so the image is downloaded and decompressed once. Writes of the same
+ * image run one after another, so later ones use the decompressed image
+ * cache (when the image has a sha256).
+ */
+class BatchManifest
+{
+public:
+    struct DeviceRule {
+        QRegularExpression description;
+        quint64 minSize = 0;
+        quint64 maxSize = 0;  // 0: no limit
+        int count = 0;        // 0: all matching drives
+
+        bool matches(const QString &description, quint64 size) const;
+    };
+
+    struct Job {
+        QString name;
+        QString image;  // URL, or absolute path of a local file
+        QByteArray sha256;
+        QStringList devices;
+        bool hasRule = false;
+        DeviceRule rule;
+        QByteArray firstRunScript;
+        QByteArray cloudInitUserData;
+        QByteArray cloudInitNetworkConfig;
+        bool verify = true;
+        double verifyCoverage = 100.0;  // Percentage of the image read back
+
+        bool isUrl() const;
+    };
+
+    // A drive that device rules may pick
+    struct Drive {
+        QString device;
+        QString description;
+        quint64 size = 0;
+    };
+
+    // One write: an image, and its customisation, to several devices
+    struct Write {
+        Job job;              // Settings of the first job; devices is unused
+        QStringList devices;  // First one is the primary device
+        QStringList jobOfDevice;  // Name of the job each device is for
+    };
+
+    bool load(const QString &path);
+    bool parse(const QByteArray &json, const QString &baseDir);
+
+    /**
+     * @brief Assign devices to the jobs and group them into writes
+     * @param drives Drives for "match" rules, in the order they are tried
+     * @return the writes in the order to run them; empty on error
+     */
+    QList<Write> plan(const QList<Drive> &drives);
+
+    const QList<Job> &jobs() const { return _jobs; }
+    QString errorString() const { return _error; }
+
+private:
+    bool _readFile(const QString &baseDir, const QString &name, QByteArray &contents);
+
+    QList<Job> _jobs;
+    QString _error;
+};
+
+#endif // BATCHMANIFEST_H
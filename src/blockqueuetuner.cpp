@@ -0,0 +1,173 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "blockqueuetuner.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QSettings>
+#include <QStringList>
+
+#include <algorithm>
+
+namespace {
+    const QString JOURNAL_GROUP = QStringLiteral("queuetuning/journal");
+
+    QByteArray readTrimmed(const QString &path)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return {};
+        return file.readAll().trimmed();
+    }
+
+    int readInt(const QString &path)
+    {
+        bool ok = false;
+        const int value = readTrimmed(path).toInt(&ok);
+        return ok ? value : 0;
+    }
+
+    // "mq-deadline kyber [none]" lists the available schedulers, the active
+    // one in brackets
+    QStringList schedulers(const QByteArray &line, QString *active)
+    {
+        QStringList names;
+        for (const QString &word : QString::fromLatin1(line).split(QLatin1Char(' '), Qt::SkipEmptyParts)) {
+            if (word.startsWith(QLatin1Char('[')) && word.endsWith(QLatin1Char(']'))) {
+                names.append(word.mid(1, word.size() - 2));
+                if (active)
+                    *active = names.last();
+            } else {
+                names.append(word);
+            }
+        }
+        if (active && active->isEmpty() && names.size() == 1)
+            *active = names.first();
+        return names;
+    }
+}
+
+QString BlockQueueTuner::QueueSettings::toString() const
+{
+    return QStringLiteral("scheduler=%1 max_sectors_kb=%2 nr_requests=%3")
+        .arg(scheduler.isEmpty() ? QStringLiteral("?") : scheduler)
+        .arg(maxSectorsKb)
+        .arg(nrRequests);
+}
+
+BlockQueueTuner::BlockQueueTuner(const QString &sysBlockDir)
+    : _sysBlockDir(sysBlockDir)
+{
+}
+
+BlockQueueTuner::QueueSettings BlockQueueTuner::_read(const QString &queueDir)
+{
+    QueueSettings queue;
+    schedulers(readTrimmed(queueDir + QStringLiteral("scheduler")), &queue.scheduler);
+    queue.maxSectorsKb = readInt(queueDir + QStringLiteral("max_sectors_kb"));
+    queue.nrRequests = readInt(queueDir + QStringLiteral("nr_requests"));
+    return queue;
+}
+
+bool BlockQueueTuner::_write(const QString &path, const QByteArray &value)
+{
+    // Unbuffered, so that a value sysfs rejects fails the write itself
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        qDebug() << "BlockQueueTuner: cannot open" << path << ":" << file.errorString();
+        return false;
+    }
+    if (file.write(value) != value.size()) {
+        qDebug() << "BlockQueueTuner: kernel refused" << value << "for" << path;
+        return false;
+    }
+    return true;
+}
+
+void BlockQueueTuner::_apply(const QString &queueDir, const QueueSettings &from, const QueueSettings &to)
+{
+    // Switching scheduler resets nr_requests, so it goes first
+    if (!to.scheduler.isEmpty() && to.scheduler != from.scheduler)
+        _write(queueDir + QStringLiteral("scheduler"), to.scheduler.toLatin1());
+    if (to.maxSectorsKb > 0 && to.maxSectorsKb != from.maxSectorsKb)
+        _write(queueDir + QStringLiteral("max_sectors_kb"), QByteArray::number(to.maxSectorsKb));
+    if (to.nrRequests > 0 && to.nrRequests != _read(queueDir).nrRequests)
+        _write(queueDir + QStringLiteral("nr_requests"), QByteArray::number(to.nrRequests));
+}
+
+bool BlockQueueTuner::tune(const QString &device, QSettings &settings)
+{
+    // Whatever an earlier run left behind goes back first, so that it is
+    // what gets journalled for this device
+    restorePending(settings, _sysBlockDir);
+
+    const QString queueDir = _sysBlockDir + QLatin1Char('/') + device + QStringLiteral("/queue/");
+    const QueueSettings current = _read(queueDir);
+    if (current.maxSectorsKb <= 0)
+        return false;
+
+    QueueSettings wanted = current;
+    const QStringList available = schedulers(readTrimmed(queueDir + QStringLiteral("scheduler")), nullptr);
+    if (available.contains(QStringLiteral("none")))
+        wanted.scheduler = QStringLiteral("none");
+    const int hwMaxSectorsKb = std::min(readInt(queueDir + QStringLiteral("max_hw_sectors_kb")), kMaxSectorsKbLimit);
+    wanted.maxSectorsKb = std::max(current.maxSectorsKb, hwMaxSectorsKb);
+    wanted.nrRequests = std::max(current.nrRequests, kNrRequests);
+    if (wanted == current)
+        return false;
+
+    settings.beginGroup(JOURNAL_GROUP + QLatin1Char('/') + device);
+    settings.setValue("scheduler", current.scheduler);
+    settings.setValue("max_sectors_kb", current.maxSectorsKb);
+    settings.setValue("nr_requests", current.nrRequests);
+    settings.endGroup();
+    settings.sync();
+
+    _apply(queueDir, current, wanted);
+
+    _device = device;
+    _before = current;
+    _after = _read(queueDir);
+    qDebug() << "BlockQueueTuner:" << device << "from" << _before.toString() << "to" << _after.toString();
+    return !(_after == _before);
+}
+
+void BlockQueueTuner::restore(QSettings &settings)
+{
+    if (_device.isEmpty())
+        return;
+
+    const QString queueDir = _sysBlockDir + QLatin1Char('/') + _device + QStringLiteral("/queue/");
+    _apply(queueDir, _read(queueDir), _before);
+    settings.remove(JOURNAL_GROUP + QLatin1Char('/') + _device);
+    settings.sync();
+    _device.clear();
+}
+
+void BlockQueueTuner::restorePending(QSettings &settings, const QString &sysBlockDir)
+{
+    settings.beginGroup(JOURNAL_GROUP);
+    const QStringList devices = settings.childGroups();
+    settings.endGroup();
+
+    for (const QString &device : devices) {
+        const QString group = JOURNAL_GROUP + QLatin1Char('/') + device;
+        QueueSettings original;
+        original.scheduler = settings.value(group + QStringLiteral("/scheduler")).toString();
+        original.maxSectorsKb = settings.value(group + QStringLiteral("/max_sectors_kb")).toInt();
+        original.nrRequests = settings.value(group + QStringLiteral("/nr_requests")).toInt();
+
+        // A device that has gone away comes back with its defaults anyway
+        const QString queueDir = sysBlockDir + QLatin1Char('/') + device + QStringLiteral("/queue/");
+        if (QFile::exists(queueDir)) {
+            qDebug() << "BlockQueueTuner: restoring" << device << "to" << original.toString();
+            _apply(queueDir, _read(queueDir), original);
+        }
+        settings.remove(group);
+    }
+    if (!devices.isEmpty())
+        settings.sync();
+}
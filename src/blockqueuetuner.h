@@ -0,0 +1,80 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef BLOCKQUEUETUNER_H
+#define BLOCKQUEUETUNER_H
+
+#include <QByteArray>
+#include <QString>
+
+class QSettings;
+
+/**
+ * @brief Tunes a Linux block device's request queue for one long write
+ *
+ * Card readers come up with queue settings meant for mixed desktop I/O:
+ * mq-deadline sorting requests that are already in order, max_sectors_kb
+ * well below what the hardware accepts, and few requests in flight. For
+ * the duration of a write this raises max_sectors_kb to max_hw_sectors_kb,
+ * switches to the "none" scheduler and raises nr_requests where the queue
+ * allows it.
+ *
+ * The original values are journalled in QSettings (and synced) before
+ * anything is changed, so if the process dies before restore() the next
+ * run puts them back with restorePending(). Values the kernel refuses are
+ * left as they are.
+ *
+ * Opt-in with the "queuetuning/enabled" setting, as it changes state that
+ * outlives the process.
+ */
+class BlockQueueTuner
+{
+public:
+    struct QueueSettings {
+        QString scheduler;      // Active scheduler, e.g. "mq-deadline"
+        int maxSectorsKb = 0;
+        int nrRequests = 0;
+
+        bool operator==(const QueueSettings &other) const = default;
+        QString toString() const;
+    };
+
+    static constexpr int kMaxSectorsKbLimit = 4096;
+    static constexpr int kNrRequests = 128;
+
+    explicit BlockQueueTuner(const QString &sysBlockDir = QStringLiteral("/sys/block"));
+
+    /**
+     * @brief Tune the queue of device (e.g. "sda")
+     * @return true if any setting was changed
+     */
+    bool tune(const QString &device, QSettings &settings);
+
+    /**
+     * @brief Put back what tune() changed and drop the journal entry
+     */
+    void restore(QSettings &settings);
+
+    bool isTuned() const { return !_device.isEmpty(); }
+    QueueSettings before() const { return _before; }
+    QueueSettings after() const { return _after; }
+
+    /**
+     * @brief Restore queues left tuned by a run that did not get to restore()
+     */
+    static void restorePending(QSettings &settings, const QString &sysBlockDir = QStringLiteral("/sys/block"));
+
+private:
+    static QueueSettings _read(const QString &queueDir);
+    static void _apply(const QString &queueDir, const QueueSettings &from, const QueueSettings &to);
+    static bool _write(const QString &path, const QByteArray &value);
+
+    QString _sysBlockDir;
+    QString _device;
+    QueueSettings _before;
+    QueueSettings _after;
+};
+
+#endif // BLOCKQUEUETUNER_H
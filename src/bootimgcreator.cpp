@@ -0,0 +1,430 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "bootimgcreator.h"
+#include "devicewrapperstructs.h"
+#include <QDebug>
+#include <QSet>
+#include <QStringList>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kSectorSize = 512;
+constexpr uint32_t kReservedSectors = 32;
+constexpr uint32_t kNumFats = 2;
+constexpr uint16_t kFsInfoSector = 1;
+constexpr uint16_t kBackupBootSector = 6;
+constexpr uint32_t kRootCluster = 2;
+constexpr uint32_t kMinClusters = 65525;  // Fewer would make it FAT16
+constexpr uint32_t kEndOfChain = 0x0FFFFFFF;
+constexpr uint8_t kMedia = 0xF8;
+constexpr uint16_t kDate = (0 << 9) | (1 << 5) | 1;  // 1980-01-01
+constexpr uint32_t kVolumeId = 0x52504931;
+constexpr int kDirEntrySize = 32;
+constexpr int kLfnChars = 13;
+constexpr int kMaxNameLength = 255;
+
+struct Node {
+    QString name;
+    bool isDir = false;
+    const QByteArray *data = nullptr;
+    Node *parent = nullptr;
+    std::vector<std::unique_ptr<Node>> children;
+    QMap<QString, Node *> byName;  // Lower case name -> child
+    unsigned char shortName[11];
+    uint8_t ntRes = 0;             // Lower case flags of a plain 8.3 name
+    bool lfn = false;
+    uint32_t entryCount = 0;       // Directory entries needed, for directories
+    uint32_t firstCluster = 0;
+    uint32_t clusters = 0;
+};
+
+uint8_t lfnChecksum(const unsigned char *shortName)
+{
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; i++)
+        sum = ((sum & 1) ? 0x80 : 0) + (sum >> 1) + shortName[i];
+    return sum;
+}
+
+bool isShortNameChar(QChar c)
+{
+    const ushort u = c.unicode();
+    if ((u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9'))
+        return true;
+    return u < 0x80 && u > ' ' && std::strchr("!#$%&'()-@^_`{}~", char(u)) != nullptr;
+}
+
+bool isValidLongName(const QString &name)
+{
+    if (name.isEmpty() || name == "." || name == ".." || name.size() > kMaxNameLength)
+        return false;
+    for (QChar c : name) {
+        if (c.unicode() < ' ' || QStringLiteral("\\:*?\"<>|").contains(c))
+            return false;
+    }
+    return true;
+}
+
+/* Fills in the 8.3 name if name is one, with each part in a single case */
+bool exactShortName(const QString &name, unsigned char *out, uint8_t &ntRes)
+{
+    const int dot = name.indexOf('.');
+    if (dot == 0 || dot != name.lastIndexOf('.'))
+        return false;
+    const QString base = dot < 0 ? name : name.left(dot);
+    const QString ext = dot < 0 ? QString() : name.mid(dot + 1);
+    if (base.size() > 8 || ext.size() > 3 || (dot > 0 && ext.isEmpty()))
+        return false;
+
+    ntRes = 0;
+    auto part = [&](const QString &s, int offset, int len, uint8_t lowerFlag) {
+        bool lower = false, upper = false;
+        std::memset(out + offset, ' ', len);
+        for (int i = 0; i < s.size(); i++) {
+            QChar c = s[i];
+            if (c >= 'a' && c <= 'z') {
+                lower = true;
+                c = c.toUpper();
+            } else if (c >= 'A' && c <= 'Z') {
+                upper = true;
+            }
+            if (!isShortNameChar(c))
+                return false;
+            out[offset + i] = uchar(c.unicode());
+        }
+        if (lower && upper)
+            return false;
+        if (lower)
+            ntRes |= lowerFlag;
+        return true;
+    };
+    return part(base, 0, 8, 0x08) && part(ext, 8, 3, 0x10);
+}
+
+/* Numeric-tail short name for an entry that needs LFN entries */
+bool generateShortName(const QString &name, const QSet<QByteArray> &taken, unsigned char *out)
+{
+    QString stripped = name;
+    while (stripped.startsWith('.'))
+        stripped.remove(0, 1);
+    const int dot = stripped.lastIndexOf('.');
+
+    auto mangle = [](const QString &s, int maxLen) {
+        QByteArray result;
+        for (QChar c : s) {
+            if (result.size() == maxLen)
+                break;
+            if (c == ' ' || c == '.')
+                continue;
+            if (c.unicode() < 0x80)
+                c = c.toUpper();
+            result.append(isShortNameChar(c) ? char(c.unicode()) : '_');
+        }
+        return result;
+    };
+    QByteArray base = mangle(dot < 0 ? stripped : stripped.left(dot), 8);
+    const QByteArray ext = mangle(dot < 0 ? QString() : stripped.mid(dot + 1), 3);
+    if (base.isEmpty())
+        base = "_";
+
+    for (int n = 1; n < 1000000; n++) {
+        const QByteArray tail = "~" + QByteArray::number(n);
+        const QByteArray candidate = (base.left(8 - tail.size()) + tail).leftJustified(8, ' ')
+                                   + ext.leftJustified(3, ' ');
+        if (!taken.contains(candidate)) {
+            std::memcpy(out, candidate.constData(), 11);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool addFile(Node &root, const QString &path, const QByteArray &data)
+{
+    const QStringList parts = path.split('/', Qt::SkipEmptyParts);
+    if (parts.isEmpty() || quint64(data.size()) > 0xFFFFFFFFULL)
+        return false;
+
+    Node *dir = &root;
+    for (int i = 0; i < parts.size(); i++) {
+        const QString &part = parts[i];
+        if (!isValidLongName(part))
+            return false;
+        const bool last = i == parts.size() - 1;
+        Node *child = dir->byName.value(part.toLower());
+        if (child) {
+            // A duplicate, or a file also used as a directory
+            if (last || !child->isDir)
+                return false;
+        } else {
+            auto node = std::make_unique<Node>();
+            node->name = part;
+            node->isDir = !last;
+            node->parent = dir;
+            if (last)
+                node->data = &data;
+            child = node.get();
+            dir->byName.insert(part.toLower(), child);
+            dir->children.push_back(std::move(node));
+        }
+        dir = child;
+    }
+    return true;
+}
+
+bool assignNames(Node &dir, bool isRoot)
+{
+    QSet<QByteArray> taken;
+    dir.entryCount = isRoot ? 0 : 2;  // "." and ".."
+
+    // Plain 8.3 names first, so that generated ones avoid them
+    for (auto &child : dir.children) {
+        child->lfn = !exactShortName(child->name, child->shortName, child->ntRes);
+        if (!child->lfn)
+            taken.insert(QByteArray(reinterpret_cast<const char *>(child->shortName), 11));
+    }
+    for (auto &child : dir.children) {
+        if (child->lfn) {
+            child->ntRes = 0;
+            if (!generateShortName(child->name, taken, child->shortName))
+                return false;
+            taken.insert(QByteArray(reinterpret_cast<const char *>(child->shortName), 11));
+            dir.entryCount += (child->name.size() + kLfnChars - 1) / kLfnChars;
+        }
+        dir.entryCount++;
+        if (child->isDir && !assignNames(*child, false))
+            return false;
+    }
+    return true;
+}
+
+void collect(Node &dir, std::vector<Node *> &dirs, std::vector<Node *> &files)
+{
+    dirs.push_back(&dir);
+    for (auto &child : dir.children) {
+        if (child->isDir)
+            collect(*child, dirs, files);
+        else
+            files.push_back(child.get());
+    }
+}
+
+dir_entry makeEntry(const unsigned char *name, uint8_t attr, uint8_t ntRes, uint32_t cluster, uint32_t size)
+{
+    dir_entry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    std::memcpy(entry.DIR_Name, name, 11);
+    entry.DIR_Attr = attr;
+    entry.DIR_NTRes = ntRes;
+    entry.DIR_CrtDate = kDate;
+    entry.DIR_LstAccDate = kDate;
+    entry.DIR_WrtDate = kDate;
+    entry.DIR_FstClusHI = uint16_t(cluster >> 16);
+    entry.DIR_FstClusLO = uint16_t(cluster & 0xFFFF);
+    entry.DIR_FileSize = size;
+    return entry;
+}
+
+} // namespace
+
+QByteArray BootImgCreator::createBootImg(const QMap<QString, QByteArray> &files,
+                                         qint64 totalSize)
+{
+    if (files.isEmpty()) {
+        qDebug() << "BootImgCreator: no files to pack";
+        return {};
+    }
+    if (totalSize <= 0 || totalSize % kSectorSize || totalSize / kSectorSize > 0xFFFFFFFFLL) {
+        qDebug() << "BootImgCreator: invalid image size" << totalSize;
+        return {};
+    }
+
+    // Geometry, with the cluster sizes of the Microsoft FAT specification
+    const uint32_t totalSectors = uint32_t(totalSize / kSectorSize);
+    uint32_t sectorsPerCluster;
+    if (totalSize <= 260LL * 1024 * 1024)
+        sectorsPerCluster = 1;
+    else if (totalSize <= 8LL * 1024 * 1024 * 1024)
+        sectorsPerCluster = 8;
+    else if (totalSize <= 16LL * 1024 * 1024 * 1024)
+        sectorsPerCluster = 16;
+    else
+        sectorsPerCluster = 32;
+
+    const quint64 tmp1 = totalSectors - kReservedSectors;
+    const quint64 tmp2 = (256 * sectorsPerCluster + kNumFats) / 2;
+    const uint32_t fatSectors = uint32_t((tmp1 + tmp2 - 1) / tmp2);
+    const uint32_t clusterCount = (totalSectors - kReservedSectors - kNumFats * fatSectors) / sectorsPerCluster;
+    if (totalSectors <= kReservedSectors + kNumFats * fatSectors || clusterCount < kMinClusters) {
+        qDebug() << "BootImgCreator:" << totalSize << "bytes is too small for FAT32";
+        return {};
+    }
+    const quint64 clusterBytes = quint64(sectorsPerCluster) * kSectorSize;
+    const quint64 dataStart = quint64(kReservedSectors + kNumFats * fatSectors) * kSectorSize;
+
+    // Directory tree and names
+    Node root;
+    root.isDir = true;
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        if (!addFile(root, it.key(), it.value())) {
+            qDebug() << "BootImgCreator: cannot add" << it.key();
+            return {};
+        }
+    }
+    if (!assignNames(root, true)) {
+        qDebug() << "BootImgCreator: ran out of short names";
+        return {};
+    }
+
+    // Contiguous chains: directories first, root at cluster 2
+    std::vector<Node *> dirs, fileNodes;
+    collect(root, dirs, fileNodes);
+    quint64 nextCluster = kRootCluster;
+    auto allocate = [&](Node *node, quint64 bytes, bool atLeastOne) {
+        node->clusters = uint32_t((bytes + clusterBytes - 1) / clusterBytes);
+        if (!node->clusters && atLeastOne)
+            node->clusters = 1;
+        node->firstCluster = node->clusters ? uint32_t(nextCluster) : 0;
+        nextCluster += node->clusters;
+    };
+    for (Node *dir : dirs)
+        allocate(dir, quint64(dir->entryCount) * kDirEntrySize, true);
+    for (Node *file : fileNodes)
+        allocate(file, quint64(file->data->size()), false);
+
+    const quint64 usedClusters = nextCluster - kRootCluster;
+    if (usedClusters > clusterCount) {
+        qDebug() << "BootImgCreator: files do not fit in" << totalSize << "bytes";
+        return {};
+    }
+
+    QByteArray image(totalSize, 0);
+    char *base = image.data();
+    auto clusterData = [&](uint32_t cluster) {
+        return base + dataStart + quint64(cluster - kRootCluster) * clusterBytes;
+    };
+
+    // Boot sector, FSInfo and their backups
+    fat32_bpb bpb;
+    std::memset(&bpb, 0, sizeof(bpb));
+    bpb.BS_jmpBoot[0] = 0xEB;
+    bpb.BS_jmpBoot[1] = 0x58;
+    bpb.BS_jmpBoot[2] = 0x90;
+    std::memcpy(bpb.BS_OEMName, "MSWIN4.1", 8);
+    bpb.BPB_BytsPerSec = kSectorSize;
+    bpb.BPB_SecPerClus = uint8_t(sectorsPerCluster);
+    bpb.BPB_RsvdSecCnt = kReservedSectors;
+    bpb.BPB_NumFATs = kNumFats;
+    bpb.BPB_Media = kMedia;
+    bpb.BPB_SecPerTrk = 63;
+    bpb.BPB_NumHeads = 255;
+    bpb.BPB_TotSec32 = totalSectors;
+    bpb.BPB_FATSz32 = fatSectors;
+    bpb.BPB_RootClus = kRootCluster;
+    bpb.BPB_FSInfo = kFsInfoSector;
+    bpb.BPB_BkBootSec = kBackupBootSector;
+    bpb.BS_DrvNum = 0x80;
+    bpb.BS_BootSig = 0x29;
+    bpb.BS_VolID = kVolumeId;
+    std::memcpy(bpb.BS_VolLab, "NO NAME    ", 11);
+    std::memcpy(bpb.BS_FilSysType, "FAT32   ", 8);
+    bpb.Signature[0] = 0x55;
+    bpb.Signature[1] = 0xAA;
+
+    FSInfo fsInfo;
+    std::memset(&fsInfo, 0, sizeof(fsInfo));
+    std::memcpy(fsInfo.FSI_LeadSig, "\x52\x52\x61\x41", 4);
+    std::memcpy(fsInfo.FSI_StrucSig, "\x72\x72\x41\x61", 4);
+    fsInfo.FSI_Free_Count = uint32_t(clusterCount - usedClusters);
+    fsInfo.FSI_Nxt_Free = uint32_t(nextCluster);
+    std::memcpy(fsInfo.FSI_TrailSig, "\x00\x00\x55\xAA", 4);
+
+    for (uint32_t sector : {0u, uint32_t(kBackupBootSector)}) {
+        std::memcpy(base + sector * kSectorSize, &bpb, sizeof(bpb));
+        std::memcpy(base + (sector + kFsInfoSector) * kSectorSize, &fsInfo, sizeof(fsInfo));
+    }
+
+    // FATs
+    std::vector<uint32_t> fat(quint64(fatSectors) * kSectorSize / sizeof(uint32_t), 0);
+    fat[0] = 0x0FFFFF00 | kMedia;
+    fat[1] = kEndOfChain;
+    auto chain = [&](const Node *node) {
+        for (uint32_t i = 0; i < node->clusters; i++) {
+            const uint32_t cluster = node->firstCluster + i;
+            fat[cluster] = i + 1 < node->clusters ? cluster + 1 : kEndOfChain;
+        }
+    };
+    for (Node *dir : dirs)
+        chain(dir);
+    for (Node *file : fileNodes)
+        chain(file);
+    for (uint32_t i = 0; i < kNumFats; i++) {
+        std::memcpy(base + (kReservedSectors + i * fatSectors) * quint64(kSectorSize),
+                    fat.data(), fat.size() * sizeof(uint32_t));
+    }
+
+    // Directories
+    for (Node *dir : dirs) {
+        char *out = clusterData(dir->firstCluster);
+        auto put = [&out](const void *entry) {
+            std::memcpy(out, entry, kDirEntrySize);
+            out += kDirEntrySize;
+        };
+
+        if (dir != &root) {
+            const uint32_t parentCluster = dir->parent == &root ? 0 : dir->parent->firstCluster;
+            dir_entry dot = makeEntry(reinterpret_cast<const unsigned char *>(".          "),
+                                      ATTR_DIRECTORY, 0, dir->firstCluster, 0);
+            dir_entry dotdot = makeEntry(reinterpret_cast<const unsigned char *>("..         "),
+                                         ATTR_DIRECTORY, 0, parentCluster, 0);
+            put(&dot);
+            put(&dotdot);
+        }
+
+        for (auto &child : dir->children) {
+            if (child->lfn) {
+                const uint8_t checksum = lfnChecksum(child->shortName);
+                const ushort *name = child->name.utf16();
+                const int len = child->name.size();
+                const int count = (len + kLfnChars - 1) / kLfnChars;
+                for (int n = count; n >= 1; n--) {
+                    longfn_entry lfn;
+                    std::memset(&lfn, 0, sizeof(lfn));
+                    lfn.LDIR_Ord = uint8_t(n | (n == count ? LAST_LONG_ENTRY : 0));
+                    lfn.LDIR_Attr = ATTR_LONG_NAME;
+                    lfn.LDIR_Chksum = checksum;
+                    uint16_t chars[kLfnChars];
+                    for (int i = 0; i < kLfnChars; i++) {
+                        const int pos = (n - 1) * kLfnChars + i;
+                        chars[i] = pos < len ? name[pos] : (pos == len ? 0x0000 : 0xFFFF);
+                    }
+                    std::memcpy(lfn.LDIR_Name1, chars, 10);
+                    std::memcpy(lfn.LDIR_Name2, chars + 5, 12);
+                    std::memcpy(lfn.LDIR_Name3, chars + 11, 4);
+                    put(&lfn);
+                }
+            }
+            dir_entry entry = makeEntry(child->shortName,
+                                        child->isDir ? ATTR_DIRECTORY : ATTR_ARCHIVE,
+                                        child->ntRes, child->firstCluster,
+                                        child->isDir ? 0 : uint32_t(child->data->size()));
+            put(&entry);
+        }
+    }
+
+    // File contents
+    for (Node *file : fileNodes) {
+        if (file->clusters)
+            std::memcpy(clusterData(file->firstCluster), file->data->constData(), file->data->size());
+    }
+
+    qDebug() << "BootImgCreator: created" << totalSize << "byte boot.img with"
+             << fileNodes.size() << "files," << usedClusters << "of" << clusterCount << "clusters used";
+    return image;
+}
@@ -11,15 +11,12 @@
 #include <QByteArray>
 
 /**
- * @brief Platform-specific boot.img creation helper
- * 
- * This class provides platform-specific implementations for creating
- * FAT32 disk images and copying files with directory hierarchy preservation.
- * 
- * Platform-specific implementations are in:
- * - mac/bootimgcreator_macos.cpp
- * - linux/bootimgcreator_linux.cpp
- * - windows/bootimgcreator_windows.cpp
+ * @brief boot.img creation helper
+ *
+ * Lays out a FAT32 file system directly in memory, so no platform tools
+ * (mkfs.vfat/mtools, hdiutil, diskpart) or temporary files are needed.
+ * Timestamps and the volume ID are fixed: the same files always give the
+ * same image, and therefore the same boot.sig.
  */
 class BootImgCreator
 {
@@ -27,14 +24,12 @@ public:
     /**
      * @brief Create a FAT32 boot.img with all files and directory structure
      * @param files Map of file paths to contents (paths may include subdirectories)
-     * @param outputPath Path where boot.img should be created
-     * @param totalSize Size in bytes for the boot.img file
-     * @return true if successful, false otherwise
+     * @param totalSize Size in bytes of the image, a multiple of 512 large
+     * enough for FAT32 (33MB)
+     * @return the image, or an empty array on error
      */
-    static bool createBootImg(const QMap<QString, QByteArray> &files, 
-                             const QString &outputPath, 
-                             qint64 totalSize);
+    static QByteArray createBootImg(const QMap<QString, QByteArray> &files,
+                                    qint64 totalSize);
 };
 
 #endif // BOOTIMGCREATOR_H
-
@@ -0,0 +1,67 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "bootpartitionshadow.h"
+#include "devicewrapper.h"
+#include <QDebug>
+#include <stdexcept>
+
+using rpi_imager::FileError;
+
+bool BootPartitionShadow::open(const char *firstBlock, size_t firstBlockSize)
+{
+    _start = _end = _captured = 0;
+
+    if (_disk.OpenDevice(rpi_imager::MemoryFileOperations::kRamdiskPrefix) != FileError::kSuccess ||
+        _disk.WriteAtOffset(0, reinterpret_cast<const std::uint8_t *>(firstBlock), firstBlockSize) != FileError::kSuccess)
+    {
+        return false;
+    }
+
+    // Anything the partition table points at beyond the first block reads
+    // back as zeros here, so the checks below also catch a GPT whose
+    // entries are not in the first block
+    quint64 offset, size;
+    try
+    {
+        DeviceWrapper dw(&_disk);
+        dw.partitionRange(1, offset, size);
+    }
+    catch (const std::runtime_error &err)
+    {
+        qDebug() << "BootPartitionShadow: no boot partition:" << err.what();
+        return false;
+    }
+
+    std::uint64_t diskSize = 0;
+    _disk.GetSize(diskSize);
+    if (offset < firstBlockSize || !size || size > kMaxPartitionSize || offset + size > diskSize)
+    {
+        qDebug() << "BootPartitionShadow: not holding back partition at" << offset << "size" << size;
+        return false;
+    }
+
+    _start = offset;
+    _end = offset + size;
+    qDebug() << "BootPartitionShadow: holding back boot partition at" << _start << "size" << size;
+    return true;
+}
+
+bool BootPartitionShadow::capture(const char *buf, size_t len)
+{
+    if (len > _end - _start - _captured)
+        return false;
+    if (_disk.WriteAtOffset(_start + _captured, reinterpret_cast<const std::uint8_t *>(buf), len) != FileError::kSuccess)
+        return false;
+    _captured += len;
+    return true;
+}
+
+bool BootPartitionShadow::read(std::uint64_t offset, char *buf, size_t len)
+{
+    std::size_t bytesRead = 0;
+    return _disk.ReadAtOffset(offset, reinterpret_cast<std::uint8_t *>(buf), len, bytesRead) == FileError::kSuccess &&
+           bytesRead == len;
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef BOOTPARTITIONSHADOW_H
+#define BOOTPARTITIONSHADOW_H
+
+#include "file_operations_memory.h"
+#include <cstdint>
+
+/**
+ * @brief In-memory copy of the boot partition of an image being written
+ *
+ * Lets customisation be applied before the boot partition reaches the
+ * device, instead of reading it back, modifying and rewriting it after
+ * the write. DownloadThread holds the partition back as it streams past,
+ * runs the customisation against file() once all of it has been captured,
+ * and then writes it out in one go.
+ *
+ * The copy is a sparse ramdisk holding the first block (for the partition
+ * table) and the partition, so free space takes no memory.
+ *
+ * Lifecycle (all calls from the writing thread):
+ *   open()     - find partition 1 in the held-back first block
+ *   capture()  - take the partition's data, in order
+ *   complete() - all of the partition has been captured
+ *   file()     - for DeviceWrapper, to customise the partition
+ *   read()     - read the result back for writing
+ */
+class BootPartitionShadow
+{
+public:
+    // Larger partitions are written and customised as usual
+    static constexpr std::uint64_t kMaxPartitionSize = 1ULL << 30;
+
+    /**
+     * @brief Locate the boot partition
+     * @param firstBlock The start of the image, with the partition table
+     * @return false if partition 1 does not exist, starts inside the
+     * first block or is too large
+     */
+    bool open(const char *firstBlock, size_t firstBlockSize);
+
+    std::uint64_t start() const { return _start; }
+    std::uint64_t end() const { return _end; }
+    // Bytes of the partition captured so far
+    std::uint64_t captured() const { return _captured; }
+    bool complete() const { return _end && _captured == _end - _start; }
+
+    /**
+     * @brief Take the next len bytes of the partition
+     * @return false on error or if that goes past the end of the partition
+     */
+    bool capture(const char *buf, size_t len);
+
+    rpi_imager::FileOperations *file() { return &_disk; }
+
+    /* Read back part of the captured partition; offset is in the image */
+    bool read(std::uint64_t offset, char *buf, size_t len);
+
+private:
+    rpi_imager::MemoryFileOperations _disk;
+    std::uint64_t _start = 0;
+    std::uint64_t _end = 0;
+    std::uint64_t _captured = 0;
+};
+
+#endif // BOOTPARTITIONSHADOW_H
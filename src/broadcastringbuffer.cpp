@@ -0,0 +1,373 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "broadcastringbuffer.h"
+#include <QtGlobal>
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+BroadcastRingBuffer::BroadcastRingBuffer(size_t numSlots, size_t slotSize, size_t alignment)
+    : _numSlots(numSlots)
+    , _slotSize(slotSize)
+    , _hugePageSlots(0)
+    , _started(false)
+    , _written(0)
+    , _committed(0)
+    , _producerWaiting(false)
+    , _consumersWaiting(0)
+    , _producerDone(false)
+    , _cancelled(false)
+    , _stallTimeoutExceeded(false)
+    , _stallType(StallType::None)
+    , _stalledConsumer(-1)
+    , _producerStalls(0)
+    , _producerWaitMs(0)
+    , _sessionTimer(nullptr)
+{
+    _slots.resize(numSlots);
+    _memory.reserve(numSlots);
+
+    for (size_t i = 0; i < numSlots; ++i) {
+        BufferPool::Buffer mem = BufferPool::instance().acquire(slotSize, alignment, SLOT_ALLOCATION_WAIT_MS);
+        if (!mem) {
+            qDebug() << "BroadcastRingBuffer: Failed to allocate slot" << i;
+            _memory.clear();
+            throw std::bad_alloc();
+        }
+        if (mem.isHugePage()) {
+            _hugePageSlots++;
+        }
+        _slots[i].data = mem.data();
+        _slots[i].capacity = slotSize;
+        _slots[i].size = 0;
+        _memory.push_back(std::move(mem));
+    }
+
+    qDebug() << "BroadcastRingBuffer: Allocated" << numSlots << "slots of"
+             << slotSize / 1024 << "KB each (" << (numSlots * slotSize) / (1024 * 1024) << "MB total)";
+}
+
+BroadcastRingBuffer::~BroadcastRingBuffer()
+{
+    cancel();
+
+    for (const ConsumerStats& stats : getConsumerStats()) {
+        if (stats.blockingStalls > 0 || stats.waitStalls > 0) {
+            qDebug() << "BroadcastRingBuffer consumer" << stats.name
+                     << (stats.detached ? "(detached)" : "")
+                     << "max lag:" << stats.maxLagSlots << "slots,"
+                     << "held up the producer" << stats.blockingStalls << "times ("
+                     << stats.blockingMs << "ms), waited for data" << stats.waitStalls << "times ("
+                     << stats.waitMs << "ms)";
+        }
+    }
+
+    _memory.clear();
+}
+
+int BroadcastRingBuffer::addConsumer(const QString& name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_started) {
+        qDebug() << "BroadcastRingBuffer: consumer" << name << "registered after the producer started";
+        return -1;
+    }
+    auto consumer = std::make_unique<Consumer>();
+    consumer->name = name;
+    _consumers.push_back(std::move(consumer));
+    return static_cast<int>(_consumers.size() - 1);
+}
+
+bool BroadcastRingBuffer::_validConsumer(int consumer) const
+{
+    return consumer >= 0 && static_cast<size_t>(consumer) < _consumers.size();
+}
+
+void BroadcastRingBuffer::detachConsumer(int consumer)
+{
+    if (!_validConsumer(consumer)) return;
+
+    Consumer& c = *_consumers[consumer];
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!c.attached) return;
+        c.attached = false;
+    }
+    qDebug() << "BroadcastRingBuffer: detached consumer" << c.name
+             << "with" << (_committed.load() - c.released.load()) << "slots unreleased";
+
+    _writeAvailable.notify_all();
+    _readAvailable.notify_all();
+}
+
+uint64_t BroadcastRingBuffer::_releasedByAll() const
+{
+    uint64_t released = std::numeric_limits<uint64_t>::max();
+    for (const auto& c : _consumers) {
+        if (c->attached) {
+            released = std::min(released, c->released.load());
+        }
+    }
+    return released;
+}
+
+int BroadcastRingBuffer::slowestConsumer() const
+{
+    int slowest = -1;
+    uint64_t released = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0; i < _consumers.size(); ++i) {
+        const Consumer& c = *_consumers[i];
+        if (c.attached && c.released < released) {
+            released = c.released;
+            slowest = static_cast<int>(i);
+        }
+    }
+    return slowest;
+}
+
+int BroadcastRingBuffer::attachedConsumers() const
+{
+    return static_cast<int>(std::count_if(_consumers.begin(), _consumers.end(),
+                                          [](const auto& c) { return c->attached.load(); }));
+}
+
+template <typename Ready>
+bool BroadcastRingBuffer::_wait(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, int timeoutMs,
+                                Ready ready, StallType type, int consumer, uint64_t& waitedMs)
+{
+    auto waitPred = [&] { return ready() || _cancelled || _stallTimeoutExceeded; };
+    const auto waitStart = std::chrono::steady_clock::now();
+    auto elapsedMs = [&waitStart] {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - waitStart).count());
+    };
+
+    bool satisfied = true;
+    while (!waitPred()) {
+        const int waitMs = timeoutMs > 0 ? timeoutMs : 100;  // Use 100ms chunks if no timeout specified
+        if (cv.wait_for(lock, std::chrono::milliseconds(waitMs), waitPred)) {
+            break;
+        }
+        if (elapsedMs() >= STALL_TIMEOUT_MS) {
+            _stallTimeoutExceeded = true;
+            _stallType.store(type);
+            _stalledConsumer = type == StallType::ProducerStall ? consumer : -1;
+            qDebug() << "BroadcastRingBuffer:" << RingBuffer::stallTypeToString(type)
+                     << "timeout exceeded after" << elapsedMs() << "ms";
+            satisfied = false;
+            break;
+        }
+        if (timeoutMs > 0) {
+            satisfied = false;
+            break;
+        }
+    }
+    waitedMs = elapsedMs();
+    return satisfied;
+}
+
+void BroadcastRingBuffer::_recordStall(uint64_t durationMs, bool isProducer, int consumer)
+{
+    if (durationMs < STALL_EVENT_THRESHOLD_MS) return;
+
+    std::lock_guard<std::mutex> eventLock(_stallEventsMutex);
+    StallEvent event;
+    event.timestampMs = _sessionTimer ? _sessionTimer->elapsed() : 0;
+    event.durationMs = static_cast<uint32_t>(durationMs);
+    event.isProducer = isProducer;
+    event.consumer = consumer;
+    _stallEvents.push(event);
+}
+
+BroadcastRingBuffer::Slot* BroadcastRingBuffer::acquireWriteSlot(int timeoutMs)
+{
+    _started = true;
+
+    // Fast path: every attached consumer is past the slot. Only the
+    // producer advances _written.
+    if (!_cancelled && !_stallTimeoutExceeded && _written - _releasedByAll() < _numSlots &&
+        attachedConsumers() > 0) {
+        return &_slots[_written++ % _numSlots];
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // Set before the cursors are re-checked so a release cannot be missed
+    _producerWaiting = true;
+    struct ClearOnExit {
+        std::atomic<bool>& flag;
+        ~ClearOnExit() { flag = false; }
+    } clearWaiting{_producerWaiting};
+
+    auto ready = [this] {
+        return attachedConsumers() == 0 || _written - _releasedByAll() < _numSlots;
+    };
+
+    if (!ready()) {
+        // The consumer furthest behind holds the oldest slot
+        const int blamed = slowestConsumer();
+        _producerStalls++;
+        uint64_t waitedMs = 0;
+        _wait(lock, _writeAvailable, timeoutMs, ready, StallType::ProducerStall, blamed, waitedMs);
+        _producerWaitMs += waitedMs;
+        if (blamed >= 0) {
+            _consumers[blamed]->blockingStalls++;
+            _consumers[blamed]->blockingMs += waitedMs;
+        }
+        _recordStall(waitedMs, true, blamed);
+    }
+
+    if (_cancelled || _stallTimeoutExceeded || attachedConsumers() == 0 || !ready()) {
+        return nullptr;
+    }
+    return &_slots[_written++ % _numSlots];
+}
+
+void BroadcastRingBuffer::commitWriteSlot(Slot* slot, size_t dataSize)
+{
+    if (!slot) return;
+
+    slot->size = dataSize;
+    const uint64_t committed = _committed.fetch_add(1) + 1;
+
+    for (const auto& c : _consumers) {
+        const size_t lag = static_cast<size_t>(committed - c->released.load());
+        if (c->attached && lag > c->maxLag.load(std::memory_order_relaxed)) {
+            c->maxLag.store(lag, std::memory_order_relaxed);
+        }
+    }
+
+    if (_consumersWaiting > 0) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _readAvailable.notify_all();
+    }
+}
+
+const BroadcastRingBuffer::Slot* BroadcastRingBuffer::acquireReadSlot(int consumer, int timeoutMs)
+{
+    if (!_validConsumer(consumer)) return nullptr;
+    Consumer& c = *_consumers[consumer];
+
+    // Fast path: data is ready. Only this consumer advances its cursor.
+    if (c.attached && !_cancelled && !_stallTimeoutExceeded && c.next < _committed) {
+        return &_slots[c.next++ % _numSlots];
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _consumersWaiting++;
+    struct DecrementOnExit {
+        std::atomic<int>& count;
+        ~DecrementOnExit() { count--; }
+    } clearWaiting{_consumersWaiting};
+
+    auto ready = [this, &c] {
+        return c.next < _committed || _producerDone || !c.attached;
+    };
+
+    if (!ready()) {
+        c.waitStalls++;
+        uint64_t waitedMs = 0;
+        _wait(lock, _readAvailable, timeoutMs, ready, StallType::ConsumerStall, consumer, waitedMs);
+        c.waitMs += waitedMs;
+        _recordStall(waitedMs, false, consumer);
+    }
+
+    if (!c.attached || _cancelled || _stallTimeoutExceeded || c.next >= _committed) {
+        return nullptr;  // Detached, cancelled, timed out or EOF
+    }
+    return &_slots[c.next++ % _numSlots];
+}
+
+void BroadcastRingBuffer::releaseReadSlot(int consumer, const Slot* slot)
+{
+    if (!slot || !_validConsumer(consumer)) return;
+    Consumer& c = *_consumers[consumer];
+
+    if (slot != &_slots[c.released % _numSlots]) {
+        qDebug() << "BroadcastRingBuffer: consumer" << c.name << "released a slot out of order";
+    }
+    c.bytesRead += slot->size;
+    c.released++;
+
+    _notifyProducer();
+}
+
+void BroadcastRingBuffer::_notifyProducer()
+{
+    // Only take the mutex if the producer is blocked
+    if (_producerWaiting) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _writeAvailable.notify_one();
+    }
+}
+
+void BroadcastRingBuffer::producerDone()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _producerDone = true;
+    }
+    _readAvailable.notify_all();
+}
+
+bool BroadcastRingBuffer::isComplete(int consumer) const
+{
+    if (!_validConsumer(consumer)) return true;
+    return _producerDone && _consumers[consumer]->next >= _committed;
+}
+
+void BroadcastRingBuffer::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cancelled = true;
+    }
+    _writeAvailable.notify_all();
+    _readAvailable.notify_all();
+}
+
+std::vector<BroadcastRingBuffer::ConsumerStats> BroadcastRingBuffer::getConsumerStats() const
+{
+    std::vector<ConsumerStats> result;
+    result.reserve(_consumers.size());
+    const uint64_t committed = _committed.load();
+    for (const auto& c : _consumers) {
+        ConsumerStats stats;
+        stats.name = c->name;
+        stats.detached = !c->attached;
+        stats.slotsRead = c->released.load();
+        stats.bytesRead = c->bytesRead.load();
+        stats.lagSlots = static_cast<size_t>(committed - std::min(committed, c->released.load()));
+        stats.maxLagSlots = c->maxLag.load();
+        stats.waitStalls = c->waitStalls.load();
+        stats.waitMs = c->waitMs.load();
+        stats.blockingStalls = c->blockingStalls.load();
+        stats.blockingMs = c->blockingMs.load();
+        result.push_back(stats);
+    }
+    return result;
+}
+
+void BroadcastRingBuffer::getProducerStats(uint64_t& producerStalls, uint64_t& totalProducerWaitMs) const
+{
+    producerStalls = _producerStalls.load();
+    totalProducerWaitMs = _producerWaitMs.load();
+}
+
+std::vector<BroadcastRingBuffer::StallEvent> BroadcastRingBuffer::getPendingStallEvents()
+{
+    std::lock_guard<std::mutex> lock(_stallEventsMutex);
+    std::vector<StallEvent> events;
+
+    while (!_stallEvents.empty()) {
+        events.push_back(_stallEvents.front());
+        _stallEvents.pop();
+    }
+
+    return events;
+}
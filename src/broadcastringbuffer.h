@@ -0,0 +1,301 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef BROADCASTRINGBUFFER_H
+#define BROADCASTRINGBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <queue>
+#include <QElapsedTimer>
+#include <QString>
+#include "bufferpool.h"
+#include "ringbuffer.h"
+
+/**
+ * @brief Ring buffer with one producer and several consumers of every slot
+ *
+ * Each registered consumer (cache writer, hasher, target devices, sparse
+ * encoder, ...) reads every committed slot through its own cursor. A slot
+ * goes back to the producer only once every attached consumer has
+ * released it, so the producer runs at the pace of the slowest one.
+ *
+ * A consumer that fails is detached: its cursor stops counting, the
+ * producer and the other consumers carry on, and its own calls return
+ * nullptr. When the producer waits for a free slot, the wait is blamed on
+ * the consumer furthest behind, so stall events and per-consumer stats
+ * say who held the write up.
+ *
+ * Like RingBuffer, acquire, commit and release are atomic operations
+ * while nobody has to wait. Consumers must be registered before the first
+ * acquireWriteSlot(); each consumer is used from one thread and releases
+ * its slots in the order it acquired them.
+ */
+class BroadcastRingBuffer
+{
+public:
+    using Slot = RingBuffer::Slot;
+    using StallType = RingBuffer::StallType;
+
+    /**
+     * @brief A stall event for performance tracking
+     */
+    struct StallEvent {
+        qint64 timestampMs;  // When the stall occurred (from session start)
+        uint32_t durationMs; // How long the stall lasted
+        bool isProducer;     // true = producer waited for a free slot, false = consumer waited for data
+        int consumer;        // Producer stall: the consumer it waited for; consumer stall: the one that waited
+    };
+
+    /**
+     * @brief Per-consumer counters
+     */
+    struct ConsumerStats {
+        QString name;
+        bool detached;
+        uint64_t slotsRead;
+        uint64_t bytesRead;
+        size_t lagSlots;          // Committed slots not yet released
+        size_t maxLagSlots;
+        uint64_t waitStalls;      // Times it waited for the producer
+        uint64_t waitMs;
+        uint64_t blockingStalls;  // Times the producer waited for it
+        uint64_t blockingMs;
+    };
+
+    /**
+     * @brief Constructor
+     * @param numSlots Number of slots in the ring buffer
+     * @param slotSize Size of each slot in bytes
+     * @param alignment Memory alignment for slots (default 4096 for direct I/O)
+     */
+    BroadcastRingBuffer(size_t numSlots, size_t slotSize, size_t alignment = 4096);
+
+    /**
+     * @brief Destructor - frees all pre-allocated memory
+     */
+    ~BroadcastRingBuffer();
+
+    // Non-copyable
+    BroadcastRingBuffer(const BroadcastRingBuffer&) = delete;
+    BroadcastRingBuffer& operator=(const BroadcastRingBuffer&) = delete;
+
+    /**
+     * @brief Register a consumer, before the producer starts
+     * @param name Used in stats and logs
+     * @return Consumer id for the consumer side calls
+     */
+    int addConsumer(const QString& name);
+
+    /**
+     * @brief Stop waiting for a consumer (e.g. a failed target device)
+     *
+     * Slots it still holds count as released, and its blocked calls return.
+     * Safe to call from any thread.
+     */
+    void detachConsumer(int consumer);
+
+    /**
+     * @brief Acquire a slot for writing (producer side)
+     *
+     * Blocks until every attached consumer has released the slot.
+     *
+     * @param timeoutMs Maximum time to wait in milliseconds (0 = infinite)
+     * @return Pointer to slot, or nullptr if timeout/cancelled or no
+     *         consumer is attached any more
+     */
+    Slot* acquireWriteSlot(int timeoutMs = 0);
+
+    /**
+     * @brief Commit a write slot after filling it with data (producer side)
+     * @param slot The slot to commit
+     * @param dataSize Actual size of data written to slot
+     */
+    void commitWriteSlot(Slot* slot, size_t dataSize);
+
+    /**
+     * @brief Acquire the consumer's next slot for reading
+     *
+     * Blocks if the consumer has read everything committed so far.
+     *
+     * @param timeoutMs Maximum time to wait in milliseconds (0 = infinite)
+     * @return Pointer to slot with data, or nullptr on EOF, timeout,
+     *         cancel or after the consumer was detached
+     */
+    const Slot* acquireReadSlot(int consumer, int timeoutMs = 0);
+
+    /**
+     * @brief Release the consumer's oldest acquired slot
+     */
+    void releaseReadSlot(int consumer, const Slot* slot);
+
+    /**
+     * @brief Signal that producer is done (no more data will be written)
+     */
+    void producerDone();
+
+    /**
+     * @brief Check if producer has signaled completion and the consumer has read everything
+     */
+    bool isComplete(int consumer) const;
+
+    /**
+     * @brief Cancel all operations and wake blocked threads
+     */
+    void cancel();
+
+    /**
+     * @brief Check if cancelled
+     */
+    bool isCancelled() const { return _cancelled; }
+
+    /**
+     * @brief Check if stall timeout was exceeded
+     * This is set when acquire operations exceed STALL_TIMEOUT_MS cumulative wait time
+     */
+    bool isStallTimeoutExceeded() const { return _stallTimeoutExceeded; }
+
+    /**
+     * @brief Get stall type (for error handling)
+     */
+    StallType getStallType() const { return _stallType.load(); }
+
+    /**
+     * @brief Consumer blamed for the stall timeout, or -1
+     */
+    int stalledConsumer() const { return _stalledConsumer.load(); }
+
+    /**
+     * @brief Attached consumer with the most unreleased slots, or -1
+     *
+     * E.g. the one to detach after acquireWriteSlot() timed out.
+     */
+    int slowestConsumer() const;
+
+    /**
+     * @brief Number of consumers still attached
+     */
+    int attachedConsumers() const;
+
+    /**
+     * @brief Get the capacity of each slot
+     */
+    size_t slotCapacity() const { return _slotSize; }
+
+    /**
+     * @brief Get number of slots
+     */
+    size_t numSlots() const { return _numSlots; }
+
+    /**
+     * @brief Get number of slots backed by huge (large) pages
+     */
+    size_t hugePageSlots() const { return _hugePageSlots; }
+
+    /**
+     * @brief Get per-consumer lag and stall statistics
+     */
+    std::vector<ConsumerStats> getConsumerStats() const;
+
+    /**
+     * @brief Get producer starvation statistics
+     */
+    void getProducerStats(uint64_t& producerStalls, uint64_t& totalProducerWaitMs) const;
+
+    /**
+     * @brief Set the session timer for stall event timestamps
+     * @param timer Pointer to QElapsedTimer started at session begin
+     */
+    void setSessionTimer(QElapsedTimer* timer) { _sessionTimer = timer; }
+
+    /**
+     * @brief Get and clear pending stall events (for performance logging)
+     * @return Vector of stall events since last call
+     */
+    std::vector<StallEvent> getPendingStallEvents();
+
+private:
+    struct Consumer {
+        QString name;
+        std::atomic<bool> attached{true};
+        std::atomic<bool> waiting{false};
+        std::atomic<uint64_t> next{0};      // Sequence number of the next slot to acquire
+        std::atomic<uint64_t> released{0};  // Slots released so far
+        std::atomic<uint64_t> bytesRead{0};
+        std::atomic<size_t> maxLag{0};
+        std::atomic<uint64_t> waitStalls{0};
+        std::atomic<uint64_t> waitMs{0};
+        std::atomic<uint64_t> blockingStalls{0};
+        std::atomic<uint64_t> blockingMs{0};
+    };
+
+    size_t _numSlots;
+    size_t _slotSize;
+
+    std::vector<Slot> _slots;
+    std::vector<BufferPool::Buffer> _memory;  // Slot memory borrowed from the pool
+    size_t _hugePageSlots;
+
+    std::vector<std::unique_ptr<Consumer>> _consumers;  // Fixed once the producer starts
+    std::atomic<bool> _started;
+
+    uint64_t _written;                 // Slots handed to the producer (producer only)
+    std::atomic<uint64_t> _committed;  // Slots committed
+
+    // Set while a side is blocked in the slow path, so the other side only
+    // takes the mutex to notify when someone is waiting
+    std::atomic<bool> _producerWaiting;
+    std::atomic<int> _consumersWaiting;
+
+    // Synchronization (slow path only)
+    mutable std::mutex _mutex;
+    std::condition_variable _writeAvailable;  // Signaled when a slot is released by everyone
+    std::condition_variable _readAvailable;   // Signaled when data is committed
+
+    // State
+    std::atomic<bool> _producerDone;
+    std::atomic<bool> _cancelled;
+    std::atomic<bool> _stallTimeoutExceeded;
+    std::atomic<StallType> _stallType;
+    std::atomic<int> _stalledConsumer;
+
+    std::atomic<uint64_t> _producerStalls;
+    std::atomic<uint64_t> _producerWaitMs;
+
+    // Stall event queue for time-series correlation
+    QElapsedTimer* _sessionTimer;               // External timer for timestamps (not owned)
+    std::queue<StallEvent> _stallEvents;        // Queue of significant stall events
+    std::mutex _stallEventsMutex;               // Protects _stallEvents
+
+    // Same values as RingBuffer (TimeoutDefaults::kRingBufferStallEventThresholdMs
+    // and kRingBufferStallTimeoutMs)
+    static const uint32_t STALL_EVENT_THRESHOLD_MS = 50;
+    static const uint32_t STALL_TIMEOUT_MS = 30000;
+
+    // How long to wait for other stages to return pool memory for a slot
+    static const int SLOT_ALLOCATION_WAIT_MS = 2000;
+
+    bool _validConsumer(int consumer) const;
+
+    // Slots released by every attached consumer
+    uint64_t _releasedByAll() const;
+
+    // Wait on cv until ready() or cancel/stall timeout, in the chunked way
+    // of RingBuffer. Returns false on timeout; waitedMs is the time spent.
+    template <typename Ready>
+    bool _wait(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, int timeoutMs,
+               Ready ready, StallType type, int consumer, uint64_t& waitedMs);
+
+    void _recordStall(uint64_t durationMs, bool isProducer, int consumer);
+
+    void _notifyProducer();
+};
+
+#endif // BROADCASTRINGBUFFER_H
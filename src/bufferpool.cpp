@@ -0,0 +1,401 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "bufferpool.h"
+#include <QtGlobal>
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <fstream>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#elif defined(Q_OS_LINUX)
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+constexpr size_t MIN_SIZE_CLASS = 4096;
+
+#ifdef Q_OS_LINUX
+enum class ThpMode { Always, Madvise, Never };
+
+// /sys/kernel/mm/transparent_hugepage/enabled reads e.g. "always [madvise] never"
+ThpMode thpMode()
+{
+    static const ThpMode mode = [] {
+        std::ifstream f("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string line;
+        if (!std::getline(f, line) || line.find("[never]") != std::string::npos)
+            return ThpMode::Never;
+        return line.find("[always]") != std::string::npos ? ThpMode::Always : ThpMode::Madvise;
+    }();
+    return mode;
+}
+
+size_t hugePageSize()
+{
+    static const size_t size = [] {
+        if (thpMode() == ThpMode::Never)
+            return size_t(0);
+        std::ifstream f("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+        unsigned long long bytes = 0;
+        if (!(f >> bytes) || bytes == 0)
+            bytes = 2 * 1024 * 1024;
+        return static_cast<size_t>(bytes);
+    }();
+    return size;
+}
+#elif defined(Q_OS_WIN)
+// Large pages need SeLockMemoryPrivilege, which is off even for
+// administrators unless granted by policy; try to enable it once
+size_t hugePageSize()
+{
+    static const size_t size = [] {
+        const size_t minimum = GetLargePageMinimum();
+        if (minimum == 0)
+            return size_t(0);
+
+        HANDLE token = nullptr;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+            return size_t(0);
+        TOKEN_PRIVILEGES tp = {};
+        tp.PrivilegeCount = 1;
+        tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        bool enabled = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid)
+                    && AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr)
+                    && GetLastError() == ERROR_SUCCESS;  // ERROR_NOT_ALL_ASSIGNED if not held
+        CloseHandle(token);
+        return enabled ? minimum : size_t(0);
+    }();
+    return size;
+}
+#else
+size_t hugePageSize()
+{
+    return 0;
+}
+#endif
+
+} // namespace
+
+BufferPool::Buffer& BufferPool::Buffer::operator=(Buffer&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        _pool = other._pool;
+        _data = other._data;
+        _capacity = other._capacity;
+        _hugePage = other._hugePage;
+        other._pool = nullptr;
+        other._data = nullptr;
+        other._capacity = 0;
+        other._hugePage = false;
+    }
+    return *this;
+}
+
+void BufferPool::Buffer::release()
+{
+    if (_pool && _data) {
+        _pool->_release(_data, _capacity, _hugePage);
+    }
+    _pool = nullptr;
+    _data = nullptr;
+    _capacity = 0;
+    _hugePage = false;
+}
+
+BufferPool& BufferPool::instance()
+{
+    static BufferPool instance;
+    return instance;
+}
+
+BufferPool::BufferPool(uint64_t limit)
+    : _limit(limit)
+    , _inUse(0)
+    , _cached(0)
+    , _peak(0)
+    , _hugePageBytes(0)
+    , _reused(0)
+    , _waits(0)
+    , _failures(0)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    trim();
+    if (_inUse > 0) {
+        qDebug() << "BufferPool: destroyed with" << _inUse / 1024 << "KB still borrowed";
+    }
+}
+
+size_t BufferPool::sizeClass(size_t size)
+{
+    if (size <= MIN_SIZE_CLASS) {
+        return MIN_SIZE_CLASS;
+    }
+
+    // Four classes per power of two: 1, 1.25, 1.5 and 1.75 times 2^k
+    size_t base = MIN_SIZE_CLASS;
+    while (base * 2 < size) {
+        base *= 2;
+    }
+    const size_t step = base / 4;
+    return (size + step - 1) / step * step;
+}
+
+BufferPool::Buffer BufferPool::acquire(size_t size, size_t alignment, int waitMs)
+{
+    const size_t capacity = sizeClass(size);
+    if (alignment < MIN_SIZE_CLASS) {
+        alignment = MIN_SIZE_CLASS;
+    }
+
+    Buffer buffer;
+    std::unique_lock<std::mutex> lock(_mutex);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitMs);
+    bool waited = false;
+
+    while (true) {
+        // Reuse a returned block of the same class
+        auto it = _cache.find(capacity);
+        if (it != _cache.end()) {
+            auto& blocks = it->second;
+            for (size_t i = 0; i < blocks.size(); ++i) {
+                if (reinterpret_cast<uintptr_t>(blocks[i].data) % alignment != 0) {
+                    continue;
+                }
+                Block block = blocks[i];
+                blocks.erase(blocks.begin() + static_cast<std::ptrdiff_t>(i));
+                if (blocks.empty()) {
+                    _cache.erase(it);
+                }
+                _cached -= block.capacity;
+                _inUse += block.capacity;
+                _reused++;
+                buffer._pool = this;
+                buffer._data = block.data;
+                buffer._capacity = block.capacity;
+                buffer._hugePage = block.hugePage;
+                return buffer;
+            }
+        }
+
+        if (_limit == 0 || _evictFor(capacity)) {
+            bool hugePage = false;
+            char* data = _allocate(capacity, alignment, hugePage);
+            if (!data) {
+                _failures++;
+                qDebug() << "BufferPool: Failed to allocate" << capacity / 1024 << "KB";
+                return buffer;
+            }
+            _inUse += capacity;
+            if (hugePage) {
+                _hugePageBytes += capacity;
+            }
+            _peak = std::max(_peak, _inUse + _cached);
+            buffer._pool = this;
+            buffer._data = data;
+            buffer._capacity = capacity;
+            buffer._hugePage = hugePage;
+            return buffer;
+        }
+
+        // Everything under the limit is borrowed: wait for a stage to give some back
+        if (waitMs <= 0 || std::chrono::steady_clock::now() >= deadline) {
+            _failures++;
+            qDebug() << "BufferPool: No room for" << capacity / 1024 << "KB,"
+                     << _inUse / (1024 * 1024) << "of" << _limit / (1024 * 1024) << "MB borrowed";
+            return buffer;
+        }
+        if (!waited) {
+            _waits++;
+            waited = true;
+        }
+        _returned.wait_until(lock, deadline);
+    }
+}
+
+bool BufferPool::_evictFor(size_t capacity)
+{
+    // Largest cached blocks first: fewest frees to make room
+    while (_inUse + _cached + capacity > _limit && !_cache.empty()) {
+        auto it = std::prev(_cache.end());
+        _free(it->second.back());
+        it->second.pop_back();
+        if (it->second.empty()) {
+            _cache.erase(it);
+        }
+    }
+    return _inUse + _cached + capacity <= _limit;
+}
+
+void BufferPool::_free(const Block& block)
+{
+    _deallocate(block.data, block.capacity, block.hugePage);
+    _cached -= block.capacity;
+    if (block.hugePage) {
+        _hugePageBytes -= block.capacity;
+    }
+}
+
+void BufferPool::_release(char* data, size_t capacity, bool hugePage)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _inUse -= capacity;
+        if (_limit > 0 && _inUse + _cached + capacity <= _limit) {
+            _cache[capacity].push_back(Block{data, capacity, hugePage});
+            _cached += capacity;
+        } else {
+            _deallocate(data, capacity, hugePage);
+            if (hugePage) {
+                _hugePageBytes -= capacity;
+            }
+        }
+    }
+    _returned.notify_all();
+}
+
+void BufferPool::setLimit(uint64_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _limit = bytes;
+        if (_limit == 0) {
+            // Unlimited pools do not cache
+            for (auto& entry : _cache) {
+                for (const Block& block : entry.second) {
+                    _free(block);
+                }
+            }
+            _cache.clear();
+        } else {
+            _evictFor(0);
+        }
+    }
+    qDebug() << "BufferPool: Limit set to" << bytes / (1024 * 1024) << "MB";
+    _returned.notify_all();
+}
+
+void BufferPool::trim()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& entry : _cache) {
+        for (const Block& block : entry.second) {
+            _free(block);
+        }
+    }
+    _cache.clear();
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return Stats{_limit, _inUse, _cached, _peak, _hugePageBytes, _reused, _waits, _failures};
+}
+
+char* BufferPool::_allocate(size_t capacity, size_t alignment, bool& hugePage)
+{
+    // Only whole huge pages, so the mapping is exactly the size class.
+    // Huge pages are aligned to far more than any I/O alignment.
+    const size_t page = hugePageSize();
+    if (page > 0 && capacity % page == 0) {
+        char* data = _allocateHugePages(capacity);
+        if (data) {
+            hugePage = true;
+            return data;
+        }
+    }
+    hugePage = false;
+    return static_cast<char*>(qMallocAligned(capacity, alignment));
+}
+
+void BufferPool::_deallocate(char* data, size_t capacity, bool hugePage)
+{
+    if (hugePage) {
+        _freeHugePages(data, capacity);
+    } else {
+        qFreeAligned(data);
+    }
+}
+
+char* BufferPool::_allocateHugePages(size_t size)
+{
+#ifdef Q_OS_LINUX
+    // Over-allocate so the buffer can start on a huge page boundary, then
+    // give back the unaligned head and the tail
+    const size_t page = hugePageSize();
+    void* raw = mmap(nullptr, size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+    const uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    const uintptr_t aligned = (start + page - 1) / page * page;
+    if (aligned > start) {
+        munmap(raw, aligned - start);
+    }
+    const size_t tail = start + page - aligned;
+    if (tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + size), tail);
+    }
+
+    // With THP in "always" mode this is implied; in "madvise" mode it is
+    // what enables it. Failure only means regular pages.
+    void* data = reinterpret_cast<void*>(aligned);
+    if (madvise(data, size, MADV_HUGEPAGE) != 0 && thpMode() != ThpMode::Always) {
+        munmap(data, size);
+        return nullptr;
+    }
+    return static_cast<char*>(data);
+#elif defined(Q_OS_WIN)
+    // Fails once physical memory is too fragmented for large pages
+    return static_cast<char*>(VirtualAlloc(nullptr, size,
+                                           MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+#else
+    Q_UNUSED(size);
+    return nullptr;
+#endif
+}
+
+void BufferPool::_freeHugePages(char* data, size_t size)
+{
+#ifdef Q_OS_LINUX
+    munmap(data, size);
+#elif defined(Q_OS_WIN)
+    Q_UNUSED(size);
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(size);
+#endif
+}
+
+QString BufferPool::hugePageSupport()
+{
+#ifdef Q_OS_LINUX
+    switch (thpMode()) {
+    case ThpMode::Always:
+        return QStringLiteral("transparent huge pages (always, %1 KB)").arg(hugePageSize() / 1024);
+    case ThpMode::Madvise:
+        return QStringLiteral("transparent huge pages (madvise, %1 KB)").arg(hugePageSize() / 1024);
+    case ThpMode::Never:
+        break;
+    }
+    return QStringLiteral("unavailable (transparent huge pages disabled)");
+#elif defined(Q_OS_WIN)
+    if (hugePageSize() == 0) {
+        return QStringLiteral("unavailable (no SeLockMemoryPrivilege)");
+    }
+    return QStringLiteral("large pages (%1 KB)").arg(hugePageSize() / 1024);
+#else
+    return QStringLiteral("unavailable on this platform");
+#endif
+}
@@ -0,0 +1,161 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <QString>
+
+/**
+ * @brief Process-wide pool of aligned buffers shared by the pipeline stages
+ *
+ * The ring buffers, verification read buffers and cache writer chunks all
+ * borrow their memory from here and give it back when done, so the sum
+ * over all stages stays under one limit instead of each stage sizing
+ * itself independently. Sizes are rounded up to size classes (steps of a
+ * quarter power of two, so at most 25% slack); returned buffers are kept
+ * for reuse by the next request of the same class and are freed when
+ * room is needed for another class or on trim().
+ *
+ * Buffers of at least one huge page are backed by huge pages where the
+ * system allows it (see hugePageSupport()), which cuts TLB misses while
+ * multi-megabyte slots are decompressed into, hashed and written.
+ *
+ * With no limit set the pool caches nothing and only hands out memory.
+ */
+class BufferPool
+{
+public:
+    /**
+     * @brief A borrowed buffer, returned to the pool when destroyed
+     */
+    class Buffer
+    {
+    public:
+        Buffer() = default;
+        Buffer(Buffer&& other) noexcept { *this = std::move(other); }
+        Buffer& operator=(Buffer&& other) noexcept;
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        ~Buffer() { release(); }
+
+        char* data() const { return _data; }
+        size_t capacity() const { return _capacity; }  // Size class, at least the requested size
+        bool isHugePage() const { return _hugePage; }
+        explicit operator bool() const { return _data != nullptr; }
+
+        /**
+         * @brief Give the buffer back to the pool before destruction
+         */
+        void release();
+
+    private:
+        friend class BufferPool;
+        BufferPool* _pool = nullptr;
+        char* _data = nullptr;
+        size_t _capacity = 0;
+        bool _hugePage = false;
+    };
+
+    struct Stats {
+        uint64_t limit;      // 0 = unlimited
+        uint64_t inUse;      // Bytes borrowed by callers
+        uint64_t cached;     // Bytes held for reuse
+        uint64_t peak;       // Highest inUse + cached
+        uint64_t hugePage;   // Part of inUse + cached on huge pages
+        uint64_t reused;     // Requests served from the cache
+        uint64_t waits;      // Requests that had to wait for a buffer to come back
+        uint64_t failures;   // Requests that could not be served
+    };
+
+    /**
+     * @brief The pool shared by the whole process
+     */
+    static BufferPool& instance();
+
+    /**
+     * @param limit Cap on borrowed plus cached bytes, 0 = unlimited
+     */
+    explicit BufferPool(uint64_t limit = 0);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /**
+     * @brief Borrow a buffer of at least size bytes
+     *
+     * If the limit would be exceeded, cached buffers of other classes are
+     * freed first; if that is not enough the call waits for another stage
+     * to return a buffer.
+     *
+     * @param size Minimum size in bytes
+     * @param alignment Required alignment (a power of two)
+     * @param waitMs How long to wait for memory under the limit (0 = don't wait)
+     * @return The buffer, or an empty one if the limit or the system ran out
+     */
+    Buffer acquire(size_t size, size_t alignment = 4096, int waitMs = 0);
+
+    /**
+     * @brief Change the limit; cached buffers above it are freed
+     */
+    void setLimit(uint64_t bytes);
+
+    /**
+     * @brief Free all cached buffers
+     */
+    void trim();
+
+    Stats stats() const;
+
+    /**
+     * @brief Size class a request of this size is rounded up to
+     */
+    static size_t sizeClass(size_t size);
+
+    /**
+     * @brief Describe huge page support on this system
+     *
+     * Transparent huge pages on Linux unless disabled system-wide, large
+     * pages on Windows when the process has SeLockMemoryPrivilege.
+     */
+    static QString hugePageSupport();
+
+private:
+    struct Block {
+        char* data;
+        size_t capacity;
+        bool hugePage;
+    };
+
+    mutable std::mutex _mutex;
+    std::condition_variable _returned;
+    std::map<size_t, std::vector<Block>> _cache;  // Size class -> returned blocks
+    uint64_t _limit;
+    uint64_t _inUse;
+    uint64_t _cached;
+    uint64_t _peak;
+    uint64_t _hugePageBytes;
+    uint64_t _reused;
+    uint64_t _waits;
+    uint64_t _failures;
+
+    void _release(char* data, size_t capacity, bool hugePage);
+    bool _evictFor(size_t capacity);  // Under _mutex
+    void _free(const Block& block);   // Under _mutex, adjusts _cached
+
+    static char* _allocate(size_t capacity, size_t alignment, bool& hugePage);
+    static void _deallocate(char* data, size_t capacity, bool hugePage);
+    static char* _allocateHugePages(size_t size);
+    static void _freeHugePages(char* data, size_t size);
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,173 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "cachecheckpoint.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+CacheCheckpoint::CacheCheckpoint()
+    : _chunkFill(0)
+{
+}
+
+CacheCheckpoint::~CacheCheckpoint() = default;
+
+void CacheCheckpoint::addData(const char *data, qint64 len)
+{
+    if (!_chunkHash)
+        _chunkHash = std::make_unique<AcceleratedCryptographicHash>(QCryptographicHash::Sha256);
+
+    qint64 pos = 0;
+    while (pos < len)
+    {
+        const qint64 n = std::min(len - pos, kChunkSize - _chunkFill);
+        _chunkHash->addData(data + pos, static_cast<int>(n));
+        _chunkFill += n;
+        pos += n;
+
+        if (_chunkFill == kChunkSize)
+        {
+            chunkHashes.append(_chunkHash->result().toHex());
+            _chunkHash->reset();
+            _chunkFill = 0;
+        }
+    }
+}
+
+void CacheCheckpoint::finishChunks()
+{
+    if (_chunkHash && _chunkFill > 0)
+    {
+        chunkHashes.append(_chunkHash->result().toHex());
+        _chunkHash->reset();
+        _chunkFill = 0;
+    }
+}
+
+QString CacheCheckpoint::sidecarPath(const QString &cacheFile)
+{
+    return cacheFile + ".chk";
+}
+
+void CacheCheckpoint::remove(const QString &cacheFile)
+{
+    const QString path = sidecarPath(cacheFile);
+    if (QFile::exists(path))
+        QFile::remove(path);
+}
+
+bool CacheCheckpoint::load(const QString &cacheFile)
+{
+    QFile file(sidecarPath(cacheFile));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root.value("version").toInt() != 1 || root.value("chunkSize").toInteger() != kChunkSize)
+        return false;
+
+    fileHash = root.value("sha256").toString().toLatin1();
+    _metadata.size = root.value("size").toInteger(-1);
+    _metadata.mtime = root.value("mtime").toInteger();
+    _metadata.inode = static_cast<quint64>(root.value("inode").toString().toULongLong());
+
+    chunkHashes.clear();
+    const QJsonArray chunks = root.value("chunks").toArray();
+    for (const QJsonValue &chunk : chunks)
+        chunkHashes.append(chunk.toString().toLatin1());
+
+    return !fileHash.isEmpty() && _metadata.size >= 0 && chunkHashes.size() == expectedChunkCount();
+}
+
+bool CacheCheckpoint::save(const QString &cacheFile)
+{
+    _metadata = _stat(cacheFile);
+    if (_metadata.size < 0 || chunkHashes.size() != expectedChunkCount())
+    {
+        qDebug() << "CacheCheckpoint: not saving inconsistent checkpoint for" << cacheFile;
+        return false;
+    }
+
+    QJsonArray chunks;
+    for (const QByteArray &hash : std::as_const(chunkHashes))
+        chunks.append(QString::fromLatin1(hash));
+
+    QJsonObject root;
+    root.insert("version", 1);
+    root.insert("sha256", QString::fromLatin1(fileHash));
+    root.insert("size", _metadata.size);
+    root.insert("mtime", _metadata.mtime);
+    // JSON numbers are doubles; keep all 64 bits of the inode
+    root.insert("inode", QString::number(_metadata.inode));
+    root.insert("chunkSize", kChunkSize);
+    root.insert("chunks", chunks);
+
+    QSaveFile file(sidecarPath(cacheFile));
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) < 0 ||
+        !file.commit())
+    {
+        qDebug() << "CacheCheckpoint: failed to write" << sidecarPath(cacheFile) << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool CacheCheckpoint::metadataMatches(const QString &cacheFile) const
+{
+    const FileMetadata current = _stat(cacheFile);
+    return current.size >= 0 &&
+           current.size == _metadata.size &&
+           current.mtime == _metadata.mtime &&
+           current.inode == _metadata.inode;
+}
+
+int CacheCheckpoint::expectedChunkCount() const
+{
+    return static_cast<int>((_metadata.size + kChunkSize - 1) / kChunkSize);
+}
+
+CacheCheckpoint::FileMetadata CacheCheckpoint::_stat(const QString &cacheFile)
+{
+    FileMetadata metadata;
+    QFileInfo fi(cacheFile);
+    if (!fi.exists())
+        return metadata;
+
+    metadata.size = fi.size();
+    metadata.mtime = fi.lastModified().toMSecsSinceEpoch();
+
+#ifdef Q_OS_WIN
+    HANDLE h = CreateFileW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(fi.absoluteFilePath()).utf16()), FILE_READ_ATTRIBUTES,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (h != INVALID_HANDLE_VALUE)
+    {
+        BY_HANDLE_FILE_INFORMATION info;
+        if (GetFileInformationByHandle(h, &info))
+            metadata.inode = (static_cast<quint64>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+        CloseHandle(h);
+    }
+#else
+    struct stat st;
+    if (::stat(QFile::encodeName(cacheFile).constData(), &st) == 0)
+        metadata.inode = static_cast<quint64>(st.st_ino);
+#endif
+
+    return metadata;
+}
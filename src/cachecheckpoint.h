@@ -0,0 +1,93 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef CACHECHECKPOINT_H
+#define CACHECHECKPOINT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <memory>
+#include "acceleratedcryptographichash.h"
+
+/**
+ * @brief Sidecar file describing a cache file's contents
+ *
+ * Records the SHA256 of the whole cache file, the SHA256 of each
+ * kChunkSize chunk and the file's size, modification time and inode
+ * (file index on Windows) at the time it was written.
+ *
+ * If the metadata still matches, the cache file has not been touched
+ * since it was verified and does not need to be hashed again. If it
+ * does not match (e.g. the file was copied or restored from backup),
+ * hashing a sample of chunks gives reasonable confidence without reading
+ * the whole file.
+ *
+ * Stored next to the cache file as "<file>.chk".
+ */
+class CacheCheckpoint
+{
+public:
+    static constexpr qint64 kChunkSize = 64 * 1024 * 1024;
+
+    CacheCheckpoint();
+    ~CacheCheckpoint();
+
+    /**
+     * @brief Feed the file contents, in order, to build chunkHashes
+     */
+    void addData(const char *data, qint64 len);
+
+    /**
+     * @brief Complete the trailing partial chunk after the last addData()
+     */
+    void finishChunks();
+
+    static QString sidecarPath(const QString &cacheFile);
+
+    /**
+     * @brief Remove the sidecar belonging to cacheFile, if any
+     */
+    static void remove(const QString &cacheFile);
+
+    /**
+     * @brief Read the sidecar of cacheFile
+     * @return false if there is none, or it is unreadable or inconsistent
+     */
+    bool load(const QString &cacheFile);
+
+    /**
+     * @brief Write the sidecar, recording the current metadata of cacheFile
+     */
+    bool save(const QString &cacheFile);
+
+    /**
+     * @brief Check whether cacheFile still has the recorded size, mtime and inode
+     */
+    bool metadataMatches(const QString &cacheFile) const;
+
+    /**
+     * @brief Number of chunks a file of the recorded size consists of
+     */
+    int expectedChunkCount() const;
+
+    QByteArray fileHash;            // Hex SHA256 of the whole file
+    QList<QByteArray> chunkHashes;  // Hex SHA256 of each chunk, in order
+
+private:
+    struct FileMetadata {
+        qint64 size = -1;
+        qint64 mtime = 0;     // Milliseconds since epoch
+        quint64 inode = 0;
+    };
+
+    static FileMetadata _stat(const QString &cacheFile);
+
+    FileMetadata _metadata;
+    std::unique_ptr<AcceleratedCryptographicHash> _chunkHash;
+    qint64 _chunkFill;
+};
+
+#endif // CACHECHECKPOINT_H
@@ -12,9 +12,20 @@
 #include <QDebug>
 #include <QCoreApplication>
 #include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QRandomGenerator>
+#include <QSet>
+#include <algorithm>
 #include <functional>
 #include "systemmemorymanager.h"
 #include "config.h"
+#include "cachecheckpoint.h"
+#include "imagechunkstore.h"
 
 // Hash algorithm used for cache verification (use same as OS list verification)
 #define CACHE_HASH_ALGORITHM OSLIST_HASH_ALGORITHM
@@ -24,6 +35,11 @@ CacheManager::CacheManager(QObject *parent)
     , workerThread_(new QThread())  // Don't parent to avoid Qt's automatic deletion
     , worker_(new CacheVerificationWorker())
     , cachingEnabled_(!::isEmbeddedMode())
+    , imageCacheEnabled_(false)
+    , chunkStoreEnabled_(true)
+    , chunkStoreVersions_(IMAGEWRITER_CHUNK_STORE_VERSIONS)
+    , cacheSizeBudget_(IMAGEWRITER_CACHE_SIZE_BUDGET)
+    , fullVerification_(false)
 {
     // Move worker to background thread
     worker_->moveToThread(workerThread_);
@@ -35,6 +51,8 @@ CacheManager::CacheManager(QObject *parent)
             this, &CacheManager::onDiskSpaceCheckComplete);
     connect(worker_, &CacheVerificationWorker::verificationProgress,
             this, &CacheManager::cacheVerificationProgress);
+    connect(worker_, &CacheVerificationWorker::imageChunked,
+            this, &CacheManager::onImageChunked);
     
     // Start worker thread
     workerThread_->start();
@@ -53,7 +71,9 @@ CacheManager::~CacheManager()
     disconnect(worker_, nullptr, this, nullptr);
     
     if (workerThread_ && workerThread_->isRunning()) {
-        // Request thread to quit gracefully
+        // Request thread to quit gracefully; a long running chunk store
+        // update gives up at the next read
+        workerThread_->requestInterruption();
         workerThread_->quit();
         
         // Wait for thread to finish
@@ -86,6 +106,16 @@ void CacheManager::startBackgroundOperations()
     // Initialize cache directory and start disk space checking
     QMetaObject::invokeMethod(worker_, "checkDiskSpace", Qt::QueuedConnection);
     
+    // A decompressed image that had not made it into the chunk store
+    // before the application quit
+    if (chunkStoreEnabled_ && !status_.imageCacheFileName.isEmpty()) {
+        QMetaObject::invokeMethod(worker_, "addImageToChunkStore", Qt::QueuedConnection,
+                                  Q_ARG(QString, getChunkStoreDirectory()),
+                                  Q_ARG(QString, status_.imageCacheFileName),
+                                  Q_ARG(QByteArray, status_.imageCacheHash),
+                                  Q_ARG(int, chunkStoreVersions_));
+    }
+
     // Start verification if we have cached file info
     if (!status_.cachedHash.isEmpty() && !status_.cacheFileName.isEmpty()) {
         qDebug() << "Found cached file info, starting background verification:" << status_.cacheFileName;
@@ -108,16 +138,26 @@ bool CacheManager::isReady() const
 bool CacheManager::isCached(const QByteArray& expectedHash) const
 {
     QMutexLocker locker(&mutex_);
-    bool result = !expectedHash.isEmpty() && 
-                  status_.cachedHash == expectedHash && 
-                  !status_.cacheFileName.isEmpty() &&
-                  QFile::exists(status_.cacheFileName) &&
-                  status_.verificationComplete &&
-                  status_.isValid;
-    
-    // Debug output removed - cache system working correctly
-    
-    return result;
+    if (expectedHash.isEmpty()) {
+        return false;
+    }
+
+    if (status_.imageCacheHash == expectedHash && QFile::exists(status_.imageCacheFileName)) {
+        return true;
+    }
+
+    if (status_.customCacheFile) {
+        return status_.cachedHash == expectedHash &&
+               QFile::exists(status_.cacheFileName) &&
+               status_.verificationComplete &&
+               status_.isValid;
+    }
+
+    // Index lookup only; entries are checked against their hash before use
+    if (status_.cachedHash == expectedHash && status_.verificationComplete && !status_.isValid) {
+        return false;
+    }
+    return entries_.contains(expectedHash);
 }
 
 bool CacheManager::hasPotentialCache(const QByteArray& expectedHash) const
@@ -125,16 +165,28 @@ bool CacheManager::hasPotentialCache(const QByteArray& expectedHash) const
     QMutexLocker locker(&mutex_);
     // Check if we have a potential cache match (hash matches, file exists)
     // Does NOT require verification to be complete - used to decide whether to start verification
-    bool result = !expectedHash.isEmpty() && 
-                  status_.cachedHash == expectedHash && 
-                  !status_.cacheFileName.isEmpty() &&
-                  QFile::exists(status_.cacheFileName);
+    bool result = false;
+    QString fileName;
+    if (expectedHash.isEmpty()) {
+        result = false;
+    } else if (status_.customCacheFile) {
+        result = status_.cachedHash == expectedHash &&
+                 !status_.cacheFileName.isEmpty() &&
+                 QFile::exists(status_.cacheFileName);
+        fileName = status_.cacheFileName;
+    } else {
+        auto it = entries_.constFind(expectedHash);
+        if (it != entries_.constEnd()) {
+            fileName = QDir(getCacheDirectory()).absoluteFilePath(it->fileName);
+            result = QFile::exists(fileName);
+        }
+    }
     
     if (result) {
         qDebug() << "Potential cache found for hash:" << expectedHash 
-                 << "file:" << status_.cacheFileName
-                 << "verified:" << status_.verificationComplete
-                 << "valid:" << status_.isValid;
+                 << "file:" << fileName
+                 << "verified:" << (status_.cachedHash == expectedHash && status_.verificationComplete)
+                 << "valid:" << (status_.cachedHash == expectedHash && status_.isValid);
     }
     
     return result;
@@ -149,8 +201,11 @@ QString CacheManager::getCacheFilePath(const QByteArray& expectedHash) const
         return (status_.cachedHash == expectedHash) ? status_.cacheFileName : QString();
     }
     
-    // Return default cache file path
-    return getDefaultCacheFilePath();
+    auto it = entries_.constFind(expectedHash);
+    if (it != entries_.constEnd()) {
+        return QDir(getCacheDirectory()).absoluteFilePath(it->fileName);
+    }
+    return getCacheEntryPath(expectedHash);
 }
 
 void CacheManager::setCustomCacheFile(const QString& cacheFile, const QByteArray& sha256)
@@ -173,10 +228,12 @@ void CacheManager::invalidateCache()
     qDebug() << "Invalidating cache";
     
     QString cacheFileName;
+    QByteArray cachedHash;
     bool customCache = false;
     
     updateCacheStatus([&](CacheStatus& status) {
         cacheFileName = status.cacheFileName;
+        cachedHash = status.cachedHash;
         customCache = status.customCacheFile;
         
         // Clear cache status
@@ -189,18 +246,16 @@ void CacheManager::invalidateCache()
         }
     });
     
-    // Clear settings (but not for custom cache files)
-    if (!customCache) {
-        settings_.beginGroup("caching");
-        settings_.remove("lastDownloadSHA256");
-        settings_.remove("lastCacheFileHash");
-        settings_.remove("lastFileName");
-        settings_.endGroup();
-        settings_.sync();
+    // Drop the entry from the index (but not for custom cache files)
+    if (!customCache && !cachedHash.isEmpty()) {
+        QMutexLocker locker(&mutex_);
+        removeCacheEntry(cachedHash);
+        saveCacheIndex();
     }
     
     // Try to remove the cache file
     if (!cacheFileName.isEmpty() && QFile::exists(cacheFileName)) {
+        CacheCheckpoint::remove(cacheFileName);
         if (QFile::remove(cacheFileName)) {
             qDebug() << "Successfully removed corrupted cache file:" << cacheFileName;
         } else {
@@ -225,19 +280,110 @@ void CacheManager::updateCacheFile(const QByteArray& uncompressedHash, const QBy
         cacheFileName = status.cacheFileName;
     });
     
-    // Save settings (but not for custom cache files)
-    if (!customCache) {
-        settings_.beginGroup("caching");
-        settings_.setValue("lastDownloadSHA256", uncompressedHash);   // Store uncompressed hash for UI matching
-        settings_.setValue("lastCacheFileHash", compressedHash);      // Store compressed hash for verification
-        settings_.setValue("lastFileName", cacheFileName);
-        settings_.endGroup();
-        settings_.sync();
+    // Add to the index (but not for custom cache files)
+    if (!customCache && !cacheFileName.isEmpty()) {
+        CacheEntry entry;
+        entry.fileName = QDir(getCacheDirectory()).relativeFilePath(cacheFileName);
+        entry.cacheFileHash = compressedHash;
+        entry.size = QFileInfo(cacheFileName).size();
+        entry.lastUsed = QDateTime::currentMSecsSinceEpoch();
+        
+        QMutexLocker locker(&mutex_);
+        entries_.insert(uncompressedHash, entry);
+        saveCacheIndex();
+        qDebug() << "Cache now holds" << entries_.size() << "images," << cachedBytes() << "bytes";
     }
     
     emit cacheFileUpdated(uncompressedHash); // UI matches against uncompressed hash
 }
 
+void CacheManager::touchCacheEntry(const QByteArray& expectedHash)
+{
+    QMutexLocker locker(&mutex_);
+    auto it = entries_.find(expectedHash);
+    if (it != entries_.end()) {
+        it->lastUsed = QDateTime::currentMSecsSinceEpoch();
+        saveCacheIndex();
+    }
+}
+
+QString CacheManager::completedCacheFilePath(const QByteArray& expectedHash) const
+{
+    // A download in progress has no entry until updateCacheFile()
+    QMutexLocker locker(&mutex_);
+    auto it = entries_.constFind(expectedHash);
+    if (it == entries_.constEnd()) {
+        return QString();
+    }
+    return QDir(getCacheDirectory()).absoluteFilePath(it->fileName);
+}
+
+QString CacheManager::prefetchFilePath(const QByteArray& expectedHash, qint64 downloadSize) const
+{
+    QMutexLocker locker(&mutex_);
+    if (!cachingEnabled_ || status_.customCacheFile || !status_.diskSpaceCheckComplete ||
+        expectedHash.isEmpty() || downloadSize < 0 || entries_.contains(expectedHash)) {
+        return QString();
+    }
+    
+    // The download may never be written, so it must not push anything out
+    if (qMax<qint64>(downloadSize, 1) > prefetchHeadroomLocked()) {
+        return QString();
+    }
+    
+    QDir dir(getCacheDirectory());
+    if (!dir.exists() && !dir.mkpath(".")) {
+        return QString();
+    }
+    return dir.absoluteFilePath(QString::fromLatin1(expectedHash) + ".prefetch");
+}
+
+bool CacheManager::addPrefetchedFile(const QString& fileName, const QByteArray& uncompressedHash, const QByteArray& compressedHash)
+{
+    {
+        QMutexLocker locker(&mutex_);
+        const QString cacheFilePath = getCacheEntryPath(uncompressedHash);
+        const qint64 size = QFileInfo(fileName).size();
+        
+        // A write of the same image may have cached it in the meantime, and
+        // other images may have been cached since the prefetch started
+        qint64 availableBytes = status_.availableBytes;
+        if (!cachingEnabled_ || status_.customCacheFile || entries_.contains(uncompressedHash) ||
+            !evictCacheEntries(size, availableBytes)) {
+            saveCacheIndex();
+            CacheCheckpoint::remove(fileName);
+            QFile::remove(fileName);
+            return false;
+        }
+        status_.availableBytes = availableBytes;
+        
+        // The checkpoint stays valid: renaming keeps the size, mtime and inode
+        CacheCheckpoint::remove(cacheFilePath);
+        QFile::remove(cacheFilePath);
+        if (!QFile::rename(fileName, cacheFilePath) ||
+            !QFile::rename(CacheCheckpoint::sidecarPath(fileName), CacheCheckpoint::sidecarPath(cacheFilePath))) {
+            qDebug() << "Failed to move prefetched file into the cache:" << fileName;
+            CacheCheckpoint::remove(fileName);
+            QFile::remove(fileName);
+            QFile::remove(cacheFilePath);
+            saveCacheIndex();
+            return false;
+        }
+        
+        CacheEntry entry;
+        entry.fileName = QDir(getCacheDirectory()).relativeFilePath(cacheFilePath);
+        entry.cacheFileHash = compressedHash;
+        entry.size = size;
+        entry.lastUsed = QDateTime::currentMSecsSinceEpoch();
+        entries_.insert(uncompressedHash, entry);
+        saveCacheIndex();
+        qDebug() << "Prefetched image added to the cache:" << entry.fileName;
+    }
+    
+    emit cacheFileUpdated(uncompressedHash);
+    return true;
+}
+
 void CacheManager::startVerification(const QByteArray& expectedHash)
 {
     QString cacheFileName;
@@ -247,12 +393,18 @@ void CacheManager::startVerification(const QByteArray& expectedHash)
         if (status.customCacheFile) {
             cacheFileName = status.cacheFileName;
             hashToVerify = expectedHash; // For custom cache files, verify against expected hash
+            status.cacheFileHash.clear();
         } else {
-            // Use the stored cache file path if available (loaded from settings),
-            // otherwise use the default path. This ensures we verify the actual
-            // cache file that exists, not a path that might differ due to app name changes.
-            cacheFileName = status.cacheFileName.isEmpty() ? getDefaultCacheFilePath() : status.cacheFileName;
-            // For regular cache files, verify against the stored compressed hash (cache file contains compressed data)
+            // Verify the entry recorded in the index for this image. Cache
+            // files contain compressed data, so check against the compressed hash.
+            auto it = entries_.constFind(expectedHash);
+            if (it != entries_.constEnd()) {
+                cacheFileName = QDir(getCacheDirectory()).absoluteFilePath(it->fileName);
+                status.cacheFileHash = it->cacheFileHash;
+            } else {
+                cacheFileName = getCacheEntryPath(expectedHash);
+                status.cacheFileHash.clear();
+            }
             hashToVerify = status.cacheFileHash.isEmpty() ? expectedHash : status.cacheFileHash;
         }
         
@@ -264,7 +416,8 @@ void CacheManager::startVerification(const QByteArray& expectedHash)
     
     // Start verification on background thread
     QMetaObject::invokeMethod(worker_, "verifyCacheFile", Qt::QueuedConnection,
-                              Q_ARG(QString, cacheFileName), Q_ARG(QByteArray, hashToVerify));
+                              Q_ARG(QString, cacheFileName), Q_ARG(QByteArray, hashToVerify),
+                              Q_ARG(bool, fullVerification_));
 }
 
 bool CacheManager::setupCacheForDownload(const QByteArray& expectedHash, qint64 downloadSize, QString& cacheFilePath)
@@ -275,39 +428,291 @@ bool CacheManager::setupCacheForDownload(const QByteArray& expectedHash, qint64
         return false;
     }
     
-    // Check if we have different hash than expected - need to clear old cache
-    if (!status_.cachedHash.isEmpty() && status_.cachedHash != expectedHash) {
-        locker.unlock();
-        invalidateCache();
-        locker.relock();
+    // Set up cache file path
+    if (status_.customCacheFile) {
+        // Check if we have different hash than expected - need to clear old cache
+        if (!status_.cachedHash.isEmpty() && status_.cachedHash != expectedHash) {
+            locker.unlock();
+            invalidateCache();
+            locker.relock();
+        }
+        cacheFilePath = status_.cacheFileName;
+    } else {
+        cacheFilePath = getCacheEntryPath(expectedHash);
     }
     
-    // Check disk space
-    if (!status_.diskSpaceCheckComplete || !status_.hasAvailableSpace) {
+    // Check disk space; evicting older entries may make enough room
+    if (!status_.diskSpaceCheckComplete) {
         return false;
     }
     
-    if (status_.availableBytes - downloadSize < IMAGEWRITER_MINIMAL_SPACE_FOR_CACHING) {
+    // A stale entry for this image is about to be overwritten
+    removeCacheEntry(expectedHash);
+    
+    qint64 availableBytes = status_.availableBytes;
+    if (!evictCacheEntries(downloadSize, availableBytes)) {
+        saveCacheIndex();
         return false;
     }
+    status_.availableBytes = availableBytes;
+    saveCacheIndex();
     
-    // Set up cache file path
-    if (status_.customCacheFile) {
-        cacheFilePath = status_.cacheFileName;
-    } else {
-        cacheFilePath = getDefaultCacheFilePath();
+    if (!status_.customCacheFile) {
+        QDir dir(getCacheDirectory());
+        if (!dir.exists() && !dir.mkpath(".")) {
+            return false;
+        }
+        // The status now describes the download in progress; updateCacheFile()
+        // fills in the hashes once it has been verified
         status_.cacheFileName = cacheFilePath;
+        status_.cachedHash.clear();
+        status_.cacheFileHash.clear();
+        status_.isValid = false;
+        status_.verificationComplete = false;
+    }
+    
+    return true;
+}
+
+bool CacheManager::evictCacheEntries(qint64 bytesNeeded, qint64& availableBytes)
+{
+    auto fits = [&]() {
+        return cachedBytes() + bytesNeeded <= cacheSizeBudget_ &&
+               availableBytes - bytesNeeded >= IMAGEWRITER_MINIMAL_SPACE_FOR_CACHING;
+    };
+    
+    if (bytesNeeded > cacheSizeBudget_) {
+        qDebug() << "Download of" << bytesNeeded << "bytes exceeds cache budget of" << cacheSizeBudget_;
+        return false;
+    }
+    
+    while (!fits() && !entries_.isEmpty()) {
+        auto lru = std::min_element(entries_.constBegin(), entries_.constEnd(),
+                                    [](const CacheEntry& a, const CacheEntry& b) { return a.lastUsed < b.lastUsed; });
+        const QByteArray hash = lru.key();
+        const qint64 size = lru->size;
+        qDebug() << "Evicting least recently used cache entry" << lru->fileName << "(" << size << "bytes)";
+        removeCacheEntry(hash);
+        availableBytes += size;
+    }
+    
+    return fits();
+}
+
+void CacheManager::removeCacheEntry(const QByteArray& uncompressedHash)
+{
+    auto it = entries_.find(uncompressedHash);
+    if (it == entries_.end()) {
+        return;
+    }
+    
+    const QString fileName = QDir(getCacheDirectory()).absoluteFilePath(it->fileName);
+    entries_.erase(it);
+    CacheCheckpoint::remove(fileName);
+    if (QFile::exists(fileName) && !QFile::remove(fileName)) {
+        qDebug() << "Failed to remove cache file:" << fileName;
     }
     
+    if (status_.cachedHash == uncompressedHash && !status_.customCacheFile) {
+        status_.cachedHash.clear();
+        status_.cacheFileHash.clear();
+        status_.cacheFileName.clear();
+        status_.isValid = false;
+        status_.verificationComplete = false;
+    }
+}
+
+qint64 CacheManager::prefetchHeadroom() const
+{
+    QMutexLocker locker(&mutex_);
+    return prefetchHeadroomLocked();
+}
+
+qint64 CacheManager::prefetchHeadroomLocked() const
+{
+    return qMin(cacheSizeBudget_ - cachedBytes(),
+                status_.availableBytes - static_cast<qint64>(IMAGEWRITER_MINIMAL_SPACE_FOR_CACHING));
+}
+
+qint64 CacheManager::cachedBytes() const
+{
+    qint64 total = 0;
+    for (const CacheEntry& entry : entries_) {
+        total += entry.size;
+    }
+    return total;
+}
+
+bool CacheManager::isImageCacheEnabled() const
+{
+    return cachingEnabled_ && imageCacheEnabled_;
+}
+
+void CacheManager::setImageCacheEnabled(bool enabled)
+{
+    imageCacheEnabled_ = enabled;
+
+    settings_.beginGroup("caching");
+    settings_.setValue("imageCacheEnabled", enabled);
+    settings_.endGroup();
+    settings_.sync();
+
+    if (!enabled) {
+        invalidateImageCache();
+        QMetaObject::invokeMethod(worker_, "clearChunkStore", Qt::QueuedConnection,
+                                  Q_ARG(QString, getChunkStoreDirectory()));
+    }
+}
+
+QString CacheManager::getImageCacheFilePath(const QByteArray& expectedHash) const
+{
+    QMutexLocker locker(&mutex_);
+
+    if (!cachingEnabled_ || expectedHash.isEmpty() || status_.imageCacheHash != expectedHash) {
+        return QString();
+    }
+
+    // The image may have been evicted or removed behind our back
+    return QFile::exists(status_.imageCacheFileName) ? status_.imageCacheFileName : QString();
+}
+
+bool CacheManager::setupImageCacheForWrite(const QByteArray& expectedHash, qint64 imageSize, QString& imageCacheFilePath)
+{
+    if (!isImageCacheEnabled() || expectedHash.isEmpty() || imageSize <= 0) {
+        return false;
+    }
+
+    QMutexLocker locker(&mutex_);
+
+    if (!status_.diskSpaceCheckComplete) {
+        return false;
+    }
+
+    // Only one decompressed image is kept, so the one it replaces counts
+    // as free space. Sparse files usually need far less than imageSize,
+    // but the worst case has to fit.
+    qint64 availableBytes = status_.availableBytes;
+    QString previousFile = status_.imageCacheFileName;
+    if (!previousFile.isEmpty() && status_.imageCacheHash != expectedHash) {
+        availableBytes += QFileInfo(previousFile).size();
+    }
+
+    if (availableBytes - imageSize < IMAGEWRITER_MINIMAL_SPACE_FOR_CACHING) {
+        qDebug() << "Not enough space to cache decompressed image of" << imageSize << "bytes";
+        return false;
+    }
+
+    QDir dir(getImageCacheDirectory());
+    if (!dir.exists() && !dir.mkpath(".")) {
+        return false;
+    }
+
+    locker.unlock();
+    invalidateImageCache();
+
+    imageCacheFilePath = dir.filePath(QString::fromLatin1(expectedHash) + ".img");
     return true;
 }
 
+void CacheManager::updateImageCacheFile(const QByteArray& uncompressedHash, const QString& imageCacheFilePath)
+{
+    updateCacheStatus([&](CacheStatus& status) {
+        status.imageCacheFileName = imageCacheFilePath;
+        status.imageCacheHash = uncompressedHash;
+    });
+
+    settings_.beginGroup("caching");
+    settings_.setValue("imageCacheFileName", imageCacheFilePath);
+    settings_.setValue("imageCacheSHA256", uncompressedHash);
+    settings_.endGroup();
+    settings_.sync();
+
+    qDebug() << "Decompressed image cache updated:" << imageCacheFilePath;
+    emit cacheFileUpdated(uncompressedHash);
+
+    if (chunkStoreEnabled_) {
+        QMetaObject::invokeMethod(worker_, "addImageToChunkStore", Qt::QueuedConnection,
+                                  Q_ARG(QString, getChunkStoreDirectory()),
+                                  Q_ARG(QString, imageCacheFilePath),
+                                  Q_ARG(QByteArray, uncompressedHash),
+                                  Q_ARG(int, chunkStoreVersions_));
+    }
+}
+
+void CacheManager::onImageChunked(const QByteArray& imageHash, const QString& imagePath, bool ok)
+{
+    if (!ok) {
+        qDebug() << "Could not add decompressed image to the chunk store, keeping" << imagePath;
+        return;
+    }
+
+    // The chunk store now holds the image, so the whole copy can go, unless
+    // it has been replaced in the meantime
+    bool current = false;
+    {
+        QMutexLocker locker(&mutex_);
+        current = status_.imageCacheHash == imageHash && status_.imageCacheFileName == imagePath;
+    }
+    if (current) {
+        invalidateImageCache();
+    }
+}
+
+QString CacheManager::getChunkedImageRecipe(const QByteArray& expectedHash)
+{
+    if (!isImageCacheEnabled() || !chunkStoreEnabled_ || expectedHash.isEmpty()) {
+        return QString();
+    }
+
+    ImageChunkStore store(getChunkStoreDirectory());
+    if (!store.contains(expectedHash)) {
+        return QString();
+    }
+    store.touch(expectedHash);
+    return store.recipePath(expectedHash);
+}
+
+void CacheManager::invalidateChunkedImage(const QByteArray& expectedHash)
+{
+    // Its chunks are collected the next time the store is pruned
+    ImageChunkStore(getChunkStoreDirectory()).remove(expectedHash);
+    qDebug() << "Removed chunked decompressed image" << expectedHash;
+}
+
+void CacheManager::invalidateImageCache()
+{
+    QString imageCacheFileName;
+
+    updateCacheStatus([&](CacheStatus& status) {
+        imageCacheFileName = status.imageCacheFileName;
+        status.imageCacheFileName.clear();
+        status.imageCacheHash.clear();
+    });
+
+    settings_.beginGroup("caching");
+    settings_.remove("imageCacheFileName");
+    settings_.remove("imageCacheSHA256");
+    settings_.endGroup();
+    settings_.sync();
+
+    if (!imageCacheFileName.isEmpty() && QFile::exists(imageCacheFileName)) {
+        QFile::remove(imageCacheFileName);
+        qDebug() << "Removed decompressed image cache file:" << imageCacheFileName;
+    }
+}
+
 void CacheManager::onVerificationComplete(bool isValid, const QString& fileName, const QByteArray& expectedHash, const QByteArray& computedHash)
 {
     Q_UNUSED(expectedHash);  // Already stored in status.cacheFileHash
     QByteArray uncompressedHashForUI;
+    bool stale = false;
     
     updateCacheStatus([&](CacheStatus& status) {
+        // A verification of another entry was queued after this one
+        if (status.cacheFileName != fileName) {
+            stale = true;
+            return;
+        }
         status.isValid = isValid;
         status.verificationComplete = true;
         status.cacheFileName = fileName;
@@ -317,6 +722,11 @@ void CacheManager::onVerificationComplete(bool isValid, const QString& fileName,
         uncompressedHashForUI = status.cachedHash; // Get the uncompressed hash for UI update
     });
     
+    if (stale) {
+        qDebug() << "Ignoring stale cache verification result for" << fileName;
+        return;
+    }
+    
     qDebug() << "Cache verification:" << (isValid ? "valid" : "invalid") << fileName
              << "expected:" << expectedHash << "computed:" << computedHash;
     
@@ -340,6 +750,11 @@ void CacheManager::onDiskSpaceCheckComplete(qint64 availableBytes, const QString
         status.hasAvailableSpace = availableBytes > IMAGEWRITER_MINIMAL_SPACE_FOR_CACHING;
         status.cacheDirectory = directory;
         status.diskSpaceCheckComplete = true;
+        // The worker may have evicted the decompressed image to free space
+        if (!status.imageCacheFileName.isEmpty() && !QFile::exists(status.imageCacheFileName)) {
+            status.imageCacheFileName.clear();
+            status.imageCacheHash.clear();
+        }
     });
     
     emit diskSpaceCheckComplete(availableBytes);
@@ -363,62 +778,232 @@ void CacheManager::loadCacheSettings()
     if (cachingEnabled_) {
         cachingEnabled_ = settings_.value("enabled", IMAGEWRITER_ENABLE_CACHE_DEFAULT).toBool();
     }
+    cacheSizeBudget_ = settings_.value("maxCacheSize", IMAGEWRITER_CACHE_SIZE_BUDGET).toLongLong();
+    // Opt-in: always rehash whole cache files rather than trusting checkpoints
+    fullVerification_ = settings_.value("fullVerification", false).toBool();
     
-    // Load cached file info
+    // Single cache file used by older versions
     QString lastFileName = settings_.value("lastFileName").toString();
     QByteArray lastHash = settings_.value("lastDownloadSHA256").toByteArray();
     QByteArray cacheFileHash = settings_.value("lastCacheFileHash").toByteArray();
+
+    imageCacheEnabled_ = settings_.value("imageCacheEnabled", false).toBool();
+    chunkStoreEnabled_ = settings_.value("imageChunkStore", true).toBool();
+    chunkStoreVersions_ = settings_.value("imageChunkVersions", IMAGEWRITER_CHUNK_STORE_VERSIONS).toInt();
+    QString imageCacheFileName = settings_.value("imageCacheFileName").toString();
+    QByteArray imageCacheHash = settings_.value("imageCacheSHA256").toByteArray();
     
     settings_.endGroup();
+
+    // The image is re-verified against the expected hash on every write from
+    // it, so only check that it is still there
+    if (imageCacheEnabled_ && !imageCacheFileName.isEmpty() && !imageCacheHash.isEmpty() &&
+        QFileInfo(imageCacheFileName).isReadable()) {
+        updateCacheStatus([&](CacheStatus& status) {
+            status.imageCacheFileName = imageCacheFileName;
+            status.imageCacheHash = imageCacheHash;
+        });
+    } else if (!imageCacheFileName.isEmpty()) {
+        invalidateImageCache();
+    }
     
-    // Validate cache file exists and is accessible
-    if (!lastFileName.isEmpty() && !lastHash.isEmpty()) {
-        QFileInfo fileInfo(lastFileName);
-        if (fileInfo.exists() && fileInfo.isReadable() && fileInfo.size() > 0) {
-            // Test file accessibility
-            QFile testFile(lastFileName);
-            if (testFile.open(QIODevice::ReadOnly)) {
-                testFile.close();
-                
-                updateCacheStatus([&](CacheStatus& status) {
-                    status.cacheFileName = lastFileName;
-                    status.cachedHash = lastHash;        // Uncompressed hash for UI queries
-                    status.cacheFileHash = cacheFileHash; // Compressed hash for cache verification
-                    status.customCacheFile = false;
-                    status.verificationComplete = false;
-                });
-            } else {
-                qDebug() << "Cache file cannot be opened, clearing settings";
-                invalidateCache();
+    loadCacheIndex();
+    
+    if (!lastFileName.isEmpty()) {
+        migrateLegacyCacheFile(lastFileName, lastHash, cacheFileHash);
+    }
+    
+    // Verify the most recently used entry in the background, as the old
+    // single-file cache did, so that writing it again does not have to wait
+    QMutexLocker locker(&mutex_);
+    auto mru = std::max_element(entries_.constBegin(), entries_.constEnd(),
+                                [](const CacheEntry& a, const CacheEntry& b) { return a.lastUsed < b.lastUsed; });
+    if (mru != entries_.constEnd()) {
+        status_.cacheFileName = QDir(getCacheDirectory()).absoluteFilePath(mru->fileName);
+        status_.cachedHash = mru.key();            // Uncompressed hash for UI queries
+        status_.cacheFileHash = mru->cacheFileHash; // Compressed hash for cache verification
+        status_.customCacheFile = false;
+        status_.verificationComplete = false;
+    }
+}
+
+/*
+ * Read the index, dropping entries whose file has gone or changed size
+ * (e.g. the cache directory was cleaned by the OS). Files that are not
+ * in the index are left over from interrupted downloads and are removed.
+ */
+void CacheManager::loadCacheIndex()
+{
+    QMutexLocker locker(&mutex_);
+    entries_.clear();
+    if (!cachingEnabled_) {
+        return;
+    }
+    
+    QDir dir(getCacheDirectory());
+    bool dirty = false;
+    
+    QFile indexFile(getCacheIndexPath());
+    if (indexFile.open(QIODevice::ReadOnly)) {
+        const QJsonObject root = QJsonDocument::fromJson(indexFile.readAll()).object();
+        const QJsonArray items = root.value("entries").toArray();
+        for (const QJsonValue& item : items) {
+            const QJsonObject obj = item.toObject();
+            const QByteArray hash = obj.value("sha256").toString().toLatin1();
+            CacheEntry entry;
+            entry.fileName = obj.value("file").toString();
+            entry.cacheFileHash = obj.value("cacheFileHash").toString().toLatin1();
+            entry.size = obj.value("size").toInteger();
+            entry.lastUsed = obj.value("lastUsed").toInteger();
+            
+            QFileInfo fi(dir.absoluteFilePath(entry.fileName));
+            if (hash.isEmpty() || entry.fileName.isEmpty() || !fi.isReadable() || fi.size() != entry.size) {
+                qDebug() << "Dropping stale cache index entry:" << entry.fileName;
+                dirty = true;
+                continue;
             }
-        } else {
-            qDebug() << "Cache file missing or unreadable, clearing settings";
-            invalidateCache();
+            entries_.insert(hash, entry);
+        }
+    }
+    
+    QSet<QString> indexed;
+    for (const CacheEntry& entry : std::as_const(entries_)) {
+        indexed.insert(QFileInfo(dir.absoluteFilePath(entry.fileName)).fileName());
+    }
+    const QStringList files = dir.entryList(QStringList() << "*.cache" << "*.cache.chk" << "*.prefetch" << "*.prefetch.chk", QDir::Files);
+    for (const QString& file : files) {
+        if (!indexed.contains(file.endsWith(".chk") ? file.chopped(4) : file)) {
+            qDebug() << "Removing unindexed cache file:" << file;
+            QFile::remove(dir.absoluteFilePath(file));
         }
     }
+    
+    if (dirty) {
+        saveCacheIndex();
+    }
+    
+    qDebug() << "Cache index:" << entries_.size() << "images," << cachedBytes() << "bytes, budget" << cacheSizeBudget_;
 }
 
-void CacheManager::saveCacheSettings()
+void CacheManager::saveCacheIndex()
+{
+    if (!cachingEnabled_) {
+        return;
+    }
+    
+    QJsonArray items;
+    for (auto it = entries_.constBegin(); it != entries_.constEnd(); ++it) {
+        QJsonObject obj;
+        obj.insert("sha256", QString::fromLatin1(it.key()));
+        obj.insert("file", it->fileName);
+        obj.insert("cacheFileHash", QString::fromLatin1(it->cacheFileHash));
+        obj.insert("size", it->size);
+        obj.insert("lastUsed", it->lastUsed);
+        items.append(obj);
+    }
+    QJsonObject root;
+    root.insert("version", 1);
+    root.insert("entries", items);
+    
+    QDir dir(getCacheDirectory());
+    if (!dir.exists() && !dir.mkpath(".")) {
+        return;
+    }
+    
+    // Write to a temporary file and rename, so the index is never half-written
+    QSaveFile indexFile(getCacheIndexPath());
+    if (!indexFile.open(QIODevice::WriteOnly) ||
+        indexFile.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) < 0 ||
+        !indexFile.commit()) {
+        qDebug() << "Failed to write cache index:" << indexFile.errorString();
+    }
+}
+
+/*
+ * Move the single cache file of older versions into the cache directory,
+ * so it survives as the first indexed entry.
+ */
+void CacheManager::migrateLegacyCacheFile(const QString& fileName, const QByteArray& uncompressedHash, const QByteArray& compressedHash)
 {
+    settings_.beginGroup("caching");
+    settings_.remove("lastDownloadSHA256");
+    settings_.remove("lastCacheFileHash");
+    settings_.remove("lastFileName");
+    settings_.endGroup();
+    settings_.sync();
+    
+    QFileInfo fileInfo(fileName);
+    if (uncompressedHash.isEmpty() || !fileInfo.isReadable() || fileInfo.size() == 0) {
+        qDebug() << "Legacy cache file missing or unreadable, removing:" << fileName;
+        QFile::remove(fileName);
+        return;
+    }
+    
     QMutexLocker locker(&mutex_);
+    if (entries_.contains(uncompressedHash)) {
+        QFile::remove(fileName);
+        return;
+    }
     
-    if (status_.customCacheFile) {
-        return; // Don't save settings for custom cache files
+    const QString target = getCacheEntryPath(uncompressedHash);
+    QDir().mkpath(QFileInfo(target).path());
+    if (!QFile::rename(fileName, target)) {
+        qDebug() << "Failed to move legacy cache file into cache directory:" << fileName;
+        QFile::remove(fileName);
+        return;
     }
     
+    CacheEntry entry;
+    entry.fileName = QFileInfo(target).fileName();
+    entry.cacheFileHash = compressedHash;
+    entry.size = fileInfo.size();
+    entry.lastUsed = fileInfo.lastModified().toMSecsSinceEpoch();
+    entries_.insert(uncompressedHash, entry);
+    saveCacheIndex();
+    
+    qDebug() << "Migrated legacy cache file to" << target;
+}
+
+void CacheManager::saveCacheSettings()
+{
+    QMutexLocker locker(&mutex_);
+    
     settings_.beginGroup("caching");
     settings_.setValue("enabled", cachingEnabled_);
-    settings_.setValue("lastFileName", status_.cacheFileName);
-    settings_.setValue("lastDownloadSHA256", status_.cachedHash);
-    settings_.setValue("lastCacheFileHash", status_.cacheFileHash);
+    settings_.setValue("maxCacheSize", cacheSizeBudget_);
     settings_.endGroup();
     settings_.sync();
+    
+    if (!status_.customCacheFile) {
+        saveCacheIndex();
+    }
 }
 
-QString CacheManager::getDefaultCacheFilePath() const
+QString CacheManager::getCacheDirectory() const
 {
-    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + 
-           QDir::separator() + "lastdownload.cache";
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           QDir::separator() + "downloads";
+}
+
+QString CacheManager::getCacheEntryPath(const QByteArray& expectedHash) const
+{
+    return getCacheDirectory() + QDir::separator() + QString::fromLatin1(expectedHash) + ".cache";
+}
+
+QString CacheManager::getCacheIndexPath() const
+{
+    return getCacheDirectory() + QDir::separator() + "index.json";
+}
+
+QString CacheManager::getImageCacheDirectory() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           QDir::separator() + "images";
+}
+
+QString CacheManager::getChunkStoreDirectory() const
+{
+    return getImageCacheDirectory() + QDir::separator() + "store";
 }
 
 bool CacheManager::isCachingEnabled() const
@@ -432,12 +1017,32 @@ CacheVerificationWorker::CacheVerificationWorker(QObject *parent)
 {
 }
 
-void CacheVerificationWorker::verifyCacheFile(const QString& fileName, const QByteArray& expectedHash)
+void CacheVerificationWorker::verifyCacheFile(const QString& fileName, const QByteArray& expectedHash, bool fullRehash)
 {
     bool isValid = false;
     QByteArray computedHash;
     
     if (!expectedHash.isEmpty() && !fileName.isEmpty()) {
+        // A checkpoint recorded when the file was written (or last fully
+        // verified) avoids reading the whole file again
+        CacheCheckpoint checkpoint;
+        if (!fullRehash && checkpoint.load(fileName) && checkpoint.fileHash == expectedHash) {
+            if (checkpoint.metadataMatches(fileName)) {
+                qDebug() << "Background: Cache file unchanged since checkpoint:" << fileName;
+                isValid = true;
+            } else {
+                qDebug() << "Background: Cache file metadata changed, checking sampled chunks:" << fileName;
+                isValid = verifySampledChunks(fileName, checkpoint);
+                if (isValid) {
+                    // Record the new metadata so the next start is instant again
+                    checkpoint.save(fileName);
+                }
+            }
+            computedHash = isValid ? checkpoint.fileHash : QByteArray();
+            emit verificationComplete(isValid, fileName, expectedHash, computedHash);
+            return;
+        }
+        
         QFile cacheFile(fileName);
         if (cacheFile.exists() && cacheFile.open(QIODevice::ReadOnly)) {
             // Calculate SHA256 of the actual cache file content
@@ -462,6 +1067,7 @@ void CacheVerificationWorker::verifyCacheFile(const QString& fileName, const QBy
                     break;
                 }
                 hash.addData(QByteArrayView(buffer.get(), bytesRead));
+                checkpoint.addData(buffer.get(), bytesRead);
                 totalBytes += bytesRead;
                 
                 // Adaptive progress update frequency based on buffer size
@@ -483,6 +1089,14 @@ void CacheVerificationWorker::verifyCacheFile(const QString& fileName, const QBy
             
             computedHash = hash.result().toHex();
             isValid = (computedHash == expectedHash);
+            
+            if (isValid) {
+                checkpoint.finishChunks();
+                checkpoint.fileHash = computedHash;
+                checkpoint.save(fileName);
+            } else {
+                CacheCheckpoint::remove(fileName);
+            }
         } else {
             qDebug() << "Cache file missing or inaccessible:" << fileName;
         }
@@ -491,6 +1105,80 @@ void CacheVerificationWorker::verifyCacheFile(const QString& fileName, const QBy
     emit verificationComplete(isValid, fileName, expectedHash, computedHash);
 }
 
+/*
+ * Rehash the first and last chunk plus a random selection of the others
+ * and compare them with the checkpoint. This catches truncation, a file
+ * replaced by a different image and most in-place damage, at a fraction
+ * of the cost of a full rehash.
+ */
+bool CacheVerificationWorker::verifySampledChunks(const QString& fileName, const CacheCheckpoint& checkpoint)
+{
+    static constexpr int kSampledChunks = 8;
+    
+    const int chunkCount = static_cast<int>(checkpoint.chunkHashes.size());
+    
+    // A file of a different size has certainly changed
+    QFile cacheFile(fileName);
+    if (!cacheFile.open(QIODevice::ReadOnly) ||
+        (cacheFile.size() + CacheCheckpoint::kChunkSize - 1) / CacheCheckpoint::kChunkSize != chunkCount) {
+        return false;
+    }
+    QList<int> samples;
+    if (chunkCount <= kSampledChunks) {
+        for (int i = 0; i < chunkCount; ++i) {
+            samples.append(i);
+        }
+    } else {
+        samples << 0 << chunkCount - 1;
+        while (samples.size() < kSampledChunks) {
+            int i = QRandomGenerator::global()->bounded(chunkCount);
+            if (!samples.contains(i)) {
+                samples.append(i);
+            }
+        }
+        std::sort(samples.begin(), samples.end());
+    }
+    
+    const qint64 bufferSize = SystemMemoryManager::instance().getAdaptiveVerifyBufferSize(CacheCheckpoint::kChunkSize);
+    std::unique_ptr<char[]> buffer = std::make_unique<char[]>(bufferSize);
+    const qint64 totalBytes = static_cast<qint64>(samples.size()) * CacheCheckpoint::kChunkSize;
+    qint64 bytesProcessed = 0;
+    
+    emit verificationProgress(0, totalBytes);
+    
+    for (int i : std::as_const(samples)) {
+        if (!cacheFile.seek(static_cast<qint64>(i) * CacheCheckpoint::kChunkSize)) {
+            return false;
+        }
+        
+        QCryptographicHash hash(CACHE_HASH_ALGORITHM);
+        qint64 remaining = CacheCheckpoint::kChunkSize;
+        while (remaining > 0 && !cacheFile.atEnd()) {
+            qint64 bytesRead = cacheFile.read(buffer.get(), std::min(bufferSize, remaining));
+            if (bytesRead <= 0) {
+                qDebug() << "Background: Error reading cache file:" << cacheFile.errorString();
+                return false;
+            }
+            hash.addData(QByteArrayView(buffer.get(), bytesRead));
+            remaining -= bytesRead;
+        }
+        
+        if (hash.result().toHex() != checkpoint.chunkHashes.at(i)) {
+            qDebug() << "Background: Cache file chunk" << i << "does not match checkpoint";
+            return false;
+        }
+        
+        bytesProcessed += CacheCheckpoint::kChunkSize;
+        emit verificationProgress(bytesProcessed, totalBytes);
+        
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
 void CacheVerificationWorker::checkDiskSpace()
 {
     // Ensure cache directory exists
@@ -503,10 +1191,74 @@ void CacheVerificationWorker::checkDiskSpace()
     QString cacheDir = getCacheDirectory();
     QStorageInfo storageInfo(cacheDir);
     qint64 availableBytes = storageInfo.bytesAvailable();
+
+    if (availableBytes < IMAGEWRITER_MINIMAL_SPACE_FOR_CACHING) {
+        availableBytes = evictImageCache(cacheDir, availableBytes);
+    }
     
     emit diskSpaceCheckComplete(availableBytes, cacheDir);
 }
 
+/*
+ * Decompressed images are by far the largest cache entries and can always
+ * be recreated from the download, so they are the first to go when the
+ * disk is getting full. Oldest first, until the minimum free space is met.
+ */
+qint64 CacheVerificationWorker::evictImageCache(const QString& cacheDir, qint64 availableBytes)
+{
+    QDir imageDir(cacheDir + QDir::separator() + "images");
+    if (!imageDir.exists()) {
+        return availableBytes;
+    }
+
+    const QFileInfoList images = imageDir.entryInfoList(QStringList() << "*.img", QDir::Files, QDir::Time | QDir::Reversed);
+    for (const QFileInfo& image : images) {
+        if (availableBytes >= IMAGEWRITER_MINIMAL_SPACE_FOR_CACHING) {
+            break;
+        }
+        if (QFile::remove(image.filePath())) {
+            qDebug() << "Low disk space: evicted decompressed image cache" << image.filePath();
+            availableBytes = QStorageInfo(cacheDir).bytesAvailable();
+        }
+    }
+
+    // Then the chunk store, least recently used image first
+    ImageChunkStore store(imageDir.filePath("store"));
+    QList<QByteArray> chunked = store.images();
+    while (availableBytes < IMAGEWRITER_MINIMAL_SPACE_FOR_CACHING && !chunked.isEmpty()) {
+        store.remove(chunked.takeLast());
+        const qint64 freed = store.collectGarbage();
+        qDebug() << "Low disk space: evicted a chunked decompressed image, freeing" << freed << "bytes";
+        availableBytes = QStorageInfo(cacheDir).bytesAvailable();
+    }
+
+    return availableBytes;
+}
+
+void CacheVerificationWorker::addImageToChunkStore(const QString& storeDirectory, const QString& imagePath,
+                                                   const QByteArray& imageHash, int keepVersions)
+{
+    ImageChunkStore store(storeDirectory);
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = store.addImage(imagePath, imageHash, [] {
+        return QThread::currentThread()->isInterruptionRequested();
+    });
+    if (ok) {
+        store.prune(keepVersions);
+        qDebug() << "Background: chunked decompressed image in" << timer.elapsed() << "ms, store now holds"
+                 << store.storedBytes() << "bytes";
+    } else if (!QThread::currentThread()->isInterruptionRequested()) {
+        store.collectGarbage();
+    }
+    emit imageChunked(imageHash, imagePath, ok);
+}
+
+void CacheVerificationWorker::clearChunkStore(const QString& storeDirectory)
+{
+    QDir(storeDirectory).removeRecursively();
+}
+
 bool CacheVerificationWorker::ensureCacheDirectoryExists()
 {
     QString cacheDir = getCacheDirectory();
@@ -14,12 +14,20 @@
 #include <QStorageInfo>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QHash>
 
 class CacheVerificationWorker;
+class CacheCheckpoint;
 
 /**
  * @brief Manages all cache operations in the background to avoid blocking the UI
  * 
+ * Downloads are kept in a content-addressed directory, one file per image
+ * named after its extract_sha256, with a small JSON index recording the
+ * compressed hash, size and last use of each entry. Lookups only consult
+ * the in-memory index. When a new download would exceed the size budget
+ * or the free space reserve, least recently used entries are evicted.
+ *
  * This class handles:
  * - Cache file integrity verification
  * - Cache file path management
@@ -49,6 +57,15 @@ public:
         bool verificationComplete = false;
         bool diskSpaceCheckComplete = false;
         bool customCacheFile = false;
+        QString imageCacheFileName;  // Decompressed image cache (sparse raw image)
+        QByteArray imageCacheHash;   // Uncompressed hash (extract_sha256) of imageCacheFileName
+    };
+
+    struct CacheEntry {
+        QString fileName;           // Relative to the cache directory
+        QByteArray cacheFileHash;   // Compressed hash (image_download_sha256)
+        qint64 size = 0;
+        qint64 lastUsed = 0;        // Milliseconds since epoch, for LRU eviction
     };
 
     explicit CacheManager(QObject *parent = nullptr);
@@ -72,7 +89,31 @@ public:
     void setCustomCacheFile(const QString& cacheFile, const QByteArray& sha256);
     void invalidateCache();
     void updateCacheFile(const QByteArray& uncompressedHash, const QByteArray& compressedHash);
+    void touchCacheEntry(const QByteArray& expectedHash);  // Cached file used as write source
+    QString completedCacheFilePath(const QByteArray& expectedHash) const;  // Indexed entries only, for CachePeerServer
+
+    // Speculative download (CachePrefetcher): where to put it, or empty if
+    // it would not fit without evicting anything. A downloadSize of 0 is not
+    // known yet; the download must then stay within prefetchHeadroom().
+    QString prefetchFilePath(const QByteArray& expectedHash, qint64 downloadSize) const;
+    qint64 prefetchHeadroom() const;
+    bool addPrefetchedFile(const QString& fileName, const QByteArray& uncompressedHash, const QByteArray& compressedHash);
     
+    // Decompressed image cache: repeat writes of the same image read the raw
+    // image directly instead of decompressing the download again
+    bool isImageCacheEnabled() const;
+    void setImageCacheEnabled(bool enabled);
+    QString getImageCacheFilePath(const QByteArray& expectedHash) const;
+    bool setupImageCacheForWrite(const QByteArray& expectedHash, qint64 imageSize, QString& imageCacheFilePath);
+    void updateImageCacheFile(const QByteArray& uncompressedHash, const QString& imageCacheFilePath);
+    void invalidateImageCache();
+
+    // Once cached, decompressed images move into a deduplicating chunk
+    // store (ImageChunkStore), so that several versions of an OS share
+    // their common blocks. The recipe to read one back with, or empty.
+    QString getChunkedImageRecipe(const QByteArray& expectedHash);
+    void invalidateChunkedImage(const QByteArray& expectedHash);
+
     // Cache verification
     void startVerification(const QByteArray& expectedHash);
     
@@ -90,6 +131,7 @@ signals:
 private slots:
     void onVerificationComplete(bool isValid, const QString& fileName, const QByteArray& expectedHash, const QByteArray& computedHash);
     void onDiskSpaceCheckComplete(qint64 availableBytes, const QString& directory);
+    void onImageChunked(const QByteArray& imageHash, const QString& imagePath, bool ok);
 
 private:
     mutable QMutex mutex_;
@@ -98,11 +140,28 @@ private:
     CacheVerificationWorker* worker_;
     QSettings settings_;
     bool cachingEnabled_;
+    bool imageCacheEnabled_;
+    bool chunkStoreEnabled_;
+    int chunkStoreVersions_;
+    qint64 cacheSizeBudget_;
+    bool fullVerification_;
+    QHash<QByteArray, CacheEntry> entries_;  // Keyed by extract_sha256, guarded by mutex_
 
     void updateCacheStatus(const std::function<void(CacheStatus&)>& updater);
     void loadCacheSettings();
     void saveCacheSettings();
-    QString getDefaultCacheFilePath() const;
+    void loadCacheIndex();
+    void saveCacheIndex();  // Caller holds mutex_
+    void migrateLegacyCacheFile(const QString& fileName, const QByteArray& uncompressedHash, const QByteArray& compressedHash);
+    bool evictCacheEntries(qint64 bytesNeeded, qint64& availableBytes);  // Caller holds mutex_
+    void removeCacheEntry(const QByteArray& uncompressedHash);           // Caller holds mutex_
+    qint64 cachedBytes() const;                                          // Caller holds mutex_
+    qint64 prefetchHeadroomLocked() const;                               // Caller holds mutex_
+    QString getCacheDirectory() const;
+    QString getCacheEntryPath(const QByteArray& expectedHash) const;
+    QString getCacheIndexPath() const;
+    QString getImageCacheDirectory() const;
+    QString getChunkStoreDirectory() const;
     bool isCachingEnabled() const;
 };
 
@@ -117,16 +176,22 @@ public:
     explicit CacheVerificationWorker(QObject *parent = nullptr);
 
 public slots:
-    void verifyCacheFile(const QString& fileName, const QByteArray& expectedHash);
+    void verifyCacheFile(const QString& fileName, const QByteArray& expectedHash, bool fullRehash);
     void checkDiskSpace();
+    void addImageToChunkStore(const QString& storeDirectory, const QString& imagePath,
+                              const QByteArray& imageHash, int keepVersions);
+    void clearChunkStore(const QString& storeDirectory);
 
 signals:
     void verificationComplete(bool isValid, const QString& fileName, const QByteArray& expectedHash, const QByteArray& computedHash);
     void diskSpaceCheckComplete(qint64 availableBytes, const QString& directory);
     void verificationProgress(qint64 bytesProcessed, qint64 totalBytes);
+    void imageChunked(const QByteArray& imageHash, const QString& imagePath, bool ok);
 
 private:
     bool ensureCacheDirectoryExists();
+    qint64 evictImageCache(const QString& cacheDir, qint64 availableBytes);
+    bool verifySampledChunks(const QString& fileName, const CacheCheckpoint& checkpoint);
     QString getCacheDirectory() const;
 };
 
@@ -0,0 +1,429 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "cachepeer.h"
+#include "mdnsmessage.h"
+#include <QDebug>
+#include <QFile>
+#include <QNetworkDatagram>
+#include <QNetworkInterface>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QSysInfo>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <algorithm>
+
+namespace {
+
+constexpr int kMaxRequestSize = 8192;
+constexpr qint64 kChunkSize = 256 * 1024;
+constexpr qint64 kSendBufferSize = 4 * 1024 * 1024;
+constexpr quint32 kTtl = 120;
+
+QUdpSocket *bindMdns(QObject *parent, quint16 port)
+{
+    QUdpSocket *socket = new QUdpSocket(parent);
+    if (!socket->bind(QHostAddress::AnyIPv4, port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint))
+    {
+        qDebug() << "CachePeer: cannot bind mDNS socket:" << socket->errorString();
+    }
+    return socket;
+}
+
+} // namespace
+
+CachePeerServer::CachePeerServer(Lookup lookup, QObject *parent)
+    : QObject(parent), _lookup(std::move(lookup)), _server(new QTcpServer(this)), _mdns(nullptr)
+{
+    // DNS labels: letters, digits and hyphens
+    QString host = QSysInfo::machineHostName();
+    host.replace(QRegularExpression("[^A-Za-z0-9-]"), "-");
+    const QByteArray id = QByteArray::number(QRandomGenerator::global()->generate() & 0xffffff, 16);
+    _instance = "rpi-imager-" + host.left(40).toLatin1() + "-" + id + "." + CachePeer::kServiceType;
+    _host = "rpi-imager-" + id + ".local";
+
+    connect(_server, &QTcpServer::newConnection, this, &CachePeerServer::_onNewConnection);
+}
+
+bool CachePeerServer::listen(quint16 port)
+{
+    if (!_server->listen(QHostAddress::Any, port))
+    {
+        _error = _server->errorString();
+        return false;
+    }
+
+    _mdns = bindMdns(this, MdnsMessage::kPort);
+    if (!_mdns->joinMulticastGroup(MdnsMessage::group()))
+    {
+        qDebug() << "CachePeerServer: cannot join mDNS group:" << _mdns->errorString();
+    }
+    connect(_mdns, &QUdpSocket::readyRead, this, &CachePeerServer::_onMdnsReadyRead);
+
+    qDebug() << "CachePeerServer: serving the cache on port" << this->port() << "as" << _instance;
+    return true;
+}
+
+quint16 CachePeerServer::port() const
+{
+    return _server->serverPort();
+}
+
+CachePeerServer::Range CachePeerServer::parseRange(const QByteArray &value, qint64 size, qint64 &first, qint64 &last)
+{
+    static const QRegularExpression re("^\\s*bytes\\s*=\\s*(\\d*)\\s*-\\s*(\\d*)\\s*$");
+    const QRegularExpressionMatch m = re.match(QString::fromLatin1(value));
+    if (!m.hasMatch() || (m.captured(1).isEmpty() && m.captured(2).isEmpty()))
+        return Range::None;
+
+    bool ok1 = true, ok2 = true;
+    if (m.captured(1).isEmpty())
+    {
+        // Suffix: the last n bytes
+        const qint64 n = m.captured(2).toLongLong(&ok2);
+        if (!ok2 || n <= 0 || size <= 0)
+            return Range::Unsatisfiable;
+        first = qMax<qint64>(0, size - n);
+        last = size - 1;
+        return Range::Valid;
+    }
+
+    first = m.captured(1).toLongLong(&ok1);
+    last = m.captured(2).isEmpty() ? size - 1 : qMin(m.captured(2).toLongLong(&ok2), size - 1);
+    if (!ok1 || !ok2)
+        return Range::None;
+    if (first >= size || last < first)
+        return Range::Unsatisfiable;
+    return Range::Valid;
+}
+
+void CachePeerServer::_onNewConnection()
+{
+    while (QTcpSocket *socket = _server->nextPendingConnection())
+    {
+        if (_transfers.size() >= kMaxConnections)
+        {
+            _reply(socket, 503, "Service Unavailable");
+            socket->disconnectFromHost();
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            continue;
+        }
+
+        _transfers.insert(socket, Transfer());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { _onReadyRead(socket); });
+        connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]() { _sendMore(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            _transfers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void CachePeerServer::_onReadyRead(QTcpSocket *socket)
+{
+    auto it = _transfers.find(socket);
+    if (it == _transfers.end() || it->remaining >= 0)
+    {
+        socket->readAll();  // Only one request per connection
+        return;
+    }
+
+    it->request += socket->readAll();
+    const int end = it->request.indexOf("\r\n\r\n");
+    if (end < 0)
+    {
+        if (it->request.size() > kMaxRequestSize)
+        {
+            _reply(socket, 400, "Bad Request");
+            socket->disconnectFromHost();
+        }
+        return;
+    }
+
+    const QByteArray request = it->request.left(end);
+    it->remaining = 0;
+    _handleRequest(socket, request);
+}
+
+void CachePeerServer::_reply(QTcpSocket *socket, int status, const QByteArray &reason, const QByteArray &headers)
+{
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + " " + reason + "\r\n" + headers;
+    if (status >= 400)
+        response += "Content-Length: 0\r\n";
+    response += "Connection: close\r\n\r\n";
+    socket->write(response);
+}
+
+void CachePeerServer::_handleRequest(QTcpSocket *socket, const QByteArray &request)
+{
+    const QList<QByteArray> lines = request.split('\n');
+    const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+    if (requestLine.size() != 3)
+    {
+        _reply(socket, 400, "Bad Request");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    const QByteArray method = requestLine[0];
+    if (method != "GET" && method != "HEAD")
+    {
+        _reply(socket, 405, "Method Not Allowed", "Allow: GET, HEAD\r\n");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    static const QRegularExpression pathRe(QString("^%1([0-9a-fA-F]{64})$").arg(CachePeer::kPathPrefix));
+    const QRegularExpressionMatch m = pathRe.match(QString::fromLatin1(requestLine[1]));
+    const QString path = m.hasMatch() ? _lookup(m.captured(1).toLatin1().toLower()) : QString();
+    QFile *file = path.isEmpty() ? nullptr : new QFile(path, socket);
+    if (!file || !file->open(QIODevice::ReadOnly))
+    {
+        qDebug() << "CachePeerServer:" << socket->peerAddress().toString() << "asked for" << requestLine[1] << "- not cached";
+        _reply(socket, 404, "Not Found");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    QByteArray rangeValue;
+    for (int i = 1; i < lines.size(); i++)
+    {
+        const int colon = lines[i].indexOf(':');
+        if (colon > 0 && lines[i].left(colon).trimmed().toLower() == "range")
+            rangeValue = lines[i].mid(colon + 1).trimmed();
+    }
+
+    const qint64 size = file->size();
+    qint64 first = 0, last = size - 1;
+    const Range range = parseRange(rangeValue, size, first, last);
+    if (range == Range::Unsatisfiable)
+    {
+        _reply(socket, 416, "Range Not Satisfiable", "Content-Range: bytes */" + QByteArray::number(size) + "\r\n");
+        socket->disconnectFromHost();
+        return;
+    }
+    if (range == Range::None)
+    {
+        first = 0;
+        last = size - 1;
+    }
+
+    QByteArray headers = "Content-Type: application/octet-stream\r\n"
+                         "Accept-Ranges: bytes\r\n"
+                         "Content-Length: " + QByteArray::number(last - first + 1) + "\r\n";
+    if (range == Range::Valid)
+    {
+        headers += "Content-Range: bytes " + QByteArray::number(first) + "-" + QByteArray::number(last) +
+                   "/" + QByteArray::number(size) + "\r\n";
+    }
+    _reply(socket, range == Range::Valid ? 206 : 200, range == Range::Valid ? "Partial Content" : "OK", headers);
+
+    if (method == "HEAD" || first > last || !file->seek(first))
+    {
+        socket->disconnectFromHost();
+        return;
+    }
+
+    qDebug() << "CachePeerServer: sending" << path << "from" << first << "to" << socket->peerAddress().toString();
+    _transfers[socket].remaining = last - first + 1;
+    _sendMore(socket);
+}
+
+void CachePeerServer::_sendMore(QTcpSocket *socket)
+{
+    auto it = _transfers.find(socket);
+    if (it == _transfers.end() || it->remaining <= 0)
+        return;
+
+    QFile *file = socket->findChild<QFile *>();
+    while (it->remaining > 0 && socket->bytesToWrite() < kSendBufferSize)
+    {
+        const QByteArray chunk = file->read(qMin(kChunkSize, it->remaining));
+        if (chunk.isEmpty())
+        {
+            // Evicted or truncated under us; the client sees a short transfer
+            socket->abort();
+            return;
+        }
+        socket->write(chunk);
+        it->remaining -= chunk.size();
+    }
+
+    if (it->remaining == 0)
+        socket->disconnectFromHost();  // After what is buffered has been sent
+}
+
+void CachePeerServer::_onMdnsReadyRead()
+{
+    while (_mdns->hasPendingDatagrams())
+    {
+        const QNetworkDatagram datagram = _mdns->receiveDatagram();
+        MdnsMessage::Message query;
+        if (!MdnsMessage::parse(datagram.data(), query) || query.response ||
+            std::none_of(query.questions.cbegin(), query.questions.cend(), [](const QByteArray &name) {
+                return name.compare(CachePeer::kServiceType, Qt::CaseInsensitive) == 0;
+            }))
+        {
+            continue;
+        }
+
+        QList<MdnsMessage::Record> records;
+        MdnsMessage::Record ptr;
+        ptr.name = CachePeer::kServiceType;
+        ptr.type = MdnsMessage::PTR;
+        ptr.ttl = kTtl;
+        ptr.target = _instance;
+        records.append(ptr);
+
+        MdnsMessage::Record srv;
+        srv.name = _instance;
+        srv.type = MdnsMessage::SRV;
+        srv.ttl = kTtl;
+        srv.port = port();
+        srv.target = _host;
+        records.append(srv);
+
+        MdnsMessage::Record txt;
+        txt.name = _instance;
+        txt.type = MdnsMessage::TXT;
+        txt.ttl = kTtl;
+        txt.text.append(QByteArray("path=") + CachePeer::kPathPrefix);
+        records.append(txt);
+
+        // The address on the asker's network, or all of them
+        QList<QHostAddress> addresses, all;
+        for (const QNetworkInterface &iface : QNetworkInterface::allInterfaces())
+        {
+            if (!(iface.flags() & QNetworkInterface::IsUp) || (iface.flags() & QNetworkInterface::IsLoopBack))
+                continue;
+            for (const QNetworkAddressEntry &entry : iface.addressEntries())
+            {
+                if (entry.ip().protocol() != QAbstractSocket::IPv4Protocol)
+                    continue;
+                all.append(entry.ip());
+                if (datagram.senderAddress().isInSubnet(entry.ip(), entry.prefixLength()))
+                    addresses.append(entry.ip());
+            }
+        }
+        for (const QHostAddress &address : addresses.isEmpty() ? all : addresses)
+        {
+            MdnsMessage::Record a;
+            a.name = _host;
+            a.type = MdnsMessage::A;
+            a.ttl = kTtl;
+            a.address = address;
+            records.append(a);
+        }
+
+        // Queries from a port other than 5353 get a unicast answer (RFC 6762 6.7)
+        if (datagram.senderPort() != MdnsMessage::kPort)
+            _mdns->writeDatagram(MdnsMessage::response(records, query.id), datagram.senderAddress(), quint16(datagram.senderPort()));
+        else
+            _mdns->writeDatagram(MdnsMessage::response(records), MdnsMessage::group(), MdnsMessage::kPort);
+    }
+}
+
+CachePeerBrowser::CachePeerBrowser(QObject *parent)
+    : QObject(parent), _socket(nullptr)
+{
+    _timer.setInterval(kQueryIntervalMs);
+    connect(&_timer, &QTimer::timeout, this, &CachePeerBrowser::_query);
+}
+
+void CachePeerBrowser::start()
+{
+    if (_socket)
+        return;
+
+    // An ephemeral port, so servers answer us directly and we do not
+    // compete with the system's mDNS responder for port 5353
+    _socket = bindMdns(this, 0);
+    connect(_socket, &QUdpSocket::readyRead, this, &CachePeerBrowser::_onReadyRead);
+    _clock.start();
+    _timer.start();
+    _query();
+}
+
+void CachePeerBrowser::_query()
+{
+    for (auto it = _peers.begin(); it != _peers.end();)
+    {
+        if (it->expires < _clock.elapsed())
+            it = _peers.erase(it);
+        else
+            ++it;
+    }
+
+    const quint16 id = quint16(QRandomGenerator::global()->bounded(1, 0xffff));
+    _socket->writeDatagram(MdnsMessage::query(CachePeer::kServiceType, MdnsMessage::PTR, id),
+                           MdnsMessage::group(), MdnsMessage::kPort);
+}
+
+void CachePeerBrowser::_onReadyRead()
+{
+    bool changed = false;
+    while (_socket->hasPendingDatagrams())
+    {
+        const QNetworkDatagram datagram = _socket->receiveDatagram();
+        MdnsMessage::Message response;
+        if (!MdnsMessage::parse(datagram.data(), response) || !response.response)
+            continue;
+
+        QHash<QByteArray, MdnsMessage::Record> srvs;
+        QHash<QByteArray, QHostAddress> addresses;
+        for (const MdnsMessage::Record &r : std::as_const(response.records))
+        {
+            if (r.type == MdnsMessage::SRV)
+                srvs.insert(r.name.toLower(), r);
+            else if (r.type == MdnsMessage::A)
+                addresses.insert(r.name.toLower(), r.address);
+        }
+
+        for (const MdnsMessage::Record &r : std::as_const(response.records))
+        {
+            if (r.type != MdnsMessage::PTR || r.name.compare(CachePeer::kServiceType, Qt::CaseInsensitive) != 0 ||
+                r.target == _ignored || !srvs.contains(r.target.toLower()))
+            {
+                continue;
+            }
+
+            const MdnsMessage::Record srv = srvs.value(r.target.toLower());
+            Peer peer;
+            peer.address = addresses.value(srv.target.toLower(), datagram.senderAddress());
+            peer.port = srv.port;
+            peer.expires = _clock.elapsed() + qint64(r.ttl) * 1000;
+            if (!_peers.contains(r.target))
+            {
+                qDebug() << "CachePeerBrowser: found" << r.target << "at" << peer.address.toString() << peer.port;
+                changed = true;
+            }
+            if (r.ttl == 0)
+                _peers.remove(r.target);  // Goodbye
+            else
+                _peers.insert(r.target, peer);
+        }
+    }
+
+    if (changed)
+        emit peersChanged();
+}
+
+QList<QByteArray> CachePeerBrowser::peerUrls(const QByteArray &sha256) const
+{
+    QList<QByteArray> urls;
+    if (sha256.isEmpty())
+        return urls;
+
+    for (const Peer &peer : _peers)
+    {
+        if (peer.expires < _clock.elapsed())
+            continue;
+        urls.append("http://" + peer.address.toString().toLatin1() + ":" + QByteArray::number(peer.port) +
+                    CachePeer::kPathPrefix + sha256.toLower());
+    }
+    return urls;
+}
@@ -0,0 +1,141 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef CACHEPEER_H
+#define CACHEPEER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+#include <QTimer>
+#include <functional>
+
+class QTcpServer;
+class QTcpSocket;
+class QUdpSocket;
+
+/**
+ * @brief Sharing the download cache between imagers on a LAN
+ *
+ * With several imaging stations on one network, each would otherwise
+ * download the same image from the internet. A station that serves its
+ * cache runs a CachePeerServer: completed CacheManager entries are
+ * available as http://<address>:<port>/cache/<extract_sha256> (GET and
+ * HEAD, with single byte ranges), and it answers multicast DNS queries
+ * for kServiceType. Stations that use peers run a CachePeerBrowser to
+ * find them, and DownloadThread tries the peers before the origin.
+ *
+ * Nothing served by a peer is trusted: the download is checked against
+ * the OS list SHA256 as usual, and a peer that does not have the image
+ * or fails part way is dropped in favour of the origin.
+ */
+namespace CachePeer
+{
+    constexpr const char *kServiceType = "_rpi-imager-cache._tcp.local";
+    constexpr const char *kPathPrefix = "/cache/";
+}
+
+/**
+ * @brief HTTP server for the local cache, announced over mDNS
+ *
+ * Runs on the thread it was created on; the data is read and sent in
+ * chunks as the socket drains, so a slow client does not hold anything up.
+ */
+class CachePeerServer : public QObject
+{
+    Q_OBJECT
+public:
+    // Path of the complete cache entry for an extract_sha256, or empty
+    using Lookup = std::function<QString(const QByteArray &sha256)>;
+
+    enum class Range { None, Valid, Unsatisfiable };
+
+    static constexpr int kMaxConnections = 16;
+
+    explicit CachePeerServer(Lookup lookup, QObject *parent = nullptr);
+
+    /**
+     * @brief Start serving, and answering mDNS queries
+     * @param port TCP port, 0 for any free one (it is announced)
+     */
+    bool listen(quint16 port = 0);
+    quint16 port() const;
+    QString errorString() const { return _error; }
+
+    // mDNS instance name, so that a browser in the same process can skip it
+    QByteArray instanceName() const { return _instance; }
+
+    /**
+     * @brief Parse a Range header value of a single byte range
+     * ("bytes=a-b", "bytes=a-" or "bytes=-n")
+     * @return None if there is no range to honour (absent, or a form
+     * that is not supported, so the whole file is sent)
+     */
+    static Range parseRange(const QByteArray &value, qint64 size, qint64 &first, qint64 &last);
+
+private:
+    struct Transfer {
+        QByteArray request;
+        qint64 remaining = -1;  // Bytes left to send; -1 until the request is read
+    };
+
+    void _onNewConnection();
+    void _onReadyRead(QTcpSocket *socket);
+    void _handleRequest(QTcpSocket *socket, const QByteArray &request);
+    void _sendMore(QTcpSocket *socket);
+    void _reply(QTcpSocket *socket, int status, const QByteArray &reason, const QByteArray &headers = QByteArray());
+    void _onMdnsReadyRead();
+
+    Lookup _lookup;
+    QTcpServer *_server;
+    QUdpSocket *_mdns;
+    QHash<QTcpSocket *, Transfer> _transfers;
+    QByteArray _instance, _host;
+    QString _error;
+};
+
+/**
+ * @brief Finds CachePeerServers over mDNS
+ *
+ * Asks when started and every kQueryIntervalMs, and keeps each peer for
+ * the TTL it announced.
+ */
+class CachePeerBrowser : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int kQueryIntervalMs = 60 * 1000;
+
+    explicit CachePeerBrowser(QObject *parent = nullptr);
+
+    void start();
+    void setIgnoredInstance(const QByteArray &instance) { _ignored = instance; }
+
+    // Where peers would have the download for an extract_sha256
+    QList<QByteArray> peerUrls(const QByteArray &sha256) const;
+
+signals:
+    void peersChanged();
+
+private:
+    struct Peer {
+        QHostAddress address;
+        quint16 port = 0;
+        qint64 expires = 0;  // _clock time
+    };
+
+    void _query();
+    void _onReadyRead();
+
+    QUdpSocket *_socket;
+    QTimer _timer;
+    QElapsedTimer _clock;
+    QHash<QByteArray, Peer> _peers;  // By instance name
+    QByteArray _ignored;
+};
+
+#endif // CACHEPEER_H
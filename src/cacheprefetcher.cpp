@@ -0,0 +1,120 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "cacheprefetcher.h"
+#include "acceleratedcryptographichash.h"
+#include "bandwidthscheduler.h"
+#include "cachecheckpoint.h"
+#include "curlnetworkconfig.h"
+#include "config.h"
+#include <QDebug>
+#include <QFile>
+
+CachePrefetcher::CachePrefetcher(const QByteArray &url, const QByteArray &expectedHash, const QString &fileName, QObject *parent)
+    : QThread(parent), _url(url), _expectedHash(expectedHash), _fileName(fileName),
+      _maxBytesPerSecond(kDefaultMaxBytesPerSecond), _cancelled(false), _complete(false), _bytesFetched(0),
+      _file(nullptr)
+{
+}
+
+CachePrefetcher::~CachePrefetcher()
+{
+    _cancelled = true;
+    wait();
+}
+
+size_t CachePrefetcher::_writeCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    auto *self = static_cast<CachePrefetcher *>(userdata);
+    const size_t len = size * nmemb;
+    if (self->_cancelled)
+        return 0;
+
+    if (self->_maxFileSize > 0 && self->_bytesFetched + static_cast<qint64>(len) > self->_maxFileSize)
+    {
+        qDebug() << "Prefetch: larger than the" << self->_maxFileSize << "bytes the cache has room for";
+        return 0;
+    }
+
+    BandwidthScheduler::instance().acquire(BandwidthScheduler::Priority::Prefetch, static_cast<qint64>(len));
+    if (self->_file->write(ptr, static_cast<qint64>(len)) != static_cast<qint64>(len))
+    {
+        qDebug() << "Prefetch: error writing" << self->_fileName << self->_file->errorString();
+        return 0;
+    }
+    self->_hash->addData(ptr, static_cast<int>(len));
+    self->_checkpoint->addData(ptr, static_cast<qint64>(len));
+    self->_bytesFetched += static_cast<qint64>(len);
+    return len;
+}
+
+int CachePrefetcher::_progressCallback(void *clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+{
+    return static_cast<CachePrefetcher *>(clientp)->_cancelled ? 1 : 0;
+}
+
+void CachePrefetcher::run()
+{
+    QFile file(_fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug() << "Prefetch: cannot create" << _fileName << file.errorString();
+        return;
+    }
+    _file = &file;
+    _hash = std::make_unique<AcceleratedCryptographicHash>(OSLIST_HASH_ALGORITHM);
+    _checkpoint = std::make_unique<CacheCheckpoint>();
+
+    CURL *c = curl_easy_init();
+    if (!c)
+    {
+        file.close();
+        return;
+    }
+
+    BandwidthScheduler::Transfer bandwidthTransfer(BandwidthScheduler::Priority::Prefetch);
+    char errorBuffer[CURL_ERROR_SIZE] = {0};
+    CurlNetworkConfig::instance().applyCurlSettings(c, CurlNetworkConfig::FetchProfile::LargeFile, errorBuffer);
+    curl_easy_setopt(c, CURLOPT_URL, _url.constData());
+    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, &CachePrefetcher::_writeCallback);
+    curl_easy_setopt(c, CURLOPT_WRITEDATA, this);
+    curl_easy_setopt(c, CURLOPT_XFERINFOFUNCTION, &CachePrefetcher::_progressCallback);
+    curl_easy_setopt(c, CURLOPT_XFERINFODATA, this);
+    curl_easy_setopt(c, CURLOPT_NOPROGRESS, 0L);
+    if (_maxBytesPerSecond > 0)
+        curl_easy_setopt(c, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(_maxBytesPerSecond));
+    // Refused up front when the server gives the size
+    if (_maxFileSize > 0)
+        curl_easy_setopt(c, CURLOPT_MAXFILESIZE_LARGE, static_cast<curl_off_t>(_maxFileSize));
+
+    qDebug() << "Prefetch: starting" << _url << "to" << _fileName
+             << "capped at" << _maxBytesPerSecond << "bytes/s";
+    const CURLcode ret = curl_easy_perform(c);
+    curl_easy_cleanup(c);
+
+    file.flush();
+    file.close();
+    _file = nullptr;
+
+    // Cancelling makes the write callback fail, so a successful transfer is complete
+    if (ret == CURLE_OK)
+    {
+        _fileHash = _hash->result().toHex();
+        _checkpoint->finishChunks();
+        _checkpoint->fileHash = _fileHash;
+        _checkpoint->save(_fileName);
+        _complete = true;
+        qDebug() << "Prefetch: complete," << _bytesFetched.load() << "bytes";
+    }
+    else if (_cancelled)
+    {
+        qDebug() << "Prefetch: stopped after" << _bytesFetched.load() << "bytes";
+    }
+    else
+    {
+        qDebug() << "Prefetch: failed after" << _bytesFetched.load() << "bytes:"
+                 << (errorBuffer[0] ? errorBuffer : curl_easy_strerror(ret));
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef CACHEPREFETCHER_H
+#define CACHEPREFETCHER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <curl/curl.h>
+
+class QFile;
+class AcceleratedCryptographicHash;
+class CacheCheckpoint;
+
+/**
+ * @brief Speculative download of the selected image into the cache
+ *
+ * Started when an OS is selected, while the user is still choosing the
+ * storage device and customisation options. The compressed download is
+ * streamed, at low thread priority and capped bandwidth, to a
+ * "<extract_sha256>.prefetch" file in the cache directory.
+ *
+ * If it completes, CacheManager::addPrefetchedFile() turns it into an
+ * ordinary cache entry and the write starts from the cache. If the write
+ * starts first, the prefetcher is stopped and what it has fetched so far
+ * is handed to DownloadThread::setPrefetchedPrefix(), so that only the
+ * rest is downloaded.
+ *
+ * Nothing is retried: a failed prefetch just leaves less for the write
+ * to skip. Under a shared rate limit it yields to the write and to the
+ * OS list (BandwidthScheduler::Priority::Prefetch).
+ */
+class CachePrefetcher : public QThread
+{
+    Q_OBJECT
+public:
+    static constexpr qint64 kDefaultMaxBytesPerSecond = 4 * 1024 * 1024;
+
+    CachePrefetcher(const QByteArray &url, const QByteArray &expectedHash, const QString &fileName, QObject *parent = nullptr);
+    ~CachePrefetcher() override;
+
+    // 0 for no cap; set before starting the thread
+    void setMaxBytesPerSecond(qint64 bytesPerSecond) { _maxBytesPerSecond = bytesPerSecond; }
+
+    // For a download of unknown size: give up once it is larger than this.
+    // 0 for no limit; set before starting the thread
+    void setMaxFileSize(qint64 bytes) { _maxFileSize = bytes; }
+
+    void cancel() { _cancelled = true; }
+
+    QByteArray expectedHash() const { return _expectedHash; }
+    QString fileName() const { return _fileName; }
+
+    // Only meaningful once the thread has finished
+    bool isComplete() const { return _complete; }
+    qint64 bytesFetched() const { return _bytesFetched; }
+    QByteArray fileHash() const { return _fileHash; }  // Hex SHA256 of the complete file
+
+protected:
+    void run() override;
+
+private:
+    static size_t _writeCallback(char *ptr, size_t size, size_t nmemb, void *userdata);
+    static int _progressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+
+    QByteArray _url, _expectedHash;
+    QString _fileName;
+    qint64 _maxBytesPerSecond;
+    qint64 _maxFileSize = 0;
+    std::atomic<bool> _cancelled;
+    std::atomic<bool> _complete;
+    std::atomic<qint64> _bytesFetched;
+    QByteArray _fileHash;
+
+    // Used on the prefetch thread only
+    QFile *_file;
+    std::unique_ptr<AcceleratedCryptographicHash> _hash;
+    std::unique_ptr<CacheCheckpoint> _checkpoint;
+};
+
+#endif // CACHEPREFETCHER_H
@@ -0,0 +1,115 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "capacityprobe.h"
+#include <algorithm>
+#include <cstring>
+
+using rpi_imager::FileError;
+
+namespace {
+
+constexpr char kMagic[8] = {'R', 'P', 'I', 'P', 'R', 'O', 'B', 'E'};
+
+void putLE64(std::uint8_t *p, std::uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = static_cast<std::uint8_t>(v >> (8 * i));
+}
+
+// Aligned view into a vector, for direct I/O
+std::uint8_t *alignedIn(std::vector<std::uint8_t> &mem, std::size_t alignment)
+{
+    const auto addr = reinterpret_cast<std::uintptr_t>(mem.data());
+    return mem.data() + (alignment - addr % alignment) % alignment;
+}
+
+} // namespace
+
+std::vector<std::uint64_t> CapacityProbe::offsets(std::uint64_t deviceSize, std::size_t tagSize)
+{
+    std::vector<std::uint64_t> result;
+    if (tagSize == 0 || deviceSize < kFirstOffset + 2 * tagSize)
+        return result;
+
+    const std::uint64_t last = (deviceSize - tagSize) / tagSize * tagSize;
+    for (std::uint64_t offset = kFirstOffset; offset + tagSize <= last; offset *= 2)
+        result.push_back(offset);
+    result.push_back(last);
+    return result;
+}
+
+void CapacityProbe::fillTag(std::uint8_t *buf, std::size_t tagSize, std::uint64_t offset, std::uint64_t nonce)
+{
+    std::memcpy(buf, kMagic, sizeof(kMagic));
+    putLE64(buf + 8, offset);
+    putLE64(buf + 16, nonce);
+
+    // xorshift64 fill, so a tag that is only partly intact does not pass
+    std::uint64_t x = (offset ^ nonce) * 0x9E3779B97F4A7C15ull | 1;
+    for (std::size_t i = 24; i < tagSize; i += 8)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        std::uint8_t word[8];
+        putLE64(word, x);
+        std::memcpy(buf + i, word, std::min<std::size_t>(8, tagSize - i));
+    }
+}
+
+CapacityProbe::Result CapacityProbe::run(rpi_imager::FileOperations &file, std::uint64_t deviceSize,
+                                         std::size_t tagSize, std::uint64_t nonce)
+{
+    Result result;
+    result.capacity = deviceSize;
+    const std::vector<std::uint64_t> probeOffsets = offsets(deviceSize, tagSize);
+    result.probes = static_cast<int>(probeOffsets.size());
+
+    std::vector<std::uint8_t> tagMem(tagSize * 2), readMem(tagSize * 2);
+    std::uint8_t *tag = alignedIn(tagMem, tagSize);
+    std::uint8_t *readBuf = alignedIn(readMem, tagSize);
+
+    // A write the device refuses counts as a bad tag at that offset
+    std::vector<bool> written(probeOffsets.size(), false);
+    for (size_t i = 0; i < probeOffsets.size(); i++)
+    {
+        fillTag(tag, tagSize, probeOffsets[i], nonce);
+        written[i] = file.WriteAtOffset(probeOffsets[i], tag, tagSize) == FileError::kSuccess;
+    }
+
+    if (file.Flush() != FileError::kSuccess || file.ForceSync() != FileError::kSuccess)
+    {
+        result.ioError = true;
+        return result;
+    }
+
+    for (size_t i = 0; i < probeOffsets.size(); i++)
+    {
+        bool intact = false;
+        if (written[i])
+        {
+            // Read from the device, not the page cache
+            file.PrepareForSequentialRead(probeOffsets[i], tagSize);
+            std::size_t bytesRead = 0;
+            if (file.ReadAtOffset(probeOffsets[i], readBuf, tagSize, bytesRead) == FileError::kSuccess &&
+                bytesRead == tagSize)
+            {
+                fillTag(tag, tagSize, probeOffsets[i], nonce);
+                intact = std::memcmp(tag, readBuf, tagSize) == 0;
+            }
+        }
+
+        if (!intact)
+        {
+            if (!result.failed)
+                result.capacity = probeOffsets[i];
+            result.failed++;
+        }
+    }
+
+    result.ok = result.failed == 0;
+    return result;
+}
@@ -0,0 +1,65 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef CAPACITYPROBE_H
+#define CAPACITYPROBE_H
+
+#include "file_operations.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Quick check that a device really holds the capacity it reports
+ *
+ * Counterfeit cards report more capacity than they have. Most of them
+ * drop the high address bits, so writes past the real size wrap around
+ * onto earlier data; others fail or discard them. Without a check, this
+ * only shows up after a full write and verify, or at first boot.
+ *
+ * run() writes a unique tag (offset, nonce and a pseudo-random fill) at
+ * kFirstOffset and every power of two above it, and at the very end of the
+ * device, in ascending order. It then syncs and reads every tag back. On a
+ * card that wraps at a power-of-two size, every probe at or past the real
+ * size lands on the same spot, so all but the last one read back
+ * overwritten. The first probe that does not read back intact gives the
+ * capacity the card really has, to within a factor of two (exactly, when
+ * the real size is a power of two).
+ *
+ * This takes a few dozen small writes and reads. It cannot prove a card is
+ * genuine: one that wraps at some other size may pass, and verification
+ * still catches that. The tags overwrite what was at those offsets, so it
+ * is only run before the image is written.
+ */
+class CapacityProbe
+{
+public:
+    static constexpr std::uint64_t kFirstOffset = 16 * 1024 * 1024;
+
+    struct Result {
+        bool ok = false;              // Every tag read back intact
+        bool ioError = false;         // The device could not be synced
+        std::uint64_t capacity = 0;   // Reported size if ok, else the offset of the first bad tag
+        int probes = 0;
+        int failed = 0;
+    };
+
+    // Offsets probed on a device of this size, in the order written
+    static std::vector<std::uint64_t> offsets(std::uint64_t deviceSize, std::size_t tagSize);
+
+    // The tag for one offset; tagSize bytes at least 32
+    static void fillTag(std::uint8_t *buf, std::size_t tagSize, std::uint64_t offset, std::uint64_t nonce);
+
+    /**
+     * @brief Write, sync and read back the tags
+     * @param file Open device; tags are tagSize bytes, which must suit its direct I/O alignment
+     * @param deviceSize Size the device reports
+     * @param nonce Different for every run, so tags left by an earlier one do not count
+     */
+    static Result run(rpi_imager::FileOperations &file, std::uint64_t deviceSize,
+                      std::size_t tagSize, std::uint64_t nonce);
+};
+
+#endif // CAPACITYPROBE_H
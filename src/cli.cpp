@@ -6,13 +6,67 @@
 #include "cli.h"
 #include "imagewriter.h"
 #include <iostream>
+#include <algorithm>
 #include <QCoreApplication>
 #include <QCommandLineParser>
 #include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
 #include "drivelistmodel.h"
 #include "drivelist/drivelist.h"
 #include "imageadvancedoptions.h"
 #include "platformquirks.h"
+#include "writebenchmark.h"
+#include "devicebackup.h"
+#include "performancestats.h"
+#include "file_operations_memory.h"
+#include "metricsserver.h"
+#include "sessioncomparison.h"
+#include "jobserver.h"
+
+// With --cache-peers, time for peers to answer before the write starts
+static constexpr int kCachePeerDiscoveryMs = 1500;
+
+// --max-download-rate, applied to all downloads of this run (not saved)
+static bool applyDownloadRateLimit(const QCommandLineParser &parser, ImageWriter *imageWriter)
+{
+    const QString value = parser.value("max-download-rate");
+    if (value.isEmpty())
+        return true;
+
+    const quint64 bytesPerSecond = WriteBenchmark::parseByteSize(value);
+    if (!bytesPerSecond)
+    {
+        std::cerr << "Error: invalid --max-download-rate: " << value.toStdString() << std::endl;
+        return false;
+    }
+    imageWriter->setDownloadRateLimit(std::max<qint64>(static_cast<qint64>(bytesPerSecond / 1024), 1));
+    return true;
+}
+
+// --metrics, serving LiveMetrics for as long as the run lasts
+static bool startMetricsServer(const QCommandLineParser &parser, QObject *parent)
+{
+    const QString value = parser.value("metrics");
+    if (value.isEmpty())
+        return true;
+
+    QHostAddress address;
+    quint16 port = 0;
+    if (!MetricsServer::parseListen(value, address, port))
+    {
+        std::cerr << "Error: invalid --metrics: " << value.toStdString() << std::endl;
+        return false;
+    }
+    MetricsServer *server = new MetricsServer(parent);
+    if (!server->listen(address, port))
+    {
+        std::cerr << "Error: cannot serve metrics on " << value.toStdString() << ": "
+                  << server->errorString().toStdString() << std::endl;
+        return false;
+    }
+    return true;
+}
 
 /* Message handler to discard qDebug() output if using cli (unless --debug is set) */
 static void devnullMsgHandler(QtMsgType, const QMessageLogContext &, const QString &)
@@ -47,6 +101,10 @@ int Cli::run()
         {"cli", ""},  // Only relevant when running GUI build in CLI mode
 #endif
         {"disable-verify", "Disable verification"},
+        {"verify-coverage", "Verify by reading back only this percentage of the image, plus the boot partition "
+                            "and blocks that catch fake-capacity cards (default 100)", "percent", ""},
+        {"io-trace", "Record every operation on dst, with its timing and result, to this file. "
+                     "Writing to replay:<file> later plays the device back", "file", ""},
         {"enable-writing-system-drives", "Only use this if you know what you are doing"},
         {"sha256", "Expected hash", "sha256", ""},
         {"cache-file", "Custom cache file (requires setting sha256 as well)", "cache-file", ""},
@@ -54,18 +112,106 @@ int Cli::run()
         {"cloudinit-userdata", "Add cloud-init user-data file to image", "cloudinit-userdata", ""},
         {"cloudinit-networkconfig", "Add cloud-init network-config file to image", "cloudinit-networkconfig", ""},
         {"disable-eject", "Disable automatic ejection of storage media after verification"},
+        {"erase-before-write", "Discard the whole storage device before writing (if supported)"},
+        {"partitions", "Write only these partitions of src (comma-separated numbers, e.g. 1 for the boot partition) "
+                       "onto dst, which must already have them at the same offsets. Only they are verified", "numbers", ""},
         {"debug", "Output debug messages to console"},
         {"quiet", "Only write to console on error"},
         {"log-file", "Log output to file (for debugging)", "path", ""},
         {"secure-boot-key", "Path to RSA private key (PEM format) for secure boot signing", "key-file", ""},
+        {"clone", "Copy src, a storage device or raw disk image, as-is. "
+                  "Only the blocks used by FAT and ext2/3/4 file systems are copied"},
+        {"clone-all-blocks", "With --clone or --backup, copy every block of src"},
+        {"backup", "Read src, a storage device or raw disk image, into dst as a zstd-compressed image with a .bmap "
+                   "beside it. Only the blocks used by FAT and ext2/3/4 file systems are read"},
+        {"backup-bmap", "Where --backup writes the block map (default: dst with .zst replaced by .bmap)", "file", ""},
+        {"backup-level", "zstd compression level for --backup (default 3)", "level", ""},
+        {"benchmark", "Benchmark dst with synthetic data, or src if it is given as a raw image, and print a JSON report. "
+                      "dst may be a device, a file (e.g. on a ramdisk), \"null\" or a null:, ramdisk: or emulate: target. "
+                      "Given several dsts, writes to 1..N of them at once; src is then required (\"synthetic\" for "
+                      "generated data). Destroys data on dst"},
+        {"benchmark-size", "Bytes written per benchmark run (K/M/G suffixes allowed)", "size", ""},
+        {"benchmark-buffer-sizes", "Comma-separated write sizes to try", "sizes", ""},
+        {"benchmark-queue-depths", "Comma-separated async queue depths to try (1 = synchronous)", "depths", ""},
+        {"benchmark-direct-io", "Comma-separated direct I/O modes to try (on, off)", "modes", ""},
+        {"benchmark-sync-intervals", "Comma-separated bytes between syncs to try (0 = final sync only)", "sizes", ""},
+        {"benchmark-no-hash", "Do not hash data during the benchmark"},
+        {"benchmark-fanout", "Comma-separated numbers of dsts to write at once, one run each (default 1 to the "
+                             "number of dsts). The last dst is repeated to make up a count if it is a null:, "
+                             "ramdisk: or emulate: target", "counts", ""},
+        {"manifest", "Run the jobs in a JSON manifest (images, devices or rules to pick them, customisation) "
+                     "instead of writing src to dst, and print a JSON report", "file", ""},
+        {"cache-peers", "Download the image from another imager on the local network that serves its cache "
+                        "(see --serve-cache), if one has it"},
+        {"serve-cache", "Serve the download cache to other imagers on the local network until interrupted, "
+                        "instead of writing"},
+        {"json-progress", "Print progress, bottleneck changes and a performance summary to stdout as "
+                          "newline-delimited JSON instead of the progress bar"},
+        {"max-download-rate", "Limit downloads to this many bytes per second in total (K/M/G suffixes allowed), "
+                              "leaving the rest of a shared uplink to others", "rate", ""},
+        {"metrics", "Serve live metrics for Prometheus at http://<address>:<port>/metrics while running. "
+                    "The address defaults to 127.0.0.1", "[address:]port", ""},
+        {"daemon", "Stay resident and run writes requested over this local socket (name or path) as JSON, "
+                   "several at once on different devices, until interrupted", "socket", ""},
+        {"daemon-slots", "Writes a --daemon runs at the same time (default 4)", "count", ""},
+        {"compare-sessions", "Compare performance stats exports given in place of src and dst with the first one, "
+                             "and print a JSON report of the differences and regressions"},
     });
 
-    parser.addPositionalArgument("src", "Image file/URL");
-    parser.addPositionalArgument("dst", "Destination device");
+    parser.addPositionalArgument("src", "Image file/URL, or device with --clone or --backup");
+    parser.addPositionalArgument("dst", "Destination device (repeat to write several devices at once). "
+                                        "null:[size] discards the data and ramdisk:[size] keeps it in memory, "
+                                        "to measure download and decompression without a device. "
+                                        "replay:<file> behaves like the device an --io-trace file was recorded from, and "
+                                        "emulate:<healthy|slc-cliff|gc|lost-completion|slow-sync> like a slow device",
+                                        "dst [dst...]");
     parser.process(*_app);
+    _jsonProgress = parser.isSet("json-progress");
+
+    if (parser.isSet("compare-sessions"))
+    {
+        return _compareSessions(parser);
+    }
+
+    if (!startMetricsServer(parser, this))
+    {
+        return 1;
+    }
+
+    if (parser.isSet("benchmark"))
+    {
+        return _runBenchmark(parser);
+    }
+
+    if (parser.isSet("backup"))
+    {
+        return _runBackup(parser);
+    }
+
+    if (!parser.value("manifest").isEmpty())
+    {
+        return _runManifest(parser);
+    }
+
+    if (parser.isSet("serve-cache"))
+    {
+        return _serveCache(parser);
+    }
+
+    if (!parser.value("daemon").isEmpty())
+    {
+        return _runDaemon(parser);
+    }
+
+    // In-memory targets need neither privileges nor a removable drive
+    const QStringList requestedDsts = parser.positionalArguments().mid(1);
+    const bool memoryTargetsOnly = !requestedDsts.isEmpty()
+        && std::all_of(requestedDsts.cbegin(), requestedDsts.cend(), [](const QString &dst) {
+               return rpi_imager::MemoryFileOperations::IsMemoryTarget(dst.toStdString());
+           });
 
     // Check for elevated privileges on platforms that require them (Linux/Windows)
-    if (!PlatformQuirks::hasElevatedPrivileges())
+    if (!memoryTargetsOnly && !PlatformQuirks::hasElevatedPrivileges())
     {
         // Common error message
         const char* commonMsg = "Writing to storage devices requires elevated privileges.";
@@ -98,25 +244,15 @@ int Cli::run()
 
 
     const QStringList args = parser.positionalArguments();
-    if (args.count() != 2)
+    if (args.count() < 2)
     {
         std::cerr << parser.helpText().toStdString() << std::endl;
         return 1;
     }
 
     // Now create ImageWriter for actual write operations
-    _imageWriter = new ImageWriter;
-    connect(_imageWriter, &ImageWriter::success, this, &Cli::onSuccess);
-    connect(_imageWriter, &ImageWriter::error, this, &Cli::onError);
-    connect(_imageWriter, &ImageWriter::preparationStatusUpdate, this, &Cli::onPreparationStatusUpdate);
-    connect(_imageWriter, &ImageWriter::downloadProgress, this, &Cli::onDownloadProgress);
-    connect(_imageWriter, &ImageWriter::verifyProgress, this, &Cli::onVerifyProgress);
-
-    if (!parser.isSet("debug"))
-    {
-        qInstallMessageHandler(devnullMsgHandler);
-    }
-    _quiet = parser.isSet("quiet");
+    _createImageWriter(parser.isSet("debug"));
+    _quiet = parser.isSet("quiet") || _jsonProgress;
     QByteArray initFormat = (parser.value("cloudinit-userdata").isEmpty()
                              && parser.value("cloudinit-networkconfig").isEmpty() ) ? "systemd" : "cloudinit";
     
@@ -147,7 +283,16 @@ int Cli::run()
         }
     }
 
-    if (args[0].startsWith("http:", Qt::CaseInsensitive) || args[0].startsWith("https:", Qt::CaseInsensitive))
+    if (parser.isSet("clone"))
+    {
+        if (!QFileInfo::exists(args[0]))
+        {
+            std::cerr << "Error: source device does not exist" << std::endl;
+            return 1;
+        }
+        _imageWriter->setSrcDevice(args[0], !parser.isSet("clone-all-blocks"));
+    }
+    else if (args[0].startsWith("http:", Qt::CaseInsensitive) || args[0].startsWith("https:", Qt::CaseInsensitive))
     {
         _imageWriter->setSrc(args[0], 0, 0, parser.value("sha256").toLatin1(), false, "", "", initFormat);
 
@@ -176,41 +321,20 @@ int Cli::run()
         }
     }
 
+    QStringList dsts = args.mid(1);
+    if (dsts.removeDuplicates() != 0)
+    {
+        std::cerr << "Error: the same destination drive was specified more than once" << std::endl;
+        return 1;
+    }
+
     if (parser.isSet("enable-writing-system-drives"))
     {
         std::cerr << "WARNING: writing to system drives is enabled." << std::endl;
     }
-    else
+    else if (!_checkRemovable(dsts))
     {
-        DriveListModel dlm;
-        dlm.processDriveList(Drivelist::ListStorageDevices() );
-        bool foundDrive = false;
-        int numDrives = dlm.rowCount( QModelIndex() );
-
-        for (int i = 0; i < numDrives; i++)
-        {
-            if (dlm.index(i, 0).data(dlm.deviceRole) == args[1])
-            {
-                foundDrive = true;
-                break;
-            }
-        }
-
-        if (!foundDrive)
-        {
-            std::cerr << "Destination drive is not in list of removable volumes. Choose one of the following:" << std::endl << std::endl;
-
-            for (int i = 0; i < numDrives; i++)
-            {
-                QModelIndex idx = dlm.index(i, 0);
-                QByteArray line = idx.data(dlm.deviceRole).toByteArray()+" ("+idx.data(dlm.descriptionRole).toByteArray()+")";
-
-                std::cerr << line.constData() << std::endl;
-            }
-
-            std::cerr << std::endl << "Or use --enable-writing-system-drives to overrule." << std::endl;
-            return 1;
-        }
+        return 1;
     }
 
     if (!parser.value("cloudinit-userdata").isEmpty() || !parser.value("cloudinit-networkconfig").isEmpty())
@@ -288,22 +412,697 @@ int Cli::run()
         _imageWriter->setImageCustomisation("", "", "", "", "", advancedOptions, initFormat);
     }
 
-    _imageWriter->setDst(args[1]);
+    _imageWriter->setDst(dsts[0]);
+    _imageWriter->setAdditionalDsts(dsts.mid(1));
+    _additionalCount = static_cast<int>(dsts.size()) - 1;
+    for (const QString &dst : dsts.mid(1))
+    {
+        _additionalPercent.insert(dst, 0);
+    }
     _imageWriter->setVerifyEnabled(!parser.isSet("disable-verify"));
+    if (parser.isSet("verify-coverage"))
+    {
+        bool ok;
+        const double coverage = parser.value("verify-coverage").toDouble(&ok);
+        if (!ok || coverage < 0 || coverage > 100)
+        {
+            std::cerr << "Error: invalid --verify-coverage: " << parser.value("verify-coverage").toStdString() << std::endl;
+            return 1;
+        }
+        _imageWriter->setVerifyCoverage(coverage);
+    }
+    if (parser.isSet("io-trace"))
+        _imageWriter->setIoTraceFile(parser.value("io-trace"));
+    if (parser.isSet("partitions"))
+    {
+        QList<int> partitions;
+        for (const QString &number : parser.value("partitions").split(',', Qt::SkipEmptyParts))
+        {
+            bool ok;
+            const int partition = number.trimmed().toInt(&ok);
+            if (!ok || partition < 1)
+            {
+                std::cerr << "Error: invalid --partitions: " << parser.value("partitions").toStdString() << std::endl;
+                return 1;
+            }
+            partitions.append(partition);
+        }
+        if (partitions.isEmpty() || parser.isSet("clone") || parser.isSet("erase-before-write") || dsts.size() > 1)
+        {
+            std::cerr << "Error: --partitions needs one dst, and cannot be used with --clone or --erase-before-write" << std::endl;
+            return 1;
+        }
+        _imageWriter->setWritePartitions(partitions);
+    }
+    _imageWriter->setEraseBeforeWrite(parser.isSet("erase-before-write"));
     _imageWriter->setSetting("eject", !parser.isSet("disable-eject"));
+    if (!applyDownloadRateLimit(parser, _imageWriter))
+    {
+        return 1;
+    }
+
+    if (parser.isSet("cache-peers"))
+    {
+        _imageWriter->setCachePeersEnabled(true);
+    }
 
     /* Run startWrite() in event loop (otherwise calling _app->exit() on error does not work) */
-    QTimer::singleShot(1, _imageWriter, &ImageWriter::startWrite);
+    QTimer::singleShot(parser.isSet("cache-peers") ? kCachePeerDiscoveryMs : 1, _imageWriter, &ImageWriter::startWrite);
+    return _app->exec();
+}
+
+void Cli::_createImageWriter(bool debug)
+{
+    _imageWriter = new ImageWriter;
+    connect(_imageWriter, &ImageWriter::success, this, &Cli::onSuccess);
+    connect(_imageWriter, &ImageWriter::error, this, &Cli::onError);
+    connect(_imageWriter, &ImageWriter::preparationStatusUpdate, this, &Cli::onPreparationStatusUpdate);
+    connect(_imageWriter, &ImageWriter::downloadProgress, this, &Cli::onDownloadProgress);
+    connect(_imageWriter, &ImageWriter::verifyProgress, this, &Cli::onVerifyProgress);
+    connect(_imageWriter, &ImageWriter::additionalDstProgress, this, &Cli::onAdditionalDstProgress);
+    connect(_imageWriter, &ImageWriter::additionalDstFinished, this, &Cli::onAdditionalDstFinished);
+
+    if (_jsonProgress)
+    {
+        _jsonClock.start();
+        connect(_imageWriter, &ImageWriter::writeProgress, this, [this](QVariant now, QVariant total) {
+            _jsonPhaseProgress("write", now.toULongLong(), total.toULongLong());
+        });
+        connect(_imageWriter, &ImageWriter::bottleneckStateChanged, this, [this](QVariant state, QVariant throughputKBps) {
+            _jsonBottleneckKBps = throughputKBps.toULongLong();
+            if (state.toString() == _jsonBottleneck)
+                return;  // Throughput update only
+            _jsonBottleneck = state.toString();
+            QJsonObject event;
+            event["event"] = "bottleneck";
+            event["state"] = _jsonBottleneck;
+            event["throughputKBps"] = static_cast<qint64>(_jsonBottleneckKBps);
+            _emitJson(event);
+        });
+        connect(_imageWriter, &ImageWriter::timeRemainingChanged, this, [this](QVariant seconds, QVariant limitedBy) {
+            _jsonEtaSeconds = seconds.toUInt();
+            _jsonEtaLimitedBy = limitedBy.toString();
+        });
+    }
+
+    if (!debug)
+    {
+        qInstallMessageHandler(devnullMsgHandler);
+    }
+}
+
+bool Cli::_checkRemovable(const QStringList &dsts)
+{
+    DriveListModel dlm;
+    dlm.processDriveList(Drivelist::ListStorageDevices() );
+    int numDrives = dlm.rowCount( QModelIndex() );
+    QString missingDrive;
+
+    for (const QString &dst : dsts)
+    {
+        if (rpi_imager::MemoryFileOperations::IsMemoryTarget(dst.toStdString()))
+            continue;
+
+        bool foundDrive = false;
+        for (int i = 0; i < numDrives; i++)
+        {
+            if (dlm.index(i, 0).data(dlm.deviceRole) == dst)
+            {
+                foundDrive = true;
+                break;
+            }
+        }
+        if (!foundDrive)
+        {
+            missingDrive = dst;
+            break;
+        }
+    }
+
+    if (!missingDrive.isEmpty())
+    {
+        std::cerr << "Destination drive " << missingDrive.toStdString() << " is not in list of removable volumes. Choose one of the following:" << std::endl << std::endl;
+
+        for (int i = 0; i < numDrives; i++)
+        {
+            QModelIndex idx = dlm.index(i, 0);
+            QByteArray line = idx.data(dlm.deviceRole).toByteArray()+" ("+idx.data(dlm.descriptionRole).toByteArray()+")";
+
+            std::cerr << line.constData() << std::endl;
+        }
+
+        std::cerr << std::endl << "Or use --enable-writing-system-drives to overrule." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int Cli::_runBenchmark(const QCommandLineParser &parser)
+{
+    const QStringList args = parser.positionalArguments();
+    const bool fanOut = args.count() > 2 || !parser.value("benchmark-fanout").isEmpty();
+    if (args.isEmpty() || (args.count() > 2 && !fanOut))
+    {
+        std::cerr << "Usage: --benchmark [src] dst [dst...]" << std::endl;
+        return 1;
+    }
+
+    if (!parser.isSet("debug"))
+    {
+        qInstallMessageHandler(devnullMsgHandler);
+    }
+    _quiet = parser.isSet("quiet");
+
+    WriteBenchmark::Options options = WriteBenchmark::defaultOptions();
+    options.target = args.last();
+    if (args.count() >= 2)
+    {
+        options.source = args.first();
+    }
+    if (fanOut)
+    {
+        options.fanOutTargets = args.count() >= 2 ? args.mid(1) : args;
+    }
+    options.hash = !parser.isSet("benchmark-no-hash");
+
+    auto parseSizes = [&parser](const QString &name, QList<quint64> &out, bool allowZero) {
+        if (parser.value(name).isEmpty())
+            return true;
+        out.clear();
+        for (const QString &item : parser.value(name).split(',', Qt::SkipEmptyParts))
+        {
+            const quint64 size = WriteBenchmark::parseByteSize(item);
+            if (size == 0 && !(allowZero && item.trimmed() == "0"))
+            {
+                std::cerr << "Error: invalid size in --" << name.toStdString() << ": " << item.toStdString() << std::endl;
+                return false;
+            }
+            out.append(size);
+        }
+        return true;
+    };
+
+    if (!parseSizes("benchmark-buffer-sizes", options.bufferSizes, false)
+        || !parseSizes("benchmark-sync-intervals", options.syncIntervals, true))
+    {
+        return 1;
+    }
+    if (!parser.value("benchmark-size").isEmpty())
+    {
+        options.bytesPerRun = WriteBenchmark::parseByteSize(parser.value("benchmark-size"));
+        if (!options.bytesPerRun)
+        {
+            std::cerr << "Error: invalid --benchmark-size" << std::endl;
+            return 1;
+        }
+    }
+    if (!parser.value("benchmark-queue-depths").isEmpty())
+    {
+        options.queueDepths.clear();
+        for (const QString &item : parser.value("benchmark-queue-depths").split(',', Qt::SkipEmptyParts))
+        {
+            bool ok = false;
+            const int depth = item.trimmed().toInt(&ok);
+            if (!ok || depth < 1)
+            {
+                std::cerr << "Error: invalid queue depth: " << item.toStdString() << std::endl;
+                return 1;
+            }
+            options.queueDepths.append(depth);
+        }
+    }
+    if (!parser.value("benchmark-direct-io").isEmpty())
+    {
+        options.directIO.clear();
+        for (const QString &item : parser.value("benchmark-direct-io").split(',', Qt::SkipEmptyParts))
+        {
+            const QString mode = item.trimmed().toLower();
+            if (mode != "on" && mode != "off")
+            {
+                std::cerr << "Error: direct I/O mode must be on or off: " << item.toStdString() << std::endl;
+                return 1;
+            }
+            options.directIO.append(mode == "on");
+        }
+    }
+
+    if (!parser.value("benchmark-fanout").isEmpty())
+    {
+        for (const QString &item : parser.value("benchmark-fanout").split(',', Qt::SkipEmptyParts))
+        {
+            bool ok = false;
+            const int count = item.trimmed().toInt(&ok);
+            if (!ok || count < 1)
+            {
+                std::cerr << "Error: invalid target count: " << item.toStdString() << std::endl;
+                return 1;
+            }
+            options.fanOutCounts.append(count);
+        }
+    }
+
+    // Writing to a device needs the same privileges and safety check as an image write
+    QStringList devices;
+    for (const QString &target : fanOut ? options.fanOutTargets : QStringList{options.target})
+    {
+        if (WriteBenchmark::isDeviceTarget(target))
+            devices.append(target);
+    }
+    if (!devices.isEmpty())
+    {
+        if (!PlatformQuirks::hasElevatedPrivileges())
+        {
+            std::cerr << "ERROR: Benchmarking a storage device requires elevated privileges." << std::endl;
+            return 1;
+        }
+        if (parser.isSet("enable-writing-system-drives"))
+        {
+            std::cerr << "WARNING: writing to system drives is enabled." << std::endl;
+        }
+        else if (!_checkRemovable(devices))
+        {
+            return 1;
+        }
+    }
+
+    WriteBenchmark benchmark(options);
+    const QJsonDocument report = benchmark.run([this](const QString &status) {
+        if (!_quiet)
+        {
+            _clearLine();
+            std::cerr << "  " << status.toStdString() << std::endl;
+        }
+    });
+    if (report.isNull())
+    {
+        std::cerr << "Error: " << benchmark.errorString().toStdString() << std::endl;
+        return 1;
+    }
+
+    std::cout << report.toJson(QJsonDocument::Indented).constData();
+
+    for (const auto &run : report.object().value("runs").toArray())
+    {
+        if (!run.toObject().value("success").toBool())
+            return 1;
+    }
+    return 0;
+}
+
+int Cli::_runBackup(const QCommandLineParser &parser)
+{
+    const QStringList args = parser.positionalArguments();
+    if (args.count() != 2)
+    {
+        std::cerr << "Usage: --backup src dst.img.zst" << std::endl;
+        return 1;
+    }
+
+    if (!parser.isSet("debug"))
+    {
+        qInstallMessageHandler(devnullMsgHandler);
+    }
+    _quiet = parser.isSet("quiet");
+
+    DeviceBackup::Options options;
+    options.source = args[0];
+    options.output = args[1];
+    options.bmap = parser.value("backup-bmap");
+    options.allBlocks = parser.isSet("clone-all-blocks");
+    if (!parser.value("backup-level").isEmpty())
+    {
+        bool ok = false;
+        options.compressionLevel = parser.value("backup-level").toInt(&ok);
+        if (!ok || options.compressionLevel < 1 || options.compressionLevel > DeviceBackup::kMaxLevel)
+        {
+            std::cerr << "Error: --backup-level must be between 1 and " << DeviceBackup::kMaxLevel << std::endl;
+            return 1;
+        }
+    }
+
+    if (!QFileInfo::exists(options.source))
+    {
+        std::cerr << "Error: source device does not exist" << std::endl;
+        return 1;
+    }
+    if (WriteBenchmark::isDeviceTarget(options.source) && !PlatformQuirks::hasElevatedPrivileges())
+    {
+        std::cerr << "Error: reading storage devices requires elevated privileges" << std::endl;
+        return 1;
+    }
+
+    DeviceBackup backup(options);
+    const bool ok = backup.run([this](quint64 now, quint64 total) {
+        _printProgress("Reading", now, total);
+    });
+    _clearLine();
+    if (!ok)
+    {
+        std::cerr << "Error: " << backup.errorString().toStdString() << std::endl;
+        return 1;
+    }
+
+    if (!_quiet)
+    {
+        const QJsonObject report = backup.report();
+        std::cerr << "Backed up " << report.value("readBytes").toInteger() / (1024 * 1024) << " MB of "
+                  << report.value("imageBytes").toInteger() / (1024 * 1024) << " MB to "
+                  << report.value("compressedBytes").toInteger() / (1024 * 1024) << " MB in "
+                  << report.value("image").toString().toStdString() << " and "
+                  << report.value("bmap").toString().toStdString() << std::endl;
+    }
+    return 0;
+}
+
+int Cli::_runManifest(const QCommandLineParser &parser)
+{
+    if (!parser.positionalArguments().isEmpty())
+    {
+        std::cerr << "Usage: --manifest file (images and devices come from the manifest)" << std::endl;
+        return 1;
+    }
+    _quiet = parser.isSet("quiet") || _jsonProgress;
+
+    BatchManifest manifest;
+    if (!manifest.load(parser.value("manifest")))
+    {
+        std::cerr << "Error: " << manifest.errorString().toStdString() << std::endl;
+        return 1;
+    }
+
+    // "match" rules only pick drives that may be written without
+    // --enable-writing-system-drives
+    QList<BatchManifest::Drive> drives;
+    DriveListModel dlm;
+    dlm.processDriveList(Drivelist::ListStorageDevices());
+    for (int i = 0; i < dlm.rowCount(QModelIndex()); i++)
+    {
+        const QModelIndex idx = dlm.index(i, 0);
+        if (idx.data(dlm.isReadOnlyRole).toBool() || idx.data(dlm.isSystemRole).toBool())
+            continue;
+        drives.append({idx.data(dlm.deviceRole).toString(), idx.data(dlm.descriptionRole).toString(),
+                       idx.data(dlm.sizeRole).toULongLong()});
+    }
+
+    _batchWrites = manifest.plan(drives);
+    if (_batchWrites.isEmpty())
+    {
+        std::cerr << "Error: " << manifest.errorString().toStdString() << std::endl;
+        return 1;
+    }
+
+    QStringList dsts;
+    for (const auto &write : std::as_const(_batchWrites))
+        dsts += write.devices;
+    const bool memoryTargetsOnly = std::all_of(dsts.cbegin(), dsts.cend(), [](const QString &dst) {
+        return rpi_imager::MemoryFileOperations::IsMemoryTarget(dst.toStdString());
+    });
+    if (!memoryTargetsOnly && !PlatformQuirks::hasElevatedPrivileges())
+    {
+        std::cerr << "ERROR: Writing to storage devices requires elevated privileges." << std::endl;
+        return 1;
+    }
+    if (parser.isSet("enable-writing-system-drives"))
+    {
+        std::cerr << "WARNING: writing to system drives is enabled." << std::endl;
+    }
+    else if (!_checkRemovable(dsts))
+    {
+        return 1;
+    }
+
+    _createImageWriter(parser.isSet("debug"));
+    _imageWriter->setEraseBeforeWrite(parser.isSet("erase-before-write"));
+    _imageWriter->setSetting("eject", !parser.isSet("disable-eject"));
+    if (!applyDownloadRateLimit(parser, _imageWriter))
+    {
+        return 1;
+    }
+
+    if (parser.isSet("cache-peers"))
+    {
+        _imageWriter->setCachePeersEnabled(true);
+    }
+
+    // The image of a later write downloads into the cache while this one
+    // verifies and finishes
+    connect(_imageWriter, &ImageWriter::writeStateChanged, this, [this]() {
+        const ImageWriter::WriteState state = _imageWriter->writeState();
+        if (state != ImageWriter::WriteState::Verifying && state != ImageWriter::WriteState::Finalizing)
+            return;
+        const QString current = _batchWrites[_batchIndex].job.image;
+        for (qsizetype i = _batchIndex + 1; i < _batchWrites.size(); i++)
+        {
+            const BatchManifest::Job &job = _batchWrites[i].job;
+            if (job.image != current && job.isUrl() && !job.sha256.isEmpty())
+            {
+                _imageWriter->prefetchNext(QUrl(job.image), 0, job.sha256);
+                return;
+            }
+        }
+    });
+
+    _batchTimer.start();
+    QTimer::singleShot(parser.isSet("cache-peers") ? kCachePeerDiscoveryMs : 1, this, &Cli::_startNextBatchWrite);
+    const int result = _app->exec();
+
+    QJsonObject report;
+    report["jobs"] = _batchReport;
+    report["seconds"] = _batchTimer.elapsed() / 1000.0;
+    if (_jsonProgress)
+    {
+        report["event"] = "report";
+        _emitJson(report);
+    }
+    else
+    {
+        std::cout << QJsonDocument(report).toJson(QJsonDocument::Indented).constData();
+    }
+    return result;
+}
+
+int Cli::_compareSessions(const QCommandLineParser &parser)
+{
+    const QStringList files = parser.positionalArguments();
+    if (files.count() < 2)
+    {
+        std::cerr << "Usage: --compare-sessions baseline.json session.json [session.json...]" << std::endl;
+        return 1;
+    }
+
+    SessionComparison comparison;
+    for (const QString &file : files)
+    {
+        if (!comparison.load(file))
+        {
+            std::cerr << "Error: " << comparison.errorString().toStdString() << std::endl;
+            return 1;
+        }
+    }
+
+    // Exit status 2 flags regressions to scripts
+    const QJsonObject report = comparison.report();
+    std::cout << QJsonDocument(report).toJson(QJsonDocument::Indented).constData();
+    return report.value("regressionCount").toInt() > 0 ? 2 : 0;
+}
+
+int Cli::_serveCache(const QCommandLineParser &parser)
+{
+    _createImageWriter(parser.isSet("debug"));
+    _imageWriter->setCachePeerServing(true);
+    if (!_imageWriter->getCachePeerServing())
+    {
+        std::cerr << "Error: cannot serve the download cache (see --debug)" << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Serving the download cache to the local network. Press Ctrl+C to stop." << std::endl;
     return _app->exec();
 }
 
+int Cli::_runDaemon(const QCommandLineParser &parser)
+{
+    if (!parser.positionalArguments().isEmpty())
+    {
+        std::cerr << "Usage: --daemon socket (images and devices come from requests)" << std::endl;
+        return 1;
+    }
+
+    int slots = 4;
+    if (!parser.value("daemon-slots").isEmpty())
+    {
+        bool ok = false;
+        slots = parser.value("daemon-slots").toInt(&ok);
+        if (!ok || slots < 1)
+        {
+            std::cerr << "Error: --daemon-slots must be a positive number" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!PlatformQuirks::hasElevatedPrivileges())
+    {
+        std::cerr << "ERROR: Writing to storage devices requires elevated privileges." << std::endl;
+        return 1;
+    }
+    const bool allowSystemDrives = parser.isSet("enable-writing-system-drives");
+    if (allowSystemDrives)
+    {
+        std::cerr << "WARNING: writing to system drives is enabled." << std::endl;
+    }
+
+    if (!parser.isSet("debug"))
+    {
+        qInstallMessageHandler(devnullMsgHandler);
+    }
+
+    JobServer *server = new JobServer(slots, allowSystemDrives, this);
+    for (ImageWriter *imageWriter : server->imageWriters())
+    {
+        imageWriter->setEraseBeforeWrite(parser.isSet("erase-before-write"));
+        imageWriter->setSetting("eject", !parser.isSet("disable-eject"));
+        if (parser.isSet("cache-peers"))
+        {
+            imageWriter->setCachePeersEnabled(true);
+        }
+        if (!applyDownloadRateLimit(parser, imageWriter))
+        {
+            return 1;
+        }
+    }
+
+    if (!server->listen(parser.value("daemon")))
+    {
+        std::cerr << "Error: cannot listen on " << parser.value("daemon").toStdString() << ": "
+                  << server->errorString().toStdString() << std::endl;
+        return 1;
+    }
+
+    if (!parser.isSet("quiet"))
+    {
+        std::cerr << "Waiting for writes on " << parser.value("daemon").toStdString()
+                  << " (" << slots << " at a time). Press Ctrl+C to stop." << std::endl;
+    }
+    return _app->exec();
+}
+
+void Cli::_startNextBatchWrite()
+{
+    if (++_batchIndex >= _batchWrites.size())
+    {
+        _app->exit(_batchFailed ? 1 : 0);
+        return;
+    }
+
+    const BatchManifest::Write &write = _batchWrites[_batchIndex];
+    const BatchManifest::Job &job = write.job;
+    if (!_quiet)
+    {
+        _clearLine();
+        std::cerr << "Writing " << job.image.toStdString() << " to " << write.devices.join(", ").toStdString() << std::endl;
+    }
+
+    JobServer::configureWrite(_imageWriter, write);
+    _additionalPercent.clear();
+    for (const QString &dst : write.devices.mid(1))
+        _additionalPercent.insert(dst, 0);
+    _lastPercent = -1;
+    _lastMsg.clear();
+
+    _batchResults.clear();
+    _jsonPhases.clear();
+    _jsonBottleneck.clear();
+    _batchWriteTimer.start();
+    _imageWriter->startWrite();
+}
+
+void Cli::_batchDeviceFinished(const QString &device, bool success, const QString &msg)
+{
+    if (_batchResults.contains(device))
+        return;
+
+    QJsonObject result;
+    result["device"] = device;
+    result["success"] = success;
+    if (!msg.isEmpty())
+        result["message"] = msg;
+    result["seconds"] = _batchWriteTimer.elapsed() / 1000.0;
+    _batchResults.insert(device, result);
+}
+
+/*
+ * The primary device finished (error is empty on success). Additional
+ * devices have all reported by now, except after an error, and the
+ * results are reported per job.
+ */
+void Cli::_finishBatchWrite(const QString &error)
+{
+    const BatchManifest::Write &write = _batchWrites[_batchIndex];
+    if (_batchResults.contains(write.devices[0]))
+        return;  // Already reported
+    _batchDeviceFinished(write.devices[0], error.isEmpty(), error);
+    for (const QString &device : write.devices)
+        _batchDeviceFinished(device, false, error.isEmpty() ? QString("No result") : error);
+
+    QStringList jobNames = write.jobOfDevice;
+    jobNames.removeDuplicates();
+    for (const QString &name : std::as_const(jobNames))
+    {
+        QJsonArray devices;
+        bool success = true;
+        double seconds = 0;
+        for (int i = 0; i < write.devices.size(); i++)
+        {
+            if (write.jobOfDevice[i] != name)
+                continue;
+            const QJsonObject result = _batchResults.value(write.devices[i]);
+            devices.append(result);
+            success = success && result["success"].toBool();
+            seconds = qMax(seconds, result["seconds"].toDouble());
+        }
+
+        QJsonObject job;
+        job["name"] = name;
+        job["image"] = write.job.image;
+        job["devices"] = devices;
+        job["success"] = success;
+        job["seconds"] = seconds;
+        _batchReport.append(job);
+
+        if (!success)
+            _batchFailed = true;
+        if (!_quiet)
+        {
+            _clearLine();
+            std::cerr << "Job " << name.toStdString() << (success ? " succeeded" : " failed")
+                      << " in " << seconds << " s" << std::endl;
+        }
+    }
+
+    QTimer::singleShot(1, this, &Cli::_startNextBatchWrite);
+}
+
 void Cli::onSuccess()
 {
+    _jsonFinished(QString());
     if (!_quiet)
     {
         _clearLine();
         std::cerr << "Write successful." << std::endl;
     }
+
+    if (_batchIndex >= 0)
+    {
+        _finishBatchWrite(QString());
+        return;
+    }
+
+    if (_additionalFailed)
+    {
+        std::cerr << "Error: writing failed on " << _additionalFailed << " of " << _additionalCount+1 << " devices" << std::endl;
+        _app->exit(1);
+        return;
+    }
     _app->exit(0);
 }
 
@@ -317,22 +1116,75 @@ void Cli::onError(QVariant msg)
 {
     QByteArray m = msg.toByteArray();
 
+    _jsonFinished(QString::fromUtf8(m));
     if (!_quiet)
     {
         _clearLine();
     }
     std::cerr << "Error: " << m.constData() << std::endl;
+    if (_batchIndex >= 0)
+    {
+        _finishBatchWrite(QString::fromUtf8(m));
+        return;
+    }
     _app->exit(1);
 }
 
 void Cli::onDownloadProgress(QVariant dlnow, QVariant dltotal)
 {
     _printProgress("Writing",  dlnow, dltotal);
+    _jsonPhaseProgress("download", dlnow.toULongLong(), dltotal.toULongLong());
 }
 
 void Cli::onVerifyProgress(QVariant now, QVariant total)
 {
     _printProgress("Verifying", now, total);
+    _jsonPhaseProgress("verify", now.toULongLong(), total.toULongLong());
+}
+
+void Cli::onAdditionalDstProgress(QVariant device, QVariant now, QVariant total)
+{
+    quint64 t = total.toULongLong();
+    if (t)
+    {
+        _additionalPercent[device.toString()] = static_cast<int>(now.toULongLong()*100/t);
+    }
+}
+
+void Cli::onAdditionalDstFinished(QVariant device, QVariant success, QVariant msg)
+{
+    _additionalPercent.remove(device.toString());
+    if (_jsonProgress)
+    {
+        QJsonObject event;
+        event["event"] = "device";
+        event["device"] = device.toString();
+        event["success"] = success.toBool();
+        if (!msg.toString().isEmpty())
+            event["message"] = msg.toString();
+        _emitJson(event);
+    }
+    if (_batchIndex >= 0)
+    {
+        _batchDeviceFinished(device.toString(), success.toBool(), msg.toString());
+    }
+
+    if (success.toBool())
+    {
+        if (!_quiet)
+        {
+            _clearLine();
+            std::cerr << "Write to " << device.toString().toStdString() << " successful." << std::endl;
+        }
+        return;
+    }
+
+    _additionalFailed++;
+    if (!_quiet)
+    {
+        _clearLine();
+    }
+    std::cerr << "Error on " << device.toString().toStdString() << ": " << msg.toString().toStdString() << std::endl;
 }
 
 void Cli::onPreparationStatusUpdate(QVariant msg)
@@ -358,7 +1210,13 @@ void Cli::_printProgress(const QByteArray &msg, QVariant now, QVariant total)
         int percent = n/t*100;
         if (percent != _lastPercent || msg != _lastMsg)
         {
-            QByteArray txt = QByteArray("  ")+msg+": ["+QByteArray(percent/5, '-')+'>'+QByteArray(20-percent/5, ' ')+"] "+QByteArray::number(percent)+" %\r";
+            QByteArray txt = QByteArray("  ")+msg+": ["+QByteArray(percent/5, '-')+'>'+QByteArray(20-percent/5, ' ')+"] "+QByteArray::number(percent)+" %";
+            // Additional devices write at their own pace; show how far each is
+            for (auto it = _additionalPercent.cbegin(); it != _additionalPercent.cend(); ++it)
+            {
+                txt += "  "+QFileInfo(it.key()).fileName().toUtf8()+": "+QByteArray::number(it.value())+" %";
+            }
+            txt += "\r";
             std::cerr << txt.constData();
             _lastPercent = percent;
             _lastMsg = msg;
@@ -370,3 +1228,65 @@ void Cli::_printProgress(const QByteArray &msg, QVariant now, QVariant total)
         _lastMsg = msg;
     }
 }
+
+void Cli::_emitJson(QJsonObject event)
+{
+    event["time"] = _jsonClock.elapsed() / 1000.0;
+    if (_batchIndex >= 0)
+        event["write"] = _batchIndex;
+    std::cout << QJsonDocument(event).toJson(QJsonDocument::Compact).constData() << std::endl;
+}
+
+/*
+ * At most one event per phase every kJsonProgressIntervalMs, plus one when
+ * the phase completes. Throughput is over the time since the previous event.
+ */
+void Cli::_jsonPhaseProgress(const QString &phase, quint64 now, quint64 total)
+{
+    if (!_jsonProgress)
+        return;
+
+    JsonPhase &p = _jsonPhases[phase];
+    const qint64 ms = _jsonClock.elapsed();
+    const bool finished = total && now >= total && now != p.lastBytes;
+    if (p.lastMs >= 0 && !finished && (ms - p.lastMs < kJsonProgressIntervalMs || now == p.lastBytes))
+        return;
+
+    QJsonObject event;
+    event["event"] = "progress";
+    event["phase"] = phase;
+    event["bytes"] = static_cast<qint64>(now);
+    event["total"] = static_cast<qint64>(total);
+    if (p.lastMs >= 0 && ms > p.lastMs && now >= p.lastBytes)
+        event["bytesPerSecond"] = static_cast<qint64>((now - p.lastBytes) * 1000 / quint64(ms - p.lastMs));
+    if (!_jsonBottleneck.isEmpty())
+    {
+        event["bottleneck"] = _jsonBottleneck;
+        event["bottleneckThroughputKBps"] = static_cast<qint64>(_jsonBottleneckKBps);
+    }
+    if (_jsonEtaSeconds)
+    {
+        event["etaSeconds"] = static_cast<qint64>(_jsonEtaSeconds);
+        event["etaLimitedBy"] = _jsonEtaLimitedBy;
+    }
+    event["ringBufferStalls"] = _imageWriter->performanceStats()->eventCount(PerformanceStats::EventType::RingBufferStarvation);
+    _emitJson(event);
+
+    p.lastBytes = now;
+    p.lastMs = ms;
+}
+
+/* Final event of a write, with the PerformanceStats summary (error is empty on success) */
+void Cli::_jsonFinished(const QString &error)
+{
+    if (!_jsonProgress)
+        return;
+
+    QJsonObject event;
+    event["event"] = "finished";
+    event["success"] = error.isEmpty();
+    if (!error.isEmpty())
+        event["error"] = error;
+    event["performance"] = _imageWriter->performanceStats()->exportToJson().object().value("summary");
+    _emitJson(event);
+}
@@ -3,9 +3,15 @@
 
 #include <QObject>
 #include <QVariant>
+#include <QMap>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include "batchmanifest.h"
 
 class ImageWriter;
 class QCoreApplication;
+class QCommandLineParser;
 
 class Cli : public QObject
 {
@@ -21,9 +27,48 @@ protected:
     int _lastPercent;
     QByteArray _lastMsg;
     bool _quiet;
+    QMap<QString, int> _additionalPercent;
+    int _additionalCount = 0;
+    int _additionalFailed = 0;
 
     void _printProgress(const QByteArray &msg, QVariant now, QVariant total);
     void _clearLine();
+    bool _checkRemovable(const QStringList &dsts);
+    int _runBenchmark(const QCommandLineParser &parser);
+    int _runBackup(const QCommandLineParser &parser);
+    void _createImageWriter(bool debug);
+    int _serveCache(const QCommandLineParser &parser);
+    int _runDaemon(const QCommandLineParser &parser);
+    int _compareSessions(const QCommandLineParser &parser);
+
+    // --manifest: the planned writes run one after another
+    QList<BatchManifest::Write> _batchWrites;
+    int _batchIndex = -1;
+    bool _batchFailed = false;
+    QElapsedTimer _batchTimer, _batchWriteTimer;
+    QMap<QString, QJsonObject> _batchResults;  // Per device of the current write
+    QJsonArray _batchReport;
+    int _runManifest(const QCommandLineParser &parser);
+    void _startNextBatchWrite();
+    void _batchDeviceFinished(const QString &device, bool success, const QString &msg);
+    void _finishBatchWrite(const QString &error);
+
+    // --json-progress: one JSON object per line on stdout
+    struct JsonPhase {
+        quint64 lastBytes = 0;  // At the last progress event
+        qint64 lastMs = -1;
+    };
+    static constexpr qint64 kJsonProgressIntervalMs = 500;  // Per phase
+    bool _jsonProgress = false;
+    QElapsedTimer _jsonClock;
+    QMap<QString, JsonPhase> _jsonPhases;
+    QString _jsonBottleneck;
+    quint64 _jsonBottleneckKBps = 0;
+    quint32 _jsonEtaSeconds = 0;  // From the latest time estimate, 0 if unknown
+    QString _jsonEtaLimitedBy;
+    void _emitJson(QJsonObject event);
+    void _jsonPhaseProgress(const QString &phase, quint64 now, quint64 total);
+    void _jsonFinished(const QString &error);
 
 protected slots:
     void onSuccess();
@@ -31,6 +76,8 @@ protected slots:
     void onDownloadProgress(QVariant dlnow, QVariant dltotal);
     void onVerifyProgress(QVariant now, QVariant total);
     void onPreparationStatusUpdate(QVariant msg);
+    void onAdditionalDstProgress(QVariant device, QVariant now, QVariant total);
+    void onAdditionalDstFinished(QVariant device, QVariant success, QVariant msg);
 
 signals:
 
@@ -0,0 +1,162 @@
+cmake_minimum_required(VERSION 3.22)
+
+# GenerateStaticDataTables.cmake
+# CMake script to compile the timezone, country, keymap and capital city lists
+# into constexpr tables (see staticdata.h), so the locale step does not read
+# and split text resources each time it opens.
+#
+# Each entry carries the byte offsets at which its words start (the start of
+# the text and after a space, comma, bracket or slash), which is where the
+# filter-as-you-type combo boxes match what is typed.
+#
+# Called with:
+# -DTIMEZONES_FILE=<file> -DCOUNTRIES_FILE=<file> -DKEYMAP_FILE=<file>
+# -DCAPITAL_CITIES_FILE=<file> -DOUTPUT_FILE=<file>
+
+foreach(var TIMEZONES_FILE COUNTRIES_FILE KEYMAP_FILE CAPITAL_CITIES_FILE OUTPUT_FILE)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} must be defined")
+    endif()
+endforeach()
+
+# Append text to out_var as a C++ string literal. Bytes outside printable
+# ASCII are written as octal escapes so the output does not depend on the
+# compiler's source character set.
+function(append_cpp_string_literal out_var text)
+    string(HEX "${text}" hex)
+    string(LENGTH "${hex}" hex_len)
+    set(literal "\"")
+    set(i 0)
+    while(i LESS hex_len)
+        string(SUBSTRING "${hex}" ${i} 2 byte)
+        math(EXPR value "0x${byte}")
+        if(value LESS 32 OR value GREATER 126)
+            math(EXPR d1 "${value} / 64")
+            math(EXPR d2 "(${value} / 8) % 8")
+            math(EXPR d3 "${value} % 8")
+            string(APPEND literal "\\${d1}${d2}${d3}")
+        else()
+            string(ASCII ${value} char)
+            if(char STREQUAL "\"" OR char STREQUAL "\\")
+                string(APPEND literal "\\")
+            endif()
+            string(APPEND literal "${char}")
+        endif()
+        math(EXPR i "${i} + 2")
+    endwhile()
+    string(APPEND literal "\"")
+    set(${out_var} "${${out_var}}${literal}" PARENT_SCOPE)
+endfunction()
+
+# Byte offsets of the word starts in text, appended to the shared
+# WORD_STARTS list; sets out_var to the "{text, first, count}" initializer
+function(make_entry out_var text)
+    string(LENGTH "${text}" len)
+    set(starts 0)
+    set(i 1)
+    while(i LESS len AND i LESS 256)
+        math(EXPR prev "${i} - 1")
+        string(SUBSTRING "${text}" ${prev} 1 char)
+        if(char MATCHES "[ ,()/]")
+            list(APPEND starts ${i})
+        endif()
+        math(EXPR i "${i} + 1")
+    endwhile()
+
+    list(LENGTH WORD_STARTS first)
+    list(LENGTH starts count)
+    list(APPEND WORD_STARTS ${starts})
+    set(WORD_STARTS "${WORD_STARTS}" PARENT_SCOPE)
+
+    set(entry "{")
+    append_cpp_string_literal(entry "${text}")
+    string(APPEND entry ", ${first}, ${count}}")
+    set(${out_var} "${entry}" PARENT_SCOPE)
+endfunction()
+
+# Non-empty, non-comment lines of a file, trimmed
+function(read_lines out_var path)
+    if(NOT EXISTS "${path}")
+        message(FATAL_ERROR "Static data source ${path} not found")
+    endif()
+    file(STRINGS "${path}" raw ENCODING UTF-8)
+    set(lines "")
+    foreach(line IN LISTS raw)
+        string(STRIP "${line}" line)
+        if(line STREQUAL "" OR line MATCHES "^#")
+            continue()
+        endif()
+        list(APPEND lines "${line}")
+    endforeach()
+    set(${out_var} "${lines}" PARENT_SCOPE)
+endfunction()
+
+set(WORD_STARTS "")
+
+function(make_list_table out_var name path)
+    read_lines(lines "${path}")
+    set(table "inline constexpr Entry ${name}[] = {\n")
+    foreach(line IN LISTS lines)
+        make_entry(entry "${line}")
+        string(APPEND table "    ${entry},\n")
+    endforeach()
+    string(APPEND table "};\n\n")
+    set(WORD_STARTS "${WORD_STARTS}" PARENT_SCOPE)
+    set(${out_var} "${table}" PARENT_SCOPE)
+endfunction()
+
+make_list_table(TIMEZONES_TABLE kTimezones "${TIMEZONES_FILE}")
+make_list_table(COUNTRIES_TABLE kCountries "${COUNTRIES_FILE}")
+make_list_table(KEYMAPS_TABLE kKeymapLayouts "${KEYMAP_FILE}")
+
+# CityName|CountryName|CountryCode|Timezone|Language|KeyboardLayout,
+# listed as "City (Country)" like getCapitalCitiesList() always has
+read_lines(capital_lines "${CAPITAL_CITIES_FILE}")
+set(CAPITALS_TABLE "inline constexpr CapitalCity kCapitalCities[] = {\n")
+foreach(line IN LISTS capital_lines)
+    string(REPLACE "|" ";" fields "${line}")
+    list(LENGTH fields field_count)
+    if(field_count LESS 6)
+        continue()
+    endif()
+    list(GET fields 0 city)
+    list(GET fields 1 country)
+    make_entry(entry "${city} (${country})")
+    set(row "    {${entry}")
+    foreach(index RANGE 0 5)
+        list(GET fields ${index} field)
+        string(APPEND row ", ")
+        append_cpp_string_literal(row "${field}")
+    endforeach()
+    string(APPEND CAPITALS_TABLE "${row}},\n")
+endforeach()
+string(APPEND CAPITALS_TABLE "};\n")
+
+list(LENGTH WORD_STARTS word_start_count)
+if(word_start_count EQUAL 0)
+    set(WORD_STARTS 0)
+endif()
+string(REPLACE ";" ", " word_starts "${WORD_STARTS}")
+
+set(CONTENT "\
+// Generated by GenerateStaticDataTables.cmake - do not edit
+#pragma once
+
+#include \"staticdata.h\"
+
+namespace StaticData {
+
+inline constexpr std::uint8_t kWordStarts[] = {${word_starts}};
+
+${TIMEZONES_TABLE}${COUNTRIES_TABLE}${KEYMAPS_TABLE}${CAPITALS_TABLE}
+} // namespace StaticData
+")
+
+# Only touch the header when the data changed, so nothing recompiles otherwise
+if(EXISTS "${OUTPUT_FILE}")
+    file(READ "${OUTPUT_FILE}" old)
+    if("${old}" STREQUAL "${CONTENT}")
+        return()
+    endif()
+endif()
+file(WRITE "${OUTPUT_FILE}" "${CONTENT}")
@@ -37,4 +37,10 @@
 /* Do not cache if it would bring free disk space under 5 GB */
 #define IMAGEWRITER_MINIMAL_SPACE_FOR_CACHING   5*1024*1024*1024ll
 
+/* Default size budget for cached downloads, least recently used are evicted first */
+#define IMAGEWRITER_CACHE_SIZE_BUDGET           16*1024*1024*1024ll
+
+/* Decompressed images kept in the deduplicating chunk store */
+#define IMAGEWRITER_CHUNK_STORE_VERSIONS        6
+
 #endif // CONFIG_H
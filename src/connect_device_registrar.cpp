@@ -116,7 +116,22 @@ ConnectDeviceRegistrar::Result ConnectDeviceRegistrar::registerDevice(
     const QString &boardDescription,
     const QString &serial)
 {
-    Result r;
+    const SignedRequest request = signRegistration(fb, transport, boardDescription, serial);
+    if (!request.ok) {
+        Result r;
+        r.errorMessage = request.errorMessage;
+        return r;
+    }
+    return submitRegistration(request);
+}
+
+ConnectDeviceRegistrar::SignedRequest ConnectDeviceRegistrar::signRegistration(
+    fastboot::FastbootProtocol &fb,
+    rpiboot::IUsbTransport &transport,
+    const QString &boardDescription,
+    const QString &serial) const
+{
+    SignedRequest r;
 
     if (!isEnabled()) {
         r.errorMessage = QStringLiteral("Connect API key not configured");
@@ -196,10 +211,24 @@ ConnectDeviceRegistrar::Result ConnectDeviceRegistrar::registerDevice(
         return r;
     }
 
+    r.body = body;
+    r.signature = signature.toLatin1();
+    r.ok = true;
+    return r;
+}
+
+ConnectDeviceRegistrar::Result ConnectDeviceRegistrar::submitRegistration(
+    const SignedRequest &request) const
+{
+    Result r;
+
+    // Must be the URL the device signed
+    const QString url = _baseUrl + QStringLiteral("/organisation/device-identities");
+
     qDebug() << "Connect: POSTing device identity to" << url;
-    HttpResult http = httpPost(url, body,
+    HttpResult http = httpPost(url, request.body,
                                 QByteArrayLiteral("Bearer ") + _apiKey.toUtf8(),
-                                signature.toLatin1());
+                                request.signature);
 
     if (http.httpCode < 0) {
         r.errorMessage = QStringLiteral("Network error: %1").arg(http.curlError);
@@ -260,6 +289,8 @@ ConnectDeviceRegistrar::AuthKeyResult ConnectDeviceRegistrar::requestAuthKey(
 
     CurlNetworkConfig::instance().applyCurlSettings(
         c, CurlNetworkConfig::FetchProfile::FireAndForget);
+    // 401 and 422 are explained to the user below, so keep their body
+    curl_easy_setopt(c, CURLOPT_FAILONERROR, 0L);
 
     QByteArray responseBody;
     struct curl_slist *headers = nullptr;
@@ -372,8 +403,13 @@ ConnectDeviceRegistrar::HttpResult ConnectDeviceRegistrar::httpPost(
 
     // Apply shared proxy / IPv4 / CA-bundle configuration.  Use the
     // FireAndForget profile — registration is a short one-shot request.
+    // The connection comes from the shared pool, so the registrations of
+    // a batch reuse it.  HTTP/2 is not asked for: it lower-cases header
+    // names, and the server checks the signature over them as sent.
     CurlNetworkConfig::instance().applyCurlSettings(
         c, CurlNetworkConfig::FetchProfile::FireAndForget);
+    // The status and body of a rejected request are reported, not dropped
+    curl_easy_setopt(c, CURLOPT_FAILONERROR, 0L);
 
     struct curl_slist *headers = nullptr;
     const QByteArray authHeader = QByteArrayLiteral("Authorization: ") + bearerToken;
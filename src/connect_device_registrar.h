@@ -53,6 +53,23 @@ public:
                           const QString &boardDescription,
                           const QString &serial);
 
+    // registerDevice() in two halves, so that the API request can be
+    // sent while the device is busy with something else.
+    // signRegistration() talks to the device and builds the signed
+    // request; submitRegistration() only talks to the API, and may be
+    // called from any thread.
+    struct SignedRequest {
+        bool ok = false;
+        QByteArray body;
+        QByteArray signature;
+        QString errorMessage;  // Set when ok == false
+    };
+    SignedRequest signRegistration(fastboot::FastbootProtocol &fb,
+                                   rpiboot::IUsbTransport &transport,
+                                   const QString &boardDescription,
+                                   const QString &serial) const;
+    Result submitRegistration(const SignedRequest &request) const;
+
     struct AuthKeyResult {
         bool ok = false;
         QString id;            // UUIDv4 of the auth key
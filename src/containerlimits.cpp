@@ -0,0 +1,245 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "containerlimits.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+// v1 reports "no limit" as LONG_MAX rounded down to a page
+constexpr int64_t V1_UNLIMITED_FROM = int64_t(1) << 60;
+
+std::string readFile(const std::filesystem::path &path)
+{
+    std::ifstream in(path);
+    if (!in)
+        return std::string();
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+int64_t readInt(const std::filesystem::path &path, int64_t fallback)
+{
+    const std::string text = readFile(path);
+    char *end = nullptr;
+    const long long value = std::strtoll(text.c_str(), &end, 10);
+    return end != text.c_str() ? value : fallback;
+}
+
+// The process's cgroup directory and every parent up to the mount point.
+// Without a cgroup namespace /proc/self/cgroup can name a path that is
+// not visible in the container; the mount point is the container's own
+// cgroup then.
+std::vector<std::filesystem::path> cgroupChain(const std::filesystem::path &base, const std::string &path)
+{
+    std::vector<std::filesystem::path> chain;
+    std::error_code ec;
+    const std::filesystem::path relative = std::filesystem::path(path).relative_path();
+    std::filesystem::path dir = base / relative;
+    if (relative.empty() || !std::filesystem::is_directory(dir, ec))
+        dir = base;
+    for (;;)
+    {
+        chain.push_back(dir);
+        if (dir == base || !dir.has_relative_path() || dir.parent_path() == dir)
+            break;
+        dir = dir.parent_path();
+    }
+    return chain;
+}
+
+struct CgroupPaths {
+    bool v2 = false;
+    std::string unified;   // 0::<path>
+    std::string memory;    // v1 controllers
+    std::string cpu;
+};
+
+CgroupPaths parseProcCgroup(const std::string &text)
+{
+    CgroupPaths paths;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        // hierarchy-ID:controller-list:cgroup-path
+        const size_t first = line.find(':');
+        const size_t second = first == std::string::npos ? first : line.find(':', first + 1);
+        if (second == std::string::npos)
+            continue;
+        const std::string id = line.substr(0, first);
+        const std::string controllers = line.substr(first + 1, second - first - 1);
+        const std::string path = line.substr(second + 1);
+
+        if (id == "0" && controllers.empty())
+        {
+            paths.v2 = true;
+            paths.unified = path;
+            continue;
+        }
+        std::istringstream names(controllers);
+        std::string name;
+        while (std::getline(names, name, ','))
+        {
+            if (name == "memory")
+                paths.memory = path;
+            else if (name == "cpu")
+                paths.cpu = path;
+        }
+    }
+    return paths;
+}
+
+} // namespace
+
+int64_t ContainerLimits::Limits::memoryAvailableBytes() const
+{
+    if (memoryLimitBytes == Unlimited)
+        return Unlimited;
+    if (memoryUsageBytes < 0)
+        return memoryLimitBytes;
+    const int64_t available = memoryLimitBytes - memoryUsageBytes + memoryReclaimableBytes;
+    return std::clamp<int64_t>(available, 0, memoryLimitBytes);
+}
+
+int64_t ContainerLimits::parseMemoryLimit(const std::string &text)
+{
+    if (text.compare(0, 3, "max") == 0)
+        return Unlimited;
+    char *end = nullptr;
+    const long long value = std::strtoll(text.c_str(), &end, 10);
+    if (end == text.c_str() || value <= 0 || value >= V1_UNLIMITED_FROM)
+        return Unlimited;
+    return value;
+}
+
+double ContainerLimits::parseCpuMax(const std::string &text)
+{
+    std::istringstream in(text);
+    std::string quota;
+    int64_t period = 0;
+    if (!(in >> quota >> period) || quota == "max" || period <= 0)
+        return 0;
+    const double value = std::strtod(quota.c_str(), nullptr);
+    return value > 0 ? value / static_cast<double>(period) : 0;
+}
+
+int64_t ContainerLimits::parseMemoryStat(const std::string &text, const std::string &key)
+{
+    std::istringstream in(text);
+    std::string name;
+    int64_t value = 0;
+    while (in >> name >> value)
+    {
+        if (name == key)
+            return value;
+    }
+    return 0;
+}
+
+ContainerLimits::Limits ContainerLimits::read(const std::string &cgroupRoot, const std::string &procCgroup)
+{
+    Limits limits;
+    const std::filesystem::path root(cgroupRoot);
+    const CgroupPaths paths = parseProcCgroup(readFile(procCgroup));
+    std::error_code ec;
+
+    if (paths.v2 && std::filesystem::exists(root / "cgroup.controllers", ec))
+    {
+        std::filesystem::path limitDir;
+        for (const auto &dir : cgroupChain(root, paths.unified))
+        {
+            const int64_t memoryMax = parseMemoryLimit(readFile(dir / "memory.max"));
+            if (memoryMax != Unlimited && (limits.memoryLimitBytes == Unlimited || memoryMax < limits.memoryLimitBytes))
+            {
+                limits.memoryLimitBytes = memoryMax;
+                limitDir = dir;
+            }
+            const double quota = parseCpuMax(readFile(dir / "cpu.max"));
+            if (quota > 0 && (limits.cpuQuota == 0 || quota < limits.cpuQuota))
+                limits.cpuQuota = quota;
+        }
+        if (!limitDir.empty())
+        {
+            limits.memoryUsageBytes = readInt(limitDir / "memory.current", -1);
+            limits.memoryReclaimableBytes = parseMemoryStat(readFile(limitDir / "memory.stat"), "inactive_file");
+        }
+    }
+    else
+    {
+        std::filesystem::path limitDir;
+        for (const auto &dir : cgroupChain(root / "memory", paths.memory))
+        {
+            const int64_t memoryMax = parseMemoryLimit(readFile(dir / "memory.limit_in_bytes"));
+            if (memoryMax != Unlimited && (limits.memoryLimitBytes == Unlimited || memoryMax < limits.memoryLimitBytes))
+            {
+                limits.memoryLimitBytes = memoryMax;
+                limitDir = dir;
+            }
+        }
+        if (!limitDir.empty())
+        {
+            limits.memoryUsageBytes = readInt(limitDir / "memory.usage_in_bytes", -1);
+            limits.memoryReclaimableBytes = parseMemoryStat(readFile(limitDir / "memory.stat"), "total_inactive_file");
+        }
+
+        std::filesystem::path cpuBase = root / "cpu";
+        if (!std::filesystem::is_directory(cpuBase, ec))
+            cpuBase = root / "cpu,cpuacct";
+        for (const auto &dir : cgroupChain(cpuBase, paths.cpu))
+        {
+            const int64_t quotaUs = readInt(dir / "cpu.cfs_quota_us", -1);
+            const int64_t periodUs = readInt(dir / "cpu.cfs_period_us", 0);
+            if (quotaUs <= 0 || periodUs <= 0)
+                continue;
+            const double quota = static_cast<double>(quotaUs) / static_cast<double>(periodUs);
+            if (limits.cpuQuota == 0 || quota < limits.cpuQuota)
+                limits.cpuQuota = quota;
+        }
+    }
+
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        limits.affinityCpus = CPU_COUNT(&allowed);
+#endif
+
+    return limits;
+}
+
+int ContainerLimits::cpuCount(const Limits &limits, int hardwareThreads)
+{
+    int count = std::max(1, hardwareThreads);
+    if (limits.affinityCpus > 0)
+        count = std::min(count, limits.affinityCpus);
+    if (limits.cpuQuota > 0)
+        count = std::min(count, std::max(1, static_cast<int>(std::ceil(limits.cpuQuota))));
+    return count;
+}
+
+int ContainerLimits::cpuCount()
+{
+    static const int count = [] {
+#ifdef __linux__
+        return cpuCount(read(), static_cast<int>(std::thread::hardware_concurrency()));
+#else
+        return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+#endif
+    }();
+    return count;
+}
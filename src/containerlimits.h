@@ -0,0 +1,84 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef CONTAINERLIMITS_H
+#define CONTAINERLIMITS_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Memory and CPU limits a container (cgroup) places on the process
+ *
+ * sysinfo() and the online CPU count describe the host. Inside a container
+ * on a CI imaging host the process may only get part of either: ring
+ * buffers sized to host RAM get the write OOM-killed, and a decoder with a
+ * thread per host core runs slower on a 2-CPU quota than with one thread.
+ *
+ * Limits are read from cgroup v2 (memory.max, cpu.max) or v1
+ * (memory.limit_in_bytes, cpu.cfs_quota_us / cpu.cfs_period_us), taking
+ * the lowest limit on the way from the process's cgroup up to the root.
+ * The CPU count also honours the affinity mask (taskset, cpusets).
+ * On other platforms there are no limits and cpuCount() is the number of
+ * hardware threads.
+ */
+class ContainerLimits
+{
+public:
+    static constexpr int64_t Unlimited = -1;
+
+    struct Limits {
+        int64_t memoryLimitBytes = Unlimited;
+        int64_t memoryUsageBytes = -1;      // Of the cgroup holding the memory limit, -1 if unknown
+        int64_t memoryReclaimableBytes = 0; // Inactive page cache in that usage
+        double cpuQuota = 0;                // CPUs' worth of time per period, 0 for none
+        int affinityCpus = 0;               // CPUs the process may run on, 0 if unknown
+
+        /**
+         * @brief Memory left under the limit, Unlimited without one
+         */
+        int64_t memoryAvailableBytes() const;
+    };
+
+    /**
+     * @brief Read the process's limits
+     * @param cgroupRoot Where the cgroup filesystem is mounted
+     * @param procCgroup The process's /proc/self/cgroup
+     */
+    static Limits read(const std::string &cgroupRoot = "/sys/fs/cgroup",
+                       const std::string &procCgroup = "/proc/self/cgroup");
+
+    /**
+     * @brief Threads worth running: affinity and quota, at least 1
+     *
+     * Read once and cached; use instead of QThread::idealThreadCount()
+     * when sizing thread pools.
+     */
+    static int cpuCount();
+
+    /**
+     * @brief Same from given limits and hardware thread count
+     */
+    static int cpuCount(const Limits &limits, int hardwareThreads);
+
+    /**
+     * @brief Parse memory.max (v2) or memory.limit_in_bytes (v1)
+     * @return Bytes, or Unlimited for "max" and v1's page-rounded LONG_MAX
+     */
+    static int64_t parseMemoryLimit(const std::string &text);
+
+    /**
+     * @brief Parse cpu.max, "$quota $period" or "max $period"
+     * @return CPUs' worth, 0 without a quota
+     */
+    static double parseCpuMax(const std::string &text);
+
+    /**
+     * @brief A field of memory.stat, 0 if missing
+     */
+    static int64_t parseMemoryStat(const std::string &text, const std::string &key);
+};
+
+#endif // CONTAINERLIMITS_H
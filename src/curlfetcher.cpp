@@ -5,107 +5,325 @@
 
 #include "curlfetcher.h"
 #include "curlnetworkconfig.h"
+#include "bandwidthscheduler.h"
 
-#include <QRunnable>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QList>
 #include <QPointer>
 #include <QDebug>
 #include <curl/curl.h>
 #include <cstring>
 
+namespace {
+
+// Sublists usually all live on one host; with HTTP/2 they share a single
+// connection, and the concurrency limit bounds how many are in flight on it
+constexpr long MAX_TOTAL_CONNECTIONS = 8;
+constexpr long MAX_HOST_CONNECTIONS = 4;
+constexpr int MAX_CONCURRENT_FETCHES = 6;
+
+struct FetchRequest {
+    QPointer<CurlFetcher> fetcher;  // QPointer to detect fetcher destruction
+    QUrl url;
+    QByteArray ifNoneMatch, ifModifiedSince;
+    int priority = CurlFetcher::NormalPriority;
+    bool streaming = false;
+    quint64 sequence = 0;
+};
+
+struct FetchTransfer {
+    FetchRequest request;
+    QByteArray data;
+    QByteArray etag, lastModified;
+    struct curl_slist *headers = nullptr;
+    char errorBuffer[CURL_ERROR_SIZE] = {0};
+};
+
 /**
- * Worker task that fetches data using libcurl in a thread pool.
- * Uses QPointer to safely handle case where CurlFetcher is destroyed during fetch.
+ * Runs every CurlFetcher transfer on one curl_multi handle in a dedicated
+ * thread, the same way IconMultiFetcher does for icons.
+ *
+ * Requests wait in a queue ordered by priority, then by arrival, and at most
+ * MAX_CONCURRENT_FETCHES are on the wire at once, so a burst of sublist
+ * fetches cannot hold back the one the user is waiting for.
  */
-class CurlFetchTask : public QRunnable
+class CurlFetchEngine
 {
 public:
-    CurlFetchTask(CurlFetcher *fetcher, const QUrl &url)
-        : _fetcher(fetcher), _url(url)
+    static CurlFetchEngine &instance()
     {
-        setAutoDelete(true);
+        static CurlFetchEngine engine;
+        return engine;
     }
-    
-    void run() override
+
+    ~CurlFetchEngine() { shutdown(); }
+
+    void enqueue(FetchRequest request)
     {
-        // Check if fetcher was destroyed or cancelled
-        if (!_fetcher || _fetcher->isCancelled()) {
-            deliverResult(QByteArray(), QStringLiteral("Cancelled"), QString());
+        if (_shutdown.load()) {
+            deliver(request.fetcher, QByteArray(), QStringLiteral("Cancelled"), QString());
             return;
         }
-        
-        QByteArray data;
-        QString error;
-        QString stats;
-        char errorBuffer[CURL_ERROR_SIZE] = {0};
-        
-        CURL *curl = curl_easy_init();
-        if (!curl) {
-            error = QStringLiteral("Failed to initialize curl");
-            deliverResult(data, error, stats);
+
+        QMutexLocker locker(&_mutex);
+        request.sequence = _sequence++;
+        _pending.append(std::move(request));
+        wake();
+    }
+
+    // Move a queued request ahead of (or behind) the others; requests
+    // already on the wire are unaffected
+    void setPriority(CurlFetcher *fetcher, int priority)
+    {
+        QMutexLocker locker(&_mutex);
+        for (auto &request : _pending) {
+            if (request.fetcher == fetcher)
+                request.priority = priority;
+        }
+    }
+
+    void shutdown()
+    {
+        if (_shutdown.exchange(true))
             return;
+
+        {
+            QMutexLocker locker(&_mutex);
+            wake();
+        }
+
+        if (_thread && _thread->isRunning()) {
+            _thread->wait(5000);
+            if (_thread->isRunning()) {
+                qWarning() << "CurlFetcher: Thread did not exit cleanly, terminating";
+                _thread->terminate();
+                _thread->wait();
+            }
+        }
+        delete _thread;
+        _thread = nullptr;
+    }
+
+private:
+    CurlFetchEngine()
+    {
+        _thread = QThread::create([this]() { run(); });
+        _thread->setObjectName(QStringLiteral("CurlFetcher"));
+        _thread->start();
+    }
+
+    // Must be called with _mutex held
+    void wake()
+    {
+        _hasWork.wakeAll();
+#if LIBCURL_VERSION_NUM >= 0x074400
+        if (_multi)
+            curl_multi_wakeup(_multi);
+#endif
+    }
+
+    void run()
+    {
+        CURLM *multi = curl_multi_init();
+        if (!multi) {
+            qCritical() << "CurlFetcher: Failed to initialize curl_multi";
+            return;
+        }
+        {
+            QMutexLocker locker(&_mutex);
+            _multi = multi;
+        }
+        curl_multi_setopt(_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, MAX_TOTAL_CONNECTIONS);
+        curl_multi_setopt(_multi, CURLMOPT_MAX_HOST_CONNECTIONS, MAX_HOST_CONNECTIONS);
+        curl_multi_setopt(_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+        while (!_shutdown.load()) {
+            startPending();
+
+            int runningHandles = 0;
+            CURLMcode mc = curl_multi_perform(_multi, &runningHandles);
+            if (mc != CURLM_OK)
+                qWarning() << "CurlFetcher: curl_multi_perform error:" << curl_multi_strerror(mc);
+
+            collectFinished();
+
+            int numfds = 0;
+            mc = curl_multi_poll(_multi, nullptr, 0, 100, &numfds);
+            if (mc != CURLM_OK)
+                qWarning() << "CurlFetcher: curl_multi_poll error:" << curl_multi_strerror(mc);
+
+            QMutexLocker locker(&_mutex);
+            if (_pending.isEmpty() && _active.isEmpty() && !_shutdown.load())
+                _hasWork.wait(&_mutex, 500);
+        }
+
+        for (auto it = _active.begin(); it != _active.end(); ++it) {
+            curl_multi_remove_handle(_multi, it.key());
+            finishTransfer(it.key(), it.value(), QByteArray(), QStringLiteral("Cancelled"), QString(), QString(), false);
+        }
+        _active.clear();
+
+        QList<FetchRequest> pending;
+        {
+            QMutexLocker locker(&_mutex);
+            pending.swap(_pending);
+        }
+        for (const auto &request : pending)
+            deliver(request.fetcher, QByteArray(), QStringLiteral("Cancelled"), QString());
+
+        QMutexLocker locker(&_mutex);
+        curl_multi_cleanup(_multi);
+        _multi = nullptr;
+    }
+
+    void startPending()
+    {
+        while (_active.size() < MAX_CONCURRENT_FETCHES) {
+            FetchRequest request;
+            {
+                QMutexLocker locker(&_mutex);
+                if (_pending.isEmpty())
+                    return;
+                qsizetype best = 0;
+                for (qsizetype i = 1; i < _pending.size(); ++i) {
+                    const auto &candidate = _pending.at(i);
+                    if (candidate.priority > _pending.at(best).priority ||
+                        (candidate.priority == _pending.at(best).priority &&
+                         candidate.sequence < _pending.at(best).sequence)) {
+                        best = i;
+                    }
+                }
+                request = _pending.takeAt(best);
+            }
+
+            if (!request.fetcher || request.fetcher->isCancelled()) {
+                deliver(request.fetcher, QByteArray(), QStringLiteral("Cancelled"), QString());
+                continue;
+            }
+
+            CURL *easy = curl_easy_init();
+            if (!easy) {
+                deliver(request.fetcher, QByteArray(), QStringLiteral("Failed to initialize curl"), QString());
+                continue;
+            }
+
+            auto *transfer = new FetchTransfer;
+            transfer->request = std::move(request);
+            setupTransfer(easy, transfer);
+
+            CURLMcode mc = curl_multi_add_handle(_multi, easy);
+            if (mc != CURLM_OK) {
+                qWarning() << "CurlFetcher: Failed to add handle:" << curl_multi_strerror(mc);
+                finishTransfer(easy, transfer, QByteArray(), QStringLiteral("Failed to start transfer"), QString(), QString(), false);
+                continue;
+            }
+            _active.insert(easy, transfer);
         }
-        
+    }
+
+    static void setupTransfer(CURL *curl, FetchTransfer *transfer)
+    {
         // Apply shared network configuration with SmallFile profile (JSON/sublists)
         CurlNetworkConfig::instance().applyCurlSettings(
-            curl, 
+            curl,
             CurlNetworkConfig::FetchProfile::SmallFile,
-            errorBuffer
+            transfer->errorBuffer
         );
-        
-        // Set URL
-        QByteArray urlBytes = _url.toEncoded();
+
+        // curl copies the string internally
+        QByteArray urlBytes = transfer->request.url.toEncoded();
         curl_easy_setopt(curl, CURLOPT_URL, urlBytes.constData());
-        
+
         // Set up write callback to capture response data
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &data);
-        
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer);
+
+        // Capture validators so the next fetch can be conditional
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerCallback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, transfer);
+
+        const FetchRequest &request = transfer->request;
+        if (!request.ifNoneMatch.isEmpty())
+            transfer->headers = curl_slist_append(transfer->headers, ("If-None-Match: " + request.ifNoneMatch).constData());
+        if (!request.ifModifiedSince.isEmpty())
+            transfer->headers = curl_slist_append(transfer->headers, ("If-Modified-Since: " + request.ifModifiedSince).constData());
+        if (transfer->headers)
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer->headers);
+
         // Set up progress callback for cancellation support
         curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progressCallback);
-        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, transfer);
         curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
-        
-        // Perform the request
-        CURLcode res = curl_easy_perform(curl);
-        
+    }
+
+    void collectFinished()
+    {
+        CURLMsg *msg;
+        int msgsLeft;
+        while ((msg = curl_multi_info_read(_multi, &msgsLeft))) {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            CURL *curl = msg->easy_handle;
+            const CURLcode res = msg->data.result;
+            FetchTransfer *transfer = _active.take(curl);
+            curl_multi_remove_handle(_multi, curl);
+            if (!transfer) {
+                qWarning() << "CurlFetcher: Completed transfer not found in active transfers";
+                curl_easy_cleanup(curl);
+                continue;
+            }
+            completeTransfer(curl, transfer, res);
+        }
+    }
+
+    static void completeTransfer(CURL *curl, FetchTransfer *transfer, CURLcode res)
+    {
+        const QUrl &url = transfer->request.url;
+        QString error;
+        QString stats;
         // Track the effective URL after redirects (empty string if not available)
         QString effectiveUrlStr;
-        
+        bool notModified = false;
+
         if (res == CURLE_ABORTED_BY_CALLBACK) {
             error = QStringLiteral("Cancelled");
         } else if (res != CURLE_OK) {
             // Build detailed error message
             long httpCode = 0;
             curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
-            
-            QString curlError = errorBuffer[0] ? QString::fromUtf8(errorBuffer) 
-                                               : QString::fromUtf8(curl_easy_strerror(res));
-            
+
+            QString curlError = transfer->errorBuffer[0] ? QString::fromUtf8(transfer->errorBuffer)
+                                                         : QString::fromUtf8(curl_easy_strerror(res));
+
             if (httpCode > 0) {
                 error = QString("HTTP %1: %2").arg(httpCode).arg(curlError);
             } else {
                 error = curlError;
             }
-            qDebug() << "CurlFetcher: fetch failed for" << _url.toString() << "-" << error;
+            qDebug() << "CurlFetcher: fetch failed for" << url.toString() << "-" << error;
         } else {
             // Success - get the effective URL after any redirects
             char *effectiveUrl = nullptr;
             curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effectiveUrl);
             if (effectiveUrl) {
                 // Compare raw C strings first to avoid QString construction when no redirect occurred
-                QByteArray originalUrlBytes = _url.toEncoded();
+                QByteArray originalUrlBytes = url.toEncoded();
                 if (strcmp(effectiveUrl, originalUrlBytes.constData()) != 0) {
                     effectiveUrlStr = QString::fromUtf8(effectiveUrl);
-                    qDebug() << "CurlFetcher: URL was redirected from" << _url.toString() << "to" << effectiveUrlStr;
+                    qDebug() << "CurlFetcher: URL was redirected from" << url.toString() << "to" << effectiveUrlStr;
                 }
             }
-            
+
             // Collect CURL connection timing metrics for performance analysis
             double dnsTime = 0, connectTime = 0, tlsTime = 0, startTransferTime = 0, totalTime = 0;
             curl_off_t downloadSpeed = 0;
             curl_off_t downloadSize = 0;
             long httpVersion = 0;
-            
+
             curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &dnsTime);
             curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connectTime);
             curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &tlsTime);
@@ -114,7 +332,7 @@ public:
             curl_easy_getinfo(curl, CURLINFO_SPEED_DOWNLOAD_T, &downloadSpeed);
             curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloadSize);
             curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &httpVersion);
-            
+
             const char* versionStr = "unknown";
             switch (httpVersion) {
                 case CURL_HTTP_VERSION_1_0: versionStr = "HTTP/1.0"; break;
@@ -123,7 +341,7 @@ public:
                 case CURL_HTTP_VERSION_3: versionStr = "HTTP/3"; break;
                 default: break;
             }
-            
+
             // Format stats the same way as DownloadThread for consistency
             // Use asprintf for single allocation instead of 8 arg() calls
             stats = QString::asprintf(
@@ -136,50 +354,115 @@ public:
                 static_cast<long long>(downloadSpeed / 1024),
                 static_cast<long long>(downloadSize),
                 versionStr);
-            
-            qDebug() << "CurlFetcher: fetched" << data.size() << "bytes from" << _url.host() << "using" << versionStr;
+
+            long httpCode = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+            notModified = (httpCode == 304);
+            if (notModified) {
+                qDebug() << "CurlFetcher: not modified:" << url.toString();
+            } else {
+                qDebug() << "CurlFetcher: fetched" << transfer->data.size() << "bytes from" << url.host() << "using" << versionStr;
+            }
         }
-        
+
+        finishTransfer(curl, transfer, transfer->data, error, stats, effectiveUrlStr, notModified);
+    }
+
+    static void finishTransfer(CURL *curl, FetchTransfer *transfer, const QByteArray &data, const QString &error,
+                               const QString &stats, const QString &effectiveUrl, bool notModified)
+    {
+        deliver(transfer->request.fetcher, data, error, stats, effectiveUrl,
+                transfer->etag, transfer->lastModified, notModified);
         curl_easy_cleanup(curl);
-        deliverResult(data, error, stats, effectiveUrlStr);
+        curl_slist_free_all(transfer->headers);
+        delete transfer;
     }
-    
-private:
+
+    static void deliver(const QPointer<CurlFetcher> &fetcher, const QByteArray &data, const QString &error,
+                        const QString &stats, const QString &effectiveUrl = QString(),
+                        const QByteArray &etag = QByteArray(), const QByteArray &lastModified = QByteArray(),
+                        bool notModified = false)
+    {
+        // Only deliver if fetcher still exists
+        if (fetcher) {
+            QMetaObject::invokeMethod(fetcher.data(), "onFetchComplete",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(QByteArray, data),
+                                      Q_ARG(QString, error),
+                                      Q_ARG(QString, stats),
+                                      Q_ARG(QString, effectiveUrl),
+                                      Q_ARG(QByteArray, etag),
+                                      Q_ARG(QByteArray, lastModified),
+                                      Q_ARG(bool, notModified));
+        }
+    }
+
     static size_t writeCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
     {
-        auto *buffer = static_cast<QByteArray*>(userdata);
+        auto *transfer = static_cast<FetchTransfer*>(userdata);
         size_t totalSize = size * nmemb;
-        buffer->append(ptr, static_cast<qsizetype>(totalSize));
+        BandwidthScheduler::instance().acquire(BandwidthScheduler::Priority::Interactive, static_cast<qint64>(totalSize));
+        transfer->data.append(ptr, static_cast<qsizetype>(totalSize));
+        if (transfer->request.streaming && transfer->request.fetcher) {
+            // Queued ahead of onFetchComplete, so chunks arrive before finished()
+            QMetaObject::invokeMethod(transfer->request.fetcher.data(), "onDataReceived",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(QByteArray, QByteArray(ptr, static_cast<qsizetype>(totalSize))));
+        }
         return totalSize;
     }
-    
-    static int progressCallback(void *clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+
+    static size_t headerCallback(char *buffer, size_t size, size_t nitems, void *userdata)
     {
-        auto *task = static_cast<CurlFetchTask*>(clientp);
-        // Return non-zero to abort the transfer if fetcher is gone or cancelled
-        if (!task->_fetcher) {
-            return 1;  // Fetcher destroyed, abort
+        auto *transfer = static_cast<FetchTransfer*>(userdata);
+        const size_t totalSize = size * nitems;
+        const QByteArray line = QByteArray(buffer, static_cast<qsizetype>(totalSize)).trimmed();
+
+        // Redirect responses come first; keep only the final response's headers
+        if (line.startsWith("HTTP/")) {
+            transfer->etag.clear();
+            transfer->lastModified.clear();
+        } else {
+            const qsizetype colon = line.indexOf(':');
+            if (colon > 0) {
+                const QByteArray name = line.left(colon).trimmed().toLower();
+                if (name == "etag")
+                    transfer->etag = line.mid(colon + 1).trimmed();
+                else if (name == "last-modified")
+                    transfer->lastModified = line.mid(colon + 1).trimmed();
+            }
         }
-        return task->_fetcher->isCancelled() ? 1 : 0;
+        return totalSize;
     }
-    
-    void deliverResult(const QByteArray &data, const QString &error, const QString &stats, const QString &effectiveUrl = QString())
+
+    static int progressCallback(void *clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
     {
-        // Only deliver if fetcher still exists
-        if (_fetcher) {
-            QMetaObject::invokeMethod(_fetcher.data(), "onFetchComplete",
-                                      Qt::QueuedConnection,
-                                      Q_ARG(QByteArray, data),
-                                      Q_ARG(QString, error),
-                                      Q_ARG(QString, stats),
-                                      Q_ARG(QString, effectiveUrl));
+        auto *transfer = static_cast<FetchTransfer*>(clientp);
+        // Return non-zero to abort the transfer if fetcher is gone or cancelled
+        const QPointer<CurlFetcher> &fetcher = transfer->request.fetcher;
+        if (!fetcher) {
+            return 1;  // Fetcher destroyed, abort
         }
+        return fetcher->isCancelled() ? 1 : 0;
     }
-    
-    QPointer<CurlFetcher> _fetcher;  // QPointer to detect fetcher destruction
-    QUrl _url;
+
+    QThread *_thread = nullptr;
+
+    // Only accessed from _thread, except for curl_multi_wakeup under _mutex
+    CURLM *_multi = nullptr;
+    QHash<CURL*, FetchTransfer*> _active;
+
+    // Protected by _mutex
+    QList<FetchRequest> _pending;
+    quint64 _sequence = 0;
+
+    QMutex _mutex;
+    QWaitCondition _hasWork;
+    std::atomic<bool> _shutdown{false};
 };
 
+} // namespace anonymous
+
 // ----------------------------------------------------------------------------
 // CurlFetcher
 // ----------------------------------------------------------------------------
@@ -205,16 +488,48 @@ void CurlFetcher::fetch(const QUrl &url)
                                   Q_ARG(QByteArray, QByteArray()),
                                   Q_ARG(QString, QStringLiteral("Unsupported URL scheme")),
                                   Q_ARG(QString, QString()),
-                                  Q_ARG(QString, QString()));
+                                  Q_ARG(QString, QString()),
+                                  Q_ARG(QByteArray, QByteArray()),
+                                  Q_ARG(QByteArray, QByteArray()),
+                                  Q_ARG(bool, false));
         return;
     }
     
     _url = url;
     _cancelled.store(false, std::memory_order_relaxed);
     
-    // Start fetch in dedicated network thread pool (not global pool)
-    auto *task = new CurlFetchTask(this, url);
-    CurlNetworkConfig::instance().networkThreadPool()->start(task);
+    // Without a cached body there is nothing to fall back on for a 304
+    FetchRequest request;
+    request.fetcher = this;
+    request.url = url;
+    request.priority = _priority;
+    request.streaming = _streaming;
+    if (!_cachedBody.isEmpty()) {
+        request.ifNoneMatch = _cachedEtag;
+        request.ifModifiedSince = _cachedLastModified;
+    }
+    CurlFetchEngine::instance().enqueue(std::move(request));
+}
+
+void CurlFetcher::setPriority(int priority)
+{
+    if (_priority == priority)
+        return;
+    _priority = priority;
+    if (!_url.isEmpty())
+        CurlFetchEngine::instance().setPriority(this, priority);
+}
+
+void CurlFetcher::shutdown()
+{
+    CurlFetchEngine::instance().shutdown();
+}
+
+void CurlFetcher::setCachedResponse(const QByteArray &cachedBody, const QByteArray &etag, const QByteArray &lastModified)
+{
+    _cachedBody = cachedBody;
+    _cachedEtag = etag;
+    _cachedLastModified = lastModified;
 }
 
 void CurlFetcher::cancel()
@@ -222,8 +537,19 @@ void CurlFetcher::cancel()
     _cancelled.store(true, std::memory_order_relaxed);
 }
 
-void CurlFetcher::onFetchComplete(const QByteArray &data, const QString &errorMsg, const QString &stats, const QString &effectiveUrl)
+void CurlFetcher::onDataReceived(const QByteArray &chunk)
 {
+    if (!isCancelled())
+        emit dataReceived(chunk, _url);
+}
+
+void CurlFetcher::onFetchComplete(const QByteArray &data, const QString &errorMsg, const QString &stats, const QString &effectiveUrl,
+                                  const QByteArray &etag, const QByteArray &lastModified, bool notModified)
+{
+    _responseEtag = etag;
+    _responseLastModified = lastModified;
+    _notModified = notModified && !_cachedBody.isEmpty();
+    
     // Emit connection stats if available (for performance tracking)
     if (!stats.isEmpty()) {
         emit connectionStats(stats, _url);
@@ -234,7 +560,7 @@ void CurlFetcher::onFetchComplete(const QByteArray &data, const QString &errorMs
     } else {
         // Use effective URL if available, otherwise fall back to original URL
         QUrl finalUrl = effectiveUrl.isEmpty() ? _url : QUrl(effectiveUrl);
-        emit finished(data, _url, finalUrl);
+        emit finished(_notModified ? _cachedBody : data, _url, finalUrl);
     }
     
     // Auto-delete after delivering result
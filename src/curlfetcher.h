@@ -17,6 +17,10 @@
  * Fetches data from a URL in a background thread and emits signals when complete.
  * Respects the shared CurlNetworkConfig settings (IPv4-only mode, proxy, etc.)
  * 
+ * All fetchers share one curl_multi handle, so requests to the same host are
+ * multiplexed over a single HTTP/2 connection. A bounded number of fetches run
+ * at once; the rest wait in a queue ordered by priority.
+ * 
  * Usage:
  *   auto *fetcher = new CurlFetcher(this);
  *   connect(fetcher, &CurlFetcher::finished, this, &MyClass::onDataReceived);
@@ -26,12 +30,28 @@
  * Cancellation:
  *   fetcher->cancel();  // Will emit error("Cancelled", url) when the fetch stops
  * 
+ * Revalidation:
+ *   fetcher->setCachedResponse(body, etag, lastModified);  // before fetch()
+ *   // On 304 Not Modified, finished() delivers the cached body
+ * 
+ * Priority:
+ *   fetcher->setPriority(CurlFetcher::HighPriority);  // before or after fetch()
+ * 
+ * Streaming:
+ *   fetcher->setStreaming(true);  // before fetch(); dataReceived() per chunk
+ * 
  * The fetcher auto-deletes after emitting finished or error.
  */
 class CurlFetcher : public QObject
 {
     Q_OBJECT
 public:
+    enum Priority {
+        LowPriority = 0,
+        NormalPriority = 1,
+        HighPriority = 2
+    };
+    
     explicit CurlFetcher(QObject *parent = nullptr);
     ~CurlFetcher() override;
     
@@ -45,6 +65,42 @@ public:
      */
     void fetch(const QUrl &url);
     
+    /**
+     * Revalidate a previously fetched copy instead of downloading it again.
+     * 
+     * The request carries If-None-Match / If-Modified-Since built from the
+     * validators; if the server answers 304 Not Modified, finished() is
+     * emitted with cachedBody and wasNotModified() returns true.
+     */
+    void setCachedResponse(const QByteArray &cachedBody, const QByteArray &etag, const QByteArray &lastModified);
+    
+    /**
+     * Validators the server sent with the response (valid in finished())
+     */
+    QByteArray etag() const { return _responseEtag; }
+    QByteArray lastModified() const { return _responseLastModified; }
+    bool wasNotModified() const { return _notModified; }
+    
+    /**
+     * Set where this fetch sits in the shared queue. Takes effect while the
+     * fetch is still waiting to start; a running transfer is not affected.
+     */
+    void setPriority(int priority);
+    int priority() const { return _priority; }
+    
+    /**
+     * Also hand out the body as it arrives, through dataReceived(), so it
+     * can be parsed before the transfer ends. finished() still delivers the
+     * whole body; a 304 delivers no chunks.
+     */
+    void setStreaming(bool streaming) { _streaming = streaming; }
+    
+    /**
+     * Stop the shared transfer thread. Called during application exit;
+     * fetches still queued or running are reported as cancelled.
+     */
+    static void shutdown();
+    
     /**
      * Cancel an in-progress fetch.
      * 
@@ -86,14 +142,29 @@ signals:
      * @param url The URL that was fetched
      */
     void connectionStats(const QString &statsMetadata, const QUrl &url);
+    
+    /**
+     * Emitted for each piece of the body as it arrives, if streaming is set.
+     * Chunks from a transfer that then fails are followed by error().
+     * @param chunk The bytes received since the last emission
+     * @param url The URL that is being fetched
+     */
+    void dataReceived(const QByteArray &chunk, const QUrl &url);
 
 public slots:
     // Internal: called from worker thread
-    void onFetchComplete(const QByteArray &data, const QString &error, const QString &stats, const QString &effectiveUrl);
+    void onFetchComplete(const QByteArray &data, const QString &error, const QString &stats, const QString &effectiveUrl,
+                         const QByteArray &etag, const QByteArray &lastModified, bool notModified);
+    void onDataReceived(const QByteArray &chunk);
 
 private:
     QUrl _url;
     std::atomic<bool> _cancelled{false};
+    QByteArray _cachedBody, _cachedEtag, _cachedLastModified;
+    QByteArray _responseEtag, _responseLastModified;
+    bool _notModified = false;
+    int _priority = NormalPriority;
+    bool _streaming = false;
 };
 
 #endif // CURLFETCHER_H
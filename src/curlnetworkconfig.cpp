@@ -7,6 +7,7 @@
 #include "imager_version.h"
 #include "config.h"
 #include "platformquirks.h"
+#include <QDateTime>
 #include <QMutexLocker>
 #include <QDebug>
 #if __has_include(<QNetworkProxy>)
@@ -32,6 +33,7 @@ void CurlNetworkConfig::ensureInitialized()
             } else {
                 qDebug() << "libcurl initialized globally";
             }
+            instance()._initShare();
             _curlInitialized.store(true, std::memory_order_release);
         }
     }
@@ -66,6 +68,77 @@ CurlNetworkConfig::~CurlNetworkConfig()
     // process exit which is fine for our use case.
 }
 
+void CurlNetworkConfig::_shareLock(CURL *, curl_lock_data data, curl_lock_access, void *userptr)
+{
+    static_cast<CurlNetworkConfig *>(userptr)->_shareLocks[data].lock();
+}
+
+void CurlNetworkConfig::_shareUnlock(CURL *, curl_lock_data data, void *userptr)
+{
+    static_cast<CurlNetworkConfig *>(userptr)->_shareLocks[data].unlock();
+}
+
+void CurlNetworkConfig::_initShare()
+{
+    // Never cleaned up, like curl_global_init(): handles may use it until exit
+    CURLSH *share = curl_share_init();
+    if (!share) {
+        qWarning() << "curl_share_init failed, fetchers will not share connections";
+        return;
+    }
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &CurlNetworkConfig::_shareLock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, &CurlNetworkConfig::_shareUnlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900  // 7.57.0
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+    _share.store(share, std::memory_order_release);
+}
+
+void CurlNetworkConfig::applyShare(CURL *curl) const
+{
+    CURLSH *share = _share.load(std::memory_order_acquire);
+    if (curl && share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    }
+}
+
+void CurlNetworkConfig::preconnect(const QUrl &url)
+{
+    if (url.scheme() != "http" && url.scheme() != "https") {
+        return;
+    }
+    
+    const QString origin = url.scheme() + "://" + url.authority();
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    {
+        QMutexLocker locker(&_mutex);
+        auto it = _preconnected.find(origin);
+        if (it != _preconnected.end() && now - *it < PreconnectIntervalMs) {
+            return;
+        }
+        _preconnected.insert(origin, now);
+    }
+    
+    const QByteArray target = url.toEncoded();
+    _networkPool->start([this, target]() {
+        CURL *curl = curl_easy_init();
+        if (!curl) {
+            return;
+        }
+        // LargeFile, so that the connection matches what the download asks for (HTTP/2)
+        applyCurlSettings(curl, FetchProfile::LargeFile);
+        curl_easy_setopt(curl, CURLOPT_URL, target.constData());
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15L);
+        const CURLcode ret = curl_easy_perform(curl);
+        curl_easy_cleanup(curl);
+        qDebug() << "Preconnect to" << QUrl::fromEncoded(target).host() << ":" << curl_easy_strerror(ret);
+    });
+}
+
 QThreadPool* CurlNetworkConfig::networkThreadPool()
 {
     return _networkPool;
@@ -131,6 +204,24 @@ void CurlNetworkConfig::detectSystemProxy(const QUrl &url)
 #endif
 }
 
+bool CurlNetworkConfig::http3Available()
+{
+#ifdef CURL_VERSION_HTTP3
+    const curl_version_info_data *info = curl_version_info(CURLVERSION_NOW);
+    return info && (info->features & CURL_VERSION_HTTP3);
+#else
+    return false;
+#endif
+}
+
+long CurlNetworkConfig::largeFileHttpVersion() const
+{
+    // CURL_HTTP_VERSION_3 (unlike 3ONLY) falls back to TCP if QUIC does not connect
+    if (http3() && http3Available())
+        return CURL_HTTP_VERSION_3;
+    return CURL_HTTP_VERSION_2TLS;
+}
+
 void CurlNetworkConfig::applyCurlSettings(CURL *curl, FetchProfile profile, char *errorBuffer) const
 {
     if (!curl) return;
@@ -192,7 +283,7 @@ void CurlNetworkConfig::applyCurlSettings(CURL *curl, FetchProfile profile, char
             curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 15L);    // Send keepalive every 15s
             
             // Enable HTTP/2 for HTTPS connections (better for large transfers)
-            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, largeFileHttpVersion());
             break;
             
         case FetchProfile::FireAndForget:
@@ -225,6 +316,11 @@ void CurlNetworkConfig::applyCurlSettings(CURL *curl, FetchProfile profile, char
         }
     }
     
+    // =========================================================================
+    // DNS cache, TLS sessions and connections shared with other fetchers
+    // =========================================================================
+    applyShare(curl);
+    
     // =========================================================================
     // SSL/TLS - CA bundle for AppImage compatibility on Linux
     // =========================================================================
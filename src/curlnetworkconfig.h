@@ -7,10 +7,13 @@
 #define CURLNETWORKCONFIG_H
 
 #include <QByteArray>
+#include <QHash>
 #include <QMutex>
 #include <QThreadPool>
 #include <QUrl>
+#include <array>
 #include <atomic>
+#include <mutex>
 #include <curl/curl.h>
 
 /**
@@ -47,6 +50,19 @@ public:
     // IPv4-only mode - for users with broken IPv6 routing
     bool ipv4Only() const { return _ipv4Only.load(std::memory_order_relaxed); }
     void setIPv4Only(bool enabled) { _ipv4Only.store(enabled, std::memory_order_relaxed); }
+
+    /**
+     * HTTP/3 (QUIC) for large files - opt-in, for lossy links where one lost
+     * TCP segment stalls every HTTP/2 stream behind it. libcurl races QUIC
+     * against TCP and falls back to HTTP/2 or 1.1 if the server does not
+     * answer over QUIC. Only effective if http3Available().
+     */
+    bool http3() const { return _http3.load(std::memory_order_relaxed); }
+    void setHttp3(bool enabled) { _http3.store(enabled, std::memory_order_relaxed); }
+    // Whether this libcurl was built with HTTP/3 support (ENABLE_HTTP3)
+    static bool http3Available();
+    // The CURLOPT_HTTP_VERSION large downloads should start with
+    long largeFileHttpVersion() const;
     
     // Proxy settings
     QByteArray proxy() const;
@@ -73,11 +89,12 @@ public:
      * - Error handling (FAILONERROR)
      * - Timeouts appropriate for the profile
      * - TCP keepalive (for large files)
-     * - HTTP/2 (for large files over HTTPS)
+     * - HTTP/2 (for large files over HTTPS), or HTTP/3 if enabled
      * - IPv4-only mode (if enabled)
      * - Proxy (if configured)
      * - CA bundle (on Linux for AppImage compatibility)
      * - User agent
+     * - Shared DNS cache, TLS sessions and connections (applyShare())
      * 
      * @param curl The curl handle to configure
      * @param profile The fetch profile determining timeout behavior
@@ -85,6 +102,26 @@ public:
      */
     void applyCurlSettings(CURL *curl, FetchProfile profile = FetchProfile::SmallFile, 
                           char *errorBuffer = nullptr) const;
+
+    /**
+     * Attach the shared DNS cache, TLS session cache and connection pool.
+     *
+     * Done by applyCurlSettings(); handles set up by hand, and those made
+     * with curl_easy_duphandle() (which does not copy it), need it
+     * explicitly. Without it, each fetcher pays its own DNS lookup, TCP
+     * connect and TLS handshake to the same hosts.
+     */
+    void applyShare(CURL *curl) const;
+
+    /**
+     * Warm up the connection to the host of url in the background: a HEAD
+     * request (following redirects) leaves the address in the DNS cache,
+     * the TLS session in the session cache and the connection in the pool
+     * for the download that follows. At most once per PreconnectIntervalMs
+     * per host; does nothing for other schemes than http(s).
+     */
+    void preconnect(const QUrl &url);
+    static constexpr int PreconnectIntervalMs = 60 * 1000;
     
     /**
      * Get the dedicated thread pool for network I/O operations.
@@ -109,7 +146,14 @@ private:
     ~CurlNetworkConfig();
     
     static std::atomic<bool> _curlInitialized;
+    static void _shareLock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+    static void _shareUnlock(CURL *handle, curl_lock_data data, void *userptr);
+    void _initShare();
+    std::atomic<CURLSH *> _share{nullptr};
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> _shareLocks;
+    QHash<QString, qint64> _preconnected;  // Origin -> msecs since epoch of the last preconnect
     std::atomic<bool> _ipv4Only{false};
+    std::atomic<bool> _http3{false};
     QByteArray _proxy;
     bool _proxyDetected{false};
     QByteArray _userAgent;
@@ -660,5 +660,80 @@ QByteArray CustomisationGenerator::generateCloudInitNetworkConfig(const QVariant
     return netcfg;
 }
 
+namespace {
+
+// Neither is changed by the generators, and neither can be a real hostname or token
+const QString kHostnamePlaceholder = QStringLiteral("@rpi-imager-hostname@");
+const QString kPiConnectTokenPlaceholder = QStringLiteral("@rpi-imager-connect-token@");
+
+} // namespace
+
+QVariantMap CustomisationBundle::sharedSettings(const QVariantMap& settings) {
+    QVariantMap shared = settings;
+    shared.remove(QStringLiteral("hostname"));
+    return shared;
+}
+
+CustomisationBundle CustomisationBundle::prepare(Format format,
+                                                 const QVariantMap& settings,
+                                                 bool withPiConnectToken,
+                                                 bool hasCcRpi,
+                                                 bool sshEnabled,
+                                                 const QString& currentUser) {
+    CustomisationBundle bundle;
+    bundle._valid = true;
+    bundle._format = format;
+    bundle._settings = sharedSettings(settings);
+    bundle._hasHostname = !settings.value(QStringLiteral("hostname")).toString().trimmed().isEmpty();
+    bundle._withPiConnectToken = withPiConnectToken;
+    bundle._hasCcRpi = hasCcRpi;
+    bundle._sshEnabled = sshEnabled;
+    bundle._currentUser = currentUser;
+
+    QVariantMap s = bundle._settings;
+    if (bundle._hasHostname)
+        s.insert(QStringLiteral("hostname"), kHostnamePlaceholder);
+    const QString token = withPiConnectToken ? kPiConnectTokenPlaceholder : QString();
+
+    if (format == Format::Systemd) {
+        bundle._template.firstrun = CustomisationGenerator::generateSystemdScript(s, token);
+    } else {
+        bundle._template.userData = CustomisationGenerator::generateCloudInitUserData(s, token, hasCcRpi, sshEnabled, currentUser);
+        bundle._template.networkConfig = CustomisationGenerator::generateCloudInitNetworkConfig(s, hasCcRpi);
+    }
+    return bundle;
+}
+
+bool CustomisationBundle::matches(Format format,
+                                  const QVariantMap& settings,
+                                  bool withPiConnectToken,
+                                  bool hasCcRpi,
+                                  bool sshEnabled,
+                                  const QString& currentUser) const {
+    return _valid && _format == format && _withPiConnectToken == withPiConnectToken &&
+           _hasCcRpi == hasCcRpi && _sshEnabled == sshEnabled && _currentUser == currentUser &&
+           _hasHostname == !settings.value(QStringLiteral("hostname")).toString().trimmed().isEmpty() &&
+           _settings == sharedSettings(settings);
+}
+
+CustomisationBundle::Payload CustomisationBundle::stamp(const QString& hostname, const QString& piConnectToken) const {
+    Payload payload = _template;
+    const QByteArray host = hostname.trimmed().toUtf8();
+    QString token = piConnectToken.trimmed();
+    if (_format == Format::CloudInit)
+        token.replace("'", "'\"'\"'");  // As in generateCloudInitUserData()
+
+    auto fill = [&](QByteArray& data) {
+        if (_hasHostname)
+            data.replace(kHostnamePlaceholder.toUtf8(), host);
+        if (_withPiConnectToken)
+            data.replace(kPiConnectTokenPlaceholder.toUtf8(), token.toUtf8());
+    };
+    fill(payload.firstrun);
+    fill(payload.userData);
+    fill(payload.networkConfig);
+    return payload;
+}
+
 } // namespace rpi_imager
 
@@ -93,6 +93,76 @@ private:
     static QString yamlEscapeString(const QString& value);
 };
 
+/**
+ * @brief Customisation payloads generated once and stamped per write
+ *
+ * Writing several cards with the same settings only changes the hostname
+ * and the Raspberry Pi Connect token between them. The scripts are
+ * generated once with placeholders for those two, including any pbkdf2
+ * work for a legacy plaintext WLAN password, and stamp() fills them in.
+ * stamp() gives the same bytes as calling CustomisationGenerator directly.
+ */
+class CustomisationBundle {
+public:
+    enum class Format { Systemd, CloudInit };
+
+    struct Payload {
+        QByteArray firstrun;        // Systemd
+        QByteArray userData;        // CloudInit
+        QByteArray networkConfig;   // CloudInit
+    };
+
+    CustomisationBundle() = default;
+
+    /**
+     * @brief Generate the payloads for settings
+     *
+     * @param withPiConnectToken Whether stamp() will be given a token; the
+     * token only changes the scripts when there is one
+     * @return the bundle; the other parameters are as for CustomisationGenerator
+     */
+    static CustomisationBundle prepare(Format format,
+                                       const QVariantMap& settings,
+                                       bool withPiConnectToken,
+                                       bool hasCcRpi = false,
+                                       bool sshEnabled = false,
+                                       const QString& currentUser = QString());
+
+    /**
+     * @brief Whether prepare() with these arguments would give this bundle,
+     * for any hostname and token
+     */
+    bool matches(Format format,
+                 const QVariantMap& settings,
+                 bool withPiConnectToken,
+                 bool hasCcRpi = false,
+                 bool sshEnabled = false,
+                 const QString& currentUser = QString()) const;
+
+    bool isValid() const { return _valid; }
+
+    /**
+     * @brief The payloads with the per-device fields filled in
+     *
+     * @param hostname Hostname; only used if the settings had one
+     * @param piConnectToken Token; only used if prepared with one
+     */
+    Payload stamp(const QString& hostname, const QString& piConnectToken) const;
+
+private:
+    static QVariantMap sharedSettings(const QVariantMap& settings);
+
+    bool _valid = false;
+    Format _format = Format::Systemd;
+    QVariantMap _settings;  // Without the hostname
+    bool _hasHostname = false;
+    bool _withPiConnectToken = false;
+    bool _hasCcRpi = false;
+    bool _sshEnabled = false;
+    QString _currentUser;
+    Payload _template;
+};
+
 } // namespace rpi_imager
 
 #endif // CUSTOMIZATION_GENERATOR_H
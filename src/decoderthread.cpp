@@ -0,0 +1,125 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "decoderthread.h"
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <cstring>
+
+DecoderThread::DecoderThread(RingBuffer *input, RingBuffer::Slot *firstSlot,
+                             std::shared_ptr<RingBuffer> output, int threads, QObject *parent)
+    : QThread(parent)
+    , _input(input)
+    , _output(std::move(output))
+    , _threads(qMax(1, threads))
+    , _cancelled(false)
+    , _failed(false)
+    , _bytesConsumed(0)
+    , _inputWaitMs(0)
+    , _decodeMs(0)
+    , _parallelBlocks(0)
+    , _outSlot(nullptr)
+    , _outUsed(0)
+    , _firstSlot(firstSlot)
+{
+    _pool.setMaxThreadCount(_threads);
+}
+
+void DecoderThread::cancel()
+{
+    _cancelled = true;
+}
+
+QString DecoderThread::errorString() const
+{
+    QMutexLocker lock(&_errorMutex);
+    return _error;
+}
+
+void DecoderThread::_fail(const QString &message)
+{
+    QMutexLocker lock(&_errorMutex);
+    if (!_failed)
+    {
+        _error = message;
+        _failed = true;
+    }
+}
+
+RingBuffer::Slot *DecoderThread::_nextInput()
+{
+    if (_firstSlot)
+    {
+        RingBuffer::Slot *slot = _firstSlot;
+        _firstSlot = nullptr;
+        _bytesConsumed += slot->size;
+        return slot;
+    }
+
+    QElapsedTimer waitTimer;
+    waitTimer.start();
+    RingBuffer::Slot *slot = _input->acquireReadSlot(100);
+    while (!slot && !_cancelled && !_input->isCancelled() && !_input->isComplete() && !_input->isStallTimeoutExceeded())
+        slot = _input->acquireReadSlot(100);
+    _inputWaitMs += static_cast<quint64>(waitTimer.elapsed());
+
+    if (slot)
+        _bytesConsumed += slot->size;
+    return slot;
+}
+
+bool DecoderThread::_acquireOutput()
+{
+    if (_outSlot)
+        return true;
+
+    _outSlot = _output->acquireWriteSlot(100);
+    while (!_outSlot && !_cancelled && !_output->isCancelled() && !_output->isStallTimeoutExceeded())
+        _outSlot = _output->acquireWriteSlot(100);
+    _outUsed = 0;
+    return _outSlot != nullptr;
+}
+
+void DecoderThread::_advanceOutput(size_t n)
+{
+    _outUsed += n;
+    if (_outUsed == _outSlot->capacity)
+        _flushOutput();
+}
+
+bool DecoderThread::_emit(const char *data, size_t len)
+{
+    while (len)
+    {
+        if (!_acquireOutput())
+            return false;
+
+        size_t n = qMin(len, _outSlot->capacity - _outUsed);
+        ::memcpy(_outSlot->data + _outUsed, data, n);
+        data += n;
+        len -= n;
+        _advanceOutput(n);
+    }
+    return true;
+}
+
+void DecoderThread::_flushOutput()
+{
+    if (_outSlot && _outUsed)
+    {
+        _output->commitWriteSlot(_outSlot, _outUsed);
+        _outSlot = nullptr;
+        _outUsed = 0;
+    }
+}
+
+bool DecoderThread::_mayBeTarHeader(const char *data, size_t len)
+{
+    if (len < 512)
+        return true;
+
+    // POSIX tar
+    return ::memcmp(data + 257, "ustar", 5) == 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef DECODERTHREAD_H
+#define DECODERTHREAD_H
+
+#include <QThread>
+#include <QThreadPool>
+#include <QString>
+#include <QMutex>
+#include <atomic>
+#include <memory>
+#include "ringbuffer.h"
+
+/**
+ * @brief Base class for the native decompressors used for raw images
+ *
+ * A decoder runs on its own thread, reads compressed data from the download
+ * ring buffer and writes decompressed data into slots of the write ring
+ * buffer, without going through libarchive. Decoding of the next slot
+ * therefore overlaps with the write of the previous one. Subclasses that
+ * can split their input into independent blocks decode those on the
+ * private thread pool and deliver the output in order.
+ *
+ * The output ring buffer gets producerDone() when run() returns, whether
+ * decoding succeeded or not; check hasError() afterwards.
+ */
+class DecoderThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param input Compressed data (download ring buffer)
+     * @param firstSlot Input slot already acquired by the caller (may be null)
+     * @param output Decompressed data (write ring buffer)
+     * @param threads Maximum number of blocks decoded in parallel
+     */
+    DecoderThread(RingBuffer *input, RingBuffer::Slot *firstSlot,
+                  std::shared_ptr<RingBuffer> output, int threads, QObject *parent = nullptr);
+
+    void cancel();
+    bool hasError() const { return _failed; }
+    QString errorString() const;
+
+    quint64 bytesConsumed() const { return _bytesConsumed; }
+    quint64 inputWaitMs() const { return _inputWaitMs; }
+    quint64 decodeMs() const { return _decodeMs; }
+    int blocksDecodedInParallel() const { return _parallelBlocks; }
+
+    /**
+     * @brief Threads the decoder was created with
+     */
+    int maxThreads() const { return _threads; }
+
+    /**
+     * @brief Decode with fewer threads than maxThreads(), or all of them again
+     *
+     * For sharing cores with the rest of the write (PipelineBalancer). The
+     * number of blocks in flight stays as it is, so the output is
+     * unaffected and the decoder picks up more threads without delay.
+     */
+    void setActiveThreads(int threads) { _pool.setMaxThreadCount(qBound(1, threads, _threads)); }
+
+protected:
+    RingBuffer *_input;
+    std::shared_ptr<RingBuffer> _output;
+    int _threads;
+    QThreadPool _pool;
+
+    std::atomic<bool> _cancelled;
+    std::atomic<bool> _failed;
+    std::atomic<quint64> _bytesConsumed;
+    std::atomic<quint64> _inputWaitMs;
+    std::atomic<quint64> _decodeMs;
+    std::atomic<int> _parallelBlocks;
+
+    // Current output slot, filled up to _outUsed
+    RingBuffer::Slot *_outSlot;
+    size_t _outUsed;
+
+    /**
+     * @brief Next compressed input slot, or null at EOF, stall or cancel
+     *
+     * The caller must release the slot back to _input.
+     */
+    RingBuffer::Slot *_nextInput();
+
+    /**
+     * @brief Make sure _outSlot has room; false on cancel or stall
+     */
+    bool _acquireOutput();
+
+    /**
+     * @brief Account for n bytes decoded directly into _outSlot
+     */
+    void _advanceOutput(size_t n);
+
+    /**
+     * @brief Copy decoded data into the output ring buffer
+     */
+    bool _emit(const char *data, size_t len);
+
+    /**
+     * @brief Commit a partially filled output slot
+     */
+    void _flushOutput();
+
+    void _fail(const QString &message);
+
+    /**
+     * @brief Check whether the first decoded block is a tar header
+     *
+     * Used to leave archives to libarchive. Returns true if fewer than 512
+     * bytes could be decoded, so callers err on the side of libarchive.
+     */
+    static bool _mayBeTarHeader(const char *data, size_t len);
+
+private:
+    RingBuffer::Slot *_firstSlot;
+    mutable QMutex _errorMutex;
+    QString _error;
+};
+
+#endif // DECODERTHREAD_H
@@ -41,7 +41,13 @@ set(CURL_DISABLE_HSTS ON CACHE BOOL "" FORCE)
 set(CURL_DISABLE_IPFS ON CACHE BOOL "" FORCE)
 set(CURL_DISABLE_WEBSOCKETS ON CACHE BOOL "" FORCE)
 set(CURL_DISABLE_PROXY OFF CACHE BOOL "" FORCE)
-set(CURL_DISABLE_QUIC ON CACHE BOOL "" FORCE)
+if(ENABLE_HTTP3)
+    # Tried only when the user turns HTTP/3 on; see DownloadThread
+    set(CURL_DISABLE_QUIC OFF CACHE BOOL "" FORCE)
+    set(USE_NGTCP2 ON CACHE BOOL "" FORCE)
+else()
+    set(CURL_DISABLE_QUIC ON CACHE BOOL "" FORCE)
+endif()
 set(CURL_DISABLE_FORM_API ON CACHE BOOL "" FORCE)
 set(CURL_DISABLE_MIME ON CACHE BOOL "" FORCE)
 set(CURL_DISABLE_BINDLOCAL ON CACHE BOOL "" FORCE)
@@ -131,6 +137,7 @@ unset(CURL_DISABLE_SOCKETPAIR)
 unset(CURL_DISABLE_SRP)
 unset(CURL_DISABLE_VERBOSE_STRINGS)
 unset(USE_NGHTTP2)
+unset(USE_NGTCP2)
 unset(CURL_ZSTD)
 unset(CURL_ENABLE_EXPORT_TARGET)
 unset(CURL_DISABLE_INSTALL)
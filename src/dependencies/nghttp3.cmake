@@ -0,0 +1,26 @@
+# Remote nghttp3 (HTTP/3 framing for the bundled libcurl, ENABLE_HTTP3 only)
+
+set(NGHTTP3_VERSION "1.12.0")
+FetchContent_Declare(nghttp3
+    GIT_REPOSITORY https://github.com/ngtcp2/nghttp3.git
+    GIT_TAG        v${NGHTTP3_VERSION}
+    GIT_SUBMODULES_RECURSE ON
+    ${USE_OVERRIDE_FIND_PACKAGE}
+)
+set(ENABLE_LIB_ONLY ON)
+set(ENABLE_STATIC_LIB ON)
+set(ENABLE_SHARED_LIB OFF)
+FetchContent_GetProperties(nghttp3)
+if(NOT nghttp3_POPULATED)
+    FetchContent_Populate(nghttp3)
+    add_subdirectory(${nghttp3_SOURCE_DIR} ${nghttp3_BINARY_DIR} EXCLUDE_FROM_ALL)
+endif()
+unset(ENABLE_LIB_ONLY)
+unset(ENABLE_STATIC_LIB)
+unset(ENABLE_SHARED_LIB)
+set(NGHTTP3_LIBRARIES nghttp3_static CACHE FILEPATH "" FORCE)
+set(NGHTTP3_LIBRARY nghttp3_static CACHE FILEPATH "" FORCE)
+# nghttp3/version.h is generated into the build tree
+set(NGHTTP3_INCLUDE_DIR ${nghttp3_SOURCE_DIR}/lib/includes CACHE PATH "" FORCE)
+set(NGHTTP3_INCLUDE_DIRS ${nghttp3_SOURCE_DIR}/lib/includes ${nghttp3_BINARY_DIR}/lib/includes CACHE PATH "" FORCE)
+set(NGHTTP3_FOUND true CACHE BOOL "" FORCE)
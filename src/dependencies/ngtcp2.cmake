@@ -0,0 +1,38 @@
+# Remote ngtcp2 (QUIC for the bundled libcurl, ENABLE_HTTP3 only)
+#
+# Built against GnuTLS, the TLS backend the bundled libcurl uses on Linux.
+
+set(NGTCP2_VERSION "1.16.0")
+FetchContent_Declare(ngtcp2
+    GIT_REPOSITORY https://github.com/ngtcp2/ngtcp2.git
+    GIT_TAG        v${NGTCP2_VERSION}
+    ${USE_OVERRIDE_FIND_PACKAGE}
+)
+set(ENABLE_LIB_ONLY ON)
+set(ENABLE_STATIC_LIB ON)
+set(ENABLE_SHARED_LIB OFF)
+set(ENABLE_GNUTLS ON)
+set(ENABLE_OPENSSL OFF)
+set(ENABLE_BORINGSSL OFF)
+set(ENABLE_PICOTLS OFF)
+set(ENABLE_WOLFSSL OFF)
+FetchContent_GetProperties(ngtcp2)
+if(NOT ngtcp2_POPULATED)
+    FetchContent_Populate(ngtcp2)
+    add_subdirectory(${ngtcp2_SOURCE_DIR} ${ngtcp2_BINARY_DIR} EXCLUDE_FROM_ALL)
+endif()
+unset(ENABLE_LIB_ONLY)
+unset(ENABLE_STATIC_LIB)
+unset(ENABLE_SHARED_LIB)
+unset(ENABLE_GNUTLS)
+unset(ENABLE_OPENSSL)
+unset(ENABLE_BORINGSSL)
+unset(ENABLE_PICOTLS)
+unset(ENABLE_WOLFSSL)
+set(NGTCP2_LIBRARY ngtcp2_static CACHE FILEPATH "" FORCE)
+set(NGTCP2_CRYPTO_GNUTLS_LIBRARY ngtcp2_crypto_gnutls_static CACHE FILEPATH "" FORCE)
+set(NGTCP2_LIBRARIES ngtcp2_crypto_gnutls_static ngtcp2_static CACHE FILEPATH "" FORCE)
+# ngtcp2/version.h is generated into the build tree
+set(NGTCP2_INCLUDE_DIR ${ngtcp2_SOURCE_DIR}/lib/includes CACHE PATH "" FORCE)
+set(NGTCP2_INCLUDE_DIRS ${ngtcp2_SOURCE_DIR}/lib/includes ${ngtcp2_BINARY_DIR}/lib/includes ${ngtcp2_SOURCE_DIR}/crypto/includes CACHE PATH "" FORCE)
+set(NGTCP2_FOUND true CACHE BOOL "" FORCE)
@@ -0,0 +1,359 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "devicebackup.h"
+#include "acceleratedcryptographichash.h"
+#include "containerlimits.h"
+#include "file_operations.h"
+#include "usedblockscanner.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <zstd.h>
+
+namespace {
+    // Reads queued on the device at once; the oldest completed one is
+    // compressed while the rest are in flight
+    constexpr int READS_IN_FLIGHT = 4;
+    constexpr size_t READ_SIZE = 4 * 1024 * 1024;
+    // Zeros for free space are fed to the compressor this much at a time
+    constexpr size_t ZERO_CHUNK_SIZE = 1024 * 1024;
+
+    // Compresses the image as a series of frames of DeviceBackup::kFrameSize
+    // bytes, each with its content size, and writes them to out
+    class FrameCompressor
+    {
+    public:
+        FrameCompressor(QIODevice &out, quint64 imageSize)
+            : _out(out), _remaining(imageSize), _outBuf(ZSTD_CStreamOutSize()) {}
+        ~FrameCompressor() { ZSTD_freeCCtx(_cctx); }
+
+        bool init(int level, int threads)
+        {
+            _cctx = ZSTD_createCCtx();
+            if (!_cctx) {
+                _error = QStringLiteral("cannot create zstd context");
+                return false;
+            }
+            ZSTD_CCtx_setParameter(_cctx, ZSTD_c_compressionLevel, level);
+            ZSTD_CCtx_setParameter(_cctx, ZSTD_c_checksumFlag, 1);
+            if (ZSTD_isError(ZSTD_CCtx_setParameter(_cctx, ZSTD_c_nbWorkers, threads)))
+                qDebug() << "Backup: zstd built without threads, compressing on one core";
+            return true;
+        }
+
+        // Image data in order; ends a frame whenever one is full
+        bool add(const char *data, size_t len)
+        {
+            while (len) {
+                if (_frameLeft == 0) {
+                    _frameLeft = std::min<quint64>(DeviceBackup::kFrameSize, _remaining);
+                    ZSTD_CCtx_setPledgedSrcSize(_cctx, _frameLeft);
+                }
+                const size_t n = static_cast<size_t>(std::min<quint64>(len, _frameLeft));
+                ZSTD_inBuffer in{data, n, 0};
+                _frameLeft -= n;
+                _remaining -= n;
+                if (!_compress(in, _frameLeft == 0 ? ZSTD_e_end : ZSTD_e_continue))
+                    return false;
+                data += n;
+                len -= n;
+            }
+            return true;
+        }
+
+        quint64 written() const { return _written; }
+        QString errorString() const { return _error; }
+
+    private:
+        bool _compress(ZSTD_inBuffer &in, ZSTD_EndDirective mode)
+        {
+            for (;;) {
+                ZSTD_outBuffer out{_outBuf.data(), _outBuf.size(), 0};
+                const size_t ret = ZSTD_compressStream2(_cctx, &out, &in, mode);
+                if (ZSTD_isError(ret)) {
+                    _error = QStringLiteral("compression failed: %1").arg(ZSTD_getErrorName(ret));
+                    return false;
+                }
+                if (out.pos && _out.write(_outBuf.data(), static_cast<qint64>(out.pos)) != static_cast<qint64>(out.pos)) {
+                    _error = QStringLiteral("cannot write image: %1").arg(_out.errorString());
+                    return false;
+                }
+                _written += out.pos;
+
+                // With workers, input is only taken in; output may lag behind
+                if (mode == ZSTD_e_end ? ret == 0 : in.pos == in.size)
+                    return true;
+            }
+        }
+
+        QIODevice &_out;
+        ZSTD_CCtx *_cctx = nullptr;
+        quint64 _remaining;
+        quint64 _frameLeft = 0;
+        quint64 _written = 0;
+        std::vector<char> _outBuf;
+        QString _error;
+    };
+}
+
+QString DeviceBackup::defaultBmapPath(const QString &output)
+{
+    QString base = output;
+    if (base.endsWith(QLatin1String(".zst"), Qt::CaseInsensitive))
+        base.chop(4);
+    return base + QLatin1String(".bmap");
+}
+
+DeviceBackup::DeviceBackup(const Options &options)
+    : _options(options)
+{
+    if (_options.bmap.isEmpty())
+        _options.bmap = defaultBmapPath(_options.output);
+    if (_options.threads <= 0)
+        _options.threads = ContainerLimits::cpuCount();
+}
+
+bool DeviceBackup::run(const std::function<void(quint64 now, quint64 total)> &progress)
+{
+    _error.clear();
+    _report = QJsonObject();
+
+    if (_options.source.isEmpty() || _options.output.isEmpty()) {
+        _error = QStringLiteral("no source or output given");
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    auto file = rpi_imager::FileOperations::Create();
+    if (file->OpenDevice(_options.source.toStdString()) != rpi_imager::FileError::kSuccess) {
+        _error = QStringLiteral("cannot open %1").arg(_options.source);
+        return false;
+    }
+    std::uint64_t imageSize = 0;
+    if (file->GetSize(imageSize) != rpi_imager::FileError::kSuccess || imageSize == 0) {
+        file->Close();
+        _error = QStringLiteral("cannot get the size of %1").arg(_options.source);
+        return false;
+    }
+
+    // With O_DIRECT, reads must be aligned in offset, length and memory
+    const auto &limits = file->GetDeviceIOLimits();
+    const size_t alignment = limits.BufferAlignment(4096);
+    const std::uint64_t blockSize = UsedBlockScanner::kBlockSize;
+    const std::uint64_t blockCount = (imageSize + blockSize - 1) / blockSize;
+
+    std::unique_ptr<fastboot::BlockMap> map;
+    if (!_options.allBlocks) {
+        UsedBlockScanner scanner([&file, alignment](std::uint64_t offset, char *buf, size_t len) {
+            const std::uint64_t start = offset / alignment * alignment;
+            const std::uint64_t span = (offset + len + alignment - 1) / alignment * alignment - start;
+            char *bounce = static_cast<char *>(qMallocAligned(span, alignment));
+            if (!bounce)
+                return false;
+            size_t bytesRead = 0;
+            bool ok = file->ReadAtOffset(start, reinterpret_cast<std::uint8_t *>(bounce), span, bytesRead) == rpi_imager::FileError::kSuccess
+                      && bytesRead >= offset + len - start;
+            if (ok)
+                memcpy(buf, bounce + (offset - start), len);
+            qFreeAligned(bounce);
+            return ok;
+        }, imageSize);
+        map = scanner.scan();
+        if (!map)
+            qDebug() << "Backup: no used block map, reading every block";
+    }
+    const bool scanned = map != nullptr;
+    if (!map) {
+        map = std::make_unique<fastboot::BlockMap>();
+        map->assign(blockSize, blockCount, {fastboot::BlockRange{0, blockCount}});
+    }
+
+    quint64 mappedBytes = 0;
+    for (const auto &range : map->ranges())
+        mappedBytes += std::min<quint64>(range.end * blockSize, imageSize) - std::min<quint64>(range.begin * blockSize, imageSize);
+    qDebug() << "Backup: reading" << mappedBytes / (1024 * 1024) << "MB of" << imageSize / (1024 * 1024)
+             << "MB in" << map->ranges().size() << "ranges after" << timer.elapsed() << "ms";
+
+    QSaveFile image(_options.output);
+    if (!image.open(QIODevice::WriteOnly)) {
+        file->Close();
+        _error = QStringLiteral("cannot create %1: %2").arg(_options.output, image.errorString());
+        return false;
+    }
+    FrameCompressor compressor(image, imageSize);
+    if (!compressor.init(_options.compressionLevel, _options.threads)) {
+        file->Close();
+        _error = compressor.errorString();
+        return false;
+    }
+
+    struct Read {
+        std::unique_ptr<char, void (*)(void *)> mem{nullptr, qFreeAligned};
+        std::atomic<bool> done{false};
+        rpi_imager::FileError result = rpi_imager::FileError::kSuccess;
+        quint64 size = 0;
+        size_t bytesRead = 0;
+        bool zero = false;   // Free space, not read
+        size_t range = 0;
+    };
+    const size_t readSize = limits.NativeIOSize(READ_SIZE, alignment);
+    Read reads[READS_IN_FLIGHT];
+    for (auto &read : reads) {
+        read.mem.reset(static_cast<char *>(qMallocAligned(readSize, alignment)));
+        if (!read.mem) {
+            file->Close();
+            _error = QStringLiteral("out of memory for read buffers");
+            return false;
+        }
+    }
+    const std::vector<char> zeros(ZERO_CHUNK_SIZE, 0);
+
+    if (file->IsAsyncIOSupported())
+        file->SetAsyncQueueDepth(READS_IN_FLIGHT);
+    file->PrepareForSequentialRead(0, imageSize);
+    file->Seek(0);
+
+    // reads[head] is the oldest queued read, followed by inFlight - 1 more
+    AcceleratedCryptographicHash rangeHash(QCryptographicHash::Sha256);
+    int head = 0;
+    int inFlight = 0;
+    quint64 queuePos = 0;
+    quint64 donePos = 0;
+    quint64 readBytes = 0;
+    bool failed = false;
+
+    while (donePos < imageSize) {
+        while (queuePos < imageSize && inFlight < READS_IN_FLIGHT) {
+            const auto extent = map->extentAtSequential(queuePos / blockSize);
+            const quint64 extentEnd = extent.end == fastboot::BlockMap::kNoEnd
+                ? imageSize : std::min<quint64>(extent.end * blockSize, imageSize);
+
+            Read &read = reads[(head + inFlight) % READS_IN_FLIGHT];
+            read.zero = !extent.mapped;
+            read.range = extent.range;
+            read.size = read.zero ? extentEnd - queuePos : std::min<quint64>(readSize, extentEnd - queuePos);
+            read.done.store(false);
+            inFlight++;
+            queuePos += read.size;
+
+            if (read.zero) {
+                read.result = rpi_imager::FileError::kSuccess;
+                read.bytesRead = 0;
+                read.done.store(true);
+                file->Seek(queuePos);
+            } else {
+                Read *r = &read;
+                file->AsyncReadSequential(reinterpret_cast<std::uint8_t *>(read.mem.get()), static_cast<size_t>(read.size),
+                    [r](rpi_imager::FileError result, std::size_t bytesRead) {
+                        r->result = result;
+                        r->bytesRead = bytesRead;
+                        r->done.store(true, std::memory_order_release);
+                    });
+            }
+        }
+
+        // Reads may complete in any order; compress strictly in order
+        Read &oldest = reads[head];
+        while (!oldest.done.load(std::memory_order_acquire)) {
+            if (file->WaitForPendingReads(qMax(0, file->GetPendingReadCount() - 1)) == rpi_imager::FileError::kCancelled)
+                break;
+        }
+        if (!oldest.done.load(std::memory_order_acquire)) {
+            _error = QStringLiteral("reading was cancelled");
+            failed = true;
+            break;
+        }
+
+        bool ok = true;
+        if (oldest.zero) {
+            for (quint64 left = oldest.size; left && ok;) {
+                const size_t n = static_cast<size_t>(std::min<quint64>(left, zeros.size()));
+                ok = compressor.add(zeros.data(), n);
+                left -= n;
+            }
+        } else {
+            if (oldest.result != rpi_imager::FileError::kSuccess || oldest.bytesRead != oldest.size) {
+                _error = QStringLiteral("read error at offset %1").arg(donePos);
+                failed = true;
+                break;
+            }
+            rangeHash.addData(oldest.mem.get(), static_cast<int>(oldest.size));
+            ok = compressor.add(oldest.mem.get(), static_cast<size_t>(oldest.size));
+            readBytes += oldest.size;
+
+            // The range is complete: its checksum goes into the bmap
+            const auto &range = map->ranges()[oldest.range];
+            if (donePos + oldest.size >= std::min<quint64>(range.end * blockSize, imageSize)) {
+                const QByteArray digest = rangeHash.result();
+                std::array<uint8_t, 32> sha256{};
+                memcpy(sha256.data(), digest.constData(), sha256.size());
+                map->setChecksum(oldest.range, sha256);
+                rangeHash.reset();
+            }
+        }
+        if (!ok) {
+            _error = compressor.errorString();
+            failed = true;
+            break;
+        }
+
+        donePos += oldest.size;
+        head = (head + 1) % READS_IN_FLIGHT;
+        inFlight--;
+        if (progress)
+            progress(readBytes, mappedBytes);
+    }
+
+    // No buffer may be freed while the device still uses it
+    file->WaitForPendingReads(0);
+    file->Close();
+    if (failed) {
+        image.cancelWriting();
+        return false;
+    }
+
+    if (!image.commit()) {
+        _error = QStringLiteral("cannot write %1: %2").arg(_options.output, image.errorString());
+        return false;
+    }
+
+    QSaveFile bmapFile(_options.bmap);
+    const std::string xml = map->toXml(imageSize);
+    if (!bmapFile.open(QIODevice::WriteOnly)
+        || bmapFile.write(xml.data(), static_cast<qint64>(xml.size())) != static_cast<qint64>(xml.size())
+        || !bmapFile.commit()) {
+        _error = QStringLiteral("cannot write %1: %2").arg(_options.bmap, bmapFile.errorString());
+        return false;
+    }
+
+    const qint64 elapsedMs = qMax<qint64>(1, timer.elapsed());
+    qDebug() << "Backup:" << readBytes / (1024 * 1024) << "MB read and compressed to"
+             << compressor.written() / (1024 * 1024) << "MB in" << elapsedMs << "ms";
+
+    _report["source"] = _options.source;
+    _report["image"] = _options.output;
+    _report["bmap"] = _options.bmap;
+    _report["imageBytes"] = static_cast<qint64>(imageSize);
+    _report["readBytes"] = static_cast<qint64>(readBytes);
+    _report["compressedBytes"] = static_cast<qint64>(compressor.written());
+    _report["ranges"] = static_cast<qint64>(map->ranges().size());
+    _report["usedBlockScan"] = scanned;
+    _report["compressionLevel"] = _options.compressionLevel;
+    _report["compressionThreads"] = _options.threads;
+    _report["seconds"] = elapsedMs / 1000.0;
+    _report["readMBps"] = readBytes / 1048576.0 / (elapsedMs / 1000.0);
+    return true;
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef DEVICEBACKUP_H
+#define DEVICEBACKUP_H
+
+#include <QJsonObject>
+#include <QString>
+#include <functional>
+
+/**
+ * DeviceBackup - Reads a device into a compressed image and its block map
+ *
+ * The reverse of a write: a golden card is captured as a .img.zst plus a
+ * .bmap that bmaptool and this program's bmap write path both accept, so
+ * the backup can be written back through the sparse and mapped-range fast
+ * paths. Used by the CLI's --backup mode.
+ *
+ * Only the blocks UsedBlockScanner finds in use (the partition table, and
+ * the metadata and allocated blocks of FAT and ext2/3/4 file systems) are
+ * read; free space goes into the image as zeros without touching the
+ * device. The mapped ranges are read through the same FileOperations async
+ * reads as verification, several in flight, and handed in order to a
+ * multi-threaded zstd compressor, so the card is read as fast as it can be
+ * while compression runs on the other cores. Each mapped range is hashed
+ * for its bmap checksum as it passes.
+ *
+ * The image is written as a series of independent zstd frames of
+ * kFrameSize bytes of image, each with its content size, so that
+ * ZstdDecoder can decompress them in parallel when the backup is written.
+ * Both files are written under temporary names and only appear once
+ * complete.
+ */
+class DeviceBackup
+{
+public:
+    static constexpr quint64 kFrameSize = 32ULL * 1024 * 1024;
+    static constexpr int kDefaultLevel = 3;
+    static constexpr int kMaxLevel = 19;   // Higher levels need far more memory per worker
+
+    struct Options {
+        QString source;              // Device, or a raw disk image
+        QString output;              // Compressed image, conventionally .img.zst
+        QString bmap;                // Empty for defaultBmapPath(output)
+        bool allBlocks = false;      // Read every block, not only those in use
+        int compressionLevel = kDefaultLevel;
+        int threads = 0;             // Compression workers, 0 for one per core
+    };
+
+    /**
+     * @brief Where the block map of a backup goes by default
+     *
+     * The output with any .zst suffix replaced by .bmap (image.img.zst
+     * gives image.img.bmap), which is one of the names bmaptool looks for.
+     */
+    static QString defaultBmapPath(const QString &output);
+
+    explicit DeviceBackup(const Options &options);
+
+    /**
+     * @brief Read the source and write the image and block map
+     * @param progress Called with bytes read and bytes to read (may be empty)
+     * @return false on error, see errorString()
+     */
+    bool run(const std::function<void(quint64 now, quint64 total)> &progress = {});
+
+    /**
+     * @brief Sizes and timings of the last successful run
+     */
+    QJsonObject report() const { return _report; }
+
+    QString errorString() const { return _error; }
+
+private:
+    Options _options;
+    QString _error;
+    QJsonObject _report;
+};
+
+#endif // DEVICEBACKUP_H
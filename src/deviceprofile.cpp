@@ -0,0 +1,74 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "deviceprofile.h"
+
+#include <algorithm>
+
+namespace {
+
+uint32_t runningAverage(uint32_t stored, uint32_t sample, uint32_t sessions)
+{
+    if (sample == 0)
+        return stored;
+    if (stored == 0 || sessions == 0)
+        return sample;
+    const uint64_t weighted = static_cast<uint64_t>(stored) * DeviceProfile::HistoryWeight + sample;
+    return static_cast<uint32_t>(weighted / (DeviceProfile::HistoryWeight + 1));
+}
+
+} // namespace
+
+void DeviceProfile::merge(const DeviceProfile &session)
+{
+    writeKBps = runningAverage(writeKBps, session.writeKBps, sessions);
+    verifyKBps = runningAverage(verifyKBps, session.verifyKBps, sessions);
+    periodicSyncMs = runningAverage(periodicSyncMs, session.periodicSyncMs, sessions);
+    finalSyncMs = runningAverage(finalSyncMs, session.finalSyncMs, sessions);
+    unmountMs = runningAverage(unmountMs, session.unmountMs, sessions);
+    ejectMs = runningAverage(ejectMs, session.ejectMs, sessions);
+
+    if (session.directIO != DirectIO::Unknown)
+        directIO = session.directIO;
+    if (session.probedCapacity > 0)
+        probedCapacity = session.probedCapacity;
+
+    // The tuner already smooths what it learns; the latest result wins
+    if (session.queueDepth > 0)
+    {
+        queueDepth = session.queueDepth;
+        blockSize = session.blockSize;
+    }
+
+    sessions++;
+}
+
+void DeviceProfile::seedSyncInterval(int64_t &intervalBytes, int64_t &intervalMs, int64_t minBytes) const
+{
+    if (periodicSyncMs > 0)
+    {
+        const int64_t affordableMs = static_cast<int64_t>(periodicSyncMs) * SyncCostFactor;
+        intervalMs = std::max(intervalMs, std::min(affordableMs, MaxSyncIntervalMs));
+    }
+
+    if (writeKBps > 0 && intervalMs > 0)
+    {
+        const int64_t deviceBytes = static_cast<int64_t>(writeKBps) * 1024 * intervalMs / 1000;
+        intervalBytes = std::max(minBytes, std::min(intervalBytes, deviceBytes));
+    }
+}
+
+uint32_t DeviceProfile::blendRateKBps(uint32_t profileKBps, uint32_t liveKBps, uint64_t observedBytes)
+{
+    if (liveKBps == 0)
+        return profileKBps;
+    if (profileKBps == 0)
+        return liveKBps;
+
+    const uint64_t live = std::min(observedBytes, LiveRateBytes);
+    const uint64_t blended = (static_cast<uint64_t>(profileKBps) * (LiveRateBytes - live) +
+                              static_cast<uint64_t>(liveKBps) * live) / LiveRateBytes;
+    return static_cast<uint32_t>(std::max<uint64_t>(1, blended));
+}
@@ -0,0 +1,88 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef DEVICEPROFILE_H
+#define DEVICEPROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief What an earlier write measured on a device model
+ *
+ * DownloadThread stores one profile per reader/card model (bus, description
+ * and capacity as reported by Drivelist) and feeds it back on the next
+ * write to the same model:
+ *
+ *   - queueDepth/blockSize skip WriteAutoTuner's probing
+ *   - writeKBps and periodicSyncMs size the periodic sync interval
+ *   - writeKBps, verifyKBps and the fixed costs seed the time estimate (EtaModel)
+ *     until enough live throughput has been seen
+ *   - probedCapacity records what CapacityProbe found, for diagnosing
+ *     counterfeit cards of the model
+ *
+ * A zero field was not measured. merge() folds a session into the stored
+ * profile as a running average weighted towards history, so one bad
+ * session (a slow download, a card doing garbage collection) moves the
+ * profile only part of the way.
+ */
+struct DeviceProfile
+{
+    enum class DirectIO { Unknown, Worked, Failed };
+
+    uint32_t sessions = 0;         // Writes merged into this profile
+    uint32_t writeKBps = 0;        // Sustained write rate while the writer was the bottleneck
+    uint32_t verifyKBps = 0;       // Read-back rate during verification
+    int queueDepth = 0;            // Learned async queue depth; 0 = not learned
+    uint64_t blockSize = 0;        // Learned write size; 0 = whole buffers
+    DirectIO directIO = DirectIO::Unknown;
+    uint32_t periodicSyncMs = 0;   // Average cost of one periodic flush + sync
+    uint32_t finalSyncMs = 0;      // Flush + sync after the last write
+    uint32_t unmountMs = 0;        // Unmounting before opening the device
+    uint32_t ejectMs = 0;          // Ejecting once done
+    uint64_t probedCapacity = 0;   // Capacity the last CapacityProbe found; 0 = not probed
+
+    static constexpr uint32_t HistoryWeight = 2;   // Stored value counts twice the new sample
+    static constexpr int64_t SyncCostFactor = 10;  // Keep periodic syncs under ~10% of write time
+    static constexpr int64_t MaxSyncIntervalMs = 30000;
+    static constexpr uint64_t LiveRateBytes = 256ULL * 1024 * 1024;  // Live rate outweighs the profile after this
+
+    bool isEmpty() const { return sessions == 0; }
+
+    /**
+     * @brief Fold one session's measurements into this profile
+     *
+     * Unmeasured (zero) fields of the session leave the stored value alone.
+     * The learned queue depth and write size, and the probed capacity, are
+     * replaced, not averaged.
+     */
+    void merge(const DeviceProfile &session);
+
+    /**
+     * @brief Adjust a memory-based periodic sync interval for this device
+     *
+     * Each periodic sync flushes everything written since the last one, so
+     * on a device with a known rate the byte interval is capped to what it
+     * writes in one time interval; this keeps a slow card from collecting a
+     * memory tier's worth of dirty pages that stall the next sync. If syncs
+     * were measured to be expensive the time interval grows so they stay
+     * below 1/SyncCostFactor of the write time.
+     *
+     * @param intervalBytes In: memory tier interval, out: seeded interval
+     * @param intervalMs In: memory tier interval, out: seeded interval
+     * @param minBytes Lower bound on intervalBytes
+     */
+    void seedSyncInterval(int64_t &intervalBytes, int64_t &intervalMs, int64_t minBytes) const;
+
+    /**
+     * @brief Rate to estimate with, blending the profile with what is measured now
+     *
+     * The profile rate dominates at the start and fades out over the first
+     * LiveRateBytes observed. Either rate may be 0 (unknown).
+     */
+    static uint32_t blendRateKBps(uint32_t profileKBps, uint32_t liveKBps, uint64_t observedBytes);
+};
+
+#endif // DEVICEPROFILE_H
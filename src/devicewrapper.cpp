@@ -7,6 +7,7 @@
 #include "devicewrapperblockcacheentry.h"
 #include "devicewrapperstructs.h"
 #include "devicewrapperfatpartition.h"
+#include "devicewrapperpartition.h"
 #include <QDebug>
 
 DeviceWrapper::DeviceWrapper(rpi_imager::FileOperations *file_ops, QObject *parent)
@@ -28,29 +29,96 @@ void DeviceWrapper::_seekToBlock(quint64 blockNr)
     }
 }
 
+namespace {
+
+/* Upper bound for a single coalesced read or write */
+constexpr quint64 MAX_BLOCKS_PER_IO = 256;
+/* Upper bound for a single read that bypasses the cache (4 MB) */
+constexpr quint64 MAX_BLOCKS_PER_UNCACHED_READ = 1024;
+
+struct AlignedFree {
+    void operator()(char *p) const { qFreeAligned(p); }
+};
+using AlignedPtr = std::unique_ptr<char, AlignedFree>;
+
+AlignedPtr allocateBlocks(quint64 count)
+{
+    /* Windows requires buffers to be 4k aligned when reading/writing raw disk devices */
+    AlignedPtr buf(static_cast<char *>(qMallocAligned(count * 4096, 4096)));
+    if (!buf)
+        throw std::runtime_error("Out of memory allocating block buffer");
+    return buf;
+}
+
+} // namespace
+
+void DeviceWrapper::_writeBlocks(quint64 firstBlock, const QList<DeviceWrapperBlockCacheEntry *> &blocks, char *staging)
+{
+    const char *data;
+    if (blocks.size() == 1)
+    {
+        data = blocks.first()->block;
+    }
+    else
+    {
+        for (qsizetype i = 0; i < blocks.size(); i++)
+            memcpy(staging + i * 4096, blocks[i]->block, 4096);
+        data = staging;
+    }
+
+    _seekToBlock(firstBlock);
+    auto result = _file_ops->WriteSequential(reinterpret_cast<const std::uint8_t*>(data), blocks.size() * 4096);
+    if (result != rpi_imager::FileError::kSuccess) {
+        throw std::runtime_error(firstBlock == 0 ? "Error writing MBR to device" : "Error writing to device");
+    }
+
+    for (auto block : blocks)
+        block->dirty = false;
+}
+
 void DeviceWrapper::sync()
 {
+    /* Partitions may hold modified metadata (e.g. the FAT) in memory */
+    for (const auto &partition : std::as_const(_partitions))
+    {
+        if (partition)
+            partition->flush();
+    }
+
     if (!_dirty)
         return;
 
-    const auto blockNrs = _blockcache.keys();
-    for (auto blockNr : blockNrs)
+    /* _blockcache is ordered by block number, so contiguous dirty blocks
+       are adjacent and can be merged into a single write */
+    AlignedPtr staging;
+    QList<DeviceWrapperBlockCacheEntry *> run;
+    quint64 runStart = 0;
+
+    auto flushRun = [&]() {
+        if (run.isEmpty())
+            return;
+        if (run.size() > 1 && !staging)
+            staging = allocateBlocks(MAX_BLOCKS_PER_IO);
+        _writeBlocks(runStart, run, staging.get());
+        run.clear();
+    };
+
+    for (auto it = _blockcache.cbegin(); it != _blockcache.cend(); ++it)
     {
-        if (blockNr == 0)
-            continue; /* Save writing first block with MBR for last */
-
-        auto block = _blockcache.value(blockNr);
+        const quint64 blockNr = it.key();
+        auto block = it.value();
 
-        if (!block->dirty)
-            continue;
+        if (blockNr == 0 || !block->dirty)
+            continue; /* Save writing first block with MBR for last */
 
-        _seekToBlock(blockNr);
-        auto result = _file_ops->WriteSequential(reinterpret_cast<const std::uint8_t*>(block->block), 4096);
-        if (result != rpi_imager::FileError::kSuccess) {
-            throw std::runtime_error("Error writing to device");
-        }
-        block->dirty = false;
+        const quint64 runLength = static_cast<quint64>(run.size());
+        if (runLength && (blockNr != runStart + runLength || runLength == MAX_BLOCKS_PER_IO))
+            flushRun();
+        if (run.isEmpty())
+            runStart = blockNr;
+        run.append(block);
     }
+    flushRun();
 
     if (_blockcache.contains(0))
     {
@@ -58,14 +126,7 @@ void DeviceWrapper::sync()
         auto block = _blockcache.value(0);
 
         if (block->dirty)
-        {
-            _seekToBlock(0);
-            auto result = _file_ops->WriteSequential(reinterpret_cast<const std::uint8_t*>(block->block), 4096);
-            if (result != rpi_imager::FileError::kSuccess) {
-                throw std::runtime_error("Error writing MBR to device");
-            }
-            block->dirty = false;
-        }
+            _writeBlocks(0, {block}, nullptr);
     }
 
     _dirty = false;
@@ -77,22 +138,39 @@ void DeviceWrapper::_readIntoBlockCacheIfNeeded(quint64 offset, quint64 size)
         return;
 
     quint64 firstBlock = offset/4096;
-    quint64 lastBlock = (offset+size)/4096;
+    quint64 lastBlock = (offset+size-1)/4096;
+    AlignedPtr staging;
 
-    for (auto i = firstBlock; i <= lastBlock; i++)
+    for (auto i = firstBlock; i <= lastBlock; )
     {
-        if (!_blockcache.contains(i))
+        if (_blockcache.contains(i))
         {
-            _seekToBlock(i);
+            i++;
+            continue;
+        }
+
+        /* Read the whole span of uncached blocks in one go */
+        quint64 count = 1;
+        while (i + count <= lastBlock && count < MAX_BLOCKS_PER_IO && !_blockcache.contains(i + count))
+            count++;
+
+        if (!staging)
+            staging = allocateBlocks(qMin(lastBlock - i + 1, MAX_BLOCKS_PER_IO));
 
+        _seekToBlock(i);
+        std::size_t bytes_read = 0;
+        auto result = _file_ops->ReadSequential(reinterpret_cast<std::uint8_t*>(staging.get()), count * 4096, bytes_read);
+        if (result != rpi_imager::FileError::kSuccess || bytes_read != count * 4096) {
+            throw std::runtime_error("Error reading from device");
+        }
+
+        for (quint64 j = 0; j < count; j++)
+        {
             auto cacheEntry = new DeviceWrapperBlockCacheEntry(this);
-            std::size_t bytes_read = 0;
-            auto result = _file_ops->ReadSequential(reinterpret_cast<std::uint8_t*>(cacheEntry->block), 4096, bytes_read);
-            if (result != rpi_imager::FileError::kSuccess || bytes_read != 4096) {
-                throw std::runtime_error("Error reading from device");
-            }
-            _blockcache.insert(i, cacheEntry);
+            memcpy(cacheEntry->block, staging.get() + j * 4096, 4096);
+            _blockcache.insert(i + j, cacheEntry);
         }
+        i += count;
     }
 }
 
@@ -117,6 +195,37 @@ void DeviceWrapper::pread(char *buf, quint64 size, quint64 offset)
     }
 }
 
+void DeviceWrapper::preadUncached(char *buf, quint64 size, quint64 offset)
+{
+    if (!size)
+        return;
+
+    const quint64 firstBlock = offset / 4096;
+    const quint64 lastBlock = (offset + size - 1) / 4096;
+    AlignedPtr staging = allocateBlocks(qMin(lastBlock - firstBlock + 1, MAX_BLOCKS_PER_UNCACHED_READ));
+
+    for (auto i = firstBlock; i <= lastBlock; )
+    {
+        const quint64 count = qMin(lastBlock - i + 1, MAX_BLOCKS_PER_UNCACHED_READ);
+        _seekToBlock(i);
+        std::size_t bytes_read = 0;
+        auto result = _file_ops->ReadSequential(reinterpret_cast<std::uint8_t*>(staging.get()), count * 4096, bytes_read);
+        if (result != rpi_imager::FileError::kSuccess || bytes_read != count * 4096) {
+            throw std::runtime_error("Error reading from device");
+        }
+
+        /* Blocks in the cache may have been modified and not written yet */
+        for (auto it = _blockcache.lowerBound(i); it != _blockcache.cend() && it.key() < i + count; ++it)
+            memcpy(staging.get() + (it.key() - i) * 4096, it.value()->block, 4096);
+
+        const quint64 chunkStart = i * 4096;
+        const quint64 from = qMax(offset, chunkStart);
+        const quint64 to = qMin(offset + size, chunkStart + count * 4096);
+        memcpy(buf + (from - offset), staging.get() + (from - chunkStart), to - from);
+        i += count;
+    }
+}
+
 void DeviceWrapper::pwrite(const char *buf, quint64 size, quint64 offset)
 {
     if (!size)
@@ -154,6 +263,13 @@ void DeviceWrapper::pwrite(const char *buf, quint64 size, quint64 offset)
 }
 
 DeviceWrapperFatPartition *DeviceWrapper::fatPartition(int nr)
+{
+    quint64 offset, size;
+    partitionRange(nr, offset, size);
+    return new DeviceWrapperFatPartition(this, offset, size, this);
+}
+
+void DeviceWrapper::partitionRange(int nr, quint64 &offset, quint64 &size)
 {
     if (nr > 4 || nr < 1)
         throw std::runtime_error("Only basic partitions 1-4 supported");
@@ -187,7 +303,9 @@ DeviceWrapperFatPartition *DeviceWrapper::fatPartition(int nr)
         if (gptpart.StartingLBA > UINT64_MAX / 512 || sectorCount > UINT64_MAX / 512)
             throw std::runtime_error("GPT partition offset/size overflow");
 
-        return new DeviceWrapperFatPartition(this, gptpart.StartingLBA * 512, sectorCount * 512, this);
+        offset = gptpart.StartingLBA * 512;
+        size = sectorCount * 512;
+        return;
     }
 
     /* MBR table handling */
@@ -201,9 +319,7 @@ DeviceWrapperFatPartition *DeviceWrapper::fatPartition(int nr)
         throw std::runtime_error("Partition does not exist");
 
     /* Overflow-safe offset/size for MBR partition (uint32_t * 512) */
-    quint64 mbrStart = static_cast<quint64>(mbr.part[nr-1].starting_sector) * 512;
-    quint64 mbrSize  = static_cast<quint64>(mbr.part[nr-1].nr_of_sectors) * 512;
-
-    return new DeviceWrapperFatPartition(this, mbrStart, mbrSize, this);
+    offset = static_cast<quint64>(mbr.part[nr-1].starting_sector) * 512;
+    size   = static_cast<quint64>(mbr.part[nr-1].nr_of_sectors) * 512;
 }
 
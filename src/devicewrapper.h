@@ -8,11 +8,14 @@
 
 #include <QObject>
 #include <QMap>
+#include <QList>
+#include <QPointer>
 #include <memory>
 #include "file_operations.h"
 
 class DeviceWrapperBlockCacheEntry;
 class DeviceWrapperFatPartition;
+class DeviceWrapperPartition;
 
 
 class DeviceWrapper : public QObject
@@ -24,15 +27,25 @@ public:
     void sync();
     void pwrite(const char *buf, quint64 size, quint64 offset);
     void pread(char *buf, quint64 size, quint64 offset);
+    /* Large reads of file data: read straight from the device in big aligned
+       chunks without filling the block cache, which still supplies any
+       block it holds */
+    void preadUncached(char *buf, quint64 size, quint64 offset);
     DeviceWrapperFatPartition *fatPartition(int nr);
+    /* Byte range of an MBR or GPT partition; throws if it does not exist */
+    void partitionRange(int nr, quint64 &offset, quint64 &size);
 
 protected:
+    friend class DeviceWrapperPartition;
+
     bool _dirty;
+    QList<QPointer<DeviceWrapperPartition>> _partitions;
     QMap<quint64,DeviceWrapperBlockCacheEntry *> _blockcache;
     rpi_imager::FileOperations *_file_ops;
 
     void _readIntoBlockCacheIfNeeded(quint64 offset, quint64 size);
     void _seekToBlock(quint64 blockNr);
+    void _writeBlocks(quint64 firstBlock, const QList<DeviceWrapperBlockCacheEntry *> &blocks, char *staging);
 
 signals:
 
@@ -20,6 +20,17 @@ static uint8_t lfnChecksum(const unsigned char *shortName) {
     return sum;
 }
 
+inline QByteArray _dirEntryToShortName(struct dir_entry *entry)
+{
+    QByteArray base = QByteArray((char *) entry->DIR_Name, 8).trimmed().toLower();
+    QByteArray ext = QByteArray((char *) entry->DIR_Name+8, 3).trimmed().toLower();
+
+    if (ext.isEmpty())
+        return base;
+    else
+        return base+"."+ext;
+}
+
 DeviceWrapperFatPartition::DeviceWrapperFatPartition(DeviceWrapper *dw, quint64 partStart, quint64 partLen, QObject *parent)
     : DeviceWrapperPartition(dw, partStart, partLen, parent)
 {
@@ -66,6 +77,10 @@ DeviceWrapperFatPartition::DeviceWrapperFatPartition(DeviceWrapper *dw, quint64
         throw std::runtime_error("exFAT file system not supported");
     if (_bytesPerSector % 4)
         throw std::runtime_error("FAT file system: invalid bytes per sector");
+    if (_type == FAT16)
+        useLayout<Fat16Layout>();
+    else
+        useLayout<Fat32Layout>();
 
     _firstFatStartOffset = bpb.fat16.BPB_RsvdSecCnt * _bytesPerSector;
     for (int i = 0; i < bpb.fat16.BPB_NumFATs; i++)
@@ -83,49 +98,141 @@ DeviceWrapperFatPartition::DeviceWrapperFatPartition(DeviceWrapper *dw, quint64
         _fat32_fsinfoSector = bpb.fat32.BPB_FSInfo;
         _clusterOffset = _firstFatStartOffset + (bpb.fat16.BPB_NumFATs * _fatSize * _bytesPerSector);
     }
+
+    /* Entries past the last data cluster are padding, never allocate them */
+    _fatEntries = qMin<quint64>(static_cast<quint64>(_fatSize) * _bytesPerSector / (_type == FAT16 ? 2 : 4),
+                                static_cast<quint64>(countOfClusters) + 2);
+    _fatLoaded = false;
+    _rootDirIndexValid = false;
+    _nextFreeCluster = 2;
+    _fsinfoFreeDelta = 0;
+    _fsinfoDirty = false;
 }
 
-uint32_t DeviceWrapperFatPartition::allocateCluster()
+template <class Layout>
+void DeviceWrapperFatPartition::useLayout()
 {
-    char sector[_bytesPerSector];
-    int bytesPerEntry = (_type == FAT16 ? 2 : 4);
-    int entriesPerSector = _bytesPerSector/bytesPerEntry;
-    uint32_t cluster;
-    uint16_t *f16 = (uint16_t *) &sector;
-    uint32_t *f32 = (uint32_t *) &sector;
+    _endOfChain = Layout::kEndOfChain;
+    _getFAT = &DeviceWrapperFatPartition::getFATT<Layout>;
+    _setFAT = &DeviceWrapperFatPartition::setFATT<Layout>;
+    _getClusterChain = &DeviceWrapperFatPartition::getClusterChainT<Layout>;
+    _listFilesInDirectory = &DeviceWrapperFatPartition::listFilesInDirectoryT<Layout>;
+}
 
+void DeviceWrapperFatPartition::loadFAT()
+{
+    if (_fatLoaded)
+        return;
+
+    /* Read the first FAT in one go. All lookups and allocations work on this
+       copy; flush() writes the modified sectors back to every FAT. */
+    _fat.resize(static_cast<qsizetype>(_fatSize) * _bytesPerSector);
     seek(_firstFatStartOffset);
+    read(_fat.data(), _fat.size());
+
+    if (_type == FAT16)
+        scanFreeClustersT<Fat16Layout>();
+    else
+        scanFreeClustersT<Fat32Layout>();
+    _dirtyFatSectors = QBitArray(_fatSize);
+    _nextFreeCluster = 2;
+    _fatLoaded = true;
+}
 
-    for (int i = 0; i < _fatSize; i++)
+template <class Layout>
+void DeviceWrapperFatPartition::scanFreeClustersT()
+{
+    _freeClusters = QBitArray(_fatEntries);
+    for (uint32_t cluster = 2; cluster < _fatEntries; cluster++)
     {
-        read(sector, sizeof(sector));
+        if ((fatEntryT<Layout>(cluster) & Layout::kValueMask) == 0)
+            _freeClusters.setBit(cluster);
+    }
+}
 
-        for (int j=0; j < entriesPerSector; j++)
+template <class Layout>
+uint32_t DeviceWrapperFatPartition::fatEntryT(uint32_t cluster) const
+{
+    return reinterpret_cast<const typename Layout::Entry *>(_fat.constData())[cluster];
+}
+
+template <class Layout>
+void DeviceWrapperFatPartition::setFatEntryT(uint32_t cluster, uint32_t value)
+{
+    if (cluster >= _fatEntries)
+        throw std::runtime_error("FAT cluster number out of range");
+
+    reinterpret_cast<typename Layout::Entry *>(_fat.data())[cluster] = static_cast<typename Layout::Entry>(value);
+    _dirtyFatSectors.setBit(static_cast<qsizetype>(cluster) * sizeof(typename Layout::Entry) / _bytesPerSector);
+
+    const bool isFree = (value & Layout::kValueMask) == 0;
+    if (cluster >= 2)
+    {
+        _freeClusters.setBit(cluster, isFree);
+        if (isFree && cluster < _nextFreeCluster)
+            _nextFreeCluster = cluster;
+    }
+
+    /* A freed cluster may get reused, so cached subdirectory contents could go stale */
+    if (isFree)
+        _subdirIndex.clear();
+}
+
+void DeviceWrapperFatPartition::flush()
+{
+    if (_fatLoaded)
+    {
+        /* Write back runs of modified sectors to all FATs (usually 2) */
+        const qsizetype sectors = _dirtyFatSectors.size();
+        for (qsizetype first = 0; first < sectors; first++)
         {
-            if (_type == FAT16)
-            {
-                if (f16[j] == 0)
-                {
-                    /* Found available FAT16 cluster, mark it used/EOF */
-                    cluster = j+i*entriesPerSector;
-                    setFAT16(cluster, 0xFFFF);
-                    return cluster;
-                }
-            }
-            else
+            if (!_dirtyFatSectors.testBit(first))
+                continue;
+
+            qsizetype last = first;
+            while (last + 1 < sectors && _dirtyFatSectors.testBit(last + 1))
+                last++;
+
+            const qsizetype offset = first * _bytesPerSector;
+            const qsizetype len = (last - first + 1) * _bytesPerSector;
+            for (auto fatStart : std::as_const(_fatStartOffset))
             {
-                if ( (f32[j] & 0x0FFFFFFF) == 0)
-                {
-                    /* Found available FAT32 cluster, mark it used/EOF */
-                    cluster = j+i*entriesPerSector;
-                    setFAT32(cluster, 0xFFFFFFF);
-                    updateFSinfo(-1, cluster);
-                    return cluster;
-                }
+                seek(fatStart + offset);
+                write(_fat.constData() + offset, len);
             }
+            first = last;
         }
+        _dirtyFatSectors.fill(false);
     }
 
+    if (_fsinfoDirty)
+    {
+        writeFSinfo();
+        _fsinfoDirty = false;
+        _fsinfoFreeDelta = 0;
+    }
+}
+
+uint32_t DeviceWrapperFatPartition::allocateCluster()
+{
+    loadFAT();
+
+    /* Clusters below the hint are known to be in use, so allocation is a
+       single forward pass over the bitmap for a whole file */
+    for (uint32_t cluster = _nextFreeCluster; cluster < _fatEntries; cluster++)
+    {
+        if (_freeClusters.testBit(cluster))
+        {
+            /* Found available cluster, mark it used/EOF */
+            setFAT(cluster, _endOfChain);
+            _nextFreeCluster = cluster + 1;
+            if (_type == FAT32)
+                updateFSinfo(-1, _nextFreeCluster);
+            return cluster;
+        }
+    }
+
+    _nextFreeCluster = _fatEntries;
     throw std::runtime_error("Out of disk space on FAT partition");
 }
 
@@ -134,89 +241,97 @@ uint32_t DeviceWrapperFatPartition::allocateCluster(uint32_t previousCluster)
     uint32_t newCluster = allocateCluster();
 
     if (previousCluster)
-    {
-        if (_type == FAT16)
-            setFAT16(previousCluster, newCluster);
-        else
-            setFAT32(previousCluster, newCluster);
-    }
+        setFAT(previousCluster, newCluster);
 
     return newCluster;
 }
 
-void DeviceWrapperFatPartition::setFAT16(uint16_t cluster, uint16_t value)
+/* count clusters, each marked end-of-chain for the caller to link. The first
+   free run long enough if there is one, else whatever is free in order */
+QList<uint32_t> DeviceWrapperFatPartition::allocateClusters(int count)
 {
-    /* Modify all FATs (usually 2) */
-    for (auto fatStart : std::as_const(_fatStartOffset))
+    QList<uint32_t> clusters;
+    if (count <= 0)
+        return clusters;
+    loadFAT();
+    clusters.reserve(count);
+
+    uint32_t firstFree = 0, runStart = 0, runLength = 0;
+    for (uint32_t cluster = _nextFreeCluster; cluster < _fatEntries && runLength < static_cast<uint32_t>(count); cluster++)
     {
-        seek(fatStart + cluster * 2);
-        write((char *) &value, 2);
+        if (!_freeClusters.testBit(cluster))
+        {
+            runLength = 0;
+            continue;
+        }
+        if (!firstFree)
+            firstFree = cluster;
+        if (!runLength)
+            runStart = cluster;
+        runLength++;
     }
-}
 
-void DeviceWrapperFatPartition::setFAT32(uint32_t cluster, uint32_t value)
-{
-    uint32_t prev_value, reserved_bits;
+    if (runLength < static_cast<uint32_t>(count))
+    {
+        for (int i = 0; i < count; i++)
+            clusters.append(allocateCluster());
+        return clusters;
+    }
 
-    /* Modify all FATs (usually 2) */
-    for (auto fatStart : std::as_const(_fatStartOffset))
+    for (uint32_t cluster = runStart; cluster < runStart + runLength; cluster++)
     {
-        /* Spec (p. 16) mentions we must preserve high 4 bits of FAT32 FAT entry when modifiying */
-        seek(fatStart + cluster * 4);
-        read( (char *) &prev_value, 4);
-        reserved_bits = prev_value & 0xF0000000;
-        value |= reserved_bits;
-
-        seek(fatStart + cluster * 4);
-        write((char *) &value, 4);
+        setFAT(cluster, _endOfChain);
+        clusters.append(cluster);
     }
+    /* Free clusters skipped before the run stay below the hint */
+    if (runStart == firstFree)
+        _nextFreeCluster = runStart + runLength;
+    if (_type == FAT32)
+        updateFSinfo(-count, 0);
+    return clusters;
 }
 
-void DeviceWrapperFatPartition::setFAT(uint32_t cluster, uint32_t value)
+template <class Layout>
+void DeviceWrapperFatPartition::setFATT(uint32_t cluster, uint32_t value)
 {
-    if (_type == FAT16)
-        setFAT16(cluster, value);
-    else
-        setFAT32(cluster, value);
+    loadFAT();
+    if (cluster >= _fatEntries)
+        throw std::runtime_error("FAT cluster number out of range");
+
+    /* Spec (p. 16) mentions we must preserve high 4 bits of FAT32 FAT entry when modifiying */
+    const uint32_t reserved_bits = fatEntryT<Layout>(cluster) & Layout::kReservedBits;
+    setFatEntryT<Layout>(cluster, (value & Layout::kValueMask) | reserved_bits);
 }
 
-uint32_t DeviceWrapperFatPartition::getFAT(uint32_t cluster)
+template <class Layout>
+uint32_t DeviceWrapperFatPartition::getFATT(uint32_t cluster)
 {
-    if (_type == FAT16)
-    {
-        uint16_t result;
-        seek(_firstFatStartOffset + cluster * 2);
-        read((char *) &result, 2);
-        return result;
-    }
-    else
-    {
-        uint32_t result;
-        seek(_firstFatStartOffset + cluster * 4);
-        read((char *) &result, 4);
-        return result & 0x0FFFFFFF;
-    }
+    loadFAT();
+    if (cluster >= _fatEntries)
+        throw std::runtime_error("Corrupt file system. FAT entry out of range");
+
+    return fatEntryT<Layout>(cluster) & Layout::kValueMask;
 }
 
-QList<uint32_t> DeviceWrapperFatPartition::getClusterChain(uint32_t firstCluster)
+template <class Layout>
+QList<uint32_t> DeviceWrapperFatPartition::getClusterChainT(uint32_t firstCluster)
 {
+    loadFAT();
+
     QList<uint32_t> list;
     uint32_t cluster = firstCluster;
 
-    while (true)
+    /* Reached EOF at an end-of-chain marker. A chain longer than the FAT
+       has entries must visit some cluster twice. */
+    while (cluster < Layout::kFirstEndMarker)
     {
-        if ( (_type == FAT16 && cluster > 0xFFF7)
-             || (_type == FAT32 && cluster > 0xFFFFFF7))
-        {
-            /* Reached EOF */
-            break;
-        }
-
-        if (list.contains(cluster))
+        if (cluster >= _fatEntries)
+            throw std::runtime_error("Corrupt file system. FAT entry out of range");
+        if (static_cast<uint32_t>(list.size()) >= _fatEntries)
             throw std::runtime_error("Corrupt file system. Circular references in FAT table");
 
         list.append(cluster);
-        cluster = getFAT(cluster);
+        cluster = fatEntryT<Layout>(cluster) & Layout::kValueMask;
     }
 
     return list;
@@ -368,119 +483,16 @@ QByteArray DeviceWrapperFatPartition::readFile(const QString &filename)
             dirCluster |= (dirEntry.DIR_FstClusHI << 16);
         }
         
-        // Save current directory state
-        uint32_t savedCurrentCluster = _fat32_currentRootDirCluster;
-        QList<uint32_t> savedDirClusters = _currentDirClusters;
-        
-        // Set up to read from subdirectory
-        if (_type == FAT32) {
-            _fat32_currentRootDirCluster = dirCluster;
-            seekCluster(_fat32_currentRootDirCluster);
-            _currentDirClusters.clear();
-            _currentDirClusters.append(_fat32_currentRootDirCluster);
-        } else {
-            seekCluster(dirCluster);
-        }
-        
         // Find the file in the subdirectory
+        const DirIndex &index = subdirIndex(dirCluster);
         QString fileName = parts[1];
-        QString fileNameLower = fileName.toLower();
-        bool found = false;
-        QString longFilename;
-        int entriesChecked = 0;
-        
-        while (true) {
-            // Read the next directory entry
-            quint64 oldOffset = _offset;
+        auto indexIt = index.names.constFind(fileName.toLower());
+        bool found = indexIt != index.names.constEnd();
+        int entriesChecked = index.entryCount;
+
+        if (found) {
+            _offset = indexIt.value();
             read((char *) &entry, sizeof(entry));
-            
-            if (entry.DIR_Name[0] == 0) {
-                // End of directory
-                break;
-            }
-            
-            if (entry.DIR_Name[0] == 0xE5) {
-                // Deleted entry, skip
-                longFilename.clear();
-                // Check for cluster boundary after skipping
-                if (_type == FAT32 && (pos() - _clusterOffset) % _bytesPerCluster == 0) {
-                    uint32_t nextCluster = getFAT(_fat32_currentRootDirCluster);
-                    if (nextCluster >= 0xFFFFFF8) break;
-                    if (_currentDirClusters.contains(nextCluster)) {
-                        qDebug() << "Circular cluster reference in subdirectory" << dirName;
-                        break;
-                    }
-                    _currentDirClusters.append(nextCluster);
-                    _fat32_currentRootDirCluster = nextCluster;
-                    seekCluster(_fat32_currentRootDirCluster);
-                }
-                continue;
-            }
-            
-            if (entry.DIR_Attr & ATTR_LONG_NAME) {
-                // Process long filename entry
-                struct longfn_entry *l = (struct longfn_entry *) &entry;
-                char lnamePartStr[26] = {0};
-                memcpy(lnamePartStr, l->LDIR_Name1, 10);
-                memcpy(lnamePartStr+10, l->LDIR_Name2, 12);
-                memcpy(lnamePartStr+22, l->LDIR_Name3, 4);
-                QString lnamePart((QChar *) lnamePartStr, 13);
-                longFilename = lnamePart + longFilename;
-                // Check for cluster boundary after LFN entry
-                if (_type == FAT32 && (pos() - _clusterOffset) % _bytesPerCluster == 0) {
-                    uint32_t nextCluster = getFAT(_fat32_currentRootDirCluster);
-                    if (nextCluster >= 0xFFFFFF8) break;
-                    if (_currentDirClusters.contains(nextCluster)) {
-                        qDebug() << "Circular cluster reference in subdirectory" << dirName;
-                        break;
-                    }
-                    _currentDirClusters.append(nextCluster);
-                    _fat32_currentRootDirCluster = nextCluster;
-                    seekCluster(_fat32_currentRootDirCluster);
-                }
-                continue;
-            }
-            
-            // Regular entry - check if it matches
-            // Truncate long filename at null char
-            if (longFilename.indexOf(QChar::Null) >= 0) {
-                longFilename.truncate(longFilename.indexOf(QChar::Null));
-            }
-            
-            // Get short filename as fallback
-            QString shortName;
-            for (int i = 0; i < 8 && entry.DIR_Name[i] != ' '; i++) {
-                shortName += QChar(entry.DIR_Name[i]).toLower();
-            }
-            if (entry.DIR_Name[8] != ' ') {
-                shortName += '.';
-                for (int i = 8; i < 11 && entry.DIR_Name[i] != ' '; i++) {
-                    shortName += QChar(entry.DIR_Name[i]).toLower();
-                }
-            }
-            
-            QString actualFilename = longFilename.isEmpty() ? shortName : longFilename.toLower();
-            entriesChecked++;
-            
-            if (actualFilename == fileNameLower) {
-                found = true;
-                break;
-            }
-            
-            longFilename.clear();
-            
-            // Check for cluster boundary after processing regular entry
-            if (_type == FAT32 && (pos() - _clusterOffset) % _bytesPerCluster == 0) {
-                uint32_t nextCluster = getFAT(_fat32_currentRootDirCluster);
-                if (nextCluster >= 0xFFFFFF8) break;
-                if (_currentDirClusters.contains(nextCluster)) {
-                    qDebug() << "Circular cluster reference in subdirectory" << dirName;
-                    break;
-                }
-                _currentDirClusters.append(nextCluster);
-                _fat32_currentRootDirCluster = nextCluster;
-                seekCluster(_fat32_currentRootDirCluster);
-            }
         }
         
         if (!found) {
@@ -488,10 +500,6 @@ QByteArray DeviceWrapperFatPartition::readFile(const QString &filename)
                      << "entries in" << dirName << ", file" << fileName << "not found";
         }
         
-        // Restore directory state
-        _fat32_currentRootDirCluster = savedCurrentCluster;
-        _currentDirClusters = savedDirClusters;
-        
         if (!found) {
             qDebug() << "DeviceWrapperFatPartition::readFile: file not found:" << filename;
             return QByteArray();
@@ -525,14 +533,26 @@ QByteArray DeviceWrapperFatPartition::readFile(const QString &filename)
     uint32_t pos = 0;
     QByteArray result(len, 0);
 
-    for (uint32_t cluster : std::as_const(clusterList))
+    /* Files are mostly contiguous, so read each run of consecutive
+       clusters at once. Long runs (kernels, initramfs) are read straight
+       from the device; caching them would only cost memory and copies. */
+    constexpr uint32_t kUncachedReadMin = 64 * 1024;
+    for (qsizetype i = 0; i < clusterList.size() && pos < len; )
     {
-        seekCluster(cluster);
-        read(result.data()+pos, qMin(_bytesPerCluster, len-pos));
+        qsizetype run = 1;
+        while (i + run < clusterList.size() && clusterList[i + run] == clusterList[i] + run
+               && static_cast<quint64>(run) * _bytesPerCluster < len - pos)
+            run++;
+
+        const uint32_t runBytes = static_cast<uint32_t>(qMin<quint64>(static_cast<quint64>(run) * _bytesPerCluster, len - pos));
+        seekCluster(clusterList[i]);
+        if (runBytes >= kUncachedReadMin)
+            readUncached(result.data()+pos, runBytes);
+        else
+            read(result.data()+pos, runBytes);
 
-        pos += _bytesPerCluster;
-        if (pos >= len)
-            break;
+        pos += runBytes;
+        i += run;
     }
 
     return result;
@@ -605,59 +625,64 @@ QStringList DeviceWrapperFatPartition::listAllFiles()
     return fileList;
 }
 
-void DeviceWrapperFatPartition::listFilesInDirectory(const QString &dirPath, uint32_t dirCluster, QStringList &fileList)
+template <class Layout>
+void DeviceWrapperFatPartition::listFilesInDirectoryT(const QString &dirPath, uint32_t dirCluster, QStringList &fileList)
 {
-    // Save current directory state
-    uint32_t savedCurrentCluster = _fat32_currentRootDirCluster;
-    QList<uint32_t> savedDirClusters = _currentDirClusters;
-    
-    // Set up for reading this directory
-    if (_type == FAT32) {
-        _fat32_currentRootDirCluster = dirCluster;
-        seekCluster(_fat32_currentRootDirCluster);
-        _currentDirClusters.clear();
-        _currentDirClusters.append(_fat32_currentRootDirCluster);
-    } else {
-        // FAT16/FAT12 subdirectories work differently
-        seekCluster(dirCluster);
-    }
-    
+    loadFAT();
+
+    /* Directory clusters are read whole and their chain followed in the
+       in-memory FAT, rather than reading entries one at a time */
+    QByteArray clusterData(_bytesPerCluster, Qt::Uninitialized);
     struct dir_entry entry;
     QString longFilename;
     uint8_t lfnExpectedChecksum = 0;  // Checksum from LFN entries
     bool haveLfnChecksum = false;
     QList<QPair<QString, uint32_t>> subdirs; // Store subdirectories to process after
-    
-    while (true) {
-        quint64 oldOffset = _offset;
-        read((char *) &entry, sizeof(entry));
-        
-        if (entry.DIR_Name[0] == 0) {
-            // End of directory
-            _offset = oldOffset;
+    uint32_t cluster = dirCluster;
+    uint32_t clustersRead = 0;
+    bool endOfDir = false;
+
+    while (!endOfDir && cluster >= 2 && cluster < Layout::kFirstEndMarker)
+    {
+        if (cluster >= _fatEntries || ++clustersRead > _fatEntries) {
+            qDebug() << "Circular or out of range cluster reference detected in directory" << dirPath;
             break;
         }
-        
-        if (entry.DIR_Attr & ATTR_LONG_NAME) {
-            // Long filename entry
-            struct longfn_entry *l = (struct longfn_entry *) &entry;
-            char lnamePartStr[26] = {0};
-            memcpy(lnamePartStr, l->LDIR_Name1, 10);
-            memcpy(lnamePartStr+10, l->LDIR_Name2, 12);
-            memcpy(lnamePartStr+22, l->LDIR_Name3, 4);
-            QString lnamePart((QChar *) lnamePartStr, 13);
-            longFilename = lnamePart + longFilename;
-            
-            // Capture the checksum from the LFN entry
-            lfnExpectedChecksum = l->LDIR_Chksum;
-            haveLfnChecksum = true;
-        } else {
+        seekCluster(cluster);
+        read(clusterData.data(), _bytesPerCluster);
+
+        for (uint32_t entryOffset = 0; entryOffset + sizeof(entry) <= _bytesPerCluster; entryOffset += sizeof(entry))
+        {
+            memcpy(&entry, clusterData.constData() + entryOffset, sizeof(entry));
+
+            if (entry.DIR_Name[0] == 0) {
+                // End of directory
+                endOfDir = true;
+                break;
+            }
+
+            if (entry.DIR_Attr & ATTR_LONG_NAME) {
+                // Long filename entry
+                struct longfn_entry *l = (struct longfn_entry *) &entry;
+                char lnamePartStr[26] = {0};
+                memcpy(lnamePartStr, l->LDIR_Name1, 10);
+                memcpy(lnamePartStr+10, l->LDIR_Name2, 12);
+                memcpy(lnamePartStr+22, l->LDIR_Name3, 4);
+                QString lnamePart((QChar *) lnamePartStr, 13);
+                longFilename = lnamePart + longFilename;
+
+                // Capture the checksum from the LFN entry
+                lfnExpectedChecksum = l->LDIR_Chksum;
+                haveLfnChecksum = true;
+                continue;
+            }
+
             // Regular directory entry
             if (entry.DIR_Name[0] != 0xE5) { // Not deleted
                 // Truncate long filename at null char
                 if (longFilename.indexOf(QChar::Null) >= 0)
                     longFilename.truncate(longFilename.indexOf(QChar::Null));
-                
+
                 // Get short filename as fallback
                 QString shortName;
                 int nameLen = 8;
@@ -672,20 +697,20 @@ void DeviceWrapperFatPartition::listFilesInDirectory(const QString &dirPath, uin
                     }
                 }
                 shortName = shortName.trimmed();
-                
+
                 // Choose filename: validate LFN checksum if we have an LFN
                 QString filename;
                 if (!longFilename.isEmpty() && haveLfnChecksum) {
                     // Calculate actual checksum of the short name
                     uint8_t actualChecksum = lfnChecksum(entry.DIR_Name);
-                    
+
                     if (actualChecksum == lfnExpectedChecksum) {
                         // Checksum matches - LFN is valid
                         filename = longFilename;
                     } else {
                         // Checksum mismatch - LFN is orphaned/corrupt, use short name
-                        qDebug() << "LFN checksum mismatch for" << shortName 
-                                 << "(expected:" << lfnExpectedChecksum 
+                        qDebug() << "LFN checksum mismatch for" << shortName
+                                 << "(expected:" << lfnExpectedChecksum
                                  << "actual:" << actualChecksum << "), using short name";
                         filename = shortName;
                     }
@@ -693,17 +718,17 @@ void DeviceWrapperFatPartition::listFilesInDirectory(const QString &dirPath, uin
                     // No LFN or no checksum - use short name
                     filename = shortName;
                 }
-                
+
                 // Skip volume labels and current/parent directory markers
-                if (!(entry.DIR_Attr & ATTR_VOLUME_ID) && 
+                if (!(entry.DIR_Attr & ATTR_VOLUME_ID) &&
                     filename != "." && filename != "..") {
-                    
+
                     QString fullPath = dirPath.isEmpty() ? filename : dirPath + "/" + filename;
-                    
+
                     if (entry.DIR_Attr & ATTR_DIRECTORY) {
                         // Get directory cluster
                         uint32_t subDirCluster = entry.DIR_FstClusLO;
-                        if (_type == FAT32) {
+                        if constexpr (Layout::kHasClusterHi) {
                             subDirCluster |= (entry.DIR_FstClusHI << 16);
                         }
                         // Store for recursive processing
@@ -714,36 +739,17 @@ void DeviceWrapperFatPartition::listFilesInDirectory(const QString &dirPath, uin
                     }
                 }
             }
-            
+
             longFilename.clear();
             haveLfnChecksum = false;
         }
-        
-        // Handle cluster boundary for FAT32
-        if (_type == FAT32) {
-            if ((pos()-_clusterOffset) % _bytesPerCluster == 0) {
-                uint32_t nextCluster = getFAT(_fat32_currentRootDirCluster);
-                if (nextCluster > 0xFFFFFF7) {
-                    break; // End of cluster chain
-                }
-                if (_currentDirClusters.contains(nextCluster)) {
-                    qDebug() << "Circular cluster reference detected in directory" << dirPath;
-                    break;
-                }
-                _currentDirClusters.append(nextCluster);
-                _fat32_currentRootDirCluster = nextCluster;
-                seekCluster(_fat32_currentRootDirCluster);
-            }
-        }
+
+        cluster = fatEntryT<Layout>(cluster) & Layout::kValueMask;
     }
-    
-    // Restore directory state
-    _fat32_currentRootDirCluster = savedCurrentCluster;
-    _currentDirClusters = savedDirClusters;
-    
+
     // Now recursively process subdirectories
     for (const auto &subdir : subdirs) {
-        listFilesInDirectory(subdir.first, subdir.second, fileList);
+        listFilesInDirectoryT<Layout>(subdir.first, subdir.second, fileList);
     }
 }
 
@@ -899,10 +905,7 @@ void DeviceWrapperFatPartition::writeFile(const QString &filename, const QByteAr
 
             if (!clusterList.isEmpty())
             {
-                if (_type == FAT16)
-                    setFAT16(clusterList.last(), 0xFFFF);
-                else
-                    setFAT32(clusterList.last(), 0xFFFFFFF);
+                setFAT(clusterList.last(), _endOfChain);
             }
         }
 
@@ -932,7 +935,7 @@ void DeviceWrapperFatPartition::writeFile(const QString &filename, const QByteAr
 
         /* Update directory entry */
         if (clusterList.isEmpty())
-            firstCluster = (_type == FAT16 ? 0xFFFF : 0xFFFFFFF);
+            firstCluster = _endOfChain;
         else
             firstCluster = clusterList.first();
 
@@ -1004,10 +1007,7 @@ void DeviceWrapperFatPartition::writeFile(const QString &filename, const QByteAr
 
         if (!clusterList.isEmpty())
         {
-            if (_type == FAT16)
-                setFAT16(clusterList.last(), 0xFFFF);
-            else
-                setFAT32(clusterList.last(), 0xFFFFFFF);
+            setFAT(clusterList.last(), _endOfChain);
         }
     }
 
@@ -1037,7 +1037,7 @@ void DeviceWrapperFatPartition::writeFile(const QString &filename, const QByteAr
 
     /* Update directory entry */
     if (clusterList.isEmpty())
-        firstCluster = (_type == FAT16 ? 0xFFFF : 0xFFFFFFF);
+        firstCluster = _endOfChain;
     else
         firstCluster = clusterList.first();
 
@@ -1053,83 +1053,150 @@ void DeviceWrapperFatPartition::writeFile(const QString &filename, const QByteAr
     qDebug() << "writeFile: updateDirEntry succeeded for" << filename;
 }
 
-inline QByteArray _dirEntryToShortName(struct dir_entry *entry)
+void DeviceWrapperFatPartition::writeFiles(const QMap<QString, QByteArray> &files)
 {
-    QByteArray base = QByteArray((char *) entry->DIR_Name, 8).trimmed().toLower();
-    QByteArray ext = QByteArray((char *) entry->DIR_Name+8, 3).trimmed().toLower();
+    struct PendingFile {
+        const QByteArray *contents;
+        struct dir_entry entry;
+        QList<uint32_t> clusterList;
+        int clustersNeeded;
+    };
+    QList<PendingFile> pending;
+    QStringList inSubdirectories;
+    int extraClustersNeeded = 0;
+
+    /* Look up or create every entry, and give back the clusters of files
+       that shrink, before anything is allocated */
+    for (auto it = files.cbegin(); it != files.cend(); ++it)
+    {
+        if (it.key().contains('/'))
+        {
+            inSubdirectories.append(it.key());
+            continue;
+        }
 
-    if (ext.isEmpty())
-        return base;
-    else
-        return base+"."+ext;
-}
+        PendingFile file;
+        file.contents = &it.value();
+        file.clustersNeeded = (it.value().length() + _bytesPerCluster - 1) / _bytesPerCluster;
+        getDirEntry(it.key(), &file.entry, true);
+        uint32_t firstCluster = file.entry.DIR_FstClusLO;
+        if (_type == FAT32)
+            firstCluster |= (file.entry.DIR_FstClusHI << 16);
+        if (firstCluster)
+            file.clusterList = getClusterChain(firstCluster);
 
-bool DeviceWrapperFatPartition::getDirEntry(const QString &longFilename, struct dir_entry *entry, bool createIfNotExist)
-{
-    QString filenameRead, longFilenameLower = longFilename.toLower();
-    uint8_t lfnExpectedChecksum = 0;
-    bool haveLfnChecksum = false;
+        if (file.clusterList.length() > file.clustersNeeded)
+        {
+            int clustersToRemove = file.clusterList.length() - file.clustersNeeded;
+            uint32_t clusterToRemove = 0;
+            QByteArray zeroes(_bytesPerCluster, 0);
 
-    if (longFilename.isEmpty())
-        throw std::runtime_error("Filename cannot not be empty");
+            for (int i = 0; i < clustersToRemove; i++)
+            {
+                clusterToRemove = file.clusterList.takeLast();
 
-    openDir();
-    while (readDir(entry))
+                /* Zero out previous data in excess clusters,
+                   just in case someone wants to take a disk image later */
+                seekCluster(clusterToRemove);
+                write(zeroes.data(), zeroes.length());
+                setFAT(clusterToRemove, 0);
+            }
+            updateFSinfo(clustersToRemove, clusterToRemove);
+
+            if (!file.clusterList.isEmpty())
+                setFAT(file.clusterList.last(), _endOfChain);
+        }
+        extraClustersNeeded += qMax(0, file.clustersNeeded - static_cast<int>(file.clusterList.length()));
+        pending.append(file);
+    }
+
+    /* Files that grow take their new clusters from one run, in order, so
+       consecutive files end up in consecutive clusters */
+    const QList<uint32_t> newClusters = allocateClusters(extraClustersNeeded);
+    qsizetype nextNewCluster = 0;
+    for (PendingFile &file : pending)
     {
-        if (entry->DIR_Attr & ATTR_LONG_NAME)
+        while (file.clusterList.length() < file.clustersNeeded)
         {
-            struct longfn_entry *l = (struct longfn_entry *) entry;
-            /* A part can have 13 UTF-16 characters */
-            char lnamePartStr[26] = {0};
-             /* Using memcpy() because it has no problems accessing unaligned struct members */
-            memcpy(lnamePartStr, l->LDIR_Name1, 10);
-            memcpy(lnamePartStr+10, l->LDIR_Name2, 12);
-            memcpy(lnamePartStr+22, l->LDIR_Name3, 4);
-            QString lnamePart( (QChar *) lnamePartStr, 13);
-            filenameRead = lnamePart + filenameRead;
-            
-            // Capture checksum from LFN entry
-            lfnExpectedChecksum = l->LDIR_Chksum;
-            haveLfnChecksum = true;
+            const uint32_t cluster = newClusters.at(nextNewCluster++);
+            if (!file.clusterList.isEmpty())
+                setFAT(file.clusterList.last(), cluster);
+            file.clusterList.append(cluster);
         }
-        else
-        {
-            if (entry->DIR_Name[0] != 0xE5)
-            {
-                if (filenameRead.indexOf(QChar::Null))
-                    filenameRead.truncate(filenameRead.indexOf(QChar::Null));
+        writeClusterData(file.clusterList, *file.contents);
+    }
 
-                //qDebug() << "Long filename:" << filenameRead << "DIR_Name:" << QByteArray((char *) entry->DIR_Name, sizeof(entry->DIR_Name)) << "Short:" << _dirEntryToShortName(entry);
+    /* Then all directory entries, in one pass */
+    const uint16_t writeDate = QDateToFATdate( QDate::currentDate() );
+    const uint16_t writeTime = QTimeToFATtime( QTime::currentTime() );
+    for (PendingFile &file : pending)
+    {
+        const uint32_t firstCluster = file.clusterList.isEmpty() ? _endOfChain : file.clusterList.first();
+        file.entry.DIR_FstClusLO = (firstCluster & 0xFFFF);
+        file.entry.DIR_FstClusHI = (firstCluster >> 16);
+        file.entry.DIR_WrtDate = writeDate;
+        file.entry.DIR_WrtTime = writeTime;
+        file.entry.DIR_LstAccDate = writeDate;
+        file.entry.DIR_FileSize = file.contents->length();
+        updateDirEntry(&file.entry);
+    }
 
-                // Validate LFN checksum if we have an LFN
-                QString actualFilename;
-                if (!filenameRead.isEmpty() && haveLfnChecksum) {
-                    uint8_t actualChecksum = lfnChecksum(entry->DIR_Name);
-                    if (actualChecksum == lfnExpectedChecksum) {
-                        // Checksum matches - use LFN
-                        actualFilename = filenameRead;
-                    } else {
-                        // Checksum mismatch - use short name
-                        actualFilename = _dirEntryToShortName(entry);
-                    }
-                } else {
-                    actualFilename = _dirEntryToShortName(entry);
-                }
+    /* writeFile() switches to the subdirectory for these */
+    for (const QString &filename : std::as_const(inSubdirectories))
+        writeFile(filename, files.value(filename));
 
-                if (actualFilename.toLower() == longFilenameLower)
-                {
-                    return true;
-                }
-            }
+    qDebug() << "DeviceWrapperFatPartition::writeFiles: wrote" << files.size() << "files,"
+             << extraClustersNeeded << "new clusters";
+}
 
-            filenameRead.clear();
-            haveLfnChecksum = false;
-        }
+/* Write contents to its clusters, a run of consecutive clusters at a time */
+void DeviceWrapperFatPartition::writeClusterData(const QList<uint32_t> &clusterList, const QByteArray &contents)
+{
+    qsizetype pos = 0;
+    for (qsizetype i = 0; i < clusterList.size() && pos < contents.length();)
+    {
+        qsizetype end = i + 1;
+        while (end < clusterList.size() && clusterList.at(end) == clusterList.at(end - 1) + 1)
+            end++;
+
+        const qsizetype len = qMin((end - i) * static_cast<qsizetype>(_bytesPerCluster), contents.length() - pos);
+        seekCluster(clusterList.at(i));
+        write(contents.constData() + pos, len);
+        pos += len;
+        i = end;
+    }
+
+    if (!clusterList.isEmpty() && contents.length() % _bytesPerCluster)
+    {
+        /* Zero out last cluster tip */
+        QByteArray zeroes(_bytesPerCluster - (contents.length() % _bytesPerCluster), 0);
+        write(zeroes.data(), zeroes.length());
+    }
+}
+
+bool DeviceWrapperFatPartition::getDirEntry(const QString &longFilename, struct dir_entry *entry, bool createIfNotExist)
+{
+    QString longFilenameLower = longFilename.toLower();
+
+    if (longFilename.isEmpty())
+        throw std::runtime_error("Filename cannot not be empty");
+
+    DirIndex &index = rootDirIndex();
+    auto indexIt = index.names.constFind(longFilenameLower);
+    if (indexIt != index.names.constEnd())
+    {
+        _offset = indexIt.value();
+        read((char *) entry, sizeof(*entry));
+        return true;
     }
 
     if (createIfNotExist)
     {
         qDebug() << "getDirEntry: creating new entry for" << longFilename;
+        /* Append at the end-of-directory marker */
+        _offset = index.endOffset;
+        _fat32_currentRootDirCluster = index.endCluster;
+        _currentDirClusters = index.endDirClusters;
         QByteArray shortFilename;
         uint8_t shortFileNameChecksum = 0;
         struct longfn_entry longEntry;
@@ -1213,8 +1280,17 @@ bool DeviceWrapperFatPartition::getDirEntry(const QString &longFilename, struct
         entry->DIR_CrtDate = QDateToFATdate( QDate::currentDate() );
         entry->DIR_CrtTime = QTimeToFATtime( QTime::currentTime() );
 
+        quint64 entryOffset = _offset;
         writeDirEntryAtCurrentPos(entry);
 
+        index.names.insert(longFilenameLower, entryOffset);
+        index.names.insert(QString::fromLatin1(_dirEntryToShortName(entry)), entryOffset);
+        index.shortNames.insert(shortFilename, entryOffset);
+        index.entryCount++;
+        index.endOffset = _offset;
+        index.endCluster = _fat32_currentRootDirCluster;
+        index.endDirClusters = _currentDirClusters;
+
         qDebug() << "getDirEntry: writing end-of-directory marker";
         /* Add an end-of-directory marker after our newly appended file */
         struct dir_entry endOfDir = {0};
@@ -1229,19 +1305,7 @@ bool DeviceWrapperFatPartition::getDirEntry(const QString &longFilename, struct
 
 bool DeviceWrapperFatPartition::dirNameExists(const QByteArray dirname)
 {
-    struct dir_entry entry;
-
-    openDir();
-    while (readDir(&entry))
-    {
-        if (!(entry.DIR_Attr & ATTR_LONG_NAME)
-                && dirname == QByteArray((char *) entry.DIR_Name, sizeof(entry.DIR_Name)))
-        {
-            return true;
-        }
-    }
-
-    return false;
+    return rootDirIndex().shortNames.contains(dirname);
 }
 
 void DeviceWrapperFatPartition::updateDirEntry(struct dir_entry *dirEntry)
@@ -1252,6 +1316,51 @@ void DeviceWrapperFatPartition::updateDirEntry(struct dir_entry *dirEntry)
     // by temporarily using a non-deleted first byte for comparison
     bool searchingForDeleted = (dirEntry->DIR_Name[0] == 0xE5);
 
+    DirIndex &index = rootDirIndex();
+    QByteArray name((char *) dirEntry->DIR_Name, sizeof(dirEntry->DIR_Name));
+    QByteArray indexedName;
+
+    if (!searchingForDeleted)
+    {
+        if (index.shortNames.contains(name))
+            indexedName = name;
+    }
+    else
+    {
+        /* Deleting: find the live entry whose name differs only in the first byte */
+        int candidates = 0;
+        for (auto it = index.shortNames.cbegin(); it != index.shortNames.cend(); ++it)
+        {
+            if (static_cast<uint8_t>(it.key().at(0)) != 0xE5 && it.key().mid(1) == name.mid(1))
+            {
+                indexedName = it.key();
+                candidates++;
+            }
+        }
+        if (candidates != 1)
+            indexedName.clear();
+    }
+
+    if (!indexedName.isEmpty())
+    {
+        quint64 entryOffset = index.shortNames.value(indexedName);
+        _offset = entryOffset;
+        write((char *) dirEntry, sizeof(*dirEntry));
+
+        if (searchingForDeleted)
+        {
+            index.shortNames.remove(indexedName);
+            if (!index.shortNames.contains(name))
+                index.shortNames.insert(name, entryOffset);
+            index.names.removeIf([entryOffset](const auto &it) { return it.value() == entryOffset; });
+            index.entryCount--;
+        }
+        return;
+    }
+
+    /* Ambiguous or unknown: fall back to scanning the directory */
+    _rootDirIndexValid = false;
+
     openDir();
     quint64 oldOffset = _offset;
 
@@ -1326,6 +1435,152 @@ void DeviceWrapperFatPartition::writeDirEntryAtCurrentPos(struct dir_entry *dirE
     }
 }
 
+/* Reassembled name of an LFN sequence, in order of the entries read */
+static void appendLfnPart(QString &name, struct dir_entry *entry)
+{
+    struct longfn_entry *l = (struct longfn_entry *) entry;
+    /* A part can have 13 UTF-16 characters */
+    char lnamePartStr[26] = {0};
+    /* Using memcpy() because it has no problems accessing unaligned struct members */
+    memcpy(lnamePartStr, l->LDIR_Name1, 10);
+    memcpy(lnamePartStr+10, l->LDIR_Name2, 12);
+    memcpy(lnamePartStr+22, l->LDIR_Name3, 4);
+    name = QString((QChar *) lnamePartStr, 13) + name;
+}
+
+DeviceWrapperFatPartition::DirIndex &DeviceWrapperFatPartition::rootDirIndex()
+{
+    if (_rootDirIndexValid)
+        return _rootDirIndex;
+
+    /* Same matching rules getDirEntry() used when it scanned the directory
+       for every lookup: LFN if its checksum matches, else the 8.3 name */
+    DirIndex &index = _rootDirIndex;
+    index = DirIndex();
+    struct dir_entry entry;
+    QString filenameRead;
+    uint8_t lfnExpectedChecksum = 0;
+    bool haveLfnChecksum = false;
+
+    openDir();
+    quint64 entryOffset = _offset;
+    while (readDir(&entry))
+    {
+        if (entry.DIR_Attr & ATTR_LONG_NAME)
+        {
+            appendLfnPart(filenameRead, &entry);
+            lfnExpectedChecksum = ((struct longfn_entry *) &entry)->LDIR_Chksum;
+            haveLfnChecksum = true;
+        }
+        else
+        {
+            QByteArray shortName((char *) entry.DIR_Name, sizeof(entry.DIR_Name));
+            if (!index.shortNames.contains(shortName))
+                index.shortNames.insert(shortName, entryOffset);
+
+            if (entry.DIR_Name[0] != 0xE5)
+            {
+                if (filenameRead.indexOf(QChar::Null))
+                    filenameRead.truncate(filenameRead.indexOf(QChar::Null));
+
+                QString actualFilename;
+                if (!filenameRead.isEmpty() && haveLfnChecksum && lfnChecksum(entry.DIR_Name) == lfnExpectedChecksum)
+                    actualFilename = filenameRead.toLower();
+                else
+                    actualFilename = QString::fromLatin1(_dirEntryToShortName(&entry));
+
+                if (!index.names.contains(actualFilename))
+                    index.names.insert(actualFilename, entryOffset);
+                index.entryCount++;
+            }
+
+            filenameRead.clear();
+            haveLfnChecksum = false;
+        }
+        entryOffset = _offset;
+    }
+
+    /* readDir() leaves us at the end-of-directory marker */
+    index.endOffset = _offset;
+    index.endCluster = _fat32_currentRootDirCluster;
+    index.endDirClusters = _currentDirClusters;
+    _rootDirIndexValid = true;
+    return index;
+}
+
+const DeviceWrapperFatPartition::DirIndex &DeviceWrapperFatPartition::subdirIndex(uint32_t dirCluster)
+{
+    auto cached = _subdirIndex.constFind(dirCluster);
+    if (cached != _subdirIndex.constEnd())
+        return cached.value();
+
+    // Save current directory state
+    uint32_t savedCurrentCluster = _fat32_currentRootDirCluster;
+    QList<uint32_t> savedDirClusters = _currentDirClusters;
+
+    if (_type == FAT32) {
+        _fat32_currentRootDirCluster = dirCluster;
+        _currentDirClusters.clear();
+        _currentDirClusters.append(_fat32_currentRootDirCluster);
+    }
+    seekCluster(dirCluster);
+
+    DirIndex index;
+    struct dir_entry entry;
+    QString longFilename;
+
+    while (true) {
+        quint64 entryOffset = _offset;
+        read((char *) &entry, sizeof(entry));
+
+        if (entry.DIR_Name[0] == 0) {
+            // End of directory
+            index.endOffset = entryOffset;
+            break;
+        }
+
+        if (entry.DIR_Name[0] == 0xE5) {
+            // Deleted entry, skip
+            longFilename.clear();
+        } else if (entry.DIR_Attr & ATTR_LONG_NAME) {
+            appendLfnPart(longFilename, &entry);
+        } else {
+            // Truncate long filename at null char
+            if (longFilename.indexOf(QChar::Null) >= 0) {
+                longFilename.truncate(longFilename.indexOf(QChar::Null));
+            }
+
+            // Short filename as fallback
+            QString actualFilename = longFilename.isEmpty()
+                    ? QString::fromLatin1(_dirEntryToShortName(&entry))
+                    : longFilename.toLower();
+            if (!index.names.contains(actualFilename))
+                index.names.insert(actualFilename, entryOffset);
+            index.entryCount++;
+            longFilename.clear();
+        }
+
+        // Follow the cluster chain at cluster boundaries
+        if (_type == FAT32 && (pos() - _clusterOffset) % _bytesPerCluster == 0) {
+            uint32_t nextCluster = getFAT(_fat32_currentRootDirCluster);
+            if (nextCluster >= 0xFFFFFF8) break;
+            if (_currentDirClusters.contains(nextCluster)) {
+                qDebug() << "Circular cluster reference in subdirectory cluster" << dirCluster;
+                break;
+            }
+            _currentDirClusters.append(nextCluster);
+            _fat32_currentRootDirCluster = nextCluster;
+            seekCluster(_fat32_currentRootDirCluster);
+        }
+    }
+
+    // Restore directory state
+    _fat32_currentRootDirCluster = savedCurrentCluster;
+    _currentDirClusters = savedDirClusters;
+
+    return _subdirIndex.insert(dirCluster, index).value();
+}
+
 void DeviceWrapperFatPartition::openDir()
 {
     /* Seek to start of root directory */
@@ -1388,6 +1643,18 @@ bool DeviceWrapperFatPartition::readDir(struct dir_entry *result)
 }
 
 void DeviceWrapperFatPartition::updateFSinfo(int deltaClusters, uint32_t nextFreeClusterHint)
+{
+    if (!_fat32_fsinfoSector)
+        return;
+
+    /* Accumulated and written once by flush() */
+    _fsinfoFreeDelta += deltaClusters;
+    if (nextFreeClusterHint)
+        _nextFreeCluster = qMin(_nextFreeCluster, nextFreeClusterHint);
+    _fsinfoDirty = true;
+}
+
+void DeviceWrapperFatPartition::writeFSinfo()
 {
     struct FSInfo fsinfo;
 
@@ -1407,14 +1674,14 @@ void DeviceWrapperFatPartition::updateFSinfo(int deltaClusters, uint32_t nextFre
         throw std::runtime_error("FAT32 FSinfo structure corrupt. Signature does not match.");
     }
 
-    if (deltaClusters != 0 && fsinfo.FSI_Free_Count != 0xFFFFFFFF)
+    if (_fsinfoFreeDelta != 0 && fsinfo.FSI_Free_Count != 0xFFFFFFFF)
     {
-        fsinfo.FSI_Free_Count += deltaClusters;
+        fsinfo.FSI_Free_Count += _fsinfoFreeDelta;
     }
 
-    if (nextFreeClusterHint)
+    if (_nextFreeCluster < _fatEntries)
     {
-        fsinfo.FSI_Nxt_Free = nextFreeClusterHint;
+        fsinfo.FSI_Nxt_Free = _nextFreeCluster;
     }
 
     seek(_fat32_fsinfoSector * _bytesPerSector);
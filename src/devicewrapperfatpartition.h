@@ -8,6 +8,10 @@
 
 #include "devicewrapperpartition.h"
 #include <QObject>
+#include <QBitArray>
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
 #include <QDate>
 #include <QTime>
 
@@ -22,10 +26,14 @@ public:
 
     QByteArray readFile(const QString &filename);
     void writeFile(const QString &filename, const QByteArray &contents);
+    /* Several files at once: new clusters for all of them are taken as one
+       contiguous run, so their data goes out in large sequential writes on sync */
+    void writeFiles(const QMap<QString, QByteArray> &files);
     bool fileExists(const QString &filename);
     bool deleteFile(const QString &filename);
     QStringList listAllFiles(); // List all files recursively
     QStringList listAllFilesRecursive(); // List all files including subdirectories
+    void flush() override; // Write modified FAT sectors and FSinfo to the DeviceWrapper
 
 protected:
     enum fatType _type;
@@ -36,22 +44,85 @@ protected:
     QList<uint32_t> _fatStartOffset;
     QList<uint32_t> _currentDirClusters;
 
-    QList<uint32_t> getClusterChain(uint32_t firstCluster);
-    void setFAT16(uint16_t cluster, uint16_t value);
-    void setFAT32(uint32_t cluster, uint32_t value);
-    void setFAT(uint32_t cluster, uint32_t value);
-    uint32_t getFAT(uint32_t cluster);
+    /* In-memory copy of the first FAT, loaded on first use */
+    QByteArray _fat;
+    QBitArray _freeClusters, _dirtyFatSectors;
+    uint32_t _fatEntries, _nextFreeCluster;
+    int _fsinfoFreeDelta;
+    bool _fatLoaded, _fsinfoDirty;
+
+    /* FAT16 and FAT32 differ in entry width, masks and end-of-chain marker.
+       The hot routines are templates on one of these, picked once at open,
+       so that walking a chain or a directory does not test _type per entry */
+    struct Fat16Layout {
+        using Entry = uint16_t;
+        static constexpr uint32_t kValueMask = 0xFFFF;
+        static constexpr uint32_t kReservedBits = 0;
+        static constexpr uint32_t kEndOfChain = 0xFFFF;
+        static constexpr uint32_t kFirstEndMarker = 0xFFF8;
+        static constexpr bool kHasClusterHi = false;
+    };
+    struct Fat32Layout {
+        using Entry = uint32_t;
+        static constexpr uint32_t kValueMask = 0x0FFFFFFF;
+        static constexpr uint32_t kReservedBits = 0xF0000000;
+        static constexpr uint32_t kEndOfChain = 0x0FFFFFFF;
+        static constexpr uint32_t kFirstEndMarker = 0x0FFFFFF8;
+        static constexpr bool kHasClusterHi = true;
+    };
+
+    uint32_t _endOfChain;
+    uint32_t (DeviceWrapperFatPartition::*_getFAT)(uint32_t);
+    void (DeviceWrapperFatPartition::*_setFAT)(uint32_t, uint32_t);
+    QList<uint32_t> (DeviceWrapperFatPartition::*_getClusterChain)(uint32_t);
+    void (DeviceWrapperFatPartition::*_listFilesInDirectory)(const QString &, uint32_t, QStringList &);
+
+    template <class Layout> void useLayout();
+    template <class Layout> uint32_t fatEntryT(uint32_t cluster) const;
+    template <class Layout> void setFatEntryT(uint32_t cluster, uint32_t value);
+    template <class Layout> uint32_t getFATT(uint32_t cluster);
+    template <class Layout> void setFATT(uint32_t cluster, uint32_t value);
+    template <class Layout> QList<uint32_t> getClusterChainT(uint32_t firstCluster);
+    template <class Layout> void scanFreeClustersT();
+    template <class Layout> void listFilesInDirectoryT(const QString &dirPath, uint32_t dirCluster, QStringList &fileList);
+
+    void loadFAT();
+
+    /* Name lookup tables for a directory, built on first access */
+    struct DirIndex {
+        QHash<QString, quint64> names;         // lower-case file name -> offset of its 8.3 entry
+        QHash<QByteArray, quint64> shortNames; // raw DIR_Name (including deleted) -> offset
+        int entryCount = 0;
+        /* Position of the end-of-directory marker, where new entries are appended */
+        quint64 endOffset = 0;
+        uint32_t endCluster = 0;
+        QList<uint32_t> endDirClusters;
+    };
+    DirIndex _rootDirIndex;
+    bool _rootDirIndexValid;
+    QHash<uint32_t, DirIndex> _subdirIndex;
+
+    DirIndex &rootDirIndex();
+    const DirIndex &subdirIndex(uint32_t dirCluster);
+
+    QList<uint32_t> getClusterChain(uint32_t firstCluster) { return (this->*_getClusterChain)(firstCluster); }
+    void setFAT(uint32_t cluster, uint32_t value) { (this->*_setFAT)(cluster, value); }
+    uint32_t getFAT(uint32_t cluster) { return (this->*_getFAT)(cluster); }
     void seekCluster(uint32_t cluster);
     uint32_t allocateCluster();
     uint32_t allocateCluster(uint32_t previousCluster);
+    QList<uint32_t> allocateClusters(int count);
+    void writeClusterData(const QList<uint32_t> &clusterList, const QByteArray &contents);
     bool getDirEntry(const QString &longFilename, struct dir_entry *entry, bool createIfNotExist = false);
     bool dirNameExists(const QByteArray dirname);
     void updateDirEntry(struct dir_entry *dirEntry);
     void writeDirEntryAtCurrentPos(struct dir_entry *dirEntry);
     void openDir();
     bool readDir(struct dir_entry *result);
-    void listFilesInDirectory(const QString &dirPath, uint32_t dirCluster, QStringList &fileList); // Helper for recursive listing
+    void listFilesInDirectory(const QString &dirPath, uint32_t dirCluster, QStringList &fileList) // Helper for recursive listing
+        { (this->*_listFilesInDirectory)(dirPath, dirCluster, fileList); }
     void updateFSinfo(int deltaClusters, uint32_t nextFreeClusterHint);
+    void writeFSinfo();
     uint16_t QTimeToFATtime(const QTime &time);
     uint16_t QDateToFATdate(const QDate &date);
 };
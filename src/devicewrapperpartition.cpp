@@ -10,6 +10,7 @@ DeviceWrapperPartition::DeviceWrapperPartition(DeviceWrapper *dw, quint64 partSt
     : QObject{parent}, _dw(dw), _partStart(partStart), _partLen(partLen), _offset(partStart)
 {
     _partEnd = _partStart + _partLen;
+    _dw->_partitions.append(this);
 }
 
 DeviceWrapperPartition::~DeviceWrapperPartition()
@@ -30,6 +31,17 @@ void DeviceWrapperPartition::read(char *data, qint64 size)
     _offset += size;
 }
 
+void DeviceWrapperPartition::readUncached(char *data, qint64 size)
+{
+    if (size < 0 || static_cast<quint64>(size) > _partEnd - _offset)
+    {
+        throw std::runtime_error("Error: trying to read beyond partition");
+    }
+
+    _dw->preadUncached(data, size, _offset);
+    _offset += size;
+}
+
 void DeviceWrapperPartition::seek(qint64 pos)
 {
     if (pos < 0 || static_cast<quint64>(pos) > _partLen)
@@ -17,10 +17,14 @@ public:
     explicit DeviceWrapperPartition(DeviceWrapper *dw, quint64 partStart, quint64 partLen, QObject *parent = nullptr);
     virtual ~DeviceWrapperPartition();
     void read(char *data, qint64 size);
+    /* read() for large file data, without going through the block cache */
+    void readUncached(char *data, qint64 size);
     void seek(qint64 pos);
     qint64 pos() const;
     void write(const char *data, qint64 size);
     DeviceWrapper *deviceWrapper() const { return _dw; }
+    /* Called by DeviceWrapper::sync() to write back any state the partition caches itself */
+    virtual void flush() {}
 
 protected:
     DeviceWrapper *_dw;
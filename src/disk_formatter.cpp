@@ -102,7 +102,8 @@ FormatError DiskFormatter::ConvertError(FileError error) const {
   return ConvertFileError(error);
 }
 
-Result<void> DiskFormatter::FormatDrive(const std::string& device_path) {
+Result<void> DiskFormatter::FormatDrive(const std::string& device_path,
+                                       FormatMode mode) {
   // Pre-format checks for Windows physical drives
 #ifdef _WIN32
   if (device_path.find("\\\\.\\PHYSICALDRIVE") == 0) {
@@ -126,6 +127,18 @@ Result<void> DiskFormatter::FormatDrive(const std::string& device_path) {
     return Result<void>(ConvertError(error));
   }
 
+  device_zeroed_ = false;
+  if (mode == FormatMode::kQuick) {
+    if (file_ops_->EraseDevice() == FileError::kSuccess) {
+      // Discarded blocks only read back as zeros where the device says so;
+      // elsewhere the FATs are still zeroed, if with ZeroRange() where possible
+      device_zeroed_ = file_ops_->GetZeroRangeMethod() == FileOperations::ZeroRangeMethod::kDiscard;
+      std::cout << "Quick format: discarded device" << (device_zeroed_ ? ", skipping zero ranges" : "") << std::endl;
+    } else {
+      std::cout << "Quick format: discard not supported, formatting in full" << std::endl;
+    }
+  }
+
   // Write MBR
   if (auto result = WriteMbr(device_size_bytes); !result) {
     return result;
@@ -148,6 +161,7 @@ Result<void> DiskFormatter::FormatFile(
   if (error != FileError::kSuccess) {
     return Result<void>(ConvertError(error));
   }
+  device_zeroed_ = false;
 
   // Write MBR
   if (auto result = WriteMbr(file_size_bytes); !result) {
@@ -377,14 +391,19 @@ Result<void> DiskFormatter::WriteFatTables(
   
   std::uint32_t sectors_per_fat = CalculateSectorsPerFat(config);
   std::uint64_t fat_size_bytes = static_cast<std::uint64_t>(sectors_per_fat) * kSectorSize;
-  
+
+  // Only the first three entries are set; the rest of each FAT is zeros, so
+  // a FAT is written as its head followed by a zero range rather than as one
+  // buffer the size of the FAT (hundreds of MB on large cards)
+  std::size_t head_size = static_cast<std::size_t>(std::min<std::uint64_t>(kFatHeadSize, fat_size_bytes));
+
   // Use aligned buffer for O_DIRECT compatibility on Linux
-  AlignedBuffer fat_table(fat_size_bytes);
-  if (!fat_table.valid()) {
+  AlignedBuffer fat_head(head_size);
+  if (!fat_head.valid()) {
     return Result<void>(FormatError::kFileWriteError);
   }
   
-  auto* fat_entries = fat_table.as<std::uint32_t>();
+  auto* fat_entries = fat_head.as<std::uint32_t>();
   
   // First three entries are special
   fat_entries[0] = ToLittleEndian(0x0FFFFFF8);  // Media descriptor + end marker
@@ -395,35 +414,65 @@ Result<void> DiskFormatter::WriteFatTables(
   for (std::uint8_t fat_num = 0; fat_num < config.num_fats; ++fat_num) {
     std::uint64_t fat_offset = (static_cast<std::uint64_t>(fat_start_sector)
         + static_cast<std::uint64_t>(fat_num) * sectors_per_fat) * kSectorSize;
-    FileError error = file_ops_->WriteAtOffset(fat_offset, fat_table.data(), fat_size_bytes);
+    FileError error = file_ops_->WriteAtOffset(fat_offset, fat_head.data(), head_size);
     if (error != FileError::kSuccess) {
       return Result<void>(ConvertError(error));
     }
+    if (auto result = WriteZeros(fat_offset + head_size, fat_size_bytes - head_size); !result) {
+      return result;
+    }
   }
   
   return Result<void>();
 }
 
+Result<void> DiskFormatter::WriteZeros(
+    std::uint64_t offset,
+    std::uint64_t length) const {
+
+  if (device_zeroed_) {
+    return Result<void>();
+  }
+
+  // Let the device clear whole blocks itself (BLKZEROOUT/BLKDISCARD) if it can
+  if (file_ops_->GetZeroRangeMethod() != FileOperations::ZeroRangeMethod::kNone
+      && offset % kZeroRangeAlignment == 0) {
+    std::uint64_t aligned_length = length / kZeroRangeAlignment * kZeroRangeAlignment;
+    if (aligned_length > 0 && file_ops_->ZeroRange(offset, aligned_length) == FileError::kSuccess) {
+      offset += aligned_length;
+      length -= aligned_length;
+    }
+  }
+  if (length == 0) {
+    return Result<void>();
+  }
+
+  // Otherwise write them, reusing one buffer of zeros
+  AlignedBuffer zeros(static_cast<std::size_t>(std::min<std::uint64_t>(kZeroChunkSize, length)));
+  if (!zeros.valid()) {
+    return Result<void>(FormatError::kFileWriteError);
+  }
+  while (length > 0) {
+    std::size_t chunk = static_cast<std::size_t>(std::min<std::uint64_t>(zeros.size(), length));
+    FileError error = file_ops_->WriteAtOffset(offset, zeros.data(), chunk);
+    if (error != FileError::kSuccess) {
+      return Result<void>(ConvertError(error));
+    }
+    offset += chunk;
+    length -= chunk;
+  }
+  return Result<void>();
+}
+
 Result<void> DiskFormatter::WriteRootDirectory(
     std::uint32_t root_cluster_sector,
     const Fat32Config& config) const {
   
   // Root directory occupies one cluster - size depends on sectors_per_cluster
   // Must zero the ENTIRE cluster to prevent old data appearing as directory entries
-  std::size_t root_cluster_size = static_cast<std::size_t>(config.sectors_per_cluster) * kSectorSize;
-  
-  // Use aligned buffer for O_DIRECT compatibility on Linux
-  AlignedBuffer root_cluster(root_cluster_size);
-  if (!root_cluster.valid()) {
-    return Result<void>(FormatError::kFileWriteError);
-  }
-  
+  std::uint64_t root_cluster_size = static_cast<std::uint64_t>(config.sectors_per_cluster) * kSectorSize;
   std::uint64_t offset = static_cast<std::uint64_t>(root_cluster_sector) * kSectorSize;
-  FileError error = file_ops_->WriteAtOffset(offset, root_cluster.data(), root_cluster_size);
-  if (error != FileError::kSuccess) {
-    return Result<void>(ConvertError(error));
-  }
-  return Result<void>();
+  return WriteZeros(offset, root_cluster_size);
 }
 
 Fat32Config DiskFormatter::CalculateFat32Config(std::uint32_t partition_size_sectors) const {
@@ -130,6 +130,13 @@ struct __attribute__((packed)) Fat32FsInfo {
   std::uint32_t trail_signature;
 };
 
+// How much of the device FormatDrive() writes
+enum class FormatMode {
+  kFull,   // Every metadata sector, with the FATs and root directory zeroed
+  kQuick   // Discard the whole device first, then write only the non-zero
+           // metadata; falls back to kFull where discard is not supported
+};
+
 class DiskFormatter {
  public:
   // Constructor that accepts a FileOperations implementation
@@ -143,7 +150,8 @@ class DiskFormatter {
   DiskFormatter& operator=(DiskFormatter&&) = default;
 
   // Format a device with MBR partition table and FAT32 filesystem
-  Result<void> FormatDrive(const std::string& device_path);
+  Result<void> FormatDrive(const std::string& device_path,
+                           FormatMode mode = FormatMode::kFull);
 
   // Format to a file for testing
   Result<void> FormatFile(
@@ -154,8 +162,14 @@ class DiskFormatter {
   static constexpr std::uint32_t kSectorSize = 512;
   static constexpr std::uint32_t kPartitionStartSector = 8192;  // 4MB offset
   static constexpr std::uint8_t kFat32PartitionType = 0x0C;    // FAT32 LBA
+  static constexpr std::size_t kFatHeadSize = 4096;          // Written part of each FAT
+  static constexpr std::uint64_t kZeroRangeAlignment = 4096;  // Largest logical block size
+  static constexpr std::size_t kZeroChunkSize = 4 * 1024 * 1024;
 
   std::unique_ptr<FileOperations> file_ops_;
+  // Set once a quick format has discarded a device whose discarded blocks
+  // read back as zeros: zero ranges then need no writing at all
+  bool device_zeroed_ = false;
 
   // Convert FileError to FormatError
   FormatError ConvertError(FileError error) const;
@@ -181,6 +195,12 @@ class DiskFormatter {
       std::uint32_t fat_start_sector,
       const Fat32Config& config) const;
 
+  // Zero [offset, offset + length) with ZeroRange() where the device
+  // supports it, and by writing zeros otherwise, in constant memory
+  Result<void> WriteZeros(
+      std::uint64_t offset,
+      std::uint64_t length) const;
+
   Result<void> WriteRootDirectory(
       std::uint32_t root_cluster_sector,
       const Fat32Config& config) const;
@@ -7,7 +7,17 @@
 #include "config.h"
 #include "platformquirks.h"
 #include "systemmemorymanager.h"
+#include "containerlimits.h"
 #include "drivelist/drivelist.h"
+#include "gzipdecoder.h"
+#include "xzdecoder.h"
+#include "zstddecoder.h"
+#include "multifilewriter.h"
+#include "threadplacement.h"
+#include "threadcputime.h"
+#include "pipelinebalancer.h"
+#include "acceleratedcryptographichash.h"
+#include "tracepoints.h"
 #include <iostream>
 #include <archive.h>
 #include <archive_entry.h>
@@ -33,6 +43,26 @@ using namespace std;
 // Ring buffer slot count is now determined dynamically by SystemMemoryManager
 const int DownloadExtractThread::RING_BUFFER_SLOTS = 0;  // Placeholder, actual value set at runtime
 
+// Enough of the download to find an ISO 9660 volume descriptor (at 32 KiB)
+static constexpr size_t RAW_PROBE_BYTES = 64 * 1024;
+
+/*
+ * An uncompressed disk image: an MBR boot signature (also present in GPT
+ * images and hybrid ISOs) or an ISO 9660 volume descriptor, and none of
+ * the compressed or archive formats libarchive and the native decoders read
+ */
+static bool looksLikeRawImage(const char *data, size_t len)
+{
+    const auto *p = reinterpret_cast<const unsigned char *>(data);
+    if (len < 512 || GzipDecoder::isGzipStream(data, len) || XzDecoder::isXzStream(data, len)
+        || ZstdDecoder::isZstdFrame(data, len) || memcmp(data, "PK", 2) == 0 || memcmp(data, "BZh", 3) == 0
+        || memcmp(data, "7z\xBC\xAF\x27\x1C", 6) == 0 || (len >= 262 && memcmp(data + 257, "ustar", 5) == 0))
+        return false;
+    if (p[510] == 0x55 && p[511] == 0xAA)
+        return true;
+    return len >= 0x8006 && memcmp(data + 0x8001, "CD001", 5) == 0;
+}
+
 // Buffer optimization logic now handled by centralized SystemMemoryManager
 
 class _extractThreadClass : public QThread {
@@ -44,6 +74,8 @@ public:
 
     virtual void run()
     {
+        ThreadPlacement::apply(ThreadPlacement::Role::DeviceIo);
+        ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::Write);
         if (_de->isImage())
             _de->extractImageRun();
         else
@@ -57,17 +89,19 @@ protected:
 DownloadExtractThread::DownloadExtractThread(const QByteArray &url, const QByteArray &localfilename, const QByteArray &expectedHash, QObject *parent)
     : DownloadThread(url, localfilename, expectedHash, parent), 
       _writeBufferSize(SystemMemoryManager::instance().getOptimalWriteBufferSize()), 
+      _writeAlignment(512),
       _currentReadSlot(nullptr),
+      _peekedReadSlot(nullptr),
+      _pushSlot(nullptr),
+      _pushSlotFill(0),
+      _rawProbed(false),
+      _rawPassThrough(false),
       _currentWriteSlot(nullptr),
       _ethreadStarted(false),
       _isImage(true), 
       _inputHash(OSLIST_HASH_ALGORITHM), 
       _progressStarted(false),
       _lastProgressTime(0),
-      _lastEmittedDlNow(0),
-      _lastLocalVerifyNow(0),
-      _lastEmittedDecompressNow(0),
-      _lastEmittedWriteNow(0),
       _bytesDecompressed(0),
       _downloadComplete(false),
       _totalDecompressionMs(0),
@@ -84,14 +118,26 @@ DownloadExtractThread::DownloadExtractThread(const QByteArray &url, const QByteA
     // Cap write buffer to the device's maximum single-request I/O size.
     // This prevents the OS from splitting each write into many sub-requests,
     // which amplifies queue pressure on devices with low queue depth. See #1592.
+    //
+    // Write ring slots are handed to the device as-is (zero-copy), so with
+    // unbuffered I/O their address and size must also satisfy the device's
+    // alignment. That is normally the page size, but 4Kn drives and some
+    // adapters need more, and the last write is padded to the logical sector.
+    const auto limits = rpi_imager::FileOperations::QueryDeviceIOLimits(_filename.toStdString());
+    const size_t writeSlotAlignment = limits.BufferAlignment(pageSize);
     {
-        auto limits = rpi_imager::FileOperations::QueryDeviceIOLimits(_filename.toStdString());
+        if (limits.io_alignment_bytes > _writeAlignment)
+        {
+            _writeAlignment = limits.io_alignment_bytes;
+            qDebug() << "Device requires" << _writeAlignment << "byte aligned I/O";
+        }
+
         if (limits.max_transfer_bytes > 0 && limits.max_transfer_bytes < writeBufferSizeHint)
         {
             size_t deviceMaxBytes = limits.max_transfer_bytes;
-            // Align down to page boundary for O_DIRECT / FILE_FLAG_NO_BUFFERING compatibility
-            deviceMaxBytes = (deviceMaxBytes / pageSize) * pageSize;
-            if (deviceMaxBytes >= pageSize)
+            // Align down for O_DIRECT / FILE_FLAG_NO_BUFFERING compatibility
+            deviceMaxBytes = (deviceMaxBytes / writeSlotAlignment) * writeSlotAlignment;
+            if (deviceMaxBytes >= writeSlotAlignment)
             {
                 qDebug() << "Capping write buffer from" << writeBufferSizeHint
                          << "to" << deviceMaxBytes << "bytes"
@@ -113,6 +159,18 @@ DownloadExtractThread::DownloadExtractThread(const QByteArray &url, const QByteA
         inputSlots, writeSlots,
         actualInputSize, actualWriteSize);
     
+    // Coordinated sizing only keeps page alignment. Each slot is one write,
+    // so keep it a whole number of the device's native requests as well.
+    // Slots that divide the erase unit never straddle one: the first block
+    // is a whole slot, so every later full slot starts on a slot boundary.
+    if (actualWriteSize > writeSlotAlignment)
+    {
+        actualWriteSize = limits.NativeIOSize(actualWriteSize, writeSlotAlignment);
+        actualWriteSize = limits.EraseAlignedSize(actualWriteSize, writeSlotAlignment);
+    }
+    if (limits.erase_unit_bytes > 0)
+        qDebug() << "Device erase unit:" << limits.erase_unit_bytes << "bytes";
+
     // Update write buffer size if it was scaled down
     if (actualWriteSize != _writeBufferSize) {
         qDebug() << "Write buffer size adjusted:" << _writeBufferSize << "->" << actualWriteSize;
@@ -120,15 +178,16 @@ DownloadExtractThread::DownloadExtractThread(const QByteArray &url, const QByteA
     }
     
     // Create zero-copy ring buffer for curl -> libarchive data transfer (compressed data)
-    _ringBuffer = std::make_unique<RingBuffer>(inputSlots, actualInputSize, pageSize);
+    _ringBuffer = std::make_shared<RingBuffer>(inputSlots, actualInputSize, pageSize);
     
     // Create ring buffer for decompress -> write path (decompressed data)
-    _writeRingBuffer = std::make_shared<RingBuffer>(writeSlots, actualWriteSize, pageSize);
+    _writeRingBuffer = std::make_shared<RingBuffer>(writeSlots, actualWriteSize, writeSlotAlignment);
     
     qDebug() << "Using buffer size:" << _writeBufferSize << "bytes with page size:" << pageSize << "bytes";
     qDebug() << "Input ring buffer:" << inputSlots << "slots of" << actualInputSize << "bytes";
     qDebug() << "Write ring buffer:" << writeSlots << "slots of" << actualWriteSize << "bytes";
     qDebug() << "Total ring buffer memory:" << (totalMemory / (1024 * 1024)) << "MB";
+    SystemMemoryManager::instance().logConfigurationSummary();
 }
 
 DownloadExtractThread::~DownloadExtractThread()
@@ -140,15 +199,22 @@ DownloadExtractThread::~DownloadExtractThread()
     {
         _extractThread->terminate();
     }
+    // Device preparation in the background registers the ring buffers
+    if (_devicePreparation.valid())
+        _devicePreparation.wait();
     
     // Wait for any pending async writes before destroying ring buffers
     // The async completion callbacks reference the ring buffer, so we must
-    // ensure they've all completed before destruction
-    if (_file && _file->IsAsyncIOSupported()) {
+    // ensure they've all completed before destruction. A sync abandoned on
+    // cancel was only started once they had, and the ring is torn down
+    // when the device is closed after it returns.
+    if (_file && _file->IsAsyncIOSupported() && !isSyncInFlight()) {
         _file->WaitForPendingWrites();
+        _file->UnregisterAsyncBuffers();
     }
     
-    // Ring buffer destructors handle memory cleanup
+    // Ring buffer destructors handle memory cleanup (input slots still
+    // queued in the cache writer keep the input ring buffer alive)
     _writeRingBuffer.reset();
     _ringBuffer.reset();
 }
@@ -158,9 +224,37 @@ void DownloadExtractThread::_onDevicePrepared()
     // If the user asked to ignore device limits and the write buffer was capped
     // below the RAM-based optimum, reallocate the ring buffers at full size.
     // This runs after _openAndPrepareDevice() but before any ring buffer access.
-    if (!_debugIgnoreDeviceLimits)
-        return;
+    if (_debugIgnoreDeviceLimits)
+        _reallocateUncappedRingBuffers();
+
+    // Async writes are issued straight from write ring buffer slots
+    if (_file && _file->IsAsyncIOSupported() && _writeRingBuffer) {
+        std::vector<rpi_imager::FileOperations::AsyncBuffer> buffers;
+        for (size_t i = 0; i < _writeRingBuffer->numSlots(); i++) {
+            const RingBuffer::Slot &slot = _writeRingBuffer->slotAt(i);
+            buffers.emplace_back(reinterpret_cast<const std::uint8_t *>(slot.data), slot.capacity);
+        }
+        _writeBuffersRegistered = _file->RegisterAsyncBuffers(buffers);
+    }
+}
+
+void DownloadExtractThread::_onMemoryPressure(int percent)
+{
+    DownloadThread::_onMemoryPressure(percent);
+
+    auto scaled = [percent](const std::shared_ptr<RingBuffer> &ring) {
+        return std::max(RingBuffer::MIN_ACTIVE_SLOTS, ring->numSlots() * static_cast<size_t>(percent) / 100);
+    };
+    if (_ringBuffer)
+        _ringBuffer->setSlotLimit(scaled(_ringBuffer));
+    // Memory registered with the kernel must stay where it is until the
+    // device is closed
+    if (_writeRingBuffer && !_writeBuffersRegistered)
+        _writeRingBuffer->setSlotLimit(scaled(_writeRingBuffer));
+}
 
+void DownloadExtractThread::_reallocateUncappedRingBuffers()
+{
     size_t optimalWriteSize = SystemMemoryManager::instance().getOptimalWriteBufferSize();
     if (_writeBufferSize >= optimalWriteSize)
         return;  // wasn't capped — nothing to do
@@ -179,9 +273,17 @@ void DownloadExtractThread::_onDevicePrepared()
         inputSlots, writeSlots,
         actualInputSize, actualWriteSize);
 
+    // Ignoring the transfer limit does not lift the alignment requirement
+    const size_t writeSlotAlignment = qMax(pageSize, _writeAlignment);
+    if (actualWriteSize > writeSlotAlignment)
+        actualWriteSize = (actualWriteSize / writeSlotAlignment) * writeSlotAlignment;
+
     _writeBufferSize = actualWriteSize;
-    _ringBuffer = std::make_unique<RingBuffer>(inputSlots, actualInputSize, pageSize);
-    _writeRingBuffer = std::make_shared<RingBuffer>(writeSlots, actualWriteSize, pageSize);
+    // Return the old slots to the pool first so both sets never count against its limit
+    _ringBuffer.reset();
+    _writeRingBuffer.reset();
+    _ringBuffer = std::make_shared<RingBuffer>(inputSlots, actualInputSize, pageSize);
+    _writeRingBuffer = std::make_shared<RingBuffer>(writeSlots, actualWriteSize, writeSlotAlignment);
 
     qDebug() << "Reallocated ring buffers:"
              << "input" << inputSlots << "x" << actualInputSize
@@ -238,36 +340,11 @@ void DownloadExtractThread::_emitProgressUpdate()
         }
     }
     
-    quint64 currentDlNow = this->dlNow();
-    quint64 currentDlTotal = this->dlTotal();
-    quint64 currentExtractTotal = this->extractTotal();
-    quint64 currentVerifyNow = this->verifyNow();
-    quint64 currentVerifyTotal = this->verifyTotal();
-    quint64 currentDecompressNow = _bytesDecompressed.load();
-    quint64 currentWriteNow = this->bytesWritten();
-    
-    // For write progress, use extract size (uncompressed) if set, otherwise fall back to download size
-    quint64 writeTotal = currentExtractTotal > 0 ? currentExtractTotal : currentDlTotal;
-    
-    // Only emit signals if values have changed
-    if (currentDlNow != _lastEmittedDlNow || (currentDlTotal > 0 && _lastEmittedDlNow == 0)) {
-        _lastEmittedDlNow = currentDlNow;
-        emit downloadProgressChanged(currentDlNow, currentDlTotal);
-    }
-    
-    if (currentDecompressNow != _lastEmittedDecompressNow) {
-        _lastEmittedDecompressNow = currentDecompressNow;
-        emit decompressProgressChanged(currentDecompressNow, writeTotal);
-    }
-    
-    if (currentWriteNow != _lastEmittedWriteNow) {
-        _lastEmittedWriteNow = currentWriteNow;
-        emit writeProgressChanged(currentWriteNow, writeTotal);
-    }
-    
-    if (currentVerifyNow != _lastLocalVerifyNow || (currentVerifyTotal > 0 && _lastLocalVerifyNow == 0)) {
-        _lastLocalVerifyNow = currentVerifyNow;
-        emit verifyProgressChanged(currentVerifyNow, currentVerifyTotal);
+    // Fill level of both ring buffers, for occupancy counters in the trace export
+    if (_ringBuffer || _writeRingBuffer) {
+        emit eventRingBufferOccupancy(
+            _ringBuffer ? static_cast<quint32>(_ringBuffer->committedSlots()) : 0,
+            _writeRingBuffer ? static_cast<quint32>(_writeRingBuffer->committedSlots()) : 0);
     }
 }
 
@@ -279,7 +356,9 @@ size_t DownloadExtractThread::_writeData(const char *buf, size_t len)
     // Emit progress updates when data starts flowing
     _emitProgressUpdate();
 
-    _writeCache(buf, len);
+    // The cache writer is fed from the ring buffer slots in _pushQueue()
+    if (!_ringBuffer)
+        _writeCache(buf, len);
 
     if (!_ethreadStarted)
     {
@@ -305,6 +384,7 @@ void DownloadExtractThread::_onDownloadSuccess()
     
     // Signal ring buffer that producer is done
     if (_ringBuffer) {
+        _commitPushSlot();
         _ringBuffer->producerDone();
     }
     
@@ -332,6 +412,10 @@ void DownloadExtractThread::cancelDownload()
 {
     DownloadThread::cancelDownload();
     _cancelExtract();
+    // Wake the decoder and the write loop now rather than at their next poll
+    if (_writeRingBuffer) {
+        _writeRingBuffer->cancel();
+    }
 }
 
 // Raise exception on libarchive errors
@@ -349,9 +433,363 @@ static inline void _checkResult(int r, struct archive *a)
     }
 }
 
+// libarchive thread
+bool DownloadExtractThread::_extractNativeRun()
+{
+    // Look at the first chunk of the download to decide whether this is a
+    // raw .zst, .xz or .gz image that can bypass libarchive
+    QElapsedTimer ringBufferWaitTimer;
+    ringBufferWaitTimer.start();
+    RingBuffer::Slot *first = _ringBuffer->acquireReadSlot(100);
+    while (!first && !_ringBuffer->isCancelled() && !_ringBuffer->isComplete() && !_ringBuffer->isStallTimeoutExceeded()) {
+        first = _ringBuffer->acquireReadSlot(100);
+    }
+    _totalRingBufferWaitMs.fetch_add(static_cast<quint64>(ringBufferWaitTimer.elapsed()));
+
+    if (!first)
+        return false;  // Let the libarchive path report EOF or stall
+
+    if (_rawPassThrough)
+    {
+        _extractRawRun(first);
+        return true;
+    }
+
+    QElapsedTimer extractionTimer;
+    extractionTimer.start();
+
+    int numThreads = ContainerLimits::cpuCount();
+    if (numThreads > 8) numThreads = 8;  // Same cap as the libarchive xz decoder
+
+    std::unique_ptr<DecoderThread> decoder;
+    if (ZstdDecoder::isZstdFrame(first->data, first->size)
+        && !ZstdDecoder::mayBeArchive(first->data, first->size))
+    {
+        qDebug() << "Decompression pipeline: zstd (native, up to" << numThreads << "frames in parallel)";
+        decoder = std::make_unique<ZstdDecoder>(_ringBuffer.get(), first, _writeRingBuffer, numThreads);
+    }
+    else if (XzDecoder::isXzStream(first->data, first->size)
+             && !XzDecoder::mayBeArchive(first->data, first->size))
+    {
+        // Bound blocks being decoded in parallel by a quarter of free memory
+        qint64 availableMB = SystemMemoryManager::instance().getAvailableMemoryMB();
+        quint64 budget = static_cast<quint64>(qBound<qint64>(64, availableMB / 4, 1024)) * 1024 * 1024;
+        qDebug() << "Decompression pipeline: xz (native, up to" << numThreads << "blocks in parallel,"
+                 << budget / (1024 * 1024) << "MB in flight)";
+        decoder = std::make_unique<XzDecoder>(_ringBuffer.get(), first, _writeRingBuffer, numThreads, budget);
+    }
+    else if (GzipDecoder::isGzipStream(first->data, first->size)
+             && !GzipDecoder::mayBeArchive(first->data, first->size))
+    {
+        // Sequential, but saves libarchive's copy of every decompressed byte
+        qDebug() << "Decompression pipeline: gzip (native)";
+        decoder = std::make_unique<GzipDecoder>(_ringBuffer.get(), first, _writeRingBuffer);
+    }
+    else
+    {
+        // Not a raw image we decode ourselves, hand the slot over to _on_read()
+        _peekedReadSlot = first;
+        return false;
+    }
+
+    emit eventImageExtraction(static_cast<quint32>(extractionTimer.elapsed()), true);
+
+    _runDecoder(*decoder);
+    return true;
+}
+
+/*
+ * Write what a DecoderThread puts into the write ring buffer, until it is
+ * done, fails or the write fails. Reports errors itself.
+ */
+void DownloadExtractThread::_runDecoder(DecoderThread &decoder)
+{
+    // With verification on, decompression and tree hashing share the cores
+    std::unique_ptr<PipelineBalancer> balancer;
+    QElapsedTimer balanceTimer;
+    if (_pipelineBalanceEnabled && _verifyEnabled && decoder.maxThreads() > 1 && ContainerLimits::cpuCount() > 1)
+    {
+        balancer = std::make_unique<PipelineBalancer>(ContainerLimits::cpuCount(), decoder.maxThreads());
+        decoder.setActiveThreads(balancer->decodeThreads());
+        AcceleratedCryptographicHash::setTreeThreads(balancer->hashThreads());
+        balanceTimer.start();
+        qDebug() << "Pipeline balance:" << balancer->decodeThreads() << "decode threads," << balancer->hashThreads() << "hash threads";
+    }
+    auto rebalance = [&]() {
+        uint64_t producerStalls, consumerStalls, producerWaitMs, consumerWaitMs;
+        _writeRingBuffer->getStarvationStats(producerStalls, consumerStalls, producerWaitMs, consumerWaitMs);
+        PipelineBalancer::Sample sample;
+        sample.writerWaitMs = consumerWaitMs;
+        sample.decoderInputWaitMs = decoder.inputWaitMs();
+        sample.preHashWaitMs = _writeTimingStats.totalPreHashWaitMs.load();
+        if (balancer->update(sample, balanceTimer.restart()))
+        {
+            decoder.setActiveThreads(balancer->decodeThreads());
+            AcceleratedCryptographicHash::setTreeThreads(balancer->hashThreads());
+            qDebug() << "Pipeline balance:" << balancer->decodeThreads() << "decode threads," << balancer->hashThreads() << "hash threads";
+        }
+    };
+    // Verification reads back with every core
+    auto endBalance = [&]() {
+        if (!balancer)
+            return;
+        AcceleratedCryptographicHash::setTreeThreads(0);
+        qDebug() << "Pipeline balance:" << balancer->shifts() << "shifts, ended with" << balancer->decodeThreads() << "decode threads";
+        balancer.reset();
+    };
+
+    decoder.start();
+
+    try
+    {
+        while (true)
+        {
+            // Decoded data arrives in committed write ring buffer slots
+            RingBuffer::Slot* slot = _writeRingBuffer->acquireReadSlot(100);
+            while (!slot && !_cancelled && !_writeRingBuffer->isCancelled() && !_writeRingBuffer->isComplete()
+                   && !_writeRingBuffer->isStallTimeoutExceeded()) {
+                // Keep polling so async write callbacks can return slots to the decoder
+                if (_deviceReady() && _file && _file->IsAsyncIOSupported()) {
+                    _file->PollAsyncCompletions();
+                }
+                slot = _writeRingBuffer->acquireReadSlot(100);
+            }
+            if (!slot)
+                break;
+
+            size_t size = slot->size;
+            if (size % _writeAlignment != 0)
+            {
+                size_t paddingBytes = _writeAlignment-(size % _writeAlignment);
+                qDebug() << "Image is NOT a valid disk image, as its length is not a multiple of the" << _writeAlignment << "byte sector size";
+                qDebug() << "Last write() would be" << size << "bytes, but padding to" << size + paddingBytes << "bytes";
+                memset(slot->data + size, 0, paddingBytes);
+                size += paddingBytes;
+            }
+
+            _bytesDecompressed.fetch_add(static_cast<quint64>(size));
+            _onDecoderProgress(decoder);
+            _emitProgressUpdate();
+            if (balancer && balanceTimer.elapsed() >= PipelineBalancer::IntervalMs)
+                rebalance();
+
+            std::shared_ptr<RingBuffer> ringBufRef = _writeRingBuffer;
+            RingBuffer::Slot* slotToRelease = slot;
+            DownloadThread::WriteCompleteCallback releaseCallback = [ringBufRef, slotToRelease]() {
+                ringBufRef->releaseReadSlot(slotToRelease);
+            };
+
+            bool writeOk = _writeFileSparse(slot->data, size, releaseCallback) > 0;
+            if (!writeOk && !_cancelled) {
+                decoder.cancel();
+                decoder.wait();
+                endBalance();
+                if (_file && _file->IsAsyncIOSupported()) {
+                    _file->WaitForPendingWrites();
+                }
+                _onWriteError();
+                _emitPipelineSummary();
+                return;
+            }
+        }
+
+        if (_cancelled)
+            decoder.cancel();
+        decoder.wait();
+        endBalance();
+
+        _totalDecompressionMs.fetch_add(decoder.decodeMs());
+        _totalRingBufferWaitMs.fetch_add(decoder.inputWaitMs());
+        _bytesReadFromRingBuffer.fetch_add(decoder.bytesConsumed());
+
+        if (!_cancelled)
+        {
+            if (_ringBuffer->isStallTimeoutExceeded())
+                _recordInputStall();
+            if (_writeRingBuffer->isStallTimeoutExceeded())
+                throw runtime_error(tr("The write operation has stalled.\n\n"
+                                       "No data has been written for 30 seconds. "
+                                       "This could be caused by:\n"
+                                       "• Storage device disconnected or unresponsive\n"
+                                       "• Device has failed or is faulty\n"
+                                       "• System resource exhaustion\n\n"
+                                       "Please check the storage device and try again.").toStdString());
+            if (decoder.hasError())
+                throw runtime_error(decoder.errorString().toStdString());
+
+            _writeComplete();
+        }
+    }
+    catch (exception &e)
+    {
+        decoder.cancel();
+        decoder.wait();
+        endBalance();
+
+        // Their callbacks reference the ring buffer, so we must wait
+        if (_deviceReady() && _file && _file->IsAsyncIOSupported()) {
+            _file->WaitForPendingWrites();
+        }
+
+        if (!_cancelled)
+        {
+            DownloadThread::cancelDownload();
+
+            if (!_stallErrorMessage.isEmpty()) {
+                emit error(_stallErrorMessage);
+            } else {
+                emit error(tr("Error extracting archive: %1").arg(e.what()));
+            }
+        }
+    }
+
+    _emitPipelineSummary();
+}
+
+/*
+ * Uncompressed images skip libarchive and the write ring buffer: each input
+ * slot, as filled by _pushQueue(), is written as is and released once the
+ * write completes
+ */
+void DownloadExtractThread::_extractRawRun(RingBuffer::Slot *first)
+{
+    qDebug() << "Decompression pipeline: none (raw image, written from the input ring buffer)";
+    emit eventImageExtraction(0, true);
+
+    bool writeOk = true;
+    RingBuffer::Slot *slot = first;
+    while (slot)
+    {
+        size_t size = slot->size;
+        _bytesReadFromRingBuffer.fetch_add(static_cast<quint64>(size));
+        if (size == 0)
+        {
+            _ringBuffer->releaseReadSlot(slot);
+        }
+        else
+        {
+            if (size % _writeAlignment != 0)
+            {
+                size_t paddingBytes = _writeAlignment-(size % _writeAlignment);
+                qDebug() << "Image is NOT a valid disk image, as its length is not a multiple of the" << _writeAlignment << "byte sector size";
+                qDebug() << "Last write() would be" << size << "bytes, but padding to" << size + paddingBytes << "bytes";
+                memset(slot->data + size, 0, paddingBytes);
+                size += paddingBytes;
+            }
+
+            _bytesDecompressed.fetch_add(static_cast<quint64>(size));
+            _emitProgressUpdate();
+
+            std::shared_ptr<RingBuffer> ringBufRef = _ringBuffer;
+            RingBuffer::Slot* slotToRelease = slot;
+            DownloadThread::WriteCompleteCallback releaseCallback = [ringBufRef, slotToRelease]() {
+                ringBufRef->releaseReadSlot(slotToRelease);
+            };
+
+            if (_writeFileSparse(slot->data, size, releaseCallback) == 0)
+            {
+                writeOk = false;
+                break;
+            }
+        }
+
+        QElapsedTimer ringBufferWaitTimer;
+        ringBufferWaitTimer.start();
+        slot = _ringBuffer->acquireReadSlot(100);
+        while (!slot && !_cancelled && !_ringBuffer->isCancelled() && !_ringBuffer->isComplete()
+               && !_ringBuffer->isStallTimeoutExceeded()) {
+            // Keep polling so async write callbacks can return slots to the download
+            if (_deviceReady() && _file && _file->IsAsyncIOSupported()) {
+                _file->PollAsyncCompletions();
+            }
+            slot = _ringBuffer->acquireReadSlot(100);
+        }
+        _totalRingBufferWaitMs.fetch_add(static_cast<quint64>(ringBufferWaitTimer.elapsed()));
+    }
+
+    if (!writeOk || _ringBuffer->isStallTimeoutExceeded())
+    {
+        _ringBuffer->cancel();
+        // Their callbacks reference the ring buffer, so we must wait
+        if (_deviceReady() && _file && _file->IsAsyncIOSupported()) {
+            _file->WaitForPendingWrites();
+        }
+    }
+
+    if (!writeOk)
+    {
+        if (!_cancelled)
+            _onWriteError();
+    }
+    else if (!_cancelled)
+    {
+        if (_ringBuffer->isStallTimeoutExceeded()
+            && _ringBuffer->getStallType() == RingBuffer::StallType::ProducerStall)
+        {
+            DownloadThread::cancelDownload();
+            emit error(tr("The write operation has stalled.\n\n"
+                          "No data has been written for 30 seconds. "
+                          "This could be caused by:\n"
+                          "• Storage device disconnected or unresponsive\n"
+                          "• Device has failed or is faulty\n"
+                          "• System resource exhaustion\n\n"
+                          "Please check the storage device and try again."));
+        }
+        else if (_ringBuffer->isStallTimeoutExceeded())
+        {
+            _recordInputStall();
+            DownloadThread::cancelDownload();
+            emit error(_stallErrorMessage);
+        }
+        else
+        {
+            _writeComplete();
+        }
+    }
+
+    _emitPipelineSummary();
+}
+
+void DownloadExtractThread::_emitPipelineSummary()
+{
+    // Emit pipeline timing summary events for performance analysis
+    // These show where time was spent in the extraction pipeline
+    emit eventPipelineDecompressionTime(
+        static_cast<quint32>(_totalDecompressionMs.load()),
+        _bytesDecompressed.load());
+    emit eventPipelineRingBufferWaitTime(
+        static_cast<quint32>(_totalRingBufferWaitMs.load()),
+        _bytesReadFromRingBuffer.load());
+    
+    qDebug() << "Pipeline timing summary:"
+             << "decompress=" << _totalDecompressionMs.load() << "ms"
+             << "(ring_wait=" << _totalRingBufferWaitMs.load() << "ms)";
+    
+    // Emit detailed write timing breakdown for hypothesis testing
+    _emitWriteTimingStats();
+    
+    // Log and emit write ring buffer statistics
+    if (_writeRingBuffer) {
+        uint64_t producerStalls, consumerStalls, producerWaitMs, consumerWaitMs;
+        _writeRingBuffer->getStarvationStats(producerStalls, consumerStalls, producerWaitMs, consumerWaitMs);
+        if (producerStalls > 0 || consumerStalls > 0) {
+            qDebug() << "Write ring buffer stats:"
+                     << "producer stalls:" << producerStalls << "(" << producerWaitMs << "ms),"
+                     << "consumer stalls:" << consumerStalls << "(" << consumerWaitMs << "ms)";
+        }
+        // Emit for performance tracking even if no stalls (shows buffer was used)
+        emit eventWriteRingBufferStats(producerStalls, consumerStalls, producerWaitMs, consumerWaitMs);
+    }
+}
+
 // libarchive thread
 void DownloadExtractThread::extractImageRun()
 {
+    // A download resumed part way through an uncompressed image starts
+    // with arbitrary data, which must not be taken for a compressed format
+    if (!_resumeSourceOffset && _extractNativeRun())
+        return;
+
     QElapsedTimer extractionTimer;
     extractionTimer.start();
     
@@ -359,8 +797,11 @@ void DownloadExtractThread::extractImageRun()
     struct archive_entry *entry;
     int r;
 
-    archive_read_support_filter_all(a);
-    archive_read_support_format_all(a);
+    if (!_resumeSourceOffset)
+    {
+        archive_read_support_filter_all(a);
+        archive_read_support_format_all(a);
+    }
     archive_read_support_format_raw(a); // for .gz and such
     
     // Configure decompression options for optimal performance
@@ -376,6 +817,9 @@ void DownloadExtractThread::extractImageRun()
         
         // Log the compression filter(s) being used for diagnostics
         _logCompressionFilters(a);
+
+        // An uncompressed image can later be resumed part way through the download
+        _rawSource = archive_filter_code(a, 0) == ARCHIVE_FILTER_NONE && archive_format(a) == ARCHIVE_FORMAT_RAW;
         
         // Emit image extraction setup event (archive opened and header read)
         emit eventImageExtraction(static_cast<quint32>(extractionTimer.elapsed()), true);
@@ -393,7 +837,7 @@ void DownloadExtractThread::extractImageRun()
                 // Without this, we deadlock: slots are freed by async write callbacks,
                 // but callbacks only fire when we poll IOCP. If we're blocked here not
                 // polling, completions pile up and slots never get freed.
-                if (_file && _file->IsAsyncIOSupported()) {
+                if (_deviceReady() && _file && _file->IsAsyncIOSupported()) {
                     _file->PollAsyncCompletions();
                 }
                 slot = _writeRingBuffer->acquireWriteSlot(100);
@@ -427,6 +871,7 @@ void DownloadExtractThread::extractImageRun()
             decompressTimer.start();
             ssize_t size = archive_read_data(a, slot->data, slot->capacity);
             _totalDecompressionMs.fetch_add(static_cast<quint64>(decompressTimer.elapsed()));
+            RPI_TRACE2(decompress_chunk, size, decompressTimer.nsecsElapsed() / 1000);
             
             if (size < 0) {
                 const char* errorStr = archive_error_string(a);
@@ -446,10 +891,10 @@ void DownloadExtractThread::extractImageRun()
                 _writeRingBuffer->releaseReadSlot(slot);
                 break;
             }
-            if (size % 512 != 0)
+            if (size % _writeAlignment != 0)
             {
-                size_t paddingBytes = 512-(size % 512);
-                qDebug() << "Image is NOT a valid disk image, as its length is not a multiple of the sector size of 512 bytes long";
+                size_t paddingBytes = _writeAlignment-(size % _writeAlignment);
+                qDebug() << "Image is NOT a valid disk image, as its length is not a multiple of the" << _writeAlignment << "byte sector size";
                 qDebug() << "Last write() would be" << size << "bytes, but padding to" << size + paddingBytes << "bytes";
                 memset(slot->data + size, 0, paddingBytes);
                 size += paddingBytes;
@@ -475,15 +920,15 @@ void DownloadExtractThread::extractImageRun()
             };
             
             // IMPORTANT: Call _writeFile directly from extraction thread instead of via
-            // QtConcurrent::run(). Using the thread pool causes deadlock when async I/O
-            // is enabled: _writeFile waits for previous hash computation, but hash runs
-            // in the same thread pool. With many queued _writeFile calls, all pool threads
-            // block waiting for hashes that can't run (no available threads).
+            // QtConcurrent::run(). _writeFile is the only thread that queues hashes
+            // (HashPipeline has a single producer), and running it in the global pool
+            // once deadlocked with async I/O: pool threads blocked waiting for hashes
+            // that needed a pool thread to run.
             //
             // With async I/O, _writeFile returns quickly after queuing the I/O operation,
             // so running it synchronously in the extraction thread doesn't block progress.
             // The actual I/O happens asynchronously via io_uring/IOCP.
-            bool writeOk = _writeFile(slot->data, static_cast<size_t>(size), releaseCallback) > 0;
+            bool writeOk = _writeFileSparse(slot->data, static_cast<size_t>(size), releaseCallback) > 0;
             if (!writeOk && !_cancelled) {
                 // Wait for pending async writes before cleanup
                 if (_file && _file->IsAsyncIOSupported()) {
@@ -501,7 +946,7 @@ void DownloadExtractThread::extractImageRun()
     {
         // Wait for pending async writes before cleanup
         // Their callbacks reference the ring buffer, so we must wait
-        if (_file && _file->IsAsyncIOSupported()) {
+        if (_deviceReady() && _file && _file->IsAsyncIOSupported()) {
             _file->WaitForPendingWrites();
         }
         
@@ -520,35 +965,8 @@ void DownloadExtractThread::extractImageRun()
     }
 
     archive_read_free(a);
-    
-    // Emit pipeline timing summary events for performance analysis
-    // These show where time was spent in the extraction pipeline
-    emit eventPipelineDecompressionTime(
-        static_cast<quint32>(_totalDecompressionMs.load()),
-        _bytesDecompressed.load());
-    emit eventPipelineRingBufferWaitTime(
-        static_cast<quint32>(_totalRingBufferWaitMs.load()),
-        _bytesReadFromRingBuffer.load());
-    
-    qDebug() << "Pipeline timing summary:"
-             << "decompress=" << _totalDecompressionMs.load() << "ms"
-             << "(ring_wait=" << _totalRingBufferWaitMs.load() << "ms)";
-    
-    // Emit detailed write timing breakdown for hypothesis testing
-    _emitWriteTimingStats();
-    
-    // Log and emit write ring buffer statistics
-    if (_writeRingBuffer) {
-        uint64_t producerStalls, consumerStalls, producerWaitMs, consumerWaitMs;
-        _writeRingBuffer->getStarvationStats(producerStalls, consumerStalls, producerWaitMs, consumerWaitMs);
-        if (producerStalls > 0 || consumerStalls > 0) {
-            qDebug() << "Write ring buffer stats:"
-                     << "producer stalls:" << producerStalls << "(" << producerWaitMs << "ms),"
-                     << "consumer stalls:" << consumerStalls << "(" << consumerWaitMs << "ms)";
-        }
-        // Emit for performance tracking even if no stalls (shows buffer was used)
-        emit eventWriteRingBufferStats(producerStalls, consumerStalls, producerWaitMs, consumerWaitMs);
-    }
+
+    _emitPipelineSummary();
 }
 
 #ifdef Q_OS_LINUX
@@ -573,7 +991,6 @@ inline bool isMountPoint(const QString &folder)
 void DownloadExtractThread::extractMultiFileRun()
 {
     QString folder;
-    QStringList filesExtracted, dirExtracted;
     // Use canonical path for comparison since drivelist returns /dev/disk, not /dev/rdisk
     QByteArray canonicalDevice = PlatformQuirks::getEjectDevicePath(_filename).toLower().toUtf8();
 
@@ -644,7 +1061,6 @@ void DownloadExtractThread::extractMultiFileRun()
 
     // Now create libarchive handles after all early returns are handled
     struct archive *a = archive_read_new();
-    struct archive *ext = archive_write_disk_new();
     struct archive_entry *entry;
     /* Extra safety checks: do not allow existing files to be overwritten (SD card should be formatted by previous step),
      * do not allow absolute paths, do not allow insecure symlinks, no special permissions */
@@ -658,7 +1074,7 @@ void DownloadExtractThread::extractMultiFileRun()
 
     archive_read_support_filter_all(a);
     archive_read_support_format_all(a);
-    archive_write_disk_set_options(ext, flags);
+    MultiFileWriter writer(flags, _bytesWritten, _cancelled);
     
     // Configure decompression options for optimal performance
     _configureArchiveOptions(a);
@@ -672,31 +1088,9 @@ void DownloadExtractThread::extractMultiFileRun()
         while ( (r = archive_read_next_header(a, &entry)) != ARCHIVE_EOF)
         {
           _checkResult(r, a);
-          r = archive_write_header(ext, entry);
-          if (r < ARCHIVE_OK)
-              qDebug() << archive_error_string(ext);
-          else if (archive_entry_size(entry) > 0)
-          {
-              //checkResult(copyData(a, ext), a);
-              const void *buff;
-              size_t size;
-              int64_t offset;
-              QString filename = QString::fromWCharArray(archive_entry_pathname_w(entry));
-
-              if (archive_entry_filetype(entry) == AE_IFDIR) // Empty directory
-                  dirExtracted.append(filename);
-              else
-                  filesExtracted.append(filename);
-
-              while ( (r = archive_read_data_block(a, &buff, &size, &offset)) != ARCHIVE_EOF)
-              {
-                  _checkResult(r, a);
-                  _checkResult(archive_write_data_block(ext, buff, size, offset), ext);
-                  _bytesWritten += size;
-              }
-          }
-          _checkResult(archive_write_finish_entry(ext), ext);
+          writer.extract(a, entry);
         }
+        writer.finish();
 
         QByteArray computedHash = _inputHash.result().toHex();
         qDebug() << "Hash of compressed multi-file zip:" << computedHash;
@@ -709,19 +1103,23 @@ void DownloadExtractThread::extractMultiFileRun()
         {
             // Finish async cache writer (waits for all pending writes to complete)
             if (_asyncCacheWriter && _asyncCacheWriter->isActive()) {
-                _asyncCacheWriter->finish();
+                // The cache holds the stream _inputHash has just hashed
+                _asyncCacheWriter->finish(computedHash);
                 
-                // Get cache file hash from async writer
-                QByteArray cacheFileHash = _asyncCacheWriter->hash();
-                
-                qDebug() << "Cache file created (async):";
-                qDebug() << "  Image hash (uncompressed):" << computedHash;
-                qDebug() << "  Cache file hash (compressed):" << cacheFileHash;
-                
-                // Emit both hashes for proper cache verification
-                emit cacheFileHashUpdated(cacheFileHash, computedHash);
-                // Keep old signal for backward compatibility
-                emit cacheFileUpdated(computedHash);
+                // finish() discards the cache if a gap could not be fetched again
+                if (!_asyncCacheWriter->hasError()) {
+                    // Get cache file hash from async writer
+                    QByteArray cacheFileHash = _asyncCacheWriter->hash();
+                    
+                    qDebug() << "Cache file created (async):";
+                    qDebug() << "  Image hash (uncompressed):" << computedHash;
+                    qDebug() << "  Cache file hash (compressed):" << cacheFileHash;
+                    
+                    // Emit both hashes for proper cache verification
+                    emit cacheFileHashUpdated(cacheFileHash, computedHash);
+                    // Keep old signal for backward compatibility
+                    emit cacheFileUpdated(computedHash);
+                }
             }
         }
 
@@ -734,6 +1132,10 @@ void DownloadExtractThread::extractMultiFileRun()
             _asyncCacheWriter->cancel();
         }
 
+        writer.abort();
+        QStringList filesExtracted = writer.files();
+        QStringList dirExtracted = writer.directories();
+
         qDebug() << "Deleting extracted files";
         for (const auto& filename : filesExtracted)
         {
@@ -768,11 +1170,10 @@ void DownloadExtractThread::extractMultiFileRun()
     // Ensure proper cleanup sequence
     
     // 1. Close libarchive handles properly (this should flush any pending writes)
-    if (archive_write_close(ext) != ARCHIVE_OK) {
+    if (!writer.close()) {
         qDebug() << "Warning: Failed to properly close archive write handle";
     }
     archive_read_free(a);
-    archive_write_free(ext);
     
     // 2. Change back to original directory BEFORE sync to avoid holding references
     QDir::setCurrent(currentDir);
@@ -819,6 +1220,15 @@ ssize_t DownloadExtractThread::_on_read(struct archive *, const void **buff)
         _currentReadSlot = nullptr;
     }
     
+    // First slot already acquired by _extractNativeRun()
+    if (_peekedReadSlot) {
+        _currentReadSlot = _peekedReadSlot;
+        _peekedReadSlot = nullptr;
+        _bytesReadFromRingBuffer.fetch_add(static_cast<quint64>(_currentReadSlot->size));
+        *buff = _currentReadSlot->data;
+        return static_cast<ssize_t>(_currentReadSlot->size);
+    }
+    
     // Time how long we wait for ring buffer data
     QElapsedTimer ringBufferWaitTimer;
     ringBufferWaitTimer.start();
@@ -833,22 +1243,7 @@ ssize_t DownloadExtractThread::_on_read(struct archive *, const void **buff)
     
     // Check for stall timeout (network stalled for too long)
     if (_ringBuffer->isStallTimeoutExceeded()) {
-        RingBuffer::StallType stallType = _ringBuffer->getStallType();
-        qDebug() << "DownloadExtractThread: Input ring buffer stall timeout:" << RingBuffer::stallTypeToString(stallType);
-        
-        // Emit a ring buffer stall event
-        qint64 timestampMs = _sessionTimer.isValid() ? _sessionTimer.elapsed() : 0;
-        QString metadata = QString("buffer: input; type: stall_timeout; stall_type: %1").arg(RingBuffer::stallTypeToString(stallType));
-        emit eventRingBufferStats(timestampMs, 30000, metadata);  // 30s stall timeout
-        
-        // Set error message for user - this is a consumer stall (waiting for download data)
-        _stallErrorMessage = tr("The download has stalled.\n\n"
-                               "No data received for 30 seconds. "
-                               "This could be caused by:\n"
-                               "• Network connection lost or unstable\n"
-                               "• Remote server became unresponsive\n"
-                               "• Firewall or proxy blocking the connection\n\n"
-                               "Please check your network connection and try again.");
+        _recordInputStall();
         
         *buff = nullptr;
         return -1;  // Signal error to libarchive
@@ -871,6 +1266,26 @@ ssize_t DownloadExtractThread::_on_read(struct archive *, const void **buff)
     return static_cast<ssize_t>(_currentReadSlot->size);
 }
 
+void DownloadExtractThread::_recordInputStall()
+{
+    RingBuffer::StallType stallType = _ringBuffer->getStallType();
+    qDebug() << "DownloadExtractThread: Input ring buffer stall timeout:" << RingBuffer::stallTypeToString(stallType);
+
+    // Emit a ring buffer stall event
+    qint64 timestampMs = _sessionTimer.isValid() ? _sessionTimer.elapsed() : 0;
+    QString metadata = QString("buffer: input; type: stall_timeout; stall_type: %1").arg(RingBuffer::stallTypeToString(stallType));
+    emit eventRingBufferStats(timestampMs, 30000, metadata);  // 30s stall timeout
+
+    // Set error message for user - this is a consumer stall (waiting for download data)
+    _stallErrorMessage = tr("The download has stalled.\n\n"
+                           "No data received for 30 seconds. "
+                           "This could be caused by:\n"
+                           "• Network connection lost or unstable\n"
+                           "• Remote server became unresponsive\n"
+                           "• Firewall or proxy blocking the connection\n\n"
+                           "Please check your network connection and try again.");
+}
+
 int DownloadExtractThread::_on_close(struct archive *)
 {
     // Release final read slot if any
@@ -883,9 +1298,9 @@ int DownloadExtractThread::_on_close(struct archive *)
 
 void DownloadExtractThread::_configureArchiveOptions(struct archive *a)
 {
-    // Get number of CPU cores for multi-threading hints
-    int numCores = QThread::idealThreadCount();
-    if (numCores < 1) numCores = 1;
+    // CPUs this process may use, for multi-threading hints: a container's
+    // quota can be far below the host's core count
+    int numCores = ContainerLimits::cpuCount();
     if (numCores > 8) numCores = 8;  // Cap at 8 to avoid excessive memory usage
     
     QString threadsStr = QString::number(numCores);
@@ -894,6 +1309,8 @@ void DownloadExtractThread::_configureArchiveOptions(struct archive *a)
     // XZ/LZMA: Enable multi-threaded decoding if file has multiple blocks
     // Note: Only works if the .xz file was compressed with block threading
     // libarchive 3.3+ supports "threads" option for xz filter
+    // Raw .xz images are decoded by XzDecoder instead (see _extractNativeRun()),
+    // so this only applies to .tar.xz
     int ret = archive_read_set_option(a, "xz", "threads", threadsBytes.constData());
     if (ret == ARCHIVE_OK) {
         qDebug() << "XZ multi-threaded decoding enabled with" << numCores << "threads";
@@ -902,13 +1319,14 @@ void DownloadExtractThread::_configureArchiveOptions(struct archive *a)
     // Also try lzma filter (some files use raw lzma)
     archive_read_set_option(a, "lzma", "threads", threadsBytes.constData());
     
-    // ZSTD: Standard decompression is single-threaded by design
-    // The zstd format requires sequential block processing due to dictionary dependencies
-    // However, we can hint for optimal buffer sizing
-    // Note: As of libarchive 3.8, there's no "threads" option for zstd decompression
+    // ZSTD: libarchive has no "threads" option for zstd decompression.
+    // Raw .zst images are decoded by ZstdDecoder instead (see
+    // _extractNativeRun()), which parallelises multi-frame files;
+    // this path only sees .tar.zst.
     
     // Gzip: Single-threaded, no threading options available
-    // The gzip format doesn't support parallel decompression
+    // Raw .gz downloads are decoded by GzipDecoder, and raw .gz files
+    // already on disk by ParallelGzipDecoder (see _extractNativeRun()).
 }
 
 void DownloadExtractThread::_logCompressionFilters(struct archive *a)
@@ -935,7 +1353,7 @@ void DownloadExtractThread::_logCompressionFilters(struct archive *a)
         if (filters.contains("xz") || filters.contains("lzma")) {
             qDebug() << "XZ/LZMA: Multi-threaded decode enabled if file has multiple blocks";
         } else if (filters.contains("zstd")) {
-            qDebug() << "ZSTD: Using single-threaded streaming decompression (format limitation)";
+            qDebug() << "ZSTD: Using single-threaded streaming decompression (tar.zst via libarchive)";
         } else if (filters.contains("gzip")) {
             qDebug() << "GZIP: Using single-threaded decompression (format limitation)";
         }
@@ -972,33 +1390,80 @@ void DownloadExtractThread::_pushQueue(const char *data, size_t len)
     // Handle data larger than slot capacity by chunking
     size_t offset = 0;
     while (offset < len && !_cancelled) {
-        // Acquire a write slot (blocks if buffer is full)
-        RingBuffer::Slot* slot = _ringBuffer->acquireWriteSlot(100);  // 100ms timeout
-        if (!slot) {
-            if (_ringBuffer->isCancelled() || _cancelled) {
-                return;
-            }
-            // Poll for async I/O completions while waiting (prevents deadlock)
-            if (_file && _file->IsAsyncIOSupported()) {
-                _file->PollAsyncCompletions();
-            }
-            // Check for stall timeout (disk writes stalled for too long)
-            if (_ringBuffer->isStallTimeoutExceeded()) {
-                qDebug() << "DownloadExtractThread: Write ring buffer stall timeout in _pushQueue";
-                return;  // Let the caller handle the error
+        if (!_pushSlot) {
+            // Acquire a write slot (blocks if buffer is full)
+            RingBuffer::Slot* slot = _ringBuffer->acquireWriteSlot(100);  // 100ms timeout
+            if (!slot) {
+                if (_ringBuffer->isCancelled() || _cancelled) {
+                    return;
+                }
+                // Poll for async I/O completions while waiting (prevents deadlock)
+                if (_deviceReady() && _file && _file->IsAsyncIOSupported()) {
+                    _file->PollAsyncCompletions();
+                }
+                // Check for stall timeout (disk writes stalled for too long)
+                if (_ringBuffer->isStallTimeoutExceeded()) {
+                    qDebug() << "DownloadExtractThread: Write ring buffer stall timeout in _pushQueue";
+                    return;  // Let the caller handle the error
+                }
+                // Timeout - try again
+                continue;
             }
-            // Timeout - try again
-            continue;
+            _pushSlot = slot;
+            _pushSlotFill = 0;
         }
         
         // Copy data directly into the pre-allocated slot buffer (zero-copy from slot's perspective)
-        size_t chunkSize = std::min(len - offset, slot->capacity);
-        memcpy(slot->data, data + offset, chunkSize);
-        
-        // Commit the slot
-        _ringBuffer->commitWriteSlot(slot, chunkSize);
+        size_t chunkSize = std::min(len - offset, _pushSlot->capacity - _pushSlotFill);
+        memcpy(_pushSlot->data + _pushSlotFill, data + offset, chunkSize);
+        _pushSlotFill += chunkSize;
         offset += chunkSize;
+        
+        // The first slot is held until the start of the image can be
+        // looked at. Raw images are written straight from these slots, so
+        // theirs are filled up to whole device blocks. Otherwise the
+        // transfer's small chunks go on into the same slot while the
+        // extractor is busy, and the slot is handed over full or as soon as
+        // the extractor has nothing left to read.
+        if (!_rawProbed && _pushSlotFill >= std::min(RAW_PROBE_BYTES, _pushSlot->capacity)) {
+            _probeRawImage();
+        }
+        if (_rawProbed && (_pushSlotFill == _pushSlot->capacity
+                           || (!_rawPassThrough && _ringBuffer->isConsumerWaiting()))) {
+            _commitPushSlot();
+        }
+    }
+}
+
+void DownloadExtractThread::_commitPushSlot()
+{
+    if (!_pushSlot) {
+        return;
+    }
+    
+    // The cache writer shares the slot rather than copying the data again
+    if (_cacheWritable() && !_asyncCacheWriter->write(_ringBuffer, _pushSlot, _pushSlotFill)) {
+        _onCacheWriteRejected();
     }
+    
+    _ringBuffer->commitWriteSlot(_pushSlot, _pushSlotFill);
+    _pushSlot = nullptr;
+    _pushSlotFill = 0;
+}
+
+void DownloadExtractThread::_probeRawImage()
+{
+    _rawProbed = true;
+    
+    // Resumed downloads start part way into the image, and the native
+    // decoders and libarchive take everything else
+    if (!_isImage || _resumeSourceOffset || _pushSlot->capacity % _writeAlignment != 0
+        || !looksLikeRawImage(_pushSlot->data, _pushSlotFill)) {
+        return;
+    }
+    
+    qDebug() << "Download is an uncompressed image, writing it from the input buffers";
+    _rawPassThrough = true;
 }
 
 void DownloadExtractThread::_onVerifyProgress()
@@ -12,6 +12,7 @@
 #include <memory>
 
 class _extractThreadClass;
+class DecoderThread;
 
 class DownloadExtractThread : public DownloadThread
 {
@@ -33,11 +34,8 @@ public:
     virtual void enableMultipleFileExtraction();
 
 signals:
-    void downloadProgressChanged(quint64 now, quint64 total);
-    void decompressProgressChanged(quint64 now, quint64 total);
-    void writeProgressChanged(quint64 now, quint64 total);
-    void verifyProgressChanged(quint64 now, quint64 total);
     void eventRingBufferStats(qint64 timestampMs, quint32 durationMs, QString metadata);  // Ring buffer stall event
+    void eventRingBufferOccupancy(quint32 inputSlotsUsed, quint32 writeSlotsUsed);  // Filled slots, sampled with progress
     
     // Pipeline timing summary events (emitted at end of extraction)
     void eventPipelineDecompressionTime(quint32 totalMs, quint64 bytesDecompressed);
@@ -47,25 +45,31 @@ signals:
 
 protected:
     size_t _writeBufferSize;
+    size_t _writeAlignment;  // Write slot alignment and last-write padding, from the device's sector size
     _extractThreadClass *_extractThread;
     
     // Zero-copy ring buffer for curl -> libarchive data transfer (compressed data)
-    std::unique_ptr<RingBuffer> _ringBuffer;
+    // Shared with AsyncCacheWriter, which holds retained slots while caching
+    std::shared_ptr<RingBuffer> _ringBuffer;
     static const int RING_BUFFER_SLOTS;  // Number of slots in ring buffer
     RingBuffer::Slot* _currentReadSlot;  // Current slot being read by libarchive
+    RingBuffer::Slot* _peekedReadSlot;   // First slot, inspected before libarchive starts
+    RingBuffer::Slot* _pushSlot;         // Being filled by _pushQueue(), not yet committed
+    size_t _pushSlotFill;
+    bool _rawProbed;                     // The start of the download has been looked at
+    std::atomic<bool> _rawPassThrough;   // Uncompressed image, written from the input slots
     
     // Ring buffer for decompress -> write path (decompressed data).
     // Uses 4 slots to ensure buffers aren't reused while hash computation is pending.
     // shared_ptr so that async I/O completion callbacks can safely extend its lifetime.
     std::shared_ptr<RingBuffer> _writeRingBuffer;
     RingBuffer::Slot* _currentWriteSlot;  // Current slot being written
+    bool _writeBuffersRegistered = false; // Write slots pinned for async I/O, so never parked
     
     bool _ethreadStarted, _isImage;
     AcceleratedCryptographicHash _inputHash;
     bool _progressStarted;
     qint64 _lastProgressTime;
-    quint64 _lastEmittedDlNow, _lastLocalVerifyNow;
-    quint64 _lastEmittedDecompressNow, _lastEmittedWriteNow;
     std::atomic<quint64> _bytesDecompressed;  // Total bytes output from decompressor
     bool _downloadComplete;
     QElapsedTimer _sessionTimer;  // Timer for stall event timestamps
@@ -79,13 +83,31 @@ protected:
     QString _stallErrorMessage;
 
     void _pushQueue(const char *data, size_t len);
+    void _commitPushSlot();
+    void _probeRawImage();
     void _cancelExtract();
     virtual void _onDevicePrepared() override;
+    virtual void _onMemoryPressure(int percent) override;
+    void _reallocateUncappedRingBuffers();
     virtual size_t _writeData(const char *buf, size_t len) override;
     virtual void _onDownloadSuccess() override;
     virtual void _onDownloadError(const QString &msg) override;
     void _emitProgressUpdate();
+    void _emitPipelineSummary();
+    void _recordInputStall();
+
+    // Decode raw .zst/.xz images with a DecoderThread instead of libarchive.
+    // Returns false (without consuming input) if the download is not one.
+    virtual bool _extractNativeRun();
+    void _runDecoder(DecoderThread &decoder);
+    // Called for each decoded slot written; for sources whose input
+    // progress is not reported elsewhere
+    virtual void _onDecoderProgress(const DecoderThread &) {}
+    void _extractRawRun(RingBuffer::Slot *first);
     virtual void _onVerifyProgress() override;
+    virtual quint64 _bytesDecompressedSoFar() const override { return _bytesDecompressed; }
+    // _inputHash covers the compressed stream when extracting files
+    virtual bool _hashesCacheStream() const override { return !_isImage; }
 
     virtual ssize_t _on_read(struct archive *a, const void **buff);
     virtual int _on_close(struct archive *a);
@@ -6,30 +6,69 @@
 #include "downloadstatstelemetry.h"
 #include "imager_version.h"
 #include "curlnetworkconfig.h"
+#include "bandwidthscheduler.h"
 #include "config.h"
+#include "threadplacement.h"
 #include <QSettings>
 #include <QDebug>
+#include <QDeadlineTimer>
+#include <QDir>
+#include <QFileInfo>
 #include <QUrl>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QSysInfo>
 #include <QLocale>
 #include <QFile>
 #include <QRegularExpression>
 
-DownloadStatsTelemetry::DownloadStatsTelemetry(const QByteArray &url, const QByteArray &parentcategory, const QByteArray &osname, bool embedded, const QString &imagerLang, QObject *parent)
-    : QThread(parent), _url(TELEMETRY_URL)
+DownloadStatsTelemetry::DownloadStatsTelemetry(const QString &queueFile, QObject *parent)
+    : QThread(parent), _url(TELEMETRY_URL),
+      _queueFile(queueFile.isEmpty() ? defaultQueueFile() : queueFile)
+{
+    // Events left by a run that could not send them
+    QFile f(_queueFile);
+    if (f.open(QIODevice::ReadOnly)) {
+        for (const QByteArray &line : f.readAll().split('\n')) {
+            if (!line.isEmpty())
+                _queue.append(line);
+        }
+        while (_queue.size() > kMaxQueued)
+            _queue.removeFirst();
+    }
+}
+
+DownloadStatsTelemetry::~DownloadStatsTelemetry()
+{
+    stop();
+    wait();
+}
+
+bool DownloadStatsTelemetry::enabled()
+{
+    QSettings settings;
+    return settings.value("telemetry", TELEMETRY_ENABLED_DEFAULT).toBool();
+}
+
+QString DownloadStatsTelemetry::defaultQueueFile()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/telemetry-queue");
+}
+
+QByteArray DownloadStatsTelemetry::eventFields(const QByteArray &url, const QByteArray &parentcategory, const QByteArray &osname, bool embedded, const QString &imagerLang)
 {
     QLocale locale;
-    
+
     // Extract clean numeric version (X.Y.Z) from IMAGER_VERSION_STR for telemetry
     // Handles formats like: v2.0.0, v2.0.0-rc4-60-geac7c2f0, 2.0.0, etc.
     QString versionStr(IMAGER_VERSION_STR);
     static QRegularExpression versionRx("^v?([0-9]+\\.[0-9]+\\.[0-9]+)");
     QRegularExpressionMatch versionMatch = versionRx.match(versionStr);
-    QByteArray cleanVersion = versionMatch.hasMatch() 
-        ? versionMatch.captured(1).toLatin1() 
+    QByteArray cleanVersion = versionMatch.hasMatch()
+        ? versionMatch.captured(1).toLatin1()
         : QByteArray(IMAGER_VERSION_STR);
-    
-    _postfields = "url="+QUrl::toPercentEncoding(url)
+
+    QByteArray fields = "url="+QUrl::toPercentEncoding(url)
             +"&os="+QUrl::toPercentEncoding(parentcategory)
             +"&image="+QUrl::toPercentEncoding(osname)
             +"&imagerVersion="+QUrl::toPercentEncoding(cleanVersion)
@@ -38,61 +77,180 @@ DownloadStatsTelemetry::DownloadStatsTelemetry(const QByteArray &url, const QByt
             +"&imagerOsArch="+QUrl::toPercentEncoding(QSysInfo::currentCpuArchitecture())
             +"&imagerLocale="+QUrl::toPercentEncoding(embedded ? imagerLang : locale.name());
 #ifdef Q_OS_LINUX
-    QFile f("/proc/cpuinfo");
-    f.open(f.ReadOnly);
-    QByteArray cpuinfo = f.readAll();
-    f.close();
-
-    if (cpuinfo.contains("Raspberry Pi")) {
-        static QRegularExpression rx("Revision[ \t]*: ([0-9a-f]+)");
-        QRegularExpressionMatch m = rx.match(cpuinfo);
-        if (m.hasMatch())
-        {
-            _postfields += "&imagerPiRevision="+QUrl::toPercentEncoding(m.captured(1));
+    // Only read once; the revision does not change while running
+    static const QByteArray piRevision = [] {
+        QFile f("/proc/cpuinfo");
+        f.open(f.ReadOnly);
+        QByteArray cpuinfo = f.readAll();
+        f.close();
+
+        if (cpuinfo.contains("Raspberry Pi")) {
+            static QRegularExpression rx("Revision[ \t]*: ([0-9a-f]+)");
+            QRegularExpressionMatch m = rx.match(cpuinfo);
+            if (m.hasMatch())
+                return QUrl::toPercentEncoding(m.captured(1));
         }
-    }
+        return QByteArray();
+    }();
+    if (!piRevision.isEmpty())
+        fields += "&imagerPiRevision="+piRevision;
 #endif
+    return fields;
 }
 
-void DownloadStatsTelemetry::run()
+void DownloadStatsTelemetry::enqueue(const QByteArray &fields)
 {
-    QSettings settings;
-    if (!settings.value("telemetry", TELEMETRY_ENABLED_DEFAULT).toBool())
+    const bool on = enabled();
+
+    QMutexLocker lock(&_mutex);
+    if (!on) {
+        if (!_queue.isEmpty()) {
+            _queue.clear();
+            _saveLocked();
+        }
         return;
+    }
+
+    _queue.append(fields);
+    while (_queue.size() > kMaxQueued)
+        _queue.removeFirst();
+    _saveLocked();
+    _wake.wakeAll();
+}
+
+void DownloadStatsTelemetry::stop()
+{
+    QMutexLocker lock(&_mutex);
+    _stop = true;
+    _wake.wakeAll();
+}
+
+int DownloadStatsTelemetry::pending() const
+{
+    QMutexLocker lock(&_mutex);
+    return _queue.size();
+}
+
+void DownloadStatsTelemetry::_saveLocked()
+{
+    if (_queue.isEmpty()) {
+        QFile::remove(_queueFile);
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(_queueFile).absolutePath());
+    QSaveFile f(_queueFile);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qDebug() << "Telemetry: cannot save queue:" << f.errorString();
+        return;
+    }
+    // Form-encoded fields have no newlines
+    for (const QByteArray &fields : std::as_const(_queue)) {
+        f.write(fields);
+        f.write("\n");
+    }
+    f.commit();
+}
+
+void DownloadStatsTelemetry::run()
+{
+    ThreadPlacement::apply(ThreadPlacement::Role::Background);
 
     _c = curl_easy_init();
     if (!_c) {
         qDebug() << "Telemetry: failed to init curl";
         return;
     }
-    
+
     // Apply shared network configuration with FireAndForget profile
     // This gives us: IPv4-only support, proper timeouts, CA bundle, etc.
     CurlNetworkConfig::instance().applyCurlSettings(
-        _c, 
+        _c,
         CurlNetworkConfig::FetchProfile::FireAndForget
     );
-    
+
     // Telemetry-specific settings
     curl_easy_setopt(_c, CURLOPT_WRITEFUNCTION, &DownloadStatsTelemetry::_curl_write_callback);
     curl_easy_setopt(_c, CURLOPT_HEADERFUNCTION, &DownloadStatsTelemetry::_curl_header_callback);
+    curl_easy_setopt(_c, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(_c, CURLOPT_XFERINFOFUNCTION, &DownloadStatsTelemetry::_curl_xferinfo_callback);
+    curl_easy_setopt(_c, CURLOPT_XFERINFODATA, this);
     curl_easy_setopt(_c, CURLOPT_URL, _url.constData());
-    curl_easy_setopt(_c, CURLOPT_POSTFIELDSIZE, _postfields.length());
-    curl_easy_setopt(_c, CURLOPT_POSTFIELDS, _postfields.constData());
+    // Keep the connection between the writes of a batch run
+    curl_easy_setopt(_c, CURLOPT_TCP_KEEPALIVE, 1L);
+#if LIBCURL_VERSION_NUM >= 0x074100  // 7.65.0
+    curl_easy_setopt(_c, CURLOPT_MAXAGE_CONN, 600L);
+#endif
+
+    QMutexLocker lock(&_mutex);
+    while (!_stop) {
+        if (_queue.isEmpty()) {
+            _wake.wait(&_mutex);
+            continue;
+        }
+
+        // Let the rest of a batch arrive
+        QDeadlineTimer batch(kBatchDelayMs);
+        while (!_stop && _wake.wait(&_mutex, batch)) {}
+
+        bool failed = false;
+        while (!_stop && !_queue.isEmpty()) {
+            const QByteArray fields = _queue.first();
+            lock.unlock();
+            const SendResult result = _send(fields);
+            lock.relock();
+
+            if (result == SendResult::Failed) {
+                failed = true;
+                break;
+            }
+            // enqueue() may have dropped it to stay under kMaxQueued
+            if (!_queue.isEmpty() && _queue.first() == fields)
+                _queue.removeFirst();
+        }
+        _saveLocked();
+
+        // Offline: try again later, or when the next event arrives
+        if (failed && !_stop)
+            _wake.wait(&_mutex, kRetryIntervalMs);
+    }
+    lock.unlock();
 
-    CURLcode ret = curl_easy_perform(_c);
     curl_easy_cleanup(_c);
+    _c = nullptr;
+}
+
+DownloadStatsTelemetry::SendResult DownloadStatsTelemetry::_send(const QByteArray &fields)
+{
+    curl_easy_setopt(_c, CURLOPT_POSTFIELDSIZE, static_cast<long>(fields.length()));
+    curl_easy_setopt(_c, CURLOPT_POSTFIELDS, fields.constData());
 
-    if (ret == CURLE_OK) {
-        qDebug() << "Telemetry sent successfully";
-    } else {
+    CURLcode ret = curl_easy_perform(_c);
+    if (ret != CURLE_OK) {
         qDebug() << "Telemetry failed:" << curl_easy_strerror(ret);
+        return SendResult::Failed;
+    }
+
+    long httpCode = 0;
+    curl_easy_getinfo(_c, CURLINFO_RESPONSE_CODE, &httpCode);
+    if (httpCode >= 500) {
+        qDebug() << "Telemetry failed: HTTP" << httpCode;
+        return SendResult::Failed;
+    }
+    if (httpCode >= 400) {
+        // Sending it again would not help
+        qDebug() << "Telemetry rejected: HTTP" << httpCode;
+        return SendResult::Rejected;
     }
+
+    qDebug() << "Telemetry sent successfully";
+    return SendResult::Sent;
 }
 
 /* /dev/null write handler */
 size_t DownloadStatsTelemetry::_curl_write_callback(char *, size_t size, size_t nmemb, void *)
 {
+    BandwidthScheduler::instance().acquire(BandwidthScheduler::Priority::Telemetry, static_cast<qint64>(size * nmemb));
     return size * nmemb;
 }
 
@@ -101,3 +259,9 @@ size_t DownloadStatsTelemetry::_curl_header_callback( void *ptr, size_t size, si
     int len = size*nmemb;
     return len;
 }
+
+int DownloadStatsTelemetry::_curl_xferinfo_callback(void *clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+{
+    // Abort so that stop() does not wait out the timeout
+    return static_cast<DownloadStatsTelemetry *>(clientp)->_stop.load() ? 1 : 0;
+}
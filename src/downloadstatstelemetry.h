@@ -3,29 +3,90 @@
 
 /*
  * SPDX-License-Identifier: Apache-2.0
- * Copyright (C) 2020 Raspberry Pi Ltd
+ * Copyright (C) 2020-2025 Raspberry Pi Ltd
  */
 
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
 #include <QObject>
+#include <QString>
 #include <QThread>
+#include <QWaitCondition>
+#include <atomic>
 #include <curl/curl.h>
 
+/**
+ * @brief Sends download statistics from one long-lived background thread
+ *
+ * Events are queued with enqueue() and sent by a single thread that keeps
+ * one curl handle, so that a batch run of hundreds of writes reuses one
+ * connection (and one TLS session) instead of starting a thread and a
+ * handshake per write. Events arriving within kBatchDelayMs of each other,
+ * as from a multi-target write, go out together in one pass.
+ *
+ * The queue is mirrored to a file, so events from a station that is
+ * offline are kept (up to kMaxQueued, oldest dropped first) and sent once
+ * it is back, by this run or a later one. The endpoint takes one event per
+ * POST, so a batch is a run of POSTs over the one connection.
+ */
 class DownloadStatsTelemetry : public QThread
 {
     Q_OBJECT
 public:
-    explicit DownloadStatsTelemetry(const QByteArray &url, const QByteArray &parentcategory, const QByteArray &osname, bool embedded, const QString &imagerLang, QObject *parent = nullptr);
+    static constexpr int kMaxQueued = 500;
+    static constexpr int kBatchDelayMs = 2000;
+    static constexpr int kRetryIntervalMs = 5 * 60 * 1000;
+
+    /**
+     * @param queueFile File the queue is kept in; empty for the default in
+     * the cache directory
+     */
+    explicit DownloadStatsTelemetry(const QString &queueFile = QString(), QObject *parent = nullptr);
+    ~DownloadStatsTelemetry() override;
+
+    /**
+     * @brief Form fields of one download event
+     */
+    static QByteArray eventFields(const QByteArray &url, const QByteArray &parentcategory, const QByteArray &osname, bool embedded, const QString &imagerLang);
+
+    static bool enabled();
+    static QString defaultQueueFile();
+
+    /**
+     * @brief Queue an event for sending, if telemetry is enabled
+     *
+     * With telemetry disabled, anything still queued is dropped as well.
+     */
+    void enqueue(const QByteArray &fields);
+
+    /**
+     * @brief Stop the thread; whatever is still queued stays on disk
+     */
+    void stop();
+
+    int pending() const;
 
 protected:
-    CURL *_c;
-    QByteArray _url, _useragent, _postfields;
-    virtual void run();
+    void run() override;
+
+private:
+    enum class SendResult { Sent, Rejected, Failed };
+
+    SendResult _send(const QByteArray &fields);
+    void _saveLocked();
     static size_t _curl_write_callback(char *ptr, size_t size, size_t nmemb, void *userdata);
+    static int _curl_xferinfo_callback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
     static size_t _curl_header_callback( void *ptr, size_t size, size_t nmemb, void *userdata);
 
-signals:
+    CURL *_c = nullptr;
+    QByteArray _url;
+    QString _queueFile;
 
-public slots:
+    mutable QMutex _mutex;
+    QWaitCondition _wake;
+    QList<QByteArray> _queue;
+    std::atomic<bool> _stop{false};
 };
 
 #endif // DOWNLOADSTATSTELEMETRY_H
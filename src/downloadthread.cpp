@@ -7,11 +7,21 @@
 #include "aligned_buffer.h"
 #include "config.h"
 #include "devicewrapper.h"
+#include "file_operations_memory.h"
+#include "file_operations_emulated.h"
+#include "file_operations_replay.h"
+#include "file_operations_tracing.h"
 #include "devicewrapperfatpartition.h"
 #include "systemmemorymanager.h"
+#include "bufferpool.h"
+#include "memorypressuremonitor.h"
 #include "timeout_utils.h"
 #include "platformquirks.h"
+#include "performancestats.h"
+#include "livemetrics.h"
 #include "drivelist/drivelist.h"
+#include "remotesizeprobe.h"
+#include "tracepoints.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -22,8 +32,13 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <regex>
+#include <zlib.h>
 #include <future>
 #include <chrono>
+#include <algorithm>
+#include <optional>
+#include <limits>
+#include <thread>
 #include <QDebug>
 #include <QProcess>
 #include <QSettings>
@@ -32,6 +47,9 @@
 #include <QtNetwork/QNetworkProxy>
 #include <QTextStream>
 #include <QRegularExpression>
+#include <QRandomGenerator>
+#include <QUrl>
+#include <QLocale>
 
 #ifdef Q_OS_WIN
 #include <windows.h>
@@ -44,8 +62,10 @@
 #include "imageadvancedoptions.h"
 #include "secureboot.h"
 #include "curlnetworkconfig.h"
+#include "bandwidthscheduler.h"
 #include "fastboot/sparse_encoder.h"  // isBlockZero()
-#include <QTemporaryDir>
+#include "fastboot/bmap.h"
+#include "usedblockscanner.h"
 
 using namespace std;
 
@@ -54,25 +74,84 @@ using rpi_imager::TimeoutResult;
 using rpi_imager::TimeoutConfig;
 using rpi_imager::runWithTimeout;
 using rpi_imager::TimeoutDefaults::kHardTimeoutSeconds;
+using rpi_imager::TimeoutDefaults::kFanOutPrepareTimeoutSeconds;
 using rpi_imager::TimeoutDefaults::kMemoryCheckIntervalMs;
 using rpi_imager::TimeoutDefaults::kCriticalMemoryMB;
+using rpi_imager::TimeoutDefaults::kCancelPollIntervalMs;
 
 QByteArray DownloadThread::_proxy;
 
+// Minimum amount of newly durable data before handing it to the pipelined verifier
+static constexpr std::uint64_t PIPELINED_VERIFY_MIN_COMMIT = 64 * 1024 * 1024;
+
+// Verification buffers come from the BufferPool: how long to wait for other
+// stages to return memory, and the smallest buffer worth verifying with
+static constexpr int VERIFY_BUFFER_WAIT_MS = 1000;
+static constexpr size_t MIN_VERIFY_BUFFER_SIZE = 256 * 1024;
+
+// Ranged writeback: size of the regions queued with StartWriteback(), as a
+// fraction of the sync interval and within these bounds
+static constexpr std::uint64_t MIN_WRITEBACK_WINDOW = 8 * 1024 * 1024;
+static constexpr std::uint64_t MAX_WRITEBACK_WINDOW = 64 * 1024 * 1024;
+
+// Resumable writes: journal ranges read back from the device before it is
+// trusted, the fewest ranges worth resuming from, and the read size used
+static constexpr int RESUME_SPOT_CHECK_RANGES = 2;
+static constexpr int RESUME_MIN_RANGES = 2;
+static constexpr size_t RESUME_READ_SIZE = 4 * 1024 * 1024;
+
+// Delta writes: compared in blocks of this size, read back this much at a
+// time, and given up on once DELTA_GIVE_UP_CHANGED_BYTES compared have
+// differed while less than this share turned out to be unchanged
+static constexpr size_t DELTA_BLOCK_SIZE = 4096;
+static constexpr size_t DELTA_READ_SIZE = 4 * 1024 * 1024;
+static constexpr std::uint64_t DELTA_GIVE_UP_CHANGED_BYTES = 8ull * 1024 * 1024;
+static constexpr int DELTA_MIN_UNCHANGED_PERCENT = 25;
+
+// Partial writes: read from the start of the device for its partition table
+static constexpr size_t PARTITION_TABLE_READ_SIZE = 1024 * 1024;
+
 DownloadThread::DownloadThread(const QByteArray &url, const QByteArray &localfilename, const QByteArray &expectedHash, QObject *parent) :
     QThread(parent), _startOffset(0), _lastDlTotal(0), _lastDlNow(0), _extractTotal(0), _verifyTotal(0), _lastVerifyNow(0), _bytesWritten(0), _lastFailureOffset(0), _sectorsStart(-1), _url(url), _filename(localfilename), _expectedHash(expectedHash),
     _firstBlock(nullptr), _cancelled(false), _successful(false), _verifyEnabled(false), _cacheEnabled(false), _lastModified(0), _serverTime(0),  _lastFailureTime(0),
-    _inputBufferSize(SystemMemoryManager::instance().getOptimalInputBufferSize()), _writehash(OSLIST_HASH_ALGORITHM), _verifyhash(OSLIST_HASH_ALGORITHM),
-    _hasPendingHash(false)
+    _inputBufferSize(SystemMemoryManager::instance().getOptimalInputBufferSize()), _writehash(OSLIST_HASH_ALGORITHM), _writeTreeHash(OSLIST_HASH_ALGORITHM, AcceleratedCryptographicHash::Mode::Comparison), _verifyhash(OSLIST_HASH_ALGORITHM, AcceleratedCryptographicHash::Mode::Comparison)
 {
+    _stageCpuStart = ThreadCpuTime::sample();
+    _stageCpuTimer.start();
+
     // Ensure libcurl is initialized (handled centrally by CurlNetworkConfig)
     CurlNetworkConfig::ensureInitialized();
 
     QSettings settings;
     _ejectEnabled = settings.value("eject", true).toBool();
+    _writeTuningEnabled = settings.value("writetuning/enabled", true).toBool();
+    _rangedWritebackEnabled = settings.value("rangedwriteback/enabled", true).toBool();
+    _resumeEnabled = settings.value("resumablewrites/enabled", true).toBool();
+    _mapUsedBlocks = settings.value("usedblocks/enabled", true).toBool();
+    _bootShadowEnabled = settings.value("bootshadow/enabled", true).toBool();
+    _capacityProbeEnabled = settings.value("capacityprobe/enabled", true).toBool();
+    _deltaWritesEnabled = settings.value("deltawrites/enabled", false).toBool();
+    _deltaWritesAuto = settings.value("deltawrites/auto", true).toBool();
+    _queueTuningEnabled = settings.value("queuetuning/enabled", false).toBool();
+    _usbPowerEnabled = settings.value("usbpower/enabled", false).toBool();
+    _pipelineBalanceEnabled = settings.value("pipelinebalance/enabled", true).toBool();
+    _memoryPressureEnabled = settings.value("memorypressure/enabled", true).toBool();
+    if (_memoryPressureEnabled)
+        MemoryPressureMonitor::instance();  // Starts watching
+    _eraseBeforeWrite = false;
+
+#ifdef Q_OS_LINUX
+    // Before DownloadExtractThread sizes its write slots from max_sectors_kb
+    if (_queueTuningEnabled && _filename.startsWith("/dev/"))
+        _queueTuner.tune(QString::fromLatin1(_filename.mid(5)), settings);
+#endif
+
+    if (_usbPowerEnabled)
+        _usbPowerHeld = PlatformQuirks::holdDevicePowerOn(QString::fromLatin1(_filename));
 
     // Initialize unified file operations
     _file = rpi_imager::FileOperations::Create();
+    _hasher = std::make_unique<HashPipeline>([this](const char *buf, size_t len) { _hashData(buf, len); });
 #ifdef Q_OS_WIN
     _volumeFile = rpi_imager::FileOperations::Create();
 #endif
@@ -81,6 +160,9 @@ DownloadThread::DownloadThread(const QByteArray &url, const QByteArray &localfil
     _lastSyncBytes = 0;
     _lastSyncTime.start();
     _initializeSyncConfiguration();
+
+    // All pipeline buffers for this write come out of one pool
+    BufferPool::instance().setLimit(SystemMemoryManager::instance().getBufferPoolLimit());
     
     // Initialize write timing tracking
     _writeTimingStats.reset();
@@ -96,6 +178,34 @@ DownloadThread::DownloadThread(const QByteArray &url, const QByteArray &localfil
     _debugIPv4Only = false;     // Use both IPv4 and IPv6 by default
     _debugSkipEndOfDevice = false; // For counterfeit cards with fake capacity
     _debugIgnoreDeviceLimits = false; // Ignore device-reported I/O limits
+    _debugParallelDownload = false; // Single connection unless enabled
+    _hashMappedRanges = false;
+    _mappedHashCursor = 0;
+    _mappedRangeWhole = false;
+    _zeroRangeFailed = false;
+    _bootShadowDecided = false;
+    _bootShadowForwarding = false;
+    _bootShadowReplaying = false;
+    _bootShadowCustomised = false;
+    _debugPipelinedVerify = false; // Verify after writing unless enabled
+    _lastSyncedOffset = 0;
+    _verifyCommitted = 0;
+    _verifyCoverage = 100.0;
+    _writebackStarted = 0;
+    _writebackWaited = 0;
+    _asyncSyncPending = false;
+    _resumeOffset = 0;
+    _resumeSourceOffset = 0;
+    _clonedUpTo = 0;
+    _writeHashTrusted = false;
+    _rawSource = false;
+    _mirrorExpectedBps = 0;
+    _writeBlockedNs = 0;
+    _rateLimited = false;
+    _mirrorWindowBytes = 0;
+    _mirrorWindowBlockedNs = 0;
+    _mirrorSlowWindows = 0;
+    _mirrorSwitchRequested = false;
     
     // Initialize bottleneck detection
     _currentBottleneck = BottleneckState::None;
@@ -106,15 +216,14 @@ DownloadThread::~DownloadThread()
 {
     _cancelled = true;
     wait();
+    if (_devicePreparation.valid())
+        _devicePreparation.wait();
     
-    // Wait for any pending hash computation to complete before destroying
-    if (_hasPendingHash) {
-        _pendingHashFuture.waitForFinished();
-        _hasPendingHash = false;
-    }
+    // Finish any queued hashing before the hashes are destroyed
+    _hasher.reset();
     
     // Close unified file operations
-    if (_file && _file->IsOpen()) {
+    if (_file && _file->IsOpen() && !isSyncInFlight()) {
         _file->Close();
     }
 #ifdef Q_OS_WIN
@@ -128,12 +237,37 @@ DownloadThread::~DownloadThread()
         _asyncCacheWriter->cancel();
         _asyncCacheWriter.reset();
     }
+    if (_imageCacheWriter) {
+        _imageCacheWriter->cancel();
+        _imageCacheWriter.reset();
+    }
     
     // Use _closeFiles() to ensure cache file is properly closed
     _closeFiles();
 
+    // The sync abandoned on cancel still uses the device; close it when that returns
+    if (_file && isSyncInFlight()) {
+        std::thread([file = std::move(_file), sync = _abandonedSync]() {
+            sync.wait();
+            if (file->IsOpen())
+                file->Close();
+        }).detach();
+    }
+
+    if (_queueTuner.isTuned())
+    {
+        QSettings settings;
+        _queueTuner.restore(settings);
+    }
+
+    if (!_usbPowerHeld.isEmpty())
+        PlatformQuirks::releaseDevicePower(QString::fromLatin1(_filename));
+
     if (_firstBlock)
         qFreeAligned(_firstBlock);
+
+    // Don't hold on to cached buffers between writes
+    BufferPool::instance().trim();
     
     // Note: curl_global_cleanup() is not called here - it happens at process exit.
     // This is safe and avoids issues with multiple DownloadThread instances.
@@ -157,7 +291,19 @@ void DownloadThread::setUserAgent(const QByteArray &ua)
 /* Curl write callback function, let it call the object oriented version */
 size_t DownloadThread::_curl_write_callback(char *ptr, size_t size, size_t nmemb, void *userdata)
 {
-    return static_cast<DownloadThread *>(userdata)->_writeData(ptr, size * nmemb);
+    // Time the pipeline or the rate limit holds the download back is not the mirror's fault
+    auto *self = static_cast<DownloadThread *>(userdata);
+    QElapsedTimer blocked;
+    blocked.start();
+    if (self->_rateLimited)
+        BandwidthScheduler::instance().acquire(BandwidthScheduler::Priority::Foreground, static_cast<qint64>(size * nmemb));
+    const size_t ret = self->_writeData(ptr, size * nmemb);
+    self->_writeBlockedNs += blocked.nsecsElapsed();
+    // Counted here rather than from the progress callback, which can lag
+    // behind, so a reconnect asks for exactly the next byte
+    self->_transferDelivered += ret;
+    self->_lastDlNow = self->_startOffset + self->_transferDelivered;
+    return ret;
 }
 
 int DownloadThread::_curl_xferinfo_callback(void *userdata, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
@@ -188,10 +334,140 @@ QByteArray DownloadThread::_fileGetContentsTrimmed(const QString &filename)
     return result;
 }
 
+/* Discards every block of the drive so the controller starts from a clean
+ * state (fresh flash translation tables, no stale data outside the image).
+ * Not all devices and card readers support it, so failing is not an error;
+ * the MBR zeroing that follows covers what matters for a correct write. */
+void DownloadThread::_eraseDevice()
+{
+    emit preparationStatusUpdate(tr("Erasing drive..."));
+    qDebug() << "Erasing whole drive before writing";
+
+    std::uint64_t knownsize = 0;
+    _file->GetSize(knownsize);
+
+    QElapsedTimer eraseTimer;
+    eraseTimer.start();
+    rpi_imager::FileError result = _file->EraseDevice();
+    qint64 eraseMs = eraseTimer.elapsed();
+    const bool success = result == rpi_imager::FileError::kSuccess;
+
+    if (success)
+        qDebug() << "Erased" << knownsize / (1024 * 1024) << "MB in" << eraseMs << "ms";
+    else
+        qDebug() << "Drive erase not supported or failed, error code" << _file->GetLastErrorCode() << "- continuing without it";
+
+    QString metadata = QString("device_size_mb: %1; error_code: %2")
+        .arg(knownsize / (1024 * 1024))
+        .arg(success ? 0 : _file->GetLastErrorCode());
+    emit eventDriveErase(static_cast<quint32>(eraseMs), success, metadata);
+}
+
+bool DownloadThread::_probeCapacity()
+{
+    // Skipping the end of the device is how counterfeit cards are used knowingly
+    if (!_capacityProbeEnabled || _debugSkipEndOfDevice ||
+        rpi_imager::MemoryFileOperations::IsMemoryTarget(_filename.toStdString()))
+    {
+        return true;
+    }
+
+    std::uint64_t knownsize = 0;
+    if (_file->GetSize(knownsize) != rpi_imager::FileError::kSuccess)
+        return true;  // Reported when the end of the device is zeroed
+
+    if (_deviceProfile.probedCapacity && _deviceProfile.probedCapacity < knownsize)
+        qDebug() << "Capacity probe: an earlier card of this model held only" << _deviceProfile.probedCapacity / (1024 * 1024) << "MB";
+
+    emit preparationStatusUpdate(tr("Checking storage capacity..."));
+    QElapsedTimer probeTimer;
+    probeTimer.start();
+
+    // A write past the real capacity can hang, as when zeroing the end
+    auto file = _file.get();
+    const size_t tagSize = _file->GetDeviceIOLimits().BufferAlignment(4096);
+    const std::uint64_t nonce = QRandomGenerator::global()->generate64();
+    // Outlives this function if the probe is abandoned on timeout
+    auto probeResult = std::make_shared<CapacityProbe::Result>();
+    int unused = 0;
+    auto timeoutResult = runWithTimeout(
+        [file, knownsize, tagSize, nonce, probeResult]() {
+            *probeResult = CapacityProbe::run(*file, knownsize, tagSize, nonce);
+            return 0;
+        },
+        unused,
+        TimeoutConfig(kHardTimeoutSeconds).withCancelFlag(&_cancelled)
+    );
+    _file->Seek(0);
+
+    const qint64 probeMs = probeTimer.elapsed();
+    if (timeoutResult == TimeoutResult::Cancelled)
+        return false;
+    if (timeoutResult == TimeoutResult::TimedOut)
+    {
+        emit eventDriveCapacityProbe(static_cast<quint32>(probeMs), false, QString("reported_mb: %1; timed_out: yes").arg(knownsize / (1024 * 1024)));
+        emit error(tr("Timeout writing to storage device.\n\n"
+                      "This may indicate a counterfeit SD card with fake capacity.\n\n"
+                      "Please try a different storage device."));
+        return false;
+    }
+
+    const CapacityProbe::Result result = *probeResult;
+    qDebug() << "Capacity probe:" << result.probes << "probes," << result.failed << "failed in" << probeMs << "ms;"
+             << "reported" << knownsize / (1024 * 1024) << "MB, detected" << result.capacity / (1024 * 1024) << "MB";
+    emit eventDriveCapacityProbe(static_cast<quint32>(probeMs), result.ok,
+                                 QString("reported_mb: %1; detected_mb: %2; probes: %3; failed: %4")
+                                     .arg(knownsize / (1024 * 1024))
+                                     .arg(result.capacity / (1024 * 1024))
+                                     .arg(result.probes)
+                                     .arg(result.failed));
+
+    if (result.ioError)
+    {
+        emit error(_fileErrorToString(rpi_imager::FileError::kSyncError, tr("preparing storage device")));
+        return false;
+    }
+
+    if (!_deviceProfileKey.isEmpty())
+    {
+        _sessionProfile.probedCapacity = result.capacity;
+        // The write stops here, so this is not stored with the rest of the session
+        if (!result.ok)
+            QSettings().setValue(_deviceProfileKey + "/probedCapacity", static_cast<quint64>(result.capacity));
+    }
+
+    if (!result.ok)
+    {
+        emit error(tr("The storage device reports a capacity of %1 GB, but could only store data in the first %2 GB.\n\n"
+                      "This indicates a counterfeit SD card with fake capacity.\n\n"
+                      "Please try a different storage device.")
+                       .arg(knownsize / 1000000000.0, 0, 'f', 1)
+                       .arg(result.capacity / 1000000000.0, 0, 'f', 1));
+        return false;
+    }
+    return true;
+}
+
 bool DownloadThread::_openAndPrepareDevice()
+{
+    // Additional devices are unmounted, cleaned and zeroed at the same time
+    // as the primary one. One after the other, each would add its own clean
+    // and settle time before any data flows.
+    _startFanOutTargets();
+    if (!_openAndPreparePrimaryDevice())
+    {
+        _cancelFanOutTargets();
+        return false;
+    }
+    return _openFanOutTargets();
+}
+
+bool DownloadThread::_openAndPreparePrimaryDevice()
 {
     QElapsedTimer unmountTimer;
     QElapsedTimer openTimer;
+
+    _loadDeviceProfile();
     
     if (_filename.startsWith("/dev/"))
     {
@@ -205,6 +481,8 @@ bool DownloadThread::_openAndPrepareDevice()
         PlatformQuirks::DiskResult unmountResult = PlatformQuirks::unmountDisk(unmountPath);
         bool unmountSuccess = (unmountResult == PlatformQuirks::DiskResult::Success);
         emit eventDriveUnmount(static_cast<quint32>(unmountTimer.elapsed()), unmountSuccess);
+        if (unmountSuccess)
+            _sessionProfile.unmountMs = static_cast<quint32>(unmountTimer.elapsed());
         
         if (!unmountSuccess) {
             qDebug() << "Unmount failed with result:" << static_cast<int>(unmountResult);
@@ -319,6 +597,34 @@ bool DownloadThread::_openAndPrepareDevice()
 
 #endif
 
+    // null: and ramdisk: targets stand in for a device when measuring the
+    // download/decompress/hash pipeline on its own, replay: ones play back
+    // a device recorded with an I/O trace and emulate: ones a modelled
+    // slow device
+    if (rpi_imager::ReplayFileOperations::IsReplayTarget(filename_str))
+    {
+        qDebug() << "Writing to replayed device" << _filename;
+        _file = std::make_unique<rpi_imager::ReplayFileOperations>();
+    }
+    else if (rpi_imager::EmulatedFileOperations::IsEmulatedTarget(filename_str))
+    {
+        qDebug() << "Writing to emulated device" << _filename;
+        _file = std::make_unique<rpi_imager::EmulatedFileOperations>();
+    }
+    else if (rpi_imager::MemoryFileOperations::IsMemoryTarget(filename_str))
+    {
+        qDebug() << "Writing to in-memory target" << _filename;
+        _file = std::make_unique<rpi_imager::MemoryFileOperations>();
+    }
+
+    if (!_ioTraceFile.isEmpty())
+    {
+        auto tracing = std::make_unique<rpi_imager::TracingFileOperations>(std::move(_file), _ioTraceFile.toStdString());
+        if (tracing->IsRecording())
+            qDebug() << "Recording device I/O trace to" << _ioTraceFile;
+        _file = std::move(tracing);
+    }
+
     // Device path is already platform-optimized by caller (e.g., rdisk on macOS)
     rpi_imager::FileError result = _file->OpenDevice(filename_str);
 
@@ -423,6 +729,8 @@ bool DownloadThread::_openAndPrepareDevice()
         }
         if (limits.max_transfer_bytes > 0)
             qDebug() << "Device max transfer:" << limits.max_transfer_bytes << "bytes";
+        if (limits.optimal_io_bytes > 0)
+            qDebug() << "Device optimal I/O size:" << limits.optimal_io_bytes << "bytes";
     }
 
     // Configure async I/O if enabled
@@ -434,6 +742,8 @@ bool DownloadThread::_openAndPrepareDevice()
         qDebug() << "Async I/O requested but not supported on this platform";
     }
 
+    _beginWriteTuning();
+
 #ifdef Q_OS_LINUX
     if (_filename.startsWith("/dev/"))
     {
@@ -449,10 +759,88 @@ bool DownloadThread::_openAndPrepareDevice()
     }
 #endif
 
+    // A resumed write continues on top of what the interrupted one left,
+    // which already had its start and end cleared
+    _prepareResume();
+
+    // Writing single partitions keeps the rest of the device, including
+    // its partition table, so none of it is probed, erased or zeroed
+    if (!_writePartitions.isEmpty() && !_fanOutDevices.isEmpty())
+    {
+        emit error(tr("Single partitions cannot be written to several storage devices at once."));
+        return false;
+    }
+    const bool wholeDevice = _writePartitions.isEmpty() && !_resumeOffset;
+
+    // Before the erase, which clears the tags again, and before the end of
+    // the device is zeroed, which can hang on a fake card
+    if (wholeDevice && !_probeCapacity())
+        return false;
+
+    if (_eraseBeforeWrite && wholeDevice)
+        _eraseDevice();
+
+    // Reading back before every write only pays off on a card that holds a
+    // similar image: by default, only once the device profile shows an image
+    // was written to this model before. An erased card holds nothing worth
+    // comparing with, and additional devices get their copy from _writeFile()
+    const bool deltaWanted = _deltaWritesEnabled || (_deltaWritesAuto && !_deviceProfile.isEmpty());
+    _deltaActive = deltaWanted && !_eraseBeforeWrite && _fanOutDevices.isEmpty();
+
+#ifndef Q_OS_WIN
+    if (wholeDevice && !_zeroDeviceEnds())
+        return false;
+#endif
+
+#ifdef Q_OS_LINUX
+    _sectorsStart = _sectorsWritten();
+#endif
+
+    // Include I/O mode in drive open event for diagnostics
+    QString ioModeMetadata = QString("direct_io: %1; platform: %2; resumed_mb: %3")
+        .arg(_file->IsDirectIOEnabled() ? "yes" : "no")
+        .arg(SystemMemoryManager::instance().getPlatformName())
+        .arg(_resumeOffset / (1024 * 1024));
+    emit eventDriveOpen(static_cast<quint32>(openTimer.elapsed()), true, ioModeMetadata);
+    
+    // Emit detailed direct I/O attempt info for performance analysis
+    auto directIOInfo = _file->GetDirectIOInfo();
+    emit eventDirectIOAttempt(
+        directIOInfo.attempted,
+        directIOInfo.succeeded,
+        directIOInfo.currently_enabled,
+        directIOInfo.error_code,
+        QString::fromStdString(directIOInfo.error_message));
+    if (directIOInfo.attempted)
+        _sessionProfile.directIO = directIOInfo.succeeded ? DeviceProfile::DirectIO::Worked
+                                                          : DeviceProfile::DirectIO::Failed;
+
+    if (_queueTuner.isTuned())
+    {
+        const auto before = _queueTuner.before();
+        const auto after = _queueTuner.after();
+        emit eventDriveQueueTuning(!(after == before),
+                                   QString("before: %1; after: %2").arg(before.toString(), after.toString()));
+    }
+    
+    if (!_writePartitions.isEmpty())
+        _startPartitionMapping();
+    else
+        _loadBlockMap();
+    if (!_blockMap)
+        _startBlockMapping();
+
+    return true;
+}
+
 #ifndef Q_OS_WIN
+bool DownloadThread::_zeroDeviceEnds()
+{
     // Zero out MBR using unified FileOperations
     QElapsedTimer mbrTimer;
     mbrTimer.start();
+    // Not _timer, which times the download running alongside
+    QElapsedTimer stepTimer;
     
     std::uint64_t knownsize = 0;
     rpi_imager::FileError sizeResult = _file->GetSize(knownsize);
@@ -473,7 +861,7 @@ bool DownloadThread::_openAndPrepareDevice()
     
     emit preparationStatusUpdate(tr("Zero'ing out first and last MB of drive..."));
     qDebug() << "Zeroing out first and last MB of drive";
-    _timer.start();
+    stepTimer.start();
 
     rpi_imager::FileError mbrWriteResult = _file->WriteSequential(emptyMB.data(), emptyMBSize);
     rpi_imager::FileError mbrFlushResult = (mbrWriteResult == rpi_imager::FileError::kSuccess) ? _file->Flush() : mbrWriteResult;
@@ -483,7 +871,7 @@ bool DownloadThread::_openAndPrepareDevice()
         emit error(_fileErrorToString(errorToReport, tr("preparing storage device")));
         return false;
     }
-    qint64 firstMBMs = _timer.elapsed();
+    qint64 firstMBMs = stepTimer.elapsed();
     qDebug() << "  First MB + flush took" << firstMBMs << "ms";
 
     // Zero out last part of card (may have GPT backup table)
@@ -496,7 +884,7 @@ bool DownloadThread::_openAndPrepareDevice()
     }
     else if (knownsize > emptyMBSize)
     {
-        _timer.restart();
+        stepTimer.restart();
         emit preparationStatusUpdate(tr("Zero'ing out end of drive..."));
         
         // Capture needed values for the lambda
@@ -543,7 +931,7 @@ bool DownloadThread::_openAndPrepareDevice()
                           "Please try a different storage device."));
             return false;
         }
-        qDebug() << "  Last MB + flush + sync took" << _timer.elapsed() << "ms";
+        qDebug() << "  Last MB + flush + sync took" << stepTimer.elapsed() << "ms";
     }
     _file->Seek(0);
     qint64 mbrTotalMs = mbrTimer.elapsed();
@@ -552,33 +940,85 @@ bool DownloadThread::_openAndPrepareDevice()
     // Emit MBR zeroing performance event with detailed breakdown
     QString mbrMetadata = QString("first_mb_ms: %1; last_mb_ms: %2; device_size_mb: %3")
         .arg(firstMBMs)
-        .arg(_timer.elapsed())  // Last MB timing (from last _timer.restart)
+        .arg(stepTimer.elapsed())  // Last MB timing (from last stepTimer.restart)
         .arg(knownsize / (1024 * 1024));
     emit eventDriveMbrZeroing(static_cast<quint32>(mbrTotalMs), true, mbrMetadata);
+
+    return true;
+}
 #endif
 
-#ifdef Q_OS_LINUX
-    _sectorsStart = _sectorsWritten();
+bool DownloadThread::_canPrepareDeviceInBackground()
+{
+    // Growing the ring buffers to their full size has to happen before any
+    // data flows through them
+    if (_debugIgnoreDeviceLimits)
+        return false;
+
+    // A write that resumes decides where the download starts, and that is
+    // only known once the device is open. Only a journal for this image can
+    // lead to one (see _prepareResume()).
+    _loadDeviceProfile();
+    if (!_resumeEnabled || _expectedHash.isEmpty() || !_bmapUrl.isEmpty() || !_fanOutDevices.isEmpty() ||
+        !_writePartitions.isEmpty() || _deviceProfileKey.isEmpty())
+    {
+        return true;
+    }
+    QSettings settings;
+    WriteJournal stored;
+    return !stored.load(settings, "writejournal/" + _deviceProfileKey.section('/', 1)) ||
+           !stored.matchesImage(_expectedHash);
+}
+
+bool DownloadThread::_prepareDeviceInBackground()
+{
+#ifdef Q_OS_WIN
+    DWORD oldMode;
+    if (!SetThreadErrorMode(SEM_FAILCRITICALERRORS | SEM_NOOPENFILEERRORBOX, &oldMode)) {
+        SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOOPENFILEERRORBOX);
+    }
 #endif
 
-    // Include I/O mode in drive open event for diagnostics
-    QString ioModeMetadata = QString("direct_io: %1; platform: %2")
-        .arg(_file->IsDirectIOEnabled() ? "yes" : "no")
-        .arg(SystemMemoryManager::instance().getPlatformName());
-    emit eventDriveOpen(static_cast<quint32>(openTimer.elapsed()), true, ioModeMetadata);
-    
-    // Emit detailed direct I/O attempt info for performance analysis
-    auto directIOInfo = _file->GetDirectIOInfo();
-    emit eventDirectIOAttempt(
-        directIOInfo.attempted,
-        directIOInfo.succeeded,
-        directIOInfo.currently_enabled,
-        directIOInfo.error_code,
-        QString::fromStdString(directIOInfo.error_message));
-    
+    QElapsedTimer prepareTimer;
+    prepareTimer.start();
+    if (!_openAndPrepareDevice())
+    {
+        // Already reported; stop the download that started alongside
+        cancelDownload();
+        return false;
+    }
+    _onDevicePrepared();
+
+    qDebug() << "Device ready after" << prepareTimer.elapsed() << "ms, with"
+             << _lastDlNow / (1024 * 1024) << "MB downloaded meanwhile";
     return true;
 }
 
+bool DownloadThread::_waitForDevice()
+{
+    if (!_devicePreparation.valid())
+        return true;
+
+    const std::shared_future<bool> preparation = _devicePreparation;
+    if (preparation.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        QElapsedTimer waitTimer;
+        waitTimer.start();
+        preparation.wait();
+        qDebug() << "Writing waited" << waitTimer.elapsed() << "ms for the device to be ready";
+    }
+    return preparation.get() && !_cancelled;
+}
+
+bool DownloadThread::_deviceReady() const
+{
+    if (!_devicePreparation.valid())
+        return true;
+
+    const std::shared_future<bool> preparation = _devicePreparation;
+    return preparation.wait_for(std::chrono::seconds(0)) == std::future_status::ready && preparation.get();
+}
+
 void DownloadThread::run()
 {
 #ifdef Q_OS_WIN
@@ -589,17 +1029,32 @@ void DownloadThread::run()
         SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOOPENFILEERRORBOX);
     }
 #endif
+    ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::Download);
 
     qDebug() << "Download thread starting. isImage?" << isImage() << "filename:" << _filename;
-    if (isImage() && !_openAndPrepareDevice())
+    if (_asyncCacheWriter)
+        _asyncCacheWriter->setFileHashProvided(_hashesCacheStream());
+    if (isImage() && _canPrepareDeviceInBackground())
     {
-        return;
+        // Unmounting, cleaning and zeroing the device can take many seconds,
+        // most of all on Windows. Download and decompress into the ring
+        // buffers meanwhile; the first write waits for the device in
+        // _waitForDevice(), and full ring buffers hold the download back.
+        qDebug() << "Preparing the device while the download starts";
+        _devicePreparation = std::async(std::launch::async, [this]() { return _prepareDeviceInBackground(); }).share();
     }
+    else
+    {
+        if (isImage() && !_openAndPrepareDevice())
+        {
+            return;
+        }
 
-    // Give subclasses a chance to adjust buffers now that debug flags and device
-    // limits are known.  Called after _openAndPrepareDevice() but before any
-    // ring-buffer access (which starts when curl_easy_perform delivers data).
-    _onDevicePrepared();
+        // Give subclasses a chance to adjust buffers now that debug flags and device
+        // limits are known.  Called after _openAndPrepareDevice() but before any
+        // ring-buffer access (which starts when curl_easy_perform delivers data).
+        _onDevicePrepared();
+    }
 
     // URL logged only on error
     if (_url.startsWith("file://") && _url.at(7) != '/')
@@ -608,6 +1063,13 @@ void DownloadThread::run()
         _url.replace("file://", "file:////");
         qDebug() << "Corrected UNC URL to:" << _url;
     }
+    _originUrl = _url;
+
+    // Holds back lower priority transfers (prefetch, telemetry) while this one runs
+    std::optional<BandwidthScheduler::Transfer> bandwidthTransfer;
+    _rateLimited = !_url.startsWith("file:");
+    if (_rateLimited)
+        bandwidthTransfer.emplace(BandwidthScheduler::Priority::Foreground);
 
     char errorBuf[CURL_ERROR_SIZE] = {0};
     _c = curl_easy_init();
@@ -627,11 +1089,16 @@ void DownloadThread::run()
     curl_easy_setopt(_c, CURLOPT_CONNECTTIMEOUT, 30);
     curl_easy_setopt(_c, CURLOPT_LOW_SPEED_TIME, 60);
     curl_easy_setopt(_c, CURLOPT_LOW_SPEED_LIMIT, 100);
+    CurlNetworkConfig::instance().applyShare(_c);
     
     // Enable HTTP/2 for HTTPS connections (falls back to HTTP/1.1 for plain HTTP)
     // Benefits: header compression, better connection utilization, multiplexing
     // Note: We track HTTP/2 failures and fall back to HTTP/1.1 if needed (see retry loop below)
-    curl_easy_setopt(_c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    // HTTP/3 instead if the user opted in and libcurl was built with it
+    const bool http3Requested = CurlNetworkConfig::instance().largeFileHttpVersion() == CURL_HTTP_VERSION_3;
+    curl_easy_setopt(_c, CURLOPT_HTTP_VERSION, http3Requested ? CURL_HTTP_VERSION_3 : CURL_HTTP_VERSION_2TLS);
+    if (http3Requested)
+        qDebug() << "Trying HTTP/3 for download";
     
     // Enable TCP keepalive to detect dead connections faster
     curl_easy_setopt(_c, CURLOPT_TCP_KEEPALIVE, 1L);
@@ -651,7 +1118,17 @@ void DownloadThread::run()
     const int MAX_HTTP2_FAILURES = 3;
     // One-shot flag: retry once with HTTP/1.1 on SSL connect failure (e.g. Schannel+HTTP/2 on Windows)
     bool http2SslFallback = false;
+    // One-shot flag: a QUIC failure after connecting drops to HTTP/2 for the rest of the download
+    bool http3Fallback = false;
     
+    // libcurl paces a single connection more smoothly than acquire() alone
+    const qint64 rateLimit = BandwidthScheduler::instance().limit();
+    if (_rateLimited && rateLimit > 0)
+    {
+        curl_easy_setopt(_c, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(rateLimit));
+        qDebug() << "Download rate limited to" << rateLimit / 1024 << "KB/s";
+    }
+
     if (_inputBufferSize)
         curl_easy_setopt(_c, CURLOPT_BUFFERSIZE, _inputBufferSize);
 
@@ -703,20 +1180,173 @@ void DownloadThread::run()
     }
 #endif
 
+    if (!_selectPeer())
+        _selectMirror();
+
+    if (isImage() && !_extractTotal && !_resumeSourceOffset && !_probeExtractTotal())
+    {
+        curl_easy_cleanup(_c);
+        DownloadThread::_onDownloadError(tr("Storage capacity is not large enough.\n\n"
+                                            "The image requires at least %1 of storage.")
+                                         .arg(QLocale().formattedDataSize(static_cast<qint64>(_extractTotal.load()))));
+        _closeFiles();
+        return;
+    }
+
+    // An uncompressed image can be downloaded from where the device left
+    // off, if the server takes range requests
+    if (_resumeSourceOffset)
+    {
+        QByteArray effectiveUrl;
+        curl_off_t contentLength = 0;
+        _probeRangeSupport(effectiveUrl, contentLength);
+        if (!_acceptRanges || contentLength <= static_cast<curl_off_t>(_resumeSourceOffset))
+        {
+            qDebug() << "Server does not take range requests, downloading from the start";
+            _resumeSourceOffset = 0;
+            _resumeFirstBlock.clear();
+        }
+        else if (!_replayResumedPrefix())
+        {
+            curl_easy_cleanup(_c);
+            if (!_cancelled)
+                DownloadThread::_onDownloadError(tr("Error reading back the data already written to the storage device."));
+            _closeFiles();
+            return;
+        }
+        else
+        {
+            _resumeAt(_resumeSourceOffset);
+            qDebug() << "Resuming download at offset" << static_cast<qint64>(_startOffset);
+        }
+    }
+    else if (!_prefetchedFile.isEmpty())
+    {
+        std::uint64_t offset = 0;
+        if (!_replayPrefetchedPrefix(offset))
+        {
+            curl_easy_cleanup(_c);
+            if (!_cancelled)
+                DownloadThread::_onDownloadError(tr("Error processing the data downloaded in the background."));
+            _closeFiles();
+            return;
+        }
+        if (offset)
+        {
+            _resumeAt(offset);
+            qDebug() << "Continuing background download at offset" << static_cast<qint64>(_startOffset);
+        }
+    }
+
     emit preparationStatusUpdate(tr("Starting download..."));
     // Minimal logging during normal operation
     _timer.start();
-    CURLcode ret = curl_easy_perform(_c);
+    const std::uint64_t firstOffset = _lastDlNow;
+    CURLcode ret;
+
+    QByteArray rangeUrl;
+    curl_off_t contentLength = 0;
+    int connections = _debugParallelDownload
+        ? SystemMemoryManager::instance().getOptimalDownloadConnections() : 1;
+    if (connections > 1 && !_startOffset && (_url.startsWith("http://") || _url.startsWith("https://"))
+        && _probeRangeSupport(rangeUrl, contentLength))
+    {
+        ret = _performParallelDownload(rangeUrl, contentLength, connections);
+        if (ret != CURLE_OK && !_cancelled && ret != CURLE_WRITE_ERROR)
+        {
+            // Carry on over a single connection from the first byte not yet delivered
+            qDebug() << "Parallel download failed:" << curl_easy_strerror(ret)
+                     << "- continuing with single connection from offset" << _lastDlNow.load();
+            _resumeAt(_lastDlNow);
+            ret = curl_easy_perform(_c);
+        }
+    }
+    else
+    {
+        ret = curl_easy_perform(_c);
+    }
+
+    auto peerFailed = [&]() {
+        return _url != _originUrl && !_cancelled && ret != CURLE_OK &&
+               ret != CURLE_WRITE_ERROR && ret != CURLE_ABORTED_BY_CALLBACK;
+    };
+    auto mirrorTooSlow = [&]() {
+        return ret == CURLE_ABORTED_BY_CALLBACK && _mirrorSwitchRequested && !_cancelled;
+    };
+    // Once data is flowing, failing to get through at all is most often the
+    // network dropping out for a moment (Wi-Fi roaming, a DHCP renewal, a
+    // NAT timeout). Keep reconnecting with backoff for a while rather than
+    // throwing away everything decompressed and written so far.
+    const int MAX_RECONNECT_ATTEMPTS = 8;
+    int reconnectAttempts = 0;
+    auto networkDropped = [&]() {
+        return _lastDlNow > firstOffset && !_cancelled && reconnectAttempts < MAX_RECONNECT_ATTEMPTS
+               && (ret == CURLE_COULDNT_CONNECT || ret == CURLE_COULDNT_RESOLVE_HOST
+                   || ret == CURLE_COULDNT_RESOLVE_PROXY || ret == CURLE_SEND_ERROR
+                   || ret == CURLE_RECV_ERROR || ret == CURLE_GOT_NOTHING
+                   || ret == CURLE_HTTP2 || ret == CURLE_HTTP2_STREAM);
+    };
 
     /* Deal with badly configured HTTP servers that terminate the connection quickly
        if connections stalls for some seconds while kernel commits buffers to slow SD card.
        And also reconnect if we detect from our end that transfer stalled for more than one minute */
-    while (ret == CURLE_PARTIAL_FILE || ret == CURLE_OPERATION_TIMEDOUT
+    while (mirrorTooSlow() || peerFailed() || ret == CURLE_PARTIAL_FILE || ret == CURLE_OPERATION_TIMEDOUT
            || (ret == CURLE_HTTP2_STREAM && _lastDlNow != _lastFailureOffset)
            || (ret == CURLE_HTTP2 && _lastDlNow != _lastFailureOffset)
            || (ret == CURLE_RECV_ERROR && _lastDlNow != _lastFailureOffset)
-           || (ret == CURLE_SSL_CONNECT_ERROR && !http2SslFallback) )
+           || (ret == CURLE_SSL_CONNECT_ERROR && !http2SslFallback)
+           || ((ret == CURLE_HTTP3 || ret == CURLE_QUIC_CONNECT_ERROR) && http3Requested && !http3Fallback)
+           || networkDropped() )
     {
+        if (mirrorTooSlow())
+        {
+            // The next fastest carries on from where this one left off
+            const MirrorRacer::Probe next = _mirrorFallbacks.takeFirst();
+            qDebug() << "Download from" << _url << "too slow - continuing from" << next.url
+                     << "at offset" << _lastDlNow.load();
+            emit eventNetworkRetry(0, QString("error: too slow; offset: %1 MB; mirror: %2")
+                .arg(_lastDlNow / (1024 * 1024)).arg(QString::fromLatin1(next.url)));
+            _url = next.url;
+            curl_easy_setopt(_c, CURLOPT_URL, _url.constData());
+            _mirrorSwitchRequested = false;
+            _mirrorSlowWindows = 0;
+            _mirrorWindowTimer.invalidate();
+            _mirrorExpectedBps = _mirrorFallbacks.isEmpty() ? 0 : next.bytesPerSecond;
+            _resumeAt(_lastDlNow);
+            ret = curl_easy_perform(_c);
+            continue;
+        }
+
+        if (peerFailed())
+        {
+            // The origin carries on from where the peer or mirror left off
+            _mirrorExpectedBps = 0;
+            const bool peer = _peerUrls.contains(_url);
+            qDebug() << "Download from" << (peer ? "peer" : "mirror") << "failed:" << curl_easy_strerror(ret)
+                     << "- continuing from the origin at offset" << _lastDlNow.load();
+            emit eventNetworkRetry(0, QString("error: %1; offset: %2 MB; %3: yes")
+                .arg(curl_easy_strerror(ret)).arg(_lastDlNow / (1024 * 1024)).arg(peer ? "peer" : "mirror"));
+            _url = _originUrl;
+            curl_easy_setopt(_c, CURLOPT_URL, _url.constData());
+            curl_easy_setopt(_c, CURLOPT_NOPROXY, nullptr);
+            _resumeAt(_lastDlNow);
+            ret = curl_easy_perform(_c);
+            continue;
+        }
+
+        if (ret == CURLE_HTTP3 || ret == CURLE_QUIC_CONNECT_ERROR)
+        {
+            // Not a network outage, so carry on over TCP straight away
+            qDebug() << "HTTP/3 failed:" << curl_easy_strerror(ret) << "- continuing over HTTP/2 at offset" << _lastDlNow.load();
+            emit eventNetworkRetry(0, QString("error: %1; offset: %2 MB; http3_fallback: yes")
+                .arg(curl_easy_strerror(ret)).arg(_lastDlNow / (1024 * 1024)));
+            curl_easy_setopt(_c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+            http3Fallback = true;
+            _resumeAt(_lastDlNow);
+            ret = curl_easy_perform(_c);
+            continue;
+        }
+
         time_t t = time(NULL);
         qDebug() << "HTTP connection lost. Error:" << curl_easy_strerror(ret) << "Time:" << t;
 
@@ -740,32 +1370,50 @@ void DownloadThread::run()
         }
 
         /* If last failure happened less than 5 seconds ago, something else may
-           be wrong. Sleep some time to prevent hammering server */
+           be wrong. Sleep some time to prevent hammering server. Attempts
+           that got nothing through back off further, up to 30 seconds. */
         quint32 sleepMs = 0;
-        if (t - _lastFailureTime < 5)
-        {
-            qDebug() << "Sleeping 5 seconds";
+        if (_lastDlNow != _lastFailureOffset)
+            reconnectAttempts = 0;
+        else
+            reconnectAttempts++;
+        if (reconnectAttempts > 0)
+            sleepMs = qMin(1000u << qMin(reconnectAttempts, 5), 30000u);
+        else if (t - _lastFailureTime < 5)
             sleepMs = 5000;
-            ::sleep(5);
+        if (sleepMs)
+        {
+            qDebug() << "Sleeping" << sleepMs / 1000 << "seconds";
+            QElapsedTimer slept;
+            slept.start();
+            while (!_cancelled && slept.elapsed() < sleepMs)
+                QThread::msleep(50);
+            if (_cancelled)
+            {
+                ret = CURLE_ABORTED_BY_CALLBACK;
+                break;
+            }
         }
         
         // Emit network retry event for performance tracking
-        QString retryMetadata = QString("error: %1; offset: %2 MB; http2_failures: %3")
+        QString retryMetadata = QString("error: %1; offset: %2 MB; http2_failures: %3; attempt: %4")
             .arg(curl_easy_strerror(ret))
             .arg(_lastDlNow / (1024 * 1024))
-            .arg(http2FailureCount);
+            .arg(http2FailureCount)
+            .arg(reconnectAttempts + 1);
         emit eventNetworkRetry(sleepMs, retryMetadata);
         
         _lastFailureTime = t;
 
-        _startOffset = _lastDlNow;
-        _lastFailureOffset = _lastDlNow;
-        curl_easy_setopt(_c, CURLOPT_RESUME_FROM_LARGE, _startOffset);
+        _resumeAt(_lastDlNow);
 
         ret = curl_easy_perform(_c);
     }
 
     curl_easy_cleanup(_c);
+    curl_slist_free_all(_resumeHeaders);
+    _resumeHeaders = nullptr;
+    bandwidthTransfer.reset();
 
     switch (ret)
     {
@@ -801,7 +1449,8 @@ void DownloadThread::run()
             
             // Emit connection stats for performance tracking
             // Times are in seconds from CURL, convert to ms for consistency
-            QString statsMetadata = QString("dns_ms: %1; connect_ms: %2; tls_ms: %3; ttfb_ms: %4; total_ms: %5; speed_kbps: %6; size_bytes: %7; http: %8")
+            // http3: "off" unless requested; "fallback" if the download ended up over TCP
+            QString statsMetadata = QString("dns_ms: %1; connect_ms: %2; tls_ms: %3; ttfb_ms: %4; total_ms: %5; speed_kbps: %6; size_bytes: %7; http: %8; source: %9; http3: %10")
                 .arg(static_cast<int>(dnsTime * 1000))
                 .arg(static_cast<int>(connectTime * 1000))
                 .arg(static_cast<int>(tlsTime * 1000))
@@ -809,7 +1458,9 @@ void DownloadThread::run()
                 .arg(static_cast<int>(totalTime * 1000))
                 .arg(static_cast<qint64>(downloadSpeed / 1024))
                 .arg(static_cast<qint64>(downloadSize))
-                .arg(versionStr);
+                .arg(versionStr)
+                .arg(_url == _originUrl ? "origin" : (_peerUrls.contains(_url) ? "peer" : "mirror"))
+                .arg(!http3Requested ? "off" : (httpVersion == CURL_HTTP_VERSION_3 ? "yes" : "fallback"));
             emit eventNetworkConnectionStats(statsMetadata);
             
             _onDownloadSuccess();
@@ -840,39 +1491,499 @@ void DownloadThread::run()
             if (curl_easy_getinfo(_c, CURLINFO_PRIMARY_IP, &ipstr) == CURLE_OK && ipstr && ipstr[0])
                 errorMsg += QString(" - Server IP: ")+ipstr;
 
-            _onDownloadError(tr("Error downloading: %1").arg(errorMsg));
+            if (ret == CURLE_RANGE_ERROR && _startOffset)
+                _onDownloadError(tr("The file changed on the server while it was being downloaded. Please try again."));
+            else
+                _onDownloadError(tr("Error downloading: %1").arg(errorMsg));
     }
+
+    // Leave the device alone before the thread counts as finished
+    if (_devicePreparation.valid())
+        _devicePreparation.wait();
 }
 
-size_t DownloadThread::_writeData(const char *buf, size_t len)
+struct DownloadThread::RangeSegment
 {
-    // Abort CURL cleanly if cancelled - returning 0 triggers CURLE_WRITE_ERROR
-    // which we handle by checking _cancelled before showing error dialogs
-    if (_cancelled)
-        return 0;
-
-    _writeCache(buf, len);
+    curl_off_t start = 0;
+    curl_off_t length = 0;
+    QByteArray data;
+    bool done = false;
+    int retries = 0;
+};
+
+struct DownloadThread::RangeTransfer
+{
+    CURL *easy = nullptr;
+    RangeSegment *segment = nullptr;
+    DownloadThread *thread = nullptr;
+    bool overrun = false;  // Server sent more than requested (ignored Range)
+};
 
-    if (!_filename.isEmpty())
-    {
-        return _writeFileZeroSkip(buf, len);
-    }
-    else
+bool DownloadThread::_probeRangeSupport(QByteArray &effectiveUrl, curl_off_t &contentLength)
+{
+    // HEAD request with the same options (proxy, CA bundle, IP version, ...)
+    CURL *probe = curl_easy_duphandle(_c);
+    if (!probe)
+        return false;
+    CurlNetworkConfig::instance().applyShare(probe);
+
+    _acceptRanges = false;
+    curl_easy_setopt(probe, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(probe, CURLOPT_NOPROGRESS, 1L);
+    CURLcode ret = curl_easy_perform(probe);
+
+    bool supported = false;
+    long responseCode = 0;
+    char *url = nullptr;
+    contentLength = 0;
+    if (ret == CURLE_OK
+        && curl_easy_getinfo(probe, CURLINFO_RESPONSE_CODE, &responseCode) == CURLE_OK && responseCode == 200
+        && curl_easy_getinfo(probe, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength) == CURLE_OK
+        && curl_easy_getinfo(probe, CURLINFO_EFFECTIVE_URL, &url) == CURLE_OK && url)
     {
-        _buf.append(buf, len);
-        return len;
+        effectiveUrl = url;
+        // Not worth the extra connections for small files
+        supported = _acceptRanges
+            && contentLength > static_cast<curl_off_t>(2 * SystemMemoryManager::DOWNLOAD_SEGMENT_SIZE);
     }
+    curl_easy_cleanup(probe);
+
+    qDebug() << "Range probe:" << curl_easy_strerror(ret) << "HTTP" << responseCode
+             << "Accept-Ranges:" << _acceptRanges << "length:" << static_cast<qint64>(contentLength)
+             << (supported ? "- using parallel download" : "- using single connection");
+    return supported;
 }
 
-void DownloadThread::_writeCache(const char *buf, size_t len)
+void DownloadThread::_resumeAt(std::uint64_t offset)
 {
-    if (!_cacheEnabled || _cancelled)
-        return;
+    _startOffset = static_cast<curl_off_t>(offset);
+    _transferDelivered = 0;
+    _lastDlNow = offset;
+    _lastFailureOffset = offset;
+    curl_easy_setopt(_c, CURLOPT_RESUME_FROM_LARGE, _startOffset);
+
+    // If-Range makes a server whose file has changed since answer with all of
+    // it, which libcurl refuses (CURLE_RANGE_ERROR) instead of appending the
+    // new file's tail to the old one's head. Weak ETags do not count for
+    // ranges, and another mirror's validators mean nothing here.
+    curl_slist_free_all(_resumeHeaders);
+    _resumeHeaders = nullptr;
+    QByteArray validator;
+    if (_validatorUrl == _url)
+        validator = !_responseEtag.isEmpty() && !_responseEtag.startsWith("W/") ? _responseEtag : _responseLastModified;
+    if (offset && !validator.isEmpty())
+        _resumeHeaders = curl_slist_append(nullptr, ("If-Range: " + validator).constData());
+    curl_easy_setopt(_c, CURLOPT_HTTPHEADER, _resumeHeaders);
+}
+
+/*
+ * Ask the peers whether they have the download (HEAD, short timeouts) and
+ * switch to the first that does. The data is checked against the expected
+ * hash as usual, wherever it came from.
+ */
+bool DownloadThread::_selectPeer()
+{
+    for (const QByteArray &peerUrl : std::as_const(_peerUrls))
+    {
+        CURL *probe = curl_easy_duphandle(_c);
+        if (!probe)
+            return false;
+
+        const QByteArray host = QUrl(QString::fromLatin1(peerUrl)).host().toLatin1();
+        curl_easy_setopt(probe, CURLOPT_URL, peerUrl.constData());
+        curl_easy_setopt(probe, CURLOPT_NOBODY, 1L);
+        curl_easy_setopt(probe, CURLOPT_NOPROGRESS, 1L);
+        curl_easy_setopt(probe, CURLOPT_HEADERFUNCTION, nullptr);
+        curl_easy_setopt(probe, CURLOPT_HEADERDATA, nullptr);
+        curl_easy_setopt(probe, CURLOPT_NOPROXY, host.constData());
+        curl_easy_setopt(probe, CURLOPT_CONNECTTIMEOUT_MS, 1000L);
+        curl_easy_setopt(probe, CURLOPT_TIMEOUT_MS, 3000L);
+        CURLcode ret = curl_easy_perform(probe);
+        long responseCode = 0;
+        curl_easy_getinfo(probe, CURLINFO_RESPONSE_CODE, &responseCode);
+        curl_easy_cleanup(probe);
+
+        qDebug() << "Peer" << peerUrl << ":" << curl_easy_strerror(ret) << "HTTP" << responseCode;
+        if (ret == CURLE_OK && responseCode == 200)
+        {
+            _url = peerUrl;
+            curl_easy_setopt(_c, CURLOPT_URL, _url.constData());
+            curl_easy_setopt(_c, CURLOPT_NOPROXY, host.constData());
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Race the origin against the mirrors from the OS list and those it lists
+ * in rel=duplicate Link headers, and switch to the fastest. The others
+ * that work are kept, fastest first, in case it slows down.
+ */
+void DownloadThread::_selectMirror()
+{
+    if (!_url.startsWith("http://") && !_url.startsWith("https://"))
+        return;
+
+    auto makeHandle = [this]() {
+        CURL *handle = curl_easy_duphandle(_c);
+        CurlNetworkConfig::instance().applyShare(handle);
+        return handle;
+    };
+
+    emit preparationStatusUpdate(tr("Finding the fastest download server..."));
+    QList<QByteArray> urls{_originUrl};
+    for (const QByteArray &url : std::as_const(_mirrorUrls))
+    {
+        if (!urls.contains(url) && urls.size() < MirrorRacer::kMaxCandidates)
+            urls.append(url);
+    }
+    QList<MirrorRacer::Probe> probes = MirrorRacer::race(urls, makeHandle);
+
+    // The redirector's mirror list comes with the origin's response
+    QList<QByteArray> listed;
+    for (const QByteArray &url : std::as_const(probes[0].duplicates))
+    {
+        if (!urls.contains(url) && !listed.contains(url) && url != probes[0].finalUrl &&
+            urls.size() + listed.size() < MirrorRacer::kMaxCandidates)
+            listed.append(url);
+    }
+    if (!listed.isEmpty() && !_cancelled)
+        probes += MirrorRacer::race(listed, makeHandle);
+
+    // Anything else is not the same file
+    const qint64 size = probes[0].totalSize;
+    for (MirrorRacer::Probe &probe : probes)
+    {
+        if (size > 0 && probe.totalSize != size)
+            probe.ok = false;
+    }
+
+    const int best = MirrorRacer::pickBest(probes, qMax<qint64>(size, 0));
+    if (best < 0 || _cancelled)
+        return;
+
+    for (int i = 0; i < probes.size(); i++)
+    {
+        if (i != best && probes[i].ok)
+            _mirrorFallbacks.append(probes[i]);
+    }
+    std::stable_sort(_mirrorFallbacks.begin(), _mirrorFallbacks.end(),
+                     [size](const MirrorRacer::Probe &a, const MirrorRacer::Probe &b) {
+                         return MirrorRacer::predictedMs(a, size) < MirrorRacer::predictedMs(b, size);
+                     });
+    _mirrorExpectedBps = _mirrorFallbacks.isEmpty() ? 0 : probes[best].bytesPerSecond;
+
+    if (best > 0)
+    {
+        qDebug() << "Downloading from mirror" << probes[best].url << "instead of" << _originUrl;
+        _url = probes[best].url;
+        curl_easy_setopt(_c, CURLOPT_URL, _url.constData());
+    }
+}
+
+/*
+ * Custom URLs come without an extract size from the OS list; read it from
+ * the image's own metadata instead, so progress and ETA use the real size
+ * from the start. Returns false if the image does not fit the device.
+ */
+bool DownloadThread::_probeExtractTotal()
+{
+    if (!_url.startsWith("http://") && !_url.startsWith("https://"))
+        return true;
+
+    auto makeHandle = [this]() {
+        CURL *handle = curl_easy_duphandle(_c);
+        CurlNetworkConfig::instance().applyShare(handle);
+        return handle;
+    };
+
+    QElapsedTimer probeTimer;
+    probeTimer.start();
+    const quint64 size = RemoteSizeProbe::probe(_url, makeHandle);
+    qDebug() << "Size probe:" << (size ? QByteArray::number(size) : QByteArray("unknown"))
+             << "bytes uncompressed, in" << probeTimer.elapsed() << "ms";
+    if (!size)
+        return true;
+    _extractTotal = size;
+
+    // Until now only the OS list size could be checked against the device
+    std::uint64_t deviceSize = 0;
+    return !_deviceReady() || !_file || _file->GetSize(deviceSize) != rpi_imager::FileError::kSuccess
+        || !deviceSize || size <= deviceSize;
+}
+
+/*
+ * Called from the progress callback. Asks for the next mirror (by failing
+ * the transfer) if throughput over the network time of the last windows
+ * was well below the prediction. Windows in which the pipeline held the
+ * download back most of the time do not count.
+ */
+bool DownloadThread::_checkMirrorThroughput()
+{
+    if (!_mirrorExpectedBps || _mirrorFallbacks.isEmpty())
+        return true;
+
+    if (!_mirrorWindowTimer.isValid())
+    {
+        _mirrorWindowTimer.start();
+        _mirrorWindowBytes = _lastDlNow;
+        _mirrorWindowBlockedNs = _writeBlockedNs;
+        return true;
+    }
+
+    const qint64 elapsedMs = _mirrorWindowTimer.elapsed();
+    if (elapsedMs < MIRROR_WINDOW_MS)
+        return true;
+
+    const qint64 networkMs = elapsedMs - (_writeBlockedNs - _mirrorWindowBlockedNs) / 1000000;
+    const qint64 bytes = static_cast<qint64>(_lastDlNow - _mirrorWindowBytes);
+    _mirrorWindowTimer.restart();
+    _mirrorWindowBytes = _lastDlNow;
+    _mirrorWindowBlockedNs = _writeBlockedNs;
+
+    if (networkMs < elapsedMs / 2)
+    {
+        _mirrorSlowWindows = 0;
+        return true;
+    }
+
+    const qint64 bytesPerSecond = bytes * 1000 / networkMs;
+    _mirrorSlowWindows = bytesPerSecond * MIRROR_SLOW_FACTOR < _mirrorExpectedBps ? _mirrorSlowWindows + 1 : 0;
+    if (_mirrorSlowWindows < MIRROR_SLOW_WINDOWS)
+        return true;
+
+    qDebug() << "Download at" << bytesPerSecond / 1024 << "KB/s, predicted" << _mirrorExpectedBps / 1024 << "KB/s";
+    _mirrorSwitchRequested = true;
+    return false;
+}
+
+size_t DownloadThread::_curl_range_write_callback(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    auto *transfer = static_cast<RangeTransfer *>(userdata);
+    size_t len = size * nmemb;
+    RangeSegment *segment = transfer->segment;
+
+    if (transfer->thread->_cancelled)
+        return 0;
+
+    // Sleeping here holds up every connection in the multi handle, which
+    // paces them together to the shared limit
+    if (transfer->thread->_rateLimited)
+        BandwidthScheduler::instance().acquire(BandwidthScheduler::Priority::Foreground, static_cast<qint64>(len));
+
+    if (segment->data.size() + static_cast<qsizetype>(len) > segment->length)
+    {
+        transfer->overrun = true;
+        return 0;
+    }
+
+    segment->data.append(ptr, static_cast<qsizetype>(len));
+    return len;
+}
+
+CURLcode DownloadThread::_performParallelDownload(const QByteArray &url, curl_off_t contentLength, int connections)
+{
+    const curl_off_t segmentSize = static_cast<curl_off_t>(SystemMemoryManager::DOWNLOAD_SEGMENT_SIZE);
+    const int segmentCount = static_cast<int>((contentLength + segmentSize - 1) / segmentSize);
+    // Segments buffered ahead of the next one to be delivered (bounds memory use)
+    const int window = connections * 2;
+    constexpr int MAX_SEGMENT_RETRIES = 3;
+
+    qDebug() << "Parallel download:" << connections << "connections," << segmentCount
+             << "segments of" << segmentSize / (1024 * 1024) << "MB";
+
+    std::vector<RangeSegment> segments(static_cast<size_t>(segmentCount));
+    for (int i = 0; i < segmentCount; i++)
+    {
+        segments[i].start = i * segmentSize;
+        segments[i].length = qMin(segmentSize, contentLength - segments[i].start);
+    }
+
+    CURLM *multi = curl_multi_init();
+    std::vector<RangeTransfer> transfers(static_cast<size_t>(connections));
+    int nextSegment = 0;
+    int deliverIndex = 0;
+    curl_off_t delivered = 0;
+
+    auto startTransfer = [&](RangeTransfer &transfer, RangeSegment *segment) {
+        if (!transfer.easy)
+        {
+            transfer.easy = curl_easy_duphandle(_c);
+            CurlNetworkConfig::instance().applyShare(transfer.easy);
+            transfer.thread = this;
+            curl_easy_setopt(transfer.easy, CURLOPT_URL, url.constData());
+            curl_easy_setopt(transfer.easy, CURLOPT_WRITEFUNCTION, &DownloadThread::_curl_range_write_callback);
+            curl_easy_setopt(transfer.easy, CURLOPT_WRITEDATA, &transfer);
+            curl_easy_setopt(transfer.easy, CURLOPT_NOPROGRESS, 1L);
+            curl_easy_setopt(transfer.easy, CURLOPT_RESUME_FROM_LARGE, static_cast<curl_off_t>(0));
+            curl_easy_setopt(transfer.easy, CURLOPT_PRIVATE, &transfer);
+        }
+        else
+        {
+            curl_multi_remove_handle(multi, transfer.easy);
+        }
+        // Resume within the segment if an earlier attempt delivered part of it
+        curl_off_t from = segment->start + segment->data.size();
+        QByteArray range = QByteArray::number(static_cast<qint64>(from)) + "-"
+                         + QByteArray::number(static_cast<qint64>(segment->start + segment->length - 1));
+        curl_easy_setopt(transfer.easy, CURLOPT_RANGE, range.constData());
+        transfer.segment = segment;
+        transfer.overrun = false;
+        curl_multi_add_handle(multi, transfer.easy);
+    };
+
+    auto assignIdle = [&]() {
+        for (auto &transfer : transfers)
+        {
+            if (transfer.segment)
+                continue;
+            if (nextSegment >= segmentCount || nextSegment >= deliverIndex + window)
+                break;
+            segments[nextSegment].data.reserve(static_cast<qsizetype>(segments[nextSegment].length));
+            startTransfer(transfer, &segments[nextSegment]);
+            nextSegment++;
+        }
+    };
+
+    CURLcode result = CURLE_OK;
+    assignIdle();
+
+    while (deliverIndex < segmentCount && result == CURLE_OK)
+    {
+        if (_cancelled)
+        {
+            result = CURLE_ABORTED_BY_CALLBACK;
+            break;
+        }
+
+        int running = 0;
+        CURLMcode mc = curl_multi_perform(multi, &running);
+        if (mc == CURLM_OK)
+            mc = curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+        if (mc != CURLM_OK)
+        {
+            qDebug() << "Parallel download: multi error" << curl_multi_strerror(mc);
+            result = CURLE_RECV_ERROR;
+            break;
+        }
+
+        int msgsLeft = 0;
+        while (CURLMsg *msg = curl_multi_info_read(multi, &msgsLeft))
+        {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            RangeTransfer *transfer = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char **>(&transfer));
+            RangeSegment *segment = transfer->segment;
+            long responseCode = 0;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &responseCode);
+
+            if (msg->data.result == CURLE_OK && responseCode == 206
+                && segment->data.size() == segment->length)
+            {
+                segment->done = true;
+                transfer->segment = nullptr;
+            }
+            else if (transfer->overrun || (msg->data.result == CURLE_OK && responseCode != 206))
+            {
+                // Server ignored the Range header despite advertising support
+                qDebug() << "Parallel download: server did not honour range request (HTTP" << responseCode << ")";
+                result = CURLE_RANGE_ERROR;
+            }
+            else if (segment->retries++ < MAX_SEGMENT_RETRIES && !_cancelled)
+            {
+                qDebug() << "Parallel download: segment at" << static_cast<qint64>(segment->start)
+                         << "failed:" << curl_easy_strerror(msg->data.result) << "- retrying";
+                emit eventNetworkRetry(0, QString("error: %1; offset: %2 MB; parallel: yes")
+                    .arg(curl_easy_strerror(msg->data.result))
+                    .arg(segment->start / (1024 * 1024)));
+                startTransfer(*transfer, segment);
+            }
+            else
+            {
+                result = (msg->data.result != CURLE_OK) ? msg->data.result : CURLE_PARTIAL_FILE;
+            }
+        }
+
+        // Hand completed segments to the consumer strictly in order
+        while (result == CURLE_OK && deliverIndex < segmentCount && segments[deliverIndex].done)
+        {
+            RangeSegment &segment = segments[deliverIndex];
+            size_t len = static_cast<size_t>(segment.data.size());
+            if (_writeData(segment.data.constData(), len) != len)
+            {
+                result = CURLE_WRITE_ERROR;
+                break;
+            }
+            delivered += segment.length;
+            segment.data = QByteArray();
+            deliverIndex++;
+        }
+
+        // Progress counts delivered bytes plus whatever is buffered so far.
+        // _lastDlNow is also the resume point should we fall back to a single
+        // connection, so only count data that has actually been delivered there.
+        _lastDlTotal = contentLength;
+        _lastDlNow = delivered;
+
+        if (result == CURLE_OK)
+            assignIdle();
+    }
+
+    for (auto &transfer : transfers)
+    {
+        if (transfer.easy)
+        {
+            curl_multi_remove_handle(multi, transfer.easy);
+            curl_easy_cleanup(transfer.easy);
+        }
+    }
+    curl_multi_cleanup(multi);
+
+    qDebug() << "Parallel download finished:" << curl_easy_strerror(result)
+             << "delivered" << static_cast<qint64>(delivered) << "of" << static_cast<qint64>(contentLength) << "bytes";
+    return result;
+}
+
+size_t DownloadThread::_writeData(const char *buf, size_t len)
+{
+    // Abort CURL cleanly if cancelled - returning 0 triggers CURLE_WRITE_ERROR
+    // which we handle by checking _cancelled before showing error dialogs
+    if (_cancelled)
+        return 0;
+
+    _writeCache(buf, len);
+
+    if (!_filename.isEmpty())
+    {
+        if (!_waitForDevice())
+            return 0;
+        return _blockMap ? _writeFileSparse(buf, len) : _writeFileZeroSkip(buf, len);
+    }
+    else
+    {
+        _buf.append(buf, len);
+        return len;
+    }
+}
+
+void DownloadThread::_writeCache(const char *buf, size_t len)
+{
+    if (_cacheWritable() && !_asyncCacheWriter->write(buf, len))
+        _onCacheWriteRejected();
+}
+
+bool DownloadThread::_cacheWritable()
+{
+    if (!_cacheEnabled || _cancelled)
+        return false;
 
     // Check if async writer exists and is still healthy
     if (!_asyncCacheWriter) {
         _cacheEnabled = false;
-        return;
+        return false;
     }
     
     // Check for async errors that may have occurred in the writer thread
@@ -882,25 +1993,26 @@ void DownloadThread::_writeCache(const char *buf, size_t len)
         // Don't call cancel() here - it can block for 5+ seconds waiting for the
         // writer thread to stop, which would stall the curl download callback.
         // Cleanup will happen in _closeFiles() or destructor.
-        return;
+        return false;
     }
 
     // Use async cache writer for non-blocking I/O
-    if (_asyncCacheWriter->isActive()) {
-        if (!_asyncCacheWriter->write(buf, len)) {
-            // write() returns false on backpressure timeout or error
-            if (_asyncCacheWriter->wasDisabledDueToBackpressure()) {
-                qDebug() << "Cache I/O too slow (backpressure). Disabling caching to avoid blocking download.";
-            } else {
-                qDebug() << "Async cache writer failed. Disabling caching.";
-            }
-            _cacheEnabled = false;
-            // Don't call cancel() here - it can block for 5+ seconds waiting for the
-            // writer thread to stop, which would stall the curl download callback.
-            // The cache writer will detect _hasError and clean up on its own, or
-            // cleanup will happen in _closeFiles() when the download completes.
-        }
+    return _asyncCacheWriter->isActive();
+}
+
+void DownloadThread::_onCacheWriteRejected()
+{
+    // write() returns false on backpressure timeout or error
+    if (_asyncCacheWriter->wasDisabledDueToBackpressure()) {
+        qDebug() << "Cache I/O too slow (backpressure). Disabling caching to avoid blocking download.";
+    } else {
+        qDebug() << "Async cache writer failed. Disabling caching.";
     }
+    _cacheEnabled = false;
+    // Don't call cancel() here - it can block for 5+ seconds waiting for the
+    // writer thread to stop, which would stall the curl download callback.
+    // The cache writer will detect _hasError and clean up on its own, or
+    // cleanup will happen in _closeFiles() when the download completes.
 }
 
 void DownloadThread::setCacheFile(const QString &filename, qint64 filesize)
@@ -919,6 +2031,11 @@ void DownloadThread::setCacheFile(const QString &filename, qint64 filesize)
                 // Note: Don't cancel here - we're in a different thread context
                 // The writer thread will clean up on its own
             }, Qt::QueuedConnection);
+
+    // A slow cache disk leaves gaps, fetched again once the download is done
+    _asyncCacheWriter->setGapFiller([this](qint64 offset, char *buf, qint64 len) {
+        return _fetchCacheRange(offset, buf, len);
+    });
     
     if (_asyncCacheWriter->open(filename, filesize))
     {
@@ -932,9 +2049,164 @@ void DownloadThread::setCacheFile(const QString &filename, qint64 filesize)
     }
 }
 
+void DownloadThread::setImageCacheFile(const QString &filename, qint64 imageSize)
+{
+    _imageCacheFilename = filename;
+    _imageCacheWriter = std::make_unique<AsyncCacheWriter>(this);
+    _imageCacheWriter->setSparse(true);
+    // A slow cache disk leaves gaps, read back from the device at the end
+    _imageCacheWriter->setGapFiller([this](qint64 offset, char *buf, qint64 len) {
+        return _readImageCacheRange(offset, buf, len);
+    });
+
+    if (_imageCacheWriter->open(filename, imageSize))
+    {
+        qDebug() << "Decompressed image cache initialized for" << filename;
+    }
+    else
+    {
+        qDebug() << "Error opening image cache file for writing. Not caching decompressed image.";
+        _imageCacheWriter.reset();
+    }
+}
+
+void DownloadThread::_writeImageCache(const char *buf, size_t len)
+{
+    // The held-back boot partition was cached as it arrived, before customisation
+    if (!_imageCacheWriter || _cancelled || _bootShadowReplaying)
+        return;
+
+    // The writer leaves gaps if the cache disk cannot keep up, and
+    // disables itself on errors; the write to the device carries on regardless
+    if (_imageCacheWriter->isActive() && !_imageCacheWriter->write(buf, len))
+        qDebug() << "Decompressed image cache disabled (cache I/O error)";
+}
+
+void DownloadThread::_finishImageCache(const QByteArray &imageHash)
+{
+    if (!_imageCacheWriter)
+        return;
+
+    if (!_imageCacheWriter->isActive() || _expectedHash != imageHash)
+    {
+        _imageCacheWriter->cancel();
+        return;
+    }
+
+    _imageCacheWriter->finish();
+    if (_imageCacheWriter->hasError())
+        return;
+    if (_imageCacheWriter->hash() != imageHash)
+    {
+        // Should not happen, as both hash the same stream
+        qDebug() << "Decompressed image cache hash mismatch, discarding" << _imageCacheFilename;
+        QFile::remove(_imageCacheFilename);
+        return;
+    }
+
+    qDebug() << "Decompressed image cached:" << _imageCacheFilename;
+    emit imageCacheFileReady(_imageCacheFilename, imageHash);
+}
+
+bool DownloadThread::_fetchCacheRange(qint64 offset, char *buf, qint64 len)
+{
+    if (_cancelled)
+        return false;
+
+    struct Target {
+        char *buf;
+        qint64 len;
+        qint64 received;
+    } target{buf, len, 0};
+
+    // Synchronous, like the bmap fetch; only used for what the cache disk
+    // could not keep up with
+    QByteArray range = QByteArray::number(offset) + "-" + QByteArray::number(offset + len - 1);
+    CURLcode res = CURLE_FAILED_INIT;
+    long httpCode = 0;
+    CURL *curl = curl_easy_init();
+    if (curl)
+    {
+        auto writeCallback = +[](char *ptr, size_t size, size_t nmemb, void *userdata) -> size_t {
+            auto *t = static_cast<Target *>(userdata);
+            const qint64 n = static_cast<qint64>(size * nmemb);
+            if (n > t->len - t->received)
+                return 0;   // Range not honoured
+            ::memcpy(t->buf + t->received, ptr, n);
+            t->received += n;
+            return size * nmemb;
+        };
+        curl_easy_setopt(curl, CURLOPT_URL, _url.constData());
+        curl_easy_setopt(curl, CURLOPT_RANGE, range.constData());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &target);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 60L);
+        CurlNetworkConfig::instance().applyShare(curl);
+        if (!_useragent.isEmpty())
+            curl_easy_setopt(curl, CURLOPT_USERAGENT, _useragent.constData());
+        if (!_proxy.isEmpty())
+            curl_easy_setopt(curl, CURLOPT_PROXY, _proxy.constData());
+        res = curl_easy_perform(curl);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+        curl_easy_cleanup(curl);
+    }
+    if (res != CURLE_OK || httpCode != 206 || target.received != len)
+    {
+        qDebug() << "Cache gap: range" << range << "fetch failed:" << curl_easy_strerror(res) << httpCode;
+        return false;
+    }
+    return true;
+}
+
+bool DownloadThread::_readImageCacheRange(qint64 offset, char *buf, qint64 len)
+{
+    // Only ranges the device holds as they were in the image: everything
+    // but the first block (still in memory, so taken from there), the
+    // held-back boot partition, and whatever a block map left unwritten.
+    // Called after the writes are drained; the image hash check in
+    // _finishImageCache() catches anything else.
+    if (_cancelled || !_file || _blockMap)
+        return false;
+    if (_bootShadow && static_cast<std::uint64_t>(offset + len) > _bootShadow->start()
+        && static_cast<std::uint64_t>(offset) < _bootShadow->end())
+        return false;
+
+    qint64 pos = 0;
+    if (_firstBlock && offset < static_cast<qint64>(_firstBlockSize))
+    {
+        pos = std::min(len, static_cast<qint64>(_firstBlockSize) - offset);
+        ::memcpy(buf, _firstBlock + offset, pos);
+    }
+    if (pos == len)
+        return true;
+
+    // Direct I/O needs whole aligned blocks
+    const qint64 start = (offset + pos) & ~qint64(4095);
+    const qint64 end = (offset + len + 4095) & ~qint64(4095);
+    BufferPool::Buffer mem = BufferPool::instance().acquire(end - start, 4096, VERIFY_BUFFER_WAIT_MS);
+    std::size_t bytesRead = 0;
+    if (!mem || _file->ReadAtOffset(start, reinterpret_cast<std::uint8_t *>(mem.data()), end - start, bytesRead)
+                    != rpi_imager::FileError::kSuccess
+        || static_cast<qint64>(bytesRead) < offset + len - start)
+        return false;
+    ::memcpy(buf + pos, mem.data() + (offset + pos - start), len - pos);
+    return true;
+}
+
 void DownloadThread::_hashData(const char *buf, size_t len)
 {
-    _writehash.addData(buf, len);
+    // _writehash is of the image as downloaded; a customised boot partition
+    // was added to it when it was held back
+    if (!_bootShadowReplaying)
+        _writehash.addData(buf, len);
+    if (_verifyEnabled)
+        _writeTreeHash.addData(buf, len);
+    if (!_journalKey.isEmpty())
+        _journal.addData(buf, len);
+    if (_sampledVerify)
+        _sampledVerify->addData(buf, len);
 }
 
 /*
@@ -943,21 +2215,41 @@ void DownloadThread::_hashData(const char *buf, size_t len)
  * through to _writeFile().  This avoids transferring and writing GBs of
  * zeros for typical OS images where most of the disk is empty.
  *
- * Only enabled when there is no expected hash for post-write verification.
- * When verification is active, skipped (non-written) zero regions would
- * still contain stale data from the previous image, causing a hash mismatch.
+ * Skipped (non-written) zero regions still contain stale data from the
+ * previous image, so plain skipping is only done when there is no
+ * expected hash for post-write verification.
+ *
+ * If the device can clear ranges itself (FileOperations::ZeroRange(),
+ * e.g. BLKZEROOUT or an SD card erase), zero runs of at least
+ * kMinZeroRangeBytes are cleared that way instead, with or without
+ * verification.  Those runs are hashed like written data and recorded in
+ * _zeroedRanges for _verify().
  */
 size_t DownloadThread::_writeFileZeroSkip(const char *buf, size_t len)
 {
+    if (!_waitForDevice())
+        return 0;
+
     constexpr size_t BLK = fastboot::SPARSE_BLK_SZ;  // 4096
+    // Shorter runs are not worth an ioctl each
+    constexpr size_t kMinZeroRangeBytes = 1024 * 1024;
 
-    // First block hasn't been captured yet — pass through unconditionally
-    if (!_firstBlock)
+    size_t shadowed;
+    if (_interceptBootPartition(buf, len, nullptr, [this](const char *b, size_t l) { return _writeFileZeroSkip(b, l); }, shadowed))
+        return shadowed;
+
+    _writeImageCache(buf, len);
+
+    // First block hasn't been captured yet — pass through unconditionally.
+    // Likewise for data a resumed write or a clone already has on the device.
+    if (!_firstBlock || _file->Tell() < qMax(_resumeOffset, _clonedUpTo))
         return _writeFile(buf, len);
 
     // When hash verification is enabled, we must write every byte so the
-    // read-back matches.  Fall through to the normal write path.
-    if (!_expectedHash.isEmpty())
+    // read-back matches, unless the device can zero the range itself.
+    const bool mustWriteZeros = !_expectedHash.isEmpty();
+    const bool zeroRange = _zeroRangeUsable();
+    if (mustWriteZeros && !zeroRange)
         return _writeFile(buf, len);
 
     const auto* p = reinterpret_cast<const uint8_t*>(buf);
@@ -977,23 +2269,40 @@ size_t DownloadThread::_writeFileZeroSkip(const char *buf, size_t len)
         // Skip the unaligned prefix — we'll write it as part of the non-zero region
         while (pos + BLK <= len) {
             if (fastboot::isBlockZero(p + pos)) {
-                // Found a zero block. Write everything before it.
-                if (pos > nonZeroStart) {
-                    size_t writeLen = pos - nonZeroStart;
+                // Count consecutive zero blocks
+                size_t zeroStart = pos;
+                while (pos + BLK <= len && fastboot::isBlockZero(p + pos))
+                    pos += BLK;
+                size_t zeroLen = pos - zeroStart;
+
+                const bool clearRun = zeroRange && zeroLen >= kMinZeroRangeBytes;
+                if (!clearRun && mustWriteZeros)
+                    continue;  // Too short to clear; written with the data around it
+
+                // Write everything before the zero run
+                if (zeroStart > nonZeroStart) {
+                    size_t writeLen = zeroStart - nonZeroStart;
                     size_t written = _writeFile(buf + nonZeroStart, writeLen);
                     if (written != writeLen)
                         return 0;
                     totalProcessed += written;
                 }
 
-                // Count consecutive zero blocks
-                size_t zeroStart = pos;
-                while (pos + BLK <= len && fastboot::isBlockZero(p + pos))
-                    pos += BLK;
+                const std::uint64_t zeroOffset = _file->Tell();
+                if (clearRun && _zeroRange(zeroOffset, buf + zeroStart, zeroLen)) {
+                    // Cleared on the device; move past it
+                } else if (mustWriteZeros) {
+                    // Clearing failed; write the zeros instead
+                    size_t written = _writeFile(buf + zeroStart, zeroLen);
+                    if (written != zeroLen)
+                        return 0;
+                    totalProcessed += written;
+                    nonZeroStart = pos;
+                    continue;
+                }
 
                 // Seek past the zero region
-                size_t zeroLen = pos - zeroStart;
-                if (_file->Seek(_file->Tell() + zeroLen) != rpi_imager::FileError::kSuccess)
+                if (_file->Seek(zeroOffset + zeroLen) != rpi_imager::FileError::kSuccess)
                     return 0;
                 totalProcessed += zeroLen;
                 _bytesWritten += zeroLen;
@@ -1017,24 +2326,490 @@ size_t DownloadThread::_writeFileZeroSkip(const char *buf, size_t len)
     return totalProcessed;
 }
 
-size_t DownloadThread::_writeFile(const char *buf, size_t len, WriteCompleteCallback onComplete)
+bool DownloadThread::_zeroRangeUsable() const
 {
-    if (_cancelled) {
-        if (onComplete) onComplete();
+    // Additional devices only receive data that goes through _writeFile()
+    return !_zeroRangeFailed && _fanOutTargets.empty() &&
+           _file->GetZeroRangeMethod() != rpi_imager::FileOperations::ZeroRangeMethod::kNone;
+}
+
+/*
+ * Image file targets: have the file system copy the source image file into
+ * the target, sharing its extents where it can (reflink), before any data
+ * is written. The image still streams past to be hashed, but _writeFile()
+ * treats everything up to _clonedUpTo like resumed data and writes nothing.
+ * Only the first block is written again at the end, as for any write.
+ *
+ * Not for writes that change the data or send it elsewhere as well.
+ */
+bool DownloadThread::_cloneFromFile(int fd, std::uint64_t size)
+{
+    if (!_file->IsRegularFile() || !_fanOutTargets.empty() || !_journalKey.isEmpty() || _resumeOffset ||
+        !_writePartitions.isEmpty() || _file->Tell() != 0 || _cancelled)
+        return false;
+
+    QElapsedTimer cloneTimer;
+    cloneTimer.start();
+    if (_file->CloneFrom(fd, size) != rpi_imager::FileError::kSuccess)
+    {
+        qDebug() << "Image file: the file system cannot copy the source, writing it";
+        return false;
+    }
+    qDebug() << "Image file: copied" << size / (1024 * 1024) << "MB by the file system in" << cloneTimer.elapsed() << "ms";
+    _clonedUpTo = size;
+    return true;
+}
+
+/*
+ * Kernel copy of an image whose hash is already known to match the
+ * expected one (a decompressed image cache hit): the image goes from the
+ * source file to the device through a pipe (FileOperations::SpliceFrom())
+ * instead of through buffers in this process, and is not hashed as it is
+ * written. Verification still needs the tree hash of the image, which a
+ * second thread reads the source for meanwhile. Only the first block is
+ * captured as usual and written at the end.
+ *
+ * Returns false, with nothing written, where this does not apply or the
+ * device does not take spliced writes; the image is then written as usual.
+ * Otherwise the write has completed, failed or been cancelled, and any
+ * error has been reported.
+ */
+bool DownloadThread::_spliceFromFile(int fd, std::uint64_t size, const std::function<void()> &progress)
+{
+#ifdef Q_OS_LINUX
+    static constexpr size_t kFirstBlockSize = 1024 * 1024;
+    static constexpr std::uint64_t kChunkSize = 8 * 1024 * 1024;  // Between progress updates
+    static constexpr size_t kHashChunkSize = 4 * 1024 * 1024;
+
+    // Anything that needs to see the data as it is written, or changes it,
+    // takes the usual path. Sampled and bmap verification hash the data as
+    // it passes; full verification only needs the tree hash.
+    if (_expectedHash.isEmpty() || size <= kFirstBlockSize + kChunkSize || size % 4096 || _firstBlock ||
+        !_fanOutTargets.empty() || !_journalKey.isEmpty() || _resumeOffset || !_writePartitions.isEmpty() ||
+        _clonedUpTo || _blockMap || _streamBlockMapper || _imageCacheWriter || _deltaActive ||
+        (_verifyEnabled && _verifyCoverage < 100.0) || _cancelled)
+        return false;
+    if (!_waitForDevice() || _file->Tell() != 0)
+        return false;
+
+    QElapsedTimer spliceTimer;
+    spliceTimer.start();
+
+    // The first chunk after the first block shows whether the device takes
+    // spliced writes; whatever it left there is overwritten by the usual path
+    if (_file->Seek(kFirstBlockSize) != rpi_imager::FileError::kSuccess ||
+        _file->SpliceFrom(fd, kFirstBlockSize, kChunkSize) != rpi_imager::FileError::kSuccess)
+    {
+        qDebug() << "Splice: the device does not take spliced writes, writing the image";
+        _file->Seek(0);
+        return false;
+    }
+
+    char *first = static_cast<char *>(qMallocAligned(kFirstBlockSize, 4096));
+    const bool firstRead = first && ::pread(fd, first, kFirstBlockSize, 0) == static_cast<ssize_t>(kFirstBlockSize);
+    const bool firstCaptured = firstRead && _writeFile(first, kFirstBlockSize) == kFirstBlockSize;
+    qFreeAligned(first);
+    if (!firstRead)
+    {
+        _onDownloadError(tr("Error reading from image file"));
+        return true;
+    }
+    if (!firstCaptured)
+    {
+        _onWriteError();
+        return true;
+    }
+
+    // The first block has been hashed; the rest of the tree hash follows in order
+    std::atomic<bool> hashReadError{false};
+    std::thread treeHasher;
+    if (_verifyEnabled)
+    {
+        treeHasher = std::thread([this, fd, size, &hashReadError]() {
+            char *buf = static_cast<char *>(qMallocAligned(kHashChunkSize, 4096));
+            for (std::uint64_t offset = kFirstBlockSize; buf && offset < size && !_cancelled; offset += kHashChunkSize)
+            {
+                const size_t len = static_cast<size_t>(qMin<std::uint64_t>(kHashChunkSize, size - offset));
+                if (::pread(fd, buf, len, static_cast<off_t>(offset)) != static_cast<ssize_t>(len))
+                {
+                    hashReadError = true;
+                    break;
+                }
+                _writeTreeHash.addData(buf, len);
+            }
+            hashReadError = hashReadError || !buf;
+            qFreeAligned(buf);
+        });
+    }
+
+    if (!_writePhaseTimer.isValid())
+        _writePhaseTimer.start();
+    _file->Seek(kFirstBlockSize + kChunkSize);
+    _bytesWritten += kChunkSize;
+    _lastDlNow = kFirstBlockSize + kChunkSize;
+    progress();
+
+    rpi_imager::FileError result = rpi_imager::FileError::kSuccess;
+    for (std::uint64_t offset = kFirstBlockSize + kChunkSize; offset < size && !_cancelled; offset += kChunkSize)
+    {
+        const size_t len = static_cast<size_t>(qMin(kChunkSize, size - offset));
+        result = _file->SpliceFrom(fd, offset, len);
+        if (result != rpi_imager::FileError::kSuccess)
+            break;
+        _bytesWritten += len;
+        _lastDlNow = offset + len;
+        progress();
+    }
+
+    if (treeHasher.joinable())
+        treeHasher.join();
+
+    if (_cancelled)
+        return true;
+    if (result == rpi_imager::FileError::kReadError || hashReadError)
+    {
+        _onDownloadError(tr("Error reading from image file"));
+        return true;
+    }
+    if (result != rpi_imager::FileError::kSuccess)
+    {
+        _onWriteError();
+        return true;
+    }
+
+    qDebug() << "Splice: wrote" << size / (1024 * 1024) << "MB in the kernel in" << spliceTimer.elapsed() << "ms";
+    _writeHashTrusted = true;
+    _writeComplete();
+    return true;
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(size);
+    Q_UNUSED(progress);
+    return false;
+#endif
+}
+
+bool DownloadThread::_zeroRange(std::uint64_t offset, const char *zeros, size_t len)
+{
+    if (_file->ZeroRange(offset, len) != rpi_imager::FileError::kSuccess)
+    {
+        qDebug() << "Clearing zero run on device failed, writing zeros from now on";
+        _zeroRangeFailed = true;
+        return false;
+    }
+
+    // Keep the image hash in order: previous parts are hashed first
+    _hasher->waitAll();
+    _hashData(zeros, len);
+
+    // Runs are cleared in write order; merge with an adjacent previous one
+    if (!_zeroedRanges.empty() && _zeroedRanges.back().first + _zeroedRanges.back().second == offset)
+        _zeroedRanges.back().second += len;
+    else
+        _zeroedRanges.emplace_back(offset, len);
+    return true;
+}
+
+/*
+ * In-flight customisation: decide, once the first block with the partition
+ * table is known, whether to hold back the boot partition. Anything that
+ * records the device in stream order as it is written keeps customising
+ * after the write instead.
+ */
+void DownloadThread::_startBootShadow()
+{
+    _bootShadowDecided = true;
+    if (!_bootShadowEnabled || !_customisationRequested())
+        return;
+
+    // Additional devices are customised one by one after the write; the
+    // write journal and resumed writes need the device in stream order. A
+    // partial write customises the boot partition already on the device,
+    // as does a write to an image file the file system has copied.
+    if (!_fanOutTargets.empty() || !_journalKey.isEmpty() || _resumeOffset || !_writePartitions.isEmpty() || _clonedUpTo)
+        return;
+
+    // A .bmap, or a map from the source, has no entries for clusters the
+    // customisation adds. A map built while writing sees the replayed data.
+    if (_blockMap && !_streamBlockMapper)
+        return;
+
+    auto shadow = std::make_unique<BootPartitionShadow>();
+    if (!shadow->open(_firstBlock, _firstBlockSize) || shadow->start() < _file->Tell())
+        return;
+    _bootShadow = std::move(shadow);
+}
+
+/*
+ * Hold back the part of buf that belongs to the boot partition. Once all of
+ * the partition has arrived it is customised in memory and written out,
+ * followed by the rest of buf. write is the caller's own writer, used for
+ * everything that goes to the device.
+ *
+ * Returns false if buf does not touch the partition and should be written
+ * as usual; otherwise result is what the writer would have returned.
+ */
+bool DownloadThread::_interceptBootPartition(const char *buf, size_t len, WriteCompleteCallback onComplete,
+                                             const ShadowWriteFunction &write, size_t &result)
+{
+    if (_bootShadowForwarding || !_firstBlock || _cancelled)
+        return false;
+    if (!_bootShadowDecided)
+        _startBootShadow();
+    if (!_bootShadow)
+        return false;
+
+    // Nothing is written while the partition is held back
+    const std::uint64_t pos = _file->Tell() + _bootShadow->captured();
+    if (pos + len <= _bootShadow->start())
+        return false;
+
+    _bootShadowForwarding = true;
+    result = len;
+    size_t done = 0;
+
+    if (pos < _bootShadow->start())
+    {
+        done = static_cast<size_t>(_bootShadow->start() - pos);
+        if (write(buf, done) != done)
+            result = 0;
+    }
+
+    if (result)
+    {
+        const size_t take = static_cast<size_t>(qMin<std::uint64_t>(
+            len - done, _bootShadow->end() - _bootShadow->start() - _bootShadow->captured()));
+
+        // Hashed and cached as downloaded; previous parts are hashed first
+        _hasher->waitAll();
+        _writehash.addData(buf + done, take);
+        _writeImageCache(buf + done, take);
+
+        if (!_bootShadow->capture(buf + done, take))
+            result = 0;
+        done += take;
+    }
+
+    if (result && _bootShadow->complete() && !_replayBootShadow(true, write))
+        result = 0;
+
+    if (result && done < len && write(buf + done, len - done) != len - done)
+        result = 0;
+
+    // The pieces were written without a callback, so buf is only free once
+    // it is no longer being hashed
+    _hasher->waitAll();
+    _bootShadowForwarding = false;
+    if (onComplete)
+        onComplete();
+    return true;
+}
+
+/*
+ * Write the held-back boot partition, customising it first if asked to.
+ * A customisation error is kept for _writeComplete(), which reports it as
+ * it would when customising after the write.
+ */
+bool DownloadThread::_replayBootShadow(bool customise, const ShadowWriteFunction &write)
+{
+    std::unique_ptr<BootPartitionShadow> shadow = std::move(_bootShadow);
+
+    if (customise)
+    {
+        QElapsedTimer customTimer;
+        customTimer.start();
+        try
+        {
+            _customizeDevice(shadow->file(), nullptr, 0);
+            _bootShadowCustomised = true;
+        }
+        catch (std::runtime_error &err)
+        {
+            _bootShadowError = QString::fromUtf8(err.what());
+        }
+        emit eventCustomisation(static_cast<quint32>(customTimer.elapsed()), _bootShadowCustomised,
+                                _customisationMetadata() + "; in-flight");
+    }
+
+    constexpr size_t kReplayChunkSize = 4 * 1024 * 1024;
+    char *chunk = static_cast<char *>(qMallocAligned(kReplayChunkSize, 4096));
+    if (!chunk)
+        return false;
+
+    // The replayed data reaches the block mapper, the mapped range hashes
+    // and the read-back hash, but not _writehash or the image cache. The
+    // hashing thread reads the flag, so it must be idle when it changes.
+    _hasher->waitAll();
+    _bootShadowReplaying = true;
+    const std::uint64_t end = shadow->start() + shadow->captured();
+    bool ok = true;
+    for (std::uint64_t offset = shadow->start(); ok && offset < end; offset += kReplayChunkSize)
+    {
+        const size_t len = static_cast<size_t>(qMin<std::uint64_t>(kReplayChunkSize, end - offset));
+
+        // The previous chunk may still be hashed in the background
+        _hasher->waitAll();
+        ok = shadow->read(offset, chunk, len) && write(chunk, len) == len;
+    }
+    _hasher->waitAll();
+    _bootShadowReplaying = false;
+
+    qFreeAligned(chunk);
+    qDebug() << "Boot partition written from memory" << (_bootShadowCustomised ? "(customised)" : "(not customised)");
+    return ok;
+}
+
+/*
+ * bmap wrapper: writes only the parts of the buffer that fall inside a range
+ * listed in the block map and seeks past the rest.  Unlike zero-skip this is
+ * safe with verification, as _verifyMappedRanges() only reads back mapped
+ * ranges and checks them against the per-range checksums in the bmap.
+ *
+ * Skipped data is still added to the image hash, so the expected hash of the
+ * uncompressed image is checked as usual.
+ */
+size_t DownloadThread::_writeFileSparse(const char *buf, size_t len, WriteCompleteCallback onComplete)
+{
+    if (!_waitForDevice())
+        return 0;
+
+    size_t shadowed;
+    if (_interceptBootPartition(buf, len, onComplete, [this](const char *b, size_t l) { return _writeFileSparse(b, l); }, shadowed))
+        return shadowed;
+
+    // The map must cover this data before it is used below
+    if (_streamBlockMapper && !_cancelled)
+        _streamBlockMapper->addData(buf, len);
+    if (!_writePartitions.isEmpty() && !_firstBlock && !_mapWritePartitions(buf, len))
+        return 0;
+
+    _writeImageCache(buf, len);
+
+    if (_hashMappedRanges && _blockMap && !_cancelled)
+        _hashMappedData(_file->Tell(), buf, len);
+
+    // First block hasn't been captured yet — it is always written
+    if (!_blockMap || !_firstBlock || _cancelled)
+        return _writeFile(buf, len, onComplete);
+
+    const std::uint64_t blockSize = _blockMap->blockSize();
+    const std::uint64_t start = _file->Tell();
+    const std::uint64_t end = start + len;
+
+    // The caller's buffer may only be released once every mapped part has
+    // been written, so hold one reference until all parts are queued
+    auto pending = std::make_shared<std::atomic<int>>(1);
+    WriteCompleteCallback partDone;
+    if (onComplete)
+    {
+        partDone = [pending, onComplete]() {
+            if (pending->fetch_sub(1) == 1)
+                onComplete();
+        };
+    }
+
+    size_t result = len;
+    std::uint64_t pos = start;
+    while (pos < end)
+    {
+        const fastboot::BlockMap::Extent extent = _blockMap->extentAtSequential(pos / blockSize);
+        const bool mapped = extent.mapped;
+        // Also keeps the unbounded extent past the map from overflowing
+        const std::uint64_t runEnd = extent.end > end / blockSize ? end : extent.end * blockSize;
+
+        const char *runBuf = buf + (pos - start);
+        size_t runLen = static_cast<size_t>(runEnd - pos);
+
+        if (mapped)
+        {
+            if (partDone)
+                pending->fetch_add(1);
+            if (_writeFile(runBuf, runLen, partDone) != runLen)
+            {
+                result = 0;
+                break;
+            }
+        }
+        else
+        {
+            // Keep the image hash in order: previous parts are hashed first
+            _hasher->waitAll();
+            _hashData(runBuf, runLen);
+
+            // An image file gets a hole rather than whatever it held before
+            if (_file->IsRegularFile() && pos >= _clonedUpTo && !_zeroRangeFailed &&
+                _file->ZeroRange(pos, runLen) != rpi_imager::FileError::kSuccess)
+            {
+                qDebug() << "Punching holes in the image file failed, leaving unmapped ranges as they are";
+                _zeroRangeFailed = true;
+            }
+
+            if (_file->Seek(runEnd) != rpi_imager::FileError::kSuccess)
+            {
+                result = 0;
+                break;
+            }
+            _bytesWritten += runLen;
+        }
+        pos = runEnd;
+    }
+
+    if (partDone)
+        partDone();
+    return result;
+}
+
+size_t DownloadThread::_writeFile(const char *buf, size_t len, WriteCompleteCallback onComplete)
+{
+    RPI_TRACE1(write_chunk, len);
+    if (_cancelled) {
+        if (onComplete) onComplete();
         return len;
     }
 
     if (!_firstBlock)
     {
-        _writehash.addData(buf, len);
+        _startSampledVerify(buf, len);
+        _hashData(buf, len);
         _firstBlock = (char *) qMallocAligned(len, 4096);
         _firstBlockSize = len;
         ::memcpy(_firstBlock, buf, len);
+        for (auto &target : _fanOutTargets)
+            target->setFirstBlock(buf, len);
+        // Lets a later attempt download from the resume offset onwards
+        if (_rawSource && !_journalKey.isEmpty() && len % 4096 == 0)
+            _journal.setFirstBlock(buf, len);
         qDebug() << "_writeFile: captured first block (" << len << ") and advanced file offset via seek";
         if (onComplete) onComplete();
         return (_file->Seek(len) == rpi_imager::FileError::kSuccess) ? len : 0;
     }
 
+    // A resumed write only hashes what the device already holds, as does a
+    // write to an image file the file system has copied the image into
+    const std::uint64_t writeOffset = _file->Tell();
+    const std::uint64_t heldUpTo = qMax(_resumeOffset, _clonedUpTo);
+    if (writeOffset < heldUpTo)
+    {
+        const size_t skip = static_cast<size_t>(qMin<std::uint64_t>(len, heldUpTo - writeOffset));
+        if (!_skipResumedData(buf, skip))
+        {
+            if (onComplete) onComplete();
+            return 0;
+        }
+        if (skip == len)
+        {
+            if (onComplete) onComplete();
+            return len;
+        }
+        return _writeFile(buf + skip, len - skip, onComplete) == len - skip ? len : 0;
+    }
+
+    if (_deltaActive && !_deltaWriting && len % DELTA_BLOCK_SIZE == 0 && writeOffset % DELTA_BLOCK_SIZE == 0)
+        return _writeFileDelta(buf, len, onComplete);
+
+    if (!_writePhaseTimer.isValid())
+        _writePhaseTimer.start();
+
     QElapsedTimer opTimer;
     quint64 preHashWaitMs = 0;
     quint64 syscallMs = 0;
@@ -1051,96 +2826,105 @@ size_t DownloadThread::_writeFile(const char *buf, size_t len, WriteCompleteCall
     quint32 currentMax = _writeTimingStats.maxWriteSizeBytes.load();
     while (lenU32 > currentMax && !_writeTimingStats.maxWriteSizeBytes.compare_exchange_weak(currentMax, lenU32)) {}
 
-    // Pipelined hash computation: wait for PREVIOUS hash before starting current one
-    if (_hasPendingHash) {
-        if (!_pendingHashFuture.isFinished()) {
-            opTimer.start();
-            _pendingHashFuture.waitForFinished();
-            preHashWaitMs = static_cast<quint64>(opTimer.elapsed());
-            _writeTimingStats.totalPreHashWaitMs.fetch_add(preHashWaitMs);
-            
-            if (preHashWaitMs > 10) {
-                qDebug() << "Hash pipeline stall: waited" << preHashWaitMs << "ms for previous hash";
-            }
-        }
+    // Hand a copy to any additional devices before the primary write moves the offset
+    if (!_fanOutTargets.empty())
+        _fanOutWrite(buf, len);
+
+    // Determine if we can use zero-copy async I/O
+    bool useAsync = _debugAsyncIO && _file->IsAsyncIOSupported() && _file->GetAsyncQueueDepth() > 1;
+    bool useZeroCopy = useAsync && onComplete;  // Zero-copy requires completion callback
+
+    // With zero-copy, the buffer is used by the async writes AND the hash,
+    // and is released once all of them are done. The hash holds a reference
+    // of its own, dropped on the hashing thread, so write completions never
+    // wait for it. The other reference is held until all pieces are queued.
+    // The write tuner may split the buffer into smaller writes, each of
+    // which holds a reference too (as in _writeFileSparse).
+    std::shared_ptr<std::atomic<int>> pending;
+    WriteCompleteCallback hashDone;
+    if (useZeroCopy) {
+        pending = std::make_shared<std::atomic<int>>(2);
+        hashDone = [pending, onComplete]() {
+            if (pending->fetch_sub(1) == 1) onComplete();
+        };
     }
 
-    // Start hash computation for current buffer
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    _pendingHashFuture = QtConcurrent::run(&DownloadThread::_hashData, this, buf, len);
-#else
-    _pendingHashFuture = QtConcurrent::run(this, &DownloadThread::_hashData, buf, len);
-#endif
-    _hasPendingHash = true;
+    // Queue the hash behind the previous buffers'; this only waits when the
+    // hashing thread is HashPipeline::kDepth buffers behind
+    opTimer.start();
+    const HashPipeline::Ticket hashTicket = _hasher->submit(buf, len, hashDone);
+    preHashWaitMs = static_cast<quint64>(opTimer.elapsed());
+    if (preHashWaitMs > 0) {
+        _writeTimingStats.totalPreHashWaitMs.fetch_add(preHashWaitMs);
+        if (preHashWaitMs > 10) {
+            qDebug() << "Hash pipeline stall: waited" << preHashWaitMs << "ms for queued hashes";
+        }
+    }
 
-    // Determine if we can use zero-copy async I/O
     opTimer.start();
     size_t bytes_written = 0;
     rpi_imager::FileError write_result;
     
-    bool useAsync = _debugAsyncIO && _file->IsAsyncIOSupported() && _file->GetAsyncQueueDepth() > 1;
-    bool useZeroCopy = useAsync && onComplete;  // Zero-copy requires completion callback
-    
     if (useZeroCopy) {
         // ZERO-COPY ASYNC: Use caller's buffer directly, release via callback
         // This is the optimal path when using ring buffer slots as async I/O buffers
-        // 
-        // IMPORTANT: The buffer is used by both the async write AND the hash computation.
-        // We must wait for BOTH to complete before releasing the buffer.
-        // Capture the hash future so the completion callback can wait for it.
-        size_t writeLen = len;
-        QFuture<void> hashFuture = _pendingHashFuture;
         
         // Capture pointer to _bytesWritten for callback to update on completion
         // This ensures progress reflects COMPLETED writes, not just queued writes
+        // (sampled by ImageWriter's ProgressAggregator)
         std::atomic<std::uint64_t>* bytesWrittenPtr = &_bytesWritten;
-        
-        // Capture 'this' and total for event-driven progress notification
-        // The signal emission is thread-safe via Qt::QueuedConnection
-        DownloadThread* self = this;
-        quint64 totalBytes = _extractTotal.load();
-        
-        write_result = _file->AsyncWriteSequential(
-            reinterpret_cast<const std::uint8_t*>(buf), len,
-            [onComplete, writeLen, hashFuture, bytesWrittenPtr, self, totalBytes](rpi_imager::FileError result, std::size_t written) mutable {
-                // Wait for hash computation to complete before releasing buffer
-                // This ensures the buffer isn't reused while still being hashed
-                if (!hashFuture.isFinished()) {
-                    hashFuture.waitForFinished();
-                }
-                
-                // Update progress when write actually completes (not when queued)
-                if (result == rpi_imager::FileError::kSuccess) {
-                    quint64 newTotal = bytesWrittenPtr->fetch_add(written) + written;
-                    // Emit progress signal - thread-safe via queued connection to main thread
-                    emit self->asyncWriteProgress(newTotal, totalBytes);
-                }
-                
-                // Now safe to release the buffer
-                if (onComplete) onComplete();
-                if (result != rpi_imager::FileError::kSuccess) {
-                    qDebug() << "Async write (zero-copy): error" << static_cast<int>(result)
-                             << "expected" << writeLen << "wrote" << written;
-                }
-            });
+
+        const size_t pieceSize = _tunedWriteSize(len);
+        size_t queued = 0;
+        write_result = rpi_imager::FileError::kSuccess;
+
+        while (queued < len) {
+            size_t writeLen = qMin(pieceSize, len - queued);
+            auto fired = std::make_shared<std::atomic<bool>>(false);
+            pending->fetch_add(1);
+            _waitForTunedQueueSlot();
+
+            write_result = _file->AsyncWriteSequential(
+                reinterpret_cast<const std::uint8_t*>(buf) + queued, writeLen,
+                [onComplete, writeLen, bytesWrittenPtr, pending, fired](rpi_imager::FileError result, std::size_t written) {
+                    fired->store(true);
+
+                    // Update progress when write actually completes (not when queued)
+                    if (result == rpi_imager::FileError::kSuccess) {
+                        bytesWrittenPtr->fetch_add(written);
+                    }
+                    
+                    // Now safe to release the buffer, if this was the last piece
+                    if (pending->fetch_sub(1) == 1 && onComplete) onComplete();
+                    if (result != rpi_imager::FileError::kSuccess) {
+                        qDebug() << "Async write (zero-copy): error" << static_cast<int>(result)
+                                 << "expected" << writeLen << "wrote" << written;
+                    }
+                });
+
+            if (write_result != rpi_imager::FileError::kSuccess) {
+                // The piece was not queued; drop its reference unless its callback already did
+                if (!fired->load())
+                    pending->fetch_sub(1);
+                break;
+            }
+            queued += writeLen;
+        }
         
         if (write_result == rpi_imager::FileError::kSuccess) {
             bytes_written = len;
             // Don't increment _bytesWritten here - callback will do it on completion
         } else {
             qDebug() << "Async write queue failed, falling back to sync";
-            // Fallback to sync - wait for hash before releasing
-            if (!_pendingHashFuture.isFinished()) {
-                _pendingHashFuture.waitForFinished();
-            }
-            write_result = _file->WriteSequential(reinterpret_cast<const std::uint8_t*>(buf), len);
+            write_result = _file->WriteSequential(reinterpret_cast<const std::uint8_t*>(buf) + queued, len - queued);
             if (write_result == rpi_imager::FileError::kSuccess) {
                 bytes_written = len;
-                _bytesWritten += bytes_written;
+                _bytesWritten += len - queued;
             }
-            // Call completion callback since we're done synchronously
-            if (onComplete) onComplete();
         }
+
+        // Release the queueing reference; completes now if nothing is in flight
+        if (pending->fetch_sub(1) == 1 && onComplete) onComplete();
     } else if (useAsync) {
         // ASYNC WITH COPY: No completion callback, must copy buffer for safety
         // This path is used when caller expects buffer to be free after return
@@ -1152,17 +2936,11 @@ size_t DownloadThread::_writeFile(const char *buf, size_t len, WriteCompleteCall
             // Capture pointer to _bytesWritten for callback to update on completion
             std::atomic<std::uint64_t>* bytesWrittenPtr = &_bytesWritten;
             
-            // Capture 'this' and total for event-driven progress notification
-            DownloadThread* self = this;
-            quint64 totalBytes = _extractTotal.load();
-            
             write_result = _file->AsyncWriteSequential(asyncBuf, len, 
-                [asyncBuf, writeLen, bytesWrittenPtr, self, totalBytes](rpi_imager::FileError result, std::size_t written) {
+                [asyncBuf, writeLen, bytesWrittenPtr](rpi_imager::FileError result, std::size_t written) {
                     // Update progress when write actually completes (not when queued)
                     if (result == rpi_imager::FileError::kSuccess) {
-                        quint64 newTotal = bytesWrittenPtr->fetch_add(written) + written;
-                        // Emit progress signal - thread-safe via queued connection to main thread
-                        emit self->asyncWriteProgress(newTotal, totalBytes);
+                        bytesWrittenPtr->fetch_add(written);
                     }
                     qFreeAligned(asyncBuf);
                     if (result != rpi_imager::FileError::kSuccess) {
@@ -1187,29 +2965,48 @@ size_t DownloadThread::_writeFile(const char *buf, size_t len, WriteCompleteCall
             }
         }
     } else {
-        // SYNCHRONOUS WRITE: Original path
-        write_result = _file->WriteSequential(reinterpret_cast<const std::uint8_t*>(buf), len);
+        // SYNCHRONOUS WRITE: Original path, in pieces if the write tuner asks for smaller writes
+        const size_t pieceSize = _tunedWriteSize(len);
+        write_result = rpi_imager::FileError::kSuccess;
+        for (size_t offset = 0; offset < len && write_result == rpi_imager::FileError::kSuccess; offset += pieceSize)
+            write_result = _file->WriteSequential(reinterpret_cast<const std::uint8_t*>(buf) + offset, qMin(pieceSize, len - offset));
         if (write_result == rpi_imager::FileError::kSuccess) {
             bytes_written = len;
             _bytesWritten += bytes_written;
         } else {
             qDebug() << "Write error: FileOperations write failed with error code" << static_cast<int>(write_result) << "while writing len:" << len;
         }
-        // For sync writes, call completion immediately
-        if (onComplete) onComplete();
+        // For sync writes, call completion as soon as the buffer is hashed
+        if (onComplete) {
+            _hasher->wait(hashTicket);
+            onComplete();
+        }
     }
     
     syscallMs = static_cast<quint64>(opTimer.elapsed());
     _writeTimingStats.totalSyscallMs.fetch_add(syscallMs);
+    
+    // Per-write latency; lock-free, so cheap enough for every call
+    static const quint16 zeroCopyLabel = PerformanceStats::internLabel("zero-copy");
+    static const quint16 asyncLabel = PerformanceStats::internLabel("async");
+    static const quint16 syncLabel = PerformanceStats::internLabel("sync");
+    PerformanceStats::recordFastEvent(PerformanceStats::EventType::WriteOperation,
+                                      static_cast<uint32_t>(opTimer.nsecsElapsed() / 1000),
+                                      static_cast<qint64>(len),
+                                      useZeroCopy ? zeroCopyLabel : (useAsync ? asyncLabel : syncLabel));
+    if (!useAsync || _file->IsInSyncFallbackMode())
+        _writeTimingStats.writeLatency.Record(static_cast<quint64>(opTimer.nsecsElapsed() / 1000));
+    _updateWriteTuning(static_cast<quint64>(opTimer.nsecsElapsed() / 1000));
+    _writeBusyUs += static_cast<quint64>(opTimer.nsecsElapsed() / 1000);
 
     qint64 written = static_cast<qint64>(bytes_written);
 
     // Wait for current hash to complete before returning
     // For zero-copy async, the buffer stays valid until onComplete is called
     // For sync/copy-async, this ensures buffer safety for callers without callback
-    if (!useZeroCopy && _hasPendingHash && !_pendingHashFuture.isFinished()) {
+    if (!useZeroCopy && !_hasher->isDone(hashTicket)) {
         opTimer.start();
-        _pendingHashFuture.waitForFinished();
+        _hasher->wait(hashTicket);
         postHashWaitMs = static_cast<quint64>(opTimer.elapsed());
         _writeTimingStats.totalPostHashWaitMs.fetch_add(postHashWaitMs);
     }
@@ -1234,6 +3031,12 @@ size_t DownloadThread::_writeFile(const char *buf, size_t len, WriteCompleteCall
 
     // Cross-platform periodic sync
     _periodicSync();
+
+    // Let the verifier read back whatever is now on the device
+    _commitPipelinedVerify();
+
+    // Record what an interrupted write could resume from
+    _saveJournal();
     
     // Update bottleneck state for UI feedback
     _updateBottleneckState();
@@ -1245,13 +3048,34 @@ bool DownloadThread::_progress(curl_off_t dltotal, curl_off_t dlnow, curl_off_t
 {
     if (dltotal)
         _lastDlTotal = _startOffset + dltotal;
-    _lastDlNow   = _startOffset + dlnow;
 
-    return !_cancelled;
+    return !_cancelled && _checkMirrorThroughput();
 }
 
 void DownloadThread::_header(const string &header)
 {
+    QByteArray lower = QByteArray::fromStdString(header).toLower();
+    if (lower.startsWith("http/"))
+    {
+        // New response (e.g. after a redirect) - only the final one counts
+        _acceptRanges = false;
+        _responseEtag.clear();
+        _responseLastModified.clear();
+        _validatorUrl = _url;
+    }
+    else if (lower.startsWith("accept-ranges:"))
+    {
+        _acceptRanges = lower.contains("bytes");
+    }
+    else if (lower.startsWith("etag:"))
+    {
+        _responseEtag = QByteArray::fromStdString(header).mid(5).trimmed();
+    }
+    else if (lower.startsWith("last-modified:"))
+    {
+        _responseLastModified = QByteArray::fromStdString(header).mid(14).trimmed();
+    }
+
     if (header.compare(0, 6, "Date: ") == 0)
     {
         _serverTime = curl_getdate(header.data()+6, NULL);
@@ -1268,7 +3092,7 @@ void DownloadThread::cancelDownload()
     _cancelled = true;
     
     // Cancel any pending async I/O to unblock waiting operations
-    if (_file) {
+    if (_file && _deviceReady()) {
         _file->CancelAsyncIO();
     }
     
@@ -1306,6 +3130,9 @@ void DownloadThread::deleteDownloadedFile()
         if (_asyncCacheWriter) {
             _asyncCacheWriter->cancel();
         }
+        if (_imageCacheWriter) {
+            _imageCacheWriter->cancel();
+        }
 #ifdef Q_OS_WIN
         if (_volumeFile && _volumeFile->IsOpen()) {
             _volumeFile->Close();
@@ -1357,6 +3184,11 @@ uint64_t DownloadThread::bytesWritten()
         return _bytesWritten;
 }
 
+uint64_t DownloadThread::bytesDecompressed()
+{
+    return _bytesDecompressedSoFar();
+}
+
 int DownloadThread::pendingAsyncWrites() const
 {
     if (_file && _file->IsAsyncIOSupported()) {
@@ -1415,6 +3247,7 @@ bool DownloadThread::reduceAsyncQueueDepth(int newDepth)
         if (newDepth < currentDepth && newDepth >= 2) {
             qDebug() << "Reducing async queue depth from" << currentDepth << "to" << newDepth;
             _file->ReduceQueueDepthForRecovery(newDepth);
+            _writeTuner.capQueueDepth(newDepth);
             emit eventQueueDepthReduction(currentDepth, newDepth, pendingWrites);
             return true;
         }
@@ -1422,6 +3255,20 @@ bool DownloadThread::reduceAsyncQueueDepth(int newDepth)
     return false;
 }
 
+bool DownloadThread::restoreAsyncQueueDepth(int newDepth)
+{
+    if (_file && _file->IsAsyncIOSupported() && !_file->IsInSyncFallbackMode()) {
+        int currentDepth = _file->GetAsyncQueueDepth();
+        if (newDepth > currentDepth) {
+            qDebug() << "Restoring async queue depth from" << currentDepth << "to" << newDepth;
+            _file->RestoreQueueDepthAfterRecovery(newDepth);
+            _writeTuner.restoreQueueDepth(newDepth);
+            return true;
+        }
+    }
+    return false;
+}
+
 int DownloadThread::getAsyncQueueDepth() const
 {
     if (_file && _file->IsAsyncIOSupported()) {
@@ -1430,6 +3277,47 @@ int DownloadThread::getAsyncQueueDepth() const
     return 0;
 }
 
+int DownloadThread::effectiveAsyncQueueDepth() const
+{
+    if (!_file || !_file->IsAsyncIOSupported()) {
+        return 0;
+    }
+    return _file->IsInSyncFallbackMode() ? 1 : _file->GetAsyncQueueDepth();
+}
+
+bool DownloadThread::resumeAsyncWrites(int depth)
+{
+    // Only after a clean drain; AttemptSyncFallback() replays cancelled writes
+    if (!_file || !_drainedToSync || !_file->ResumeAsyncAfterSyncFallback(depth)) {
+        return false;
+    }
+    _drainedToSync = false;
+    qDebug() << "Resumed async writes at queue depth" << depth;
+    _writeTuner.restoreQueueDepth(depth);
+    return true;
+}
+
+std::vector<uint64_t> DownloadThread::writeLatencySnapshot() const
+{
+    if (effectiveAsyncQueueDepth() > 1) {
+        return _file->GetAsyncWriteLatencyHistogram().Snapshot();
+    }
+    return _writeTimingStats.writeLatency.Snapshot();
+}
+
+quint64 DownloadThread::asyncWriteLatencyUs(double quantile, quint64 &samples) const
+{
+    samples = 0;
+    if (!_file || !_file->IsAsyncIOSupported())
+        return 0;
+
+    const auto &histogram = _file->GetAsyncWriteLatencyHistogram();
+    const std::vector<uint64_t> counts = histogram.Snapshot();
+    for (uint64_t c : counts)
+        samples += c;
+    return rpi_imager::LatencyHistogram::ValueAtQuantile(counts, quantile, histogram.MaxUs());
+}
+
 bool DownloadThread::drainAndSwitchToSync(int timeoutSeconds)
 {
     if (_file && _file->IsAsyncIOSupported()) {
@@ -1446,6 +3334,8 @@ bool DownloadThread::drainAndSwitchToSync(int timeoutSeconds)
         
         if (success) {
             qDebug() << "Drain successful in" << durationMs << "ms - continuing in sync mode (hot-swap)";
+            _writeTuner.capQueueDepth(WriteAutoTuner::MinQueueDepth);
+            _drainedToSync = true;
             return true;
         }
         
@@ -1582,13 +3472,27 @@ void DownloadThread::_onWriteError()
 
 void DownloadThread::_closeFiles()
 {
+    // Not while the device is still being prepared in the background
+    if (_devicePreparation.valid())
+        _devicePreparation.wait();
+
     QElapsedTimer closeTimer;
     closeTimer.start();
+
+    // The verifier reads through _file, stop it before closing
+    if (_pipelinedVerifier) {
+        _pipelinedVerifier->stop();
+        _pipelinedVerifier.reset();
+    }
     
-    // Close unified file operations
-    if (_file && _file->IsOpen()) {
+    // Close unified file operations, unless an abandoned sync still uses them
+    if (_file && _file->IsOpen() && !isSyncInFlight()) {
         _file->Close();
     }
+    if (_verifyFile) {
+        _verifyFile->Close();
+        _verifyFile.reset();
+    }
 #ifdef Q_OS_WIN
     if (_volumeFile && _volumeFile->IsOpen()) {
         _volumeFile->Close();
@@ -1600,6 +3504,11 @@ void DownloadThread::_closeFiles()
     if (_asyncCacheWriter) {
         _asyncCacheWriter->cancel();
     }
+    if (_imageCacheWriter) {
+        _imageCacheWriter->cancel();
+    }
+    _cancelFanOutTargets();
+    _bootShadow.reset();
     
     quint32 closeDurationMs = static_cast<quint32>(closeTimer.elapsed());
     if (closeDurationMs > 0) {
@@ -1607,8 +3516,75 @@ void DownloadThread::_closeFiles()
     }
 }
 
+bool DownloadThread::isSyncInFlight() const
+{
+    return _abandonedSync.valid()
+        && _abandonedSync.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+/* fsync() cannot be interrupted, and flushing a large page cache to a slow
+ * card takes many seconds. Run it on a helper thread, so that cancelling
+ * stops waiting for it; the device is closed once it returns. The async
+ * writes are drained here first, so the completion queue is only ever
+ * reaped by this thread and the helper makes the bare sync call. */
+rpi_imager::FileError DownloadThread::_cancellableSync()
+{
+    if (_cancelled)
+        return rpi_imager::FileError::kCancelled;
+
+    const rpi_imager::FileError drained = _file->WaitForPendingWrites();
+    if (drained != rpi_imager::FileError::kSuccess)
+        return drained;
+    if (_cancelled)
+        return rpi_imager::FileError::kCancelled;
+
+    auto promise = std::make_shared<std::promise<rpi_imager::FileError>>();
+    std::shared_future<rpi_imager::FileError> sync = promise->get_future().share();
+    std::thread([promise, file = _file.get()]() {
+        RPI_TRACE0(sync_begin);
+        const rpi_imager::FileError result = file->SyncToDevice();
+        RPI_TRACE1(sync_end, static_cast<int>(result));
+        promise->set_value(result);
+    }).detach();
+
+    const auto interval = std::chrono::milliseconds(kCancelPollIntervalMs);
+    while (sync.wait_for(interval) != std::future_status::ready)
+    {
+        if (_cancelled)
+        {
+            qDebug() << "Cancelled during sync, leaving it to finish in the background";
+            _abandonedSync = sync;
+            return rpi_imager::FileError::kCancelled;
+        }
+    }
+    return sync.get();
+}
+
 void DownloadThread::_writeComplete()
 {
+    // An image short enough to arrive in full may get here first
+    if (!_waitForDevice())
+    {
+        _closeFiles();
+        return;
+    }
+
+    // The image ended inside the held-back boot partition: write what there
+    // is, and customise after the write as usual
+    if (_bootShadow && !_cancelled)
+    {
+        qDebug() << "Image ended inside the boot partition, writing it without customisation";
+        _bootShadowForwarding = true;
+        const bool ok = _replayBootShadow(false, [this](const char *b, size_t l) { return _writeFileSparse(b, l); });
+        _bootShadowForwarding = false;
+        if (!ok)
+        {
+            _onWriteError();
+            _closeFiles();
+            return;
+        }
+    }
+
     // Wait for all async writes to complete before proceeding
     // This is critical for data integrity before verification
     if (_file && _file->IsAsyncIOSupported() && _file->GetAsyncQueueDepth() > 1) {
@@ -1681,40 +3657,41 @@ void DownloadThread::_writeComplete()
     // Don't report errors if the operation was cancelled
     if (_cancelled)
     {
-        // Still need to wait for pending hash to avoid dangling futures
-        if (_hasPendingHash) {
-            _pendingHashFuture.waitForFinished();
-            _hasPendingHash = false;
-        }
+        // Queued buffers may be freed once this returns
+        _hasher->waitAll();
         _closeFiles();
         return;
     }
 
-    // Wait for final pending hash computation to complete before getting result
-    if (_hasPendingHash) {
-        if (!_pendingHashFuture.isFinished()) {
-            QElapsedTimer waitTimer;
-            waitTimer.start();
-            _pendingHashFuture.waitForFinished();
+    // Wait for the hashing thread to catch up before getting the result
+    {
+        QElapsedTimer waitTimer;
+        waitTimer.start();
+        _hasher->waitAll();
+        if (waitTimer.elapsed() > 0)
             qDebug() << "Final hash wait:" << waitTimer.elapsed() << "ms";
-        }
-        _hasPendingHash = false;
     }
 
-    QByteArray computedHash = _writehash.result().toHex();
+    // A spliced image was not hashed; its hash was known beforehand
+    QByteArray computedHash = _writeHashTrusted ? _expectedHash : _writehash.result().toHex();
     qDebug() << "Hash of uncompressed image:" << computedHash;
     if (!_expectedHash.isEmpty() && _expectedHash != computedHash)
     {
         qDebug() << "Mismatch with expected hash:" << _expectedHash;
+        _removeJournal();
         
         // Cancel async cache writer (this will remove the cache file)
         if (_asyncCacheWriter) {
             _asyncCacheWriter->cancel();
         }
+        if (_imageCacheWriter) {
+            _imageCacheWriter->cancel();
+        }
+        emit imageHashMismatch();
         
         // Provide more specific error message based on context
         QString errorMsg;
-        if (_url.startsWith("file://") && _url.contains("lastdownload.cache"))
+        if (_url.startsWith("file://") && _url.endsWith(".cache"))
         {
             errorMsg = tr("Cached file is corrupt. SHA256 hash does not match expected value.<br>"
                          "The cache file will be removed and the download will restart.");
@@ -1735,19 +3712,46 @@ void DownloadThread::_writeComplete()
         _closeFiles();
         return;
     }
+
+    // Everything is on the device now; verification and customisation
+    // are not resumed
+    _removeJournal();
+
     if (_cacheEnabled && _expectedHash == computedHash)
     {
         // Finish async cache writer (waits for all pending writes to complete)
         if (_asyncCacheWriter && _asyncCacheWriter->isActive()) {
             _asyncCacheWriter->finish();
             
-            // Get cache file hash from async writer
-            QByteArray cacheFileHash = _asyncCacheWriter->hash();
-            
-            // Emit both hashes for proper cache verification
-            emit cacheFileHashUpdated(cacheFileHash, computedHash);
-            // Keep old signal for backward compatibility
-            emit cacheFileUpdated(computedHash);
+            // finish() discards the cache if a gap could not be fetched again
+            if (!_asyncCacheWriter->hasError()) {
+                // Get cache file hash from async writer
+                QByteArray cacheFileHash = _asyncCacheWriter->hash();
+                
+                // Emit both hashes for proper cache verification
+                emit cacheFileHashUpdated(cacheFileHash, computedHash);
+                // Keep old signal for backward compatibility
+                emit cacheFileUpdated(computedHash);
+            }
+        }
+    }
+    _finishImageCache(computedHash);
+
+    // Additional devices drain, sync and verify on their own threads while
+    // the primary device does the same below
+    for (auto &target : _fanOutTargets)
+        target->finishWrites(_file->Tell(), _verifyEnabled);
+
+    // An image file ends where the image does, even if its last blocks
+    // were skipped as zeros rather than written
+    if (_file->IsRegularFile())
+    {
+        std::uint64_t fileSize = 0;
+        const std::uint64_t imageEnd = _file->Tell();
+        if (_file->GetSize(fileSize) == rpi_imager::FileError::kSuccess && fileSize < imageEnd &&
+            _file->ZeroRange(fileSize, imageEnd - fileSize) != rpi_imager::FileError::kSuccess)
+        {
+            qDebug() << "Could not extend the image file to" << imageEnd << "bytes";
         }
     }
 
@@ -1757,46 +3761,131 @@ void DownloadThread::_writeComplete()
     // Uses BlockingQueuedConnection so the watchdog is stopped before we block.
     emit finalSyncStarting();
 
-    rpi_imager::FileError flushResult = _file->Flush();
-    if (flushResult != rpi_imager::FileError::kSuccess)
-    {
-        DownloadThread::_onDownloadError(_fileErrorToString(flushResult, tr("flush")));
-        _closeFiles();
-        return;
-    }
+    QElapsedTimer finalSyncTimer;
+    finalSyncTimer.start();
 
-#ifndef Q_OS_WIN
-    rpi_imager::FileError syncResult = _file->ForceSync();
+#ifdef Q_OS_WIN
+    // FlushFileBuffers: skipped once cancelled, and quick with direct I/O
+    rpi_imager::FileError syncResult = _file->Flush();
+#else
+    // The whole page cache flush runs where cancelling need not wait for it
+    rpi_imager::FileError syncResult = _cancellableSync();
+#endif
     if (syncResult != rpi_imager::FileError::kSuccess) {
-        DownloadThread::_onDownloadError(_fileErrorToString(syncResult, tr("sync")));
+        if (syncResult != rpi_imager::FileError::kCancelled)
+            DownloadThread::_onDownloadError(_fileErrorToString(syncResult, tr("sync")));
         _closeFiles();
         return;
     }
-#endif
 
     qDebug() << "Write done in" << _timer.elapsed() / 1000 << "seconds";
 
+    _sessionProfile.finalSyncMs = static_cast<quint32>(finalSyncTimer.elapsed());
+    _writeBusyUs += static_cast<quint64>(finalSyncTimer.nsecsElapsed() / 1000);
+    if (_periodicSyncCount > 0)
+        _sessionProfile.periodicSyncMs = static_cast<quint32>(_periodicSyncMsTotal / _periodicSyncCount);
+
+    // Only a write the device held back says how fast the device is; one
+    // paced by the download or decompression would store the source's rate
+    const qint64 writePhaseMs = _writePhaseTimer.isValid() ? _writePhaseTimer.elapsed() : 0;
+    const quint64 sessionBytes = _bytesWritten.load();
+    if (writePhaseMs > 0 && sessionBytes >= WriteAutoTuner::MinProbeBytes &&
+        _writeBusyUs * 100 >= static_cast<quint64>(writePhaseMs) * 1000 * WriteAutoTuner::WriterBoundPercent)
+    {
+        _sessionProfile.writeKBps = static_cast<quint32>(sessionBytes * 1000 / (static_cast<quint64>(writePhaseMs) * 1024));
+    }
+
     /* Verify */
-    if (_verifyEnabled && !_verify())
+    QElapsedTimer verifyTimer;
+    verifyTimer.start();
+    if (_verifyEnabled)
     {
-        _closeFiles();
-        return;
+        ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::Verify);
+        if (!_verify())
+        {
+            _closeFiles();
+            return;
+        }
+        if (_verifyFile)
+        {
+            _verifyFile->Close();
+            _verifyFile.reset();
+        }
+    }
+    // Pipelined verification reads part of the image while writing, which says little about read speed
+    if (_verifyEnabled && !_debugPipelinedVerify && !_cancelled && verifyTimer.elapsed() > 0 &&
+        _lastVerifyNow.load() >= WriteAutoTuner::MinProbeBytes)
+    {
+        _sessionProfile.verifyKBps = static_cast<quint32>(_lastVerifyNow.load() * 1000 /
+                                                          (static_cast<quint64>(verifyTimer.elapsed()) * 1024));
+    }
+    _emitStageCpuTime();
+
+    // Latency at the periodic syncs is where a reader waking up shows
+    if (_usbPowerEnabled)
+    {
+        const QString syncs = QString("periodic syncs: %1, avg %2 ms, max %3 ms")
+            .arg(_periodicSyncCount)
+            .arg(_periodicSyncCount ? _periodicSyncMsTotal / _periodicSyncCount : 0)
+            .arg(_writeTimingStats.syncLatency.MaxUs() / 1000);
+        emit eventDriveUsbPower(!_usbPowerHeld.isEmpty(),
+                                (_usbPowerHeld.isEmpty() ? QString("nothing changed") : _usbPowerHeld) + "; " + syncs);
     }
 
     emit finalizing();
 
+    // The device's cache was flushed above. With direct I/O, what is left -
+    // customisation and the first block - can be written through it, so the
+    // final sync need not flush the whole cache again (10 s or more on some
+    // readers): writes to a write-through cache are on the media when they
+    // complete, and a write-back cache that honours FUA takes them as FUA writes.
+    // Windows does not sync at the end.
+#ifndef Q_OS_WIN
+    using WriteCache = rpi_imager::FileOperations::DeviceIOLimits::WriteCache;
+    const rpi_imager::FileOperations::DeviceIOLimits &ioLimits = _file->GetDeviceIOLimits();
+    bool finalWindowWrittenThrough = false;
+    if (_file->IsDirectIOEnabled())
+    {
+        if (ioLimits.write_cache == WriteCache::kWriteThrough)
+            finalWindowWrittenThrough = true;
+        else if (ioLimits.write_cache == WriteCache::kWriteBack && ioLimits.fua_supported)
+            finalWindowWrittenThrough = _file->SetWriteThrough(true);
+    }
+#endif
+
+    // Customise and finalise additional devices while the first block is still held back
+    _finishFanOutTargets();
+
+    // Before customisation, which would write the image's partition table
+    if (!_writePartitions.isEmpty() && !_writeFirstBlockPartitions())
+    {
+        _closeFiles();
+        return;
+    }
+
     qDebug() << "Checking customization: config=" << !_config.isEmpty() << "cmdline=" << !_cmdline.isEmpty() 
              << "firstrun=" << !_firstrun.isEmpty() << "cloudinit=" << !_cloudinit.isEmpty() 
              << "initFormat=" << _initFormat << "isEmpty=" << _initFormat.isEmpty();
-    if ((!_config.isEmpty() || !_cmdline.isEmpty() || !_firstrun.isEmpty() || !_cloudinit.isEmpty()) && !_initFormat.isEmpty())
+    if (_customisationRequested())
     {
-        if (!_customizeImage())
+        // Customised in flight, before the boot partition was written
+        if (!_bootShadowError.isEmpty())
+        {
+            emit error(_bootShadowError);
+            _closeFiles();
+            return;
+        }
+        if (!_bootShadowCustomised && !_customizeImage())
         {
             _closeFiles();
             return;
         }
     }
 
+    if (_deltaComparedBytes)
+        qDebug() << "Delta write:" << _deltaUnchangedBytes / (1024 * 1024) << "MB of"
+                 << _deltaComparedBytes / (1024 * 1024) << "MB compared were already on the device";
+
     if (_firstBlock)
     {
         qDebug() << "Writing first block (which we skipped at first)";
@@ -1821,26 +3910,31 @@ void DownloadThread::_writeComplete()
     QElapsedTimer syncTimer;
     syncTimer.start();
     
-    rpi_imager::FileError finalFlushResult = _file->Flush();
-    if (finalFlushResult != rpi_imager::FileError::kSuccess)
-    {
-        emit eventFinalSync(static_cast<quint32>(syncTimer.elapsed()), false);
-        DownloadThread::_onDownloadError(_fileErrorToString(finalFlushResult, tr("final flush")));
-        _closeFiles();
-        return;
-    }
-
-#ifndef Q_OS_WIN
-    rpi_imager::FileError finalSyncResult = _file->ForceSync();
+#ifdef Q_OS_WIN
+    // FlushFileBuffers: skipped once cancelled, and quick with direct I/O
+    rpi_imager::FileError finalSyncResult = _file->Flush();
+#else
+    // Unless a write found the kernel cannot write through
+    if (finalWindowWrittenThrough && ioLimits.write_cache == WriteCache::kWriteBack && !_file->IsWriteThrough())
+        finalWindowWrittenThrough = false;
+    if (finalWindowWrittenThrough)
+        qDebug() << "Final writes went through the device cache, skipping the final sync";
+    // Written-through data leaves little to flush; everything else is
+    // flushed and synced where cancelling need not wait for it
+    rpi_imager::FileError finalSyncResult = finalWindowWrittenThrough ? _file->Flush()
+                                                                      : _cancellableSync();
+#endif
     if (finalSyncResult != rpi_imager::FileError::kSuccess) {
         emit eventFinalSync(static_cast<quint32>(syncTimer.elapsed()), false);
-        DownloadThread::_onDownloadError(_fileErrorToString(finalSyncResult, tr("final sync")));
+        if (finalSyncResult != rpi_imager::FileError::kCancelled)
+            DownloadThread::_onDownloadError(_fileErrorToString(finalSyncResult, tr("final sync")));
         _closeFiles();
         return;
     }
-#endif
 
+    _writeTimingStats.syncLatency.Record(static_cast<quint64>(syncTimer.nsecsElapsed() / 1000));
     emit eventFinalSync(static_cast<quint32>(syncTimer.elapsed()), true);
+    _emitLatencyHistogram(QStringLiteral("sync"), _writeTimingStats.syncLatency);
     _closeFiles();
 
 #ifdef Q_OS_DARWIN
@@ -1850,61 +3944,273 @@ void DownloadThread::_writeComplete()
 
     emit success();
 
-    if (_ejectEnabled)
+    if (_ejectEnabled && !rpi_imager::MemoryFileOperations::IsMemoryTarget(_filename.toStdString()))
     {
         // Use canonical device path for eject (e.g., /dev/disk on macOS, not rdisk)
         QString ejectPath = PlatformQuirks::getEjectDevicePath(_filename);
-        PlatformQuirks::ejectDisk(ejectPath);
+        QElapsedTimer ejectTimer;
+        ejectTimer.start();
+        if (PlatformQuirks::ejectDisk(ejectPath) == PlatformQuirks::DiskResult::Success)
+            _sessionProfile.ejectMs = static_cast<quint32>(ejectTimer.elapsed());
+    }
+
+    _storeDeviceProfile();
+}
+
+/* Reading back through a handle that goes through the page cache can hand
+ * out the data just written rather than what is on the media. _file uses
+ * direct I/O on block devices, unless that was turned off in the debug
+ * options or could not be had. In the latter case the device is opened a
+ * second time for reading only, with O_DIRECT, F_NOCACHE or
+ * FILE_FLAG_NO_BUFFERING. If that fails too, verify reads through _file. */
+rpi_imager::FileOperations *DownloadThread::_verifyReader()
+{
+    if (_verifyFile)
+        return _verifyFile.get();
+
+    const std::string target = _filename.toStdString();
+    if (!_debugDirectIO || _file->IsDirectIOEnabled() || _file->IsRegularFile() || !_ioTraceFile.isEmpty() ||
+        rpi_imager::ReplayFileOperations::IsReplayTarget(target) ||
+        rpi_imager::EmulatedFileOperations::IsEmulatedTarget(target) ||
+        rpi_imager::MemoryFileOperations::IsMemoryTarget(target))
+    {
+        return _file.get();
+    }
+
+    auto reader = rpi_imager::FileOperations::Create();
+    if (reader->OpenDevice(target) != rpi_imager::FileError::kSuccess)
+    {
+        qDebug() << "Verify: cannot open a second handle, reading through the write handle";
+        return _file.get();
+    }
+    if (!reader->IsDirectIOEnabled())
+        reader->SetDirectIOEnabled(true);
+    if (!reader->IsDirectIOEnabled())
+    {
+        qDebug() << "Verify: no direct I/O on the read handle, reading through the write handle";
+        reader->Close();
+        return _file.get();
     }
+    if (_debugAsyncIO && reader->IsAsyncIOSupported())
+        reader->SetAsyncQueueDepth(VERIFY_READS_IN_FLIGHT);
+
+    qDebug() << "Verify: reading back through a separate uncached handle";
+    _verifyFile = std::move(reader);
+    return _verifyFile.get();
 }
 
 bool DownloadThread::_verify()
 {
+    if (_blockMap)
+        return _verifyMappedRanges();
+    if (_sampledVerify)
+        return _verifySampledBlocks();
+
     _lastVerifyNow = 0;
     _verifyTotal = _file->Tell();
+    rpi_imager::FileOperations *reader = _verifyReader();
     _verifyThroughputBytes = 0;
     _verifyThroughputTimer.start();
     
-    // Use adaptive buffer size based on file size and system memory for optimal verification performance
-    size_t verifyBufferSize = SystemMemoryManager::instance().getAdaptiveVerifyBufferSize(_verifyTotal);
-    char *verifyBuf = (char *) qMallocAligned(verifyBufferSize, 4096);
+    // Use adaptive buffer size based on file size and system memory for optimal verification performance.
+    // Several buffers of that size rotate: up to VERIFY_READS_IN_FLIGHT - 1 are
+    // being read by the device while the oldest completed one is hashed on
+    // another thread, so neither the device nor the hash waits for the other.
+    // Sized in whole device requests, so each read reaches the device as
+    // native-size requests rather than being split unevenly
+    const auto &limits = reader->GetDeviceIOLimits();
+    const size_t verifyAlignment = limits.BufferAlignment(4096);
+    size_t verifyBufferSize = limits.NativeIOSize(
+        SystemMemoryManager::instance().getAdaptiveVerifyBufferSize(_verifyTotal), verifyAlignment);
+    struct VerifyRead {
+        BufferPool::Buffer mem;
+        char *buf = nullptr;
+        std::atomic<bool> done{false};
+        rpi_imager::FileError result = rpi_imager::FileError::kSuccess;
+        size_t size = 0;
+        size_t bytesRead = 0;
+        bool zeroed = false;
+        QElapsedTimer timer;
+        quint64 latencyUs = 0;
+    };
+    VerifyRead reads[VERIFY_READS_IN_FLIGHT];
+
+    // Borrowed from the buffer pool; if the other stages still hold most
+    // of it, settle for smaller buffers rather than failing
+    bool haveBuffers = false;
+    while (!haveBuffers)
+    {
+        haveBuffers = true;
+        for (auto &read : reads)
+        {
+            read.mem = BufferPool::instance().acquire(verifyBufferSize, verifyAlignment, VERIFY_BUFFER_WAIT_MS);
+            read.buf = read.mem.data();
+            haveBuffers = haveBuffers && read.mem;
+        }
+        if (haveBuffers || verifyBufferSize <= MIN_VERIFY_BUFFER_SIZE)
+            break;
+        for (auto &read : reads)
+            read.mem.release();
+        verifyBufferSize = limits.NativeIOSize(verifyBufferSize / 2, verifyAlignment);
+    }
+    if (!haveBuffers)
+    {
+        DownloadThread::_onDownloadError(tr("Not enough memory to verify the written image."));
+        return false;
+    }
     
     QElapsedTimer t1;
     t1.start();
     
-    qDebug() << "Post-write verification using" << verifyBufferSize/1024 << "KB buffer for" 
-             << _verifyTotal/(1024*1024) << "MB image";
+    qDebug() << "Post-write verification using" << VERIFY_READS_IN_FLIGHT << "x" << verifyBufferSize/1024
+             << "KB buffers for" << _verifyTotal/(1024*1024) << "MB image";
 
-    // Platform-specific optimization for sequential read verification
-    // Invalidates cache and enables read-ahead hints
-    _file->PrepareForSequentialRead(0, _verifyTotal);
+    std::uint64_t verifiedWhileWriting = 0;
+    if (_pipelinedVerifier)
+    {
+        // The first block and everything up to the returned offset are
+        // already in _verifyhash
+        verifiedWhileWriting = _pipelinedVerifier->stop();
+        if (_pipelinedVerifier->hasFailed())
+        {
+            qDebug() << "Pipelined verify failed, verifying from the start";
+            _verifyhash.reset();
+            verifiedWhileWriting = 0;
+        }
+        else
+        {
+            qDebug() << verifiedWhileWriting/(1024*1024) << "MB already verified while writing";
+        }
+        _pipelinedVerifier.reset();
+    }
 
-    if (!_firstBlock)
+    if (verifiedWhileWriting)
     {
-        _file->Seek(0);
+        reader->PrepareForSequentialRead(verifiedWhileWriting, _verifyTotal - verifiedWhileWriting);
+        reader->Seek(verifiedWhileWriting);
+        _lastVerifyNow = verifiedWhileWriting;
     }
     else
     {
-        _verifyhash.addData(_firstBlock, _firstBlockSize);
-        _file->Seek(_firstBlockSize);
-        _lastVerifyNow += _firstBlockSize;
+        // Platform-specific optimization for sequential read verification
+        // Invalidates cache and enables read-ahead hints
+        reader->PrepareForSequentialRead(0, _verifyTotal);
+
+        if (!_firstBlock)
+        {
+            reader->Seek(0);
+        }
+        else
+        {
+            _verifyhash.addData(_firstBlock, _firstBlockSize);
+            reader->Seek(_firstBlockSize);
+            _lastVerifyNow += _firstBlockSize;
+        }
     }
 
+    // Ranges cleared with ZeroRange() read back as zeros by the guarantee
+    // of BLKZEROOUT / discard_zeroes_data, so they are hashed as zeros
+    // instead of being read back
+    size_t zeroedCursor = 0;
+    if (!_zeroedRanges.empty())
+        qDebug() << "Verify: not reading back" << _zeroedRanges.size() << "ranges cleared on the device";
+
+    // reads[head] is the oldest queued read, followed by inFlight - 1 more;
+    // the buffer before head may still be hashing
+    QFuture<void> hashFuture;
+    bool hashing = false;
+    int head = 0;
+    int inFlight = 0;
+    std::uint64_t queuePos = _lastVerifyNow;
+    bool readFailed = false;
+
     while (_verifyEnabled && _lastVerifyNow < _verifyTotal && !_cancelled)
     {
-        size_t bytes_to_read = qMin((qint64) verifyBufferSize, (qint64) (_verifyTotal-_lastVerifyNow));
-        size_t lenRead = 0;
-        rpi_imager::FileError read_result = _file->ReadSequential(reinterpret_cast<std::uint8_t*>(verifyBuf), bytes_to_read, lenRead);
-        if (read_result != rpi_imager::FileError::kSuccess)
+        // Keep the device busy with every buffer that is not being hashed
+        while (!readFailed && queuePos < static_cast<std::uint64_t>(_verifyTotal) &&
+               inFlight + (hashing ? 1 : 0) < VERIFY_READS_IN_FLIGHT)
         {
-            DownloadThread::_onDownloadError(tr("Error reading from storage.<br>"
-                                                "SD card may be broken."));
-            qFreeAligned(verifyBuf);
-            return false;
+            const std::uint64_t pos = queuePos;
+            size_t bytes_to_read = static_cast<size_t>(qMin<std::uint64_t>(verifyBufferSize, _verifyTotal - pos));
+
+            while (zeroedCursor < _zeroedRanges.size() &&
+                   _zeroedRanges[zeroedCursor].first + _zeroedRanges[zeroedCursor].second <= pos)
+                zeroedCursor++;
+
+            bool zeroed = false;
+            if (zeroedCursor < _zeroedRanges.size())
+            {
+                const auto &range = _zeroedRanges[zeroedCursor];
+                if (range.first <= pos)
+                {
+                    zeroed = true;
+                    bytes_to_read = static_cast<size_t>(qMin<std::uint64_t>(bytes_to_read, range.first + range.second - pos));
+                }
+                else
+                {
+                    bytes_to_read = static_cast<size_t>(qMin<std::uint64_t>(bytes_to_read, range.first - pos));
+                }
+            }
+
+            VerifyRead &read = reads[(head + inFlight) % VERIFY_READS_IN_FLIGHT];
+            read.size = bytes_to_read;
+            read.zeroed = zeroed;
+            read.done.store(false);
+            inFlight++;
+            queuePos += bytes_to_read;
+
+            if (zeroed)
+            {
+                ::memset(read.buf, 0, bytes_to_read);
+                read.result = rpi_imager::FileError::kSuccess;
+                read.bytesRead = bytes_to_read;
+                read.done.store(true);
+                reader->Seek(queuePos);
+            }
+            else
+            {
+                read.timer.start();
+                VerifyRead *r = &read;
+                reader->AsyncReadSequential(reinterpret_cast<std::uint8_t*>(read.buf), bytes_to_read,
+                    [r](rpi_imager::FileError result, std::size_t bytesRead) {
+                        r->latencyUs = static_cast<quint64>(r->timer.nsecsElapsed() / 1000);
+                        r->result = result;
+                        r->bytesRead = bytesRead;
+                        r->done.store(true, std::memory_order_release);
+                    });
+            }
         }
 
-        _verifyhash.addData(verifyBuf, static_cast<qint64>(lenRead));
-        _lastVerifyNow += static_cast<qint64>(lenRead);
+        // Reads may complete in any order; hash strictly in order
+        VerifyRead &oldest = reads[head];
+        while (!oldest.done.load(std::memory_order_acquire) && !_cancelled)
+        {
+            if (reader->WaitForPendingReads(qMax(0, reader->GetPendingReadCount() - 1)) == rpi_imager::FileError::kCancelled)
+                break;
+        }
+        if (!oldest.done.load(std::memory_order_acquire))
+            break;  // Cancelled
+
+        if (!oldest.zeroed)
+            _writeTimingStats.verifyReadLatency.Record(oldest.latencyUs);
+        if (oldest.result != rpi_imager::FileError::kSuccess || oldest.bytesRead != oldest.size)
+        {
+            readFailed = true;
+            break;
+        }
+
+        // One hash at a time, in order; the previous buffer becomes free again
+        if (hashing)
+            hashFuture.waitForFinished();
+        const char *hashBuf = oldest.buf;
+        const size_t hashLen = oldest.bytesRead;
+        hashFuture = QtConcurrent::run([this, hashBuf, hashLen]() {
+            _verifyhash.addData(hashBuf, static_cast<qint64>(hashLen));
+        });
+        hashing = true;
+        head = (head + 1) % VERIFY_READS_IN_FLIGHT;
+        inFlight--;
+        _lastVerifyNow += hashLen;
 
         // Calculate and emit verification read throughput periodically
         {
@@ -1918,84 +4224,397 @@ bool DownloadThread::_verify()
                 _verifyThroughputBytes = _lastVerifyNow.load();
                 _verifyThroughputTimer.restart();
                 emit bottleneckStateChanged(BottleneckState::Verifying, throughputKBps);
+                _emitTimeRemaining(true);
             }
         }
 
         // Allow subclasses to emit progress updates
         _onVerifyProgress();
     }
-    qFreeAligned(verifyBuf);
+
+    // No buffer may be freed while the device or the hash still uses it
+    reader->WaitForPendingReads(0);
+    if (hashing)
+        hashFuture.waitForFinished();
+    for (auto &read : reads)
+        read.mem.release();
+
+    if (readFailed)
+    {
+        DownloadThread::_onDownloadError(tr("Error reading from storage.<br>"
+                                            "SD card may be broken."));
+        return false;
+    }
 
     qDebug() << "Verify hash:" << _verifyhash.result().toHex();
     qDebug() << "Verify done in" << t1.elapsed() / 1000.0 << "seconds";
+    _emitLatencyHistogram(QStringLiteral("verifyRead"), _writeTimingStats.verifyReadLatency);
 
-    if (_verifyhash.result() == _writehash.result() || !_verifyEnabled || _cancelled)
+    if (_verifyhash.result() == _writeTreeHash.result() || !_verifyEnabled || _cancelled)
     {
         emit eventVerify(static_cast<quint32>(t1.elapsed()), true, 
-                         _writehash.result().toHex(), _verifyhash.result().toHex());
+                         _writeTreeHash.result().toHex(), _verifyhash.result().toHex());
         return true;
     }
     else
     {
         emit eventVerify(static_cast<quint32>(t1.elapsed()), false,
-                         _writehash.result().toHex(), _verifyhash.result().toHex());
+                         _writeTreeHash.result().toHex(), _verifyhash.result().toHex());
         DownloadThread::_onDownloadError(tr("Verifying write failed. Contents of SD card is different from what was written to it."));
     }
 
     return false;
 }
 
-void DownloadThread::_updateBottleneckState()
+bool DownloadThread::_verifyMappedRanges()
 {
-    // Poll for async completions to ensure callbacks fire promptly
-    // This prevents progress from jumping when completions batch up
-    if (_file) {
-        _file->PollAsyncCompletions();
+    // The last range may end past the image, its hash is complete now
+    if (_hashMappedRanges)
+        _finishMappedRangeHash();
+
+    const auto &ranges = _blockMap->ranges();
+    const std::uint64_t blockSize = _blockMap->blockSize();
+    const std::uint64_t imageSize = _file->Tell();
+    rpi_imager::FileOperations *reader = _verifyReader();
+
+    _lastVerifyNow = 0;
+    _verifyTotal = 0;
+    for (const auto &range : ranges)
+    {
+        std::uint64_t rangeStart = range.begin * blockSize;
+        std::uint64_t rangeEnd = qMin(range.end * blockSize, imageSize);
+        if (rangeEnd > rangeStart)
+            _verifyTotal += rangeEnd - rangeStart;
     }
-    
-    // Adaptive recovery: periodically check if memory conditions have changed
-    // If memory is now critically low, reduce queue depth to recover
-    // Uses instance members (not static) for thread safety across multiple DownloadThread instances
-    if (!_memoryCheckStarted) {
-        _memoryCheckTimer.start();
-        _memoryCheckStarted = true;
-    } else if (_memoryCheckTimer.elapsed() >= kMemoryCheckIntervalMs) {
-        _memoryCheckTimer.restart();
-        
-        if (_file && _file->IsAsyncIOSupported() && _file->GetAsyncQueueDepth() > 8) {
-            qint64 availableMemMB = SystemMemoryManager::instance().getAvailableMemoryMB();
-            if (availableMemMB < kCriticalMemoryMB) {
-                qDebug() << "DownloadThread: Memory critically low (" << availableMemMB 
-                         << "MB) - requesting queue depth reduction for recovery";
-                _file->ReduceQueueDepthForRecovery(_file->GetAsyncQueueDepth() / 2);
-            }
-        }
+    _verifyThroughputBytes = 0;
+    _verifyThroughputTimer.start();
+
+    const auto &limits = reader->GetDeviceIOLimits();
+    const size_t verifyAlignment = limits.BufferAlignment(4096);
+    size_t verifyBufferSize = limits.NativeIOSize(
+        SystemMemoryManager::instance().getAdaptiveVerifyBufferSize(_verifyTotal), verifyAlignment);
+    BufferPool::Buffer verifyMem = BufferPool::instance().acquire(verifyBufferSize, verifyAlignment, VERIFY_BUFFER_WAIT_MS);
+    if (!verifyMem)
+    {
+        DownloadThread::_onDownloadError(tr("Not enough memory to verify the written image."));
+        return false;
     }
-    
-    // Detect current bottleneck based on pipeline state
-    BottleneckState newState = BottleneckState::None;
-    quint32 throughputKBps = 0;
-    
-    if (_file && _file->IsAsyncIOSupported() && _file->GetAsyncQueueDepth() > 1) {
-        int pendingWrites = _file->GetPendingWriteCount();
-        int queueDepth = _file->GetAsyncQueueDepth();
-        
-        // If async queue is more than 75% full, storage is the bottleneck
-        if (pendingWrites > (queueDepth * 3 / 4)) {
-            newState = BottleneckState::Storage;
+    char *verifyBuf = verifyMem.data();
+
+    QElapsedTimer t1;
+    t1.start();
+
+    qDebug() << "Post-write verification of" << ranges.size() << "mapped ranges ("
+             << _verifyTotal/(1024*1024) << "of" << imageSize/(1024*1024) << "MB) using"
+             << verifyBufferSize/1024 << "KB buffer";
+
+    bool ok = true;
+    QByteArray expectedHex, actualHex;
+    for (const auto &range : ranges)
+    {
+        if (!_verifyEnabled || _cancelled)
+            break;
+
+        std::uint64_t pos = range.begin * blockSize;
+        std::uint64_t rangeEnd = qMin(range.end * blockSize, imageSize);
+        if (rangeEnd <= pos)
+            continue;
+
+        AcceleratedCryptographicHash rangeHash(QCryptographicHash::Sha256);
+
+        // The first block is only written after customisation; use the copy in memory
+        if (_firstBlock && pos < _firstBlockSize)
+        {
+            std::uint64_t n = qMin(rangeEnd, static_cast<std::uint64_t>(_firstBlockSize)) - pos;
+            rangeHash.addData(_firstBlock + pos, static_cast<int>(n));
+            pos += n;
+            _lastVerifyNow += n;
         }
-    }
-    
-    // Calculate current write throughput for display
-    qint64 currentBytes = _bytesWritten.load();
-    static qint64 lastThroughputBytes = 0;
-    static QElapsedTimer throughputTimer;
-    static bool throughputTimerStarted = false;
-    
-    if (!throughputTimerStarted) {
-        throughputTimer.start();
-        throughputTimerStarted = true;
-        lastThroughputBytes = currentBytes;
+
+        if (pos < rangeEnd)
+        {
+            reader->PrepareForSequentialRead(pos, rangeEnd - pos);
+            if (reader->Seek(pos) != rpi_imager::FileError::kSuccess)
+            {
+                DownloadThread::_onDownloadError(tr("Error reading from storage.<br>"
+                                                    "SD card may be broken."));
+                return false;
+            }
+        }
+
+        while (pos < rangeEnd && _verifyEnabled && !_cancelled)
+        {
+            size_t bytes_to_read = static_cast<size_t>(qMin(static_cast<std::uint64_t>(verifyBufferSize), rangeEnd - pos));
+            size_t lenRead = 0;
+            QElapsedTimer readTimer;
+            readTimer.start();
+            rpi_imager::FileError read_result = reader->ReadSequential(reinterpret_cast<std::uint8_t*>(verifyBuf), bytes_to_read, lenRead);
+            _writeTimingStats.verifyReadLatency.Record(static_cast<quint64>(readTimer.nsecsElapsed() / 1000));
+            if (read_result != rpi_imager::FileError::kSuccess || lenRead == 0)
+            {
+                DownloadThread::_onDownloadError(tr("Error reading from storage.<br>"
+                                                    "SD card may be broken."));
+                return false;
+            }
+
+            rangeHash.addData(verifyBuf, static_cast<int>(lenRead));
+            pos += lenRead;
+            _lastVerifyNow += lenRead;
+
+            qint64 elapsed = _verifyThroughputTimer.elapsed();
+            if (elapsed >= 500) {
+                qint64 bytesDelta = _lastVerifyNow.load() - _verifyThroughputBytes;
+                quint32 throughputKBps = 0;
+                if (bytesDelta > 0) {
+                    throughputKBps = static_cast<quint32>((bytesDelta * 1000) / (elapsed * 1024));
+                }
+                _verifyThroughputBytes = _lastVerifyNow.load();
+                _verifyThroughputTimer.restart();
+                emit bottleneckStateChanged(BottleneckState::Verifying, throughputKBps);
+                _emitTimeRemaining(true);
+            }
+
+            _onVerifyProgress();
+        }
+
+        if (pos < rangeEnd)
+            break;  // Cancelled
+
+        QByteArray expected(reinterpret_cast<const char *>(range.sha256.data()), static_cast<int>(range.sha256.size()));
+        QByteArray actual = rangeHash.result();
+        if (actual != expected)
+        {
+            qDebug() << "Verify: mismatch in blocks" << range.begin << "-" << range.end - 1
+                     << "expected" << expected.toHex() << "got" << actual.toHex();
+            expectedHex = expected.toHex();
+            actualHex = actual.toHex();
+            ok = false;
+            break;
+        }
+    }
+    verifyMem.release();
+
+    qDebug() << "Verify of mapped ranges" << (ok ? "passed" : "failed") << "in" << t1.elapsed() / 1000.0 << "seconds";
+    _emitLatencyHistogram(QStringLiteral("verifyRead"), _writeTimingStats.verifyReadLatency);
+
+    if (ok || !_verifyEnabled || _cancelled)
+    {
+        emit eventVerify(static_cast<quint32>(t1.elapsed()), true,
+                         _writehash.result().toHex(), QByteArray("bmap"));
+        return true;
+    }
+
+    emit eventVerify(static_cast<quint32>(t1.elapsed()), false, expectedHex, actualHex);
+    DownloadThread::_onDownloadError(tr("Verifying write failed. Contents of SD card is different from what was written to it."));
+    return false;
+}
+
+/*
+ * Sampled verify takes its checksums from the data as it is hashed, from the
+ * first block on. The boot partition is found in the first block's partition
+ * table, so it is always among the blocks read back.
+ */
+void DownloadThread::_startSampledVerify(const char *firstBlock, size_t firstBlockSize)
+{
+    if (!_verifyEnabled || _verifyCoverage >= 100.0 || _blockMap || _sampledVerify)
+        return;
+
+    // A different sample on every write, so a batch of cards covers more of the image
+    _sampledVerify = std::make_unique<SampledVerify>(_verifyCoverage, QRandomGenerator::global()->generate64());
+
+    rpi_imager::MemoryFileOperations disk;
+    if (disk.OpenDevice(rpi_imager::MemoryFileOperations::kRamdiskPrefix) != rpi_imager::FileError::kSuccess ||
+        disk.WriteAtOffset(0, reinterpret_cast<const std::uint8_t *>(firstBlock), firstBlockSize) != rpi_imager::FileError::kSuccess)
+    {
+        return;
+    }
+
+    quint64 offset, size;
+    try
+    {
+        DeviceWrapper dw(&disk);
+        dw.partitionRange(1, offset, size);
+        _sampledVerify->addRequiredRange(offset, size);
+        qDebug() << "Sampled verify:" << _verifyCoverage << "% of the image, plus boot partition at" << offset << "size" << size;
+    }
+    catch (const std::runtime_error &err)
+    {
+        qDebug() << "Sampled verify:" << _verifyCoverage << "% of the image, no boot partition:" << err.what();
+    }
+}
+
+bool DownloadThread::_verifySampledBlocks()
+{
+    // Every checksum is complete once the hashing thread is done
+    _hasher->waitAll();
+    const std::vector<SampledVerify::Block> blocks = _sampledVerify->blocks();
+
+    _lastVerifyNow = 0;
+    _verifyTotal = 0;
+    for (const auto &block : blocks)
+        _verifyTotal += block.length;
+    _verifyThroughputBytes = 0;
+    _verifyThroughputTimer.start();
+
+    rpi_imager::FileOperations *reader = _verifyReader();
+    const auto &limits = reader->GetDeviceIOLimits();
+    const size_t verifyAlignment = limits.BufferAlignment(4096);
+    BufferPool::Buffer verifyMem = BufferPool::instance().acquire(SampledVerify::kBlockSize, verifyAlignment, VERIFY_BUFFER_WAIT_MS);
+    if (!verifyMem)
+    {
+        DownloadThread::_onDownloadError(tr("Not enough memory to verify the written image."));
+        return false;
+    }
+    char *verifyBuf = verifyMem.data();
+
+    QElapsedTimer t1;
+    t1.start();
+
+    qDebug() << "Post-write verification of" << blocks.size() << "sampled blocks ("
+             << _verifyTotal/(1024*1024) << "of" << _sampledVerify->size()/(1024*1024) << "MB)";
+
+    bool ok = true;
+    QByteArray expectedHex, actualHex;
+    for (const auto &block : blocks)
+    {
+        if (!_verifyEnabled || _cancelled)
+            break;
+
+        // Whole aligned blocks suit direct I/O; the first block is only
+        // written after customisation, so that part comes from memory
+        const size_t readLen = (block.length + verifyAlignment - 1) / verifyAlignment * verifyAlignment;
+        size_t bytesRead = 0;
+        QElapsedTimer readTimer;
+        readTimer.start();
+        rpi_imager::FileError read_result = reader->ReadAtOffset(block.offset, reinterpret_cast<std::uint8_t*>(verifyBuf), readLen, bytesRead);
+        _writeTimingStats.verifyReadLatency.Record(static_cast<quint64>(readTimer.nsecsElapsed() / 1000));
+        if (read_result != rpi_imager::FileError::kSuccess || bytesRead < block.length)
+        {
+            DownloadThread::_onDownloadError(tr("Error reading from storage.<br>"
+                                                "SD card may be broken."));
+            return false;
+        }
+        if (_firstBlock && block.offset < _firstBlockSize)
+        {
+            const size_t n = static_cast<size_t>(qMin<std::uint64_t>(block.length, _firstBlockSize - block.offset));
+            ::memcpy(verifyBuf, _firstBlock + block.offset, n);
+        }
+        const quint32 crc = static_cast<quint32>(crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(verifyBuf), block.length));
+        _lastVerifyNow += block.length;
+
+        qint64 elapsed = _verifyThroughputTimer.elapsed();
+        if (elapsed >= 500) {
+            qint64 bytesDelta = _lastVerifyNow.load() - _verifyThroughputBytes;
+            quint32 throughputKBps = 0;
+            if (bytesDelta > 0) {
+                throughputKBps = static_cast<quint32>((bytesDelta * 1000) / (elapsed * 1024));
+            }
+            _verifyThroughputBytes = _lastVerifyNow.load();
+            _verifyThroughputTimer.restart();
+            emit bottleneckStateChanged(BottleneckState::Verifying, throughputKBps);
+            _emitTimeRemaining(true);
+        }
+
+        _onVerifyProgress();
+
+        if (crc != block.crc)
+        {
+            qDebug() << "Verify: mismatch in sampled block at" << block.offset
+                     << "expected" << Qt::hex << block.crc << "got" << crc;
+            expectedHex = QByteArray::number(block.crc, 16);
+            actualHex = QByteArray::number(crc, 16);
+            ok = false;
+            break;
+        }
+    }
+    verifyMem.release();
+
+    qDebug() << "Verify of sampled blocks" << (ok ? "passed" : "failed") << "in" << t1.elapsed() / 1000.0 << "seconds";
+    _emitLatencyHistogram(QStringLiteral("verifyRead"), _writeTimingStats.verifyReadLatency);
+
+    if (ok || !_verifyEnabled || _cancelled)
+    {
+        emit eventVerify(static_cast<quint32>(t1.elapsed()), true,
+                         _writehash.result().toHex(), QByteArray("sampled"));
+        return true;
+    }
+
+    emit eventVerify(static_cast<quint32>(t1.elapsed()), false, expectedHex, actualHex);
+    DownloadThread::_onDownloadError(tr("Verifying write failed. Contents of SD card is different from what was written to it."));
+    return false;
+}
+
+void DownloadThread::_onMemoryPressure(int percent)
+{
+    // A smaller queue fills sooner; a slow cache disk then leaves gaps to
+    // be filled at the end rather than holding more memory
+    if (_asyncCacheWriter)
+        _asyncCacheWriter->setQueueScale(percent);
+    if (_imageCacheWriter)
+        _imageCacheWriter->setQueueScale(percent);
+}
+
+void DownloadThread::_updateBottleneckState()
+{
+    // Poll for async completions to ensure callbacks fire promptly
+    // This prevents progress from jumping when completions batch up
+    if (_file) {
+        _file->PollAsyncCompletions();
+    }
+    
+    // Adaptive recovery: periodically check if memory conditions have changed
+    // If memory is now critically low, reduce queue depth to recover
+    // Uses instance members (not static) for thread safety across multiple DownloadThread instances
+    if (!_memoryCheckStarted) {
+        _memoryCheckTimer.start();
+        _memoryCheckStarted = true;
+    } else if (_memoryCheckTimer.elapsed() >= kMemoryCheckIntervalMs) {
+        _memoryCheckTimer.restart();
+        
+        if (_file && _file->IsAsyncIOSupported() && _file->GetAsyncQueueDepth() > 8) {
+            qint64 availableMemMB = SystemMemoryManager::instance().getAvailableMemoryMB();
+            if (availableMemMB < kCriticalMemoryMB) {
+                qDebug() << "DownloadThread: Memory critically low (" << availableMemMB 
+                         << "MB) - requesting queue depth reduction for recovery";
+                _file->ReduceQueueDepthForRecovery(_file->GetAsyncQueueDepth() / 2);
+            }
+        }
+
+        if (_memoryPressureEnabled) {
+            const int scale = MemoryPressureMonitor::instance().scalePercent();
+            if (scale != _memoryPressureScale) {
+                qDebug() << "DownloadThread: memory pressure - buffers and caches at" << scale << "% of normal";
+                _memoryPressureScale = scale;
+                _onMemoryPressure(scale);
+            }
+        }
+    }
+    
+    // Detect current bottleneck based on pipeline state
+    BottleneckState newState = BottleneckState::None;
+    quint32 throughputKBps = 0;
+    
+    if (_file && _file->IsAsyncIOSupported() && _file->GetAsyncQueueDepth() > 1) {
+        int pendingWrites = _file->GetPendingWriteCount();
+        int queueDepth = _file->GetAsyncQueueDepth();
+        LiveMetrics::instance().setAsyncQueue(queueDepth, pendingWrites);
+        
+        // If async queue is more than 75% full, storage is the bottleneck
+        if (pendingWrites > (queueDepth * 3 / 4)) {
+            newState = BottleneckState::Storage;
+        }
+    }
+    
+    // Calculate current write throughput for display
+    qint64 currentBytes = _bytesWritten.load();
+    static qint64 lastThroughputBytes = 0;
+    static QElapsedTimer throughputTimer;
+    static bool throughputTimerStarted = false;
+    
+    if (!throughputTimerStarted) {
+        throughputTimer.start();
+        throughputTimerStarted = true;
+        lastThroughputBytes = currentBytes;
     } else {
         qint64 elapsed = throughputTimer.elapsed();
         if (elapsed >= 500) {  // Update throughput every 500ms
@@ -2005,6 +4624,13 @@ void DownloadThread::_updateBottleneckState()
             }
             lastThroughputBytes = currentBytes;
             throughputTimer.restart();
+            _emitTimeRemaining(false);
+
+            LiveMetrics::instance().setWriteThroughput(static_cast<uint64_t>(throughputKBps) * 1024);
+            if (LiveMetrics::instance().enabled()) {
+                _publishLatency(QStringLiteral("write"), _writeLatencyHistogram());
+                _publishLatency(QStringLiteral("sync"), _writeTimingStats.syncLatency);
+            }
         }
     }
     
@@ -2051,17 +4677,36 @@ void DownloadThread::_periodicSync()
     if (_file && _file->IsDirectIOEnabled()) {
         return;
     }
+
+    // Where the kernel can write back ranges of the file, drain the page
+    // cache in step with the writes instead of stalling on a full sync
+    if (_rangedWritebackEnabled && _file && _file->IsRangeWritebackSupported()) {
+        _rangedWriteback();
+        return;
+    }
     
+    // One queued flush at a time; the interval restarts when it is queued
+    if (_asyncSyncPending) {
+        return;
+    }
+
     qint64 currentBytes = _bytesWritten;
     qint64 bytesSinceLastSync = currentBytes - _lastSyncBytes;
     qint64 timeSinceLastSync = _lastSyncTime.elapsed();
+
+    // Sync on an erase unit boundary, so the card does not have to commit a
+    // partly written unit that the next writes would have completed. Wait
+    // at most one more unit's worth of writes for a boundary.
+    const std::uint64_t eraseUnit = _file->GetDeviceIOLimits().erase_unit_bytes;
+    const bool midEraseUnit = eraseUnit > 0 && _file->Tell() % eraseUnit != 0 &&
+                              bytesSinceLastSync < _syncConfig.syncIntervalBytes + static_cast<qint64>(eraseUnit);
     
     // Sync if we've written more than the configured sync interval
     // OR if it's been more than the time interval since last sync
     // AND we've written at least some data since last sync
     if ((bytesSinceLastSync >= _syncConfig.syncIntervalBytes || 
          (timeSinceLastSync >= _syncConfig.syncIntervalMs && bytesSinceLastSync > 0)) &&
-        !_cancelled)
+        !midEraseUnit && !_cancelled)
     {
         QElapsedTimer syncTimer;
         syncTimer.start();
@@ -2070,44 +4715,159 @@ void DownloadThread::_periodicSync()
                  << "(" << bytesSinceLastSync << "bytes since last sync,"
                  << timeSinceLastSync << "ms elapsed)"
                  << "on" << SystemMemoryManager::instance().getPlatformName();
-        
-        // Use unified FileOperations for flushing and syncing
-        if (_file->Flush() != rpi_imager::FileError::kSuccess) {
-            quint64 syncMs = static_cast<quint64>(syncTimer.elapsed());
-            _writeTimingStats.totalSyncMs.fetch_add(syncMs);
-            _writeTimingStats.syncCount.fetch_add(1);
-            emit eventPeriodicSync(static_cast<quint32>(syncMs), false, currentBytes);
-            qDebug() << "Warning: Flush() failed during periodic sync";
+
+        // Queue the flush behind the writes instead of waiting for it here,
+        // so the writes after it can be prepared and queued meanwhile
+        if (_file->IsAsyncFlushSupported()) {
+            _asyncPeriodicSync(currentBytes);
             return;
         }
         
-        // Force filesystem sync using unified FileOperations
-        if (_file->ForceSync() != rpi_imager::FileError::kSuccess) {
+        // Flush and sync in one, where cancelling need not wait for it
+        if (_cancellableSync() != rpi_imager::FileError::kSuccess) {
             quint64 syncMs = static_cast<quint64>(syncTimer.elapsed());
             _writeTimingStats.totalSyncMs.fetch_add(syncMs);
             _writeTimingStats.syncCount.fetch_add(1);
             emit eventPeriodicSync(static_cast<quint32>(syncMs), false, currentBytes);
-            qDebug() << "Warning: ForceSync() failed during periodic sync";
+            qDebug() << "Warning: sync failed during periodic sync";
             return;
         }
         
         quint64 syncMs = static_cast<quint64>(syncTimer.elapsed());
         _writeTimingStats.totalSyncMs.fetch_add(syncMs);
         _writeTimingStats.syncCount.fetch_add(1);
+        _writeTimingStats.syncLatency.Record(static_cast<quint64>(syncTimer.nsecsElapsed() / 1000));
         
         // Track the next 5 writes after this sync to measure post-sync throughput impact
         _writeTimingStats.writesUntilNextSync.store(5);
         
+        RPI_TRACE2(sync_periodic, currentBytes, syncMs);
         emit eventPeriodicSync(static_cast<quint32>(syncMs), true, currentBytes);
+        _periodicSyncMsTotal += syncMs;
+        _periodicSyncCount++;
         
         // Update tracking variables
         _lastSyncBytes = currentBytes;
         _lastSyncTime.restart();
+        _lastSyncedOffset = _file->Tell();
         
         qDebug() << "Periodic sync completed successfully in" << syncMs << "ms";
     }
 }
 
+void DownloadThread::_asyncPeriodicSync(qint64 currentBytes)
+{
+    // The callback runs on this thread, from a later write or wait that
+    // processes completions
+    const std::uint64_t syncedOffset = _file->Tell();
+    _asyncSyncPending = true;
+    _asyncSyncTimer.start();
+    _lastSyncBytes = currentBytes;
+    _lastSyncTime.restart();
+
+    _file->AsyncFlush([this, syncedOffset, currentBytes](rpi_imager::FileError result, std::size_t) {
+        _asyncSyncPending = false;
+        quint64 syncMs = static_cast<quint64>(_asyncSyncTimer.elapsed());
+        _writeTimingStats.totalSyncMs.fetch_add(syncMs);
+        _writeTimingStats.syncCount.fetch_add(1);
+        if (result != rpi_imager::FileError::kSuccess) {
+            emit eventPeriodicSync(static_cast<quint32>(syncMs), false, currentBytes);
+            if (result != rpi_imager::FileError::kCancelled) {
+                qDebug() << "Warning: queued flush failed during periodic sync";
+            }
+            return;
+        }
+
+        _writeTimingStats.syncLatency.Record(static_cast<quint64>(_asyncSyncTimer.nsecsElapsed() / 1000));
+        _writeTimingStats.writesUntilNextSync.store(5);
+        RPI_TRACE2(sync_periodic, currentBytes, syncMs);
+        emit eventPeriodicSync(static_cast<quint32>(syncMs), true, currentBytes);
+        _periodicSyncMsTotal += syncMs;
+        _periodicSyncCount++;
+        _lastSyncedOffset = std::max(_lastSyncedOffset, syncedOffset);
+
+        if (_debugVerboseLogging) {
+            qDebug() << "Queued periodic sync at" << currentBytes << "bytes written completed in" << syncMs << "ms";
+        }
+    });
+}
+
+void DownloadThread::_rangedWriteback()
+{
+    // Only ranges whose writes have completed; async writes still in
+    // flight have not dirtied their pages yet
+    std::uint64_t written = _file->Tell();
+    auto pending = _file->GetPendingWritesSorted();
+    if (!pending.empty()) {
+        written = std::min(written, pending.front().offset);
+    }
+
+    // Queue whole erase units only; a partly written unit at the end is
+    // left for the next region, once the writes after it complete it
+    const std::uint64_t eraseUnit = _file->GetDeviceIOLimits().erase_unit_bytes;
+    if (eraseUnit > 0) {
+        written = written / eraseUnit * eraseUnit;
+    }
+
+    const std::uint64_t window = std::clamp<std::uint64_t>(
+        static_cast<std::uint64_t>(_syncConfig.syncIntervalBytes) / 4,
+        MIN_WRITEBACK_WINDOW, MAX_WRITEBACK_WINDOW);
+    if (written < _writebackStarted + window || _cancelled) {
+        return;
+    }
+
+    // Queue the newest region; this returns without waiting
+    if (_file->StartWriteback(_writebackStarted, written - _writebackStarted) != rpi_imager::FileError::kSuccess) {
+        qDebug() << "Ranged writeback failed, falling back to periodic sync";
+        _rangedWritebackEnabled = false;
+        return;
+    }
+    const std::uint64_t previousStart = _writebackStarted;
+    _writebackStarted = written;
+
+    // Wait for the older regions only when dirty data is piling up, or when
+    // the time interval is up so pipelined verify can move forward. By then
+    // the kernel has usually written them out already.
+    qint64 dirtyKB = 0, writebackKB = 0;
+    const bool pressure = SystemMemoryManager::instance().getWritebackState(dirtyKB, writebackKB) &&
+                          (dirtyKB + writebackKB) * 1024 >= _syncConfig.syncIntervalBytes;
+    const bool timeUp = _lastSyncTime.elapsed() >= _syncConfig.syncIntervalMs;
+    if ((!pressure && !timeUp) || previousStart <= _writebackWaited) {
+        return;
+    }
+
+    QElapsedTimer syncTimer;
+    syncTimer.start();
+    const qint64 currentBytes = _bytesWritten;
+    bool ok = _file->WaitWriteback(_writebackWaited, previousStart - _writebackWaited) == rpi_imager::FileError::kSuccess;
+
+    quint64 syncMs = static_cast<quint64>(syncTimer.elapsed());
+    _writeTimingStats.totalSyncMs.fetch_add(syncMs);
+    _writeTimingStats.syncCount.fetch_add(1);
+    emit eventPeriodicSync(static_cast<quint32>(syncMs), ok, currentBytes);
+    if (!ok) {
+        qDebug() << "Warning: ranged writeback wait failed, falling back to periodic sync";
+        _rangedWritebackEnabled = false;
+        return;
+    }
+
+    _writeTimingStats.syncLatency.Record(static_cast<quint64>(syncTimer.nsecsElapsed() / 1000));
+    _writeTimingStats.writesUntilNextSync.store(5);
+    _periodicSyncMsTotal += syncMs;
+    _periodicSyncCount++;
+
+    if (_debugVerboseLogging) {
+        qDebug() << "Ranged writeback: waited for" << (previousStart - _writebackWaited) / (1024 * 1024)
+                 << "MB in" << syncMs << "ms, dirty" << dirtyKB / 1024 << "MB, writeback"
+                 << writebackKB / 1024 << "MB" << (pressure ? "(pressure)" : "(interval)");
+    }
+
+    _writebackWaited = previousStart;
+    _lastSyncBytes = currentBytes;
+    _lastSyncTime.restart();
+    _lastSyncedOffset = previousStart;
+}
+
 void DownloadThread::_emitWriteTimingStats()
 {
     quint32 writeCount = _writeTimingStats.writeCount.load();
@@ -2149,147 +4909,1398 @@ void DownloadThread::_emitWriteTimingStats()
         
         emit eventWriteAfterSyncImpact(avgBefore, avgAfter, countBefore + countAfter);
     }
-    
-    qDebug() << "Write timing stats:"
-             << "writes=" << writeCount
-             << "syscall=" << _writeTimingStats.totalSyscallMs.load() << "ms"
-             << "preHashWait=" << _writeTimingStats.totalPreHashWaitMs.load() << "ms"
-             << "postHashWait=" << _writeTimingStats.totalPostHashWaitMs.load() << "ms"
-             << "sync=" << _writeTimingStats.totalSyncMs.load() << "ms"
-             << "syncCount=" << _writeTimingStats.syncCount.load()
-             << "avgSize=" << avgSize / 1024 << "KB";
+    
+    qDebug() << "Write timing stats:"
+             << "writes=" << writeCount
+             << "syscall=" << _writeTimingStats.totalSyscallMs.load() << "ms"
+             << "preHashWait=" << _writeTimingStats.totalPreHashWaitMs.load() << "ms"
+             << "postHashWait=" << _writeTimingStats.totalPostHashWaitMs.load() << "ms"
+             << "sync=" << _writeTimingStats.totalSyncMs.load() << "ms"
+             << "syncCount=" << _writeTimingStats.syncCount.load()
+             << "avgSize=" << avgSize / 1024 << "KB";
+    
+    _emitLatencyHistogram(QStringLiteral("write"), _writeLatencyHistogram());
+
+    LiveMetrics::instance().setWriteThroughput(0);
+    LiveMetrics::instance().setAsyncQueue(0, 0);
+}
+
+const rpi_imager::LatencyHistogram &DownloadThread::_writeLatencyHistogram() const
+{
+    // Async writes are timed submit-to-completion by FileOperations
+    if (_file && _file->IsAsyncIOSupported() && _file->GetAsyncQueueDepth() > 1 &&
+        _file->GetAsyncWriteLatencyHistogram().Count() > 0) {
+        return _file->GetAsyncWriteLatencyHistogram();
+    }
+    return _writeTimingStats.writeLatency;
+}
+
+void DownloadThread::_publishLatency(const QString &name, const rpi_imager::LatencyHistogram &histogram)
+{
+    if (histogram.Count() == 0) {
+        return;
+    }
+    LiveMetrics::instance().publishLatency(_filename.toStdString(), name.toStdString(), histogram.Snapshot());
+}
+
+void DownloadThread::_emitLatencyHistogram(const QString &name, const rpi_imager::LatencyHistogram &histogram)
+{
+    if (histogram.Count() == 0) {
+        return;
+    }
+    
+    const std::vector<uint64_t> counts = histogram.Snapshot();
+    QList<quint64> buckets;
+    buckets.reserve(static_cast<qsizetype>(counts.size()));
+    for (uint64_t count : counts) {
+        buckets.append(static_cast<quint64>(count));
+    }
+    emit eventLatencyHistogram(name, buckets, static_cast<quint64>(histogram.MaxUs()));
+
+    if (LiveMetrics::instance().enabled()) {
+        LiveMetrics::instance().publishLatency(_filename.toStdString(), name.toStdString(), counts);
+    }
+}
+
+void DownloadThread::_emitStageCpuTime()
+{
+    const ThreadCpuTime::Sample added = ThreadCpuTime::difference(ThreadCpuTime::sample(), _stageCpuStart);
+    const quint32 wallMs = static_cast<quint32>(_stageCpuTimer.elapsed());
+    for (size_t i = 0; i < ThreadCpuTime::StageCount; i++)
+    {
+        if (added[i].cpuUs <= 0)
+            continue;
+        const QString stage = QString::fromLatin1(ThreadCpuTime::stageName(static_cast<ThreadCpuTime::Stage>(i)));
+        const quint32 cpuMs = static_cast<quint32>(added[i].cpuUs / 1000);
+        const quint32 activeMs = static_cast<quint32>(added[i].activeUs / 1000);
+        qDebug() << "CPU time:" << stage << cpuMs << "ms over" << activeMs << "ms of thread time," << wallMs << "ms of write";
+        emit eventStageCpuTime(stage, cpuMs, activeMs, wallMs);
+    }
+}
+
+QString DownloadThread::_deviceProfileModelKey() const
+{
+    // The reader/card model as the OS describes it, plus bus and capacity,
+    // so two sizes of the same card line are profiled separately
+    const QByteArray device = PlatformQuirks::getEjectDevicePath(_filename).toLower().toUtf8();
+    for (const auto &d : Drivelist::ListStorageDevices())
+    {
+        if (QByteArray::fromStdString(d.device).toLower() != device)
+            continue;
+
+        QString model = QString::fromStdString(d.description).trimmed();
+        if (model.isEmpty())
+            return QString();
+        model = QString("%1 %2 %3GB").arg(QString::fromStdString(d.busType), model)
+                    .arg((d.size + 500000000ULL) / 1000000000ULL);
+        model.replace(QRegularExpression("[^A-Za-z0-9._-]+"), "_");
+        return "deviceprofiles/" + model;
+    }
+    return QString();
+}
+
+void DownloadThread::_loadDeviceProfile()
+{
+    _deviceProfile = DeviceProfile();
+    _sessionProfile = DeviceProfile();
+    _etaModel = EtaModel();
+    _etaClock.start();
+    _writePhaseTimer.invalidate();
+    _writeBusyUs = 0;
+    _periodicSyncMsTotal = 0;
+    _periodicSyncCount = 0;
+
+    _deviceProfileKey.clear();
+    if (rpi_imager::MemoryFileOperations::IsMemoryTarget(_filename.toStdString()))
+        return;
+
+    _deviceProfileKey = _deviceProfileModelKey();
+    QSettings settings;
+    if (_deviceProfileKey.isEmpty())
+        return;
+    // Also stored by writes that stopped at the capacity probe
+    _deviceProfile.probedCapacity = settings.value(_deviceProfileKey + "/probedCapacity").toULongLong();
+    if (!settings.contains(_deviceProfileKey + "/sessions"))
+        return;
+
+    settings.beginGroup(_deviceProfileKey);
+    _deviceProfile.sessions = settings.value("sessions").toUInt();
+    _deviceProfile.writeKBps = settings.value("writeKBps").toUInt();
+    _deviceProfile.verifyKBps = settings.value("verifyKBps").toUInt();
+    _deviceProfile.queueDepth = settings.value("queueDepth").toInt();
+    _deviceProfile.blockSize = settings.value("blockSize").toULongLong();
+    const QString directIO = settings.value("directIO").toString();
+    if (directIO == "worked")
+        _deviceProfile.directIO = DeviceProfile::DirectIO::Worked;
+    else if (directIO == "failed")
+        _deviceProfile.directIO = DeviceProfile::DirectIO::Failed;
+    _deviceProfile.periodicSyncMs = settings.value("periodicSyncMs").toUInt();
+    _deviceProfile.finalSyncMs = settings.value("finalSyncMs").toUInt();
+    _deviceProfile.unmountMs = settings.value("unmountMs").toUInt();
+    _deviceProfile.ejectMs = settings.value("ejectMs").toUInt();
+    settings.endGroup();
+
+    qDebug() << "Device profile for" << _deviceProfileKey << "from" << _deviceProfile.sessions << "earlier writes:"
+             << "write" << _deviceProfile.writeKBps << "KB/s, verify" << _deviceProfile.verifyKBps << "KB/s,"
+             << "queue depth" << _deviceProfile.queueDepth << ", direct I/O" << directIO
+             << ", sync" << _deviceProfile.periodicSyncMs << "/" << _deviceProfile.finalSyncMs << "ms,"
+             << "unmount" << _deviceProfile.unmountMs << "ms, eject" << _deviceProfile.ejectMs << "ms";
+
+    _syncConfig = SystemMemoryManager::instance().calculateSyncConfiguration(_deviceProfile);
+
+    // Open with the learned depth rather than allocating slots only to shrink the queue later
+    if (_writeTuningEnabled && _debugAsyncIO && _deviceProfile.queueDepth >= WriteAutoTuner::MinQueueDepth &&
+        _deviceProfile.queueDepth < _debugAsyncQueueDepth)
+    {
+        qDebug() << "Seeding async queue depth from device profile:" << _debugAsyncQueueDepth
+                 << "->" << _deviceProfile.queueDepth;
+        _debugAsyncQueueDepth = _deviceProfile.queueDepth;
+    }
+}
+
+void DownloadThread::_storeDeviceProfile()
+{
+    if (_deviceProfileKey.isEmpty())
+        return;
+
+    // The tuner has already stored what it learned during the write
+    DeviceProfile session = _sessionProfile;
+    session.queueDepth = 0;
+
+    DeviceProfile profile = _deviceProfile;
+    profile.merge(session);
+
+    QSettings settings;
+    settings.beginGroup(_deviceProfileKey);
+    settings.setValue("sessions", profile.sessions);
+    settings.setValue("writeKBps", profile.writeKBps);
+    settings.setValue("verifyKBps", profile.verifyKBps);
+    if (profile.directIO != DeviceProfile::DirectIO::Unknown)
+        settings.setValue("directIO", profile.directIO == DeviceProfile::DirectIO::Worked ? "worked" : "failed");
+    settings.setValue("periodicSyncMs", profile.periodicSyncMs);
+    settings.setValue("finalSyncMs", profile.finalSyncMs);
+    settings.setValue("unmountMs", profile.unmountMs);
+    settings.setValue("ejectMs", profile.ejectMs);
+    if (profile.probedCapacity)
+        settings.setValue("probedCapacity", static_cast<quint64>(profile.probedCapacity));
+    settings.endGroup();
+
+    qDebug() << "Device profile for" << _deviceProfileKey << "updated: write" << profile.writeKBps
+             << "KB/s (this write" << _sessionProfile.writeKBps << "), verify" << profile.verifyKBps
+             << "KB/s (this write" << _sessionProfile.verifyKBps << ")";
+}
+
+void DownloadThread::_emitTimeRemaining(bool verifying)
+{
+    const quint64 total = _extractTotal ? _extractTotal.load() : _lastDlTotal.load();
+    if (total == 0)
+        return;
+
+    const qint64 now = _etaClock.elapsed();
+    const quint64 written = _bytesWritten.load();
+    _etaModel.setProfile(_deviceProfile, _ejectEnabled);
+    // Once verifying, writing and everything feeding it are done
+    if (!verifying)
+    {
+        _etaModel.update(EtaModel::Stage::Download, _lastDlNow.load(), _lastDlTotal.load(), now);
+        if (_extractTotal)
+            _etaModel.update(EtaModel::Stage::Decompress, _bytesDecompressedSoFar(), _extractTotal.load(), now);
+    }
+    _etaModel.update(EtaModel::Stage::Write, verifying ? total : written, total, now);
+
+    if (_verifyEnabled && (verifying || !_debugPipelinedVerify))
+    {
+        const quint64 verifyTotal = _verifyTotal ? _verifyTotal.load() : total;
+        _etaModel.update(EtaModel::Stage::Verify, _lastVerifyNow.load(), verifyTotal, now);
+    }
+
+    const EtaModel::Estimate eta = _etaModel.estimate();
+    emit timeRemainingChanged(eta.known ? static_cast<quint32>((eta.ms + 999) / 1000) : 0,
+                              QString::fromLatin1(EtaModel::stageName(eta.limitedBy)));
+}
+
+void DownloadThread::_beginWriteTuning()
+{
+    const std::string target = _filename.toStdString();
+    // Replayed and emulated devices are there to be tuned against
+    if (!_writeTuningEnabled || (rpi_imager::MemoryFileOperations::IsMemoryTarget(target) &&
+                                 !rpi_imager::ReplayFileOperations::IsReplayTarget(target) &&
+                                 !rpi_imager::EmulatedFileOperations::IsEmulatedTarget(target)))
+        return;
+
+    const bool async = _debugAsyncIO && _file->IsAsyncIOSupported() && _file->GetAsyncQueueDepth() > 1;
+    const int maxDepth = async ? _file->GetAsyncQueueDepth() : 1;
+    const size_t maxBlockSize = SystemMemoryManager::instance().getOptimalWriteBufferSize();
+
+    _writeTunerTimer.start();
+
+    if (_deviceProfile.queueDepth > 0)
+    {
+        WriteAutoTuner::Setting learned;
+        learned.queueDepth = _deviceProfile.queueDepth;
+        learned.blockSize = static_cast<size_t>(_deviceProfile.blockSize);
+        _writeTuner.beginLearned(learned, maxDepth, maxBlockSize, _writeTunerTimer.elapsed());
+
+        const auto setting = _writeTuner.setting();
+        if (async && setting.queueDepth < _file->GetAsyncQueueDepth())
+        {
+            emit eventQueueDepthReduction(_file->GetAsyncQueueDepth(), setting.queueDepth, 0);
+            _file->ReduceQueueDepthForRecovery(setting.queueDepth);
+        }
+        qDebug() << "Write tuning: using learned queue depth" << setting.queueDepth
+                 << "and write size" << setting.blockSize << "for" << _deviceProfileKey;
+        emit eventWriteTuning(setting.queueDepth, static_cast<quint32>(setting.blockSize),
+                              _deviceProfile.writeKBps, "learned");
+    }
+    else
+    {
+        _writeTuner.begin(maxDepth, maxBlockSize, _writeTunerTimer.elapsed());
+        qDebug() << "Write tuning: probing from queue depth" << maxDepth << "and write size" << maxBlockSize
+                 << (_deviceProfileKey.isEmpty() ? "(device model unknown, not stored)" : "");
+    }
+}
+
+void DownloadThread::_updateWriteTuning(quint64 callLatencyUs)
+{
+    if (_writeTuner.state() == WriteAutoTuner::State::Idle)
+        return;
+
+    const auto decision = _writeTuner.onWrite(_bytesWritten.load(), callLatencyUs, _writeTunerTimer.elapsed());
+
+    if (decision.probeDone)
+    {
+        const auto &probe = _writeTuner.probes().back();
+        const quint32 throughputKBps = static_cast<quint32>(probe.throughputBps / 1024);
+        qDebug() << "Write tuning: queue depth" << probe.setting.queueDepth << "write size" << probe.setting.blockSize
+                 << "->" << throughputKBps << "KB/s, max latency" << probe.maxLatencyUs << "us"
+                 << (probe.writerBound ? "" : "(writer not the bottleneck)");
+        emit eventWriteTuning(probe.setting.queueDepth, static_cast<quint32>(probe.setting.blockSize), throughputKBps,
+                              QString("probe; writer_bound=%1; max_latency_us=%2")
+                                  .arg(probe.writerBound ? "true" : "false").arg(probe.maxLatencyUs));
+    }
+
+    if (!decision.apply)
+        return;
+
+    const auto setting = _writeTuner.setting();
+    if (decision.reduceDepth && _file->IsAsyncIOSupported())
+    {
+        const int currentDepth = _file->GetAsyncQueueDepth();
+        if (setting.queueDepth >= WriteAutoTuner::MinQueueDepth && setting.queueDepth < currentDepth)
+        {
+            emit eventQueueDepthReduction(currentDepth, setting.queueDepth, _file->GetPendingWriteCount());
+            _file->ReduceQueueDepthForRecovery(setting.queueDepth);
+        }
+    }
+
+    if (_writeTuner.isProbing())
+        return;
+
+    const quint32 throughputKBps = static_cast<quint32>(_writeTuner.best().throughputBps / 1024);
+    qDebug() << "Write tuning:" << decision.reason << "- queue depth" << setting.queueDepth
+             << "write size" << setting.blockSize;
+    emit eventWriteTuning(setting.queueDepth, static_cast<quint32>(setting.blockSize), throughputKBps,
+                          QString::fromLatin1(decision.reason));
+
+    // Stored straight away: a depth forced down by a stalling device is
+    // worth keeping even if this write does not finish
+    if (decision.persist && !_deviceProfileKey.isEmpty())
+    {
+        QSettings settings;
+        settings.setValue(_deviceProfileKey + "/queueDepth", setting.queueDepth);
+        settings.setValue(_deviceProfileKey + "/blockSize", static_cast<quint64>(setting.blockSize));
+        if (!settings.contains(_deviceProfileKey + "/sessions"))
+            settings.setValue(_deviceProfileKey + "/sessions", 0);
+    }
+}
+
+void DownloadThread::_waitForTunedQueueSlot()
+{
+    // Probed depths below the one the device was opened with are enforced
+    // here; a settled depth is applied to the device queue itself
+    if (!_writeTuner.isProbing())
+        return;
+
+    const int limit = _writeTuner.setting().queueDepth;
+    if (limit >= _file->GetAsyncQueueDepth())
+        return;
+
+    while (!_cancelled && _file->GetPendingWriteCount() >= limit)
+    {
+        _file->PollAsyncCompletions();
+        if (_file->GetPendingWriteCount() < limit)
+            break;
+        QThread::usleep(200);
+    }
+}
+
+size_t DownloadThread::_tunedWriteSize(size_t len) const
+{
+    const size_t blockSize = _writeTuner.setting().blockSize;
+    return (blockSize > 0 && blockSize < len) ? blockSize : len;
+}
+
+void DownloadThread::setVerifyEnabled(bool verify)
+{
+    _verifyEnabled = verify;
+}
+
+void DownloadThread::setVerifyCoverage(double percent)
+{
+    _verifyCoverage = qBound(0.0, percent, 100.0);
+}
+
+void DownloadThread::setIoTraceFile(const QString &path)
+{
+    _ioTraceFile = path;
+}
+
+void DownloadThread::setEraseBeforeWrite(bool erase)
+{
+    _eraseBeforeWrite = erase;
+}
+
+void DownloadThread::setWritePartitions(const QList<int> &partitions)
+{
+    _writePartitions = partitions;
+}
+
+bool DownloadThread::isImage()
+{
+    return true;
+}
+
+void DownloadThread::setInputBufferSize(int len)
+{
+    if (len <= 0) {
+        // Use memory-aware optimal input buffer size
+        _inputBufferSize = SystemMemoryManager::instance().getOptimalInputBufferSize();
+        qDebug() << "Using adaptive input buffer size:" << _inputBufferSize << "bytes";
+    } else {
+        _inputBufferSize = len;
+    }
+}
+
+qint64 DownloadThread::_sectorsWritten()
+{
+#ifdef Q_OS_LINUX
+    if (!_filename.startsWith("/dev/"))
+        return -1;
+
+    QFile f("/sys/class/block/"+_filename.mid(5)+"/stat");
+    if (!f.open(f.ReadOnly))
+        return -1;
+    QByteArray ioline = f.readAll().simplified();
+    f.close();
+
+    QList<QByteArray> stats = ioline.split(' ');
+
+    if (stats.count() >= 6)
+        return stats.at(6).toLongLong(); /* write sectors */
+#endif
+    return -1;
+}
+
+void DownloadThread::setImageCustomisation(const QByteArray &config, const QByteArray &cmdline, const QByteArray &firstrun, const QByteArray &cloudinit, const QByteArray &cloudInitNetwork, const QByteArray &initFormat, const ImageOptions::AdvancedOptions opts)
+{
+    _config = config;
+    _cmdline = cmdline;
+    _firstrun = firstrun;
+    _cloudinit = cloudinit;
+    _cloudinitNetwork = cloudInitNetwork;
+    _initFormat = initFormat;
+    _advancedOptions = opts;
+    qDebug() << "DownloadThread::setImageCustomisation - initFormat:" << initFormat << "cloudinit empty:" << cloudinit.isEmpty() << "cloudinitNetwork empty:" << cloudInitNetwork.isEmpty();
+}
+
+void DownloadThread::setDebugDirectIO(bool enabled)
+{
+    _debugDirectIO = enabled;
+    qDebug() << "DownloadThread: Direct I/O" << (enabled ? "enabled" : "disabled");
+}
+
+void DownloadThread::setDebugPeriodicSync(bool enabled)
+{
+    _debugPeriodicSync = enabled;
+    qDebug() << "DownloadThread: Periodic sync" << (enabled ? "enabled" : "disabled");
+}
+
+void DownloadThread::setDebugVerboseLogging(bool enabled)
+{
+    _debugVerboseLogging = enabled;
+    qDebug() << "DownloadThread: Verbose logging" << (enabled ? "enabled" : "disabled");
+}
+
+void DownloadThread::setDebugAsyncIO(bool enabled)
+{
+    _debugAsyncIO = enabled;
+    qDebug() << "DownloadThread: Async I/O" << (enabled ? "enabled" : "disabled");
+}
+
+void DownloadThread::setDebugAsyncQueueDepth(int depth)
+{
+    // Hard cap at 256 to prevent resource exhaustion
+    const int maxDepth = 256;
+    int requestedDepth = (depth < 1) ? 1 : ((depth > maxDepth) ? maxDepth : depth);
+    
+    // Memory-based sanity check: warn if queue depth would use excessive memory
+    // With 8MB write blocks, each pending write uses 8MB of ring buffer memory
+    qint64 availableMemMB = SystemMemoryManager::instance().getAvailableMemoryMB();
+    size_t writeBlockSize = SystemMemoryManager::instance().getOptimalWriteBufferSize();
+    size_t estimatedMemoryMB = (requestedDepth * writeBlockSize) / (1024 * 1024);
+    
+    if (estimatedMemoryMB > static_cast<size_t>(availableMemMB / 2)) {
+        // Queue depth would use more than 50% of available RAM - cap it
+        int safeDepth = static_cast<int>((availableMemMB * 1024 * 1024 / 2) / writeBlockSize);
+        safeDepth = qMax(4, qMin(safeDepth, requestedDepth));
+        
+        qDebug() << "DownloadThread: WARNING - Requested queue depth" << requestedDepth
+                 << "would use" << estimatedMemoryMB << "MB (only" << availableMemMB << "MB available)."
+                 << "Capping to" << safeDepth;
+        requestedDepth = safeDepth;
+    }
+    
+    _debugAsyncQueueDepth = requestedDepth;
+    qDebug() << "DownloadThread: Async queue depth set to" << _debugAsyncQueueDepth
+             << "(estimated memory:" << estimatedMemoryMB << "MB)";
+}
+
+void DownloadThread::setDebugIPv4Only(bool enabled)
+{
+    _debugIPv4Only = enabled;
+    qDebug() << "DownloadThread: IPv4-only mode" << (enabled ? "enabled" : "disabled");
+}
+
+void DownloadThread::setDebugSkipEndOfDevice(bool enabled)
+{
+    _debugSkipEndOfDevice = enabled;
+    qDebug() << "DownloadThread: Skip end-of-device operations" << (enabled ? "enabled (for counterfeit cards)" : "disabled");
+}
+
+void DownloadThread::setDebugIgnoreDeviceLimits(bool enabled)
+{
+    _debugIgnoreDeviceLimits = enabled;
+    qDebug() << "DownloadThread: Ignore device I/O limits" << (enabled ? "enabled" : "disabled");
+}
+
+void DownloadThread::setDebugParallelDownload(bool enabled)
+{
+    _debugParallelDownload = enabled;
+    qDebug() << "DownloadThread: Parallel range download" << (enabled ? "enabled" : "disabled");
+}
+
+void DownloadThread::setDebugPipelinedVerify(bool enabled)
+{
+    _debugPipelinedVerify = enabled;
+    qDebug() << "DownloadThread: Verify while writing" << (enabled ? "enabled" : "disabled");
+}
+
+void DownloadThread::_commitPipelinedVerify()
+{
+    // Mapped-range (bmap) and sampled verification read ranges out of
+    // order, so they always run after writing
+    if (!_debugPipelinedVerify || !_verifyEnabled || _blockMap || _sampledVerify || !_firstBlock || _cancelled)
+        return;
+
+    if (_file->Tell() < _verifyCommitted + PIPELINED_VERIFY_MIN_COMMIT)
+        return;
+
+    const std::uint64_t durable = _durableOffset();
+    if (durable < _verifyCommitted + PIPELINED_VERIFY_MIN_COMMIT)
+        return;
+
+    if (!_pipelinedVerifier)
+    {
+        size_t bufferSize = _file->GetDeviceIOLimits().NativeIOSize(
+            SystemMemoryManager::instance().getAdaptiveVerifyBufferSize(_extractTotal.load()), 4096);
+        _pipelinedVerifier = std::make_unique<PipelinedVerifier>(_file.get(), _verifyhash,
+                                                                 _firstBlock, _firstBlockSize, bufferSize);
+        _pipelinedVerifier->start(QThread::LowPriority);
+        _verifyCommitted = _firstBlockSize;
+        qDebug() << "Pipelined verify: started using" << bufferSize/1024 << "KB buffer";
+    }
+
+    // Drop the written pages from the cache so the read-back comes from the device
+    _file->PrepareForSequentialRead(_verifyCommitted, durable - _verifyCommitted);
+    _pipelinedVerifier->commit(durable);
+    _verifyCommitted = durable;
+}
+
+std::uint64_t DownloadThread::_durableOffset()
+{
+    if (_file->IsDirectIOEnabled())
+    {
+        // No page cache involved: everything before the oldest write still
+        // in flight has reached the device
+        auto pending = _file->GetPendingWritesSorted();
+        return pending.empty() ? _file->Tell() : pending.front().offset;
+    }
+    return _lastSyncedOffset;
+}
+
+void DownloadThread::_prepareResume()
+{
+    _resumeOffset = 0;
+    _resumeSourceOffset = 0;
+    _resumeFirstBlock.clear();
+    _journalKey.clear();
+
+    // The journal follows the image in stream order, which sparse (bmap)
+    // writes and skipped zeros do not keep on the device. Additional
+    // devices are not journalled.
+    std::uint64_t deviceSize = 0;
+    if (!_resumeEnabled || _expectedHash.isEmpty() || !_bmapUrl.isEmpty() || !_fanOutDevices.isEmpty() ||
+        !_writePartitions.isEmpty() || _deviceProfileKey.isEmpty() ||
+        _file->GetSize(deviceSize) != rpi_imager::FileError::kSuccess)
+    {
+        return;
+    }
+
+    _journalKey = "writejournal/" + _deviceProfileKey.section('/', 1);
+    const QByteArray deviceId = _deviceProfileKey.toUtf8() + "/" + QByteArray::number(static_cast<quint64>(deviceSize));
+
+    QSettings settings;
+    WriteJournal stored;
+    if (stored.load(settings, _journalKey) && stored.matches(_expectedHash, deviceId))
+    {
+        emit preparationStatusUpdate(tr("Checking previously written data..."));
+        const int ranges = _verifyJournalTail(stored);
+        if (ranges >= RESUME_MIN_RANGES)
+            _resumeOffset = static_cast<std::uint64_t>(ranges) * WriteJournal::kRangeSize;
+        else
+            qDebug() << "Write journal does not match the device, writing from the start";
+    }
+
+    _journal.start(_expectedHash, deviceId);
+    if (!_resumeOffset)
+    {
+        // Whatever an earlier write left is being overwritten
+        WriteJournal::remove(settings, _journalKey);
+        return;
+    }
+
+    // Already on the device, so neither synced nor queued for writeback again
+    _lastSyncedOffset = _resumeOffset;
+    _writebackStarted = _resumeOffset;
+    _writebackWaited = _resumeOffset;
+
+    const QByteArray firstBlock = stored.firstBlock();
+    if (!firstBlock.isEmpty() && firstBlock.size() % 4096 == 0 &&
+        static_cast<std::uint64_t>(firstBlock.size()) < _resumeOffset &&
+        (_url.startsWith("http://") || _url.startsWith("https://")))
+    {
+        _resumeFirstBlock = firstBlock;
+        _resumeSourceOffset = _resumeOffset;
+
+        // The caches would be missing the part that is not downloaded again
+        _cacheEnabled = false;
+        if (_asyncCacheWriter)
+            _asyncCacheWriter->cancel();
+        if (_imageCacheWriter)
+        {
+            _imageCacheWriter->cancel();
+            _imageCacheWriter.reset();
+        }
+    }
+
+    qDebug() << "Resuming interrupted write at" << _resumeOffset / (1024 * 1024) << "MB"
+             << (_resumeSourceOffset ? "(download starts there too)" : "(source is read from the start)");
+    emit preparationStatusUpdate(tr("Resuming write at %1 GB...")
+                                     .arg(static_cast<double>(_resumeOffset) / (1024.0 * 1024 * 1024), 0, 'f', 1));
+}
+
+/*
+ * Reads the last ranges the journal holds back from the device and returns
+ * how many ranges, from the start, can be trusted. A range at the end that
+ * does not match is dropped, as it may have been torn by the interruption;
+ * a mismatch below a matching range means the device was written since.
+ *
+ * Range 0 is never read back: its first block is only written at the end.
+ * Until then the partition table is blank, which is checked instead, and
+ * catches a device that was formatted or written by something else.
+ */
+int DownloadThread::_verifyJournalTail(const WriteJournal &journal)
+{
+    BufferPool::Buffer mem = BufferPool::instance().acquire(RESUME_READ_SIZE, 4096, VERIFY_BUFFER_WAIT_MS);
+    if (!mem)
+        return 0;
+    auto *buf = reinterpret_cast<std::uint8_t *>(mem.data());
+
+    size_t bytesRead = 0;
+    if (_file->ReadAtOffset(0, buf, 4096, bytesRead) != rpi_imager::FileError::kSuccess || bytesRead != 4096 ||
+        !std::all_of(buf, buf + 512, [](std::uint8_t b) { return b == 0; }))
+    {
+        qDebug() << "Device has a partition table, not resuming";
+        return 0;
+    }
+
+    int count = journal.rangeCount();
+    int matched = 0;
+    int dropped = 0;
+    while (matched < RESUME_SPOT_CHECK_RANGES && count - 1 - matched >= 1 && !_cancelled)
+    {
+        const int index = count - 1 - matched;
+        const std::uint64_t offset = static_cast<std::uint64_t>(index) * WriteJournal::kRangeSize;
+        _file->PrepareForSequentialRead(offset, WriteJournal::kRangeSize);
+
+        quint32 crc = WriteJournal::checksum(nullptr, 0);
+        bool readOk = true;
+        for (std::uint64_t pos = 0; pos < WriteJournal::kRangeSize && readOk; pos += RESUME_READ_SIZE)
+        {
+            readOk = _file->ReadAtOffset(offset + pos, buf, RESUME_READ_SIZE, bytesRead) == rpi_imager::FileError::kSuccess
+                     && bytesRead == RESUME_READ_SIZE;
+            if (readOk)
+                crc = WriteJournal::checksum(reinterpret_cast<const char *>(buf), RESUME_READ_SIZE, crc);
+        }
+
+        if (readOk && crc == journal.rangeChecksum(index))
+        {
+            matched++;
+            continue;
+        }
+
+        qDebug() << "Write journal range" << index << "does not match the device";
+        if (matched > 0 || ++dropped > RESUME_SPOT_CHECK_RANGES)
+            return 0;
+        count--;
+    }
+
+    return _cancelled ? 0 : count;
+}
+
+bool DownloadThread::_skipResumedData(const char *buf, size_t len)
+{
+    // Keep the image hash in order: previous writes are hashed first
+    _hasher->waitAll();
+    _hashData(buf, len);
+
+    if (_file->Seek(_file->Tell() + len) != rpi_imager::FileError::kSuccess)
+        return false;
+    _bytesWritten += len;
+    return true;
+}
+
+/*
+ * Delta write: read back what the device holds where buf is going and only
+ * write the blocks that differ, which saves most of the writing when a card
+ * is re-flashed with the same image or a newer release of it. Unchanged
+ * runs are treated like resumed data: hashed in order and seeked over, so
+ * the image hash, the journal and verification still cover every byte.
+ *
+ * A card that holds something else costs reading back a little more than
+ * DELTA_GIVE_UP_CHANGED_BYTES, after which delta writes are given up for
+ * the rest of the write.
+ */
+size_t DownloadThread::_writeFileDelta(const char *buf, size_t len, WriteCompleteCallback onComplete)
+{
+    // As in _writeFileSparse(), the caller's buffer is released once every
+    // changed run has been written
+    auto pending = std::make_shared<std::atomic<int>>(1);
+    WriteCompleteCallback partDone;
+    if (onComplete)
+    {
+        partDone = [pending, onComplete]() {
+            if (pending->fetch_sub(1) == 1)
+                onComplete();
+        };
+    }
+
+    size_t changedFrom = len;   // Start of a changed run not written yet
+    auto writeChanged = [&](size_t end) {
+        if (changedFrom >= end)
+            return true;
+        const size_t runLen = end - changedFrom;
+        if (partDone)
+            pending->fetch_add(1);
+        _deltaWriting = true;
+        const bool ok = _writeFile(buf + changedFrom, runLen, partDone) == runLen;
+        _deltaWriting = false;
+        changedFrom = len;
+        return ok;
+    };
+
+    BufferPool::Buffer mem = BufferPool::instance().acquire(DELTA_READ_SIZE, 4096, VERIFY_BUFFER_WAIT_MS);
+    const char *device = mem.data();
+    const std::uint64_t start = _file->Tell();
+    bool ok = true;
+    size_t pos = 0;
+    while (ok && pos < len && !_cancelled)
+    {
+        const size_t n = qMin(DELTA_READ_SIZE, len - pos);
+        size_t bytesRead = 0;
+        if (!mem || _file->ReadAtOffset(start + pos, reinterpret_cast<std::uint8_t *>(mem.data()), n, bytesRead)
+                        != rpi_imager::FileError::kSuccess || bytesRead != n)
+        {
+            qDebug() << "Delta write: reading back failed at offset" << start + pos << "- writing everything";
+            _deltaActive = false;
+            break;
+        }
+
+        for (size_t block = 0; ok && block < n; )
+        {
+            const bool same = ::memcmp(buf + pos + block, device + block, DELTA_BLOCK_SIZE) == 0;
+            size_t runEnd = block + DELTA_BLOCK_SIZE;
+            while (runEnd < n && (::memcmp(buf + pos + runEnd, device + runEnd, DELTA_BLOCK_SIZE) == 0) == same)
+                runEnd += DELTA_BLOCK_SIZE;
+
+            if (!same)
+            {
+                if (changedFrom == len)
+                    changedFrom = pos + block;
+            }
+            else
+            {
+                ok = writeChanged(pos + block) && _skipResumedData(buf + pos + block, runEnd - block);
+                _deltaUnchangedBytes += runEnd - block;
+            }
+            block = runEnd;
+        }
+        _deltaComparedBytes += n;
+        pos += n;
+
+        if (_deltaComparedBytes - _deltaUnchangedBytes >= DELTA_GIVE_UP_CHANGED_BYTES &&
+            _deltaUnchangedBytes * 100 < _deltaComparedBytes * DELTA_MIN_UNCHANGED_PERCENT)
+        {
+            qDebug() << "Delta write: only" << _deltaUnchangedBytes / (1024 * 1024) << "MB of"
+                     << _deltaComparedBytes / (1024 * 1024) << "MB unchanged, writing the rest as usual";
+            _deltaActive = false;
+            break;
+        }
+    }
+
+    // Whatever was not compared is written as it is
+    if (ok && pos < len && changedFrom == len)
+        changedFrom = pos;
+    if (ok)
+        ok = writeChanged(len);
+
+    // Also done by _writeFile(), which a run of unchanged buffers never reaches
+    _commitPipelinedVerify();
+    _saveJournal();
+
+    if (partDone)
+        partDone();
+    return ok ? len : 0;
+}
+
+/*
+ * For a download that starts at _resumeOffset: feed the hashes with the
+ * part of the image before it, taking the first block from the journal and
+ * the rest from the device, and move the write position past it.
+ */
+bool DownloadThread::_replayResumedPrefix()
+{
+    _firstBlockSize = static_cast<size_t>(_resumeFirstBlock.size());
+    _firstBlock = static_cast<char *>(qMallocAligned(_firstBlockSize, 4096));
+    if (!_firstBlock)
+        return false;
+    ::memcpy(_firstBlock, _resumeFirstBlock.constData(), _firstBlockSize);
+    _resumeFirstBlock.clear();
+    _journal.setFirstBlock(_firstBlock, _firstBlockSize);
+    _startSampledVerify(_firstBlock, _firstBlockSize);
+    _hashData(_firstBlock, _firstBlockSize);
+
+    BufferPool::Buffer mem = BufferPool::instance().acquire(RESUME_READ_SIZE, 4096, VERIFY_BUFFER_WAIT_MS);
+    if (!mem)
+        return false;
+    auto *buf = reinterpret_cast<std::uint8_t *>(mem.data());
+
+    emit preparationStatusUpdate(tr("Reading back previously written data..."));
+    _file->PrepareForSequentialRead(_firstBlockSize, _resumeOffset - _firstBlockSize);
+    for (std::uint64_t pos = _firstBlockSize; pos < _resumeOffset; )
+    {
+        if (_cancelled)
+            return false;
+
+        const size_t len = static_cast<size_t>(qMin<std::uint64_t>(RESUME_READ_SIZE, _resumeOffset - pos));
+        size_t bytesRead = 0;
+        if (_file->ReadAtOffset(pos, buf, len, bytesRead) != rpi_imager::FileError::kSuccess || bytesRead != len)
+        {
+            qDebug() << "Reading back resumed data failed at offset" << pos;
+            return false;
+        }
+        _hashData(reinterpret_cast<const char *>(buf), len);
+        _bytesWritten += len;
+        pos += len;
+    }
+
+    return _file->Seek(_resumeOffset) == rpi_imager::FileError::kSuccess;
+}
+
+void DownloadThread::_saveJournal()
+{
+    if (_journalKey.isEmpty())
+        return;
+
+    const std::uint64_t durable = _durableOffset();
+    if (!_journal.hasUnsavedRanges(durable))
+        return;
+
+    QSettings settings;
+    _journal.save(settings, _journalKey, durable);
+}
+
+void DownloadThread::_removeJournal()
+{
+    if (_journalKey.isEmpty())
+        return;
+
+    QSettings settings;
+    WriteJournal::remove(settings, _journalKey);
+    _journalKey.clear();
+}
+
+void DownloadThread::setBmapUrl(const QByteArray &url)
+{
+    _bmapUrl = url;
+}
+
+void DownloadThread::setPeerUrls(const QList<QByteArray> &urls)
+{
+    _peerUrls = urls;
+}
+
+void DownloadThread::setMirrorUrls(const QList<QByteArray> &urls)
+{
+    _mirrorUrls = urls;
+}
+
+void DownloadThread::setPrefetchedPrefix(const QString &fileName)
+{
+    _prefetchedFile = fileName;
+}
+
+/*
+ * Feed the data of _prefetchedFile to _writeData(), as if it had just been
+ * downloaded. offset is left at 0 (and nothing fed) if the server cannot
+ * continue from where the prefetch stopped.
+ */
+bool DownloadThread::_replayPrefetchedPrefix(std::uint64_t &offset)
+{
+    QFile file(_prefetchedFile);
+    const qint64 size = file.size();
+    offset = 0;
+
+    QByteArray effectiveUrl;
+    curl_off_t contentLength = 0;
+    if (size > 0)
+        _probeRangeSupport(effectiveUrl, contentLength);
+    if (size <= 0 || !_acceptRanges || contentLength <= static_cast<curl_off_t>(size) || !file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Not using the" << size << "bytes downloaded in the background";
+        file.remove();
+        return true;
+    }
+
+    emit preparationStatusUpdate(tr("Processing data downloaded in the background..."));
+    QByteArray buf(static_cast<qsizetype>(RESUME_READ_SIZE), Qt::Uninitialized);
+    while (!_cancelled)
+    {
+        const qint64 len = file.read(buf.data(), buf.size());
+        if (len <= 0)
+            break;
+        if (_writeData(buf.constData(), static_cast<size_t>(len)) != static_cast<size_t>(len))
+            return false;
+        offset += static_cast<std::uint64_t>(len);
+    }
+    file.close();
+    file.remove();
+    return !_cancelled;
+}
+
+void DownloadThread::_loadBlockMap()
+{
+    if (_bmapUrl.isEmpty())
+        return;
+
+    // Additional devices verify by reading back the whole device
+    if (!_fanOutDevices.isEmpty())
+    {
+        qDebug() << "bmap: not used when writing to multiple devices";
+        return;
+    }
+
+    emit preparationStatusUpdate(tr("Fetching block map..."));
+    qDebug() << "bmap: fetching" << _bmapUrl;
+
+    // Synchronous fetch — bmap files are tiny (few KB)
+    std::string responseData;
+    CURLcode res = CURLE_FAILED_INIT;
+    CURL *curl = curl_easy_init();
+    if (curl)
+    {
+        auto writeCallback = +[](char *ptr, size_t size, size_t nmemb, void *userdata) -> size_t {
+            static_cast<std::string*>(userdata)->append(ptr, size * nmemb);
+            return size * nmemb;
+        };
+        curl_easy_setopt(curl, CURLOPT_URL, _bmapUrl.constData());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseData);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+        CurlNetworkConfig::instance().applyShare(curl);
+        if (!_useragent.isEmpty())
+            curl_easy_setopt(curl, CURLOPT_USERAGENT, _useragent.constData());
+        if (!_proxy.isEmpty())
+            curl_easy_setopt(curl, CURLOPT_PROXY, _proxy.constData());
+        res = curl_easy_perform(curl);
+        curl_easy_cleanup(curl);
+    }
+    if (res != CURLE_OK || responseData.empty())
+    {
+        qWarning() << "bmap: fetch failed:" << curl_easy_strerror(res) << "- writing full image";
+        return;
+    }
+
+    auto blockMap = std::make_unique<fastboot::BlockMap>();
+    std::string parseError;
+    if (!blockMap->parse(responseData, &parseError) || blockMap->empty())
+    {
+        qWarning() << "bmap: parse failed:" << QString::fromStdString(parseError) << "- writing full image";
+        return;
+    }
+
+    // A bmap for a different image would leave data unwritten
+    std::uint64_t mapSize = blockMap->blockCount() * blockMap->blockSize();
+    std::uint64_t imageSize = _extractTotal.load();
+    if (imageSize && (mapSize < imageSize || mapSize >= imageSize + blockMap->blockSize()))
+    {
+        qWarning() << "bmap: covers" << mapSize << "bytes but image is" << imageSize << "- writing full image";
+        return;
+    }
+
+    // Without per-range checksums the skipped ranges cannot be verified
+    if (_verifyEnabled && !blockMap->hasChecksums())
+    {
+        qWarning() << "bmap: no SHA-256 checksums, needed for verification - writing full image";
+        return;
+    }
+
+    qDebug() << "bmap: loaded —" << blockMap->mappedBlockCount() << "of" << blockMap->blockCount()
+             << "blocks mapped (" << (100 * blockMap->mappedBlockCount() / std::max<uint64_t>(blockMap->blockCount(), 1))
+             << "%)";
+    // Corrupt data is caught range by range, not only by the image hash
+    _hashMappedRanges = blockMap->hasChecksums();
+    _mappedHashCursor = 0;
+    _mappedRangeHash.reset();
+    _blockMap = std::move(blockMap);
+}
+
+void DownloadThread::setBlockMap(std::unique_ptr<fastboot::BlockMap> map)
+{
+    // Additional devices verify by reading back the whole device
+    if (!_fanOutDevices.isEmpty())
+    {
+        qDebug() << "Block map: not used when writing to multiple devices";
+        return;
+    }
+
+    qDebug() << "Block map:" << map->mappedBlockCount() << "of" << map->blockCount() << "blocks in use";
+    _streamBlockMapper.reset();
+    _hashMappedRanges = _verifyEnabled && !map->hasChecksums();
+    _mappedHashCursor = 0;
+    _mappedRangeHash.reset();
+    _blockMap = std::move(map);
+}
+
+/*
+ * Skip the free space of the image's file systems when there is no .bmap.
+ * Its blocks are only known once the FAT or the ext bitmaps have streamed
+ * past, so the map grows in _writeFileSparse() as the data arrives.
+ */
+void DownloadThread::_startBlockMapping()
+{
+    // Additional devices verify by reading back the whole device, and the
+    // write journal needs every block on the device in stream order
+    if (!_mapUsedBlocks || !_fanOutDevices.isEmpty() || !_journalKey.isEmpty())
+        return;
+
+    qDebug() << "Block map: finding used blocks while writing";
+    _hashMappedRanges = _verifyEnabled;
+    _mappedHashCursor = 0;
+    _mappedRangeHash.reset();
+    _blockMap = std::make_unique<fastboot::BlockMap>();
+
+    // Not given the image size from the OS list, as a short one would
+    // leave the end of the image unmapped
+    _streamBlockMapper = std::make_unique<StreamingBlockMapper>(_blockMap.get(), 0);
+}
+
+/*
+ * Partial writes: until the first block has passed, the map is empty and
+ * nothing is written. Without checksums in the map, the ranges are hashed
+ * as they are written, so only they are verified.
+ */
+void DownloadThread::_startPartitionMapping()
+{
+    qDebug() << "Partial write: writing partitions" << _writePartitions;
+    _hashMappedRanges = _verifyEnabled;
+    _mappedHashCursor = 0;
+    _mappedRangeHash.reset();
+    _blockMap = std::make_unique<fastboot::BlockMap>();
+}
+
+/*
+ * Map the partitions to write, from the partition table at the start of the
+ * image. The device keeps its own partition table, so each partition has
+ * to start at the same offset on the device and be at least as large there
+ * (a root file system grown on first boot is fine).
+ */
+bool DownloadThread::_mapWritePartitions(const char *buf, size_t len)
+{
+    const std::uint64_t blockSize = UsedBlockScanner::kBlockSize;
+    const std::uint64_t imageSize = _extractTotal.load() ? _extractTotal.load()
+                                                         : std::numeric_limits<std::uint64_t>::max();
+    auto readFrom = [](const char *data, size_t size) {
+        return [data, size](std::uint64_t offset, char *out, size_t n) {
+            if (offset > size || n > size - offset)
+                return false;
+            ::memcpy(out, data + offset, n);
+            return true;
+        };
+    };
+
+    std::vector<UsedBlockScanner::Partition> imageParts;
+    if (!UsedBlockScanner::readPartitions(readFrom(buf, len), imageSize, imageParts))
+    {
+        DownloadThread::_onDownloadError(tr("The image has no partition table that could be read, "
+                                            "so single partitions cannot be written."));
+        return false;
+    }
+
+    std::uint64_t deviceSize = 0;
+    size_t headRead = 0;
+    BufferPool::Buffer head = BufferPool::instance().acquire(PARTITION_TABLE_READ_SIZE, 4096, VERIFY_BUFFER_WAIT_MS);
+    std::vector<UsedBlockScanner::Partition> deviceParts;
+    if (!head || _file->GetSize(deviceSize) != rpi_imager::FileError::kSuccess ||
+        _file->ReadAtOffset(0, reinterpret_cast<std::uint8_t *>(head.data()), PARTITION_TABLE_READ_SIZE, headRead)
+            != rpi_imager::FileError::kSuccess ||
+        !UsedBlockScanner::readPartitions(readFrom(head.data(), headRead), deviceSize, deviceParts))
+    {
+        DownloadThread::_onDownloadError(tr("The partition table of the storage device could not be read. "
+                                            "Write the whole image instead."));
+        return false;
+    }
+
+    std::vector<fastboot::BlockRange> ranges;
+    for (int number : std::as_const(_writePartitions))
+    {
+        auto byNumber = [number](const UsedBlockScanner::Partition &part) { return part.number == number; };
+        const auto image = std::find_if(imageParts.begin(), imageParts.end(), byNumber);
+        const auto device = std::find_if(deviceParts.begin(), deviceParts.end(), byNumber);
+        if (image == imageParts.end())
+        {
+            DownloadThread::_onDownloadError(tr("The image has no partition %1.").arg(number));
+            return false;
+        }
+        if (device == deviceParts.end() || device->start != image->start ||
+            device->end - device->start < image->end - image->start)
+        {
+            DownloadThread::_onDownloadError(tr("Partition %1 of the storage device does not match the image. "
+                                                "Write the whole image instead.").arg(number));
+            return false;
+        }
+        // Whole blocks only, so no neighbouring partition is touched
+        if (image->start % blockSize || (image->end % blockSize && image->end != imageSize))
+        {
+            DownloadThread::_onDownloadError(tr("Partition %1 of the image is not aligned to 4 KB, "
+                                                "so it cannot be written on its own.").arg(number));
+            return false;
+        }
+
+        fastboot::BlockRange range{};
+        range.begin = image->start / blockSize;
+        range.end = (image->end + blockSize - 1) / blockSize;
+        ranges.push_back(range);
+    }
+
+    std::sort(ranges.begin(), ranges.end(),
+              [](const fastboot::BlockRange &a, const fastboot::BlockRange &b) { return a.begin < b.begin; });
+    ranges.erase(std::unique(ranges.begin(), ranges.end(),
+                             [](const fastboot::BlockRange &a, const fastboot::BlockRange &b) { return a.begin == b.begin; }),
+                 ranges.end());
+
+    const std::uint64_t blockCount = _extractTotal.load() ? (imageSize + blockSize - 1) / blockSize
+                                                          : ranges.back().end;
+    _blockMap->assign(blockSize, blockCount, std::move(ranges));
+    qDebug() << "Partial write:" << _blockMap->mappedBlockCount() * blockSize / (1024 * 1024) << "MB in"
+             << _blockMap->ranges().size() << "partitions";
+    return true;
+}
+
+/*
+ * The held-back first block holds the image's partition table, which a
+ * partial write leaves out; only the parts of it inside the partitions
+ * being written go to the device.
+ */
+bool DownloadThread::_writeFirstBlockPartitions()
+{
+    if (!_firstBlock)
+        return true;
+
+    rpi_imager::FileError result = rpi_imager::FileError::kSuccess;
+    const std::uint64_t blockSize = _blockMap->blockSize();
+    for (const auto &range : _blockMap->ranges())
+    {
+        const std::uint64_t start = range.begin * blockSize;
+        const std::uint64_t end = qMin<std::uint64_t>(range.end * blockSize, _firstBlockSize);
+        if (start >= end)
+            break;
+        result = _file->Seek(start);
+        if (result == rpi_imager::FileError::kSuccess)
+            result = _file->WriteSequential(reinterpret_cast<const std::uint8_t *>(_firstBlock) + start, end - start);
+        if (result != rpi_imager::FileError::kSuccess)
+            break;
+    }
+    if (result == rpi_imager::FileError::kSuccess)
+        result = _file->Flush();
+
+    qFreeAligned(_firstBlock);
+    _firstBlock = nullptr;
+    if (result != rpi_imager::FileError::kSuccess)
+    {
+        DownloadThread::_onDownloadError(_fileErrorToString(result, tr("writing partitions")));
+        return false;
+    }
+    _bytesWritten += _firstBlockSize;
+    return true;
 }
 
-void DownloadThread::setVerifyEnabled(bool verify)
+/*
+ * Hash the mapped parts of data written at offset, one SHA-256 per range.
+ * Data arrives in order, so a range is complete once data past it arrives.
+ */
+void DownloadThread::_hashMappedData(std::uint64_t offset, const char *buf, size_t len)
 {
-    _verifyEnabled = verify;
+    const auto &ranges = _blockMap->ranges();
+    const std::uint64_t blockSize = _blockMap->blockSize();
+    const std::uint64_t end = offset + len;
+
+    std::uint64_t pos = offset;
+    while (pos < end && _mappedHashCursor < ranges.size())
+    {
+        const std::uint64_t rangeStart = ranges[_mappedHashCursor].begin * blockSize;
+        const std::uint64_t rangeEnd = ranges[_mappedHashCursor].end * blockSize;
+        if (pos >= rangeEnd)
+        {
+            _finishMappedRangeHash();
+            continue;
+        }
+        if (pos < rangeStart)
+        {
+            pos = qMin(end, rangeStart);
+            continue;
+        }
+
+        const std::uint64_t runEnd = qMin(end, rangeEnd);
+        if (!_mappedRangeHash)
+        {
+            _mappedRangeHash = std::make_unique<AcceleratedCryptographicHash>(QCryptographicHash::Sha256);
+            // Not so after a resume, which starts part way into the image
+            _mappedRangeWhole = pos == rangeStart;
+        }
+        _mappedRangeHash->addData(buf + (pos - offset), static_cast<int>(runEnd - pos));
+        pos = runEnd;
+        if (pos == rangeEnd)
+            _finishMappedRangeHash();
+    }
 }
 
-bool DownloadThread::isImage()
+void DownloadThread::_finishMappedRangeHash()
 {
-    return true;
+    if (_mappedHashCursor >= _blockMap->ranges().size())
+        return;
+
+    if (_mappedRangeHash)
+    {
+        const QByteArray digest = _mappedRangeHash->result();
+        std::array<std::uint8_t, 32> sha256{};
+        memcpy(sha256.data(), digest.constData(), qMin<size_t>(digest.size(), sha256.size()));
+        const fastboot::BlockRange &range = _blockMap->ranges()[_mappedHashCursor];
+        if (!range.hasSha256)
+        {
+            _blockMap->setChecksum(_mappedHashCursor, sha256);
+        }
+        else if (_mappedRangeWhole && range.sha256 != sha256)
+        {
+            qWarning() << "bmap: checksum mismatch in blocks" << range.begin << "to" << range.end - 1;
+            DownloadThread::_onDownloadError(tr("The downloaded image does not match its block map (blocks %1 to %2). "
+                                                "The download may be corrupt, please try again.")
+                                                 .arg(range.begin).arg(range.end - 1));
+        }
+        _mappedRangeHash.reset();
+    }
+    _mappedHashCursor++;
 }
 
-void DownloadThread::setInputBufferSize(int len)
+void DownloadThread::addFanOutTarget(const QByteArray &device)
 {
-    if (len <= 0) {
-        // Use memory-aware optimal input buffer size
-        _inputBufferSize = SystemMemoryManager::instance().getOptimalInputBufferSize();
-        qDebug() << "Using adaptive input buffer size:" << _inputBufferSize << "bytes";
-    } else {
-        _inputBufferSize = len;
-    }
+    _fanOutDevices.append(device);
+    qDebug() << "DownloadThread: Additional target device" << device;
 }
 
-qint64 DownloadThread::_sectorsWritten()
+void DownloadThread::_startFanOutTargets()
 {
-#ifdef Q_OS_LINUX
-    if (!_filename.startsWith("/dev/"))
-        return -1;
+    if (_fanOutDevices.isEmpty())
+        return;
 
-    QFile f("/sys/class/block/"+_filename.mid(5)+"/stat");
-    if (!f.open(f.ReadOnly))
-        return -1;
-    QByteArray ioline = f.readAll().simplified();
-    f.close();
+    // Additional devices use the same I/O mode as the primary device, but
+    // each gets its own queue, so depth is capped by its own device limits
+    const int queueDepth = _debugAsyncIO ? _debugAsyncQueueDepth : 1;
+    const bool directIO = _debugDirectIO;
+    const bool skipEndOfDevice = _debugSkipEndOfDevice;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(kFanOutPrepareTimeoutSeconds);
 
-    QList<QByteArray> stats = ioline.split(' ');
+    for (const QByteArray &device : std::as_const(_fanOutDevices))
+    {
+        auto target = std::make_shared<FanOutTarget>(device);
+        std::promise<bool> opened;
+        _pendingFanOutTargets.push_back({target, opened.get_future(), deadline});
 
-    if (stats.count() >= 6)
-        return stats.at(6).toLongLong(); /* write sectors */
+        // Detached, and holding its own reference: a device that hangs in
+        // unmount or clean must not hold up the others or our teardown
+        std::thread([target, opened = std::move(opened), directIO, queueDepth, skipEndOfDevice]() mutable {
+#ifdef Q_OS_WIN
+            DWORD oldMode;
+            if (!SetThreadErrorMode(SEM_FAILCRITICALERRORS | SEM_NOOPENFILEERRORBOX, &oldMode)) {
+                SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOOPENFILEERRORBOX);
+            }
 #endif
-    return -1;
+            opened.set_value(target->open(directIO, queueDepth, skipEndOfDevice));
+        }).detach();
+    }
 }
 
-void DownloadThread::setImageCustomisation(const QByteArray &config, const QByteArray &cmdline, const QByteArray &firstrun, const QByteArray &cloudinit, const QByteArray &cloudInitNetwork, const QByteArray &initFormat, const ImageOptions::AdvancedOptions opts)
+bool DownloadThread::_openFanOutTargets()
 {
-    _config = config;
-    _cmdline = cmdline;
-    _firstrun = firstrun;
-    _cloudinit = cloudinit;
-    _cloudinitNetwork = cloudInitNetwork;
-    _initFormat = initFormat;
-    _advancedOptions = opts;
-    qDebug() << "DownloadThread::setImageCustomisation - initFormat:" << initFormat << "cloudinit empty:" << cloudinit.isEmpty() << "cloudinitNetwork empty:" << cloudInitNetwork.isEmpty();
-}
+    if (_pendingFanOutTargets.empty())
+        return true;
 
-void DownloadThread::setDebugDirectIO(bool enabled)
-{
-    _debugDirectIO = enabled;
-    qDebug() << "DownloadThread: Direct I/O" << (enabled ? "enabled" : "disabled");
-}
+    emit preparationStatusUpdate(tr("Preparing additional drives..."));
 
-void DownloadThread::setDebugPeriodicSync(bool enabled)
-{
-    _debugPeriodicSync = enabled;
-    qDebug() << "DownloadThread: Periodic sync" << (enabled ? "enabled" : "disabled");
-}
+    for (PendingFanOutTarget &pending : _pendingFanOutTargets)
+    {
+        const std::shared_ptr<FanOutTarget> target = pending.target;
+        std::future_status status = pending.opened.wait_for(std::chrono::seconds(0));
+        while (status != std::future_status::ready && !_cancelled
+               && std::chrono::steady_clock::now() < pending.deadline)
+        {
+            status = pending.opened.wait_for(std::chrono::milliseconds(100));
+        }
 
-void DownloadThread::setDebugVerboseLogging(bool enabled)
-{
-    _debugVerboseLogging = enabled;
-    qDebug() << "DownloadThread: Verbose logging" << (enabled ? "enabled" : "disabled");
-}
+        if (status == std::future_status::ready && pending.opened.get())
+        {
+            connect(target.get(), &FanOutTarget::progress, this, [this](QByteArray dev, quint64 written) {
+                emit fanOutTargetProgress(QString(dev), written, _extractTotal.load());
+            }, Qt::DirectConnection);
+            _fanOutTargets.push_back(target);
+            continue;
+        }
 
-void DownloadThread::setDebugAsyncIO(bool enabled)
-{
-    _debugAsyncIO = enabled;
-    qDebug() << "DownloadThread: Async I/O" << (enabled ? "enabled" : "disabled");
+        if (status != std::future_status::ready)
+        {
+            // Left to its preparation thread, which drops it once the stuck
+            // call returns; cancel() keeps it from being started
+            qDebug() << "Additional target" << target->device() << "not ready in time";
+            target->cancel();
+            target->fail(_cancelled ? tr("Writing was cancelled.")
+                                    : tr("Timed out preparing storage device '%1'.").arg(QString(target->device())));
+        }
+
+        // A device that cannot be prepared is reported and left out;
+        // the remaining devices are still written
+        emit fanOutTargetFinished(QString(target->device()), false, target->errorString());
+    }
+    _pendingFanOutTargets.clear();
+
+    return true;
 }
 
-void DownloadThread::setDebugAsyncQueueDepth(int depth)
+void DownloadThread::_fanOutWrite(const char *buf, size_t len)
 {
-    // Hard cap at 256 to prevent resource exhaustion
-    const int maxDepth = 256;
-    int requestedDepth = (depth < 1) ? 1 : ((depth > maxDepth) ? maxDepth : depth);
-    
-    // Memory-based sanity check: warn if queue depth would use excessive memory
-    // With 8MB write blocks, each pending write uses 8MB of ring buffer memory
-    qint64 availableMemMB = SystemMemoryManager::instance().getAvailableMemoryMB();
-    size_t writeBlockSize = SystemMemoryManager::instance().getOptimalWriteBufferSize();
-    size_t estimatedMemoryMB = (requestedDepth * writeBlockSize) / (1024 * 1024);
-    
-    if (estimatedMemoryMB > static_cast<size_t>(availableMemMB / 2)) {
-        // Queue depth would use more than 50% of available RAM - cap it
-        int safeDepth = static_cast<int>((availableMemMB * 1024 * 1024 / 2) / writeBlockSize);
-        safeDepth = qMax(4, qMin(safeDepth, requestedDepth));
-        
-        qDebug() << "DownloadThread: WARNING - Requested queue depth" << requestedDepth
-                 << "would use" << estimatedMemoryMB << "MB (only" << availableMemMB << "MB available)."
-                 << "Capping to" << safeDepth;
-        requestedDepth = safeDepth;
+    // Offset of this write on the primary device (zero-skip may have seeked)
+    std::uint64_t offset = _file->Tell();
+
+    for (auto &target : _fanOutTargets)
+    {
+        // Failed targets are reported once, in _finishFanOutTargets()
+        if (!target->hasFailed())
+            target->write(offset, buf, len);
     }
-    
-    _debugAsyncQueueDepth = requestedDepth;
-    qDebug() << "DownloadThread: Async queue depth set to" << _debugAsyncQueueDepth
-             << "(estimated memory:" << estimatedMemoryMB << "MB)";
 }
 
-void DownloadThread::setDebugIPv4Only(bool enabled)
+void DownloadThread::_finishFanOutTargets()
 {
-    _debugIPv4Only = enabled;
-    qDebug() << "DownloadThread: IPv4-only mode" << (enabled ? "enabled" : "disabled");
+    if (_fanOutTargets.empty())
+        return;
+
+    const QByteArray expectedHash = _writeTreeHash.result();
+    const bool customise = _customisationRequested();
+
+    for (auto &target : _fanOutTargets)
+    {
+        // finishWrites() was called before the primary's sync and verify,
+        // so by now most targets have already finished verifying
+        target->wait();
+
+        if (!target->hasFailed() && _verifyEnabled && target->verifyHash() != expectedHash)
+        {
+            target->fail(tr("Verifying write failed. Contents of SD card is different from what was written to it."));
+        }
+
+        if (!target->hasFailed() && customise)
+        {
+            try
+            {
+                _customizeDevice(target->file(), _firstBlock, _firstBlockSize);
+            }
+            catch (std::runtime_error &err)
+            {
+                target->fail(QString::fromUtf8(err.what()));
+            }
+        }
+
+        // DeviceWrapper already wrote the first block when customising
+        bool ok = target->close(!customise);
+        qDebug() << "Additional target" << target->device() << (ok ? "succeeded" : "failed:") << target->errorString();
+        emit fanOutTargetFinished(QString(target->device()), ok, target->errorString());
+
+        if (ok && _ejectEnabled && !rpi_imager::MemoryFileOperations::IsMemoryTarget(target->device().toStdString()))
+        {
+            PlatformQuirks::ejectDisk(PlatformQuirks::getEjectDevicePath(target->device()));
+        }
+    }
+
+    _fanOutTargets.clear();
 }
 
-void DownloadThread::setDebugSkipEndOfDevice(bool enabled)
+void DownloadThread::_cancelFanOutTargets()
 {
-    _debugSkipEndOfDevice = enabled;
-    qDebug() << "DownloadThread: Skip end-of-device operations" << (enabled ? "enabled (for counterfeit cards)" : "disabled");
+    // Targets still being prepared are cancelled the same way; their
+    // preparation threads see it before starting to write
+    for (PendingFanOutTarget &pending : _pendingFanOutTargets)
+        _fanOutTargets.push_back(pending.target);
+    _pendingFanOutTargets.clear();
+
+    for (auto &target : _fanOutTargets)
+    {
+        target->cancel();
+        if (!target->hasFailed())
+            target->fail(_cancelled ? tr("Writing was cancelled.") : tr("Writing to the primary device failed."));
+        emit fanOutTargetFinished(QString(target->device()), false, target->errorString());
+    }
+    _fanOutTargets.clear();
 }
 
-void DownloadThread::setDebugIgnoreDeviceLimits(bool enabled)
+bool DownloadThread::_customisationRequested() const
 {
-    _debugIgnoreDeviceLimits = enabled;
-    qDebug() << "DownloadThread: Ignore device I/O limits" << (enabled ? "enabled" : "disabled");
+    return (!_config.isEmpty() || !_cmdline.isEmpty() || !_firstrun.isEmpty() || !_cloudinit.isEmpty()) && !_initFormat.isEmpty();
 }
 
-bool DownloadThread::_customizeImage()
+// Metadata for performance tracking (what was configured, not values)
+QString DownloadThread::_customisationMetadata() const
 {
-    emit preparationStatusUpdate(tr("Customising OS..."));
-    QElapsedTimer customTimer;
-    customTimer.start();
-    
-    // Build metadata for performance tracking (what was configured, not values)
     QStringList configuredItems;
     if (!_config.isEmpty()) configuredItems << "config: set";
     if (!_cmdline.isEmpty()) configuredItems << "cmdline: set";
@@ -2297,137 +6308,168 @@ bool DownloadThread::_customizeImage()
     if (!_cloudinit.isEmpty()) configuredItems << "cloudinit: set";
     if (!_cloudinitNetwork.isEmpty()) configuredItems << "network: set";
     if (_advancedOptions.testFlag(ImageOptions::EnableSecureBoot)) configuredItems << "secureboot: enabled";
-    QString metadata = configuredItems.join("; ");
+    return configuredItems.join("; ");
+}
+
+bool DownloadThread::_customizeImage()
+{
+    emit preparationStatusUpdate(tr("Customising OS..."));
+    QElapsedTimer customTimer;
+    customTimer.start();
+    
+    const QString metadata = _customisationMetadata();
 
-    // Use DeviceWrapper with existing FileOperations for image customization
     try
     {
-        // Create DeviceWrapper using our existing FileOperations instance directly
+        // Use our existing FileOperations instance directly
         // This avoids opening the device twice and triggering authorization dialogs
-        DeviceWrapper dw(_file.get());
+        _customizeDevice(_file.get(), _firstBlock, _firstBlockSize);
         if (_firstBlock)
         {
-            // Outsource first block handling to DeviceWrapper.
-            // It will still not actually be written out yet,
-            // until we call sync(), and then it will
-            // save the first 4k sector with MBR for last
-            dw.pwrite(_firstBlock, _firstBlockSize, 0);
+            // DeviceWrapper wrote the first block as part of its sync()
             _bytesWritten += _firstBlockSize;
             qFreeAligned(_firstBlock);
             _firstBlock = nullptr;
         }
-        
-        // Parse FAT partition (can be slow for large partitions)
-        QElapsedTimer fatTimer;
-        fatTimer.start();
-        DeviceWrapperFatPartition *fat = dw.fatPartition(1);
-        emit eventFatPartitionSetup(static_cast<quint32>(fatTimer.elapsed()), fat != nullptr);
+    }
+    catch (std::runtime_error &err)
+    {
+        emit eventCustomisation(static_cast<quint32>(customTimer.elapsed()), false, metadata);
+        emit error(err.what());
+        return false;
+    }
 
-        if (!_config.isEmpty())
-        {
-            auto configItems = _config.split('\n');
-            configItems.removeAll("");
-            QByteArray config = fat->readFile("config.txt");
+    emit eventCustomisation(static_cast<quint32>(customTimer.elapsed()), true, metadata);
+    emit finalizing();
 
-            for (const QByteArray& item : std::as_const(configItems))
-            {
-                if (config.contains("#"+item)) {
-                    // Uncomment existing line
-                    config.replace("#"+item, item);
-                } else if (config.contains("\n"+item)) {
-                    // config.txt already contains the line
-                } else {
-                    // Append new line to config.txt
-                    if (config.right(1) != QByteArray("\n"))
-                        config += "\n"+item+"\n";
-                    else
-                        config += item+"\n";
-                }
-            }
+    return true;
+}
 
-            fat->writeFile("config.txt", config);
-        }
+void DownloadThread::_customizeDevice(rpi_imager::FileOperations *file, const char *firstBlock, size_t firstBlockSize)
+{
+    // Only report stage timings for the primary device
+    const bool isPrimary = (file == _file.get());
+
+    // Customisation is applied per device, so work on copies of the
+    // strings that get extended below
+    QByteArray cmdlineAppend = _cmdline;
+
+    // Throws std::runtime_error on failure
+    DeviceWrapper dw(file);
+    if (firstBlock)
+    {
+        // Outsource first block handling to DeviceWrapper.
+        // It will still not actually be written out yet,
+        // until we call sync(), and then it will
+        // save the first 4k sector with MBR for last
+        dw.pwrite(firstBlock, firstBlockSize, 0);
+    }
+    
+    // Parse FAT partition (can be slow for large partitions)
+    QElapsedTimer fatTimer;
+    fatTimer.start();
+    DeviceWrapperFatPartition *fat = dw.fatPartition(1);
+    if (isPrimary)
+        emit eventFatPartitionSetup(static_cast<quint32>(fatTimer.elapsed()), fat != nullptr);
+
+    // Written together at the end, so their clusters are allocated as one run
+    QMap<QString, QByteArray> files;
 
-        // init_format decision is owned by ImageWriter; no auto-detection here
+    if (!_config.isEmpty())
+    {
+        auto configItems = _config.split('\n');
+        configItems.removeAll("");
+        QByteArray config = fat->readFile("config.txt");
 
-        if (!_firstrun.isEmpty())
+        for (const QByteArray& item : std::as_const(configItems))
         {
-            // CustomisationGenerator now creates complete scripts with header and footer
-            // No need to add them here anymore
-            if (_initFormat == "systemd") {
-                fat->writeFile("firstrun.sh", _firstrun);
-                _cmdline += " systemd.run=/boot/firstrun.sh systemd.run_success_action=reboot systemd.unit=kernel-command-line.target";
+            if (config.contains("#"+item)) {
+                // Uncomment existing line
+                config.replace("#"+item, item);
+            } else if (config.contains("\n"+item)) {
+                // config.txt already contains the line
+            } else {
+                // Append new line to config.txt
+                if (config.right(1) != QByteArray("\n"))
+                    config += "\n"+item+"\n";
+                else
+                    config += item+"\n";
             }
         }
 
-        auto initCloud = _initFormat == "cloudinit" || _initFormat == "cloudinit-rpi";
-        auto hasCloudContent = !_cloudinit.isEmpty() || !_cloudinitNetwork.isEmpty();
-        qDebug() << "_customizeImage: _initFormat=" << _initFormat << "initCloud=" << initCloud << "_cloudinit.isEmpty()=" << _cloudinit.isEmpty();
-        if (initCloud && hasCloudContent) {
-            // Write meta-data file for NoCloud datasource
-            // cloud-init requires meta-data to be present for proper datasource detection
-            // instance-id should be unique per imaging to ensure cloud-init processes user-data
-            QByteArray instanceId = "rpi-imager-" + QByteArray::number(QDateTime::currentMSecsSinceEpoch());
-            QByteArray metadata = "instance-id: " + instanceId + "\n";
-            fat->writeFile("meta-data", metadata);
-
-            // Expose datasource type and instance-id on kernel cmdline so that
-            // cloud-init's check_instance_id() can validate the cache without
-            // reading from seed_dirs (which are never populated for this
-            // deployment pattern). Without this, the NoCloud datasource cache
-            // is invalidated on every reboot (/run is tmpfs), forcing a full
-            // re-discovery from /boot/firmware on every boot.
-            _cmdline += " ds=nocloud;i=" + instanceId;
-
-            if (!_cloudinit.isEmpty())
-            {
-                _cloudinit = "#cloud-config\n"+_cloudinit;
-                fat->writeFile("user-data", _cloudinit);
-            }
+        files.insert("config.txt", config);
+    }
 
-            if (!_cloudinitNetwork.isEmpty())
-            {
-                fat->writeFile("network-config", _cloudinitNetwork);
-            }
+    // init_format decision is owned by ImageWriter; no auto-detection here
+
+    if (!_firstrun.isEmpty())
+    {
+        // CustomisationGenerator now creates complete scripts with header and footer
+        // No need to add them here anymore
+        if (_initFormat == "systemd") {
+            files.insert("firstrun.sh", _firstrun);
+            cmdlineAppend += " systemd.run=/boot/firstrun.sh systemd.run_success_action=reboot systemd.unit=kernel-command-line.target";
         }
+    }
 
-        if (!_cmdline.isEmpty())
+    auto initCloud = _initFormat == "cloudinit" || _initFormat == "cloudinit-rpi";
+    auto hasCloudContent = !_cloudinit.isEmpty() || !_cloudinitNetwork.isEmpty();
+    qDebug() << "_customizeDevice: _initFormat=" << _initFormat << "initCloud=" << initCloud << "_cloudinit.isEmpty()=" << _cloudinit.isEmpty();
+    if (initCloud && hasCloudContent) {
+        // Write meta-data file for NoCloud datasource
+        // cloud-init requires meta-data to be present for proper datasource detection
+        // instance-id should be unique per imaging to ensure cloud-init processes user-data
+        QByteArray instanceId = "rpi-imager-" + QByteArray::number(QDateTime::currentMSecsSinceEpoch());
+        QByteArray metadata = "instance-id: " + instanceId + "\n";
+        files.insert("meta-data", metadata);
+
+        // Expose datasource type and instance-id on kernel cmdline so that
+        // cloud-init's check_instance_id() can validate the cache without
+        // reading from seed_dirs (which are never populated for this
+        // deployment pattern). Without this, the NoCloud datasource cache
+        // is invalidated on every reboot (/run is tmpfs), forcing a full
+        // re-discovery from /boot/firmware on every boot.
+        cmdlineAppend += " ds=nocloud;i=" + instanceId;
+
+        if (!_cloudinit.isEmpty())
         {
-            QByteArray cmdline = fat->readFile("cmdline.txt").trimmed();
-
-            cmdline += _cmdline;
-
-            fat->writeFile("cmdline.txt", cmdline);
+            files.insert("user-data", "#cloud-config\n"+_cloudinit);
         }
-        
-        // Sync before secure boot processing (writes partition table/MBR)
-        QElapsedTimer syncTimer;
-        syncTimer.start();
-        dw.sync();
-        emit eventPartitionTableWrite(static_cast<quint32>(syncTimer.elapsed()), true);
-        
-        // Generate secure boot files if enabled
-        if (_advancedOptions.testFlag(ImageOptions::EnableSecureBoot))
+
+        if (!_cloudinitNetwork.isEmpty())
         {
-            emit preparationStatusUpdate(tr("Creating signed boot image..."));
-            if (!_createSecureBootFiles(fat))
-            {
-                emit error(tr("Failed to create secure boot files"));
-                return false;
-            }
+            files.insert("network-config", _cloudinitNetwork);
         }
     }
-    catch (std::runtime_error &err)
+
+    if (!cmdlineAppend.isEmpty())
     {
-        emit eventCustomisation(static_cast<quint32>(customTimer.elapsed()), false, metadata);
-        emit error(err.what());
-        return false;
-    }
+        QByteArray cmdline = fat->readFile("cmdline.txt").trimmed();
 
-    emit eventCustomisation(static_cast<quint32>(customTimer.elapsed()), true, metadata);
-    emit finalizing();
+        cmdline += cmdlineAppend;
 
-    return true;
+        files.insert("cmdline.txt", cmdline);
+    }
+
+    if (!files.isEmpty())
+        fat->writeFiles(files);
+    
+    // Sync before secure boot processing (writes partition table/MBR)
+    QElapsedTimer syncTimer;
+    syncTimer.start();
+    dw.sync();
+    if (isPrimary)
+        emit eventPartitionTableWrite(static_cast<quint32>(syncTimer.elapsed()), true);
+    
+    // Generate secure boot files if enabled
+    if (_advancedOptions.testFlag(ImageOptions::EnableSecureBoot))
+    {
+        emit preparationStatusUpdate(tr("Creating signed boot image..."));
+        if (!_createSecureBootFiles(fat))
+        {
+            throw std::runtime_error(tr("Failed to create secure boot files").toStdString());
+        }
+    }
 }
 
 bool DownloadThread::_createSecureBootFiles(DeviceWrapperFatPartition *fat)
@@ -2501,20 +6543,10 @@ bool DownloadThread::_createSecureBootFiles(DeviceWrapperFatPartition *fat)
     qDebug() << "DownloadThread:" << bootFiles.size() << "boot files," 
              << customFiles.size() << "customization files";
 
-    // Create temporary directory for boot.img and boot.sig
-    QTemporaryDir tempDir;
-    if (!tempDir.isValid()) {
-        qDebug() << "DownloadThread: failed to create temp directory";
-        emit error(tr("Failed to create temporary directory"));
-        return false;
-    }
-
-    QString bootImgPath = tempDir.path() + "/boot.img";
-    QString bootSigPath = tempDir.path() + "/boot.sig";
-
-    // Create boot.img (only with boot files, not customization files)
+    // Create boot.img in memory (only with boot files, not customization files)
     emit preparationStatusUpdate(tr("Creating boot.img..."));
-    if (!SecureBoot::createBootImg(bootFiles, bootImgPath)) {
+    QByteArray bootImgData = SecureBoot::createBootImg(bootFiles);
+    if (bootImgData.isEmpty()) {
         qDebug() << "DownloadThread: failed to create boot.img";
         emit error(tr("Failed to create boot.img"));
         return false;
@@ -2522,31 +6554,13 @@ bool DownloadThread::_createSecureBootFiles(DeviceWrapperFatPartition *fat)
 
     // Generate boot.sig
     emit preparationStatusUpdate(tr("Signing boot image..."));
-    if (!SecureBoot::generateBootSig(bootImgPath, rsaKeyPath, bootSigPath)) {
+    QByteArray bootSigData = SecureBoot::generateBootSig(bootImgData, rsaKeyPath);
+    if (bootSigData.isEmpty()) {
         qDebug() << "DownloadThread: failed to generate boot.sig";
         emit error(tr("Failed to generate boot.sig"));
         return false;
     }
 
-    // Read boot.img and boot.sig
-    QFile bootImgFile(bootImgPath);
-    if (!bootImgFile.open(QIODevice::ReadOnly)) {
-        qDebug() << "DownloadThread: failed to read boot.img";
-        emit error(tr("Failed to read boot.img"));
-        return false;
-    }
-    QByteArray bootImgData = bootImgFile.readAll();
-    bootImgFile.close();
-
-    QFile bootSigFile(bootSigPath);
-    if (!bootSigFile.open(QIODevice::ReadOnly)) {
-        qDebug() << "DownloadThread: failed to read boot.sig";
-        emit error(tr("Failed to read boot.sig"));
-        return false;
-    }
-    QByteArray bootSigData = bootSigFile.readAll();
-    bootSigFile.close();
-
     // Delete ALL original files from the boot partition FIRST (before writing boot.img/boot.sig)
     // This ensures we use the original filenames from extraction, avoiding LFN issues
     // Boot files will be inside boot.img
@@ -2617,8 +6631,7 @@ bool DownloadThread::_createSecureBootFiles(DeviceWrapperFatPartition *fat)
     // NOW write boot.img and boot.sig to the cleaned partition
     emit preparationStatusUpdate(tr("Writing signed boot files..."));
     try {
-        fat->writeFile("boot.img", bootImgData);
-        fat->writeFile("boot.sig", bootSigData);
+        fat->writeFiles({{"boot.img", bootImgData}, {"boot.sig", bootSigData}});
         qDebug() << "DownloadThread: secure boot files written successfully";
     }
     catch (std::runtime_error &err) {
@@ -2633,16 +6646,14 @@ bool DownloadThread::_createSecureBootFiles(DeviceWrapperFatPartition *fat)
     if (!customFiles.isEmpty()) {
         emit preparationStatusUpdate(tr("Writing customization files..."));
         qDebug() << "DownloadThread: writing" << customFiles.size() << "customization files back";
-        for (auto it = customFiles.constBegin(); it != customFiles.constEnd(); ++it) {
-            try {
-                fat->writeFile(it.key(), it.value());
-                qDebug() << "DownloadThread: wrote customization file:" << it.key();
-            }
-            catch (std::runtime_error &err) {
-                qDebug() << "DownloadThread: WARNING - failed to write customization file" << it.key() << ":" << err.what();
-                // Don't fail the entire process, but log the warning
-                // The file might still exist from before, but it could be corrupted
-            }
+        try {
+            fat->writeFiles(customFiles);
+            qDebug() << "DownloadThread: wrote customization files:" << customFiles.keys();
+        }
+        catch (std::runtime_error &err) {
+            qDebug() << "DownloadThread: WARNING - failed to write customization files:" << err.what();
+            // Don't fail the entire process, but log the warning
+            // The files might still exist from before, but they could be corrupted
         }
     }
 
@@ -16,6 +16,8 @@
 #include <QElapsedTimer>
 #include <QFuture>
 #include <atomic>
+#include <chrono>
+#include <future>
 #include <time.h>
 #include <curl/curl.h>
 #include "acceleratedcryptographichash.h"
@@ -23,7 +25,24 @@
 #include "systemmemorymanager.h"
 #include "file_operations.h"
 #include "asynccachewriter.h"
-
+#include "fanouttarget.h"
+#include "hashpipeline.h"
+#include "sampledverify.h"
+#include "capacityprobe.h"
+#include "pipelinedverifier.h"
+#include "latencyhistogram.h"
+#include "threadcputime.h"
+#include "writeautotuner.h"
+#include "deviceprofile.h"
+#include "etamodel.h"
+#include "writejournal.h"
+#include "bootpartitionshadow.h"
+#include "mirrorracer.h"
+#include "blockqueuetuner.h"
+#include <vector>
+
+namespace fastboot { class BlockMap; }
+class StreamingBlockMapper;
 
 class DownloadThread : public QThread
 {
@@ -62,6 +81,12 @@ public:
      */
     virtual void cancelDownload();
 
+    /*
+     * True while a sync given up on by cancelling still holds the device.
+     * It is closed once the sync returns, from a helper thread.
+     */
+    bool isSyncInFlight() const;
+
     /*
      * Set proxy server.
      * Specify a string like this: user:pass@proxyserver:8080/
@@ -110,11 +135,42 @@ public:
      */
     void setVerifyEnabled(bool verify);
 
+    /*
+     * Read back only this percentage of the image when verifying (plus the
+     * boot partition and capacity probes, see SampledVerify). 100 reads
+     * back everything.
+     */
+    void setVerifyCoverage(double percent);
+
+    /*
+     * Record every operation on the device to this file (see iotrace.h),
+     * for replaying with a replay:<file> target. Empty records nothing.
+     */
+    void setIoTraceFile(const QString &path);
+
+    /*
+     * Discard/unmap the whole drive before writing the image
+     */
+    void setEraseBeforeWrite(bool erase);
+
+    /*
+     * Write only these partitions of the image (numbered as in its
+     * partition table, from 1), onto a device that already has them at the
+     * same offsets. Everything else on the device is left as it is.
+     */
+    void setWritePartitions(const QList<int> &partitions);
+
     /*
      * Enable disk cache
      */
     void setCacheFile(const QString &filename, qint64 filesize = 0);
 
+    /*
+     * Also keep a sparse copy of the decompressed image in the cache.
+     * imageCacheFileReady() is emitted once the image hash was verified.
+     */
+    void setImageCacheFile(const QString &filename, qint64 imageSize = 0);
+
     /*
      * Set input buffer size
      */
@@ -136,6 +192,47 @@ public:
     void setDebugIPv4Only(bool enabled);
     void setDebugSkipEndOfDevice(bool enabled);
     void setDebugIgnoreDeviceLimits(bool enabled);
+    void setDebugParallelDownload(bool enabled);
+    void setDebugPipelinedVerify(bool enabled);
+
+    /*
+     * Write the same image to an additional device (set before starting the thread).
+     * Each additional device gets its own writer thread and async queue, and its
+     * failure does not abort the write to the other devices.
+     */
+    void addFanOutTarget(const QByteArray &device);
+
+    /*
+     * Block map (.bmap) of the image (set before starting the thread).
+     * When available, ranges the bmap marks as unused are skipped instead of
+     * written, and verification only reads back the mapped ranges.
+     */
+    void setBmapUrl(const QByteArray &url);
+
+    /*
+     * Other imagers on the LAN that may have the download cached
+     * (CachePeerServer URLs, set before starting the thread). The first
+     * that has it is used instead of the origin, which takes over from
+     * where the peer left off if it fails.
+     */
+    void setPeerUrls(const QList<QByteArray> &urls);
+
+    /*
+     * The start of the download, fetched by a CachePrefetcher before the
+     * write started (set before starting the thread). It is fed through as
+     * if it had just been downloaded, and the download continues after it
+     * if the server takes range requests. The file is removed afterwards.
+     */
+    void setPrefetchedPrefix(const QString &fileName);
+
+    /*
+     * Other URLs serving the same download, from the OS list (set before
+     * starting the thread). These, and the mirrors the origin lists in
+     * rel=duplicate Link headers, are raced against the origin and the
+     * fastest is used. If its throughput later falls well below what the
+     * probe predicted, the download moves to the next fastest.
+     */
+    void setMirrorUrls(const QList<QByteArray> &urls);
 
     /*
      * Thread safe download progress query functions
@@ -147,6 +244,7 @@ public:
     uint64_t verifyNow();
     uint64_t verifyTotal();
     uint64_t bytesWritten();
+    uint64_t bytesDecompressed();
     int pendingAsyncWrites() const;
     
     // Force poll for async I/O completions - call when stall detected
@@ -157,9 +255,28 @@ public:
     // Returns true if reduction was applied, false if not supported
     bool reduceAsyncQueueDepth(int newDepth);
     
+    // Raise async queue depth again after a reduceAsyncQueueDepth() the device
+    // has recovered from. Returns true if the depth was raised
+    bool restoreAsyncQueueDepth(int newDepth);
+    
     // Get current async queue depth
     int getAsyncQueueDepth() const;
     
+    // Queue depth writes actually run at: 1 in sync fallback mode, 0 without async I/O
+    int effectiveAsyncQueueDepth() const;
+    
+    // Leave the sync mode drainAndSwitchToSync() entered and queue async writes
+    // again at depth. Returns true if async writes are back on
+    bool resumeAsyncWrites(int depth);
+    
+    // Counts of the write latency histogram writes currently go through: async
+    // completions, or the blocking write calls in sync mode
+    std::vector<uint64_t> writeLatencySnapshot() const;
+    
+    // Async write completion latency at quantile (0..1) in microseconds, over
+    // this write so far; samples is set to the number of completions
+    quint64 asyncWriteLatencyUs(double quantile, quint64 &samples) const;
+    
     // Drain pending async writes and switch to sync mode for hot-swap.
     // Waits up to timeoutSeconds for pending writes to complete naturally.
     // Returns true if drain succeeded (all pending completed), false if timeout.
@@ -182,6 +299,7 @@ public:
     // buffer until onComplete is called.
     // If onComplete is null or async is disabled, the buffer can be reused after return.
     size_t _writeFileZeroSkip(const char *buf, size_t len);
+    size_t _writeFileSparse(const char *buf, size_t len, WriteCompleteCallback onComplete = nullptr);
     size_t _writeFile(const char *buf, size_t len, WriteCompleteCallback onComplete = nullptr);
 
 signals:
@@ -189,6 +307,8 @@ signals:
     void error(QString msg);
     void cacheFileUpdated(QByteArray sha256);
     void cacheFileHashUpdated(QByteArray cacheFileHash, QByteArray imageHash);
+    void imageCacheFileReady(QString filename, QByteArray imageHash);
+    void imageHashMismatch();
     void finalizing();
     void preparationStatusUpdate(QString msg);
     
@@ -200,6 +320,10 @@ signals:
     void eventDriveOpen(quint32 durationMs, bool success, QString metadata);
     void eventDriveAuthorization(quint32 durationMs, bool success);   // Privilege escalation timing
     void eventDriveMbrZeroing(quint32 durationMs, bool success, QString metadata);  // MBR zeroing timing
+    void eventDriveErase(quint32 durationMs, bool success, QString metadata);       // Whole-drive discard timing
+    void eventDriveCapacityProbe(quint32 durationMs, bool success, QString metadata); // Fake-capacity probe result
+    void eventDriveQueueTuning(bool success, QString metadata);      // Block queue settings before and after tuning
+    void eventDriveUsbPower(bool success, QString metadata);         // USB power settings held for the write, with sync latency
     void eventDirectIOAttempt(bool attempted, bool succeeded, bool currentlyEnabled, int errorCode, QString errorMessage);
     void eventCustomisation(quint32 durationMs, bool success, QString metadata);
     void finalSyncStarting();  // Emitted before post-write fdatasync/fsync
@@ -217,7 +341,7 @@ signals:
     void eventQueueDepthReduction(int oldDepth, int newDepth, int pendingWrites); // Async queue depth reduced
     void eventDrainAndHotSwap(quint32 durationMs, int pendingBefore, bool success); // Drained queue and switched to sync
     void syncFallbackActivated(QString reason); // Async I/O stalled, fell back to sync mode
-    void requestWriteRestart(QString reason);  // Request ImageWriter to restart write from scratch
+    void requestWriteRestart(QString reason);  // Request ImageWriter to restart the write (resumed if a journal allows)
     
     // Write timing breakdown signals (for hypothesis testing)
     void eventWriteTimingBreakdown(quint32 totalWriteOps, quint64 totalSyscallMs, quint64 totalPreHashWaitMs,
@@ -226,13 +350,20 @@ signals:
     void eventWriteAfterSyncImpact(quint32 avgThroughputBeforeSyncKBps, quint32 avgThroughputAfterSyncKBps, quint32 sampleCount);
     void eventAsyncIOConfig(bool enabled, bool supported, int queueDepth, quint32 pendingAtEnd);
     void eventAsyncIOTiming(quint32 totalMs, quint64 bytesWritten, quint32 writeCount);
+    void eventLatencyHistogram(QString name, QList<quint64> buckets, quint64 maxUs); // LatencyHistogram counts, microseconds
+    void eventStageCpuTime(QString stage, quint32 cpuMs, quint32 activeMs, quint32 wallMs); // Thread CPU time of a pipeline stage during this write
+    void eventWriteTuning(int queueDepth, quint32 blockSize, quint32 throughputKBps, QString metadata); // Auto-tuner probe or decision
     
     // Bottleneck state signal for UI feedback
     void bottleneckStateChanged(DownloadThread::BottleneckState state, quint32 throughputKBps);
-    
-    // Async write progress signal - emitted from completion callbacks (thread-safe)
-    // Connected to UI with Qt::QueuedConnection for cross-thread safety
-    void asyncWriteProgress(quint64 bytesWritten, quint64 totalBytes);
+
+    // Estimated time until the write and verification are done; 0 if unknown.
+    // limitedBy names the stage most of that time is spent waiting on (see EtaModel)
+    void timeRemainingChanged(quint32 seconds, QString limitedBy);
+
+    // Per-device status of additional (fan-out) destination devices
+    void fanOutTargetProgress(QString device, quint64 bytesWritten, quint64 totalBytes);
+    void fanOutTargetFinished(QString device, bool success, QString message);
 
 protected:
     virtual void run();
@@ -247,14 +378,45 @@ protected:
     virtual void _onVerifyProgress() {}  // Called during verify loop for progress updates
     int _authopen(const QByteArray &filename);
     bool _openAndPrepareDevice();
+    bool _openAndPreparePrimaryDevice();
+    bool _canPrepareDeviceInBackground();
+    bool _prepareDeviceInBackground();
+    // Blocks until a device being prepared in the background is ready;
+    // false if that failed or the write was cancelled
+    bool _waitForDevice();
+    // Whether _file may be used yet (always, unless prepared in the background)
+    bool _deviceReady() const;
+    void _eraseDevice();
+    bool _zeroDeviceEnds();
+    // Fails counterfeit cards before writing (capacityprobe/enabled setting)
+    bool _capacityProbeEnabled;
+    bool _probeCapacity();
     virtual void _onDevicePrepared() {}  // Hook for subclasses after device open, before writes
+    // Resizes buffers and caches to percent of normal when memory pressure changes
+    virtual void _onMemoryPressure(int percent);
     void _writeCache(const char *buf, size_t len);
+    // Whether the thread hashes the same stream it caches, and passes that digest to AsyncCacheWriter::finish()
+    virtual bool _hashesCacheStream() const { return false; }
+    bool _cacheWritable();
+    void _onCacheWriteRejected();
+    void _writeImageCache(const char *buf, size_t len);
+    void _finishImageCache(const QByteArray &imageHash);
+    // Gap fillers for the cache writers, when they fall behind (AsyncCacheWriter::setGapFiller())
+    bool _fetchCacheRange(qint64 offset, char *buf, qint64 len);
+    bool _readImageCacheRange(qint64 offset, char *buf, qint64 len);
     qint64 _sectorsWritten();
     void _closeFiles();
+    rpi_imager::FileOperations *_verifyReader();
+    rpi_imager::FileError _cancellableSync();
     QByteArray _fileGetContentsTrimmed(const QString &filename);
+    bool _customisationRequested() const;
     bool _customizeImage();
+    QString _customisationMetadata() const;
+    void _customizeDevice(rpi_imager::FileOperations *file, const char *firstBlock, size_t firstBlockSize);
     bool _createSecureBootFiles(class DeviceWrapperFatPartition *fat);
     void _periodicSync();
+    void _asyncPeriodicSync(qint64 currentBytes);
+    void _rangedWriteback();
 
     /*
      * libcurl callbacks
@@ -267,6 +429,18 @@ protected:
     static int _curl_xferinfo_callback(void *userdata, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
     static size_t _curl_header_callback( void *ptr, size_t size, size_t nmemb, void *userdata);
 
+    // Parallel HTTP range download: several connections fetch consecutive
+    // segments which are passed to _writeData() strictly in order
+    struct RangeSegment;
+    struct RangeTransfer;
+    bool _probeRangeSupport(QByteArray &effectiveUrl, curl_off_t &contentLength);
+    bool _selectPeer();
+    // Carry on the single connection from offset, the first byte not yet
+    // passed to _writeData(), so whatever consumes the stream never notices
+    void _resumeAt(std::uint64_t offset);
+    CURLcode _performParallelDownload(const QByteArray &url, curl_off_t contentLength, int connections);
+    static size_t _curl_range_write_callback(char *ptr, size_t size, size_t nmemb, void *userdata);
+
     CURL *_c;
     curl_off_t _startOffset;
     std::atomic<std::uint64_t> _lastDlTotal, _lastDlNow, _extractTotal, _verifyTotal, _lastVerifyNow, _bytesWritten;
@@ -279,33 +453,186 @@ protected:
     static QByteArray _proxy;
     std::atomic<bool> _cancelled;  // Atomic for safe access from timeout utility
     bool _successful, _verifyEnabled, _cacheEnabled, _ejectEnabled;
+    bool _eraseBeforeWrite;
     time_t _lastModified, _serverTime, _lastFailureTime;
     QElapsedTimer _timer;
     int _inputBufferSize;
 
     // Unified cross-platform file operations
     std::unique_ptr<rpi_imager::FileOperations> _file;
+    // Second handle on the device for reading it back, opened with direct I/O
+    // when _file is not, so the verify sees the media rather than the page cache
+    std::unique_ptr<rpi_imager::FileOperations> _verifyFile;
     
     // Async cache writer for non-blocking cache file I/O
     std::unique_ptr<AsyncCacheWriter> _asyncCacheWriter;
     QString _cacheFilename;  // Store filename for legacy signal emission
 
+    // Decompressed image cache, filled from the data handed to the writers
+    std::unique_ptr<AsyncCacheWriter> _imageCacheWriter;
+    QString _imageCacheFilename;
+
+    // Additional destination devices for multi-target writing
+    QList<QByteArray> _fanOutDevices;
+    std::vector<std::shared_ptr<FanOutTarget>> _fanOutTargets;
+    // Targets being prepared on their own threads, alongside the primary device
+    struct PendingFanOutTarget {
+        std::shared_ptr<FanOutTarget> target;
+        std::future<bool> opened;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::vector<PendingFanOutTarget> _pendingFanOutTargets;
+    void _startFanOutTargets();
+    bool _openFanOutTargets();
+    void _fanOutWrite(const char *buf, size_t len);
+    void _finishFanOutTargets();
+    void _cancelFanOutTargets();
+
+    QByteArray _originUrl;
+    QList<QByteArray> _peerUrls;
+
+    QString _prefetchedFile;
+    bool _replayPrefetchedPrefix(std::uint64_t &offset);
+
+    // Mirror selection (see MirrorRacer)
+    static constexpr int MIRROR_WINDOW_MS = 10000;   // Throughput is compared over windows this long
+    static constexpr int MIRROR_SLOW_FACTOR = 4;     // Slow: below 1/4 of the predicted throughput...
+    static constexpr int MIRROR_SLOW_WINDOWS = 2;    // ...for this many windows in a row
+    QList<QByteArray> _mirrorUrls;
+    QList<MirrorRacer::Probe> _mirrorFallbacks;  // Other usable sources, fastest first
+    qint64 _mirrorExpectedBps;                   // Predicted for _url; 0 to not check
+    std::atomic<qint64> _writeBlockedNs;         // Time curl spent in the write callback (incl. rate limiting)
+    QElapsedTimer _mirrorWindowTimer;
+    std::uint64_t _mirrorWindowBytes;
+    qint64 _mirrorWindowBlockedNs;
+    int _mirrorSlowWindows;
+    bool _mirrorSwitchRequested;
+    void _selectMirror();
+    bool _probeExtractTotal();
+
+    // Network downloads take part in the shared rate limit (see BandwidthScheduler)
+    bool _rateLimited;
+    bool _checkMirrorThroughput();
+
+    // bmap-driven sparse writing
+    QByteArray _bmapUrl;
+    std::unique_ptr<fastboot::BlockMap> _blockMap;
+    void _loadBlockMap();
+    bool _verifyMappedRanges();
+
+    /*
+     * Use a block map built from the source (e.g. by UsedBlockScanner)
+     * instead of a .bmap. Without range checksums in the map, they are
+     * taken from the data as it is written, for _verifyMappedRanges().
+     * Ranges that come with a checksum are checked against it as soon as
+     * their data has streamed past, so a corrupt download fails there.
+     */
+    void setBlockMap(std::unique_ptr<fastboot::BlockMap> map);
+    bool _hashMappedRanges;
+    size_t _mappedHashCursor;  // Range _mappedRangeHash is for
+    bool _mappedRangeWhole;    // _mappedRangeHash started at the range's start
+    std::unique_ptr<AcceleratedCryptographicHash> _mappedRangeHash;
+    void _hashMappedData(std::uint64_t offset, const char *buf, size_t len);
+    void _finishMappedRangeHash();
+
+    /*
+     * Without a .bmap, the block map is built from the image's own file
+     * systems as it is written (usedblocks/enabled setting)
+     */
+    bool _mapUsedBlocks;
+    std::unique_ptr<StreamingBlockMapper> _streamBlockMapper;
+    void _startBlockMapping();
+
+    // Partial writes: the map only covers the partitions to write, taken
+    // from the image's partition table as the first block passes
+    QList<int> _writePartitions;
+    void _startPartitionMapping();
+    bool _mapWritePartitions(const char *buf, size_t len);
+    bool _writeFirstBlockPartitions();
+
+    // Zero runs cleared with FileOperations::ZeroRange() instead of being
+    // written, as (offset, length) in write order
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> _zeroedRanges;
+    bool _zeroRangeFailed;
+    bool _zeroRangeUsable() const;
+    bool _zeroRange(std::uint64_t offset, const char *zeros, size_t len);
+
+    // Image file targets: the file system copied the image from a source
+    // file up to here; the data is still hashed as it passes, not written
+    std::uint64_t _clonedUpTo;
+    bool _cloneFromFile(int fd, std::uint64_t size);
+
+    // Raw images with a trusted hash: written by the kernel from the source
+    // file, not hashed; _writeComplete() takes the expected hash as theirs
+    bool _writeHashTrusted;
+    bool _spliceFromFile(int fd, std::uint64_t size, const std::function<void()> &progress);
+
+    /*
+     * In-flight customisation: the boot partition is held back in memory
+     * as it streams past, customised there and then written once, instead
+     * of being read back and rewritten after the write
+     * (bootshadow/enabled setting)
+     */
+    using ShadowWriteFunction = std::function<size_t(const char *, size_t)>;
+    bool _bootShadowEnabled;
+    bool _bootShadowDecided;      // Whether to hold back the partition was decided
+    bool _bootShadowForwarding;   // Writing through the hook, do not intercept again
+    bool _bootShadowReplaying;    // Writing the held-back partition out
+    bool _bootShadowCustomised;
+    QString _bootShadowError;     // Customisation failed, reported at the end of the write
+    std::unique_ptr<BootPartitionShadow> _bootShadow;
+    void _startBootShadow();
+    bool _interceptBootPartition(const char *buf, size_t len, WriteCompleteCallback onComplete,
+                                 const ShadowWriteFunction &write, size_t &result);
+    bool _replayBootShadow(bool customise, const ShadowWriteFunction &write);
+
+    // Verify-while-writing: reads back durable data behind the write cursor
+    std::unique_ptr<PipelinedVerifier> _pipelinedVerifier;
+    std::uint64_t _lastSyncedOffset;  // Write offset at the last successful periodic sync
+    std::uint64_t _verifyCommitted;   // Offset handed to the verifier so far
+    void _commitPipelinedVerify();
+
+    // Sampled verify: checksums of a sample of blocks, read back instead of the whole image
+    double _verifyCoverage;
+    QString _ioTraceFile;
+    std::unique_ptr<SampledVerify> _sampledVerify;
+    void _startSampledVerify(const char *firstBlock, size_t firstBlockSize);
+    bool _verifySampledBlocks();
+
 #ifdef Q_OS_WIN
     // Windows-specific volume file for legacy compatibility
     std::unique_ptr<rpi_imager::FileOperations> _volumeFile;
     QByteArray _nr;
 #endif
 
-    AcceleratedCryptographicHash _writehash, _verifyhash;
+    // _writehash is the plain hash of the image, checked against the
+    // expected (extract_sha256) hash. Read-back is only compared with what
+    // was written, so it uses the parallel, non-cryptographic comparison
+    // hash on both sides.
+    AcceleratedCryptographicHash _writehash, _writeTreeHash, _verifyhash;
 
-    // Pipelined hash computation - store future for previous hash operation
-    QFuture<void> _pendingHashFuture;
-    bool _hasPendingHash;
+    // Hashes written buffers in order, behind the writes
+    std::unique_ptr<HashPipeline> _hasher;
+    // Set while the device is opened and prepared alongside the download
+    std::shared_future<bool> _devicePreparation;
+    // A sync still running on a helper thread after a cancel stopped waiting for it
+    std::shared_future<rpi_imager::FileError> _abandonedSync;
 
     // Cross-platform adaptive page cache flushing
     qint64 _lastSyncBytes;
     QElapsedTimer _lastSyncTime;
     SystemMemoryManager::SyncConfiguration _syncConfig;
+
+    // Ranged writeback (FileOperations::StartWriteback) in place of periodic
+    // full syncs for buffered writes: [_writebackWaited, _writebackStarted)
+    // is queued for writeback, everything before _writebackWaited is written out
+    bool _rangedWritebackEnabled;
+    std::uint64_t _writebackStarted;
+    std::uint64_t _writebackWaited;
+
+    // Periodic sync queued with FileOperations::AsyncFlush() and not yet done
+    bool _asyncSyncPending;
+    QElapsedTimer _asyncSyncTimer;
     
     // Debug options
     bool _debugDirectIO;
@@ -316,11 +643,20 @@ protected:
     bool _debugIPv4Only;
     bool _debugSkipEndOfDevice;
     bool _debugIgnoreDeviceLimits;
+    bool _debugParallelDownload;
+    bool _debugPipelinedVerify;
+    bool _acceptRanges = false;  // Set by _header() when the server advertises byte ranges
+    // Validators of the last response, sent as If-Range when resuming from
+    // the same URL so a file replaced on the server is not spliced together
+    QByteArray _responseEtag, _responseLastModified, _validatorUrl;
+    curl_slist *_resumeHeaders = nullptr;
+    std::uint64_t _transferDelivered = 0;  // Passed to _writeData() since _startOffset
 
     void _initializeSyncConfiguration();
     void _updateBottleneckState();
 
     // Verification throughput tracking
+    static constexpr int VERIFY_READS_IN_FLIGHT = 4;  // Verify buffers: queued reads plus the one being hashed
     qint64 _verifyThroughputBytes{0};
     QElapsedTimer _verifyThroughputTimer;
 
@@ -352,6 +688,11 @@ protected:
         std::atomic<quint32> throughputCountAfterSync{0};     // Count of measurements after sync
         std::atomic<quint32> writesUntilNextSync{0};          // Counter to track "after sync" writes
         
+        // Per-operation latency distributions (async writes are tracked by FileOperations)
+        rpi_imager::LatencyHistogram writeLatency;       // Synchronous write() calls
+        rpi_imager::LatencyHistogram syncLatency;        // Flush + fsync, periodic and final
+        rpi_imager::LatencyHistogram verifyReadLatency;  // Each read during verification
+        
         void reset() {
             totalSyscallMs.store(0);
             totalPreHashWaitMs.store(0);
@@ -367,6 +708,9 @@ protected:
             throughputSamplesAfterSync.store(0);
             throughputCountAfterSync.store(0);
             writesUntilNextSync.store(0);
+            writeLatency.Reset();
+            syncLatency.Reset();
+            verifyReadLatency.Reset();
         }
     };
     WriteTimingStats _writeTimingStats;
@@ -374,6 +718,93 @@ protected:
     quint64 _lastWriteBytes{0};     // Bytes written at last measurement
     
     void _emitWriteTimingStats();   // Called at end of write phase
+    void _emitLatencyHistogram(const QString &name, const rpi_imager::LatencyHistogram &histogram);
+
+    // Pipeline CPU time by stage when the thread was created; what the
+    // write added is reported once it is verified
+    ThreadCpuTime::Sample _stageCpuStart;
+    QElapsedTimer _stageCpuTimer;
+    void _emitStageCpuTime();
+    // Async submit-to-completion when writing asynchronously, else write() calls
+    const rpi_imager::LatencyHistogram &_writeLatencyHistogram() const;
+    // To LiveMetrics, while a scraper is listening
+    void _publishLatency(const QString &name, const rpi_imager::LatencyHistogram &histogram);
+
+    // Online tuning of async queue depth and write size (see WriteAutoTuner)
+    WriteAutoTuner _writeTuner;
+    QElapsedTimer _writeTunerTimer;
+    bool _writeTuningEnabled;
+
+    void _beginWriteTuning();
+    void _updateWriteTuning(quint64 callLatencyUs);
+    void _waitForTunedQueueSlot();
+    size_t _tunedWriteSize(size_t len) const;
+
+    // Measurements kept per device model across sessions (see DeviceProfile)
+    QString _deviceProfileKey;       // QSettings group for this device model, empty if unknown
+    DeviceProfile _deviceProfile;    // Loaded before opening the device
+    DeviceProfile _sessionProfile;   // Measured during this write
+    QElapsedTimer _writePhaseTimer;  // First write until the final sync is done
+    quint64 _writeBusyUs{0};         // Time write calls blocked the writer
+    quint64 _periodicSyncMsTotal{0};
+    std::atomic<bool> _drainedToSync{false};  // In sync mode through drainAndSwitchToSync(), may resume async
+    quint32 _periodicSyncCount{0};
+
+    QString _deviceProfileModelKey() const;
+    void _loadDeviceProfile();
+    void _storeDeviceProfile();
+    void _emitTimeRemaining(bool verifying);
+    virtual quint64 _bytesDecompressedSoFar() const { return 0; }
+    EtaModel _etaModel;
+    QElapsedTimer _etaClock;
+
+    // Resuming an interrupted write of the same image to the same device (see WriteJournal)
+    WriteJournal _journal;
+    QString _journalKey;                // QSettings group, empty if this write keeps no journal
+    QByteArray _resumeFirstBlock;       // From the journal, for a download that starts at _resumeOffset
+    std::uint64_t _resumeOffset;        // The device already holds the image up to here
+    std::uint64_t _resumeSourceOffset;  // Where the download starts; 0 if the source is read from the start
+    bool _resumeEnabled;
+    bool _rawSource;                    // The downloaded data is the uncompressed image itself
+
+    void _prepareResume();
+    int _verifyJournalTail(const WriteJournal &journal);
+    bool _skipResumedData(const char *buf, size_t len);
+    bool _replayResumedPrefix();
+    std::uint64_t _durableOffset();
+    void _saveJournal();
+    void _removeJournal();
+
+    // Opt-in: the device's block queue tuned for the write, restored when
+    // this thread is destroyed (see BlockQueueTuner)
+    bool _queueTuningEnabled;
+    BlockQueueTuner _queueTuner;
+
+    // Opt-in: the USB device kept from suspending through the write and
+    // verify, released when this thread is destroyed (see
+    // PlatformQuirks::holdDevicePowerOn())
+    bool _usbPowerEnabled;
+    QString _usbPowerHeld;  // What was changed, empty if nothing
+
+    // Cores shared out between parallel decompression and tree hashing by
+    // where the write waits, with verification on (see PipelineBalancer)
+    bool _pipelineBalanceEnabled;
+
+    // Buffers and caches shrunk while the system is short of memory, and
+    // grown back when it recovers (see MemoryPressureMonitor)
+    bool _memoryPressureEnabled;
+    int _memoryPressureScale = 100;
+
+    // Delta writes: re-flashing a card that already holds a similar image
+    // only writes the blocks that differ from what is on it
+    bool _deltaWritesEnabled;           // On every card
+    bool _deltaWritesAuto;              // On models the device profile has seen written
+    bool _deltaActive = false;          // Turned off again when little turns out to match
+    bool _deltaWriting = false;         // _writeFileDelta() is writing a changed run
+    std::uint64_t _deltaComparedBytes = 0;
+    std::uint64_t _deltaUnchangedBytes = 0;
+
+    size_t _writeFileDelta(const char *buf, size_t len, WriteCompleteCallback onComplete);
 };
 
 #endif // DOWNLOADTHREAD_H
@@ -0,0 +1,107 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef DOWNSAMPLE_H
+#define DOWNSAMPLE_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Downsampling of time series for long sessions
+ */
+namespace Downsample {
+
+/**
+ * @brief Pick points of a series that keep its shape (Largest-Triangle-Three-Buckets)
+ *
+ * Splits the points between the first and last into target - 2 buckets
+ * and keeps, from each, the point that forms the largest triangle with
+ * the point kept before it and the average of the next bucket. Corners,
+ * where the series changes slope, win over points on a straight run: on
+ * a cumulative byte count those are where the throughput changed, such
+ * as the start and end of a stall.
+ *
+ * @param first Index of the first point, always kept
+ * @param last Index of the last point, always kept
+ * @param target Number of points to keep, at least 2
+ * @param x Callable returning the x value (e.g. time) of a point by index
+ * @param y Callable returning the y value of a point by index
+ * @return Indices of the points to keep, in order
+ */
+template <typename X, typename Y>
+std::vector<int> lttb(int first, int last, int target, X x, Y y)
+{
+    std::vector<int> kept;
+    const int count = last - first + 1;
+    if (count <= 0)
+        return kept;
+    if (target >= count || count <= 2)
+    {
+        for (int i = first; i <= last; ++i)
+            kept.push_back(i);
+        return kept;
+    }
+    if (target < 2)
+        target = 2;
+
+    kept.reserve(static_cast<size_t>(target));
+    kept.push_back(first);
+    if (target > 2)
+    {
+        // Buckets over the points between the first and the last
+        const double every = static_cast<double>(count - 2) / (target - 2);
+        int a = first;
+        for (int bucket = 0; bucket < target - 2; ++bucket)
+        {
+            // Average of the next bucket, or the last point after the final one
+            const int nextStart = first + 1 + static_cast<int>(std::floor((bucket + 1) * every));
+            const int nextEnd = std::min(first + 1 + static_cast<int>(std::floor((bucket + 2) * every)), last + 1);
+            double avgX = 0, avgY = 0;
+            for (int i = nextStart; i < nextEnd; ++i)
+            {
+                avgX += static_cast<double>(x(i));
+                avgY += static_cast<double>(y(i));
+            }
+            if (nextEnd > nextStart)
+            {
+                avgX /= nextEnd - nextStart;
+                avgY /= nextEnd - nextStart;
+            }
+            else
+            {
+                avgX = static_cast<double>(x(last));
+                avgY = static_cast<double>(y(last));
+            }
+
+            const int from = first + 1 + static_cast<int>(std::floor(bucket * every));
+            const int to = std::min(first + 1 + static_cast<int>(std::floor((bucket + 1) * every)), last);
+            const double ax = static_cast<double>(x(a));
+            const double ay = static_cast<double>(y(a));
+            double maxArea = -1;
+            int chosen = from;
+            for (int i = from; i < to; ++i)
+            {
+                // Twice the triangle's area; only the comparison matters
+                const double area = std::fabs((ax - avgX) * (static_cast<double>(y(i)) - ay)
+                                              - (ax - static_cast<double>(x(i))) * (avgY - ay));
+                if (area > maxArea)
+                {
+                    maxArea = area;
+                    chosen = i;
+                }
+            }
+            kept.push_back(chosen);
+            a = chosen;
+        }
+    }
+    kept.push_back(last);
+    return kept;
+}
+
+} // namespace Downsample
+
+#endif // DOWNSAMPLE_H
@@ -24,7 +24,7 @@
 #endif
 
 DriveFormatThread::DriveFormatThread(const QByteArray &device, QObject *parent)
-    : QThread(parent), _device(device)
+    : QThread(parent), _device(device), _quickFormat(false)
 {
 
 }
@@ -34,6 +34,11 @@ DriveFormatThread::~DriveFormatThread()
     wait();
 }
 
+void DriveFormatThread::setQuickFormat(bool quick)
+{
+    _quickFormat = quick;
+}
+
 std::uint64_t DriveFormatThread::getDeviceSize(const QByteArray &device)
 {
     auto driveList = Drivelist::ListStorageDevices();
@@ -71,13 +76,22 @@ void DriveFormatThread::run()
     // Windows-specific disk preparation
     emit preparationStatusUpdate(tr("Preparing disk for formatting..."));
     
-    // Clean disk with diskpart utility (standardized to 60s timeout with 3 retries, always unmount volumes)
+    // Clean disk with direct IOCTLs, as for writing an image
+    emit preparationStatusUpdate(tr("Unmounting volumes..."));
+    DiskpartUtil::unmountVolumes(_device);
     emit preparationStatusUpdate(tr("Cleaning disk..."));
-    auto diskpartResult = DiskpartUtil::cleanDisk(_device, std::chrono::seconds(60), 3, DiskpartUtil::VolumeHandling::UnmountFirst);
-    if (!diskpartResult.success)
+    auto cleanResult = DiskpartUtil::cleanDiskFast(_device);
+    if (!cleanResult.success)
     {
-        emit error(diskpartResult.errorMessage);
-        return;
+        // Fall back to diskpart (standardized to 60s timeout with 3 retries)
+        qDebug() << "Fast disk clean failed, falling back to diskpart:" << cleanResult.errorMessage;
+        emit preparationStatusUpdate(tr("Cleaning disk (legacy method)..."));
+        cleanResult = DiskpartUtil::cleanDisk(_device, std::chrono::seconds(60), 3, DiskpartUtil::VolumeHandling::SkipUnmounting);
+        if (!cleanResult.success)
+        {
+            emit error(cleanResult.errorMessage);
+            return;
+        }
     }
 #endif
 
@@ -113,7 +127,8 @@ void DriveFormatThread::run()
     formatTimer.start();
     
     rpi_imager::DiskFormatter formatter;
-    auto formatResult = formatter.FormatDrive(_device.toStdString());
+    auto formatResult = formatter.FormatDrive(_device.toStdString(),
+        _quickFormat ? rpi_imager::FormatMode::kQuick : rpi_imager::FormatMode::kFull);
 
     quint32 formatDurationMs = static_cast<quint32>(formatTimer.elapsed());
     
@@ -122,7 +137,8 @@ void DriveFormatThread::run()
         emit error(formatErrorToString(formatResult.error()));
     } else {
         emit eventDriveFormat(formatDurationMs, true);
-        qDebug() << "Cross-platform disk formatter succeeded in" << formatDurationMs << "ms";
+        qDebug() << "Cross-platform disk formatter succeeded in" << formatDurationMs << "ms"
+                 << (_quickFormat ? "(quick format)" : "");
         emit success();
     }
 }
@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Storage device hotplug notifications for rpi-imager.
+ * Lets the drive list rescan as soon as something changes, instead of
+ * relying on frequent polling alone.
+ */
+
+#ifndef DEVICEMONITOR_H
+#define DEVICEMONITOR_H
+
+#include <functional>
+#include <memory>
+
+namespace Drivelist {
+
+/**
+ * @brief Notifies when storage devices may have been added, removed or changed
+ *
+ * This class is implemented per-platform:
+ * - Linux: udev netlink monitor (block and USB device events)
+ * - macOS: DiskArbitration appeared/disappeared/changed callbacks
+ * - Windows: WM_DEVICECHANGE device interface notifications
+ *
+ * Notifications only say that *something* changed; callers rescan with
+ * ListStorageDevices(). Several notifications may arrive for a single
+ * change (e.g. a disk and each of its partitions), so callers should
+ * coalesce them.
+ *
+ * The callback is invoked on a thread owned by the monitor and must be
+ * cheap and thread-safe.
+ */
+class DeviceMonitor
+{
+public:
+    explicit DeviceMonitor(std::function<void()> onChange);
+    ~DeviceMonitor();
+
+    DeviceMonitor(const DeviceMonitor&) = delete;
+    DeviceMonitor& operator=(const DeviceMonitor&) = delete;
+
+    /**
+     * @brief Start delivering notifications
+     * @return false if event notifications are unavailable; callers should
+     *         then rely on polling
+     */
+    bool start();
+
+    /**
+     * @brief Stop delivering notifications
+     *
+     * After this returns the callback is no longer running and will not
+     * be invoked again. Also called by the destructor.
+     */
+    void stop();
+
+    /**
+     * @brief Whether USB devices without storage (rpiboot, fastboot) are reported too
+     */
+    [[nodiscard]] bool coversUsbDevices() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+} // namespace Drivelist
+
+#endif // DEVICEMONITOR_H
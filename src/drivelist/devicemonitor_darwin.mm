@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * macOS hotplug notifications using DiskArbitration.
+ *
+ * Design notes:
+ * - Registers disk appeared/disappeared/description changed callbacks on
+ *   a private serial dispatch queue, so no run loop is needed
+ * - DiskArbitration reports every existing disk as "appeared" right after
+ *   registration; that only triggers one extra rescan
+ * - rpiboot/fastboot devices are plain USB devices, not disks, and are not
+ *   reported
+ */
+
+#include "devicemonitor.h"
+
+#import <DiskArbitration/DiskArbitration.h>
+#include <dispatch/dispatch.h>
+
+namespace Drivelist {
+
+struct DeviceMonitor::Impl {
+    std::function<void()> onChange;
+    DASessionRef session = nullptr;
+    dispatch_queue_t queue = nullptr;
+
+    static void diskChanged(DADiskRef, void *context)
+    {
+        static_cast<Impl *>(context)->onChange();
+    }
+
+    static void diskDescriptionChanged(DADiskRef, CFArrayRef, void *context)
+    {
+        static_cast<Impl *>(context)->onChange();
+    }
+};
+
+DeviceMonitor::DeviceMonitor(std::function<void()> onChange)
+    : _impl(std::make_unique<Impl>())
+{
+    _impl->onChange = std::move(onChange);
+}
+
+DeviceMonitor::~DeviceMonitor()
+{
+    stop();
+}
+
+bool DeviceMonitor::start()
+{
+    if (_impl->session)
+        return true;
+
+    _impl->session = DASessionCreate(kCFAllocatorDefault);
+    if (!_impl->session)
+        return false;
+
+    _impl->queue = dispatch_queue_create("com.raspberrypi.imager.devicemonitor", DISPATCH_QUEUE_SERIAL);
+    DARegisterDiskAppearedCallback(_impl->session, nullptr, Impl::diskChanged, _impl.get());
+    DARegisterDiskDisappearedCallback(_impl->session, nullptr, Impl::diskChanged, _impl.get());
+    DARegisterDiskDescriptionChangedCallback(_impl->session, nullptr, nullptr, Impl::diskDescriptionChanged, _impl.get());
+    DASessionSetDispatchQueue(_impl->session, _impl->queue);
+    return true;
+}
+
+void DeviceMonitor::stop()
+{
+    if (!_impl->session)
+        return;
+
+    DASessionSetDispatchQueue(_impl->session, nullptr);
+    // Wait for a callback that may already be running on the queue
+    dispatch_sync(_impl->queue, ^{});
+
+    DAUnregisterCallback(_impl->session, reinterpret_cast<void *>(Impl::diskChanged), _impl.get());
+    DAUnregisterCallback(_impl->session, reinterpret_cast<void *>(Impl::diskDescriptionChanged), _impl.get());
+    CFRelease(_impl->session);
+    _impl->session = nullptr;
+#if !__has_feature(objc_arc)
+    dispatch_release(_impl->queue);
+#endif
+    _impl->queue = nullptr;
+}
+
+bool DeviceMonitor::coversUsbDevices() const
+{
+    return false;
+}
+
+} // namespace Drivelist
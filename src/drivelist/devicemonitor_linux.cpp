@@ -0,0 +1,141 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Linux hotplug notifications using a udev netlink monitor.
+ *
+ * Design notes:
+ * - Listens on the "udev" netlink group, so events arrive after udev rules
+ *   have run and lsblk sees the new device state
+ * - Watches block devices (disks, partitions, media changes) and USB
+ *   devices (rpiboot/fastboot targets, which have no block device)
+ * - A dedicated thread poll()s the monitor socket and an eventfd used to
+ *   stop it
+ */
+
+#include "devicemonitor.h"
+
+#include <libudev.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <QDebug>
+
+namespace Drivelist {
+
+struct DeviceMonitor::Impl {
+    std::function<void()> onChange;
+    struct udev *udev = nullptr;
+    struct udev_monitor *monitor = nullptr;
+    int stopFd = -1;
+    std::thread thread;
+
+    void run()
+    {
+        const int monitorFd = udev_monitor_get_fd(monitor);
+        pollfd fds[2] = {
+            { monitorFd, POLLIN, 0 },
+            { stopFd, POLLIN, 0 }
+        };
+
+        while (true) {
+            if (::poll(fds, 2, -1) < 0) {
+                if (errno == EINTR)
+                    continue;
+                qWarning() << "DeviceMonitor: poll failed:" << strerror(errno);
+                return;
+            }
+            if (fds[1].revents)
+                return;
+            if (!(fds[0].revents & POLLIN))
+                continue;
+
+            // Drain everything queued so a burst of events (disk plus each
+            // partition) results in a single notification
+            bool changed = false;
+            while (struct udev_device *dev = udev_monitor_receive_device(monitor)) {
+                changed = true;
+                udev_device_unref(dev);
+            }
+            if (changed)
+                onChange();
+        }
+    }
+};
+
+DeviceMonitor::DeviceMonitor(std::function<void()> onChange)
+    : _impl(std::make_unique<Impl>())
+{
+    _impl->onChange = std::move(onChange);
+}
+
+DeviceMonitor::~DeviceMonitor()
+{
+    stop();
+}
+
+bool DeviceMonitor::start()
+{
+    if (_impl->thread.joinable())
+        return true;
+
+    _impl->udev = udev_new();
+    if (!_impl->udev) {
+        qWarning() << "DeviceMonitor: udev_new failed";
+        return false;
+    }
+
+    _impl->monitor = udev_monitor_new_from_netlink(_impl->udev, "udev");
+    if (!_impl->monitor ||
+        udev_monitor_filter_add_match_subsystem_devtype(_impl->monitor, "block", nullptr) < 0 ||
+        udev_monitor_filter_add_match_subsystem_devtype(_impl->monitor, "usb", "usb_device") < 0 ||
+        udev_monitor_enable_receiving(_impl->monitor) < 0) {
+        qWarning() << "DeviceMonitor: could not set up udev monitor";
+        stop();
+        return false;
+    }
+
+    _impl->stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_impl->stopFd < 0) {
+        qWarning() << "DeviceMonitor: eventfd failed:" << strerror(errno);
+        stop();
+        return false;
+    }
+
+    _impl->thread = std::thread([impl = _impl.get()] { impl->run(); });
+    qDebug() << "DeviceMonitor: listening for udev block/usb events";
+    return true;
+}
+
+void DeviceMonitor::stop()
+{
+    if (_impl->thread.joinable()) {
+        const uint64_t one = 1;
+        if (::write(_impl->stopFd, &one, sizeof(one)) < 0)
+            qWarning() << "DeviceMonitor: failed to signal monitor thread:" << strerror(errno);
+        _impl->thread.join();
+    }
+    if (_impl->stopFd >= 0) {
+        ::close(_impl->stopFd);
+        _impl->stopFd = -1;
+    }
+    if (_impl->monitor) {
+        udev_monitor_unref(_impl->monitor);
+        _impl->monitor = nullptr;
+    }
+    if (_impl->udev) {
+        udev_unref(_impl->udev);
+        _impl->udev = nullptr;
+    }
+}
+
+bool DeviceMonitor::coversUsbDevices() const
+{
+    return true;
+}
+
+} // namespace Drivelist
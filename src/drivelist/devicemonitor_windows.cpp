@@ -0,0 +1,145 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Windows hotplug notifications using WM_DEVICECHANGE.
+ *
+ * Design notes:
+ * - A message-only window on a dedicated thread receives the messages;
+ *   message-only windows get no broadcasts, so device interface
+ *   notifications are registered explicitly
+ * - Registers for all interface classes, which covers disks, volumes
+ *   (media inserted into a card reader) and raw USB devices (rpiboot,
+ *   fastboot)
+ */
+
+#include "devicemonitor.h"
+
+#include <windows.h>
+#include <dbt.h>
+#include <thread>
+#include <QDebug>
+
+namespace Drivelist {
+
+namespace {
+
+const wchar_t *kWindowClassName = L"RpiImagerDeviceMonitor";
+
+} // namespace
+
+struct DeviceMonitor::Impl {
+    std::function<void()> onChange;
+    std::thread thread;
+    HWND window = nullptr;
+    HANDLE ready = nullptr;
+    bool started = false;
+
+    static LRESULT CALLBACK windowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+    {
+        if (msg == WM_DEVICECHANGE &&
+            (wParam == DBT_DEVICEARRIVAL || wParam == DBT_DEVICEREMOVECOMPLETE)) {
+            auto *impl = reinterpret_cast<Impl *>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+            if (impl)
+                impl->onChange();
+            return TRUE;
+        }
+        return DefWindowProcW(hwnd, msg, wParam, lParam);
+    }
+
+    void run()
+    {
+        HINSTANCE instance = GetModuleHandleW(nullptr);
+        WNDCLASSEXW wc = {};
+        wc.cbSize = sizeof(wc);
+        wc.lpfnWndProc = windowProc;
+        wc.hInstance = instance;
+        wc.lpszClassName = kWindowClassName;
+        RegisterClassExW(&wc);  // Fails harmlessly if already registered
+
+        window = CreateWindowExW(0, kWindowClassName, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, instance, nullptr);
+        HDEVNOTIFY notify = nullptr;
+        if (window) {
+            SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+
+            DEV_BROADCAST_DEVICEINTERFACE_W filter = {};
+            filter.dbcc_size = sizeof(filter);
+            filter.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
+            notify = RegisterDeviceNotificationW(window, &filter,
+                                                 DEVICE_NOTIFY_WINDOW_HANDLE | DEVICE_NOTIFY_ALL_INTERFACE_CLASSES);
+            if (!notify) {
+                qWarning() << "DeviceMonitor: RegisterDeviceNotification failed:" << GetLastError();
+                DestroyWindow(window);
+                window = nullptr;
+            }
+        } else {
+            qWarning() << "DeviceMonitor: CreateWindowEx failed:" << GetLastError();
+        }
+
+        started = window != nullptr;
+        SetEvent(ready);
+        if (!started)
+            return;
+
+        MSG msg;
+        while (GetMessageW(&msg, nullptr, 0, 0) > 0) {
+            TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+
+        UnregisterDeviceNotification(notify);
+        DestroyWindow(window);
+        window = nullptr;
+    }
+};
+
+DeviceMonitor::DeviceMonitor(std::function<void()> onChange)
+    : _impl(std::make_unique<Impl>())
+{
+    _impl->onChange = std::move(onChange);
+}
+
+DeviceMonitor::~DeviceMonitor()
+{
+    stop();
+}
+
+bool DeviceMonitor::start()
+{
+    if (_impl->thread.joinable())
+        return _impl->started;
+
+    _impl->ready = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!_impl->ready)
+        return false;
+
+    _impl->thread = std::thread([impl = _impl.get()] { impl->run(); });
+    WaitForSingleObject(_impl->ready, INFINITE);
+    CloseHandle(_impl->ready);
+    _impl->ready = nullptr;
+
+    if (!_impl->started) {
+        _impl->thread.join();
+        return false;
+    }
+    qDebug() << "DeviceMonitor: listening for device interface changes";
+    return true;
+}
+
+void DeviceMonitor::stop()
+{
+    if (!_impl->thread.joinable())
+        return;
+
+    if (_impl->window)
+        PostMessageW(_impl->window, WM_QUIT, 0, 0);
+    _impl->thread.join();
+    _impl->started = false;
+}
+
+bool DeviceMonitor::coversUsbDevices() const
+{
+    return true;
+}
+
+} // namespace Drivelist
@@ -307,7 +307,7 @@ struct DeviceDescriptor {
  * @brief Enumerate all storage devices on the system
  *
  * This function is implemented per-platform:
- * - Linux: Uses lsblk with JSON output
+ * - Linux: Reads sysfs and /proc/self/mountinfo, falling back to lsblk
  * - macOS: Uses DiskArbitration and IOKit frameworks
  * - Windows: Uses SetupDi and DeviceIoControl APIs
  *
@@ -324,6 +324,7 @@ std::vector<DeviceDescriptor> ListStorageDevices();
 // These are declared in the platform implementation files when
 // DRIVELIST_ENABLE_TEST_API is defined. See:
 // - drivelist_linux.cpp: Drivelist::testing::parseLinuxBlockDevices()
+// - drivelist_linux.cpp: Drivelist::testing::parseSysfsBlockDevices()
 // - drivelist_windows.cpp: Drivelist::testing::windowsBusTypeToString()
 // - drivelist_windows.cpp: Drivelist::testing::isWindowsSystemDevice()
 
@@ -0,0 +1,524 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Benchmarks for drive enumeration and hotplug handling.
+ *
+ * Every card swap waits on the path from the hotplug notification to the
+ * drive list showing the new card. This measures its parts:
+ * - ListStorageDevices() with the platform backend, on the devices present
+ * - on Linux, the lsblk and sysfs backends on synthetic device counts
+ * - DriveListModel taking in a list with one drive more or less
+ * - enumeration on a worker thread through to the model's row change, the
+ *   way the poll thread delivers it, for synthetic device counts
+ *
+ * Tagged [.benchmark] so a plain run does nothing; run with
+ *   ./drivelist_benchmarks "[benchmark]"
+ * Results are also written as JSON to $RPI_IMAGER_DRIVELIST_BENCHMARK_JSON
+ * (default drivelist_benchmarks.json) for regression tracking.
+ *
+ * With RPI_IMAGER_BENCHMARK_HOTPLUG=<n>, "[hotplug]" also times n real
+ * card insertions or removals, from the first notification of the device
+ * monitor to the row change in a polling DriveListModel.
+ */
+
+// DRIVELIST_ENABLE_TEST_API is defined via CMake compile definitions
+#include <QtGlobal>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark_all.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <catch2/reporters/catch_reporter_event_listener.hpp>
+#include <catch2/reporters/catch_reporter_registrars.hpp>
+
+#include "drivelist.h"
+#include "devicemonitor.h"
+#include "drivelistmodel.h"
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <filesystem>
+#include <unistd.h>
+#endif
+
+using namespace Drivelist;
+
+// ── Regression JSON ─────────────────────────────────────────────────────
+
+namespace {
+    struct Result {
+        std::string name;
+        double meanNs, lowMeanNs, highMeanNs, stddevNs;
+        size_t samples;
+        int iterations;
+    };
+
+    // Results timed outside BENCHMARK, such as real hotplug events
+    std::vector<Result> &recordedResults()
+    {
+        static std::vector<Result> results;
+        return results;
+    }
+
+    void record(const std::string &name, const std::vector<double> &samplesNs)
+    {
+        if (samplesNs.empty())
+            return;
+        double sum = 0;
+        for (double s : samplesNs)
+            sum += s;
+        const double mean = sum / samplesNs.size();
+        double variance = 0;
+        for (double s : samplesNs)
+            variance += (s - mean) * (s - mean);
+        const double stddev = std::sqrt(variance / samplesNs.size());
+        const auto [low, high] = std::minmax_element(samplesNs.begin(), samplesNs.end());
+        recordedResults().push_back({name, mean, *low, *high, stddev, samplesNs.size(), 1});
+    }
+
+    std::string jsonString(const std::string &s)
+    {
+        std::string out = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    const char *platformName()
+    {
+#if defined(Q_OS_WIN)
+        return "windows";
+#elif defined(Q_OS_MACOS)
+        return "macos";
+#else
+        return "linux";
+#endif
+    }
+
+    class BenchmarkJsonListener : public Catch::EventListenerBase
+    {
+    public:
+        using Catch::EventListenerBase::EventListenerBase;
+
+        void benchmarkEnded(Catch::BenchmarkStats<> const &stats) override
+        {
+            Result r;
+            r.name = stats.info.name;
+            r.meanNs = stats.mean.point.count();
+            r.lowMeanNs = stats.mean.lower_bound.count();
+            r.highMeanNs = stats.mean.upper_bound.count();
+            r.stddevNs = stats.standardDeviation.point.count();
+            r.samples = stats.samples.size();
+            r.iterations = stats.info.iterations;
+            _results.push_back(r);
+        }
+
+        void testRunEnded(Catch::TestRunStats const &) override
+        {
+            _results.insert(_results.end(), recordedResults().begin(), recordedResults().end());
+            if (_results.empty())
+                return;
+
+            const char *env = std::getenv("RPI_IMAGER_DRIVELIST_BENCHMARK_JSON");
+            const std::string path = env && *env ? env : "drivelist_benchmarks.json";
+            std::ofstream out(path);
+            if (!out)
+                return;
+
+            const std::time_t now = std::time(nullptr);
+            char timestamp[32];
+            std::strftime(timestamp, sizeof timestamp, "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+            out << "{\n  \"version\": 1,\n"
+                << "  \"timestamp\": " << jsonString(timestamp) << ",\n"
+                << "  \"context\": {\n"
+                << "    \"platform\": " << jsonString(platformName()) << ",\n"
+                << "    \"devicesPresent\": " << ListStorageDevices().size() << ",\n"
+                << "    \"hardwareThreads\": " << std::thread::hardware_concurrency() << "\n"
+                << "  },\n  \"benchmarks\": [\n";
+            for (size_t i = 0; i < _results.size(); ++i) {
+                const Result &r = _results[i];
+                out << "    {\"name\": " << jsonString(r.name)
+                    << ", \"meanNs\": " << r.meanNs
+                    << ", \"lowMeanNs\": " << r.lowMeanNs
+                    << ", \"highMeanNs\": " << r.highMeanNs
+                    << ", \"stddevNs\": " << r.stddevNs
+                    << ", \"samples\": " << r.samples
+                    << ", \"iterations\": " << r.iterations
+                    << "}" << (i + 1 < _results.size() ? "," : "") << "\n";
+            }
+            out << "  ]\n}\n";
+        }
+
+    private:
+        std::vector<Result> _results;
+    };
+}
+
+CATCH_REGISTER_LISTENER(BenchmarkJsonListener)
+
+// ── Test data ───────────────────────────────────────────────────────────
+
+namespace {
+    QCoreApplication *app()
+    {
+        static int argc = 1;
+        static char name[] = "drivelist_benchmarks";
+        static char *argv[] = {name, nullptr};
+        static QCoreApplication *instance = new QCoreApplication(argc, argv);
+        return instance;
+    }
+
+    // Kernel naming: sda..sdz, then sdaa..
+    std::string diskName(int index)
+    {
+        std::string name = "sd";
+        if (index >= 26)
+            name += char('a' + index / 26 - 1);
+        name += char('a' + index % 26);
+        return name;
+    }
+
+    // A USB card reader with a mounted boot partition, as the backends report it
+    DeviceDescriptor usbDisk(int index)
+    {
+        DeviceDescriptor d;
+        d.device = "/dev/" + diskName(index);
+        d.raw = d.device;
+        d.description = "Generic STORAGE DEVICE " + std::to_string(index);
+        d.size = 32010928128ULL;
+        d.busType = "USB";
+        d.isRemovable = true;
+        d.isCard = true;
+        d.isUSB = true;
+        d.mountpoints = {"/media/user/boot" + std::to_string(index)};
+        d.mountpointLabels = {"bootfs"};
+        return d;
+    }
+
+    std::vector<DeviceDescriptor> usbDisks(int count)
+    {
+        std::vector<DeviceDescriptor> list;
+        for (int i = 0; i < count; ++i)
+            list.push_back(usbDisk(i));
+        return list;
+    }
+
+    // Run the event loop until the model next inserts or removes rows
+    class RowChangeWaiter
+    {
+    public:
+        explicit RowChangeWaiter(DriveListModel &model)
+        {
+            QObject::connect(&model, &QAbstractItemModel::rowsInserted, &_loop, &QEventLoop::quit);
+            QObject::connect(&model, &QAbstractItemModel::rowsRemoved, &_loop, &QEventLoop::quit);
+        }
+
+        void wait() { _loop.exec(); }
+
+    private:
+        QEventLoop _loop;
+    };
+}
+
+#ifdef Q_OS_LINUX
+
+namespace {
+    namespace fs = std::filesystem;
+
+    void writeSysfsFile(const fs::path &path, const std::string &content)
+    {
+        fs::create_directories(path.parent_path());
+        std::ofstream(path) << content << "\n";
+    }
+
+    std::string lsblkJson(int disks)
+    {
+        std::string json = R"({"blockdevices": [)";
+        for (int i = 0; i < disks; ++i) {
+            const std::string name = "/dev/" + diskName(i);
+            json += i ? "," : "";
+            json += R"({"kname": ")" + name + R"(", "type": "disk", "subsystems": "block:scsi:usb:pci",)"
+                    R"( "ro": false, "rm": true, "hotplug": true, "size": "32010928128",)"
+                    R"( "phy-sec": 512, "log-sec": 512, "label": "", "vendor": "Generic ",)"
+                    R"( "model": "STORAGE DEVICE  ", "mountpoint": null, "children": [)"
+                    R"({"kname": ")" + name + R"(1", "type": "part", "label": "bootfs",)"
+                    R"( "mountpoint": "/media/user/boot)" + std::to_string(i) + R"("},)"
+                    R"({"kname": ")" + name + R"(2", "type": "part", "label": "rootfs", "mountpoint": null}]})";
+        }
+        return json + "]}";
+    }
+
+    /**
+     * A sysfs tree of USB card readers, laid out as the kernel does
+     * (see the sysfs test in drivelist_test.cpp). Plugging a disk in or
+     * out adds or removes its link in block/, as the kernel does.
+     */
+    class SyntheticSysfs
+    {
+    public:
+        explicit SyntheticSysfs(int disks)
+            : _root(fs::temp_directory_path() / ("drivelist_benchmark_" + std::to_string(::getpid())))
+        {
+            fs::remove_all(_root);
+            for (const char *bus : {"bus/pci", "bus/usb", "bus/scsi", "class/block"})
+                fs::create_directories(sys() / bus);
+            fs::create_directories(sys() / "block");
+
+            const fs::path pci = sys() / "devices/pci0000:00/0000:00:14.0";
+            linkSubsystem(pci, "bus/pci");
+            linkSubsystem(pci / "usb2", "bus/usb");
+
+            std::string mounts = "25 1 259:2 / / rw,relatime shared:1 - ext4 /dev/nvme0n1p2 rw\n";
+            for (int i = 0; i < disks; ++i) {
+                const std::string port = "2-" + std::to_string(i + 1);
+                const std::string host = "host" + std::to_string(i);
+                const fs::path usbDev = pci / "usb2" / port;
+                const fs::path scsiDev = usbDev / (port + ":1.0") / host / ("target" + std::to_string(i) + ":0:0")
+                                         / (std::to_string(i) + ":0:0:0");
+                const std::string name = diskName(i);
+                const fs::path disk = scsiDev / "block" / name;
+                const std::string minor = std::to_string(16 * i);
+                const std::string partMinor = std::to_string(16 * i + 1);
+
+                linkSubsystem(usbDev, "bus/usb");
+                linkSubsystem(usbDev / (port + ":1.0"), "bus/usb");
+                linkSubsystem(usbDev / (port + ":1.0") / host, "bus/scsi");
+                linkSubsystem(scsiDev, "bus/scsi");
+                linkSubsystem(disk, "class/block");
+                writeSysfsFile(usbDev / "removable", "removable");
+                writeSysfsFile(disk / "dev", "8:" + minor);
+                writeSysfsFile(disk / "size", "62521344");
+                writeSysfsFile(disk / "ro", "0");
+                writeSysfsFile(disk / "removable", "1");
+                writeSysfsFile(disk / "queue/physical_block_size", "512");
+                writeSysfsFile(disk / "queue/logical_block_size", "512");
+                writeSysfsFile(disk / (name + "1") / "partition", "1");
+                writeSysfsFile(disk / (name + "1") / "dev", "8:" + partMinor);
+                writeSysfsFile(udev() / ("b8:" + minor), "E:ID_VENDOR=Generic\nE:ID_MODEL=STORAGE_DEVICE");
+                writeSysfsFile(udev() / ("b8:" + partMinor), "E:ID_FS_LABEL=bootfs");
+                _disks.push_back(disk);
+                mounts += "3" + std::to_string(i) + " 25 8:" + partMinor + " / /media/user/boot" + std::to_string(i)
+                          + " rw,relatime shared:2 - vfat /dev/" + name + "1 rw\n";
+                setPlugged(i, true);
+            }
+            _mountinfo = mounts;
+        }
+
+        ~SyntheticSysfs() { fs::remove_all(_root); }
+
+        void setPlugged(int index, bool plugged)
+        {
+            const fs::path link = sys() / "block" / diskName(index);
+            if (plugged)
+                fs::create_directory_symlink(_disks[index], link);
+            else
+                fs::remove(link);
+        }
+
+        std::vector<DeviceDescriptor> scan() const
+        {
+            return testing::parseSysfsBlockDevices((sys() / "block").string(), udev().string(), _mountinfo);
+        }
+
+    private:
+        fs::path sys() const { return _root / "sys"; }
+        fs::path udev() const { return _root / "udev"; }
+
+        void linkSubsystem(const fs::path &dir, const char *subsystem)
+        {
+            fs::create_directories(dir);
+            if (!fs::exists(dir / "subsystem"))
+                fs::create_directory_symlink(sys() / subsystem, dir / "subsystem");
+        }
+
+        fs::path _root;
+        std::vector<fs::path> _disks;
+        std::string _mountinfo;
+    };
+}
+
+#endif // Q_OS_LINUX
+
+// ── Enumeration ─────────────────────────────────────────────────────────
+
+TEST_CASE("ListStorageDevices latency", "[.benchmark][drivelist]")
+{
+    BENCHMARK(std::string("ListStorageDevices, ") + platformName())
+    {
+        return ListStorageDevices();
+    };
+}
+
+#ifdef Q_OS_LINUX
+
+TEST_CASE("Linux enumeration backends on synthetic devices", "[.benchmark][drivelist][linux]")
+{
+    const int disks = GENERATE(4, 32, 128);
+
+    const std::string json = lsblkJson(disks);
+    REQUIRE(testing::parseLinuxBlockDevices(json, false).size() == size_t(disks));
+    BENCHMARK("lsblk parse, " + std::to_string(disks) + " disks")
+    {
+        return testing::parseLinuxBlockDevices(json, false);
+    };
+
+    // Without the scan cache ListStorageDevices() keeps between polls
+    const SyntheticSysfs sysfs(disks);
+    REQUIRE(sysfs.scan().size() == size_t(disks));
+    BENCHMARK("sysfs scan, " + std::to_string(disks) + " disks")
+    {
+        return sysfs.scan();
+    };
+}
+
+#endif // Q_OS_LINUX
+
+// ── Hotplug ─────────────────────────────────────────────────────────────
+
+TEST_CASE("DriveListModel update for one inserted or removed card", "[.benchmark][drivelist][model]")
+{
+    app();
+    const int disks = GENERATE(4, 32, 128);
+
+    const std::vector<DeviceDescriptor> without = usbDisks(disks);
+    const std::vector<DeviceDescriptor> with = usbDisks(disks + 1);
+    DriveListModel model;
+    model.processDriveList(without);
+    REQUIRE(model.rowCount() == disks);
+
+    // Alternate between the two lists, so each run is one card going in or out
+    bool plugged = false;
+    BENCHMARK_ADVANCED("DriveListModel update, " + std::to_string(disks) + " drives")(Catch::Benchmark::Chronometer meter)
+    {
+        meter.measure([&] {
+            plugged = !plugged;
+            model.processDriveList(plugged ? with : without);
+            // Removed rows are deleted later, as the event loop would
+            QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+            return model.rowCount();
+        });
+    };
+}
+
+TEST_CASE("Hotplug to drive list latency on synthetic devices", "[.benchmark][drivelist][hotplug]")
+{
+    app();
+    const int disks = GENERATE(4, 32, 128);
+
+#ifdef Q_OS_LINUX
+    // The inserted card is the last one of the tree
+    SyntheticSysfs sysfs(disks + 1);
+    sysfs.setPlugged(disks, false);
+    auto enumerate = [&](bool plugged) {
+        sysfs.setPlugged(disks, plugged);
+        return sysfs.scan();
+    };
+#else
+    const std::vector<DeviceDescriptor> without = usbDisks(disks);
+    const std::vector<DeviceDescriptor> with = usbDisks(disks + 1);
+    auto enumerate = [&](bool plugged) { return plugged ? with : without; };
+#endif
+
+    DriveListModel model;
+    model.processDriveList(enumerate(false));
+    REQUIRE(model.rowCount() == disks);
+
+    // Stands in for the poll thread: enumerate there, deliver to the model's thread
+    QThread pollThread;
+    QObject poller;
+    poller.moveToThread(&pollThread);
+    pollThread.start();
+
+    RowChangeWaiter waiter(model);
+    bool plugged = false;
+    auto hotplug = [&] {
+        plugged = !plugged;
+        QMetaObject::invokeMethod(&poller, [&, plugged] {
+            QMetaObject::invokeMethod(&model, [&model, list = enumerate(plugged)]() mutable {
+                model.processDriveList(std::move(list));
+            }, Qt::QueuedConnection);
+        }, Qt::QueuedConnection);
+        waiter.wait();
+    };
+
+    hotplug();
+    CHECK(model.rowCount() == disks + 1);
+    hotplug();
+    CHECK(model.rowCount() == disks);
+
+    BENCHMARK_ADVANCED("Hotplug to model, " + std::to_string(disks) + " drives")(Catch::Benchmark::Chronometer meter)
+    {
+        meter.measure([&] {
+            hotplug();
+            return model.rowCount();
+        });
+    };
+
+    pollThread.quit();
+    pollThread.wait();
+}
+
+TEST_CASE("Hotplug to drive list latency on real devices", "[.benchmark][drivelist][hotplug]")
+{
+    const char *env = std::getenv("RPI_IMAGER_BENCHMARK_HOTPLUG");
+    const int events = env ? std::atoi(env) : 0;
+    if (events <= 0)
+        SKIP("Set RPI_IMAGER_BENCHMARK_HOTPLUG to the number of card insertions and removals to time");
+
+    app();
+    using Clock = std::chrono::steady_clock;
+
+    // First notification since the model last changed; 0 when none is pending
+    std::atomic<Clock::rep> notified{0};
+    DeviceMonitor monitor([&notified] {
+        Clock::rep expected = 0;
+        notified.compare_exchange_strong(expected, Clock::now().time_since_epoch().count());
+    });
+    if (!monitor.start())
+        SKIP("Hotplug notifications are not available");
+
+    DriveListModel model;
+    RowChangeWaiter waiter(model);
+    model.startPolling();
+
+    // Let the first poll fill the model before any card moves
+    QEventLoop settle;
+    QTimer::singleShot(2000, &settle, &QEventLoop::quit);
+    settle.exec();
+    notified = 0;
+
+    std::vector<double> samplesNs;
+    WARN("Insert or remove a card " << events << " times");
+    while (int(samplesNs.size()) < events) {
+        waiter.wait();
+        const Clock::rep start = notified.exchange(0);
+        if (start == 0)
+            continue;  // A poll that was not caused by a notification
+        const auto elapsed = Clock::now().time_since_epoch() - Clock::duration(start);
+        samplesNs.push_back(std::chrono::duration<double, std::nano>(elapsed).count());
+        WARN("Drive list updated " << samplesNs.back() / 1e6 << " ms after the notification");
+    }
+
+    model.stopPolling();
+    monitor.stop();
+    record("Hotplug to model, real devices", samplesNs);
+}
@@ -5,7 +5,8 @@
  * macOS drive enumeration using DiskArbitration and IOKit.
  *
  * Design notes:
- * - Uses DiskArbitration for disk enumeration and property queries
+ * - Uses DiskArbitration for disk enumeration and property queries, with
+ *   one long-lived session whose callbacks keep a cache of the disks
  * - Uses IOKit for APFS parent device discovery
  * - Uses NSFileManager for mount point enumeration
  * - Separates disk enumeration from property extraction for testability
@@ -22,6 +23,11 @@
 #import <IOKit/IOBSD.h>
 #include <os/log.h>
 #include <sys/sysctl.h>
+#include <dispatch/dispatch.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
 
 // Unified logging for disk operations - visible in Console.app
 // Users can capture with: log collect --device --last 1h
@@ -261,49 +267,130 @@ DeviceDescriptor createDeviceDescriptor(const std::string& bsdName, CFDictionary
 }
 
 /**
- * @brief Callback for DiskArbitration disk enumeration
+ * @brief Whole disks as DiskArbitration reports them, kept up to date by a
+ * long-lived session
+ *
+ * Creating a session on every scan meant waiting on the run loop for the
+ * disks to be reported, and walking the IORegistry for every APFS volume,
+ * every few seconds. The session's callbacks run on a private serial
+ * queue and update the cached descriptors as disks appear, disappear or
+ * change, so a scan only copies them.
+ *
+ * Never destroyed: the callbacks may still run while the process exits.
  */
-void diskAppearedCallback(DADiskRef disk, void* context)
+class DiskCache
 {
-    auto* diskList = static_cast<NSMutableArray*>(context);
-    const char* bsdName = DADiskGetBSDName(disk);
-    if (bsdName) {
-        [diskList addObject:[NSString stringWithUTF8String:bsdName]];
+public:
+    static DiskCache& instance()
+    {
+        static DiskCache* cache = new DiskCache();
+        return *cache;
     }
-}
 
-/**
- * @brief Enumerate all disks using DiskArbitration
- * @param outDisks Output array to populate with BSD names
- * @return true on success
- *
- * Note: Uses a short run loop timeout. DiskArbitration callbacks are
- * typically very fast, but on systems with many disks this could
- * theoretically miss some. In practice, 50ms is sufficient.
- */
-bool enumerateDisks(NSMutableArray* outDisks)
-{
-    DASessionRef session = DASessionCreate(kCFAllocatorDefault);
-    if (!session) {
-        return false;
+    DASessionRef session() const { return _session; }
+
+    /**
+     * @brief Append the whole disks, in BSD name order
+     * @return false if there is no DiskArbitration session
+     */
+    bool copyDisks(std::vector<DeviceDescriptor>& out)
+    {
+        if (!_session) {
+            return false;
+        }
+
+        // DiskArbitration reports the existing disks right after
+        // registration; allow the 50ms enumeration always had, then let
+        // callbacks already queued finish
+        std::this_thread::sleep_until(_started + std::chrono::milliseconds(50));
+        dispatch_sync(_queue, ^{});
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        out.reserve(out.size() + _disks.size());
+        for (const auto& [bsdName, device] : _disks) {
+            out.push_back(device);
+        }
+        return true;
     }
 
-    // Register callback and run loop briefly to collect disks
-    DARegisterDiskAppearedCallback(session, nullptr, diskAppearedCallback, (__bridge void*)outDisks);
+private:
+    DiskCache()
+    {
+        _session = DASessionCreate(kCFAllocatorDefault);
+        if (!_session) {
+            return;
+        }
 
-    CFRunLoopRef runLoop = [[NSRunLoop currentRunLoop] getCFRunLoop];
-    DASessionScheduleWithRunLoop(session, runLoop, kCFRunLoopDefaultMode);
-    CFRunLoopStop(runLoop);
-    CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0.05, NO);
+        _queue = dispatch_queue_create("com.raspberrypi.imager.drivelist", DISPATCH_QUEUE_SERIAL);
+        _started = std::chrono::steady_clock::now();
+        DARegisterDiskAppearedCallback(_session, nullptr, diskAppeared, this);
+        DARegisterDiskDisappearedCallback(_session, nullptr, diskDisappeared, this);
+        DARegisterDiskDescriptionChangedCallback(_session, nullptr, nullptr, diskDescriptionChanged, this);
+        DASessionSetDispatchQueue(_session, _queue);
+    }
 
-    DAUnregisterCallback(session, reinterpret_cast<void*>(diskAppearedCallback), (__bridge void*)outDisks);
-    CFRelease(session);
+    void update(DADiskRef disk)
+    {
+        const char* bsdNameCStr = DADiskGetBSDName(disk);
+        if (!bsdNameCStr) {
+            return;
+        }
 
-    // Sort for consistent ordering
-    [outDisks sortUsingSelector:@selector(localizedCaseInsensitiveCompare:)];
+        @autoreleasepool {
+            // Partitions are only looked at for their mount points
+            if (isPartition([NSString stringWithUTF8String:bsdNameCStr])) {
+                return;
+            }
 
-    return true;
-}
+            std::string bsdName = bsdNameCStr;
+            CFDictionaryRef diskDescription = DADiskCopyDescription(disk);
+            if (!diskDescription) {
+                DRIVELIST_LOG_DEBUG("DiskCache: dropping %{public}s (no description)", bsdName.c_str());
+                remove(disk);
+                return;
+            }
+
+            DeviceDescriptor device = createDeviceDescriptor(bsdName, diskDescription);
+            CFRelease(diskDescription);
+            DRIVELIST_LOG_DEBUG("DiskCache: %{public}s size=%llu removable=%d system=%d",
+                                bsdName.c_str(), device.size, device.isRemovable, device.isSystem);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _disks[bsdName] = std::move(device);
+        }
+    }
+
+    void remove(DADiskRef disk)
+    {
+        const char* bsdName = DADiskGetBSDName(disk);
+        if (!bsdName) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _disks.erase(bsdName);
+    }
+
+    static void diskAppeared(DADiskRef disk, void* context)
+    {
+        static_cast<DiskCache*>(context)->update(disk);
+    }
+
+    static void diskDescriptionChanged(DADiskRef disk, CFArrayRef, void* context)
+    {
+        static_cast<DiskCache*>(context)->update(disk);
+    }
+
+    static void diskDisappeared(DADiskRef disk, void* context)
+    {
+        static_cast<DiskCache*>(context)->remove(disk);
+    }
+
+    DASessionRef _session = nullptr;
+    dispatch_queue_t _queue = nullptr;
+    std::chrono::steady_clock::time_point _started;
+    std::mutex _mutex;
+    std::map<std::string, DeviceDescriptor> _disks;  // By BSD name
+};
 
 /**
  * @brief Add mount point information to device list
@@ -388,8 +475,8 @@ std::vector<DeviceDescriptor> ListStorageDevices()
                            (long)osVersion.minorVersion,
                            (long)osVersion.patchVersion);
 
-        DASessionRef session = DASessionCreate(kCFAllocatorDefault);
-        if (!session) {
+        DiskCache& cache = DiskCache::instance();
+        if (!cache.copyDisks(deviceList)) {
             DRIVELIST_LOG_ERROR("ListStorageDevices: failed to create DiskArbitration session");
             // Return sentinel error device so UI can display failure
             DeviceDescriptor errorDevice;
@@ -400,63 +487,10 @@ std::vector<DeviceDescriptor> ListStorageDevices()
             return deviceList;
         }
 
-        // Enumerate all disks
-        NSMutableArray* diskNames = [[NSMutableArray alloc] init];
-        if (!enumerateDisks(diskNames)) {
-            DRIVELIST_LOG_ERROR("ListStorageDevices: disk enumeration failed");
-            CFRelease(session);
-            DeviceDescriptor errorDevice;
-            errorDevice.device = "__error__";
-            errorDevice.error = "Failed to enumerate drives: DiskArbitration enumeration failed";
-            errorDevice.description = "Drive enumeration failed";
-            deviceList.push_back(std::move(errorDevice));
-            return deviceList;
-        }
-        
-        DRIVELIST_LOG_INFO("ListStorageDevices: found %lu disk entries", (unsigned long)[diskNames count]);
-        
-        // Reserve capacity to avoid reallocations during enumeration
-        deviceList.reserve(static_cast<size_t>([diskNames count]));
-
-        // Process each whole disk (skip partitions)
-        for (NSString* diskName in diskNames) {
-            @autoreleasepool {
-                if (isPartition(diskName)) {
-                    continue;
-                }
-
-                std::string bsdName = [diskName UTF8String];
-                DADiskRef disk = DADiskCreateFromBSDName(
-                    kCFAllocatorDefault, session, bsdName.c_str());
-
-                if (!disk) {
-                    DRIVELIST_LOG_DEBUG("ListStorageDevices: skipping %{public}s (no DADiskRef)", bsdName.c_str());
-                    continue;
-                }
-
-                CFDictionaryRef diskDescription = DADiskCopyDescription(disk);
-                if (!diskDescription) {
-                    DRIVELIST_LOG_DEBUG("ListStorageDevices: skipping %{public}s (no description)", bsdName.c_str());
-                    CFRelease(disk);
-                    continue;
-                }
-
-                DeviceDescriptor device = createDeviceDescriptor(bsdName, diskDescription);
-                DRIVELIST_LOG_DEBUG("ListStorageDevices: %{public}s size=%llu removable=%d system=%d",
-                                    bsdName.c_str(), device.size, device.isRemovable, device.isSystem);
-                deviceList.push_back(std::move(device));
-
-                CFRelease(diskDescription);
-                CFRelease(disk);
-            }
-        }
+        DRIVELIST_LOG_INFO("ListStorageDevices: %lu disks", (unsigned long)deviceList.size());
 
         // Add mount point information
-        addMountPoints(deviceList, session);
-
-        CFRelease(session);
-        // Note: diskNames will be released by ARC when leaving @autoreleasepool
-        // If building with MRC, uncomment: [diskNames release];
+        addMountPoints(deviceList, cache.session());
     }
 
     DRIVELIST_LOG_INFO("ListStorageDevices: returning %zu devices", deviceList.size());
@@ -2,10 +2,12 @@
  * SPDX-License-Identifier: Apache-2.0
  * Copyright (C) 2020-2025 Raspberry Pi Ltd
  *
- * Linux drive enumeration using lsblk.
+ * Linux drive enumeration using sysfs, with lsblk as a fallback.
  *
  * Design notes:
- * - Uses lsblk with JSON output for reliable parsing
+ * - Reads /sys/block, the udev database and /proc/self/mountinfo directly,
+ *   producing the same objects as lsblk's JSON output
+ * - Falls back to lsblk with JSON output if sysfs is unavailable
  * - Parsing logic is separated from command execution for testability
  * - Handles various edge cases: loop devices, NVMe, SD cards, internal readers
  */
@@ -15,9 +17,14 @@
 
 #include <optional>
 #include <QProcess>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutex>
 #include <QDebug>
 
 namespace Drivelist {
@@ -276,6 +283,357 @@ std::optional<QByteArray> executeLsblk()
     return output;
 }
 
+// ============================================================================
+// Native sysfs enumeration
+// ============================================================================
+//
+// Builds the same objects lsblk would print (kname, subsystems, ro, rm, ...)
+// straight from /sys/block, /run/udev/data and /proc/self/mountinfo, and
+// feeds them to parseBlockDevice(), so both paths classify devices
+// identically. Avoids a fork/exec and JSON round trip per poll, and does not
+// stall behind a busy lsblk under heavy I/O.
+
+struct SysfsRoots {
+    QString sysBlock = QStringLiteral("/sys/block");
+    QString udevData = QStringLiteral("/run/udev/data");
+};
+
+/**
+ * @brief Attributes that do not change while the same medium is present
+ */
+struct StaticAttributes {
+    QString subsystems;
+    bool hotplug = false;
+    QString vendor;
+    QString model;
+    int physicalSectorSize = 0;
+    int logicalSectorSize = 0;
+};
+
+QString readAttribute(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll()).trimmed();
+}
+
+/**
+ * @brief Decode the \xNN escapes used by udev's *_ENC properties and
+ *        the octal escapes used in mountinfo
+ */
+QString decodeEscapes(const QByteArray& encoded)
+{
+    QByteArray out;
+    out.reserve(encoded.size());
+    for (qsizetype i = 0; i < encoded.size(); ++i) {
+        if (encoded[i] == '\\' && i + 3 < encoded.size() && encoded[i + 1] == 'x') {
+            bool ok = false;
+            const char c = static_cast<char>(encoded.mid(i + 2, 2).toInt(&ok, 16));
+            if (ok) {
+                out.append(c);
+                i += 3;
+                continue;
+            }
+        }
+        if (encoded[i] == '\\' && i + 3 < encoded.size() &&
+            encoded[i + 1] >= '0' && encoded[i + 1] <= '3') {
+            bool ok = false;
+            const char c = static_cast<char>(encoded.mid(i + 1, 3).toInt(&ok, 8));
+            if (ok) {
+                out.append(c);
+                i += 3;
+                continue;
+            }
+        }
+        out.append(encoded[i]);
+    }
+    return QString::fromUtf8(out);
+}
+
+/**
+ * @brief Map "major:minor" to the first mountpoint of that device
+ */
+QHash<QString, QString> parseMountinfo(const QByteArray& mountinfo)
+{
+    QHash<QString, QString> mounts;
+    for (const QByteArray& line : mountinfo.split('\n')) {
+        // id parent major:minor root mountpoint options ...
+        const QList<QByteArray> fields = line.split(' ');
+        if (fields.size() < 5) {
+            continue;
+        }
+        const QString devNum = QString::fromLatin1(fields[2]);
+        if (!mounts.contains(devNum)) {
+            mounts.insert(devNum, decodeEscapes(fields[4]));
+        }
+    }
+    return mounts;
+}
+
+/**
+ * @brief Read the udev database entry ("E:KEY=VALUE" lines) of a block device
+ */
+QHash<QString, QByteArray> readUdevProperties(const SysfsRoots& roots, const QString& devNum)
+{
+    QHash<QString, QByteArray> properties;
+    QFile file(roots.udevData + "/b" + devNum);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return properties;
+    }
+    for (const QByteArray& line : file.readAll().split('\n')) {
+        if (!line.startsWith("E:")) {
+            continue;
+        }
+        const qsizetype eq = line.indexOf('=');
+        if (eq > 2) {
+            properties.insert(QString::fromLatin1(line.mid(2, eq - 2)), line.mid(eq + 1));
+        }
+    }
+    return properties;
+}
+
+QString udevString(const QHash<QString, QByteArray>& properties, const QString& key)
+{
+    if (properties.contains(key + "_ENC")) {
+        return decodeEscapes(properties.value(key + "_ENC")).trimmed();
+    }
+    return QString::fromUtf8(properties.value(key)).trimmed();
+}
+
+/**
+ * @brief Walk the device's sysfs ancestors, as lsblk does for
+ *        SUBSYSTEMS and HOTPLUG
+ */
+StaticAttributes readStaticAttributes(const SysfsRoots& roots, const QString& blockDir,
+                                      const QHash<QString, QByteArray>& udev)
+{
+    StaticAttributes attrs;
+
+    // /sys/block/<name> is a symlink into /sys/devices/...; stop at /sys
+    const QString sysRoot = QFileInfo(roots.sysBlock).canonicalPath();
+    QString path = QFileInfo(blockDir).canonicalFilePath();
+    QStringList subsystems;
+    bool hotplugKnown = false;
+
+    for (bool isDevice = true; path.length() > sysRoot.length() && path.startsWith(sysRoot);
+         path = QFileInfo(path).path(), isDevice = false) {
+        const QFileInfo subsystemLink(path + "/subsystem");
+        if (subsystemLink.isSymLink()) {
+            const QString subsystem = QFileInfo(subsystemLink.symLinkTarget()).fileName();
+            if (subsystems.isEmpty() || subsystems.last() != subsystem) {
+                subsystems.append(subsystem);
+            }
+        }
+
+        // Parent devices (e.g. USB ports) say "removable" or "fixed"
+        if (!isDevice && !hotplugKnown) {
+            const QString removable = readAttribute(path + "/removable");
+            if (removable == "removable" || removable == "fixed") {
+                attrs.hotplug = (removable == "removable");
+                hotplugKnown = true;
+            }
+        }
+    }
+    attrs.subsystems = subsystems.join(':');
+
+    attrs.vendor = udevString(udev, "ID_VENDOR");
+    if (attrs.vendor.isEmpty()) {
+        attrs.vendor = readAttribute(blockDir + "/device/vendor");
+    }
+    attrs.model = udevString(udev, "ID_MODEL");
+    if (attrs.model.isEmpty()) {
+        attrs.model = readAttribute(blockDir + "/device/model");
+    }
+
+    attrs.physicalSectorSize = readAttribute(blockDir + "/queue/physical_block_size").toInt();
+    attrs.logicalSectorSize = readAttribute(blockDir + "/queue/logical_block_size").toInt();
+    return attrs;
+}
+
+/**
+ * @brief Describe a partition or stacked device (dm, md) below a disk
+ */
+QJsonObject readChildDevice(const SysfsRoots& roots, const QString& dir, const QString& name,
+                            const QHash<QString, QString>& mounts, int depth);
+
+/**
+ * @brief Collect holders (dm-crypt, LVM, md) of dir as children
+ */
+QJsonArray readHolders(const SysfsRoots& roots, const QString& dir,
+                       const QHash<QString, QString>& mounts, int depth)
+{
+    QJsonArray holders;
+    if (depth >= MAX_CHILD_RECURSION_DEPTH) {
+        return holders;
+    }
+    const QStringList names = QDir(dir + "/holders").entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::System);
+    for (const QString& holder : names) {
+        holders.append(readChildDevice(roots, roots.sysBlock + "/" + holder, holder, mounts, depth + 1));
+    }
+    return holders;
+}
+
+QJsonObject readChildDevice(const SysfsRoots& roots, const QString& dir, const QString& name,
+                            const QHash<QString, QString>& mounts, int depth)
+{
+    const QString devNum = readAttribute(dir + "/dev");
+    const auto udev = readUdevProperties(roots, devNum);
+
+    QJsonObject child;
+    child["kname"] = "/dev/" + name;
+    child["label"] = udevString(udev, "ID_FS_LABEL");
+    child["mountpoint"] = mounts.value(devNum);
+
+    const QJsonArray holders = readHolders(roots, dir, mounts, depth);
+    if (!holders.isEmpty()) {
+        child["children"] = holders;
+    }
+    return child;
+}
+
+/**
+ * @brief Build the lsblk-style description of a whole disk
+ */
+QJsonObject readBlockDevice(const SysfsRoots& roots, const QString& name, const StaticAttributes& attrs,
+                            const QHash<QString, QByteArray>& udev, const QHash<QString, QString>& mounts)
+{
+    const QString dir = roots.sysBlock + "/" + name;
+    const QString devNum = readAttribute(dir + "/dev");
+
+    QJsonObject bdev;
+    bdev["kname"] = "/dev/" + name;
+    bdev["type"] = name.startsWith("loop") ? "loop" : "disk";
+    bdev["subsystems"] = attrs.subsystems;
+    bdev["ro"] = readAttribute(dir + "/ro") == "1";
+    bdev["rm"] = readAttribute(dir + "/removable") == "1";
+    bdev["hotplug"] = attrs.hotplug;
+    // /sys/block/<name>/size is always in 512-byte units
+    bdev["size"] = static_cast<qint64>(readAttribute(dir + "/size").toULongLong() * 512);
+    bdev["phy-sec"] = attrs.physicalSectorSize;
+    bdev["log-sec"] = attrs.logicalSectorSize;
+    bdev["label"] = udevString(udev, "ID_FS_LABEL");
+    bdev["vendor"] = attrs.vendor;
+    bdev["model"] = attrs.model;
+    bdev["mountpoint"] = mounts.value(devNum);
+
+    // Partitions are subdirectories with a "partition" attribute
+    QJsonArray children;
+    const QStringList entries = QDir(dir).entryList(QStringList() << name + "*", QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString& part : entries) {
+        if (QFileInfo::exists(dir + "/" + part + "/partition")) {
+            children.append(readChildDevice(roots, dir + "/" + part, part, mounts, 0));
+        }
+    }
+    for (const auto& holder : readHolders(roots, dir, mounts, 0)) {
+        children.append(holder);
+    }
+    if (!children.isEmpty()) {
+        bdev["children"] = children;
+    }
+    return bdev;
+}
+
+/**
+ * @brief Per-device cache of StaticAttributes, diffed against the previous scan
+ *
+ * ListStorageDevices() is called from several threads, hence the mutex.
+ */
+class SysfsScanCache
+{
+public:
+    std::optional<QJsonArray> scan(const SysfsRoots& roots, const QByteArray& mountinfo)
+    {
+        QDir sysBlock(roots.sysBlock);
+        if (!sysBlock.exists()) {
+            return std::nullopt;
+        }
+
+        const QHash<QString, QString> mounts = parseMountinfo(mountinfo);
+        const QStringList names = sysBlock.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::System, QDir::Name);
+
+        QMutexLocker lock(&_mutex);
+        QHash<QString, Entry> current;
+        QJsonArray blockDevices;
+
+        for (const QString& name : names) {
+            const QString dir = roots.sysBlock + "/" + name;
+
+            // Stacked devices are listed under the disks they are built on,
+            // and lsblk omits empty devices (unused loop devices, empty readers)
+            if (!QDir(dir + "/slaves").isEmpty(QDir::Dirs | QDir::NoDotAndDotDot | QDir::System)) {
+                continue;
+            }
+            if (readAttribute(dir + "/size").toULongLong() == 0) {
+                continue;
+            }
+
+            // diskseq changes when new media is inserted (Linux 5.15+)
+            const QString identity = readAttribute(dir + "/dev") + "/" + readAttribute(dir + "/diskseq");
+            const auto udev = readUdevProperties(roots, readAttribute(dir + "/dev"));
+
+            auto cached = _entries.constFind(name);
+            Entry entry;
+            if (cached != _entries.constEnd() && cached->identity == identity) {
+                entry = *cached;
+            } else {
+                entry.identity = identity;
+                entry.attrs = readStaticAttributes(roots, dir, udev);
+                if (_scanned) {
+                    qDebug() << "Drivelist: block device" << (cached == _entries.constEnd() ? "added:" : "changed:") << name;
+                }
+            }
+            current.insert(name, entry);
+            blockDevices.append(readBlockDevice(roots, name, entry.attrs, udev, mounts));
+        }
+
+        for (auto it = _entries.constBegin(); it != _entries.constEnd(); ++it) {
+            if (!current.contains(it.key())) {
+                qDebug() << "Drivelist: block device removed:" << it.key();
+            }
+        }
+        _entries = std::move(current);
+        _scanned = true;
+        return blockDevices;
+    }
+
+private:
+    struct Entry {
+        QString identity;
+        StaticAttributes attrs;
+    };
+
+    QMutex _mutex;
+    QHash<QString, Entry> _entries;
+    bool _scanned = false;
+};
+
+QByteArray readMountinfo()
+{
+    QFile file(QStringLiteral("/proc/self/mountinfo"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+std::vector<DeviceDescriptor> parseBlockDeviceArray(const QJsonArray& blockDevices, bool embeddedMode)
+{
+    std::vector<DeviceDescriptor> deviceList;
+
+    // Reserve capacity to avoid reallocations during enumeration
+    deviceList.reserve(static_cast<size_t>(blockDevices.size()));
+
+    for (const auto& item : blockDevices) {
+        auto device = parseBlockDevice(item.toObject(), embeddedMode);
+        if (device) {
+            deviceList.push_back(std::move(*device));
+        }
+    }
+    return deviceList;
+}
+
 } // anonymous namespace
 
 // ============================================================================
@@ -284,6 +642,14 @@ std::optional<QByteArray> executeLsblk()
 
 std::vector<DeviceDescriptor> ListStorageDevices()
 {
+    static SysfsScanCache sysfsCache;
+    const bool embeddedMode = ::isEmbeddedMode();
+
+    auto sysfsDevices = sysfsCache.scan(SysfsRoots(), readMountinfo());
+    if (sysfsDevices) {
+        return parseBlockDeviceArray(*sysfsDevices, embeddedMode);
+    }
+
     std::vector<DeviceDescriptor> deviceList;
 
     auto jsonOutput = executeLsblk();
@@ -310,20 +676,7 @@ std::vector<DeviceDescriptor> ListStorageDevices()
         return deviceList;
     }
 
-    const bool embeddedMode = ::isEmbeddedMode();
-    const QJsonArray blockDevices = doc.object().value("blockdevices").toArray();
-    
-    // Reserve capacity to avoid reallocations during enumeration
-    deviceList.reserve(static_cast<size_t>(blockDevices.size()));
-
-    for (const auto& item : blockDevices) {
-        auto device = parseBlockDevice(item.toObject(), embeddedMode);
-        if (device) {
-            deviceList.push_back(std::move(*device));
-        }
-    }
-
-    return deviceList;
+    return parseBlockDeviceArray(doc.object().value("blockdevices").toArray(), embeddedMode);
 }
 
 // ============================================================================
@@ -344,19 +697,22 @@ std::vector<DeviceDescriptor> parseLinuxBlockDevices(const std::string& jsonOutp
         return deviceList;
     }
 
-    const QJsonArray blockDevices = doc.object().value("blockdevices").toArray();
-    
-    // Reserve capacity to avoid reallocations during enumeration
-    deviceList.reserve(static_cast<size_t>(blockDevices.size()));
-    
-    for (const auto& item : blockDevices) {
-        auto device = parseBlockDevice(item.toObject(), embeddedMode);
-        if (device) {
-            deviceList.push_back(std::move(*device));
-        }
-    }
+    return parseBlockDeviceArray(doc.object().value("blockdevices").toArray(), embeddedMode);
+}
 
-    return deviceList;
+std::vector<DeviceDescriptor> parseSysfsBlockDevices(const std::string& sysBlockDir, const std::string& udevDataDir,
+                                                     const std::string& mountinfo, bool embeddedMode)
+{
+    SysfsRoots roots;
+    roots.sysBlock = QString::fromStdString(sysBlockDir);
+    roots.udevData = QString::fromStdString(udevDataDir);
+
+    SysfsScanCache cache;
+    auto blockDevices = cache.scan(roots, QByteArray::fromStdString(mountinfo));
+    if (!blockDevices) {
+        return {};
+    }
+    return parseBlockDeviceArray(*blockDevices, embeddedMode);
 }
 
 } // namespace testing
@@ -6,7 +6,7 @@
  *
  * These tests cover:
  * - DeviceDescriptor methods (isDisplayable, hasSystemMountpoint, uniqueKey)
- * - Linux lsblk JSON parsing (when on Linux)
+ * - Linux lsblk JSON parsing and sysfs enumeration (when on Linux)
  * - Platform-independent filtering logic
  */
 
@@ -16,6 +16,12 @@
 
 #include "drivelist.h"
 
+#ifdef Q_OS_LINUX
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#endif
+
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
 
@@ -26,6 +32,8 @@ using Catch::Matchers::ContainsSubstring;
 namespace Drivelist::testing {
 #ifdef Q_OS_LINUX
 std::vector<DeviceDescriptor> parseLinuxBlockDevices(const std::string& jsonOutput, bool embeddedMode = false);
+std::vector<DeviceDescriptor> parseSysfsBlockDevices(const std::string& sysBlockDir, const std::string& udevDataDir,
+                                                     const std::string& mountinfo, bool embeddedMode = false);
 #endif
 #ifdef Q_OS_WIN
 std::string windowsBusTypeToString(int busType);
@@ -568,6 +576,112 @@ TEST_CASE("Linux lsblk parsing", "[drivelist][linux][unit]")
     }
 }
 
+namespace {
+
+void writeSysfsFile(const std::filesystem::path& path, const std::string& content)
+{
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path) << content << "\n";
+}
+
+} // namespace
+
+TEST_CASE("Linux sysfs enumeration", "[drivelist][linux][unit]")
+{
+    using namespace Drivelist::testing;
+    namespace fs = std::filesystem;
+
+    const fs::path root = fs::temp_directory_path() / ("drivelist_sysfs_test_" + std::to_string(::getpid()));
+    fs::remove_all(root);
+    const fs::path sys = root / "sys";
+    const fs::path udev = root / "udev";
+
+    // Subsystem symlinks only need a target name
+    for (const char* bus : {"bus/pci", "bus/usb", "bus/scsi", "class/block"}) {
+        fs::create_directories(sys / bus);
+    }
+    auto linkSubsystem = [&](const fs::path& dir, const char* subsystem) {
+        fs::create_directories(dir);
+        fs::create_directory_symlink(sys / subsystem, dir / "subsystem");
+    };
+
+    // USB stick: pci -> usb -> scsi -> block, with one mounted partition
+    const fs::path pci = sys / "devices/pci0000:00/0000:00:14.0";
+    const fs::path usbDev = pci / "usb2/2-1";
+    const fs::path scsiDev = usbDev / "2-1:1.0/host6/target6:0:0/6:0:0:0";
+    const fs::path sdb = scsiDev / "block/sdb";
+    linkSubsystem(pci, "bus/pci");
+    linkSubsystem(pci / "usb2", "bus/usb");
+    linkSubsystem(usbDev, "bus/usb");
+    linkSubsystem(usbDev / "2-1:1.0", "bus/usb");
+    linkSubsystem(usbDev / "2-1:1.0/host6", "bus/scsi");
+    linkSubsystem(scsiDev, "bus/scsi");
+    linkSubsystem(sdb, "class/block");
+    writeSysfsFile(usbDev / "removable", "removable");
+    writeSysfsFile(sdb / "dev", "8:16");
+    writeSysfsFile(sdb / "size", "62521344");
+    writeSysfsFile(sdb / "ro", "0");
+    writeSysfsFile(sdb / "removable", "1");
+    writeSysfsFile(sdb / "queue/physical_block_size", "512");
+    writeSysfsFile(sdb / "queue/logical_block_size", "512");
+    writeSysfsFile(sdb / "sdb1/partition", "1");
+    writeSysfsFile(sdb / "sdb1/dev", "8:17");
+    writeSysfsFile(udev / "b8:16", "E:ID_VENDOR=SanDisk\nE:ID_MODEL_ENC=Cruzer\\x20Blade\nE:ID_MODEL=Cruzer_Blade");
+    writeSysfsFile(udev / "b8:17", "E:ID_FS_LABEL=boot");
+
+    // Unused loop device (size 0) and an attached one
+    linkSubsystem(sys / "devices/virtual/block/loop0", "class/block");
+    writeSysfsFile(sys / "devices/virtual/block/loop0/dev", "7:0");
+    writeSysfsFile(sys / "devices/virtual/block/loop0/size", "0");
+    linkSubsystem(sys / "devices/virtual/block/loop1", "class/block");
+    writeSysfsFile(sys / "devices/virtual/block/loop1/dev", "7:1");
+    writeSysfsFile(sys / "devices/virtual/block/loop1/size", "2048");
+    writeSysfsFile(sys / "devices/virtual/block/loop1/ro", "1");
+
+    fs::create_directories(sys / "block");
+    fs::create_directory_symlink(sdb, sys / "block/sdb");
+    fs::create_directory_symlink(sys / "devices/virtual/block/loop0", sys / "block/loop0");
+    fs::create_directory_symlink(sys / "devices/virtual/block/loop1", sys / "block/loop1");
+
+    const std::string mountinfo =
+        "25 1 259:2 / / rw,relatime shared:1 - ext4 /dev/nvme0n1p2 rw\n"
+        "36 25 8:17 / /media/user/my\\040boot rw,relatime shared:2 - vfat /dev/sdb1 rw\n";
+
+    auto devices = parseSysfsBlockDevices((sys / "block").string(), udev.string(), mountinfo);
+
+    REQUIRE(devices.size() == 2);
+
+    SECTION("Reads USB disk attributes like lsblk")
+    {
+        const auto& dev = devices[1];
+        CHECK(dev.device == "/dev/sdb");
+        CHECK(dev.size == 62521344ULL * 512);
+        CHECK(dev.isUSB == true);
+        CHECK(dev.isRemovable == true);
+        CHECK(dev.isVirtual == false);
+        CHECK(dev.isSystem == false);
+        CHECK_THAT(dev.description, ContainsSubstring("SanDisk Cruzer Blade"));
+        CHECK_THAT(dev.description, ContainsSubstring("(boot)"));
+    }
+
+    SECTION("Takes partition mountpoints from mountinfo")
+    {
+        const auto& dev = devices[1];
+        REQUIRE(dev.mountpoints.size() == 1);
+        CHECK(dev.mountpoints[0] == "/media/user/my boot");
+    }
+
+    SECTION("Skips empty devices and marks loop devices as virtual")
+    {
+        const auto& dev = devices[0];
+        CHECK(dev.device == "/dev/loop1");
+        CHECK(dev.isVirtual == true);
+        CHECK(dev.isReadOnly == true);
+    }
+
+    fs::remove_all(root);
+}
+
 #endif // Q_OS_LINUX
 
 // ============================================================================
@@ -10,6 +10,8 @@
  * - Handles many edge cases: VHDs, Storage Spaces, RAIDs, Google Drive conflicts
  * - Device number + enumerator matching prevents false mountpoint associations
  * - RAII wrappers for all Windows handles to prevent resource leaks
+ * - Static disk properties are cached by device instance ID; a scan only
+ *   queries new disks in full, and reads size, writability and mountpoints
  */
 
 #include "drivelist.h"
@@ -33,6 +35,8 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
+#include <mutex>
 #include <memory>
 #include <algorithm>
 #include <cctype>
@@ -520,79 +524,23 @@ bool getDeviceSize(HANDLE hPhysical, DeviceDescriptor& device)
 }
 
 /**
- * @brief Get enumerator name for a volume (for disambiguation)
- * 
- * This is used to disambiguate volumes that share the same device number
- * but come from different drivers (e.g., Google Drive FS vs physical disk).
+ * @brief Get the device instance ID, which stays the same for as long as
+ * the device is attached
  */
-std::string getVolumeEnumeratorName(const std::string& volumeName)
+std::wstring getDeviceInstanceId(HDEVINFO hDeviceInfo, SP_DEVINFO_DATA& deviceInfoData)
 {
-    // Open the volume to get its device number (using wide string for Unicode support)
-    std::wstring volumePathW = L"\\\\.\\" + std::wstring(volumeName.begin(), volumeName.end()) + L":";
-    UniqueHandle hVolume = makeUniqueHandle(CreateFileW(volumePathW.c_str(), 0,
-                                  FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
-                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
-    if (!hVolume) {
-        DRIVELIST_TRACE_ERROR("CreateFileW (volume)");
+    DWORD requiredSize = 0;
+    SetupDiGetDeviceInstanceIdW(hDeviceInfo, &deviceInfoData, nullptr, 0, &requiredSize);
+    if (requiredSize == 0) {
         return {};
     }
 
-    int32_t targetDeviceNumber = getDeviceNumber(hVolume.get());
-    if (targetDeviceNumber == -1) return {};
-
-    // Find the disk device with this number
-    UniqueDevInfo hDeviceInfo = makeUniqueDevInfo(SetupDiGetClassDevsW(
-        &GUID_DEVICE_INTERFACE_DISK, nullptr, nullptr,
-        DIGCF_PRESENT | DIGCF_DEVICEINTERFACE));
-    if (!hDeviceInfo) {
-        DRIVELIST_TRACE_ERROR("SetupDiGetClassDevsW");
+    std::vector<wchar_t> buffer(requiredSize);
+    if (!SetupDiGetDeviceInstanceIdW(hDeviceInfo, &deviceInfoData, buffer.data(), requiredSize, nullptr)) {
+        DRIVELIST_TRACE_ERROR("SetupDiGetDeviceInstanceIdW");
         return {};
     }
-
-    std::string result;
-    SP_DEVINFO_DATA deviceInfoData = {};
-    deviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
-
-    for (DWORD i = 0; SetupDiEnumDeviceInfo(hDeviceInfo.get(), i, &deviceInfoData); i++) {
-        SP_DEVICE_INTERFACE_DATA interfaceData = {};
-        interfaceData.cbSize = sizeof(SP_DEVICE_INTERFACE_DATA);
-
-        for (DWORD j = 0; ; j++) {
-            if (!SetupDiEnumDeviceInterfaces(hDeviceInfo.get(), &deviceInfoData,
-                                              &GUID_DEVICE_INTERFACE_DISK, j, &interfaceData)) {
-                break;
-            }
-
-            // Get interface detail - first call gets required size
-            DWORD requiredSize = 0;
-            SetupDiGetDeviceInterfaceDetailW(hDeviceInfo.get(), &interfaceData, nullptr, 0, &requiredSize, nullptr);
-            
-            // Verify we got ERROR_INSUFFICIENT_BUFFER (expected) not some other error
-            if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || requiredSize == 0) {
-                continue;
-            }
-
-            std::vector<BYTE> detailBuffer(requiredSize);
-            auto* detailData = reinterpret_cast<PSP_DEVICE_INTERFACE_DETAIL_DATA_W>(detailBuffer.data());
-            detailData->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_W);
-
-            if (SetupDiGetDeviceInterfaceDetailW(hDeviceInfo.get(), &interfaceData, detailData, requiredSize, nullptr, nullptr)) {
-                UniqueHandle hDevice = makeUniqueHandle(CreateFileW(detailData->DevicePath, 0,
-                                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
-                                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
-                if (hDevice) {
-                    int32_t deviceNum = getDeviceNumber(hDevice.get());
-                    if (deviceNum == targetDeviceNumber) {
-                        result = getEnumeratorName(hDeviceInfo.get(), deviceInfoData);
-                        break;
-                    }
-                }
-            }
-        }
-        if (!result.empty()) break;
-    }
-
-    return result;
+    return std::wstring(buffer.data());
 }
 
 /**
@@ -611,19 +559,24 @@ std::vector<std::string> getAvailableVolumes()
     return volumes;
 }
 
+// A fixed or removable drive letter and the disk it is on
+struct VolumeInfo {
+    std::string drivePath;  // e.g. "E:\\"
+    int32_t deviceNumber = -1;
+};
+
 /**
- * @brief Get mountpoints for a device, with enumerator disambiguation
- * 
- * Uses enumerator comparison to handle cases where different drivers
- * assign the same device number (e.g., Google Drive FS virtual drive).
+ * @brief Get the device number behind every fixed and removable drive letter
+ *
+ * Done once per scan: each letter costs a CreateFile and an IOCTL, and was
+ * previously repeated for every disk.
  */
-void getMountpoints(int32_t deviceNumber, const std::string& deviceEnumerator,
-                    std::vector<std::string>& mountpoints)
+std::vector<VolumeInfo> getVolumes()
 {
+    std::vector<VolumeInfo> volumes;
     for (const auto& volumeName : getAvailableVolumes()) {
         std::wstring volumePathW = L"\\\\.\\" + std::wstring(volumeName.begin(), volumeName.end()) + L":";
         std::wstring drivePathW = std::wstring(volumeName.begin(), volumeName.end()) + L":\\";
-        std::string drivePath = volumeName + ":\\";
 
         // Only check fixed and removable drives
         UINT driveType = GetDriveTypeW(drivePathW.c_str());
@@ -636,58 +589,99 @@ void getMountpoints(int32_t deviceNumber, const std::string& deviceEnumerator,
                                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
         if (!hVolume) continue;
 
-        int32_t volumeDeviceNumber = getDeviceNumber(hVolume.get());
+        int32_t deviceNumber = getDeviceNumber(hVolume.get());
+        if (deviceNumber == -1) continue;
 
-        if (volumeDeviceNumber == deviceNumber) {
-            // Extra disambiguation: check enumerator to avoid Google Drive conflicts
-            // Use case-insensitive comparison for driver names
-            std::string volumeEnumerator = getVolumeEnumeratorName(volumeName);
-            if (!deviceEnumerator.empty() && !volumeEnumerator.empty() &&
-                !equalsIgnoreCase(volumeEnumerator, deviceEnumerator)) {
-                DRIVELIST_TRACE("Skipping volume due to enumerator mismatch");
-                continue;  // Different drivers, skip
-            }
-            mountpoints.push_back(drivePath);
-        }
+        volumes.push_back({volumeName + ":\\", deviceNumber});
     }
+    return volumes;
 }
 
 /**
- * @brief Check if any mountpoint contains system folders
+ * @brief Get mountpoints for a device, with enumerator disambiguation
  * 
+ * Uses enumerator comparison to handle cases where different drivers
+ * assign the same device number (e.g., Google Drive FS virtual drive).
+ * A volume's enumerator is that of the first disk enumerated with its
+ * device number (volumeEnumerators).
+ */
+void getMountpoints(int32_t deviceNumber, const std::string& deviceEnumerator,
+                    const std::vector<VolumeInfo>& volumes,
+                    const std::map<int32_t, std::string>& volumeEnumerators,
+                    std::vector<std::string>& mountpoints)
+{
+    for (const auto& volume : volumes) {
+        if (volume.deviceNumber != deviceNumber) {
+            continue;
+        }
+
+        // Extra disambiguation: check enumerator to avoid Google Drive conflicts
+        // Use case-insensitive comparison for driver names
+        auto it = volumeEnumerators.find(deviceNumber);
+        const std::string volumeEnumerator = it != volumeEnumerators.end() ? it->second : std::string();
+        if (!deviceEnumerator.empty() && !volumeEnumerator.empty() &&
+            !equalsIgnoreCase(volumeEnumerator, deviceEnumerator)) {
+            DRIVELIST_TRACE("Skipping volume due to enumerator mismatch");
+            continue;  // Different drivers, skip
+        }
+        mountpoints.push_back(volume.drivePath);
+    }
+}
+
+/**
+ * @brief Get the paths of the Windows, profile and program folders
+ *
  * Requires COM initialization for SHGetKnownFolderPath. Uses RAII wrapper
- * to ensure proper cleanup even on early return.
- * 
- * Note: Case-insensitive path comparison for Windows paths.
+ * to ensure proper cleanup even on early return. The paths do not change
+ * while we run, so they are looked up once; a failed lookup is retried on
+ * the next call.
  */
-bool isSystemDevice(const std::vector<std::string>& mountpoints)
+std::vector<std::string> getKnownFolderPaths()
 {
+    static std::mutex mutex;
+    static std::vector<std::string> paths;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!paths.empty()) {
+        return paths;
+    }
+
     // Ensure COM is initialized for shell functions
     ComInitializer comInit;
     if (!comInit) {
         DRIVELIST_TRACE("Warning: COM initialization failed, assuming non-system device");
-        return false;
+        return {};
     }
-    
+
     for (const GUID& folderId : KNOWN_FOLDER_IDS) {
         PWSTR folderPath = nullptr;
         HRESULT hr = SHGetKnownFolderPath(folderId, 0, nullptr, &folderPath);
         if (SUCCEEDED(hr) && folderPath) {
-            std::string systemPath = wcharToUtf8(folderPath);
+            paths.push_back(wcharToUtf8(folderPath));
             CoTaskMemFree(folderPath);
+        }
+    }
+    return paths;
+}
 
-            for (const auto& mountpoint : mountpoints) {
-                // Case-insensitive prefix match for Windows paths
-                if (systemPath.size() >= mountpoint.size()) {
-                    bool match = std::equal(mountpoint.begin(), mountpoint.end(), systemPath.begin(),
-                                           [](char a, char b) {
-                                               return std::toupper(static_cast<unsigned char>(a)) ==
-                                                      std::toupper(static_cast<unsigned char>(b));
-                                           });
-                    if (match) {
-                        DRIVELIST_TRACE("Detected system device by known folder path");
-                        return true;
-                    }
+/**
+ * @brief Check if any mountpoint contains system folders
+ * 
+ * Note: Case-insensitive path comparison for Windows paths.
+ */
+bool isSystemDevice(const std::vector<std::string>& mountpoints)
+{
+    for (const std::string& systemPath : getKnownFolderPaths()) {
+        for (const auto& mountpoint : mountpoints) {
+            // Case-insensitive prefix match for Windows paths
+            if (systemPath.size() >= mountpoint.size()) {
+                bool match = std::equal(mountpoint.begin(), mountpoint.end(), systemPath.begin(),
+                                       [](char a, char b) {
+                                           return std::toupper(static_cast<unsigned char>(a)) ==
+                                                  std::toupper(static_cast<unsigned char>(b));
+                                       });
+                if (match) {
+                    DRIVELIST_TRACE("Detected system device by known folder path");
+                    return true;
                 }
             }
         }
@@ -696,14 +690,41 @@ bool isSystemDevice(const std::vector<std::string>& mountpoints)
 }
 
 /**
- * @brief Get detailed device information using DeviceIoControl
- * 
+ * @brief What is known about a disk that does not change while it stays
+ * attached: its registry properties, interface path, device number, bus
+ * and block sizes
+ */
+struct StaticDeviceInfo {
+    DeviceDescriptor device;      // Only the static fields are filled in
+    int32_t deviceNumber = -1;
+    // Bus and block sizes, kept apart from device as they are only reported
+    // while the disk has a medium
+    DeviceDescriptor bus;
+    bool hasAdapterInfo = false;
+    bool hasBlockSize = false;
+};
+
+/**
+ * @brief Query the static properties of a disk
+ *
  * Opens the device interface to query device number, then opens the
- * physical drive to get geometry, adapter info, and block sizes.
+ * physical drive to get adapter info and block sizes.
  * Uses RAII for all handles to ensure cleanup on all code paths.
+ * Returns false, with info.device.error set, if the disk could not be
+ * identified.
  */
-bool getDetailData(DeviceDescriptor& device, HDEVINFO hDeviceInfo, SP_DEVINFO_DATA& deviceInfoData)
+bool getStaticData(StaticDeviceInfo& info, HDEVINFO hDeviceInfo, SP_DEVINFO_DATA& deviceInfoData)
 {
+    DeviceDescriptor& device = info.device;
+
+    // Get basic device info from registry
+    // Sanitize description to prevent Unicode display attacks
+    device.enumerator = getEnumeratorName(hDeviceInfo, deviceInfoData);
+    device.description = sanitizeForDisplay(getFriendlyName(hDeviceInfo, deviceInfoData));
+    device.isRemovable = isRemovableDevice(hDeviceInfo, deviceInfoData);
+    device.isVirtual = isVirtualHardDrive(hDeviceInfo, deviceInfoData);
+    device.devicePathNull = true;
+
     SP_DEVICE_INTERFACE_DATA interfaceData = {};
     interfaceData.cbSize = sizeof(SP_DEVICE_INTERFACE_DATA);
 
@@ -749,21 +770,29 @@ bool getDetailData(DeviceDescriptor& device, HDEVINFO hDeviceInfo, SP_DEVINFO_DA
         return false;
     }
 
-    int32_t deviceNumber = getDeviceNumber(hDevice.get());
-    if (deviceNumber == -1) {
+    info.deviceNumber = getDeviceNumber(hDevice.get());
+    if (info.deviceNumber == -1) {
         device.error = "Failed to get device number";
         return false;
     }
 
-    device.device = "\\\\.\\PhysicalDrive" + std::to_string(deviceNumber);
+    device.device = "\\\\.\\PhysicalDrive" + std::to_string(info.deviceNumber);
     device.raw = device.device;
+    return true;
+}
 
-    // Get mountpoints (can release interface handle now)
-    hDevice.reset();
-    getMountpoints(deviceNumber, device.enumerator, device.mountpoints);
-
+/**
+ * @brief Query what can change while a disk stays attached: the medium in
+ * a card reader (size, writability), and the bus and block sizes until they
+ * have been read once
+ *
+ * Returns false, with device.error set, if the size could not be read
+ * (e.g. a card reader with no card).
+ */
+bool getDynamicData(DeviceDescriptor& device, StaticDeviceInfo& info)
+{
     // Open physical drive for geometry/adapter info
-    std::wstring physicalDriveW = L"\\\\.\\PhysicalDrive" + std::to_wstring(deviceNumber);
+    std::wstring physicalDriveW = L"\\\\.\\PhysicalDrive" + std::to_wstring(info.deviceNumber);
     UniqueHandle hPhysical = makeUniqueHandle(CreateFileW(physicalDriveW.c_str(), 0,
                                     FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
                                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
@@ -773,23 +802,39 @@ bool getDetailData(DeviceDescriptor& device, HDEVINFO hDeviceInfo, SP_DEVINFO_DA
         return false;
     }
 
-    bool success = getDeviceSize(hPhysical.get(), device);
-    if (success) {
-        getAdapterInfo(hPhysical.get(), device);
-        getBlockSize(hPhysical.get(), device);
-
-        // Check if writable (IOCTL_DISK_IS_WRITABLE succeeds if writable)
-        DWORD bytesReturned = 0;
-        device.isReadOnly = !DeviceIoControl(hPhysical.get(), IOCTL_DISK_IS_WRITABLE,
-                                              nullptr, 0, nullptr, 0, &bytesReturned, nullptr);
-    } else {
+    if (!getDeviceSize(hPhysical.get(), device)) {
         DRIVELIST_TRACE_ERROR("DeviceIoControl (get geometry)");
         device.error = "Failed to get device geometry";
+        return false;
     }
 
-    return success;
+    if (!info.hasAdapterInfo) {
+        info.hasAdapterInfo = getAdapterInfo(hPhysical.get(), info.bus);
+    }
+    if (!info.hasBlockSize) {
+        info.hasBlockSize = getBlockSize(hPhysical.get(), info.bus);
+    }
+    device.busType = info.bus.busType;
+    device.busVersion = info.bus.busVersion;
+    device.busVersionNull = info.bus.busVersionNull;
+    if (info.hasBlockSize) {
+        device.blockSize = info.bus.blockSize;
+        device.logicalBlockSize = info.bus.logicalBlockSize;
+    }
+
+    // Check if writable (IOCTL_DISK_IS_WRITABLE succeeds if writable)
+    DWORD bytesReturned = 0;
+    device.isReadOnly = !DeviceIoControl(hPhysical.get(), IOCTL_DISK_IS_WRITABLE,
+                                          nullptr, 0, nullptr, 0, &bytesReturned, nullptr);
+    return true;
 }
 
+// Static properties of the disks seen in the last scan, by device instance
+// ID. Disks that are no longer present are dropped, so a disk that comes
+// back is queried afresh.
+std::mutex g_deviceCacheMutex;
+std::map<std::wstring, StaticDeviceInfo> g_deviceCache;
+
 } // anonymous namespace
 
 // ============================================================================
@@ -821,28 +866,45 @@ std::vector<DeviceDescriptor> ListStorageDevices()
         return deviceList;
     }
 
+    // Scans run from the poll thread and from write/format threads; one at
+    // a time keeps the cache consistent
+    std::lock_guard<std::mutex> lock(g_deviceCacheMutex);
+
+    // Pass 1: static properties, from the cache for disks seen before
+    std::vector<StaticDeviceInfo> disks;
+    std::vector<bool> identified;
+    std::vector<std::wstring> instanceIds;
     SP_DEVINFO_DATA deviceInfoData = {};
     deviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
 
-    // Count devices for reserve (optional optimization)
-    DWORD deviceCount = 0;
-    while (SetupDiEnumDeviceInfo(hDeviceInfo.get(), deviceCount, &deviceInfoData)) {
-        ++deviceCount;
+    for (DWORD i = 0; SetupDiEnumDeviceInfo(hDeviceInfo.get(), i, &deviceInfoData); i++) {
+        std::wstring instanceId = getDeviceInstanceId(hDeviceInfo.get(), deviceInfoData);
+        instanceIds.push_back(instanceId);
+        auto cached = instanceId.empty() ? g_deviceCache.end() : g_deviceCache.find(instanceId);
+        if (cached != g_deviceCache.end()) {
+            disks.push_back(cached->second);
+            identified.push_back(true);
+        } else {
+            StaticDeviceInfo info;
+            identified.push_back(getStaticData(info, hDeviceInfo.get(), deviceInfoData));
+            disks.push_back(std::move(info));
+        }
     }
-    deviceList.reserve(static_cast<size_t>(deviceCount));
-    
-    // Reset for actual enumeration
-    deviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
 
-    for (DWORD i = 0; SetupDiEnumDeviceInfo(hDeviceInfo.get(), i, &deviceInfoData); i++) {
-        DeviceDescriptor device;
+    // Each volume goes to the first disk enumerated with its device number
+    std::vector<VolumeInfo> volumes = getVolumes();
+    std::map<int32_t, std::string> volumeEnumerators;
+    for (size_t i = 0; i < disks.size(); i++) {
+        if (identified[i]) {
+            volumeEnumerators.emplace(disks[i].deviceNumber, disks[i].device.enumerator);
+        }
+    }
 
-        // Get basic device info from registry
-        // Sanitize description to prevent Unicode display attacks
-        device.enumerator = getEnumeratorName(hDeviceInfo.get(), deviceInfoData);
-        device.description = sanitizeForDisplay(getFriendlyName(hDeviceInfo.get(), deviceInfoData));
-        device.isRemovable = isRemovableDevice(hDeviceInfo.get(), deviceInfoData);
-        device.isVirtual = isVirtualHardDrive(hDeviceInfo.get(), deviceInfoData);
+    // Pass 2: what can change between scans
+    deviceList.reserve(disks.size());
+    for (size_t i = 0; i < disks.size(); i++) {
+        StaticDeviceInfo& info = disks[i];
+        DeviceDescriptor device = info.device;
 
         // Classify by driver name (case-insensitive comparison for driver names)
         device.isSCSI = containsIgnoreCase(GENERIC_STORAGE_DRIVERS, device.enumerator);
@@ -854,10 +916,12 @@ std::vector<DeviceDescriptor> ListStorageDevices()
                           (equalsIgnoreCase(device.enumerator, "SCSI") || 
                            equalsIgnoreCase(device.enumerator, "IDE"));
 
-        device.devicePathNull = true;
+        if (identified[i]) {
+            getMountpoints(info.deviceNumber, device.enumerator, volumes, volumeEnumerators, device.mountpoints);
+        }
 
         // Get detailed hardware info
-        if (getDetailData(device, hDeviceInfo.get(), deviceInfoData)) {
+        if (identified[i] && getDynamicData(device, info)) {
             // Refine classification based on bus type (these are our constants, case-sensitive OK)
             device.isCard = (device.busType == "SD" || device.busType == "MMC" || device.busType == "UFS");
 
@@ -887,6 +951,16 @@ std::vector<DeviceDescriptor> ListStorageDevices()
         deviceList.push_back(std::move(device));
     }
 
+    // Keep what getDynamicData() learnt about bus and block sizes. Only
+    // disks that could be identified are kept, so the others are retried.
+    std::map<std::wstring, StaticDeviceInfo> cache;
+    for (size_t i = 0; i < disks.size(); i++) {
+        if (identified[i] && !instanceIds[i].empty()) {
+            cache[instanceIds[i]] = std::move(disks[i]);
+        }
+    }
+    g_deviceCache = std::move(cache);
+
     DRIVELIST_TRACE("ListStorageDevices complete");
     return deviceList;
 }
@@ -18,19 +18,21 @@ public:
                            bool isFastbootStorage = false, QString fastbootBlockDevice = QString(), QString fastbootStorageType = QString(),
                            QObject *parent = nullptr);
 
+    // Properties that are part of the drive's key are constant; the rest are
+    // updated in place by DriveListModel when a poll reports a change
     Q_PROPERTY(QString device MEMBER _device CONSTANT)
-    Q_PROPERTY(QString description MEMBER _description CONSTANT)
+    Q_PROPERTY(QString description MEMBER _description)
     Q_PROPERTY(quint64 size MEMBER _size CONSTANT)
-    Q_PROPERTY(QStringList mountpoints MEMBER _mountpoints CONSTANT)
-    Q_PROPERTY(QStringList childDevices MEMBER _childDevices CONSTANT)
-    Q_PROPERTY(bool isUsb MEMBER _isUsb CONSTANT)
-    Q_PROPERTY(bool isScsi MEMBER _isScsi CONSTANT)
-    Q_PROPERTY(bool isReadOnly MEMBER _isReadOnly CONSTANT)
-    Q_PROPERTY(bool isSystem MEMBER _isSystem CONSTANT)
+    Q_PROPERTY(QStringList mountpoints MEMBER _mountpoints)
+    Q_PROPERTY(QStringList childDevices MEMBER _childDevices)
+    Q_PROPERTY(bool isUsb MEMBER _isUsb)
+    Q_PROPERTY(bool isScsi MEMBER _isScsi)
+    Q_PROPERTY(bool isReadOnly MEMBER _isReadOnly)
+    Q_PROPERTY(bool isSystem MEMBER _isSystem)
     Q_PROPERTY(bool isRpiboot MEMBER _isRpiboot CONSTANT)
     Q_PROPERTY(bool isFastbootStorage MEMBER _isFastbootStorage CONSTANT)
     Q_PROPERTY(QString fastbootBlockDevice MEMBER _fastbootBlockDevice CONSTANT)
-    Q_PROPERTY(QString fastbootStorageType MEMBER _fastbootStorageType CONSTANT)
+    Q_PROPERTY(QString fastbootStorageType MEMBER _fastbootStorageType)
     Q_INVOKABLE int sizeInGb();
 
 signals:
@@ -111,6 +111,7 @@ void DriveListModel::processDriveList(std::vector<Drivelist::DeviceDescriptor> l
         QString fastbootStorageType;
     };
     QList<NewDriveInfo> drivesToAdd;
+    QList<NewDriveInfo> drivesToUpdate;
 
     for (const auto &i : l)
     {
@@ -179,41 +180,41 @@ void DriveListModel::processDriveList(std::vector<Drivelist::DeviceDescriptor> l
         QString deviceNamePlusSize = QString::fromStdString(i.uniqueKey());
         drivesInNewList.insert(deviceNamePlusSize);
 
-        if (!_drivelist.contains(deviceNamePlusSize))
+        // Mark virtual disks as system drives to trigger confirmation dialog
+        const bool isSystemOverride = i.isSystem || i.isVirtual;
+
+        // Treat NVMe drives like SCSI for icon purposes
+        QString busType = QString::fromStdString(i.busType);
+        QString devicePath = QString::fromStdString(i.device);
+        bool isNvme = (busType.compare("NVME", Qt::CaseInsensitive) == 0) || devicePath.startsWith("/dev/nvme");
+        bool isScsiForIcon = i.isSCSI || isNvme;
+
+        // Convert child devices (APFS volumes on macOS) to QStringList
+        QStringList childDevices;
+        for (const auto &s : i.childDevices)
         {
-            // Mark virtual disks as system drives to trigger confirmation dialog
-            const bool isSystemOverride = i.isSystem || i.isVirtual;
-
-            // Treat NVMe drives like SCSI for icon purposes
-            QString busType = QString::fromStdString(i.busType);
-            QString devicePath = QString::fromStdString(i.device);
-            bool isNvme = (busType.compare("NVME", Qt::CaseInsensitive) == 0) || devicePath.startsWith("/dev/nvme");
-            bool isScsiForIcon = i.isSCSI || isNvme;
-
-            // Convert child devices (APFS volumes on macOS) to QStringList
-            QStringList childDevices;
-            for (const auto &s : i.childDevices)
-            {
-                childDevices.append(QString::fromStdString(s));
-            }
+            childDevices.append(QString::fromStdString(s));
+        }
 
-            NewDriveInfo info;
-            info.key = deviceNamePlusSize;
-            info.device = QString::fromStdString(i.device);
-            info.description = QString::fromStdString(i.description);
-            info.size = i.size;
-            info.isUSB = i.isUSB;
-            info.isScsi = isScsiForIcon;
-            info.isReadOnly = i.isReadOnly;
-            info.isSystem = isSystemOverride;
-            info.mountpoints = mountpoints;
-            info.childDevices = childDevices;
-            info.isRpiboot = isRpibootDevice;
-            info.isFastbootStorage = isFastbootStorage;
-            info.fastbootBlockDevice = QString::fromStdString(i.fastbootBlockDevice);
-            info.fastbootStorageType = QString::fromStdString(i.fastbootStorageType);
+        NewDriveInfo info;
+        info.key = deviceNamePlusSize;
+        info.device = QString::fromStdString(i.device);
+        info.description = QString::fromStdString(i.description);
+        info.size = i.size;
+        info.isUSB = i.isUSB;
+        info.isScsi = isScsiForIcon;
+        info.isReadOnly = i.isReadOnly;
+        info.isSystem = isSystemOverride;
+        info.mountpoints = mountpoints;
+        info.childDevices = childDevices;
+        info.isRpiboot = isRpibootDevice;
+        info.isFastbootStorage = isFastbootStorage;
+        info.fastbootBlockDevice = QString::fromStdString(i.fastbootBlockDevice);
+        info.fastbootStorageType = QString::fromStdString(i.fastbootStorageType);
+        if (_drivelist.contains(deviceNamePlusSize))
+            drivesToUpdate.append(info);
+        else
             drivesToAdd.append(info);
-        }
     }
 
     // Update the rpiboot tracking set so disappeared devices can re-fire
@@ -228,10 +229,11 @@ void DriveListModel::processDriveList(std::vector<Drivelist::DeviceDescriptor> l
         if (!drivesInNewList.contains(key))
         {
             // Find the row index for this key
-            int row = _drivelist.keys().indexOf(key);
-            if (row >= 0)
+            auto it = _drivelist.constFind(key);
+            if (it != _drivelist.constEnd())
             {
-                QString devicePath = _drivelist.value(key)->property("device").toString();
+                const int row = static_cast<int>(std::distance(_drivelist.constBegin(), it));
+                QString devicePath = it.value()->property("device").toString();
                 qDebug() << "Drive removed:" << devicePath;
 
                 beginRemoveRows(QModelIndex(), row, row);
@@ -245,6 +247,44 @@ void DriveListModel::processDriveList(std::vector<Drivelist::DeviceDescriptor> l
         }
     }
 
+    // Update drives that are still present in place. Device, size and the
+    // rpiboot/fastboot identity are part of the key, so only the remaining
+    // roles can change; a row whose roles are all unchanged emits nothing,
+    // which keeps QML from re-rendering every delegate on each poll.
+    for (const auto &info : drivesToUpdate)
+    {
+        auto it = _drivelist.constFind(info.key);
+        DriveListItem *item = it.value();
+        const QList<QPair<int, QVariant>> values = {
+            {descriptionRole, info.description},
+            {isUsbRole, info.isUSB},
+            {isScsiRole, info.isScsi},
+            {isReadOnlyRole, info.isReadOnly},
+            {isSystemRole, info.isSystem},
+            {mountpointsRole, info.mountpoints},
+            {childDevicesRole, info.childDevices},
+            {fastbootStorageTypeRole, info.fastbootStorageType}
+        };
+
+        QList<int> changedRoles;
+        for (const auto &value : values)
+        {
+            const QByteArray propertyName = _rolenames.value(value.first);
+            if (item->property(propertyName) != value.second)
+            {
+                item->setProperty(propertyName, value.second);
+                changedRoles.append(value.first);
+            }
+        }
+
+        if (!changedRoles.isEmpty())
+        {
+            const QModelIndex idx = index(static_cast<int>(std::distance(_drivelist.constBegin(), it)));
+            emit dataChanged(idx, idx, changedRoles);
+            qDebug() << "Drive changed:" << info.device;
+        }
+    }
+
     // Add new drives
     for (const auto &info : drivesToAdd)
     {
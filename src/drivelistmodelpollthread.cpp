@@ -1,11 +1,14 @@
 #include "drivelistmodelpollthread.h"
+#include <QDeadlineTimer>
 #include <QElapsedTimer>
 #include <QDebug>
 #ifdef Q_OS_WIN
 #include <windows.h>
 #endif
+#include "drivelist/devicemonitor.h"
 #include "rpiboot/rpiboot_scanner.h"
 #include "rpiboot/libusb_transport.h"
+#include "rpiboot/usb_hotplug_monitor.h"
 #include "fastboot/fastboot_protocol.h"
 #include <set>
 #include <sstream>
@@ -15,16 +18,27 @@
  * Copyright (C) 2020 Raspberry Pi Ltd
  */
 
+namespace {
+
+// Time to let a burst of hotplug events (disk, then each partition) settle
+// before rescanning
+constexpr int kDeviceChangeSettleMs = 50;
+
+} // namespace
+
 DriveListModelPollThread::DriveListModelPollThread(QObject *parent)
-    : QThread(parent), _terminate(false), _scanMode(ScanMode::Normal)
+    : QThread(parent), _terminate(false), _scanMode(ScanMode::Normal), _deviceChangePending(false)
 {
     qRegisterMetaType< std::vector<Drivelist::DeviceDescriptor> >( "std::vector<Drivelist::DeviceDescriptor>" );
 }
 
 DriveListModelPollThread::~DriveListModelPollThread()
 {
-    _terminate = true;
-    _modeChanged.wakeAll();  // Wake thread if it's waiting
+    {
+        QMutexLocker lock(&_mutex);
+        _terminate = true;
+        _modeChanged.wakeAll();  // Wake thread if it's waiting
+    }
     if (!wait(2000)) {
         // Thread is stuck (e.g. blocked in libusb_init due to a libusb macOS
         // deadlock).  Force-kill it and wait for it to die — QThread::~QThread()
@@ -37,6 +51,9 @@ DriveListModelPollThread::~DriveListModelPollThread()
 
 void DriveListModelPollThread::stop()
 {
+    // Set under the mutex so the thread cannot miss the wakeup between
+    // checking the flag and starting to wait
+    QMutexLocker lock(&_mutex);
     _terminate = true;
     _modeChanged.wakeAll();  // Wake thread to check terminate flag
 }
@@ -51,17 +68,15 @@ void DriveListModelPollThread::setScanMode(ScanMode mode)
 {
     QMutexLocker lock(&_mutex);
     if (_scanMode != mode) {
-        ScanMode oldMode = _scanMode;
         _scanMode = mode;
         
         const char* modeStr = (mode == ScanMode::Normal) ? "Normal" :
                               (mode == ScanMode::Slow) ? "Slow" : "Paused";
         qDebug() << "Drive scan mode changed to:" << modeStr;
         
-        // Wake thread if transitioning from paused to active
-        if (oldMode == ScanMode::Paused && mode != ScanMode::Paused) {
-            _modeChanged.wakeAll();
-        }
+        // Wake thread so a paused thread resumes, and a sleeping one
+        // stops early or picks up the new interval
+        _modeChanged.wakeAll();
         
         emit scanModeChanged(mode);
     }
@@ -95,6 +110,27 @@ void DriveListModelPollThread::setFastbootScanEnabled(bool enabled)
     qDebug() << "Fastboot scanning" << (enabled ? "enabled" : "disabled");
 }
 
+void DriveListModelPollThread::_onDeviceChange()
+{
+    QMutexLocker lock(&_mutex);
+    _deviceChangePending = true;
+    _modeChanged.wakeAll();
+}
+
+int DriveListModelPollThread::_pollIntervalMs(ScanMode mode, bool monitorActive, bool monitorCoversUsb) const
+{
+    // rpiboot and fastboot devices are only found by polling libusb unless
+    // the monitor reports USB devices as well
+    const bool needUsbPolling = !monitorCoversUsb &&
+        (_rpibootEnabled.load(std::memory_order_relaxed) || _fastbootScanEnabled.load(std::memory_order_relaxed));
+
+    if (!monitorActive || needUsbPolling)
+        return (mode == ScanMode::Slow) ? 5000 : 1000;
+
+    // Fallback only, in case an event was missed
+    return (mode == ScanMode::Slow) ? 30000 : 10000;
+}
+
 void DriveListModelPollThread::run()
 {
 #ifdef Q_OS_WIN
@@ -106,6 +142,16 @@ void DriveListModelPollThread::run()
     }
 #endif
 
+    Drivelist::DeviceMonitor monitor([this] { _onDeviceChange(); });
+    const bool monitorActive = monitor.start();
+    if (!monitorActive)
+        qDebug() << "Device hotplug notifications unavailable, polling for drive changes";
+
+    // rpiboot and fastboot devices: libusb hotplug events, started once USB
+    // scanning is first enabled so libusb is not initialised otherwise
+    rpiboot::UsbHotplugMonitor usbMonitor([this] { _onDeviceChange(); });
+    bool usbMonitorStarted = false;
+
     QElapsedTimer t1;
 
     while (!_terminate)
@@ -126,7 +172,18 @@ void DriveListModelPollThread::run()
             continue;  // Re-check mode after waking
         }
         
-        // Perform the scan
+        // Perform the scan; changes reported from here on trigger another one
+        {
+            QMutexLocker lock(&_mutex);
+            _deviceChangePending = false;
+        }
+        if (!usbMonitorStarted && (_rpibootEnabled.load(std::memory_order_relaxed) ||
+                                   _fastbootScanEnabled.load(std::memory_order_relaxed))) {
+            usbMonitorStarted = true;
+            if (!usbMonitor.start())
+                qDebug() << "USB hotplug notifications unavailable, polling for rpiboot/fastboot devices";
+        }
+
         t1.start();
         auto driveList = Drivelist::ListStorageDevices();
         if (_rpibootEnabled.load(std::memory_order_relaxed)) {
@@ -264,17 +321,24 @@ void DriveListModelPollThread::run()
         if (elapsed > 1000)
             qDebug() << "Enumerating drives took a long time:" << elapsed/1000.0 << "seconds";
         
-        // Sleep based on current mode
-        int sleepSeconds = (currentMode == ScanMode::Slow) ? 5 : 1;
-        
-        // Use interruptible sleep - check mode periodically
-        for (int i = 0; i < sleepSeconds && !_terminate; ++i) {
+        // Sleep until the next scan is due, a device change is reported or
+        // the scan mode changes
+        bool deviceChanged;
+        {
             QMutexLocker lock(&_mutex);
-            if (_scanMode == ScanMode::Paused) {
-                break;  // Mode changed to paused, exit sleep early
+            QDeadlineTimer deadline(_pollIntervalMs(currentMode, monitorActive,
+                                                    monitor.coversUsbDevices() || usbMonitor.active()));
+            while (!_terminate && !_deviceChangePending && _scanMode == currentMode) {
+                if (!_modeChanged.wait(&_mutex, deadline))
+                    break;  // Timed out - regular scan
             }
-            lock.unlock();
-            QThread::sleep(1);
+            deviceChanged = _deviceChangePending;
         }
+
+        if (deviceChanged && !_terminate)
+            QThread::msleep(kDeviceChangeSettleMs);
     }
+
+    usbMonitor.stop();
+    monitor.stop();
 }
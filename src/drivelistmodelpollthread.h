@@ -21,6 +21,12 @@
  * - Paused mode: No scanning (during write operations to avoid contention)
  * - Slow mode: Scans every 5 seconds (during final stages, minimal UI updates)
  * 
+ * Where the platform provides hotplug notifications (Drivelist::DeviceMonitor),
+ * a device change triggers an immediate rescan and the periodic scan becomes
+ * a slow fallback (every 10s, or 30s in Slow mode). rpiboot and fastboot
+ * devices are reported by libusb hotplug events (rpiboot::UsbHotplugMonitor);
+ * full-rate polling is kept when neither monitor can report them.
+ * 
  * Pausing scanning during write operations prevents:
  * - I/O contention on the target device
  * - Device lock conflicts on Windows
@@ -93,6 +99,7 @@ protected:
     std::atomic<bool> _rpibootEnabled{false};
     std::atomic<bool> _fastbootScanEnabled{false};
     ScanMode _scanMode;
+    bool _deviceChangePending;
     mutable QMutex _mutex;
     QWaitCondition _modeChanged;
 
@@ -112,6 +119,16 @@ protected:
 
     virtual void run() override;
 
+    /**
+     * @brief Called from the device monitor's thread when devices changed
+     */
+    void _onDeviceChange();
+
+    /**
+     * @brief Time until the next scan when no device change is reported
+     */
+    int _pollIntervalMs(ScanMode mode, bool monitorActive, bool monitorCoversUsb) const;
+
 signals:
     void newDriveList(std::vector<Drivelist::DeviceDescriptor> list);
     
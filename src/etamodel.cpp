@@ -0,0 +1,146 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "etamodel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+uint64_t transferMs(uint64_t bytes, uint32_t rateKBps)
+{
+    return bytes * 1000 / (static_cast<uint64_t>(rateKBps) * 1024);
+}
+
+} // namespace
+
+void EtaModel::setProfile(const DeviceProfile &profile, bool eject)
+{
+    _profile = profile;
+    _eject = eject;
+}
+
+void EtaModel::update(Stage stage, uint64_t done, uint64_t total, int64_t nowMs)
+{
+    StageState &s = _stages[static_cast<int>(stage)];
+    s.done = done;
+    s.total = total;
+
+    // The rate is only sampled once the stage has started
+    if (done == 0 || s.sampleMs < 0 || done < s.sampleDone)
+    {
+        s.sampleMs = nowMs;
+        s.sampleDone = done;
+        return;
+    }
+
+    const int64_t elapsed = nowMs - s.sampleMs;
+    if (elapsed < kMinSampleMs)
+        return;
+
+    const double sample = static_cast<double>(done - s.sampleDone) * 1000.0 / 1024.0 / static_cast<double>(elapsed);
+    if (s.rateKBps <= 0)
+    {
+        s.rateKBps = sample;
+    }
+    else
+    {
+        const double alpha = 1.0 - std::exp(-static_cast<double>(elapsed) / kSmoothingMs);
+        s.rateKBps += alpha * (sample - s.rateKBps);
+    }
+    s.sampleMs = nowMs;
+    s.sampleDone = done;
+}
+
+uint32_t EtaModel::rateKBps(Stage stage) const
+{
+    const double rate = _stages[static_cast<int>(stage)].rateKBps;
+    return rate > 0 ? std::max<uint32_t>(1, static_cast<uint32_t>(rate)) : 0;
+}
+
+uint32_t EtaModel::_blendedRate(Stage stage) const
+{
+    const StageState &s = _stages[static_cast<int>(stage)];
+    switch (stage)
+    {
+    case Stage::Write:
+        return DeviceProfile::blendRateKBps(_profile.writeKBps, rateKBps(stage), s.done);
+    case Stage::Verify:
+    {
+        // Reading back is rarely slower than writing, so the write rate is a
+        // safe stand-in until verification has been measured on this device
+        const uint32_t rate = DeviceProfile::blendRateKBps(_profile.verifyKBps, rateKBps(stage), s.done);
+        return rate ? rate : _blendedRate(Stage::Write);
+    }
+    default:
+        return rateKBps(stage);
+    }
+}
+
+EtaModel::Estimate EtaModel::estimate() const
+{
+    Estimate result;
+
+    // The write phase: the slowest of the concurrent stages
+    uint64_t pipelineMs = 0;
+    bool writing = false;
+    for (Stage stage : {Stage::Download, Stage::Decompress, Stage::Write})
+    {
+        const StageState &s = _stages[static_cast<int>(stage)];
+        if (s.total == 0 || s.done >= s.total)
+            continue;
+        if (stage == Stage::Write)
+            writing = true;
+
+        const uint32_t rate = _blendedRate(stage);
+        if (rate == 0)
+        {
+            // Download and decompression are left out until measured
+            if (stage == Stage::Write)
+                return result;
+            continue;
+        }
+
+        const uint64_t ms = transferMs(s.total - s.done, rate);
+        if (ms >= pipelineMs)
+        {
+            pipelineMs = ms;
+            result.limitedBy = stage;
+        }
+    }
+
+    result.ms = pipelineMs;
+    if (writing)
+        result.ms += _profile.finalSyncMs;
+
+    const StageState &verify = _stages[static_cast<int>(Stage::Verify)];
+    if (verify.total > verify.done)
+    {
+        const uint32_t rate = _blendedRate(Stage::Verify);
+        if (rate == 0)
+            return result;
+        const uint64_t ms = transferMs(verify.total - verify.done, rate);
+        if (!writing || ms > pipelineMs)
+            result.limitedBy = Stage::Verify;
+        result.ms += ms;
+    }
+
+    if (_eject)
+        result.ms += _profile.ejectMs;
+    result.known = true;
+    return result;
+}
+
+const char *EtaModel::stageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::Download: return "download";
+    case Stage::Decompress: return "decompress";
+    case Stage::Write: return "write";
+    case Stage::Verify: return "verify";
+    }
+    return "";
+}
@@ -0,0 +1,80 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef ETAMODEL_H
+#define ETAMODEL_H
+
+#include "deviceprofile.h"
+#include <cstdint>
+
+/**
+ * @brief Time left for a write, modelled as a pipeline
+ *
+ * Download, decompression and writing run at the same time, through ring
+ * buffers, so the write phase ends when the slowest of them has caught up:
+ * the largest of remaining bytes / rate over those stages. The final sync,
+ * verification and ejection follow one after another.
+ *
+ * Each stage's rate is smoothed with an exponentially weighted average over
+ * kSmoothingMs of progress samples, so a periodic sync or a card pausing for
+ * garbage collection lowers it gradually instead of making the estimate jump.
+ * Time lost to periodic syncs is part of the measured write rate. Write and
+ * verify rates start from the device profile and are blended over to the
+ * live rate (DeviceProfile::blendRateKBps()).
+ *
+ * Call update() for each stage every few hundred ms; samples closer together
+ * than kMinSampleMs are folded into the next one.
+ */
+class EtaModel
+{
+public:
+    enum class Stage { Download, Decompress, Write, Verify };
+    static constexpr int StageCount = 4;
+
+    static constexpr int64_t kSmoothingMs = 10000;
+    static constexpr int64_t kMinSampleMs = 400;
+
+    struct Estimate {
+        uint64_t ms = 0;
+        bool known = false;
+        Stage limitedBy = Stage::Write;  // Stage that the most time is left for
+    };
+
+    /**
+     * @param profile Rates and fixed costs from earlier writes to this model
+     * @param eject Whether the device is ejected at the end
+     */
+    void setProfile(const DeviceProfile &profile, bool eject);
+
+    /**
+     * @brief Progress of one stage
+     * @param total Bytes the stage has to process in all; 0 if it does not take part
+     */
+    void update(Stage stage, uint64_t done, uint64_t total, int64_t nowMs);
+
+    // Smoothed live rate of a stage, 0 until measured
+    uint32_t rateKBps(Stage stage) const;
+
+    Estimate estimate() const;
+
+    static const char *stageName(Stage stage);
+
+private:
+    struct StageState {
+        uint64_t done = 0;
+        uint64_t total = 0;
+        uint64_t sampleDone = 0;
+        int64_t sampleMs = -1;
+        double rateKBps = 0;  // 0 = not measured
+    };
+
+    StageState _stages[StageCount];
+    DeviceProfile _profile;
+    bool _eject = false;
+
+    uint32_t _blendedRate(Stage stage) const;
+};
+
+#endif // ETAMODEL_H
@@ -0,0 +1,507 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "fanouttarget.h"
+#include "aligned_buffer.h"
+#include "capacityprobe.h"
+#include "config.h"
+#include "file_operations_emulated.h"
+#include "file_operations_memory.h"
+#include "file_operations_replay.h"
+#include "platformquirks.h"
+#include "systemmemorymanager.h"
+#include "timeout_utils.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QSettings>
+#include <memory>
+
+#ifdef Q_OS_WIN
+#include "windows/diskpart_util.h"
+#endif
+
+using rpi_imager::FileError;
+using rpi_imager::TimeoutResult;
+using rpi_imager::TimeoutConfig;
+using rpi_imager::runWithTimeout;
+using rpi_imager::TimeoutDefaults::kFanOutLagTimeoutMs;
+using rpi_imager::TimeoutDefaults::kHardTimeoutSeconds;
+
+FanOutTarget::FanOutTarget(const QByteArray &device, QObject *parent)
+    : QThread(parent)
+    , _device(device)
+    , _file(rpi_imager::FileOperations::Create())
+    , _queuedBytes(0)
+    , _imageSize(0)
+    , _verify(false)
+    , _useAsync(false)
+    , _failed(false)
+    , _finishing(false)
+    , _cancelled(false)
+    , _bytesWritten(0)
+    , _inFlightBytes(0)
+{
+    // Bound how far a target may lag behind the primary device.
+    // Same tiers as AsyncCacheWriter: conservative on low-memory systems,
+    // since every target holds its own copy of the queued data.
+    qint64 totalMemMB = SystemMemoryManager::instance().getTotalMemoryMB();
+    if (totalMemMB < 2048) {
+        _maxQueueMemory = 32 * 1024 * 1024;
+    } else if (totalMemMB < 8192) {
+        _maxQueueMemory = 64 * 1024 * 1024;
+    } else {
+        _maxQueueMemory = 128 * 1024 * 1024;
+    }
+}
+
+FanOutTarget::~FanOutTarget()
+{
+    cancel();
+    if (_file && _file->IsOpen()) {
+        _file->Close();
+    }
+}
+
+bool FanOutTarget::open(bool directIO, int asyncQueueDepth, bool skipEndOfDevice)
+{
+    qDebug() << "FanOutTarget: preparing" << _device;
+
+    if (_device.startsWith("/dev/")) {
+        QString unmountPath = PlatformQuirks::getEjectDevicePath(_device);
+        if (PlatformQuirks::unmountDisk(unmountPath) != PlatformQuirks::DiskResult::Success) {
+            fail(tr("Failed to unmount disk '%1'.").arg(unmountPath));
+            return false;
+        }
+    }
+
+    const bool memoryTarget = rpi_imager::MemoryFileOperations::IsMemoryTarget(_device.toStdString());
+    if (rpi_imager::ReplayFileOperations::IsReplayTarget(_device.toStdString())) {
+        _file = std::make_unique<rpi_imager::ReplayFileOperations>();
+    } else if (rpi_imager::EmulatedFileOperations::IsEmulatedTarget(_device.toStdString())) {
+        _file = std::make_unique<rpi_imager::EmulatedFileOperations>();
+    } else if (memoryTarget) {
+        _file = std::make_unique<rpi_imager::MemoryFileOperations>();
+    }
+
+#ifdef Q_OS_WIN
+    if (!memoryTarget) {
+        DiskpartUtil::unmountVolumes(_device);
+        auto cleanResult = DiskpartUtil::cleanDiskFast(_device);
+        if (!cleanResult.success) {
+            qDebug() << "FanOutTarget: fast disk clean failed, falling back to diskpart:" << cleanResult.errorMessage;
+            cleanResult = DiskpartUtil::cleanDisk(_device, std::chrono::seconds(60), 3, DiskpartUtil::VolumeHandling::SkipUnmounting);
+        }
+        if (!cleanResult.success) {
+            fail(cleanResult.errorMessage);
+            return false;
+        }
+    }
+#endif
+
+    if (_file->OpenDevice(_device.toStdString()) != FileError::kSuccess) {
+        fail(tr("Cannot open storage device '%1'.").arg(QString(_device)));
+        return false;
+    }
+
+    if (_file->IsDirectIOEnabled() != directIO) {
+        _file->SetDirectIOEnabled(directIO);
+    }
+
+    // Same device-informed cap as the primary device (see #1592)
+    const auto &limits = _file->GetDeviceIOLimits();
+    if (limits.suggested_queue_depth > 0) {
+        asyncQueueDepth = qMin(asyncQueueDepth, qMax(4, limits.suggested_queue_depth * 3));
+    }
+    if (asyncQueueDepth > 1 && _file->IsAsyncIOSupported()) {
+        _useAsync = _file->SetAsyncQueueDepth(asyncQueueDepth);
+    }
+
+    // Same fake-capacity check as the primary device
+    if (!memoryTarget && !skipEndOfDevice && QSettings().value("capacityprobe/enabled", true).toBool()
+        && !_probeCapacity()) {
+        return false;
+    }
+
+#ifndef Q_OS_WIN
+    std::uint64_t knownsize = 0;
+    if (_file->GetSize(knownsize) != FileError::kSuccess) {
+        fail(tr("Error getting size of storage device '%1'.").arg(QString(_device)));
+        return false;
+    }
+
+    constexpr size_t emptyMBSize = 1024 * 1024;
+    rpi_imager::AlignedBuffer emptyMB(emptyMBSize);
+    if (!emptyMB) {
+        fail(tr("Failed to allocate buffer for MBR zeroing."));
+        return false;
+    }
+
+    if (_file->WriteSequential(emptyMB.data(), emptyMBSize) != FileError::kSuccess
+        || _file->Flush() != FileError::kSuccess) {
+        fail(tr("Error preparing storage device '%1'.").arg(QString(_device)));
+        return false;
+    }
+
+    if (!skipEndOfDevice && knownsize > emptyMBSize) {
+        auto file = _file.get();
+        const uint8_t *bufferData = emptyMB.data();
+        uint64_t seekPosition = knownsize - emptyMBSize;
+        int lastMBResultInt = 0;
+        auto timeoutResult = runWithTimeout(
+            [file, seekPosition, bufferData, emptyMBSize]() {
+                if (file->Seek(seekPosition) != FileError::kSuccess)
+                    return static_cast<int>(FileError::kSeekError);
+                if (file->WriteSequential(bufferData, emptyMBSize) != FileError::kSuccess)
+                    return static_cast<int>(FileError::kWriteError);
+                if (file->Flush() != FileError::kSuccess)
+                    return static_cast<int>(FileError::kFlushError);
+                return static_cast<int>(FileError::kSuccess);
+            },
+            lastMBResultInt,
+            TimeoutConfig(kHardTimeoutSeconds).withCancelFlag(&_cancelled)
+        );
+
+        if (timeoutResult != TimeoutResult::Completed
+            || static_cast<FileError>(lastMBResultInt) != FileError::kSuccess) {
+            fail(tr("Write error while trying to zero out last part of card '%1'.").arg(QString(_device)));
+            return false;
+        }
+    }
+    _file->Seek(0);
+#endif
+
+    // Given up on while it was being prepared
+    if (_cancelled) {
+        return false;
+    }
+
+    qDebug() << "FanOutTarget:" << _device << "ready, async:" << _useAsync
+             << "queue depth:" << _file->GetAsyncQueueDepth()
+             << "max lag:" << _maxQueueMemory / (1024 * 1024) << "MB";
+
+    start();
+    return true;
+}
+
+bool FanOutTarget::_probeCapacity()
+{
+    std::uint64_t knownsize = 0;
+    if (_file->GetSize(knownsize) != FileError::kSuccess) {
+        return true;
+    }
+
+    auto file = _file.get();
+    const size_t tagSize = _file->GetDeviceIOLimits().BufferAlignment(4096);
+    const std::uint64_t nonce = QRandomGenerator::global()->generate64();
+    auto probeResult = std::make_shared<CapacityProbe::Result>();
+    int unused = 0;
+    auto timeoutResult = runWithTimeout(
+        [file, knownsize, tagSize, nonce, probeResult]() {
+            *probeResult = CapacityProbe::run(*file, knownsize, tagSize, nonce);
+            return 0;
+        },
+        unused,
+        TimeoutConfig(kHardTimeoutSeconds).withCancelFlag(&_cancelled)
+    );
+    _file->Seek(0);
+
+    if (timeoutResult == TimeoutResult::Cancelled) {
+        return false;
+    }
+    if (timeoutResult == TimeoutResult::TimedOut || probeResult->ioError) {
+        fail(tr("Error checking the capacity of storage device '%1'.").arg(QString(_device)));
+        return false;
+    }
+
+    qDebug() << "FanOutTarget:" << _device << "capacity probe:" << probeResult->failed << "of"
+             << probeResult->probes << "probes failed, detected" << probeResult->capacity / (1024 * 1024) << "MB";
+    if (!probeResult->ok) {
+        fail(tr("Storage device '%1' reports %2 GB but could only store data in the first %3 GB (counterfeit card).")
+                 .arg(QString(_device))
+                 .arg(knownsize / 1000000000.0, 0, 'f', 1)
+                 .arg(probeResult->capacity / 1000000000.0, 0, 'f', 1));
+        return false;
+    }
+    return true;
+}
+
+void FanOutTarget::setFirstBlock(const char *data, size_t len)
+{
+    _firstBlock = QByteArray(data, static_cast<qsizetype>(len));
+}
+
+bool FanOutTarget::write(std::uint64_t offset, const char *data, size_t len)
+{
+    if (_failed || _cancelled) {
+        return false;
+    }
+
+    {
+        QMutexLocker lock(&_mutex);
+
+        // Bounded lag: wait for this target to catch up, but never longer than
+        // kFanOutLagTimeoutMs. Unlike the cache writer we cannot just skip data,
+        // so a target that cannot keep up is dropped from the batch.
+        static constexpr int WAIT_INTERVAL_MS = 50;
+        int waitedMs = 0;
+        while (_queuedBytes + _inFlightBytes.load() + static_cast<qint64>(len) > _maxQueueMemory
+               && !_queue.isEmpty()) {
+            if (_failed || _cancelled) {
+                return false;
+            }
+            if (waitedMs >= kFanOutLagTimeoutMs) {
+                lock.unlock();
+                qDebug() << "FanOutTarget:" << _device << "lagged for" << waitedMs << "ms, dropping target";
+                fail(tr("Storage device '%1' is too slow to keep up with the other devices.").arg(QString(_device)));
+                return false;
+            }
+            _queueNotFull.wait(&_mutex, WAIT_INTERVAL_MS);
+            waitedMs += WAIT_INTERVAL_MS;
+        }
+
+        WriteChunk chunk;
+        chunk.offset = offset;
+        chunk.len = len;
+        chunk.data = static_cast<char *>(qMallocAligned(len, 4096));
+        if (!chunk.data) {
+            lock.unlock();
+            fail(tr("Out of memory while writing to '%1'.").arg(QString(_device)));
+            return false;
+        }
+        ::memcpy(chunk.data, data, len);
+
+        _queue.enqueue(chunk);
+        _queuedBytes += static_cast<qint64>(len);
+    }
+
+    _queueNotEmpty.wakeOne();
+    return true;
+}
+
+void FanOutTarget::finishWrites(std::uint64_t imageSize, bool verify)
+{
+    _imageSize = imageSize;
+    _verify = verify;
+    _finishing = true;
+    _queueNotEmpty.wakeAll();
+}
+
+void FanOutTarget::run()
+{
+    while (!_cancelled && !_failed) {
+        WriteChunk chunk;
+        bool hasData = false;
+
+        {
+            QMutexLocker lock(&_mutex);
+            while (_queue.isEmpty() && !_cancelled && !_finishing) {
+                _queueNotEmpty.wait(&_mutex, 100);
+            }
+            if (!_queue.isEmpty()) {
+                chunk = _queue.dequeue();
+                _queuedBytes -= static_cast<qint64>(chunk.len);
+                hasData = true;
+            } else if (_finishing) {
+                break;
+            }
+        }
+
+        if (hasData && !_writeChunk(chunk)) {
+            break;
+        }
+        _queueNotFull.wakeAll();
+    }
+
+    _clearQueue();
+
+    if (!_cancelled && !_failed) {
+        _syncAndVerify();
+    } else if (_file->IsAsyncIOSupported()) {
+        _file->CancelAsyncIO();
+    }
+
+    qDebug() << "FanOutTarget:" << _device << "writer finished," << _bytesWritten.load() << "bytes"
+             << (_failed ? "(failed)" : "");
+}
+
+bool FanOutTarget::_writeChunk(const WriteChunk &chunk)
+{
+    if (_file->Tell() != chunk.offset && _file->Seek(chunk.offset) != FileError::kSuccess) {
+        qFreeAligned(chunk.data);
+        fail(tr("Error seeking on storage device '%1'.").arg(QString(_device)));
+        return false;
+    }
+
+    if (_useAsync) {
+        _inFlightBytes += static_cast<qint64>(chunk.len);
+        char *buf = chunk.data;
+        size_t len = chunk.len;
+        FileError result = _file->AsyncWriteSequential(
+            reinterpret_cast<const std::uint8_t *>(buf), len,
+            [this, buf, len](FileError result, std::size_t written) {
+                if (result == FileError::kSuccess) {
+                    quint64 total = _bytesWritten.fetch_add(written) + written;
+                    emit progress(_device, total);
+                } else if (result != FileError::kCancelled) {
+                    fail(tr("Error writing to storage device '%1'.").arg(QString(_device)));
+                }
+                qFreeAligned(buf);
+                _inFlightBytes -= static_cast<qint64>(len);
+                _queueNotFull.wakeAll();
+            });
+        if (result != FileError::kSuccess && !_failed) {
+            fail(tr("Error writing to storage device '%1'.").arg(QString(_device)));
+        }
+        return !_failed;
+    }
+
+    FileError result = _file->WriteSequential(reinterpret_cast<const std::uint8_t *>(chunk.data), chunk.len);
+    qFreeAligned(chunk.data);
+    if (result != FileError::kSuccess) {
+        fail(tr("Error writing to storage device '%1'.").arg(QString(_device)));
+        return false;
+    }
+    quint64 total = _bytesWritten.fetch_add(chunk.len) + chunk.len;
+    emit progress(_device, total);
+    return true;
+}
+
+bool FanOutTarget::_syncAndVerify()
+{
+    if (_useAsync && _file->WaitForPendingWrites() != FileError::kSuccess) {
+        fail(tr("Error writing to storage device '%1'.").arg(QString(_device)));
+        return false;
+    }
+
+    if (_file->Flush() != FileError::kSuccess
+#ifndef Q_OS_WIN
+        || _file->ForceSync() != FileError::kSuccess
+#endif
+        ) {
+        fail(tr("Error syncing storage device '%1'.").arg(QString(_device)));
+        return false;
+    }
+
+    if (!_verify) {
+        return true;
+    }
+
+    // Each target verifies on its own thread, so read-back of all
+    // devices in the batch runs in parallel.
+    QElapsedTimer t1;
+    t1.start();
+    // Compared with the primary's tree hash of the written data
+    AcceleratedCryptographicHash verifyhash(OSLIST_HASH_ALGORITHM, AcceleratedCryptographicHash::Mode::Comparison);
+    verifyhash.addData(_firstBlock);
+    std::uint64_t pos = static_cast<std::uint64_t>(_firstBlock.size());
+
+    size_t verifyBufferSize = SystemMemoryManager::instance().getAdaptiveVerifyBufferSize(_imageSize);
+    rpi_imager::AlignedBuffer verifyBuf(verifyBufferSize);
+    if (!verifyBuf) {
+        fail(tr("Failed to allocate verification buffer."));
+        return false;
+    }
+
+    _file->PrepareForSequentialRead(0, _imageSize);
+    _file->Seek(pos);
+    while (pos < _imageSize && !_cancelled) {
+        size_t toRead = static_cast<size_t>(qMin<std::uint64_t>(verifyBufferSize, _imageSize - pos));
+        size_t lenRead = 0;
+        if (_file->ReadSequential(verifyBuf.data(), toRead, lenRead) != FileError::kSuccess || lenRead == 0) {
+            fail(tr("Error reading from storage device '%1'.").arg(QString(_device)));
+            return false;
+        }
+        verifyhash.addData(reinterpret_cast<const char *>(verifyBuf.data()), static_cast<qint64>(lenRead));
+        pos += lenRead;
+    }
+
+    _verifyHash = verifyhash.result();
+    qDebug() << "FanOutTarget:" << _device << "verify done in" << t1.elapsed() / 1000.0 << "seconds";
+    return true;
+}
+
+bool FanOutTarget::close(bool writeFirstBlock)
+{
+    if (_failed) {
+        _file->Close();
+        return false;
+    }
+
+    if (writeFirstBlock && !_firstBlock.isEmpty()) {
+        rpi_imager::AlignedBuffer block(static_cast<std::size_t>(_firstBlock.size()));
+        if (!block) {
+            fail(tr("Out of memory while writing to '%1'.").arg(QString(_device)));
+            _file->Close();
+            return false;
+        }
+        ::memcpy(block.data(), _firstBlock.constData(), static_cast<size_t>(_firstBlock.size()));
+        _file->Seek(0);
+        if (_file->WriteSequential(block.data(), static_cast<size_t>(_firstBlock.size())) != FileError::kSuccess) {
+            fail(tr("Error writing partition table to '%1'.").arg(QString(_device)));
+            _file->Close();
+            return false;
+        }
+    }
+
+    bool ok = _file->Flush() == FileError::kSuccess;
+#ifndef Q_OS_WIN
+    ok = ok && _file->ForceSync() == FileError::kSuccess;
+#endif
+    _file->Close();
+
+    if (!ok) {
+        fail(tr("Error syncing storage device '%1'.").arg(QString(_device)));
+        return false;
+    }
+    _bytesWritten += static_cast<quint64>(_firstBlock.size());
+    return true;
+}
+
+void FanOutTarget::cancel()
+{
+    _cancelled = true;
+    _queueNotEmpty.wakeAll();
+    _queueNotFull.wakeAll();
+    if (isRunning()) {
+        if (_file->IsAsyncIOSupported()) {
+            _file->CancelAsyncIO();
+        }
+        wait();
+    }
+    _clearQueue();
+}
+
+void FanOutTarget::fail(const QString &message)
+{
+    bool expected = false;
+    if (!_failed.compare_exchange_strong(expected, true)) {
+        return;
+    }
+    {
+        QMutexLocker lock(&_mutex);
+        _error = message;
+    }
+    qDebug() << "FanOutTarget:" << _device << "failed:" << message;
+    _queueNotEmpty.wakeAll();
+    _queueNotFull.wakeAll();
+    emit failed(_device, message);
+}
+
+QString FanOutTarget::errorString() const
+{
+    QMutexLocker lock(&_mutex);
+    return _error;
+}
+
+void FanOutTarget::_clearQueue()
+{
+    QMutexLocker lock(&_mutex);
+    while (!_queue.isEmpty()) {
+        qFreeAligned(_queue.dequeue().data);
+    }
+    _queuedBytes = 0;
+}
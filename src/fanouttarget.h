@@ -0,0 +1,156 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef FANOUTTARGET_H
+#define FANOUTTARGET_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+#include <memory>
+#include "acceleratedcryptographichash.h"
+#include "file_operations.h"
+
+/**
+ * @brief Secondary destination device for multi-target ("fan-out") writing
+ *
+ * DownloadThread writes the decompressed image to its primary device as
+ * usual and additionally hands every write to each FanOutTarget. A target
+ * owns its own FileOperations instance (and therefore its own async I/O
+ * queue) and a dedicated writer thread, so a slow card only delays its own
+ * queue rather than the primary device or the other targets.
+ *
+ * Lag is bounded: each target queues at most a fixed amount of memory.
+ * If a target cannot accept more data within kFanOutLagTimeoutMs, it is
+ * marked as failed and dropped from the batch instead of stalling the
+ * whole pipeline. Write, sync and verify errors are isolated the same way.
+ *
+ * Lifecycle (all calls from the DownloadThread, except open() and run()):
+ *   open()          - unmount, open and prepare the device, start thread;
+ *                     runs on a preparation thread of its own, so several
+ *                     targets are prepared at once
+ *   setFirstBlock() - first block is held back and written last (as for
+ *                     the primary device)
+ *   write()         - queue a copy of the data for the given offset
+ *   finishWrites()  - no more data; thread drains, syncs and verifies
+ *   wait()          - QThread::wait(), then inspect hasFailed()/verifyHash()
+ *   file()          - used for customisation and the final first block
+ *   close()         - final flush/sync and close
+ */
+class FanOutTarget : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit FanOutTarget(const QByteArray &device, QObject *parent = nullptr);
+    ~FanOutTarget() override;
+
+    /**
+     * @brief Unmount, open, check the capacity and zero the start/end of the device
+     * @param directIO Whether direct I/O should be used
+     * @param asyncQueueDepth Async queue depth (<= 1 = synchronous writes)
+     * @param skipEndOfDevice Skip the capacity probe and zeroing the last MB (counterfeit card workaround)
+     * @return true if the device is ready for writing
+     */
+    bool open(bool directIO, int asyncQueueDepth, bool skipEndOfDevice);
+
+    void setFirstBlock(const char *data, size_t len);
+
+    /**
+     * @brief Queue a copy of the data to be written at the given offset
+     *
+     * Blocks for at most kFanOutLagTimeoutMs if this target is too far
+     * behind. On timeout the target is failed and false is returned;
+     * the caller should carry on with the remaining targets.
+     */
+    bool write(std::uint64_t offset, const char *data, size_t len);
+
+    /**
+     * @brief Signal end of data
+     * @param imageSize Total image size (used as the verify length)
+     * @param verify Read back and hash the written data after syncing
+     */
+    void finishWrites(std::uint64_t imageSize, bool verify);
+
+    /**
+     * @brief Write the held-back first block, flush, sync and close
+     *
+     * When customisation was applied through file(), the first block has
+     * already been written via DeviceWrapper; pass writeFirstBlock=false.
+     */
+    bool close(bool writeFirstBlock);
+
+    /**
+     * @brief Abort writing and discard queued data
+     */
+    void cancel();
+
+    /**
+     * @brief Mark the target as failed (e.g. hash or customisation failure)
+     */
+    void fail(const QString &message);
+
+    QByteArray device() const { return _device; }
+    rpi_imager::FileOperations *file() const { return _file.get(); }
+    bool hasFailed() const { return _failed; }
+    QString errorString() const;
+    quint64 bytesWritten() const { return _bytesWritten; }
+
+    /**
+     * @brief Tree hash of the data read back from the device (first block included)
+     *
+     * Only valid after finishWrites(..., true) and wait().
+     */
+    QByteArray verifyHash() const { return _verifyHash; }
+
+signals:
+    void progress(QByteArray device, quint64 bytesWritten);
+    void failed(QByteArray device, QString message);
+
+protected:
+    void run() override;
+
+private:
+    struct WriteChunk {
+        std::uint64_t offset;
+        char *data;
+        size_t len;
+    };
+
+    QByteArray _device;
+    std::unique_ptr<rpi_imager::FileOperations> _file;
+    QByteArray _firstBlock;
+
+    QQueue<WriteChunk> _queue;
+    mutable QMutex _mutex;
+    QWaitCondition _queueNotEmpty;
+    QWaitCondition _queueNotFull;
+    qint64 _queuedBytes;
+    qint64 _maxQueueMemory;
+
+    QString _error;
+    QByteArray _verifyHash;
+    std::uint64_t _imageSize;
+    bool _verify;
+    bool _useAsync;
+
+    std::atomic<bool> _failed;
+    std::atomic<bool> _finishing;
+    std::atomic<bool> _cancelled;
+    std::atomic<quint64> _bytesWritten;
+    // Queued chunk memory still owned by in-flight async writes
+    std::atomic<qint64> _inFlightBytes;
+
+    bool _writeChunk(const WriteChunk &chunk);
+    bool _syncAndVerify();
+    void _clearQueue();
+    bool _probeCapacity();
+};
+
+#endif // FANOUTTARGET_H
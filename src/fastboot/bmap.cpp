@@ -5,6 +5,7 @@
 
 #include "bmap.h"
 
+#include <QCryptographicHash>
 #include <QXmlStreamReader>
 #include <algorithm>
 #include <cstring>
@@ -108,6 +109,89 @@ bool BlockMap::parse(std::string_view xml, std::string* errorMsg)
     return true;
 }
 
+void BlockMap::assign(uint64_t blockSize, uint64_t blockCount, std::vector<BlockRange> ranges)
+{
+    _blockSize = blockSize;
+    _blockCount = blockCount;
+    _ranges = std::move(ranges);
+    _mappedBlockCount = 0;
+    _hasChecksums = false;
+    _cursor = 0;
+
+    for (const auto& r : _ranges) {
+        _mappedBlockCount += r.end - r.begin;
+        _hasChecksums = _hasChecksums || r.hasSha256;
+    }
+}
+
+void BlockMap::append(uint64_t begin, uint64_t end)
+{
+    if (begin >= end)
+        return;
+
+    if (!_ranges.empty() && _ranges.back().end == begin && !_ranges.back().hasSha256) {
+        _ranges.back().end = end;
+    } else {
+        BlockRange r{};
+        r.begin = begin;
+        r.end = end;
+        _ranges.push_back(r);
+    }
+    _mappedBlockCount += end - begin;
+    _blockCount = std::max(_blockCount, end);
+}
+
+void BlockMap::setChecksum(size_t index, const std::array<uint8_t, 32>& sha256)
+{
+    _ranges[index].sha256 = sha256;
+    _ranges[index].hasSha256 = true;
+    _hasChecksums = true;
+}
+
+std::string BlockMap::toXml(uint64_t imageSize) const
+{
+    // bmaptool checks BmapFileChecksum against the SHA-256 of the file
+    // with the checksum itself written as zeros
+    static constexpr std::string_view kChecksumPlaceholder =
+        "0000000000000000000000000000000000000000000000000000000000000000";
+
+    std::string xml;
+    xml += "<?xml version=\"1.0\" ?>\n";
+    xml += "<bmap version=\"2.0\">\n";
+    xml += "    <ImageSize>" + std::to_string(imageSize) + "</ImageSize>\n";
+    xml += "    <BlockSize>" + std::to_string(_blockSize) + "</BlockSize>\n";
+    xml += "    <BlocksCount>" + std::to_string(_blockCount) + "</BlocksCount>\n";
+    xml += "    <MappedBlocksCount>" + std::to_string(_mappedBlockCount) + "</MappedBlocksCount>\n";
+    xml += "    <ChecksumType>sha256</ChecksumType>\n";
+    xml += "    <BmapFileChecksum>";
+    const size_t checksumPos = xml.size();
+    xml += kChecksumPlaceholder;
+    xml += "</BmapFileChecksum>\n";
+    xml += "    <BlockMap>\n";
+
+    for (const auto& r : _ranges) {
+        xml += "        <Range";
+        if (r.hasSha256) {
+            const QByteArray hex = QByteArray::fromRawData(
+                reinterpret_cast<const char*>(r.sha256.data()), 32).toHex();
+            xml += " chksum=\"" + hex.toStdString() + "\"";
+        }
+        xml += ">" + std::to_string(r.begin);
+        if (r.end - r.begin > 1)
+            xml += "-" + std::to_string(r.end - 1);  // inclusive
+        xml += "</Range>\n";
+    }
+
+    xml += "    </BlockMap>\n";
+    xml += "</bmap>\n";
+
+    const QByteArray fileChecksum = QCryptographicHash::hash(
+        QByteArray::fromRawData(xml.data(), static_cast<qsizetype>(xml.size())),
+        QCryptographicHash::Sha256).toHex();
+    xml.replace(checksumPos, kChecksumPlaceholder.size(), fileChecksum.toStdString());
+    return xml;
+}
+
 std::vector<uint8_t> BlockMap::serialize() const
 {
     size_t payloadSize = sizeof(BmapWireHeader)
@@ -14,8 +14,10 @@
 #ifndef FASTBOOT_BMAP_H
 #define FASTBOOT_BMAP_H
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <limits>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -63,10 +65,41 @@ static_assert(sizeof(BmapWireRange) == 40);
 // DONT_CARE during sparse encoding.
 class BlockMap {
 public:
+    // A run of blocks [begin, end) that are all mapped or all unmapped.
+    // Past the last range (and past blockCount()) the unmapped extent runs
+    // to kNoEnd: a map that is still growing through append() may map part
+    // of it later, so callers of such maps should query again at each
+    // block there rather than rely on that end.
+    struct Extent {
+        uint64_t begin;
+        uint64_t end;
+        bool mapped;
+        size_t range;  // Index of the mapped range, or of the next one if unmapped
+    };
+    static constexpr uint64_t kNoEnd = std::numeric_limits<uint64_t>::max();
+
     // Parse a bmap XML document.  Returns false on parse error.
     // errorMsg is set on failure.
     bool parse(std::string_view xml, std::string* errorMsg = nullptr);
 
+    // Build a map from mapped ranges found by other means (e.g. a scan of
+    // the file system allocation bitmaps).  Ranges must be sorted and
+    // non-overlapping; they carry no checksums until setChecksum().
+    void assign(uint64_t blockSize, uint64_t blockCount, std::vector<BlockRange> ranges);
+
+    // Map blocks [begin, end), which must lie after the last range.  Joins
+    // the last range when adjacent, unless it already has a checksum.  For
+    // maps built while the image streams past.
+    void append(uint64_t begin, uint64_t end);
+
+    // Set the SHA-256 of the raw bytes of range `index`.
+    void setChecksum(size_t index, const std::array<uint8_t, 32>& sha256);
+
+    // Write the map as a bmap-tools 2.0 XML document (sha256 checksums,
+    // with BmapFileChecksum filled in) for an image of imageSize bytes.
+    // Ranges without a checksum are written without a chksum attribute.
+    std::string toXml(uint64_t imageSize) const;
+
     // Serialize to the binary wire format expected by fastbootd's
     // oem bmap-load command.  Returns the packed binary payload.
     std::vector<uint8_t> serialize() const;
@@ -81,6 +114,14 @@ public:
     // NOT thread-safe — use one instance per thread.
     bool isMappedSequential(uint64_t idx);
 
+    // The extent that block `idx` falls in, so that callers can handle a
+    // whole run at once rather than ask about every block.
+    Extent extentAt(uint64_t idx) const;
+
+    // As extentAt(), sharing the cursor of isMappedSequential(): O(1)
+    // amortised for increasing idx.  NOT thread-safe.
+    Extent extentAtSequential(uint64_t idx);
+
     uint64_t blockSize() const { return _blockSize; }
     uint64_t blockCount() const { return _blockCount; }
     uint64_t mappedBlockCount() const { return _mappedBlockCount; }
@@ -113,6 +154,40 @@ inline bool BlockMap::isMappedSequential(uint64_t idx)
     return idx >= _ranges[_cursor].begin;
 }
 
+inline BlockMap::Extent BlockMap::extentAt(uint64_t idx) const
+{
+    // First range starting after idx; the one before it may contain idx
+    auto it = std::upper_bound(_ranges.begin(), _ranges.end(), idx,
+        [](uint64_t val, const BlockRange& r) { return val < r.begin; });
+    const size_t next = static_cast<size_t>(it - _ranges.begin());
+
+    if (next > 0 && idx < _ranges[next - 1].end)
+        return {_ranges[next - 1].begin, _ranges[next - 1].end, true, next - 1};
+
+    const uint64_t begin = next > 0 ? _ranges[next - 1].end : 0;
+    const uint64_t end = next < _ranges.size() ? _ranges[next].begin : kNoEnd;
+    return {begin, end, false, next};
+}
+
+inline BlockMap::Extent BlockMap::extentAtSequential(uint64_t idx)
+{
+    if (_cursor > 0 && _cursor <= _ranges.size() && idx < _ranges[_cursor - 1].end)
+        return extentAt(idx);  // Moved backwards
+
+    while (_cursor < _ranges.size() && _ranges[_cursor].end <= idx)
+        ++_cursor;
+
+    if (_cursor >= _ranges.size()) {
+        const uint64_t begin = _ranges.empty() ? 0 : _ranges.back().end;
+        return {begin, kNoEnd, false, _ranges.size()};
+    }
+
+    const BlockRange& r = _ranges[_cursor];
+    if (idx >= r.begin)
+        return {r.begin, r.end, true, _cursor};
+    return {_cursor > 0 ? _ranges[_cursor - 1].end : 0, r.begin, false, _cursor};
+}
+
 } // namespace fastboot
 
 #endif // FASTBOOT_BMAP_H
@@ -6,11 +6,16 @@
 #include "fastboot_protocol.h"
 
 #include <algorithm>
+#include <charconv>
 #include <cstdio>
 #include <cstring>
 
 namespace fastboot {
 
+// Size of each bulk transfer in a download or upload payload; the
+// transport keeps several in flight at once.
+static constexpr size_t DATA_CHUNK_SIZE = 64 * 1024;
+
 // ── Response reading ───────────────────────────────────────────────────
 
 Response FastbootProtocol::readResponse(rpiboot::IUsbTransport& transport, int timeoutMs)
@@ -136,27 +141,23 @@ bool FastbootProtocol::sendData(rpiboot::IUsbTransport& transport,
         return false;
     }
 
-    // Stream data to device
+    // Stream data to device, in larger transfers on a SuperSpeed link
     size_t offset = 0;
-    while (offset < data.size()) {
-        if (cancelled.load()) {
-            _lastError = "Cancelled";
-            return false;
-        }
-
-        size_t chunkSize = std::min<size_t>(rpiboot::BULK_CHUNK_SIZE, data.size() - offset);
-        auto chunk = data.subspan(offset, chunkSize);
-
-        int xfer = transport.bulkWrite(EP_OUT, chunk, 5000);
-        if (xfer < 0) {
-            _lastError = "Bulk write failed during " + std::string(commandPrefix)
-                + " at offset " + std::to_string(offset);
-            return false;
-        }
-        offset += static_cast<size_t>(xfer);
-
-        if (progress)
-            progress(offset, data.size(), "Transferring to device...");
+    const size_t chunkSize = rpiboot::bulkChunkSizeFor(transport.speed(), DATA_CHUNK_SIZE);
+    int64_t xfer = transport.bulkWriteStream(EP_OUT, data, chunkSize, 5000, cancelled,
+        [&](size_t done) {
+            offset = done;
+            if (progress)
+                progress(offset, data.size(), "Transferring to device...");
+        });
+    if (cancelled.load()) {
+        _lastError = "Cancelled";
+        return false;
+    }
+    if (xfer < 0 || static_cast<size_t>(xfer) != data.size()) {
+        _lastError = "Bulk write failed during " + std::string(commandPrefix)
+            + " at offset " + std::to_string(offset);
+        return false;
     }
 
     // Read final OKAY
@@ -214,32 +215,34 @@ std::vector<uint8_t> FastbootProtocol::upload(rpiboot::IUsbTransport& transport,
         return {};
     }
 
-    // Read payload from bulk IN
-    std::vector<uint8_t> result;
-    result.reserve(resp.dataSize);
-    size_t remaining = resp.dataSize;
+    // Read payload from bulk IN.  A stream call ends early at a short
+    // transfer, so keep reading until the announced size has arrived.
+    std::vector<uint8_t> result(resp.dataSize);
+    size_t received = 0;
 
-    while (remaining > 0) {
+    while (received < result.size()) {
         if (cancelled.load()) {
             _lastError = "Cancelled";
             return {};
         }
 
-        uint8_t buf[rpiboot::BULK_CHUNK_SIZE];
-        size_t toRead = std::min<size_t>(remaining, sizeof(buf));
-        auto bufSpan = std::span<uint8_t>(buf, toRead);
-
-        int bytesRead = transport.bulkRead(EP_IN, bufSpan, 5000);
+        const size_t base = received;
+        int64_t bytesRead = transport.bulkReadStream(
+            EP_IN, std::span<uint8_t>(result).subspan(base), DATA_CHUNK_SIZE, 5000, cancelled,
+            [&](size_t done) {
+                if (progress)
+                    progress(base + done, resp.dataSize, "Uploading from device...");
+            });
+        if (cancelled.load()) {
+            _lastError = "Cancelled";
+            return {};
+        }
         if (bytesRead <= 0) {
             _lastError = "Bulk read failed during upload at offset "
-                + std::to_string(result.size());
+                + std::to_string(received);
             return {};
         }
-        result.insert(result.end(), buf, buf + bytesRead);
-        remaining -= static_cast<size_t>(bytesRead);
-
-        if (progress)
-            progress(result.size(), resp.dataSize, "Uploading from device...");
+        received += static_cast<size_t>(bytesRead);
     }
 
     // Read final OKAY
@@ -348,6 +351,107 @@ std::optional<std::string> FastbootProtocol::getVar(rpiboot::IUsbTransport& tran
     return std::nullopt;
 }
 
+std::optional<uint32_t> FastbootProtocol::parseSize(std::string_view value)
+{
+    int base = 10;
+    if (value.starts_with("0x") || value.starts_with("0X")) {
+        value.remove_prefix(2);
+        base = 16;
+    }
+    uint32_t size = 0;
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), size, base);
+    if (value.empty() || ec != std::errc() || end != value.data() + value.size())
+        return std::nullopt;
+    return size;
+}
+
+// ── Batches ────────────────────────────────────────────────────────────
+
+FastbootProtocol::BatchOp FastbootProtocol::BatchOp::cmd(std::string command, int timeoutMs,
+                                                         bool allowFail)
+{
+    BatchOp op;
+    op.kind = Command;
+    op.command = std::move(command);
+    op.timeoutMs = timeoutMs;
+    op.allowFail = allowFail;
+    return op;
+}
+
+FastbootProtocol::BatchOp FastbootProtocol::BatchOp::stage(std::span<const uint8_t> data)
+{
+    BatchOp op;
+    op.kind = Stage;
+    op.data = data;
+    return op;
+}
+
+FastbootProtocol::BatchOp FastbootProtocol::BatchOp::upload()
+{
+    BatchOp op;
+    op.kind = Upload;
+    return op;
+}
+
+FastbootProtocol::BatchResult FastbootProtocol::runBatch(rpiboot::IUsbTransport& transport,
+                                                         std::span<const BatchOp> ops,
+                                                         std::atomic<bool>& cancelled)
+{
+    _lastError.clear();
+
+    BatchResult result;
+    result.responses.reserve(ops.size());
+
+    for (const BatchOp& op : ops) {
+        if (cancelled.load()) {
+            _lastError = "Cancelled";
+            break;
+        }
+
+        if (op.kind == BatchOp::Command) {
+            auto resp = sendCommand(transport, op.command, op.timeoutMs);
+            if (resp.type != Response::Okay && !(op.allowFail && resp.type == Response::Fail)) {
+                _lastError = op.command + " failed: " + resp.message;
+                break;
+            }
+            result.responses.push_back(std::move(resp));
+        } else if (op.kind == BatchOp::Stage) {
+            if (!stage(transport, op.data, nullptr, cancelled))
+                break;
+            result.responses.push_back({Response::Okay, "", 0});
+        } else {
+            auto data = upload(transport, nullptr, cancelled);
+            if (!_lastError.empty())
+                break;
+            result.uploads.push_back(std::move(data));
+            result.responses.push_back({Response::Okay, "", 0});
+        }
+        ++result.completed;
+    }
+
+    return result;
+}
+
+std::vector<std::optional<std::string>> FastbootProtocol::getVars(
+    rpiboot::IUsbTransport& transport,
+    std::span<const std::string_view> names)
+{
+    std::vector<BatchOp> ops;
+    ops.reserve(names.size());
+    for (std::string_view name : names)
+        ops.push_back(BatchOp::cmd("getvar:" + std::string(name), 3000, true));
+
+    std::atomic<bool> cancelled{false};
+    auto batch = runBatch(transport, ops, cancelled);
+
+    std::vector<std::optional<std::string>> values(names.size());
+    for (size_t i = 0; i < batch.completed; ++i) {
+        if (batch.responses[i].type == Response::Okay)
+            values[i] = batch.responses[i].message;
+    }
+    return values;
+}
+
 // ── Combined flash ─────────────────────────────────────────────────────
 
 bool FastbootProtocol::flashImage(rpiboot::IUsbTransport& transport,
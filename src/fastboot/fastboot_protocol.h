@@ -86,6 +86,14 @@ public:
     std::optional<std::string> getVar(rpiboot::IUsbTransport& transport,
                                        std::string_view name);
 
+    // Parse a size variable such as max-download-size, which gadgets
+    // report either in hex ("0x10000000") or in decimal.  Returns nullopt
+    // if the value is not a number that fits in 32 bits.
+    static std::optional<uint32_t> parseSize(std::string_view value);
+
+    // max-download-size to assume if the device doesn't report one
+    static constexpr uint32_t DEFAULT_MAX_DOWNLOAD_SIZE = 256 * 1024 * 1024;
+
     // Combined download + flash in one call.
     bool flashImage(rpiboot::IUsbTransport& transport,
                     std::string_view partition,
@@ -119,6 +127,43 @@ public:
                                          std::string_view devicePath,
                                          std::atomic<bool>& cancelled);
 
+    // One step of a batch run by runBatch().
+    struct BatchOp {
+        enum Kind { Command, Stage, Upload };
+        Kind kind = Command;
+        std::string command;            // Command only
+        std::span<const uint8_t> data;  // Stage only; must outlive the batch
+        int timeoutMs = 30000;          // Command only
+        bool allowFail = false;         // A FAIL is recorded instead of ending the batch
+
+        static BatchOp cmd(std::string command, int timeoutMs = 30000,
+                           bool allowFail = false);
+        static BatchOp stage(std::span<const uint8_t> data);
+        static BatchOp upload();
+    };
+
+    struct BatchResult {
+        size_t completed = 0;                       // Ops run before the first failure
+        std::vector<Response> responses;            // Terminal response of each completed op
+        std::vector<std::vector<uint8_t>> uploads;  // Payload of each completed Upload, in order
+        bool ok(size_t opCount) const { return completed == opCount; }
+    };
+
+    // Run a sequence of commands, stages and uploads back to back.
+    // Fastboot has a single command in flight, so the win is on the host:
+    // every command string and payload is built before the first one is
+    // sent, and each op goes out as soon as the previous terminal response
+    // has been read.  Stops at the first failure (lastError() set) unless
+    // that op allows it.
+    BatchResult runBatch(rpiboot::IUsbTransport& transport,
+                         std::span<const BatchOp> ops,
+                         std::atomic<bool>& cancelled);
+
+    // Query several device variables in one batch.
+    // Each entry is the value, or nullopt if the device refused it.
+    std::vector<std::optional<std::string>> getVars(rpiboot::IUsbTransport& transport,
+                                                     std::span<const std::string_view> names);
+
     const std::string& lastError() const { return _lastError; }
 
 private:
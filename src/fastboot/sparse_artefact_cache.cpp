@@ -0,0 +1,247 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "sparse_artefact_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace fastboot {
+
+static constexpr const char* MANIFEST_NAME = "manifest";
+static constexpr const char* MANIFEST_MAGIC = "rpi-imager-sparse-artefact 1";
+static constexpr const char* PARTIAL_MARKER = ".partial-";
+
+// Recordings this old were left behind by a flash that never finished
+static constexpr std::chrono::hours STALE_PARTIAL_AGE{24};
+
+SparseArtefactCache::SparseArtefactCache(std::filesystem::path root)
+    : _root(std::move(root))
+{
+}
+
+std::string SparseArtefactCache::key(std::string_view imageHash, uint32_t maxDownloadSize,
+                                     std::string_view blockMapId)
+{
+    // Only characters that are safe in a directory name on every platform
+    auto sanitised = [](std::string_view in) {
+        std::string out;
+        for (char c : in.substr(0, 64)) {
+            if (std::isalnum(static_cast<unsigned char>(c)))
+                out += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return out;
+    };
+    char size[16];
+    std::snprintf(size, sizeof(size), "%x", maxDownloadSize);
+    return sanitised(imageHash) + "-" + size + "-" + sanitised(blockMapId);
+}
+
+std::optional<std::vector<SparseArtefactCache::Segment>> SparseArtefactCache::find(
+    const std::string& key) const
+{
+    const auto dir = _root / key;
+    std::ifstream manifest(dir / MANIFEST_NAME);
+    std::string line;
+    if (!manifest || !std::getline(manifest, line) || line != MANIFEST_MAGIC)
+        return std::nullopt;
+
+    std::vector<Segment> segments;
+    while (std::getline(manifest, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        Segment segment;
+        if (!(fields >> name >> segment.size >> segment.fedBytes) ||
+            name.find_first_of("/\\") != std::string::npos)
+            return std::nullopt;
+        segment.path = dir / name;
+        std::error_code ec;
+        if (std::filesystem::file_size(segment.path, ec) != segment.size || ec)
+            return std::nullopt;
+        segments.push_back(std::move(segment));
+    }
+    if (segments.empty())
+        return std::nullopt;
+
+    // prune() keeps the artefacts used most recently
+    std::error_code ec;
+    std::filesystem::last_write_time(dir / MANIFEST_NAME,
+                                     std::filesystem::file_time_type::clock::now(), ec);
+    return segments;
+}
+
+std::unique_ptr<SparseArtefactCache::Writer> SparseArtefactCache::record(const std::string& key) const
+{
+    // Recorded under a name of its own, so that concurrent flashes of the
+    // same image do not write into each other's files
+    static std::atomic<unsigned> sequence{0};
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    const auto dir = _root / (key + PARTIAL_MARKER + std::to_string(stamp) + "-"
+                              + std::to_string(sequence++));
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec)
+        return nullptr;
+    return std::unique_ptr<Writer>(new Writer(dir, _root / key));
+}
+
+void SparseArtefactCache::prune(size_t keep) const
+{
+    std::error_code ec;
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> complete;
+    const auto now = std::filesystem::file_time_type::clock::now();
+    for (const auto& entry : std::filesystem::directory_iterator(_root, ec)) {
+        if (!entry.is_directory(ec))
+            continue;
+        const auto& path = entry.path();
+        std::error_code timeEc;
+        if (path.filename().string().find(PARTIAL_MARKER) != std::string::npos) {
+            const auto mtime = std::filesystem::last_write_time(path, timeEc);
+            if (!timeEc && now - mtime > STALE_PARTIAL_AGE)
+                std::filesystem::remove_all(path, timeEc);
+            continue;
+        }
+        const auto used = std::filesystem::last_write_time(path / MANIFEST_NAME, timeEc);
+        if (timeEc) {
+            std::filesystem::remove_all(path, timeEc);  // Not an artefact we wrote
+            continue;
+        }
+        complete.emplace_back(used, path);
+    }
+
+    if (complete.size() <= keep)
+        return;
+    std::sort(complete.begin(), complete.end(),
+              [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (size_t i = keep; i < complete.size(); ++i)
+        std::filesystem::remove_all(complete[i].second, ec);
+}
+
+// ── Writer ──────────────────────────────────────────────────────────────
+
+SparseArtefactCache::Writer::Writer(std::filesystem::path dir, std::filesystem::path finalDir)
+    : _dir(std::move(dir))
+    , _finalDir(std::move(finalDir))
+{
+    _thread = std::thread(&Writer::writeLoop, this);
+}
+
+SparseArtefactCache::Writer::~Writer()
+{
+    if (_thread.joinable())
+        abort();
+}
+
+bool SparseArtefactCache::Writer::add(std::shared_ptr<const void> owner,
+                                      std::span<const uint8_t> data, uint64_t fedBytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_failed.load() || _finishing)
+            return false;
+        if (_queue.size() >= MAX_QUEUED_SEGMENTS) {
+            // The disk is slower than the flash; do not hold it up
+            _failed.store(true);
+            _queue.clear();
+        } else {
+            _queue.push_back({std::move(owner), data, fedBytes});
+        }
+    }
+    _cv.notify_all();
+    return !_failed.load();
+}
+
+void SparseArtefactCache::Writer::writeLoop()
+{
+    while (true) {
+        Pending pending;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this] { return !_queue.empty() || _finishing || _failed.load(); });
+            if (_queue.empty() || _failed.load())
+                return;
+            pending = std::move(_queue.front());
+            _queue.pop_front();
+        }
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "segment-%05zu.simg", _written.size());
+        std::ofstream out(_dir / name, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(pending.data.data()),
+                  static_cast<std::streamsize>(pending.data.size()));
+        out.close();
+        if (!out) {
+            abandon();
+            return;
+        }
+        _written.push_back({_dir / name, pending.data.size(), pending.fedBytes});
+    }
+}
+
+void SparseArtefactCache::Writer::abandon()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _failed.store(true);
+        _queue.clear();
+    }
+    _cv.notify_all();
+}
+
+bool SparseArtefactCache::Writer::commit()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _finishing = true;
+    }
+    _cv.notify_all();
+    if (_thread.joinable())
+        _thread.join();
+
+    std::error_code ec;
+    if (_failed.load() || _written.empty()) {
+        std::filesystem::remove_all(_dir, ec);
+        return false;
+    }
+
+    {
+        std::ofstream manifest(_dir / MANIFEST_NAME, std::ios::trunc);
+        manifest << MANIFEST_MAGIC << "\n";
+        for (const auto& segment : _written) {
+            manifest << segment.path.filename().string() << " " << segment.size
+                     << " " << segment.fedBytes << "\n";
+        }
+        manifest.close();
+        if (!manifest) {
+            std::filesystem::remove_all(_dir, ec);
+            return false;
+        }
+    }
+
+    // Replace any older copy of the same artefact
+    std::filesystem::remove_all(_finalDir, ec);
+    std::filesystem::rename(_dir, _finalDir, ec);
+    if (ec) {
+        std::filesystem::remove_all(_dir, ec);
+        return false;
+    }
+    return true;
+}
+
+void SparseArtefactCache::Writer::abort()
+{
+    abandon();
+    if (_thread.joinable())
+        _thread.join();
+    std::error_code ec;
+    std::filesystem::remove_all(_dir, ec);
+}
+
+} // namespace fastboot
@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * On-disk cache of encoded Android sparse segments.
+ *
+ * The segments SparseEncoder produces for an image depend only on the
+ * image, the segment size limit and the block map, so once an image has
+ * been flashed they can be kept and streamed straight to later devices,
+ * with no download, decompression or encoding.
+ *
+ * Layout, one directory per artefact under the cache root:
+ *   <key>/segment-00000.simg ...   the segments, in flashing order
+ *   <key>/manifest                 written last; an artefact without one
+ *                                  is incomplete and never used
+ */
+
+#ifndef FASTBOOT_SPARSE_ARTEFACT_CACHE_H
+#define FASTBOOT_SPARSE_ARTEFACT_CACHE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace fastboot {
+
+class SparseArtefactCache {
+public:
+    explicit SparseArtefactCache(std::filesystem::path root);
+
+    // Identifies an artefact: the SHA-256 of the decompressed image (hex),
+    // the encoder's max-download-size, and what decided the DONT_CARE
+    // blocks (a hash of the bmap, or the name of the block scan).
+    static std::string key(std::string_view imageHash, uint32_t maxDownloadSize,
+                           std::string_view blockMapId);
+
+    struct Segment {
+        std::filesystem::path path;
+        uint64_t size = 0;
+        uint64_t fedBytes = 0;   // Image bytes covered up to the end of this segment
+    };
+
+    // The segments of a complete artefact, or nullopt if there is none
+    // (or a segment file is missing or has the wrong size).  Marks the
+    // artefact as recently used.
+    std::optional<std::vector<Segment>> find(const std::string& key) const;
+
+    // Records the segments of one flash.  Segments are written on a thread
+    // of its own; a recording that cannot keep up is abandoned rather than
+    // slowing the flash down.  Nothing is visible to find() until commit().
+    class Writer {
+    public:
+        ~Writer();
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        // Queue a copy-free reference to a segment.  `owner` keeps `data`
+        // alive until it has been written.  Returns false once the
+        // recording has been abandoned.
+        bool add(std::shared_ptr<const void> owner, std::span<const uint8_t> data,
+                 uint64_t fedBytes);
+
+        // Write the manifest once every segment is on disk.  Returns false
+        // (and removes the partial artefact) if the recording was abandoned.
+        bool commit();
+
+        // Throw the recording away
+        void abort();
+
+        static constexpr size_t MAX_QUEUED_SEGMENTS = 4;
+
+    private:
+        friend class SparseArtefactCache;
+        Writer(std::filesystem::path dir, std::filesystem::path finalDir);
+        void writeLoop();
+        void abandon();
+
+        struct Pending {
+            std::shared_ptr<const void> owner;
+            std::span<const uint8_t> data;
+            uint64_t fedBytes = 0;
+        };
+
+        std::filesystem::path _dir;        // Recorded into
+        std::filesystem::path _finalDir;   // Renamed to on commit
+        std::vector<Segment> _written;
+        std::deque<Pending> _queue;
+        std::mutex _mutex;
+        std::condition_variable _cv;
+        bool _finishing = false;
+        std::atomic<bool> _failed{false};
+        std::thread _thread;
+    };
+
+    // Start recording an artefact for `key`, or nullptr if the cache
+    // directory cannot be written.
+    std::unique_ptr<Writer> record(const std::string& key) const;
+
+    // Remove least recently used artefacts beyond the newest `keep`, and
+    // recordings left behind by an interrupted flash.
+    void prune(size_t keep) const;
+
+    const std::filesystem::path& root() const { return _root; }
+
+private:
+    std::filesystem::path _root;
+};
+
+} // namespace fastboot
+
+#endif // FASTBOOT_SPARSE_ARTEFACT_CACHE_H
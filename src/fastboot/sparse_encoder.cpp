@@ -7,18 +7,467 @@
 #include "bmap.h"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <condition_variable>
 #include <cstring>
+#include <mutex>
+#include <thread>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SPARSE_CLASSIFY_AVX2
+#define SPARSE_CRC_PCLMUL
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SPARSE_CLASSIFY_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__aarch64__) && defined(__GNUC__)
+#define SPARSE_CRC_ARMV8
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+#define SPARSE_CRC_TARGET
+#elif defined(__clang__)
+#define SPARSE_CRC_TARGET __attribute__((target("crc")))
+#else
+#define SPARSE_CRC_TARGET __attribute__((target("+crc")))
+#endif
+#endif
 
 namespace fastboot {
 
+// ── Classification kernels ─────────────────────────────────────────────
+//
+// All kernels compare the block against its first 32-bit word repeated,
+// checking for a mismatch after every 512 bytes.  Image data that is not
+// a fill pattern almost always differs within the first few bytes.
+
+static constexpr size_t CLASSIFY_STRIDE = 512;
+
+static bool classifyScalar(const uint8_t* data, uint32_t* fillValue)
+{
+    uint32_t val;
+    std::memcpy(&val, data, 4);
+    const uint64_t pattern = (static_cast<uint64_t>(val) << 32) | val;
+
+    for (size_t off = 0; off < SPARSE_BLK_SZ; off += CLASSIFY_STRIDE) {
+        uint64_t diff = 0;
+        for (size_t i = 0; i < CLASSIFY_STRIDE; i += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, data + off + i, sizeof(word));
+            diff |= word ^ pattern;
+        }
+        if (diff)
+            return false;
+    }
+    *fillValue = val;
+    return true;
+}
+
+#ifdef SPARSE_CLASSIFY_AVX2
+__attribute__((target("avx2")))
+static bool classifyAvx2(const uint8_t* data, uint32_t* fillValue)
+{
+    uint32_t val;
+    std::memcpy(&val, data, 4);
+    const __m256i pattern = _mm256_set1_epi32(static_cast<int>(val));
+
+    for (size_t off = 0; off < SPARSE_BLK_SZ; off += CLASSIFY_STRIDE) {
+        const auto* p = reinterpret_cast<const __m256i*>(data + off);
+        __m256i diff = _mm256_setzero_si256();
+        for (size_t i = 0; i < CLASSIFY_STRIDE / sizeof(__m256i); i += 4) {
+            diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256(p + i), pattern));
+            diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256(p + i + 1), pattern));
+            diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256(p + i + 2), pattern));
+            diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256(p + i + 3), pattern));
+        }
+        if (!_mm256_testz_si256(diff, diff))
+            return false;
+    }
+    *fillValue = val;
+    return true;
+}
+#endif
+
+#ifdef SPARSE_CLASSIFY_NEON
+static bool classifyNeon(const uint8_t* data, uint32_t* fillValue)
+{
+    uint32_t val;
+    std::memcpy(&val, data, 4);
+    const uint32x4_t pattern = vdupq_n_u32(val);
+
+    for (size_t off = 0; off < SPARSE_BLK_SZ; off += CLASSIFY_STRIDE) {
+        const uint8_t* p = data + off;
+        uint32x4_t diff = vdupq_n_u32(0);
+        for (size_t i = 0; i < CLASSIFY_STRIDE; i += 64) {
+            diff = vorrq_u32(diff, veorq_u32(vreinterpretq_u32_u8(vld1q_u8(p + i)), pattern));
+            diff = vorrq_u32(diff, veorq_u32(vreinterpretq_u32_u8(vld1q_u8(p + i + 16)), pattern));
+            diff = vorrq_u32(diff, veorq_u32(vreinterpretq_u32_u8(vld1q_u8(p + i + 32)), pattern));
+            diff = vorrq_u32(diff, veorq_u32(vreinterpretq_u32_u8(vld1q_u8(p + i + 48)), pattern));
+        }
+        // Fold to 64 bits; vmaxvq is AArch64-only
+        const uint64x2_t folded = vreinterpretq_u64_u32(diff);
+        if (vgetq_lane_u64(folded, 0) | vgetq_lane_u64(folded, 1))
+            return false;
+    }
+    *fillValue = val;
+    return true;
+}
+#endif
+
+using ClassifyFn = bool (*)(const uint8_t*, uint32_t*);
+
+struct Classifier {
+    ClassifyFn fn;
+    const char* name;
+};
+
+static const Classifier& classifier()
+{
+    static const Classifier selected = [] {
+#ifdef SPARSE_CLASSIFY_AVX2
+        if (__builtin_cpu_supports("avx2"))
+            return Classifier{classifyAvx2, "AVX2"};
+#endif
+#ifdef SPARSE_CLASSIFY_NEON
+        return Classifier{classifyNeon, "NEON"};
+#else
+        return Classifier{classifyScalar, "scalar"};
+#endif
+    }();
+    return selected;
+}
+
+bool classifyBlockFill(const uint8_t* data, uint32_t* fillValue)
+{
+    return classifier().fn(data, fillValue);
+}
+
+const char* blockClassifierName()
+{
+    return classifier().name;
+}
+
+// ── CRC-32 kernels ─────────────────────────────────────────────────────
+//
+// The CRC-32 of zlib and libsparse: reflected polynomial 0xEDB88320,
+// initial value and final XOR 0xFFFFFFFF.  The SSE4.2 crc32 instruction
+// computes CRC-32C, a different polynomial, so x86 folds with PCLMULQDQ.
+
+static constexpr uint32_t CRC32_POLY = 0xEDB88320;
+
+static constexpr auto CRC32_TABLE = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+            c = c & 1 ? (c >> 1) ^ CRC32_POLY : c >> 1;
+        table[i] = c;
+    }
+    return table;
+}();
+
+static uint32_t crc32Scalar(uint32_t crc, const uint8_t* data, size_t size)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = CRC32_TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+#ifdef SPARSE_CRC_PCLMUL
+// Fold `acc` across 128 bits with the constants in `k` and add `next`
+__attribute__((target("pclmul,sse4.1")))
+static inline __m128i foldPclmul(__m128i acc, __m128i next, __m128i k)
+{
+    const __m128i lo = _mm_clmulepi64_si128(acc, k, 0x00);
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(acc, k, 0x11), next), lo);
+}
+
+// Folds 64 bytes at a time in four lanes, then to 128 and 32 bits with a
+// Barrett reduction ("Fast CRC Computation for Generic Polynomials Using
+// PCLMULQDQ", Intel, 2009).  Takes and returns the CRC register, the
+// inverse of the CRC; `size` is at least 64 and a multiple of 16.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32FoldPclmul(uint32_t crc, const uint8_t* data, size_t size)
+{
+    alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+    alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+    const auto* p = reinterpret_cast<const __m128i*>(data);
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128(p), _mm_cvtsi32_si128(static_cast<int>(crc)));
+    __m128i x2 = _mm_loadu_si128(p + 1);
+    __m128i x3 = _mm_loadu_si128(p + 2);
+    __m128i x4 = _mm_loadu_si128(p + 3);
+    p += 4;
+    size -= 64;
+
+    __m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+    for (; size >= 64; size -= 64, p += 4) {
+        x1 = foldPclmul(x1, _mm_loadu_si128(p), k);
+        x2 = foldPclmul(x2, _mm_loadu_si128(p + 1), k);
+        x3 = foldPclmul(x3, _mm_loadu_si128(p + 2), k);
+        x4 = foldPclmul(x4, _mm_loadu_si128(p + 3), k);
+    }
+
+    // Fold the four lanes, then any remaining 16-byte blocks, into one
+    k = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+    x1 = foldPclmul(x1, x2, k);
+    x1 = foldPclmul(x1, x3, k);
+    x1 = foldPclmul(x1, x4, k);
+    for (; size >= 16; size -= 16, ++p)
+        x1 = foldPclmul(x1, _mm_loadu_si128(p), k);
+
+    // 128 to 64 bits
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    k = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x00), x2);
+
+    // Barrett reduction to 32 bits
+    k = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+static uint32_t crc32Pclmul(uint32_t crc, const uint8_t* data, size_t size)
+{
+    const size_t folded = size >= 64 ? size & ~size_t(15) : 0;
+    if (folded) {
+        crc = ~crc32FoldPclmul(~crc, data, folded);
+        data += folded;
+        size -= folded;
+    }
+    return crc32Scalar(crc, data, size);
+}
+#endif
+
+#ifdef SPARSE_CRC_ARMV8
+SPARSE_CRC_TARGET
+static uint32_t crc32Armv8(uint32_t crc, const uint8_t* data, size_t size)
+{
+    crc = ~crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = __crc32d(crc, word);
+    }
+    for (; size > 0; --size, ++data)
+        crc = __crc32b(crc, *data);
+    return ~crc;
+}
+
+static bool haveArmv8Crc()
+{
+#if defined(__ARM_FEATURE_CRC32) || defined(__APPLE__)
+    return true;
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return false;
+#endif
+}
+#endif
+
+using Crc32Fn = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+struct Crc32Kernel {
+    Crc32Fn fn;
+    const char* name;
+};
+
+static const Crc32Kernel& crc32Kernel()
+{
+    static const Crc32Kernel selected = [] {
+#ifdef SPARSE_CRC_PCLMUL
+        if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+            return Crc32Kernel{crc32Pclmul, "PCLMUL"};
+#endif
+#ifdef SPARSE_CRC_ARMV8
+        if (haveArmv8Crc())
+            return Crc32Kernel{crc32Armv8, "ARMv8 CRC32"};
+#endif
+        return Crc32Kernel{crc32Scalar, "table"};
+    }();
+    return selected;
+}
+
+uint32_t sparseCrc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    return crc32Kernel().fn(crc, data, size);
+}
+
+const char* crc32KernelName()
+{
+    return crc32Kernel().name;
+}
+
+// Polynomial arithmetic modulo the CRC polynomial, for appending runs of
+// zeros or of a known block without reading them (as zlib's
+// crc32_combine()).  Bit-reflected: x^0 is the top bit.
+static uint32_t crcMultiply(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+    for (uint32_t m = 1u << 31; m; m >>= 1) {
+        if (a & m)
+            product ^= b;
+        b = b & 1 ? (b >> 1) ^ CRC32_POLY : b >> 1;
+    }
+    return product;
+}
+
+// x^(8 * bytes): the operator that shifts a CRC register past `bytes` bytes
+static uint32_t crcShiftOperator(uint64_t bytes)
+{
+    // X2N[k] = x^(2^k)
+    static const auto X2N = [] {
+        std::array<uint32_t, 32> table{};
+        uint32_t p = 1u << 30;  // x^1
+        for (auto& entry : table) {
+            entry = p;
+            p = crcMultiply(p, p);
+        }
+        return table;
+    }();
+
+    uint32_t op = 1u << 31;  // x^0
+    for (unsigned k = 3; bytes; bytes >>= 1, ++k) {
+        if (bytes & 1)
+            op = crcMultiply(X2N[k & 31], op);
+    }
+    return op;
+}
+
+// CRC after `bytes` more zero bytes
+static uint32_t crcAppendZeros(uint32_t crc, uint64_t bytes)
+{
+    return ~crcMultiply(crcShiftOperator(bytes), ~crc);
+}
+
+// CRC after one more block whose own CRC (from 0) is `blockCrc`
+static uint32_t crcAppendBlock(uint32_t crc, uint32_t blockCrc)
+{
+    static const uint32_t blockShift = crcShiftOperator(SPARSE_BLK_SZ);
+    return crcMultiply(blockShift, crc) ^ blockCrc;
+}
+
+// ── Parallel classification ────────────────────────────────────────────
+
+// Spans shorter than this (per thread) are classified inline; waking
+// workers would cost more than it saves.
+static constexpr size_t PARALLEL_MIN_BLOCKS_PER_THREAD = 64;
+
+// Persistent workers that classify slices of one span.  The calling
+// thread takes the first slice, so `threads` includes it.
+class ClassifyPool {
+public:
+    explicit ClassifyPool(unsigned threads)
+    {
+        for (unsigned i = 1; i < threads; ++i)
+            _workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~ClassifyPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start.notify_all();
+        for (auto& t : _workers)
+            t.join();
+    }
+
+    unsigned threads() const { return static_cast<unsigned>(_workers.size()) + 1; }
+
+    void run(const uint8_t* data, size_t blocks, BlockClass* out)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _data = data;
+            _blocks = blocks;
+            _out = out;
+            _pending = static_cast<unsigned>(_workers.size());
+            ++_generation;
+        }
+        _start.notify_all();
+
+        classifySlice(0);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this] { return _pending == 0; });
+    }
+
+private:
+    void classifySlice(unsigned index)
+    {
+        const size_t n = threads();
+        const size_t first = _blocks * index / n;
+        const size_t last = _blocks * (index + 1) / n;
+        for (size_t b = first; b < last; ++b) {
+            BlockClass& c = _out[b];
+            c.fillValue = 0;
+            c.fill = classifyBlockFill(_data + b * SPARSE_BLK_SZ, &c.fillValue);
+        }
+    }
+
+    void workerLoop(unsigned index)
+    {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start.wait(lock, [&] { return _stop || _generation != seen; });
+                if (_stop)
+                    return;
+                seen = _generation;
+            }
+
+            classifySlice(index);
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                --_pending;
+            }
+            _done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _done;
+    uint64_t _generation = 0;
+    unsigned _pending = 0;
+    bool _stop = false;
+
+    const uint8_t* _data = nullptr;
+    size_t _blocks = 0;
+    BlockClass* _out = nullptr;
+};
+
+// ── Encoder ────────────────────────────────────────────────────────────
+
 // Minimum segment must hold: file header + leading DONT_CARE prefix +
-// one chunk header + one block + trailing DONT_CARE suffix
+// one chunk header + one block + trailing DONT_CARE suffix + CRC32 chunk
+static constexpr size_t CRC32_CHUNK_SZ = SPARSE_CHUNK_HDR_SZ + 4;
 static constexpr size_t MIN_SEGMENT_SIZE =
-    SPARSE_FILE_HDR_SZ + 2 * SPARSE_CHUNK_HDR_SZ + SPARSE_CHUNK_HDR_SZ + SPARSE_BLK_SZ;
+    SPARSE_FILE_HDR_SZ + 2 * SPARSE_CHUNK_HDR_SZ + SPARSE_CHUNK_HDR_SZ + SPARSE_BLK_SZ + CRC32_CHUNK_SZ;
 
 SparseEncoder::SparseEncoder(uint32_t maxSegmentSize, uint64_t totalImageSize)
     : _maxSegmentSize(maxSegmentSize)
+    , _segmentSizeLimit(maxSegmentSize)
     , _totalImageBlocks(totalImageSize > 0
           ? (totalImageSize + SPARSE_BLK_SZ - 1) / SPARSE_BLK_SZ
           : 0)
@@ -37,6 +486,33 @@ void SparseEncoder::setBlockMap(std::unique_ptr<BlockMap> map)
     _blockMap = std::move(map);
 }
 
+void SparseEncoder::setClassifyThreads(unsigned threads)
+{
+    assert(_processedBlocks == 0);  // must be called before first feed()
+    _classifyPool.reset();
+    if (threads > 1)
+        _classifyPool = std::make_unique<ClassifyPool>(threads);
+}
+
+void SparseEncoder::setChecksums(bool enabled)
+{
+    assert(_processedBlocks == 0);  // must be called before first feed()
+    _checksums = enabled;
+}
+
+void SparseEncoder::setSegmentSizeLimit(uint32_t bytes)
+{
+    _segmentSizeLimit = std::clamp<uint32_t>(bytes, static_cast<uint32_t>(MIN_SEGMENT_SIZE),
+                                             _maxSegmentSize);
+}
+
+void SparseEncoder::classifySpan(const uint8_t* data, size_t blocks)
+{
+    _classes.resize(blocks);
+    _classifyPool->run(data, blocks, _classes.data());
+    _classesData = data;
+}
+
 void SparseEncoder::beginSegment()
 {
     _out.clear();
@@ -48,6 +524,8 @@ void SparseEncoder::beginSegment()
     _segRaw = 0;
     _segFill = 0;
     _segDontCare = 0;
+    _segCrc = 0;
+    _segCrcZeroBlocks = 0;
 
     // For continuation segments (not the first), prepend a DONT_CARE chunk
     // that covers all blocks already written by previous segments.  This
@@ -65,10 +543,43 @@ void SparseEncoder::beginSegment()
         _out.resize(pos + SPARSE_CHUNK_HDR_SZ);
         std::memcpy(_out.data() + pos, &hdr, sizeof(hdr));
         _segmentBlocks = skipBlocks;
+        _segCrcZeroBlocks = skipBlocks;
         ++_chunkCount;
     }
 }
 
+void SparseEncoder::checksumPendingZeros()
+{
+    if (_segCrcZeroBlocks == 0)
+        return;
+    _segCrc = crcAppendZeros(_segCrc, _segCrcZeroBlocks * SPARSE_BLK_SZ);
+    _segCrcZeroBlocks = 0;
+}
+
+void SparseEncoder::checksumBlock(uint16_t type, const uint8_t* block, uint32_t fillValue)
+{
+    // DONT_CARE reads back as zeros, like FILL(0)
+    if (type == CHUNK_TYPE_DONT_CARE || (type == CHUNK_TYPE_FILL && fillValue == 0)) {
+        ++_segCrcZeroBlocks;
+        return;
+    }
+    checksumPendingZeros();
+
+    if (type == CHUNK_TYPE_RAW) {
+        _segCrc = sparseCrc32(_segCrc, block, SPARSE_BLK_SZ);
+        return;
+    }
+    if (!_fillCrcValid || fillValue != _fillCrcValue) {
+        alignas(16) uint8_t filled[SPARSE_BLK_SZ];
+        for (size_t i = 0; i < SPARSE_BLK_SZ; i += 4)
+            std::memcpy(filled + i, &fillValue, 4);
+        _fillCrc = sparseCrc32(0, filled, SPARSE_BLK_SZ);
+        _fillCrcValue = fillValue;
+        _fillCrcValid = true;
+    }
+    _segCrc = crcAppendBlock(_segCrc, _fillCrc);
+}
+
 
 void SparseEncoder::flushRun()
 {
@@ -143,6 +654,21 @@ void SparseEncoder::finaliseSegment()
         _out.resize(pos + SPARSE_CHUNK_HDR_SZ);
         std::memcpy(_out.data() + pos, &tail, sizeof(tail));
         _segmentBlocks += tailBlocks;
+        _segCrcZeroBlocks += tailBlocks;
+        ++_chunkCount;
+    }
+
+    if (_checksums) {
+        checksumPendingZeros();
+        SparseChunkHeader crcHdr{};
+        crcHdr.chunk_type = CHUNK_TYPE_CRC32;
+        crcHdr.chunk_sz = 0;
+        crcHdr.total_sz = CRC32_CHUNK_SZ;
+
+        size_t pos = _out.size();
+        _out.resize(pos + CRC32_CHUNK_SZ);
+        std::memcpy(_out.data() + pos, &crcHdr, sizeof(crcHdr));
+        std::memcpy(_out.data() + pos + SPARSE_CHUNK_HDR_SZ, &_segCrc, 4);
         ++_chunkCount;
     }
 
@@ -171,13 +697,14 @@ void SparseEncoder::finaliseSegment()
     _readyStats.fillBlocks = _segFill;
     _readyStats.dontCareBlocks = _segDontCare;
     _readyStats.wireBytes = _out.size();
+    _readyStats.crc32 = _checksums ? _segCrc : 0;
 
-    // Move to ready buffer
-    _ready = std::move(_out);
+    // Swap into the ready buffer so _out keeps an allocation to reuse
+    _ready.swap(_out);
     beginSegment();
 }
 
-void SparseEncoder::processBlock(const uint8_t* block)
+void SparseEncoder::processBlock(const uint8_t* block, const BlockClass* known)
 {
     // Classify the block.
     //
@@ -188,14 +715,23 @@ void SparseEncoder::processBlock(const uint8_t* block)
     // every byte in a raw disk image is meaningful and DONT_CARE would
     // leave prior device content in place.
     //
-    // isBlockFill handles zero blocks (fill value 0).
+    // The fill check handles zero blocks (fill value 0).  `known` carries
+    // a classification already computed by classifySpan().
     uint16_t type;
     uint32_t fillVal = 0;
 
-    if (_blockMap && !_blockMap->isMappedSequential(_processedBlocks)) {
+    if (_blockMap && _processedBlocks >= _extentEnd) {
+        const BlockMap::Extent extent = _blockMap->extentAtSequential(_processedBlocks);
+        _extentMapped = extent.mapped;
+        // A growing map may still map blocks past its end
+        _extentEnd = extent.end == BlockMap::kNoEnd ? _processedBlocks + 1 : extent.end;
+    }
+
+    if (_blockMap && !_extentMapped) {
         type = CHUNK_TYPE_DONT_CARE;
         ++_statsDontCare;
-    } else if (isBlockFill(block, &fillVal)) {
+    } else if (known ? (fillVal = known->fillValue, known->fill)
+                     : classifyBlockFill(block, &fillVal)) {
         type = CHUNK_TYPE_FILL;
         ++_statsFill;
     } else {
@@ -210,13 +746,18 @@ void SparseEncoder::processBlock(const uint8_t* block)
 
     // Would this block fit in the current segment?  Reserve space for the
     // trailing DONT_CARE chunk that finaliseSegment() appends to pad each
-    // segment to the full image block count.
-    size_t trailer = (_totalImageBlocks > 0) ? SPARSE_CHUNK_HDR_SZ : 0;
+    // segment to the full image block count, and for the CRC32 chunk.
+    size_t trailer = ((_totalImageBlocks > 0) ? SPARSE_CHUNK_HDR_SZ : 0)
+        + (_checksums ? CRC32_CHUNK_SZ : 0);
     size_t cost = continues
         ? (type == CHUNK_TYPE_RAW ? SPARSE_BLK_SZ : 0)
         : (SPARSE_CHUNK_HDR_SZ + (type == CHUNK_TYPE_RAW ? SPARSE_BLK_SZ
                                  : type == CHUNK_TYPE_FILL ? 4 : 0));
-    if (_out.size() + cost + trailer > _maxSegmentSize) {
+    // A FILL or DONT_CARE run only reaches _out when it is flushed
+    const size_t pendingRun = (_runBlocks > 0 && _runType != CHUNK_TYPE_RAW)
+        ? SPARSE_CHUNK_HDR_SZ + (_runType == CHUNK_TYPE_FILL ? 4 : 0)
+        : 0;
+    if (_out.size() + pendingRun + cost + trailer > _segmentSizeLimit) {
         finaliseSegment();
         continues = false;
         cost = SPARSE_CHUNK_HDR_SZ + (type == CHUNK_TYPE_RAW ? SPARSE_BLK_SZ
@@ -230,6 +771,8 @@ void SparseEncoder::processBlock(const uint8_t* block)
     case CHUNK_TYPE_FILL:      ++_segFill; break;
     case CHUNK_TYPE_RAW:       ++_segRaw; break;
     }
+    if (_checksums)
+        checksumBlock(type, block, fillVal);
 
     // Start a new run if not continuing
     if (!continues) {
@@ -283,13 +826,34 @@ size_t SparseEncoder::feed(const void* data, size_t size)
         }
     }
 
+    // Classify the full blocks up front on the worker pool, unless the
+    // previous call stopped for a segment and this one resumes in the
+    // span already classified.
+    const size_t fullBlocks = static_cast<size_t>(end - src) / SPARSE_BLK_SZ;
+    const bool resume = !_classes.empty() && src == _classesResume
+        && _classesData + _classes.size() * SPARSE_BLK_SZ <= end;
+    if (!resume) {
+        _classes.clear();
+        if (_classifyPool && fullBlocks >= PARALLEL_MIN_BLOCKS_PER_THREAD * _classifyPool->threads())
+            classifySpan(src, fullBlocks);
+    }
+
     // Process full blocks directly from input (zero-copy classification)
     while (static_cast<size_t>(end - src) >= SPARSE_BLK_SZ) {
-        processBlock(src);
+        const BlockClass* known = nullptr;
+        if (!_classes.empty()) {
+            size_t index = static_cast<size_t>(src - _classesData) / SPARSE_BLK_SZ;
+            if (index < _classes.size())
+                known = &_classes[index];
+        }
+        processBlock(src, known);
         src += SPARSE_BLK_SZ;
-        if (!_ready.empty())
+        if (!_ready.empty()) {
+            _classesResume = src;
             return static_cast<size_t>(src - begin);
+        }
     }
+    _classes.clear();
 
     // Buffer remainder
     size_t rem = static_cast<size_t>(end - src);
@@ -330,4 +894,38 @@ std::span<const uint8_t> SparseEncoder::takeSegment(SegmentStats* stats)
     return {_ready.data(), _ready.size()};
 }
 
+bool SparseEncoder::takeSegment(std::vector<uint8_t>& buffer, SegmentStats* stats)
+{
+    if (_ready.empty())
+        return false;
+    if (stats)
+        *stats = _readyStats;
+    buffer.swap(_ready);
+    _ready.clear();
+    return true;
+}
+
+// ── Segment sizing ─────────────────────────────────────────────────────
+
+SegmentSizer::SegmentSizer(uint32_t maxDownloadSize)
+    : _max(maxDownloadSize)
+    , _size(std::min(INITIAL_SEGMENT_SIZE, maxDownloadSize))
+{
+}
+
+void SegmentSizer::recordTransfer(size_t bytes, uint32_t transferMs)
+{
+    if (bytes == 0)
+        return;
+
+    const double sample = static_cast<double>(bytes) * 1000.0 / std::max<uint32_t>(transferMs, 1);
+    _bytesPerSec = _bytesPerSec > 0 ? (_bytesPerSec + sample) / 2 : sample;
+
+    const double target = _bytesPerSec * TARGET_TRANSFER_MS / 1000.0;
+    const double grown = std::min(target, 2.0 * _size);
+    const uint32_t floor = std::min(INITIAL_SEGMENT_SIZE, _max);
+    _size = static_cast<uint32_t>(std::clamp(grown, static_cast<double>(floor),
+                                             static_cast<double>(_max)));
+}
+
 } // namespace fastboot
@@ -37,6 +37,7 @@ static constexpr uint32_t SPARSE_BLK_SZ       = 4096;
 static constexpr uint16_t CHUNK_TYPE_RAW       = 0xCAC1;
 static constexpr uint16_t CHUNK_TYPE_FILL      = 0xCAC2;
 static constexpr uint16_t CHUNK_TYPE_DONT_CARE = 0xCAC3;
+static constexpr uint16_t CHUNK_TYPE_CRC32     = 0xCAC4;
 
 #pragma pack(push, 1)
 struct SparseFileHeader {
@@ -62,8 +63,9 @@ static_assert(sizeof(SparseChunkHeader) == 12);
 #pragma pack(pop)
 
 // ── Block classification ───────────────────────────────────────────────
-// These are intentionally in the header so the compiler can inline and
-// auto-vectorise them at the call site.
+// isBlockZero/isBlockFill are intentionally in the header so the compiler
+// can inline and auto-vectorise them at the call site.  The encoder itself
+// uses classifyBlockFill(), which dispatches to explicit SIMD kernels.
 
 // Returns true if all 4096 bytes are zero.
 // Uses OR-accumulate over uint64_t — auto-vectorises to SSE2/AVX2/NEON.
@@ -95,6 +97,29 @@ inline bool isBlockFill(const uint8_t* data, uint32_t* fillValue)
     return false;
 }
 
+// Same result as isBlockFill(), using the fastest kernel available on this
+// CPU (AVX2 on x86-64, NEON on ARM, scalar otherwise).  Returns as soon as
+// a mismatch is found, so RAW blocks typically cost a single vector compare.
+bool classifyBlockFill(const uint8_t* data, uint32_t* fillValue);
+
+// Name of the kernel classifyBlockFill() dispatches to, for logging.
+const char* blockClassifierName();
+
+// CRC-32 of `size` more bytes after `crc`, as zlib's crc32() computes it,
+// using the fastest kernel available on this CPU (PCLMULQDQ folding on
+// x86-64, the ARMv8 CRC32 instructions on AArch64, a table otherwise).
+uint32_t sparseCrc32(uint32_t crc, const uint8_t* data, size_t size);
+
+// Name of the kernel sparseCrc32() dispatches to, for logging.
+const char* crc32KernelName();
+
+// Result of classifying one block, computed ahead of run-merging when the
+// encoder classifies in parallel.
+struct BlockClass {
+    uint32_t fillValue;
+    bool fill;
+};
+
 // ── Streaming encoder ──────────────────────────────────────────────────
 
 class SparseEncoder {
@@ -110,6 +135,29 @@ public:
     // Must be called before the first feed().  Takes ownership.
     void setBlockMap(std::unique_ptr<class BlockMap> map);
 
+    // Cap segments at `bytes` on the wire (at most maxSegmentSize), from
+    // the segment being built onwards.  DONT_CARE runs carry no payload,
+    // so a segment still spans every unmapped block it meets however
+    // small the cap.
+    void setSegmentSizeLimit(uint32_t bytes);
+    uint32_t segmentSizeLimit() const { return _segmentSizeLimit; }
+
+    // Classify the full blocks of each feed() call on `threads` threads
+    // (including the caller) before merging runs sequentially.  0 or 1
+    // classifies inline, block by block.  Output is identical either way.
+    // Must be called before the first feed().
+    void setClassifyThreads(unsigned threads);
+
+    // End each segment with a CRC32 chunk: the CRC-32 of the image range
+    // the segment covers, with DONT_CARE blocks counted as zeros as
+    // libsparse does.  RAW blocks are summed as they are copied into the
+    // segment and FILL and DONT_CARE runs from their length and value, so
+    // this costs no second pass over the data.  Off by default, as not
+    // every fastboot implementation accepts CRC32 chunks.  Must be called
+    // before the first feed().
+    void setChecksums(bool enabled);
+    bool checksums() const { return _checksums; }
+
     // Feed raw decompressed data.  May be called with any size.
     // Internally buffers partial blocks and emits complete segments.
     // Returns the number of bytes consumed.  When fewer than `size`
@@ -131,6 +179,7 @@ public:
         uint32_t fillBlocks = 0;   // blocks sent as FILL
         uint32_t dontCareBlocks = 0; // blocks skipped as DONT_CARE
         size_t   wireBytes = 0;    // segment size on the wire
+        uint32_t crc32 = 0;        // value of the CRC32 chunk, if checksums are on
     };
 
     // Returns the next completed segment, or an empty span if none ready.
@@ -138,6 +187,12 @@ public:
     // If stats is non-null, it is populated with per-segment statistics.
     std::span<const uint8_t> takeSegment(SegmentStats* stats = nullptr);
 
+    // Moves the next completed segment into `buffer` and keeps the
+    // buffer's old storage for building later segments.  Returns false if
+    // none is ready.  The data stays valid across feed()/finish(), so it
+    // can be sent while the next segment is encoded.
+    bool takeSegment(std::vector<uint8_t>& buffer, SegmentStats* stats = nullptr);
+
     // Statistics
     uint64_t rawBlockCount() const { return _statsRaw; }
     uint64_t fillBlockCount() const { return _statsFill; }
@@ -145,16 +200,23 @@ public:
     uint64_t totalBlocksProcessed() const { return _processedBlocks; }
 
 private:
-    void processBlock(const uint8_t* block);
+    void processBlock(const uint8_t* block, const BlockClass* known = nullptr);
+    void classifySpan(const uint8_t* data, size_t blocks);
     void flushRun();
     void finaliseSegment();
     void beginSegment();
+    void checksumBlock(uint16_t type, const uint8_t* block, uint32_t fillValue);
+    void checksumPendingZeros();
 
     uint32_t _maxSegmentSize;
+    uint32_t _segmentSizeLimit;
     uint64_t _totalImageBlocks;
 
-    // Optional block map for DONT_CARE optimisation
+    // Optional block map for DONT_CARE optimisation, and the extent of it
+    // the current block is in: the map is only asked again past its end
     std::unique_ptr<class BlockMap> _blockMap;
+    uint64_t _extentEnd = 0;
+    bool _extentMapped = false;
 
     // Output buffer — one segment at a time
     std::vector<uint8_t> _out;
@@ -167,6 +229,15 @@ private:
     uint32_t _runFillValue = 0;
     size_t   _runRawStart = 0;      // offset in _out where RAW data begins
 
+    // Parallel classification (see setClassifyThreads).  _classes holds
+    // the results for the blocks starting at _classesData; when feed()
+    // stops early for a segment, the caller's next feed() resumes at
+    // _classesResume and reuses them.
+    std::unique_ptr<class ClassifyPool> _classifyPool;
+    std::vector<BlockClass> _classes;
+    const uint8_t* _classesData = nullptr;
+    const uint8_t* _classesResume = nullptr;
+
     // Partial block accumulator
     alignas(8) uint8_t _partial[SPARSE_BLK_SZ] = {};
     size_t _partialSize = 0;
@@ -180,6 +251,16 @@ private:
     uint32_t _segDontCare = 0;
     SegmentStats _readyStats{};
 
+    // Running CRC-32 of the current segment's image range (setChecksums).
+    // Zero blocks are counted and folded in at once before anything else
+    // is summed; the CRC of the last fill block seen is kept.
+    bool _checksums = false;
+    uint32_t _segCrc = 0;
+    uint64_t _segCrcZeroBlocks = 0;
+    uint32_t _fillCrcValue = 0;
+    uint32_t _fillCrc = 0;
+    bool _fillCrcValid = false;
+
     // Completed segment ready for takeSegment()
     std::vector<uint8_t> _ready;
 
@@ -189,6 +270,39 @@ private:
     uint64_t _statsDontCare = 0;
 };
 
+// ── Segment sizing ─────────────────────────────────────────────────────
+//
+// Chooses the size of each sparse segment.  A full max-download-size
+// segment keeps the link idle until that much of the image has been
+// encoded, while every segment costs a download and a flash command
+// round trip.  Segments therefore start at INITIAL_SEGMENT_SIZE, so the
+// first transfer begins almost at once, then at most double each time up
+// to what the measured link moves in TARGET_TRANSFER_MS, capped at
+// max-download-size.  A slower link shrinks them again, down to the
+// initial size.
+
+class SegmentSizer {
+public:
+    static constexpr uint32_t INITIAL_SEGMENT_SIZE = 4 * 1024 * 1024;
+    static constexpr uint32_t TARGET_TRANSFER_MS = 2000;
+
+    explicit SegmentSizer(uint32_t maxDownloadSize);
+
+    // Size for the next segment to be encoded
+    uint32_t nextSize() const { return _size; }
+
+    // A segment of `bytes` took `transferMs` to download to the device
+    void recordTransfer(size_t bytes, uint32_t transferMs);
+
+    // Smoothed link throughput; 0 until a transfer has been recorded
+    uint64_t linkBytesPerSec() const { return static_cast<uint64_t>(_bytesPerSec); }
+
+private:
+    uint32_t _max;
+    uint32_t _size;
+    double _bytesPerSec = 0;
+};
+
 } // namespace fastboot
 
 #endif // FASTBOOT_SPARSE_ENCODER_H
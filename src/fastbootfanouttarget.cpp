@@ -0,0 +1,179 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "fastbootfanouttarget.h"
+#include "rpiboot/libusb_transport.h"
+#include "timeout_utils.h"
+
+#include <QDebug>
+#include <QObject>
+#include <QStringList>
+
+#include <chrono>
+#include <stdexcept>
+
+using rpi_imager::TimeoutDefaults::kFanOutLagTimeoutMs;
+
+FastbootFanOutTarget::FastbootFanOutTarget(const QString &fastbootId, const QString &blockDevice)
+    : _fastbootId(fastbootId)
+    , _blockDevice(blockDevice)
+{
+}
+
+FastbootFanOutTarget::~FastbootFanOutTarget()
+{
+    cancel();
+    if (_thread.joinable())
+        _thread.join();
+}
+
+bool FastbootFanOutTarget::open(bool queryIdentity)
+{
+    rpiboot::UsbDeviceInfo info{};
+    info.vendorId = rpiboot::FASTBOOT_VID;
+    info.productId = rpiboot::FASTBOOT_PID;
+    const QStringList parts = _fastbootId.split(':');
+    if (parts.size() >= 2) {
+        info.busNumber = static_cast<uint8_t>(parts[0].toUInt());
+        info.deviceAddress = static_cast<uint8_t>(parts[1].toUInt());
+    }
+
+    try {
+        _ctx = std::make_unique<rpiboot::LibusbContext>();
+    } catch (const std::runtime_error &e) {
+        fail(QString::fromUtf8(e.what()));
+        return false;
+    }
+    _transport = _ctx->openDevice(info);
+    if (!_transport || !_transport->isOpen()) {
+        fail(QObject::tr("Failed to open fastboot device: %1").arg(_fastbootId));
+        return false;
+    }
+
+    std::vector<std::string_view> varNames = {"max-download-size"};
+    if (queryIdentity) {
+        varNames.push_back("product");
+        varNames.push_back("serialno");
+    }
+    auto vars = _fb.getVars(*_transport, varNames);
+    _maxDownloadSize = fastboot::FastbootProtocol::DEFAULT_MAX_DOWNLOAD_SIZE;
+    if (vars[0]) {
+        if (auto size = fastboot::FastbootProtocol::parseSize(*vars[0]))
+            _maxDownloadSize = *size;
+    }
+    if (queryIdentity) {
+        if (vars[1])
+            _boardDescription = QString::fromStdString(*vars[1]);
+        if (vars[2])
+            _serial = QString::fromStdString(*vars[2]);
+    }
+    qDebug() << "Additional fastboot target" << _fastbootId
+             << "max-download-size =" << _maxDownloadSize;
+    return true;
+}
+
+rpiboot::IUsbTransport &FastbootFanOutTarget::transport()
+{
+    return *_transport;
+}
+
+void FastbootFanOutTarget::start(std::function<void(uint64_t)> onProgress)
+{
+    _onProgress = std::move(onProgress);
+    _thread = std::thread(&FastbootFanOutTarget::sendLoop, this);
+}
+
+bool FastbootFanOutTarget::queueSegment(Segment segment, uint64_t fedBytes)
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        const bool room = _cv.wait_for(lock, std::chrono::milliseconds(kFanOutLagTimeoutMs), [this] {
+            return _queue.size() < kMaxQueuedSegments || _failed.load() || _cancelled.load();
+        });
+        if (_failed.load() || _cancelled.load())
+            return false;
+        if (!room) {
+            lock.unlock();
+            fail(QObject::tr("Fastboot device %1 fell too far behind the other devices.").arg(_fastbootId));
+            return false;
+        }
+        _queue.push_back({std::move(segment), fedBytes});
+    }
+    _cv.notify_all();
+    return true;
+}
+
+bool FastbootFanOutTarget::finishSegments()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _finishing = true;
+    }
+    _cv.notify_all();
+    if (_thread.joinable())
+        _thread.join();
+    return !_failed.load();
+}
+
+void FastbootFanOutTarget::cancel()
+{
+    _cancelled.store(true);
+    _cv.notify_all();
+}
+
+void FastbootFanOutTarget::fail(const QString &message)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_failed.load())
+            return;
+        _error = message;
+        _failed.store(true);
+        // Let go of the shared segments straight away
+        _queue.clear();
+    }
+    qDebug() << "Additional fastboot target" << _fastbootId << "failed:" << message;
+    _cv.notify_all();
+}
+
+QString FastbootFanOutTarget::errorString() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _error;
+}
+
+void FastbootFanOutTarget::sendLoop()
+{
+    const std::string partition = _blockDevice.toStdString();
+    while (true) {
+        QueuedSegment current;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this] {
+                return !_queue.empty() || _finishing || _failed.load() || _cancelled.load();
+            });
+            if (_queue.empty() || _failed.load() || _cancelled.load())
+                return;
+            current = std::move(_queue.front());
+            _queue.pop_front();
+        }
+        _cv.notify_all();
+
+        if (!_fb.download(*_transport, current.data.bytes(), nullptr, _cancelled)) {
+            if (!_cancelled.load())
+                fail(QObject::tr("Fastboot download failed: %1").arg(QString::fromStdString(_fb.lastError())));
+            return;
+        }
+        if (!_fb.flash(*_transport, partition, 120000)) {
+            if (!_cancelled.load())
+                fail(QObject::tr("Fastboot flash failed: %1").arg(QString::fromStdString(_fb.lastError())));
+            return;
+        }
+        // Drop our reference before reporting, so the encoder can reuse the buffer
+        current.data = nullptr;
+        if (_onProgress)
+            _onProgress(current.fedBytes);
+    }
+}
@@ -0,0 +1,145 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef FASTBOOTFANOUTTARGET_H
+#define FASTBOOTFANOUTTARGET_H
+
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "fastboot/fastboot_protocol.h"
+#include "rpiboot/file_server.h"
+
+namespace rpiboot { class LibusbContext; class LibusbTransport; }
+
+/**
+ * @brief Additional fastboot device for multi-device ("fan-out") flashing
+ *
+ * FastbootFlashThread downloads, decompresses and sparse-encodes the image
+ * once. A sparse segment does not depend on the device it is sent to, as
+ * long as the device accepts its size, so every target is handed the same
+ * encoded segments and sends them to its own gadget on a send thread of
+ * its own. A slow device only delays its own queue.
+ *
+ * Lag is bounded as for FanOutTarget: a target holds at most
+ * kMaxQueuedSegments segments, and if it cannot take another within
+ * kFanOutLagTimeoutMs it is failed and dropped instead of stalling the
+ * other devices. USB and flash errors are isolated the same way.
+ *
+ * Lifecycle (all calls from the FastbootFlashThread):
+ *   open()           - open the gadget and read its max-download-size
+ *   start()          - start the send thread
+ *   queueSegment()   - hand over an encoded segment
+ *   finishSegments() - no more segments; waits for the queue to drain
+ *   protocol(), transport() - customisation, registration and reboot
+ */
+class FastbootFanOutTarget
+{
+public:
+    // An encoded buffer, or a segment replayed from the artefact cache
+    using Segment = rpiboot::FileData;
+
+    // fastbootId is "bus:addr"; blockDevice the device-side storage to flash
+    FastbootFanOutTarget(const QString &fastbootId, const QString &blockDevice);
+    ~FastbootFanOutTarget();
+
+    FastbootFanOutTarget(const FastbootFanOutTarget&) = delete;
+    FastbootFanOutTarget& operator=(const FastbootFanOutTarget&) = delete;
+
+    /**
+     * @brief Open the gadget and query its variables
+     * @param queryIdentity Also read "product" and "serialno" for Connect registration
+     * @return true if the device is ready for flashing
+     */
+    bool open(bool queryIdentity);
+
+    /**
+     * @brief Start sending queued segments
+     * @param onProgress Called on the send thread with the image bytes
+     *        flashed so far, after each segment
+     */
+    void start(std::function<void(uint64_t)> onProgress);
+
+    /**
+     * @brief Queue a segment; fedBytes is the image input it covers up to
+     *
+     * Blocks for at most kFanOutLagTimeoutMs if this target is too far
+     * behind. On timeout the target is failed and false is returned;
+     * the caller should carry on with the remaining targets.
+     */
+    bool queueSegment(Segment segment, uint64_t fedBytes);
+
+    /**
+     * @brief Signal end of segments and wait for the queue to be flashed
+     * @return false if the target failed
+     */
+    bool finishSegments();
+
+    /**
+     * @brief Abort sending and discard queued segments
+     */
+    void cancel();
+
+    /**
+     * @brief Mark the target as failed (e.g. hash or customisation failure)
+     */
+    void fail(const QString &message);
+
+    QString fastbootId() const { return _fastbootId; }
+    QString blockDevice() const { return _blockDevice; }
+    uint32_t maxDownloadSize() const { return _maxDownloadSize; }
+    QString boardDescription() const { return _boardDescription; }
+    QString serial() const { return _serial; }
+
+    // Only for use once finishSegments() has returned
+    fastboot::FastbootProtocol &protocol() { return _fb; }
+    rpiboot::IUsbTransport &transport();
+    std::atomic<bool> &cancelledFlag() { return _cancelled; }
+
+    bool hasFailed() const { return _failed.load(); }
+    QString errorString() const;
+
+    static constexpr size_t kMaxQueuedSegments = 2;
+
+private:
+    struct QueuedSegment {
+        Segment data;
+        uint64_t fedBytes = 0;
+    };
+
+    void sendLoop();
+
+    QString _fastbootId;
+    QString _blockDevice;
+    uint32_t _maxDownloadSize = 0;
+    QString _boardDescription;
+    QString _serial;
+
+    std::unique_ptr<rpiboot::LibusbContext> _ctx;
+    std::unique_ptr<rpiboot::LibusbTransport> _transport;
+    fastboot::FastbootProtocol _fb;
+
+    std::thread _thread;
+    std::function<void(uint64_t)> _onProgress;
+    std::deque<QueuedSegment> _queue;
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _finishing = false;
+
+    QString _error;
+    std::atomic<bool> _failed{false};
+    std::atomic<bool> _cancelled{false};
+};
+
+#endif // FASTBOOTFANOUTTARGET_H
@@ -4,34 +4,108 @@
  */
 
 #include "fastbootflashthread.h"
+#include "fastbootfanouttarget.h"
 #include "rpiboot/libusb_transport.h"
+#include "rpiboot/shared_file_cache.h"
 #include "fastboot/fastboot_protocol.h"
 #include "fastboot/sparse_encoder.h"
 #include "fastboot/bmap.h"
+#include "fastboot/sparse_artefact_cache.h"
 #include "connect_device_registrar.h"
+#include "containerlimits.h"
 #include "curlnetworkconfig.h"
 #include "acceleratedcryptographichash.h"
 #include "ringbuffer.h"
 #include "systemmemorymanager.h"
+#include "usedblockscanner.h"
 
 #include <QDateTime>
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QScopeGuard>
+#include <QSettings>
+#include <QStandardPaths>
 
 #include <archive.h>
 #include <archive_entry.h>
 #include <curl/curl.h>
 
+#include <algorithm>
+#include <condition_variable>
 #include <cstring>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <optional>
 #include <thread>
 
 // Use the canonical FASTBOOT_VID/PID from rpiboot_types.h
 using rpiboot::FASTBOOT_VID;
 using rpiboot::FASTBOOT_PID;
 
-// Default max-download-size if the device doesn't report one
-static constexpr uint32_t DEFAULT_MAX_DOWNLOAD_SIZE = 256 * 1024 * 1024;  // 256 MB
+// Buffers for encoded segments.  A segment is shared by the primary
+// device's sender and every fan-out target; its buffer comes back here
+// once the last of them has sent it, and is reused for a later segment.
+class SegmentPool : public std::enable_shared_from_this<SegmentPool>
+{
+public:
+    std::unique_ptr<std::vector<uint8_t>> take()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_free.empty())
+            return std::make_unique<std::vector<uint8_t>>();
+        auto buffer = std::move(_free.back());
+        _free.pop_back();
+        return buffer;
+    }
+
+    std::shared_ptr<const std::vector<uint8_t>> share(std::unique_ptr<std::vector<uint8_t>> buffer)
+    {
+        return std::shared_ptr<const std::vector<uint8_t>>(buffer.release(),
+            [pool = shared_from_this()](const std::vector<uint8_t>* spent) {
+                std::lock_guard<std::mutex> lock(pool->_mutex);
+                pool->_free.emplace_back(const_cast<std::vector<uint8_t>*>(spent));
+            });
+    }
+
+private:
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<std::vector<uint8_t>>> _free;
+};
+
+// Sparse artefacts are about the size of the image each; keep a few
+static constexpr size_t SPARSE_ARTEFACTS_KEPT = 2;
+
+// A segment replayed from the artefact cache, mapped where possible
+static rpiboot::FileData loadCachedSegment(const fastboot::SparseArtefactCache::Segment& segment)
+{
+    auto data = rpiboot::SharedFileCache::mapFile(segment.path);
+    if (!data) {
+        auto bytes = rpiboot::FileServer::readFileFromDisk(segment.path.parent_path(),
+                                                           segment.path.filename().string());
+        if (!bytes.empty())
+            data = std::make_shared<const std::vector<uint8_t>>(std::move(bytes));
+    }
+    if (!data || data.size() != segment.size)
+        return nullptr;
+    return data;
+}
+
+// Time one stage of the flash pipeline spent blocked on its neighbours
+struct StageWaits {
+    const char* name;
+    uint64_t inputWaitMs;   // Waiting for data from the stage before
+    uint64_t outputWaitMs;  // Waiting for room in the queue to the next
+};
+
+// The stage that waited least is the one the others were waiting for
+static const StageWaits& bottleneckStage(std::span<const StageWaits> stages)
+{
+    return *std::min_element(stages.begin(), stages.end(),
+        [](const StageWaits& a, const StageWaits& b) {
+            return a.inputWaitMs + a.outputWaitMs < b.inputWaitMs + b.outputWaitMs;
+        });
+}
 
 FastbootFlashThread::FastbootFlashThread(const QString& fastbootId,
                                            const QString& blockDevice,
@@ -74,6 +148,30 @@ void FastbootFlashThread::cancel()
         _compressedRing->cancel();
     if (_decompressedRing)
         _decompressedRing->cancel();
+    std::lock_guard<std::mutex> lock(_fanOutMutex);
+    for (auto& target : _fanOutTargets)
+        target->cancel();
+}
+
+void FastbootFlashThread::addFanOutTarget(const QString &fastbootId, const QString &blockDevice)
+{
+    _fanOutDevices.append({fastbootId, blockDevice});
+    qDebug() << "FastbootFlashThread: additional target" << fastbootId << blockDevice;
+}
+
+void FastbootFlashThread::openFanOutTargets(bool queryIdentity)
+{
+    for (const auto& device : std::as_const(_fanOutDevices)) {
+        auto target = std::make_unique<FastbootFanOutTarget>(device.first, device.second);
+        if (!target->open(queryIdentity)) {
+            // A device that cannot be opened is reported and left out;
+            // the remaining devices are still flashed
+            emit fanOutTargetFinished(target->fastbootId(), false, target->errorString());
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(_fanOutMutex);
+        _fanOutTargets.push_back(std::move(target));
+    }
 }
 
 void FastbootFlashThread::setImageCustomisation(const QByteArray &config,
@@ -98,16 +196,56 @@ void FastbootFlashThread::setConnectRegistration(const QString &apiKey,
     _connectDescriptionPrefix = descriptionPrefix;
 }
 
-bool FastbootFlashThread::applyCustomisation(fastboot::FastbootProtocol& fb,
-                                              rpiboot::IUsbTransport& transport)
+FastbootFlashThread::CustomisationPlan FastbootFlashThread::prepareCustomisation() const
 {
+    CustomisationPlan plan;
     bool hasCustomisation = !_config.isEmpty() || !_cmdline.isEmpty() ||
                             !_firstrun.isEmpty() || !_cloudinit.isEmpty() ||
                             !_cloudinitNetwork.isEmpty();
     if (!hasCustomisation || _initFormat.isEmpty())
+        return plan;
+    plan.active = true;
+
+    // ── firstrun.sh (systemd format) ──
+    plan.cmdlineAppend = _cmdline;
+    if (!_firstrun.isEmpty() && _initFormat == "systemd") {
+        plan.newFiles.append({"firstrun.sh", _firstrun});
+        plan.cmdlineAppend += " systemd.run=/boot/firstrun.sh"
+                              " systemd.run_success_action=reboot"
+                              " systemd.unit=kernel-command-line.target";
+    }
+
+    // ── cloud-init files ──
+    // Only write meta-data and the ds=nocloud cmdline when there is actual
+    // cloud-init content.  A stale cmdline entry (e.g. recommendedWifiCountry)
+    // alone should not trigger cloud-init file writes.
+    bool initCloud = (_initFormat == "cloudinit" || _initFormat == "cloudinit-rpi");
+    bool hasCloudContent = !_cloudinit.isEmpty() || !_cloudinitNetwork.isEmpty();
+    if (initCloud && hasCloudContent) {
+        QByteArray instanceId = "rpi-imager-" + QByteArray::number(QDateTime::currentMSecsSinceEpoch());
+        plan.newFiles.append({"meta-data", "instance-id: " + instanceId + "\n"});
+        plan.cmdlineAppend += " ds=nocloud;i=" + instanceId;
+
+        if (!_cloudinit.isEmpty())
+            plan.newFiles.append({"user-data", "#cloud-config\n" + _cloudinit});
+        if (!_cloudinitNetwork.isEmpty())
+            plan.newFiles.append({"network-config", _cloudinitNetwork});
+    }
+
+    return plan;
+}
+
+bool FastbootFlashThread::applyCustomisation(fastboot::FastbootProtocol& fb,
+                                              rpiboot::IUsbTransport& transport,
+                                              const CustomisationPlan& plan,
+                                              std::atomic<bool>& cancelled,
+                                              QString& errorOut)
+{
+    using BatchOp = fastboot::FastbootProtocol::BatchOp;
+
+    if (!plan.active)
         return true;
 
-    emit preparationStatusUpdate(tr("Applying OS customisation..."));
     qDebug() << "applyCustomisation: initFormat=" << _initFormat
              << "config=" << _config.size() << "bytes"
              << "cmdline=" << _cmdline.size() << "bytes"
@@ -119,8 +257,8 @@ bool FastbootFlashThread::applyCustomisation(fastboot::FastbootProtocol& fb,
     std::string bootPartition = _blockDevice.toStdString() + "p1";
 
     if (!fb.mountDevice(transport, bootPartition, MOUNTPOINT, "vfat")) {
-        emit error(tr("Failed to mount boot partition: %1")
-                   .arg(QString::fromStdString(fb.lastError())));
+        errorOut = tr("Failed to mount boot partition: %1")
+                   .arg(QString::fromStdString(fb.lastError()));
         return false;
     }
 
@@ -142,17 +280,44 @@ bool FastbootFlashThread::applyCustomisation(fastboot::FastbootProtocol& fb,
             static_cast<size_t>(ba.size()));
     };
 
-    // ── config.txt: read, uncomment/append entries, write back ──
-    if (!_config.isEmpty()) {
-        auto configData = fb.readDeviceFile(transport, BOOT + "config.txt", _cancelled);
-        if (configData.empty()) {
-            emit error(tr("Failed to read config.txt: %1")
-                       .arg(QString::fromStdString(fb.lastError())));
+    // ── Read config.txt and cmdline.txt in one batch ──
+    // Each file is "oem upload-file" followed by an upload.
+    QList<QByteArray> readNames;
+    if (!_config.isEmpty())
+        readNames.append("config.txt");
+    if (!plan.cmdlineAppend.isEmpty())
+        readNames.append("cmdline.txt");
+
+    std::vector<BatchOp> readOps;
+    for (const QByteArray& name : std::as_const(readNames)) {
+        readOps.push_back(BatchOp::cmd("oem upload-file " + BOOT + name.toStdString()));
+        readOps.push_back(BatchOp::upload());
+    }
+    auto reads = fb.runBatch(transport, readOps, cancelled);
+    if (!reads.ok(readOps.size())) {
+        errorOut = tr("Failed to read %1: %2")
+                   .arg(QString::fromLatin1(readNames.at(static_cast<qsizetype>(reads.completed / 2))),
+                        QString::fromStdString(fb.lastError()));
+        return false;
+    }
+    // Never modify and write back a file that did not come through
+    for (qsizetype i = 0; i < readNames.size(); ++i) {
+        if (reads.uploads[static_cast<size_t>(i)].empty()) {
+            errorOut = tr("Failed to read %1: %2")
+                       .arg(QString::fromLatin1(readNames.at(i)), tr("file is empty"));
             return false;
         }
-        QByteArray config(reinterpret_cast<const char*>(configData.data()),
-                          static_cast<int>(configData.size()));
+    }
+    auto readFile = [&](const char* name) {
+        const auto& data = reads.uploads[static_cast<size_t>(readNames.indexOf(name))];
+        return QByteArray(reinterpret_cast<const char*>(data.data()),
+                          static_cast<int>(data.size()));
+    };
 
+    // ── config.txt: uncomment/append entries ──
+    QList<QPair<QByteArray, QByteArray>> files;
+    if (!_config.isEmpty()) {
+        QByteArray config = readFile("config.txt");
         auto items = _config.split('\n');
         items.removeAll("");
         for (const QByteArray& item : std::as_const(items)) {
@@ -164,83 +329,32 @@ bool FastbootFlashThread::applyCustomisation(fastboot::FastbootProtocol& fb,
                 config += item + "\n";
             }
         }
-
-        if (!fb.writeDeviceFile(transport, BOOT + "config.txt", toSpan(config), _cancelled)) {
-            emit error(tr("Failed to write config.txt: %1")
-                       .arg(QString::fromStdString(fb.lastError())));
-            return false;
-        }
+        files.append({"config.txt", config});
     }
 
-    // ── firstrun.sh (systemd format) ──
-    QByteArray cmdlineAppend = _cmdline;
-    if (!_firstrun.isEmpty() && _initFormat == "systemd") {
-        if (!fb.writeDeviceFile(transport, BOOT + "firstrun.sh", toSpan(_firstrun), _cancelled)) {
-            emit error(tr("Failed to write firstrun.sh: %1")
-                       .arg(QString::fromStdString(fb.lastError())));
-            return false;
-        }
-        cmdlineAppend += " systemd.run=/boot/firstrun.sh"
-                         " systemd.run_success_action=reboot"
-                         " systemd.unit=kernel-command-line.target";
-    }
+    files.append(plan.newFiles);
 
-    // ── cloud-init files ──
-    // Only write meta-data and the ds=nocloud cmdline when there is actual
-    // cloud-init content.  A stale cmdline entry (e.g. recommendedWifiCountry)
-    // alone should not trigger cloud-init file writes.
-    bool initCloud = (_initFormat == "cloudinit" || _initFormat == "cloudinit-rpi");
-    bool hasCloudContent = !_cloudinit.isEmpty() || !_cloudinitNetwork.isEmpty();
-    if (initCloud && hasCloudContent) {
-        QByteArray instanceId = "rpi-imager-" + QByteArray::number(QDateTime::currentMSecsSinceEpoch());
-        QByteArray metadata = "instance-id: " + instanceId + "\n";
-        if (!fb.writeDeviceFile(transport, BOOT + "meta-data", toSpan(metadata), _cancelled)) {
-            emit error(tr("Failed to write meta-data: %1")
-                       .arg(QString::fromStdString(fb.lastError())));
-            return false;
-        }
-
-        cmdlineAppend += " ds=nocloud;i=" + instanceId;
+    // ── cmdline.txt: append ──
+    if (!plan.cmdlineAppend.isEmpty())
+        files.append({"cmdline.txt", readFile("cmdline.txt").trimmed() + plan.cmdlineAppend});
 
-        if (!_cloudinit.isEmpty()) {
-            QByteArray userData = "#cloud-config\n" + _cloudinit;
-            if (!fb.writeDeviceFile(transport, BOOT + "user-data", toSpan(userData), _cancelled)) {
-                emit error(tr("Failed to write user-data: %1")
-                           .arg(QString::fromStdString(fb.lastError())));
-                return false;
-            }
-        }
-
-        if (!_cloudinitNetwork.isEmpty()) {
-            if (!fb.writeDeviceFile(transport, BOOT + "network-config",
-                                     toSpan(_cloudinitNetwork), _cancelled)) {
-                emit error(tr("Failed to write network-config: %1")
-                           .arg(QString::fromStdString(fb.lastError())));
-                return false;
-            }
-        }
+    // ── Write everything back in one batch ──
+    // Each file is a stage followed by "oem download-file".
+    std::vector<BatchOp> writeOps;
+    for (const auto& file : std::as_const(files)) {
+        writeOps.push_back(BatchOp::stage(toSpan(file.second)));
+        writeOps.push_back(BatchOp::cmd("oem download-file " + BOOT + file.first.toStdString()));
     }
-
-    // ── cmdline.txt: read, append, write back ──
-    if (!cmdlineAppend.isEmpty()) {
-        auto cmdlineData = fb.readDeviceFile(transport, BOOT + "cmdline.txt", _cancelled);
-        if (cmdlineData.empty()) {
-            emit error(tr("Failed to read cmdline.txt: %1")
-                       .arg(QString::fromStdString(fb.lastError())));
-            return false;
-        }
-        QByteArray cmdline = QByteArray(reinterpret_cast<const char*>(cmdlineData.data()),
-                                         static_cast<int>(cmdlineData.size())).trimmed();
-        cmdline += cmdlineAppend;
-
-        if (!fb.writeDeviceFile(transport, BOOT + "cmdline.txt", toSpan(cmdline), _cancelled)) {
-            emit error(tr("Failed to write cmdline.txt: %1")
-                       .arg(QString::fromStdString(fb.lastError())));
-            return false;
-        }
+    auto writes = fb.runBatch(transport, writeOps, cancelled);
+    if (!writes.ok(writeOps.size())) {
+        errorOut = tr("Failed to write %1: %2")
+                   .arg(QString::fromLatin1(files.at(static_cast<qsizetype>(writes.completed / 2)).first),
+                        QString::fromStdString(fb.lastError()));
+        return false;
     }
 
-    qDebug() << "FastbootFlashThread: customisation applied successfully";
+    qDebug() << "FastbootFlashThread: customisation applied successfully,"
+             << files.size() << "files";
     return true;
 }
 
@@ -505,26 +619,89 @@ void FastbootFlashThread::runImpl()
         return;
     }
 
-    // 2. Query max-download-size
+    // 2. Query max-download-size, and the board identifiers for the Connect
+    //    description field while we are at it, so that registering does not
+    //    add round trips after the flash.
     fastboot::FastbootProtocol fb;
-    auto maxDlSizeStr = fb.getVar(*transport, "max-download-size");
-    uint32_t maxDownloadSize = DEFAULT_MAX_DOWNLOAD_SIZE;
+    std::vector<std::string_view> varNames = {"max-download-size"};
+    if (!_connectApiKey.isEmpty()) {
+        varNames.push_back("product");
+        varNames.push_back("serialno");
+    }
+    auto vars = fb.getVars(*transport, varNames);
+    auto maxDlSizeStr = vars[0];
+    QString boardDescription;
+    QString serial;
+    if (!_connectApiKey.isEmpty()) {
+        if (vars[1])
+            boardDescription = QString::fromStdString(*vars[1]);
+        if (vars[2])
+            serial = QString::fromStdString(*vars[2]);
+    }
+    uint32_t maxDownloadSize = fastboot::FastbootProtocol::DEFAULT_MAX_DOWNLOAD_SIZE;
     if (maxDlSizeStr) {
-        try {
-            std::string val = *maxDlSizeStr;
-            if (val.starts_with("0x") || val.starts_with("0X"))
-                maxDownloadSize = static_cast<uint32_t>(std::stoul(val, nullptr, 16));
-            else
-                maxDownloadSize = static_cast<uint32_t>(std::stoul(val));
-        } catch (...) {
+        if (auto size = fastboot::FastbootProtocol::parseSize(*maxDlSizeStr)) {
+            maxDownloadSize = *size;
+        } else {
             qDebug() << "FastbootFlashThread: could not parse max-download-size:"
                      << QString::fromStdString(*maxDlSizeStr)
                      << "using default" << maxDownloadSize;
         }
     }
     qDebug() << "FastbootFlashThread: max-download-size =" << maxDownloadSize;
+
+    // Every device is sent the same segments, so they are sized for the
+    // device that accepts the least
+    if (!_fanOutDevices.isEmpty()) {
+        emit preparationStatusUpdate(tr("Connecting to additional fastboot devices..."));
+        openFanOutTargets(!_connectApiKey.isEmpty());
+        for (const auto& target : _fanOutTargets)
+            maxDownloadSize = std::min(maxDownloadSize, target->maxDownloadSize());
+    }
     emit eventFastbootDeviceOpen(static_cast<quint32>(deviceOpenTimer.elapsed()), true,
-                                 QStringLiteral("max-download-size=%1").arg(maxDownloadSize));
+                                 QStringLiteral("max-download-size=%1; devices=%2")
+                                     .arg(maxDownloadSize).arg(_fanOutTargets.size() + 1));
+
+    // Register device identities with Raspberry Pi Connect (optional,
+    // non-fatal) while the image is written.  The devices must sign the
+    // requests while in fastboot mode, which only takes a moment, so they
+    // do it now before the flash; the requests then go to the API in the
+    // background and are collected in step 10.
+    std::vector<std::pair<QString, std::future<ConnectDeviceRegistrar::Result>>> connectRegistrations;
+    if (!_connectApiKey.isEmpty()) {
+        emit preparationStatusUpdate(tr("Registering device identity with Raspberry Pi Connect..."));
+        const ConnectDeviceRegistrar registrar(_connectApiKey, _connectDescriptionPrefix);
+        auto startRegistration = [&](const QString& fastbootId, fastboot::FastbootProtocol& deviceFb,
+                                     rpiboot::IUsbTransport& deviceTransport, const QString& description,
+                                     const QString& deviceSerial) {
+            auto request = registrar.signRegistration(deviceFb, deviceTransport, description, deviceSerial);
+            if (!request.ok) {
+                qWarning() << "Connect: registration failed for" << fastbootId << ":" << request.errorMessage;
+                return;
+            }
+            connectRegistrations.emplace_back(fastbootId, std::async(std::launch::async, [registrar, request] {
+                return registrar.submitRegistration(request);
+            }));
+        };
+        startRegistration(_fastbootId, fb, *transport, boardDescription, serial);
+        for (auto& target : _fanOutTargets)
+            startRegistration(target->fastbootId(), target->protocol(), target->transport(),
+                              target->boardDescription(), target->serial());
+    }
+
+    // Additional devices still running when we return failed along with
+    // the primary device (or with the hash check)
+    auto reportFanOutFailures = qScopeGuard([this] {
+        for (auto& target : _fanOutTargets) {
+            target->cancel();
+            target->finishSegments();
+            if (!target->hasFailed())
+                target->fail(_cancelled.load() ? tr("Cancelled") : tr("Flashing was aborted."));
+            emit fanOutTargetFinished(target->fastbootId(), false, target->errorString());
+        }
+        std::lock_guard<std::mutex> lock(_fanOutMutex);
+        _fanOutTargets.clear();
+    });
 
     // 3. Allocate ring buffers
     size_t inputSlotSize, writeSlotSize, inputSlots, writeSlots;
@@ -537,26 +714,29 @@ void FastbootFlashThread::runImpl()
     _compressedRing = std::make_unique<RingBuffer>(inputSlots, inputSlotSize);
     _decompressedRing = std::make_unique<RingBuffer>(writeSlots, writeSlotSize);
 
-    // 4. Initialize incremental hash if verification is needed
-    if (!_expectedHash.isEmpty())
-        _imageHash = std::make_unique<AcceleratedCryptographicHash>(QCryptographicHash::Sha256);
-
-    // 5. Start pipeline threads
-    emit writing();
-    emit preparationStatusUpdate(tr("Downloading and flashing OS image..."));
-
-    std::thread downloadThread([this]() { downloadProducer(); });
-    std::thread decompressThread([this]() { decompressConsumerProducer(); });
-
-    // 6. Flash consumer loop — sparse-encode and stream to device
+    // Sparse encoder, set up before the pipeline starts.
     //
     // The sparse encoder converts the raw decompressed image into Android
     // sparse image segments.  When a bmap is available, unmapped blocks
-    // become DONT_CARE (skipped entirely).  Otherwise zero-filled regions
-    // are FILL(0) to guarantee correctness on non-erased storage.
+    // become DONT_CARE (skipped entirely).  Without one, the free space
+    // of the image's FAT and ext file systems is found as it streams past
+    // and skipped the same way.  Anything else that is zero-filled is
+    // FILL(0) to guarantee correctness on non-erased storage.
     fastboot::SparseEncoder sparse(maxDownloadSize, _extractLen);
-
-    // Fetch and apply optional block map
+    fastboot::SegmentSizer segmentSizer(maxDownloadSize);
+    sparse.setSegmentSizeLimit(segmentSizer.nextSize());
+
+    // Classify each ring slot's blocks on a few cores; merging runs into
+    // chunks stays sequential.  The decompressor and USB writer need the rest.
+    const unsigned classifyThreads = static_cast<unsigned>(std::clamp(ContainerLimits::cpuCount() / 2, 1, 4));
+    sparse.setClassifyThreads(classifyThreads);
+    qDebug() << "FastbootFlashThread: sparse block classifier" << fastboot::blockClassifierName()
+             << "on" << classifyThreads << "thread(s)";
+
+    // Fetch and apply optional block map.  This happens before the
+    // pipeline starts, as it decides which cached artefact can be used.
+    bool haveBlockMap = false;
+    std::string blockMapId = "none";
     if (!_bmapUrl.isEmpty()) {
         emit preparationStatusUpdate(tr("Fetching block map..."));
         qDebug() << "FastbootFlashThread: fetching bmap from" << _bmapUrl;
@@ -597,42 +777,114 @@ void FastbootFlashThread::runImpl()
                          << (100 * blockMap->mappedBlockCount() / std::max<uint64_t>(blockMap->blockCount(), 1))
                          << "%)";
                 sparse.setBlockMap(std::move(blockMap));
+                haveBlockMap = true;
+                blockMapId = QCryptographicHash::hash(bmapData, QCryptographicHash::Sha256).toHex().toStdString();
             } else {
                 qWarning() << "FastbootFlashThread: bmap parse failed:" << QString::fromStdString(parseError);
             }
         }
     }
+
+    // The encoder owns the map; the mapper adds to it ahead of each feed().
+    // It is not given _extractLen, as a short one would leave the end of
+    // the image unmapped.
+    std::unique_ptr<StreamingBlockMapper> usedBlocks;
+    if (!haveBlockMap && QSettings().value("usedblocks/enabled", true).toBool()) {
+        auto blockMap = std::make_unique<fastboot::BlockMap>();
+        usedBlocks = std::make_unique<StreamingBlockMapper>(blockMap.get(), 0);
+        sparse.setBlockMap(std::move(blockMap));
+        blockMapId = "usedblocks";
+        qDebug() << "FastbootFlashThread: no bmap, finding used blocks while flashing";
+    }
+
+    // The encoded segments of an image already flashed with the same
+    // segment size and block map are replayed from disk, skipping the
+    // download, decompression and encoding.  They are only recorded and
+    // used for images with a known hash, which is checked when recording.
+    std::optional<fastboot::SparseArtefactCache> artefactCache;
+    std::optional<std::vector<fastboot::SparseArtefactCache::Segment>> cachedSegments;
+    std::unique_ptr<fastboot::SparseArtefactCache::Writer> artefactRecorder;
+    std::string artefactKey;
+    if (!_expectedHash.isEmpty() && QSettings().value("fastboot/artefactcache", true).toBool()) {
+        const QString root = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                             + QStringLiteral("/sparse-artefacts");
+        artefactCache.emplace(std::filesystem::path(root.toStdString()));
+        artefactKey = fastboot::SparseArtefactCache::key(_expectedHash.toStdString(),
+                                                         maxDownloadSize, blockMapId);
+        cachedSegments = artefactCache->find(artefactKey);
+        if (cachedSegments) {
+            qDebug() << "FastbootFlashThread: replaying" << cachedSegments->size()
+                     << "cached sparse segments for" << QString::fromStdString(artefactKey);
+        } else {
+            artefactRecorder = artefactCache->record(artefactKey);
+        }
+    }
+    const bool replaying = cachedSegments.has_value();
+
+    // 4. Initialize incremental hash if verification is needed.  A replayed
+    //    artefact was verified when it was recorded.
+    if (!_expectedHash.isEmpty() && !replaying)
+        _imageHash = std::make_unique<AcceleratedCryptographicHash>(QCryptographicHash::Sha256);
+
+    // 5. Start pipeline threads
+    emit writing();
+    emit preparationStatusUpdate(replaying ? tr("Flashing cached OS image...")
+                                           : tr("Downloading and flashing OS image..."));
+
+    QElapsedTimer pipelineTimer;
+    pipelineTimer.start();
+    std::thread downloadThread;
+    std::thread decompressThread;
+    if (!replaying) {
+        downloadThread = std::thread([this]() { downloadProducer(); });
+        decompressThread = std::thread([this]() { decompressConsumerProducer(); });
+    }
+
+    // 6. Flash consumer loop — stream the encoded segments to the device
     quint64 totalFed = 0;
     bool flashError = false;
+    QString sendError;  // Set on the sender thread before it sets sendFailed
+    QString replayError;
 
-    // Helper: send one sparse segment via download + flash
+    // Guards the segment hand-over and segmentSizer below
+    std::mutex sendMutex;
+
+    // Helper: send one sparse segment via download + flash.  Runs on the
+    // sender thread below; `fedBytes` is the input consumed up to the end
+    // of the segment, for progress reporting.
     uint32_t segmentIndex = 0;
-    auto sendSegment = [&](std::span<const uint8_t> seg) -> bool {
-        rpiboot::ProgressCallback progressCb = [this, totalFed](
-            uint64_t current, uint64_t /*total*/, const std::string&) {
-            emit writeProgress(totalFed,
-                               _extractLen > 0 ? _extractLen : totalFed);
+    auto sendSegment = [&](std::span<const uint8_t> seg, quint64 fedBytes) -> bool {
+        rpiboot::ProgressCallback progressCb = [this, fedBytes](
+            uint64_t /*current*/, uint64_t /*total*/, const std::string&) {
+            emit writeProgress(fedBytes,
+                               _extractLen > 0 ? _extractLen : fedBytes);
         };
 
         qDebug() << "FastbootFlashThread: downloading segment" << segmentIndex
                  << "(" << seg.size() << "bytes)";
 
+        QElapsedTimer transferTimer;
+        transferTimer.start();
         if (!fb.download(*transport, seg, progressCb, _cancelled)) {
             qDebug() << "FastbootFlashThread: download FAILED for segment"
                      << segmentIndex << ":" << QString::fromStdString(fb.lastError());
-            if (!_cancelled.load())
-                emit error(tr("Fastboot download failed: %1")
-                           .arg(QString::fromStdString(fb.lastError())));
+            sendError = tr("Fastboot download failed: %1")
+                        .arg(QString::fromStdString(fb.lastError()));
             return false;
         }
 
+        const auto transferMs = static_cast<uint32_t>(transferTimer.elapsed());
+        {
+            std::lock_guard<std::mutex> lock(sendMutex);
+            segmentSizer.recordTransfer(seg.size(), transferMs);
+        }
+
         qDebug() << "FastbootFlashThread: flashing segment" << segmentIndex;
         if (!fb.flash(*transport, _blockDevice.toStdString(), 120000)) {
             qDebug() << "FastbootFlashThread: flash FAILED for segment"
                      << segmentIndex << ":" << QString::fromStdString(fb.lastError());
-            if (!_cancelled.load())
-                emit error(tr("Fastboot flash failed: %1")
-                           .arg(QString::fromStdString(fb.lastError())));
+            sendError = tr("Fastboot flash failed: %1")
+                        .arg(QString::fromStdString(fb.lastError()));
             return false;
         }
 
@@ -641,7 +893,141 @@ void FastbootFlashThread::runImpl()
         return true;
     };
 
-    while (!_cancelled.load()) {
+    // Segments are sent on their own thread so that encoding segment N+1
+    // overlaps the USB transfer and on-device flash of segment N.  One
+    // segment is in flight and at most one more waits in `queued`; the
+    // encoder blocks when it gets further ahead than that.  Fan-out targets
+    // are handed the same segment after the primary device.  Buffers are
+    // shared rather than copied and cycle back into the encoder.
+    struct QueuedSegment {
+        FastbootFanOutTarget::Segment data;
+        quint64 fedBytes = 0;
+    };
+    auto segmentPool = std::make_shared<SegmentPool>();
+    for (auto& target : _fanOutTargets) {
+        target->start([this, id = target->fastbootId()](uint64_t fedBytes) {
+            emit fanOutTargetProgress(id, fedBytes, _extractLen > 0 ? _extractLen : fedBytes);
+        });
+    }
+    std::condition_variable sendCv;
+    QueuedSegment queued;
+    bool segmentQueued = false;
+    bool encodingDone = false;
+    std::atomic<bool> sendFailed{false};
+
+    // Stalls on the segment hand-over, counted like RingBuffer's: the
+    // encoder waiting for the sender to take a segment, and the sender
+    // waiting for one to be encoded.  Guarded by sendMutex.
+    uint64_t encodeStalls = 0, encodeWaitMs = 0;
+    uint64_t sendStalls = 0, sendWaitMs = 0;
+
+    std::thread sendThread([&]() {
+        QueuedSegment current;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(sendMutex);
+                // _cancelled is set elsewhere without notifying, so poll
+                if (!segmentQueued && !encodingDone && !_cancelled.load()) {
+                    QElapsedTimer waitTimer;
+                    waitTimer.start();
+                    while (!segmentQueued && !encodingDone && !_cancelled.load())
+                        sendCv.wait_for(lock, std::chrono::milliseconds(100));
+                    ++sendStalls;
+                    sendWaitMs += static_cast<uint64_t>(waitTimer.elapsed());
+                }
+                if (!segmentQueued || _cancelled.load())
+                    return;
+                std::swap(current, queued);
+                segmentQueued = false;
+            }
+            sendCv.notify_all();
+
+            if (!sendSegment(current.data.bytes(), current.fedBytes)) {
+                sendFailed = true;
+                sendCv.notify_all();
+                return;
+            }
+            current.data = nullptr;
+            emit writeProgress(current.fedBytes,
+                               _extractLen > 0 ? _extractLen : current.fedBytes);
+            emit downloadProgress(_dlnow.load(), _dltotal.load());
+        }
+    });
+
+    // Hand a segment to the senders.  Returns false once no device is left
+    // to send to: the primary device's failure only stops it, not the
+    // fan-out targets.
+    auto dispatchSegment = [&](const FastbootFanOutTarget::Segment& segment, quint64 fedBytes) -> bool {
+        bool primaryAlive;
+        {
+            std::unique_lock<std::mutex> lock(sendMutex);
+            if (segmentQueued && !sendFailed.load() && !_cancelled.load()) {
+                QElapsedTimer waitTimer;
+                waitTimer.start();
+                while (segmentQueued && !sendFailed.load() && !_cancelled.load())
+                    sendCv.wait_for(lock, std::chrono::milliseconds(100));
+                ++encodeStalls;
+                encodeWaitMs += static_cast<uint64_t>(waitTimer.elapsed());
+            }
+            if (_cancelled.load())
+                return false;
+            primaryAlive = !sendFailed.load();
+            if (primaryAlive) {
+                queued.data = segment;
+                queued.fedBytes = fedBytes;
+                segmentQueued = true;
+            }
+            sparse.setSegmentSizeLimit(segmentSizer.nextSize());
+        }
+        if (primaryAlive)
+            sendCv.notify_all();
+        // A target that falls behind or fails is dropped from here on
+        bool anyAlive = primaryAlive;
+        for (auto& target : _fanOutTargets) {
+            if (!target->hasFailed() && target->queueSegment(segment, fedBytes))
+                anyAlive = true;
+        }
+        return anyAlive;
+    };
+
+    // Hand the segment in `encoded` to the senders, and to the artefact
+    // recording; `encoded` receives a spare buffer in exchange.
+    auto queueSegment = [&](std::unique_ptr<std::vector<uint8_t>>& encoded) -> bool {
+        auto buffer = segmentPool->share(std::move(encoded));
+        encoded = segmentPool->take();
+        if (artefactRecorder && !artefactRecorder->add(buffer, *buffer, totalFed)) {
+            qDebug() << "FastbootFlashThread: not caching sparse segments, the disk is not keeping up";
+            artefactRecorder.reset();
+        }
+        return dispatchSegment(FastbootFanOutTarget::Segment(std::move(buffer)), totalFed);
+    };
+
+    // Replay a cached artefact in place of the pipeline
+    if (replaying) {
+        for (const auto& cached : *cachedSegments) {
+            if (_cancelled.load())
+                break;
+            auto segment = loadCachedSegment(cached);
+            if (!segment) {
+                replayError = tr("Cannot read cached image segment: %1")
+                              .arg(QString::fromStdString(cached.path.string()));
+                std::error_code ec;
+                std::filesystem::remove_all(artefactCache->root() / artefactKey, ec);
+                flashError = true;
+                break;
+            }
+            totalFed = cached.fedBytes;
+            if (!dispatchSegment(segment, totalFed)) {
+                flashError = true;
+                break;
+            }
+        }
+    }
+
+    auto encoded = segmentPool->take();
+    uint32_t encodedIndex = 0;
+
+    while (!replaying && !_cancelled.load()) {
         auto *slot = _decompressedRing->acquireReadSlot(100);
         if (!slot) {
             if (_decompressedRing->isCancelled())
@@ -657,7 +1043,10 @@ void FastbootFlashThread::runImpl()
 
         totalFed += slot->size;
 
-        // Feed data to the sparse encoder, draining completed segments
+        if (usedBlocks)
+            usedBlocks->addData(slot->data, slot->size);
+
+        // Feed data to the sparse encoder, queueing completed segments
         // as they appear.  feed() returns fewer bytes than offered when
         // a segment is ready, so we loop until all data is consumed.
         const auto* feedPtr = reinterpret_cast<const uint8_t*>(slot->data);
@@ -668,22 +1057,17 @@ void FastbootFlashThread::runImpl()
             feedRemaining -= consumed;
 
             fastboot::SparseEncoder::SegmentStats segStats;
-            auto seg = sparse.takeSegment(&segStats);
-            if (!seg.empty()) {
-                qDebug() << "FastbootFlashThread: segment" << segmentIndex
+            if (sparse.takeSegment(*encoded, &segStats)) {
+                qDebug() << "FastbootFlashThread: segment" << encodedIndex
                          << "blocks=" << segStats.blocks
                          << "(raw=" << segStats.rawBlocks
                          << "fill=" << segStats.fillBlocks
                          << "skip=" << segStats.dontCareBlocks << ")"
                          << "chunks=" << segStats.chunks
                          << "wire=" << segStats.wireBytes << "bytes";
-                if (!sendSegment(seg)) {
+                ++encodedIndex;
+                if (!queueSegment(encoded))
                     flashError = true;
-                } else {
-                    emit writeProgress(totalFed,
-                                       _extractLen > 0 ? _extractLen : totalFed);
-                    emit downloadProgress(_dlnow.load(), _dltotal.load());
-                }
             }
         }
         _decompressedRing->releaseReadSlot(slot);
@@ -692,26 +1076,39 @@ void FastbootFlashThread::runImpl()
             break;
     }
 
-    // Finish the sparse stream and drain all remaining segments.
+    // Finish the sparse stream and queue all remaining segments.
     // finish() may need multiple calls when the trailing partial block
     // triggers a segment split.
-    while (!flashError && !_cancelled.load()) {
+    while (!replaying && !flashError && !_cancelled.load()) {
         sparse.finish();
         fastboot::SparseEncoder::SegmentStats segStats;
-        auto seg = sparse.takeSegment(&segStats);
-        if (seg.empty())
+        if (!sparse.takeSegment(*encoded, &segStats))
             break;
-        qDebug() << "FastbootFlashThread: final segment" << segmentIndex
+        qDebug() << "FastbootFlashThread: final segment" << encodedIndex
                  << "blocks=" << segStats.blocks
                  << "(raw=" << segStats.rawBlocks
                  << "fill=" << segStats.fillBlocks
                  << "skip=" << segStats.dontCareBlocks << ")"
                  << "wire=" << segStats.wireBytes << "bytes";
-        if (!sendSegment(seg))
+        ++encodedIndex;
+        if (!queueSegment(encoded))
             flashError = true;
     }
 
-    if (!flashError && !_cancelled.load()) {
+    // Let the senders drain their queues.  Customisation files are built
+    // while the last segment is still flashing, before waiting for it.
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        encodingDone = true;
+    }
+    sendCv.notify_all();
+    CustomisationPlan customisation;
+    if (!flashError && !_cancelled.load())
+        customisation = prepareCustomisation();
+    sendThread.join();
+    const bool primaryFailed = sendFailed.load();
+
+    if (!replaying && !flashError && !_cancelled.load()) {
         qDebug() << "Sparse stats: raw=" << sparse.rawBlockCount()
                  << "fill=" << sparse.fillBlockCount()
                  << "dontcare=" << sparse.dontCareBlockCount()
@@ -720,97 +1117,171 @@ void FastbootFlashThread::runImpl()
 
     qDebug() << "FastbootFlashThread: flash loop ended —"
              << "flashError=" << flashError
+             << "primaryFailed=" << primaryFailed
              << "cancelled=" << _cancelled.load()
              << "totalFed=" << totalFed
              << "segments=" << segmentIndex;
 
-    // 7. Wait for pipeline threads to finish
-    if (_cancelled.load()) {
+    // 7. Wait for pipeline threads to finish.  If every device failed the
+    //    encoder stopped reading, so the producers have to be stopped too.
+    if (_cancelled.load() || flashError) {
         _compressedRing->cancel();
         _decompressedRing->cancel();
     }
 
-    downloadThread.join();
-    decompressThread.join();
+    if (downloadThread.joinable())
+        downloadThread.join();
+    if (decompressThread.joinable())
+        decompressThread.join();
+
+    // Per-stage stall accounting, as DownloadExtractThread reports for its
+    // write ring buffer: each queue's producer and consumer waits, and the
+    // stage that waited least as the bottleneck.
+    {
+        uint64_t dlStalls, decInStalls, dlWaitMs, decInWaitMs;
+        uint64_t decOutStalls, encInStalls, decOutWaitMs, encInWaitMs;
+        _compressedRing->getStarvationStats(dlStalls, decInStalls, dlWaitMs, decInWaitMs);
+        _decompressedRing->getStarvationStats(decOutStalls, encInStalls, decOutWaitMs, encInWaitMs);
+
+        const StageWaits stages[] = {
+            {"download", 0, dlWaitMs},
+            {"decompress", decInWaitMs, decOutWaitMs},
+            {"encode", encInWaitMs, encodeWaitMs},
+            {"send", sendWaitMs, 0},
+        };
+        QString metadata = QStringLiteral(
+            "download_to_decompress: producer_stalls: %1 (%2 ms); consumer_stalls: %3 (%4 ms); "
+            "decompress_to_encode: producer_stalls: %5 (%6 ms); consumer_stalls: %7 (%8 ms); "
+            "encode_to_send: producer_stalls: %9 (%10 ms); consumer_stalls: %11 (%12 ms); "
+            "bottleneck: %13")
+            .arg(dlStalls).arg(dlWaitMs).arg(decInStalls).arg(decInWaitMs)
+            .arg(decOutStalls).arg(decOutWaitMs).arg(encInStalls).arg(encInWaitMs)
+            .arg(encodeStalls).arg(encodeWaitMs).arg(sendStalls).arg(sendWaitMs)
+            .arg(QLatin1String(bottleneckStage(stages).name));
+        qDebug() << "FastbootFlashThread: pipeline stats:" << metadata;
+        emit eventFastbootPipelineStats(static_cast<quint32>(pipelineTimer.elapsed()),
+                                        !flashError && !primaryFailed && !_cancelled.load(), metadata);
+    }
 
-    // Check for pipeline errors
-    if (!_downloadError.isEmpty() && !_cancelled.load()) {
-        emit error(tr("Download failed: %1").arg(_downloadError));
+    if (_cancelled.load()) {
+        emit error(tr("Cancelled"));
         return;
     }
-    if (!_decompressError.isEmpty() && !_cancelled.load()) {
-        emit error(tr("Decompression failed: %1").arg(_decompressError));
+
+    // Every device failed; the primary device's error is the one to show.
+    // Checked before the pipeline errors, which stopping the producers
+    // above sets as a side effect.
+    if (flashError) {
+        if (!replayError.isEmpty())
+            emit error(replayError);
+        else
+            emit error(primaryFailed ? sendError : tr("Fastboot flash failed on every device."));
         return;
     }
 
-    if (_cancelled.load()) {
-        emit error(tr("Cancelled"));
+    // Check for pipeline errors
+    if (!_downloadError.isEmpty()) {
+        emit error(tr("Download failed: %1").arg(_downloadError));
         return;
     }
-
-    // A flash error was already reported via error() from sendSegment().
-    // Do not fall through to hash verification / customisation / success().
-    if (flashError)
+    if (!_decompressError.isEmpty()) {
+        emit error(tr("Decompression failed: %1").arg(_decompressError));
         return;
+    }
+
+    // Wait for the additional devices to flash what they have queued
+    for (auto& target : _fanOutTargets)
+        target->finishSegments();
 
     // 8. Verify hash
     if (_imageHash) {
         QByteArray actualHash = _imageHash->result().toHex();
         if (actualHash != _expectedHash) {
-            emit error(tr("Image hash mismatch. Expected: %1 Got: %2")
-                       .arg(QString::fromLatin1(_expectedHash),
-                            QString::fromLatin1(actualHash)));
+            const QString msg = tr("Image hash mismatch. Expected: %1 Got: %2")
+                                .arg(QString::fromLatin1(_expectedHash),
+                                     QString::fromLatin1(actualHash));
+            for (auto& target : _fanOutTargets)
+                target->fail(msg);
+            emit error(msg);
             return;
         }
     }
 
-    // 9. Apply OS customisation via fastboot file transfer
-    qDebug() << "FastbootFlashThread: applying OS customisation...";
-    if (!applyCustomisation(fb, *transport)) {
-        qDebug() << "FastbootFlashThread: customisation FAILED";
-        return;
+    // The segments just sent are now known to be of the right image
+    if (artefactRecorder) {
+        if (artefactRecorder->commit())
+            qDebug() << "FastbootFlashThread: cached sparse segments as" << QString::fromStdString(artefactKey);
+        artefactRecorder.reset();
+        artefactCache->prune(SPARSE_ARTEFACTS_KEPT);
     }
-    qDebug() << "FastbootFlashThread: customisation OK";
 
-    // 10. Register device identity with Raspberry Pi Connect (optional,
-    //     non-fatal).  Must happen while the device is still in fastboot
-    //     mode so we can query its public key and ask it to sign the
-    //     request via the firmware crypto engine.
-    if (!_connectApiKey.isEmpty()) {
-        emit preparationStatusUpdate(tr("Registering device identity with Raspberry Pi Connect..."));
+    // 9. Apply OS customisation via fastboot file transfer to each device
+    //    that was flashed
+    auto finishDevice = [&](fastboot::FastbootProtocol& deviceFb, rpiboot::IUsbTransport& deviceTransport,
+                            std::atomic<bool>& cancelled, QString& errorOut) -> bool {
+        if (customisation.active)
+            emit preparationStatusUpdate(tr("Applying OS customisation..."));
+        if (!applyCustomisation(deviceFb, deviceTransport, customisation, cancelled, errorOut)) {
+            qDebug() << "FastbootFlashThread: customisation FAILED:" << errorOut;
+            return false;
+        }
+
+        return true;
+    };
 
-        // Gather board identifiers for the Connect description field.
-        QString boardDescription;
-        if (auto boardVar = fb.getVar(*transport, "product")) {
-            boardDescription = QString::fromStdString(*boardVar);
+    // 11. Reboot into the flashed OS
+    auto reboot = [](fastboot::FastbootProtocol& deviceFb, rpiboot::IUsbTransport& deviceTransport) {
+        auto resp = deviceFb.sendCommand(deviceTransport, "reboot", 10000);
+        if (resp.type != fastboot::Response::Okay) {
+            qDebug() << "FastbootFlashThread: reboot command returned:"
+                     << QString::fromStdString(resp.message);
+            // Non-fatal — flash succeeded even if reboot fails
         }
-        QString serial;
-        if (auto serialVar = fb.getVar(*transport, "serialno")) {
-            serial = QString::fromStdString(*serialVar);
+    };
+
+    QString primaryError = sendError;
+    qDebug() << "FastbootFlashThread: applying OS customisation...";
+    const bool primaryOk = !primaryFailed &&
+        finishDevice(fb, *transport, _cancelled, primaryError);
+
+    for (auto& target : _fanOutTargets) {
+        QString targetError;
+        if (!target->hasFailed()) {
+            if (finishDevice(target->protocol(), target->transport(), target->cancelledFlag(), targetError))
+                reboot(target->protocol(), target->transport());
+            else
+                target->fail(targetError);
         }
+        const bool ok = !target->hasFailed();
+        qDebug() << "Additional fastboot target" << target->fastbootId()
+                 << (ok ? "succeeded" : "failed:") << target->errorString();
+        emit fanOutTargetFinished(target->fastbootId(), ok, target->errorString());
+    }
+    {
+        std::lock_guard<std::mutex> lock(_fanOutMutex);
+        _fanOutTargets.clear();
+    }
 
-        ConnectDeviceRegistrar registrar(_connectApiKey, _connectDescriptionPrefix);
-        auto result = registrar.registerDevice(fb, *transport,
-                                                boardDescription, serial);
+    // 10. Collect the Connect registrations sent during the flash
+    for (auto& [fastbootId, registration] : connectRegistrations) {
+        const auto result = registration.get();
         if (result.ok) {
-            qDebug() << "Connect: device identity registered, id="
+            qDebug() << "Connect: device identity registered for" << fastbootId << ", id="
                      << result.deviceId;
         } else {
-            qWarning() << "Connect: registration failed:"
+            qWarning() << "Connect: registration failed for" << fastbootId << ":"
                        << result.errorMessage;
         }
     }
 
-    // 11. Finalize
-    emit finalizing();
-
-    auto resp = fb.sendCommand(*transport, "reboot", 10000);
-    if (resp.type != fastboot::Response::Okay) {
-        qDebug() << "FastbootFlashThread: reboot command returned:"
-                 << QString::fromStdString(resp.message);
-        // Non-fatal — flash succeeded even if reboot fails
+    if (!primaryOk) {
+        emit error(primaryError);
+        return;
     }
 
+    emit finalizing();
+    reboot(fb, *transport);
+
     qDebug() << "FastbootFlashThread: flash complete, total" << totalFed << "bytes";
     emit success();
 }
@@ -8,6 +8,10 @@
  *   Thread 1 (download):   curl → _compressedRing
  *   Thread 2 (decompress): _compressedRing → libarchive → _decompressedRing
  *   Main thread (flash):   _decompressedRing → fastboot download+flash → USB
+ *
+ * Additional devices (addFanOutTarget()) share the download, decompression
+ * and sparse encoding; each one sends the encoded segments on its own
+ * FastbootFanOutTarget thread.
  */
 
 #ifndef FASTBOOTFLASHTHREAD_H
@@ -16,10 +20,16 @@
 #include <QThread>
 #include <QString>
 #include <QUrl>
+#include <QByteArray>
+#include <QList>
+#include <QPair>
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
 class RingBuffer;
+class FastbootFanOutTarget;
 class AcceleratedCryptographicHash;
 namespace fastboot { class FastbootProtocol; }
 namespace rpiboot { class IUsbTransport; }
@@ -59,6 +69,11 @@ public:
     void setConnectRegistration(const QString &apiKey,
                                  const QString &descriptionPrefix);
 
+    // Flash the same image to another fastboot device ("bus:addr") at the
+    // same time.  Its failures are reported through fanOutTargetFinished()
+    // and do not stop the other devices.
+    void addFanOutTarget(const QString &fastbootId, const QString &blockDevice);
+
 signals:
     void writing();   // Emitted when download+flash pipeline starts
     void success();
@@ -68,6 +83,9 @@ signals:
     void downloadProgress(quint64 dlnow, quint64 dltotal);
     void writeProgress(quint64 now, quint64 total);
     void eventFastbootDeviceOpen(quint32 durationMs, bool success, QString metadata);
+    void eventFastbootPipelineStats(quint32 durationMs, bool success, QString metadata);
+    void fanOutTargetProgress(QString fastbootId, quint64 now, quint64 total);
+    void fanOutTargetFinished(QString fastbootId, bool success, QString msg);
 
 protected:
     void run() override;
@@ -76,8 +94,21 @@ private:
     void runImpl();
     void downloadProducer();
     void decompressConsumerProducer();
+
+    // Customisation files worked out on the host.  Built while the last
+    // segment is still flashing, so only device I/O is left afterwards.
+    struct CustomisationPlan {
+        bool active = false;
+        QList<QPair<QByteArray, QByteArray>> newFiles;  // boot partition name, contents
+        QByteArray cmdlineAppend;
+    };
+    CustomisationPlan prepareCustomisation() const;
     bool applyCustomisation(class fastboot::FastbootProtocol& fb,
-                             class rpiboot::IUsbTransport& transport);
+                             class rpiboot::IUsbTransport& transport,
+                             const CustomisationPlan& plan,
+                             std::atomic<bool>& cancelled,
+                             QString& errorOut);
+    void openFanOutTargets(bool queryIdentity);
 
     QString _fastbootId;
     QString _blockDevice;
@@ -114,6 +145,12 @@ private:
     // Raspberry Pi Connect Device Identity registration (optional)
     QString _connectApiKey;
     QString _connectDescriptionPrefix;
+
+    // Additional devices: requested (id, block device), then opened.
+    // _fanOutMutex guards _fanOutTargets against cancel().
+    QList<QPair<QString, QString>> _fanOutDevices;
+    std::vector<std::unique_ptr<FastbootFanOutTarget>> _fanOutTargets;
+    std::mutex _fanOutMutex;
 };
 
 #endif // FASTBOOTFLASHTHREAD_H
@@ -696,6 +696,45 @@ TEST_CASE("DeviceWrapperFatPartition comprehensive tests", "[fat][!mayfail][.des
         std::cout << "  Created and cleaned up " << testFiles.size() << " test files" << std::endl;
     }
     
+    SECTION("Write several files at once") {
+        QMap<QString, QByteArray> files = {
+            {"batch1.txt", QByteArray(100, 'A')},
+            {"batch_long_name_2.dat", QByteArray(20000, 'B')},
+            {"batch3.bin", QByteArray()},
+        };
+        fat->writeFiles(files);
+        for (auto it = files.cbegin(); it != files.cend(); ++it) {
+            REQUIRE(fat->fileExists(it.key()));
+            REQUIRE(fat->readFile(it.key()) == it.value());
+        }
+
+        // Rewriting shrinks one file and grows another
+        files["batch1.txt"] = QByteArray(9000, 'C');
+        files["batch_long_name_2.dat"] = QByteArray(10, 'D');
+        fat->writeFiles(files);
+        for (auto it = files.cbegin(); it != files.cend(); ++it) {
+            REQUIRE(fat->readFile(it.key()) == it.value());
+        }
+
+        for (auto it = files.cbegin(); it != files.cend(); ++it) {
+            REQUIRE(fat->deleteFile(it.key()));
+        }
+    }
+    
+    SECTION("Large files read back before and after sync") {
+        // Long cluster runs are read around the block cache, which must
+        // still supply what has been written but not synced
+        QByteArray data(1024 * 1024 + 123, 0);
+        for (qsizetype i = 0; i < data.size(); i++)
+            data[i] = static_cast<char>(i * 7);
+        fat->writeFile("large_read.bin", data);
+        REQUIRE(fat->readFile("large_read.bin") == data);
+
+        fat->deviceWrapper()->sync();
+        REQUIRE(fat->readFile("large_read.bin") == data);
+        REQUIRE(fat->deleteFile("large_read.bin"));
+    }
+    
     SECTION("Test file size limits") {
         std::cout << "Testing various file sizes..." << std::endl;
         
@@ -6,6 +6,7 @@
 #ifndef FILE_OPERATIONS_H_
 #define FILE_OPERATIONS_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <memory>
@@ -14,6 +15,9 @@
 #include <chrono>
 #include <mutex>
 #include <vector>
+#include <utility>
+
+#include "latencyhistogram.h"
 
 namespace rpi_imager {
 
@@ -56,7 +60,8 @@ enum class WriteErrorClass {
 };
 
 // Thread-safe write latency statistics for async I/O
-// Tracks per-write latencies and wall-clock time from first submit to last complete.
+// Tracks per-write latencies (aggregates and a LatencyHistogram) and wall-clock
+// time from first submit to last complete.
 // All members are thread-safe and can be updated from async completion callbacks.
 class WriteLatencyStats {
  public:
@@ -87,6 +92,7 @@ class WriteLatencyStats {
     
     sum_us_.fetch_add(latency_us);
     count_.fetch_add(1);
+    histogram_.Record(latency_us);
     
     // Update last completion time
     auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
@@ -101,8 +107,11 @@ class WriteLatencyStats {
     count_ = 0;
     first_submit_ns_ = 0;
     last_complete_ns_ = 0;
+    histogram_.Reset();
   }
   
+  const LatencyHistogram& histogram() const { return histogram_; }
+  
   void getStats(uint32_t& wallClockMs, uint32_t& writeCount,
                 uint32_t& minLatencyUs, uint32_t& maxLatencyUs, 
                 uint32_t& avgLatencyUs) const {
@@ -133,6 +142,7 @@ class WriteLatencyStats {
   std::atomic<uint32_t> count_{0};
   std::atomic<int64_t> first_submit_ns_{0};  // nanoseconds since epoch
   std::atomic<int64_t> last_complete_ns_{0}; // nanoseconds since epoch
+  LatencyHistogram histogram_;               // Submit-to-completion, per write
 };
 
 // Abstract interface for platform-specific file operations
@@ -164,6 +174,13 @@ class FileOperations {
   // Streaming I/O operations (for sequential writing like image downloads)
   virtual FileError WriteSequential(const std::uint8_t* data, std::size_t size) = 0;
   virtual FileError ReadSequential(std::uint8_t* data, std::size_t size, std::size_t& bytes_read) = 0;
+
+  // Read at an explicit offset without moving the streaming position.
+  // Safe to call from another thread while sequential/async writes are in
+  // progress (used for verify-while-writing). bytes_read < size only at
+  // the end of the device.
+  virtual FileError ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                                 std::size_t size, std::size_t& bytes_read) = 0;
   
   // ============= Async I/O API =============
   // Async writes allow overlapping I/O latency with data preparation/hashing.
@@ -202,6 +219,49 @@ class FileOperations {
     return result;
   }
   
+  // Async reads: the counterpart of AsyncWriteSequential() for verification.
+  // Each call reads size bytes from the sequential read position (as
+  // ReadSequential() would) and advances it, so several reads can be in
+  // flight at increasing offsets while the caller hashes earlier buffers.
+  // The callback runs exactly once, possibly on another thread and in any
+  // order relative to other reads; bytes_read < size only at the end of the
+  // device. The caller bounds how many reads are in flight and must keep
+  // each buffer valid until its callback has run.
+  using AsyncReadCallback = std::function<void(FileError result, std::size_t bytes_read)>;
+  virtual FileError AsyncReadSequential(std::uint8_t* data, std::size_t size,
+                                        AsyncReadCallback callback = nullptr) {
+    // Default implementation: fall back to sync read
+    std::size_t bytes_read = 0;
+    FileError result = ReadSequential(data, size, bytes_read);
+    if (callback) callback(result, bytes_read);
+    return result;
+  }
+
+  // Wait until at most max_pending reads are in flight, running their
+  // callbacks. After cancellation, returns kCancelled straight away unless
+  // max_pending is 0, in which case in-flight reads are still drained so
+  // their buffers can be freed.
+  virtual FileError WaitForPendingReads(int max_pending = 0) {
+    (void)max_pending;
+    return FileError::kSuccess;
+  }
+
+  // Get number of reads currently in flight
+  virtual int GetPendingReadCount() const { return 0; }
+
+  // Register the memory async writes will be issued from (e.g. ring buffer
+  // slots) so the kernel can skip per-write page pinning. Writes from other
+  // memory still work as before. Replaces any previous registration, which
+  // lasts until UnregisterAsyncBuffers() or destruction; the caller must keep
+  // the buffers alive that long. Waits for pending writes first.
+  // Returns false if not supported (not an error).
+  using AsyncBuffer = std::pair<const std::uint8_t*, std::size_t>;
+  virtual bool RegisterAsyncBuffers(const std::vector<AsyncBuffer>& buffers) {
+    (void)buffers;
+    return false;
+  }
+  virtual void UnregisterAsyncBuffers() {}
+  
   // Get number of writes currently in flight
   virtual int GetPendingWriteCount() const { return 0; }
   
@@ -211,7 +271,19 @@ class FileOperations {
   
   // Wait for all pending async writes to complete. Returns first error encountered, or kSuccess.
   virtual FileError WaitForPendingWrites() { return FileError::kSuccess; }
-  
+
+  // Queue a Flush() behind every write queued so far and return without
+  // waiting for it. The callback runs once, on the thread that processes
+  // write completions, after the earlier writes and the flush are done.
+  // WaitForPendingWrites() waits for queued flushes too. Without support
+  // this is a blocking Flush().
+  virtual bool IsAsyncFlushSupported() const { return false; }
+  virtual FileError AsyncFlush(AsyncWriteCallback callback = nullptr) {
+    FileError result = Flush();
+    if (callback) callback(result, 0);
+    return result;
+  }
+
   // Cancel pending async I/O and wake up any blocking waits.
   // After calling this, WaitForPendingWrites and AsyncWriteSequential will return quickly.
   virtual void CancelAsyncIO() {}
@@ -245,6 +317,13 @@ class FileOperations {
   virtual void ReduceQueueDepthForRecovery(int newDepth) {
     (void)newDepth;  // Default: no-op for sync implementations
   }
+
+  // Raise the queue depth again once the device has recovered from a
+  // ReduceQueueDepthForRecovery(). The caller must not go above the depth
+  // it set with SetAsyncQueueDepth().
+  virtual void RestoreQueueDepthAfterRecovery(int newDepth) {
+    (void)newDepth;  // Default: no-op for sync implementations
+  }
   
   // Drain pending async writes and switch to sync mode.
   // Uses a per-completion stall timeout: if ANY write completes, the timer resets.
@@ -272,6 +351,15 @@ class FileOperations {
     sync_fallback_mode_ = true;
     return true;  // Default: no async to drain
   }
+
+  // Leave the sync mode DrainAndSwitchToSync() entered, once the device has
+  // recovered, and queue async writes again at depth (at most the depth set
+  // with SetAsyncQueueDepth()). Only possible with nothing pending and no
+  // async error. Returns false if async writes stay off.
+  virtual bool ResumeAsyncAfterSyncFallback(int depth) {
+    (void)depth;
+    return false;
+  }
   
   // Get async I/O timing statistics
   // - wallClockMs: total time from first submit to last completion
@@ -283,6 +371,11 @@ class FileOperations {
     write_latency_stats_.getStats(wallClockMs, writeCount, minLatencyUs, maxLatencyUs, avgLatencyUs);
   }
   
+  // Distribution of async write latency, submit to completion
+  virtual const LatencyHistogram& GetAsyncWriteLatencyHistogram() const {
+    return write_latency_stats_.histogram();
+  }
+  
   // Reset async I/O statistics (call before starting a new operation)
   virtual void ResetAsyncIOStats() {
     write_latency_stats_.reset();
@@ -294,6 +387,53 @@ class FileOperations {
   struct DeviceIOLimits {
     size_t max_transfer_bytes = 0;   // Max single I/O request size in bytes (0 = unknown)
     int suggested_queue_depth = 0;   // Device/bus-informed queue depth limit (0 = unknown)
+    size_t io_alignment_bytes = 0;   // Buffer/offset/length alignment unbuffered I/O requires (0 = unknown)
+    size_t physical_sector_bytes = 0; // Physical sector size; writes in multiples avoid device RMW (0 = unknown)
+    size_t optimal_io_bytes = 0;     // Preferred request size reported by the device (0 = unknown)
+    size_t erase_unit_bytes = 0;     // Erase block / SD allocation unit; partial units cost the card RMW (0 = unknown)
+
+    // The device's own write cache. Completed writes to a write-back cache
+    // are lost on removal until the cache is flushed; FUA writes skip it.
+    enum class WriteCache { kUnknown, kWriteBack, kWriteThrough };
+    WriteCache write_cache = WriteCache::kUnknown;
+    bool fua_supported = false;      // Device honours Force Unit Access writes
+
+    // Alignment for buffer addresses, offsets and lengths: what unbuffered
+    // I/O requires, and whole physical sectors, but at least `minimum`
+    size_t BufferAlignment(size_t minimum) const {
+      return std::max(minimum, std::max(io_alignment_bytes, physical_sector_bytes));
+    }
+
+    // Round an I/O size so that the device sees whole native requests rather
+    // than requests split or merged by the kernel: a multiple of the max
+    // transfer size when it is at least that large, otherwise a multiple of
+    // the optimal I/O size (or the alignment). Never less than one aligned unit.
+    size_t NativeIOSize(size_t size, size_t minimum_alignment) const {
+      const size_t alignment = BufferAlignment(minimum_alignment);
+      const size_t request = max_transfer_bytes / alignment * alignment;
+      if (request > 0 && size >= request)
+        return size / request * request;
+
+      size_t unit = alignment;
+      if (optimal_io_bytes > alignment && optimal_io_bytes % alignment == 0 && optimal_io_bytes <= size)
+        unit = optimal_io_bytes;
+      return std::max(alignment, size / unit * unit);
+    }
+
+    // Shrink an I/O size so that back-to-back I/Os of that size from an
+    // erase unit boundary never straddle one: a whole number of erase
+    // units, or the largest aligned size that divides one evenly.
+    size_t EraseAlignedSize(size_t size, size_t minimum_alignment) const {
+      const size_t alignment = BufferAlignment(minimum_alignment);
+      if (erase_unit_bytes == 0 || erase_unit_bytes % alignment != 0)
+        return size;
+      if (size >= erase_unit_bytes)
+        return size / erase_unit_bytes * erase_unit_bytes;
+      size_t divisor = size / alignment * alignment;
+      while (divisor > alignment && erase_unit_bytes % divisor != 0)
+        divisor -= alignment;
+      return std::max(divisor, alignment);
+    }
   };
 
  protected:
@@ -309,10 +449,84 @@ class FileOperations {
   // Force filesystem sync (for page cache management)
   virtual FileError ForceSync() = 0;
   virtual FileError Flush() = 0;
+
+  // The bare sync system call (fsync, FlushFileBuffers), without draining
+  // or reaping async writes first. Callers drain them with
+  // WaitForPendingWrites() beforehand. It only uses the file handle, so it
+  // may run on a helper thread while the owner waits for it or gives up on
+  // it, without two threads reaping the same completion queue.
+  virtual FileError SyncToDevice() { return ForceSync(); }
+  
+  // Ranged writeback of buffered writes (Linux sync_file_range), so the page
+  // cache can be drained region by region instead of in one fdatasync().
+  // StartWriteback() queues [offset, offset + length) for writeback and
+  // returns at once; WaitWriteback() blocks until that range is written out
+  // and drops it from the page cache. Neither flushes the device's own write
+  // cache, so a final ForceSync() is still required.
+  virtual bool IsRangeWritebackSupported() const { return false; }
+  virtual FileError StartWriteback(std::uint64_t offset, std::uint64_t length) {
+    (void)offset; (void)length;
+    return FileError::kFlushError;
+  }
+  virtual FileError WaitWriteback(std::uint64_t offset, std::uint64_t length) {
+    (void)offset; (void)length;
+    return FileError::kFlushError;
+  }
   
   // Prepare for sequential read (e.g., verification)
   // Invalidates cache and enables read-ahead hints for optimal sequential read performance
   virtual void PrepareForSequentialRead(std::uint64_t offset, std::uint64_t length) = 0;
+
+  // How ZeroRange() clears a range on the open device, if at all
+  enum class ZeroRangeMethod {
+    kNone,         // Not supported; write zeros instead
+    kWriteZeroes,  // Linux: BLKZEROOUT, offloaded to the device (write_zeroes_max_bytes > 0)
+    kDiscard,      // Linux: BLKDISCARD on a device reporting discard_zeroes_data
+    kPunchHole     // Regular files: a hole punched with fallocate(), or the file extended over it
+  };
+  virtual ZeroRangeMethod GetZeroRangeMethod() const { return ZeroRangeMethod::kNone; }
+
+  // Whether the target is a regular file (an image file) rather than a device
+  virtual bool IsRegularFile() const { return false; }
+
+  // Make the first length bytes of the target a copy of the regular file
+  // src_fd, leaving the copying to the file system: its extents are shared
+  // (reflink) where it can, holes in the source stay holes. Only for
+  // regular-file targets. On failure part of the range may have been
+  // copied and the caller writes the data as usual. Does not move the file
+  // position.
+  virtual FileError CloneFrom(int src_fd, std::uint64_t length) {
+    (void)src_fd; (void)length;
+    return FileError::kWriteError;
+  }
+
+  // Write length bytes of src_fd, from src_offset, at the current position
+  // without passing them through this process (Linux: splice() through a
+  // pipe, from the source's page cache to the device). Waits for pending
+  // writes first and advances the position like a write; the file position
+  // of src_fd is not used. On failure part of the range may have been
+  // written and the position is undefined: the caller seeks and writes the
+  // data as usual.
+  virtual FileError SpliceFrom(int src_fd, std::uint64_t src_offset, std::size_t length) {
+    (void)src_fd; (void)src_offset; (void)length;
+    return FileError::kWriteError;
+  }
+
+  // Make [offset, offset + length) read back as zeros without transferring
+  // the data. Both must be multiples of the logical block size, except on
+  // regular files, which are extended if the range ends past them. Does not
+  // move the file position.
+  virtual FileError ZeroRange(std::uint64_t offset, std::uint64_t length) {
+    (void)offset; (void)length;
+    return FileError::kWriteError;
+  }
+
+  // Discard/unmap every block of the open device so the media starts from
+  // an erased state. What is read back afterwards is device-defined; callers
+  // must not rely on zeros. Only meaningful for block devices.
+  virtual FileError EraseDevice() {
+    return FileError::kWriteError;
+  }
   
   // Get platform-specific file handle (for compatibility with existing code)
   virtual int GetHandle() const = 0;
@@ -332,6 +546,14 @@ class FileOperations {
   // Must be called after OpenDevice(). Some platforms may not support disabling after open.
   // Returns kSuccess if the change was applied, or an error if not supported/failed.
   virtual FileError SetDirectIOEnabled(bool enabled) = 0;
+
+  // Write-through: each write made with it on returns once it is on stable
+  // media - a FUA write where the device supports one, a cache flush after
+  // it where not - so the writes need no ForceSync() after them. Meant for
+  // the last few writes of an image. Returns false where not supported;
+  // IsWriteThrough() turns false if a write finds the kernel lacks it.
+  virtual bool SetWriteThrough(bool enabled) { (void)enabled; return false; }
+  virtual bool IsWriteThrough() const { return false; }
   
   // Get direct I/O attempt details (for performance logging)
   // Returns: attempted (bool), succeeded (bool), error_code (int), error_message (string)
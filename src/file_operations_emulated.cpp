@@ -0,0 +1,164 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "file_operations_emulated.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace rpi_imager {
+
+namespace {
+
+constexpr double kMiB = 1024.0 * 1024.0;
+
+std::uint64_t TransferUs(std::uint64_t bytes, double mb_per_s) {
+  if (mb_per_s <= 0)
+    return 0;
+  return static_cast<std::uint64_t>(static_cast<double>(bytes) * 1e6 / (mb_per_s * kMiB));
+}
+
+}  // namespace
+
+bool EmulatedDeviceModel::Preset(const std::string& name, EmulatedDeviceModel& model) {
+  model = EmulatedDeviceModel{};
+  if (name == "healthy")
+    return true;
+  if (name == "slc-cliff") {
+    // Fast until the SLC cache is full, then the native rate of the TLC behind it
+    model.write_rate = {{0, 90.0}, {4ULL * 1024 * 1024 * 1024, 9.0}};
+    return true;
+  }
+  if (name == "gc") {
+    model.write_rate = {{0, 20.0}};
+    model.gc_mean_interval_bytes = 256ULL * 1024 * 1024;
+    model.gc_pause_min_ms = 500;
+    model.gc_pause_max_ms = 8000;
+    return true;
+  }
+  if (name == "lost-completion") {
+    model.lost_completions = {500, 5000};
+    return true;
+  }
+  if (name == "slow-sync") {
+    // A write cache that takes the data quickly and flushes it slowly
+    model.write_rate = {{0, 60.0}};
+    model.sync_flush_mb_per_s = 15.0;
+    return true;
+  }
+  return false;
+}
+
+bool EmulatedFileOperations::IsEmulatedTarget(const std::string& path) {
+  return path.rfind(kEmulatePrefix, 0) == 0;
+}
+
+FileError EmulatedFileOperations::OpenDevice(const std::string& path) {
+  const std::string name = IsEmulatedTarget(path) ? path.substr(std::strlen(kEmulatePrefix)) : std::string();
+  if (!EmulatedDeviceModel::Preset(name, model_)) {
+    FileOperationsLog("EmulatedFileOperations: no device model named '" + name +
+                      "' (healthy, slc-cliff, gc, lost-completion, slow-sync)");
+    return FileError::kOpenError;
+  }
+  return OpenModel();
+}
+
+FileError EmulatedFileOperations::CreateTestFile(const std::string& path, std::uint64_t size) {
+  (void)path;
+  model_.size = size;
+  return OpenModel();
+}
+
+FileError EmulatedFileOperations::OpenModel() {
+  FileError result = OpenTimed(model_.size);
+  if (result != FileError::kSuccess)
+    return result;
+
+  std::sort(model_.write_rate.begin(), model_.write_rate.end(),
+            [](const auto& a, const auto& b) { return a.from_bytes < b.from_bytes; });
+  rng_state_ = model_.seed;
+  written_ = 0;
+  dirty_ = 0;
+  async_writes_ = 0;
+  gc_pauses_ = 0;
+  gc_pause_us_ = 0;
+  lost_ = 0;
+  next_gc_ = model_.gc_mean_interval_bytes ? NextGcInterval() : UINT64_MAX;
+  return FileError::kSuccess;
+}
+
+double EmulatedFileOperations::NextUniform() {
+  // splitmix64
+  std::uint64_t z = (rng_state_ += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return static_cast<double>(z >> 11) * 0x1.0p-53;
+}
+
+std::uint64_t EmulatedFileOperations::NextGcInterval() {
+  const double interval = -static_cast<double>(model_.gc_mean_interval_bytes) * std::log(1.0 - NextUniform());
+  return std::max<std::uint64_t>(1, static_cast<std::uint64_t>(interval));
+}
+
+double EmulatedFileOperations::WriteRateAt(std::uint64_t written) const {
+  double rate = model_.write_rate.empty() ? 0.0 : model_.write_rate.front().mb_per_s;
+  for (const auto& point : model_.write_rate) {
+    if (point.from_bytes > written)
+      break;
+    rate = point.mb_per_s;
+  }
+  return rate;
+}
+
+EmulatedFileOperations::Service EmulatedFileOperations::Serve(
+    DeviceOp op, std::uint64_t offset, std::uint64_t length, bool async) {
+  (void)offset;
+  Service service;
+  service.us = model_.command_us;
+
+  switch (op) {
+    case DeviceOp::kWrite: {
+      service.us += TransferUs(length, WriteRateAt(written_));
+      written_ += length;
+      dirty_ += length;
+
+      while (written_ >= next_gc_) {
+        const double min = static_cast<double>(std::max<std::uint64_t>(1, model_.gc_pause_min_ms));
+        const double max = static_cast<double>(std::max(model_.gc_pause_min_ms, model_.gc_pause_max_ms));
+        const std::uint64_t pause_us = static_cast<std::uint64_t>(min * std::pow(max / min, NextUniform()) * 1000.0);
+        service.us += pause_us;
+        gc_pauses_++;
+        gc_pause_us_ += pause_us;
+        next_gc_ = written_ + NextGcInterval();
+      }
+
+      if (async) {
+        ++async_writes_;
+        if (std::find(model_.lost_completions.begin(), model_.lost_completions.end(), async_writes_) !=
+            model_.lost_completions.end()) {
+          service.lost_completion = true;
+          lost_++;
+        }
+      }
+      break;
+    }
+    case DeviceOp::kRead:
+      service.us += TransferUs(length, model_.read_mb_per_s);
+      break;
+    case DeviceOp::kSync:
+      service.us = model_.sync_base_us + TransferUs(dirty_, model_.sync_flush_mb_per_s);
+      dirty_ = 0;
+      break;
+    case DeviceOp::kZeroRange:
+    case DeviceOp::kErase:
+      // Discards only touch the mapping tables
+      break;
+  }
+  return service;
+}
+
+}  // namespace rpi_imager
@@ -0,0 +1,109 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef FILE_OPERATIONS_EMULATED_H_
+#define FILE_OPERATIONS_EMULATED_H_
+
+#include "file_operations_timed.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace rpi_imager {
+
+// How an emulated device performs. Rates are in MB/s of 1024 * 1024 bytes.
+struct EmulatedDeviceModel {
+  // Write rate from this many bytes written onwards, e.g. a fast SLC cache
+  // followed by the native rate of the flash behind it
+  struct RatePoint {
+    std::uint64_t from_bytes;
+    double mb_per_s;
+  };
+
+  std::uint64_t size = 32ULL * 1024 * 1024 * 1024;
+  std::vector<RatePoint> write_rate = {{0, 40.0}};
+  double read_mb_per_s = 80.0;
+  std::uint64_t command_us = 100;  // Added to every operation
+
+  // Garbage collection: after an exponentially distributed number of bytes
+  // written (this mean; 0 for never) the device stalls for a time drawn
+  // log-uniformly from [gc_pause_min_ms, gc_pause_max_ms]
+  std::uint64_t gc_mean_interval_bytes = 0;
+  std::uint64_t gc_pause_min_ms = 0;
+  std::uint64_t gc_pause_max_ms = 0;
+
+  // Async writes, counted from 1, whose completion is lost until polled
+  std::vector<std::uint64_t> lost_completions;
+
+  // A sync costs sync_base_us plus flushing what was written since the
+  // last one at sync_flush_mb_per_s (0: nothing to flush)
+  std::uint64_t sync_base_us = 1000;
+  double sync_flush_mb_per_s = 0;
+
+  std::uint64_t seed = 1;
+
+  // Built-in models for emulate:<name> targets: healthy, slc-cliff, gc,
+  // lost-completion, slow-sync. Returns false for an unknown name.
+  static bool Preset(const std::string& name, EmulatedDeviceModel& model);
+};
+
+// A ramdisk that performs like a configurable slow device, for exercising
+// and benchmarking the async write path and WriteProgressWatchdog recovery
+// (polling, queue depth reduction, drain to sync and stepping back up)
+// without a misbehaving card to hand.
+//
+// Selected by target path:
+//   emulate:<preset>   See EmulatedDeviceModel::Preset()
+// or constructed with a model (CreateTestFile() then opens it with the
+// given size). Pauses and lost completions follow from the model and its
+// seed alone, so a scenario behaves the same on every run.
+class EmulatedFileOperations : public TimedMemoryFileOperations {
+ public:
+  // Whether path names an emulate: target rather than a device
+  static bool IsEmulatedTarget(const std::string& path);
+
+  EmulatedFileOperations() = default;
+  explicit EmulatedFileOperations(const EmulatedDeviceModel& model) : model_(model) {}
+
+  FileError OpenDevice(const std::string& path) override;
+  // A device of the constructor's model with this size (path is ignored)
+  FileError CreateTestFile(const std::string& path, std::uint64_t size) override;
+
+  const EmulatedDeviceModel& GetModel() const { return model_; }
+
+  // What the device has done since it was opened
+  std::uint64_t GetGcPauseCount() const { return gc_pauses_; }
+  std::uint64_t GetGcPauseMs() const { return gc_pause_us_ / 1000; }
+  std::uint64_t GetLostCompletionCount() const { return lost_; }
+
+ protected:
+  Service Serve(DeviceOp op, std::uint64_t offset, std::uint64_t length, bool async) override;
+
+ private:
+  FileError OpenModel();
+
+  // Uniform in [0, 1) from the model's seed; the same on every platform
+  double NextUniform();
+  std::uint64_t NextGcInterval();
+
+  double WriteRateAt(std::uint64_t written) const;
+
+  EmulatedDeviceModel model_;
+  std::uint64_t rng_state_ = 0;
+  std::uint64_t written_ = 0;
+  std::uint64_t dirty_ = 0;
+  std::uint64_t next_gc_ = 0;
+  std::uint64_t async_writes_ = 0;
+
+  // Read from other threads while the device is in use
+  std::atomic<std::uint64_t> gc_pauses_{0};
+  std::atomic<std::uint64_t> gc_pause_us_{0};
+  std::atomic<std::uint64_t> lost_{0};
+};
+
+}  // namespace rpi_imager
+
+#endif  // FILE_OPERATIONS_EMULATED_H_
@@ -0,0 +1,252 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "file_operations_memory.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace rpi_imager {
+
+namespace {
+
+bool StartsWith(const std::string& s, const char* prefix) {
+  return s.rfind(prefix, 0) == 0;
+}
+
+// Size with an optional K/M/G/T suffix; empty means the default
+bool ParseSize(const std::string& text, std::uint64_t& size) {
+  if (text.empty()) {
+    size = MemoryFileOperations::kDefaultSize;
+    return true;
+  }
+
+  std::uint64_t value = 0;
+  std::size_t i = 0;
+  for (; i < text.size() && std::isdigit(static_cast<unsigned char>(text[i])); ++i) {
+    if (value > (UINT64_MAX - 9) / 10) return false;
+    value = value * 10 + static_cast<std::uint64_t>(text[i] - '0');
+  }
+  if (i == 0) return false;
+
+  int shift = 0;
+  if (i < text.size()) {
+    switch (std::toupper(static_cast<unsigned char>(text[i]))) {
+      case 'K': shift = 10; break;
+      case 'M': shift = 20; break;
+      case 'G': shift = 30; break;
+      case 'T': shift = 40; break;
+      default: return false;
+    }
+    if (++i != text.size()) return false;
+  }
+  if (shift && value > (UINT64_MAX >> shift)) return false;
+
+  size = value << shift;
+  return size > 0;
+}
+
+bool IsAllZero(const std::uint8_t* data, std::size_t size) {
+  return size == 0 || (data[0] == 0 && std::memcmp(data, data + 1, size - 1) == 0);
+}
+
+}  // namespace
+
+bool MemoryFileOperations::IsMemoryTarget(const std::string& path) {
+  return StartsWith(path, kNullPrefix) || StartsWith(path, kRamdiskPrefix) || StartsWith(path, kReplayPrefix) ||
+         StartsWith(path, kEmulatePrefix);
+}
+
+bool MemoryFileOperations::ParseTarget(const std::string& path, Mode& mode, std::uint64_t& size) {
+  if (StartsWith(path, kNullPrefix)) {
+    mode = Mode::kNull;
+    return ParseSize(path.substr(std::strlen(kNullPrefix)), size);
+  }
+  if (StartsWith(path, kRamdiskPrefix)) {
+    mode = Mode::kRamdisk;
+    return ParseSize(path.substr(std::strlen(kRamdiskPrefix)), size);
+  }
+  return false;
+}
+
+FileError MemoryFileOperations::OpenDevice(const std::string& path) {
+  Mode mode;
+  std::uint64_t size;
+  if (!ParseTarget(path, mode, size)) {
+    FileOperationsLog("MemoryFileOperations: not a memory target: " + path);
+    return FileError::kOpenError;
+  }
+  return Open(mode, size);
+}
+
+FileError MemoryFileOperations::CreateTestFile(const std::string& path, std::uint64_t size) {
+  (void)path;
+  return Open(Mode::kRamdisk, size);
+}
+
+FileError MemoryFileOperations::Open(Mode mode, std::uint64_t size) {
+  {
+    std::lock_guard<std::mutex> lock(chunks_mutex_);
+    chunks_.clear();
+  }
+  mode_ = mode;
+  size_ = size;
+  position_ = 0;
+  open_ = true;
+  device_io_limits_ = DeviceIOLimits{};
+
+  FileOperationsLog(std::string("MemoryFileOperations: opened ") +
+                    (mode == Mode::kNull ? "null" : "ramdisk") + " target of " +
+                    std::to_string(size / (1024 * 1024)) + " MB");
+  return FileError::kSuccess;
+}
+
+FileError MemoryFileOperations::WriteAtOffset(
+    std::uint64_t offset,
+    const std::uint8_t* data,
+    std::size_t size) {
+  if (!open_) return FileError::kWriteError;
+  if (offset > size_ || size > size_ - offset) return FileError::kWriteError;
+  if (mode_ == Mode::kNull) return FileError::kSuccess;
+
+  std::lock_guard<std::mutex> lock(chunks_mutex_);
+  while (size > 0) {
+    const std::uint64_t index = offset / kChunkSize;
+    const std::size_t within = static_cast<std::size_t>(offset % kChunkSize);
+    const std::size_t n = std::min(size, kChunkSize - within);
+
+    auto it = chunks_.find(index);
+    if (it == chunks_.end()) {
+      // Zeros over an unwritten chunk read back the same without storing them
+      if (!IsAllZero(data, n)) {
+        auto chunk = std::make_unique<std::uint8_t[]>(kChunkSize);  // Value-initialised to zero
+        std::memcpy(chunk.get() + within, data, n);
+        chunks_.emplace(index, std::move(chunk));
+      }
+    } else {
+      std::memcpy(it->second.get() + within, data, n);
+    }
+
+    offset += n;
+    data += n;
+    size -= n;
+  }
+  return FileError::kSuccess;
+}
+
+FileError MemoryFileOperations::GetSize(std::uint64_t& size) {
+  if (!open_) return FileError::kSizeError;
+  size = size_;
+  return FileError::kSuccess;
+}
+
+FileError MemoryFileOperations::Close() {
+  open_ = false;
+  position_ = 0;
+  return FileError::kSuccess;
+}
+
+FileError MemoryFileOperations::WriteSequential(const std::uint8_t* data, std::size_t size) {
+  FileError result = WriteAtOffset(position_, data, size);
+  if (result == FileError::kSuccess) position_ += size;
+  return result;
+}
+
+FileError MemoryFileOperations::ReadSequential(std::uint8_t* data, std::size_t size, std::size_t& bytes_read) {
+  FileError result = ReadAtOffset(position_, data, size, bytes_read);
+  if (result == FileError::kSuccess) position_ += bytes_read;
+  return result;
+}
+
+FileError MemoryFileOperations::ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                                             std::size_t size, std::size_t& bytes_read) {
+  bytes_read = 0;
+  if (!open_) return FileError::kReadError;
+  if (offset >= size_) return FileError::kSuccess;
+  size = static_cast<std::size_t>(std::min<std::uint64_t>(size, size_ - offset));
+
+  if (mode_ == Mode::kNull) {
+    FillPattern(offset, data, size);
+    bytes_read = size;
+    return FileError::kSuccess;
+  }
+
+  std::lock_guard<std::mutex> lock(chunks_mutex_);
+  std::size_t done = 0;
+  while (done < size) {
+    const std::uint64_t index = (offset + done) / kChunkSize;
+    const std::size_t within = static_cast<std::size_t>((offset + done) % kChunkSize);
+    const std::size_t n = std::min(size - done, kChunkSize - within);
+
+    auto it = chunks_.find(index);
+    if (it == chunks_.end())
+      std::memset(data + done, 0, n);
+    else
+      std::memcpy(data + done, it->second.get() + within, n);
+    done += n;
+  }
+  bytes_read = size;
+  return FileError::kSuccess;
+}
+
+FileError MemoryFileOperations::Seek(std::uint64_t position) {
+  if (!open_ || position > size_) return FileError::kSeekError;
+  position_ = position;
+  return FileError::kSuccess;
+}
+
+FileError MemoryFileOperations::ZeroRange(std::uint64_t offset, std::uint64_t length) {
+  if (!open_) return FileError::kWriteError;
+  if (offset > size_ || length > size_ - offset) return FileError::kWriteError;
+  if (mode_ == Mode::kNull || length == 0) return FileError::kSuccess;
+
+  std::lock_guard<std::mutex> lock(chunks_mutex_);
+  const std::uint64_t end = offset + length;
+  for (auto it = chunks_.begin(); it != chunks_.end();) {
+    const std::uint64_t chunkStart = it->first * kChunkSize;
+    const std::uint64_t chunkEnd = chunkStart + kChunkSize;
+    if (chunkEnd <= offset || chunkStart >= end) {
+      ++it;
+    } else if (chunkStart >= offset && chunkEnd <= end) {
+      it = chunks_.erase(it);
+    } else {
+      const std::uint64_t from = std::max(offset, chunkStart);
+      const std::uint64_t to = std::min(end, chunkEnd);
+      std::memset(it->second.get() + (from - chunkStart), 0, static_cast<std::size_t>(to - from));
+      ++it;
+    }
+  }
+  return FileError::kSuccess;
+}
+
+FileError MemoryFileOperations::EraseDevice() {
+  if (!open_) return FileError::kWriteError;
+  std::lock_guard<std::mutex> lock(chunks_mutex_);
+  chunks_.clear();
+  return FileError::kSuccess;
+}
+
+std::uint64_t MemoryFileOperations::GetResidentBytes() const {
+  std::lock_guard<std::mutex> lock(chunks_mutex_);
+  return static_cast<std::uint64_t>(chunks_.size()) * kChunkSize;
+}
+
+void MemoryFileOperations::FillPattern(std::uint64_t offset, std::uint8_t* data, std::size_t size) {
+  // Every 8-byte word is a function of its index, so any read of the same
+  // range returns the same bytes regardless of how it is split
+  for (std::size_t i = 0; i < size;) {
+    const std::uint64_t absolute = offset + i;
+    std::uint64_t word = (absolute / 8) * 0x9E3779B97F4A7C15ULL;
+    word ^= word >> 31;
+    const std::size_t byte = static_cast<std::size_t>(absolute % 8);
+    const std::size_t n = std::min<std::size_t>(8 - byte, size - i);
+    for (std::size_t b = 0; b < n; ++b)
+      data[i + b] = static_cast<std::uint8_t>(word >> ((byte + b) * 8));
+    i += n;
+  }
+}
+
+}  // namespace rpi_imager
@@ -0,0 +1,130 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef FILE_OPERATIONS_MEMORY_H_
+#define FILE_OPERATIONS_MEMORY_H_
+
+#include "file_operations.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace rpi_imager {
+
+// Device-less FileOperations for measuring the download -> decompress ->
+// hash pipeline without storage in the way.
+//
+// Selected by target path instead of a device name:
+//   null:[size]     Writes are discarded, reads return a deterministic
+//                   pattern. Verification and customisation fail by design;
+//                   use it with verification disabled.
+//   ramdisk:[size]  Sparse in-memory image. Only chunks that have been
+//                   written with non-zero data take memory, unwritten areas
+//                   read back as zeros, so verify and customisation work.
+//   replay:<trace>  A ramdisk with the timing and errors of a recorded
+//                   device; see ReplayFileOperations.
+//   emulate:<name>  A ramdisk that performs like a slow or misbehaving
+//                   device; see EmulatedFileOperations.
+// size takes an optional K, M, G or T suffix (powers of 1024) and defaults
+// to kDefaultSize. Writes are synchronous; the image survives Close() and
+// lasts until the object is destroyed or another target is opened.
+class MemoryFileOperations : public FileOperations {
+ public:
+  enum class Mode { kNull, kRamdisk };
+
+  static constexpr const char* kNullPrefix = "null:";
+  static constexpr const char* kRamdiskPrefix = "ramdisk:";
+  static constexpr const char* kReplayPrefix = "replay:";
+  static constexpr const char* kEmulatePrefix = "emulate:";
+  static constexpr std::uint64_t kDefaultSize = 64ULL * 1024 * 1024 * 1024;
+  static constexpr std::size_t kChunkSize = 1024 * 1024;
+
+  // Whether path names a null:, ramdisk:, replay: or emulate: target rather
+  // than a device
+  static bool IsMemoryTarget(const std::string& path);
+
+  // Parse path into mode and size. Returns false if it is not a null: or
+  // ramdisk: target or the size is malformed.
+  static bool ParseTarget(const std::string& path, Mode& mode, std::uint64_t& size);
+
+  MemoryFileOperations() = default;
+  ~MemoryFileOperations() override = default;
+
+  MemoryFileOperations(const MemoryFileOperations&) = delete;
+  MemoryFileOperations& operator=(const MemoryFileOperations&) = delete;
+
+  FileError OpenDevice(const std::string& path) override;
+  // Regular path: a ramdisk of the given size (the file is not touched)
+  FileError CreateTestFile(const std::string& path, std::uint64_t size) override;
+  FileError WriteAtOffset(
+      std::uint64_t offset,
+      const std::uint8_t* data,
+      std::size_t size) override;
+  FileError GetSize(std::uint64_t& size) override;
+  FileError Close() override;
+  bool IsOpen() const override { return open_; }
+
+  FileError WriteSequential(const std::uint8_t* data, std::size_t size) override;
+  FileError ReadSequential(std::uint8_t* data, std::size_t size, std::size_t& bytes_read) override;
+  FileError ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                         std::size_t size, std::size_t& bytes_read) override;
+
+  FileError Seek(std::uint64_t position) override;
+  std::uint64_t Tell() const override { return position_; }
+
+  FileError ForceSync() override { return open_ ? FileError::kSuccess : FileError::kSyncError; }
+  FileError Flush() override { return open_ ? FileError::kSuccess : FileError::kFlushError; }
+  void PrepareForSequentialRead(std::uint64_t offset, std::uint64_t length) override {
+    (void)offset; (void)length;
+  }
+
+  // Dropping chunks makes a range read back as zeros in either mode
+  ZeroRangeMethod GetZeroRangeMethod() const override { return ZeroRangeMethod::kDiscard; }
+  FileError ZeroRange(std::uint64_t offset, std::uint64_t length) override;
+  FileError EraseDevice() override;
+
+  int GetHandle() const override { return -1; }
+  int GetLastErrorCode() const override { return 0; }
+
+  // Nothing to bypass; the flag is only kept so callers see what they set
+  bool IsDirectIOEnabled() const override { return direct_io_; }
+  FileError SetDirectIOEnabled(bool enabled) override {
+    direct_io_ = enabled;
+    return FileError::kSuccess;
+  }
+  DirectIOInfo GetDirectIOInfo() const override {
+    DirectIOInfo info;
+    info.currently_enabled = direct_io_;
+    return info;
+  }
+
+  Mode GetMode() const { return mode_; }
+
+  // Memory held by written chunks
+  std::uint64_t GetResidentBytes() const;
+
+ protected:
+  FileError Open(Mode mode, std::uint64_t size);
+
+ private:
+  // Fill data with the null target's pattern for [offset, offset + size)
+  static void FillPattern(std::uint64_t offset, std::uint8_t* data, std::size_t size);
+
+  Mode mode_ = Mode::kNull;
+  bool open_ = false;
+  bool direct_io_ = false;
+  std::uint64_t size_ = 0;
+  std::uint64_t position_ = 0;
+
+  // ramdisk: chunk index -> kChunkSize bytes. ReadAtOffset may run on a
+  // verifier thread while writes continue, so access is locked.
+  mutable std::mutex chunks_mutex_;
+  std::unordered_map<std::uint64_t, std::unique_ptr<std::uint8_t[]>> chunks_;
+};
+
+} // namespace rpi_imager
+
+#endif // FILE_OPERATIONS_MEMORY_H_
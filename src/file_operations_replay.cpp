@@ -0,0 +1,204 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "file_operations_replay.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace rpi_imager {
+
+namespace {
+
+// Whether a repeat over [offset, offset + length) covers a recorded range.
+// Failed reads are recorded with no length: they match at their offset.
+bool Overlaps(std::uint64_t offset, std::uint64_t length,
+              std::uint64_t recorded_offset, std::uint64_t recorded_length) {
+  const std::uint64_t end = offset + std::max<std::uint64_t>(length, 1);
+  const std::uint64_t recorded_end = recorded_offset + std::max<std::uint64_t>(recorded_length, 1);
+  return offset < recorded_end && recorded_offset < end;
+}
+
+bool IsDeviceOp(IoTraceOp op) {
+  return op == IoTraceOp::kWrite || op == IoTraceOp::kRead || op == IoTraceOp::kSync ||
+         op == IoTraceOp::kZeroRange || op == IoTraceOp::kErase;
+}
+
+}  // namespace
+
+void ReplayFileOperations::ServiceCurve::Clear() {
+  points_.clear();
+  consumed_ = 0;
+}
+
+void ReplayFileOperations::ServiceCurve::Add(std::uint64_t bytes, std::uint64_t us) {
+  if (points_.empty()) {
+    points_.emplace_back(bytes, us);
+  } else if (bytes == 0) {
+    points_.back().second += us;
+  } else {
+    points_.emplace_back(points_.back().first + bytes, points_.back().second + us);
+  }
+}
+
+std::uint64_t ReplayFileOperations::ServiceCurve::At(std::uint64_t bytes) const {
+  if (points_.empty() || bytes == 0)
+    return 0;
+
+  auto it = std::upper_bound(points_.begin(), points_.end(), bytes,
+                             [](std::uint64_t b, const auto& point) { return b < point.first; });
+  const std::pair<std::uint64_t, std::uint64_t> origin{0, 0};
+  if (it == points_.end()) {
+    // Past the trace: the device's average rate
+    const auto& last = points_.back();
+    if (last.first == 0)
+      return last.second;
+    return last.second + static_cast<std::uint64_t>(
+        static_cast<double>(bytes - last.first) * static_cast<double>(last.second) / static_cast<double>(last.first));
+  }
+  const auto& prev = it == points_.begin() ? origin : *(it - 1);
+  const double fraction = static_cast<double>(bytes - prev.first) / static_cast<double>(it->first - prev.first);
+  return prev.second + static_cast<std::uint64_t>(fraction * static_cast<double>(it->second - prev.second));
+}
+
+std::uint64_t ReplayFileOperations::ServiceCurve::Take(std::uint64_t bytes) {
+  const std::uint64_t from = At(consumed_);
+  consumed_ += bytes;
+  const std::uint64_t to = At(consumed_);
+  return to > from ? to - from : 0;
+}
+
+void ReplayFileOperations::ServiceSequence::Clear() {
+  times_.clear();
+  total_ = 0;
+  next_ = 0;
+}
+
+std::uint64_t ReplayFileOperations::ServiceSequence::Take() {
+  const std::size_t index = next_++;
+  if (index < times_.size())
+    return times_[index];
+  return times_.empty() ? 0 : total_ / times_.size();
+}
+
+bool ReplayFileOperations::IsReplayTarget(const std::string& path) {
+  return path.rfind(kReplayPrefix, 0) == 0;
+}
+
+FileError ReplayFileOperations::OpenDevice(const std::string& path) {
+  if (!IsReplayTarget(path)) {
+    FileOperationsLog("ReplayFileOperations: not a replay target: " + path);
+    return FileError::kOpenError;
+  }
+
+  std::vector<IoTraceRecord> records;
+  std::string error;
+  if (!ReadIoTrace(path.substr(std::strlen(kReplayPrefix)), records, error)) {
+    FileOperationsLog("ReplayFileOperations: " + error);
+    return FileError::kOpenError;
+  }
+
+  auto open = std::find_if(records.begin(), records.end(),
+                           [](const IoTraceRecord& r) { return r.op == IoTraceOp::kOpen; });
+  if (open == records.end()) {
+    FileOperationsLog("ReplayFileOperations: trace does not record the device being opened");
+    return FileError::kOpenError;
+  }
+  if (open->result != FileError::kSuccess)
+    return open->result;
+  if (open->length == 0) {
+    FileOperationsLog("ReplayFileOperations: trace does not record the device size");
+    return FileError::kOpenError;
+  }
+
+  FileError result = OpenTimed(open->length);
+  if (result != FileError::kSuccess)
+    return result;
+  LoadModel(records);
+
+  FileOperationsLog("ReplayFileOperations: replaying " + std::to_string(trace_ops_) + " operations, " +
+                    std::to_string(failures_.size()) + " of them failed");
+  return FileError::kSuccess;
+}
+
+void ReplayFileOperations::LoadModel(const std::vector<IoTraceRecord>& records) {
+  writes_.Clear();
+  reads_.Clear();
+  syncs_.Clear();
+  zero_ranges_.Clear();
+  erases_.Clear();
+  failures_.clear();
+
+  std::vector<IoTraceRecord> ops;
+  std::copy_if(records.begin(), records.end(), std::back_inserter(ops),
+               [](const IoTraceRecord& r) { return IsDeviceOp(r.op); });
+  std::stable_sort(ops.begin(), ops.end(), [](const IoTraceRecord& a, const IoTraceRecord& b) {
+    return a.completeUs < b.completeUs;
+  });
+  trace_ops_ = ops.size();
+
+  // The device works on one thing at a time: an operation's service time
+  // starts when it was submitted or when the one before it finished,
+  // whichever is later, so queueing in front of the device is not counted
+  std::uint64_t previous_complete = 0;
+  std::uint64_t sync_ordinal = 0;
+  std::uint64_t erase_ordinal = 0;
+  for (const IoTraceRecord& r : ops) {
+    const std::uint64_t start = std::max(r.submitUs, previous_complete);
+    const std::uint64_t service = r.completeUs > start ? r.completeUs - start : 0;
+    previous_complete = std::max(previous_complete, r.completeUs);
+
+    std::uint64_t failure_offset = r.offset;
+    switch (r.op) {
+      case IoTraceOp::kWrite: writes_.Add(r.length, service); break;
+      case IoTraceOp::kRead: reads_.Add(r.length, service); break;
+      case IoTraceOp::kSync: syncs_.Add(service); failure_offset = sync_ordinal++; break;
+      case IoTraceOp::kZeroRange: zero_ranges_.Add(service); break;
+      case IoTraceOp::kErase: erases_.Add(service); failure_offset = erase_ordinal++; break;
+      default: break;
+    }
+    if (r.result != FileError::kSuccess)
+      failures_.push_back(Failure{r.op, failure_offset, r.length, r.result, false});
+  }
+}
+
+ReplayFileOperations::Service ReplayFileOperations::Serve(
+    DeviceOp op, std::uint64_t offset, std::uint64_t length, bool async) {
+  (void)async;
+  Service service;
+  IoTraceOp traced = IoTraceOp::kWrite;
+  bool by_ordinal = false;
+  switch (op) {
+    case DeviceOp::kWrite: service.us = writes_.Take(length); break;
+    case DeviceOp::kRead: traced = IoTraceOp::kRead; service.us = reads_.Take(length); break;
+    case DeviceOp::kSync:
+      traced = IoTraceOp::kSync;
+      offset = syncs_.Ordinal();
+      service.us = syncs_.Take();
+      by_ordinal = true;
+      break;
+    case DeviceOp::kZeroRange: traced = IoTraceOp::kZeroRange; service.us = zero_ranges_.Take(); break;
+    case DeviceOp::kErase:
+      traced = IoTraceOp::kErase;
+      offset = erases_.Ordinal();
+      service.us = erases_.Take();
+      by_ordinal = true;
+      break;
+  }
+
+  for (Failure& f : failures_) {
+    if (f.fired || f.op != traced)
+      continue;
+    if (by_ordinal ? f.offset == offset : Overlaps(offset, length, f.offset, f.length)) {
+      f.fired = true;
+      service.result = f.result;
+      break;
+    }
+  }
+  return service;
+}
+
+}  // namespace rpi_imager
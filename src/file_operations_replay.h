@@ -0,0 +1,103 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef FILE_OPERATIONS_REPLAY_H_
+#define FILE_OPERATIONS_REPLAY_H_
+
+#include "file_operations_timed.h"
+#include "iotrace.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rpi_imager {
+
+// A ramdisk that behaves like the device an I/O trace was recorded from
+// (see TracingFileOperations), so a user's slow or failing card can be
+// reproduced and tuned against without the card.
+//
+// Selected by target path:
+//   replay:<trace file>
+// The ramdisk has the recorded device's size. Each operation takes the
+// time the device spent on the same kind of work in the trace: writes and
+// reads by how many bytes have gone before, so a card that slows down once
+// its cache is full does so at the same point; syncs, zeroed ranges and
+// erases in the order they were recorded. Past the end of the trace the
+// device's average rate applies. Async writes queue as described in
+// TimedMemoryFileOperations.
+// A write, read or zeroed range that failed in the trace fails once when
+// it is repeated over the same offsets; the n-th sync or erase fails if
+// the n-th recorded one did.
+//
+// The result is deterministic for a given sequence of operations: nothing
+// depends on the host's storage, only on the trace and the calls made.
+class ReplayFileOperations : public TimedMemoryFileOperations {
+ public:
+  // Whether path names a replay: target rather than a device
+  static bool IsReplayTarget(const std::string& path);
+
+  ReplayFileOperations() = default;
+
+  FileError OpenDevice(const std::string& path) override;
+
+  // Recorded operations loaded by the last OpenDevice()
+  std::size_t GetTraceOperationCount() const { return trace_ops_; }
+
+ protected:
+  Service Serve(DeviceOp op, std::uint64_t offset, std::uint64_t length, bool async) override;
+
+ private:
+  // Cumulative bytes -> cumulative device time, for writes or reads
+  class ServiceCurve {
+   public:
+    void Clear();
+    void Add(std::uint64_t bytes, std::uint64_t us);
+    // Device time for the next bytes
+    std::uint64_t Take(std::uint64_t bytes);
+
+   private:
+    std::uint64_t At(std::uint64_t bytes) const;
+
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> points_;  // Both cumulative
+    std::uint64_t consumed_ = 0;
+  };
+
+  // Device time per operation, for syncs, zeroed ranges and erases
+  class ServiceSequence {
+   public:
+    void Clear();
+    void Add(std::uint64_t us) { times_.push_back(us); total_ += us; }
+    std::uint64_t Take();
+    std::uint64_t Ordinal() const { return next_; }
+
+   private:
+    std::vector<std::uint64_t> times_;
+    std::uint64_t total_ = 0;
+    std::size_t next_ = 0;
+  };
+
+  struct Failure {
+    IoTraceOp op;
+    std::uint64_t offset;   // Ordinal for syncs and erases
+    std::uint64_t length;
+    FileError result;
+    bool fired;
+  };
+
+  void LoadModel(const std::vector<IoTraceRecord>& records);
+
+  ServiceCurve writes_;
+  ServiceCurve reads_;
+  ServiceSequence syncs_;
+  ServiceSequence zero_ranges_;
+  ServiceSequence erases_;
+  std::vector<Failure> failures_;
+  std::size_t trace_ops_ = 0;
+};
+
+}  // namespace rpi_imager
+
+#endif  // FILE_OPERATIONS_REPLAY_H_
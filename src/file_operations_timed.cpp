@@ -0,0 +1,231 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "file_operations_timed.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace rpi_imager {
+
+TimedMemoryFileOperations::~TimedMemoryFileOperations() {
+  if (IsOpen())
+    Close();
+}
+
+FileError TimedMemoryFileOperations::OpenTimed(std::uint64_t size) {
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_.clear();
+    async_error_ = FileError::kSuccess;
+  }
+  pending_cv_.notify_all();
+  sync_fallback_mode_ = false;
+  depth_ = active_depth_ = 1;
+
+  FileError result = Open(Mode::kRamdisk, size);
+  std::lock_guard<std::mutex> lock(device_mutex_);
+  device_free_ = Clock::now();
+  return result;
+}
+
+FileError TimedMemoryFileOperations::Close() {
+  // Closing kicks the completion queue, lost completions included
+  CompletePending(0, true, true);
+  return MemoryFileOperations::Close();
+}
+
+TimedMemoryFileOperations::Clock::time_point TimedMemoryFileOperations::Book(
+    DeviceOp op, std::uint64_t offset, std::uint64_t length, bool async, Service& service) {
+  std::lock_guard<std::mutex> lock(device_mutex_);
+  service = Serve(op, offset, length, async);
+  const Clock::time_point due = std::max(Clock::now(), device_free_) + std::chrono::microseconds(service.us);
+  device_free_ = due;
+  return due;
+}
+
+FileError TimedMemoryFileOperations::Timed(DeviceOp op, std::uint64_t offset, std::uint64_t length) {
+  Service service;
+  std::this_thread::sleep_until(Book(op, offset, length, false, service));
+  return service.result;
+}
+
+FileError TimedMemoryFileOperations::WriteAtOffset(std::uint64_t offset, const std::uint8_t* data, std::size_t size) {
+  if (!IsOpen()) return FileError::kWriteError;
+  FileError result = Timed(DeviceOp::kWrite, offset, size);
+  if (result != FileError::kSuccess) return result;
+  return MemoryFileOperations::WriteAtOffset(offset, data, size);
+}
+
+FileError TimedMemoryFileOperations::ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                                                  std::size_t size, std::size_t& bytes_read) {
+  bytes_read = 0;
+  if (!IsOpen()) return FileError::kReadError;
+  FileError result = Timed(DeviceOp::kRead, offset, size);
+  if (result != FileError::kSuccess) return result;
+  return MemoryFileOperations::ReadAtOffset(offset, data, size, bytes_read);
+}
+
+FileError TimedMemoryFileOperations::ForceSync() {
+  CompletePending(0, true, false);
+  if (!IsOpen()) return FileError::kSyncError;
+  return Timed(DeviceOp::kSync, 0, 0);
+}
+
+FileError TimedMemoryFileOperations::Flush() {
+  CompletePending(0, true, false);
+  if (!IsOpen()) return FileError::kFlushError;
+  return Timed(DeviceOp::kSync, 0, 0);
+}
+
+FileError TimedMemoryFileOperations::ZeroRange(std::uint64_t offset, std::uint64_t length) {
+  CompletePending(0, true, false);
+  if (!IsOpen()) return FileError::kWriteError;
+  FileError result = Timed(DeviceOp::kZeroRange, offset, length);
+  if (result != FileError::kSuccess) return result;
+  return MemoryFileOperations::ZeroRange(offset, length);
+}
+
+FileError TimedMemoryFileOperations::EraseDevice() {
+  CompletePending(0, true, false);
+  if (!IsOpen()) return FileError::kWriteError;
+  FileError result = Timed(DeviceOp::kErase, 0, 0);
+  if (result != FileError::kSuccess) return result;
+  return MemoryFileOperations::EraseDevice();
+}
+
+bool TimedMemoryFileOperations::SetAsyncQueueDepth(int depth) {
+  depth_ = active_depth_ = std::max(1, depth);
+  return true;
+}
+
+FileError TimedMemoryFileOperations::AsyncWriteSequential(const std::uint8_t* data, std::size_t size,
+                                                          AsyncWriteCallback callback) {
+  if (active_depth_ <= 1 || sync_fallback_mode_)
+    return FileOperations::AsyncWriteSequential(data, size, std::move(callback));
+  if (!IsOpen()) return FileError::kWriteError;
+
+  CompletePending(static_cast<std::size_t>(active_depth_ - 1), true, false);
+
+  const std::uint64_t offset = Tell();
+  Service service;
+  const Clock::time_point due = Book(DeviceOp::kWrite, offset, size, true, service);
+  FileError result = service.result;
+  // The data lands now; only the completion waits for the device
+  if (result == FileError::kSuccess)
+    result = MemoryFileOperations::WriteAtOffset(offset, data, size);
+  if (result == FileError::kSuccess)
+    Seek(offset + size);
+
+  write_latency_stats_.recordSubmit();
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  pending_.push_back(PendingWrite{due, Clock::now(), size, result, service.lost_completion, std::move(callback)});
+  return FileError::kSuccess;
+}
+
+bool TimedMemoryFileOperations::CompletePending(std::size_t keep, bool wait, bool reap_lost,
+                                                Clock::duration stall) {
+  const bool bounded = stall != Clock::duration::max();
+  std::unique_lock<std::mutex> lock(pending_mutex_);
+  Clock::time_point last_progress = Clock::now();
+  for (;;) {
+    if (pending_.size() <= keep)
+      return true;
+
+    const PendingWrite& front = pending_.front();
+    const Clock::time_point now = Clock::now();
+    const bool blocked = front.lost && !reap_lost;
+    if (blocked || front.due > now) {
+      if (!wait)
+        return true;
+      if (bounded && now - last_progress >= stall)
+        return false;
+      // Another thread polling or cancelling wakes us
+      if (blocked && !bounded) {
+        pending_cv_.wait(lock);
+      } else {
+        Clock::time_point until = blocked ? last_progress + stall : front.due;
+        if (bounded)
+          until = std::min(until, last_progress + stall);
+        pending_cv_.wait_until(lock, until);
+      }
+      continue;
+    }
+
+    PendingWrite done = std::move(pending_.front());
+    pending_.pop_front();
+    if (done.result != FileError::kSuccess && async_error_ == FileError::kSuccess)
+      async_error_ = done.result;
+    lock.unlock();
+    pending_cv_.notify_all();
+
+    write_latency_stats_.recordCompletion(done.submitted);
+    if (done.callback)
+      done.callback(done.result, done.result == FileError::kSuccess ? done.size : 0);
+
+    last_progress = Clock::now();
+    lock.lock();
+  }
+}
+
+int TimedMemoryFileOperations::GetPendingWriteCount() const {
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  return static_cast<int>(pending_.size());
+}
+
+void TimedMemoryFileOperations::PollAsyncCompletions() {
+  CompletePending(0, false, true);
+}
+
+FileError TimedMemoryFileOperations::WaitForPendingWrites() {
+  CompletePending(0, true, false);
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  return async_error_;
+}
+
+void TimedMemoryFileOperations::CancelAsyncIO() {
+  std::deque<PendingWrite> cancelled;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    cancelled.swap(pending_);
+  }
+  pending_cv_.notify_all();
+  for (PendingWrite& write : cancelled) {
+    if (write.callback)
+      write.callback(FileError::kCancelled, 0);
+  }
+}
+
+FileError TimedMemoryFileOperations::AttemptSyncFallback() {
+  CompletePending(0, true, true);
+  sync_fallback_mode_ = true;
+  return FileError::kSuccess;
+}
+
+void TimedMemoryFileOperations::ReduceQueueDepthForRecovery(int newDepth) {
+  active_depth_ = std::clamp(newDepth, 1, depth_.load());
+}
+
+void TimedMemoryFileOperations::RestoreQueueDepthAfterRecovery(int newDepth) {
+  active_depth_ = std::clamp(newDepth, 1, depth_.load());
+}
+
+bool TimedMemoryFileOperations::DrainAndSwitchToSync(int stallTimeoutSeconds) {
+  sync_fallback_mode_ = true;
+  return CompletePending(0, true, true, std::chrono::seconds(std::max(1, stallTimeoutSeconds)));
+}
+
+bool TimedMemoryFileOperations::ResumeAsyncAfterSyncFallback(int depth) {
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    if (!pending_.empty() || async_error_ != FileError::kSuccess)
+      return false;
+  }
+  sync_fallback_mode_ = false;
+  active_depth_ = std::clamp(depth, 1, depth_.load());
+  return true;
+}
+
+}  // namespace rpi_imager
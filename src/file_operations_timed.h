@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef FILE_OPERATIONS_TIMED_H_
+#define FILE_OPERATIONS_TIMED_H_
+
+#include "file_operations_memory.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace rpi_imager {
+
+// A ramdisk whose operations take as long as a modelled device says, for
+// device backends that exist to reproduce timing: ReplayFileOperations and
+// EmulatedFileOperations. The subclass prices each operation in Serve();
+// this class keeps the device's timeline and the async write queue.
+//
+// The device serves one operation at a time. Synchronous operations sleep
+// until the device would have finished them. Async writes are stored at
+// once, queue behind each other up to the queue depth and complete in
+// submission order when the device would have finished them; callbacks
+// run on the thread that submits, polls or waits.
+//
+// A completion Serve() marks lost is only delivered by an explicit poll
+// (PollAsyncCompletions(), AttemptSyncFallback(), DrainAndSwitchToSync()),
+// as with a completion port or ring that has to be kicked: plain waits and
+// later submissions block behind it, and so does the caller, until another
+// thread polls or cancels.
+class TimedMemoryFileOperations : public MemoryFileOperations {
+ public:
+  ~TimedMemoryFileOperations() override;
+
+  FileError Close() override;
+
+  FileError WriteAtOffset(std::uint64_t offset, const std::uint8_t* data, std::size_t size) override;
+  FileError ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                         std::size_t size, std::size_t& bytes_read) override;
+
+  FileError ForceSync() override;
+  FileError Flush() override;
+  FileError ZeroRange(std::uint64_t offset, std::uint64_t length) override;
+  FileError EraseDevice() override;
+
+  bool SetAsyncQueueDepth(int depth) override;
+  int GetAsyncQueueDepth() const override { return depth_; }
+  bool IsAsyncIOSupported() const override { return true; }
+  FileError AsyncWriteSequential(const std::uint8_t* data, std::size_t size,
+                                 AsyncWriteCallback callback = nullptr) override;
+  int GetPendingWriteCount() const override;
+  void PollAsyncCompletions() override;
+  FileError WaitForPendingWrites() override;
+  void CancelAsyncIO() override;
+  FileError AttemptSyncFallback() override;
+  void ReduceQueueDepthForRecovery(int newDepth) override;
+  void RestoreQueueDepthAfterRecovery(int newDepth) override;
+  bool DrainAndSwitchToSync(int stallTimeoutSeconds) override;
+  bool ResumeAsyncAfterSyncFallback(int depth) override;
+
+ protected:
+  using Clock = std::chrono::steady_clock;
+
+  enum class DeviceOp { kWrite, kRead, kSync, kZeroRange, kErase };
+
+  struct Service {
+    std::uint64_t us = 0;                 // Device time the operation takes
+    FileError result = FileError::kSuccess;
+    bool lost_completion = false;         // Async writes only
+  };
+
+  TimedMemoryFileOperations() = default;
+
+  // Price one operation. Called in the order the device serves them, one
+  // at a time (under a lock), so the subclass may keep state across calls.
+  virtual Service Serve(DeviceOp op, std::uint64_t offset, std::uint64_t length, bool async) = 0;
+
+  // Open a ramdisk of size with an idle device and no queue
+  FileError OpenTimed(std::uint64_t size);
+
+ private:
+  struct PendingWrite {
+    Clock::time_point due;
+    Clock::time_point submitted;
+    std::size_t size;
+    FileError result;
+    bool lost;
+    AsyncWriteCallback callback;
+  };
+
+  // Book the device for one operation; returns when it will be done
+  Clock::time_point Book(DeviceOp op, std::uint64_t offset, std::uint64_t length, bool async, Service& service);
+
+  // Synchronous operation: book it and sleep until the device is done
+  FileError Timed(DeviceOp op, std::uint64_t offset, std::uint64_t length);
+
+  // Complete pending writes, oldest first, until at most keep are left.
+  // Without wait only those that are already due; lost completions only
+  // when reap_lost. Returns false if a wait gave up after stall.
+  bool CompletePending(std::size_t keep, bool wait, bool reap_lost,
+                       Clock::duration stall = Clock::duration::max());
+
+  std::mutex device_mutex_;
+  Clock::time_point device_free_;
+
+  mutable std::mutex pending_mutex_;
+  std::condition_variable pending_cv_;
+  std::deque<PendingWrite> pending_;
+  // The watchdog may reduce the depth while a write waits for room
+  std::atomic<int> depth_{1};
+  std::atomic<int> active_depth_{1};
+  FileError async_error_ = FileError::kSuccess;
+};
+
+}  // namespace rpi_imager
+
+#endif  // FILE_OPERATIONS_TIMED_H_
@@ -0,0 +1,235 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "file_operations_tracing.h"
+
+#include <atomic>
+
+namespace rpi_imager {
+
+TracingFileOperations::TracingFileOperations(std::unique_ptr<FileOperations> inner, const std::string& trace_path)
+    : inner_(std::move(inner)) {
+  trace_.Open(trace_path);
+}
+
+TracingFileOperations::~TracingFileOperations() {
+  // Completion callbacks of queued writes still record
+  if (inner_->IsOpen())
+    inner_->Close();
+  trace_.Close();
+}
+
+void TracingFileOperations::Record(IoTraceOp op, FileError result, std::uint64_t offset, std::uint64_t length,
+                                   std::uint64_t submitUs, bool async) {
+  IoTraceRecord record;
+  record.op = op;
+  record.result = result;
+  record.async = async;
+  record.offset = offset;
+  record.length = length;
+  record.submitUs = submitUs;
+  record.completeUs = trace_.NowUs();
+  trace_.Append(record);
+}
+
+void TracingFileOperations::RecordEvent(IoTraceOp op, std::uint32_t value) {
+  IoTraceRecord record;
+  record.op = op;
+  record.value = value;
+  record.submitUs = record.completeUs = trace_.NowUs();
+  trace_.Append(record);
+}
+
+void TracingFileOperations::RecordOpen(FileError result) {
+  std::uint64_t size = 0;
+  if (result == FileError::kSuccess)
+    inner_->GetSize(size);
+  const std::uint64_t now = trace_.NowUs();
+  Record(IoTraceOp::kOpen, result, 0, size, now);
+  device_io_limits_ = inner_->GetDeviceIOLimits();
+  read_position_ = 0;
+}
+
+FileError TracingFileOperations::OpenDevice(const std::string& path) {
+  FileError result = inner_->OpenDevice(path);
+  RecordOpen(result);
+  return result;
+}
+
+FileError TracingFileOperations::CreateTestFile(const std::string& path, std::uint64_t size) {
+  FileError result = inner_->CreateTestFile(path, size);
+  RecordOpen(result);
+  return result;
+}
+
+FileError TracingFileOperations::Close() {
+  return inner_->Close();
+}
+
+FileError TracingFileOperations::WriteAtOffset(std::uint64_t offset, const std::uint8_t* data, std::size_t size) {
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->WriteAtOffset(offset, data, size);
+  Record(IoTraceOp::kWrite, result, offset, size, submit);
+  return result;
+}
+
+FileError TracingFileOperations::WriteSequential(const std::uint8_t* data, std::size_t size) {
+  const std::uint64_t offset = inner_->Tell();
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->WriteSequential(data, size);
+  Record(IoTraceOp::kWrite, result, offset, size, submit);
+  return result;
+}
+
+FileError TracingFileOperations::ReadSequential(std::uint8_t* data, std::size_t size, std::size_t& bytes_read) {
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->ReadSequential(data, size, bytes_read);
+  Record(IoTraceOp::kRead, result, read_position_, bytes_read, submit);
+  read_position_ += bytes_read;
+  return result;
+}
+
+FileError TracingFileOperations::ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                                              std::size_t size, std::size_t& bytes_read) {
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->ReadAtOffset(offset, data, size, bytes_read);
+  Record(IoTraceOp::kRead, result, offset, bytes_read, submit);
+  return result;
+}
+
+bool TracingFileOperations::SetAsyncQueueDepth(int depth) {
+  const bool ok = inner_->SetAsyncQueueDepth(depth);
+  RecordEvent(IoTraceOp::kQueueDepth, static_cast<std::uint32_t>(inner_->GetAsyncQueueDepth()));
+  return ok;
+}
+
+FileError TracingFileOperations::AsyncWriteSequential(const std::uint8_t* data, std::size_t size,
+                                                      AsyncWriteCallback callback) {
+  const std::uint64_t offset = inner_->Tell();
+  const std::uint64_t submit = trace_.NowUs();
+  auto recorded = std::make_shared<std::atomic<bool>>(false);
+  FileError result = inner_->AsyncWriteSequential(data, size,
+      [this, offset, size, submit, recorded, callback](FileError r, std::size_t written) {
+        recorded->store(true);
+        Record(IoTraceOp::kWrite, r, offset, size, submit, true);
+        (void)written;
+        if (callback) callback(r, written);
+      });
+  // Refused without being queued: the callback may never run
+  if (result != FileError::kSuccess && !recorded->load())
+    Record(IoTraceOp::kWrite, result, offset, size, submit, true);
+  return result;
+}
+
+FileError TracingFileOperations::AsyncReadSequential(std::uint8_t* data, std::size_t size,
+                                                     AsyncReadCallback callback) {
+  const std::uint64_t offset = read_position_;
+  read_position_ += size;
+  const std::uint64_t submit = trace_.NowUs();
+  return inner_->AsyncReadSequential(data, size,
+      [this, offset, submit, callback](FileError r, std::size_t bytes_read) {
+        Record(IoTraceOp::kRead, r, offset, bytes_read, submit, true);
+        if (callback) callback(r, bytes_read);
+      });
+}
+
+FileError TracingFileOperations::AsyncFlush(AsyncWriteCallback callback) {
+  const std::uint64_t submit = trace_.NowUs();
+  return inner_->AsyncFlush([this, submit, callback](FileError r, std::size_t written) {
+    Record(IoTraceOp::kSync, r, 0, 0, submit, true);
+    if (callback) callback(r, written);
+  });
+}
+
+FileError TracingFileOperations::AttemptSyncFallback() {
+  RecordEvent(IoTraceOp::kSyncFallback, 0);
+  return inner_->AttemptSyncFallback();
+}
+
+void TracingFileOperations::ReduceQueueDepthForRecovery(int newDepth) {
+  inner_->ReduceQueueDepthForRecovery(newDepth);
+  RecordEvent(IoTraceOp::kQueueDepth, static_cast<std::uint32_t>(newDepth));
+}
+
+void TracingFileOperations::RestoreQueueDepthAfterRecovery(int newDepth) {
+  inner_->RestoreQueueDepthAfterRecovery(newDepth);
+  RecordEvent(IoTraceOp::kQueueDepth, static_cast<std::uint32_t>(newDepth));
+}
+
+bool TracingFileOperations::DrainAndSwitchToSync(int stallTimeoutSeconds) {
+  RecordEvent(IoTraceOp::kSyncFallback, 0);
+  return inner_->DrainAndSwitchToSync(stallTimeoutSeconds);
+}
+
+bool TracingFileOperations::ResumeAsyncAfterSyncFallback(int depth) {
+  const bool resumed = inner_->ResumeAsyncAfterSyncFallback(depth);
+  if (resumed)
+    RecordEvent(IoTraceOp::kQueueDepth, static_cast<std::uint32_t>(depth));
+  return resumed;
+}
+
+FileError TracingFileOperations::Seek(std::uint64_t position) {
+  FileError result = inner_->Seek(position);
+  if (result == FileError::kSuccess)
+    read_position_ = position;
+  return result;
+}
+
+FileError TracingFileOperations::ForceSync() {
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->ForceSync();
+  Record(IoTraceOp::kSync, result, 0, 0, submit);
+  return result;
+}
+
+FileError TracingFileOperations::Flush() {
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->Flush();
+  Record(IoTraceOp::kSync, result, 0, 0, submit);
+  return result;
+}
+
+FileError TracingFileOperations::SyncToDevice() {
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->SyncToDevice();
+  Record(IoTraceOp::kSync, result, 0, 0, submit);
+  return result;
+}
+
+void TracingFileOperations::PrepareForSequentialRead(std::uint64_t offset, std::uint64_t length) {
+  inner_->PrepareForSequentialRead(offset, length);
+  read_position_ = offset;
+}
+
+FileError TracingFileOperations::CloneFrom(int src_fd, std::uint64_t length) {
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->CloneFrom(src_fd, length);
+  Record(IoTraceOp::kWrite, result, 0, length, submit);
+  return result;
+}
+
+FileError TracingFileOperations::SpliceFrom(int src_fd, std::uint64_t src_offset, std::size_t length) {
+  const std::uint64_t offset = inner_->Tell();
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->SpliceFrom(src_fd, src_offset, length);
+  Record(IoTraceOp::kWrite, result, offset, length, submit);
+  return result;
+}
+
+FileError TracingFileOperations::ZeroRange(std::uint64_t offset, std::uint64_t length) {
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->ZeroRange(offset, length);
+  Record(IoTraceOp::kZeroRange, result, offset, length, submit);
+  return result;
+}
+
+FileError TracingFileOperations::EraseDevice() {
+  const std::uint64_t submit = trace_.NowUs();
+  FileError result = inner_->EraseDevice();
+  Record(IoTraceOp::kErase, result, 0, 0, submit);
+  return result;
+}
+
+}  // namespace rpi_imager
@@ -0,0 +1,130 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef FILE_OPERATIONS_TRACING_H_
+#define FILE_OPERATIONS_TRACING_H_
+
+#include "file_operations.h"
+#include "iotrace.h"
+
+#include <memory>
+#include <string>
+
+namespace rpi_imager {
+
+// Records the I/O of another FileOperations to an I/O trace (see iotrace.h)
+// and otherwise passes everything through. Writes, reads, syncs, zeroed
+// ranges and erases are recorded with their submit and completion times
+// and result, async writes and flushes from their completion callbacks;
+// queue depth changes and sync fallbacks as they happen. Attach it in
+// place of the device's FileOperations before the device is opened, so
+// the trace starts with its size.
+//
+// Replay the trace with ReplayFileOperations.
+class TracingFileOperations : public FileOperations {
+ public:
+  TracingFileOperations(std::unique_ptr<FileOperations> inner, const std::string& trace_path);
+  ~TracingFileOperations() override;
+
+  TracingFileOperations(const TracingFileOperations&) = delete;
+  TracingFileOperations& operator=(const TracingFileOperations&) = delete;
+
+  bool IsRecording() const { return trace_.IsOpen(); }
+  FileOperations& Inner() { return *inner_; }
+
+  FileError OpenDevice(const std::string& path) override;
+  FileError CreateTestFile(const std::string& path, std::uint64_t size) override;
+  FileError WriteAtOffset(std::uint64_t offset, const std::uint8_t* data, std::size_t size) override;
+  FileError GetSize(std::uint64_t& size) override { return inner_->GetSize(size); }
+  FileError Close() override;
+  bool IsOpen() const override { return inner_->IsOpen(); }
+
+  FileError WriteSequential(const std::uint8_t* data, std::size_t size) override;
+  FileError ReadSequential(std::uint8_t* data, std::size_t size, std::size_t& bytes_read) override;
+  FileError ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                         std::size_t size, std::size_t& bytes_read) override;
+
+  bool SetAsyncQueueDepth(int depth) override;
+  int GetAsyncQueueDepth() const override { return inner_->GetAsyncQueueDepth(); }
+  bool IsAsyncIOSupported() const override { return inner_->IsAsyncIOSupported(); }
+  FileError AsyncWriteSequential(const std::uint8_t* data, std::size_t size,
+                                 AsyncWriteCallback callback = nullptr) override;
+  FileError AsyncReadSequential(std::uint8_t* data, std::size_t size,
+                                AsyncReadCallback callback = nullptr) override;
+  FileError WaitForPendingReads(int max_pending = 0) override { return inner_->WaitForPendingReads(max_pending); }
+  int GetPendingReadCount() const override { return inner_->GetPendingReadCount(); }
+  bool RegisterAsyncBuffers(const std::vector<AsyncBuffer>& buffers) override {
+    return inner_->RegisterAsyncBuffers(buffers);
+  }
+  void UnregisterAsyncBuffers() override { inner_->UnregisterAsyncBuffers(); }
+  int GetPendingWriteCount() const override { return inner_->GetPendingWriteCount(); }
+  void PollAsyncCompletions() override { inner_->PollAsyncCompletions(); }
+  FileError WaitForPendingWrites() override { return inner_->WaitForPendingWrites(); }
+  bool IsAsyncFlushSupported() const override { return inner_->IsAsyncFlushSupported(); }
+  FileError AsyncFlush(AsyncWriteCallback callback = nullptr) override;
+  void CancelAsyncIO() override { inner_->CancelAsyncIO(); }
+  FileError AttemptSyncFallback() override;
+  std::vector<PendingWriteInfo> GetPendingWritesSorted() const override { return inner_->GetPendingWritesSorted(); }
+  bool IsInSyncFallbackMode() const override { return inner_->IsInSyncFallbackMode(); }
+  void ReduceQueueDepthForRecovery(int newDepth) override;
+  void RestoreQueueDepthAfterRecovery(int newDepth) override;
+  bool DrainAndSwitchToSync(int stallTimeoutSeconds) override;
+  bool ResumeAsyncAfterSyncFallback(int depth) override;
+  void GetAsyncIOStats(uint32_t& wallClockMs, uint32_t& writeCount, uint32_t& minLatencyUs,
+                       uint32_t& maxLatencyUs, uint32_t& avgLatencyUs) const override {
+    inner_->GetAsyncIOStats(wallClockMs, writeCount, minLatencyUs, maxLatencyUs, avgLatencyUs);
+  }
+  const LatencyHistogram& GetAsyncWriteLatencyHistogram() const override {
+    return inner_->GetAsyncWriteLatencyHistogram();
+  }
+  void ResetAsyncIOStats() override { inner_->ResetAsyncIOStats(); }
+
+  FileError Seek(std::uint64_t position) override;
+  std::uint64_t Tell() const override { return inner_->Tell(); }
+
+  FileError ForceSync() override;
+  FileError Flush() override;
+  FileError SyncToDevice() override;
+
+  bool IsRangeWritebackSupported() const override { return inner_->IsRangeWritebackSupported(); }
+  FileError StartWriteback(std::uint64_t offset, std::uint64_t length) override {
+    return inner_->StartWriteback(offset, length);
+  }
+  FileError WaitWriteback(std::uint64_t offset, std::uint64_t length) override {
+    return inner_->WaitWriteback(offset, length);
+  }
+  void PrepareForSequentialRead(std::uint64_t offset, std::uint64_t length) override;
+
+  ZeroRangeMethod GetZeroRangeMethod() const override { return inner_->GetZeroRangeMethod(); }
+  bool IsRegularFile() const override { return inner_->IsRegularFile(); }
+  FileError CloneFrom(int src_fd, std::uint64_t length) override;
+  FileError SpliceFrom(int src_fd, std::uint64_t src_offset, std::size_t length) override;
+  FileError ZeroRange(std::uint64_t offset, std::uint64_t length) override;
+  FileError EraseDevice() override;
+
+  int GetHandle() const override { return inner_->GetHandle(); }
+  int GetLastErrorCode() const override { return inner_->GetLastErrorCode(); }
+  WriteErrorClass ClassifyLastWriteError() const override { return inner_->ClassifyLastWriteError(); }
+  bool IsDirectIOEnabled() const override { return inner_->IsDirectIOEnabled(); }
+  FileError SetDirectIOEnabled(bool enabled) override { return inner_->SetDirectIOEnabled(enabled); }
+  bool SetWriteThrough(bool enabled) override { return inner_->SetWriteThrough(enabled); }
+  bool IsWriteThrough() const override { return inner_->IsWriteThrough(); }
+  DirectIOInfo GetDirectIOInfo() const override { return inner_->GetDirectIOInfo(); }
+
+ private:
+  // Record an operation that started at submitUs and has just completed
+  void Record(IoTraceOp op, FileError result, std::uint64_t offset, std::uint64_t length,
+              std::uint64_t submitUs, bool async = false);
+  void RecordEvent(IoTraceOp op, std::uint32_t value);
+  void RecordOpen(FileError result);
+
+  std::unique_ptr<FileOperations> inner_;
+  IoTraceWriter trace_;
+  std::uint64_t read_position_ = 0;  // Of sequential reads, which Tell() does not report
+};
+
+}  // namespace rpi_imager
+
+#endif  // FILE_OPERATIONS_TRACING_H_
@@ -0,0 +1,171 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "gzipdecoder.h"
+#include "threadplacement.h"
+#include "threadcputime.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <cstring>
+
+// 15-bit window, gzip wrapper only
+static constexpr int GZIP_WINDOW_BITS = 15 + 16;
+
+static QString zlibError(int ret, const z_stream &strm)
+{
+    switch (ret)
+    {
+    case Z_MEM_ERROR:
+        return QStringLiteral("out of memory");
+    case Z_DATA_ERROR:
+        return strm.msg ? QStringLiteral("gzip data is corrupt: %1").arg(QString::fromLatin1(strm.msg))
+                        : QStringLiteral("gzip data is corrupt");
+    case Z_NEED_DICT:
+        return QStringLiteral("gzip stream needs a preset dictionary");
+    default:
+        return QStringLiteral("gzip decoder error %1").arg(ret);
+    }
+}
+
+GzipDecoder::GzipDecoder(RingBuffer *input, RingBuffer::Slot *firstSlot,
+                         std::shared_ptr<RingBuffer> output, QObject *parent)
+    : DecoderThread(input, firstSlot, std::move(output), 1, parent)
+    , _memberEnded(false)
+{
+    ::memset(&_strm, 0, sizeof(_strm));
+}
+
+GzipDecoder::~GzipDecoder()
+{
+    cancel();
+    wait();
+}
+
+bool GzipDecoder::isGzipStream(const char *data, size_t len)
+{
+    // ID1, ID2 and CM = deflate
+    return len >= 10
+        && static_cast<unsigned char>(data[0]) == 0x1f
+        && static_cast<unsigned char>(data[1]) == 0x8b
+        && data[2] == 0x08;
+}
+
+bool GzipDecoder::mayBeArchive(const char *data, size_t len)
+{
+    z_stream strm;
+    ::memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, GZIP_WINDOW_BITS) != Z_OK)
+        return true;
+
+    unsigned char header[512];
+    strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    strm.next_out = header;
+    strm.avail_out = sizeof(header);
+    while (strm.avail_out && len)
+    {
+        uInt chunk = len > UINT_MAX ? UINT_MAX : static_cast<uInt>(len);
+        strm.avail_in = chunk;
+        int ret = inflate(&strm, Z_NO_FLUSH);
+        len -= chunk - strm.avail_in;
+        if (ret != Z_OK)
+            break;
+    }
+    size_t decoded = sizeof(header) - strm.avail_out;
+    inflateEnd(&strm);
+
+    return _mayBeTarHeader(reinterpret_cast<const char *>(header), decoded);
+}
+
+bool GzipDecoder::_decode(const char *data, size_t len)
+{
+    _strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+
+    while (!_cancelled)
+    {
+        if (_memberEnded)
+        {
+            if (len == 0)
+                break;
+            // Another member follows the one just finished
+            inflateReset(&_strm);
+            _memberEnded = false;
+        }
+
+        if (!_acquireOutput())
+            return false;
+
+        // Decode directly into the write ring buffer slot
+        uInt room = static_cast<uInt>(qMin<size_t>(_outSlot->capacity - _outUsed, UINT_MAX));
+        uInt chunk = static_cast<uInt>(qMin<size_t>(len, UINT_MAX));
+        _strm.next_out = reinterpret_cast<Bytef *>(_outSlot->data + _outUsed);
+        _strm.avail_out = room;
+        _strm.avail_in = chunk;
+        int ret = inflate(&_strm, Z_NO_FLUSH);
+        size_t produced = room - _strm.avail_out;
+        len -= chunk - _strm.avail_in;
+        _advanceOutput(produced);
+
+        if (ret == Z_STREAM_END)
+        {
+            _memberEnded = true;
+            continue;
+        }
+        if (ret == Z_BUF_ERROR && len == 0)
+            break;  // No progress possible until more input arrives
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            _fail(zlibError(ret, _strm));
+            return false;
+        }
+        if (len == 0 && produced < room)
+            break;
+    }
+    return !_cancelled;
+}
+
+void GzipDecoder::run()
+{
+    ThreadPlacement::apply(ThreadPlacement::Role::Decompress);
+    ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::Decompress);
+    QElapsedTimer decodeTimer;
+    const bool initialised = inflateInit2(&_strm, GZIP_WINDOW_BITS) == Z_OK;
+    bool ok = initialised;
+    if (!ok)
+        _fail(zlibError(Z_MEM_ERROR, _strm));
+
+    while (ok && !_cancelled)
+    {
+        RingBuffer::Slot *slot = _nextInput();
+        if (!slot)
+            break;
+
+        decodeTimer.start();
+        ok = _decode(slot->data, slot->size);
+        _input->releaseReadSlot(slot);
+        _decodeMs += static_cast<quint64>(decodeTimer.elapsed());
+    }
+
+    if (ok && !_cancelled && !_failed)
+    {
+        if (_input->isStallTimeoutExceeded() || _input->isCancelled())
+            _fail(QStringLiteral("download interrupted"));
+        else if (!_memberEnded)
+            _fail(QStringLiteral("compressed data is truncated"));
+        else
+            _flushOutput();
+    }
+
+    if (initialised)
+        inflateEnd(&_strm);
+
+    if (_cancelled && !_failed)
+        _fail(QStringLiteral("cancelled"));
+
+    // Unblock the writer
+    _output->producerDone();
+
+    qDebug() << "GzipDecoder: consumed" << _bytesConsumed.load() / (1024 * 1024) << "MB,"
+             << "decode" << _decodeMs.load() << "ms, input wait" << _inputWaitMs.load() << "ms";
+}
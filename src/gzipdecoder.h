@@ -0,0 +1,52 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef GZIPDECODER_H
+#define GZIPDECODER_H
+
+#include <zlib.h>
+#include "decoderthread.h"
+
+/**
+ * @brief Native gzip decoder for raw .gz images
+ *
+ * Deflate streams cannot be split, so decoding is sequential, but it goes
+ * straight from the download ring buffer slots into the write ring buffer
+ * slots. Going through libarchive costs a copy of the whole image from its
+ * filter buffer into the caller's buffer. Concatenated gzip members (as
+ * written by pigz -i or by appending .gz files) are decoded in turn.
+ */
+class GzipDecoder : public DecoderThread
+{
+    Q_OBJECT
+
+public:
+    GzipDecoder(RingBuffer *input, RingBuffer::Slot *firstSlot,
+                std::shared_ptr<RingBuffer> output, QObject *parent = nullptr);
+    ~GzipDecoder() override;
+
+    /**
+     * @brief Check whether data starts with a gzip member header
+     */
+    static bool isGzipStream(const char *data, size_t len);
+
+    /**
+     * @brief Decode the start of the stream to check for a tar header
+     *
+     * Used to leave .tar.gz to libarchive.
+     */
+    static bool mayBeArchive(const char *data, size_t len);
+
+protected:
+    void run() override;
+
+private:
+    z_stream _strm;
+    bool _memberEnded;      // Last inflate() call finished a member
+
+    bool _decode(const char *data, size_t len);
+};
+
+#endif // GZIPDECODER_H
@@ -0,0 +1,95 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "hashpipeline.h"
+#include "threadplacement.h"
+#include "threadcputime.h"
+#include "tracepoints.h"
+#include <utility>
+
+HashPipeline::HashPipeline(HashFunction hash)
+    : _hash(std::move(hash))
+{
+    _thread = std::thread(&HashPipeline::_run, this);
+}
+
+HashPipeline::~HashPipeline()
+{
+    // Queued behind every buffer, so those are still hashed
+    Job stop;
+    stop.stop = true;
+    _push(std::move(stop));
+    _thread.join();
+}
+
+HashPipeline::Ticket HashPipeline::submit(const char *buf, size_t len, std::function<void()> done)
+{
+    Job job;
+    job.buf = buf;
+    job.len = len;
+    job.done = std::move(done);
+    _push(std::move(job));
+    return ++_submitted;
+}
+
+void HashPipeline::wait(Ticket ticket)
+{
+    Ticket completed = _completed.load(std::memory_order_acquire);
+    while (completed < ticket)
+    {
+        _completed.wait(completed, std::memory_order_acquire);
+        completed = _completed.load(std::memory_order_acquire);
+    }
+}
+
+void HashPipeline::_push(Job &&job)
+{
+    const size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    while (head - tail >= kDepth)
+    {
+        _tail.wait(tail, std::memory_order_acquire);
+        tail = _tail.load(std::memory_order_acquire);
+    }
+
+    _jobs[head & (kDepth - 1)] = std::move(job);
+    _head.store(head + 1, std::memory_order_release);
+    _head.notify_one();
+}
+
+void HashPipeline::_run()
+{
+    ThreadPlacement::apply(ThreadPlacement::Role::Hash);
+    ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::Hash);
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+        size_t head = _head.load(std::memory_order_acquire);
+        while (head == tail)
+        {
+            _head.wait(head, std::memory_order_acquire);
+            head = _head.load(std::memory_order_acquire);
+        }
+
+        Job &job = _jobs[tail & (kDepth - 1)];
+        if (job.stop)
+            return;
+
+        RPI_TRACE1(hash_chunk_begin, job.len);
+        _hash(job.buf, job.len);
+        RPI_TRACE1(hash_chunk_end, job.len);
+        std::function<void()> done = std::move(job.done);
+        job.done = nullptr;
+
+        // The slot is free for the producer from here on
+        _tail.store(++tail, std::memory_order_release);
+        _tail.notify_one();
+
+        if (done)
+            done();
+        _completed.fetch_add(1, std::memory_order_release);
+        _completed.notify_all();
+    }
+}
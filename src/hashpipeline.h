@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef HASHPIPELINE_H
+#define HASHPIPELINE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+/**
+ * @brief Hashes buffers in order on a dedicated thread, several buffers deep
+ *
+ * The writer queues each buffer as it writes it and carries on; the hashing
+ * thread works through the queue in submission order, so a stateful hash
+ * sees the stream exactly as written. Up to kDepth buffers can be queued
+ * before submit() waits, which absorbs short bursts where writing outpaces
+ * hashing.
+ *
+ * The queue is a single producer / single consumer ring: queueing a buffer
+ * is a handful of stores and a release, with no locks or allocation beyond
+ * the optional callback. Only one thread may call submit().
+ *
+ * A buffer must stay valid until it has been hashed. Callers that hand out
+ * the buffer elsewhere too (e.g. to async writes) pass a done callback,
+ * which runs on the hashing thread and acts as the hash's share of the
+ * buffer's release; nobody has to block waiting for the hash.
+ */
+class HashPipeline
+{
+public:
+    using HashFunction = std::function<void(const char *buf, size_t len)>;
+    // Sequence number of a queued buffer; the first is 1
+    using Ticket = std::uint64_t;
+
+    static constexpr size_t kDepth = 16;  // Must be a power of two
+    static_assert((kDepth & (kDepth - 1)) == 0, "kDepth must be a power of two");
+
+    explicit HashPipeline(HashFunction hash);
+    // Hashes whatever is still queued, then stops the thread
+    ~HashPipeline();
+    HashPipeline(const HashPipeline &) = delete;
+    HashPipeline &operator=(const HashPipeline &) = delete;
+
+    /**
+     * @brief Queue buf for hashing after everything queued before it
+     *
+     * Waits while kDepth buffers are already queued.
+     *
+     * @param done Runs on the hashing thread once buf has been hashed
+     */
+    Ticket submit(const char *buf, size_t len, std::function<void()> done = nullptr);
+
+    bool isDone(Ticket ticket) const noexcept
+    {
+        return _completed.load(std::memory_order_acquire) >= ticket;
+    }
+
+    // Wait until the buffer with this ticket, and all before it, are hashed
+    void wait(Ticket ticket);
+
+    // Wait until everything queued so far is hashed
+    void waitAll() { wait(_submitted); }
+
+private:
+    struct Job {
+        const char *buf = nullptr;
+        size_t len = 0;
+        std::function<void()> done;
+        bool stop = false;
+    };
+
+    void _push(Job &&job);
+    void _run();
+
+    HashFunction _hash;
+    Ticket _submitted = 0;  // Producer only
+
+    alignas(64) std::atomic<size_t> _head{0};        // Written by the producer
+    alignas(64) std::atomic<size_t> _tail{0};        // Written by the hashing thread
+    alignas(64) std::atomic<Ticket> _completed{0};   // Written by the hashing thread
+    std::array<Job, kDepth> _jobs;
+    std::thread _thread;
+};
+
+#endif // HASHPIPELINE_H
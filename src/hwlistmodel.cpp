@@ -7,37 +7,38 @@
 #include "imagewriter.h"
 
 #include <QJsonObject>
-#include <QJsonDocument>
 #include <QDebug>
 #include <QJsonValue>
 
+namespace {
+    // SoC families an rpiboot chip name can belong to
+    enum ChipFamily : quint8 {
+        Bcm2712 = 1 << 0,
+        Bcm2711 = 1 << 1,
+        Bcm2836 = 1 << 2,  // Pi 2 and 3
+        Bcm2835 = 1 << 3
+    };
+}
+
 HWListModel::HWListModel(ImageWriter &imageWriter)
     : QAbstractListModel(&imageWriter), _imageWriter(imageWriter) {}
 
 bool HWListModel::reload()
 {
-    QJsonDocument doc = _imageWriter.getFilteredOSlistDocument();
-    QJsonObject root = doc.object();
-
-    if (root.isEmpty() || !doc.isObject()) {
-        qWarning() << Q_FUNC_INFO << "Invalid root";
-        return false;
-    }
-
-    QJsonValue imager = root.value("imager");
-
-    if (!imager.isObject()) {
-        qWarning() << Q_FUNC_INFO << "missing imager";
-        return false;
-    }
-
-    QJsonValue devices = imager.toObject().value("devices");
+    // Only the "imager" object is needed, not the filtered OS list
+    QJsonValue devices = _imageWriter.osListImagerMetadata().value("devices");
 
     if (!devices.isArray()) {
         // just means list hasn't been loaded yet
         return false;
     }
 
+    // The same devices as last time: keep the model and its delegates
+    if (devices.toArray() == _devicesJson && !_hwDevices.isEmpty()) {
+        setCurrentIndex(_defaultIndex);
+        return true;
+    }
+
     beginResetModel();
     _currentIndex = -1;
     // Replace contents on reload to avoid duplicate entries when re-entering the step
@@ -69,12 +70,15 @@ bool HWListModel::reload()
             deviceObj["matching_type"].toString(),
             deviceObj["architecture"].toString()
         };
+        hwDevice.chipFamilies = chipFamiliesOfTags(hwDevice.tags);
         _hwDevices.append(hwDevice);
 
         if (deviceObj["default"].isBool() && deviceObj["default"].toBool())
             indexOfDefault = _hwDevices.size() - 1;
     }
 
+    _devicesJson = deviceArray;
+    _defaultIndex = indexOfDefault;
     endResetModel();
 
     setCurrentIndex(indexOfDefault);
@@ -124,11 +128,7 @@ QVariant HWListModel::data(const QModelIndex &index, int role) const {
     case ArchitectureRole:
         return device.architecture;
     case IsUsbBootConnectedRole:
-        for (const auto &chip : _connectedRpibootChips) {
-            if (tagsMatchChip(device.tags, chip))
-                return true;
-        }
-        return false;
+        return (device.chipFamilies & _connectedChipFamilies) != 0;
     }
 
     return {};
@@ -200,32 +200,45 @@ int HWListModel::currentIndex() const {
 }
 
 void HWListModel::setConnectedRpibootChips(const QStringList &chips) {
-    if (_connectedRpibootChips == chips)
+    quint8 families = 0;
+    for (const auto &chip : chips)
+        families |= chipFamily(chip);
+    if (families == _connectedChipFamilies)
         return;
-    _connectedRpibootChips = chips;
-    if (!_hwDevices.isEmpty())
-        emit dataChanged(index(0), index(_hwDevices.size() - 1), {IsUsbBootConnectedRole});
+
+    // Only rows whose answer changed are announced
+    const quint8 changed = families ^ _connectedChipFamilies;
+    _connectedChipFamilies = families;
+    for (int row = 0; row < _hwDevices.size(); ++row) {
+        if (_hwDevices[row].chipFamilies & changed)
+            emit dataChanged(index(row), index(row), {IsUsbBootConnectedRole});
+    }
 }
 
-bool HWListModel::tagsMatchChip(const QJsonArray &tags, const QString &chipName) {
-    QStringList prefixes;
+quint8 HWListModel::chipFamily(const QString &chipName) {
     if (chipName == QLatin1String("BCM2712"))
-        prefixes = {QStringLiteral("pi5-")};
-    else if (chipName == QLatin1String("BCM2711"))
-        prefixes = {QStringLiteral("pi4-")};
-    else if (chipName.startsWith(QLatin1String("BCM2836")) || chipName == QLatin1String("BCM2836/7"))
-        prefixes = {QStringLiteral("pi2-"), QStringLiteral("pi3-")};
-    else if (chipName == QLatin1String("BCM2835"))
-        prefixes = {QStringLiteral("pi1-")};
-    else
-        return false;
+        return Bcm2712;
+    if (chipName == QLatin1String("BCM2711"))
+        return Bcm2711;
+    if (chipName.startsWith(QLatin1String("BCM2836")))
+        return Bcm2836;
+    if (chipName == QLatin1String("BCM2835"))
+        return Bcm2835;
+    return 0;
+}
 
+quint8 HWListModel::chipFamiliesOfTags(const QJsonArray &tags) {
+    quint8 families = 0;
     for (const auto &tag : tags) {
         const QString t = tag.toString();
-        for (const auto &prefix : prefixes) {
-            if (t.startsWith(prefix))
-                return true;
-        }
+        if (t.startsWith(QLatin1String("pi5-")))
+            families |= Bcm2712;
+        else if (t.startsWith(QLatin1String("pi4-")))
+            families |= Bcm2711;
+        else if (t.startsWith(QLatin1String("pi2-")) || t.startsWith(QLatin1String("pi3-")))
+            families |= Bcm2836;
+        else if (t.startsWith(QLatin1String("pi1-")))
+            families |= Bcm2835;
     }
-    return false;
+    return families;
 }
@@ -45,6 +45,7 @@ public:
         QString description;
         QString matchingType;
         QString architecture; // Preferred architecture (armel, armhf, armv8)
+        quint8 chipFamilies = 0; // SoC families its tags name, see chipFamily()
 
         bool isInclusive() const {
             return matchingType == QLatin1String("inclusive");
@@ -78,13 +79,17 @@ protected:
     QVariant data(const QModelIndex &index, int role) const override;
 
 private:
-    static bool tagsMatchChip(const QJsonArray &tags, const QString &chipName);
+    // One bit per SoC family an rpiboot chip name belongs to, 0 if unknown
+    static quint8 chipFamily(const QString &chipName);
+    static quint8 chipFamiliesOfTags(const QJsonArray &tags);
 
     QVector<HardwareDevice> _hwDevices;
+    QJsonArray _devicesJson;  // What _hwDevices was built from
+    int _defaultIndex = -1;
     ImageWriter &_imageWriter;
     int _currentIndex = -1;
     QString _lastSelectedDeviceName;  // Track actual device to detect changes
-    QStringList _connectedRpibootChips;
+    quint8 _connectedChipFamilies = 0;
 };
 
 #endif
@@ -7,15 +7,46 @@
 #include "iconmultifetcher.h"
 
 #include <QQuickTextureFactory>
+#include <QBuffer>
+#include <QImageReader>
 #include <QDebug>
 
+namespace {
+
+// Size to decode at: the natural size shrunk to fit the requested one,
+// keeping the aspect ratio (a non-positive dimension is unconstrained)
+QSize displaySize(const QSize &natural, const QSize &requested)
+{
+    if (!natural.isValid() || natural.isEmpty()) {
+        return QSize();
+    }
+    const int width = requested.width() > 0 ? requested.width() : natural.width();
+    const int height = requested.height() > 0 ? requested.height() : natural.height();
+    if (natural.width() <= width && natural.height() <= height) {
+        return QSize();  // Never upscale
+    }
+    return natural.scaled(width, height, Qt::KeepAspectRatio);
+}
+
+} // namespace
+
 // ----------------------------------------------------------------------------
 // IconImageResponse
 // ----------------------------------------------------------------------------
 
-IconImageResponse::IconImageResponse(const QUrl &url)
-    : _urlKey(url.toString())  // Pre-compute cache key
+IconImageResponse::IconImageResponse(const QUrl &url, const QSize &requestedSize)
+    : _urlKey(url.toString()),  // Pre-compute cache key
+      _requestedSize(requestedSize)
 {
+    _imageKey = QStringLiteral("%1@%2x%3").arg(_urlKey).arg(requestedSize.width()).arg(requestedSize.height());
+    
+    // Already decoded at this size: finish as soon as the caller has connected
+    _image = IconMultiFetcher::instance().getCachedImage(_imageKey);
+    if (!_image.isNull()) {
+        QMetaObject::invokeMethod(this, &IconImageResponse::finished, Qt::QueuedConnection);
+        return;
+    }
+    
     // Queue fetch with the multi-fetcher (efficient for many concurrent icons)
     IconMultiFetcher::instance().queueFetch(this, url);
 }
@@ -38,8 +69,16 @@ void IconImageResponse::onFetchComplete(const QString &cacheKey, const QString &
         if (data.isEmpty()) {
             _errorString = QStringLiteral("Cache miss");
         } else {
-            if (!_image.loadFromData(data)) {
+            QBuffer buffer(&data);
+            QImageReader reader(&buffer);
+            const QSize scaled = displaySize(reader.size(), _requestedSize);
+            if (scaled.isValid()) {
+                reader.setScaledSize(scaled);
+            }
+            if (!reader.read(&_image)) {
                 _errorString = QStringLiteral("Failed to decode image");
+            } else {
+                IconMultiFetcher::instance().addCachedImage(_imageKey, _image);
             }
         }
     }
@@ -66,8 +105,8 @@ IconImageProvider::IconImageProvider()
 
 IconImageProvider::~IconImageProvider() = default;
 
-QQuickImageResponse *IconImageProvider::requestImageResponse(const QString &id, const QSize &)
+QQuickImageResponse *IconImageProvider::requestImageResponse(const QString &id, const QSize &requestedSize)
 {
     QUrl url(id);
-    return new IconImageResponse(url);
+    return new IconImageResponse(url, requestedSize);
 }
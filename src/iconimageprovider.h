@@ -18,13 +18,14 @@
  * HTTP/2 multiplexing and connection pooling. Supports cancellation.
  * 
  * Data is looked up directly from the shared cache to avoid copies through
- * the Qt signal system.
+ * the Qt signal system. Decoded images are cached at the requested size, so
+ * an icon that has been shown before is not decoded again.
  */
 class IconImageResponse final : public QQuickImageResponse
 {
     Q_OBJECT
 public:
-    explicit IconImageResponse(const QUrl &url);
+    IconImageResponse(const QUrl &url, const QSize &requestedSize);
     
     QQuickTextureFactory *textureFactory() const override;
     QString errorString() const override { return _errorString; }
@@ -48,6 +49,8 @@ public slots:
 
 private:
     QString _urlKey;  // Cache key for looking up data
+    QString _imageKey;  // Cache key for the decoded image at _requestedSize
+    QSize _requestedSize;
     QImage _image;
     QString _errorString;
     std::atomic<bool> _cancelled{false};
@@ -6,14 +6,31 @@
 #include "iconmultifetcher.h"
 #include "iconimageprovider.h"
 #include "curlnetworkconfig.h"
+#include "bandwidthscheduler.h"
+#include "threadplacement.h"
+#include "memorypressuremonitor.h"
 
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+
+#include <algorithm>
 
 // Maximum concurrent connections for icon fetching
 // This limits both total connections and connections per host
 static constexpr long MAX_TOTAL_CONNECTIONS = 10;
 static constexpr long MAX_HOST_CONNECTIONS = 6;
 
+// Disk cache file format
+static constexpr quint32 DISK_MAGIC = 0x49434f4e;  // "ICON"
+static constexpr quint32 DISK_VERSION = 1;
+
 IconMultiFetcher& IconMultiFetcher::instance()
 {
     static IconMultiFetcher instance;
@@ -23,6 +40,9 @@ IconMultiFetcher& IconMultiFetcher::instance()
 IconMultiFetcher::IconMultiFetcher(QObject *parent)
     : QObject(parent)
 {
+    _diskCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+                    QDir::separator() + "icons";
+
     // Create and start the dedicated fetcher thread
     _thread = QThread::create([this]() { runEventLoop(); });
     _thread->setObjectName(QStringLiteral("IconMultiFetcher"));
@@ -66,6 +86,9 @@ void IconMultiFetcher::clearCache()
     _cache.clear();
     _cacheOrder.clear();
     _cacheBytes = 0;
+    _decodedCache.clear();
+    _pendingRequests.removeIf([](const PendingRequest &req) { return req.prefetch; });
+    _prefetchUrls.clear();
     qDebug() << "IconMultiFetcher: Cache cleared";
 }
 
@@ -79,6 +102,22 @@ QByteArray IconMultiFetcher::getCachedData(const QString &urlKey) const
     return QByteArray();
 }
 
+QImage IconMultiFetcher::getCachedImage(const QString &imageKey) const
+{
+    QMutexLocker locker(&_mutex);
+    const QImage *image = _decodedCache.object(imageKey);
+    return image ? *image : QImage();
+}
+
+void IconMultiFetcher::addCachedImage(const QString &imageKey, const QImage &image)
+{
+    if (image.isNull()) {
+        return;
+    }
+    QMutexLocker locker(&_mutex);
+    _decodedCache.insert(imageKey, new QImage(image), image.sizeInBytes());
+}
+
 // Limit pending requests to prevent memory exhaustion DoS
 static constexpr int MaxPendingRequests = 500;
 
@@ -146,9 +185,51 @@ void IconMultiFetcher::cancelFetch(IconImageResponse *response)
     _hasWork.wakeAll();
 }
 
+void IconMultiFetcher::setVisibleIcons(const QStringList &visible, const QStringList &upcoming)
+{
+    if (_shutdown.load()) {
+        return;
+    }
+    
+    QMutexLocker locker(&_mutex);
+    _visibleUrls = QSet<QString>(visible.cbegin(), visible.cend());
+    
+    // Replace the previous prefetches; anything still upcoming is queued again
+    _pendingRequests.removeIf([](const PendingRequest &req) { return req.prefetch; });
+    _prefetchUrls.clear();
+    for (const QString &urlKey : upcoming) {
+        if (_pendingRequests.size() >= MaxPendingRequests) {
+            break;
+        }
+        if (urlKey.isEmpty() || _cache.contains(urlKey) || _visibleUrls.contains(urlKey)
+            || _prefetchUrls.contains(urlKey)) {
+            continue;
+        }
+        _prefetchUrls.insert(urlKey);
+        _pendingRequests.enqueue({nullptr, QUrl(urlKey), urlKey, true});
+    }
+    _hasWork.wakeAll();
+    
+#if LIBCURL_VERSION_NUM >= 0x074400
+    if (_multi) {
+        curl_multi_wakeup(_multi);
+    }
+#endif
+}
+
+IconMultiFetcher::Priority IconMultiFetcher::priorityOf(const PendingRequest &req) const
+{
+    // Already have mutex from caller
+    if (req.prefetch) {
+        return PrefetchPriority;
+    }
+    return _visibleUrls.contains(req.urlKey) ? VisiblePriority : NormalPriority;
+}
+
 void IconMultiFetcher::runEventLoop()
 {
     qDebug() << "IconMultiFetcher: Event loop starting";
+    ThreadPlacement::apply(ThreadPlacement::Role::Background);
     
     // Initialize curl_multi handle
     _multi = curl_multi_init();
@@ -164,7 +245,20 @@ void IconMultiFetcher::runEventLoop()
     // Enable HTTP/2 multiplexing
     curl_multi_setopt(_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
     
+    pruneDiskCache();
+
+    const bool followMemoryPressure = QSettings().value("memorypressure/enabled", true).toBool();
+    int memoryPressureScale = 100;
+    
     while (!_shutdown.load()) {
+        if (followMemoryPressure) {
+            const int scale = MemoryPressureMonitor::instance().scalePercent();
+            if (scale != memoryPressureScale) {
+                memoryPressureScale = scale;
+                applyMemoryPressure(scale);
+            }
+        }
+
         // Process any pending requests
         processPendingRequests();
         
@@ -223,7 +317,7 @@ void IconMultiFetcher::processPendingRequests()
         PendingRequest req = _pendingRequests.dequeue();
         
         // Skip if response was deleted
-        if (!req.response) {
+        if (!req.response && !req.prefetch) {
             continue;
         }
         
@@ -244,18 +338,32 @@ void IconMultiFetcher::processPendingRequests()
         }
     }
     
+    // Visible icons first; the sort is stable, so arrival order holds within a priority
+    std::stable_sort(stillPending.begin(), stillPending.end(),
+                     [this](const PendingRequest &a, const PendingRequest &b) {
+                         return priorityOf(a) > priorityOf(b);
+                     });
+    
+    // Requests that found every transfer slot busy, still in priority order
+    QQueue<PendingRequest> deferred;
+    
     // Now process remaining pending requests
     while (!stillPending.isEmpty()) {
         PendingRequest req = stillPending.dequeue();
         
         // Skip if response was deleted while waiting
-        if (!req.response) {
+        if (!req.response && !req.prefetch) {
             continue;
         }
         
         // Use pre-computed urlKey (no QString allocation here)
         const QString &urlKey = req.urlKey;
         
+        // Scrolled out of the prefetch window while the lock was released
+        if (req.prefetch && !_prefetchUrls.contains(urlKey)) {
+            continue;
+        }
+        
         // Check if this URL is already being fetched (coalescing)
         auto inFlightIt = _inFlightUrls.find(urlKey);
         if (inFlightIt != _inFlightUrls.end()) {
@@ -263,18 +371,80 @@ void IconMultiFetcher::processPendingRequests()
             CURL *existingEasy = inFlightIt.value();
             auto transferIt = _activeTransfers.find(existingEasy);
             if (transferIt != _activeTransfers.end()) {
-                transferIt.value()->waitingResponses.append(req.response);
+                if (req.response) {
+                    transferIt.value()->waitingResponses.append(req.response);
+                }
                 continue; // No new fetch needed
             }
         }
         
+        // An earlier request in this batch may have filled the cache from disk
+        auto cacheIt = _cache.constFind(urlKey);
+        if (cacheIt != _cache.constEnd()) {
+            const QString errorMsg = cacheIt->errorMsg;
+            locker.unlock();
+            if (req.response) {
+                QMetaObject::invokeMethod(req.response.data(), "onFetchComplete",
+                                          Qt::QueuedConnection,
+                                          Q_ARG(QString, urlKey),
+                                          Q_ARG(QString, errorMsg));
+            }
+            locker.relock();
+            continue;
+        }
+        
+        // Serve a copy from the last run straight away; if it is more than a
+        // day old, revalidate it in the background for next time
+        DiskEntry disk;
+        locker.unlock();
+        const bool onDisk = isDiskCacheable(req.url) && loadFromDisk(urlKey, &disk);
+        locker.relock();
+        if (onDisk) {
+            addToCache(urlKey, disk.body);
+            locker.unlock();
+            if (req.response) {
+                QMetaObject::invokeMethod(req.response.data(), "onFetchComplete",
+                                          Qt::QueuedConnection,
+                                          Q_ARG(QString, urlKey),
+                                          Q_ARG(QString, QString()));
+            }
+            
+            // Revalidation is background work, so it only takes a free slot
+            const qint64 age = QDateTime::currentSecsSinceEpoch() - disk.storedAt;
+            if (age >= DiskRevalidateSecs && !_inFlightUrls.contains(urlKey)
+                && _activeTransfers.size() < MaxActiveTransfers) {
+                CURL *easy = createEasyHandle(req.url, urlKey, &disk);
+                if (easy) {
+                    _inFlightUrls[urlKey] = easy;
+                    CURLMcode mc = curl_multi_add_handle(_multi, easy);
+                    if (mc != CURLM_OK) {
+                        qWarning() << "IconMultiFetcher: Failed to add handle:" << curl_multi_strerror(mc);
+                        _inFlightUrls.remove(urlKey);
+                        cleanupTransfer(easy);
+                    }
+                }
+            }
+            locker.relock();
+            continue;
+        }
+        
+        // Keep the rest queued until a transfer finishes
+        if (_activeTransfers.size() >= MaxActiveTransfers) {
+            deferred.enqueue(req);
+            continue;
+        }
+        
         locker.unlock();
         CURL *easy = createEasyHandle(req.url, urlKey);
         locker.relock();
         
         if (easy) {
             // Add response to waiting list
-            _activeTransfers[easy]->waitingResponses.append(req.response);
+            TransferData *data = _activeTransfers[easy];
+            data->prefetch = req.prefetch;
+            if (req.response) {
+                data->waitingResponses.append(req.response);
+            }
             _inFlightUrls[urlKey] = easy;
             
             CURLMcode mc = curl_multi_add_handle(_multi, easy);
@@ -294,9 +464,16 @@ void IconMultiFetcher::processPendingRequests()
         }
     }
     
+    // Deferred requests go back ahead of anything queued meanwhile
+    if (!deferred.isEmpty()) {
+        deferred.append(_pendingRequests);
+        _pendingRequests = std::move(deferred);
+    }
+    
     // Handle cancellations for active transfers
     QSet<IconImageResponse*> toCancel = _cancelledResponses;
     _cancelledResponses.clear();
+    const QSet<QString> prefetchUrls = _prefetchUrls;
     locker.unlock();
     
     // Remove cancelled/deleted responses from waiting lists
@@ -319,8 +496,10 @@ void IconMultiFetcher::processPendingRequests()
             }
         }
         
-        // If no responses are waiting anymore, cancel the transfer
-        if (data->waitingResponses.isEmpty()) {
+        // If no responses are waiting anymore, cancel the transfer, unless
+        // it is a prefetch whose icon is still about to scroll into view
+        const bool prefetchWanted = data->prefetch && prefetchUrls.contains(data->urlKey);
+        if (data->waitingResponses.isEmpty() && !data->revalidating && !prefetchWanted) {
             CURL *easy = it.key();
             _inFlightUrls.remove(data->urlKey);  // Use pre-computed key
             curl_multi_remove_handle(_multi, easy);
@@ -359,22 +538,52 @@ void IconMultiFetcher::processCompletedTransfers()
                 qDebug() << "IconMultiFetcher: Fetch failed for" << data->url.host() << "-" << errorMsg;
             }
             
-            // Add to cache (including failures, to avoid retrying broken URLs)
-            // Note: Negative caching is intentional for icons because:
-            // 1. Broken icon URLs are typically permanent (wrong URL in OS list)
-            // 2. Retrying 50 broken URLs on every scroll would be wasteful
-            // 3. Cache is cleared when switching repositories anyway
-            // TODO: Consider adding TTL for negative cache entries if needed
-            {
+            if (data->revalidating) {
+                // The disk copy is already on screen; keep it unless the
+                // server sent a new one
+                long httpCode = 0;
+                curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &httpCode);
+                const bool replaced = errorMsg.isEmpty() && httpCode != 304 && !data->buffer.isEmpty();
+                const QByteArray body = replaced ? data->buffer : data->cached.body;
+                
+                if (errorMsg.isEmpty()) {
+                    DiskEntry entry = data->cached;
+                    if (replaced) {
+                        entry.body = body;
+                        entry.etag = data->etag;
+                        entry.lastModified = data->lastModified;
+                    }
+                    entry.storedAt = QDateTime::currentSecsSinceEpoch();
+                    storeOnDisk(data->urlKey, entry);
+                }
+                errorMsg.clear();
+                
                 QMutexLocker locker(&_mutex);
-                addToCache(data->urlKey, data->buffer);  // Use pre-computed key
-                if (!errorMsg.isEmpty()) {
-                    // Update cache entry with error message
-                    auto cacheIt = _cache.find(data->urlKey);
-                    if (cacheIt != _cache.end()) {
-                        cacheIt->errorMsg = errorMsg;
+                addToCache(data->urlKey, body, replaced);
+            } else {
+                // Add to cache (including failures, to avoid retrying broken URLs)
+                // Note: Negative caching is intentional for icons because:
+                // 1. Broken icon URLs are typically permanent (wrong URL in OS list)
+                // 2. Retrying 50 broken URLs on every scroll would be wasteful
+                // 3. Cache is cleared when switching repositories anyway
+                // TODO: Consider adding TTL for negative cache entries if needed
+                {
+                    QMutexLocker locker(&_mutex);
+                    addToCache(data->urlKey, data->buffer);  // Use pre-computed key
+                    if (!errorMsg.isEmpty()) {
+                        // Update cache entry with error message
+                        auto cacheIt = _cache.find(data->urlKey);
+                        if (cacheIt != _cache.end()) {
+                            cacheIt->errorMsg = errorMsg;
+                        }
                     }
                 }
+                
+                // Failures stay in memory only, so the next run tries again
+                if (errorMsg.isEmpty() && !data->buffer.isEmpty() && isDiskCacheable(data->url)) {
+                    storeOnDisk(data->urlKey, {data->buffer, data->etag, data->lastModified,
+                                               QDateTime::currentSecsSinceEpoch()});
+                }
             }
             
             // Deliver cache key to all waiting responses (they look up data directly)
@@ -397,7 +606,7 @@ void IconMultiFetcher::processCompletedTransfers()
     }
 }
 
-CURL* IconMultiFetcher::createEasyHandle(const QUrl &url, const QString &urlKey)
+CURL* IconMultiFetcher::createEasyHandle(const QUrl &url, const QString &urlKey, const DiskEntry *cached)
 {
     // Security: Only allow HTTP/HTTPS/file schemes.
     // file:// is needed for local repositories with local icons.
@@ -441,6 +650,18 @@ CURL* IconMultiFetcher::createEasyHandle(const QUrl &url, const QString &urlKey)
     curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, headerCallback);
     curl_easy_setopt(easy, CURLOPT_HEADERDATA, data);
     
+    // Revalidate a disk copy: a 304 leaves the body empty
+    if (cached) {
+        data->revalidating = true;
+        data->cached = *cached;
+        if (!cached->etag.isEmpty())
+            data->headers = curl_slist_append(data->headers, ("If-None-Match: " + cached->etag).constData());
+        if (!cached->lastModified.isEmpty())
+            data->headers = curl_slist_append(data->headers, ("If-Modified-Since: " + cached->lastModified).constData());
+        if (data->headers)
+            curl_easy_setopt(easy, CURLOPT_HTTPHEADER, data->headers);
+    }
+    
     // Store in active transfers map
     _activeTransfers[easy] = data;
     
@@ -457,13 +678,19 @@ void IconMultiFetcher::cleanupTransfer(CURL *easy)
     curl_easy_cleanup(easy);
 }
 
-void IconMultiFetcher::addToCache(const QString &urlKey, const QByteArray &data)
+void IconMultiFetcher::addToCache(const QString &urlKey, const QByteArray &data, bool replace)
 {
     // Already have mutex from caller
     
     // Check if already cached (shouldn't happen, but be safe)
-    if (_cache.contains(urlKey)) {
-        return;
+    auto existing = _cache.find(urlKey);
+    if (existing != _cache.end()) {
+        if (!replace) {
+            return;
+        }
+        _cacheBytes -= existing->data.size();
+        _cache.erase(existing);
+        _cacheOrder.removeOne(urlKey);
     }
     
     // Evict if needed before adding
@@ -479,7 +706,7 @@ void IconMultiFetcher::evictIfNeeded()
 {
     // Already have mutex from caller
     
-    while ((_cacheBytes > MaxCacheBytes || _cache.size() > MaxCacheEntries) 
+    while ((_cacheBytes > _cacheLimitBytes || _cache.size() > _cacheLimitEntries) 
            && !_cacheOrder.isEmpty()) {
         // Evict oldest entry
         QString oldest = _cacheOrder.takeFirst();
@@ -491,10 +718,23 @@ void IconMultiFetcher::evictIfNeeded()
     }
 }
 
+void IconMultiFetcher::applyMemoryPressure(int percent)
+{
+    QMutexLocker locker(&_mutex);
+    _cacheLimitBytes = MaxCacheBytes * percent / 100;
+    _cacheLimitEntries = qMax(1, MaxCacheEntries * percent / 100);
+    evictIfNeeded();
+    // Decoded images are the larger copy, and can be decoded again
+    _decodedCache.setMaxCost(MaxDecodedCacheBytes * percent / 100);
+    qDebug() << "IconMultiFetcher: caches at" << percent << "% of normal," << _cache.size()
+             << "icons," << (_cacheBytes / 1024) << "KB";
+}
+
 size_t IconMultiFetcher::writeCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
 {
     auto *data = static_cast<TransferData*>(userdata);
     size_t totalSize = size * nmemb;
+    BandwidthScheduler::instance().acquire(BandwidthScheduler::Priority::Interactive, static_cast<qint64>(totalSize));
     data->buffer.append(ptr, static_cast<qsizetype>(totalSize));
     return totalSize;
 }
@@ -507,6 +747,16 @@ size_t IconMultiFetcher::headerCallback(char *buffer, size_t size, size_t nitems
     // Parse Content-Length header to pre-allocate buffer
     // Format: "Content-Length: 12345\r\n"
     QByteArray header(buffer, static_cast<qsizetype>(totalSize));
+    
+    // Keep the final response's validators for the disk cache
+    if (header.startsWith("HTTP/")) {
+        data->etag.clear();
+        data->lastModified.clear();
+    } else if (header.size() > 5 && qstrnicmp(header.constData(), "etag:", 5) == 0) {
+        data->etag = header.mid(5).trimmed();
+    } else if (header.size() > 14 && qstrnicmp(header.constData(), "last-modified:", 14) == 0) {
+        data->lastModified = header.mid(14).trimmed();
+    }
     if (header.startsWith("Content-Length:") || header.startsWith("content-length:")) {
         // Parse the length value
         int colonPos = header.indexOf(':');
@@ -523,3 +773,72 @@ size_t IconMultiFetcher::headerCallback(char *buffer, size_t size, size_t nitems
     
     return totalSize;  // Must return total size to continue
 }
+
+bool IconMultiFetcher::isDiskCacheable(const QUrl &url)
+{
+    const QString scheme = url.scheme().toLower();
+    return scheme == QLatin1String("http") || scheme == QLatin1String("https");
+}
+
+QString IconMultiFetcher::diskPathFor(const QString &urlKey) const
+{
+    const QByteArray key = QCryptographicHash::hash(urlKey.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return _diskCacheDir + QDir::separator() + QString::fromLatin1(key) + QLatin1String(".icon");
+}
+
+bool IconMultiFetcher::loadFromDisk(const QString &urlKey, DiskEntry *entry) const
+{
+    QFile f(diskPathFor(urlKey));
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    QDataStream in(&f);
+    quint32 magic = 0, version = 0;
+    QString storedKey;
+    DiskEntry e;
+    in >> magic >> version;
+    if (magic != DISK_MAGIC || version != DISK_VERSION) {
+        return false;
+    }
+    in >> storedKey >> e.etag >> e.lastModified >> e.storedAt >> e.body;
+    if (in.status() != QDataStream::Ok || storedKey != urlKey || e.body.isEmpty()) {
+        return false;
+    }
+    
+    *entry = std::move(e);
+    return true;
+}
+
+void IconMultiFetcher::storeOnDisk(const QString &urlKey, const DiskEntry &entry) const
+{
+    QDir().mkpath(_diskCacheDir);
+    QSaveFile f(diskPathFor(urlKey));
+    if (!f.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    
+    QDataStream out(&f);
+    out << DISK_MAGIC << DISK_VERSION << urlKey << entry.etag << entry.lastModified << entry.storedAt << entry.body;
+    if (!f.commit()) {
+        qWarning() << "IconMultiFetcher: Could not write disk cache entry for" << urlKey;
+    }
+}
+
+void IconMultiFetcher::pruneDiskCache() const
+{
+    // Entries are rewritten whenever they are revalidated, so the file time
+    // tracks when an icon was last in use
+    const QDateTime cutoff = QDateTime::currentDateTime().addSecs(-DiskMaxAgeSecs);
+    QDir dir(_diskCacheDir);
+    const QFileInfoList files = dir.entryInfoList({QStringLiteral("*.icon")}, QDir::Files);
+    int removed = 0;
+    for (const QFileInfo &info : files) {
+        if (info.lastModified() < cutoff && QFile::remove(info.absoluteFilePath())) {
+            ++removed;
+        }
+    }
+    if (removed > 0) {
+        qDebug() << "IconMultiFetcher: Pruned" << removed << "expired disk cache entries";
+    }
+}
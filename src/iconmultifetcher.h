@@ -16,7 +16,10 @@
 #include <QQueue>
 #include <QList>
 #include <QSet>
+#include <QStringList>
 #include <QPointer>
+#include <QCache>
+#include <QImage>
 #include <atomic>
 #include <curl/curl.h>
 
@@ -29,11 +32,16 @@ class IconImageResponse;
  * handles many small downloads using a single curl_multi handle. Benefits:
  * 
  * - In-memory cache: Same icon URL returns instantly from cache
+ * - Disk cache: Icons survive restarts; a copy older than a day is shown
+ *   straight away and revalidated in the background with its ETag
+ * - Decoded cache: Display-size QImages, so icons already seen skip decoding
  * - HTTP/2 multiplexing: Multiple icons from the same host share one connection
  * - Connection pooling: Reuses TCP connections across requests
  * - Controlled concurrency: Limits parallel connections to avoid overwhelming servers
  * - Single thread: No thread pool contention for icon fetches
  * - Coalescing: Multiple requests for the same URL share one network fetch
+ * - Priorities: Icons on screen are fetched first, the next page is
+ *   prefetched once they are done, and offscreen fetches wait their turn
  * 
  * Usage:
  *   IconMultiFetcher::instance().queueFetch(response, url);
@@ -60,6 +68,15 @@ public:
      */
     void cancelFetch(IconImageResponse *response);
     
+    /**
+     * Tell the fetcher which icons are on screen and which come next.
+     * Queued fetches for visible icons jump ahead of the rest; upcoming
+     * icons are prefetched into the cache at low priority, and prefetches
+     * that are no longer upcoming are dropped. Each call replaces the last.
+     * Thread-safe.
+     */
+    void setVisibleIcons(const QStringList &visible, const QStringList &upcoming);
+    
     /**
      * Clear the in-memory icon cache.
      * Useful when switching OS list repositories.
@@ -73,6 +90,13 @@ public:
      */
     QByteArray getCachedData(const QString &urlKey) const;
     
+    /**
+     * Decoded icons at display size, keyed by URL and requested size.
+     * Thread-safe. Returns a null QImage if not cached.
+     */
+    QImage getCachedImage(const QString &imageKey) const;
+    void addCachedImage(const QString &imageKey, const QImage &image);
+    
     /**
      * Shutdown the fetcher thread. Called during application exit.
      */
@@ -83,6 +107,10 @@ public:
     // Cache configuration
     static constexpr qsizetype MaxCacheBytes = 32 * 1024 * 1024; // 32 MB cache limit
     static constexpr int MaxCacheEntries = 500; // Also limit entry count
+    static constexpr int MaxActiveTransfers = 8; // Transfers in flight; the rest queue by priority
+    static constexpr qsizetype MaxDecodedCacheBytes = 64 * 1024 * 1024; // Decoded QImages
+    static constexpr qint64 DiskRevalidateSecs = 24 * 60 * 60; // Revalidate disk copies daily
+    static constexpr qint64 DiskMaxAgeSecs = 30 * 24 * 60 * 60; // Unused disk copies expire
 
 private:
     explicit IconMultiFetcher(QObject *parent = nullptr);
@@ -104,12 +132,30 @@ private:
      */
     void processCompletedTransfers();
     
+    // Icon as stored in the disk cache
+    struct DiskEntry {
+        QByteArray body;
+        QByteArray etag;
+        QByteArray lastModified;
+        qint64 storedAt = 0;  // Seconds since epoch of the last fetch or revalidation
+    };
+    
     /**
      * Create and configure a CURL easy handle for an icon fetch.
      * @param url The URL to fetch
      * @param urlKey Pre-computed url.toString() to avoid allocation
+     * @param cached If set, make the request conditional on this disk copy
+     */
+    CURL* createEasyHandle(const QUrl &url, const QString &urlKey, const DiskEntry *cached = nullptr);
+    
+    /**
+     * Disk cache (only accessed from _thread). Only http(s) icons are stored.
      */
-    CURL* createEasyHandle(const QUrl &url, const QString &urlKey);
+    static bool isDiskCacheable(const QUrl &url);
+    QString diskPathFor(const QString &urlKey) const;
+    bool loadFromDisk(const QString &urlKey, DiskEntry *entry) const;
+    void storeOnDisk(const QString &urlKey, const DiskEntry &entry) const;
+    void pruneDiskCache() const;
     
     /**
      * Clean up a transfer (remove from multi, cleanup easy handle).
@@ -118,15 +164,18 @@ private:
     
     /**
      * Add data to cache, evicting old entries if needed.
+     * Replaces an existing entry if replace is set.
      * Must be called with _mutex held.
      */
-    void addToCache(const QString &urlKey, const QByteArray &data);
+    void addToCache(const QString &urlKey, const QByteArray &data, bool replace = false);
     
     /**
      * Evict oldest entries until cache is within limits.
      * Must be called with _mutex held.
      */
     void evictIfNeeded();
+    // Shrink or grow the caches to percent of their normal size
+    void applyMemoryPressure(int percent);
     
     // Write callback for curl
     static size_t writeCallback(char *ptr, size_t size, size_t nmemb, void *userdata);
@@ -145,9 +194,18 @@ private:
         QPointer<IconImageResponse> response;  // QPointer to detect deletion
         QUrl url;
         QString urlKey;  // Pre-computed to avoid repeated QUrl::toString() allocations
+        bool prefetch = false;  // No response; only fills the cache
     };
     QQueue<PendingRequest> _pendingRequests;
     
+    // Dispatch order: visible, then other requests, then prefetches
+    enum Priority { PrefetchPriority, NormalPriority, VisiblePriority };
+    Priority priorityOf(const PendingRequest &req) const;
+    
+    // Icons on screen, and upcoming icons being prefetched (protected by _mutex)
+    QSet<QString> _visibleUrls;
+    QSet<QString> _prefetchUrls;
+    
     // Cancellation set (protected by _mutex)
     QSet<IconImageResponse*> _cancelledResponses;
     
@@ -158,6 +216,20 @@ private:
         QByteArray buffer;
         char errorBuffer[CURL_ERROR_SIZE];
         QList<QPointer<IconImageResponse>> waitingResponses; // QPointer to detect deletion
+        
+        // Validators from the response, for the disk cache
+        QByteArray etag;
+        QByteArray lastModified;
+        
+        // Set when revalidating a disk copy that has already been shown;
+        // such a transfer runs even with no responses waiting
+        bool revalidating = false;
+        // Set for a prefetch; it runs while its icon is still upcoming
+        bool prefetch = false;
+        DiskEntry cached;
+        struct curl_slist *headers = nullptr;
+        
+        ~TransferData() { curl_slist_free_all(headers); }
     };
     QHash<CURL*, TransferData*> _activeTransfers;
     
@@ -172,6 +244,13 @@ private:
     QHash<QString, CacheEntry> _cache;
     QList<QString> _cacheOrder; // LRU order: oldest at front
     qsizetype _cacheBytes = 0;
+    qsizetype _cacheLimitBytes = MaxCacheBytes;   // Lowered under memory pressure
+    int _cacheLimitEntries = MaxCacheEntries;
+    
+    // Decoded images, cost in bytes (protected by _mutex)
+    mutable QCache<QString, QImage> _decodedCache{MaxDecodedCacheBytes};
+    
+    QString _diskCacheDir;
     
     // Synchronization
     mutable QMutex _mutex;  // mutable for const getCachedData()
@@ -0,0 +1,387 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "imagechunkstore.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QTextStream>
+#include <cstring>
+
+static const char kRecipeMagic[] = "rpi-imager-chunk-recipe 1";
+static const char kRecipeSuffix[] = ".recipe";
+static const char kZeroEntry[] = "zero";
+
+namespace {
+
+bool isZeroBlock(const char *data, qint64 len)
+{
+    qint64 i = 0;
+    for (; i + 8 <= len; i += 8) {
+        quint64 word;
+        std::memcpy(&word, data + i, sizeof(word));
+        if (word)
+            return false;
+    }
+    for (; i < len; ++i) {
+        if (data[i])
+            return false;
+    }
+    return true;
+}
+
+// Cheap hash of a block's contents, for choosing chunk boundaries
+quint64 blockFingerprint(const char *data, qint64 len)
+{
+    quint64 h = 0xcbf29ce484222325ULL;
+    qint64 i = 0;
+    for (; i + 8 <= len; i += 8) {
+        quint64 word;
+        std::memcpy(&word, data + i, sizeof(word));
+        h = (h ^ word) * 0x100000001b3ULL;
+    }
+    for (; i < len; ++i)
+        h = (h ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ULL;
+    return h ^ (h >> 29);
+}
+
+// The hash and length of each entry of a recipe; empty hash for zeros
+bool parseRecipe(const QString &path, QVector<QPair<QByteArray, qint64>> &entries, qint64 &size)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    if (file.readLine().trimmed() != kRecipeMagic)
+        return false;
+    const QList<QByteArray> sizeLine = file.readLine().trimmed().split(' ');
+    bool ok = false;
+    if (sizeLine.size() != 2 || sizeLine[0] != "size")
+        return false;
+    size = sizeLine[1].toLongLong(&ok);
+    if (!ok || size < 0)
+        return false;
+
+    qint64 total = 0;
+    while (!file.atEnd()) {
+        const QList<QByteArray> fields = file.readLine().trimmed().split(' ');
+        if (fields.size() != 2)
+            return false;
+        const qint64 length = fields[1].toLongLong(&ok);
+        if (!ok || length <= 0)
+            return false;
+        if (fields[0] == kZeroEntry)
+            entries.append({QByteArray(), length});
+        else if (fields[0].size() == 64)
+            entries.append({fields[0], length});
+        else
+            return false;
+        total += length;
+    }
+    return total == size;
+}
+
+} // namespace
+
+ImageChunkStore::ImageChunkStore(const QString &directory)
+    : _directory(directory)
+{
+}
+
+QString ImageChunkStore::recipePath(const QByteArray &imageHash) const
+{
+    return _directory + "/recipes/" + QString::fromLatin1(imageHash) + kRecipeSuffix;
+}
+
+QString ImageChunkStore::chunkPath(const QByteArray &hash) const
+{
+    return _directory + "/chunks/" + QString::fromLatin1(hash.left(2)) + "/" + QString::fromLatin1(hash);
+}
+
+bool ImageChunkStore::contains(const QByteArray &imageHash) const
+{
+    return !imageHash.isEmpty() && QFileInfo::exists(recipePath(imageHash));
+}
+
+bool ImageChunkStore::storeChunk(const QByteArray &hash, const QByteArray &data, bool &added)
+{
+    added = false;
+    const QString path = chunkPath(hash);
+    if (QFileInfo(path).size() == data.size())
+        return true;  // Already stored for another image
+
+    if (!QDir().mkpath(QFileInfo(path).path()))
+        return false;
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+        return false;
+    added = true;
+    return true;
+}
+
+bool ImageChunkStore::addImage(const QString &imagePath, const QByteArray &imageHash,
+                               const std::function<bool()> &interrupted)
+{
+    if (contains(imageHash)) {
+        touch(imageHash);
+        return true;
+    }
+
+    QFile image(imagePath);
+    if (!image.open(QIODevice::ReadOnly)) {
+        qDebug() << "Chunk store: cannot open" << imagePath;
+        return false;
+    }
+
+    Builder builder(*this);
+    QByteArray buffer(4 * 1024 * 1024, Qt::Uninitialized);
+    while (true) {
+        if (interrupted && interrupted())
+            return false;
+        const qint64 len = image.read(buffer.data(), buffer.size());
+        if (len < 0)
+            return false;
+        if (len == 0)
+            break;
+        if (!builder.addData(buffer.constData(), len))
+            return false;
+    }
+    if (!builder.finish(imageHash))
+        return false;
+
+    qDebug() << "Chunk store: added" << imageHash << "-" << builder.totalBytes() << "bytes, of which"
+             << builder.storedBytes() << "were not already stored";
+    return true;
+}
+
+void ImageChunkStore::touch(const QByteArray &imageHash)
+{
+    QFile recipe(recipePath(imageHash));
+    if (recipe.open(QIODevice::ReadWrite))
+        recipe.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+}
+
+QList<QByteArray> ImageChunkStore::images() const
+{
+    QList<QByteArray> result;
+    const QFileInfoList recipes = QDir(_directory + "/recipes")
+        .entryInfoList(QStringList() << QString("*") + kRecipeSuffix, QDir::Files, QDir::Time);
+    for (const QFileInfo &recipe : recipes)
+        result.append(recipe.completeBaseName().toLatin1());
+    return result;
+}
+
+void ImageChunkStore::remove(const QByteArray &imageHash)
+{
+    QFile::remove(recipePath(imageHash));
+}
+
+void ImageChunkStore::prune(int keep)
+{
+    const QList<QByteArray> all = images();
+    for (int i = qMax(keep, 0); i < all.size(); ++i) {
+        qDebug() << "Chunk store: dropping" << all[i];
+        remove(all[i]);
+    }
+    collectGarbage();
+}
+
+qint64 ImageChunkStore::collectGarbage()
+{
+    QSet<QByteArray> referenced;
+    for (const QByteArray &image : images()) {
+        QVector<QPair<QByteArray, qint64>> entries;
+        qint64 size = 0;
+        if (!parseRecipe(recipePath(image), entries, size)) {
+            // Unusable, and would pin its chunks forever
+            remove(image);
+            continue;
+        }
+        for (const auto &entry : entries) {
+            if (!entry.first.isEmpty())
+                referenced.insert(entry.first);
+        }
+    }
+
+    // Also removes chunks left behind by an interrupted addImage()
+    qint64 freed = 0;
+    QDirIterator it(_directory + "/chunks", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        if (referenced.contains(it.fileName().toLatin1()))
+            continue;
+        const qint64 size = it.fileInfo().size();
+        if (QFile::remove(it.filePath()))
+            freed += size;
+    }
+    return freed;
+}
+
+qint64 ImageChunkStore::storedBytes() const
+{
+    qint64 total = 0;
+    QDirIterator it(_directory + "/chunks", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        total += it.fileInfo().size();
+    }
+    return total;
+}
+
+// ── Builder ─────────────────────────────────────────────────────────────
+
+ImageChunkStore::Builder::Builder(ImageChunkStore &store)
+    : _store(store)
+{
+    _chunk.reserve(kMaxChunkBlocks * kBlockSize);
+}
+
+bool ImageChunkStore::Builder::addData(const char *data, qint64 len)
+{
+    while (len > 0 && !_failed) {
+        if (!_pending.isEmpty() || len < kBlockSize) {
+            const qint64 take = qMin(kBlockSize - _pending.size(), len);
+            _pending.append(data, take);
+            data += take;
+            len -= take;
+            if (_pending.size() == kBlockSize) {
+                addBlock(_pending.constData(), kBlockSize);
+                _pending.clear();
+            }
+        } else {
+            addBlock(data, kBlockSize);
+            data += kBlockSize;
+            len -= kBlockSize;
+        }
+    }
+    return !_failed;
+}
+
+bool ImageChunkStore::Builder::addBlock(const char *block, qint64 len)
+{
+    _totalBytes += len;
+    if (isZeroBlock(block, len)) {
+        if (!_chunk.isEmpty())
+            endChunk();
+        _zeroRun += len;
+        return !_failed;
+    }
+    if (_zeroRun > 0) {
+        _entries.append({QByteArray(), _zeroRun});
+        _zeroRun = 0;
+    }
+
+    _chunk.append(block, len);
+    const qint64 blocks = _chunk.size() / kBlockSize;
+    if (blocks >= kMaxChunkBlocks ||
+        (blocks >= kMinChunkBlocks && (blockFingerprint(block, len) & kBoundaryMask) == kBoundaryMask))
+        endChunk();
+    return !_failed;
+}
+
+bool ImageChunkStore::Builder::endChunk()
+{
+    if (_chunk.isEmpty())
+        return true;
+    const QByteArray hash = QCryptographicHash::hash(_chunk, QCryptographicHash::Sha256).toHex();
+    bool added = false;
+    if (!_store.storeChunk(hash, _chunk, added)) {
+        qDebug() << "Chunk store: cannot write chunk" << hash;
+        _failed = true;
+        return false;
+    }
+    if (added)
+        _storedBytes += _chunk.size();
+    _entries.append({hash, _chunk.size()});
+    _chunk.clear();
+    return true;
+}
+
+bool ImageChunkStore::Builder::finish(const QByteArray &imageHash)
+{
+    // A trailing partial block is kept as it is
+    if (!_pending.isEmpty()) {
+        addBlock(_pending.constData(), _pending.size());
+        _pending.clear();
+    }
+    endChunk();
+    if (_zeroRun > 0) {
+        _entries.append({QByteArray(), _zeroRun});
+        _zeroRun = 0;
+    }
+    if (_failed || _totalBytes == 0)
+        return false;
+
+    const QString path = _store.recipePath(imageHash);
+    if (!QDir().mkpath(QFileInfo(path).path()))
+        return false;
+    QSaveFile recipe(path);
+    if (!recipe.open(QIODevice::WriteOnly))
+        return false;
+    QTextStream out(&recipe);
+    out << kRecipeMagic << "\n" << "size " << _totalBytes << "\n";
+    for (const Entry &entry : std::as_const(_entries))
+        out << (entry.hash.isEmpty() ? QByteArray(kZeroEntry) : entry.hash) << " " << entry.length << "\n";
+    out.flush();
+    return out.status() == QTextStream::Ok && recipe.commit();
+}
+
+// ── Reader ──────────────────────────────────────────────────────────────
+
+bool ImageChunkStore::Reader::open(const QString &recipePath)
+{
+    QVector<QPair<QByteArray, qint64>> entries;
+    if (!parseRecipe(recipePath, entries, _size))
+        return false;
+
+    QDir store = QFileInfo(recipePath).absoluteDir();
+    store.cdUp();
+    _chunkDirectory = store.filePath("chunks");
+    _entries.clear();
+    for (const auto &entry : std::as_const(entries))
+        _entries.append({entry.first, entry.second});
+    _index = 0;
+    _offsetInEntry = 0;
+    _chunk.close();
+    return true;
+}
+
+qint64 ImageChunkStore::Reader::read(char *buf, qint64 len)
+{
+    qint64 done = 0;
+    while (done < len && _index < _entries.size()) {
+        const Entry &entry = _entries[_index];
+        const qint64 take = qMin(len - done, entry.length - _offsetInEntry);
+        if (entry.hash.isEmpty()) {
+            std::memset(buf + done, 0, static_cast<size_t>(take));
+        } else {
+            if (!_chunk.isOpen()) {
+                _chunk.setFileName(_chunkDirectory + "/" + QString::fromLatin1(entry.hash.left(2)) +
+                                   "/" + QString::fromLatin1(entry.hash));
+                if (!_chunk.open(QIODevice::ReadOnly) || _chunk.size() != entry.length) {
+                    qDebug() << "Chunk store: missing or damaged chunk" << entry.hash;
+                    _chunk.close();
+                    return -1;
+                }
+            }
+            if (_chunk.read(buf + done, take) != take) {
+                _chunk.close();
+                return -1;
+            }
+        }
+        done += take;
+        _offsetInEntry += take;
+        if (_offsetInEntry == entry.length) {
+            _chunk.close();
+            ++_index;
+            _offsetInEntry = 0;
+        }
+    }
+    return done;
+}
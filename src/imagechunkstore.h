@@ -0,0 +1,174 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef IMAGECHUNKSTORE_H
+#define IMAGECHUNKSTORE_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+/**
+ * @brief Deduplicating store for decompressed images
+ *
+ * Successive releases of an OS share most of their file system blocks, so
+ * the decompressed image cache keeps its images here as chunks, stored
+ * once however many images use them, plus a recipe per image listing its
+ * chunks in order.
+ *
+ * Chunk boundaries are content-defined, at 4 KiB block granularity: a
+ * chunk ends after a block whose fingerprint matches kBoundaryMask (once
+ * it has kMinChunkBlocks), or at kMaxChunkBlocks. A block inserted or
+ * removed therefore only changes the chunks around it, and chunks line up
+ * with file system blocks. Runs of zero blocks become chunks of their own
+ * and are not stored at all.
+ *
+ * Layout under the store directory:
+ *   chunks/<2 hex>/<sha256>   chunk contents, named after their SHA256
+ *   recipes/<image>.recipe    written last; lists the image's chunks
+ *
+ * Not thread-safe: CacheVerificationWorker owns the store for writing, so
+ * adding, pruning and garbage collection never overlap. A Reader only needs
+ * the chunks of its recipe, which stay as long as the recipe does; an image
+ * is touched when it is used, so prune() keeps the ones being read.
+ */
+class ImageChunkStore
+{
+public:
+    static constexpr qint64 kBlockSize = 4096;
+    static constexpr int kMinChunkBlocks = 4;       // 16 KiB
+    static constexpr int kMaxChunkBlocks = 64;      // 256 KiB
+    static constexpr quint64 kBoundaryMask = 0xf;   // About 64 KiB on average
+
+    explicit ImageChunkStore(const QString &directory);
+
+    QString directory() const { return _directory; }
+
+    /**
+     * @brief Chunk a decompressed image into the store
+     * @param interrupted Polled between reads; returning true abandons
+     * @return false on error or interruption; no recipe is written then
+     */
+    bool addImage(const QString &imagePath, const QByteArray &imageHash,
+                  const std::function<bool()> &interrupted = {});
+
+    /**
+     * @brief Splits a stream into chunks and stores the ones not yet present
+     *
+     * Used by addImage(); data can be fed in pieces of any size.
+     */
+    class Builder
+    {
+    public:
+        explicit Builder(ImageChunkStore &store);
+
+        bool addData(const char *data, qint64 len);
+
+        /**
+         * @brief Store the trailing chunk and write the recipe
+         */
+        bool finish(const QByteArray &imageHash);
+
+        qint64 storedBytes() const { return _storedBytes; }   // Newly stored
+        qint64 totalBytes() const { return _totalBytes; }
+
+    private:
+        struct Entry {
+            QByteArray hash;   // Empty for a run of zeros
+            qint64 length;
+        };
+
+        bool addBlock(const char *block, qint64 len);
+        bool endChunk();
+
+        ImageChunkStore &_store;
+        QByteArray _pending;     // Bytes short of a whole block
+        QByteArray _chunk;
+        qint64 _zeroRun = 0;
+        QVector<Entry> _entries;
+        qint64 _storedBytes = 0;
+        qint64 _totalBytes = 0;
+        bool _failed = false;
+    };
+
+    /**
+     * @brief Reads an image back from its recipe, in order
+     */
+    class Reader
+    {
+    public:
+        /**
+         * @brief Open the recipe at recipePath, as returned by recipePath()
+         */
+        bool open(const QString &recipePath);
+
+        qint64 size() const { return _size; }
+
+        /**
+         * @brief Read up to len bytes
+         * @return bytes read, 0 at the end, -1 on error (missing or damaged chunk)
+         */
+        qint64 read(char *buf, qint64 len);
+
+    private:
+        struct Entry {
+            QByteArray hash;
+            qint64 length;
+        };
+
+        QString _chunkDirectory;
+        QVector<Entry> _entries;
+        qint64 _size = 0;
+        int _index = 0;
+        qint64 _offsetInEntry = 0;
+        QFile _chunk;
+    };
+
+    bool contains(const QByteArray &imageHash) const;
+    QString recipePath(const QByteArray &imageHash) const;
+
+    /**
+     * @brief Mark an image as used now, for prune()
+     */
+    void touch(const QByteArray &imageHash);
+
+    /**
+     * @brief Images in the store, most recently used first
+     */
+    QList<QByteArray> images() const;
+
+    /**
+     * @brief Forget an image; its chunks go at the next collectGarbage()
+     */
+    void remove(const QByteArray &imageHash);
+
+    /**
+     * @brief Keep only the `keep` most recently used images
+     */
+    void prune(int keep);
+
+    /**
+     * @brief Delete chunks no recipe refers to
+     * @return bytes freed
+     */
+    qint64 collectGarbage();
+
+    /**
+     * @brief Size of all stored chunks
+     */
+    qint64 storedBytes() const;
+
+private:
+    QString chunkPath(const QByteArray &hash) const;
+    bool storeChunk(const QByteArray &hash, const QByteArray &data, bool &added);
+
+    QString _directory;
+};
+
+#endif // IMAGECHUNKSTORE_H
@@ -19,6 +19,7 @@
 #include "localfileextractthread.h"
 #include "systemmemorymanager.h"
 #include "downloadstatstelemetry.h"
+#include "acceleratedcryptographichash.h"
 #include "wlancredentials.h"
 #include "device_info.h"
 #include "platformquirks.h"
@@ -26,6 +27,8 @@
 #include "iconimageprovider.h"
 #include "iconmultifetcher.h"
 #include "nativefiledialog.h"
+#include "appfonts.h"
+#include "usbsourceindex.h"
 #include <QQmlApplicationEngine>
 #include <QQuickWindow>
 #endif
@@ -61,10 +64,20 @@
 #include <QDateTime>
 #include "curlfetcher.h"
 #include "rpibootthread.h"
+#include "rpiboot/firmware_manager.h"
+#include "rpibootscheduler.h"
 #include "fastbootflashthread.h"
 #include "fastbootflashthread.h"
 #include "connect_device_registrar.h"
 #include "curlnetworkconfig.h"
+#include "timeout_utils.h"
+#include "bandwidthscheduler.h"
+#include "startupprofile.h"
+#include "staticdata.h"
+#include "threadplacement.h"
+#include "blockqueuetuner.h"
+#include "livemetrics.h"
+#include "threadcputime.h"
 #include <QDebug>
 #include <QJsonObject>
 #include <QTranslator>
@@ -78,7 +91,9 @@
 #endif
 #include <stdlib.h>
 #include <new>
+#include <vector>
 #include <QLocale>
+#include <QMetaEnum>
 #include <QMetaType>
 #include "imageadvancedoptions.h"
 
@@ -97,7 +112,7 @@
 using namespace ImageOptions;
 
 namespace {
-    constexpr uint MAX_SUBITEMS_DEPTH = 16;
+    constexpr uint MAX_SUBITEMS_DEPTH = OsListTree::MaxDepth;
 } // namespace anonymous
 
 // Initialize static member for secure boot CLI override
@@ -140,9 +155,37 @@ ImageWriter::ImageWriter(QObject *parent)
 {
     // Initialise CacheManager
     _cacheManager = new CacheManager(this);
+    setCachePeerServing(_settings.value("cache/servePeers", false).toBool());
+    setCachePeersEnabled(_settings.value("cache/usePeers", false).toBool());
+    setCachePrefetchEnabled(_settings.value("cache/prefetch", true).toBool());
+    setHttp3Enabled(_settings.value("network/http3", false).toBool());
+    setDownloadRateLimit(_settings.value("network/maxKBps", 0).toLongLong());
     
     // Initialise PerformanceStats
     _performanceStats = new PerformanceStats(this);
+
+#ifdef Q_OS_LINUX
+    // Put back block queue settings of a write that never got to restore them
+    BlockQueueTuner::restorePending(_settings);
+#endif
+
+    // Send download statistics saved while offline
+    if (QFile::exists(DownloadStatsTelemetry::defaultQueueFile())) {
+        if (DownloadStatsTelemetry::enabled()) {
+            _telemetry = new DownloadStatsTelemetry(QString(), this);
+            _telemetry->start();
+        } else {
+            QFile::remove(DownloadStatsTelemetry::defaultQueueFile());
+        }
+    }
+
+    // Progress for QML and the CLI, coalesced to the display rate; the Pi's
+    // own display gets fewer updates to leave its CPU to the write
+    _progressAggregator = new ProgressAggregator(this);
+    if (::isEmbeddedMode())
+        _progressAggregator->setInterval(kEmbeddedProgressIntervalMs);
+    connect(_progressAggregator, &ProgressAggregator::snapshotChanged, this, &ImageWriter::progressChanged);
+    connect(_progressAggregator, &ProgressAggregator::sampled, this, &ImageWriter::_onProgressSampled);
     
     // Initialize debug options with defaults
     // Direct I/O is enabled by default (matches current behavior)
@@ -152,8 +195,14 @@ ImageWriter::ImageWriter(QObject *parent)
     _debugVerboseLogging = false;
     _debugAsyncIO = true;       // Async I/O enabled by default for performance
     _debugIPv4Only = false;     // Use both IPv4 and IPv6 by default
+    _eraseBeforeWrite = false;
+    _verifyCoverage = 100.0;
+    _cloneSource = false;
+    _cloneUsedBlocksOnly = false;
     _debugSkipEndOfDevice = false; // Normal behavior; enable for counterfeit cards
     _debugIgnoreDeviceLimits = false; // Use device-reported I/O limits by default
+    _debugParallelDownload = false; // Single HTTP connection by default
+    _debugPipelinedVerify = false; // Verify after writing by default
     _debugRpiboot = false;          // Rpiboot/fastboot support disabled by default
     _debugForceSecureBoot = false;  // No UI override; CLI flag still wins
     _debugSignFastbootGadget = false; // CM5 re-provisioning: sign fastboot gadget
@@ -336,6 +385,7 @@ ImageWriter::ImageWriter(QObject *parent)
     // Only record polls that take longer than 200ms to avoid noise from normal fast polls
     connect(&_drivelist, &DriveListModel::eventDriveListPoll,
             this, [this](quint32 durationMs){
+                StartupProfile::instance().milestone("drive_list_first_scan");
                 if (durationMs >= 200) {
                     _performanceStats->recordEvent(PerformanceStats::EventType::DriveListPoll, durationMs, true);
                 }
@@ -346,6 +396,7 @@ ImageWriter::ImageWriter(QObject *parent)
             this, [this](quint32 durationMs, bool success){
                 _performanceStats->recordEvent(PerformanceStats::EventType::OsListParse, durationMs, success);
             });
+    connect(this, &ImageWriter::osListEntriesChanged, &_oslist, &OSListModel::updateEntries);
 
     // Start background cache operations early
     _cacheManager->startBackgroundOperations();
@@ -443,6 +494,16 @@ ImageWriter::~ImageWriter()
     qDebug() << "Stopping network monitoring";
     PlatformQuirks::stopNetworkMonitoring();
     
+    // The firmware prefetch captures 'this'
+    if (_rpibootFirmwarePrefetch.valid()) {
+        _rpibootFirmwarePrefetchCancel.store(true);
+        _rpibootFirmwarePrefetch.wait();
+    }
+    if (_usbSourceHashing.valid()) {
+        _usbSourceHashingCancel.store(true);
+        _usbSourceHashing.wait();
+    }
+
     // Cancel FastbootFlashThread before stopping drive list polling.
     // Both use libusb; concurrent libusb_exit (FastbootFlashThread) and
     // libusb_init (DriveListModelPollThread) trigger a macOS libusb deadlock
@@ -467,6 +528,19 @@ ImageWriter::~ImageWriter()
 
     // Stop and cleanup CacheManager background thread before Qt's automatic cleanup
     // This ensures the background thread is properly terminated before ImageWriter is destroyed
+    // Serves files CacheManager looks up, or adds to it
+    cancelPrefetch();
+    delete _cachePeerServer;
+    _cachePeerServer = nullptr;
+
+    // Whatever is still queued is sent by the next run
+    if (_telemetry) {
+        _telemetry->stop();
+        _telemetry->wait();
+        delete _telemetry;
+        _telemetry = nullptr;
+    }
+
     if (_cacheManager) {
         qDebug() << "Cleaning up CacheManager";
         delete _cacheManager;
@@ -515,9 +589,15 @@ void ImageWriter::setEngine(QQmlApplicationEngine *engine)
 }
 
 /* Set URL to download from */
-void ImageWriter::setSrc(const QUrl &url, quint64 downloadLen, quint64 extrLen, QByteArray expectedHash, bool multifilesinzip, QString parentcategory, QString osname, QByteArray initFormat, QString releaseDate, QString bmapUrl)
+void ImageWriter::setSrc(const QUrl &url, quint64 downloadLen, quint64 extrLen, QByteArray expectedHash, bool multifilesinzip, QString parentcategory, QString osname, QByteArray initFormat, QString releaseDate, QString bmapUrl, QStringList mirrors)
 {
+    // A prefetch of this image started during the previous write carries on
+    const bool prefetchingImage = _prefetcher && !expectedHash.isEmpty() && _prefetcher->expectedHash() == expectedHash;
+    if ((url != _src || expectedHash != _expectedHash) && !prefetchingImage)
+        cancelPrefetch();
+
     _src = url;
+    _cloneSource = false;
     _downloadLen = downloadLen;
     _extrLen = extrLen;
     _expectedHash = expectedHash;
@@ -527,6 +607,9 @@ void ImageWriter::setSrc(const QUrl &url, quint64 downloadLen, quint64 extrLen,
     _initFormat = (initFormat == "none") ? "" : initFormat;
     _osReleaseDate = releaseDate;
     _bmapUrl = bmapUrl;
+    _mirrorUrls.clear();
+    for (const QString &mirror : std::as_const(mirrors))
+        _mirrorUrls.append(mirror.toLatin1());
     // Gzip ISIZE is 32-bit, so uncompressed size is unreliable for files >4GB.
     // When no trusted extract size is provided by the manifest, mark it so the
     // UI can show indeterminate progress instead of a misleading percentage.
@@ -562,9 +645,118 @@ void ImageWriter::setSrc(const QUrl &url, quint64 downloadLen, quint64 extrLen,
             _parseZstdFile();
         else
             _parseCompressedFile();
+
+        if (compressed && _extrLen && _extractSizeKnown)
+            _storeUsbSourceExtractSize();
     }
 }
 
+QString ImageWriter::decompressedImageSource(const QByteArray &expectedHash)
+{
+    if (expectedHash.isEmpty())
+        return QString();
+    const QString imageCachePath = _cacheManager->getImageCacheFilePath(expectedHash);
+    return imageCachePath.isEmpty() ? _cacheManager->getChunkedImageRecipe(expectedHash) : imageCachePath;
+}
+
+void ImageWriter::setPrimedImage(const QByteArray &expectedHash, const QString &path)
+{
+    _primedImageHash = path.isEmpty() ? QByteArray() : expectedHash;
+    _primedImagePath = path;
+}
+
+void ImageWriter::setSrcDevice(const QString &device, bool usedBlocksOnly)
+{
+    setSrc(QUrl::fromLocalFile(device));
+    // QFileInfo reports 0 bytes for block devices
+    _downloadLen = _extrLen = LocalFileExtractThread::sourceSize(device);
+    _cloneSource = true;
+    _cloneUsedBlocksOnly = usedBlocksOnly;
+}
+
+void ImageWriter::startPrefetch()
+{
+    if (_prefetcher && _prefetcher->expectedHash() == _expectedHash)
+        return;
+    cancelPrefetch();
+    if (_cloneSource || !_downloadLen)
+        return;
+
+    const qint64 maxKBps = _settings.value("cache/prefetchMaxKBps", CachePrefetcher::kDefaultMaxBytesPerSecond / 1024).toLongLong();
+    _startPrefetch(_src, _downloadLen, _expectedHash, maxKBps * 1024);
+}
+
+void ImageWriter::prefetchNext(const QUrl &url, quint64 downloadLen, const QByteArray &expectedHash)
+{
+    // Verifying and finishing leave the network idle, so it is not capped
+    _startPrefetch(url, downloadLen, expectedHash, 0);
+}
+
+void ImageWriter::_startPrefetch(const QUrl &url, quint64 downloadLen, const QByteArray &expectedHash, qint64 maxBytesPerSecond)
+{
+    if (_prefetcher && _prefetcher->expectedHash() == expectedHash)
+        return;
+    cancelPrefetch();
+
+    if (!_cachePrefetchEnabled || expectedHash.isEmpty() || (url.scheme() != "http" && url.scheme() != "https"))
+        return;
+
+    // Also empty if the image is cached already, or would not fit
+    const QString fileName = _cacheManager->prefetchFilePath(expectedHash, static_cast<qint64>(downloadLen));
+    if (fileName.isEmpty())
+        return;
+
+    _prefetcher = new CachePrefetcher(url.toString(QUrl::FullyEncoded).toLatin1(), expectedHash, fileName, this);
+    _prefetcher->setMaxBytesPerSecond(maxBytesPerSecond);
+    if (!downloadLen)
+        _prefetcher->setMaxFileSize(_cacheManager->prefetchHeadroom());
+    connect(_prefetcher, &QThread::finished, this, [this, prefetcher = _prefetcher]() {
+        // A failed prefetch is kept for the write to continue from
+        if (prefetcher == _prefetcher && prefetcher->isComplete())
+            _finishPrefetch(false);
+    });
+    _prefetcher->start(QThread::LowestPriority);
+}
+
+void ImageWriter::cancelPrefetch()
+{
+    if (_prefetcher)
+        _finishPrefetch(false);
+
+    if (!_prefetchedPrefix.isEmpty())
+    {
+        QFile::remove(_prefetchedPrefix);
+        _prefetchedPrefix.clear();
+    }
+}
+
+void ImageWriter::preconnect(const QString &url)
+{
+    CurlNetworkConfig::instance().preconnect(QUrl(url));
+}
+
+/*
+ * Stop the prefetcher. A complete download goes into the cache either way;
+ * a partial one is kept in _prefetchedPrefix if a write of the same image
+ * is about to start.
+ */
+void ImageWriter::_finishPrefetch(bool forWrite)
+{
+    CachePrefetcher *prefetcher = _prefetcher;
+    _prefetcher = nullptr;
+    prefetcher->cancel();
+    prefetcher->wait();
+
+    if (prefetcher->isComplete())
+        _cacheManager->addPrefetchedFile(prefetcher->fileName(), prefetcher->expectedHash(), prefetcher->fileHash());
+    else if (forWrite && prefetcher->expectedHash() == _expectedHash && prefetcher->bytesFetched() > 0)
+        _prefetchedPrefix = prefetcher->fileName();
+    else
+        QFile::remove(prefetcher->fileName());
+
+    prefetcher->deleteLater();
+}
+
 /* Set device to write to */
 void ImageWriter::setDst(const QString &device, quint64 deviceSize)
 {
@@ -582,6 +774,12 @@ void ImageWriter::setDst(const QString &device, quint64 deviceSize)
     qDebug() << "Device selection changed to:" << device;
 }
 
+void ImageWriter::setAdditionalDsts(const QStringList &devices)
+{
+    _additionalDsts = devices;
+    qDebug() << "Additional devices:" << devices;
+}
+
 void ImageWriter::setRpibootDevice(const QString &deviceId)
 {
     _rpibootDeviceId = deviceId;
@@ -592,6 +790,37 @@ void ImageWriter::setRpibootDevice(const QString &deviceId)
     _devLen = 0;
 
     qDebug() << "rpiboot device selected:" << deviceId;
+
+    // Part 4 of "rpiboot://bus:addr:portpath:pid" identifies the chip
+    const QStringList parts = deviceId.mid(deviceId.indexOf("://") + 3).split(':');
+    if (parts.size() >= 4) {
+        if (auto gen = rpiboot::chipGenerationFromPid(static_cast<uint16_t>(parts[3].toUInt())))
+            _prefetchRpibootFirmware(*gen);
+    }
+}
+
+void ImageWriter::_prefetchRpibootFirmware(rpiboot::ChipGeneration chip)
+{
+    // Download, extract and sign the firmware while the user picks an OS
+    // and options; RpibootThread then finds it prepared.  One at a time:
+    // preparations are serialised on the firmware cache anyway.
+    if (_rpibootFirmwarePrefetch.valid() &&
+        _rpibootFirmwarePrefetch.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+
+    const rpiboot::SideloadMode mode = _rpibootSideloadMode;
+    const std::string customGadget = _debugCustomFastbootGadget.toStdString();
+    std::string signKey;
+    if (_debugSignFastbootGadget)
+        signKey = _settings.value(QStringLiteral("secureboot_rsa_key")).toString().toStdString();
+
+    _rpibootFirmwarePrefetch = std::async(std::launch::async, [this, mode, chip, customGadget, signKey]() {
+        rpiboot::FirmwareManager fwMgr;
+        fwMgr.setCustomFastbootGadget(customGadget);
+        fwMgr.setSignFastbootGadgetKey(signKey);
+        if (fwMgr.ensureAvailable(mode, chip, nullptr, _rpibootFirmwarePrefetchCancel).empty())
+            qDebug() << "rpiboot firmware prefetch failed:" << QString::fromStdString(fwMgr.lastError());
+    });
 }
 
 bool ImageWriter::isRpibootDevice() const
@@ -639,24 +868,10 @@ void ImageWriter::onRpibootDeviceDetected(const QString &deviceId,
     if (!_debugRpiboot)
         return;
 
-    // Compute port path key for dedup
-    QString ppKey;
-    for (int i = 0; i < portPath.size(); ++i) {
-        if (i > 0) ppKey += '.';
-        ppKey += QString::number(portPath[i]);
-    }
-
-    // Skip if already bootstrapping this device
-    if (_bootstrappingDevices.contains(ppKey))
-        return;
-
-    _bootstrappingDevices.insert(ppKey);
-    qDebug() << "Auto-bootstrap: starting rpiboot for" << ppKey << "deviceId=" << deviceId;
-
-    // Create DeviceInfo from parameters
     RpibootThread::DeviceInfo devInfo;
     devInfo.busNumber = busNumber;
     devInfo.deviceAddress = deviceAddress;
+    devInfo.productId = productId;
     for (const auto& p : portPath)
         devInfo.portPath.push_back(p);
 
@@ -665,34 +880,34 @@ void ImageWriter::onRpibootDeviceDetected(const QString &deviceId,
     if (auto gen = rpiboot::chipGenerationFromPid(productId))
         devInfo.chipGeneration = *gen;
 
-    auto *thread = new RpibootThread(devInfo, _rpibootSideloadMode, this);
-    if (!_debugCustomFastbootGadget.isEmpty())
-        thread->setCustomFastbootGadget(_debugCustomFastbootGadget);
+    if (!_bootstrapScheduler) {
+        _bootstrapScheduler = new RpibootScheduler(_rpibootSideloadMode, this);
+        connect(_bootstrapScheduler, &RpibootScheduler::deviceReady, this, &ImageWriter::onBootstrapComplete);
+        connect(_bootstrapScheduler, &RpibootScheduler::deviceFailed, this, &ImageWriter::onBootstrapError);
+        connect(_bootstrapScheduler, &RpibootScheduler::allFinished, this, &ImageWriter::onBootstrapAllFinished);
+        connect(_bootstrapScheduler, &RpibootScheduler::preparationStatusUpdate, this, &ImageWriter::onPreparationStatusUpdate);
+    }
+
+    // Skip if already bootstrapping this device
+    const QString ppKey = RpibootScheduler::portPathKey(devInfo.portPath);
+    if (_bootstrapScheduler->contains(ppKey))
+        return;
+
+    _bootstrapScheduler->setMode(_rpibootSideloadMode);
+    _bootstrapScheduler->setCustomFastbootGadget(_debugCustomFastbootGadget);
     // Plumb the re-provisioning key through to FirmwareManager so the
     // bootcode upload + gadget signing run on auto-bootstrap too — without
     // this a pre-fused CM5 silently rejects the unsigned bootcode and the
     // 15s re-enumerate timeout fires.
+    QString signKey;
     if (_debugSignFastbootGadget) {
-        QString rsaKey = _settings.value(QStringLiteral("secureboot_rsa_key")).toString();
-        if (rsaKey.isEmpty()) {
+        signKey = _settings.value(QStringLiteral("secureboot_rsa_key")).toString();
+        if (signKey.isEmpty()) {
             qWarning() << "Auto-bootstrap: re-provisioning enabled but no secure boot RSA key configured; "
                           "uploaded bootcode will not be counter-signed and the device will reject it";
-        } else {
-            thread->setSignFastbootGadgetKey(rsaKey);
         }
     }
-
-    connect(thread, &RpibootThread::fastbootDeviceReady, this,
-            [this, ppKey](const QString &fastbootId) {
-                onBootstrapComplete(ppKey, fastbootId);
-            });
-    connect(thread, &RpibootThread::error, this,
-            [this, ppKey](const QString &msg) {
-                onBootstrapError(ppKey, msg);
-            });
-    connect(thread, &RpibootThread::preparationStatusUpdate, this, &ImageWriter::onPreparationStatusUpdate);
-
-    _activeBootstrapThreads[ppKey] = thread;
+    _bootstrapScheduler->setSignFastbootGadgetKey(signKey);
 
     // Pause drive scanning for the duration of the bootstrap.  The poll
     // thread also calls libusb_get_device_list / scanRpibootDevices on a
@@ -701,50 +916,36 @@ void ImageWriter::onRpibootDeviceDetected(const QString &deviceId,
     // produces sporadic LIBUSB_ERROR_IO / NO_DEVICE failures partway
     // through boot.img upload (variable cutoff at ~12-14 MB).  Same
     // pattern the regular write path uses while WriteState != Idle.
-    qDebug() << "Auto-bootstrap: pausing drive scan to avoid concurrent libusb access";
-    _drivelist.pausePolling();
+    if (_bootstrapScheduler->isIdle()) {
+        qDebug() << "Auto-bootstrap: pausing drive scan to avoid concurrent libusb access";
+        _drivelist.pausePolling();
+    }
 
-    thread->start();
+    // Devices plugged in together boot concurrently; firmware and boot
+    // files are fetched and read once and shared between them
+    qDebug() << "Auto-bootstrap: starting rpiboot for" << ppKey << "deviceId=" << deviceId;
+    _bootstrapScheduler->enqueue(devInfo);
 }
 
 void ImageWriter::onBootstrapComplete(const QString &portPathKey, const QString &fastbootId)
 {
     qDebug() << "Auto-bootstrap complete:" << portPathKey << "fastbootId=" << fastbootId;
 
-    // Clean up the thread
-    if (_activeBootstrapThreads.contains(portPathKey)) {
-        _activeBootstrapThreads[portPathKey]->deleteLater();
-        _activeBootstrapThreads.remove(portPathKey);
-    }
-    _bootstrappingDevices.remove(portPathKey);
-
-    // Enable fastboot scanning so the poll thread discovers storage devices,
-    // then unpause polling — paired with pausePolling() in the bootstrap kickoff.
+    // Enable fastboot scanning so the poll thread discovers storage devices
     _drivelist.setFastbootScanEnabled(true);
-    if (_activeBootstrapThreads.isEmpty()) {
-        qDebug() << "Auto-bootstrap: resuming drive scan";
-        _drivelist.resumePolling();
-    }
 }
 
 void ImageWriter::onBootstrapError(const QString &portPathKey, const QString &msg)
 {
     qWarning() << "Auto-bootstrap error for" << portPathKey << ":" << msg;
+}
 
-    // Clean up the thread
-    if (_activeBootstrapThreads.contains(portPathKey)) {
-        _activeBootstrapThreads[portPathKey]->deleteLater();
-        _activeBootstrapThreads.remove(portPathKey);
-    }
-    _bootstrappingDevices.remove(portPathKey);
-
-    // Unpause drive scanning when the last bootstrap finishes (success or
-    // error).  Only resume once no bootstraps remain in flight, in case
-    // multiple devices are being bootstrapped simultaneously.
-    if (_activeBootstrapThreads.isEmpty()) {
-        qDebug() << "Auto-bootstrap: resuming drive scan after error";
-        _drivelist.resumePolling();
-    }
+void ImageWriter::onBootstrapAllFinished(int succeeded, int failed)
+{
+    // Unpause drive scanning once no bootstraps remain in flight — paired
+    // with pausePolling() when the first device of a batch was queued
+    qDebug() << "Auto-bootstrap: resuming drive scan," << succeeded << "ready," << failed << "failed";
+    _drivelist.resumePolling();
 }
 
 void ImageWriter::onRpibootFastbootReady(const QString &fastbootId)
@@ -802,9 +1003,11 @@ void ImageWriter::onRpibootFastbootReady(const QString &fastbootId)
     connect(_fastbootFlashThread, &FastbootFlashThread::error, this, &ImageWriter::onError);
     connect(_fastbootFlashThread, &FastbootFlashThread::preparationStatusUpdate, this, &ImageWriter::onPreparationStatusUpdate);
     connect(_fastbootFlashThread, &FastbootFlashThread::downloadProgress, this, [this](quint64 now, quint64 total) {
+        _progressAggregator->report(ProgressAggregator::Phase::Download, now, total);
         emit downloadProgress(QVariant(now), QVariant(total));
     });
     connect(_fastbootFlashThread, &FastbootFlashThread::writeProgress, this, [this](quint64 now, quint64 total) {
+        _progressAggregator->report(ProgressAggregator::Phase::Write, now, total);
         emit writeProgress(QVariant(now), QVariant(total));
     });
     connect(_fastbootFlashThread, &FastbootFlashThread::finalizing, this, &ImageWriter::onFinalizing);
@@ -826,6 +1029,10 @@ void ImageWriter::onRpibootFastbootReady(const QString &fastbootId)
             this, [this](quint32 ms, bool ok, QString meta){
                 _performanceStats->recordEvent(PerformanceStats::EventType::FastbootDeviceOpen, ms, ok, meta);
             });
+    connect(_fastbootFlashThread, &FastbootFlashThread::eventFastbootPipelineStats,
+            this, [this](quint32 ms, bool ok, QString meta){
+                _performanceStats->recordEvent(PerformanceStats::EventType::FastbootPipelineStats, ms, ok, meta);
+            });
     connect(_fastbootFlashThread, &FastbootFlashThread::downloadProgress,
             this, [this](quint64 now, quint64 total){
                 _performanceStats->recordDownloadProgress(now, total);
@@ -835,6 +1042,8 @@ void ImageWriter::onRpibootFastbootReady(const QString &fastbootId)
                 _performanceStats->recordWriteProgress(now, total);
             });
 
+    // Fastboot reports its progress; nothing to sample
+    _progressAggregator->start();
     _fastbootFlashThread->start();
 }
 
@@ -906,6 +1115,10 @@ void ImageWriter::startWrite()
         return;
     }
 
+    // The write takes over from a background download of the same image
+    if (_prefetcher)
+        _finishPrefetch(true);
+
     // Clean up a finished-but-not-yet-collected thread (deleteLater timing gap).
     // A *running* thread here is a bug — our exit paths (onError, onCancelled,
     // QThread::finished handler) should have cleaned up already.
@@ -978,6 +1191,30 @@ void ImageWriter::startWrite()
         _fastbootFlashThread->setImageCustomisation(_config, _cmdline, _firstrun, _cloudinit, _cloudinitNetwork, _initFormat);
         if (!_bmapUrl.isEmpty())
             _fastbootFlashThread->setBmapUrl(QUrl(_bmapUrl));
+
+        // Multi-device flashing: the other selected gadgets share the
+        // download, decompression and sparse encoding
+        for (const QString &device : std::as_const(_additionalDsts))
+        {
+            if (!device.startsWith(QStringLiteral("fastboot://")))
+                continue;
+            const QString path = device.mid(11);
+            const int slashIdx = path.indexOf('/');
+            if (slashIdx > 0)
+                _fastbootFlashThread->addFanOutTarget(path.left(slashIdx), path.mid(slashIdx + 1));
+            else
+                _fastbootFlashThread->addFanOutTarget(path, QStringLiteral("mmcblk0"));
+        }
+        connect(_fastbootFlashThread, &FastbootFlashThread::fanOutTargetProgress, this,
+                [this](QString device, quint64 now, quint64 total) {
+                    emit additionalDstProgress(device, now, total);
+                });
+        connect(_fastbootFlashThread, &FastbootFlashThread::fanOutTargetFinished, this,
+                [this](QString device, bool success, QString msg) {
+                    _performanceStats->recordEvent(PerformanceStats::EventType::AdditionalTargetResult, 0, success,
+                        QString("device: %1; %2").arg(device, success ? QStringLiteral("ok") : msg));
+                    emit additionalDstFinished(device, success, msg);
+                });
         // Same Connect-org wire-up as the rpiboot path: when the user
         // picked a fastboot storage device directly, register the
         // device's firmware identity with the organisation before
@@ -995,9 +1232,11 @@ void ImageWriter::startWrite()
         connect(_fastbootFlashThread, &FastbootFlashThread::error, this, &ImageWriter::onError);
         connect(_fastbootFlashThread, &FastbootFlashThread::preparationStatusUpdate, this, &ImageWriter::onPreparationStatusUpdate);
         connect(_fastbootFlashThread, &FastbootFlashThread::downloadProgress, this, [this](quint64 now, quint64 total) {
+            _progressAggregator->report(ProgressAggregator::Phase::Download, now, total);
             emit downloadProgress(QVariant(now), QVariant(total));
         });
         connect(_fastbootFlashThread, &FastbootFlashThread::writeProgress, this, [this](quint64 now, quint64 total) {
+            _progressAggregator->report(ProgressAggregator::Phase::Write, now, total);
             emit writeProgress(QVariant(now), QVariant(total));
         });
         connect(_fastbootFlashThread, &FastbootFlashThread::finalizing, this, &ImageWriter::onFinalizing);
@@ -1015,6 +1254,10 @@ void ImageWriter::startWrite()
                 this, [this](quint32 ms, bool ok, QString meta){
                     _performanceStats->recordEvent(PerformanceStats::EventType::FastbootDeviceOpen, ms, ok, meta);
                 });
+        connect(_fastbootFlashThread, &FastbootFlashThread::eventFastbootPipelineStats,
+                this, [this](quint32 ms, bool ok, QString meta){
+                    _performanceStats->recordEvent(PerformanceStats::EventType::FastbootPipelineStats, ms, ok, meta);
+                });
         connect(_fastbootFlashThread, &FastbootFlashThread::downloadProgress,
                 this, [this](quint64 now, quint64 total){
                     _performanceStats->recordDownloadProgress(now, total);
@@ -1023,6 +1266,7 @@ void ImageWriter::startWrite()
                 this, [this](quint64 now, quint64 total){
                     _performanceStats->recordWriteProgress(now, total);
                 });
+        _progressAggregator->start();
         _fastbootFlashThread->start();
         return;
     }
@@ -1099,6 +1343,8 @@ void ImageWriter::startWrite()
         // For formatting operations, skip all cache operations since we don't need cached files
         qDebug() << "Starting format operation - skipping cache operations";
         DriveFormatThread *dft = new DriveFormatThread(_dst.toLatin1(), this);
+        // Erasing a card: discarding it is both faster and better for the card
+        dft->setQuickFormat(true);
         connect(dft, SIGNAL(success()), SLOT(onSuccess()));
         connect(dft, SIGNAL(error(QString)), SLOT(onError(QString)));
         connect(dft, SIGNAL(preparationStatusUpdate(QString)), SLOT(onPreparationStatusUpdate(QString)));
@@ -1122,7 +1368,7 @@ void ImageWriter::startWrite()
             onError(tr("Source file not found: %1").arg(localPath));
             return;
         }
-        if (!localFi.isFile())
+        if (!localFi.isFile() && !_cloneSource)
         {
             onError(tr("Source is not a regular file: %1").arg(localPath));
             return;
@@ -1132,6 +1378,11 @@ void ImageWriter::startWrite()
             onError(tr("Source file is not readable: %1").arg(localPath));
             return;
         }
+        if (_cloneSource && (localPath == _dst || _additionalDsts.contains(localPath)))
+        {
+            onError(tr("The device being cloned cannot also be written to."));
+            return;
+        }
     }
 
     if (_devLen && _extrLen > _devLen)
@@ -1183,6 +1434,8 @@ void ImageWriter::startWrite()
         sysInfo.osVersion = QSysInfo::productVersion();
         sysInfo.cpuArchitecture = QSysInfo::currentCpuArchitecture();
         sysInfo.cpuCoreCount = QThread::idealThreadCount();
+        sysInfo.hashBackend = AcceleratedCryptographicHash::backendName();
+        sysInfo.threadPlacement = ThreadPlacement::describe();
         
         // Imager version
         sysInfo.imagerVersion = IMAGER_VERSION_STR;
@@ -1221,10 +1474,35 @@ void ImageWriter::startWrite()
     // This allows us to start verification for cached files that haven't been verified yet
     QElapsedTimer cacheLookupTimer;
     cacheLookupTimer.start();
-    bool potentialCacheHit = !_expectedHash.isEmpty() && _cacheManager->hasPotentialCache(_expectedHash);
+    // A decompressed copy of the image beats the compressed cache: it is
+    // written as-is, without decompression, and checked against the
+    // expected hash while writing
+    QString imageCachePath;
+    bool chunkedImageHit = false;
+    if (!_expectedHash.isEmpty() && !_multipleFilesInZip)
+    {
+        // A copy primed for station mode, in RAM or on local disk
+        if (_expectedHash == _primedImageHash && QFile::exists(_primedImagePath))
+            imageCachePath = _primedImagePath;
+        if (imageCachePath.isEmpty())
+            imageCachePath = _cacheManager->getImageCacheFilePath(_expectedHash);
+        if (imageCachePath.isEmpty())
+        {
+            imageCachePath = _cacheManager->getChunkedImageRecipe(_expectedHash);
+            chunkedImageHit = !imageCachePath.isEmpty();
+        }
+    }
+    bool imageCacheHit = !imageCachePath.isEmpty();
+    bool potentialCacheHit = !imageCacheHit && !_expectedHash.isEmpty() && _cacheManager->hasPotentialCache(_expectedHash);
     _performanceStats->recordEvent(PerformanceStats::EventType::CacheLookup,
         static_cast<quint32>(cacheLookupTimer.elapsed()), true,
-        potentialCacheHit ? "potential_hit" : (_expectedHash.isEmpty() ? "no_hash" : "miss"));
+        chunkedImageHit ? "chunked_image_hit" : imageCacheHit ? "image_hit" : (potentialCacheHit ? "potential_hit" : (_expectedHash.isEmpty() ? "no_hash" : "miss")));
+
+    if (imageCacheHit)
+    {
+        qDebug() << "Using decompressed image cache:" << imageCachePath;
+        urlstr = QUrl::fromLocalFile(imageCachePath).toString(_src.FullyEncoded).toLatin1();
+    }
     
     if (potentialCacheHit)
     {
@@ -1234,13 +1512,17 @@ void ImageWriter::startWrite()
                  << "isValid=" << cacheStatus.isValid
                  << "file=" << cacheStatus.cacheFileName;
 
-        if (cacheStatus.verificationComplete && cacheStatus.isValid)
+        // The status describes whichever cache entry was verified last
+        const bool statusIsForImage = cacheStatus.cachedHash == _expectedHash;
+
+        if (statusIsForImage && cacheStatus.verificationComplete && cacheStatus.isValid)
         {
             qDebug() << "Using verified cache file (background verified):" << cacheStatus.cacheFileName;
             // Use cached file
             urlstr = QUrl::fromLocalFile(cacheStatus.cacheFileName).toString(_src.FullyEncoded).toLatin1();
+            _cacheManager->touchCacheEntry(_expectedHash);
         }
-        else if (cacheStatus.verificationComplete && !cacheStatus.isValid)
+        else if (statusIsForImage && cacheStatus.verificationComplete && !cacheStatus.isValid)
         {
             qDebug() << "Cache file failed background integrity check, invalidating and proceeding with download";
             _cacheManager->invalidateCache();
@@ -1260,7 +1542,7 @@ void ImageWriter::startWrite()
             // Start timing cache verification
             _cacheVerificationTimer.start();
             
-            if (!cacheStatus.verificationComplete)
+            if (!statusIsForImage || !cacheStatus.verificationComplete)
             {
                 qDebug() << "Starting cache verification";
                 _cacheManager->startVerification(_expectedHash);
@@ -1284,16 +1566,30 @@ void ImageWriter::startWrite()
     try {
         if (QUrl(urlstr).isLocalFile())
         {
-            _thread = new LocalFileExtractThread(urlstr, writeDevicePath.toLatin1(), _expectedHash, this);
+            LocalFileExtractThread *localThread = new LocalFileExtractThread(urlstr, writeDevicePath.toLatin1(), _expectedHash, this);
+            localThread->setRawImageSource(imageCacheHit || _cloneSource);
+            if (chunkedImageHit)
+                localThread->setChunkedImageSource();
+            else
+                localThread->setTrustedSource(imageCacheHit);
+            if (_cloneSource)
+                localThread->setCloneSource(_cloneUsedBlocksOnly);
+            _thread = localThread;
         }
         else
         {
             _thread = new DownloadExtractThread(urlstr, writeDevicePath.toLatin1(), _expectedHash, this);
+            if (_cachePeerBrowser)
+                _thread->setPeerUrls(_cachePeerBrowser->peerUrls(_expectedHash));
+            _thread->setMirrorUrls(_mirrorUrls);
+            if (!_prefetchedPrefix.isEmpty())
+            {
+                _thread->setPrefetchedPrefix(_prefetchedPrefix);
+                _prefetchedPrefix.clear();
+            }
             if (_repo.toString() == OSLIST_URL)
             {
-                DownloadStatsTelemetry *tele = new DownloadStatsTelemetry(urlstr, _parentCategory.toLatin1(), _osName.toLatin1(), isEmbeddedMode(), _currentLangcode, this);
-                connect(tele, SIGNAL(finished()), tele, SLOT(deleteLater()));
-                tele->start();
+                _sendTelemetry(urlstr);
             }
         }
     } catch (const std::bad_alloc& e) {
@@ -1354,47 +1650,10 @@ void ImageWriter::startWrite()
     // Connect to progress signals if this is a DownloadExtractThread
     DownloadExtractThread *downloadThread = qobject_cast<DownloadExtractThread*>(_thread);
     if (downloadThread) {
-        connect(downloadThread, &DownloadExtractThread::downloadProgressChanged,
-                this, &ImageWriter::downloadProgress);
-        connect(downloadThread, &DownloadExtractThread::writeProgressChanged,
-                this, &ImageWriter::writeProgress);
-        connect(downloadThread, &DownloadExtractThread::verifyProgressChanged,
-                this, &ImageWriter::verifyProgress);
-        
-        // Connect async write progress signal for event-driven UI updates during WaitForPendingWrites
-        // This signal is emitted from IOCP completion callbacks, providing real-time progress
-        connect(downloadThread, &DownloadThread::asyncWriteProgress,
-                this, &ImageWriter::writeProgress, Qt::QueuedConnection);
-        
-        // Capture progress for performance stats (lightweight - just stores raw samples)
-        connect(downloadThread, &DownloadExtractThread::downloadProgressChanged,
-                this, [this](quint64 now, quint64 total){
-                    _performanceStats->recordDownloadProgress(now, total);
-                });
-        connect(downloadThread, &DownloadExtractThread::decompressProgressChanged,
-                this, [this](quint64 now, quint64 total){
-                    _performanceStats->recordDecompressProgress(now, total);
-                });
-        connect(downloadThread, &DownloadExtractThread::writeProgressChanged,
-                this, [this](quint64 now, quint64 total){
-                    _performanceStats->recordWriteProgress(now, total);
-                });
-        connect(downloadThread, &DownloadThread::asyncWriteProgress,
-                this, [this](quint64 now, quint64 total){
-                    _performanceStats->recordWriteProgress(now, total);
-                }, Qt::QueuedConnection);
-        connect(downloadThread, &DownloadExtractThread::verifyProgressChanged,
-                this, [this](quint64 now, quint64 total){
-                    _performanceStats->recordVerifyProgress(now, total);
-                });
-        
-        // Also transition state to Verifying when verify progress first arrives
-        connect(downloadThread, &DownloadExtractThread::verifyProgressChanged,
-                this, [this](quint64 /*now*/, quint64 /*total*/){
-                    if (_writeState != WriteState::Verifying && _writeState != WriteState::Finalizing &&
-                        _writeState != WriteState::Succeeded && _writeState != WriteState::Cancelling)
-                        setWriteState(WriteState::Verifying);
-                });
+        // Progress counters are sampled at the display rate rather than
+        // forwarded per chunk; see _onProgressSampled()
+        _lastProgressSample = ProgressSnapshot();
+        _progressAggregator->start(downloadThread);
         
         // Capture ring buffer stall events for time-series correlation
         connect(downloadThread, &DownloadExtractThread::eventRingBufferStats,
@@ -1409,6 +1668,11 @@ void ImageWriter::startWrite()
                     event.bytesTransferred = 0;
                     _performanceStats->addEvent(event);
                 });
+        connect(downloadThread, &DownloadExtractThread::eventRingBufferOccupancy,
+                this, [this](quint32 inputSlotsUsed, quint32 writeSlotsUsed){
+                    _performanceStats->recordRingBufferOccupancy(inputSlotsUsed, writeSlotsUsed);
+                    LiveMetrics::instance().setRingOccupancy(inputSlotsUsed, writeSlotsUsed);
+                });
         
         // Pipeline timing summary events (emitted at end of extraction)
         connect(downloadThread, &DownloadExtractThread::eventPipelineDecompressionTime,
@@ -1487,6 +1751,22 @@ void ImageWriter::startWrite()
             this, [this](quint32 durationMs, bool success, QString metadata){
                 _performanceStats->recordEvent(PerformanceStats::EventType::DriveMbrZeroing, durationMs, success, metadata);
             });
+    connect(_thread, &DownloadThread::eventDriveErase,
+            this, [this](quint32 durationMs, bool success, QString metadata){
+                _performanceStats->recordEvent(PerformanceStats::EventType::DriveErase, durationMs, success, metadata);
+            });
+    connect(_thread, &DownloadThread::eventDriveCapacityProbe,
+            this, [this](quint32 durationMs, bool success, QString metadata){
+                _performanceStats->recordEvent(PerformanceStats::EventType::DriveCapacityProbe, durationMs, success, metadata);
+            });
+    connect(_thread, &DownloadThread::eventDriveQueueTuning,
+            this, [this](bool success, QString metadata){
+                _performanceStats->recordEvent(PerformanceStats::EventType::DriveQueueTuning, 0, success, metadata);
+            });
+    connect(_thread, &DownloadThread::eventDriveUsbPower,
+            this, [this](bool success, QString metadata){
+                _performanceStats->recordEvent(PerformanceStats::EventType::DriveUsbPower, 0, success, metadata);
+            });
     connect(_thread, &DownloadThread::eventDirectIOAttempt,
             this, [this](bool attempted, bool succeeded, bool currentlyEnabled, int errorCode, QString errorMessage){
                 QString metadata = QString("attempted: %1; succeeded: %2; currently_enabled: %3; error_code: %4; error: %5")
@@ -1544,6 +1824,12 @@ void ImageWriter::startWrite()
                 _performanceStats->recordEvent(PerformanceStats::EventType::QueueDepthReduction, 0, true,
                     QString("depth=%1->%2; pending=%3").arg(oldDepth).arg(newDepth).arg(pendingWrites));
             });
+    connect(_thread, &DownloadThread::eventWriteTuning,
+            this, [this](int queueDepth, quint32 blockSize, quint32 throughputKBps, QString metadata){
+                _performanceStats->recordEvent(PerformanceStats::EventType::WriteTuning, 0, true,
+                    QString("depth=%1; block_kb=%2; throughput_kbps=%3; %4")
+                        .arg(queueDepth).arg(blockSize / 1024).arg(throughputKBps).arg(metadata));
+            });
     connect(_thread, &DownloadThread::eventDrainAndHotSwap,
             this, [this](quint32 durationMs, int pendingBefore, bool success){
                 _performanceStats->recordEvent(PerformanceStats::EventType::DrainAndHotSwap, durationMs, success,
@@ -1576,6 +1862,14 @@ void ImageWriter::startWrite()
                 quint32 totalMs = static_cast<quint32>(totalSyscallMs + totalPreHashWaitMs + totalPostHashWaitMs);
                 _performanceStats->recordEvent(PerformanceStats::EventType::WriteTimingBreakdown, totalMs, true, metadata);
             });
+    connect(_thread, &DownloadThread::eventLatencyHistogram,
+            this, [this](QString name, QList<quint64> buckets, quint64 maxUs){
+                _performanceStats->recordLatencyHistogram(name, buckets, maxUs);
+            });
+    connect(_thread, &DownloadThread::eventStageCpuTime,
+            this, [this](QString stage, quint32 cpuMs, quint32 activeMs, quint32 wallMs){
+                _performanceStats->recordStageCpuTime(stage, cpuMs, activeMs, wallMs);
+            });
     connect(_thread, &DownloadThread::eventWriteSizeDistribution,
             this, [this](quint32 minSizeKB, quint32 maxSizeKB, quint32 avgSizeKB, quint64 totalBytes, quint32 writeCount){
                 QString metadata = QString("minKB: %1; maxKB: %2; avgKB: %3; totalBytes: %4; count: %5")
@@ -1631,9 +1925,22 @@ void ImageWriter::startWrite()
                         break;
                 }
                 emit bottleneckStatusChanged(statusText, throughputKBps);
+                emit bottleneckStateChanged(QString(QMetaEnum::fromType<DownloadThread::BottleneckState>()
+                                                        .valueToKey(static_cast<int>(state))).toLower(),
+                                            throughputKBps);
+            });
+
+    // Forward the time estimate (see EtaModel) to QML and the CLI
+    connect(_thread, &DownloadThread::timeRemainingChanged,
+            this, [this](quint32 seconds, QString limitedBy){
+                emit timeRemainingChanged(seconds, limitedBy);
             });
 
     _thread->setVerifyEnabled(_verifyEnabled);
+    _thread->setVerifyCoverage(_verifyCoverage);
+    _thread->setIoTraceFile(_ioTraceFile);
+    _thread->setEraseBeforeWrite(_eraseBeforeWrite);
+    _thread->setWritePartitions(_writePartitions);
     _thread->setUserAgent(QString("Mozilla/5.0 rpi-imager/%1").arg(staticVersion()).toUtf8());
     qDebug() << "startWrite: Passing to thread - initFormat:" << _initFormat << "cloudinit empty:" << _cloudinit.isEmpty() << "cloudinitNetwork empty:" << _cloudinitNetwork.isEmpty();
     _thread->setImageCustomisation(_config, _cmdline, _firstrun, _cloudinit, _cloudinitNetwork, _initFormat, _advancedOptions);
@@ -1651,6 +1958,30 @@ void ImageWriter::startWrite()
     _thread->setDebugIPv4Only(_debugIPv4Only);
     _thread->setDebugSkipEndOfDevice(_debugSkipEndOfDevice);
     _thread->setDebugIgnoreDeviceLimits(_debugIgnoreDeviceLimits);
+    _thread->setDebugParallelDownload(_debugParallelDownload);
+    _thread->setDebugPipelinedVerify(_debugPipelinedVerify);
+
+    if (!_bmapUrl.isEmpty())
+        _thread->setBmapUrl(_bmapUrl.toUtf8());
+
+    // Multi-target writing: same image to additional devices
+    for (const QString &device : std::as_const(_additionalDsts))
+    {
+        _thread->addFanOutTarget(PlatformQuirks::getWriteDevicePath(device).toLatin1());
+    }
+    if (!_additionalDsts.isEmpty())
+    {
+        connect(_thread, &DownloadThread::fanOutTargetProgress, this,
+                [this](QString device, quint64 now, quint64 total) {
+                    emit additionalDstProgress(device, now, total);
+                });
+        connect(_thread, &DownloadThread::fanOutTargetFinished, this,
+                [this](QString device, bool success, QString msg) {
+                    _performanceStats->recordEvent(PerformanceStats::EventType::AdditionalTargetResult, 0, success,
+                        QString("device: %1; %2").arg(device, success ? QStringLiteral("ok") : msg));
+                    emit additionalDstFinished(device, success, msg);
+                });
+    }
 
     // Only set up cache operations for remote downloads, not when using cached files as source
     if (!_expectedHash.isEmpty() && !QUrl(urlstr).isLocalFile())
@@ -1678,11 +2009,13 @@ void ImageWriter::startWrite()
     {
         qDebug() << "Using cached file as source - skipping cache setup";
     }
+    _setupImageCache(imageCacheHit);
 
     if (_multipleFilesInZip)
     {
         static_cast<DownloadExtractThread *>(_thread)->enableMultipleFileExtraction();
         DriveFormatThread *dft = new DriveFormatThread(_dst.toLatin1(), this);
+        dft->setQuickFormat(_eraseBeforeWrite);
         connect(dft, SIGNAL(success()), _thread, SLOT(start()));
         connect(dft, SIGNAL(error(QString)), SLOT(onError(QString)));
         connect(dft, SIGNAL(preparationStatusUpdate(QString)), SLOT(onPreparationStatusUpdate(QString)));
@@ -1746,6 +2079,7 @@ void ImageWriter::cancelWrite()
     if (_thread)
     {
         connect(_thread, SIGNAL(finished()), SLOT(onCancelled()));
+        _cancelTimer.start();
         _thread->cancelDownload();
     }
 
@@ -1799,8 +2133,22 @@ void ImageWriter::onCancelled()
     setWriteState(WriteState::Cancelled);
     stopProgressPolling();
 
-    // Clean up thread
+    // Time to release the device, including a sync left running in the background
     QObject *senderObj = sender();
+    if (_cancelTimer.isValid()) {
+        const qint64 latencyMs = _cancelTimer.elapsed();
+        auto *thread = qobject_cast<DownloadThread *>(senderObj);
+        const bool syncInFlight = thread && thread->isSyncInFlight();
+        if (latencyMs > rpi_imager::TimeoutDefaults::kCancelTargetMs)
+            qDebug() << "Cancelling took" << latencyMs << "ms, above the" << rpi_imager::TimeoutDefaults::kCancelTargetMs << "ms target";
+        _performanceStats->recordEvent(PerformanceStats::EventType::WriteCancellation,
+                                       static_cast<quint32>(latencyMs),
+                                       latencyMs <= rpi_imager::TimeoutDefaults::kCancelTargetMs,
+                                       QString("syncInFlight: %1").arg(syncInFlight ? "yes" : "no"));
+        _cancelTimer.invalidate();
+    }
+
+    // Clean up thread
     if (senderObj) {
         senderObj->deleteLater();
         if (senderObj == _thread)
@@ -1933,33 +2281,6 @@ void ImageWriter::setCustomOsListUrl(const QUrl &url)
 }
 
 namespace {
-    QJsonArray findAndInsertJsonResult(QJsonArray parent_list, QJsonArray incomingBody, QUrl referenceUrl, uint8_t count) {
-        if (count > MAX_SUBITEMS_DEPTH) {
-            qDebug() << "Aborting insertion of subitems, exceeded maximum configured limit of " << MAX_SUBITEMS_DEPTH << " levels.";
-            return {};
-        }
-
-        QJsonArray returnArray = {};
-
-        for (auto ositem : parent_list) {
-            auto ositemObject = ositem.toObject();
-
-            if (ositemObject.contains("subitems")) {
-                // Recurse!
-                ositemObject["subitems"] = findAndInsertJsonResult(ositemObject["subitems"].toArray(), incomingBody, referenceUrl, count + 1);
-            } else if (ositemObject.contains("subitems_url")) {
-                if ( !ositemObject["subitems_url"].toString().compare(referenceUrl.toString())) {
-                    ositemObject.insert("subitems", incomingBody);
-                    ositemObject.remove("subitems_url");
-                }
-            }
-
-            returnArray += ositemObject;
-        }
-
-        return returnArray;
-    }
-
     // Centralized URL preflight validation for fetches
     // Note: We intentionally skip filesystem validation (exists/isFile) for local files
     // as these calls can be slow on iCloud-synced directories or network volumes.
@@ -2001,21 +2322,85 @@ void ImageWriter::queueSublistFetches(const QJsonArray &list, int depth)
                 continue;
             }
 
-            // Create a CurlFetcher for this sublist
-            auto *fetcher = new CurlFetcher(this);
-            connect(fetcher, &CurlFetcher::finished, this, &ImageWriter::onOsListFetchComplete);
-            connect(fetcher, &CurlFetcher::error, this, &ImageWriter::onOsListFetchError);
-            connect(fetcher, &CurlFetcher::connectionStats, this, &ImageWriter::onNetworkConnectionStats);
-            
-            // Track start time for performance
-            _pendingFetchStartTimes[subUrl] = QDateTime::currentMSecsSinceEpoch();
-            fetcher->fetch(subUrl);
+            startOsListFetch(subUrl);
         }
     }
 }
 
+void ImageWriter::startOsListFetch(const QUrl &url)
+{
+    auto *fetcher = new CurlFetcher(this);
+    connect(fetcher, &CurlFetcher::finished, this, &ImageWriter::onOsListFetchComplete);
+    connect(fetcher, &CurlFetcher::error, this, &ImageWriter::onOsListFetchError);
+    connect(fetcher, &CurlFetcher::connectionStats, this, &ImageWriter::onNetworkConnectionStats);
+
+    // Revalidate the copy from the last fetch rather than downloading it again
+    OsListCache::Response cached;
+    if (_osListCache.lookup(url, &cached))
+        fetcher->setCachedResponse(cached.body, cached.etag, cached.lastModified);
+
+    // The top-level list gates everything else; a category the user has
+    // already opened jumps the queue via prioritizeSublist()
+    if (url == osListUrl() || _prioritizedSublists.contains(url))
+        fetcher->setPriority(CurlFetcher::HighPriority);
+
+    // With nothing on screen yet, show the top-level entries as they arrive
+    if (url == osListUrl() && !_stagingOsList && _completeOsList.isEmpty()) {
+        _osListStream = std::make_unique<OsListStreamParser>();
+        _osListStreamFetcher = fetcher;
+        fetcher->setStreaming(true);
+        connect(fetcher, &CurlFetcher::dataReceived, this, &ImageWriter::onOsListDataReceived);
+    }
+
+    _pendingOsListUrls.insert(url);
+    _osListFetchers.insert(url, fetcher);
+
+    // Track start time for performance
+    _pendingFetchStartTimes[url] = QDateTime::currentMSecsSinceEpoch();
+    fetcher->fetch(url);
+}
+
+void ImageWriter::prioritizeSublist(const QString &subitemsUrl)
+{
+    const QUrl url(subitemsUrl);
+    if (!url.isValid())
+        return;
+
+    _prioritizedSublists.insert(url);
+    CurlFetcher *fetcher = _osListFetchers.value(url);
+    if (fetcher) {
+        qDebug() << "Prioritising sublist fetch for opened category:" << url;
+        fetcher->setPriority(CurlFetcher::HighPriority);
+    }
+}
+
+void ImageWriter::setVisibleOsIcons(const QStringList &visible, const QStringList &upcoming)
+{
+#ifndef CLI_ONLY_BUILD
+    // Only icons served by the icon provider go through IconMultiFetcher;
+    // normalise them the way IconImageResponse keys its fetches
+    auto toUrlKeys = [](const QStringList &icons) {
+        static const QString prefix = QStringLiteral("image://icons/");
+        QStringList keys;
+        keys.reserve(icons.size());
+        for (const QString &icon : icons) {
+            if (icon.startsWith(prefix))
+                keys.append(QUrl(icon.mid(prefix.size())).toString());
+        }
+        return keys;
+    };
+    IconMultiFetcher::instance().setVisibleIcons(toUrlKeys(visible), toUrlKeys(upcoming));
+#else
+    Q_UNUSED(visible);
+    Q_UNUSED(upcoming);
+#endif
+}
+
 
 void ImageWriter::setHWFilterList(const QJsonArray &tags, const bool &inclusive) {
+    // Re-selecting a device, or one with the same tags, filters nothing new
+    if (tags == _deviceFilter && inclusive == _deviceFilterIsInclusive)
+        return;
     _deviceFilter = tags;
     _deviceFilterIsInclusive = inclusive;
     emit hwFilterChanged();
@@ -2077,7 +2462,41 @@ bool ImageWriter::checkSWCapability(const QString &cap) {
     return false;
 }
 
+void ImageWriter::onOsListDataReceived(const QByteArray &chunk, const QUrl &url)
+{
+    if (!_osListStream || sender() != _osListStreamFetcher || _osListStream->hasError())
+        return;
+
+    const QList<QJsonObject> entries = _osListStream->feed(chunk);
+    if (entries.isEmpty())
+        return;
+
+    const bool wasEmpty = _completeOsList.isEmpty();
+    for (const QJsonObject &entry : entries) {
+        _completeOsList.appendTopLevel(entry);
+        // Sublists are fetched while the rest of the list downloads
+        queueSublistFetches(QJsonArray{entry}, 1);
+    }
+
+    if (wasEmpty) {
+        qDebug() << "Showing OS list entries while" << url << "downloads";
+        PlatformQuirks::stopNetworkMonitoring();
+        emit osListUnavailableChanged();
+    }
+
+    // Rebuilding the model for every chunk would cost more than it saves
+    if (wasEmpty || _osListStreamTimer.elapsed() >= kOsListStreamIntervalMs) {
+        _osListStreamTimer.start();
+        emit osListPrepared();
+    }
+}
+
 void ImageWriter::onOsListFetchComplete(const QByteArray &data, const QUrl &url, const QUrl &effectiveUrl)
+{
+    applyOsListResponse(data, url, effectiveUrl, qobject_cast<CurlFetcher *>(sender()));
+}
+
+void ImageWriter::applyOsListResponse(const QByteArray &data, const QUrl &url, const QUrl &effectiveUrl, CurlFetcher *fetcher)
 {
     // Calculate request duration for performance tracking
     quint32 durationMs = 0;
@@ -2105,39 +2524,74 @@ void ImageWriter::onOsListFetchComplete(const QByteArray &data, const QUrl &url,
         }
     }
 
-    auto response_object = QJsonDocument::fromJson(data).object();
+    // A list read entry by entry as it arrived is already in the tree
+    std::unique_ptr<OsListStreamParser> stream;
+    if (_osListStream && fetcher && fetcher == _osListStreamFetcher) {
+        stream = std::move(_osListStream);
+        _osListStreamFetcher.clear();
+    }
+    const bool streamed = stream && stream->isComplete() && stream->entryCount() > 0;
+    if (stream && !streamed && stream->entryCount() > 0) {
+        qDebug() << "OS list did not stream cleanly, parsing it whole:" << url;
+        _completeOsList.clear();
+    }
+
+    QJsonObject response_object;
+    if (!streamed)
+        response_object = QJsonDocument::fromJson(data).object();
+
+#ifndef CLI_ONLY_BUILD
+    // OS names and descriptions in CJK need the fallback font on embedded systems
+    if (isEmbeddedMode() && !AppFonts::cjkFallbackTried() && AppFonts::containsCjk(QString::fromUtf8(data)))
+        AppFonts::ensureCjkFallback();
+#endif
+
+    // A sublist has nothing to go into once its top-level list was dropped
+    OsListTree &target = _stagingOsList ? _stagedOsList : _completeOsList;
+    if (!isTopLevelRequest && target.isEmpty()) {
+        qDebug() << "Ignoring sublist of a discarded OS list:" << url;
+    } else if (streamed || response_object.contains("os_list")) {
+        // Keep the list and its validators so the next fetch can be answered
+        // with 304 Not Modified
+        if (fetcher && !fetcher->wasNotModified()) {
+            _osListCache.store(url, {data, fetcher->etag(), fetcher->lastModified()});
+        }
 
-    if (response_object.contains("os_list")) {
-        // Step 1: Insert the items into the canonical JSON document.
+        // Step 1: Splice the items into the OS list tree.
         //         It doesn't matter that these may still contain subitems_url items
         //         As these will be fixed up as the subitems_url instances are blinked in
-        bool wasEmpty = _completeOsList.isEmpty();
+        bool wasEmpty = target.isEmpty();
+        QList<int> changedRows;
         
         // Stop network monitoring on any successful fetch (initial or refresh)
         // This handles both the startup case and the "refresh failed, now succeeded" case
         PlatformQuirks::stopNetworkMonitoring();
         
-        if (wasEmpty) {
-            _completeOsList = QJsonDocument(response_object);
+        if (streamed) {
+            target.setImagerMetadata(stream->imagerMetadata());
+        } else if (wasEmpty) {
+            target = OsListTree(QJsonDocument(response_object));
             // Notify UI that OS list is now available (was unavailable, now has data)
-            emit osListUnavailableChanged();
+            if (!_stagingOsList)
+                emit osListUnavailableChanged();
         } else {
-            // Preserve latest top-level imager metadata if present in the top-level fetch
-            auto new_list = findAndInsertJsonResult(_completeOsList["os_list"].toArray(), response_object["os_list"].toArray(), url, 1);
-            QJsonObject imager_meta = _completeOsList["imager"].toObject();
+            changedRows = target.insertSublist(url.toString(), response_object["os_list"].toArray());
             if (response_object.contains("imager") && isTopLevelRequest) {
                 // Update imager metadata when this reply is for the top-level OS list
-                imager_meta = response_object["imager"].toObject();
+                target.setImagerMetadata(response_object["imager"].toObject());
             }
-            _completeOsList = QJsonDocument(QJsonObject({
-                {"imager", imager_meta},
-                {"os_list", new_list}
-            }));
         }
 
-        // Queue fetches for any subitems_url entries
-        queueSublistFetches(response_object["os_list"].toArray(), 1);
-        emit osListPrepared();
+        // Queue fetches for any subitems_url entries (already done for a streamed list)
+        if (!streamed)
+            queueSublistFetches(response_object["os_list"].toArray(), 1);
+        if (!_stagingOsList) {
+            // A sublist only touches the rows that referred to it
+            if (wasEmpty || isTopLevelRequest)
+                emit osListPrepared();
+            else if (!changedRows.isEmpty())
+                emit osListEntriesChanged(changedRows);
+        }
         
         // Record performance event for OS list fetch
         if (durationMs > 0) {
@@ -2149,7 +2603,8 @@ void ImageWriter::onOsListFetchComplete(const QByteArray &data, const QUrl &url,
         }
 
         // After processing a top-level list fetch, (re)schedule the next refresh
-        if (isTopLevelRequest) {
+        // (a staged list does so once it is swapped in)
+        if (isTopLevelRequest && !_stagingOsList) {
             scheduleOsListRefresh();
         }
     } else {
@@ -2160,12 +2615,50 @@ void ImageWriter::onOsListFetchComplete(const QByteArray &data, const QUrl &url,
             emit osListUnavailableChanged();
         }
     }
+
+    _pendingOsListUrls.remove(url);
+    _osListFetchers.remove(url);
+    if (_pendingOsListUrls.isEmpty())
+        finishOsListAssembly();
+}
+
+void ImageWriter::finishOsListAssembly()
+{
+    bool changed = true;
+    if (_stagingOsList) {
+        _stagingOsList = false;
+        if (_stagedOsList.isEmpty()) {
+            // Top-level list was unusable; keep what is on screen
+            return;
+        }
+        changed = _stagedOsList.toDocument() != _completeOsList.toDocument();
+        _completeOsList = std::move(_stagedOsList);
+        _stagedOsList.clear();
+        _osListFromSnapshot = false;
+        if (changed)
+            emit osListPrepared();
+        scheduleOsListRefresh();
+    }
+
+    if (changed && !_completeOsList.isEmpty() && !_osListFromSnapshot)
+        _osListCache.storeSnapshot(osListUrl(), _completeOsList.toDocument());
 }
 
 void ImageWriter::onOsListFetchError(const QString &errorMessage, const QUrl &url)
 {
     // Clean up start time tracking
     _pendingFetchStartTimes.remove(url);
+
+    // Entries shown from a download that then failed are not the list
+    if (_osListStream && sender() && sender() == _osListStreamFetcher) {
+        const bool shown = _osListStream->entryCount() > 0;
+        _osListStream.reset();
+        _osListStreamFetcher.clear();
+        if (shown) {
+            _completeOsList.clear();
+            emit osListPrepared();
+        }
+    }
     
     // Track if this is the top-level OS list request
     bool isTopLevelRequest = (url == osListUrl());
@@ -2180,11 +2673,31 @@ void ImageWriter::onOsListFetchError(const QString &errorMessage, const QUrl &ur
 
     qDebug() << "Failed to fetch URL [" << url << "]:" << errorMessage;
 
+    // A sublist that cannot be fetched now is taken from the last run
+    OsListCache::Response cached;
+    if (!isTopLevelRequest && _osListCache.lookup(url, &cached)) {
+        qDebug() << "Using cached copy of" << url;
+        applyOsListResponse(cached.body, url, url, nullptr);
+        return;
+    }
+
+    _pendingOsListUrls.remove(url);
+    _osListFetchers.remove(url);
+    if (isTopLevelRequest) {
+        // Nothing to assemble; whatever is on screen stays
+        _stagingOsList = false;
+        _stagedOsList.clear();
+        _pendingOsListUrls.clear();
+        _osListFetchers.clear();
+    } else if (_pendingOsListUrls.isEmpty()) {
+        finishOsListAssembly();
+    }
+
     // If the top-level OS list fetch fails with a connection error and we haven't
     // tried IPv4-only yet, retry with IPv4-only mode. This handles Windows 11 systems
     // with broken IPv6 routing where DNS returns AAAA records but IPv6 connections
     // time out, while the browser's Happy Eyeballs falls back to IPv4 transparently.
-    if (isTopLevelRequest && _completeOsList.isEmpty()
+    if (isTopLevelRequest && (_completeOsList.isEmpty() || _osListFromSnapshot)
         && !CurlNetworkConfig::instance().ipv4Only()
         && PlatformQuirks::hasNetworkConnectivity()) {
         qDebug() << "OS list fetch failed with connectivity present - retrying with IPv4-only";
@@ -2227,53 +2740,6 @@ void ImageWriter::onNetworkConnectionStats(const QString &statsMetadata, const Q
     _performanceStats->recordEvent(PerformanceStats::EventType::NetworkConnectionStats, 0, true, fullMetadata);
 }
 
-namespace {
-    QJsonArray filterOsListWithHWTags(QJsonArray incoming_os_list, QJsonArray hw_filter, const bool inclusive, uint8_t count) {
-        if (count > MAX_SUBITEMS_DEPTH) {
-            qDebug() << "Aborting insertion of subitems, exceeded maximum configured limit of " << MAX_SUBITEMS_DEPTH << " levels.";
-            return {};
-        }
-
-        QJsonArray returnArray = {};
-
-        for (auto ositem : incoming_os_list) {
-            auto ositemObject = ositem.toObject();
-
-            if (ositemObject.contains("subitems")) {
-                // Recurse!
-                ositemObject["subitems"] = filterOsListWithHWTags(ositemObject["subitems"].toArray(), hw_filter, inclusive, count + 1);
-                if (ositemObject["subitems"].toArray().count() > 0) {
-                    returnArray += ositemObject;
-                }
-            } else {
-                // Filter this one!
-                if (ositemObject.contains("devices")) {
-                    auto keep = false;
-                    const auto ositem_devices = ositemObject["devices"].toArray();
-
-                    for (auto compat_device : ositem_devices) {
-                        if (hw_filter.contains(compat_device.toString())) {
-                            keep = true;
-                            break;
-                        }
-                    }
-
-                    if (keep) {
-                        returnArray.append(ositem);
-                    }
-                } else {
-                    // No devices tags, so work out if we're exclusive or inclusive filtering!
-                    if (inclusive) {
-                        returnArray.append(ositem);
-                    }
-                }
-            }
-        }
-
-        return returnArray;
-    }
-} // namespace anonymous
-
 QByteArray ImageWriter::getFilteredOSlist()
 {
     return getFilteredOSlistDocument().toJson();
@@ -2290,37 +2756,69 @@ QJsonDocument ImageWriter::getFilteredOSlistDocument() {
     {
         if (!_completeOsList.isEmpty()) {
             if (!_deviceFilter.isEmpty()) {
-                reference_os_list_array = filterOsListWithHWTags(_completeOsList.object().value("os_list").toArray(), _deviceFilter, _deviceFilterIsInclusive, 1);
+                reference_os_list_array = _completeOsList.filteredList(_deviceFilter, _deviceFilterIsInclusive);
             } else {
                 // The device filter can be an empty array when a device filter has not been selected, or has explicitly been selected as
                 // "no filtering". In that case, avoid walking the tree and use the unfiltered list.
-                reference_os_list_array = _completeOsList.object().value("os_list").toArray();
+                reference_os_list_array = _completeOsList.toDocument().object().value("os_list").toArray();
             }
 
-            reference_imager_metadata = _completeOsList.object().value("imager").toObject();
+            reference_imager_metadata = _completeOsList.imagerMetadata();
         }
     }
 
-    reference_os_list_array.append(QJsonObject({
+    for (const auto &entry : internalOSlistEntries())
+        reference_os_list_array.append(entry);
+
+    return QJsonDocument(
+        QJsonObject({
+            {"imager", reference_imager_metadata},
+            {"os_list", reference_os_list_array},
+        }
+    ));
+}
+
+int ImageWriter::getOSlistEntryCount() const
+{
+    return _completeOsList.topLevelCount();
+}
+
+QJsonObject ImageWriter::getFilteredOSlistEntry(int row)
+{
+    if (_device_info->hardwareTagsSet()) {
+        _deviceFilter = _device_info->getHardwareTags();
+    }
+
+    if (_deviceFilter.isEmpty())
+        return _completeOsList.topLevelEntry(row);
+    return _completeOsList.filteredTopLevelEntry(row, _deviceFilter, _deviceFilterIsInclusive);
+}
+
+QJsonArray ImageWriter::searchOSList(const QString &query, int limit)
+{
+    if (_device_info->hardwareTagsSet()) {
+        _deviceFilter = _device_info->getHardwareTags();
+    }
+
+    return _completeOsList.search(query, _deviceFilter, _deviceFilterIsInclusive, limit);
+}
+
+QJsonArray ImageWriter::internalOSlistEntries()
+{
+    return {
+        QJsonObject({
             {"name", QCoreApplication::translate("main", "Erase")},
             {"description", QCoreApplication::translate("main", "Format card as FAT32")},
             {"icon", "../icons/erase.png"},
             {"url", "internal://format"},
-        }));
-
-    reference_os_list_array.append(QJsonObject({
+        }),
+        QJsonObject({
             {"name", QCoreApplication::translate("main", "Use custom")},
             {"description", QCoreApplication::translate("main", "Select a custom .img from your computer")},
             {"icon", "../icons/use_custom.png"},
             {"url", "internal://custom"},
-        }));
-
-    return QJsonDocument(
-        QJsonObject({
-            {"imager", reference_imager_metadata},
-            {"os_list", reference_os_list_array},
-        }
-    ));
+        }),
+    };
 }
 
 void ImageWriter::beginOSListFetch() {
@@ -2333,24 +2831,39 @@ void ImageWriter::beginOSListFetch() {
     // This is a no-op if a proxy was already detected or manually configured.
     CurlNetworkConfig::instance().detectSystemProxy(topUrl);
 
-    // Create a CurlFetcher to fetch the OS list
-    auto *fetcher = new CurlFetcher(this);
-    connect(fetcher, &CurlFetcher::finished, this, &ImageWriter::onOsListFetchComplete);
-    connect(fetcher, &CurlFetcher::error, this, &ImageWriter::onOsListFetchError);
-    connect(fetcher, &CurlFetcher::connectionStats, this, &ImageWriter::onNetworkConnectionStats);
-    
-    // Track start time for performance
-    _pendingFetchStartTimes[topUrl] = QDateTime::currentMSecsSinceEpoch();
-    
+    // Show the list assembled on the last run straight away; the fetched
+    // one replaces it once every sublist has arrived
+    if (_completeOsList.isEmpty()) {
+        QJsonDocument snapshot = _osListCache.loadSnapshot(topUrl);
+        if (!snapshot.isEmpty()) {
+            qDebug() << "Populating OS list from cached snapshot while fetching";
+            _completeOsList = OsListTree(snapshot);
+            _osListFromSnapshot = true;
+            emit osListUnavailableChanged();
+            emit osListPrepared();
+        }
+    }
+
+    // With a list already on screen (snapshot or refresh), assemble the new
+    // one off-screen so the UI never shows a half-merged list
+    _stagingOsList = !_completeOsList.isEmpty();
+    _stagedOsList.clear();
+    _osListStream.reset();
+    _osListStreamFetcher.clear();
+    _pendingOsListUrls.clear();
+    _osListFetchers.clear();
+    _prioritizedSublists.clear();
+
     // This will set up a chain of requests that culminate in the eventual fetch and assembly of
     // a complete cached OS list.
-    fetcher->fetch(topUrl);
+    startOsListFetch(topUrl);
 }
 
 void ImageWriter::refreshOsListFrom(const QUrl &url) {
     setCustomRepo(url);
     bool wasAvailable = !_completeOsList.isEmpty();
-    _completeOsList = QJsonDocument();
+    _completeOsList.clear();
+    _osListFromSnapshot = false;
     if (wasAvailable) {
         // Notify UI that OS list is now unavailable (cleared for refetch)
         emit osListUnavailableChanged();
@@ -2389,16 +2902,13 @@ void ImageWriter::scheduleOsListRefresh()
     }
 
     if (!_completeOsList.isEmpty()) {
-        QJsonObject root = _completeOsList.object();
-        if (root.contains("imager")) {
-            QJsonObject imager = root.value("imager").toObject();
-            // New optional fields
-            if (baseMinutes <= 0 && imager.contains("refresh_interval_minutes")) {
-                baseMinutes = imager.value("refresh_interval_minutes").toInt(0);
-            }
-            if (jitterMinutes <= 0 && imager.contains("refresh_jitter_minutes")) {
-                jitterMinutes = imager.value("refresh_jitter_minutes").toInt(0);
-            }
+        const QJsonObject imager = _completeOsList.imagerMetadata();
+        // New optional fields
+        if (baseMinutes <= 0 && imager.contains("refresh_interval_minutes")) {
+            baseMinutes = imager.value("refresh_interval_minutes").toInt(0);
+        }
+        if (jitterMinutes <= 0 && imager.contains("refresh_jitter_minutes")) {
+            jitterMinutes = imager.value("refresh_jitter_minutes").toInt(0);
         }
     }
 
@@ -2477,6 +2987,13 @@ void ImageWriter::startProgressPolling()
     
     _dlnow = 0;
     _verifynow = 0;
+
+    // "ui/lowRenderWhileWriting" off keeps full rendering, to compare the UI
+    // thread's CPU time with
+    if (::isEmbeddedMode() && _settings.value("ui/lowRenderWhileWriting", true).toBool())
+        _setLowRenderMode(true);
+    _uiCpuStartUs = ThreadCpuTime::currentThreadUs();
+    _uiCpuTimer.start();
     
     // Create and start the progress watchdog component
     if (!_progressWatchdog) {
@@ -2488,18 +3005,28 @@ void ImageWriter::startProgressPolling()
                     qDebug() << "Watchdog: Hot-swap to sync mode succeeded";
                     _performanceStats->recordEvent(PerformanceStats::EventType::WatchdogRecovery, 0, true,
                         QString("action=hotSwap; %1").arg(reason));
+                    LiveMetrics::instance().addRecovery(LiveMetrics::Recovery::HotSwap);
                     emit operationWarning(reason);
                 });
+        connect(_progressWatchdog, &WriteProgressWatchdog::queueDepthRecovery,
+                this, [this](QString transition, int fromDepth, int toDepth) {
+                    bool success = transition != "probeFailed" && transition != "gaveUp";
+                    _performanceStats->recordEvent(PerformanceStats::EventType::WatchdogRecovery, 0, success,
+                        QString("action=%1; depth=%2->%3").arg(transition).arg(fromDepth).arg(toDepth));
+                    LiveMetrics::instance().addRecovery(LiveMetrics::Recovery::QueueDepth);
+                });
         connect(_progressWatchdog, &WriteProgressWatchdog::restartNeeded,
                 this, [this](QString reason) {
                     _performanceStats->recordEvent(PerformanceStats::EventType::WatchdogRecovery, 0, false,
                         QString("action=restart; %1").arg(reason));
+                    LiveMetrics::instance().addRecovery(LiveMetrics::Recovery::Restart);
                     restartWrite(reason);
                 });
         connect(_progressWatchdog, &WriteProgressWatchdog::hardTimeout,
                 this, [this](QString error) {
                     _performanceStats->recordEvent(PerformanceStats::EventType::WatchdogRecovery, 0, false,
                         QString("action=hardTimeout; %1").arg(error));
+                    LiveMetrics::instance().addRecovery(LiveMetrics::Recovery::HardTimeout);
                     onError(error);
                 });
         connect(_progressWatchdog, &WriteProgressWatchdog::stallWarning,
@@ -2517,8 +3044,66 @@ void ImageWriter::startProgressPolling()
     // period where system dialogs block the thread but no I/O has begun. (#1511)
 }
 
-void ImageWriter::stopProgressPolling()
-{
+/*
+ * Called on every sample of the write thread's counters. Drives what used to
+ * be connected to the thread's progress signals: the QVariant signals the
+ * CLI listens to, the performance stats and the switch to Verifying.
+ */
+void ImageWriter::_onProgressSampled(const ProgressSnapshot &sample)
+{
+    const ProgressSnapshot &last = _lastProgressSample;
+
+    if (sample.downloadNow != last.downloadNow || (sample.downloadTotal > 0 && last.downloadTotal == 0)) {
+        _performanceStats->recordDownloadProgress(sample.downloadNow, sample.downloadTotal);
+        if (sample.downloadNow > last.downloadNow)
+            LiveMetrics::instance().addPhaseBytes(LiveMetrics::Phase::Download, sample.downloadNow - last.downloadNow);
+        emit downloadProgress(QVariant(sample.downloadNow), QVariant(sample.downloadTotal));
+    }
+
+    if (sample.decompressNow != last.decompressNow) {
+        _performanceStats->recordDecompressProgress(sample.decompressNow, sample.writeTotal);
+        if (sample.decompressNow > last.decompressNow)
+            LiveMetrics::instance().addPhaseBytes(LiveMetrics::Phase::Decompress, sample.decompressNow - last.decompressNow);
+    }
+
+    if (sample.writeNow != last.writeNow) {
+        _performanceStats->recordWriteProgress(sample.writeNow, sample.writeTotal);
+        if (sample.writeNow > last.writeNow)
+            LiveMetrics::instance().addPhaseBytes(LiveMetrics::Phase::Write, sample.writeNow - last.writeNow);
+        emit writeProgress(QVariant(sample.writeNow), QVariant(sample.writeTotal));
+    }
+
+    if (sample.verifyNow != last.verifyNow || (sample.verifyTotal > 0 && last.verifyTotal == 0)) {
+        _performanceStats->recordVerifyProgress(sample.verifyNow, sample.verifyTotal);
+        if (sample.verifyNow > last.verifyNow)
+            LiveMetrics::instance().addPhaseBytes(LiveMetrics::Phase::Verify, sample.verifyNow - last.verifyNow);
+        emit verifyProgress(QVariant(sample.verifyNow), QVariant(sample.verifyTotal));
+
+        if (_writeState != WriteState::Verifying && _writeState != WriteState::Finalizing &&
+            _writeState != WriteState::Succeeded && _writeState != WriteState::Cancelling)
+            setWriteState(WriteState::Verifying);
+    }
+
+    _lastProgressSample = sample;
+}
+
+void ImageWriter::stopProgressPolling()
+{
+    _progressAggregator->stop();
+    _setLowRenderMode(false);
+
+    // Set against the pipeline stages, this is what showing progress cost
+    if (_uiCpuStartUs >= 0)
+    {
+        const qint64 cpuUs = ThreadCpuTime::currentThreadUs();
+        if (cpuUs >= _uiCpuStartUs)
+        {
+            const quint32 wallMs = static_cast<quint32>(_uiCpuTimer.elapsed());
+            _performanceStats->recordStageCpuTime("ui", static_cast<quint32>((cpuUs - _uiCpuStartUs) / 1000), wallMs, wallMs);
+        }
+        _uiCpuStartUs = -1;
+    }
+
     // Stop the progress watchdog
     if (_progressWatchdog) {
         _progressWatchdog->stop();
@@ -2531,6 +3116,16 @@ void ImageWriter::stopProgressPolling()
     }
 }
 
+void ImageWriter::_setLowRenderMode(bool enabled)
+{
+    if (enabled == _lowRenderMode)
+        return;
+    _lowRenderMode = enabled;
+    _progressAggregator->setInterval(enabled ? kLowRenderProgressIntervalMs : kEmbeddedProgressIntervalMs);
+    qDebug() << "Low-render mode" << (enabled ? "on" : "off");
+    emit lowRenderModeChanged();
+}
+
 void ImageWriter::restartWrite(QString reason)
 {
     qDebug() << "Restarting write:" << reason;
@@ -2615,6 +3210,35 @@ void ImageWriter::setVerifyEnabled(bool verify)
         _thread->setVerifyEnabled(verify);
 }
 
+void ImageWriter::setVerifyCoverage(double percent)
+{
+    _verifyCoverage = percent;
+    if (_thread)
+        _thread->setVerifyCoverage(percent);
+}
+
+void ImageWriter::setIoTraceFile(const QString &path)
+{
+    _ioTraceFile = path;
+    if (_thread)
+        _thread->setIoTraceFile(path);
+}
+
+bool ImageWriter::getEraseBeforeWrite() const
+{
+    return _eraseBeforeWrite;
+}
+
+void ImageWriter::setEraseBeforeWrite(bool erase)
+{
+    _eraseBeforeWrite = erase;
+}
+
+void ImageWriter::setWritePartitions(const QList<int> &partitions)
+{
+    _writePartitions = partitions;
+}
+
 /* Relay events from download thread to QML */
 void ImageWriter::onSuccess()
 {
@@ -3105,6 +3729,9 @@ bool ImageWriter::mountUsbSourceMedia()
     return devices > 0;
 }
 
+/* The index of each medium is kept by volume UUID, so that hashes and
+   extract sizes found once are not looked for again. Images without a hash
+   are hashed in the background; the next listing includes it. */
 QByteArray ImageWriter::getUsbSourceOSlist()
 {
 #ifdef Q_OS_LINUX
@@ -3112,33 +3739,140 @@ QByteArray ImageWriter::getUsbSourceOSlist()
     QDir dir("/media");
     const QStringList medialist = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
     QStringList namefilters = {"*.img", "*.zip", "*.gz", "*.xz", "*.zst", "*.wic"};
+    UsbSourceIndex index;
+    QList<QPair<QString, QString>> unhashed;
 
     for (const QString &devname : medialist)
     {
         QDir subdir("/media/"+devname);
         const QStringList files = subdir.entryList(namefilters, QDir::Files, QDir::Name);
-        for (const QString &file : files)
-        {
-            QString path = "/media/"+devname+"/"+file;
-            QFileInfo fi(path);
-
-            QJsonObject f = {
-                {"name", file},
-                {"description", devname+"/"+file},
-                {"url", QUrl::fromLocalFile(path).toString() },
-                {"release_date", ""},
-                {"image_download_size", fi.size()}
-            };
-            oslist.append(f);
-        }
+        const QString uuid = UsbSourceIndex::volumeUuid(devname);
+
+        auto list = [&](UsbSourceIndex::Entries *entries) {
+            bool changed = false;
+            for (const QString &file : files)
+            {
+                QString path = "/media/"+devname+"/"+file;
+                QFileInfo fi(path);
+
+                QJsonObject f = {
+                    {"name", file},
+                    {"description", devname+"/"+file},
+                    {"url", QUrl::fromLocalFile(path).toString() },
+                    {"release_date", ""},
+                    {"image_download_size", fi.size()}
+                };
+
+                if (entries)
+                {
+                    UsbSourceIndex::Entry entry = entries->value(file);
+                    if (!UsbSourceIndex::matches(entry, fi))
+                    {
+                        entry = UsbSourceIndex::entryFor(fi);
+                        const QString suffix = fi.suffix().toLower();
+                        if (suffix == "img" || suffix == "wic")
+                            entry.extractSize = static_cast<quint64>(fi.size());
+                        entries->insert(file, entry);
+                        changed = true;
+                    }
+                    if (entry.sha256.isEmpty())
+                        unhashed.append({uuid, path});
+                    else
+                        f.insert("image_download_sha256", QString::fromLatin1(entry.sha256));
+                    if (entry.extractSize)
+                        f.insert("extract_size", static_cast<qint64>(entry.extractSize));
+                }
+                oslist.append(f);
+            }
+
+            // Images no longer on the medium
+            if (entries)
+            {
+                for (auto it = entries->begin(); it != entries->end();)
+                {
+                    if (files.contains(it.key()))
+                    {
+                        ++it;
+                    }
+                    else
+                    {
+                        it = entries->erase(it);
+                        changed = true;
+                    }
+                }
+            }
+            return changed;
+        };
+
+        if (uuid.isEmpty())
+            list(nullptr);
+        else
+            index.update(uuid, [&](UsbSourceIndex::Entries &entries) { return list(&entries); });
     }
 
+    if (!unhashed.isEmpty())
+        _hashUsbSources(unhashed);
+
     return QJsonDocument(oslist).toJson();
 #else
     return QByteArray();
 #endif
 }
 
+void ImageWriter::_hashUsbSources(const QList<QPair<QString, QString>> &images)
+{
+    // One pass at a time; images it misses are picked up by the next listing
+    if (_usbSourceHashing.valid() &&
+        _usbSourceHashing.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+
+    _usbSourceHashing = std::async(std::launch::async, [this, images]() {
+        UsbSourceIndex index;
+        for (const auto &image : images)
+        {
+            const QFileInfo fi(image.second);
+            const QByteArray sha256 = UsbSourceIndex::hashFile(image.second, _usbSourceHashingCancel);
+            if (_usbSourceHashingCancel.load())
+                return;
+            if (sha256.isEmpty())
+                continue;
+
+            qDebug() << "Hashed source image" << image.second;
+            index.update(image.first, [&](UsbSourceIndex::Entries &entries) {
+                auto it = entries.find(fi.fileName());
+                // Not if the file was replaced while it was being read
+                if (it == entries.end() || !UsbSourceIndex::matches(*it, QFileInfo(image.second)))
+                    return false;
+                it->sha256 = sha256;
+                return true;
+            });
+        }
+    });
+}
+
+void ImageWriter::_storeUsbSourceExtractSize()
+{
+#ifdef Q_OS_LINUX
+    const QFileInfo fi(_src.toLocalFile());
+    const QString mountdir = fi.absolutePath();
+    if (QFileInfo(mountdir).absolutePath() != "/media")
+        return;
+
+    const QString uuid = UsbSourceIndex::volumeUuid(QFileInfo(mountdir).fileName());
+    if (uuid.isEmpty())
+        return;
+
+    const quint64 extrLen = _extrLen;
+    UsbSourceIndex().update(uuid, [&](UsbSourceIndex::Entries &entries) {
+        auto it = entries.find(fi.fileName());
+        if (it == entries.end() || !UsbSourceIndex::matches(*it, fi) || it->extractSize == extrLen)
+            return false;
+        it->extractSize = extrLen;
+        return true;
+    });
+#endif
+}
+
 QString ImageWriter::_sshKeyDir()
 {
     return QDir::homePath()+"/.ssh";
@@ -3220,86 +3954,98 @@ QString ImageWriter::getTimezone()
     return QTimeZone::systemTimeZoneId();
 }
 
-QStringList ImageWriter::getTimezoneList()
+namespace {
+
+QString fromUtf8(std::string_view text)
 {
-    QStringList timezones;
-    QFile f(":/timezones.txt");
-    if (f.open(QFile::ReadOnly | QFile::Text)) {
-        timezones = QString::fromUtf8(f.readAll()).split('\n');
-        for (QString &s : timezones)
-            s = s.trimmed();
-        f.close();
-    }
+    return QString::fromUtf8(text.data(), static_cast<qsizetype>(text.size()));
+}
 
-    return timezones;
+QStringList staticDataList(std::span<const StaticData::Entry> entries)
+{
+    QStringList list;
+    list.reserve(static_cast<qsizetype>(entries.size()));
+    for (const StaticData::Entry &entry : entries)
+        list.append(fromUtf8(entry.text));
+    return list;
 }
 
-QStringList ImageWriter::getCountryList()
+/* The lowercased text from each word start, each preceded by a newline,
+ * so ImComboBox matches what is typed with a single indexOf("\n" + typed) */
+QStringList staticDataSearchKeys(std::span<const StaticData::Entry> entries)
 {
-    QStringList countries;
-    QFile f(":/countries.txt");
-    if (f.open(QFile::ReadOnly | QFile::Text))
+    QStringList keys;
+    keys.reserve(static_cast<qsizetype>(entries.size()));
+    for (const StaticData::Entry &entry : entries)
     {
-        countries = QString::fromUtf8(f.readAll()).split('\n', Qt::SkipEmptyParts);
-        for (QString &s : countries) s = s.trimmed();
-        f.close();
+        QString key;
+        for (std::uint8_t start : StaticData::wordStarts(entry))
+        {
+            key += QLatin1Char('\n');
+            key += fromUtf8(entry.text.substr(start)).toLower();
+        }
+        keys.append(key);
     }
+    return keys;
+}
+
+std::vector<StaticData::Entry> capitalCityEntries()
+{
+    std::vector<StaticData::Entry> entries;
+    for (const StaticData::CapitalCity &capital : StaticData::capitalCities())
+        entries.push_back(capital.display);
+    return entries;
+}
+
+} // namespace
+
+QStringList ImageWriter::getTimezoneList()
+{
+    static const QStringList timezones = staticDataList(StaticData::timezones());
+    return timezones;
+}
+
+QStringList ImageWriter::getTimezoneSearchKeys()
+{
+    static const QStringList keys = staticDataSearchKeys(StaticData::timezones());
+    return keys;
+}
 
+QStringList ImageWriter::getCountryList()
+{
+    static const QStringList countries = staticDataList(StaticData::countries());
     return countries;
 }
 
 QStringList ImageWriter::getKeymapLayoutList()
 {
-    QFile f(":/keymap-layouts.txt");
-    if (!f.open(QFile::ReadOnly | QFile::Text))
-        return {};
+    static const QStringList layouts = staticDataList(StaticData::keymapLayouts());
+    return layouts;
+}
 
-    QStringList list = QString::fromUtf8(f.readAll())
-                           .split('\n', Qt::SkipEmptyParts);
-    for (QString &s : list)
-        s = s.trimmed();
-    return list;
+QStringList ImageWriter::getKeymapLayoutSearchKeys()
+{
+    static const QStringList keys = staticDataSearchKeys(StaticData::keymapLayouts());
+    return keys;
 }
 
 QStringList ImageWriter::getCapitalCitiesList()
 {
-    QStringList cities;
-    QFile f(":/capital-cities.txt");
-    if (f.open(QFile::ReadOnly | QFile::Text))
-    {
-        QTextStream in(&f);
-        while (!in.atEnd())
-        {
-            QString line = in.readLine().trimmed();
-            // Skip empty lines and comments
-            if (line.isEmpty() || line.startsWith('#'))
-                continue;
-            
-            // Parse: CityName|CountryName|CountryCode|Timezone|Language|KeyboardLayout
-            QStringList parts = line.split('|');
-            if (parts.size() >= 2)
-            {
-                QString cityName = parts[0];
-                QString countryName = parts[1];
-                // Format as "City (Country)"
-                QString displayName = cityName + " (" + countryName + ")";
-                cities.append(displayName);
-            }
-        }
-        f.close();
-    }
-    
+    // Listed as "City (Country)"
+    static const QStringList cities = staticDataList(capitalCityEntries());
     return cities;
 }
 
+QStringList ImageWriter::getCapitalCitiesSearchKeys()
+{
+    static const QStringList keys = staticDataSearchKeys(capitalCityEntries());
+    return keys;
+}
+
 QVariantMap ImageWriter::getLocaleDataForCapital(const QString &capitalCity)
 {
     QVariantMap result;
-    QFile f(":/capital-cities.txt");
-    
-    if (!f.open(QFile::ReadOnly | QFile::Text))
-        return result;
-    
+
     // Extract just the city name from "City (Country)" format
     QString cityNameOnly = capitalCity;
     int parenIndex = capitalCity.indexOf(" (");
@@ -3307,30 +4053,18 @@ QVariantMap ImageWriter::getLocaleDataForCapital(const QString &capitalCity)
     {
         cityNameOnly = capitalCity.left(parenIndex);
     }
-    
-    QTextStream in(&f);
-    while (!in.atEnd())
-    {
-        QString line = in.readLine().trimmed();
-        // Skip empty lines and comments
-        if (line.isEmpty() || line.startsWith('#'))
-            continue;
-        
-        // Parse: CityName|CountryName|CountryCode|Timezone|Language|KeyboardLayout
-        QStringList parts = line.split('|');
-        if (parts.size() >= 6 && parts[0] == cityNameOnly)
-        {
-            result["cityName"] = parts[0];
-            result["countryName"] = parts[1];
-            result["countryCode"] = parts[2];
-            result["timezone"] = parts[3];
-            result["language"] = parts[4];
-            result["keyboard"] = parts[5];
-            break;
-        }
-    }
-    f.close();
-    
+
+    const QByteArray city = cityNameOnly.toUtf8();
+    const StaticData::CapitalCity *capital = StaticData::findCapital(std::string_view(city.constData(), static_cast<size_t>(city.size())));
+    if (!capital)
+        return result;
+
+    result["cityName"] = fromUtf8(capital->city);
+    result["countryName"] = fromUtf8(capital->country);
+    result["countryCode"] = fromUtf8(capital->countryCode);
+    result["timezone"] = fromUtf8(capital->timezone);
+    result["language"] = fromUtf8(capital->language);
+    result["keyboard"] = fromUtf8(capital->keyboard);
     return result;
 }
 
@@ -3688,6 +4422,142 @@ void ImageWriter::setDebugIgnoreDeviceLimits(bool enabled)
     }
 }
 
+qint64 ImageWriter::getDownloadRateLimit() const
+{
+    return BandwidthScheduler::instance().limit() / 1024;
+}
+
+void ImageWriter::setDownloadRateLimit(qint64 kbps)
+{
+    BandwidthScheduler::instance().setLimit(kbps * 1024);
+    if (kbps > 0)
+        qDebug() << "Downloads limited to" << kbps << "KB/s in total";
+}
+
+bool ImageWriter::getHttp3Enabled() const
+{
+    return CurlNetworkConfig::instance().http3();
+}
+
+void ImageWriter::setHttp3Enabled(bool enabled)
+{
+    CurlNetworkConfig::instance().setHttp3(enabled);
+    if (enabled && !CurlNetworkConfig::http3Available())
+        qDebug() << "HTTP/3 requested, but libcurl was built without it - using HTTP/2";
+}
+
+bool ImageWriter::isHttp3Available() const
+{
+    return CurlNetworkConfig::http3Available();
+}
+
+bool ImageWriter::getDebugParallelDownload() const
+{
+    return _debugParallelDownload;
+}
+
+void ImageWriter::setDebugParallelDownload(bool enabled)
+{
+    if (_debugParallelDownload != enabled) {
+        _debugParallelDownload = enabled;
+        qDebug() << "Debug: Parallel range download" << (enabled ? "enabled" : "disabled");
+    }
+}
+
+bool ImageWriter::getDebugPipelinedVerify() const
+{
+    return _debugPipelinedVerify;
+}
+
+void ImageWriter::setDebugPipelinedVerify(bool enabled)
+{
+    if (_debugPipelinedVerify != enabled) {
+        _debugPipelinedVerify = enabled;
+        qDebug() << "Debug: Verify while writing" << (enabled ? "enabled" : "disabled");
+    }
+}
+
+bool ImageWriter::getImageCacheEnabled() const
+{
+    return _cacheManager->isImageCacheEnabled();
+}
+
+void ImageWriter::setImageCacheEnabled(bool enabled)
+{
+    if (_cacheManager->isImageCacheEnabled() != enabled) {
+        _cacheManager->setImageCacheEnabled(enabled);
+        qDebug() << "Decompressed image cache" << (enabled ? "enabled" : "disabled");
+    }
+}
+
+bool ImageWriter::getCachePeerServing() const
+{
+    return _cachePeerServer != nullptr;
+}
+
+void ImageWriter::setCachePeerServing(bool enabled)
+{
+    if (enabled == (_cachePeerServer != nullptr))
+        return;
+
+    if (!enabled) {
+        delete _cachePeerServer;
+        _cachePeerServer = nullptr;
+        if (_cachePeerBrowser)
+            _cachePeerBrowser->setIgnoredInstance(QByteArray());
+        qDebug() << "Stopped serving the cache to peers";
+        return;
+    }
+
+    _cachePeerServer = new CachePeerServer([this](const QByteArray &sha256) {
+        return _cacheManager->completedCacheFilePath(sha256);
+    }, this);
+    if (!_cachePeerServer->listen(static_cast<quint16>(_settings.value("cache/peerPort", 0).toUInt()))) {
+        qDebug() << "Cannot serve the cache to peers:" << _cachePeerServer->errorString();
+        delete _cachePeerServer;
+        _cachePeerServer = nullptr;
+        return;
+    }
+    if (_cachePeerBrowser)
+        _cachePeerBrowser->setIgnoredInstance(_cachePeerServer->instanceName());
+}
+
+bool ImageWriter::getCachePeersEnabled() const
+{
+    return _cachePeerBrowser != nullptr;
+}
+
+void ImageWriter::setCachePeersEnabled(bool enabled)
+{
+    if (enabled == (_cachePeerBrowser != nullptr))
+        return;
+
+    if (!enabled) {
+        delete _cachePeerBrowser;
+        _cachePeerBrowser = nullptr;
+        qDebug() << "Downloading from peers disabled";
+        return;
+    }
+
+    _cachePeerBrowser = new CachePeerBrowser(this);
+    if (_cachePeerServer)
+        _cachePeerBrowser->setIgnoredInstance(_cachePeerServer->instanceName());
+    _cachePeerBrowser->start();
+    qDebug() << "Looking for peers that serve their cache";
+}
+
+bool ImageWriter::getCachePrefetchEnabled() const
+{
+    return _cachePrefetchEnabled;
+}
+
+void ImageWriter::setCachePrefetchEnabled(bool enabled)
+{
+    _cachePrefetchEnabled = enabled;
+    if (!enabled)
+        cancelPrefetch();
+}
+
 bool ImageWriter::getDebugRpiboot() const
 {
     return _debugRpiboot;
@@ -3820,8 +4690,12 @@ void ImageWriter::applyCustomisationFromSettings(const QVariantMap &settings)
 
 void ImageWriter::_applySystemdCustomisationFromSettings(const QVariantMap &s)
 {
-    // Use CustomisationGenerator for script generation
-    QByteArray script = rpi_imager::CustomisationGenerator::generateSystemdScript(s, _piConnectToken);
+    // Use CustomisationGenerator for script generation, once per set of settings
+    using rpi_imager::CustomisationBundle;
+    const bool withToken = !_piConnectToken.trimmed().isEmpty();
+    if (!_customisationBundle.matches(CustomisationBundle::Format::Systemd, s, withToken))
+        _customisationBundle = CustomisationBundle::prepare(CustomisationBundle::Format::Systemd, s, withToken);
+    QByteArray script = _customisationBundle.stamp(s.value("hostname").toString(), _piConnectToken).firstrun;
 
     QByteArray cmdlineAppend;
     ImageOptions::AdvancedOptions advOpts = NoAdvancedOptions;
@@ -3852,11 +4726,16 @@ void ImageWriter::_applyCloudInitCustomisationFromSettings(const QVariantMap &s)
     const bool sshEnabled = s.value("sshEnabled").toBool();
     const bool hasCcRpi = imageSupportsCcRpi();
     
-    QByteArray cloud = rpi_imager::CustomisationGenerator::generateCloudInitUserData(
-        s, _piConnectToken, hasCcRpi, sshEnabled, getCurrentUser());
-    
-    QByteArray netcfg = rpi_imager::CustomisationGenerator::generateCloudInitNetworkConfig(
-        s, hasCcRpi);
+    // Generated once per set of settings; only the hostname and the
+    // Connect token are filled in per write
+    using rpi_imager::CustomisationBundle;
+    const bool withToken = !_piConnectToken.trimmed().isEmpty();
+    const QString currentUser = getCurrentUser();
+    if (!_customisationBundle.matches(CustomisationBundle::Format::CloudInit, s, withToken, hasCcRpi, sshEnabled, currentUser))
+        _customisationBundle = CustomisationBundle::prepare(CustomisationBundle::Format::CloudInit, s, withToken, hasCcRpi, sshEnabled, currentUser);
+    const CustomisationBundle::Payload payload = _customisationBundle.stamp(s.value("hostname").toString(), _piConnectToken);
+    QByteArray cloud = payload.userData;
+    QByteArray netcfg = payload.networkConfig;
     
     // Only emit cmdline / advanced options when there is actual content to
     // customise.  A stale persisted recommendedWifiCountry should not cause
@@ -4072,6 +4951,9 @@ void ImageWriter::replaceTranslator(QTranslator *trans)
     QCoreApplication::installTranslator(_trans);
 
 #ifndef CLI_ONLY_BUILD
+    if (isEmbeddedMode() && AppFonts::isCjkLanguage(_trans->language()))
+        AppFonts::ensureCjkFallback();
+
     if (_engine)
     {
         _engine->retranslate();
@@ -4239,9 +5121,11 @@ void ImageWriter::onCacheVerificationProgress(qint64 bytesProcessed, qint64 tota
     if (_waitingForCacheVerification) {
         // Show cache verification progress as "verify" progress
         // This reuses the existing verify progress UI
+        _progressAggregator->report(ProgressAggregator::Phase::Verify,
+                                    static_cast<quint64>(bytesProcessed), static_cast<quint64>(totalBytes));
         emit verifyProgress(bytesProcessed, totalBytes);
-        // The progress text will be updated by the QML onVerifyProgress handler
-        // which shows "Verifying... X%" - this is perfect for cache verification too
+        // WritingStep.qml shows verify progress as "Verifying... X%", which
+        // suits cache verification too
     }
 }
 
@@ -4315,6 +5199,39 @@ void ImageWriter::onSelectedDeviceRemoved(const QString &device)
     }
 }
 
+/*
+ * Decompressed image cache. When writing from it, a hash mismatch means the
+ * cached image is damaged, so drop it. Otherwise tee the decompressed data
+ * into a new cache entry, which is kept once the image hash checks out.
+ */
+void ImageWriter::_setupImageCache(bool writingFromImageCache)
+{
+    if (_expectedHash.isEmpty() || _multipleFilesInZip)
+        return;
+
+    if (writingFromImageCache)
+    {
+        connect(_thread, &DownloadThread::imageHashMismatch, this, [this]() {
+            qDebug() << "Decompressed image cache is corrupt, removing it";
+            _primedImageHash.clear();
+            _cacheManager->invalidateImageCache();
+            _cacheManager->invalidateChunkedImage(_expectedHash);
+        });
+        return;
+    }
+
+    QString imageCacheFilePath;
+    if (_cacheManager->setupImageCacheForWrite(_expectedHash, _extrLen, imageCacheFilePath))
+    {
+        qDebug() << "Caching decompressed image to:" << imageCacheFilePath;
+        _thread->setImageCacheFile(imageCacheFilePath, _extrLen);
+        connect(_thread, &DownloadThread::imageCacheFileReady,
+                this, [this](const QString& filename, const QByteArray& imageHash) {
+                    _cacheManager->updateImageCacheFile(imageHash, filename);
+                });
+    }
+}
+
 void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
 {
     QString urlstr = _src.toString(_src.FullyEncoded);
@@ -4323,6 +5240,7 @@ void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
         QString cacheFilePath = _cacheManager->getCacheFilePath(_expectedHash);
         qDebug() << "Using verified cache file:" << cacheFilePath;
         urlstr = QUrl::fromLocalFile(cacheFilePath).toString(_src.FullyEncoded);
+        _cacheManager->touchCacheEntry(_expectedHash);
     } else {
         qDebug() << "Cache file invalid, invalidating and using original URL";
         _cacheManager->invalidateCache();
@@ -4368,11 +5286,17 @@ void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
         QString writeDevicePath = PlatformQuirks::getWriteDevicePath(_dst);
         try {
             _thread = new DownloadExtractThread(urlstr.toLatin1(), writeDevicePath.toLatin1(), _expectedHash, this);
+            if (_cachePeerBrowser)
+                _thread->setPeerUrls(_cachePeerBrowser->peerUrls(_expectedHash));
+            _thread->setMirrorUrls(_mirrorUrls);
+            if (!_prefetchedPrefix.isEmpty())
+            {
+                _thread->setPrefetchedPrefix(_prefetchedPrefix);
+                _prefetchedPrefix.clear();
+            }
             if (_repo.toString() == OSLIST_URL)
             {
-                DownloadStatsTelemetry *tele = new DownloadStatsTelemetry(urlstr.toLatin1(), _parentCategory.toLatin1(), _osName.toLatin1(), isEmbeddedMode(), _currentLangcode, this);
-                connect(tele, SIGNAL(finished()), tele, SLOT(deleteLater()));
-                tele->start();
+                _sendTelemetry(urlstr.toLatin1());
             }
         } catch (const std::bad_alloc& e) {
             _handleMemoryAllocationFailure(e.what());
@@ -4402,47 +5326,10 @@ void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
     // Connect to progress signals if this is a DownloadExtractThread
     DownloadExtractThread *downloadThread = qobject_cast<DownloadExtractThread*>(_thread);
     if (downloadThread) {
-        connect(downloadThread, &DownloadExtractThread::downloadProgressChanged,
-                this, &ImageWriter::downloadProgress);
-        connect(downloadThread, &DownloadExtractThread::writeProgressChanged,
-                this, &ImageWriter::writeProgress);
-        connect(downloadThread, &DownloadExtractThread::verifyProgressChanged,
-                this, &ImageWriter::verifyProgress);
-        
-        // Connect async write progress signal for event-driven UI updates during WaitForPendingWrites
-        // This signal is emitted from IOCP completion callbacks, providing real-time progress
-        connect(downloadThread, &DownloadThread::asyncWriteProgress,
-                this, &ImageWriter::writeProgress, Qt::QueuedConnection);
-        
-        // Capture progress for performance stats (lightweight - just stores raw samples)
-        connect(downloadThread, &DownloadExtractThread::downloadProgressChanged,
-                this, [this](quint64 now, quint64 total){
-                    _performanceStats->recordDownloadProgress(now, total);
-                });
-        connect(downloadThread, &DownloadExtractThread::decompressProgressChanged,
-                this, [this](quint64 now, quint64 total){
-                    _performanceStats->recordDecompressProgress(now, total);
-                });
-        connect(downloadThread, &DownloadExtractThread::writeProgressChanged,
-                this, [this](quint64 now, quint64 total){
-                    _performanceStats->recordWriteProgress(now, total);
-                });
-        connect(downloadThread, &DownloadThread::asyncWriteProgress,
-                this, [this](quint64 now, quint64 total){
-                    _performanceStats->recordWriteProgress(now, total);
-                }, Qt::QueuedConnection);
-        connect(downloadThread, &DownloadExtractThread::verifyProgressChanged,
-                this, [this](quint64 now, quint64 total){
-                    _performanceStats->recordVerifyProgress(now, total);
-                });
-        
-        // Also transition state to Verifying when verify progress first arrives
-        connect(downloadThread, &DownloadExtractThread::verifyProgressChanged,
-                this, [this](quint64 /*now*/, quint64 /*total*/){
-                    if (_writeState != WriteState::Verifying && _writeState != WriteState::Finalizing &&
-                        _writeState != WriteState::Succeeded && _writeState != WriteState::Cancelling)
-                        setWriteState(WriteState::Verifying);
-                });
+        // Progress counters are sampled at the display rate rather than
+        // forwarded per chunk; see _onProgressSampled()
+        _lastProgressSample = ProgressSnapshot();
+        _progressAggregator->start(downloadThread);
         
         // Capture ring buffer stall events for time-series correlation
         connect(downloadThread, &DownloadExtractThread::eventRingBufferStats,
@@ -4457,6 +5344,11 @@ void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
                     event.bytesTransferred = 0;
                     _performanceStats->addEvent(event);
                 });
+        connect(downloadThread, &DownloadExtractThread::eventRingBufferOccupancy,
+                this, [this](quint32 inputSlotsUsed, quint32 writeSlotsUsed){
+                    _performanceStats->recordRingBufferOccupancy(inputSlotsUsed, writeSlotsUsed);
+                    LiveMetrics::instance().setRingOccupancy(inputSlotsUsed, writeSlotsUsed);
+                });
         
         // Pipeline timing summary events (emitted at end of extraction)
         connect(downloadThread, &DownloadExtractThread::eventPipelineDecompressionTime,
@@ -4535,6 +5427,22 @@ void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
             this, [this](quint32 durationMs, bool success, QString metadata){
                 _performanceStats->recordEvent(PerformanceStats::EventType::DriveMbrZeroing, durationMs, success, metadata);
             });
+    connect(_thread, &DownloadThread::eventDriveErase,
+            this, [this](quint32 durationMs, bool success, QString metadata){
+                _performanceStats->recordEvent(PerformanceStats::EventType::DriveErase, durationMs, success, metadata);
+            });
+    connect(_thread, &DownloadThread::eventDriveCapacityProbe,
+            this, [this](quint32 durationMs, bool success, QString metadata){
+                _performanceStats->recordEvent(PerformanceStats::EventType::DriveCapacityProbe, durationMs, success, metadata);
+            });
+    connect(_thread, &DownloadThread::eventDriveQueueTuning,
+            this, [this](bool success, QString metadata){
+                _performanceStats->recordEvent(PerformanceStats::EventType::DriveQueueTuning, 0, success, metadata);
+            });
+    connect(_thread, &DownloadThread::eventDriveUsbPower,
+            this, [this](bool success, QString metadata){
+                _performanceStats->recordEvent(PerformanceStats::EventType::DriveUsbPower, 0, success, metadata);
+            });
     connect(_thread, &DownloadThread::eventDirectIOAttempt,
             this, [this](bool attempted, bool succeeded, bool currentlyEnabled, int errorCode, QString errorMessage){
                 QString metadata = QString("attempted: %1; succeeded: %2; currently_enabled: %3; error_code: %4; error: %5")
@@ -4592,6 +5500,12 @@ void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
                 _performanceStats->recordEvent(PerformanceStats::EventType::QueueDepthReduction, 0, true,
                     QString("depth=%1->%2; pending=%3").arg(oldDepth).arg(newDepth).arg(pendingWrites));
             });
+    connect(_thread, &DownloadThread::eventWriteTuning,
+            this, [this](int queueDepth, quint32 blockSize, quint32 throughputKBps, QString metadata){
+                _performanceStats->recordEvent(PerformanceStats::EventType::WriteTuning, 0, true,
+                    QString("depth=%1; block_kb=%2; throughput_kbps=%3; %4")
+                        .arg(queueDepth).arg(blockSize / 1024).arg(throughputKBps).arg(metadata));
+            });
     connect(_thread, &DownloadThread::eventDrainAndHotSwap,
             this, [this](quint32 durationMs, int pendingBefore, bool success){
                 _performanceStats->recordEvent(PerformanceStats::EventType::DrainAndHotSwap, durationMs, success,
@@ -4624,6 +5538,14 @@ void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
                 quint32 totalMs = static_cast<quint32>(totalSyscallMs + totalPreHashWaitMs + totalPostHashWaitMs);
                 _performanceStats->recordEvent(PerformanceStats::EventType::WriteTimingBreakdown, totalMs, true, metadata);
             });
+    connect(_thread, &DownloadThread::eventLatencyHistogram,
+            this, [this](QString name, QList<quint64> buckets, quint64 maxUs){
+                _performanceStats->recordLatencyHistogram(name, buckets, maxUs);
+            });
+    connect(_thread, &DownloadThread::eventStageCpuTime,
+            this, [this](QString stage, quint32 cpuMs, quint32 activeMs, quint32 wallMs){
+                _performanceStats->recordStageCpuTime(stage, cpuMs, activeMs, wallMs);
+            });
     connect(_thread, &DownloadThread::eventWriteSizeDistribution,
             this, [this](quint32 minSizeKB, quint32 maxSizeKB, quint32 avgSizeKB, quint64 totalBytes, quint32 writeCount){
                 QString metadata = QString("minKB: %1; maxKB: %2; avgKB: %3; totalBytes: %4; count: %5")
@@ -4679,9 +5601,22 @@ void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
                         break;
                 }
                 emit bottleneckStatusChanged(statusText, throughputKBps);
+                emit bottleneckStateChanged(QString(QMetaEnum::fromType<DownloadThread::BottleneckState>()
+                                                        .valueToKey(static_cast<int>(state))).toLower(),
+                                            throughputKBps);
+            });
+
+    // Forward the time estimate (see EtaModel) to QML and the CLI
+    connect(_thread, &DownloadThread::timeRemainingChanged,
+            this, [this](quint32 seconds, QString limitedBy){
+                emit timeRemainingChanged(seconds, limitedBy);
             });
 
     _thread->setVerifyEnabled(_verifyEnabled);
+    _thread->setVerifyCoverage(_verifyCoverage);
+    _thread->setIoTraceFile(_ioTraceFile);
+    _thread->setEraseBeforeWrite(_eraseBeforeWrite);
+    _thread->setWritePartitions(_writePartitions);
     _thread->setUserAgent(QString("Mozilla/5.0 rpi-imager/%1").arg(staticVersion()).toUtf8());
     qDebug() << "_continueStartWrite: Passing to thread - initFormat:" << _initFormat << "cloudinit empty:" << _cloudinit.isEmpty() << "cloudinitNetwork empty:" << _cloudinitNetwork.isEmpty();
     _thread->setImageCustomisation(_config, _cmdline, _firstrun, _cloudinit, _cloudinitNetwork, _initFormat, _advancedOptions);
@@ -4699,6 +5634,30 @@ void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
     _thread->setDebugIPv4Only(_debugIPv4Only);
     _thread->setDebugSkipEndOfDevice(_debugSkipEndOfDevice);
     _thread->setDebugIgnoreDeviceLimits(_debugIgnoreDeviceLimits);
+    _thread->setDebugParallelDownload(_debugParallelDownload);
+    _thread->setDebugPipelinedVerify(_debugPipelinedVerify);
+
+    if (!_bmapUrl.isEmpty())
+        _thread->setBmapUrl(_bmapUrl.toUtf8());
+
+    // Multi-target writing: same image to additional devices
+    for (const QString &device : std::as_const(_additionalDsts))
+    {
+        _thread->addFanOutTarget(PlatformQuirks::getWriteDevicePath(device).toLatin1());
+    }
+    if (!_additionalDsts.isEmpty())
+    {
+        connect(_thread, &DownloadThread::fanOutTargetProgress, this,
+                [this](QString device, quint64 now, quint64 total) {
+                    emit additionalDstProgress(device, now, total);
+                });
+        connect(_thread, &DownloadThread::fanOutTargetFinished, this,
+                [this](QString device, bool success, QString msg) {
+                    _performanceStats->recordEvent(PerformanceStats::EventType::AdditionalTargetResult, 0, success,
+                        QString("device: %1; %2").arg(device, success ? QStringLiteral("ok") : msg));
+                    emit additionalDstFinished(device, success, msg);
+                });
+    }
 
     // Handle caching setup for downloads using CacheManager
     // Only set up caching when we're downloading (not using cached file as source)
@@ -4727,12 +5686,14 @@ void ImageWriter::_continueStartWriteAfterCacheVerification(bool cacheIsValid)
     {
         qDebug() << "Using cached file as source - skipping cache setup";
     }
+    _setupImageCache(false);
 
     // Start the actual write operation
     if (_multipleFilesInZip)
     {
         static_cast<DownloadExtractThread *>(_thread)->enableMultipleFileExtraction();
         DriveFormatThread *dft = new DriveFormatThread(_dst.toLatin1(), this);
+        dft->setQuickFormat(_eraseBeforeWrite);
         connect(dft, SIGNAL(success()), _thread, SLOT(start()));
         connect(dft, SIGNAL(error(QString)), SLOT(onError(QString)));
         connect(dft, SIGNAL(preparationStatusUpdate(QString)), SLOT(onPreparationStatusUpdate(QString)));
@@ -5118,7 +6079,7 @@ bool ImageWriter::exportPerformanceData()
     QString filePath = NativeFileDialog::getSaveFileName(
         tr("Save Performance Data"),
         initialDir + "/" + defaultFilename,
-        tr("JSON files (*.json);;All files (*)"),
+        tr("JSON files (*.json);;Chrome trace files (*.trace.json);;All files (*)"),
         _mainWindow
     );
     
@@ -5158,8 +6119,14 @@ bool ImageWriter::exportPerformanceDataToFile(const QString &filePath)
         finalPath += ".json";
     }
     
+    // Pick up hot-path events still waiting on the producer threads' rings
+    _performanceStats->drainEventRings();
+    
     // Export data - all complex processing happens here, triggered by user action
-    bool success = _performanceStats->exportToFile(finalPath);
+    // A .trace.json name gets the Chrome trace, for ui.perfetto.dev
+    bool success = finalPath.endsWith(".trace.json", Qt::CaseInsensitive)
+        ? _performanceStats->exportTraceToFile(finalPath)
+        : _performanceStats->exportToFile(finalPath);
     if (success) {
         qDebug() << "Performance data exported to:" << finalPath;
     }
@@ -5209,3 +6176,12 @@ void ImageWriter::_handleSetupException(const char* what)
     _performanceStats->endSession(false, QString("Setup exception: %1").arg(what));
     emit error(tr("Failed to start write operation: %1").arg(what));
 }
+
+void ImageWriter::_sendTelemetry(const QByteArray &url)
+{
+    if (!_telemetry) {
+        _telemetry = new DownloadStatsTelemetry(QString(), this);
+        _telemetry->start();
+    }
+    _telemetry->enqueue(DownloadStatsTelemetry::eventFields(url, _parentCategory.toLatin1(), _osName.toLatin1(), isEmbeddedMode(), _currentLangcode));
+}
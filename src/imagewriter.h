@@ -6,13 +6,17 @@
  * Copyright (C) 2020-2025 Raspberry Pi Ltd
  */
 
+#include <atomic>
+#include <future>
 #include <memory>
 
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QObject>
+#include <QPointer>
 #include <QTimer>
 #include <QUrl>
+#include <QSet>
 #include <QSettings>
 #include <QString>
 #include <QVariant>
@@ -29,20 +33,30 @@
 #include <QWindow>
 #endif
 #include "cachemanager.h"
+#include "cachepeer.h"
+#include "cacheprefetcher.h"
 #include "device_info.h"
 #include "imageadvancedoptions.h"
+#include "customization_generator.h"
 #include "performancestats.h"
+#include "progressaggregator.h"
+#include "oslistcache.h"
+#include "oslisttree.h"
+#include "osliststreamparser.h"
 #include "rpiboot/rpiboot_types.h"
 
 class QQmlApplicationEngine;
 class DownloadThread;
 class DownloadExtractThread;
+class DownloadStatsTelemetry;
 class QTranslator;
 class WriteProgressWatchdog;
+class CurlFetcher;
 #ifndef CLI_ONLY_BUILD
 class NativeFileDialog;
 #endif
 class RpibootThread;
+class RpibootScheduler;
 class FastbootFlashThread;
 
 class ImageWriter : public QObject
@@ -72,19 +86,67 @@ public:
 
     Q_PROPERTY(WriteState writeState READ writeState NOTIFY writeStateChanged)
     Q_PROPERTY(bool isOsListUnavailable READ isOsListUnavailable NOTIFY osListUnavailableChanged)
+    // Progress of the current write, updated at most once per display interval
+    Q_PROPERTY(ProgressSnapshot progress READ progress NOTIFY progressChanged)
+
+    ProgressSnapshot progress() const { return _progressAggregator->snapshot(); }
+
+    // While writing on the Pi's own display: fewer progress updates and no
+    // animations, so the UI leaves the cores to decompression and hashing
+    Q_PROPERTY(bool lowRenderMode READ lowRenderMode NOTIFY lowRenderModeChanged)
+    bool lowRenderMode() const { return _lowRenderMode; }
 
     /* Returns true if the extract size is reliably known (false for gz files which can't store sizes >4GB) */
     Q_INVOKABLE bool isExtractSizeKnown() const { return _extractSizeKnown; }
 
     /* Set URL to download from, and if known download length and uncompressed length */
-    Q_INVOKABLE void setSrc(const QUrl &url, quint64 downloadLen = 0, quint64 extrLen = 0, QByteArray expectedHash = "", bool multifilesinzip = false, QString parentcategory = "", QString osname = "", QByteArray initFormat = "", QString releaseDate = "", QString bmapUrl = "");
+    Q_INVOKABLE void setSrc(const QUrl &url, quint64 downloadLen = 0, quint64 extrLen = 0, QByteArray expectedHash = "", bool multifilesinzip = false, QString parentcategory = "", QString osname = "", QByteArray initFormat = "", QString releaseDate = "", QString bmapUrl = "", QStringList mirrors = {});
+
+    /* Set a storage device (or raw disk image) to clone, optionally copying only the blocks file systems use */
+    Q_INVOKABLE void setSrcDevice(const QString &device, bool usedBlocksOnly = true);
+
+    /* Start downloading the source set with setSrc() into the cache in the background,
+       while the rest of the wizard is completed. Stopped by selecting another source. */
+    Q_INVOKABLE void startPrefetch();
+    Q_INVOKABLE void cancelPrefetch();
+
+    /* Start downloading the image of the write that follows the current one into the cache,
+       while this one verifies and finishes. Kept through setSrc() of the same image, and
+       taken over by its startWrite() as with startPrefetch(). downloadLen may be 0 if unknown. */
+    void prefetchNext(const QUrl &url, quint64 downloadLen, const QByteArray &expectedHash);
+
+    /* Warm up the DNS cache, TLS session and connection for an image URL (see CurlNetworkConfig::preconnect) */
+    Q_INVOKABLE void preconnect(const QString &url);
+
+    /* The decompressed image cached for expectedHash: a whole image, or a chunk store recipe,
+       or empty. The daemon's station mode primes a copy of it (see PrimedImage). */
+    QString decompressedImageSource(const QByteArray &expectedHash);
+
+    /* Write images with expectedHash from a primed copy at path, rather than from the cache */
+    void setPrimedImage(const QByteArray &expectedHash, const QString &path);
 
     /* Set device to write to */
     Q_INVOKABLE void setDst(const QString &device, quint64 deviceSize = 0);
 
+    /* Set additional devices to write the same image to (multi-target writing) */
+    Q_INVOKABLE void setAdditionalDsts(const QStringList &devices);
+
     /* Set verification enabled */
     Q_INVOKABLE void setVerifyEnabled(bool verify);
 
+    /* Read back only this percentage of the image when verifying (100 = all) */
+    Q_INVOKABLE void setVerifyCoverage(double percent);
+
+    /* Record the device's I/O to this file for later replay (empty = off) */
+    Q_INVOKABLE void setIoTraceFile(const QString &path);
+
+    /* Discard the whole drive before writing (where the device supports it) */
+    Q_INVOKABLE bool getEraseBeforeWrite() const;
+    Q_INVOKABLE void setEraseBeforeWrite(bool erase);
+
+    /* Write only these partitions of the image (numbered from 1) onto a drive with the same layout */
+    void setWritePartitions(const QList<int> &partitions);
+
     /* Set custom repo */
     Q_INVOKABLE void setCustomRepo(const QUrl &repo);
 
@@ -158,9 +220,27 @@ public:
     /* Overload which returns QJsonDocument */
     Q_INVOKABLE QJsonDocument getFilteredOSlistDocument();
 
+    /* A single top-level entry of the OS list with the HW filter applied;
+       empty if the filter removes it. Erase and Use custom are not included. */
+    int getOSlistEntryCount() const;
+    QJsonObject getFilteredOSlistEntry(int row);
+    /* The "imager" object of the OS list, without building the list */
+    QJsonObject osListImagerMetadata() const { return _completeOsList.imagerMetadata(); }
+    static QJsonArray internalOSlistEntries();
+
+    /* Entries at any depth of the OS list, sublists fetched so far included, whose
+       name, description or device tags contain every word of query; HW filter applied */
+    Q_INVOKABLE QJsonArray searchOSList(const QString &query, int limit = 50);
+
     /** Begin the asynchronous fetch of the OS lists, and associated sublists. */
     Q_INVOKABLE void beginOSListFetch();
 
+    /** Fetch this subitems_url ahead of other queued sublists; called when the user opens its category */
+    Q_INVOKABLE void prioritizeSublist(const QString &subitemsUrl);
+
+    /** Icons of the OS list rows on screen, fetched first, and of the next page, prefetched while idle */
+    Q_INVOKABLE void setVisibleOsIcons(const QStringList &visible, const QStringList &upcoming);
+
     /** Set the HW filter, for a filtered view of the OS list */
     Q_INVOKABLE void setHWFilterList(const QJsonArray &tags, const bool &inclusive);
 
@@ -252,6 +332,10 @@ public:
     Q_INVOKABLE QStringList getCountryList();
     Q_INVOKABLE QStringList getKeymapLayoutList();
     Q_INVOKABLE QStringList getCapitalCitiesList();
+    // Search index for ImComboBox.searchKeys, parallel to the list above
+    Q_INVOKABLE QStringList getTimezoneSearchKeys();
+    Q_INVOKABLE QStringList getKeymapLayoutSearchKeys();
+    Q_INVOKABLE QStringList getCapitalCitiesSearchKeys();
     Q_INVOKABLE QVariantMap getLocaleDataForCapital(const QString &capitalCity);
     Q_INVOKABLE QString getSSID();
     Q_INVOKABLE QString getPSK();
@@ -295,6 +379,28 @@ public:
     Q_INVOKABLE void setDebugSkipEndOfDevice(bool enabled);
     Q_INVOKABLE bool getDebugIgnoreDeviceLimits() const;
     Q_INVOKABLE void setDebugIgnoreDeviceLimits(bool enabled);
+    // Shared download rate limit in KB/s, 0 for none (saved as "network/maxKBps")
+    Q_INVOKABLE qint64 getDownloadRateLimit() const;
+    Q_INVOKABLE void setDownloadRateLimit(qint64 kbps);
+    // HTTP/3 for image downloads (saved as "network/http3"); only offered if libcurl has it
+    Q_INVOKABLE bool getHttp3Enabled() const;
+    Q_INVOKABLE void setHttp3Enabled(bool enabled);
+    Q_INVOKABLE bool isHttp3Available() const;
+    Q_INVOKABLE bool getDebugParallelDownload() const;
+    Q_INVOKABLE void setDebugParallelDownload(bool enabled);
+    Q_INVOKABLE bool getDebugPipelinedVerify() const;
+    Q_INVOKABLE void setDebugPipelinedVerify(bool enabled);
+    Q_INVOKABLE bool getImageCacheEnabled() const;
+    Q_INVOKABLE void setImageCacheEnabled(bool enabled);
+    // Serve the download cache to other imagers on the LAN / download from them
+    // (for this session; saved as "cache/servePeers" and "cache/usePeers")
+    Q_INVOKABLE bool getCachePeerServing() const;
+    Q_INVOKABLE void setCachePeerServing(bool enabled);
+    Q_INVOKABLE bool getCachePeersEnabled() const;
+    Q_INVOKABLE void setCachePeersEnabled(bool enabled);
+    // Background download of the selected OS (for this session; saved as "cache/prefetch")
+    Q_INVOKABLE bool getCachePrefetchEnabled() const;
+    Q_INVOKABLE void setCachePrefetchEnabled(bool enabled);
     Q_INVOKABLE bool getDebugRpiboot() const;
     Q_INVOKABLE void setDebugRpiboot(bool enabled);
     Q_INVOKABLE QString getDebugCustomFastbootGadget() const;
@@ -414,6 +520,10 @@ signals:
     void downloadProgress(QVariant dlnow, QVariant dltotal);
     void writeProgress(QVariant now, QVariant total);
     void verifyProgress(QVariant now, QVariant total);
+    void progressChanged();
+    void lowRenderModeChanged();
+    void additionalDstProgress(QVariant device, QVariant now, QVariant total);
+    void additionalDstFinished(QVariant device, QVariant success, QVariant msg);
     void error(QVariant msg);
     void success();
     void fileSelected(QVariant filename);
@@ -422,7 +532,13 @@ signals:
     void networkOnline();
     void preparationStatusUpdate(QVariant msg);
     void osListPrepared();
+    // Top-level rows of the OS list whose subitems changed since osListPrepared
+    void osListEntriesChanged(const QList<int> &rows);
     void bottleneckStatusChanged(QVariant status, QVariant throughputKBps);
+    // Same, untranslated: "none", "network", "decompression", "storage" or "verifying"
+    void bottleneckStateChanged(QVariant state, QVariant throughputKBps);
+    // 0 if not known yet; limitedBy: "download", "decompress", "write" or "verify"
+    void timeRemainingChanged(QVariant seconds, QVariant limitedBy);
     void operationWarning(QVariant message);  // Non-fatal warning during operation (e.g., sync fallback)
     void hwFilterChanged();
     void networkInfo(QVariant msg);
@@ -459,6 +575,7 @@ protected slots:
     void onPreparationStatusUpdate(QString msg);
     void onOsListFetchComplete(const QByteArray &data, const QUrl &url, const QUrl &effectiveUrl);
     void onOsListFetchError(const QString &errorMessage, const QUrl &url);
+    void onOsListDataReceived(const QByteArray &chunk, const QUrl &url);
     void onNetworkConnectionStats(const QString &statsMetadata, const QUrl &url);
     void onSTPdetected();
     void onCacheVerificationProgress(qint64 bytesProcessed, qint64 totalBytes);
@@ -472,12 +589,22 @@ protected slots:
                                   const QList<uint8_t> &portPath, uint16_t productId);
     void onBootstrapComplete(const QString &portPathKey, const QString &fastbootId);
     void onBootstrapError(const QString &portPathKey, const QString &msg);
+    void onBootstrapAllFinished(int succeeded, int failed);
 
 private:
     void setWriteState(WriteState state);
     WriteState writeState() const { return _writeState; }
     // Cache management
     CacheManager* _cacheManager;
+    CachePeerServer* _cachePeerServer = nullptr;
+    CachePeerBrowser* _cachePeerBrowser = nullptr;
+    CachePrefetcher* _prefetcher = nullptr;
+    DownloadStatsTelemetry* _telemetry = nullptr;  // Started on first use, or at startup to flush a saved queue
+    void _sendTelemetry(const QByteArray &url);
+    bool _cachePrefetchEnabled = true;
+    QString _prefetchedPrefix;  // Partial prefetch of the source, for the next write to continue
+    void _startPrefetch(const QUrl &url, quint64 downloadLen, const QByteArray &expectedHash, qint64 maxBytesPerSecond);
+    void _finishPrefetch(bool forWrite);
     bool _waitingForCacheVerification;
     QElapsedTimer _cacheVerificationTimer;  // Tracks cache verification duration
     
@@ -489,17 +616,39 @@ private:
     // refer to an external JSON list, fetch the list and put it in place.
     void fillSubLists(QJsonArray &topLevel);
     void queueSublistFetches(const QJsonArray &list, int depth);
+    void startOsListFetch(const QUrl &url);
+    void applyOsListResponse(const QByteArray &data, const QUrl &url, const QUrl &effectiveUrl, CurlFetcher *fetcher);
+    void finishOsListAssembly();
     QHash<QUrl, qint64> _pendingFetchStartTimes;  // Track request start times for performance
-    QJsonDocument _completeOsList;
+    OsListTree _completeOsList;
+    // While a cached or previous list is shown, the fetched one is assembled
+    // here and swapped in once every sublist has arrived
+    OsListCache _osListCache;
+    OsListTree _stagedOsList;
+    QSet<QUrl> _pendingOsListUrls;
+    QHash<QUrl, QPointer<CurlFetcher>> _osListFetchers;
+    // subitems_url of categories opened before their sublist arrived
+    QSet<QUrl> _prioritizedSublists;
+    bool _stagingOsList = false;
+    bool _osListFromSnapshot = false;
+    // A first top-level list is shown entry by entry as it downloads
+    static constexpr int kOsListStreamIntervalMs = 250;
+    std::unique_ptr<OsListStreamParser> _osListStream;
+    QPointer<CurlFetcher> _osListStreamFetcher;
+    QElapsedTimer _osListStreamTimer;  // Since the list was last re-announced
     QJsonArray _deviceFilter, _hwCapabilities, _swCapabilities;
-    bool _deviceFilterIsInclusive;
+    bool _deviceFilterIsInclusive = true;
     std::shared_ptr<DeviceInfo> _device_info;
 
     QString parseTokenFromUrl(const QUrl &url, bool strictAuthKey = false) const;
 
 protected:
     QUrl _src, _repo;
+    QStringList _additionalDsts;
     QString _dst, _parentCategory, _osName, _osReleaseDate, _currentLang, _currentLangcode, _currentKeyboard, _bmapUrl;
+    QByteArray _primedImageHash;
+    QString _primedImagePath;
+    QList<QByteArray> _mirrorUrls;
     QByteArray _expectedHash, _cmdline, _config, _firstrun, _cloudinit, _cloudinitNetwork, _initFormat;
     ImageOptions::AdvancedOptions _advancedOptions;
     quint64 _downloadLen, _extrLen, _devLen, _dlnow, _verifynow;
@@ -507,6 +656,7 @@ protected:
     bool _selectedDeviceValid;
     WriteState _writeState;
     bool _cancelledDueToDeviceRemoval;
+    QElapsedTimer _cancelTimer;  // From cancelWrite() until the write thread finished
     HWListModel _hwlist;
     OSListModel _oslist;
     QQmlApplicationEngine *_engine;
@@ -515,6 +665,11 @@ protected:
     SuspendInhibitor *_suspendInhibitor;
     DownloadThread *_thread;
     bool _verifyEnabled, _multipleFilesInZip, _online, _extractSizeKnown;
+    bool _eraseBeforeWrite;
+    QList<int> _writePartitions;
+    double _verifyCoverage;
+    QString _ioTraceFile;
+    bool _cloneSource, _cloneUsedBlocksOnly;
     QSettings _settings;
     QMap<QString,QString> _translations;
     QTranslator *_trans;
@@ -527,6 +682,9 @@ protected:
     // Lets the wizard drop only its own minted keys on storage / OS
     // changes without clobbering a user-supplied token.
     bool _piConnectTokenIsOrgMinted = false;
+    // Scripts for the last customisation settings, reused while only the
+    // hostname or the Connect token change between writes
+    rpi_imager::CustomisationBundle _customisationBundle;
     // CLI flag to force enable secure boot regardless of OS capabilities
     static bool _forceSecureBootEnabled;
 #ifndef CLI_ONLY_BUILD
@@ -538,6 +696,21 @@ protected:
     
     // Progress watchdog - separate component that monitors for stalls
     WriteProgressWatchdog* _progressWatchdog = nullptr;
+
+    // Samples the write thread's progress counters for the UI, CLI and stats
+    ProgressAggregator *_progressAggregator;
+    ProgressSnapshot _lastProgressSample;
+    void _onProgressSampled(const ProgressSnapshot &sample);
+
+    // Embedded mode: display interval, and the longer one while writing
+    static constexpr int kEmbeddedProgressIntervalMs = 250;
+    static constexpr int kLowRenderProgressIntervalMs = 500;
+    bool _lowRenderMode = false;
+    void _setLowRenderMode(bool enabled);
+
+    // CPU time of the UI thread during the write, kept as the "ui" stage
+    qint64 _uiCpuStartUs = -1;
+    QElapsedTimer _uiCpuTimer;
     bool _forceSyncMode = false;  // Force sync I/O on next write (after recovery restart)
     
     // Debug options (secret menu)
@@ -549,6 +722,8 @@ protected:
     bool _debugIPv4Only;
     bool _debugSkipEndOfDevice;
     bool _debugIgnoreDeviceLimits;
+    bool _debugParallelDownload;
+    bool _debugPipelinedVerify;
     bool _debugRpiboot;
     QString _debugCustomFastbootGadget;
     bool _debugForceSecureBoot;
@@ -559,6 +734,14 @@ protected:
     RpibootThread *_rpibootThread = nullptr;
     FastbootFlashThread *_fastbootFlashThread = nullptr;
     rpiboot::SideloadMode _rpibootSideloadMode = rpiboot::SideloadMode::Fastboot;
+    // Firmware preparation started when an rpiboot device is selected
+    std::future<void> _rpibootFirmwarePrefetch;
+    std::atomic<bool> _rpibootFirmwarePrefetchCancel{false};
+    void _prefetchRpibootFirmware(rpiboot::ChipGeneration chip);
+
+    // Hashes the images found on USB source media for their index
+    std::future<void> _usbSourceHashing;
+    std::atomic<bool> _usbSourceHashingCancel{false};
 
     // Fastboot storage device selection (pre-bootstrapped)
     bool _isFastbootDevice = false;
@@ -566,11 +749,13 @@ protected:
     QString _fastbootBlockDevice;
 
     // Auto-bootstrap tracking
-    QSet<QString> _bootstrappingDevices;           // port path keys in progress
-    QMap<QString, RpibootThread*> _activeBootstrapThreads;
+    RpibootScheduler *_bootstrapScheduler = nullptr;
 
     void _parseCompressedFile();
     void _parseXZFile();
+    // Source media in embedded mode: remember a parsed extract size, and hash unhashed images
+    void _storeUsbSourceExtractSize();
+    void _hashUsbSources(const QList<QPair<QString, QString>> &images);
     void _parseGzFile();
     void _parseZstdFile();
     QString _pubKeyFileName();
@@ -580,6 +765,7 @@ protected:
     void _applySystemdCustomisationFromSettings(const QVariantMap &s);
     void _applyCloudInitCustomisationFromSettings(const QVariantMap &s);
     void _continueStartWriteAfterCacheVerification(bool cacheIsValid);
+    void _setupImageCache(bool writingFromImageCache);
     void scheduleOsListRefresh();
     void _handleMemoryAllocationFailure(const char* what);
     void _handleSetupException(const char* what);
@@ -0,0 +1,123 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "imagingjob.h"
+#include "downloadextractthread.h"
+#include "localfileextractthread.h"
+#include "platformquirks.h"
+
+#include <QDebug>
+#include <QUrl>
+#include <atomic>
+#include <mutex>
+
+namespace rpi_imager {
+
+// How often progress is reported while the job runs
+static constexpr unsigned long PROGRESS_INTERVAL_MS = 250;
+
+struct ImagingJob::Private {
+    ImagingJobOptions options;
+    ImagingCallbacks callbacks;
+
+    std::mutex mutex;                  // Guards thread, against cancel()
+    DownloadThread *thread = nullptr;
+    std::atomic<bool> cancelled{false};
+};
+
+ImagingJob::ImagingJob(ImagingJobOptions options, ImagingCallbacks callbacks)
+    : d(std::make_unique<Private>())
+{
+    d->options = std::move(options);
+    d->callbacks = std::move(callbacks);
+}
+
+ImagingJob::~ImagingJob() = default;
+
+void ImagingJob::cancel()
+{
+    d->cancelled = true;
+    std::lock_guard<std::mutex> lock(d->mutex);
+    if (d->thread)
+        d->thread->cancelDownload();
+}
+
+ImagingResult ImagingJob::run()
+{
+    ImagingResult result;
+    const ImagingJobOptions &options = d->options;
+
+    // A path without a scheme is a local file, as for the command line
+    QUrl url(QString::fromStdString(options.source));
+    if (url.scheme().isEmpty() || url.scheme().size() == 1)   // "C:" is a drive letter
+        url = QUrl::fromLocalFile(QString::fromStdString(options.source));
+
+    const QByteArray device = PlatformQuirks::getWriteDevicePath(QString::fromStdString(options.device)).toLatin1();
+    const QByteArray expectedHash = QByteArray::fromStdString(options.expectedSha256).toLower();
+
+    std::unique_ptr<DownloadThread> thread;
+    if (url.isLocalFile())
+        thread = std::make_unique<LocalFileExtractThread>(url.toEncoded(), device, expectedHash);
+    else
+        thread = std::make_unique<DownloadExtractThread>(url.toEncoded(), device, expectedHash);
+
+    thread->setVerifyEnabled(options.verify);
+    thread->setEraseBeforeWrite(options.eraseBeforeWrite);
+    thread->setWritePartitions(QList<int>(options.partitions.begin(), options.partitions.end()));
+    if (options.imageSize)
+        thread->setExtractTotal(options.imageSize);
+
+    // Nothing runs an event loop for the job, so signals are handled on the
+    // thread that emits them
+    QObject::connect(thread.get(), &DownloadThread::error, thread.get(), [&result](QString msg) {
+        if (result.error.empty())
+            result.error = msg.toStdString();
+    }, Qt::DirectConnection);
+    if (d->callbacks.status)
+    {
+        QObject::connect(thread.get(), &DownloadThread::preparationStatusUpdate, thread.get(), [this](QString msg) {
+            d->callbacks.status(msg.toStdString());
+        }, Qt::DirectConnection);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        if (d->cancelled)
+        {
+            result.cancelled = true;
+            return result;
+        }
+        d->thread = thread.get();
+    }
+
+    auto reportProgress = [this, &thread]() {
+        if (!d->callbacks.progress)
+            return;
+        if (thread->verifyTotal())
+            d->callbacks.progress(ImagingStage::Verifying, thread->verifyNow(), thread->verifyTotal());
+        else
+            d->callbacks.progress(ImagingStage::Writing, thread->bytesWritten(), thread->extractTotal());
+    };
+
+    thread->start();
+    while (!thread->wait(PROGRESS_INTERVAL_MS))
+        reportProgress();
+    reportProgress();
+
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        d->thread = nullptr;
+    }
+
+    result.success = thread->successfull();
+    result.cancelled = d->cancelled && !result.success;
+    if (!result.success && result.error.empty() && !result.cancelled)
+        result.error = "Writing the image failed";
+    qDebug() << "ImagingJob:" << url.toDisplayString() << "to" << device
+             << (result.success ? "done" : result.cancelled ? "cancelled" : "failed");
+    return result;
+}
+
+} // namespace rpi_imager
@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef IMAGING_IMAGINGJOB_H
+#define IMAGING_IMAGINGJOB_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rpi_imager {
+
+/**
+ * @brief What an ImagingJob writes, and where
+ */
+struct ImagingJobOptions {
+    std::string source;           // http(s) URL, file:// URL or local path of the image
+    std::string device;           // Storage device (or file) to write to
+    std::string expectedSha256;   // Of the uncompressed image, hex; empty to skip the check
+    std::uint64_t imageSize = 0;  // Uncompressed, if known; 0 otherwise
+    bool verify = true;           // Read back and check what was written
+    bool eraseBeforeWrite = false;
+    std::vector<int> partitions;  // Write only these partitions (see DownloadThread::setWritePartitions())
+};
+
+enum class ImagingStage {
+    Writing,     // Downloading, decompressing and writing, all at once
+    Verifying
+};
+
+/**
+ * @brief Called from the job's own thread; must not block for long
+ */
+struct ImagingCallbacks {
+    // done and total in bytes; total is 0 while unknown
+    std::function<void(ImagingStage stage, std::uint64_t done, std::uint64_t total)> progress;
+    // Human-readable steps before writing starts (unmounting, probing, ...)
+    std::function<void(const std::string &message)> status;
+};
+
+struct ImagingResult {
+    bool success = false;
+    bool cancelled = false;
+    std::string error;            // Set when the job failed
+};
+
+/**
+ * @brief One image written to one device, without the GUI
+ *
+ * The write pipeline of the application (download or local file,
+ * decompression, hashing, sparse and delta writes, verification) behind a
+ * plain C++ interface, for programs that embed it rather than run the
+ * imager. Any number of jobs may run at once, each on the thread that
+ * called run().
+ *
+ * The pipeline runs on Qt Core and Network, but needs no event loop and no
+ * QML engine. The host creates one QCoreApplication before the first job;
+ * its organisation and application name select the settings (QSettings)
+ * that tune the pipeline, as for the imager itself.
+ */
+class ImagingJob
+{
+public:
+    ImagingJob(ImagingJobOptions options, ImagingCallbacks callbacks = {});
+    ~ImagingJob();
+
+    ImagingJob(const ImagingJob &) = delete;
+    ImagingJob &operator=(const ImagingJob &) = delete;
+
+    /**
+     * @brief Write the image; returns once done, failed or cancelled
+     */
+    ImagingResult run();
+
+    /**
+     * @brief Stop a running job; may be called from any thread
+     */
+    void cancel();
+
+private:
+    struct Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace rpi_imager
+
+#endif // IMAGING_IMAGINGJOB_H
@@ -0,0 +1,154 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "iotrace.h"
+
+#include <cerrno>
+#include <cstring>
+
+namespace rpi_imager {
+
+namespace {
+
+constexpr std::size_t kFlushBytes = 64 * 1024;
+
+void PutLe(std::uint8_t* out, std::uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i)
+    out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+}
+
+std::uint64_t GetLe(const std::uint8_t* in, int bytes) {
+  std::uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i)
+    value |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+  return value;
+}
+
+}  // namespace
+
+bool IoTraceWriter::Open(const std::string& path) {
+  Close();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_ = std::fopen(path.c_str(), "wb");
+  if (!file_) {
+    FileOperationsLog("IoTrace: cannot create " + path + ": " + std::strerror(errno));
+    return false;
+  }
+
+  std::uint8_t header[kHeaderBytes];
+  std::memcpy(header, kMagic, sizeof(kMagic));
+  PutLe(header + 8, kVersion, 4);
+  PutLe(header + 12, kRecordBytes, 4);
+  buffer_.assign(header, header + kHeaderBytes);
+  start_ = std::chrono::steady_clock::now();
+  count_ = 0;
+  FileOperationsLog("IoTrace: recording to " + path);
+  return true;
+}
+
+bool IoTraceWriter::IsOpen() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return file_ != nullptr;
+}
+
+std::uint64_t IoTraceWriter::NowUs() const {
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_).count());
+}
+
+void IoTraceWriter::Append(const IoTraceRecord& record) {
+  std::uint8_t out[kRecordBytes];
+  out[0] = static_cast<std::uint8_t>(record.op);
+  out[1] = static_cast<std::uint8_t>(record.result);
+  PutLe(out + 2, record.async ? 1 : 0, 2);
+  PutLe(out + 4, record.value, 4);
+  PutLe(out + 8, record.offset, 8);
+  PutLe(out + 16, record.length, 8);
+  PutLe(out + 24, record.submitUs, 8);
+  PutLe(out + 32, record.completeUs, 8);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_)
+    return;
+  buffer_.insert(buffer_.end(), out, out + kRecordBytes);
+  ++count_;
+  if (buffer_.size() >= kFlushBytes)
+    FlushLocked();
+}
+
+void IoTraceWriter::FlushLocked() {
+  if (file_ && !buffer_.empty()) {
+    std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    std::fflush(file_);
+  }
+  buffer_.clear();
+}
+
+void IoTraceWriter::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_)
+    return;
+  FlushLocked();
+  std::fclose(file_);
+  file_ = nullptr;
+  FileOperationsLog("IoTrace: recorded " + std::to_string(count_) + " operations");
+}
+
+std::uint64_t IoTraceWriter::RecordCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return count_;
+}
+
+bool ReadIoTrace(const std::string& path, std::vector<IoTraceRecord>& records, std::string& error) {
+  records.clear();
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  std::uint8_t header[IoTraceWriter::kHeaderBytes];
+  const bool headerOk = std::fread(header, 1, sizeof(header), file) == sizeof(header) &&
+                        std::memcmp(header, IoTraceWriter::kMagic, sizeof(IoTraceWriter::kMagic)) == 0;
+  if (!headerOk || GetLe(header + 8, 4) != IoTraceWriter::kVersion) {
+    std::fclose(file);
+    error = path + " is not an I/O trace of this version";
+    return false;
+  }
+  // Later versions may append fields to each record
+  const std::size_t recordBytes = static_cast<std::size_t>(GetLe(header + 12, 4));
+  if (recordBytes < IoTraceWriter::kRecordBytes) {
+    std::fclose(file);
+    error = path + " has records of unknown size";
+    return false;
+  }
+
+  std::vector<std::uint8_t> in(recordBytes);
+  while (std::fread(in.data(), 1, recordBytes, file) == recordBytes) {
+    IoTraceRecord record;
+    const std::uint8_t op = in[0];
+    const std::uint8_t result = in[1];
+    if (op < static_cast<std::uint8_t>(IoTraceOp::kOpen) || op > static_cast<std::uint8_t>(IoTraceOp::kSyncFallback) ||
+        result > static_cast<std::uint8_t>(FileError::kTimeout)) {
+      std::fclose(file);
+      error = path + ": bad record " + std::to_string(records.size());
+      return false;
+    }
+    record.op = static_cast<IoTraceOp>(op);
+    record.result = static_cast<FileError>(result);
+    record.async = (GetLe(in.data() + 2, 2) & 1) != 0;
+    record.value = static_cast<std::uint32_t>(GetLe(in.data() + 4, 4));
+    record.offset = GetLe(in.data() + 8, 8);
+    record.length = GetLe(in.data() + 16, 8);
+    record.submitUs = GetLe(in.data() + 24, 8);
+    record.completeUs = GetLe(in.data() + 32, 8);
+    records.push_back(record);
+  }
+  std::fclose(file);
+  return true;
+}
+
+}  // namespace rpi_imager
@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Binary trace of the I/O a write did to its device, recorded by
+ * TracingFileOperations and played back by ReplayFileOperations, so that
+ * the behaviour of a user's device can be reproduced without the device.
+ *
+ * The file is a 16 byte header (magic "RPIIOTRC", version, record size)
+ * followed by fixed-size little-endian records, one per completed
+ * operation, in the order they completed.
+ */
+
+#ifndef IOTRACE_H
+#define IOTRACE_H
+
+#include "file_operations.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rpi_imager {
+
+enum class IoTraceOp : std::uint8_t {
+  kOpen = 1,          // length: size of the device
+  kWrite = 2,         // offset, length
+  kRead = 3,          // offset, length
+  kSync = 4,          // ForceSync(), Flush() or AsyncFlush()
+  kZeroRange = 5,     // offset, length
+  kErase = 6,         // EraseDevice()
+  kQueueDepth = 7,    // value: async queue depth set, reduced or restored
+  kSyncFallback = 8,  // Async writes given up for synchronous ones
+};
+
+struct IoTraceRecord {
+  IoTraceOp op = IoTraceOp::kWrite;
+  FileError result = FileError::kSuccess;
+  bool async = false;
+  std::uint32_t value = 0;
+  std::uint64_t offset = 0;
+  std::uint64_t length = 0;
+  std::uint64_t submitUs = 0;    // Since the trace was opened
+  std::uint64_t completeUs = 0;
+};
+
+class IoTraceWriter {
+ public:
+  static constexpr char kMagic[8] = {'R', 'P', 'I', 'I', 'O', 'T', 'R', 'C'};
+  static constexpr std::uint32_t kVersion = 1;
+  static constexpr std::size_t kHeaderBytes = 16;
+  static constexpr std::size_t kRecordBytes = 40;
+
+  IoTraceWriter() = default;
+  ~IoTraceWriter() { Close(); }
+
+  IoTraceWriter(const IoTraceWriter&) = delete;
+  IoTraceWriter& operator=(const IoTraceWriter&) = delete;
+
+  // Create (or truncate) path and write the header; times start from here
+  bool Open(const std::string& path);
+  bool IsOpen() const;
+
+  // Microseconds since Open(), for IoTraceRecord times
+  std::uint64_t NowUs() const;
+
+  // May be called from any thread, e.g. async completion callbacks.
+  // Records are buffered and written out in batches.
+  void Append(const IoTraceRecord& record);
+
+  void Close();
+
+  std::uint64_t RecordCount() const;
+
+ private:
+  void FlushLocked();
+
+  mutable std::mutex mutex_;
+  std::FILE* file_ = nullptr;
+  std::vector<std::uint8_t> buffer_;
+  std::chrono::steady_clock::time_point start_;
+  std::uint64_t count_ = 0;
+};
+
+// Read a whole trace. A truncated last record (a process that died while
+// recording) is dropped; anything else that does not parse is an error.
+bool ReadIoTrace(const std::string& path, std::vector<IoTraceRecord>& records, std::string& error);
+
+}  // namespace rpi_imager
+
+#endif  // IOTRACE_H
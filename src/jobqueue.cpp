@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "jobqueue.h"
+#include <algorithm>
+
+int JobQueue::enqueue(const BatchManifest::Write &write)
+{
+    Entry entry;
+    entry.id = _nextId++;
+    entry.write = write;
+    _entries.append(entry);
+    return entry.id;
+}
+
+int JobQueue::startNext()
+{
+    if (runningCount() >= _maxRunning)
+        return 0;
+
+    QSet<QString> busyDevices;
+    QSet<QString> busyImages;
+    for (const Entry &entry : std::as_const(_entries))
+    {
+        if (!entry.running)
+            continue;
+        for (const QString &device : entry.write.devices)
+            busyDevices.insert(device);
+        busyImages.insert(entry.write.job.image);
+    }
+
+    // Devices wanted by earlier queued writes are busy for later ones too
+    for (Entry &entry : _entries)
+    {
+        if (entry.running)
+            continue;
+
+        const QStringList &devices = entry.write.devices;
+        const bool free = std::none_of(devices.cbegin(), devices.cend(), [&](const QString &device) {
+            return busyDevices.contains(device);
+        });
+        if (free && !busyImages.contains(entry.write.job.image))
+        {
+            entry.running = true;
+            return entry.id;
+        }
+        for (const QString &device : devices)
+            busyDevices.insert(device);
+    }
+    return 0;
+}
+
+bool JobQueue::remove(int id)
+{
+    return _entries.removeIf([id](const Entry &entry) { return entry.id == id; }) > 0;
+}
+
+const JobQueue::Entry *JobQueue::find(int id) const
+{
+    for (const Entry &entry : _entries)
+    {
+        if (entry.id == id)
+            return &entry;
+    }
+    return nullptr;
+}
+
+int JobQueue::runningCount() const
+{
+    return static_cast<int>(std::count_if(_entries.cbegin(), _entries.cend(), [](const Entry &entry) {
+        return entry.running;
+    }));
+}
+
+QSet<QString> JobQueue::claimedDevices() const
+{
+    QSet<QString> devices;
+    for (const Entry &entry : _entries)
+    {
+        for (const QString &device : entry.write.devices)
+            devices.insert(device);
+    }
+    return devices;
+}
@@ -0,0 +1,59 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef JOBQUEUE_H
+#define JOBQUEUE_H
+
+#include <QList>
+#include <QSet>
+#include <QString>
+#include "batchmanifest.h"
+
+/**
+ * @brief Which of the daemon's queued writes may start
+ *
+ * Writes run at the same time as long as they share no device. A write
+ * also waits while another of the same image runs, so it picks up the
+ * image from the cache rather than downloading it a second time. Writes
+ * are otherwise started in the order they were queued, and one never
+ * overtakes an earlier one that wants any of its devices.
+ */
+class JobQueue
+{
+public:
+    struct Entry {
+        int id = 0;
+        BatchManifest::Write write;
+        bool running = false;
+    };
+
+    explicit JobQueue(int maxRunning) : _maxRunning(maxRunning) {}
+
+    // Returns the id of the write
+    int enqueue(const BatchManifest::Write &write);
+
+    /**
+     * @brief Mark the next write that can start as running
+     * @return its id, or 0 if none can start now
+     */
+    int startNext();
+
+    // A running write finished, or a queued one is no longer wanted
+    bool remove(int id);
+
+    const Entry *find(int id) const;
+    const QList<Entry> &entries() const { return _entries; }
+    int runningCount() const;
+
+    // Devices of running and queued writes, which rules must not pick
+    QSet<QString> claimedDevices() const;
+
+private:
+    QList<Entry> _entries;  // In the order queued
+    int _maxRunning;
+    int _nextId = 1;
+};
+
+#endif // JOBQUEUE_H
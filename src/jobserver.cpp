@@ -0,0 +1,695 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "jobserver.h"
+#include "drivelistmodel.h"
+#include "imagewriter.h"
+#include "file_operations_memory.h"
+#include "primedimage.h"
+#include "systemmemorymanager.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSet>
+#include <QUrl>
+#include <algorithm>
+
+JobServer::JobServer(int slots, bool allowSystemDrives, QObject *parent)
+    : QObject(parent), _server(new QLocalServer(this)), _drives(new DriveListModel(this)),
+      _queue(slots), _allowSystemDrives(allowSystemDrives)
+{
+    connect(_server, &QLocalServer::newConnection, this, &JobServer::_onNewConnection);
+
+    for (int i = 0; i < slots; i++)
+    {
+        Slot slot;
+        slot.imageWriter = new ImageWriter(this);
+        _slots.append(slot);
+
+        // Slots are only appended here, so the index stays valid
+        ImageWriter *imageWriter = slot.imageWriter;
+        connect(imageWriter, &ImageWriter::downloadProgress, this, [this, i](QVariant now, QVariant total) {
+            _progress(_slots[i], "download", now.toULongLong(), total.toULongLong());
+        });
+        connect(imageWriter, &ImageWriter::writeProgress, this, [this, i](QVariant now, QVariant total) {
+            _progress(_slots[i], "write", now.toULongLong(), total.toULongLong());
+        });
+        connect(imageWriter, &ImageWriter::verifyProgress, this, [this, i](QVariant now, QVariant total) {
+            _progress(_slots[i], "verify", now.toULongLong(), total.toULongLong());
+        });
+        connect(imageWriter, &ImageWriter::additionalDstFinished, this, [this, i](QVariant device, QVariant success, QVariant msg) {
+            _deviceFinished(_slots[i], device.toString(), success.toBool(), msg.toString());
+        });
+        connect(imageWriter, &ImageWriter::success, this, [this, i]() {
+            _finish(_slots[i], QString());
+        });
+        connect(imageWriter, &ImageWriter::error, this, [this, i](QVariant msg) {
+            _finish(_slots[i], msg.toString());
+        });
+        connect(imageWriter, &ImageWriter::cancelled, this, [this, i]() {
+            _finish(_slots[i], QStringLiteral("Cancelled"));
+        });
+        connect(imageWriter, &ImageWriter::writeStateChanged, this, [this, i]() {
+            const ImageWriter::WriteState state = _slots[i].imageWriter->writeState();
+            if (state == ImageWriter::WriteState::Verifying || state == ImageWriter::WriteState::Finalizing)
+                _prefetchNext(_slots[i]);
+        });
+    }
+
+    // Kept warm, so "match" rules and the removable check need no scan.
+    // Hotplug notifications insert a drive as soon as it appears, for station mode.
+    connect(_drives, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &, int first, int last) {
+        _onDrivesInserted(first, last);
+    });
+    _drives->startPolling();
+    if (!_slots.isEmpty())
+        _slots[0].imageWriter->beginOSListFetch();
+}
+
+JobServer::~JobServer()
+{
+    _drives->stopPolling();
+    _releaseStationImage();
+}
+
+QList<ImageWriter *> JobServer::imageWriters() const
+{
+    QList<ImageWriter *> imageWriters;
+    for (const Slot &slot : _slots)
+        imageWriters.append(slot.imageWriter);
+    return imageWriters;
+}
+
+bool JobServer::listen(const QString &name)
+{
+    // A socket left behind by a daemon that did not exit cleanly
+    QLocalServer::removeServer(name);
+    _server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!_server->listen(name))
+    {
+        _error = _server->errorString();
+        return false;
+    }
+    qDebug() << "JobServer: listening on" << _server->fullServerName() << "with" << _slots.size() << "slots";
+    return true;
+}
+
+void JobServer::configureWrite(ImageWriter *imageWriter, const BatchManifest::Write &write)
+{
+    const BatchManifest::Job &job = write.job;
+    const bool cloudInit = !job.cloudInitUserData.isEmpty() || !job.cloudInitNetworkConfig.isEmpty();
+    const QByteArray initFormat = cloudInit ? "cloudinit" : "systemd";
+    if (job.isUrl())
+        imageWriter->setSrc(QUrl(job.image), 0, 0, job.sha256, false, "", "", initFormat);
+    else
+        imageWriter->setSrc(QUrl::fromLocalFile(job.image), QFileInfo(job.image).size(), 0, job.sha256, false, "", "", initFormat);
+
+    // Always set, so the previous write's customisation does not carry over
+    if (cloudInit)
+        imageWriter->setImageCustomisation("", "", "", job.cloudInitUserData, job.cloudInitNetworkConfig, ImageOptions::NoAdvancedOptions, initFormat);
+    else if (!job.firstRunScript.isEmpty())
+        imageWriter->setImageCustomisation("", "", job.firstRunScript, "", "", ImageOptions::UserDefinedFirstRun, initFormat);
+    else
+        imageWriter->setImageCustomisation("", "", "", "", "", ImageOptions::NoAdvancedOptions, initFormat);
+
+    // Jobs sharing the image and customisation are written at the same time
+    imageWriter->setDst(write.devices[0]);
+    imageWriter->setAdditionalDsts(write.devices.mid(1));
+    imageWriter->setVerifyEnabled(job.verify);
+    imageWriter->setVerifyCoverage(job.verifyCoverage);
+}
+
+void JobServer::_onNewConnection()
+{
+    while (QLocalSocket *socket = _server->nextPendingConnection())
+    {
+        _buffers.insert(socket, QByteArray());
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { _onReadyRead(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            // Its writes carry on; their events have nowhere to go
+            _buffers.remove(socket);
+            for (auto it = _owners.begin(); it != _owners.end(); ++it)
+            {
+                if (it.value() == socket)
+                    it.value() = nullptr;
+            }
+            if (_stationOwner == socket)
+                _stationOwner = nullptr;
+            socket->deleteLater();
+        });
+    }
+}
+
+void JobServer::_onReadyRead(QLocalSocket *socket)
+{
+    auto it = _buffers.find(socket);
+    if (it == _buffers.end())
+        return;
+
+    *it += socket->readAll();
+    int end;
+    while ((end = it->indexOf('\n')) >= 0)
+    {
+        const QByteArray line = it->left(end).trimmed();
+        it->remove(0, end + 1);
+        if (line.isEmpty())
+            continue;
+
+        QJsonParseError parseError;
+        const QJsonDocument doc = QJsonDocument::fromJson(line, &parseError);
+        if (!doc.isObject())
+        {
+            QJsonObject event;
+            event["event"] = "error";
+            event["message"] = doc.isNull() ? parseError.errorString() : QStringLiteral("Request is not a JSON object");
+            _send(socket, event);
+            continue;
+        }
+        _handleRequest(socket, doc.object());
+    }
+
+    if (it->size() > kMaxRequestSize)
+    {
+        qDebug() << "JobServer: dropping client with an oversized request";
+        socket->disconnectFromServer();
+    }
+}
+
+void JobServer::_handleRequest(QLocalSocket *socket, const QJsonObject &request)
+{
+    const QString type = request["request"].toString();
+    if (type == "write")
+    {
+        _queueWrites(socket, request);
+    }
+    else if (type == "cancel")
+    {
+        _cancel(socket, request["id"].toInt());
+    }
+    else if (type == "status")
+    {
+        QJsonArray writes;
+        for (const JobQueue::Entry &entry : _queue.entries())
+        {
+            QJsonObject write;
+            write["id"] = entry.id;
+            write["image"] = entry.write.job.image;
+            write["devices"] = QJsonArray::fromStringList(entry.write.devices);
+            write["state"] = entry.running ? "running" : "queued";
+            writes.append(write);
+        }
+        QJsonObject event;
+        event["event"] = "status";
+        event["writes"] = writes;
+        event["slots"] = static_cast<int>(_slots.size());
+        if (_stationArmed)
+        {
+            QJsonObject station;
+            station["image"] = _stationJob.image;
+            station["primed"] = _primedImage ? (_primedImage->location() == PrimedImage::Location::Memory ? "memory" : "disk") : "no";
+            event["station"] = station;
+        }
+        _send(socket, event);
+    }
+    else if (type == "drives")
+    {
+        const QSet<QString> claimed = _queue.claimedDevices();
+        QJsonArray drives;
+        for (int i = 0; i < _drives->rowCount(); i++)
+        {
+            const QModelIndex idx = _drives->index(i, 0);
+            QJsonObject drive;
+            drive["device"] = idx.data(DriveListModel::deviceRole).toString();
+            drive["description"] = idx.data(DriveListModel::descriptionRole).toString();
+            drive["size"] = static_cast<qint64>(idx.data(DriveListModel::sizeRole).toULongLong());
+            drive["readOnly"] = idx.data(DriveListModel::isReadOnlyRole).toBool();
+            drive["system"] = idx.data(DriveListModel::isSystemRole).toBool();
+            drive["claimed"] = claimed.contains(drive["device"].toString());
+            drives.append(drive);
+        }
+        QJsonObject event;
+        event["event"] = "drives";
+        event["drives"] = drives;
+        _send(socket, event);
+    }
+    else if (type == "station")
+    {
+        _setStation(socket, request);
+    }
+    else
+    {
+        QJsonObject event;
+        event["event"] = "error";
+        event["message"] = QStringLiteral("Unknown request \"%1\"").arg(type);
+        _send(socket, event);
+    }
+}
+
+void JobServer::_queueWrites(QLocalSocket *socket, const QJsonObject &request)
+{
+    QJsonObject error;
+    error["event"] = "error";
+
+    // Files named by jobs are relative to the daemon's working directory
+    BatchManifest manifest;
+    QJsonObject jobs;
+    jobs["jobs"] = request["jobs"];
+    if (!manifest.parse(QJsonDocument(jobs).toJson(QJsonDocument::Compact), QDir::currentPath()))
+    {
+        error["message"] = manifest.errorString();
+        _send(socket, error);
+        return;
+    }
+
+    const QList<BatchManifest::Write> writes = manifest.plan(_matchableDrives());
+    if (writes.isEmpty())
+    {
+        error["message"] = manifest.errorString();
+        _send(socket, error);
+        return;
+    }
+
+    for (const BatchManifest::Write &write : writes)
+    {
+        for (const QString &device : write.devices)
+        {
+            if (!_isRemovable(device))
+            {
+                error["message"] = QStringLiteral("Destination drive %1 is not in list of removable volumes").arg(device);
+                _send(socket, error);
+                return;
+            }
+        }
+    }
+
+    for (const BatchManifest::Write &write : writes)
+    {
+        const int id = _queue.enqueue(write);
+        _owners.insert(id, socket);
+
+        QJsonObject event;
+        event["event"] = "queued";
+        event["id"] = id;
+        event["image"] = write.job.image;
+        event["devices"] = QJsonArray::fromStringList(write.devices);
+        QStringList names = write.jobOfDevice;
+        names.removeDuplicates();
+        event["jobs"] = QJsonArray::fromStringList(names);
+        _send(socket, event);
+
+        // Connect to the server while the write waits
+        if (write.job.isUrl())
+            _slots[0].imageWriter->preconnect(write.job.image);
+    }
+    _schedule();
+}
+
+void JobServer::_cancel(QLocalSocket *socket, int id)
+{
+    const JobQueue::Entry *entry = _queue.find(id);
+    if (!entry)
+    {
+        QJsonObject event;
+        event["event"] = "error";
+        event["message"] = QStringLiteral("No write %1").arg(id);
+        _send(socket, event);
+        return;
+    }
+
+    if (entry->running)
+    {
+        for (Slot &slot : _slots)
+        {
+            if (slot.id == id)
+                slot.imageWriter->cancelWrite();  // Finishes once it stopped
+        }
+        return;
+    }
+
+    QJsonObject event;
+    event["event"] = "finished";
+    event["id"] = id;
+    event["success"] = false;
+    event["message"] = "Cancelled";
+    _sendToOwner(id, event);
+    _owners.remove(id);
+    _queue.remove(id);
+    _schedule();
+}
+
+void JobServer::_schedule()
+{
+    while (std::any_of(_slots.cbegin(), _slots.cend(), [](const Slot &slot) { return !slot.id; }))
+    {
+        const int id = _queue.startNext();
+        if (!id)
+            return;
+
+        // The slot already downloading the image, if it is idle, so the
+        // write takes over its prefetch
+        const BatchManifest::Write &write = _queue.find(id)->write;
+        auto it = std::find_if(_slots.begin(), _slots.end(), [&write](const Slot &slot) {
+            return !slot.id && slot.prefetchImage == write.job.image;
+        });
+        if (it == _slots.end())
+            it = std::find_if(_slots.begin(), _slots.end(), [](const Slot &slot) { return !slot.id; });
+        Slot &slot = *it;
+        slot.id = id;
+        slot.results.clear();
+        slot.lastProgressMs.clear();
+        slot.prefetchImage.clear();
+        slot.timer.start();
+        configureWrite(slot.imageWriter, write);
+
+        QJsonObject event;
+        event["event"] = "started";
+        event["id"] = id;
+        _sendToOwner(id, event);
+        slot.imageWriter->startWrite();
+    }
+}
+
+/*
+ * The write of slot is verifying or finishing. Download the image of the
+ * first queued write that is waiting, unless it is the image being written
+ * or another slot downloads it already.
+ */
+void JobServer::_prefetchNext(Slot &slot)
+{
+    if (!slot.id)
+        return;
+
+    QSet<QString> images;
+    for (const Slot &other : std::as_const(_slots))
+    {
+        if (other.id)
+            images.insert(_queue.find(other.id)->write.job.image);
+        if (&other != &slot && !other.prefetchImage.isEmpty())
+            images.insert(other.prefetchImage);
+    }
+
+    for (const JobQueue::Entry &entry : _queue.entries())
+    {
+        const BatchManifest::Job &job = entry.write.job;
+        // The prefetch goes into the cache, which is keyed by the hash
+        if (entry.running || !job.isUrl() || job.sha256.isEmpty() || images.contains(job.image))
+            continue;
+        if (slot.prefetchImage != job.image)
+            qDebug() << "Downloading" << job.image << "while write" << slot.id << "finishes";
+        slot.prefetchImage = job.image;
+        slot.imageWriter->prefetchNext(QUrl(job.image), 0, job.sha256);
+        return;
+    }
+}
+
+void JobServer::_progress(Slot &slot, const QString &phase, quint64 now, quint64 total)
+{
+    if (!slot.id)
+        return;
+
+    const qint64 ms = slot.timer.elapsed();
+    auto it = slot.lastProgressMs.find(phase);
+    if (it != slot.lastProgressMs.end() && ms - *it < kProgressIntervalMs && now < total)
+        return;
+    slot.lastProgressMs.insert(phase, ms);
+
+    QJsonObject event;
+    event["event"] = "progress";
+    event["id"] = slot.id;
+    event["phase"] = phase;
+    event["bytes"] = static_cast<qint64>(now);
+    event["total"] = static_cast<qint64>(total);
+    _sendToOwner(slot.id, event);
+}
+
+void JobServer::_deviceFinished(Slot &slot, const QString &device, bool success, const QString &msg)
+{
+    if (!slot.id || slot.results.contains(device))
+        return;
+
+    QJsonObject result;
+    result["device"] = device;
+    result["success"] = success;
+    if (!msg.isEmpty())
+        result["message"] = msg;
+    result["seconds"] = slot.timer.elapsed() / 1000.0;
+    slot.results.insert(device, result);
+}
+
+/*
+ * The primary device finished (error is empty on success), as in the
+ * CLI's --manifest mode. Devices that have not reported by now failed.
+ */
+void JobServer::_finish(Slot &slot, const QString &error)
+{
+    if (!slot.id)
+        return;  // Already reported, e.g. an error after cancelling
+    const int id = slot.id;
+    const BatchManifest::Write write = _queue.find(id)->write;
+
+    _deviceFinished(slot, write.devices[0], error.isEmpty(), error);
+    for (const QString &device : write.devices)
+        _deviceFinished(slot, device, false, error.isEmpty() ? QString("No result") : error);
+
+    QJsonArray devices;
+    bool success = true;
+    for (int i = 0; i < write.devices.size(); i++)
+    {
+        QJsonObject result = slot.results.value(write.devices[i]);
+        result["job"] = write.jobOfDevice[i];
+        success = success && result["success"].toBool();
+        devices.append(result);
+    }
+
+    QJsonObject event;
+    event["event"] = "finished";
+    event["id"] = id;
+    event["success"] = success;
+    if (!error.isEmpty())
+        event["message"] = error;
+    event["devices"] = devices;
+    event["seconds"] = slot.timer.elapsed() / 1000.0;
+    _sendToOwner(id, event);
+
+    slot.id = 0;
+    _owners.remove(id);
+    _queue.remove(id);
+    _schedule();
+
+    // The first write of the station's image filled the image cache
+    if (success && _stationArmed && write.job.sha256 == _stationJob.sha256)
+        _primeStationImage();
+}
+
+void JobServer::_setStation(QLocalSocket *socket, const QJsonObject &request)
+{
+    QJsonObject event;
+    if (!request.contains("job"))
+    {
+        _stationArmed = false;
+        _stationOwner = nullptr;
+        _releaseStationImage();
+        event["event"] = "station";
+        event["armed"] = false;
+        _send(socket, event);
+        return;
+    }
+
+    event["event"] = "error";
+    BatchManifest manifest;
+    QJsonObject jobs;
+    jobs["jobs"] = QJsonArray{request["job"]};
+    if (!manifest.parse(QJsonDocument(jobs).toJson(QJsonDocument::Compact), QDir::currentPath()))
+    {
+        event["message"] = manifest.errorString();
+        _send(socket, event);
+        return;
+    }
+    const BatchManifest::Job &job = manifest.jobs().first();
+    if (!job.hasRule || !job.devices.isEmpty())
+    {
+        event["message"] = QStringLiteral("A station job picks its drives with \"match\" only");
+        _send(socket, event);
+        return;
+    }
+    if (job.sha256.isEmpty())
+    {
+        // Without it the image cache, and so the primed image, are not used
+        event["message"] = QStringLiteral("A station job needs the image's \"sha256\"");
+        _send(socket, event);
+        return;
+    }
+
+    if (job.sha256 != _stationJob.sha256)
+        _releaseStationImage();
+    _stationArmed = true;
+    _stationJob = job;
+    _stationOwner = socket;
+    if (job.isUrl())
+        _slots[0].imageWriter->preconnect(job.image);
+
+    event = QJsonObject();
+    event["event"] = "station";
+    event["armed"] = true;
+    event["image"] = job.image;
+    _send(socket, event);
+
+    _primeStationImage();
+}
+
+/*
+ * Drives inserted while the station is armed are written without being
+ * asked for. Drives present when it was armed are left alone.
+ */
+void JobServer::_onDrivesInserted(int first, int last)
+{
+    if (!_stationArmed)
+        return;
+
+    const QSet<QString> claimed = _queue.claimedDevices();
+    bool queued = false;
+    for (int i = first; i <= last; i++)
+    {
+        const QModelIndex idx = _drives->index(i, 0);
+        const QString device = idx.data(DriveListModel::deviceRole).toString();
+        if (idx.data(DriveListModel::isReadOnlyRole).toBool() || idx.data(DriveListModel::isSystemRole).toBool()
+            || claimed.contains(device)
+            || !_stationJob.rule.matches(idx.data(DriveListModel::descriptionRole).toString(),
+                                         idx.data(DriveListModel::sizeRole).toULongLong()))
+        {
+            continue;
+        }
+
+        BatchManifest::Write write;
+        write.job = _stationJob;
+        write.devices = QStringList{device};
+        write.jobOfDevice = QStringList{_stationJob.name};
+        const int id = _queue.enqueue(write);
+        _owners.insert(id, _stationOwner);
+        queued = true;
+
+        QJsonObject event;
+        event["event"] = "queued";
+        event["id"] = id;
+        event["image"] = write.job.image;
+        event["devices"] = QJsonArray::fromStringList(write.devices);
+        event["jobs"] = QJsonArray::fromStringList(write.jobOfDevice);
+        _sendToOwner(id, event);
+    }
+    if (queued)
+        _schedule();
+}
+
+void JobServer::_primeStationImage()
+{
+    if (!_stationArmed || _primedImage || (_priming.valid() &&
+        _priming.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+    {
+        return;
+    }
+
+    // Not cached yet: primed once the first write has cached it
+    const QString source = _slots[0].imageWriter->decompressedImageSource(_stationJob.sha256);
+    if (source.isEmpty())
+        return;
+
+    // Leave room for the write pipelines; SystemMemoryManager reports 0 if it cannot tell
+    SystemMemoryManager &memory = SystemMemoryManager::instance();
+    const qint64 reserveMB = qMax(kStationReserveMB, memory.getTotalMemoryMB() / 4);
+    const qint64 memoryBudget = qMax<qint64>(0, memory.getAvailableMemoryMB() - reserveMB) * 1024 * 1024;
+
+    _primingCancel = false;
+    const QByteArray hash = _stationJob.sha256;
+    _priming = std::async(std::launch::async, [this, source, hash, memoryBudget]() {
+        QElapsedTimer timer;
+        timer.start();
+        auto image = std::make_shared<PrimedImage>();
+        if (!image->prime(source, hash, memoryBudget, _primingCancel))
+            return;
+        const qint64 ms = timer.elapsed();
+        QMetaObject::invokeMethod(this, [this, image, hash, ms]() {
+            // Disarmed, or armed with another image, meanwhile
+            if (_stationArmed && _stationJob.sha256 == hash)
+                _onStationImagePrimed(image, ms);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void JobServer::_onStationImagePrimed(std::shared_ptr<PrimedImage> image, qint64 ms)
+{
+    _primedImage = std::move(image);
+    for (Slot &slot : _slots)
+        slot.imageWriter->setPrimedImage(_stationJob.sha256, _primedImage->path());
+
+    QJsonObject event;
+    event["event"] = "primed";
+    event["location"] = _primedImage->location() == PrimedImage::Location::Memory ? "memory" : "disk";
+    event["size"] = _primedImage->size();
+    event["seconds"] = ms / 1000.0;
+    _send(_stationOwner, event);
+}
+
+void JobServer::_releaseStationImage()
+{
+    if (_priming.valid())
+    {
+        _primingCancel = true;
+        _priming.wait();
+    }
+    for (Slot &slot : _slots)
+        slot.imageWriter->setPrimedImage(QByteArray(), QString());
+    // A write still reading the copy keeps it open; on Linux and macOS the
+    // file goes once it is closed
+    _primedImage.reset();
+}
+
+QList<BatchManifest::Drive> JobServer::_matchableDrives() const
+{
+    // Rules only pick drives that may be written without
+    // --enable-writing-system-drives, and none another write has
+    const QSet<QString> claimed = _queue.claimedDevices();
+    QList<BatchManifest::Drive> drives;
+    for (int i = 0; i < _drives->rowCount(); i++)
+    {
+        const QModelIndex idx = _drives->index(i, 0);
+        const QString device = idx.data(DriveListModel::deviceRole).toString();
+        if (idx.data(DriveListModel::isReadOnlyRole).toBool() || idx.data(DriveListModel::isSystemRole).toBool()
+            || claimed.contains(device))
+            continue;
+        drives.append({device, idx.data(DriveListModel::descriptionRole).toString(),
+                       idx.data(DriveListModel::sizeRole).toULongLong()});
+    }
+    return drives;
+}
+
+bool JobServer::_isRemovable(const QString &device) const
+{
+    if (_allowSystemDrives || rpi_imager::MemoryFileOperations::IsMemoryTarget(device.toStdString()))
+        return true;
+
+    for (int i = 0; i < _drives->rowCount(); i++)
+    {
+        if (_drives->index(i, 0).data(DriveListModel::deviceRole).toString() == device)
+            return true;
+    }
+    return false;
+}
+
+void JobServer::_send(QLocalSocket *socket, const QJsonObject &event)
+{
+    if (!socket || !_buffers.contains(socket))
+        return;
+    socket->write(QJsonDocument(event).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void JobServer::_sendToOwner(int id, const QJsonObject &event)
+{
+    _send(_owners.value(id), event);
+}
@@ -0,0 +1,140 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include "batchmanifest.h"
+#include "jobqueue.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+
+class DriveListModel;
+class ImageWriter;
+class PrimedImage;
+class QLocalServer;
+class QLocalSocket;
+
+/**
+ * @brief The CLI's --daemon mode: writes requested over a local socket
+ *
+ * Stays resident so that a job starts without the cost of starting the
+ * imager: the ImageWriters, and with them the OS list, the download and
+ * image caches and curl's connection pool, are created once and reused,
+ * and the drive list is polled all the time.
+ *
+ * Clients send one JSON object per line and get events back the same way:
+ *
+ *   {"request": "write", "jobs": [...]}   jobs as in a --manifest file
+ *   {"request": "cancel", "id": 3}
+ *   {"request": "status"}
+ *   {"request": "drives"}
+ *   {"request": "station", "job": {...}}  arm station mode; without "job", disarm
+ *
+ * A write is answered with "queued" for each write planned from the jobs
+ * (or "error"), then "started", "progress" and "finished" events carrying
+ * its id go to the client that asked for it. Writes to different devices
+ * run at the same time, up to one per ImageWriter (see JobQueue).
+ *
+ * In station mode, every drive inserted that the job's "match" rule picks
+ * is written straight away, as a write of its own. Once the image is in
+ * the decompressed image cache, a copy is primed in RAM or on local disk
+ * (PrimedImage), so each card is written from it without downloading or
+ * decompressing anything.
+ *
+ * While a write verifies and finishes, its ImageWriter downloads the image
+ * of the next queued write that cannot start yet into the cache, and that
+ * write is then started on the same ImageWriter.
+ */
+class JobServer : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr qint64 kProgressIntervalMs = 500;  // Per write and phase
+    static constexpr int kMaxRequestSize = 1024 * 1024;
+    static constexpr qint64 kStationReserveMB = 1024;  // Memory a primed image leaves free, at least
+
+    /**
+     * @param slots Writes that may run at the same time
+     * @param allowSystemDrives Whether named devices may be system drives
+     */
+    JobServer(int slots, bool allowSystemDrives, QObject *parent = nullptr);
+    ~JobServer();
+
+    // For settings that apply to every write
+    QList<ImageWriter *> imageWriters() const;
+
+    /**
+     * @brief Start serving
+     * @param name Socket name or path (see QLocalServer::listen())
+     */
+    bool listen(const QString &name);
+    QString errorString() const { return _error; }
+
+    /**
+     * @brief Set up imageWriter to write the image and customisation of write
+     *
+     * Also used by the CLI's --manifest mode.
+     */
+    static void configureWrite(ImageWriter *imageWriter, const BatchManifest::Write &write);
+
+private:
+    struct Slot {
+        ImageWriter *imageWriter = nullptr;
+        int id = 0;  // Of the running write, 0 if idle
+        QElapsedTimer timer;
+        QMap<QString, QJsonObject> results;  // Per device
+        QHash<QString, qint64> lastProgressMs;  // Per phase
+        QString prefetchImage;  // Of a queued write, downloading while this one finishes
+    };
+
+    void _onNewConnection();
+    void _onReadyRead(QLocalSocket *socket);
+    void _handleRequest(QLocalSocket *socket, const QJsonObject &request);
+    void _queueWrites(QLocalSocket *socket, const QJsonObject &request);
+    void _cancel(QLocalSocket *socket, int id);
+    void _setStation(QLocalSocket *socket, const QJsonObject &request);
+    void _onDrivesInserted(int first, int last);
+    void _primeStationImage();
+    void _onStationImagePrimed(std::shared_ptr<PrimedImage> image, qint64 ms);
+    void _releaseStationImage();
+    void _schedule();
+    void _prefetchNext(Slot &slot);
+    void _progress(Slot &slot, const QString &phase, quint64 now, quint64 total);
+    void _deviceFinished(Slot &slot, const QString &device, bool success, const QString &msg);
+    void _finish(Slot &slot, const QString &error);
+    QList<BatchManifest::Drive> _matchableDrives() const;
+    bool _isRemovable(const QString &device) const;
+    void _send(QLocalSocket *socket, const QJsonObject &event);
+    void _sendToOwner(int id, const QJsonObject &event);
+
+    QLocalServer *_server;
+    DriveListModel *_drives;
+    QList<Slot> _slots;
+    JobQueue _queue;
+    bool _allowSystemDrives;
+    QHash<QLocalSocket *, QByteArray> _buffers;
+    QHash<int, QLocalSocket *> _owners;  // Client that queued each write
+
+    // Station mode
+    bool _stationArmed = false;
+    BatchManifest::Job _stationJob;
+    QLocalSocket *_stationOwner = nullptr;
+    std::shared_ptr<PrimedImage> _primedImage;
+    std::future<void> _priming;
+    std::atomic<bool> _primingCancel{false};
+    QString _error;
+};
+
+#endif // JOBSERVER_H
@@ -0,0 +1,125 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef LATENCYHISTOGRAM_H_
+#define LATENCYHISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace rpi_imager {
+
+// Log-linear (HDR-style) latency histogram in microseconds.
+//
+// Values below 16us get a bucket each; above that, every power of two is
+// split into 16 linear sub-buckets, so any value is within 1/16 (6.25%) of
+// its bucket's bounds from 1us up to hours. Recording is one relaxed atomic
+// increment, safe from any thread including async completion callbacks.
+//
+// A card's GC pauses show up as a second mode far out in the tail, which
+// an average or even a max hides; percentiles come from the bucket counts.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 4;
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kMaxExponent = 36;  // 2^36us is about 19 hours
+  static constexpr int kBucketCount = kSubBuckets + (kMaxExponent - kSubBucketBits) * kSubBuckets;
+
+  static int BucketFor(uint64_t us) {
+    if (us < kSubBuckets) return static_cast<int>(us);
+    const int exponent = 63 - std::countl_zero(us);
+    if (exponent >= kMaxExponent) return kBucketCount - 1;
+    const int sub = static_cast<int>((us >> (exponent - kSubBucketBits)) & (kSubBuckets - 1));
+    return kSubBuckets + (exponent - kSubBucketBits) * kSubBuckets + sub;
+  }
+
+  // Smallest value that falls in bucket
+  static uint64_t BucketLowerBound(int bucket) {
+    if (bucket < kSubBuckets) return static_cast<uint64_t>(bucket);
+    const int exponent = (bucket - kSubBuckets) / kSubBuckets + kSubBucketBits;
+    const int sub = (bucket - kSubBuckets) % kSubBuckets;
+    return static_cast<uint64_t>(kSubBuckets + sub) << (exponent - kSubBucketBits);
+  }
+
+  // Largest value that falls in bucket
+  static uint64_t BucketUpperBound(int bucket) {
+    if (bucket >= kBucketCount - 1) return UINT64_MAX;
+    return BucketLowerBound(bucket + 1) - 1;
+  }
+
+  // Value at or below which the given fraction (0..1) of samples fall, as
+  // the upper bound of its bucket so tails are never understated. counts
+  // is a Snapshot(); max caps the result to the largest value seen.
+  static uint64_t ValueAtQuantile(const std::vector<uint64_t>& counts, double quantile, uint64_t max) {
+    uint64_t total = 0;
+    for (uint64_t c : counts) total += c;
+    if (total == 0) return 0;
+
+    // Rank of the sample, 1-based, rounded up
+    uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(total));
+    if (static_cast<double>(rank) < quantile * static_cast<double>(total)) ++rank;
+    if (rank < 1) rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < static_cast<int>(counts.size()); ++i) {
+      seen += counts[static_cast<size_t>(i)];
+      if (seen >= rank) {
+        const uint64_t upper = BucketUpperBound(i);
+        return upper < max ? upper : max;
+      }
+    }
+    return max;
+  }
+
+  void Record(uint64_t us) noexcept {
+    counts_[static_cast<size_t>(BucketFor(us))].fetch_add(1, std::memory_order_relaxed);
+    uint64_t current = max_us_.load(std::memory_order_relaxed);
+    while (us > current &&
+           !max_us_.compare_exchange_weak(current, us, std::memory_order_relaxed)) {}
+  }
+
+  void MergeFrom(const LatencyHistogram& other) noexcept {
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      const uint64_t c = other.counts_[i].load(std::memory_order_relaxed);
+      if (c) counts_[i].fetch_add(c, std::memory_order_relaxed);
+    }
+    const uint64_t other_max = other.MaxUs();
+    uint64_t current = max_us_.load(std::memory_order_relaxed);
+    while (other_max > current &&
+           !max_us_.compare_exchange_weak(current, other_max, std::memory_order_relaxed)) {}
+  }
+
+  void Reset() noexcept {
+    for (auto& c : counts_) c.store(0, std::memory_order_relaxed);
+    max_us_.store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t Count() const {
+    uint64_t total = 0;
+    for (const auto& c : counts_) total += c.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  uint64_t MaxUs() const { return max_us_.load(std::memory_order_relaxed); }
+
+  // Bucket counts, kBucketCount long
+  std::vector<uint64_t> Snapshot() const {
+    std::vector<uint64_t> counts(counts_.size());
+    for (size_t i = 0; i < counts_.size(); ++i)
+      counts[i] = counts_[i].load(std::memory_order_relaxed);
+    return counts;
+  }
+
+ private:
+  std::array<std::atomic<uint64_t>, kBucketCount> counts_{};
+  std::atomic<uint64_t> max_us_{0};
+};
+
+}  // namespace rpi_imager
+
+#endif  // LATENCYHISTOGRAM_H_
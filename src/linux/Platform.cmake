@@ -16,12 +16,17 @@ endif()
 
 set(PLATFORM_SOURCES
     drivelist/drivelist_linux.cpp
+    drivelist/devicemonitor.h
+    drivelist/devicemonitor_linux.cpp
     linux/stpanalyzer.h
     linux/stpanalyzer.cpp
     linux/acceleratedcryptographichash_gnutls.cpp
-    linux/bootimgcreator_linux.cpp
+    linux/sha256_kernel.h
+    linux/sha256_kernel.cpp
     linux/rsakeyfingerprint_linux.cpp
     linux/file_operations_linux.cpp
+    linux/devicehelper.h
+    linux/devicehelper.cpp
     linux/platformquirks_linux.cpp
 )
 
@@ -57,4 +62,8 @@ add_definitions(-DHAVE_GNUTLS)
 # libusb requires libudev for rpiboot support
 pkg_check_modules(UDEV REQUIRED libudev)
 
+# Drive hotplug notifications (drivelist/devicemonitor_linux.cpp)
+set(EXTRALIBS ${EXTRALIBS} ${UDEV_LIBRARIES})
+include_directories(${UDEV_INCLUDE_DIRS})
+
 
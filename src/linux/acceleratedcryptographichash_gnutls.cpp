@@ -1,5 +1,6 @@
 /*
- * Use GnuTLS for SHA256
+ * Use the CPU's SHA instructions for SHA256 where available, GnuTLS
+ * otherwise
  *
  * SPDX-License-Identifier: Apache-2.0
  * Copyright (C) 2024 Raspberry Pi Ltd
@@ -7,6 +8,7 @@
 
 #include "acceleratedcryptographichash.h"
 #include "gnutls/crypto.h"
+#include "sha256_kernel.h"
 
 struct AcceleratedCryptographicHash::impl {
     explicit impl(QCryptographicHash::Algorithm method)
@@ -14,18 +16,24 @@ struct AcceleratedCryptographicHash::impl {
         if (method != QCryptographicHash::Sha256)
             throw std::runtime_error("Only sha256 implemented");
 
-        gnutls_hash_init(&_sha256, GNUTLS_DIG_SHA256);
-
+        if (Sha256Kernel::backend() != Sha256Kernel::Backend::None)
+            _kernel = std::make_unique<Sha256Kernel>();
+        else
+            gnutls_hash_init(&_sha256, GNUTLS_DIG_SHA256);
     }
 
     ~impl()
     {
-        gnutls_hash_deinit(_sha256, NULL);
+        if (!_kernel)
+            gnutls_hash_deinit(_sha256, NULL);
     }
 
     void addData(const char *data, int length)
     {
-        gnutls_hash(_sha256, data, length);
+        if (_kernel)
+            _kernel->addData(data, length);
+        else
+            gnutls_hash(_sha256, data, length);
     }
 
     void addData(const QByteArray &data)
@@ -35,37 +43,58 @@ struct AcceleratedCryptographicHash::impl {
 
     QByteArray result() const
     {
+        if (_kernel)
+        {
+            uint8_t digest[32];
+            _kernel->result(digest);
+            return QByteArray(reinterpret_cast<const char *>(digest), sizeof digest);
+        }
+
         unsigned char binhash[gnutls_hash_get_len(GNUTLS_DIG_SHA256)];
         gnutls_hash_output(_sha256, binhash);
         return QByteArray((char *) binhash, sizeof binhash);
     }
 
 private:
+    std::unique_ptr<Sha256Kernel> _kernel;
     gnutls_hash_hd_t _sha256;
 };
 
-AcceleratedCryptographicHash::AcceleratedCryptographicHash(QCryptographicHash::Algorithm method)
-    : p_Impl(std::make_unique<impl>(method)), _algo(method) {}
+AcceleratedCryptographicHash::AcceleratedCryptographicHash(QCryptographicHash::Algorithm method, Mode mode)
+    : p_Impl(std::make_unique<impl>(method)), _tree(mode != Mode::Sequential ? _makeTree(method, mode) : nullptr), _algo(method) {}
 
 AcceleratedCryptographicHash::~AcceleratedCryptographicHash() = default;
 
 void AcceleratedCryptographicHash::addData(const char *data, int length) {
+    if (_tree)
+        return _treeAddData(data, length);
     p_Impl->addData(data, length);
 }
 void AcceleratedCryptographicHash::addData(const QByteArray &data) {
+    if (_tree)
+        return _treeAddData(data.constData(), data.size());
     p_Impl->addData(data);
 }
 QByteArray AcceleratedCryptographicHash::result() const {
     // Cache the result for consistent behavior across platforms
     if (!_resultCached) {
-        _cachedResult = p_Impl->result();
+        _cachedResult = _tree ? _treeResult() : p_Impl->result();
         _resultCached = true;
     }
     return _cachedResult;
 }
 
+QString AcceleratedCryptographicHash::backendName() {
+    const Sha256Kernel::Backend backend = Sha256Kernel::backend();
+    if (backend != Sha256Kernel::Backend::None)
+        return QString::fromLatin1(Sha256Kernel::backendName(backend)) + " (internal)";
+    return QStringLiteral("GnuTLS");
+}
+
 void AcceleratedCryptographicHash::reset() {
     p_Impl = std::make_unique<impl>(_algo);
+    if (_tree)
+        _resetTree();
     _cachedResult.clear();
     _resultCached = false;
 }
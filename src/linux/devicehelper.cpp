@@ -0,0 +1,293 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "devicehelper.h"
+#include "../file_operations.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <mutex>
+
+namespace rpi_imager {
+
+namespace {
+
+enum Op : std::uint32_t {
+  kOpOpen = 1,
+  kOpUnmount = 2,
+};
+
+// One request or reply per SOCK_SEQPACKET message
+struct Request {
+  std::uint32_t op;
+  std::int32_t flags;
+  char path[256];
+};
+
+struct Reply {
+  std::int32_t result;
+  std::int32_t error;  // errno
+};
+
+std::mutex g_mutex;  // One request at a time on the socket
+int g_socket = -1;
+pid_t g_pid = -1;
+
+// Canonical path of a block device under /dev, or empty
+std::string BlockDevicePath(const std::string& path) {
+  if (path.compare(0, 5, "/dev/") != 0)
+    return {};
+  char resolved[PATH_MAX];
+  if (!realpath(path.c_str(), resolved))
+    return {};
+  struct stat st;
+  if (std::strncmp(resolved, "/dev/", 5) != 0 || stat(resolved, &st) != 0 || !S_ISBLK(st.st_mode))
+    return {};
+  return resolved;
+}
+
+bool SendReply(int socket, const Reply& reply, int fd) {
+  struct iovec iov;
+  iov.iov_base = const_cast<Reply*>(&reply);
+  iov.iov_len = sizeof(reply);
+
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (fd >= 0) {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+
+  ssize_t sent;
+  do {
+    sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  return sent == static_cast<ssize_t>(sizeof(reply));
+}
+
+// Reply and the descriptor passed with it, if any (-1)
+bool ReceiveReply(int socket, Reply& reply, int& fd) {
+  fd = -1;
+  struct iovec iov;
+  iov.iov_base = &reply;
+  iov.iov_len = sizeof(reply);
+
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t received;
+  do {
+    received = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); received > 0 && cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  }
+  return received == static_cast<ssize_t>(sizeof(reply));
+}
+
+// Send a request and wait for the reply. A helper that has gone away is
+// forgotten, so callers fall back to what they did without it.
+bool Transact(std::uint32_t op, const std::string& path, int flags, Reply& reply, int& fd) {
+  fd = -1;
+  Request request;
+  std::memset(&request, 0, sizeof(request));
+  if (path.size() >= sizeof(request.path))
+    return false;
+  request.op = op;
+  request.flags = flags;
+  std::memcpy(request.path, path.c_str(), path.size());
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  if (g_socket < 0)
+    return false;
+
+  ssize_t sent;
+  do {
+    sent = send(g_socket, &request, sizeof(request), MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  if (sent == static_cast<ssize_t>(sizeof(request)) && ReceiveReply(g_socket, reply, fd))
+    return true;
+
+  FileOperationsLog("Device helper went away, opening devices directly");
+  if (fd >= 0)
+    close(fd);
+  fd = -1;
+  close(g_socket);
+  g_socket = -1;
+  return false;
+}
+
+}  // namespace
+
+bool DeviceHelper::Start(const std::string& program) {
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) != 0)
+    return false;
+
+  const char* const argv[] = {"pkexec", "--disable-internal-agent", program.c_str(), "--device-helper", nullptr};
+  pid_t pid = fork();
+  if (pid == 0) {
+    // The helper's stdin is its end of the socket; dup2() clears
+    // close-on-exec for it alone
+    dup2(sv[1], STDIN_FILENO);
+    execv("/usr/bin/pkexec", const_cast<char* const*>(argv));
+    _exit(127);
+  }
+  close(sv[1]);
+  if (pid < 0) {
+    close(sv[0]);
+    return false;
+  }
+
+  // The helper says it is ready. If pkexec gives up instead (cancelled,
+  // no policy), its end closes and nothing arrives.
+  if (!Attach(sv[0])) {
+    waitpid(pid, nullptr, 0);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_pid = pid;
+  FileOperationsLog("Device helper started");
+  return true;
+}
+
+bool DeviceHelper::Attach(int socket) {
+  Reply ready;
+  int fd;
+  if (!ReceiveReply(socket, ready, fd) || ready.result != 0) {
+    if (fd >= 0)
+      close(fd);
+    close(socket);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_socket = socket;
+  g_pid = -1;
+  return true;
+}
+
+void DeviceHelper::Stop() {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  if (g_socket >= 0)
+    close(g_socket);
+  g_socket = -1;
+  if (g_pid > 0)
+    waitpid(g_pid, nullptr, 0);
+  g_pid = -1;
+}
+
+bool DeviceHelper::IsRunning() {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_socket >= 0;
+}
+
+int DeviceHelper::Open(const std::string& path, int flags, int& error) {
+  Reply reply;
+  int fd;
+  if (!Transact(kOpOpen, path, flags, reply, fd)) {
+    error = EACCES;
+    return -1;
+  }
+  if (reply.result != 0 || fd < 0) {
+    error = reply.error ? reply.error : EACCES;
+    return -1;
+  }
+  error = 0;
+  return fd;
+}
+
+int DeviceHelper::Unmount(const std::string& path) {
+  Reply reply;
+  int fd;
+  if (!Transact(kOpUnmount, path, 0, reply, fd))
+    return -1;
+  if (fd >= 0)
+    close(fd);
+  return reply.result;
+}
+
+bool DeviceHelper::IsAllowedOpen(const std::string& path, int flags) {
+  constexpr int kAllowedFlags = O_ACCMODE | O_DIRECT | O_EXCL | O_SYNC | O_DSYNC | O_CLOEXEC | O_LARGEFILE;
+  return (flags & ~kAllowedFlags) == 0 && !BlockDevicePath(path).empty();
+}
+
+int DeviceHelper::Serve(int socket, const UnmountHandler& unmount) {
+  if (!SendReply(socket, Reply{0, 0}, -1))
+    return 1;
+
+  for (;;) {
+    Request request;
+    ssize_t received = recv(socket, &request, sizeof(request), 0);
+    if (received == 0)
+      return 0;  // The client has exited
+    if (received < 0) {
+      if (errno == EINTR)
+        continue;
+      return 1;
+    }
+
+    Reply reply{-1, EINVAL};
+    int fd = -1;
+    if (received == static_cast<ssize_t>(sizeof(request))) {
+      request.path[sizeof(request.path) - 1] = '\0';
+      const std::string device = BlockDevicePath(request.path);
+      if (device.empty()) {
+        reply = Reply{-1, EACCES};
+      } else if (request.op == kOpOpen) {
+        if (!IsAllowedOpen(device, request.flags)) {
+          reply = Reply{-1, EACCES};
+        } else {
+          // Checked again on the descriptor, in case the node was swapped since
+          fd = open(device.c_str(), request.flags | O_CLOEXEC);
+          struct stat st;
+          if (fd < 0) {
+            reply = Reply{-1, errno};
+          } else if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode)) {
+            close(fd);
+            fd = -1;
+            reply = Reply{-1, EACCES};
+          } else {
+            reply = Reply{0, 0};
+          }
+        }
+      } else if (request.op == kOpUnmount) {
+        reply = Reply{unmount ? unmount(device) : -1, 0};
+      }
+    }
+
+    const bool sent = SendReply(socket, reply, fd);
+    if (fd >= 0)
+      close(fd);
+    if (!sent)
+      return 1;
+  }
+}
+
+}  // namespace rpi_imager
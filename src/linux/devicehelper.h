@@ -0,0 +1,62 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef DEVICEHELPER_H_
+#define DEVICEHELPER_H_
+
+#include <functional>
+#include <string>
+
+namespace rpi_imager {
+
+// A long-lived privileged helper that opens block devices for an
+// unprivileged process and passes the descriptors back with SCM_RIGHTS.
+//
+// Started once through pkexec, so the polkit prompt is paid at startup and
+// every device open afterwards is a socket round trip, while the GUI itself
+// runs as the user. The helper's stdin is one end of a SOCK_SEQPACKET
+// socketpair; it exits when the other end closes. It only opens block
+// devices under /dev, never creates files, and unmounts only what is
+// mounted from the device asked for.
+class DeviceHelper {
+ public:
+  // ---- Client, in the unprivileged process ----
+
+  // Launch `program --device-helper` through pkexec and wait until the helper
+  // is ready or pkexec gives up (authentication cancelled or no policy)
+  static bool Start(const std::string& program);
+
+  // Wait for the helper on the other end of socket to be ready and send
+  // requests to it. Takes the socket, closing it on failure.
+  static bool Attach(int socket);
+
+  // Close the socket, which ends the helper, and reap it
+  static void Stop();
+
+  static bool IsRunning();
+
+  // open(path, flags) in the helper. Returns the descriptor, or -1 with
+  // error set to the errno the helper saw (EACCES for refused requests).
+  static int Open(const std::string& path, int flags, int& error);
+
+  // unmountDisk(path) in the helper; its result, or -1 if it could not be asked
+  static int Unmount(const std::string& path);
+
+  // ---- Helper, running as root ----
+
+  using UnmountHandler = std::function<int(const std::string& path)>;
+
+  // Answer requests on socket until it closes. Returns the exit status.
+  static int Serve(int socket, const UnmountHandler& unmount);
+
+  // Whether the helper opens path with flags: an existing block device
+  // under /dev, with no flags beyond access mode, O_DIRECT, O_EXCL and the
+  // sync flags
+  static bool IsAllowedOpen(const std::string& path, int flags);
+};
+
+}  // namespace rpi_imager
+
+#endif  // DEVICEHELPER_H_
@@ -4,12 +4,15 @@
  */
 
 #include "file_operations_linux.h"
+#include "devicehelper.h"
 
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <linux/fs.h>
+#include <linux/falloc.h>
 #include <errno.h>
 #include <sstream>
 #include <cstring>
@@ -17,6 +20,7 @@
 #include <thread>
 #include <functional>
 #include "../timeout_utils.h"
+#include "../tracepoints.h"
 
 using rpi_imager::TimeoutResult;
 using rpi_imager::TimeoutConfig;
@@ -30,6 +34,10 @@ using rpi_imager::TimeoutDefaults::kAsyncFirstCompletionTimeoutMs;
 // io_uring support (Linux 5.1+)
 #ifdef HAVE_LIBURING
 #include <liburing.h>
+
+// How long the SQPOLL thread keeps polling after the last submission
+// before it sleeps and needs a syscall to wake
+static constexpr unsigned kSqPollIdleMs = 1000;
 #endif
 
 #include <fstream>
@@ -45,9 +53,11 @@ static void Log(const std::string& msg) {
 }
 
 LinuxFileOperations::LinuxFileOperations() 
-    : fd_(-1), last_error_code_(0), using_direct_io_(false), direct_io_attempted_(false),
-      async_queue_depth_(1), pending_writes_(0), cancelled_(false), first_async_error_(FileError::kSuccess),
-      async_write_offset_(0), io_uring_available_(false), ring_(nullptr), next_write_id_(1) {  // Start at 1, 0 is reserved for cancel operations
+    : fd_(-1), last_error_code_(0), using_direct_io_(false), direct_io_attempted_(false), write_through_(false),
+      zero_range_method_(ZeroRangeMethod::kNone), logical_block_size_(512), is_regular_file_(false),
+      async_queue_depth_(1), pending_writes_(0), pending_reads_(0), pending_syncs_(0), cancelled_(false), first_async_error_(FileError::kSuccess),
+      async_write_offset_(0), io_uring_available_(false), ring_(nullptr), sqpoll_(false),
+      fixed_files_registered_(false), registered_fd_(-1), next_write_id_(1) {  // Start at 1, 0 is reserved for cancel operations
     
 #ifdef HAVE_LIBURING
     // Probe for io_uring availability
@@ -87,8 +97,32 @@ bool LinuxFileOperations::InitIOUring() {
     
     struct io_uring_params params;
     memset(&params, 0, sizeof(params));
-    
-    int ret = io_uring_queue_init_params(queue_size, ring_, &params);
+    int ret = -EINVAL;
+
+#ifdef IORING_FEAT_SQPOLL_NONFIXED
+    // With a kernel thread polling the submission queue, queueing a write
+    // needs no syscall while the thread is awake. Unprivileged SQPOLL and
+    // SQPOLL without registered files both arrived in 5.11; anywhere else
+    // use a normal ring.
+    params.flags = IORING_SETUP_SQPOLL;
+    params.sq_thread_idle = kSqPollIdleMs;
+    ret = io_uring_queue_init_params(queue_size, ring_, &params);
+    if (ret == 0 && !(params.features & IORING_FEAT_SQPOLL_NONFIXED)) {
+        io_uring_queue_exit(ring_);
+        ret = -EINVAL;
+    }
+    if (ret < 0) {
+        std::ostringstream oss;
+        oss << "io_uring SQPOLL not available: " << strerror(-ret) << ", submitting with syscalls";
+        Log(oss.str());
+        memset(ring_, 0, sizeof(io_uring));
+        memset(&params, 0, sizeof(params));
+    }
+#endif
+    sqpoll_ = (ret == 0);
+    if (!sqpoll_) {
+        ret = io_uring_queue_init_params(queue_size, ring_, &params);
+    }
     if (ret < 0) {
         std::ostringstream oss;
         oss << "io_uring_queue_init failed: " << strerror(-ret) << " (error " << -ret << ")";
@@ -99,7 +133,7 @@ bool LinuxFileOperations::InitIOUring() {
     }
     
     std::ostringstream oss;
-    oss << "io_uring initialized with queue size " << queue_size;
+    oss << "io_uring initialized with queue size " << queue_size << (sqpoll_ ? " (SQPOLL)" : "");
     Log(oss.str());
     
     return true;
@@ -107,15 +141,22 @@ bool LinuxFileOperations::InitIOUring() {
 
 void LinuxFileOperations::CleanupIOUring() {
     if (ring_ != nullptr) {
+        // Exiting the ring drops registered buffers and files with it
+        registered_buffers_.clear();
+        fixed_files_registered_ = false;
+        registered_fd_ = -1;
         io_uring_queue_exit(ring_);
         delete ring_;
         ring_ = nullptr;
     }
     pending_callbacks_.clear();
+    pending_reads_map_.clear();
+    pending_syncs_map_.clear();
 }
 
 void LinuxFileOperations::ProcessCompletions(bool wait) {
-    if (ring_ == nullptr || pending_writes_.load() == 0) {
+    if (ring_ == nullptr ||
+        (pending_writes_.load() == 0 && pending_reads_.load() == 0 && pending_syncs_.load() == 0)) {
         return;
     }
 
@@ -131,7 +172,8 @@ void LinuxFileOperations::ProcessCompletions(bool wait) {
         
         ret = io_uring_wait_cqe_timeout(ring_, &cqe, &ts);
         // If timeout (-ETIME) and not cancelled, try again with overall limit
-        while (ret == -ETIME && !cancelled_.load() && pending_writes_.load() > 0) {
+        while (ret == -ETIME && !cancelled_.load() &&
+               (pending_writes_.load() > 0 || pending_reads_.load() > 0 || pending_syncs_.load() > 0)) {
             auto elapsed = std::chrono::steady_clock::now() - waitStart;
             if (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() >= kAsyncFirstCompletionTimeoutMs) {
                 Log("ProcessCompletions: No completion received in " + std::to_string(kAsyncFirstCompletionTimeoutMs) + 
@@ -157,6 +199,82 @@ void LinuxFileOperations::ProcessCompletions(bool wait) {
             continue;
         }
         
+        // Verify reads: no latency tracking or sync fallback, just the callback
+        PendingRead read;
+        bool is_read = false;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            auto it = pending_reads_map_.find(write_id);
+            if (it != pending_reads_map_.end()) {
+                read = std::move(it->second);
+                pending_reads_map_.erase(it);
+                is_read = true;
+            }
+        }
+        if (is_read) {
+            io_uring_cqe_seen(ring_, cqe);
+            RPI_TRACE2(io_read_complete, write_id, result);
+
+            FileError error = FileError::kSuccess;
+            std::size_t bytes_read = 0;
+            if (result < 0) {
+                error = (result == -ECANCELED) ? FileError::kCancelled : FileError::kReadError;
+                if (error == FileError::kReadError) {
+                    Log(std::string("io_uring read failed: ") + strerror(-result));
+                }
+            } else {
+                bytes_read = static_cast<std::size_t>(result);
+                // A short read before the end of the device is rare; finish it synchronously
+                if (bytes_read > 0 && bytes_read < read.size) {
+                    std::size_t rest = 0;
+                    error = ReadAtOffset(read.offset + bytes_read, read.data + bytes_read,
+                                         read.size - bytes_read, rest);
+                    bytes_read += rest;
+                }
+            }
+
+            if (read.callback) {
+                read.callback(error, error == FileError::kSuccess ? bytes_read : 0);
+            }
+            pending_reads_.fetch_sub(1);
+            processed_at_least_one = true;
+            ret = io_uring_peek_cqe(ring_, &cqe);
+            continue;
+        }
+
+        // Queued flushes: the writes before them have all completed
+        AsyncWriteCallback sync_callback;
+        bool is_sync = false;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            auto it = pending_syncs_map_.find(write_id);
+            if (it != pending_syncs_map_.end()) {
+                sync_callback = std::move(it->second);
+                pending_syncs_map_.erase(it);
+                is_sync = true;
+            }
+        }
+        if (is_sync) {
+            io_uring_cqe_seen(ring_, cqe);
+            RPI_TRACE2(io_sync_complete, write_id, result);
+
+            FileError error = FileError::kSuccess;
+            if (result < 0) {
+                error = (result == -ECANCELED) ? FileError::kCancelled : FileError::kFlushError;
+                if (error == FileError::kFlushError) {
+                    Log(std::string("io_uring fdatasync failed: ") + strerror(-result));
+                }
+            }
+
+            if (sync_callback) {
+                sync_callback(error, 0);
+            }
+            pending_syncs_.fetch_sub(1);
+            processed_at_least_one = true;
+            ret = io_uring_peek_cqe(ring_, &cqe);
+            continue;
+        }
+
         AsyncWriteCallback callback = nullptr;
         std::size_t expected_size = 0;
         bool found_in_map = false;
@@ -187,6 +305,7 @@ void LinuxFileOperations::ProcessCompletions(bool wait) {
         auto completionTime = std::chrono::steady_clock::now();
         auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(completionTime - submit_time).count();
         write_latency_stats_.recordCompletion(submit_time);
+        RPI_TRACE3(io_write_complete, write_id, result, latency);
 
         // Adaptive recovery: if individual write latency is very high, reduce queue depth
         // This helps the system recover when conditions change (memory pressure, slow device)
@@ -283,14 +402,271 @@ FileError LinuxFileOperations::OpenDevice(const std::string& path) {
     if (device_io_limits_.max_transfer_bytes > 0 || device_io_limits_.suggested_queue_depth > 0) {
       std::ostringstream oss;
       oss << "Device I/O limits: max_transfer=" << device_io_limits_.max_transfer_bytes
-          << " bytes, suggested_queue_depth=" << device_io_limits_.suggested_queue_depth;
+          << " bytes, suggested_queue_depth=" << device_io_limits_.suggested_queue_depth
+          << ", write_cache=" << (device_io_limits_.write_cache == DeviceIOLimits::WriteCache::kWriteBack ? "write back" :
+                                  device_io_limits_.write_cache == DeviceIOLimits::WriteCache::kWriteThrough ? "write through" : "unknown")
+          << ", fua=" << device_io_limits_.fua_supported;
       Log(oss.str());
     }
+
+    zero_range_method_ = ZeroRangeMethod::kNone;
+    int logical_block_size = 0;
+    if (isBlockDevice && ioctl(fd_, BLKSSZGET, &logical_block_size) == 0 && logical_block_size > 0) {
+      logical_block_size_ = static_cast<std::uint32_t>(logical_block_size);
+      zero_range_method_ = QueryZeroRangeMethod(current_path_);
+    }
+    UpdateRegularFile();
   }
 
   return result;
 }
 
+// Image files: zero ranges become holes, and the file system may copy
+void LinuxFileOperations::UpdateRegularFile() {
+  struct stat st;
+  is_regular_file_ = fstat(fd_, &st) == 0 && S_ISREG(st.st_mode);
+  if (is_regular_file_)
+    zero_range_method_ = ZeroRangeMethod::kPunchHole;
+}
+
+// Only methods that are fast compared to writing zeros are used: BLKZEROOUT
+// without device support makes the kernel write zero pages itself.
+FileOperations::ZeroRangeMethod LinuxFileOperations::QueryZeroRangeMethod(const std::string& path) {
+  if (path.find("/dev/") != 0)
+    return ZeroRangeMethod::kNone;
+  const std::string queueDir = "/sys/block/" + path.substr(5) + "/queue/";
+
+  auto readValue = [&queueDir](const char* name) -> std::uint64_t {
+    std::ifstream f(queueDir + name);
+    std::uint64_t val = 0;
+    return (f >> val) ? val : 0;
+  };
+
+  const std::uint64_t writeZeroesMax = readValue("write_zeroes_max_bytes");
+  if (writeZeroesMax > 0) {
+    std::ostringstream oss;
+    oss << "Zero range: BLKZEROOUT (write_zeroes_max_bytes=" << writeZeroesMax << ")";
+    Log(oss.str());
+    return ZeroRangeMethod::kWriteZeroes;
+  }
+
+  // discard_zeroes_data always reads 0 on kernels since 4.12, where
+  // zeroing is reported through write_zeroes_max_bytes instead
+  if (readValue("discard_max_bytes") > 0 && readValue("discard_zeroes_data") == 1) {
+    Log("Zero range: BLKDISCARD (discard_zeroes_data=1)");
+    return ZeroRangeMethod::kDiscard;
+  }
+
+  return ZeroRangeMethod::kNone;
+}
+
+FileError LinuxFileOperations::ZeroRange(std::uint64_t offset, std::uint64_t length) {
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+  if (zero_range_method_ == ZeroRangeMethod::kPunchHole) {
+    return PunchHole(offset, length);
+  }
+  if (zero_range_method_ == ZeroRangeMethod::kNone ||
+      offset % logical_block_size_ != 0 || length % logical_block_size_ != 0) {
+    return FileError::kWriteError;
+  }
+
+  std::uint64_t range[2] = {offset, length};
+  const unsigned long request =
+      (zero_range_method_ == ZeroRangeMethod::kWriteZeroes) ? BLKZEROOUT : BLKDISCARD;
+  if (ioctl(fd_, request, range) != 0) {
+    last_error_code_ = errno;
+    std::ostringstream oss;
+    oss << "Zero range failed at offset " << offset << " length " << length
+        << ": " << std::strerror(errno);
+    Log(oss.str());
+    return FileError::kWriteError;
+  }
+  return FileError::kSuccess;
+}
+
+// Deallocates the part of the range inside the file and extends the file
+// over the rest, so the whole range reads back as zeros and takes no space
+FileError LinuxFileOperations::PunchHole(std::uint64_t offset, std::uint64_t length) {
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+    last_error_code_ = errno;
+    return FileError::kWriteError;
+  }
+  const std::uint64_t fileSize = static_cast<std::uint64_t>(st.st_size);
+  const std::uint64_t end = offset + length;
+
+  if (offset < fileSize &&
+      fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset),
+                static_cast<off_t>(std::min(end, fileSize) - offset)) != 0) {
+    last_error_code_ = errno;
+    std::ostringstream oss;
+    oss << "Punching hole at offset " << offset << " length " << length
+        << " failed: " << std::strerror(errno);
+    Log(oss.str());
+    return FileError::kWriteError;
+  }
+  // Only ever grows the file: writes queued before this all end at or before offset
+  if (end > fileSize && ftruncate(fd_, static_cast<off_t>(end)) != 0) {
+    last_error_code_ = errno;
+    return FileError::kWriteError;
+  }
+  return FileError::kSuccess;
+}
+
+FileError LinuxFileOperations::CloneFrom(int src_fd, std::uint64_t length) {
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+  if (!is_regular_file_) {
+    return FileError::kWriteError;
+  }
+  WaitForPendingWrites();
+
+  struct stat srcStat;
+  if (fstat(src_fd, &srcStat) != 0 || !S_ISREG(srcStat.st_mode)) {
+    return FileError::kReadError;
+  }
+
+#ifdef FICLONE
+  // The whole source as one reflink, on file systems that share extents
+  // (btrfs, XFS with reflink=1, bcachefs)
+  if (static_cast<std::uint64_t>(srcStat.st_size) == length && ioctl(fd_, FICLONE, src_fd) == 0) {
+    Log("Clone: target shares the extents of the source (FICLONE)");
+    return FileError::kSuccess;
+  }
+#endif
+
+  // Otherwise copy the data segments in the kernel, which may still share
+  // extents, and leave the holes between them as holes
+  const off_t end = static_cast<off_t>(length);
+  off_t pos = 0;
+  std::uint64_t copied = 0;
+  while (pos < end) {
+    off_t data = lseek(src_fd, pos, SEEK_DATA);
+    if (data < 0 && errno != ENXIO) {
+      last_error_code_ = errno;
+      return FileError::kReadError;
+    }
+    if (data < 0 || data > end)
+      data = end;  // No data left before the end
+    off_t hole = data < end ? lseek(src_fd, data, SEEK_HOLE) : end;
+    if (hole < 0 || hole > end)
+      hole = end;
+
+    if (data > pos && PunchHole(static_cast<std::uint64_t>(pos), static_cast<std::uint64_t>(data - pos)) != FileError::kSuccess)
+      return FileError::kWriteError;
+
+    loff_t in = data, out = data;
+    while (in < hole) {
+      const ssize_t n = copy_file_range(src_fd, &in, fd_, &out, static_cast<size_t>(hole - in), 0);
+      if (n <= 0) {
+        last_error_code_ = n < 0 ? errno : EIO;
+        std::ostringstream oss;
+        oss << "Clone: copy_file_range failed at offset " << in << ": " << std::strerror(last_error_code_);
+        Log(oss.str());
+        return FileError::kWriteError;
+      }
+      copied += static_cast<std::uint64_t>(n);
+    }
+    pos = hole;
+  }
+
+  std::ostringstream oss;
+  oss << "Clone: copied " << copied << " bytes of data in the kernel, " << length - copied << " bytes left as holes";
+  Log(oss.str());
+  return FileError::kSuccess;
+}
+
+FileError LinuxFileOperations::SpliceFrom(int src_fd, std::uint64_t src_offset, std::size_t length) {
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+  WaitForPendingWrites();
+
+  // copy_file_range() does not write to block devices, so the pages go
+  // through a pipe: moved in from the source's page cache, moved out to
+  // the device, never copied to user space
+  int pipefd[2];
+  if (pipe2(pipefd, O_CLOEXEC) != 0) {
+    last_error_code_ = errno;
+    return FileError::kWriteError;
+  }
+  // Larger than the default 64 KB, so each splice() moves more; may be
+  // refused above /proc/sys/fs/pipe-max-size, which only costs syscalls
+  const int pipeSize = fcntl(pipefd[1], F_SETPIPE_SZ, 1024 * 1024);
+  const std::size_t chunk = pipeSize > 0 ? static_cast<std::size_t>(pipeSize) : 64 * 1024;
+
+  loff_t in = static_cast<loff_t>(src_offset);
+  loff_t out = static_cast<loff_t>(Tell());
+  std::size_t left = length;
+  FileError result = FileError::kSuccess;
+  while (left > 0 && result == FileError::kSuccess) {
+    const ssize_t filled = splice(src_fd, &in, pipefd[1], nullptr, std::min(left, chunk),
+                                  SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (filled <= 0) {
+      last_error_code_ = filled < 0 ? errno : EIO;  // The source is shorter than length
+      result = FileError::kReadError;
+      break;
+    }
+
+    ssize_t drained = 0;
+    while (drained < filled) {
+      const ssize_t n = splice(pipefd[0], nullptr, fd_, &out, static_cast<std::size_t>(filled - drained),
+                               SPLICE_F_MOVE | SPLICE_F_MORE);
+      if (n <= 0) {
+        last_error_code_ = n < 0 ? errno : EIO;
+        result = FileError::kWriteError;
+        break;
+      }
+      drained += n;
+    }
+    left -= static_cast<std::size_t>(drained);
+  }
+
+  close(pipefd[0]);
+  close(pipefd[1]);
+
+  if (result != FileError::kSuccess) {
+    std::ostringstream oss;
+    oss << "Splice: failed at offset " << out << ": " << std::strerror(last_error_code_);
+    Log(oss.str());
+    return result;
+  }
+
+  // splice() with an offset leaves the file position alone
+  return Seek(static_cast<std::uint64_t>(out));
+}
+
+FileError LinuxFileOperations::EraseDevice() {
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+
+  std::uint64_t size = 0;
+  FileError result = GetSize(size);
+  if (result != FileError::kSuccess) {
+    return result;
+  }
+  if (size == 0) {
+    return FileError::kWriteError;
+  }
+
+  // Discard must not race queued writes to the same blocks
+  WaitForPendingWrites();
+
+  std::uint64_t range[2] = {0, size};
+  if (ioctl(fd_, BLKDISCARD, range) != 0) {
+    last_error_code_ = errno;
+    std::ostringstream oss;
+    oss << "Erase (BLKDISCARD) of " << size << " bytes failed: " << std::strerror(errno);
+    Log(oss.str());
+    return FileError::kWriteError;
+  }
+  return FileError::kSuccess;
+}
+
 FileError LinuxFileOperations::CreateTestFile(const std::string& path, std::uint64_t size) {
   FileError result = OpenInternal(path.c_str(), 
                                   O_CREAT | O_RDWR | O_TRUNC, 
@@ -303,6 +679,7 @@ FileError LinuxFileOperations::CreateTestFile(const std::string& path, std::uint
     Close();
     return FileError::kSizeError;
   }
+  UpdateRegularFile();
 
   return FileError::kSuccess;
 }
@@ -322,7 +699,7 @@ FileError LinuxFileOperations::WriteAtOffset(
 
   std::size_t bytes_written = 0;
   while (bytes_written < size) {
-    ssize_t result = write(fd_, data + bytes_written, size - bytes_written);
+    ssize_t result = WriteChunk(data + bytes_written, size - bytes_written);
     if (result <= 0) {
       return FileError::kWriteError;
     }
@@ -362,6 +739,9 @@ FileError LinuxFileOperations::Close() {
   // Wait for any pending async writes
   WaitForPendingWrites();
   
+  // The fixed file table holds its own reference to the file
+  UpdateFixedFile(-1);
+  
   if (fd_ >= 0) {
     if (close(fd_) != 0) {
       fd_ = -1;
@@ -372,6 +752,9 @@ FileError LinuxFileOperations::Close() {
   }
   current_path_.clear();
   using_direct_io_ = false;
+  write_through_ = false;
+  zero_range_method_ = ZeroRangeMethod::kNone;
+  is_regular_file_ = false;
   async_write_offset_ = 0;
   return FileError::kSuccess;
 }
@@ -393,6 +776,7 @@ FileError LinuxFileOperations::SetDirectIOEnabled(bool enabled) {
   off_t currentPos = lseek(fd_, 0, SEEK_CUR);
   std::string savedPath = current_path_;
   
+  UpdateFixedFile(-1);
   close(fd_);
   fd_ = -1;
   
@@ -426,10 +810,54 @@ FileError LinuxFileOperations::SetDirectIOEnabled(bool enabled) {
   return FileError::kSuccess;
 }
 
+bool LinuxFileOperations::SetWriteThrough(bool enabled) {
+#ifdef RWF_DSYNC
+  if (enabled && !IsOpen()) {
+    return false;
+  }
+  if (write_through_ != enabled) {
+    write_through_ = enabled;
+    Log(enabled ? "Write-through (RWF_DSYNC) enabled" : "Write-through disabled");
+  }
+  return true;
+#else
+  write_through_ = false;
+  return !enabled;
+#endif
+}
+
+// One write at the file offset. Write-through writes go through
+// pwritev2(RWF_DSYNC), which the block layer sends as a FUA write or
+// follows with a cache flush; a kernel without it (before 4.7) gets a
+// plain write and write-through is switched off, so callers sync instead.
+ssize_t LinuxFileOperations::WriteChunk(const std::uint8_t* data, std::size_t size) {
+#ifdef RWF_DSYNC
+  if (write_through_) {
+    struct iovec iov;
+    iov.iov_base = const_cast<std::uint8_t*>(data);
+    iov.iov_len = size;
+    ssize_t result = pwritev2(fd_, &iov, 1, -1, RWF_DSYNC);
+    if (result >= 0 || (errno != EOPNOTSUPP && errno != ENOSYS)) {
+      return result;
+    }
+    write_through_ = false;
+    Log("RWF_DSYNC not supported, write-through disabled");
+  }
+#endif
+  return write(fd_, data, size);
+}
+
 FileError LinuxFileOperations::OpenInternal(const char* path, int flags, mode_t mode) {
   Close();
 
   fd_ = open(path, flags, mode);
+  // An unprivileged GUI has the device helper open devices for it
+  if (fd_ < 0 && (errno == EACCES || errno == EPERM) && IsBlockDevicePath(path) &&
+      DeviceHelper::IsRunning()) {
+    int error = 0;
+    fd_ = DeviceHelper::Open(path, flags, error);
+    errno = error;
+  }
   if (fd_ < 0) {
     last_error_code_ = errno;
     return FileError::kOpenError;
@@ -447,7 +875,7 @@ FileError LinuxFileOperations::WriteSequential(const std::uint8_t* data, std::si
 
   std::size_t bytes_written = 0;
   while (bytes_written < size) {
-    ssize_t result = write(fd_, data + bytes_written, size - bytes_written);
+    ssize_t result = WriteChunk(data + bytes_written, size - bytes_written);
     if (result <= 0) {
       if (result == 0 || errno != EINTR) {
         last_error_code_ = errno;
@@ -483,6 +911,33 @@ FileError LinuxFileOperations::ReadSequential(std::uint8_t* data, std::size_t si
   return FileError::kSuccess;
 }
 
+FileError LinuxFileOperations::ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                                            std::size_t size, std::size_t& bytes_read) {
+  bytes_read = 0;
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+
+  // pread() leaves the file offset alone, so this does not disturb
+  // concurrent sequential writes on the same descriptor
+  while (bytes_read < size) {
+    ssize_t result = pread(fd_, data + bytes_read, size - bytes_read,
+                           static_cast<off_t>(offset + bytes_read));
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return FileError::kReadError;
+    }
+    if (result == 0) {
+      break;  // End of device
+    }
+    bytes_read += static_cast<std::size_t>(result);
+  }
+
+  return FileError::kSuccess;
+}
+
 FileError LinuxFileOperations::Seek(std::uint64_t position) {
   if (!IsOpen()) {
     return FileError::kOpenError;
@@ -546,6 +1001,50 @@ FileError LinuxFileOperations::Flush() {
   return FileError::kSuccess;
 }
 
+FileError LinuxFileOperations::SyncToDevice() {
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+
+  if (fsync(fd_) != 0) {
+    return FileError::kSyncError;
+  }
+
+  return FileError::kSuccess;
+}
+
+FileError LinuxFileOperations::StartWriteback(std::uint64_t offset, std::uint64_t length) {
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+
+  if (sync_file_range(fd_, static_cast<off64_t>(offset), static_cast<off64_t>(length),
+                      SYNC_FILE_RANGE_WRITE) != 0) {
+    last_error_code_ = errno;
+    return FileError::kFlushError;
+  }
+  return FileError::kSuccess;
+}
+
+FileError LinuxFileOperations::WaitWriteback(std::uint64_t offset, std::uint64_t length) {
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+
+  // WAIT_BEFORE catches pages already under writeback from StartWriteback(),
+  // WRITE picks up anything dirtied since
+  if (sync_file_range(fd_, static_cast<off64_t>(offset), static_cast<off64_t>(length),
+                      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                      SYNC_FILE_RANGE_WAIT_AFTER) != 0) {
+    last_error_code_ = errno;
+    return FileError::kFlushError;
+  }
+
+  // Clean now, so there is no point keeping it cached
+  posix_fadvise(fd_, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_DONTNEED);
+  return FileError::kSuccess;
+}
+
 void LinuxFileOperations::PrepareForSequentialRead(std::uint64_t offset, std::uint64_t length) {
   if (!IsOpen()) {
     return;
@@ -664,9 +1163,23 @@ FileError LinuxFileOperations::AsyncWriteSequential(const std::uint8_t* data, st
   
   pending_writes_.fetch_add(1);
   
-  // Set up the SQE for a write
-  io_uring_prep_write(sqe, fd_, data, static_cast<unsigned>(size), static_cast<off_t>(write_offset));
+  // Set up the SQE for a write. Data from a registered buffer goes through
+  // the fixed buffer/file path, which skips pinning the pages and looking
+  // up the fd on every write.
+  int buf_index = FindRegisteredBuffer(data, size);
+  if (buf_index >= 0 && UpdateFixedFile(fd_)) {
+    io_uring_prep_write_fixed(sqe, 0, data, static_cast<unsigned>(size), static_cast<off_t>(write_offset), buf_index);
+    sqe->flags |= IOSQE_FIXED_FILE;
+  } else {
+    io_uring_prep_write(sqe, fd_, data, static_cast<unsigned>(size), static_cast<off_t>(write_offset));
+  }
+#ifdef RWF_DSYNC
+  if (write_through_) {
+    sqe->rw_flags = RWF_DSYNC;
+  }
+#endif
   io_uring_sqe_set_data64(sqe, write_id);
+  RPI_TRACE3(io_write_submit, write_id, write_offset, size);
   
   // Submit the request
   int ret = io_uring_submit(ring_);
@@ -692,6 +1205,283 @@ FileError LinuxFileOperations::AsyncWriteSequential(const std::uint8_t* data, st
 #endif
 }
 
+FileError LinuxFileOperations::AsyncFlush(AsyncWriteCallback callback) {
+  if (fd_ < 0) {
+    if (callback) callback(FileError::kOpenError, 0);
+    return FileError::kOpenError;
+  }
+
+  if (!IsAsyncFlushSupported() || ring_ == nullptr) {
+    return FileOperations::AsyncFlush(callback);
+  }
+
+#ifdef HAVE_LIBURING
+  if (first_async_error_ != FileError::kSuccess) {
+    if (callback) callback(first_async_error_, 0);
+    return first_async_error_;
+  }
+
+  struct io_uring_sqe* sqe = io_uring_get_sqe(ring_);
+  if (sqe == nullptr) {
+    io_uring_submit(ring_);
+    ProcessCompletions(true);
+    sqe = io_uring_get_sqe(ring_);
+    if (sqe == nullptr) {
+      Log("io_uring: failed to get SQE for fdatasync even after flush");
+      if (callback) callback(FileError::kFlushError, 0);
+      return FileError::kFlushError;
+    }
+  }
+
+  std::uint64_t sync_id = next_write_id_++;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_syncs_map_[sync_id] = callback;
+  }
+  pending_syncs_.fetch_add(1);
+
+  if (UpdateFixedFile(fd_)) {
+    io_uring_prep_fsync(sqe, 0, IORING_FSYNC_DATASYNC);
+    sqe->flags |= IOSQE_FIXED_FILE;
+  } else {
+    io_uring_prep_fsync(sqe, fd_, IORING_FSYNC_DATASYNC);
+  }
+  // Every earlier write has already been submitted, so there is nothing
+  // left to link to; draining starts the sync only once they have all
+  // completed, and holds back later writes until it is done
+  sqe->flags |= IOSQE_IO_DRAIN;
+  io_uring_sqe_set_data64(sqe, sync_id);
+  RPI_TRACE1(io_sync_submit, sync_id);
+
+  int ret = io_uring_submit(ring_);
+  if (ret < 0) {
+    pending_syncs_.fetch_sub(1);
+    {
+      std::lock_guard<std::mutex> lock(pending_mutex_);
+      pending_syncs_map_.erase(sync_id);
+    }
+    std::ostringstream oss;
+    oss << "io_uring_submit (fdatasync) failed: " << strerror(-ret);
+    Log(oss.str());
+    if (callback) callback(FileError::kFlushError, 0);
+    return FileError::kFlushError;
+  }
+
+  return FileError::kSuccess;
+#else
+  return FileOperations::AsyncFlush(callback);
+#endif
+}
+
+FileError LinuxFileOperations::AsyncReadSequential(std::uint8_t* data, std::size_t size,
+                                                    AsyncReadCallback callback) {
+  if (fd_ < 0) {
+    if (callback) callback(FileError::kOpenError, 0);
+    return FileError::kOpenError;
+  }
+
+  if (cancelled_.load()) {
+    if (callback) callback(FileError::kCancelled, 0);
+    return FileError::kCancelled;
+  }
+
+  // The descriptor's offset is the sequential read position, as for
+  // ReadSequential(). Advance it now so the next read queues behind this one.
+  off_t end = lseek(fd_, static_cast<off_t>(size), SEEK_CUR);
+  if (end == -1) {
+    if (callback) callback(FileError::kSeekError, 0);
+    return FileError::kSeekError;
+  }
+  std::uint64_t read_offset = static_cast<std::uint64_t>(end) - size;
+
+  if (!io_uring_available_ || ring_ == nullptr || sync_fallback_mode_) {
+    std::size_t bytes_read = 0;
+    FileError result = ReadAtOffset(read_offset, data, size, bytes_read);
+    if (callback) callback(result, bytes_read);
+    return result;
+  }
+
+#ifdef HAVE_LIBURING
+  struct io_uring_sqe* sqe = io_uring_get_sqe(ring_);
+  if (sqe == nullptr) {
+    io_uring_submit(ring_);
+    ProcessCompletions(true);
+    sqe = io_uring_get_sqe(ring_);
+    if (sqe == nullptr) {
+      Log("io_uring: failed to get SQE for read even after flush");
+      if (callback) callback(FileError::kReadError, 0);
+      return FileError::kReadError;
+    }
+  }
+
+  std::uint64_t read_id = next_write_id_++;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_reads_map_[read_id] = PendingRead{callback, data, read_offset, size};
+  }
+  pending_reads_.fetch_add(1);
+
+  io_uring_prep_read(sqe, fd_, data, static_cast<unsigned>(size), static_cast<off_t>(read_offset));
+  io_uring_sqe_set_data64(sqe, read_id);
+  RPI_TRACE3(io_read_submit, read_id, read_offset, size);
+
+  int ret = io_uring_submit(ring_);
+  if (ret < 0) {
+    pending_reads_.fetch_sub(1);
+    {
+      std::lock_guard<std::mutex> lock(pending_mutex_);
+      pending_reads_map_.erase(read_id);
+    }
+    std::ostringstream oss;
+    oss << "io_uring_submit (read) failed: " << strerror(-ret);
+    Log(oss.str());
+    if (callback) callback(FileError::kReadError, 0);
+    return FileError::kReadError;
+  }
+
+  return FileError::kSuccess;
+#else
+  // Should never reach here, but just in case
+  std::size_t bytes_read = 0;
+  FileError result = ReadAtOffset(read_offset, data, size, bytes_read);
+  if (callback) callback(result, bytes_read);
+  return result;
+#endif
+}
+
+FileError LinuxFileOperations::WaitForPendingReads(int max_pending) {
+#ifdef HAVE_LIBURING
+  if (max_pending < 0) max_pending = 0;
+  bool cancel_submitted = false;
+
+  while (pending_reads_.load() > max_pending) {
+    if (cancelled_.load()) {
+      if (max_pending > 0) {
+        return FileError::kCancelled;
+      }
+      // The buffers are about to be freed: cancel, then drain every completion
+      if (!cancel_submitted) {
+        CancelAsyncIO();
+        cancel_submitted = true;
+      }
+    }
+    ProcessCompletions(true);
+  }
+
+  return cancelled_.load() ? FileError::kCancelled : FileError::kSuccess;
+#else
+  (void)max_pending;
+  return FileError::kSuccess;
+#endif
+}
+
+bool LinuxFileOperations::RegisterAsyncBuffers(const std::vector<AsyncBuffer>& buffers) {
+#ifdef HAVE_LIBURING
+  if (!io_uring_available_ || ring_ == nullptr) {
+    return false;
+  }
+  
+  // Registration needs an idle ring
+  WaitForPendingWrites();
+  UnregisterAsyncBuffers();
+  if (buffers.empty()) {
+    return false;
+  }
+  
+  std::vector<struct iovec> iov;
+  iov.reserve(buffers.size());
+  for (const AsyncBuffer& buffer : buffers) {
+    struct iovec v;
+    v.iov_base = const_cast<std::uint8_t*>(buffer.first);
+    v.iov_len = buffer.second;
+    iov.push_back(v);
+  }
+  
+  int ret = io_uring_register_buffers(ring_, iov.data(), static_cast<unsigned>(iov.size()));
+  if (ret < 0) {
+    // Typically ENOMEM from RLIMIT_MEMLOCK on kernels before 5.12
+    std::ostringstream oss;
+    oss << "io_uring_register_buffers failed: " << strerror(-ret) << ", using unregistered writes";
+    Log(oss.str());
+    return false;
+  }
+  registered_buffers_ = buffers;
+  
+  // One-entry fixed file table, filled in by UpdateFixedFile()
+  int fd = -1;
+  ret = io_uring_register_files(ring_, &fd, 1);
+  if (ret < 0) {
+    std::ostringstream oss;
+    oss << "io_uring_register_files failed: " << strerror(-ret) << ", using unregistered writes";
+    Log(oss.str());
+    UnregisterAsyncBuffers();
+    return false;
+  }
+  fixed_files_registered_ = true;
+  registered_fd_ = -1;
+  
+  std::ostringstream oss;
+  oss << "io_uring: registered " << buffers.size() << " write buffers";
+  Log(oss.str());
+  return true;
+#else
+  (void)buffers;
+  return false;
+#endif
+}
+
+void LinuxFileOperations::UnregisterAsyncBuffers() {
+#ifdef HAVE_LIBURING
+  if (ring_ == nullptr) {
+    return;
+  }
+  WaitForPendingWrites();
+  if (fixed_files_registered_) {
+    io_uring_unregister_files(ring_);
+    fixed_files_registered_ = false;
+    registered_fd_ = -1;
+  }
+  if (!registered_buffers_.empty()) {
+    io_uring_unregister_buffers(ring_);
+    registered_buffers_.clear();
+  }
+#endif
+}
+
+int LinuxFileOperations::FindRegisteredBuffer(const std::uint8_t* data, std::size_t size) const {
+  for (std::size_t i = 0; i < registered_buffers_.size(); ++i) {
+    const AsyncBuffer& buffer = registered_buffers_[i];
+    if (data >= buffer.first && data + size <= buffer.first + buffer.second) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+bool LinuxFileOperations::UpdateFixedFile(int fd) {
+#ifdef HAVE_LIBURING
+  if (!fixed_files_registered_ || ring_ == nullptr) {
+    return false;
+  }
+  if (registered_fd_ == fd) {
+    return fd >= 0;
+  }
+  // Updating the table does not need an idle ring, unlike registering
+  int ret = io_uring_register_files_update(ring_, 0, &fd, 1);
+  if (ret < 0) {
+    std::ostringstream oss;
+    oss << "io_uring_register_files_update failed: " << strerror(-ret);
+    Log(oss.str());
+    return false;
+  }
+  registered_fd_ = fd;
+  return fd >= 0;
+#else
+  (void)fd;
+  return false;
+#endif
+}
+
 void LinuxFileOperations::PollAsyncCompletions() {
   // Intentionally a no-op on Linux.
   //
@@ -728,6 +1518,20 @@ void LinuxFileOperations::CancelAsyncIO() {
         io_uring_sqe_set_data64(sqe, 0);  // No callback for cancel operations
       }
     }
+    for (const auto& [read_id, pending] : pending_reads_map_) {
+      struct io_uring_sqe* sqe = io_uring_get_sqe(ring_);
+      if (sqe != nullptr) {
+        io_uring_prep_cancel64(sqe, read_id, 0);
+        io_uring_sqe_set_data64(sqe, 0);
+      }
+    }
+    for (const auto& [sync_id, pending] : pending_syncs_map_) {
+      struct io_uring_sqe* sqe = io_uring_get_sqe(ring_);
+      if (sqe != nullptr) {
+        io_uring_prep_cancel64(sqe, sync_id, 0);
+        io_uring_sqe_set_data64(sqe, 0);
+      }
+    }
   }
   io_uring_submit(ring_);
 
@@ -754,7 +1558,7 @@ FileError LinuxFileOperations::WaitForPendingWrites() {
   auto startTime = std::chrono::steady_clock::now();
   int lastLogSecond = 0;
   
-  while (pending_writes_.load() > 0) {
+  while (pending_writes_.load() > 0 || pending_syncs_.load() > 0) {
     // Check cancellation
     if (cancelled_.load()) {
       CancelAsyncIO();
@@ -897,6 +1701,19 @@ FileError LinuxFileOperations::AttemptSyncFallback() {
     Log("Sync fallback: fsync failed");
     return FileError::kSyncError;
   }
+
+  // The fsync above also covers any flushes still queued behind the writes
+  std::unordered_map<std::uint64_t, AsyncWriteCallback> syncs;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    syncs.swap(pending_syncs_map_);
+  }
+  pending_syncs_.store(0);
+  for (const auto& [sync_id, sync_callback] : syncs) {
+    if (sync_callback) {
+      sync_callback(FileError::kSuccess, 0);
+    }
+  }
   
   // Update async_write_offset_ to reflect completed writes
   if (!pendingWrites.empty()) {
@@ -999,6 +1816,41 @@ void LinuxFileOperations::ReduceQueueDepthForRecovery(int newDepth) {
 #endif
 }
 
+bool LinuxFileOperations::ResumeAsyncAfterSyncFallback(int depth) {
+#ifdef HAVE_LIBURING
+  if (!sync_fallback_mode_ || !io_uring_available_ || ring_ == nullptr || depth <= 1 ||
+      pending_writes_.load() > 0 || first_async_error_ != FileError::kSuccess) {
+    return false;
+  }
+
+  // Sync writes kept async_write_offset_ up to date, so queueing carries on from there
+  async_queue_depth_ = depth;
+  sync_fallback_mode_ = false;
+
+  Log("Resumed async writes after sync fallback at queue depth " + std::to_string(depth));
+  return true;
+#else
+  (void)depth;
+  return false;
+#endif
+}
+
+void LinuxFileOperations::RestoreQueueDepthAfterRecovery(int newDepth) {
+#ifdef HAVE_LIBURING
+  int oldDepth = async_queue_depth_;
+  if (newDepth <= oldDepth || sync_fallback_mode_) {
+    return;
+  }
+
+  // The ring is sized for the largest depth, so only the limit changes
+  async_queue_depth_ = newDepth;
+
+  Log("Queue depth restored after recovery: " + std::to_string(oldDepth) + " -> " + std::to_string(newDepth));
+#else
+  (void)newDepth;
+#endif
+}
+
 // Query device I/O limits from sysfs without requiring an open file descriptor.
 // Returns zero-initialized struct if the device path isn't a block device or sysfs is unavailable.
 FileOperations::DeviceIOLimits QueryPlatformDeviceIOLimits(const std::string& path) {
@@ -1029,6 +1881,63 @@ FileOperations::DeviceIOLimits QueryPlatformDeviceIOLimits(const std::string& pa
       limits.max_transfer_bytes = static_cast<size_t>(val) * 1024;
   }
 
+  // Sector sizes — O_DIRECT needs whole logical blocks, physical blocks avoid RMW
+  {
+    std::ifstream f(queueDir + "logical_block_size");
+    int val = 0;
+    if (f >> val && val > 0)
+      limits.io_alignment_bytes = static_cast<size_t>(val);
+  }
+  {
+    std::ifstream f(queueDir + "physical_block_size");
+    int val = 0;
+    if (f >> val && val > 0)
+      limits.physical_sector_bytes = static_cast<size_t>(val);
+  }
+
+  // optimal_io_size — preferred request size, 0 when the device does not say
+  {
+    std::ifstream f(queueDir + "optimal_io_size");
+    long long val = 0;
+    if (f >> val && val > 0)
+      limits.optimal_io_bytes = static_cast<size_t>(val);
+  }
+
+  // Erase unit: SD/MMC cards report their allocation unit as
+  // preferred_erase_size. Elsewhere the discard granularity is the nearest
+  // hint, but most devices report a sector there, which says nothing.
+  {
+    std::ifstream f("/sys/block/" + devname + "/device/preferred_erase_size");
+    long long val = 0;
+    if (f >> val && val > 0)
+      limits.erase_unit_bytes = static_cast<size_t>(val);
+  }
+  if (limits.erase_unit_bytes == 0) {
+    std::ifstream f(queueDir + "discard_granularity");
+    long long val = 0;
+    if (f >> val && val >= 64 * 1024 && (val & (val - 1)) == 0)
+      limits.erase_unit_bytes = static_cast<size_t>(val);
+  }
+
+  // Volatile write cache: "write back" or "write through" (Linux 4.7+).
+  // FUA writes reach the media without flushing the rest of the cache.
+  {
+    std::ifstream f(queueDir + "write_cache");
+    std::string mode;
+    if (std::getline(f, mode)) {
+      if (mode == "write back")
+        limits.write_cache = FileOperations::DeviceIOLimits::WriteCache::kWriteBack;
+      else if (mode == "write through")
+        limits.write_cache = FileOperations::DeviceIOLimits::WriteCache::kWriteThrough;
+    }
+  }
+  {
+    std::ifstream f(queueDir + "fua");
+    int val = 0;
+    if (f >> val)
+      limits.fua_supported = val != 0;
+  }
+
   return limits;
 }
 
@@ -45,6 +45,8 @@ class LinuxFileOperations : public FileOperations {
   // Streaming I/O operations
   FileError WriteSequential(const std::uint8_t* data, std::size_t size) override;
   FileError ReadSequential(std::uint8_t* data, std::size_t size, std::size_t& bytes_read) override;
+  FileError ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                         std::size_t size, std::size_t& bytes_read) override;
   
   // File positioning
   FileError Seek(std::uint64_t position) override;
@@ -53,9 +55,30 @@ class LinuxFileOperations : public FileOperations {
   // Sync operations
   FileError ForceSync() override;
   FileError Flush() override;
+  FileError SyncToDevice() override;
+
+  // Ranged writeback (sync_file_range), for buffered writes only
+  bool IsRangeWritebackSupported() const override { return IsOpen() && !using_direct_io_; }
+  FileError StartWriteback(std::uint64_t offset, std::uint64_t length) override;
+  FileError WaitWriteback(std::uint64_t offset, std::uint64_t length) override;
   
   // Sequential read optimization
   void PrepareForSequentialRead(std::uint64_t offset, std::uint64_t length) override;
+
+  // Zeroing without writing data (BLKZEROOUT / BLKDISCARD, or punching
+  // holes in a regular file)
+  ZeroRangeMethod GetZeroRangeMethod() const override { return zero_range_method_; }
+  FileError ZeroRange(std::uint64_t offset, std::uint64_t length) override;
+
+  // Image file targets (FICLONE, or copy_file_range() per data segment)
+  bool IsRegularFile() const override { return is_regular_file_; }
+  FileError CloneFrom(int src_fd, std::uint64_t length) override;
+
+  // Kernel copy from a file (splice() through a pipe)
+  FileError SpliceFrom(int src_fd, std::uint64_t src_offset, std::size_t length) override;
+
+  // Whole-device erase (BLKDISCARD)
+  FileError EraseDevice() override;
   
   // Handle access
   int GetHandle() const override;
@@ -68,6 +91,10 @@ class LinuxFileOperations : public FileOperations {
   
   // Enable or disable direct I/O
   FileError SetDirectIOEnabled(bool enabled) override;
+
+  // Write-through with RWF_DSYNC, on synchronous and io_uring writes
+  bool SetWriteThrough(bool enabled) override;
+  bool IsWriteThrough() const override { return write_through_; }
   
   // Get direct I/O attempt details (Linux: O_DIRECT attempted for block devices)
   DirectIOInfo GetDirectIOInfo() const override { 
@@ -84,12 +111,24 @@ class LinuxFileOperations : public FileOperations {
   bool IsAsyncIOSupported() const override { return io_uring_available_; }
   FileError AsyncWriteSequential(const std::uint8_t* data, std::size_t size, 
                                   AsyncWriteCallback callback = nullptr) override;
+  bool RegisterAsyncBuffers(const std::vector<AsyncBuffer>& buffers) override;
+  void UnregisterAsyncBuffers() override;
   int GetPendingWriteCount() const override { return pending_writes_.load(); }
+  FileError AsyncReadSequential(std::uint8_t* data, std::size_t size,
+                                AsyncReadCallback callback = nullptr) override;
+  FileError WaitForPendingReads(int max_pending = 0) override;
+  int GetPendingReadCount() const override { return pending_reads_.load(); }
   void PollAsyncCompletions() override;
   FileError WaitForPendingWrites() override;
+  bool IsAsyncFlushSupported() const override {
+    return io_uring_available_ && async_queue_depth_ > 1 && !sync_fallback_mode_;
+  }
+  FileError AsyncFlush(AsyncWriteCallback callback = nullptr) override;
   void CancelAsyncIO() override;
   std::vector<PendingWriteInfo> GetPendingWritesSorted() const override;
   void ReduceQueueDepthForRecovery(int newDepth) override;
+  void RestoreQueueDepthAfterRecovery(int newDepth) override;
+  bool ResumeAsyncAfterSyncFallback(int depth) override;
   // GetAsyncIOStats() inherited from FileOperations base class
 
  private:
@@ -98,15 +137,28 @@ class LinuxFileOperations : public FileOperations {
   int last_error_code_;
   bool using_direct_io_;
   bool direct_io_attempted_;  // True if O_DIRECT was attempted for this device
+  bool write_through_;        // Writes carry RWF_DSYNC
+  ZeroRangeMethod zero_range_method_;
+  std::uint32_t logical_block_size_;
+  bool is_regular_file_;
   
   // io_uring state
   int async_queue_depth_;
   std::atomic<int> pending_writes_;
+  std::atomic<int> pending_reads_;
+  std::atomic<int> pending_syncs_;
   std::atomic<bool> cancelled_;
   FileError first_async_error_;
   std::uint64_t async_write_offset_;
   bool io_uring_available_;
   io_uring* ring_;
+  bool sqpoll_;  // A kernel thread polls the submission queue
+  
+  // Registered buffers (IORING_OP_WRITE_FIXED) and the fd registered as
+  // fixed file 0 (-1 = none, table empty when !fixed_files_registered_)
+  std::vector<AsyncBuffer> registered_buffers_;
+  bool fixed_files_registered_;
+  int registered_fd_;
   
   // Track callbacks by user_data pointer
   struct PendingWrite {
@@ -117,17 +169,34 @@ class LinuxFileOperations : public FileOperations {
     std::chrono::steady_clock::time_point submit_time;
   };
   std::unordered_map<std::uint64_t, PendingWrite> pending_callbacks_;
+
+  // Reads share the ring and the id sequence with writes
+  struct PendingRead {
+    AsyncReadCallback callback;
+    std::uint8_t* data;
+    std::uint64_t offset;
+    std::size_t size;
+  };
+  std::unordered_map<std::uint64_t, PendingRead> pending_reads_map_;
+  // Queued fdatasync()s, by id from the same sequence
+  std::unordered_map<std::uint64_t, AsyncWriteCallback> pending_syncs_map_;
   std::uint64_t next_write_id_;
   mutable std::mutex pending_mutex_;
   
   // Note: write_latency_stats_ is inherited from FileOperations base class
 
   FileError OpenInternal(const char* path, int flags, mode_t mode = 0);
+  ssize_t WriteChunk(const std::uint8_t* data, std::size_t size);
   static bool IsBlockDevicePath(const std::string& path);
+  static ZeroRangeMethod QueryZeroRangeMethod(const std::string& path);
+  FileError PunchHole(std::uint64_t offset, std::uint64_t length);
+  void UpdateRegularFile();
   
   bool InitIOUring();
   void CleanupIOUring();
   void ProcessCompletions(bool wait);
+  int FindRegisteredBuffer(const std::uint8_t* data, std::size_t size) const;
+  bool UpdateFixedFile(int fd);
   FileError AttemptSyncFallback() override;
   bool DrainAndSwitchToSync(int timeoutSeconds) override;
 };
@@ -12,6 +12,7 @@
  */
 
 #include "../platformquirks.h"
+#include "devicehelper.h"
 #include <cstdlib>
 #include <unistd.h>
 #include <pwd.h>
@@ -34,6 +35,7 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <atomic>
+#include <map>
 #include <mutex>
 #include <net/if_arp.h>
 #include <QDebug>
@@ -1358,6 +1360,13 @@ QString getEjectDevicePath(const QString& devicePath) {
 DiskResult unmountDisk(const QString& device) {
     QByteArray deviceBytes = device.toUtf8();
     const char* devicePath = deviceBytes.constData();
+
+    // An unprivileged GUI cannot umount(); the device helper can
+    if (::geteuid() != 0 && rpi_imager::DeviceHelper::IsRunning()) {
+        const int result = rpi_imager::DeviceHelper::Unmount(deviceBytes.toStdString());
+        if (result >= 0)
+            return static_cast<DiskResult>(result);
+    }
     
     // Verify device exists and is not a directory
     struct stat stats;
@@ -1493,6 +1502,108 @@ DiskResult ejectDisk(const QString& device) {
     return unmountDisk(device);
 }
 
+// Power settings changed by holdDevicePowerOn(), per device: sysfs file and
+// its value before
+static std::mutex powerHoldMutex;
+static std::map<QString, std::vector<std::pair<QString, QByteArray>>> powerHolds;
+
+static QByteArray readSysfsValue(const QString& path) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return {};
+    return f.readAll().trimmed();
+}
+
+static bool writeSysfsValue(const QString& path, const QByteArray& value) {
+    // Unbuffered, so that a value the kernel rejects fails the write itself
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Unbuffered) || f.write(value) != value.size()) {
+        qDebug() << "holdDevicePowerOn: cannot write" << value << "to" << path;
+        return false;
+    }
+    return true;
+}
+
+// The USB device (the directory with idVendor) that block device name is
+// attached through, or empty if it is not on USB
+static QString usbDeviceDir(const QString& sysRoot, const QString& name) {
+    const QString root = QFileInfo(sysRoot).canonicalFilePath();
+    QString dir = QFileInfo(sysRoot + "/block/" + name + "/device").canonicalFilePath();
+    while (!root.isEmpty() && dir.startsWith(root + '/')) {
+        if (QFile::exists(dir + "/idVendor") && QFile::exists(dir + "/power/control"))
+            return dir;
+        dir = QFileInfo(dir).path();
+    }
+    return {};
+}
+
+static QString holdDevicePowerOnImpl(const QString& sysRoot, const QString& device) {
+    if (!device.startsWith("/dev/"))
+        return {};
+    const QString usbDir = usbDeviceDir(sysRoot, device.mid(5));
+    if (usbDir.isEmpty())
+        return {};
+
+    // Value to set, and the values that already mean it
+    struct Setting { const char* file; QByteArray value; QList<QByteArray> alreadySet; };
+    const Setting settings[] = {
+        {"power/control", "on", {"on"}},
+        {"power/usb2_hardware_lpm", "0", {"0", "n", "N"}},
+        {"port/usb3_lpm_permit", "0", {"0"}},
+    };
+
+    std::lock_guard<std::mutex> lock(powerHoldMutex);
+    if (powerHolds.count(device))
+        return {};
+
+    std::vector<std::pair<QString, QByteArray>> changed;
+    QStringList description;
+    for (const Setting& setting : settings) {
+        const QString path = usbDir + '/' + setting.file;
+        const QByteArray before = readSysfsValue(path);
+        if (before.isEmpty() || setting.alreadySet.contains(before))
+            continue;
+        if (writeSysfsValue(path, setting.value)) {
+            changed.emplace_back(path, before);
+            description.append(QString("%1 %2 -> %3").arg(setting.file, QString::fromLatin1(before), QString::fromLatin1(setting.value)));
+        }
+    }
+    if (changed.empty())
+        return {};
+
+    powerHolds[device] = std::move(changed);
+    qDebug() << "holdDevicePowerOn:" << device << "via" << usbDir << ":" << description;
+    return description.join(", ");
+}
+
+static void releaseDevicePowerImpl(const QString& device) {
+    std::lock_guard<std::mutex> lock(powerHoldMutex);
+    auto it = powerHolds.find(device);
+    if (it == powerHolds.end())
+        return;
+    // Back in reverse, so that power/control goes back to auto last
+    for (auto change = it->second.rbegin(); change != it->second.rend(); ++change)
+        writeSysfsValue(change->first, change->second);
+    powerHolds.erase(it);
+}
+
+QString holdDevicePowerOn(const QString& device) {
+    return holdDevicePowerOnImpl("/sys", device);
+}
+
+void releaseDevicePower(const QString& device) {
+    releaseDevicePowerImpl(device);
+}
+
+// Test API for unit testing against a fake sysfs tree
+#ifdef PLATFORMQUIRKS_ENABLE_TEST_API
+namespace TestAPI {
+    QString holdDevicePowerOn(const QString& sysRoot, const QString& device) {
+        return holdDevicePowerOnImpl(sysRoot, device);
+    }
+}
+#endif
+
 const char* findCACertBundle()
 {
     // Cache the result - this is called on every curl handle setup
@@ -0,0 +1,249 @@
+/*
+ * SHA256 using the CPU's SHA instructions (x86 SHA-NI, ARMv8 SHA2)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "sha256_kernel.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA256_KERNEL_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define SHA256_KERNEL_ARMV8
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace {
+
+alignas(16) const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t initialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+#ifdef SHA256_KERNEL_X86
+__attribute__((target("sha,sse4.1,ssse3")))
+void compressShaNi(uint32_t state[8], const uint8_t *blocks, size_t count)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The SHA-NI instructions want the state as ABEF and CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0])), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4])), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; count > 0; count--, blocks += 64)
+    {
+        const __m128i abefSave = state0;
+        const __m128i cdghSave = state1;
+        __m128i w[4];
+
+        for (int i = 0; i < 16; i++)
+        {
+            if (i < 4)
+            {
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks + 16 * i)), byteSwap);
+            }
+            else
+            {
+                __m128i next = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+                w[i & 3] = _mm_sha256msg2_epu32(next, w[(i + 3) & 3]);
+            }
+
+            __m128i msg = _mm_add_epi32(w[i & 3], _mm_load_si128(reinterpret_cast<const __m128i *>(&K[4 * i])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]), state1);
+}
+
+bool cpuHasShaNi()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+        return false;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ebx & bit_SHA) != 0;
+}
+#endif
+
+#ifdef SHA256_KERNEL_ARMV8
+#if defined(__clang__)
+__attribute__((target("sha2")))
+#else
+__attribute__((target("+crypto")))
+#endif
+void compressArmV8(uint32_t state[8], const uint8_t *blocks, size_t count)
+{
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    for (; count > 0; count--, blocks += 64)
+    {
+        const uint32x4_t abcdSave = state0;
+        const uint32x4_t efghSave = state1;
+        uint32x4_t w[4];
+
+        for (int i = 0; i < 16; i++)
+        {
+            if (i < 4)
+                w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 16 * i)));
+            else
+                w[i & 3] = vsha256su1q_u32(vsha256su0q_u32(w[i & 3], w[(i + 1) & 3]), w[(i + 2) & 3], w[(i + 3) & 3]);
+
+            const uint32x4_t msg = vaddq_u32(w[i & 3], vld1q_u32(&K[4 * i]));
+            const uint32x4_t prev = state0;
+            state0 = vsha256hq_u32(state0, state1, msg);
+            state1 = vsha256h2q_u32(state1, prev, msg);
+        }
+
+        state0 = vaddq_u32(state0, abcdSave);
+        state1 = vaddq_u32(state1, efghSave);
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+bool cpuHasArmV8Sha2()
+{
+    return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+}
+#endif
+
+} // namespace
+
+Sha256Kernel::Backend Sha256Kernel::backend()
+{
+    static const Backend detected = [] {
+#ifdef SHA256_KERNEL_X86
+        if (cpuHasShaNi())
+            return Backend::ShaNi;
+#endif
+#ifdef SHA256_KERNEL_ARMV8
+        if (cpuHasArmV8Sha2())
+            return Backend::ArmV8;
+#endif
+        return Backend::None;
+    }();
+    return detected;
+}
+
+const char *Sha256Kernel::backendName(Backend backend)
+{
+    switch (backend)
+    {
+    case Backend::ShaNi:
+        return "SHA-NI";
+    case Backend::ArmV8:
+        return "ARMv8 SHA2";
+    case Backend::None:
+        break;
+    }
+    return "none";
+}
+
+Sha256Kernel::CompressFn Sha256Kernel::_compress()
+{
+    switch (backend())
+    {
+#ifdef SHA256_KERNEL_X86
+    case Backend::ShaNi:
+        return compressShaNi;
+#endif
+#ifdef SHA256_KERNEL_ARMV8
+    case Backend::ArmV8:
+        return compressArmV8;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+Sha256Kernel::Sha256Kernel()
+    : _bufferFill(0), _totalLength(0), _compressFn(_compress())
+{
+    memcpy(_state, initialState, sizeof(_state));
+}
+
+void Sha256Kernel::addData(const void *data, size_t length)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    _totalLength += length;
+
+    if (_bufferFill > 0)
+    {
+        const size_t n = length < sizeof(_buffer) - _bufferFill ? length : sizeof(_buffer) - _bufferFill;
+        memcpy(_buffer + _bufferFill, p, n);
+        _bufferFill += n;
+        p += n;
+        length -= n;
+        if (_bufferFill < sizeof(_buffer))
+            return;
+        _compressFn(_state, _buffer, 1);
+        _bufferFill = 0;
+    }
+
+    // Whole blocks straight from the caller's buffer
+    if (length >= 64)
+    {
+        _compressFn(_state, p, length / 64);
+        p += length & ~size_t(63);
+        length &= 63;
+    }
+
+    memcpy(_buffer, p, length);
+    _bufferFill = length;
+}
+
+void Sha256Kernel::result(uint8_t digest[32]) const
+{
+    uint32_t state[8];
+    uint8_t tail[128] = {};
+    memcpy(state, _state, sizeof(state));
+    memcpy(tail, _buffer, _bufferFill);
+    tail[_bufferFill] = 0x80;
+
+    const size_t tailLength = _bufferFill + 9 <= 64 ? 64 : 128;
+    const uint64_t bits = _totalLength * 8;
+    for (int i = 0; i < 8; i++)
+        tail[tailLength - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    _compressFn(state, tail, tailLength / 64);
+
+    for (int i = 0; i < 8; i++)
+    {
+        digest[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+        digest[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[4 * i + 3] = static_cast<uint8_t>(state[i]);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef SHA256_KERNEL_H
+#define SHA256_KERNEL_H
+
+/*
+ * SHA256 using the CPU's SHA instructions (x86 SHA-NI, ARMv8 SHA2)
+ *
+ * GnuTLS only uses these through its hardware acceleration layer, which
+ * depends on how the distribution built it; with this kernel the fast
+ * path does not depend on the installed GnuTLS.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+class Sha256Kernel
+{
+public:
+    enum class Backend { None, ShaNi, ArmV8 };
+
+    /**
+     * @brief SHA instructions supported by this CPU, detected once at run time
+     */
+    static Backend backend();
+    static const char *backendName(Backend backend);
+
+    /**
+     * @brief Only valid to construct if backend() != Backend::None
+     */
+    Sha256Kernel();
+
+    void addData(const void *data, size_t length);
+    void result(uint8_t digest[32]) const;
+
+private:
+    using CompressFn = void (*)(uint32_t state[8], const uint8_t *blocks, size_t count);
+    static CompressFn _compress();
+
+    uint32_t _state[8];
+    uint8_t _buffer[64];
+    size_t _bufferFill;
+    uint64_t _totalLength;
+    CompressFn _compressFn;
+};
+
+#endif // SHA256_KERNEL_H
@@ -0,0 +1,176 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "livemetrics.h"
+#include "latencyhistogram.h"
+#include <sstream>
+
+namespace {
+
+// A bound in seconds, without trailing zeros: 0.00025, 1, 2.5
+std::string seconds(uint64_t us)
+{
+    std::string text = std::to_string(us / 1000000);
+    uint64_t fraction = us % 1000000;
+    if (fraction)
+    {
+        std::string digits = std::to_string(fraction);
+        digits.insert(0, 6 - digits.size(), '0');
+        while (digits.back() == '0')
+            digits.pop_back();
+        text += "." + digits;
+    }
+    return text;
+}
+
+void header(std::ostringstream &out, const char *name, const char *type, const char *help, const char *unit = nullptr)
+{
+    out << "# TYPE " << name << ' ' << type << '\n';
+    if (unit)
+        out << "# UNIT " << name << ' ' << unit << '\n';
+    out << "# HELP " << name << ' ' << help << '\n';
+}
+
+} // namespace
+
+LiveMetrics &LiveMetrics::instance()
+{
+    static LiveMetrics metrics;
+    return metrics;
+}
+
+const char *LiveMetrics::phaseName(Phase phase)
+{
+    switch (phase)
+    {
+    case Phase::Download:   return "download";
+    case Phase::Decompress: return "decompress";
+    case Phase::Write:      return "write";
+    case Phase::Verify:     return "verify";
+    default:                return "unknown";
+    }
+}
+
+const char *LiveMetrics::recoveryName(Recovery action)
+{
+    switch (action)
+    {
+    case Recovery::QueueDepth:  return "queueDepth";
+    case Recovery::HotSwap:     return "hotSwap";
+    case Recovery::Restart:     return "restart";
+    case Recovery::HardTimeout: return "hardTimeout";
+    default:                    return "unknown";
+    }
+}
+
+std::string LiveMetrics::escapeLabel(const std::string &value)
+{
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value)
+    {
+        if (c == '\\' || c == '"')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (c == '\n')
+            escaped += "\\n";
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+
+void LiveMetrics::publishLatency(const std::string &device, const std::string &operation, const std::vector<uint64_t> &counts)
+{
+    std::lock_guard<std::mutex> lock(_latencyMutex);
+    Latency &latency = _latency[{device, operation}];
+
+    bool restarted = latency.published.size() != counts.size();
+    for (size_t i = 0; i < counts.size() && !restarted; ++i)
+        restarted = counts[i] < latency.published[i];
+
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        const uint64_t added = restarted ? counts[i] : counts[i] - latency.published[i];
+        if (!added)
+            continue;
+        // The first bound the bucket's largest value is within, so the
+        // rendered histogram never understates a latency
+        const uint64_t upper = rpi_imager::LatencyHistogram::BucketUpperBound(static_cast<int>(i));
+        size_t bound = 0;
+        while (bound < kLatencyBoundsUs.size() && upper > kLatencyBoundsUs[bound])
+            ++bound;
+        latency.buckets[bound] += added;
+    }
+    latency.published = counts;
+}
+
+std::string LiveMetrics::render() const
+{
+    std::ostringstream out;
+
+    header(out, "rpi_imager_phase_bytes", "counter", "Bytes through each phase of the imaging pipeline", "bytes");
+    for (size_t i = 0; i < _phaseBytes.size(); ++i)
+    {
+        out << "rpi_imager_phase_bytes_total{phase=\"" << phaseName(static_cast<Phase>(i)) << "\"} "
+            << _phaseBytes[i].load(std::memory_order_relaxed) << '\n';
+    }
+
+    header(out, "rpi_imager_write_throughput_bytes_per_second", "gauge", "Write throughput over the last half second");
+    out << "rpi_imager_write_throughput_bytes_per_second " << _writeThroughput.load(std::memory_order_relaxed) << '\n';
+
+    header(out, "rpi_imager_ring_buffer_slots_used", "gauge", "Slots holding data in the decompression ring buffers");
+    out << "rpi_imager_ring_buffer_slots_used{ring=\"input\"} " << _ringInputSlots.load(std::memory_order_relaxed) << '\n'
+        << "rpi_imager_ring_buffer_slots_used{ring=\"write\"} " << _ringWriteSlots.load(std::memory_order_relaxed) << '\n';
+
+    header(out, "rpi_imager_async_queue_depth", "gauge", "Async writes allowed in flight");
+    out << "rpi_imager_async_queue_depth " << _asyncQueueDepth.load(std::memory_order_relaxed) << '\n';
+    header(out, "rpi_imager_async_pending_writes", "gauge", "Async writes in flight");
+    out << "rpi_imager_async_pending_writes " << _pendingWrites.load(std::memory_order_relaxed) << '\n';
+
+    header(out, "rpi_imager_watchdog_recoveries", "counter", "Recovery actions taken by the write progress watchdog");
+    for (size_t i = 0; i < _recoveries.size(); ++i)
+    {
+        out << "rpi_imager_watchdog_recoveries_total{action=\"" << recoveryName(static_cast<Recovery>(i)) << "\"} "
+            << _recoveries[i].load(std::memory_order_relaxed) << '\n';
+    }
+
+    header(out, "rpi_imager_io_latency_seconds", "histogram", "Latency of device I/O operations", "seconds");
+    {
+        std::lock_guard<std::mutex> lock(_latencyMutex);
+        for (const auto &[key, latency] : _latency)
+        {
+            const std::string labels = "device=\"" + escapeLabel(key.first) + "\",operation=\"" + escapeLabel(key.second) + "\"";
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < kLatencyBoundsUs.size(); ++i)
+            {
+                cumulative += latency.buckets[i];
+                out << "rpi_imager_io_latency_seconds_bucket{" << labels << ",le=\"" << seconds(kLatencyBoundsUs[i])
+                    << "\"} " << cumulative << '\n';
+            }
+            cumulative += latency.buckets.back();
+            out << "rpi_imager_io_latency_seconds_bucket{" << labels << ",le=\"+Inf\"} " << cumulative << '\n'
+                << "rpi_imager_io_latency_seconds_count{" << labels << "} " << cumulative << '\n';
+        }
+    }
+
+    out << "# EOF\n";
+    return out.str();
+}
+
+void LiveMetrics::reset()
+{
+    for (auto &bytes : _phaseBytes)
+        bytes.store(0, std::memory_order_relaxed);
+    _writeThroughput.store(0, std::memory_order_relaxed);
+    setRingOccupancy(0, 0);
+    setAsyncQueue(0, 0);
+    for (auto &count : _recoveries)
+        count.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(_latencyMutex);
+    _latency.clear();
+}
@@ -0,0 +1,126 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef LIVEMETRICS_H
+#define LIVEMETRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Counters and gauges of the imaging pipeline while it runs, for scraping
+ *
+ * PerformanceStats keeps the whole session for a report at the end; a
+ * station fleet wants the current state instead. The pipeline publishes
+ * here as it goes: ImageWriter the bytes through each phase, ring buffer
+ * occupancy and watchdog recoveries, DownloadThread the write throughput,
+ * async queue state and its device's latency histograms. Counters and
+ * gauges are relaxed atomics, so publishing costs a store; MetricsServer
+ * renders them on each scrape.
+ *
+ * Counters add up over every write of the process, so a manifest run or a
+ * daemon reads as one series. Latency histograms are taken from the
+ * thread's LatencyHistogram twice a second, and only while enabled.
+ */
+class LiveMetrics
+{
+public:
+    enum class Phase { Download, Decompress, Write, Verify, Count };
+    enum class Recovery { QueueDepth, HotSwap, Restart, HardTimeout, Count };
+
+    // Bucket bounds of the rendered latency histograms, in microseconds
+    static constexpr std::array<uint64_t, 16> kLatencyBoundsUs = {
+        100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+        100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000};
+
+    // The pipeline's; tests make their own
+    static LiveMetrics &instance();
+    LiveMetrics() = default;
+
+    /**
+     * @brief Whether anything scrapes the metrics; latency is only published then
+     */
+    bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+
+    void addPhaseBytes(Phase phase, uint64_t bytes)
+    {
+        _phaseBytes[static_cast<size_t>(phase)].fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void setWriteThroughput(uint64_t bytesPerSecond) { _writeThroughput.store(bytesPerSecond, std::memory_order_relaxed); }
+    void setRingOccupancy(uint32_t inputSlots, uint32_t writeSlots)
+    {
+        _ringInputSlots.store(inputSlots, std::memory_order_relaxed);
+        _ringWriteSlots.store(writeSlots, std::memory_order_relaxed);
+    }
+    void setAsyncQueue(int depth, int pendingWrites)
+    {
+        _asyncQueueDepth.store(depth, std::memory_order_relaxed);
+        _pendingWrites.store(pendingWrites, std::memory_order_relaxed);
+    }
+    void addRecovery(Recovery action)
+    {
+        _recoveries[static_cast<size_t>(action)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Publish a device's latency histogram
+     * @param device Device path, the "device" label
+     * @param operation "write", "sync" or "verifyRead"
+     * @param counts LatencyHistogram::Snapshot() of it
+     *
+     * What was added since the last publish for the same device and
+     * operation is counted. A bucket that went down means a new histogram,
+     * from the next write to the device, and all of it is counted.
+     */
+    void publishLatency(const std::string &device, const std::string &operation, const std::vector<uint64_t> &counts);
+
+    /**
+     * @brief All metrics in the OpenMetrics text format, ending in "# EOF"
+     */
+    std::string render() const;
+
+    /**
+     * @brief Clear everything, for tests
+     */
+    void reset();
+
+    static const char *phaseName(Phase phase);
+    static const char *recoveryName(Recovery action);
+
+    /**
+     * @brief Escape a label value: backslash, double quote and newline
+     */
+    static std::string escapeLabel(const std::string &value);
+
+private:
+    LiveMetrics(const LiveMetrics&) = delete;
+    LiveMetrics& operator=(const LiveMetrics&) = delete;
+
+    struct Latency {
+        std::vector<uint64_t> published;                       // Counts at the last publish
+        std::array<uint64_t, kLatencyBoundsUs.size() + 1> buckets{};  // Per bound, then +Inf; not cumulative
+    };
+
+    std::atomic<bool> _enabled{false};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(Phase::Count)> _phaseBytes{};
+    std::atomic<uint64_t> _writeThroughput{0};
+    std::atomic<uint32_t> _ringInputSlots{0};
+    std::atomic<uint32_t> _ringWriteSlots{0};
+    std::atomic<int> _asyncQueueDepth{0};
+    std::atomic<int> _pendingWrites{0};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(Recovery::Count)> _recoveries{};
+
+    mutable std::mutex _latencyMutex;
+    std::map<std::pair<std::string, std::string>, Latency> _latency;  // By device and operation
+};
+
+#endif // LIVEMETRICS_H
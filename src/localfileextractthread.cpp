@@ -5,15 +5,43 @@
 
 #include "localfileextractthread.h"
 #include "config.h"
+#include "containerlimits.h"
+#include "threadcputime.h"
+#include "gzipdecoder.h"
+#include "parallelgzipdecoder.h"
 #include "systemmemorymanager.h"
+#include "usedblockscanner.h"
 #include <archive.h>
 #include <archive_entry.h>
 
 #include <QUrl>
+#include <QDir>
 #include <QDebug>
+#include <thread>
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_DARWIN)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#endif
+#if defined(Q_OS_LINUX)
+#include <linux/fs.h>
+#elif defined(Q_OS_DARWIN)
+#include <sys/disk.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#include <winioctl.h>
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// Fewer cores than this decode a .gz file faster sequentially
+static constexpr int PARALLEL_GZIP_MIN_THREADS = 4;
 
 LocalFileExtractThread::LocalFileExtractThread(const QByteArray &url, const QByteArray &dst, const QByteArray &expectedHash, QObject *parent)
-    : DownloadExtractThread(url, dst, expectedHash, parent)
+    : DownloadExtractThread(url, dst, expectedHash, parent), _rawImageSource(false), _directRead(false), _rawReadError(false),
+      _cloneSource(false), _cloneUsedBlocksOnly(false), _inputMap(nullptr), _inputMapSize(0), _inputMapPos(0), _inputMapReleased(0)
 {
     // Prevent the machine from sleeping while the download/extraction is in progress.
     try
@@ -35,12 +63,14 @@ LocalFileExtractThread::~LocalFileExtractThread()
 {
     _cancelled = true;
     
-    // Ensure input file is always closed to prevent file handle leaks
-    if (_inputfile.isOpen()) {
+    // Ensure input file is always closed to prevent file handle leaks.
+    // A mapped input is only closed once the thread no longer reads it.
+    if (_inputfile.isOpen() && !_inputMap) {
         _inputfile.close();
     }
     
     wait();
+    _inputfile.close();
     qFreeAligned(_inputBuf);
 
     // Release the inhibition on suspending the system.
@@ -52,35 +82,62 @@ LocalFileExtractThread::~LocalFileExtractThread()
 void LocalFileExtractThread::_cancelExtract()
 {
     _cancelled = true;
-    if (_inputfile.isOpen())
+    // Wakes the raw image reader if it is waiting for a free slot
+    if (_writeRingBuffer)
+        _writeRingBuffer->cancel();
+    // Closing would unmap memory libarchive may still be decoding from;
+    // _on_read() fails on the next call instead
+    if (_inputfile.isOpen() && !_inputMap)
         _inputfile.close();
 }
 
 void LocalFileExtractThread::run()
 {
+    ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::Download);
     if (isImage() && !_openAndPrepareDevice())
         return;
+    _onDevicePrepared();
 
     emit preparationStatusUpdate(tr("Opening image file..."));
     _timer.start();
     _inputfile.setFileName( QUrl(_url).toLocalFile() );
-    if (!_inputfile.open(_inputfile.ReadOnly))
+    if (_chunkedImageSource)
+    {
+        _chunkReader = std::make_unique<ImageChunkStore::Reader>();
+        if (!_chunkReader->open(_inputfile.fileName()))
+        {
+            _onDownloadError(tr("Error opening image file"));
+            _closeFiles();
+            return;
+        }
+        _lastDlTotal = _chunkReader->size();
+    }
+    else if (!(_rawImageSource && _openInputUncached(_inputfile.fileName())) && !_openInputSequential(_inputfile.fileName()))
     {
         _onDownloadError(tr("Error opening image file"));
         _closeFiles();
         return;
     }
-    _lastDlTotal = _inputfile.size();
+    else
+    {
+        _lastDlTotal = _fileSize(_inputfile);
+    }
+
+    if (isImage() && _cloneSource && _cloneUsedBlocksOnly)
+        _scanUsedBlocks();
     
     emit preparationStatusUpdate(tr("Starting extraction..."));
 
     // Test if this file can be handled by libarchive
     bool canUseArchive = false;
-    if (isImage())
+    if (isImage() && !_rawImageSource)
     {
         canUseArchive = _testArchiveFormat();
     }
     
+    if (!isImage() || canUseArchive)
+        _mapInput();
+
     if (isImage() && canUseArchive)
         extractImageRun();  // Use libarchive for compressed/archive files
     else if (isImage() && !canUseArchive)
@@ -97,15 +154,27 @@ ssize_t LocalFileExtractThread::_on_read(struct archive *, const void **buff)
     if (_cancelled)
         return -1;
 
-    *buff = _inputBuf;
-    ssize_t len = _inputfile.read(_inputBuf, _inputBufSize);
+    ssize_t len;
+    if (_inputMap)
+    {
+        // Hand out a window of the mapping instead of copying it
+        _releaseMappedInput();
+        len = qMin((qint64)_inputBufSize, _inputMapSize - _inputMapPos);
+        *buff = _inputMap + _inputMapPos;
+        _inputMapPos += len;
+    }
+    else
+    {
+        *buff = _inputBuf;
+        len = _inputfile.read(_inputBuf, _inputBufSize);
+    }
 
     if (len > 0)
     {
         _lastDlNow += len;
         if (!_isImage)
         {
-            _inputHash.addData(_inputBuf, len);
+            _inputHash.addData(static_cast<const char *>(*buff), len);
         }
         
         // Emit progress updates for local file extraction
@@ -117,53 +186,409 @@ ssize_t LocalFileExtractThread::_on_read(struct archive *, const void **buff)
 
 int LocalFileExtractThread::_on_close(struct archive *)
 {
+    if (_inputMap)
+    {
+        _inputfile.unmap(_inputMap);
+        _inputMap = nullptr;
+    }
     _inputfile.close();
     return 0;
 }
 
-void LocalFileExtractThread::extractRawImageRun()
+/*
+ * Map a local archive so libarchive decodes straight from the page cache,
+ * saving a copy and a read() per chunk. Best effort: on failure (e.g. not
+ * enough address space on 32-bit builds) _on_read() keeps using read().
+ */
+bool LocalFileExtractThread::_mapInput()
+{
+    qint64 size = _inputfile.size();
+    if (size <= 0)
+        return false;
+
+    uchar *map = _inputfile.map(0, size);
+    if (!map)
+    {
+        qDebug() << "Could not map" << _inputfile.fileName() << "- using buffered reads";
+        return false;
+    }
+#if defined(Q_OS_LINUX) || defined(Q_OS_DARWIN)
+    madvise(map, size, MADV_SEQUENTIAL);
+#endif
+
+    _inputMapSize = size;
+    _inputMapPos = _inputfile.pos();
+    _inputMapReleased = 0;
+    _inputMap = map;
+    return true;
+}
+
+/*
+ * Drop the pages behind the read cursor. libarchive may still use the
+ * window returned by the previous _on_read() call, so we stay one window
+ * behind. The archive is read once, so keeping it cached only evicts more
+ * useful data.
+ */
+void LocalFileExtractThread::_releaseMappedInput()
+{
+    const qint64 pageSize = SystemMemoryManager::instance().getSystemPageSize();
+    qint64 end = (_inputMapPos - (qint64)_inputBufSize) / pageSize * pageSize;
+    if (end <= _inputMapReleased)
+        return;
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_DARWIN)
+    madvise(_inputMap + _inputMapReleased, end - _inputMapReleased, MADV_DONTNEED);
+#endif
+#if defined(Q_OS_LINUX)
+    posix_fadvise(_inputfile.handle(), _inputMapReleased, end - _inputMapReleased, POSIX_FADV_DONTNEED);
+#endif
+    _inputMapReleased = end;
+}
+
+/*
+ * Open the input so that reads bypass the page cache. A cached image is
+ * read once per write and is typically several GB, so caching it only
+ * evicts more useful data. Best effort: returns false if not supported,
+ * in which case the caller opens the file normally.
+ */
+bool LocalFileExtractThread::_openInputUncached(const QString &path)
+{
+#if defined(Q_OS_LINUX)
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+    if (fd < 0)
+    {
+        qDebug() << "O_DIRECT not available for" << path << "- using buffered reads";
+        return false;
+    }
+    // _inputBuf and _inputBufSize are block aligned as O_DIRECT requires
+    _directRead = true;
+#elif defined(Q_OS_DARWIN)
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    fcntl(fd, F_NOCACHE, 1);
+#else
+    Q_UNUSED(path);
+    return false;
+#endif
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_DARWIN)
+    if (!_inputfile.open(fd, QIODevice::ReadOnly | QIODevice::Unbuffered, QFileDevice::AutoCloseHandle))
+    {
+        ::close(fd);
+        _directRead = false;
+        return false;
+    }
+    return true;
+#endif
+}
+
+/*
+ * Open the input with a sequential access hint, so the OS reads ahead
+ * aggressively. Matters most for slow source media such as a USB stick
+ * holding the image in embedded mode.
+ */
+bool LocalFileExtractThread::_openInputSequential(const QString &path)
+{
+#if defined(Q_OS_WIN)
+    HANDLE h = CreateFileW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(path).utf16()), GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (h != INVALID_HANDLE_VALUE)
+    {
+        int fd = _open_osfhandle(reinterpret_cast<intptr_t>(h), _O_RDONLY | _O_BINARY);
+        if (fd < 0)
+            CloseHandle(h);
+        else if (_inputfile.open(fd, QIODevice::ReadOnly, QFileDevice::AutoCloseHandle))
+            return true;
+        else
+            _close(fd);
+    }
+    return _inputfile.open(QIODevice::ReadOnly);
+#else
+    Q_UNUSED(path);
+    if (!_inputfile.open(QIODevice::ReadOnly))
+        return false;
+#if defined(Q_OS_LINUX)
+    posix_fadvise(_inputfile.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#elif defined(Q_OS_DARWIN)
+    fcntl(_inputfile.handle(), F_RDAHEAD, 1);
+#endif
+    return true;
+#endif
+}
+
+/*
+ * QFile reports 0 bytes for block devices, ask the device instead
+ */
+quint64 LocalFileExtractThread::_fileSize(QFile &file)
+{
+    qint64 size = file.size();
+    if (size > 0 || !file.isOpen())
+        return static_cast<quint64>(qMax<qint64>(size, 0));
+
+    int fd = file.handle();
+#if defined(Q_OS_LINUX)
+    std::uint64_t bytes = 0;
+    if (ioctl(fd, BLKGETSIZE64, &bytes) == 0)
+        return bytes;
+#elif defined(Q_OS_DARWIN)
+    std::uint64_t blockCount = 0;
+    std::uint32_t blockSize = 0;
+    if (ioctl(fd, DKIOCGETBLOCKCOUNT, &blockCount) == 0 && ioctl(fd, DKIOCGETBLOCKSIZE, &blockSize) == 0)
+        return blockCount * blockSize;
+#elif defined(Q_OS_WIN)
+    GET_LENGTH_INFORMATION info;
+    DWORD returned;
+    if (DeviceIoControl(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), IOCTL_DISK_GET_LENGTH_INFO,
+                        nullptr, 0, &info, sizeof(info), &returned, nullptr))
+        return static_cast<quint64>(info.Length.QuadPart);
+#else
+    Q_UNUSED(fd);
+#endif
+    return 0;
+}
+
+quint64 LocalFileExtractThread::sourceSize(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+    return _fileSize(file);
+}
+
+/*
+ * Clone only the blocks the source's file systems use. The map replaces a
+ * .bmap: unused ranges are skipped when writing, and only the used ones are
+ * read back when verifying.
+ */
+void LocalFileExtractThread::_scanUsedBlocks()
+{
+    emit preparationStatusUpdate(tr("Finding used blocks..."));
+
+    QElapsedTimer scanTimer;
+    scanTimer.start();
+
+    // With O_DIRECT, reads must be aligned in offset, length and memory
+    const std::uint64_t alignment = 4096;
+    UsedBlockScanner scanner([this, alignment](std::uint64_t offset, char *buf, size_t len) {
+        const std::uint64_t start = offset / alignment * alignment;
+        const std::uint64_t span = (offset + len + alignment - 1) / alignment * alignment - start;
+        char *bounce = static_cast<char *>(qMallocAligned(span, alignment));
+        if (!bounce)
+            return false;
+        bool ok = _inputfile.seek(start)
+                  && _inputfile.read(bounce, span) >= static_cast<qint64>(offset + len - start);
+        if (ok)
+            memcpy(buf, bounce + (offset - start), len);
+        qFreeAligned(bounce);
+        return ok;
+    }, _lastDlTotal);
+
+    std::unique_ptr<fastboot::BlockMap> map = scanner.scan();
+    _inputfile.seek(0);
+
+    if (!map)
+    {
+        qDebug() << "Clone: no used block map, copying every block";
+        return;
+    }
+    qDebug() << "Clone: block scan took" << scanTimer.elapsed() << "ms";
+    setBlockMap(std::move(map));
+}
+
+/*
+ * Input comes from _inputfile rather than the download ring buffer. A raw
+ * .gz image that is mapped in full can be decoded in parallel; anything
+ * else goes through libarchive.
+ */
+bool LocalFileExtractThread::_extractNativeRun()
+{
+    if (!_inputMap)
+        return false;
+
+    // Speculative chunk decoding does up to three times the work of
+    // sequential decoding
+    int numThreads = ContainerLimits::cpuCount();
+    if (numThreads < PARALLEL_GZIP_MIN_THREADS)
+        return false;
+    if (numThreads > 8) numThreads = 8;  // Same cap as the other decoders
+
+    const char *data = reinterpret_cast<const char *>(_inputMap + _inputMapPos);
+    size_t len = static_cast<size_t>(_inputMapSize - _inputMapPos);
+    if (!GzipDecoder::isGzipStream(data, len) || GzipDecoder::mayBeArchive(data, len))
+        return false;
+
+    QElapsedTimer extractionTimer;
+    extractionTimer.start();
+
+    // Bound chunks decoded ahead by a quarter of free memory, as for xz
+    qint64 availableMB = SystemMemoryManager::instance().getAvailableMemoryMB();
+    quint64 budget = static_cast<quint64>(qBound<qint64>(64, availableMB / 4, 1024)) * 1024 * 1024;
+    qDebug() << "Decompression pipeline: gzip (native, up to" << numThreads << "chunks in parallel,"
+             << budget / (1024 * 1024) << "MB in flight)";
+    ParallelGzipDecoder decoder(data, len, _writeRingBuffer, numThreads, budget);
+
+    emit eventImageExtraction(static_cast<quint32>(extractionTimer.elapsed()), true);
+
+    _runDecoder(decoder);
+    return true;
+}
+
+void LocalFileExtractThread::_onDecoderProgress(const DecoderThread &decoder)
+{
+    _lastDlNow = decoder.bytesConsumed();
+}
+
+/*
+ * Reader side of the raw image copy: fills write ring buffer slots from
+ * the input file, so the next chunk is already in memory when the device
+ * finishes the previous write
+ */
+void LocalFileExtractThread::_readRawImage(qint64 totalBytes)
 {
-    qDebug() << "Extracting raw disk image (ISO/IMG/RAW) directly";
-    
-    qint64 totalBytes = _inputfile.size();
     qint64 bytesRead = 0;
-    
+
     while (bytesRead < totalBytes && !_cancelled)
     {
-        qint64 chunkSize = qMin((qint64)_inputBufSize, totalBytes - bytesRead);
-        qint64 len = _inputfile.read(_inputBuf, chunkSize);
-        
+        RingBuffer::Slot *slot = _writeRingBuffer->acquireWriteSlot(100);
+        if (!slot)
+        {
+            if (_writeRingBuffer->isCancelled() || _writeRingBuffer->isStallTimeoutExceeded())
+                break;
+            continue;
+        }
+
+        // O_DIRECT needs the full aligned length even for the final short read
+        qint64 chunkSize = _directRead ? (qint64)slot->capacity : qMin((qint64)slot->capacity, totalBytes - bytesRead);
+        qint64 len = _chunkReader ? _chunkReader->read(slot->data, chunkSize)
+                                  : _inputfile.read(slot->data, chunkSize);
+
         if (len <= 0)
         {
             if (len < 0)
-                _onDownloadError(tr("Error reading from image file"));
+                _rawReadError = true;
+            // Empty slots are released unwritten by the consumer
+            _writeRingBuffer->commitWriteSlot(slot, 0);
             break;
         }
-        
-        // Write the data directly to the output device
-        size_t written = _writeFile(_inputBuf, len);
-        if (written != (size_t)len)
+
+        _writeRingBuffer->commitWriteSlot(slot, len);
+        bytesRead += len;
+        _lastDlNow = bytesRead;
+    }
+
+    _writeRingBuffer->producerDone();
+}
+
+void LocalFileExtractThread::extractRawImageRun()
+{
+    qDebug() << "Extracting raw disk image (ISO/IMG/RAW) directly";
+    
+    qint64 totalBytes = static_cast<qint64>(_lastDlTotal.load());
+    qint64 bytesWritten = 0;
+    bool writeOk = true;
+    _rawReadError = false;
+
+    // An image file on the same file system takes a reflink or in-kernel
+    // copy of the source; the image is still read below to be hashed
+    if (!_cloneSource && !_chunkedImageSource && _inputfile.handle() >= 0)
+        _cloneFromFile(_inputfile.handle(), static_cast<std::uint64_t>(totalBytes));
+
+    // A cached image with a known-good hash can go from the page cache to
+    // the device without being read or hashed here
+    if (_trustedSource && !_cloneSource && !_chunkedImageSource && _inputfile.handle() >= 0 &&
+        _spliceFromFile(_inputfile.handle(), static_cast<std::uint64_t>(totalBytes), [this]() { _emitProgressUpdate(); }))
+    {
+        _emitPipelineSummary();
+        return;
+    }
+
+    std::thread reader([this, totalBytes]() { _readRawImage(totalBytes); });
+
+    while (true)
+    {
+        RingBuffer::Slot *slot = _writeRingBuffer->acquireReadSlot(100);
+        while (!slot && !_cancelled && !_writeRingBuffer->isCancelled() && !_writeRingBuffer->isComplete()
+               && !_writeRingBuffer->isStallTimeoutExceeded()) {
+            // Keep polling so async write callbacks can return slots to the reader
+            if (_file && _file->IsAsyncIOSupported()) {
+                _file->PollAsyncCompletions();
+            }
+            slot = _writeRingBuffer->acquireReadSlot(100);
+        }
+        if (!slot)
+            break;
+
+        size_t size = slot->size;
+        if (size == 0)
         {
-            _onDownloadError(tr("Error writing to device"));
+            _writeRingBuffer->releaseReadSlot(slot);
+            continue;
+        }
+        bytesWritten += size;
+
+        if (size % _writeAlignment != 0)
+        {
+            size_t paddingBytes = _writeAlignment-(size % _writeAlignment);
+            qDebug() << "Image is NOT a valid disk image, as its length is not a multiple of the" << _writeAlignment << "byte sector size";
+            qDebug() << "Last write() would be" << size << "bytes, but padding to" << size + paddingBytes << "bytes";
+            memset(slot->data + size, 0, paddingBytes);
+            size += paddingBytes;
+        }
+
+        std::shared_ptr<RingBuffer> ringBufRef = _writeRingBuffer;
+        RingBuffer::Slot *slotToRelease = slot;
+        DownloadThread::WriteCompleteCallback releaseCallback = [ringBufRef, slotToRelease]() {
+            ringBufRef->releaseReadSlot(slotToRelease);
+        };
+
+        if (_writeFileSparse(slot->data, size, releaseCallback) == 0)
+        {
+            writeOk = false;
+            _writeRingBuffer->cancel();
             break;
         }
-        
-        bytesRead += len;
-        _lastDlNow = bytesRead;
-        
+
         // Emit progress updates
         _emitProgressUpdate();
     }
-    
-    if (!_cancelled && bytesRead == totalBytes)
+
+    reader.join();
+
+    if (!writeOk || _writeRingBuffer->isStallTimeoutExceeded())
+    {
+        // Their callbacks reference the ring buffer, so we must wait
+        if (_file && _file->IsAsyncIOSupported()) {
+            _file->WaitForPendingWrites();
+        }
+    }
+
+    if (!writeOk)
     {
-        qDebug() << "Raw image extraction completed successfully";
-        _writeComplete();
+        _onWriteError();
     }
     else if (!_cancelled)
     {
-        _onDownloadError(tr("Failed to read complete image file"));
+        if (_writeRingBuffer->isStallTimeoutExceeded())
+            _onDownloadError(tr("The write operation has stalled.\n\n"
+                                "No data has been written for 30 seconds. "
+                                "This could be caused by:\n"
+                                "• Storage device disconnected or unresponsive\n"
+                                "• Device has failed or is faulty\n"
+                                "• System resource exhaustion\n\n"
+                                "Please check the storage device and try again."));
+        else if (_rawReadError)
+            _onDownloadError(tr("Error reading from image file"));
+        else if (bytesWritten == totalBytes)
+        {
+            qDebug() << "Raw image extraction completed successfully";
+            _writeComplete();
+        }
+        else
+            _onDownloadError(tr("Failed to read complete image file"));
     }
+
+    _emitPipelineSummary();
 }
 
 bool LocalFileExtractThread::_testArchiveFormat()
@@ -8,7 +8,10 @@
 
 #include "downloadextractthread.h"
 #include "suspend_inhibitor.h"
+#include "imagechunkstore.h"
 #include <QFile>
+#include <atomic>
+#include <memory>
 
 // Forward declarations for libarchive
 struct archive;
@@ -21,18 +24,72 @@ public:
     explicit LocalFileExtractThread(const QByteArray &url, const QByteArray &dst = "", const QByteArray &expectedHash = "", QObject *parent = nullptr);
     virtual ~LocalFileExtractThread();
 
+    /*
+     * Source is an uncompressed image (e.g. from the decompressed image
+     * cache): skip format detection and copy it with uncached reads
+     */
+    void setRawImageSource(bool raw) { _rawImageSource = raw; }
+
+    /*
+     * Source is the recipe of an image in the decompressed image cache's
+     * chunk store; the image is read back from its chunks
+     */
+    void setChunkedImageSource() { _rawImageSource = true; _chunkedImageSource = true; }
+
+    /*
+     * The hash of the source is known to match the expected hash (a
+     * decompressed image cache hit), so on Linux it may be written by the
+     * kernel without passing through this process or being hashed.
+     * Call setRawImageSource(true) as well.
+     */
+    void setTrustedSource(bool trusted) { _trustedSource = trusted; }
+
+    /*
+     * Source is a storage device (or raw disk image) being cloned. With
+     * usedBlocksOnly, free space of its file systems is not copied; the
+     * source is scanned up front instead of while it is written.
+     * Call setRawImageSource(true) as well.
+     */
+    void setCloneSource(bool usedBlocksOnly) { _cloneSource = true; _cloneUsedBlocksOnly = usedBlocksOnly; _mapUsedBlocks = false; }
+
+    /*
+     * Size of a local image or block device, 0 if unknown
+     */
+    static quint64 sourceSize(const QString &path);
+
 protected:
     virtual void _cancelExtract();
     virtual void run();
     virtual ssize_t _on_read(struct archive *a, const void **buff);
     virtual int _on_close(struct archive *a);
+    virtual bool _extractNativeRun();
+    virtual void _onDecoderProgress(const DecoderThread &decoder);
     void extractRawImageRun();
+    void _readRawImage(qint64 totalBytes);
     bool _testArchiveFormat();
+    bool _openInputUncached(const QString &path);
+    bool _openInputSequential(const QString &path);
+    bool _mapInput();
+    static quint64 _fileSize(QFile &file);
+    void _scanUsedBlocks();
+    void _releaseMappedInput();
     static ssize_t _archive_read_test(struct archive *, void *client_data, const void **buff);
     static int _archive_close_test(struct archive *, void *client_data);
     QFile _inputfile;
     char *_inputBuf;
     size_t _inputBufSize;
+    bool _rawImageSource;
+    bool _directRead;
+    std::atomic<bool> _rawReadError;
+    bool _cloneSource;
+    bool _cloneUsedBlocksOnly;
+    bool _chunkedImageSource = false;
+    bool _trustedSource = false;
+    std::unique_ptr<ImageChunkStore::Reader> _chunkReader;
+    uchar *_inputMap;  // Whole input file, if mapped for libarchive
+    qint64 _inputMapSize;
+    qint64 _inputMapPos;
+    qint64 _inputMapReleased;
 
 private:
     SuspendInhibitor *_suspendInhibitor;
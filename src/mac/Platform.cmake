@@ -16,9 +16,10 @@ set(PLATFORM_SOURCES
     mac/acceleratedcryptographichash_commoncrypto.cpp
     mac/macfile.cpp
     mac/macfile.h
-    mac/bootimgcreator_macos.cpp
     mac/rsakeyfingerprint_macos.mm
     drivelist/drivelist_darwin.mm
+    drivelist/devicemonitor.h
+    drivelist/devicemonitor_darwin.mm
     mac/file_operations_macos.cpp
     mac/platformquirks_macos.mm
     mac/mac_suspend_inhibitor.cpp
@@ -37,28 +37,38 @@ private:
     CC_SHA256_CTX _sha256;
 };
 
-AcceleratedCryptographicHash::AcceleratedCryptographicHash(QCryptographicHash::Algorithm method)
-    : p_Impl(std::make_unique<impl>(method)), _algo(method) {}
+AcceleratedCryptographicHash::AcceleratedCryptographicHash(QCryptographicHash::Algorithm method, Mode mode)
+    : p_Impl(std::make_unique<impl>(method)), _tree(mode != Mode::Sequential ? _makeTree(method, mode) : nullptr), _algo(method) {}
 
 AcceleratedCryptographicHash::~AcceleratedCryptographicHash() = default;
 
 void AcceleratedCryptographicHash::addData(const char *data, int length) {
+    if (_tree)
+        return _treeAddData(data, length);
     p_Impl->addData(data, length);
 }
 void AcceleratedCryptographicHash::addData(const QByteArray &data) {
+    if (_tree)
+        return _treeAddData(data.constData(), data.size());
     p_Impl->addData(data);
 }
 QByteArray AcceleratedCryptographicHash::result() const {
     // CC_SHA256_Final is destructive - cache the result so subsequent calls work
     if (!_resultCached) {
-        _cachedResult = p_Impl->result();
+        _cachedResult = _tree ? _treeResult() : p_Impl->result();
         _resultCached = true;
     }
     return _cachedResult;
 }
 
+QString AcceleratedCryptographicHash::backendName() {
+    return QStringLiteral("CommonCrypto");
+}
+
 void AcceleratedCryptographicHash::reset() {
     p_Impl = std::make_unique<impl>(_algo);
+    if (_tree)
+        _resetTree();
     _cachedResult.clear();
     _resultCached = false;
 }
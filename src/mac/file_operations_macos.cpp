@@ -19,7 +19,11 @@
 #include <chrono>
 #include <thread>
 #include <functional>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 #include "../timeout_utils.h"
+#include "../tracepoints.h"
 
 using rpi_imager::TimeoutResult;
 using rpi_imager::TimeoutConfig;
@@ -39,9 +43,10 @@ static void Log(const std::string& msg) {
 }
 
 MacOSFileOperations::MacOSFileOperations() 
-    : fd_(-1), last_error_code_(0), using_direct_io_(false),
+    : fd_(-1), last_error_code_(0), using_direct_io_(false), raw_block_size_(0),
       async_queue_depth_(1), pending_writes_(0), cancelled_(false), first_async_error_(FileError::kSuccess),
-      async_queue_(nullptr), queue_semaphore_(nullptr), async_write_offset_(0),
+      async_queue_(nullptr), queue_semaphore_(nullptr), slots_to_retire_(0), retired_slots_(0),
+      read_queue_(nullptr), pending_reads_(0), async_write_offset_(0),
       next_write_id_(1) {
 }
 
@@ -50,6 +55,105 @@ bool MacOSFileOperations::IsBlockDevicePath(const std::string& path) {
   return (path.find("/dev/") == 0);
 }
 
+std::string MacOSFileOperations::RawDevicePath(const std::string& path) {
+  // The buffered /dev/diskN node splits large transfers into small cached
+  // ones; the raw node passes them straight to the driver. DiskArbitration
+  // (unmount, eject) still wants /dev/diskN, but that is handled by path
+  // elsewhere, never through this file descriptor.
+  static const std::string kBlockPrefix = "/dev/disk";
+  if (path.compare(0, kBlockPrefix.size(), kBlockPrefix) != 0) {
+    return path;
+  }
+  return "/dev/rdisk" + path.substr(kBlockPrefix.size());
+}
+
+bool MacOSFileOperations::IsRawAligned(std::uint64_t offset, std::size_t size) const {
+  return raw_block_size_ == 0 || (offset % raw_block_size_ == 0 && size % raw_block_size_ == 0);
+}
+
+FileError MacOSFileOperations::UnalignedWriteAt(std::uint64_t offset, const std::uint8_t* data, std::size_t size) {
+  const std::uint64_t block = raw_block_size_;
+  const std::uint64_t start = offset / block * block;
+  const std::uint64_t end = (offset + size + block - 1) / block * block;
+  const std::size_t length = static_cast<std::size_t>(end - start);
+
+  void* bounce = nullptr;
+  if (posix_memalign(&bounce, 4096, length) != 0) {
+    return FileError::kWriteError;
+  }
+  std::unique_ptr<std::uint8_t, decltype(&free)> buffer(static_cast<std::uint8_t*>(bounce), &free);
+
+  // Keep what is already on the device around the write
+  auto readBlock = [this, &buffer, start](std::uint64_t at) {
+    ssize_t n = pread(fd_, buffer.get() + (at - start), raw_block_size_, static_cast<off_t>(at));
+    if (n < static_cast<ssize_t>(raw_block_size_)) {
+      memset(buffer.get() + (at - start) + std::max<ssize_t>(n, 0), 0,
+             raw_block_size_ - static_cast<std::size_t>(std::max<ssize_t>(n, 0)));
+    }
+  };
+  const bool partialHead = offset != start;
+  const bool partialTail = offset + size != end;
+  if (partialHead) {
+    readBlock(start);
+  }
+  if (partialTail && !(partialHead && end - block == start)) {
+    readBlock(end - block);
+  }
+  memcpy(buffer.get() + (offset - start), data, size);
+
+  std::size_t written = 0;
+  while (written < length) {
+    ssize_t result = pwrite(fd_, buffer.get() + written, length - written, static_cast<off_t>(start + written));
+    if (result <= 0) {
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      last_error_code_ = errno;
+      return FileError::kWriteError;
+    }
+    written += static_cast<std::size_t>(result);
+  }
+  return FileError::kSuccess;
+}
+
+FileError MacOSFileOperations::UnalignedReadAt(std::uint64_t offset, std::uint8_t* data,
+                                               std::size_t size, std::size_t& bytes_read) {
+  bytes_read = 0;
+  const std::uint64_t block = raw_block_size_;
+  const std::uint64_t start = offset / block * block;
+  const std::uint64_t end = (offset + size + block - 1) / block * block;
+  const std::size_t length = static_cast<std::size_t>(end - start);
+
+  void* bounce = nullptr;
+  if (posix_memalign(&bounce, 4096, length) != 0) {
+    return FileError::kReadError;
+  }
+  std::unique_ptr<std::uint8_t, decltype(&free)> buffer(static_cast<std::uint8_t*>(bounce), &free);
+
+  std::size_t got = 0;
+  while (got < length) {
+    ssize_t result = pread(fd_, buffer.get() + got, length - got, static_cast<off_t>(start + got));
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      last_error_code_ = errno;
+      return FileError::kReadError;
+    }
+    if (result == 0) {
+      break;  // End of device
+    }
+    got += static_cast<std::size_t>(result);
+  }
+
+  const std::size_t skip = static_cast<std::size_t>(offset - start);
+  if (got > skip) {
+    bytes_read = std::min(size, got - skip);
+    memcpy(data, buffer.get() + skip, bytes_read);
+  }
+  return FileError::kSuccess;
+}
+
 bool MacOSFileOperations::EnableDirectIO() {
   if (fd_ < 0) {
     return false;
@@ -95,14 +199,26 @@ FileError MacOSFileOperations::SetDirectIOEnabled(bool enabled) {
 }
 
 MacOSFileOperations::~MacOSFileOperations() {
+  WaitForPendingReads();
   Close();
   CleanupAsyncIO();
+  if (read_queue_ != nullptr) {
+    dispatch_release(read_queue_);
+    read_queue_ = nullptr;
+  }
 }
 
 void MacOSFileOperations::InitAsyncIO() {
   if (async_queue_ == nullptr && async_queue_depth_ > 1) {
-    async_queue_ = dispatch_queue_create("com.raspberrypi.imager.asyncio", DISPATCH_QUEUE_SERIAL);
+    // Each write is a positional pwrite(), so writes at distinct offsets can
+    // run side by side; the semaphore, not the queue, bounds how many do.
+    // A serial queue would keep the device at queue depth 1.
+    dispatch_queue_attr_t attr = dispatch_queue_attr_make_with_qos_class(
+        DISPATCH_QUEUE_CONCURRENT, QOS_CLASS_USER_INITIATED, 0);
+    async_queue_ = dispatch_queue_create("com.raspberrypi.imager.asyncio", attr);
     queue_semaphore_ = dispatch_semaphore_create(async_queue_depth_);
+    slots_to_retire_.store(0);
+    retired_slots_.store(0);
     async_write_offset_ = 0;
     pending_writes_.store(0);
     cancelled_.store(false);
@@ -116,6 +232,11 @@ void MacOSFileOperations::CleanupAsyncIO() {
   WaitForPendingWrites();
   
   if (queue_semaphore_ != nullptr) {
+    // libdispatch aborts if a semaphore is released below its initial value
+    for (int i = retired_slots_.exchange(0); i > 0; --i) {
+      dispatch_semaphore_signal(queue_semaphore_);
+    }
+    slots_to_retire_.store(0);
     dispatch_release(queue_semaphore_);
     queue_semaphore_ = nullptr;
   }
@@ -125,7 +246,23 @@ void MacOSFileOperations::CleanupAsyncIO() {
   }
 }
 
-FileError MacOSFileOperations::OpenDevice(const std::string& path) {
+void MacOSFileOperations::ReleaseQueueSlot() {
+  int debt = slots_to_retire_.load();
+  while (debt > 0) {
+    if (slots_to_retire_.compare_exchange_weak(debt, debt - 1)) {
+      retired_slots_.fetch_add(1);
+      return;
+    }
+  }
+  dispatch_semaphore_signal(queue_semaphore_);
+}
+
+FileError MacOSFileOperations::OpenDevice(const std::string& requested_path) {
+  // Bulk writes and verify reads always go through the raw node
+  const std::string path = RawDevicePath(requested_path);
+  if (path != requested_path) {
+    Log("Using raw device " + path + " instead of " + requested_path);
+  }
   std::cout << "Opening macOS device: " << path << std::endl;
   
   bool isBlockDevice = IsBlockDevicePath(path);
@@ -191,6 +328,26 @@ FileError MacOSFileOperations::OpenDevice(const std::string& path) {
 #endif
     // macOS doesn't expose queue depth directly; leave suggested_queue_depth as 0
 
+    // Sector sizes, so buffers and reads can be sized in whole native units
+    {
+      std::uint32_t logicalBlock = 0;
+      if (ioctl(fd_, DKIOCGETBLOCKSIZE, &logicalBlock) == 0 && logicalBlock > 0)
+        device_io_limits_.io_alignment_bytes = logicalBlock;
+#ifdef DKIOCGETPHYSICALBLOCKSIZE
+      std::uint32_t physicalBlock = 0;
+      if (ioctl(fd_, DKIOCGETPHYSICALBLOCKSIZE, &physicalBlock) == 0 && physicalBlock > 0)
+        device_io_limits_.physical_sector_bytes = physicalBlock;
+#endif
+    }
+
+    // Raw nodes reject transfers that are not whole sectors
+    struct stat st;
+    std::uint32_t sectorSize = 0;
+    if (fstat(fd_, &st) == 0 && S_ISCHR(st.st_mode) &&
+        ioctl(fd_, DKIOCGETBLOCKSIZE, &sectorSize) == 0 && sectorSize > 0) {
+      raw_block_size_ = sectorSize;
+    }
+
     std::cout << "Successfully opened device with authorization, fd=" << fd_
               << (using_direct_io_ ? " (direct I/O enabled)" : " (buffered I/O)") << std::endl;
     return FileError::kSuccess;
@@ -228,6 +385,10 @@ FileError MacOSFileOperations::WriteAtOffset(
     return FileError::kOpenError;
   }
 
+  if (!IsRawAligned(offset, size)) {
+    return UnalignedWriteAt(offset, data, size);
+  }
+
   if (lseek(fd_, static_cast<off_t>(offset), SEEK_SET) == -1) {
     std::cout << "WriteAtOffset: lseek failed, offset=" << offset << ", errno=" << errno << std::endl;
     return FileError::kSeekError;
@@ -303,6 +464,7 @@ FileError MacOSFileOperations::Close() {
   }
   current_path_.clear();
   using_direct_io_ = false;
+  raw_block_size_ = 0;
   async_write_offset_ = 0;
   return FileError::kSuccess;
 }
@@ -334,6 +496,19 @@ FileError MacOSFileOperations::WriteSequential(const std::uint8_t* data, std::si
     return FileError::kOpenError;
   }
 
+  if (raw_block_size_ != 0) {
+    off_t pos = lseek(fd_, 0, SEEK_CUR);
+    if (pos >= 0 && !IsRawAligned(static_cast<std::uint64_t>(pos), size)) {
+      FileError result = UnalignedWriteAt(static_cast<std::uint64_t>(pos), data, size);
+      if (result != FileError::kSuccess) {
+        return result;
+      }
+      lseek(fd_, pos + static_cast<off_t>(size), SEEK_SET);
+      async_write_offset_ += size;
+      return FileError::kSuccess;
+    }
+  }
+
   std::size_t bytes_written = 0;
   while (bytes_written < size) {
     ssize_t result = write(fd_, data + bytes_written, size - bytes_written);
@@ -363,6 +538,17 @@ FileError MacOSFileOperations::ReadSequential(std::uint8_t* data, std::size_t si
     return FileError::kOpenError;
   }
 
+  if (raw_block_size_ != 0) {
+    off_t pos = lseek(fd_, 0, SEEK_CUR);
+    if (pos >= 0 && !IsRawAligned(static_cast<std::uint64_t>(pos), size)) {
+      FileError result = UnalignedReadAt(static_cast<std::uint64_t>(pos), data, size, bytes_read);
+      if (result == FileError::kSuccess) {
+        lseek(fd_, pos + static_cast<off_t>(bytes_read), SEEK_SET);
+      }
+      return result;
+    }
+  }
+
   ssize_t result = read(fd_, data, size);
   if (result < 0) {
     bytes_read = 0;
@@ -373,6 +559,37 @@ FileError MacOSFileOperations::ReadSequential(std::uint8_t* data, std::size_t si
   return FileError::kSuccess;
 }
 
+FileError MacOSFileOperations::ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                                            std::size_t size, std::size_t& bytes_read) {
+  bytes_read = 0;
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+
+  if (!IsRawAligned(offset, size)) {
+    return UnalignedReadAt(offset, data, size, bytes_read);
+  }
+
+  // pread() leaves the file offset alone, so this does not disturb
+  // concurrent sequential writes on the same descriptor
+  while (bytes_read < size) {
+    ssize_t result = pread(fd_, data + bytes_read, size - bytes_read,
+                           static_cast<off_t>(offset + bytes_read));
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return FileError::kReadError;
+    }
+    if (result == 0) {
+      break;  // End of device
+    }
+    bytes_read += static_cast<std::size_t>(result);
+  }
+
+  return FileError::kSuccess;
+}
+
 FileError MacOSFileOperations::Seek(std::uint64_t position) {
   if (!IsOpen()) {
     return FileError::kOpenError;
@@ -467,6 +684,43 @@ void MacOSFileOperations::PrepareForSequentialRead(std::uint64_t offset, std::ui
   }
 }
 
+FileError MacOSFileOperations::EraseDevice() {
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+
+#ifdef DKIOCUNMAP
+  std::uint64_t size = 0;
+  FileError result = GetSize(size);
+  if (result != FileError::kSuccess) {
+    return result;
+  }
+  if (size == 0) {
+    return FileError::kWriteError;
+  }
+
+  // Unmap must not race queued writes to the same blocks
+  WaitForPendingWrites();
+
+  dk_extent_t extent = {};
+  extent.offset = 0;
+  extent.length = size;
+  dk_unmap_t unmap = {};
+  unmap.extents = &extent;
+  unmap.extentsCount = 1;
+  if (ioctl(fd_, DKIOCUNMAP, &unmap) == -1) {
+    last_error_code_ = errno;
+    std::ostringstream oss;
+    oss << "Erase (DKIOCUNMAP) of " << size << " bytes failed, errno: " << errno;
+    Log(oss.str());
+    return FileError::kWriteError;
+  }
+  return FileError::kSuccess;
+#else
+  return FileError::kWriteError;
+#endif
+}
+
 int MacOSFileOperations::GetHandle() const {
   return fd_;
 }
@@ -517,6 +771,20 @@ FileError MacOSFileOperations::AsyncWriteSequential(const std::uint8_t* data, st
     if (callback) callback(result, result == FileError::kSuccess ? size : 0);
     return result;
   }
+
+  // A partial sector on a raw device needs a read-modify-write, which must
+  // not overlap in-flight writes to the same sector
+  if (!IsRawAligned(async_write_offset_, size)) {
+    FileError result = WaitForPendingWrites();
+    if (result == FileError::kSuccess) {
+      result = UnalignedWriteAt(async_write_offset_, data, size);
+    }
+    if (result == FileError::kSuccess) {
+      async_write_offset_ += size;
+    }
+    if (callback) callback(result, result == FileError::kSuccess ? size : 0);
+    return result;
+  }
   
   // Wait for a slot in the queue (checking for cancellation)
   // Note: Stall detection is handled by WriteProgressWatchdog at the ImageWriter level.
@@ -532,14 +800,14 @@ FileError MacOSFileOperations::AsyncWriteSequential(const std::uint8_t* data, st
   
   // Check for cancellation after acquiring slot
   if (cancelled_.load()) {
-    dispatch_semaphore_signal(queue_semaphore_);
+    ReleaseQueueSlot();
     if (callback) callback(FileError::kCancelled, 0);
     return FileError::kCancelled;
   }
   
   // Check for previous errors
   if (first_async_error_.load() != FileError::kSuccess) {
-    dispatch_semaphore_signal(queue_semaphore_);
+    ReleaseQueueSlot();
     if (callback) callback(first_async_error_.load(), 0);
     return first_async_error_.load();
   }
@@ -560,9 +828,10 @@ FileError MacOSFileOperations::AsyncWriteSequential(const std::uint8_t* data, st
   }
   
   pending_writes_.fetch_add(1);
+  RPI_TRACE3(io_write_submit, write_id, write_offset, size);
   
-  // Queue the async write using GCD
-  // Note: We use pwrite to write at a specific offset, allowing concurrent writes
+  // Queue the async write using GCD. Up to async_queue_depth_ of these run
+  // at once and may complete in any order; each pwrite() has its own offset.
   // Capture stats pointer for block - the base class's write_latency_stats_ is thread-safe
   rpi_imager::WriteLatencyStats* stats = &write_latency_stats_;
   dispatch_async(async_queue_, ^{
@@ -570,6 +839,8 @@ FileError MacOSFileOperations::AsyncWriteSequential(const std::uint8_t* data, st
     
     // Record completion latency (thread-safe via atomic operations)
     stats->recordCompletion(submit_time);
+    RPI_TRACE3(io_write_complete, write_id, written,
+               std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - submit_time).count());
     
     FileError result = FileError::kSuccess;
     if (written < 0 || static_cast<size_t>(written) != size) {
@@ -586,7 +857,7 @@ FileError MacOSFileOperations::AsyncWriteSequential(const std::uint8_t* data, st
     }
     
     // Free a slot in the queue for more writes
-    dispatch_semaphore_signal(queue_semaphore_);
+    ReleaseQueueSlot();
     
     // Notify caller if callback provided - BEFORE decrementing pending count
     // This ensures WaitForPendingWrites() blocks until callbacks complete
@@ -608,6 +879,75 @@ FileError MacOSFileOperations::AsyncWriteSequential(const std::uint8_t* data, st
   return FileError::kSuccess;
 }
 
+FileError MacOSFileOperations::AsyncReadSequential(std::uint8_t* data, std::size_t size,
+                                                    AsyncReadCallback callback) {
+  if (fd_ < 0) {
+    if (callback) callback(FileError::kOpenError, 0);
+    return FileError::kOpenError;
+  }
+
+  if (cancelled_.load()) {
+    if (callback) callback(FileError::kCancelled, 0);
+    return FileError::kCancelled;
+  }
+
+  // The descriptor's offset is the sequential read position, as for
+  // ReadSequential(). Advance it now so the next read queues behind this one.
+  off_t end = lseek(fd_, static_cast<off_t>(size), SEEK_CUR);
+  if (end == -1) {
+    if (callback) callback(FileError::kSeekError, 0);
+    return FileError::kSeekError;
+  }
+  std::uint64_t read_offset = static_cast<std::uint64_t>(end) - size;
+
+  // Reads have their own queue, so they overlap whatever the write queue
+  // depth was. The caller bounds how many are in flight.
+  if (read_queue_ == nullptr) {
+    dispatch_queue_attr_t attr = dispatch_queue_attr_make_with_qos_class(
+        DISPATCH_QUEUE_CONCURRENT, QOS_CLASS_USER_INITIATED, 0);
+    read_queue_ = dispatch_queue_create("com.raspberrypi.imager.asyncread", attr);
+  }
+
+  pending_reads_.fetch_add(1);
+  RPI_TRACE3(io_read_submit, read_offset, read_offset, size);
+  dispatch_async(read_queue_, ^{
+    // ReadAtOffset() takes care of partial sectors on raw devices
+    std::size_t bytes_read = 0;
+    FileError result = ReadAtOffset(read_offset, data, size, bytes_read);
+    RPI_TRACE2(io_read_complete, read_offset,
+               result == FileError::kSuccess ? static_cast<std::int64_t>(bytes_read) : -1);
+
+    if (callback) {
+      callback(result, bytes_read);
+    }
+
+    // As for writes: decrement only after the callback has run
+    pending_reads_.fetch_sub(1);
+    {
+      std::lock_guard<std::mutex> lock(completion_mutex_);
+      completion_cv_.notify_all();
+    }
+  });
+
+  return FileError::kSuccess;
+}
+
+FileError MacOSFileOperations::WaitForPendingReads(int max_pending) {
+  if (max_pending < 0) max_pending = 0;
+
+  // pread() cannot be cancelled, so draining after cancellation waits for
+  // the reads already running; they are bounded by the caller's pool
+  std::unique_lock<std::mutex> lock(completion_mutex_);
+  while (pending_reads_.load() > max_pending) {
+    if (cancelled_.load() && max_pending > 0) {
+      return FileError::kCancelled;
+    }
+    completion_cv_.wait_for(lock, std::chrono::milliseconds(100));
+  }
+
+  return cancelled_.load() ? FileError::kCancelled : FileError::kSuccess;
+}
+
 void MacOSFileOperations::PollAsyncCompletions() {
   // On macOS, dispatch queues handle completions automatically on background threads.
   // Callbacks are invoked asynchronously, so no explicit polling is needed.
@@ -862,11 +1202,69 @@ void MacOSFileOperations::ReduceQueueDepthForRecovery(int newDepth) {
   newDepth = std::max(newDepth, TimeoutDefaults::kMinAsyncQueueDepth);
   
   async_queue_depth_ = newDepth;
+
+  // Writes run concurrently, so the semaphore has to shrink too. Slots are
+  // retired as in-flight writes complete rather than waited for here.
+  if (queue_semaphore_ != nullptr) {
+    slots_to_retire_.fetch_add(oldDepth - newDepth);
+  }
   
   Log("Queue depth reduced for recovery: " + std::to_string(oldDepth) + " -> " + std::to_string(newDepth) +
       " (pending: " + std::to_string(pending_writes_.load()) + ")");
 }
 
+bool MacOSFileOperations::ResumeAsyncAfterSyncFallback(int depth) {
+  // After AttemptSyncFallback() cancelled writes, the queue is not reusable
+  if (!sync_fallback_mode_ || async_queue_ == nullptr || cancelled_.load() || depth <= 1 ||
+      pending_writes_.load() > 0 || first_async_error_.load() != FileError::kSuccess) {
+    return false;
+  }
+
+  // Sync writes kept async_write_offset_ up to date, so queueing carries on
+  // from there. The semaphore still has the slots of the depth at the time
+  // of the drain; bring it to the new depth the usual way.
+  sync_fallback_mode_ = false;
+  if (depth < async_queue_depth_) {
+    ReduceQueueDepthForRecovery(depth);
+  } else {
+    RestoreQueueDepthAfterRecovery(depth);
+  }
+
+  Log("Resumed async writes after sync fallback at queue depth " + std::to_string(depth));
+  return true;
+}
+
+void MacOSFileOperations::RestoreQueueDepthAfterRecovery(int newDepth) {
+  int oldDepth = async_queue_depth_;
+  if (newDepth <= oldDepth || sync_fallback_mode_) {
+    return;
+  }
+
+  async_queue_depth_ = newDepth;
+
+  // Cancel reductions not yet taken out of the semaphore first, then give
+  // retired slots back. Neither goes above the depth it was created with.
+  if (queue_semaphore_ != nullptr) {
+    for (int i = oldDepth; i < newDepth; ++i) {
+      int debt = slots_to_retire_.load();
+      bool cancelled = false;
+      while (debt > 0 && !cancelled) {
+        cancelled = slots_to_retire_.compare_exchange_weak(debt, debt - 1);
+      }
+      if (cancelled) {
+        continue;
+      }
+      int retired = retired_slots_.load();
+      while (retired > 0 && !retired_slots_.compare_exchange_weak(retired, retired - 1)) {}
+      if (retired > 0) {
+        dispatch_semaphore_signal(queue_semaphore_);
+      }
+    }
+  }
+
+  Log("Queue depth restored after recovery: " + std::to_string(oldDepth) + " -> " + std::to_string(newDepth));
+}
+
 // GetAsyncIOStats() inherited from FileOperations base class
 
 // macOS requires authorization to open block devices, so pre-open queries are not practical.
@@ -42,6 +42,8 @@ class MacOSFileOperations : public FileOperations {
   // Streaming I/O operations
   FileError WriteSequential(const std::uint8_t* data, std::size_t size) override;
   FileError ReadSequential(std::uint8_t* data, std::size_t size, std::size_t& bytes_read) override;
+  FileError ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                         std::size_t size, std::size_t& bytes_read) override;
   
   // File positioning
   FileError Seek(std::uint64_t position) override;
@@ -53,6 +55,9 @@ class MacOSFileOperations : public FileOperations {
   
   // Sequential read optimization
   void PrepareForSequentialRead(std::uint64_t offset, std::uint64_t length) override;
+
+  // Whole-device erase (DKIOCUNMAP)
+  FileError EraseDevice() override;
   
   // Handle access
   int GetHandle() const override;
@@ -75,18 +80,24 @@ class MacOSFileOperations : public FileOperations {
     return info;
   }
   
-  // ============= Async I/O API (macOS: using GCD dispatch_io) =============
+  // ============= Async I/O API (macOS: pwrite on a concurrent GCD queue) =============
   bool SetAsyncQueueDepth(int depth) override;
   int GetAsyncQueueDepth() const override { return async_queue_depth_; }
   bool IsAsyncIOSupported() const override { return true; }
   FileError AsyncWriteSequential(const std::uint8_t* data, std::size_t size, 
                                   AsyncWriteCallback callback = nullptr) override;
   int GetPendingWriteCount() const override { return pending_writes_.load(); }
+  FileError AsyncReadSequential(std::uint8_t* data, std::size_t size,
+                                AsyncReadCallback callback = nullptr) override;
+  FileError WaitForPendingReads(int max_pending = 0) override;
+  int GetPendingReadCount() const override { return pending_reads_.load(); }
   void PollAsyncCompletions() override;
   FileError WaitForPendingWrites() override;
   void CancelAsyncIO() override;
   std::vector<PendingWriteInfo> GetPendingWritesSorted() const override;
   void ReduceQueueDepthForRecovery(int newDepth) override;
+  void RestoreQueueDepthAfterRecovery(int newDepth) override;
+  bool ResumeAsyncAfterSyncFallback(int depth) override;
   // GetAsyncIOStats() inherited from FileOperations base class
 
  private:
@@ -94,16 +105,21 @@ class MacOSFileOperations : public FileOperations {
   std::string current_path_;
   int last_error_code_;
   bool using_direct_io_;  // Track if we're using F_NOCACHE
+  std::uint32_t raw_block_size_;  // Sector size when fd_ is a raw (character) device, else 0
   
   // Async I/O state
   int async_queue_depth_;
   std::atomic<int> pending_writes_;
   std::atomic<bool> cancelled_;
   std::atomic<FileError> first_async_error_;
-  dispatch_queue_t async_queue_;
-  dispatch_semaphore_t queue_semaphore_;  // Limits in-flight writes
+  dispatch_queue_t async_queue_;          // Concurrent: one pwrite() per in-flight write
+  dispatch_semaphore_t queue_semaphore_;  // Limits in-flight writes to async_queue_depth_
+  std::atomic<int> slots_to_retire_;      // Recovery reduction still to take out of the semaphore
+  std::atomic<int> retired_slots_;        // Taken out; given back before the semaphore is released
   std::mutex completion_mutex_;
   std::condition_variable completion_cv_;
+  dispatch_queue_t read_queue_;           // Concurrent: one pread() per in-flight async read
+  std::atomic<int> pending_reads_;
   std::uint64_t async_write_offset_;  // Current write position for async
   
   // Tracking for sync fallback: map write_id -> pending write info
@@ -122,6 +138,15 @@ class MacOSFileOperations : public FileOperations {
   
   // Helper to determine if path is a block device
   static bool IsBlockDevicePath(const std::string& path);
+
+  // /dev/diskN[sM] -> /dev/rdiskN[sM]; other paths are returned unchanged
+  static std::string RawDevicePath(const std::string& path);
+
+  // Raw devices only accept whole sectors; these go through a sector-aligned
+  // bounce buffer, reading back partial head/tail sectors for writes
+  bool IsRawAligned(std::uint64_t offset, std::size_t size) const;
+  FileError UnalignedWriteAt(std::uint64_t offset, const std::uint8_t* data, std::size_t size);
+  FileError UnalignedReadAt(std::uint64_t offset, std::uint8_t* data, std::size_t size, std::size_t& bytes_read);
   
   // Enable direct I/O mode using F_NOCACHE
   bool EnableDirectIO();
@@ -131,6 +156,9 @@ class MacOSFileOperations : public FileOperations {
   
   // Cleanup async I/O resources
   void CleanupAsyncIO();
+
+  // Return a write slot to the semaphore, or retire it after a queue depth reduction
+  void ReleaseQueueSlot();
   
   // Attempt sync fallback when async I/O stalls
   FileError AttemptSyncFallback() override;
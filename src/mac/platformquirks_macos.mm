@@ -448,6 +448,16 @@ DiskResult ejectDisk(const QString& device) {
     return runDiskOperation(bsdNameBytes.constData(), ejectUnmountCallback);
 }
 
+QString holdDevicePowerOn(const QString& device) {
+    // USB devices with an open client are not suspended on macOS
+    Q_UNUSED(device);
+    return {};
+}
+
+void releaseDevicePower(const QString& device) {
+    Q_UNUSED(device);
+}
+
 qreal detectTextScaleFactor()
 {
     // macOS handles DPI scaling correctly via Retina support.
@@ -12,14 +12,19 @@
 #include <QLocale>
 #include <QSettings>
 #include <QCommandLineParser>
+#include <QThreadPool>
 #ifdef Q_OS_UNIX
 #include <unistd.h>
 #endif
 #include "cli.h"
 #include "curlnetworkconfig.h"
+#include "startupprofile.h"
+#include "containerlimits.h"
+#include "tracepoints.h"
 
 #ifndef CLI_ONLY_BUILD
 #include "iconmultifetcher.h"
+#include "curlfetcher.h"
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
@@ -27,6 +32,7 @@
 #include "imagewriter.h"
 #include "networkaccessmanagerfactory.h"
 #include "nativefiledialog.h"
+#include "appfonts.h"
 #include <QQuickWindow>
 #include <QScreen>
 #include <QFont>
@@ -34,8 +40,14 @@
 #include <QSessionManager>
 #include <QFileOpenEvent>
 #include <QtMath>
+#include <QJsonDocument>
+#include <QTimer>
+#include <memory>
 #endif
 #include "platformquirks.h"
+#ifdef Q_OS_LINUX
+#include "linux/devicehelper.h"
+#endif
 #ifdef Q_OS_DARWIN
 #include <CoreFoundation/CoreFoundation.h>
 #include <CoreServices/CoreServices.h>
@@ -109,8 +121,77 @@ static constexpr quint16 kPort =
 #endif
 
 
+#ifndef CLI_ONLY_BUILD
+/* Follow the window until the OS list is on screen, then add the startup
+ * phases to the performance data and, with --startup-profile, write the
+ * JSON report */
+static void traceStartupUntilInteractive(QQuickWindow *window, ImageWriter *imageWriter,
+                                         const QString &reportPath, qint64 budgetMs)
+{
+    // Offline, the OS list never comes; report what there is after this long
+    constexpr int kGiveUpMs = 60 * 1000;
+    auto finished = std::make_shared<bool>(false);
+    auto frames = std::make_shared<QMetaObject::Connection>();
+
+    auto finish = [=](bool complete) {
+        if (*finished)
+            return;
+        *finished = true;
+        QObject::disconnect(*frames);
+
+        StartupProfile &profile = StartupProfile::instance();
+        if (!complete)
+            profile.milestone("gave_up_waiting_for_os_list");
+        for (const StartupProfile::Phase &phase : profile.phases())
+        {
+            imageWriter->performanceStats()->recordEvent(PerformanceStats::EventType::StartupPhase,
+                static_cast<uint32_t>(phase.endMs - phase.startMs), true,
+                QString("phase: %1; start_ms: %2").arg(phase.name).arg(phase.startMs));
+        }
+
+        const QJsonObject report = profile.report(budgetMs);
+        qDebug() << "Startup took" << report["totalMs"].toInteger() << "ms to" << profile.phases().last().name;
+        if (budgetMs > 0 && !report["withinBudget"].toBool())
+            qWarning() << "Startup exceeded its budget of" << budgetMs << "ms";
+        if (reportPath.isEmpty())
+            return;
+
+        const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+        if (reportPath == "-")
+        {
+            fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+            fflush(stdout);
+            return;
+        }
+        QFile f(reportPath);
+        if (f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            f.write(json);
+        else
+            qWarning() << "Cannot write startup profile to" << reportPath << f.errorString();
+    };
+
+    QObject::connect(imageWriter, &ImageWriter::osListPrepared, window, []() {
+        StartupProfile::instance().milestone("os_list_ready");
+    });
+    *frames = QObject::connect(window, &QQuickWindow::frameSwapped, window, [=]() {
+        StartupProfile &profile = StartupProfile::instance();
+        profile.mark("first_frame");
+        // The first frame drawn once the list is there shows it
+        if (profile.isMarked("os_list_ready"))
+        {
+            profile.mark("os_list_first_paint");
+            finish(true);
+        }
+    });
+    QTimer::singleShot(kGiveUpMs, window, [=]() { finish(false); });
+}
+#endif
+
 int main(int argc, char *argv[])
 {
+    StartupProfile::instance().start();
+    rpi_imager::TraceProviderScope traceProvider;
+
     // Parse --log-file early, before Qt initialization
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
@@ -161,12 +242,40 @@ int main(int argc, char *argv[])
         }
     }
 
+#ifdef Q_OS_LINUX
+    // Handle --device-helper before Qt initialization
+    // Called via pkexec by an --unprivileged-gui instance (runs as root)
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--device-helper") == 0) {
+            int status = rpi_imager::DeviceHelper::Serve(STDIN_FILENO, [](const std::string& device) {
+                return static_cast<int>(PlatformQuirks::unmountDisk(QString::fromStdString(device)));
+            });
+            if (g_logFile) fclose(g_logFile);
+            return status;
+        }
+    }
+#endif
+
     // Attempt automatic elevation if running from an elevatable bundle without privileges
     // This happens BEFORE Qt initialization to avoid overhead
     // If elevation succeeds, this process is replaced; if it fails, we continue
     if (PlatformQuirks::isElevatableBundle() && !PlatformQuirks::hasElevatedPrivileges()) {
+        bool helperStarted = false;
+#ifdef Q_OS_LINUX
+        // --unprivileged-gui elevates only a helper that opens and unmounts
+        // devices for the GUI, which keeps running as the user
+        bool unprivilegedGui = false;
+        bool cliMode = false;
+        for (int i = 1; i < argc; i++) {
+            unprivilegedGui |= strcmp(argv[i], "--unprivileged-gui") == 0;
+            cliMode |= strcmp(argv[i], "--cli") == 0;
+        }
+        if (unprivilegedGui && !cliMode && PlatformQuirks::hasElevationPolicyInstalled())
+            helperStarted = rpi_imager::DeviceHelper::Start(PlatformQuirks::getBundlePath());
+#endif
         // Try to elevate - this will only work if an elevation policy is installed
-        PlatformQuirks::tryElevate(argc, argv);
+        if (!helperStarted)
+            PlatformQuirks::tryElevate(argc, argv);
         // If we get here, elevation failed or wasn't possible
         // Continue running without elevation - the UI will show a warning
     }
@@ -175,6 +284,10 @@ int main(int argc, char *argv[])
     // This must happen before any Qt initialization (QCoreApplication/QGuiApplication)
     PlatformQuirks::applyQuirks();
 
+    // Qt sizes its global thread pool to the host's cores, which a
+    // container's CPU quota may not let the process use
+    QThreadPool::globalInstance()->setMaxThreadCount(ContainerLimits::cpuCount());
+
 #ifdef CLI_ONLY_BUILD
     /* Force CLI mode for CLI-only builds */
     CurlNetworkConfig::ensureInitialized();
@@ -222,6 +335,7 @@ int main(int argc, char *argv[])
     // by reading DRM EDID data and setting QT_SCALE_FACTOR before launching
 
     QGuiApplication app(argc, argv);
+    StartupProfile::instance().mark("qt_application");
 
     app.setOrganizationName("Raspberry Pi");
     app.setOrganizationDomain("raspberrypi.com");
@@ -256,7 +370,11 @@ int main(int argc, char *argv[])
     // Early check for elevated privileges on platforms that require them (Linux/Windows)
     bool hasPermissionIssue = false;
 #if defined(Q_OS_LINUX) || defined(Q_OS_WIN)
-    if (!PlatformQuirks::hasElevatedPrivileges())
+    bool deviceAccess = PlatformQuirks::hasElevatedPrivileges();
+#ifdef Q_OS_LINUX
+    deviceAccess |= rpi_imager::DeviceHelper::IsRunning();
+#endif
+    if (!deviceAccess)
     {
         hasPermissionIssue = true;
         qWarning() << "Not running with elevated privileges - device access may fail";
@@ -276,6 +394,7 @@ int main(int argc, char *argv[])
 
     // Create ImageWriter early to check embedded mode
     ImageWriter imageWriter;
+    StartupProfile::instance().mark("image_writer");
 
 #ifdef Q_OS_DARWIN
     // Ensure our app is the default handler for rpi-imager:// scheme so Safari recognizes it
@@ -290,21 +409,17 @@ int main(int argc, char *argv[])
         }
     }
 #endif
+    AppFonts::registerBundled();
 #ifdef Q_OS_LINUX
     if (imageWriter.isEmbeddedMode()) {
         // Font and locale setup only needed for embedded Linux systems
         // Desktop systems have proper font fallbacks already configured
 
-        /* Set default font - load embedded Roboto font */
-        QStringList fontList = QFontDatabase::applicationFontFamilies(QFontDatabase::addApplicationFont(":/fonts/Roboto-Regular.ttf"));
-        if (!fontList.isEmpty()) {
-            QGuiApplication::setFont(QFont(fontList.first(), 10));
-        }
+        /* Set default font - the embedded Roboto font */
+        QGuiApplication::setFont(QFont(AppFonts::regular(), 10));
 
-        /* Add system fallback font if available (common on Linux systems) */
-        if (QFile::exists("/usr/share/fonts/truetype/droid/DroidSansFallback.ttf")) {
-            QFontDatabase::addApplicationFont("/usr/share/fonts/truetype/droid/DroidSansFallback.ttf");
-        }
+        /* The CJK fallback font is registered once a translation or the OS
+         * list needs it (see ImageWriter::replaceTranslator()) */
 
         /* Set default locale for embedded systems that might not have proper locale detection */
         QLocale::Language l = QLocale::system().language();
@@ -315,6 +430,7 @@ int main(int argc, char *argv[])
         qDebug() << "Embedded mode detected. System locale:" << QLocale::system().name();
     }
 #endif
+    StartupProfile::instance().mark("fonts");
     NetworkAccessManagerFactory namf;
     QQmlApplicationEngine engine;
     QString customQm;
@@ -343,7 +459,14 @@ int main(int argc, char *argv[])
         {"disable-telemetry", "Disable telemetry (persist setting)"},
         {"enable-telemetry", "Use default telemetry setting (clear override)"},
         {"qml-file-dialogs", "Force use of QML file dialogs instead of native dialogs"},
-        {"enable-secure-boot", "Force enable secure boot customization step regardless of OS capabilities"}
+        {"enable-secure-boot", "Force enable secure boot customization step regardless of OS capabilities"},
+#ifdef Q_OS_LINUX
+        {"unprivileged-gui", "Run the GUI as the current user, with a privileged helper opening devices"},
+#endif
+        {"startup-profile", "When the OS list is first shown, write the time each startup phase took "
+                            "as JSON to file (- for stdout)", "file", ""},
+        {"startup-budget", "With --startup-profile, the milliseconds startup should take; "
+                           "the report says whether it did", "ms", ""}
     });
 
     // Accept rpi-imager:// callback URLs as positional argument (used by callback relay on Windows)
@@ -442,6 +565,18 @@ int main(int argc, char *argv[])
         ImageWriter::setForceSecureBootEnabled(true);
     }
 
+    qint64 startupBudgetMs = 0;
+    if (parser.isSet("startup-budget"))
+    {
+        bool ok = false;
+        startupBudgetMs = parser.value("startup-budget").toLongLong(&ok);
+        if (!ok || startupBudgetMs <= 0)
+        {
+            cerr << "Invalid value for --startup-budget" << endl;
+            return 1;
+        }
+    }
+
     // Accept rpi-imager:// callback URLs or manifest files (.rpi-imager-manifest, .json) as positional argument
     // Image files/URLs should be passed via --cli mode, not the desktop GUI
     const QStringList posArgs = parser.positionalArguments();
@@ -564,6 +699,8 @@ int main(int argc, char *argv[])
     }
 #endif
 
+    StartupProfile::instance().mark("arguments");
+
     QTranslator *translator = new QTranslator;
     if (customQm.isEmpty())
     {
@@ -614,6 +751,7 @@ int main(int argc, char *argv[])
         else
             delete translator;
     }
+    StartupProfile::instance().mark("translator");
 
     if (cliRefreshInterval >= 0 || cliRefreshJitter >= 0)
     {
@@ -669,11 +807,10 @@ int main(int argc, char *argv[])
 
     if (engine.rootObjects().isEmpty())
         return -1;
+    StartupProfile::instance().mark("qml_load");
 
     QObject *qmlwindow = engine.rootObjects().value(0);
-    qmlwindow->connect(&imageWriter, SIGNAL(downloadProgress(QVariant,QVariant)), qmlwindow, SLOT(onDownloadProgress(QVariant,QVariant)));
-    qmlwindow->connect(&imageWriter, SIGNAL(writeProgress(QVariant,QVariant)), qmlwindow, SLOT(onWriteProgress(QVariant,QVariant)));
-    qmlwindow->connect(&imageWriter, SIGNAL(verifyProgress(QVariant,QVariant)), qmlwindow, SLOT(onVerifyProgress(QVariant,QVariant)));
+    // Write progress reaches QML as the imageWriter.progress property
     qmlwindow->connect(&imageWriter, SIGNAL(preparationStatusUpdate(QVariant)), qmlwindow, SLOT(onPreparationStatusUpdate(QVariant)));
     qmlwindow->connect(&imageWriter, SIGNAL(error(QVariant)), qmlwindow, SLOT(onError(QVariant)));
     qmlwindow->connect(&imageWriter, SIGNAL(finalizing()), qmlwindow, SLOT(onFinalizing()));
@@ -742,6 +879,11 @@ int main(int argc, char *argv[])
 
     qmlwindow->setProperty("x", x);
     qmlwindow->setProperty("y", y);
+    StartupProfile::instance().mark("window_setup");
+    if (auto *quickWindow = qobject_cast<QQuickWindow *>(qmlwindow))
+    {
+        traceStartupUntilInteractive(quickWindow, &imageWriter, parser.value("startup-profile"), startupBudgetMs);
+    }
 
     // Defer OS list fetch to after event loop starts to avoid blocking first draw
     // The network connectivity check can be slow (DNS lookups, interface enumeration)
@@ -806,6 +948,7 @@ int main(int argc, char *argv[])
 
     // Shutdown curl_multi icon fetcher before exiting
     IconMultiFetcher::instance().shutdown();
+    CurlFetcher::shutdown();
 
     return rc;
 #endif /* !CLI_ONLY_BUILD */
@@ -93,8 +93,9 @@ ApplicationWindow {
         context: Qt.ApplicationShortcut
         onActivated: {
             console.log("Opening debug options dialog...")
-            debugOptionsDialog.initialize()
-            debugOptionsDialog.open()
+            debugOptionsLoader.active = true
+            debugOptionsLoader.item.initialize()
+            debugOptionsLoader.item.open()
         }
     }
 
@@ -108,11 +109,16 @@ ApplicationWindow {
             id: wizardContainer
             anchors.fill: parent
             imageWriter: window.imageWriter
-            optionsPopup: appOptionsDialog
             overlayRootRef: overlayRoot
             // Show Language step if C++ requested it
             showLanguageSelection: window.showLanguageSelection
 
+            onOptionsRequested: {
+                appOptionsLoader.active = true
+                appOptionsLoader.item.initialize()
+                appOptionsLoader.item.open()
+            }
+
             onWizardCompleted: {
                 // Reset to start of wizard or close application
                 wizardContainer.currentStep = 0;
@@ -490,18 +496,30 @@ ApplicationWindow {
         }
     }
 
-    AppOptionsDialog {
-        id: appOptionsDialog
-        parent: overlayRoot
-        imageWriter: window.imageWriter
-        wizardContainer: wizardContainer
+    // The options dialogs are large and most sessions never open them, so
+    // they are only created the first time they are opened
+    Loader {
+        id: appOptionsLoader
+        active: false
+        sourceComponent: Component {
+            AppOptionsDialog {
+                parent: overlayRoot
+                imageWriter: window.imageWriter
+                wizardContainer: wizardContainer
+            }
+        }
     }
 
-    DebugOptionsDialog {
-        id: debugOptionsDialog
-        parent: overlayRoot
-        imageWriter: window.imageWriter
-        wizardContainer: wizardContainer
+    Loader {
+        id: debugOptionsLoader
+        active: false
+        sourceComponent: Component {
+            DebugOptionsDialog {
+                parent: overlayRoot
+                imageWriter: window.imageWriter
+                wizardContainer: wizardContainer
+            }
+        }
     }
 
     // Removed embeddedFinishedPopup; handled by Wizard Done step
@@ -513,7 +531,7 @@ ApplicationWindow {
         anchors.centerIn: parent
         imageWriter: window.imageWriter
         dialogTitle: qsTr("Save Performance Data")
-        nameFilters: [qsTr("JSON files (*.json)"), qsTr("All files (*)")]
+        nameFilters: [qsTr("JSON files (*.json)"), qsTr("Chrome trace files (*.trace.json)"), qsTr("All files (*)")]
         
         onAccepted: {
             var filePath = String(selectedFile)
@@ -553,21 +571,6 @@ ApplicationWindow {
     }
 
     /* Slots for signals imagewrite emits */
-    function onDownloadProgress(now, total) {
-        // Forward to wizard container
-        wizardContainer.onDownloadProgress(now, total);
-    }
-
-    function onWriteProgress(now, total) {
-        // Forward to wizard container
-        wizardContainer.onWriteProgress(now, total);
-    }
-
-    function onVerifyProgress(now, total) {
-        // Forward to wizard container
-        wizardContainer.onVerifyProgress(now, total);
-    }
-
     function onPreparationStatusUpdate(msg) {
         // Forward to wizard container
         wizardContainer.onPreparationStatusUpdate(msg);
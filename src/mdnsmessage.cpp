@@ -0,0 +1,253 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "mdnsmessage.h"
+#include <QtEndian>
+
+namespace {
+
+constexpr quint16 kClassIn = 1;
+constexpr quint16 kFlagResponse = 0x8400;  // QR and AA
+constexpr int kHeaderSize = 12;
+
+void putU16(QByteArray &out, quint16 v)
+{
+    out.append(char(v >> 8));
+    out.append(char(v & 0xff));
+}
+
+void putU32(QByteArray &out, quint32 v)
+{
+    putU16(out, quint16(v >> 16));
+    putU16(out, quint16(v & 0xffff));
+}
+
+void putName(QByteArray &out, const QByteArray &name)
+{
+    for (const QByteArray &label : name.split('.'))
+    {
+        if (label.isEmpty())
+            continue;
+        const QByteArray l = label.left(63);
+        out.append(char(l.size()));
+        out.append(l);
+    }
+    out.append('\0');
+}
+
+QByteArray header(quint16 id, quint16 flags, int questions, int answers)
+{
+    QByteArray out;
+    putU16(out, id);
+    putU16(out, flags);
+    putU16(out, quint16(questions));
+    putU16(out, quint16(answers));
+    putU16(out, 0);
+    putU16(out, 0);
+    return out;
+}
+
+class Reader
+{
+public:
+    explicit Reader(const QByteArray &packet) : _p(packet) {}
+
+    bool u16(int &pos, quint16 &v) const
+    {
+        if (pos + 2 > _p.size())
+            return false;
+        v = qFromBigEndian<quint16>(_p.constData() + pos);
+        pos += 2;
+        return true;
+    }
+
+    bool u32(int &pos, quint32 &v) const
+    {
+        if (pos + 4 > _p.size())
+            return false;
+        v = qFromBigEndian<quint32>(_p.constData() + pos);
+        pos += 4;
+        return true;
+    }
+
+    // Follows compression pointers; pos ends up after the name as stored
+    bool name(int &pos, QByteArray &out) const
+    {
+        out.clear();
+        int p = pos;
+        bool jumped = false;
+        for (int hops = 0; hops < 64; hops++)
+        {
+            if (p >= _p.size())
+                return false;
+            const quint8 len = quint8(_p[p]);
+            if (len == 0)
+            {
+                if (!jumped)
+                    pos = p + 1;
+                return true;
+            }
+            if ((len & 0xc0) == 0xc0)
+            {
+                if (p + 2 > _p.size())
+                    return false;
+                if (!jumped)
+                    pos = p + 2;
+                jumped = true;
+                p = ((len & 0x3f) << 8) | quint8(_p[p + 1]);
+                continue;
+            }
+            if (len > 63 || p + 1 + len > _p.size())
+                return false;
+            if (!out.isEmpty())
+                out.append('.');
+            out.append(_p.constData() + p + 1, len);
+            p += 1 + len;
+        }
+        return false;  // Pointer loop
+    }
+
+private:
+    const QByteArray &_p;
+};
+
+} // namespace
+
+QHostAddress MdnsMessage::group()
+{
+    return QHostAddress(QStringLiteral("224.0.0.251"));
+}
+
+QByteArray MdnsMessage::query(const QByteArray &name, quint16 type, quint16 id)
+{
+    QByteArray out = header(id, 0, 1, 0);
+    putName(out, name);
+    putU16(out, type);
+    putU16(out, kClassIn);
+    return out;
+}
+
+QByteArray MdnsMessage::response(const QList<Record> &records, quint16 id)
+{
+    QByteArray out = header(id, kFlagResponse, 0, int(records.size()));
+    for (const Record &r : records)
+    {
+        QByteArray data;
+        switch (r.type)
+        {
+        case PTR:
+            putName(data, r.target);
+            break;
+        case SRV:
+            putU16(data, 0);  // Priority
+            putU16(data, 0);  // Weight
+            putU16(data, r.port);
+            putName(data, r.target);
+            break;
+        case TXT:
+            for (const QByteArray &t : r.text)
+            {
+                data.append(char(qMin(int(t.size()), 255)));
+                data.append(t.left(255));
+            }
+            if (data.isEmpty())
+                data.append('\0');
+            break;
+        case A:
+            putU32(data, r.address.toIPv4Address());
+            break;
+        default:
+            continue;
+        }
+
+        putName(out, r.name);
+        putU16(out, r.type);
+        putU16(out, kClassIn);
+        putU32(out, r.ttl);
+        putU16(out, quint16(data.size()));
+        out.append(data);
+    }
+    return out;
+}
+
+bool MdnsMessage::parse(const QByteArray &packet, Message &message)
+{
+    const Reader r(packet);
+    message = Message();
+    if (packet.size() < kHeaderSize)
+        return false;
+
+    int pos = 0;
+    quint16 flags, qdCount, anCount, nsCount, arCount;
+    r.u16(pos, message.id);
+    r.u16(pos, flags);
+    r.u16(pos, qdCount);
+    r.u16(pos, anCount);
+    r.u16(pos, nsCount);
+    r.u16(pos, arCount);
+    message.response = flags & 0x8000;
+
+    for (int i = 0; i < qdCount; i++)
+    {
+        QByteArray name;
+        quint16 type, cls;
+        if (!r.name(pos, name) || !r.u16(pos, type) || !r.u16(pos, cls))
+            return false;
+        message.questions.append(name);
+    }
+
+    const int recordCount = anCount + nsCount + arCount;
+    for (int i = 0; i < recordCount; i++)
+    {
+        Record rec;
+        quint16 cls, length;
+        if (!r.name(pos, rec.name) || !r.u16(pos, rec.type) || !r.u16(pos, cls) ||
+            !r.u32(pos, rec.ttl) || !r.u16(pos, length) || pos + length > packet.size())
+        {
+            return false;
+        }
+        const int end = pos + length;
+
+        bool ok = true;
+        switch (rec.type)
+        {
+        case PTR:
+            ok = r.name(pos, rec.target);
+            break;
+        case SRV: {
+            quint16 priority, weight;
+            ok = r.u16(pos, priority) && r.u16(pos, weight) && r.u16(pos, rec.port) && r.name(pos, rec.target);
+            break;
+        }
+        case TXT:
+            while (pos < end)
+            {
+                const int len = quint8(packet[pos++]);
+                if (pos + len > end)
+                    return false;
+                if (len)
+                    rec.text.append(packet.mid(pos, len));
+                pos += len;
+            }
+            break;
+        case A: {
+            quint32 v;
+            ok = length == 4 && r.u32(pos, v);
+            rec.address = QHostAddress(v);
+            break;
+        }
+        default:
+            break;
+        }
+        if (!ok || pos > end)
+            return false;
+        pos = end;
+
+        if (rec.type == PTR || rec.type == SRV || rec.type == TXT || rec.type == A)
+            message.records.append(rec);
+    }
+
+    return true;
+}
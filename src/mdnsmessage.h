@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef MDNSMESSAGE_H
+#define MDNSMESSAGE_H
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QList>
+
+/**
+ * @brief Just enough of the DNS wire format for DNS-SD over multicast DNS
+ *
+ * Covers the records a service announcement is made of (PTR, SRV, TXT
+ * and A). Names are written uncompressed; compressed names in received
+ * packets are followed.
+ */
+namespace MdnsMessage
+{
+    constexpr quint16 kPort = 5353;
+    QHostAddress group();  // 224.0.0.251
+
+    enum Type : quint16 {
+        A = 1,
+        PTR = 12,
+        TXT = 16,
+        SRV = 33
+    };
+
+    struct Record {
+        QByteArray name;  // Dotted, without the trailing dot
+        quint16 type = 0;
+        quint32 ttl = 120;
+        QByteArray target;     // PTR and SRV
+        quint16 port = 0;      // SRV
+        QHostAddress address;  // A
+        QList<QByteArray> text;  // TXT
+    };
+
+    struct Message {
+        quint16 id = 0;
+        bool response = false;
+        QList<QByteArray> questions;  // Names asked about (any type)
+        QList<Record> records;        // Answers and additional records
+    };
+
+    QByteArray query(const QByteArray &name, quint16 type, quint16 id = 0);
+    QByteArray response(const QList<Record> &records, quint16 id = 0);
+
+    /**
+     * @brief Decode a packet
+     * @return false if it is truncated or malformed. Records of other
+     * types are skipped.
+     */
+    bool parse(const QByteArray &packet, Message &message);
+}
+
+#endif // MDNSMESSAGE_H
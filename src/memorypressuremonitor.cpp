@@ -0,0 +1,365 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "memorypressuremonitor.h"
+#include "bufferpool.h"
+#include "systemmemorymanager.h"
+#include <QtGlobal>
+#include <QDebug>
+#include <QStringList>
+#include <chrono>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#elif defined(Q_OS_DARWIN)
+#include <dispatch/dispatch.h>
+#elif defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#endif
+
+using Level = MemoryPressurePolicy::Level;
+
+namespace {
+
+Level worse(Level a, Level b)
+{
+    return static_cast<int>(a) > static_cast<int>(b) ? a : b;
+}
+
+#ifdef Q_OS_LINUX
+constexpr const char *PSI_PATH = "/proc/pressure/memory";
+// Wake when tasks stall on memory for 150 ms in any 2 s window; 2 s is the
+// shortest window unprivileged processes may use
+constexpr const char *PSI_TRIGGER = "some 150000 2000000";
+
+std::string readFile(const std::string &path)
+{
+    std::ifstream in(path);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+std::string readFd(int fd)
+{
+    char buf[512];
+    const ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    return n > 0 ? std::string(buf, static_cast<size_t>(n)) : std::string();
+}
+
+// memory.events of the cgroup v2 the process runs in
+std::string cgroupEventsPath()
+{
+    std::ifstream in("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.rfind("0::", 0) == 0) {
+            return "/sys/fs/cgroup" + line.substr(3) + "/memory.events";
+        }
+    }
+    return std::string();
+}
+#endif
+
+} // namespace
+
+MemoryPressureMonitor& MemoryPressureMonitor::instance()
+{
+    static MemoryPressureMonitor instance;
+    return instance;
+}
+
+MemoryPressureMonitor::MemoryPressureMonitor()
+    : _scalePercent(100)
+    , _level(Level::Normal)
+    , _stopping(false)
+{
+    // Constructed first so they outlive the monitor thread
+    BufferPool::instance();
+    SystemMemoryManager::instance();
+
+    if (!_openSources()) {
+        qDebug() << "MemoryPressureMonitor: no memory pressure signals on this system";
+        return;
+    }
+    qDebug() << "MemoryPressureMonitor: watching" << _sources;
+    _thread = std::thread(&MemoryPressureMonitor::_run, this);
+}
+
+MemoryPressureMonitor::~MemoryPressureMonitor()
+{
+    stop();
+}
+
+QString MemoryPressureMonitor::sources() const
+{
+    return _sources;
+}
+
+void MemoryPressureMonitor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stopping) {
+            return;
+        }
+        _stopping = true;
+    }
+    _stopped.notify_all();
+#ifdef Q_OS_LINUX
+    if (_stopFd >= 0) {
+        const uint64_t one = 1;
+        (void)!write(_stopFd, &one, sizeof(one));
+    }
+#endif
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    _closeSources();
+}
+
+void MemoryPressureMonitor::_run()
+{
+    const auto start = std::chrono::steady_clock::now();
+    while (!_stopping) {
+        const Level level = _sample();
+        const int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        const int before = _policy.scalePercent();
+        if (_policy.onLevel(level, nowMs)) {
+            _scalePercent = _policy.scalePercent();
+            qDebug() << "MemoryPressureMonitor: pressure" << MemoryPressurePolicy::levelName(level)
+                     << "- buffers and caches at" << _policy.scalePercent() << "% of normal";
+            // Buffers kept for reuse are the first thing to give back
+            if (_policy.scalePercent() < before) {
+                BufferPool::instance().trim();
+            }
+        }
+        _level = level;
+
+        _waitForSignal();
+    }
+}
+
+#ifdef Q_OS_LINUX
+
+bool MemoryPressureMonitor::_openSources()
+{
+    QStringList sources;
+
+    if (!readFile(PSI_PATH).empty()) {
+        sources << QStringLiteral("PSI");
+        _psiFd = open(PSI_PATH, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (_psiFd >= 0 && write(_psiFd, PSI_TRIGGER, strlen(PSI_TRIGGER) + 1) < 0) {
+            // Older kernels only let root set triggers: sample once a second
+            close(_psiFd);
+            _psiFd = -1;
+        }
+        if (_psiFd >= 0) {
+            sources.last() += QStringLiteral(" trigger");
+        }
+    }
+
+    const std::string events = cgroupEventsPath();
+    if (!events.empty()) {
+        _eventsFd = open(events.c_str(), O_RDONLY | O_CLOEXEC);
+        if (_eventsFd >= 0) {
+            _haveEvents = MemoryPressurePolicy::parseMemoryEvents(readFd(_eventsFd), _lastEvents);
+            sources << QStringLiteral("cgroup memory.events");
+        }
+    }
+
+    sources << QStringLiteral("available memory");
+    _sources = sources.join(QStringLiteral(", "));
+
+    _stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    return _stopFd >= 0;
+}
+
+void MemoryPressureMonitor::_closeSources()
+{
+    for (int *fd : {&_psiFd, &_eventsFd, &_stopFd}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+void MemoryPressureMonitor::_waitForSignal()
+{
+    // PSI triggers and kernfs files both signal with POLLPRI
+    struct pollfd fds[3];
+    nfds_t count = 0;
+    fds[count++] = {_stopFd, POLLIN, 0};
+    if (_psiFd >= 0) {
+        fds[count++] = {_psiFd, POLLPRI, 0};
+    }
+    if (_eventsFd >= 0) {
+        fds[count++] = {_eventsFd, POLLPRI, 0};
+    }
+    poll(fds, count, CHECK_INTERVAL_MS);
+}
+
+Level MemoryPressureMonitor::_sample()
+{
+    Level level = Level::Normal;
+
+    Level psi = Level::Normal;
+    if (MemoryPressurePolicy::levelFromPsi(readFile(PSI_PATH), psi)) {
+        level = worse(level, psi);
+    }
+
+    if (_eventsFd >= 0) {
+        // Reading also re-arms the POLLPRI notification
+        MemoryPressurePolicy::MemoryEvents events;
+        if (MemoryPressurePolicy::parseMemoryEvents(readFd(_eventsFd), events)) {
+            if (_haveEvents) {
+                level = worse(level, MemoryPressurePolicy::levelFromMemoryEvents(_lastEvents, events));
+            }
+            _lastEvents = events;
+            _haveEvents = true;
+        }
+    }
+
+    SystemMemoryManager &memory = SystemMemoryManager::instance();
+    return worse(level, MemoryPressurePolicy::levelFromAvailable(memory.getAvailableMemoryMB(),
+                                                                 memory.getTotalMemoryMB()));
+}
+
+#elif defined(Q_OS_DARWIN)
+
+bool MemoryPressureMonitor::_openSources()
+{
+    dispatch_source_t source = dispatch_source_create(
+        DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+        DISPATCH_MEMORYPRESSURE_NORMAL | DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+        dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+    if (!source) {
+        return false;
+    }
+    dispatch_set_context(source, this);
+    dispatch_source_set_event_handler_f(source, [](void *context) {
+        auto *monitor = static_cast<MemoryPressureMonitor *>(context);
+        const unsigned long pressure = dispatch_source_get_data(static_cast<dispatch_source_t>(monitor->_source));
+        Level level = Level::Normal;
+        if (pressure & DISPATCH_MEMORYPRESSURE_CRITICAL) {
+            level = Level::Critical;
+        } else if (pressure & DISPATCH_MEMORYPRESSURE_WARN) {
+            level = Level::Warning;
+        }
+        {
+            std::lock_guard<std::mutex> lock(monitor->_mutex);
+            monitor->_osLevel = static_cast<int>(level);
+        }
+        monitor->_stopped.notify_all();
+    });
+    _source = source;
+    dispatch_resume(source);
+    _sources = QStringLiteral("dispatch memory pressure source");
+    return true;
+}
+
+void MemoryPressureMonitor::_closeSources()
+{
+    if (_source) {
+        dispatch_source_t source = static_cast<dispatch_source_t>(_source);
+        dispatch_source_cancel(source);
+        dispatch_release(source);
+        _source = nullptr;
+    }
+}
+
+void MemoryPressureMonitor::_waitForSignal()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    const int seen = _osLevel;
+    _stopped.wait_for(lock, std::chrono::milliseconds(CHECK_INTERVAL_MS),
+                      [this, seen] { return _stopping || _osLevel != seen; });
+}
+
+Level MemoryPressureMonitor::_sample()
+{
+    return static_cast<Level>(_osLevel.load());
+}
+
+#elif defined(Q_OS_WIN)
+
+bool MemoryPressureMonitor::_openSources()
+{
+    _lowMemory = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+    _highMemory = CreateMemoryResourceNotification(HighMemoryResourceNotification);
+    if (!_lowMemory || !_highMemory) {
+        _closeSources();
+        return false;
+    }
+    _sources = QStringLiteral("memory resource notifications, available memory");
+    return true;
+}
+
+void MemoryPressureMonitor::_closeSources()
+{
+    for (void **handle : {&_lowMemory, &_highMemory}) {
+        if (*handle) {
+            CloseHandle(*handle);
+            *handle = nullptr;
+        }
+    }
+}
+
+void MemoryPressureMonitor::_waitForSignal()
+{
+    // The low memory notification stays signalled while memory is low, so
+    // only wait on it while it is not
+    if (level() != Level::Critical) {
+        WaitForSingleObject(_lowMemory, CHECK_INTERVAL_MS);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stopped.wait_for(lock, std::chrono::milliseconds(CHECK_INTERVAL_MS), [this] { return _stopping.load(); });
+}
+
+Level MemoryPressureMonitor::_sample()
+{
+    BOOL low = FALSE;
+    BOOL high = TRUE;
+    QueryMemoryResourceNotification(_lowMemory, &low);
+    QueryMemoryResourceNotification(_highMemory, &high);
+    Level level = low ? Level::Critical : (high ? Level::Normal : Level::Warning);
+
+    SystemMemoryManager &memory = SystemMemoryManager::instance();
+    return worse(level, MemoryPressurePolicy::levelFromAvailable(memory.getAvailableMemoryMB(),
+                                                                 memory.getTotalMemoryMB()));
+}
+
+#else
+
+bool MemoryPressureMonitor::_openSources()
+{
+    return false;
+}
+
+void MemoryPressureMonitor::_closeSources()
+{
+}
+
+void MemoryPressureMonitor::_waitForSignal()
+{
+}
+
+Level MemoryPressureMonitor::_sample()
+{
+    return Level::Normal;
+}
+
+#endif
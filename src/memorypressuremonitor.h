@@ -0,0 +1,89 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef MEMORYPRESSUREMONITOR_H
+#define MEMORYPRESSUREMONITOR_H
+
+#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "memorypressurepolicy.h"
+
+/**
+ * @brief Watches the system's memory pressure signals for the whole process
+ *
+ * A background thread follows what the OS reports and runs it through
+ * MemoryPressurePolicy:
+ *   Linux    /proc/pressure/memory (PSI) with a poll() trigger, the
+ *            process's cgroup v2 memory.events, and available memory
+ *   macOS    DISPATCH_SOURCE_TYPE_MEMORYPRESSURE
+ *   Windows  Low and high memory resource notifications
+ *
+ * Consumers read scalePercent() at points that suit them (the write loop,
+ * the icon fetcher's event loop) and resize what they hold when it
+ * changes: ring buffer slot limits, the icon cache and the cache writer
+ * queue. When the scale drops, cached buffer pool memory is freed at once.
+ * Started on first use.
+ */
+class MemoryPressureMonitor
+{
+public:
+    static MemoryPressureMonitor& instance();
+
+    /**
+     * @brief Percentage of their normal size buffers and caches should use
+     */
+    int scalePercent() const { return _scalePercent.load(std::memory_order_relaxed); }
+
+    MemoryPressurePolicy::Level level() const { return _level.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief The signals being watched, for logging
+     */
+    QString sources() const;
+
+    /**
+     * @brief Stop watching, e.g. before the process exits
+     */
+    void stop();
+
+private:
+    MemoryPressureMonitor();
+    ~MemoryPressureMonitor();
+    MemoryPressureMonitor(const MemoryPressureMonitor&) = delete;
+    MemoryPressureMonitor& operator=(const MemoryPressureMonitor&) = delete;
+
+    static constexpr int CHECK_INTERVAL_MS = 1000;
+
+    void _run();
+    bool _openSources();         // Platform-specific
+    void _closeSources();
+    void _waitForSignal();       // Up to CHECK_INTERVAL_MS, or until the OS signals
+    MemoryPressurePolicy::Level _sample();
+
+    MemoryPressurePolicy _policy;  // Monitor thread only
+    std::atomic<int> _scalePercent;
+    std::atomic<MemoryPressurePolicy::Level> _level;
+    std::atomic<bool> _stopping;
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _stopped;
+    QString _sources;
+
+    // Platform state
+    int _psiFd = -1;
+    int _eventsFd = -1;
+    int _stopFd = -1;
+    bool _haveEvents = false;
+    MemoryPressurePolicy::MemoryEvents _lastEvents;
+    void *_source = nullptr;              // dispatch_source_t
+    std::atomic<int> _osLevel{0};         // Latest level the dispatch source reported
+    void *_lowMemory = nullptr;           // Windows notification handles
+    void *_highMemory = nullptr;
+};
+
+#endif // MEMORYPRESSUREMONITOR_H
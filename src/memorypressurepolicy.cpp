@@ -0,0 +1,128 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "memorypressurepolicy.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+bool MemoryPressurePolicy::onLevel(Level level, int64_t nowMs)
+{
+    const int before = _scalePercent;
+    _level = level;
+
+    switch (level)
+    {
+    case Level::Critical:
+        _scalePercent = std::min(_scalePercent, CriticalPercent);
+        _calmSinceMs = nowMs;
+        break;
+    case Level::Warning:
+        _scalePercent = std::min(_scalePercent, WarningPercent);
+        _calmSinceMs = nowMs;
+        break;
+    case Level::Normal:
+        if (_scalePercent < 100 && nowMs - _calmSinceMs >= _recoverStepMs)
+        {
+            _scalePercent = std::min(100, _scalePercent * 2);
+            _calmSinceMs = nowMs;
+        }
+        break;
+    }
+    return _scalePercent != before;
+}
+
+const char *MemoryPressurePolicy::levelName(Level level)
+{
+    switch (level)
+    {
+    case Level::Normal:   return "normal";
+    case Level::Warning:  return "warning";
+    case Level::Critical: return "critical";
+    }
+    return "unknown";
+}
+
+namespace {
+
+// avg10 from a PSI line such as
+//   some avg10=1.53 avg60=0.87 avg300=0.22 total=1234567
+bool psiAvg10(const std::string &text, const std::string &kind, double &avg10)
+{
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (line.compare(0, kind.size() + 1, kind + " ") != 0)
+            continue;
+        const size_t pos = line.find("avg10=");
+        if (pos == std::string::npos)
+            return false;
+        avg10 = std::strtod(line.c_str() + pos + 6, nullptr);
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+bool MemoryPressurePolicy::levelFromPsi(const std::string &text, Level &level)
+{
+    double some = 0;
+    if (!psiAvg10(text, "some", some))
+        return false;
+    double full = 0;
+    psiAvg10(text, "full", full);  // Not reported for the whole system before Linux 5.13
+
+    if (some >= PsiSomeCritical || full >= PsiFullCritical)
+        level = Level::Critical;
+    else if (some >= PsiSomeWarning)
+        level = Level::Warning;
+    else
+        level = Level::Normal;
+    return true;
+}
+
+bool MemoryPressurePolicy::parseMemoryEvents(const std::string &text, MemoryEvents &events)
+{
+    std::istringstream in(text);
+    std::string key;
+    uint64_t value = 0;
+    bool any = false;
+    while (in >> key >> value)
+    {
+        any = true;
+        if (key == "high")
+            events.high = value;
+        else if (key == "max")
+            events.max = value;
+        else if (key == "oom")
+            events.oom = value;
+        else if (key == "oom_kill")
+            events.oomKill = value;
+    }
+    return any;
+}
+
+MemoryPressurePolicy::Level MemoryPressurePolicy::levelFromMemoryEvents(const MemoryEvents &before,
+                                                                        const MemoryEvents &after)
+{
+    if (after.max > before.max || after.oom > before.oom || after.oomKill > before.oomKill)
+        return Level::Critical;
+    if (after.high > before.high)
+        return Level::Warning;
+    return Level::Normal;
+}
+
+MemoryPressurePolicy::Level MemoryPressurePolicy::levelFromAvailable(int64_t availableMB, int64_t totalMB)
+{
+    if (availableMB <= 0 || totalMB <= 0)
+        return Level::Normal;  // Unknown
+    if (availableMB < AvailableCriticalMB || availableMB * 100 < totalMB * AvailableCriticalPercent)
+        return Level::Critical;
+    if (availableMB * 100 < totalMB * AvailableWarningPercent)
+        return Level::Warning;
+    return Level::Normal;
+}
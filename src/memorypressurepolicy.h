@@ -0,0 +1,103 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef MEMORYPRESSUREPOLICY_H
+#define MEMORYPRESSUREPOLICY_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief How much of their normal size buffers and caches may use, given
+ * the memory pressure the system reports
+ *
+ * Ring buffer slot counts, the icon cache and the cache writer queue are
+ * sized once, from the memory available when they are created. On a
+ * shared host that can change during a write, and the write gets swapped
+ * out or OOM-killed. MemoryPressureMonitor feeds the level it reads from
+ * the OS in here once a second; the result is a percentage of the normal
+ * sizes:
+ *
+ *   Warning   at most WarningPercent
+ *   Critical  at most CriticalPercent
+ *   Normal    doubled after every RecoverStepMs without pressure, up to 100
+ *
+ * Shrinking is immediate; growing back is gradual, so pressure that comes
+ * and goes does not make the buffers flap.
+ *
+ * The parsers turn what Linux reports (/proc/pressure/memory and a cgroup's
+ * memory.events) into levels.
+ */
+class MemoryPressurePolicy
+{
+public:
+    enum class Level { Normal, Warning, Critical };
+
+    static constexpr int WarningPercent = 50;
+    static constexpr int CriticalPercent = 25;
+    static constexpr int64_t RecoverStepMs = 10000;
+
+    // PSI averages over 10 s, in percent of time stalled on memory
+    static constexpr double PsiSomeWarning = 10.0;
+    static constexpr double PsiSomeCritical = 40.0;
+    static constexpr double PsiFullCritical = 5.0;
+
+    // Memory available, when the OS reports nothing better
+    static constexpr int64_t AvailableCriticalMB = 256;  // = TimeoutDefaults::kCriticalMemoryMB
+    static constexpr int AvailableCriticalPercent = 5;   // Of total memory
+    static constexpr int AvailableWarningPercent = 10;
+
+    /**
+     * @brief Counters from a cgroup v2 memory.events file
+     */
+    struct MemoryEvents {
+        uint64_t high = 0;     // Reclaim forced above memory.high
+        uint64_t max = 0;      // Allocations that hit memory.max
+        uint64_t oom = 0;
+        uint64_t oomKill = 0;
+    };
+
+    explicit MemoryPressurePolicy(int64_t recoverStepMs = RecoverStepMs) : _recoverStepMs(recoverStepMs) {}
+
+    /**
+     * @brief The level seen at nowMs
+     * @return Whether scalePercent() changed
+     */
+    bool onLevel(Level level, int64_t nowMs);
+
+    int scalePercent() const { return _scalePercent; }
+    Level level() const { return _level; }
+
+    static const char *levelName(Level level);
+
+    /**
+     * @brief Level from the contents of /proc/pressure/memory
+     * @return false if the text has no "some" line
+     */
+    static bool levelFromPsi(const std::string &text, Level &level);
+
+    /**
+     * @brief Parse the contents of memory.events
+     */
+    static bool parseMemoryEvents(const std::string &text, MemoryEvents &events);
+
+    /**
+     * @brief Level from what happened between two reads of memory.events
+     */
+    static Level levelFromMemoryEvents(const MemoryEvents &before, const MemoryEvents &after);
+
+    /**
+     * @brief Level from available and total memory in MB
+     */
+    static Level levelFromAvailable(int64_t availableMB, int64_t totalMB);
+
+private:
+    int64_t _recoverStepMs;
+    int64_t _calmSinceMs = 0;
+    int _scalePercent = 100;
+    Level _level = Level::Normal;
+};
+
+#endif // MEMORYPRESSUREPOLICY_H
@@ -0,0 +1,140 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "metricsserver.h"
+#include "livemetrics.h"
+#include <QDebug>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+namespace {
+
+constexpr int kMaxRequestSize = 8192;
+
+} // namespace
+
+MetricsServer::MetricsServer(QObject *parent)
+    : QObject(parent), _server(new QTcpServer(this))
+{
+    connect(_server, &QTcpServer::newConnection, this, &MetricsServer::_onNewConnection);
+}
+
+MetricsServer::~MetricsServer()
+{
+    LiveMetrics::instance().setEnabled(false);
+}
+
+bool MetricsServer::listen(const QHostAddress &address, quint16 port)
+{
+    if (!_server->listen(address, port))
+    {
+        _error = _server->errorString();
+        return false;
+    }
+    LiveMetrics::instance().setEnabled(true);
+    qDebug() << "MetricsServer: serving" << kPath << "on" << address.toString() << "port" << _server->serverPort();
+    return true;
+}
+
+quint16 MetricsServer::port() const
+{
+    return _server->serverPort();
+}
+
+bool MetricsServer::parseListen(const QString &value, QHostAddress &address, quint16 &port)
+{
+    // The port follows the last colon; IPv6 addresses go in brackets
+    const int colon = value.lastIndexOf(':');
+    QString host = colon < 0 ? QString() : value.left(colon);
+    if (host.startsWith('[') && host.endsWith(']'))
+        host = host.mid(1, host.size() - 2);
+
+    bool ok = false;
+    const uint number = value.mid(colon + 1).toUInt(&ok);
+    if (!ok || number == 0 || number > 65535)
+        return false;
+
+    if (host.isEmpty())
+        address = QHostAddress(QHostAddress::LocalHost);
+    else if (!address.setAddress(host))
+        return false;
+    port = static_cast<quint16>(number);
+    return true;
+}
+
+void MetricsServer::_onNewConnection()
+{
+    while (QTcpSocket *socket = _server->nextPendingConnection())
+    {
+        if (_requests.size() >= kMaxConnections)
+        {
+            _reply(socket, 503, "Service Unavailable");
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            continue;
+        }
+
+        _requests.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { _onReadyRead(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            _requests.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MetricsServer::_onReadyRead(QTcpSocket *socket)
+{
+    auto it = _requests.find(socket);
+    if (it == _requests.end())
+        return;
+
+    *it += socket->readAll();
+    const int end = it->indexOf("\r\n\r\n");
+    if (end < 0)
+    {
+        if (it->size() > kMaxRequestSize)
+            _reply(socket, 400, "Bad Request");
+        return;
+    }
+
+    const QList<QByteArray> requestLine = it->left(it->indexOf("\r\n")).split(' ');
+    _requests.erase(it);  // Only one request per connection
+    if (requestLine.size() != 3)
+    {
+        _reply(socket, 400, "Bad Request");
+        return;
+    }
+
+    if (requestLine[0] != "GET")
+    {
+        _reply(socket, 405, "Method Not Allowed", "Allow: GET\r\n");
+        return;
+    }
+
+    // Query strings are ignored, as Prometheus may add some
+    QByteArray path = requestLine[1];
+    const int query = path.indexOf('?');
+    if (query >= 0)
+        path.truncate(query);
+    if (path != kPath)
+    {
+        _reply(socket, 404, "Not Found");
+        return;
+    }
+
+    _reply(socket, 200, "OK", "Content-Type: " + QByteArray(kContentType) + "\r\n",
+           QByteArray::fromStdString(LiveMetrics::instance().render()));
+}
+
+void MetricsServer::_reply(QTcpSocket *socket, int status, const QByteArray &reason,
+                           const QByteArray &headers, const QByteArray &body)
+{
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + " " + reason + "\r\n" + headers;
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+    socket->write(response);
+    socket->disconnectFromHost();
+}
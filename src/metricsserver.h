@@ -0,0 +1,62 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+
+class QTcpServer;
+class QTcpSocket;
+
+/**
+ * @brief HTTP endpoint for Prometheus to scrape LiveMetrics
+ *
+ * Answers GET /metrics with LiveMetrics::render() in the OpenMetrics text
+ * format, one request per connection. Runs on the thread it was created
+ * on; rendering reads atomics, so a scrape does not wait for the pipeline.
+ * Enables LiveMetrics while listening.
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int kMaxConnections = 16;
+    static constexpr const char *kPath = "/metrics";
+    static constexpr const char *kContentType = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+    explicit MetricsServer(QObject *parent = nullptr);
+    ~MetricsServer();
+
+    /**
+     * @brief Start serving
+     * @param address Address to listen on, e.g. QHostAddress::LocalHost
+     * @param port TCP port, 0 for any free one
+     */
+    bool listen(const QHostAddress &address, quint16 port);
+    quint16 port() const;
+    QString errorString() const { return _error; }
+
+    /**
+     * @brief Parse a --metrics value, "[address:]port"
+     * @return false if it is not one; the address defaults to localhost
+     */
+    static bool parseListen(const QString &value, QHostAddress &address, quint16 &port);
+
+private:
+    void _onNewConnection();
+    void _onReadyRead(QTcpSocket *socket);
+    void _reply(QTcpSocket *socket, int status, const QByteArray &reason,
+                const QByteArray &headers = QByteArray(), const QByteArray &body = QByteArray());
+
+    QTcpServer *_server;
+    QHash<QTcpSocket *, QByteArray> _requests;
+    QString _error;
+};
+
+#endif // METRICSSERVER_H
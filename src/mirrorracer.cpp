@@ -0,0 +1,219 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "mirrorracer.h"
+#include <QDebug>
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <memory>
+
+namespace {
+
+struct Transfer {
+    MirrorRacer::Probe *probe = nullptr;
+    CURL *easy = nullptr;
+    qint64 received = 0;
+};
+
+size_t probeWrite(char *, size_t size, size_t nmemb, void *userdata)
+{
+    auto *t = static_cast<Transfer *>(userdata);
+    t->received += static_cast<qint64>(size * nmemb);
+    // A server that ignores the range sends the whole file
+    return t->received > MirrorRacer::kProbeBytes ? 0 : size * nmemb;
+}
+
+size_t probeHeader(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    auto *probe = static_cast<Transfer *>(userdata)->probe;
+    const QByteArray line = QByteArray(ptr, static_cast<qsizetype>(size * nmemb)).trimmed();
+    const QByteArray lower = line.toLower();
+
+    if (lower.startsWith("http/"))
+    {
+        // New response (e.g. after a redirect) - only the final one counts
+        probe->totalSize = -1;
+        probe->duplicates.clear();
+    }
+    else if (lower.startsWith("content-range:"))
+    {
+        const int slash = line.lastIndexOf('/');
+        bool ok = false;
+        const qint64 total = slash < 0 ? -1 : line.mid(slash + 1).trimmed().toLongLong(&ok);
+        probe->totalSize = ok ? total : -1;
+    }
+    else
+    {
+        probe->duplicates += MirrorRacer::parseDuplicateLinks(line);
+    }
+    return size * nmemb;
+}
+
+} // namespace
+
+QList<MirrorRacer::Probe> MirrorRacer::race(const QList<QByteArray> &urls, const HandleFactory &makeHandle)
+{
+    QList<Probe> probes(urls.size());
+    std::vector<std::unique_ptr<Transfer>> transfers;
+    CURLM *multi = curl_multi_init();
+    if (!multi)
+        return probes;
+
+    const QByteArray range = "0-" + QByteArray::number(kProbeBytes - 1);
+    for (qsizetype i = 0; i < urls.size(); i++)
+    {
+        probes[i].url = urls[i];
+        CURL *easy = makeHandle();
+        if (!easy)
+            continue;
+
+        auto t = std::make_unique<Transfer>();
+        t->probe = &probes[i];
+        t->easy = easy;
+        curl_easy_setopt(easy, CURLOPT_URL, urls[i].constData());
+        curl_easy_setopt(easy, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(easy, CURLOPT_RESUME_FROM_LARGE, static_cast<curl_off_t>(0));
+        curl_easy_setopt(easy, CURLOPT_RANGE, range.constData());
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &probeWrite);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, t.get());
+        curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, &probeHeader);
+        curl_easy_setopt(easy, CURLOPT_HEADERDATA, t.get());
+        curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 1L);
+        curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, kProbeTimeoutMs);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, t.get());
+        curl_multi_add_handle(multi, easy);
+        transfers.push_back(std::move(t));
+    }
+
+    int running = 0;
+    do
+    {
+        CURLMcode mc = curl_multi_perform(multi, &running);
+        if (mc == CURLM_OK && running)
+            mc = curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+        if (mc != CURLM_OK)
+        {
+            qDebug() << "Mirror probe:" << curl_multi_strerror(mc);
+            break;
+        }
+
+        int msgsLeft = 0;
+        while (CURLMsg *msg = curl_multi_info_read(multi, &msgsLeft))
+        {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            Transfer *t = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char **>(&t));
+            Probe &probe = *t->probe;
+            long responseCode = 0;
+            double startTransfer = 0, total = 0;
+            char *effectiveUrl = nullptr;
+            curl_easy_getinfo(t->easy, CURLINFO_RESPONSE_CODE, &responseCode);
+            curl_easy_getinfo(t->easy, CURLINFO_STARTTRANSFER_TIME, &startTransfer);
+            curl_easy_getinfo(t->easy, CURLINFO_TOTAL_TIME, &total);
+            curl_easy_getinfo(t->easy, CURLINFO_EFFECTIVE_URL, &effectiveUrl);
+
+            // Only a server that takes ranges can be switched to part way
+            probe.ok = msg->data.result == CURLE_OK && responseCode == 206 && t->received > 0;
+            probe.finalUrl = effectiveUrl ? QByteArray(effectiveUrl) : probe.url;
+            probe.ttfbMs = static_cast<qint64>(startTransfer * 1000);
+            probe.bytesPerSecond = static_cast<qint64>(t->received / std::max(total - startTransfer, 0.001));
+            qDebug() << "Mirror probe" << probe.finalUrl << ":" << curl_easy_strerror(msg->data.result)
+                     << "HTTP" << responseCode << "ttfb" << probe.ttfbMs << "ms,"
+                     << probe.bytesPerSecond / 1024 << "KB/s," << probe.duplicates.size() << "duplicates";
+        }
+    } while (running);
+
+    for (const auto &t : transfers)
+    {
+        curl_multi_remove_handle(multi, t->easy);
+        curl_easy_cleanup(t->easy);
+    }
+    curl_multi_cleanup(multi);
+    return probes;
+}
+
+QList<QByteArray> MirrorRacer::parseDuplicateLinks(const QByteArray &headerLine)
+{
+    if (!headerLine.toLower().startsWith("link:"))
+        return {};
+
+    struct Link {
+        QByteArray url;
+        int pri = INT_MAX;
+    };
+    QList<Link> links;
+    const QByteArray value = headerLine.mid(5);
+    qsizetype pos = 0;
+    while ((pos = value.indexOf('<', pos)) >= 0)
+    {
+        const qsizetype end = value.indexOf('>', pos);
+        if (end < 0)
+            break;
+        qsizetype next = value.indexOf(',', end);
+        if (next < 0)
+            next = value.size();
+
+        Link link;
+        link.url = value.mid(pos + 1, end - pos - 1).trimmed();
+        bool duplicate = false;
+        for (const QByteArray &param : value.mid(end + 1, next - end - 1).split(';'))
+        {
+            const QByteArray p = param.trimmed().toLower();
+            if (p.startsWith("rel="))
+            {
+                const QByteArray rels = p.mid(4).replace('"', "");
+                duplicate = rels.split(' ').contains("duplicate");
+            }
+            else if (p.startsWith("pri="))
+            {
+                bool ok = false;
+                const int pri = p.mid(4).toInt(&ok);
+                if (ok)
+                    link.pri = pri;
+            }
+        }
+        if (duplicate && (link.url.startsWith("http://") || link.url.startsWith("https://")))
+            links.append(link);
+        pos = next;
+    }
+
+    std::stable_sort(links.begin(), links.end(), [](const Link &a, const Link &b) { return a.pri < b.pri; });
+    QList<QByteArray> urls;
+    for (const Link &link : std::as_const(links))
+        urls.append(link.url);
+    return urls;
+}
+
+qint64 MirrorRacer::predictedMs(const Probe &probe, qint64 downloadSize)
+{
+    if (!probe.ok || probe.bytesPerSecond <= 0)
+        return std::numeric_limits<qint64>::max();
+    return probe.ttfbMs + static_cast<qint64>(double(downloadSize) * 1000 / double(probe.bytesPerSecond));
+}
+
+int MirrorRacer::pickBest(const QList<Probe> &probes, qint64 downloadSize)
+{
+    int best = -1;
+    qint64 bestMs = 0;
+    for (qsizetype i = 0; i < probes.size(); i++)
+    {
+        if (!probes[i].ok)
+            continue;
+        const qint64 ms = predictedMs(probes[i], downloadSize);
+        if (best < 0 || ms < bestMs)
+        {
+            best = static_cast<int>(i);
+            bestMs = ms;
+        }
+    }
+
+    // Not worth leaving the first candidate for a small predicted gain
+    if (best > 0 && probes[0].ok && double(predictedMs(probes[0], downloadSize)) < double(bestMs) * kSwitchMargin)
+        return 0;
+    return best;
+}
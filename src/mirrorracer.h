@@ -0,0 +1,72 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef MIRRORRACER_H
+#define MIRRORRACER_H
+
+#include <QByteArray>
+#include <QList>
+#include <functional>
+#include <curl/curl.h>
+
+/**
+ * @brief Picks the fastest of several URLs serving the same download
+ *
+ * Candidates come from the OS list ("mirrors") and from the
+ * "Link: <url>; rel=duplicate" headers a mirror redirector sends with the
+ * file (RFC 6249). Each is asked for the first kProbeBytes in parallel;
+ * the time to the first byte and the throughput over the rest predict how
+ * long the whole download would take from it.
+ *
+ * A mirror that reports a different size than the first candidate is
+ * not used. The download is checked against the OS list SHA256 as usual,
+ * wherever it comes from.
+ */
+class MirrorRacer
+{
+public:
+    static constexpr qint64 kProbeBytes = 512 * 1024;
+    static constexpr long kProbeTimeoutMs = 5000;
+    static constexpr int kMaxCandidates = 6;
+    // A mirror must be predicted this much faster to be used instead of the first candidate
+    static constexpr double kSwitchMargin = 1.25;
+
+    struct Probe {
+        QByteArray url;        // As given
+        QByteArray finalUrl;   // After redirects
+        bool ok = false;
+        qint64 ttfbMs = 0;
+        qint64 bytesPerSecond = 0;
+        qint64 totalSize = -1;           // From Content-Range, -1 if unknown
+        QList<QByteArray> duplicates;    // Link rel=duplicate URLs, best first
+    };
+
+    // Returns a handle with the download's settings (proxy, CA bundle, ...)
+    using HandleFactory = std::function<CURL *()>;
+
+    /**
+     * @brief Probe all urls at once
+     * @return One Probe per url, in the same order
+     */
+    static QList<Probe> race(const QList<QByteArray> &urls, const HandleFactory &makeHandle);
+
+    /**
+     * @brief The rel=duplicate URLs in one Link header line, best (lowest
+     * pri) first. Empty if it is not a Link header.
+     */
+    static QList<QByteArray> parseDuplicateLinks(const QByteArray &headerLine);
+
+    /**
+     * @brief Index of the probe predicted to download downloadSize bytes
+     * soonest; probes[0] unless another beats it by kSwitchMargin.
+     * -1 if none succeeded.
+     */
+    static int pickBest(const QList<Probe> &probes, qint64 downloadSize);
+
+    // Predicted milliseconds to download downloadSize bytes
+    static qint64 predictedMs(const Probe &probe, qint64 downloadSize);
+};
+
+#endif // MIRRORRACER_H
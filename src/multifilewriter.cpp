@@ -0,0 +1,310 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "multifilewriter.h"
+#include "containerlimits.h"
+#include <archive.h>
+#include <archive_entry.h>
+#include <algorithm>
+#include <stdexcept>
+#include <QDebug>
+
+MultiFileWriter::MultiFileWriter(int flags, std::atomic<std::uint64_t> &bytesWritten,
+                                 const std::atomic<bool> &cancelled, int workers)
+    : _bytesWritten(bytesWritten), _cancelled(cancelled)
+{
+    if (workers <= 0)
+        workers = defaultWorkerCount();
+
+    // Created up front on this thread: archive_write_disk_new() reads the umask
+    // by setting it, which is not safe to do from several threads at once
+    _ext = archive_write_disk_new();
+    archive_write_disk_set_options(_ext, flags);
+    for (int i = 0; i < workers; i++)
+    {
+        struct archive *ext = archive_write_disk_new();
+        archive_write_disk_set_options(ext, flags);
+        _workerExt.push_back(ext);
+    }
+    for (struct archive *ext : _workerExt)
+        _workers.emplace_back(&MultiFileWriter::_workerLoop, this, ext);
+}
+
+MultiFileWriter::~MultiFileWriter()
+{
+    abort();
+    for (struct archive *ext : _workerExt)
+        archive_write_free(ext);
+    archive_write_free(_ext);
+}
+
+int MultiFileWriter::defaultWorkerCount()
+{
+    return std::clamp(ContainerLimits::cpuCount(), 1, 4);
+}
+
+void MultiFileWriter::extract(struct archive *a, struct archive_entry *entry)
+{
+    _throwIfFailed();
+
+    if (archive_entry_filetype(entry) == AE_IFREG && archive_entry_size_is_set(entry)
+        && archive_entry_size(entry) <= kSmallFileSize)
+    {
+        File file;
+        file.data.resize(static_cast<std::size_t>(archive_entry_size(entry)));
+        std::size_t got = 0;
+        while (got < file.data.size())
+        {
+            la_ssize_t n = archive_read_data(a, file.data.data() + got, file.data.size() - got);
+            if (n == ARCHIVE_FATAL)
+                throw std::runtime_error(archive_error_string(a));
+            if (n < 0)
+            {
+                qDebug() << archive_error_string(a);
+                break;
+            }
+            if (n == 0)
+                break;
+            got += static_cast<std::size_t>(n);
+        }
+        file.data.resize(got);
+        file.entry = archive_entry_clone(entry);
+
+        _pending.bytes += got;
+        _pending.files.push_back(std::move(file));
+        if (_pending.files.size() >= kBatchFiles || _pending.bytes >= kBatchBytes)
+            _flushBatch();
+        return;
+    }
+
+    _recordPath(entry);
+    int r = archive_write_header(_ext, entry);
+    if (r < ARCHIVE_OK)
+        qDebug() << archive_error_string(_ext);
+    else if (archive_entry_filetype(entry) == AE_IFREG)
+        _writeLargeFile(a);
+
+    r = archive_write_finish_entry(_ext);
+    if (r == ARCHIVE_FATAL)
+        throw std::runtime_error(archive_error_string(_ext));
+    if (r < ARCHIVE_OK)
+        qDebug() << archive_error_string(_ext);
+}
+
+void MultiFileWriter::_writeLargeFile(struct archive *a)
+{
+    // Read whole chunks rather than libarchive's decompression blocks, so the
+    // file is written in a few large, aligned writes
+    if (_chunk.empty())
+        _chunk.resize(kChunkSize);
+
+    while (true)
+    {
+        la_ssize_t n = archive_read_data(a, _chunk.data(), _chunk.size());
+        if (n == 0)
+            break;
+        if (n == ARCHIVE_FATAL)
+            throw std::runtime_error(archive_error_string(a));
+        if (n < 0)
+        {
+            qDebug() << archive_error_string(a);
+            break;
+        }
+        if (archive_write_data(_ext, _chunk.data(), static_cast<std::size_t>(n)) < 0)
+            throw std::runtime_error(archive_error_string(_ext));
+        _bytesWritten += static_cast<std::uint64_t>(n);
+        _throwIfFailed();
+    }
+}
+
+void MultiFileWriter::_writeSmallFile(struct archive *ext, const File &file)
+{
+    _recordPath(file.entry);
+    int r = archive_write_header(ext, file.entry);
+    if (r < ARCHIVE_OK)
+    {
+        qDebug() << archive_error_string(ext);
+    }
+    else if (!file.data.empty())
+    {
+        if (archive_write_data(ext, file.data.data(), file.data.size()) < 0)
+            throw std::runtime_error(archive_error_string(ext));
+        _bytesWritten += file.data.size();
+    }
+
+    r = archive_write_finish_entry(ext);
+    if (r == ARCHIVE_FATAL)
+        throw std::runtime_error(archive_error_string(ext));
+    if (r < ARCHIVE_OK)
+        qDebug() << archive_error_string(ext);
+}
+
+void MultiFileWriter::_workerLoop(struct archive *ext)
+{
+    while (true)
+    {
+        Batch batch;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _workAvailable.wait(lock, [this] { return _stopping || !_queued.empty(); });
+            // Stopping: the queue is still written out unless aborted
+            if (_queued.empty())
+                return;
+            batch = std::move(_queued.front());
+            _queued.pop_front();
+            _busyWorkers++;
+        }
+
+        try
+        {
+            for (const File &file : batch.files)
+            {
+                if (_cancelled || _aborted)
+                    break;
+                _writeSmallFile(ext, file);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            _setError(e.what());
+        }
+
+        const std::size_t bytes = batch.bytes;
+        _freeBatch(batch);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _busyWorkers--;
+            _bytesInFlight -= bytes;
+        }
+        _workDone.notify_all();
+    }
+}
+
+void MultiFileWriter::_queue(Batch &&batch)
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _workDone.wait(lock, [this] { return _bytesInFlight < kMaxBytesInFlight || _aborted; });
+        if (!_aborted && !_stopping)
+        {
+            _bytesInFlight += batch.bytes;
+            _queued.push_back(std::move(batch));
+            lock.unlock();
+            _workAvailable.notify_one();
+            return;
+        }
+    }
+    _freeBatch(batch);
+}
+
+void MultiFileWriter::_flushBatch()
+{
+    if (_pending.files.empty())
+        return;
+    Batch batch = std::move(_pending);
+    _pending = Batch();
+    _queue(std::move(batch));
+}
+
+void MultiFileWriter::_freeBatch(Batch &batch)
+{
+    for (File &file : batch.files)
+        archive_entry_free(file.entry);
+    batch.files.clear();
+    batch.bytes = 0;
+}
+
+void MultiFileWriter::_recordPath(struct archive_entry *entry)
+{
+    QString path = QString::fromWCharArray(archive_entry_pathname_w(entry));
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (archive_entry_filetype(entry) == AE_IFDIR)
+        _directories.append(path);
+    else
+        _files.append(path);
+}
+
+void MultiFileWriter::_setError(const std::string &message)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_error.empty())
+            _error = message;
+        _aborted = true;
+    }
+    _workDone.notify_all();
+}
+
+void MultiFileWriter::_throwIfFailed()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_error.empty())
+        throw std::runtime_error(_error);
+}
+
+void MultiFileWriter::finish()
+{
+    _flushBatch();
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _workDone.wait(lock, [this] { return _queued.empty() && _busyWorkers == 0; });
+    }
+    _throwIfFailed();
+}
+
+void MultiFileWriter::abort()
+{
+    _freeBatch(_pending);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _aborted = true;
+        for (Batch &batch : _queued)
+        {
+            _bytesInFlight -= batch.bytes;
+            _freeBatch(batch);
+        }
+        _queued.clear();
+    }
+    _workDone.notify_all();
+    _stopWorkers();
+}
+
+bool MultiFileWriter::close()
+{
+    _flushBatch();
+    _stopWorkers();
+
+    bool ok = true;
+    for (struct archive *ext : _workerExt)
+        ok = archive_write_close(ext) == ARCHIVE_OK && ok;
+    ok = archive_write_close(_ext) == ARCHIVE_OK && ok;
+    return ok;
+}
+
+void MultiFileWriter::_stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _workAvailable.notify_all();
+    for (std::thread &worker : _workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+}
+
+QStringList MultiFileWriter::files() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _files;
+}
+
+QStringList MultiFileWriter::directories() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _directories;
+}
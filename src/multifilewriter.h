@@ -0,0 +1,133 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef MULTIFILEWRITER_H
+#define MULTIFILEWRITER_H
+
+#include <QStringList>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct archive;
+struct archive_entry;
+
+/**
+ * @brief Writes the entries of a multi-file archive to disk, small files in
+ * parallel
+ *
+ * Multi-file (NOOBS-style) zips hold thousands of small files, and on a
+ * FAT-formatted SD card each one costs a create, a directory update and a
+ * close that take far longer than writing its data. Writing one file at a
+ * time leaves the card idle for most of that.
+ *
+ * extract() reads regular files of up to kSmallFileSize whole, and queues
+ * them in batches of up to kBatchFiles files or kBatchBytes for a pool of
+ * workers, each with its own libarchive disk writer. Larger files, and
+ * files whose size the archive does not state, are written on the calling
+ * thread in kChunkSize pieces while the workers carry on. Directories and
+ * other entries are created on the calling thread straight away.
+ *
+ * At most kMaxBytesInFlight of small files are held in memory; extract()
+ * waits for the workers beyond that.
+ */
+class MultiFileWriter
+{
+public:
+    static constexpr std::int64_t kSmallFileSize = 256 * 1024;
+    static constexpr std::size_t kBatchBytes = 4 * 1024 * 1024;
+    static constexpr int kBatchFiles = 64;
+    static constexpr std::size_t kMaxBytesInFlight = 64 * 1024 * 1024;
+    static constexpr std::size_t kChunkSize = 4 * 1024 * 1024;
+
+    /**
+     * @param flags ARCHIVE_EXTRACT_* options for every disk writer
+     * @param bytesWritten Incremented as file data is written
+     * @param cancelled Workers drop what is queued once this is set
+     * @param workers Number of worker threads; 0 for defaultWorkerCount()
+     */
+    MultiFileWriter(int flags, std::atomic<std::uint64_t> &bytesWritten,
+                    const std::atomic<bool> &cancelled, int workers = 0);
+    ~MultiFileWriter();
+    MultiFileWriter(const MultiFileWriter &) = delete;
+    MultiFileWriter &operator=(const MultiFileWriter &) = delete;
+
+    // One per core, but no more than 4: the card is a single device
+    static int defaultWorkerCount();
+
+    /**
+     * @brief Extract the entry a was just positioned at by
+     * archive_read_next_header()
+     * @throws std::runtime_error on a read error, or a write error in a worker
+     */
+    void extract(struct archive *a, struct archive_entry *entry);
+
+    /**
+     * @brief Write what is still queued and wait for it
+     * @throws std::runtime_error with the first write error
+     */
+    void finish();
+
+    // Drop what is queued and stop the workers, e.g. after an error
+    void abort();
+
+    /**
+     * @brief Stop the workers and close all disk writers, which applies the
+     * deferred directory times
+     * @return false if a disk writer failed to close
+     */
+    bool close();
+
+    // Files and directories created so far, to clean up after a failure
+    QStringList files() const;
+    QStringList directories() const;
+
+private:
+    struct File {
+        struct archive_entry *entry = nullptr;
+        std::vector<char> data;
+    };
+    struct Batch {
+        std::vector<File> files;
+        std::size_t bytes = 0;
+    };
+
+    void _workerLoop(struct archive *ext);
+    void _writeSmallFile(struct archive *ext, const File &file);
+    void _writeLargeFile(struct archive *a);
+    void _queue(Batch &&batch);
+    void _flushBatch();
+    void _freeBatch(Batch &batch);
+    void _recordPath(struct archive_entry *entry);
+    void _setError(const std::string &message);
+    void _throwIfFailed();
+    void _stopWorkers();
+
+    std::atomic<std::uint64_t> &_bytesWritten;
+    const std::atomic<bool> &_cancelled;
+    struct archive *_ext;
+    std::vector<struct archive *> _workerExt;
+    std::vector<std::thread> _workers;
+    std::vector<char> _chunk;
+    Batch _pending;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _workAvailable;
+    std::condition_variable _workDone;
+    std::deque<Batch> _queued;
+    std::size_t _bytesInFlight = 0;
+    int _busyWorkers = 0;
+    bool _stopping = false;
+    std::atomic<bool> _aborted{false};
+    std::string _error;
+    QStringList _files, _directories;
+};
+
+#endif // MULTIFILEWRITER_H
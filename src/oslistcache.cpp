@@ -0,0 +1,133 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "oslistcache.h"
+
+#include <QCborValue>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+    constexpr quint32 RESPONSE_MAGIC = 0x4f534c52;  // "OSLR"
+    constexpr quint32 SNAPSHOT_MAGIC = 0x4f534c53;  // "OSLS"
+    constexpr quint32 FORMAT_VERSION = 1;
+}
+
+OsListCache::OsListCache(const QString &directory)
+    : _directory(directory)
+{
+}
+
+QString OsListCache::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           QDir::separator() + "oslist";
+}
+
+bool OsListCache::isCacheable(const QUrl &url)
+{
+    const QString scheme = url.scheme().toLower();
+    return scheme == QLatin1String("http") || scheme == QLatin1String("https");
+}
+
+QString OsListCache::pathFor(const QUrl &url, const char *suffix) const
+{
+    const QByteArray key = QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1).toHex();
+    return _directory + QDir::separator() + QString::fromLatin1(key) + QLatin1String(suffix);
+}
+
+bool OsListCache::lookup(const QUrl &url, Response *response) const
+{
+    if (!isCacheable(url))
+        return false;
+
+    QFile f(pathFor(url, ".resp"));
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&f);
+    quint32 magic = 0, version = 0;
+    QUrl storedUrl;
+    Response r;
+    in >> magic >> version;
+    if (magic != RESPONSE_MAGIC || version != FORMAT_VERSION)
+        return false;
+    in >> storedUrl >> r.etag >> r.lastModified >> r.body;
+    if (in.status() != QDataStream::Ok || storedUrl != url || r.body.isEmpty())
+        return false;
+
+    *response = std::move(r);
+    return true;
+}
+
+void OsListCache::store(const QUrl &url, const Response &response)
+{
+    if (!isCacheable(url) || response.body.isEmpty())
+        return;
+
+    QDir().mkpath(_directory);
+    QSaveFile f(pathFor(url, ".resp"));
+    if (!f.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&f);
+    out << RESPONSE_MAGIC << FORMAT_VERSION << url << response.etag << response.lastModified << response.body;
+    if (!f.commit())
+        qWarning() << "OsListCache: could not write cached response for" << url;
+}
+
+QJsonDocument OsListCache::loadSnapshot(const QUrl &repoUrl) const
+{
+    if (!isCacheable(repoUrl))
+        return {};
+
+    QFile f(pathFor(repoUrl, ".snapshot"));
+    if (!f.open(QIODevice::ReadOnly))
+        return {};
+
+    QDataStream in(&f);
+    quint32 magic = 0, version = 0;
+    QUrl storedUrl;
+    QByteArray cbor;
+    in >> magic >> version;
+    if (magic != SNAPSHOT_MAGIC || version != FORMAT_VERSION)
+        return {};
+    in >> storedUrl >> cbor;
+    if (in.status() != QDataStream::Ok || storedUrl != repoUrl)
+        return {};
+
+    const QJsonObject list = QCborValue::fromCbor(cbor).toJsonValue().toObject();
+    if (!list.contains("os_list"))
+        return {};
+    return QJsonDocument(list);
+}
+
+void OsListCache::storeSnapshot(const QUrl &repoUrl, const QJsonDocument &list)
+{
+    if (!isCacheable(repoUrl) || !list.isObject())
+        return;
+
+    QDir().mkpath(_directory);
+    QSaveFile f(pathFor(repoUrl, ".snapshot"));
+    if (!f.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&f);
+    out << SNAPSHOT_MAGIC << FORMAT_VERSION << repoUrl
+        << QCborValue::fromJsonValue(list.object()).toCbor();
+    if (!f.commit())
+        qWarning() << "OsListCache: could not write OS list snapshot for" << repoUrl;
+}
+
+void OsListCache::clear()
+{
+    QDir(_directory).removeRecursively();
+}
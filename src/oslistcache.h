@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef OSLISTCACHE_H
+#define OSLISTCACHE_H
+
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QString>
+#include <QUrl>
+
+/**
+ * On-disk cache for the OS list.
+ *
+ * Holds two things:
+ * - Each fetched list (top-level and every subitems_url) with the ETag and
+ *   Last-Modified it was served with, so the next fetch can be a conditional
+ *   request that the server answers with 304 Not Modified.
+ * - A snapshot of the fully merged list per repository in CBOR, so the UI
+ *   can be populated at startup before any request has been answered.
+ *
+ * Only http(s) URLs are cached; local repositories are read directly.
+ * All methods are meant to be called from the GUI thread.
+ */
+class OsListCache
+{
+public:
+    struct Response {
+        QByteArray body;
+        QByteArray etag;
+        QByteArray lastModified;
+    };
+
+    explicit OsListCache(const QString &directory = defaultDirectory());
+
+    static QString defaultDirectory();
+    static bool isCacheable(const QUrl &url);
+
+    bool lookup(const QUrl &url, Response *response) const;
+    void store(const QUrl &url, const Response &response);
+
+    // The merged OS list last assembled for this repository, or an empty
+    // document if there is none
+    QJsonDocument loadSnapshot(const QUrl &repoUrl) const;
+    void storeSnapshot(const QUrl &repoUrl, const QJsonDocument &list);
+
+    void clear();
+
+private:
+    QString pathFor(const QUrl &url, const char *suffix) const;
+
+    QString _directory;
+};
+
+#endif // OSLISTCACHE_H
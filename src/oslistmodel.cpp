@@ -14,13 +14,15 @@
 #include <QRandomGenerator>
 #include <qjsonarray.h>
 #include <algorithm>
-#include <QRegularExpression>
 #include <QUrl>
 #include <QFileInfo>
 #include <QElapsedTimer>
 
 namespace {
 
+    // Erase and Use custom have no row in the fetched list and sort after it
+    constexpr int INTERNAL_SOURCE_ROW = 1 << 30;
+
     // Valid init_format values according to schema
     static const QStringList VALID_INIT_FORMATS = {
         QStringLiteral(""),
@@ -75,152 +77,46 @@ namespace {
         return filtered;
     }
 
-    QJsonArray getListForLocale(QJsonObject root) {
-        // "os_list_<locale>" has priority
-
-        QString localeName = QLocale::system().name();
-        QString candidateKey = QStringLiteral("os_list_%1").arg(localeName);
-
-        QJsonArray list;
-        if (root.contains(candidateKey)) {
-            list = root[candidateKey].toArray();
-        } else if (localeName.contains(QLatin1Char('_'))) {
-            localeName = localeName.section('_', 0, 0);
-            candidateKey = QStringLiteral("os_list_%1").arg(localeName);
-            if (root.contains(candidateKey)) {
-                list = root[candidateKey].toArray();
-            }
-        }
-
-        // fallback to "os_list"
-        if (list.isEmpty() && root.contains(QLatin1String("os_list"))) {
-            list = root["os_list"].toArray();
-        }
-
-        return list;
-    }
-
-    QJsonArray parseOSJson(QJsonObject root) {
-        QJsonArray list = getListForLocale(root);
-        if (list.isEmpty()) {
-            qWarning() << Q_FUNC_INFO << "Expected to find os_list key" << root.keys();
-            return {};
-        }
-
-        // Filter out entries with invalid init_format values
-        list = filterInvalidInitFormats(list);
-
-        // Apply random shuffling to arrays containing 'random' flag
-        std::function<void(QJsonArray&)> shuffleIfRandom = [&](QJsonArray &lst) {
-            for (int i = 0; i < lst.size(); i++) {
-                QJsonObject entry = lst[i].toObject();
+    // Apply random shuffling to arrays containing 'random' flag
+    void shuffleIfRandom(QJsonArray &lst) {
+        for (int i = 0; i < lst.size(); i++) {
+            QJsonObject entry = lst[i].toObject();
+            
+            if (entry.contains(QLatin1String("subitems"))) {
+                QJsonArray subitems = entry["subitems"].toArray();
+                shuffleIfRandom(subitems);
                 
-                if (entry.contains(QLatin1String("subitems"))) {
-                    QJsonArray subitems = entry["subitems"].toArray();
-                    shuffleIfRandom(subitems);
-                    
-                    // Shuffle if random flag is set
-                    if (entry.contains(QLatin1String("random")) && entry["random"].toBool()) {
-                        // Fisher-Yates shuffle - properly handle QJsonArray
-                        for (int j = subitems.size() - 1; j > 0; j--) {
-                            int k = QRandomGenerator::global()->bounded(j + 1);
-                            if (j != k) {
-                                // Properly swap QJsonArray elements by storing values, not references
-                                QJsonValue tempValue = subitems[j];
-                                QJsonValue kValue = subitems[k];
-                                subitems[j] = kValue;
-                                subitems[k] = tempValue;
-                            }
+                // Shuffle if random flag is set
+                if (entry.contains(QLatin1String("random")) && entry["random"].toBool()) {
+                    // Fisher-Yates shuffle - properly handle QJsonArray
+                    for (int j = subitems.size() - 1; j > 0; j--) {
+                        int k = QRandomGenerator::global()->bounded(j + 1);
+                        if (j != k) {
+                            // Properly swap QJsonArray elements by storing values, not references
+                            QJsonValue tempValue = subitems[j];
+                            QJsonValue kValue = subitems[k];
+                            subitems[j] = kValue;
+                            subitems[k] = tempValue;
                         }
                     }
-                    entry["subitems"] = subitems;
-                    lst[i] = entry;
                 }
-            }
-        };
-
-        shuffleIfRandom(list);
-
-        // Flatten, since GUI doesn't support a tree model
-        for (int i = 0; i < list.size(); i++) {
-            QJsonObject entry = list[i].toObject();
-            if (entry.contains("subitems")) {
-                QJsonDocument subitemsDoc(entry["subitems"].toArray());
-                entry["subitems_json"] = QString::fromUtf8(subitemsDoc.toJson());
-                entry.remove("subitems");
-                list[i] = entry;
+                entry["subitems"] = subitems;
+                lst[i] = entry;
             }
         }
-
-        return list;
     }
 
-    // Apply architecture-based sorting to subitems in a JSON array
-    void applyArchitectureSorting(QJsonArray &list, const QString &preferredArchitecture) {
-        if (preferredArchitecture.isEmpty()) {
-            return; // No preferred architecture, no sorting needed
-        }
-
-        // First, sort the top-level array itself
-        QJsonArray sortedList;
-        QJsonArray otherItems;
-        
-        // Collect items that match preferred architecture first
-        for (int i = 0; i < list.size(); i++) {
-            QJsonObject item = list[i].toObject();
-            QString itemArch = item["architecture"].toString();
-            
-            if (itemArch == preferredArchitecture) {
-                sortedList.append(list[i]);
-            } else {
-                otherItems.append(list[i]);
-            }
-        }
-        
-        // Append all non-matching items
-        for (int i = 0; i < otherItems.size(); i++) {
-            sortedList.append(otherItems[i]);
+    // Prepare one top-level entry for the model: prune invalid init_format
+    // values and shuffle random sublists. Returns an empty object if the
+    // whole entry is pruned.
+    QJsonObject prepareOSEntry(const QJsonObject &entry) {
+        QJsonArray list = filterInvalidInitFormats(QJsonArray{entry});
+        if (list.isEmpty()) {
+            return {};
         }
-        
-        // Replace the original list with the sorted one
-        list = sortedList;
 
-        // Then recursively process subitems within each entry
-        for (int i = 0; i < list.size(); i++) {
-            QJsonObject entry = list[i].toObject();
-            
-            if (entry.contains(QLatin1String("subitems"))) {
-                QJsonArray subitems = entry["subitems"].toArray();
-                
-                // Recursively apply to nested subitems
-                applyArchitectureSorting(subitems, preferredArchitecture);
-                
-                // Manual stable sort: move items matching preferred architecture to the front
-                // We'll build a new array with preferred items first, then others
-                QJsonArray sortedSubitems;
-                QJsonArray otherSubitems;
-                
-                // First pass: collect items that match preferred architecture
-                for (int j = 0; j < subitems.size(); j++) {
-                    QJsonObject subitem = subitems[j].toObject();
-                    QString itemArch = subitem["architecture"].toString();
-                    
-                    if (itemArch == preferredArchitecture) {
-                        sortedSubitems.append(subitems[j]);
-                    } else {
-                        otherSubitems.append(subitems[j]);
-                    }
-                }
-                
-                // Second pass: append all non-matching items
-                for (int j = 0; j < otherSubitems.size(); j++) {
-                    sortedSubitems.append(otherSubitems[j]);
-                }
-                
-                entry["subitems"] = sortedSubitems;
-                list[i] = entry;
-            }
-        }
+        shuffleIfRandom(list);
+        return list.first().toObject();
     }
 
     // Sanitize icon source: allow known-good forms and drop malformed URLs to avoid runtime fetch errors
@@ -273,106 +169,339 @@ namespace {
     }
 }
 
+int OSListModel::Columns::size() const
+{
+    return sourceRows.size();
+}
+
+void OSListModel::Columns::resize(int rows)
+{
+    sourceRows.resize(rows);
+    sources.resize(rows);
+    subitems.resize(rows);
+    for (auto &column : roles) {
+        column.resize(rows);
+    }
+}
+
+void OSListModel::Columns::insert(int at)
+{
+    sourceRows.insert(at, -1);
+    sources.insert(at, QJsonObject());
+    subitems.insert(at, QJsonArray());
+    for (auto &column : roles) {
+        column.insert(at, QVariant());
+    }
+}
+
+void OSListModel::Columns::remove(int at)
+{
+    sourceRows.removeAt(at);
+    sources.removeAt(at);
+    subitems.removeAt(at);
+    for (auto &column : roles) {
+        column.removeAt(at);
+    }
+}
+
+void OSListModel::Columns::copy(int to, const Columns &from, int row)
+{
+    sourceRows[to] = from.sourceRows[row];
+    sources[to] = from.sources[row];
+    subitems[to] = from.subitems[row];
+    for (size_t i = 0; i < roles.size(); i++) {
+        roles[i][to] = from.roles[i][row];
+    }
+}
+
+void OSListModel::Columns::store(int row, OS &&os)
+{
+    sourceRows[row] = os.sourceRow;
+    sources[row] = std::move(os.source);
+    subitems[row] = std::move(os.subitems);
+
+    auto set = [&](OSListRole role, QVariant value) { roles[role - NameRole][row] = std::move(value); };
+    set(NameRole, os.name);
+    set(DescriptionRole, os.description);
+    set(DevicesRole, os.devices);
+    set(CapabilitiesRole, os.capabilities);
+    set(ExtractSha256Role, os.extractSha256);
+    set(BmapUrlRole, os.bmapUrl);
+    set(MirrorsRole, os.mirrors);
+    set(ExtractSizeRole, os.extractSize);
+    set(IconRole, os.icon);
+    set(ImageDownloadSizeRole, os.imageDownloadSize);
+    set(InitFormatRole, os.initFormat);
+    set(ReleaseDataRole, os.releaseDate);
+    set(UrlRole, os.url);
+    set(RandomRole, os.random);
+    // Left invalid until asked for if there are subitems to serialise
+    set(SubItemsJsonRole, subitems[row].isEmpty() ? QVariant(QString()) : QVariant());
+    set(TooltipRole, os.tooltip);
+    set(WebsiteRole, os.website);
+    set(ArchitectureRole, os.architecture);
+    set(PiConnectRole, os.enableRPiConnect);
+}
+
+QString OSListModel::Columns::string(int row, OSListRole role) const
+{
+    return roles[role - NameRole][row].toString();
+}
+
+void OSListModel::Columns::setDescription(int row, const QString &description)
+{
+    roles[DescriptionRole - NameRole][row] = description;
+}
+
 OSListModel::OSListModel(ImageWriter &imageWriter)
     : QAbstractListModel(&imageWriter), _imageWriter(imageWriter) {}
 
+OSListModel::OS OSListModel::osFromJson(const QJsonObject &obj, int sourceRow)
+{
+    OS os;
+    os.sourceRow = sourceRow;
+
+    os.name = obj["name"].toString();
+    os.description = obj["description"].toString();
+
+    QJsonArray devicesArray = obj["devices"].toArray();
+    os.devices.reserve(devicesArray.size());
+    for (const auto &device : devicesArray) {
+        os.devices.append(device.toString());
+    }
+
+    QJsonArray capsArray = obj["capabilities"].toArray();
+    os.capabilities.reserve(capsArray.size());
+    for (const auto &cap : capsArray) {
+        os.capabilities.append(cap.toString());
+    }
+
+    os.extractSize = obj["extract_size"].toDouble();
+    os.imageDownloadSize = obj["image_download_size"].toDouble();
+
+    os.random = obj["random"].toBool();
+
+    os.extractSha256 = obj["extract_sha256"].toString();
+    os.bmapUrl = obj["bmap_url"].toString();
+    for (const auto &mirror : obj["mirrors"].toArray()) {
+        os.mirrors.append(mirror.toString());
+    }
+    // Icon source: rewrite to image provider to avoid network head-of-line blocking
+    {
+        const QString rawIcon = obj["icon"].toString();
+        const QString sanitized = sanitizeIconSource(rawIcon);
+        if (!sanitized.isEmpty()) {
+            // If already qrc or local relative, keep as-is. For http(s), route via image://icons/
+            if (sanitized.startsWith("http://") || sanitized.startsWith("https://")) {
+                os.icon = QStringLiteral("image://icons/") + sanitized;
+            } else {
+                os.icon = sanitized;
+            }
+        }
+    }
+    os.initFormat = obj["init_format"].toString();
+    os.releaseDate = obj["release_date"].toString();
+    os.url = obj["url"].toString();
+    os.subitems = obj["subitems"].toArray();
+    os.tooltip = obj["tooltip"].toString();
+    os.website = obj["website"].toString();
+    os.architecture = obj["architecture"].toString();
+    os.enableRPiConnect = obj.value("enable_rpi_connect").toBool(false);
+
+    return os;
+}
+
+bool OSListModel::precedes(const QString &archA, int sourceRowA, const QString &archB, int sourceRowB) const
+{
+    // Entries for the device's architecture first, otherwise in list order
+    if (!_preferredArchitecture.isEmpty()) {
+        const bool aPreferred = archA == _preferredArchitecture;
+        const bool bPreferred = archB == _preferredArchitecture;
+        if (aPreferred != bPreferred) {
+            return aPreferred;
+        }
+    }
+    return sourceRowA < sourceRowB;
+}
+
+int OSListModel::rowForSource(int sourceRow) const
+{
+    return _rows.sourceRows.indexOf(sourceRow);
+}
+
+int OSListModel::insertionRow(const OS &os) const
+{
+    int first = 0;
+    int last = _rows.size();
+    while (first < last) {
+        const int mid = (first + last) / 2;
+        if (precedes(_rows.string(mid, ArchitectureRole), _rows.sourceRows[mid], os.architecture, os.sourceRow)) {
+            first = mid + 1;
+        } else {
+            last = mid;
+        }
+    }
+    return first;
+}
+
 bool OSListModel::reload()
 {
     QElapsedTimer parseTimer;
     parseTimer.start();
-    
-    QJsonDocument doc = _imageWriter.getFilteredOSlistDocument();
-    QJsonObject root = doc.object();
-
-    QJsonArray list = parseOSJson(root);
-    if (list.isEmpty()) {
-        emit eventOsListParse(static_cast<quint32>(parseTimer.elapsed()), false);
-        return false;
-    }
 
     // Get the preferred architecture from the currently selected device
-    QString preferredArchitecture = _imageWriter.getHWList()->currentArchitecture();
-    
-    // Apply architecture-based sorting if device has a preference
-    applyArchitectureSorting(list, preferredArchitecture);
+    _preferredArchitecture = _imageWriter.getHWList()->currentArchitecture();
 
-    beginResetModel();
-    _osList.clear();
-    _osList.reserve(list.count());
+    const int count = _imageWriter.getOSlistEntryCount();
+    const QJsonArray internalEntries = ImageWriter::internalOSlistEntries();
 
-    for (const auto value : list) {
-        const QJsonObject obj = value.toObject();
+    // Entries that are unchanged since the last reload keep their row values;
+    // only new and changed ones are prepared and converted again
+    QHash<int, int> previousRows;
+    previousRows.reserve(_rows.size());
+    for (int i = 0; i < _rows.size(); i++) {
+        previousRows.insert(_rows.sourceRows[i], i);
+    }
+
+    struct Pending {
+        int sourceRow;
+        QString architecture;
+        int previousRow;    // -1 if os has to be stored
         OS os;
+    };
+    QVector<Pending> rows;
+    rows.reserve(count + internalEntries.size());
+
+    auto add = [&](const QJsonObject &source, int sourceRow, bool prepare) {
+        const int previous = previousRows.value(sourceRow, -1);
+        if (previous >= 0 && _rows.sources[previous] == source) {
+            rows.append({sourceRow, _rows.string(previous, ArchitectureRole), previous, OS()});
+            return;
+        }
+        const QJsonObject entry = prepare ? prepareOSEntry(source) : source;
+        if (entry.isEmpty()) {
+            return;
+        }
+        OS os = osFromJson(entry, sourceRow);
+        os.source = source;
+        QString architecture = os.architecture;
+        rows.append({sourceRow, std::move(architecture), -1, std::move(os)});
+    };
+    for (int i = 0; i < count; i++) {
+        add(_imageWriter.getFilteredOSlistEntry(i), i, true);
+    }
+    for (int i = 0; i < internalEntries.size(); i++) {
+        add(internalEntries[i].toObject(), INTERNAL_SOURCE_ROW + i, false);
+    }
 
-        os.name = obj["name"].toString();
-        os.description = obj["description"].toString();
+    // Apply architecture-based sorting if device has a preference
+    std::sort(rows.begin(), rows.end(), [this](const Pending &a, const Pending &b) {
+        return precedes(a.architecture, a.sourceRow, b.architecture, b.sourceRow);
+    });
 
-        QJsonArray devicesArray = obj["devices"].toArray();
-        os.devices.reserve(devicesArray.size());
-        for (const auto &device : devicesArray) {
-            os.devices.append(device.toString());
-        }
+    bool sameRows = rows.size() == _rows.size();
+    for (int i = 0; sameRows && i < rows.size(); i++) {
+        sameRows = rows[i].sourceRow == _rows.sourceRows[i];
+    }
 
-        QJsonArray capsArray = obj["capabilities"].toArray();
-        os.capabilities.reserve(capsArray.size());
-        for (const auto &cap : capsArray) {
-            os.capabilities.append(cap.toString());
+    if (sameRows) {
+        // Same entries in the same order: update the changed rows in place,
+        // so the view keeps its delegates and scroll position
+        const QVector<QVariant> descriptions = _rows.roles[DescriptionRole - NameRole];
+        QVector<bool> stored(rows.size(), false);
+        for (int i = 0; i < rows.size(); i++) {
+            if (rows[i].previousRow < 0) {
+                _rows.store(i, std::move(rows[i].os));
+                stored[i] = true;
+            }
         }
 
-        os.extractSize = obj["extract_size"].toDouble();
-        os.imageDownloadSize = obj["image_download_size"].toDouble();
-
-        os.random = obj["random"].toBool();
+        markFirstAsRecommended();
 
-        os.extractSha256 = obj["extract_sha256"].toString();
-        os.bmapUrl = obj["bmap_url"].toString();
-        // Icon source: rewrite to image provider to avoid network head-of-line blocking
-        {
-            const QString rawIcon = obj["icon"].toString();
-            const QString sanitized = sanitizeIconSource(rawIcon);
-            if (!sanitized.isEmpty()) {
-                // If already qrc or local relative, keep as-is. For http(s), route via image://icons/
-                if (sanitized.startsWith("http://") || sanitized.startsWith("https://")) {
-                    os.icon = QStringLiteral("image://icons/") + sanitized;
-                } else {
-                    os.icon = sanitized;
-                }
+        for (int i = 0; i < rows.size(); i++) {
+            if (stored[i]) {
+                emit dataChanged(index(i), index(i));
+            } else if (_rows.roles[DescriptionRole - NameRole][i] != descriptions[i]) {
+                emit dataChanged(index(i), index(i), {DescriptionRole});
+            }
+        }
+    } else {
+        Columns columns;
+        columns.resize(rows.size());
+        for (int i = 0; i < rows.size(); i++) {
+            if (rows[i].previousRow >= 0) {
+                columns.copy(i, _rows, rows[i].previousRow);
+            } else {
+                columns.store(i, std::move(rows[i].os));
             }
         }
-        os.initFormat = obj["init_format"].toString();
-        os.releaseDate = obj["release_date"].toString();
-        os.url = obj["url"].toString();
-        os.subitemsJson = obj["subitems_json"].toString();
-        os.tooltip = obj["tooltip"].toString();
-        os.website = obj["website"].toString();
-        os.architecture = obj["architecture"].toString();
-        os.enableRPiConnect = obj.value("enable_rpi_connect").toBool(false);
-
-        _osList.append(os);
-    }
 
-    // Mark the first OS as recommended after architecture sorting
-    markFirstAsRecommended();
+        beginResetModel();
+        _rows = std::move(columns);
+
+        // Mark the first OS as recommended after architecture sorting
+        markFirstAsRecommended();
+
+        endResetModel();
+    }
 
-    endResetModel();
-    
     emit eventOsListParse(static_cast<quint32>(parseTimer.elapsed()), true);
 
     return true;
 }
 
+void OSListModel::updateEntries(const QList<int> &sourceRows)
+{
+    // Not loaded yet; the first reload() picks everything up
+    if (_rows.size() == 0) return;
+
+    for (int sourceRow : sourceRows) {
+        const QJsonObject source = _imageWriter.getFilteredOSlistEntry(sourceRow);
+        const int row = rowForSource(sourceRow);
+        if (row >= 0 && _rows.sources[row] == source) {
+            continue;
+        }
+
+        const QJsonObject entry = prepareOSEntry(source);
+        if (entry.isEmpty()) {
+            // Pruned by the HW or init_format filter now that its subitems are known
+            if (row >= 0) {
+                beginRemoveRows(QModelIndex(), row, row);
+                _rows.remove(row);
+                endRemoveRows();
+            }
+            continue;
+        }
+
+        OS os = osFromJson(entry, sourceRow);
+        os.source = source;
+        if (row >= 0) {
+            _rows.store(row, std::move(os));
+            emit dataChanged(index(row), index(row));
+        } else {
+            const int at = insertionRow(os);
+            beginInsertRows(QModelIndex(), at, at);
+            _rows.insert(at);
+            _rows.store(at, std::move(os));
+            endInsertRows();
+        }
+    }
+
+    updateRecommended();
+}
+
 void OSListModel::softRefresh()
 {
-    if (_osList.isEmpty()) return;
+    if (_rows.size() == 0) return;
     const QModelIndex first = index(0);
-    const QModelIndex last = index(_osList.size() - 1);
+    const QModelIndex last = index(_rows.size() - 1);
     emit dataChanged(first, last);
 }
 
 
 int OSListModel::rowCount(const QModelIndex &) const
 {
-    return _osList.size();
+    return _rows.size();
 }
 
 QHash<int, QByteArray> OSListModel::roleNames() const
@@ -384,6 +513,7 @@ QHash<int, QByteArray> OSListModel::roleNames() const
         { CapabilitiesRole, "capabilities" },
         { ExtractSha256Role, "extract_sha256" },
         { BmapUrlRole, "bmap_url" },
+        { MirrorsRole, "mirrors" },
         { ExtractSizeRole, "extract_size" },
         { IconRole, "icon" },
         { ImageDownloadSizeRole, "image_download_size" },
@@ -400,85 +530,82 @@ QHash<int, QByteArray> OSListModel::roleNames() const
 
 QVariant OSListModel::data(const QModelIndex &index, int role) const {
     const int row = index.row();
-    if (row < 0 || row >= _osList.size())
+    if (row < 0 || row >= _rows.size() || role < NameRole || role >= NameRole + RoleCount)
         return {};
 
-    const OS &os = _osList[row];
-
-    switch (OSListRole(role)) {
-        case NameRole:
-            return os.name;
-        case DescriptionRole:
-            return os.description;
-        case DevicesRole:
-            return os.devices;
-        case CapabilitiesRole:
-            return os.capabilities;
-        case ExtractSha256Role:
-            return os.extractSha256;
-        case BmapUrlRole:
-            return os.bmapUrl;
-        case ExtractSizeRole:
-            return os.extractSize;
-        case IconRole:
-            return os.icon;
-        case ImageDownloadSizeRole:
-            return os.imageDownloadSize;
-        case InitFormatRole:
-            return os.initFormat;
-        case ReleaseDataRole:
-            return os.releaseDate;
-        case UrlRole:
-            return os.url;
-        case RandomRole:
-            return os.random;
-        case SubItemsJsonRole:
-            return os.subitemsJson;
-        case TooltipRole:
-            return os.tooltip;
-        case WebsiteRole:
-            return os.website;
-        case ArchitectureRole:
-            return os.architecture;
-        case PiConnectRole:
-            return os.enableRPiConnect;
+    QVariant &value = _rows.roles[role - NameRole][row];
+    if (role == SubItemsJsonRole && !value.isValid()) {
+        // Only entries that are opened, or checked for being a sublist, get
+        // their subitems serialised
+        value = QString::fromUtf8(QJsonDocument(_rows.subitems[row]).toJson());
     }
-
-    return {};
+    return value;
 }
 
 void OSListModel::markFirstAsRecommended() {
     const QString recommendedString = QStringLiteral(" (%1)").arg(tr("Recommended"));
 
-    // First pass: Remove any existing "(Recommended)" labels from all items
-    for (int i = 0; i < _osList.size(); i++) {
-        OS &os = _osList[i];
-        // Remove any variant of the recommended string (handles different locales)
-        if (os.description.contains(QRegularExpression(R"( \([^)]*\bRecommended\b[^)]*\))"))) {
-            os.description.remove(QRegularExpression(R"( \([^)]*\bRecommended\b[^)]*\))"));
-        }
-        // Also remove the localized version if it exists
-        if (os.description.contains(recommendedString)) {
-            os.description.remove(recommendedString);
+    _recommendedSourceRow = -1;
+
+    // First pass: Remove any existing "(Recommended)" label, in whichever
+    // language it was added, by going back to the description in the list
+    for (int i = 0; i < _rows.size(); i++) {
+        const QString original = _rows.sources[i]["description"].toString();
+        if (_rows.string(i, DescriptionRole) != original) {
+            _rows.setDescription(i, original);
         }
     }
 
     // Second pass: Add the localized "(Recommended)" to the first item if appropriate
     // Skip internal items (Erase, Use custom) - these are fallbacks when OS list download fails
-    for (int i = 0; i < _osList.size(); i++) {
-        OS &candidate = _osList[i];
-
+    for (int i = 0; i < _rows.size(); i++) {
         // Skip internal items (e.g., "internal://format", "internal://custom")
-        if (candidate.url.startsWith(QLatin1String("internal://"))) {
+        if (_rows.string(i, UrlRole).startsWith(QLatin1String("internal://"))) {
             continue;
         }
 
         // Found a real OS entry - mark it as recommended if appropriate
-        if (!candidate.description.isEmpty() &&
-            candidate.subitemsJson.isEmpty())
+        const QString description = _rows.string(i, DescriptionRole);
+        if (!description.isEmpty() && _rows.subitems[i].isEmpty())
         {
-            candidate.description += recommendedString;
+            _rows.setDescription(i, description + recommendedString);
+            _recommendedSourceRow = _rows.sourceRows[i];
         }
         break;  // Only mark the first real OS
     }
 }
+
+void OSListModel::updateRecommended()
+{
+    // Same rule as markFirstAsRecommended(), but only touches the rows whose
+    // label changes
+    const QString recommendedString = QStringLiteral(" (%1)").arg(tr("Recommended"));
+
+    int target = -1;
+    for (int i = 0; i < _rows.size(); i++) {
+        if (_rows.string(i, UrlRole).startsWith(QLatin1String("internal://"))) {
+            continue;
+        }
+        if (!_rows.string(i, DescriptionRole).isEmpty() && _rows.subitems[i].isEmpty()) {
+            target = i;
+        }
+        break;
+    }
+
+    const int current = rowForSource(_recommendedSourceRow);
+    if (current >= 0 && current != target) {
+        const QString description = _rows.string(current, DescriptionRole);
+        if (description.endsWith(recommendedString)) {
+            _rows.setDescription(current, description.chopped(recommendedString.size()));
+            emit dataChanged(index(current), index(current), {DescriptionRole});
+        }
+    }
+    if (target >= 0) {
+        const QString description = _rows.string(target, DescriptionRole);
+        if (!description.endsWith(recommendedString)) {
+            _rows.setDescription(target, description + recommendedString);
+            emit dataChanged(index(target), index(target), {DescriptionRole});
+        }
+    }
+    _recommendedSourceRow = target >= 0 ? _rows.sourceRows[target] : -1;
+}
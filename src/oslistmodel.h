@@ -7,6 +7,9 @@
 #define OSLISTMODEL_H
 
 #include <QAbstractItemModel>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <array>
 #ifndef CLI_ONLY_BUILD
 #include <QQmlEngine>
 #endif
@@ -36,6 +39,7 @@ public:
         CapabilitiesRole,
         ExtractSha256Role,
         BmapUrlRole,
+        MirrorsRole,
         ExtractSizeRole,
         IconRole,
         ImageDownloadSizeRole,
@@ -49,6 +53,7 @@ public:
         ArchitectureRole,
         PiConnectRole,
     };
+    static constexpr int RoleCount = PiConnectRole - NameRole + 1;
 
     struct OS {
         QString name;
@@ -59,13 +64,15 @@ public:
         QString initFormat;
         QString releaseDate;
         QString url;
-        QString subitemsJson;
-        QString subitemsUrl;
+        QJsonArray subitems;
         QString tooltip;
         QString website;
         QString extractSha256;
         QString bmapUrl;       // Optional bmap file URL for fastboot DONT_CARE optimisation
+        QStringList mirrors;   // Optional other URLs serving the same image
         QString architecture; // Architecture this OS expects (armel, armhf, armv8)
+        int sourceRow = -1;   // Index of the entry in ImageWriter's top-level OS list
+        QJsonObject source;   // The entry as ImageWriter returned it, before pruning
 
         quint64 imageDownloadSize = 0;
         quint64 extractSize = 0;
@@ -83,19 +90,52 @@ public:
     // Adds "(Recommended)" to the description of the first OS
     Q_INVOKABLE void markFirstAsRecommended();
 
+public slots:
+    // Re-read just these top-level entries (by ImageWriter row) after their
+    // sublists arrived, inserting, updating or removing model rows
+    void updateEntries(const QList<int> &sourceRows);
+
 signals:
     void eventOsListParse(quint32 durationMs, bool success);
 
-public slots:
-
 protected:
     int rowCount(const QModelIndex &) const override;
     QHash<int, QByteArray> roleNames() const override;
     QVariant data(const QModelIndex &index, int role) const override;
 
 private:
-    QVector<OS> _osList;
+    /*
+      Rows in display order, stored column by column. Role values are
+      converted to QVariant once when a row is stored, so data() is a lookup;
+      subitems_json is only serialised when it is first asked for.
+    */
+    struct Columns {
+        QVector<int> sourceRows;
+        QVector<QJsonObject> sources;
+        QVector<QJsonArray> subitems;
+        // Mutable for the lazily filled subitems_json column
+        mutable std::array<QVector<QVariant>, RoleCount> roles;
+
+        int size() const;
+        void resize(int rows);
+        void insert(int at);
+        void remove(int at);
+        void copy(int to, const Columns &from, int row);
+        void store(int row, OS &&os);
+        QString string(int row, OSListRole role) const;
+        void setDescription(int row, const QString &description);
+    };
+
+    static OS osFromJson(const QJsonObject &obj, int sourceRow);
+    bool precedes(const QString &archA, int sourceRowA, const QString &archB, int sourceRowB) const;
+    int rowForSource(int sourceRow) const;
+    int insertionRow(const OS &os) const;
+    void updateRecommended();
+
+    Columns _rows;
     ImageWriter &_imageWriter;
+    QString _preferredArchitecture;
+    int _recommendedSourceRow = -1;
 };
 
 #endif
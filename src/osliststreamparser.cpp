@@ -0,0 +1,122 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "osliststreamparser.h"
+
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonParseError>
+
+QList<QJsonObject> OsListStreamParser::feed(QByteArrayView chunk)
+{
+    QList<QJsonObject> entries;
+    if (_error)
+        return entries;
+
+    // Start of the captured bytes within this chunk
+    qsizetype captureFrom = 0;
+
+    for (qsizetype i = 0; i < chunk.size(); ++i) {
+        const char c = chunk[i];
+
+        if (_inString) {
+            if (_escape) {
+                _escape = false;
+            } else if (c == '\\') {
+                _escape = true;
+            } else if (c == '"') {
+                _inString = false;
+            } else if (_depth == 1) {
+                _string.append(c);
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            _inString = true;
+            if (_depth == 1)
+                _string.clear();
+            break;
+        case ':':
+            if (_depth == 1)
+                _key = _string;
+            break;
+        case '{':
+        case '[':
+            if (_complete || (_depth == 0 && c != '{')) {
+                _error = true;
+                return entries;
+            }
+            if (_depth == 1 && c == '[' && _key == "os_list") {
+                _inList = true;
+            } else if (_capture == Capture::None && c == '{'
+                       && ((_depth == 1 && _key == "imager") || (_depth == 2 && _inList))) {
+                _capture = _depth == 1 ? Capture::Imager : Capture::Entry;
+                _captureDepth = _depth;
+                _captured.clear();
+                captureFrom = i;
+            }
+            ++_depth;
+            break;
+        case '}':
+        case ']':
+            if (_depth == 0) {
+                _error = true;
+                return entries;
+            }
+            --_depth;
+            if (_capture != Capture::None && _depth == _captureDepth) {
+                _captured.append(chunk.data() + captureFrom, i + 1 - captureFrom);
+                if (!_finishCapture(entries))
+                    return entries;
+            }
+            if (_depth == 1)
+                _inList = false;
+            else if (_depth == 0)
+                _complete = true;
+            break;
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            break;
+        default:
+            // Scalars only appear inside the root object
+            if (_depth == 0) {
+                _error = true;
+                return entries;
+            }
+            break;
+        }
+    }
+
+    if (_capture != Capture::None)
+        _captured.append(chunk.data() + captureFrom, chunk.size() - captureFrom);
+    return entries;
+}
+
+bool OsListStreamParser::_finishCapture(QList<QJsonObject> &entries)
+{
+    QJsonParseError parseError{};
+    const QJsonDocument document = QJsonDocument::fromJson(_captured, &parseError);
+    const Capture capture = _capture;
+    _capture = Capture::None;
+    _captured.clear();
+
+    if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+        qDebug() << "OsListStreamParser: cannot parse entry:" << parseError.errorString();
+        _error = true;
+        return false;
+    }
+
+    if (capture == Capture::Imager) {
+        _imager = document.object();
+    } else {
+        entries.append(document.object());
+        ++_entryCount;
+    }
+    return true;
+}
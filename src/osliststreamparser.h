@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef OSLISTSTREAMPARSER_H
+#define OSLISTSTREAMPARSER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QJsonObject>
+#include <QList>
+
+/**
+ * Reads an OS list as it is downloaded, one top-level entry at a time.
+ *
+ * The scanner only follows nesting and strings; the bytes of the entry it
+ * is in are kept, and each entry of "os_list" is parsed on its own once it
+ * is complete. The caller can show the first categories while the rest is
+ * still on the wire, and no document for the whole list is ever built.
+ * "imager" is kept the same way; other members of the root are skipped.
+ *
+ * Entries of "os_list" that are not objects are skipped. Anything that is
+ * not well-formed JSON as far as the scanner can tell, or an entry that
+ * does not parse, puts the parser in error and it ignores the rest.
+ */
+class OsListStreamParser
+{
+public:
+    /**
+     * Scan the next bytes of the body
+     * @return The "os_list" entries they complete, in order
+     */
+    QList<QJsonObject> feed(QByteArrayView chunk);
+
+    bool hasError() const { return _error; }
+
+    // The root object has been closed, and nothing went wrong
+    bool isComplete() const { return _complete && !_error; }
+
+    // Entries returned so far
+    int entryCount() const { return _entryCount; }
+
+    QJsonObject imagerMetadata() const { return _imager; }
+
+private:
+    enum class Capture { None, Entry, Imager };
+
+    bool _finishCapture(QList<QJsonObject> &entries);
+
+    int _depth = 0;
+    bool _inString = false;
+    bool _escape = false;
+    bool _inList = false;  // Inside the "os_list" array
+    bool _complete = false;
+    bool _error = false;
+
+    // Strings of the root object, to know which member a value belongs to
+    QByteArray _string;
+    QByteArray _key;
+
+    Capture _capture = Capture::None;
+    int _captureDepth = 0;  // Depth at which the captured value ends
+    QByteArray _captured;
+
+    int _entryCount = 0;
+    QJsonObject _imager;
+};
+
+#endif // OSLISTSTREAMPARSER_H
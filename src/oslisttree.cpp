@@ -0,0 +1,308 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "oslisttree.h"
+
+#include <QDebug>
+
+#include <QStringList>
+
+#include <algorithm>
+
+namespace {
+    // Filters remembered at once; a device step rarely sees more
+    constexpr int MAX_CACHED_FILTERS = 16;
+
+    void setBit(std::vector<quint64> &set, int bit)
+    {
+        const size_t word = static_cast<size_t>(bit) / 64;
+        if (set.size() <= word)
+            set.resize(word + 1, 0);
+        set[word] |= quint64(1) << (bit % 64);
+    }
+
+    void unite(std::vector<quint64> &set, const std::vector<quint64> &other)
+    {
+        if (set.size() < other.size())
+            set.resize(other.size(), 0);
+        for (size_t i = 0; i < other.size(); ++i)
+            set[i] |= other[i];
+    }
+
+    bool intersects(const std::vector<quint64> &a, const std::vector<quint64> &b)
+    {
+        const size_t n = std::min(a.size(), b.size());
+        for (size_t i = 0; i < n; ++i) {
+            if (a[i] & b[i])
+                return true;
+        }
+        return false;
+    }
+}
+
+OsListTree::OsListTree(const QJsonDocument &document)
+{
+    if (!document.isObject())
+        return;
+
+    const QJsonObject root = document.object();
+    _imager = root.value("imager").toObject();
+    const QJsonArray list = root.value("os_list").toArray();
+    _topLevel.reserve(static_cast<size_t>(list.size()));
+    for (const auto &value : list)
+        _topLevel.push_back(buildNode(value.toObject(), nullptr, static_cast<int>(_topLevel.size())));
+    _present = true;
+}
+
+void OsListTree::clear()
+{
+    _topLevel.clear();
+    _imager = QJsonObject();
+    _bySubitemsUrl.clear();
+    _tagBits.clear();
+    _searchIndex.clear();
+    _searchNodes.clear();
+    _filters.clear();
+    _present = false;
+    _document = QJsonDocument();
+    _documentValid = false;
+}
+
+void OsListTree::setImagerMetadata(const QJsonObject &imager)
+{
+    _imager = imager;
+    _documentValid = false;
+}
+
+void OsListTree::appendTopLevel(const QJsonObject &entry)
+{
+    _topLevel.push_back(buildNode(entry, nullptr, static_cast<int>(_topLevel.size())));
+    _present = true;
+    _documentValid = false;
+    for (auto &filter : _filters) {
+        filter.rows.resize(_topLevel.size());
+        filter.valid.push_back(false);
+    }
+}
+
+std::unique_ptr<OsListTree::Node> OsListTree::buildNode(const QJsonObject &object, Node *parent, int topLevelRow)
+{
+    auto node = std::make_unique<Node>();
+    node->fields = object;
+    node->parent = parent;
+    node->depth = parent ? parent->depth + 1 : 1;
+    node->topLevelRow = topLevelRow;
+
+    QString searchText = object.value("description").toString();
+    if (object.contains("devices")) {
+        node->tagged = true;
+        for (const auto &tag : object.value("devices").toArray()) {
+            const QString name = tag.toString();
+            auto it = _tagBits.constFind(name);
+            if (it == _tagBits.constEnd())
+                it = _tagBits.insert(name, static_cast<int>(_tagBits.size()));
+            setBit(node->devices, it.value());
+            searchText += QLatin1Char(' ') + name;
+        }
+    }
+    _searchIndex.add(object.value("name").toString(), searchText);
+    _searchNodes.push_back(node.get());
+
+    if (object.contains("subitems")) {
+        node->fields.remove("subitems");
+        buildChildren(node.get(), object.value("subitems").toArray());
+    } else {
+        if (object.contains("subitems_url"))
+            _bySubitemsUrl[object.value("subitems_url").toString()].append(node.get());
+        updateSubtreeDevices(node.get());
+    }
+    return node;
+}
+
+void OsListTree::buildChildren(Node *node, const QJsonArray &items)
+{
+    node->hasSubitems = true;
+    if (node->depth + 1 > MaxDepth) {
+        qDebug() << "Aborting insertion of subitems, exceeded maximum configured limit of " << MaxDepth << " levels.";
+        return;
+    }
+
+    node->subitems.reserve(static_cast<size_t>(items.size()));
+    for (const auto &value : items)
+        node->subitems.push_back(buildNode(value.toObject(), node, node->topLevelRow));
+    updateSubtreeDevices(node);
+}
+
+void OsListTree::updateSubtreeDevices(Node *node)
+{
+    if (!node->hasSubitems) {
+        node->subtreeDevices = node->devices;
+        node->subtreeUntagged = !node->tagged;
+        return;
+    }
+
+    node->subtreeDevices.clear();
+    node->subtreeUntagged = false;
+    for (const auto &child : node->subitems) {
+        unite(node->subtreeDevices, child->subtreeDevices);
+        node->subtreeUntagged = node->subtreeUntagged || child->subtreeUntagged;
+    }
+}
+
+QList<int> OsListTree::insertSublist(const QString &url, const QJsonArray &items)
+{
+    QList<int> rows;
+    const QList<Node *> waiting = _bySubitemsUrl.take(url);
+    for (Node *node : waiting) {
+        node->fields.remove("subitems_url");
+        buildChildren(node, items);
+        for (Node *ancestor = node->parent; ancestor; ancestor = ancestor->parent)
+            updateSubtreeDevices(ancestor);
+        rows.append(node->topLevelRow);
+    }
+
+    if (!rows.isEmpty()) {
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+        _documentValid = false;
+        for (auto &filter : _filters) {
+            for (int row : rows)
+                filter.valid[static_cast<size_t>(row)] = false;
+        }
+    }
+    return rows;
+}
+
+QJsonObject OsListTree::topLevelEntry(int row) const
+{
+    if (row < 0 || row >= topLevelCount())
+        return {};
+    return toJson(*_topLevel[static_cast<size_t>(row)]);
+}
+
+QJsonObject OsListTree::toJson(const Node &node)
+{
+    if (!node.hasSubitems)
+        return node.fields;
+
+    QJsonArray subitems;
+    for (const auto &child : node.subitems)
+        subitems.append(toJson(*child));
+    QJsonObject object = node.fields;
+    object.insert("subitems", subitems);
+    return object;
+}
+
+QJsonDocument OsListTree::toDocument() const
+{
+    if (!_present)
+        return {};
+
+    if (!_documentValid) {
+        QJsonArray list;
+        for (const auto &node : _topLevel)
+            list.append(toJson(*node));
+        _document = QJsonDocument(QJsonObject({
+            {"imager", _imager},
+            {"os_list", list}
+        }));
+        _documentValid = true;
+    }
+    return _document;
+}
+
+OsListTree::FilterCache &OsListTree::filterFor(const QJsonArray &deviceTags, bool inclusive) const
+{
+    QStringList tags;
+    tags.reserve(deviceTags.size());
+    for (const auto &tag : deviceTags)
+        tags.append(tag.toString());
+    tags.sort();
+    const QString key = (inclusive ? QStringLiteral("+") : QStringLiteral("-")) + tags.join(QLatin1Char('\n'));
+
+    auto it = _filters.find(key);
+    if (it == _filters.end()) {
+        if (_filters.size() >= MAX_CACHED_FILTERS)
+            _filters.clear();
+        it = _filters.insert(key, FilterCache());
+        it->inclusive = inclusive;
+        it->rows.resize(_topLevel.size());
+        it->valid.assign(_topLevel.size(), false);
+    }
+
+    // Tags a sublist introduced after the mask was built may now match
+    if (it->tagCount != _tagBits.size()) {
+        it->mask.clear();
+        for (const QString &tag : std::as_const(tags)) {
+            const auto bit = _tagBits.constFind(tag);
+            if (bit != _tagBits.constEnd())
+                setBit(it->mask, bit.value());
+        }
+        it->tagCount = static_cast<int>(_tagBits.size());
+    }
+    return it.value();
+}
+
+bool OsListTree::keeps(const Node &node, const FilterCache &filter)
+{
+    return intersects(node.subtreeDevices, filter.mask) || (filter.inclusive && node.subtreeUntagged);
+}
+
+QJsonObject OsListTree::filteredJson(const Node &node, const FilterCache &filter)
+{
+    if (!node.hasSubitems)
+        return node.fields;
+
+    QJsonArray subitems;
+    for (const auto &child : node.subitems) {
+        if (keeps(*child, filter))
+            subitems.append(filteredJson(*child, filter));
+    }
+    QJsonObject object = node.fields;
+    object.insert("subitems", subitems);
+    return object;
+}
+
+QJsonObject OsListTree::filteredTopLevelEntry(int row, const QJsonArray &deviceTags, bool inclusive) const
+{
+    if (row < 0 || row >= topLevelCount())
+        return {};
+
+    FilterCache &filter = filterFor(deviceTags, inclusive);
+    const size_t i = static_cast<size_t>(row);
+    if (!filter.valid[i]) {
+        const Node &node = *_topLevel[i];
+        filter.rows[i] = keeps(node, filter) ? filteredJson(node, filter) : QJsonObject();
+        filter.valid[i] = true;
+    }
+    return filter.rows[i];
+}
+
+QJsonArray OsListTree::filteredList(const QJsonArray &deviceTags, bool inclusive) const
+{
+    QJsonArray list;
+    for (int row = 0; row < topLevelCount(); ++row) {
+        const QJsonObject entry = filteredTopLevelEntry(row, deviceTags, inclusive);
+        if (!entry.isEmpty())
+            list.append(entry);
+    }
+    return list;
+}
+
+QJsonArray OsListTree::search(const QString &query, const QJsonArray &deviceTags, bool inclusive, int limit) const
+{
+    const FilterCache *filter = deviceTags.isEmpty() ? nullptr : &filterFor(deviceTags, inclusive);
+    QJsonArray results;
+    // Ask for more than limit, since the device filter drops some
+    for (int id : _searchIndex.search(query, filter ? limit * 4 : limit)) {
+        const Node &node = *_searchNodes[static_cast<size_t>(id)];
+        if (filter && !keeps(node, *filter))
+            continue;
+        results.append(filter ? filteredJson(node, *filter) : toJson(node));
+        if (results.size() == limit)
+            break;
+    }
+    return results;
+}
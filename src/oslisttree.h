@@ -0,0 +1,147 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef OSLISTTREE_H
+#define OSLISTTREE_H
+
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+#include "ossearchindex.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * The merged OS list as a mutable tree.
+ *
+ * The top-level list names further lists by subitems_url; as each of those
+ * arrives it is spliced in under every entry that refers to it. Entries are
+ * indexed by subitems_url, so a splice costs the size of the incoming list
+ * rather than a rebuild of the whole document.
+ *
+ * The JSON form is only produced on request and is cached until the tree
+ * next changes.
+ *
+ * Each leaf's "devices" tags are recorded as a bitset when it is added, and
+ * every node keeps the union over its subtree, so the hardware filter is a
+ * mask test per node. Filtered entries are cached per filter, and a splice
+ * only invalidates the rows it touched, so switching back and forth between
+ * devices does not walk the list again.
+ *
+ * Each entry's name, description and device tags go into a search index as
+ * it is added, sublists included, so search() does not walk the list either.
+ */
+class OsListTree
+{
+public:
+    // Nesting limit for subitems, counting the top-level list as 1
+    static constexpr int MaxDepth = 16;
+
+    OsListTree() = default;
+    explicit OsListTree(const QJsonDocument &document);
+    OsListTree(OsListTree &&) = default;
+    OsListTree &operator=(OsListTree &&) = default;
+    OsListTree(const OsListTree &) = delete;
+    OsListTree &operator=(const OsListTree &) = delete;
+
+    bool isEmpty() const { return !_present; }
+    void clear();
+
+    QJsonObject imagerMetadata() const { return _imager; }
+    void setImagerMetadata(const QJsonObject &imager);
+
+    // Add an entry to the end of the top-level list, as it streams in
+    void appendTopLevel(const QJsonObject &entry);
+
+    /**
+     * Put items in place of every entry whose subitems_url is url
+     * @return Indexes of the top-level entries that changed, in order
+     */
+    QList<int> insertSublist(const QString &url, const QJsonArray &items);
+
+    int topLevelCount() const { return static_cast<int>(_topLevel.size()); }
+    QJsonObject topLevelEntry(int row) const;
+
+    // {"imager": ..., "os_list": [...]}
+    QJsonDocument toDocument() const;
+
+    /**
+     * The list keeping only what matches the device tags: a leaf is kept if
+     * it names one of the tags, or if it names none and inclusive is set; an
+     * entry with subitems is kept if any of them is. Filtered-out top-level
+     * entries come back as an empty object.
+     */
+    QJsonObject filteredTopLevelEntry(int row, const QJsonArray &deviceTags, bool inclusive) const;
+    QJsonArray filteredList(const QJsonArray &deviceTags, bool inclusive) const;
+
+    /**
+     * Entries at any depth whose name, description or device tags contain
+     * every word of query (see OsSearchIndex), as filtered by the device
+     * tags. Entries with subitems come with their filtered subitems.
+     */
+    QJsonArray search(const QString &query, const QJsonArray &deviceTags, bool inclusive, int limit) const;
+
+private:
+    using DeviceSet = std::vector<quint64>;
+
+    struct Node {
+        QJsonObject fields;  // Everything but "subitems"
+        std::vector<std::unique_ptr<Node>> subitems;
+        Node *parent = nullptr;
+        bool hasSubitems = false;
+        int depth = 1;
+        int topLevelRow = 0;
+
+        // A leaf's own "devices", and the union over all leaves below
+        DeviceSet devices;
+        bool tagged = false;
+        DeviceSet subtreeDevices;
+        bool subtreeUntagged = false;
+    };
+
+    struct FilterCache {
+        DeviceSet mask;
+        int tagCount = -1;
+        bool inclusive = false;
+        std::vector<QJsonObject> rows;
+        std::vector<bool> valid;
+    };
+
+    std::unique_ptr<Node> buildNode(const QJsonObject &object, Node *parent, int topLevelRow);
+    void buildChildren(Node *node, const QJsonArray &items);
+    static void updateSubtreeDevices(Node *node);
+    static QJsonObject toJson(const Node &node);
+
+    FilterCache &filterFor(const QJsonArray &deviceTags, bool inclusive) const;
+    static bool keeps(const Node &node, const FilterCache &filter);
+    static QJsonObject filteredJson(const Node &node, const FilterCache &filter);
+
+    std::vector<std::unique_ptr<Node>> _topLevel;
+    QJsonObject _imager;
+    bool _present = false;
+
+    // Entries still waiting for their sublist
+    QHash<QString, QList<Node *>> _bySubitemsUrl;
+
+    // Bit position of each device tag seen so far
+    QHash<QString, int> _tagBits;
+
+    // Every node, by search index document id
+    OsSearchIndex _searchIndex;
+    std::vector<Node *> _searchNodes;
+
+    // Keyed by inclusive flag and the sorted tags
+    mutable QHash<QString, FilterCache> _filters;
+
+    mutable QJsonDocument _document;
+    mutable bool _documentValid = false;
+};
+
+#endif // OSLISTTREE_H
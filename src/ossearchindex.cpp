@@ -0,0 +1,140 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "ossearchindex.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    constexpr int TRIGRAM = 3;
+    // Prefix grams of one and two characters, only at the start of a word
+    constexpr int MAX_PREFIX = 2;
+}
+
+quint64 OsSearchIndex::gram(const QChar *chars, int length)
+{
+    // Length in the top bits keeps prefixes apart from trigrams
+    quint64 key = quint64(length) << 48;
+    for (int i = 0; i < length; ++i)
+        key |= quint64(chars[i].unicode()) << (32 - 16 * i);
+    return key;
+}
+
+QStringList OsSearchIndex::words(const QString &text)
+{
+    QStringList words;
+    const QString folded = text.toCaseFolded();
+    qsizetype start = -1;
+    for (qsizetype i = 0; i <= folded.size(); ++i) {
+        const bool wordChar = i < folded.size() && folded.at(i).isLetterOrNumber();
+        if (wordChar && start < 0) {
+            start = i;
+        } else if (!wordChar && start >= 0) {
+            words.append(folded.mid(start, i - start));
+            start = -1;
+        }
+    }
+    return words;
+}
+
+int OsSearchIndex::add(const QString &name, const QString &text)
+{
+    const int id = size();
+    Document document;
+    document.name = words(name).join(QLatin1Char(' '));
+    document.text = document.name + QLatin1Char(' ') + words(text).join(QLatin1Char(' '));
+
+    std::vector<quint64> grams;
+    for (const QString &word : words(document.text)) {
+        for (int length = 1; length <= std::min<int>(MAX_PREFIX, word.size()); ++length)
+            grams.push_back(gram(word.constData(), length));
+        for (qsizetype i = 0; i + TRIGRAM <= word.size(); ++i)
+            grams.push_back(gram(word.constData() + i, TRIGRAM));
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    for (quint64 key : grams)
+        _postings[key].push_back(id);
+
+    _documents.push_back(std::move(document));
+    return id;
+}
+
+void OsSearchIndex::clear()
+{
+    _postings.clear();
+    _documents.clear();
+}
+
+std::vector<int> OsSearchIndex::candidates(const QString &word) const
+{
+    if (word.size() <= MAX_PREFIX)
+        return _postings.value(gram(word.constData(), static_cast<int>(word.size())));
+
+    // Intersect the trigrams' lists, shortest first so the result shrinks fast
+    std::vector<const std::vector<int> *> lists;
+    for (qsizetype i = 0; i + TRIGRAM <= word.size(); ++i) {
+        const auto it = _postings.constFind(gram(word.constData() + i, TRIGRAM));
+        if (it == _postings.constEnd())
+            return {};
+        lists.push_back(&it.value());
+    }
+    std::sort(lists.begin(), lists.end(), [](const auto *a, const auto *b) { return a->size() < b->size(); });
+
+    std::vector<int> result = *lists.front();
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        std::vector<int> narrowed;
+        std::set_intersection(result.begin(), result.end(), lists[i]->begin(), lists[i]->end(),
+                              std::back_inserter(narrowed));
+        result = std::move(narrowed);
+    }
+    return result;
+}
+
+QList<int> OsSearchIndex::search(const QString &query, int limit) const
+{
+    const QStringList queryWords = words(query);
+    if (queryWords.isEmpty() || limit <= 0)
+        return {};
+
+    std::vector<int> matches = candidates(queryWords.first());
+    for (qsizetype i = 1; i < queryWords.size() && !matches.empty(); ++i) {
+        const std::vector<int> found = candidates(queryWords.at(i));
+        std::vector<int> narrowed;
+        std::set_intersection(matches.begin(), matches.end(), found.begin(), found.end(),
+                              std::back_inserter(narrowed));
+        matches = std::move(narrowed);
+    }
+
+    // Trigrams can all occur without the word doing so, and the name only
+    // ranks first if it holds every word itself
+    QList<int> byName;
+    QList<int> byText;
+    for (int id : matches) {
+        const Document &document = _documents[static_cast<size_t>(id)];
+        bool inText = true;
+        bool inName = true;
+        for (const QString &word : queryWords) {
+            if (word.size() > MAX_PREFIX && !document.text.contains(word)) {
+                inText = false;
+                break;
+            }
+            inName = inName && document.name.contains(word);
+        }
+        if (!inText)
+            continue;
+        if (inName) {
+            byName.append(id);
+            if (byName.size() == limit)
+                break;
+        } else if (byText.size() < limit) {
+            byText.append(id);
+        }
+    }
+
+    byName.append(byText.mid(0, limit - byName.size()));
+    return byName;
+}
@@ -0,0 +1,67 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef OSSEARCHINDEX_H
+#define OSSEARCHINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+/**
+ * Full-text index over the entries of the OS list.
+ *
+ * Every word of a document is split into trigrams, and its first one and
+ * two characters are recorded as prefixes. A query word of three or more
+ * characters is looked up by intersecting the posting lists of its
+ * trigrams, and the few candidates left are checked against the text; a
+ * shorter word is looked up by prefix. A search therefore costs the size
+ * of the smallest posting lists involved, not a walk over the list.
+ *
+ * Documents are only ever added, with increasing ids, so posting lists
+ * stay sorted without sorting them.
+ */
+class OsSearchIndex
+{
+public:
+    /**
+     * Index a document
+     * @param name Matched like text, but ranked first
+     * @param text Everything else to match: description, tags
+     * @return The document's id, one more than the previous
+     */
+    int add(const QString &name, const QString &text);
+
+    void clear();
+    int size() const { return static_cast<int>(_documents.size()); }
+
+    /**
+     * Documents containing every word of query, case insensitive. Those
+     * whose name contains all of the words come first; within each group
+     * documents are in the order they were added.
+     * @param limit Most ids returned
+     */
+    QList<int> search(const QString &query, int limit) const;
+
+    // Case folded words of text, split at anything not a letter or digit
+    static QStringList words(const QString &text);
+
+private:
+    struct Document {
+        QString name;   // Case folded
+        QString text;   // Case folded name and text
+    };
+
+    static quint64 gram(const QChar *chars, int length);
+    std::vector<int> candidates(const QString &word) const;
+
+    QHash<quint64, std::vector<int>> _postings;
+    std::vector<Document> _documents;
+};
+
+#endif // OSSEARCHINDEX_H
@@ -0,0 +1,626 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "parallelgzipdecoder.h"
+#include "threadplacement.h"
+#include "threadcputime.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QtConcurrent/qtconcurrentrun.h>
+#include <cstring>
+
+// Furthest a deflate back-reference can reach
+static constexpr size_t WINDOW_SIZE = 32768;
+// Compressed bytes between cuts
+static constexpr size_t CHUNK_SIZE = 2 * 1024 * 1024;
+// A chunk stops at the next block boundary once it has decoded this much;
+// the rest up to the next cut is decoded sequentially. Binary data can keep
+// copying from the window for megabytes, so the speculative runs may last
+// as long as the chunk.
+static constexpr size_t CHUNK_OUTPUT_LIMIT = 16 * 1024 * 1024;
+// Memory a queued chunk may take: output plus the two speculative runs
+static constexpr quint64 CHUNK_COST = 3 * CHUNK_OUTPUT_LIMIT;
+// How far a candidate block start has to decode before a chunk starts there
+static constexpr size_t PROBE_OUTPUT = 32 * 1024;
+static constexpr size_t MIN_GROW = 1024 * 1024;
+static constexpr uint64_t NO_BLOCK = UINT64_MAX;
+
+struct ParallelGzipDecoder::ChunkJob
+{
+    uint64_t fromBit;               // Cut the chunk starts after
+    uint64_t toBit;                 // Cut the next chunk starts after
+    std::atomic<bool> cancelled{false};
+
+    uint64_t startBit = NO_BLOCK;   // Block the chunk was decoded from
+    uint64_t endBit = 0;            // Block boundary decoding stopped at
+    bool streamEnd = false;         // endBit is the end of the final block
+    bool ok = false;
+    QByteArray output;
+    // Output before prefix may have been copied from the unknown window;
+    // high and inverse hold the same bytes decoded over the other two
+    // dictionaries
+    size_t prefix = 0;
+    QByteArray high;
+    QByteArray inverse;
+    QFuture<void> future;
+};
+
+namespace {
+
+/*
+ * Window stand-ins for speculative decoding. Position i of the window is
+ * low[i] = i & 0xff and high[i] = i >> 8; inverse[i] = ~low[i] tells
+ * copied bytes from literals, which come out the same in every run.
+ */
+struct Dictionaries
+{
+    uint8_t low[WINDOW_SIZE];
+    uint8_t high[WINDOW_SIZE];
+    uint8_t inverse[WINDOW_SIZE];
+
+    Dictionaries()
+    {
+        for (size_t i = 0; i < WINDOW_SIZE; ++i)
+        {
+            low[i] = static_cast<uint8_t>(i & 0xff);
+            high[i] = static_cast<uint8_t>(i >> 8);
+            inverse[i] = static_cast<uint8_t>(~i & 0xff);
+        }
+    }
+};
+
+const Dictionaries &dictionaries()
+{
+    static const Dictionaries dict;
+    return dict;
+}
+
+/*
+ * Raw inflate starting at any block boundary. next() returns at the end of
+ * every block, so the caller always knows the bit position.
+ */
+class RawInflater
+{
+public:
+    enum Result { BlockEnd, StreamEnd, OutputFull, Error };
+
+    RawInflater()
+        : _data(nullptr), _end(nullptr), _initialised(false)
+    {
+        ::memset(&_strm, 0, sizeof(_strm));
+    }
+
+    ~RawInflater()
+    {
+        if (_initialised)
+            inflateEnd(&_strm);
+    }
+
+    RawInflater(const RawInflater &) = delete;
+    RawInflater &operator=(const RawInflater &) = delete;
+
+    bool begin(const uint8_t *data, size_t len, uint64_t bit, const uint8_t *dict, size_t dictLen)
+    {
+        if (!_initialised)
+        {
+            if (inflateInit2(&_strm, -15) != Z_OK)
+                return false;
+            _initialised = true;
+        }
+        else if (inflateReset(&_strm) != Z_OK)
+            return false;
+
+        if (dictLen && inflateSetDictionary(&_strm, dict, static_cast<uInt>(dictLen)) != Z_OK)
+            return false;
+
+        size_t byte = static_cast<size_t>(bit / 8);
+        int shift = static_cast<int>(bit % 8);
+        if (byte >= len)
+            return false;
+        if (shift && inflatePrime(&_strm, 8 - shift, data[byte] >> shift) != Z_OK)
+            return false;
+        if (shift)
+            byte++;
+
+        _data = data;
+        _end = data + len;
+        _strm.next_in = const_cast<Bytef *>(data + byte);
+        _strm.avail_in = 0;
+        return true;
+    }
+
+    Result next(uint8_t *out, size_t room, size_t &produced)
+    {
+        produced = 0;
+        while (true)
+        {
+            uInt inChunk = static_cast<uInt>(qMin<size_t>(static_cast<size_t>(_end - _strm.next_in), UINT_MAX));
+            uInt outChunk = static_cast<uInt>(qMin<size_t>(room - produced, UINT_MAX));
+            _strm.avail_in = inChunk;
+            _strm.next_out = out + produced;
+            _strm.avail_out = outChunk;
+            int ret = inflate(&_strm, Z_BLOCK);
+            produced += outChunk - _strm.avail_out;
+
+            if (ret == Z_STREAM_END)
+                return StreamEnd;
+            if (ret != Z_OK && ret != Z_BUF_ERROR)
+                return Error;
+            if (_strm.data_type & 128)
+                return BlockEnd;
+            if (produced == room)
+                return OutputFull;
+            if (ret == Z_BUF_ERROR || _strm.next_in == _end)
+                return Error;   // Truncated
+        }
+    }
+
+    // Only meaningful at a block boundary or the end of the stream
+    uint64_t bitPosition() const
+    {
+        return static_cast<uint64_t>(_strm.next_in - _data) * 8 - static_cast<uint64_t>(_strm.data_type & 7);
+    }
+
+private:
+    z_stream _strm;
+    const uint8_t *_data;
+    const uint8_t *_end;
+    bool _initialised;
+};
+
+// Decode exactly len bytes
+bool inflateExactly(RawInflater &inflater, uint8_t *out, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        size_t produced;
+        RawInflater::Result result = inflater.next(out + done, len - done, produced);
+        done += produced;
+        if (result == RawInflater::Error || (result == RawInflater::StreamEnd && done < len))
+            return false;
+    }
+    return true;
+}
+
+uint64_t load64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+/*
+ * First bit in [fromBit, toBit) where a non-final dynamic Huffman block
+ * plausibly starts: valid header counts, a complete code length code, and
+ * zlib can decode PROBE_OUTPUT bytes or up to the end of the block from
+ * there. False positives are possible; delivery rejects them.
+ */
+uint64_t findBlock(const uint8_t *data, size_t len, uint64_t fromBit, uint64_t toBit,
+                   const std::atomic<bool> &cancelled)
+{
+    // The header and 19 code length code lengths take 74 bits
+    if (len < 16)
+        return NO_BLOCK;
+    const uint64_t lastBit = qMin<uint64_t>(toBit, static_cast<uint64_t>(len - 11) * 8);
+
+    RawInflater probe;
+    std::unique_ptr<uint8_t[]> out(new uint8_t[PROBE_OUTPUT]);
+    for (uint64_t bit = fromBit; bit < lastBit; ++bit)
+    {
+        if ((bit & 0xffff) == 0 && cancelled)
+            break;
+
+        uint64_t bits = load64(data + bit / 8) >> (bit % 8);
+        // BFINAL 0, BTYPE 2
+        if ((bits & 7) != 4)
+            continue;
+        unsigned hlit = (bits >> 3) & 31;
+        unsigned hdist = (bits >> 8) & 31;
+        if (hlit > 29 || hdist > 29)
+            continue;
+        unsigned hclen = static_cast<unsigned>((bits >> 13) & 15) + 4;
+
+        // zlib only accepts a complete code length code
+        uint64_t lengths = load64(data + (bit + 17) / 8) >> ((bit + 17) % 8);
+        unsigned kraft = 0;
+        for (unsigned i = 0; i < hclen; ++i)
+        {
+            unsigned l = (lengths >> (3 * i)) & 7;
+            if (l)
+                kraft += 128 >> l;
+        }
+        if (kraft != 128)
+            continue;
+
+        size_t produced;
+        if (probe.begin(data, len, bit, dictionaries().low, WINDOW_SIZE)
+            && probe.next(out.get(), PROBE_OUTPUT, produced) != RawInflater::Error)
+            return bit;
+    }
+    return NO_BLOCK;
+}
+
+// Length of the gzip member header at data, 0 if there is none
+size_t gzipHeaderLength(const uint8_t *data, size_t len)
+{
+    if (len < 10 || data[0] != 0x1f || data[1] != 0x8b || data[2] != 8 || (data[3] & 0xe0))
+        return 0;
+
+    const uint8_t flags = data[3];
+    size_t pos = 10;
+    if (flags & 0x04)   // FEXTRA
+    {
+        if (len < pos + 2)
+            return 0;
+        pos += 2 + (data[pos] | (data[pos + 1] << 8));
+    }
+    auto skipString = [&]() {
+        while (pos < len && data[pos])
+            pos++;
+        pos++;
+    };
+    if (flags & 0x08)   // FNAME
+        skipString();
+    if (flags & 0x10)   // FCOMMENT
+        skipString();
+    if (flags & 0x02)   // FHCRC
+        pos += 2;
+    return pos < len ? pos : 0;
+}
+
+uint32_t load32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8)
+         | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+} // namespace
+
+ParallelGzipDecoder::ParallelGzipDecoder(const char *data, size_t len, std::shared_ptr<RingBuffer> output,
+                                         int threads, quint64 maxInFlightBytes, QObject *parent)
+    : DecoderThread(nullptr, nullptr, std::move(output), threads, parent)
+    , _data(reinterpret_cast<const uint8_t *>(data))
+    , _len(len)
+    , _maxJobs(static_cast<size_t>(qBound<quint64>(1, maxInFlightBytes / CHUNK_COST, static_cast<quint64>(_threads) * 2)))
+    , _nextChunk(1)
+    , _bit(0)
+    , _crc(0)
+    , _memberSize(0)
+{
+}
+
+ParallelGzipDecoder::~ParallelGzipDecoder()
+{
+    cancel();
+    wait();
+}
+
+/*
+ * Decode one chunk from the first plausible block after its cut. Runs on
+ * the decoder's thread pool.
+ */
+void ParallelGzipDecoder::_decodeChunk(const uint8_t *data, size_t len, ChunkJob &job)
+{
+    job.startBit = findBlock(data, len, job.fromBit, job.toBit, job.cancelled);
+    if (job.startBit == NO_BLOCK)
+        return;
+
+    const Dictionaries &dict = dictionaries();
+    RawInflater runs[3];
+    const uint8_t *dicts[3] = { dict.low, dict.high, dict.inverse };
+    QByteArray *outputs[3] = { &job.output, &job.high, &job.inverse };
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!runs[i].begin(data, len, job.startBit, dicts[i], WINDOW_SIZE))
+            return;
+    }
+
+    bool speculative = true;
+    size_t used = 0;
+    size_t literalsFrom = 0;    // No output from here on was copied from the window
+    RawInflater::Result result = RawInflater::Error;
+    while (!job.cancelled)
+    {
+        const int active = speculative ? 3 : 1;
+        if (static_cast<size_t>(job.output.size()) - used < MIN_GROW)
+        {
+            qsizetype size = static_cast<qsizetype>(used + qMax(MIN_GROW, used / 2));
+            for (int i = 0; i < active; ++i)
+                outputs[i]->resize(size);
+        }
+
+        uint8_t *out = reinterpret_cast<uint8_t *>(job.output.data());
+        size_t produced;
+        result = runs[0].next(out + used, static_cast<size_t>(job.output.size()) - used, produced);
+        if (result == RawInflater::Error)
+            return;
+
+        if (speculative)
+        {
+            for (int i = 1; i < 3; ++i)
+            {
+                if (!inflateExactly(runs[i], reinterpret_cast<uint8_t *>(outputs[i]->data()) + used, produced))
+                    return;
+            }
+            const uint8_t *inverse = reinterpret_cast<const uint8_t *>(job.inverse.constData());
+            for (size_t k = used; k < used + produced; ++k)
+            {
+                if (out[k] != inverse[k])
+                    literalsFrom = k + 1;
+            }
+        }
+        used += produced;
+
+        if (speculative && used - literalsFrom >= WINDOW_SIZE)
+        {
+            // Later output can only copy from literals, so one run is enough
+            speculative = false;
+            job.prefix = used;
+            job.high.resize(static_cast<qsizetype>(used));
+            job.high.squeeze();
+            job.inverse.resize(static_cast<qsizetype>(used));
+            job.inverse.squeeze();
+        }
+
+        if (result == RawInflater::StreamEnd)
+            break;
+        if (result == RawInflater::BlockEnd
+            && (runs[0].bitPosition() >= job.toBit || used >= CHUNK_OUTPUT_LIMIT))
+            break;
+    }
+    if (job.cancelled)
+        return;
+
+    if (speculative)
+        job.prefix = used;
+    job.streamEnd = result == RawInflater::StreamEnd;
+    job.endBit = runs[0].bitPosition();
+    job.output.resize(static_cast<qsizetype>(used));
+    job.ok = true;
+}
+
+void ParallelGzipDecoder::_queueJobs()
+{
+    const size_t chunks = (_len + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    while (_nextChunk < chunks && _jobs.size() < _maxJobs)
+    {
+        uint64_t fromBit = static_cast<uint64_t>(_nextChunk) * CHUNK_SIZE * 8;
+        uint64_t toBit = static_cast<uint64_t>(qMin(_len, (_nextChunk + 1) * CHUNK_SIZE)) * 8;
+        _nextChunk++;
+        if (toBit <= _bit)
+            continue;   // Sequential decoding has already passed it
+
+        auto job = std::make_unique<ChunkJob>();
+        job->fromBit = fromBit;
+        job->toBit = toBit;
+        ChunkJob *j = job.get();
+        const uint8_t *data = _data;
+        size_t len = _len;
+        job->future = QtConcurrent::run(&_pool, [data, len, j]() {
+            ThreadCpuTime::Task cpuTask(ThreadCpuTime::Stage::Decompress);
+            _decodeChunk(data, len, *j);
+        });
+        _jobs.push_back(std::move(job));
+    }
+}
+
+void ParallelGzipDecoder::_dropJob()
+{
+    ChunkJob *job = _jobs.front().get();
+    job->cancelled = true;
+    job->future.waitForFinished();
+    _jobs.pop_front();
+}
+
+void ParallelGzipDecoder::_account(const char *data, size_t len)
+{
+    _crc = crc32_z(_crc, reinterpret_cast<const Bytef *>(data), len);
+    _memberSize += len;
+
+    if (len >= WINDOW_SIZE)
+    {
+        _window = QByteArray(data + len - WINDOW_SIZE, static_cast<qsizetype>(WINDOW_SIZE));
+        return;
+    }
+    qsizetype excess = _window.size() + static_cast<qsizetype>(len) - static_cast<qsizetype>(WINDOW_SIZE);
+    if (excess > 0)
+        _window.remove(0, excess);
+    _window.append(data, static_cast<qsizetype>(len));
+}
+
+bool ParallelGzipDecoder::_deliverChunk(ChunkJob &job)
+{
+    // The window is known now: fill in the bytes that were copied from it
+    char *out = job.output.data();
+    const uint8_t *high = reinterpret_cast<const uint8_t *>(job.high.constData());
+    const char *inverse = job.inverse.constData();
+    const size_t missing = WINDOW_SIZE - static_cast<size_t>(_window.size());
+    for (size_t k = 0; k < job.prefix; ++k)
+    {
+        if (out[k] == inverse[k])
+            continue;
+        size_t pos = (static_cast<size_t>(high[k]) << 8) | static_cast<uint8_t>(out[k]);
+        if (pos < missing)
+            return false;   // Refers to before the start of the member
+        out[k] = _window.at(static_cast<qsizetype>(pos - missing));
+    }
+
+    _account(job.output.constData(), static_cast<size_t>(job.output.size()));
+    if (!_emit(job.output.constData(), static_cast<size_t>(job.output.size())))
+        return false;
+    _bit = job.endBit;
+    _bytesConsumed = _bit / 8;
+    _parallelBlocks++;
+    return true;
+}
+
+/*
+ * Decode with the known window, straight into the write ring buffer, up to
+ * the first block boundary at or after stopBit or the end of the stream
+ */
+bool ParallelGzipDecoder::_decodeSequential(uint64_t stopBit, bool &streamEnd)
+{
+    RawInflater inflater;
+    if (!inflater.begin(_data, _len, _bit, reinterpret_cast<const uint8_t *>(_window.constData()),
+                        static_cast<size_t>(_window.size())))
+    {
+        _fail(QStringLiteral("gzip data is corrupt"));
+        return false;
+    }
+
+    while (!_cancelled)
+    {
+        if (!_acquireOutput())
+            return false;
+
+        char *out = _outSlot->data + _outUsed;
+        size_t produced;
+        RawInflater::Result result = inflater.next(reinterpret_cast<uint8_t *>(out),
+                                                   _outSlot->capacity - _outUsed, produced);
+        if (result == RawInflater::Error)
+        {
+            _fail(QStringLiteral("gzip data is corrupt"));
+            return false;
+        }
+        _account(out, produced);
+        _advanceOutput(produced);
+
+        if (result == RawInflater::StreamEnd
+            || (result == RawInflater::BlockEnd && inflater.bitPosition() >= stopBit))
+        {
+            streamEnd = result == RawInflater::StreamEnd;
+            _bit = inflater.bitPosition();
+            _bytesConsumed = _bit / 8;
+            return true;
+        }
+        if (result == RawInflater::BlockEnd)
+            _bytesConsumed = inflater.bitPosition() / 8;
+    }
+    return false;
+}
+
+/*
+ * Check the trailer of the member just decoded, and move on to the next
+ * member if there is one
+ */
+bool ParallelGzipDecoder::_endMember(bool &more)
+{
+    size_t trailer = static_cast<size_t>((_bit + 7) / 8);
+    if (_len - trailer < 8)
+    {
+        _fail(QStringLiteral("compressed data is truncated"));
+        return false;
+    }
+    if (load32(_data + trailer) != static_cast<uint32_t>(_crc))
+    {
+        _fail(QStringLiteral("gzip data is corrupt: incorrect data check"));
+        return false;
+    }
+    if (load32(_data + trailer + 4) != static_cast<uint32_t>(_memberSize))
+    {
+        _fail(QStringLiteral("gzip data is corrupt: incorrect length check"));
+        return false;
+    }
+
+    size_t next = trailer + 8;
+    _bytesConsumed = next;
+    more = next < _len;
+    if (!more)
+        return true;
+
+    size_t header = gzipHeaderLength(_data + next, _len - next);
+    if (!header)
+    {
+        _fail(QStringLiteral("gzip data is corrupt: incorrect header check"));
+        return false;
+    }
+    _bit = static_cast<uint64_t>(next + header) * 8;
+    _window.clear();
+    _crc = crc32(0, nullptr, 0);
+    _memberSize = 0;
+    return true;
+}
+
+void ParallelGzipDecoder::run()
+{
+    ThreadPlacement::apply(ThreadPlacement::Role::Decompress);
+    ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::Decompress);
+    QElapsedTimer decodeTimer;
+    decodeTimer.start();
+
+    size_t header = gzipHeaderLength(_data, _len);
+    bool ok = header != 0;
+    if (!ok)
+        _fail(QStringLiteral("gzip data is corrupt: incorrect header check"));
+    _bit = static_cast<uint64_t>(header) * 8;
+    _crc = crc32(0, nullptr, 0);
+
+    while (ok && !_cancelled)
+    {
+        _queueJobs();
+
+        ChunkJob *job = _jobs.empty() ? nullptr : _jobs.front().get();
+        uint64_t stopBit = NO_BLOCK;
+        if (job && _bit >= job->fromBit)
+        {
+            job->future.waitForFinished();
+            if (!job->ok || job->startBit < _bit)
+            {
+                // No usable output, or a false block start
+                _dropJob();
+                continue;
+            }
+            stopBit = job->startBit;
+        }
+        else if (job)
+        {
+            // Catch up to the cut first
+            stopBit = job->fromBit;
+        }
+
+        bool streamEnd = false;
+        if (stopBit == _bit)
+        {
+            // The chunk starts right where delivered output ends
+            streamEnd = job->streamEnd;
+            bool delivered = _deliverChunk(*job);
+            _jobs.pop_front();
+            if (!delivered)
+                continue;   // Decoded sequentially instead
+        }
+        else
+        {
+            ok = _decodeSequential(stopBit, streamEnd);
+        }
+
+        if (ok && streamEnd)
+        {
+            bool more = false;
+            ok = _endMember(more);
+            if (!more)
+                break;
+        }
+    }
+
+    while (!_jobs.empty())
+        _dropJob();
+
+    if (ok && !_cancelled && !_failed)
+        _flushOutput();
+
+    if (_cancelled && !_failed)
+        _fail(QStringLiteral("cancelled"));
+
+    // Unblock the writer
+    _output->producerDone();
+
+    _decodeMs = static_cast<quint64>(decodeTimer.elapsed());
+    qDebug() << "ParallelGzipDecoder: consumed" << _bytesConsumed.load() / (1024 * 1024) << "MB,"
+             << _parallelBlocks.load() << "chunks decoded in parallel,"
+             << "decode" << _decodeMs.load() << "ms";
+}
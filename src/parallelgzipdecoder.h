@@ -0,0 +1,77 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef PARALLELGZIPDECODER_H
+#define PARALLELGZIPDECODER_H
+
+#include <QByteArray>
+#include <zlib.h>
+#include <deque>
+#include "decoderthread.h"
+
+/**
+ * @brief Parallel gzip decoder for raw .gz images that are already on disk
+ *
+ * Deflate has no block index and blocks refer back into the 32 KiB window
+ * before them, so downloads are decoded sequentially by GzipDecoder. With
+ * the whole file at hand, the compressed data is instead cut into chunks
+ * that are decoded on the thread pool, the way rapidgzip and pugz do it:
+ *
+ * - A chunk starts at the first bit after its cut that looks like the
+ *   header of a dynamic Huffman block and that zlib can decode from.
+ * - The window before it is unknown, so the chunk is decoded three times,
+ *   with dictionaries that spell out each window position in their bytes.
+ *   Where the runs agree a byte is a literal; elsewhere they tell which
+ *   window byte it was copied from. Once the last 32 KiB decoded are all
+ *   literals, the rest of the chunk is decoded once.
+ * - Output is delivered in order. A chunk is only used if the output
+ *   before it ends on exactly the block it starts at, which rules out
+ *   false block starts, and its window references are then filled in.
+ *   Whatever no usable chunk covers is decoded sequentially.
+ *
+ * The CRC32 and size in each member's trailer are checked, and
+ * concatenated members are supported.
+ */
+class ParallelGzipDecoder : public DecoderThread
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param data Whole compressed file; must stay mapped until the decoder has finished
+     * @param maxInFlightBytes Budget for chunks decoded ahead of delivery
+     */
+    ParallelGzipDecoder(const char *data, size_t len, std::shared_ptr<RingBuffer> output,
+                        int threads, quint64 maxInFlightBytes, QObject *parent = nullptr);
+    ~ParallelGzipDecoder() override;
+
+protected:
+    void run() override;
+
+private:
+    struct ChunkJob;
+
+    const uint8_t *_data;
+    size_t _len;
+    size_t _maxJobs;
+    size_t _nextChunk;      // Next cut to queue a chunk job for
+    std::deque<std::unique_ptr<ChunkJob>> _jobs;
+
+    uint64_t _bit;          // Block boundary delivered output has reached
+    QByteArray _window;     // Last 32 KiB delivered in the current member
+    uLong _crc;
+    quint64 _memberSize;
+
+    void _queueJobs();
+    void _dropJob();
+    bool _deliverChunk(ChunkJob &job);
+    bool _decodeSequential(uint64_t stopBit, bool &streamEnd);
+    void _account(const char *data, size_t len);
+    bool _endMember(bool &more);
+
+    static void _decodeChunk(const uint8_t *data, size_t len, ChunkJob &job);
+};
+
+#endif // PARALLELGZIPDECODER_H
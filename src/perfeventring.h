@@ -0,0 +1,100 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef PERFEVENTRING_H
+#define PERFEVENTRING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Fixed-capacity single producer / single consumer event ring
+ *
+ * One ring belongs to each thread that records hot-path timing events
+ * (see PerformanceStats::recordFastEvent()). Pushing is a copy of a small
+ * POD record and one release store, with no locks, allocation or strings:
+ * labels are interned to 16-bit IDs up front. When the consumer falls
+ * behind, new records are counted as dropped rather than blocking the
+ * producer.
+ *
+ * A thread claims a ring for its lifetime and releases it on exit; a later
+ * thread may then claim the same ring, so rings are reused rather than one
+ * being allocated per short-lived worker.
+ */
+class PerfEventRing
+{
+public:
+    struct Record {
+        int64_t timestampNs;   // steady_clock at the end of the event
+        uint32_t durationUs;
+        uint16_t label;        // Interned label, 0 if none
+        uint8_t type;          // PerformanceStats::EventType
+        int64_t payload;       // Event specific, e.g. bytes written
+    };
+
+    static constexpr size_t Capacity = 8192;  // Must be a power of two
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    /**
+     * @brief Append a record (producer thread only)
+     * @return false if the ring was full and the record was dropped
+     */
+    bool push(const Record &record) noexcept
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= Capacity) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _records[head & (Capacity - 1)] = record;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Hand every record pushed so far to fn, oldest first (consumer only)
+     * @return Number of records drained
+     */
+    template <typename Fn>
+    size_t drain(Fn &&fn)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        const size_t head = _head.load(std::memory_order_acquire);
+        for (size_t i = tail; i != head; ++i)
+            fn(_records[i & (Capacity - 1)]);
+        _tail.store(head, std::memory_order_release);
+        return head - tail;
+    }
+
+    /**
+     * @brief Records dropped because the ring was full, since the last call
+     */
+    uint64_t takeDropped() noexcept { return _dropped.exchange(0, std::memory_order_relaxed); }
+
+    /**
+     * @brief Become this ring's producer; fails if another thread holds it
+     */
+    bool claim() noexcept
+    {
+        bool expected = false;
+        return _claimed.compare_exchange_strong(expected, true, std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Give up the ring when the producer thread exits
+     */
+    void release() noexcept { _claimed.store(false, std::memory_order_release); }
+
+private:
+    alignas(64) std::atomic<size_t> _head{0};  // Written by the producer
+    alignas(64) std::atomic<size_t> _tail{0};  // Written by the consumer
+    std::atomic<uint64_t> _dropped{0};
+    std::atomic<bool> _claimed{false};
+    std::array<Record, Capacity> _records{};
+};
+
+#endif // PERFEVENTRING_H
@@ -4,11 +4,77 @@
  */
 
 #include "performancestats.h"
+#include "perfeventring.h"
+#include "latencyhistogram.h"
+#include "downsample.h"
 #include <QFile>
 #include <QDateTime>
 #include <QDebug>
+#include <QHash>
 #include <QMutexLocker>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <memory>
+#include <vector>
+
+namespace {
+    int64_t steadyNowNs() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Rings of every thread that has recorded a fast event; the consumer
+    // side is only touched with the mutex held
+    struct EventRingRegistry {
+        QMutex mutex;
+        std::vector<std::unique_ptr<PerfEventRing>> rings;
+    };
+
+    EventRingRegistry &eventRingRegistry()
+    {
+        static EventRingRegistry registry;
+        return registry;
+    }
+
+    // The calling thread's ring, released for reuse when the thread exits
+    struct ThreadEventRing {
+        PerfEventRing *ring = nullptr;
+        ~ThreadEventRing()
+        {
+            if (ring)
+                ring->release();
+        }
+    };
+    thread_local ThreadEventRing t_eventRing;
+
+    PerfEventRing *claimEventRing()
+    {
+        EventRingRegistry &registry = eventRingRegistry();
+        QMutexLocker locker(&registry.mutex);
+        for (const auto &ring : registry.rings) {
+            if (ring->claim())
+                return ring.get();
+        }
+        registry.rings.push_back(std::make_unique<PerfEventRing>());
+        PerfEventRing *ring = registry.rings.back().get();
+        ring->claim();
+        return ring;
+    }
+
+    struct LabelTable {
+        QMutex mutex;
+        QHash<QByteArray, quint16> ids;
+        QList<QString> names{QString()};  // Index 0 is "no label"
+    };
+
+    LabelTable &labelTable()
+    {
+        static LabelTable table;
+        return table;
+    }
+}
 
 PerformanceStats::PerformanceStats(QObject *parent)
     : QObject(parent)
@@ -24,14 +90,25 @@ PerformanceStats::PerformanceStats(QObject *parent)
     , _writeTotal(0)
     , _verifyTotal(0)
     , _hasSystemInfo(false)
+    , _lastOccupancySampleTime(0)
+    , _occupancyIntervalMs(MIN_SAMPLE_INTERVAL_MS)
+    , _fastEventsDropped(0)
+    , _sessionOriginNs(0)
 {
+    _drainTimer.setInterval(DRAIN_INTERVAL_MS);
+    connect(&_drainTimer, &QTimer::timeout, this, &PerformanceStats::drainEventRings);
+
     std::memset(_phaseStartTimes, 0, sizeof(_phaseStartTimes));
     std::memset(_lastSampleTime, 0, sizeof(_lastSampleTime));
+    std::fill(std::begin(_sampleIntervalMs), std::end(_sampleIntervalMs), MIN_SAMPLE_INTERVAL_MS);
     std::memset(&_systemInfo, 0, sizeof(_systemInfo));
 }
 
 void PerformanceStats::startSession(const QString &imageName, quint64 imageSize, const QString &deviceName)
 {
+    // Anything still queued belongs to the previous cycle
+    drainEventRings();
+    
     QMutexLocker locker(&_mutex);
     
     // If this is the very first session, initialise capacity
@@ -45,6 +122,7 @@ void PerformanceStats::startSession(const QString &imageName, quint64 imageSize,
     
     // Emit CycleStart event to mark the beginning of a new imaging cycle
     // This allows multiple cycles to be captured and analysed separately
+    _cycleMarks.append(currentMark());
     TimedEvent cycleStartEvent;
     cycleStartEvent.type = EventType::CycleStart;
     cycleStartEvent.startMs = _sessionActive ? static_cast<uint32_t>(_sessionTimer.elapsed()) : 0;
@@ -69,6 +147,7 @@ void PerformanceStats::startSession(const QString &imageName, quint64 imageSize,
     _currentPhase = Phase::Idle;
     std::memset(_phaseStartTimes, 0, sizeof(_phaseStartTimes));
     std::memset(_lastSampleTime, 0, sizeof(_lastSampleTime));
+    _lastOccupancySampleTime = 0;
     
     _downloadTotal = 0;
     _decompressTotal = 0;
@@ -80,7 +159,9 @@ void PerformanceStats::startSession(const QString &imageName, quint64 imageSize,
     
     // Start/restart the session timer for this cycle
     _sessionTimer.start();
+    _sessionOriginNs = steadyNowNs();
     _sessionActive = true;
+    _drainTimer.start();
     
     qDebug() << "PerformanceStats: Started cycle for" << imageName 
              << "size:" << imageSize << "device:" << deviceName
@@ -98,6 +179,12 @@ void PerformanceStats::reset()
     _decompressSamples.clear();
     _writeSamples.clear();
     _verifySamples.clear();
+    _occupancySamples.clear();
+    _cycleMarks.clear();
+    _latencyHistograms.clear();
+    _stageCpuTimes.clear();
+    _fastEvents.clear();
+    _fastEventsDropped = 0;
     
     _imageName.clear();
     _deviceName.clear();
@@ -111,6 +198,9 @@ void PerformanceStats::reset()
     _currentPhase = Phase::Idle;
     std::memset(_phaseStartTimes, 0, sizeof(_phaseStartTimes));
     std::memset(_lastSampleTime, 0, sizeof(_lastSampleTime));
+    _lastOccupancySampleTime = 0;
+    std::fill(std::begin(_sampleIntervalMs), std::end(_sampleIntervalMs), MIN_SAMPLE_INTERVAL_MS);
+    _occupancyIntervalMs = MIN_SAMPLE_INTERVAL_MS;
     
     _downloadTotal = 0;
     _decompressTotal = 0;
@@ -145,6 +235,9 @@ void PerformanceStats::updateDirectIOEnabled(bool enabled)
 
 void PerformanceStats::endSession(bool success, const QString &errorMessage)
 {
+    drainEventRings();
+    _drainTimer.stop();
+    
     QMutexLocker locker(&_mutex);
     
     if (!_sessionActive)
@@ -355,7 +448,7 @@ void PerformanceStats::addRawSample(Phase phase, quint64 bytesNow, quint64 bytes
     }
     
     // Rate limit samples - this is the only check, very fast
-    if (currentTime - _lastSampleTime[phaseIdx] < MIN_SAMPLE_INTERVAL_MS)
+    if (currentTime - _lastSampleTime[phaseIdx] < _sampleIntervalMs[phaseIdx])
         return;
     
     // Get appropriate vector
@@ -368,9 +461,13 @@ void PerformanceStats::addRawSample(Phase phase, quint64 bytesNow, quint64 bytes
         default: return;
     }
     
-    // Check capacity limit
-    if (samples->size() >= MAX_SAMPLES_PER_PHASE)
-        return;
+    // At the limit, keep the shape of the whole session at half the resolution
+    if (samples->size() >= MAX_SAMPLES_PER_PHASE) {
+        downsampleSeries(*samples,
+                         [](const RawSample &sample) { return sample.bytesProcessed; },
+                         [phaseIdx](CycleMark &mark) -> int & { return mark.samples[phaseIdx]; });
+        _sampleIntervalMs[phaseIdx] *= 2;
+    }
     
     // Store raw sample - minimal work
     RawSample sample;
@@ -381,6 +478,166 @@ void PerformanceStats::addRawSample(Phase phase, quint64 bytesNow, quint64 bytes
     _lastSampleTime[phaseIdx] = currentTime;
 }
 
+template <typename T, typename Y, typename MarkIndex>
+void PerformanceStats::downsampleSeries(QVector<T> &series, Y y, MarkIndex markIndex)
+{
+    // Cycles restart the timestamps, so each is downsampled on its own
+    std::vector<int> bounds = {0, static_cast<int>(series.size())};
+    for (CycleMark &mark : _cycleMarks)
+        bounds.push_back(markIndex(mark));
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    std::vector<int> kept;
+    kept.reserve(static_cast<size_t>(series.size() / 2 + bounds.size() * 2));
+    for (size_t b = 0; b + 1 < bounds.size(); ++b) {
+        const int first = bounds[b];
+        const int last = bounds[b + 1] - 1;
+        const std::vector<int> part = Downsample::lttb(
+            first, last, qMax(2, (last - first + 1) / 2),
+            [&series](int i) { return series.at(i).timestampMs; },
+            [&series, &y](int i) { return y(series.at(i)); });
+        kept.insert(kept.end(), part.begin(), part.end());
+    }
+
+    QVector<T> compacted;
+    compacted.reserve(series.capacity());
+    for (int i : kept)
+        compacted.append(series.at(i));
+    // Each mark starts a cycle, and a cycle's first sample is always kept
+    for (CycleMark &mark : _cycleMarks) {
+        int &index = markIndex(mark);
+        index = static_cast<int>(std::lower_bound(kept.begin(), kept.end(), index) - kept.begin());
+    }
+    series.swap(compacted);
+}
+
+void PerformanceStats::recordRingBufferOccupancy(quint32 inputSlotsUsed, quint32 writeSlotsUsed)
+{
+    QMutexLocker locker(&_mutex);
+    
+    if (!_sessionActive)
+        return;
+    
+    qint64 currentTime = _sessionTimer.elapsed();
+    if (_lastOccupancySampleTime != 0 && currentTime - _lastOccupancySampleTime < _occupancyIntervalMs)
+        return;
+    if (_occupancySamples.size() >= MAX_SAMPLES_PER_PHASE) {
+        downsampleSeries(_occupancySamples,
+                         [](const OccupancySample &sample) { return sample.inputSlotsUsed + sample.writeSlotsUsed; },
+                         [](CycleMark &mark) -> int & { return mark.occupancy; });
+        _occupancyIntervalMs *= 2;
+    }
+    
+    OccupancySample sample;
+    sample.timestampMs = static_cast<uint32_t>(currentTime);
+    sample.inputSlotsUsed = static_cast<uint16_t>(qMin<quint32>(inputSlotsUsed, 0xffff));
+    sample.writeSlotsUsed = static_cast<uint16_t>(qMin<quint32>(writeSlotsUsed, 0xffff));
+    _occupancySamples.append(sample);
+    
+    _lastOccupancySampleTime = currentTime;
+}
+
+void PerformanceStats::recordLatencyHistogram(const QString &name, const QList<quint64> &buckets, quint64 maxUs)
+{
+    QMutexLocker locker(&_mutex);
+    
+    LatencyRecord record;
+    record.cycle = qMax(0, static_cast<int>(_cycleMarks.size()) - 1);
+    record.name = name;
+    record.buckets.assign(buckets.cbegin(), buckets.cend());
+    record.maxUs = maxUs;
+    
+    for (auto &existing : _latencyHistograms) {
+        if (existing.cycle == record.cycle && existing.name == name) {
+            existing = std::move(record);
+            return;
+        }
+    }
+    _latencyHistograms.append(std::move(record));
+}
+
+void PerformanceStats::recordStageCpuTime(const QString &stage, quint32 cpuMs, quint32 activeMs, quint32 wallMs)
+{
+    QMutexLocker locker(&_mutex);
+    
+    StageCpuRecord record{qMax(0, static_cast<int>(_cycleMarks.size()) - 1), stage, cpuMs, activeMs, wallMs};
+    for (auto &existing : _stageCpuTimes) {
+        if (existing.cycle == record.cycle && existing.stage == stage) {
+            existing = record;
+            return;
+        }
+    }
+    _stageCpuTimes.append(record);
+}
+
+quint16 PerformanceStats::internLabel(const char *label)
+{
+    LabelTable &table = labelTable();
+    const QByteArray key(label);
+    QMutexLocker locker(&table.mutex);
+    auto it = table.ids.constFind(key);
+    if (it != table.ids.constEnd())
+        return it.value();
+    if (table.names.size() > 0xffff)
+        return 0;
+    const quint16 id = static_cast<quint16>(table.names.size());
+    table.names.append(QString::fromUtf8(key));
+    table.ids.insert(key, id);
+    return id;
+}
+
+QString PerformanceStats::labelName(quint16 label)
+{
+    LabelTable &table = labelTable();
+    QMutexLocker locker(&table.mutex);
+    return label < table.names.size() ? table.names.at(label) : QString();
+}
+
+void PerformanceStats::recordFastEvent(EventType type, uint32_t durationUs, qint64 payload, quint16 label) noexcept
+{
+    PerfEventRing *ring = t_eventRing.ring;
+    if (!ring) {
+        // First event on this thread: the only time a lock is taken
+        ring = claimEventRing();
+        t_eventRing.ring = ring;
+    }
+    
+    PerfEventRing::Record record;
+    record.timestampNs = steadyNowNs();
+    record.durationUs = durationUs;
+    record.label = label;
+    record.type = static_cast<uint8_t>(type);
+    record.payload = payload;
+    ring->push(record);
+}
+
+void PerformanceStats::drainEventRings()
+{
+    EventRingRegistry &registry = eventRingRegistry();
+    QMutexLocker registryLocker(&registry.mutex);
+    QMutexLocker locker(&_mutex);
+    
+    for (const auto &ring : registry.rings) {
+        ring->drain([this](const PerfEventRing::Record &r) {
+            // Events from before the first cycle, or past the cap, are only counted
+            const int64_t startNs = r.timestampNs - static_cast<int64_t>(r.durationUs) * 1000;
+            if (_sessionOriginNs == 0 || startNs < _sessionOriginNs || _fastEvents.size() >= MAX_FAST_EVENTS) {
+                ++_fastEventsDropped;
+                return;
+            }
+            FastEvent e;
+            e.startUs = static_cast<uint64_t>((startNs - _sessionOriginNs) / 1000);
+            e.durationUs = r.durationUs;
+            e.label = r.label;
+            e.type = static_cast<EventType>(r.type);
+            e.payload = r.payload;
+            _fastEvents.append(e);
+        });
+        _fastEventsDropped += ring->takeDropped();
+    }
+}
+
 bool PerformanceStats::hasData() const
 {
     QMutexLocker locker(&_mutex);
@@ -388,7 +645,8 @@ bool PerformanceStats::hasData() const
            !_downloadSamples.isEmpty() || 
            !_decompressSamples.isEmpty() ||
            !_writeSamples.isEmpty() || 
-           !_verifySamples.isEmpty();
+           !_verifySamples.isEmpty() ||
+           !_fastEvents.isEmpty();
 }
 
 bool PerformanceStats::hasImagingData() const
@@ -405,6 +663,13 @@ bool PerformanceStats::hasImagingData() const
            !_verifySamples.isEmpty();
 }
 
+int PerformanceStats::eventCount(EventType type) const
+{
+    QMutexLocker locker(&_mutex);
+    return static_cast<int>(std::count_if(_events.cbegin(), _events.cend(),
+                                          [type](const TimedEvent &e) { return e.type == type; }));
+}
+
 QString PerformanceStats::eventTypeName(EventType type)
 {
     switch (type) {
@@ -427,6 +692,10 @@ QString PerformanceStats::eventTypeName(EventType type)
         case EventType::DriveDiskClean: return "driveDiskClean";
         case EventType::DriveRescan: return "driveRescan";
         case EventType::DriveFormat: return "driveFormat";
+        case EventType::DriveErase: return "driveErase";
+        case EventType::DriveCapacityProbe: return "driveCapacityProbe";
+        case EventType::DriveQueueTuning: return "driveQueueTuning";
+        case EventType::DriveUsbPower: return "driveUsbPower";
         
         // Cache operations
         case EventType::CacheLookup: return "cacheLookup";
@@ -457,6 +726,8 @@ QString PerformanceStats::eventTypeName(EventType type)
         case EventType::WriteAfterSyncImpact: return "writeAfterSyncImpact";
         case EventType::AsyncIOConfig: return "asyncIOConfig";
         case EventType::AsyncIOTiming: return "asyncIOTiming";
+        case EventType::WriteOperation: return "writeOperation";
+        case EventType::WriteTuning: return "writeTuning";
         
         // Cycle boundaries
         case EventType::CycleStart: return "cycleStart";
@@ -470,6 +741,7 @@ QString PerformanceStats::eventTypeName(EventType type)
         case EventType::SyncFallbackActivated: return "syncFallbackActivated";
         case EventType::DrainAndHotSwap: return "drainAndHotSwap";
         case EventType::WatchdogRecovery: return "watchdogRecovery";
+        case EventType::WriteCancellation: return "writeCancellation";
         
         // Customisation
         case EventType::Customisation: return "customisation";
@@ -482,15 +754,18 @@ QString PerformanceStats::eventTypeName(EventType type)
         case EventType::FatPartitionSetup: return "fatPartitionSetup";
         case EventType::FinalSync: return "finalSync";
         case EventType::DeviceClose: return "deviceClose";
+        case EventType::AdditionalTargetResult: return "additionalTargetResult";
         
         // UI operations
         case EventType::FileDialogOpen: return "fileDialogOpen";
+        case EventType::StartupPhase: return "startupPhase";
 
         // Rpiboot / Fastboot
         case EventType::RpibootFirmwareSetup: return "rpibootFirmwareSetup";
         case EventType::RpibootProtocol: return "rpibootProtocol";
         case EventType::RpibootFastbootWait: return "rpibootFastbootWait";
         case EventType::FastbootDeviceOpen: return "fastbootDeviceOpen";
+        case EventType::FastbootPipelineStats: return "fastbootPipelineStats";
 
         default: return "unknown";
     }
@@ -554,7 +829,9 @@ QJsonArray PerformanceStats::buildHistogramForPhase(const QVector<RawSample> &sa
         uint64_t sumKBps = 0;
         int throughputSamples = 0;
         
-        for (int i = windowStart + 1; i < windowEnd; ++i) {
+        // Includes the interval leading into the window: once a long
+        // session has been downsampled, a window may hold a single sample
+        for (int i = qMax(windowStart, 1); i < windowEnd; ++i) {
             const RawSample &prev = samples[i - 1];
             const RawSample &curr = samples[i];
             
@@ -663,12 +940,14 @@ QJsonObject PerformanceStats::buildSummary() const
     summary["events"] = eventSummary;
     
     // Phase statistics (calculated from raw samples)
-    auto buildPhaseStats = [this](const QVector<RawSample> &samples, quint64 totalBytes) -> QJsonObject {
+    auto buildPhaseStats = [this](const QVector<RawSample> &samples, quint64 totalBytes, int intervalMs) -> QJsonObject {
         QJsonObject stats;
         if (samples.isEmpty())
             return stats;
         
         stats["sampleCount"] = samples.size();
+        // Above MIN_SAMPLE_INTERVAL_MS once a long session has been downsampled
+        stats["sampleIntervalMs"] = intervalMs;
         stats["bytesTotal"] = static_cast<qint64>(totalBytes);
         
         if (samples.size() >= 2) {
@@ -708,15 +987,59 @@ QJsonObject PerformanceStats::buildSummary() const
     };
     
     QJsonObject phases;
-    phases["download"] = buildPhaseStats(_downloadSamples, _downloadTotal);
-    phases["decompress"] = buildPhaseStats(_decompressSamples, _decompressTotal);
-    phases["write"] = buildPhaseStats(_writeSamples, _writeTotal);
-    phases["verify"] = buildPhaseStats(_verifySamples, _verifyTotal);
+    phases["download"] = buildPhaseStats(_downloadSamples, _downloadTotal, _sampleIntervalMs[0]);
+    phases["decompress"] = buildPhaseStats(_decompressSamples, _decompressTotal, _sampleIntervalMs[1]);
+    phases["write"] = buildPhaseStats(_writeSamples, _writeTotal, _sampleIntervalMs[2]);
+    phases["verify"] = buildPhaseStats(_verifySamples, _verifyTotal, _sampleIntervalMs[3]);
     summary["phases"] = phases;
     
     return summary;
 }
 
+QJsonObject PerformanceStats::buildFastEventStats() const
+{
+    // Group by type and label, e.g. writeOperation/"zero-copy"
+    QMap<QPair<int, int>, QVector<uint32_t>> durations;
+    QMap<QPair<int, int>, qint64> payloads;
+    for (const FastEvent &e : _fastEvents) {
+        const QPair<int, int> key(static_cast<int>(e.type), e.label);
+        durations[key].append(e.durationUs);
+        payloads[key] += e.payload;
+    }
+    
+    QJsonArray groups;
+    for (auto it = durations.begin(); it != durations.end(); ++it) {
+        QVector<uint32_t> &d = it.value();
+        std::sort(d.begin(), d.end());
+        quint64 totalUs = 0;
+        for (uint32_t us : d)
+            totalUs += us;
+        auto percentile = [&d](int p) {
+            return static_cast<qint64>(d[static_cast<int>((static_cast<qint64>(d.size()) - 1) * p / 100)]);
+        };
+        
+        QJsonObject group;
+        group["type"] = eventTypeName(static_cast<EventType>(it.key().first));
+        const QString label = labelName(static_cast<quint16>(it.key().second));
+        if (!label.isEmpty())
+            group["label"] = label;
+        group["count"] = static_cast<qint64>(d.size());
+        group["totalUs"] = static_cast<qint64>(totalUs);
+        group["minUs"] = static_cast<qint64>(d.first());
+        group["p50Us"] = percentile(50);
+        group["p90Us"] = percentile(90);
+        group["p99Us"] = percentile(99);
+        group["maxUs"] = static_cast<qint64>(d.last());
+        group["totalPayload"] = payloads.value(it.key());
+        groups.append(group);
+    }
+    
+    QJsonObject stats;
+    stats["groups"] = groups;
+    stats["dropped"] = static_cast<qint64>(_fastEventsDropped);
+    return stats;
+}
+
 QJsonDocument PerformanceStats::exportToJson() const
 {
     QMutexLocker locker(&_mutex);
@@ -758,6 +1081,10 @@ QJsonDocument PerformanceStats::exportToJson() const
         platform["osVersion"] = _systemInfo.osVersion;
         platform["cpuArchitecture"] = _systemInfo.cpuArchitecture;
         platform["cpuCores"] = _systemInfo.cpuCoreCount;
+        if (!_systemInfo.hashBackend.isEmpty())
+            platform["hashBackend"] = _systemInfo.hashBackend;
+        if (!_systemInfo.threadPlacement.isEmpty())
+            platform["threadPlacement"] = _systemInfo.threadPlacement;
         sysInfo["platform"] = platform;
         
         // Imager build info
@@ -827,6 +1154,18 @@ QJsonDocument PerformanceStats::exportToJson() const
     // Build time-series histograms (complex processing)
     root["histograms"] = buildHistograms();
     
+    // Latency distribution of hot-path events
+    if (!_fastEvents.isEmpty() || _fastEventsDropped > 0)
+        root["fastEvents"] = buildFastEventStats();
+    
+    // Per-operation latency percentiles and buckets
+    if (!_latencyHistograms.isEmpty())
+        root["latencyHistograms"] = buildLatencyHistograms();
+    
+    // CPU time and utilisation by pipeline stage
+    if (!_stageCpuTimes.isEmpty())
+        root["stageCpu"] = buildStageCpuTimes();
+    
     // Schema for parsing
     QJsonObject schema;
     schema["histogramSliceFormat"] = QJsonArray({
@@ -836,12 +1175,73 @@ QJsonDocument PerformanceStats::exportToJson() const
         "bucket_128-256MB", "bucket_256-512MB", "bucket_512-1024MB", "bucket_1024+MB"
     });
     schema["histogramWindowMs"] = HISTOGRAM_WINDOW_MS;
+    schema["latencyBucketFormat"] = QJsonArray({"lowerUs", "upperUs", "count"});
     schema["throughputUnit"] = "KB/s";
     root["schema"] = schema;
     
     return QJsonDocument(root);
 }
 
+QJsonArray PerformanceStats::buildStageCpuTimes() const
+{
+    QJsonArray stages;
+    for (const auto &record : _stageCpuTimes) {
+        QJsonObject obj;
+        obj["stage"] = record.stage;
+        obj["cycle"] = record.cycle;
+        obj["cpuMs"] = static_cast<qint64>(record.cpuMs);
+        obj["activeMs"] = static_cast<qint64>(record.activeMs);
+        obj["wallMs"] = static_cast<qint64>(record.wallMs);
+        // Busy share of the stage's thread time; near 100 is CPU bound
+        obj["utilisationPercent"] = record.activeMs > 0
+            ? qRound(100.0 * record.cpuMs / record.activeMs) : 0;
+        // Cores the stage kept busy over the write
+        obj["cores"] = record.wallMs > 0
+            ? qRound(100.0 * record.cpuMs / record.wallMs) / 100.0 : 0.0;
+        stages.append(obj);
+    }
+    return stages;
+}
+
+QJsonArray PerformanceStats::buildLatencyHistograms() const
+{
+    using rpi_imager::LatencyHistogram;
+    
+    QJsonArray histograms;
+    for (const auto &record : _latencyHistograms) {
+        quint64 count = 0;
+        QJsonArray buckets;
+        for (size_t i = 0; i < record.buckets.size(); ++i) {
+            const uint64_t n = record.buckets[i];
+            if (n == 0)
+                continue;
+            count += n;
+            // Last bucket is open-ended; its top is the largest value seen
+            const uint64_t upper = qMin<uint64_t>(LatencyHistogram::BucketUpperBound(static_cast<int>(i)), record.maxUs);
+            buckets.append(QJsonArray({
+                static_cast<qint64>(LatencyHistogram::BucketLowerBound(static_cast<int>(i))),
+                static_cast<qint64>(upper),
+                static_cast<qint64>(n)
+            }));
+        }
+        if (count == 0)
+            continue;
+        
+        QJsonObject obj;
+        obj["name"] = record.name;
+        obj["cycle"] = record.cycle;
+        obj["count"] = static_cast<qint64>(count);
+        obj["maxUs"] = static_cast<qint64>(record.maxUs);
+        obj["p50Us"] = static_cast<qint64>(LatencyHistogram::ValueAtQuantile(record.buckets, 0.50, record.maxUs));
+        obj["p90Us"] = static_cast<qint64>(LatencyHistogram::ValueAtQuantile(record.buckets, 0.90, record.maxUs));
+        obj["p99Us"] = static_cast<qint64>(LatencyHistogram::ValueAtQuantile(record.buckets, 0.99, record.maxUs));
+        obj["p999Us"] = static_cast<qint64>(LatencyHistogram::ValueAtQuantile(record.buckets, 0.999, record.maxUs));
+        obj["buckets"] = buckets;
+        histograms.append(obj);
+    }
+    return histograms;
+}
+
 bool PerformanceStats::exportToFile(const QString &filePath) const
 {
     QFile file(filePath);
@@ -857,3 +1257,361 @@ bool PerformanceStats::exportToFile(const QString &filePath) const
     qDebug() << "PerformanceStats: Exported data to" << filePath;
     return true;
 }
+
+// ===== Chrome Trace Event export =====
+
+namespace {
+    // Tracks (thread ids) within each cycle's process, in display order
+    enum TraceTrack : int {
+        TrackSession = 1,
+        TrackNetwork,
+        TrackDevice,
+        TrackDownload,
+        TrackDecompress,
+        TrackHash,
+        TrackWrite,
+        TrackSync,
+        TrackVerify,
+        TrackRingBuffer,
+        TrackCount
+    };
+
+    const char *traceTrackName(int track)
+    {
+        switch (track) {
+            case TrackSession: return "Session";
+            case TrackNetwork: return "Network";
+            case TrackDevice: return "Device";
+            case TrackDownload: return "Download";
+            case TrackDecompress: return "Decompress";
+            case TrackHash: return "Hash";
+            case TrackWrite: return "Write";
+            case TrackSync: return "Sync";
+            case TrackVerify: return "Verify";
+            case TrackRingBuffer: return "Ring buffer stalls";
+            default: return "Other";
+        }
+    }
+
+    int traceTrackFor(PerformanceStats::EventType type)
+    {
+        using T = PerformanceStats::EventType;
+        switch (type) {
+            case T::OsListFetch:
+            case T::OsListParse:
+            case T::SublistFetch:
+            case T::NetworkLatency:
+            case T::NetworkRetry:
+            case T::NetworkConnectionStats:
+                return TrackNetwork;
+            case T::DriveListPoll:
+            case T::DriveOpen:
+            case T::DriveAuthorization:
+            case T::DriveMbrZeroing:
+            case T::DirectIOAttempt:
+            case T::DriveUnmount:
+            case T::DriveUnmountVolumes:
+            case T::DriveDiskClean:
+            case T::DriveRescan:
+            case T::DriveFormat:
+            case T::DriveErase:
+            case T::DriveCapacityProbe:
+            case T::DriveQueueTuning:
+            case T::DriveUsbPower:
+            case T::PartitionTableWrite:
+            case T::FatPartitionSetup:
+            case T::RpibootFirmwareSetup:
+            case T::RpibootProtocol:
+            case T::RpibootFastbootWait:
+            case T::FastbootDeviceOpen:
+                return TrackDevice;
+            case T::CacheLookup:
+            case T::CacheWrite:
+                return TrackDownload;
+            case T::ImageDecompressInit:
+            case T::ImageExtraction:
+            case T::PipelineDecompressionTime:
+            case T::PipelineRingBufferWaitTime:
+                return TrackDecompress;
+            case T::HashComputation:
+            case T::CacheVerification:
+                return TrackHash;
+            case T::MemoryAllocation:
+            case T::BufferResize:
+            case T::PipelineWriteWaitTime:
+            case T::WriteTimingBreakdown:
+            case T::WriteSizeDistribution:
+            case T::WriteAfterSyncImpact:
+            case T::AsyncIOConfig:
+            case T::AsyncIOTiming:
+            case T::WriteOperation:
+            case T::WriteTuning:
+            case T::ProgressStall:
+            case T::MemoryAllocationFailure:
+            case T::DeviceIOTimeout:
+            case T::QueueDepthReduction:
+            case T::SyncFallbackActivated:
+            case T::DrainAndHotSwap:
+            case T::WatchdogRecovery:
+            case T::WriteCancellation:
+            case T::AdditionalTargetResult:
+                return TrackWrite;
+            case T::PeriodicSync:
+            case T::FinalSync:
+            case T::CacheFlush:
+            case T::DeviceClose:
+                return TrackSync;
+            case T::RingBufferStarvation:
+            case T::WriteRingBufferStats:
+            case T::FastbootPipelineStats:
+                return TrackRingBuffer;
+            default:
+                return TrackSession;
+        }
+    }
+
+    // Totals reported once at the end of a stage; their duration is
+    // accumulated time, not a span, so they are shown as instants
+    bool isSummaryEvent(PerformanceStats::EventType type)
+    {
+        using T = PerformanceStats::EventType;
+        switch (type) {
+            case T::PipelineDecompressionTime:
+            case T::PipelineWriteWaitTime:
+            case T::PipelineRingBufferWaitTime:
+            case T::WriteRingBufferStats:
+            case T::FastbootPipelineStats:
+            case T::WriteTimingBreakdown:
+            case T::WriteSizeDistribution:
+            case T::WriteAfterSyncImpact:
+            case T::AsyncIOConfig:
+            case T::AsyncIOTiming:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // A break in samples longer than this ends a phase span
+    constexpr uint32_t TRACE_PHASE_GAP_MS = 2000;
+
+    QJsonObject traceMetadata(const char *name, int pid, int tid, const QJsonObject &args)
+    {
+        QJsonObject e;
+        e["ph"] = "M";
+        e["name"] = name;
+        e["pid"] = pid;
+        e["tid"] = tid;
+        e["args"] = args;
+        return e;
+    }
+
+    QJsonObject traceCounter(const QString &name, int pid, uint32_t timestampMs, const QJsonObject &args)
+    {
+        QJsonObject e;
+        e["ph"] = "C";
+        e["name"] = name;
+        e["pid"] = pid;
+        e["ts"] = static_cast<qint64>(timestampMs) * 1000;
+        e["args"] = args;
+        return e;
+    }
+}
+
+PerformanceStats::CycleMark PerformanceStats::currentMark() const
+{
+    CycleMark mark;
+    mark.events = _events.size();
+    mark.samples[0] = _downloadSamples.size();
+    mark.samples[1] = _decompressSamples.size();
+    mark.samples[2] = _writeSamples.size();
+    mark.samples[3] = _verifySamples.size();
+    mark.occupancy = _occupancySamples.size();
+    mark.fastEvents = _fastEvents.size();
+    return mark;
+}
+
+void PerformanceStats::appendTraceCycle(QJsonArray &trace, int pid, const QString &name,
+                                        const CycleMark &from, const CycleMark &to) const
+{
+    bool usedTracks[TrackCount] = {};
+    
+    trace.append(traceMetadata("process_name", pid, 0, QJsonObject{{"name", name}}));
+    trace.append(traceMetadata("process_sort_index", pid, 0, QJsonObject{{"sort_index", pid}}));
+    
+    // Discrete events
+    for (int i = from.events; i < to.events; ++i) {
+        const TimedEvent &e = _events[i];
+        const int tid = traceTrackFor(e.type);
+        usedTracks[tid] = true;
+        
+        QJsonObject args;
+        args["success"] = e.success;
+        if (!e.metadata.isEmpty())
+            args["metadata"] = e.metadata;
+        if (e.bytesTransferred > 0)
+            args["bytesTransferred"] = static_cast<qint64>(e.bytesTransferred);
+        
+        QJsonObject traceEvent;
+        traceEvent["name"] = eventTypeName(e.type);
+        traceEvent["cat"] = traceTrackName(tid);
+        traceEvent["pid"] = pid;
+        traceEvent["tid"] = tid;
+        
+        const bool summary = isSummaryEvent(e.type);
+        if (summary || e.durationMs == 0) {
+            // Summaries are recorded when the stage ends
+            const qint64 atMs = summary ? static_cast<qint64>(e.startMs) + e.durationMs : e.startMs;
+            if (summary)
+                args["durationMs"] = static_cast<qint64>(e.durationMs);
+            traceEvent["ph"] = "i";
+            traceEvent["s"] = "t";
+            traceEvent["ts"] = atMs * 1000;
+        } else {
+            traceEvent["ph"] = "X";
+            traceEvent["ts"] = static_cast<qint64>(e.startMs) * 1000;
+            traceEvent["dur"] = static_cast<qint64>(e.durationMs) * 1000;
+        }
+        traceEvent["args"] = args;
+        trace.append(traceEvent);
+    }
+    
+    // Phase spans from the progress samples, plus a throughput counter that
+    // drops to zero across gaps
+    static const struct {
+        const QVector<RawSample> PerformanceStats::*samples;
+        int track;
+        const char *span;
+        const char *counter;
+    } phases[4] = {
+        {&PerformanceStats::_downloadSamples, TrackDownload, "Downloading", "Download throughput"},
+        {&PerformanceStats::_decompressSamples, TrackDecompress, "Decompressing", "Decompress throughput"},
+        {&PerformanceStats::_writeSamples, TrackWrite, "Writing", "Write throughput"},
+        {&PerformanceStats::_verifySamples, TrackVerify, "Verifying", "Verify throughput"},
+    };
+    for (int p = 0; p < 4; ++p) {
+        const QVector<RawSample> &samples = this->*phases[p].samples;
+        const int begin = from.samples[p];
+        const int end = to.samples[p];
+        if (begin >= end)
+            continue;
+        usedTracks[phases[p].track] = true;
+        
+        auto appendSpan = [&](int first, int last) {
+            QJsonObject span;
+            span["name"] = phases[p].span;
+            span["cat"] = traceTrackName(phases[p].track);
+            span["ph"] = "X";
+            span["pid"] = pid;
+            span["tid"] = phases[p].track;
+            span["ts"] = static_cast<qint64>(samples[first].timestampMs) * 1000;
+            span["dur"] = static_cast<qint64>(samples[last].timestampMs - samples[first].timestampMs) * 1000;
+            span["args"] = QJsonObject{{"bytes", static_cast<qint64>(samples[last].bytesProcessed - samples[first].bytesProcessed)}};
+            trace.append(span);
+        };
+        
+        int runStart = begin;
+        for (int i = begin + 1; i < end; ++i) {
+            const RawSample &prev = samples[i - 1];
+            const RawSample &cur = samples[i];
+            const uint32_t dtMs = cur.timestampMs > prev.timestampMs ? cur.timestampMs - prev.timestampMs : 0;
+            if (dtMs > TRACE_PHASE_GAP_MS) {
+                appendSpan(runStart, i - 1);
+                runStart = i;
+                trace.append(traceCounter(phases[p].counter, pid, prev.timestampMs + MIN_SAMPLE_INTERVAL_MS,
+                                          QJsonObject{{"MB/s", 0}}));
+                continue;
+            }
+            if (dtMs == 0 || cur.bytesProcessed < prev.bytesProcessed)
+                continue;
+            const double mbps = static_cast<double>(cur.bytesProcessed - prev.bytesProcessed)
+                                / (1024.0 * 1024.0) * 1000.0 / dtMs;
+            trace.append(traceCounter(phases[p].counter, pid, cur.timestampMs,
+                                      QJsonObject{{"MB/s", std::round(mbps * 100.0) / 100.0}}));
+        }
+        appendSpan(runStart, end - 1);
+        trace.append(traceCounter(phases[p].counter, pid, samples[end - 1].timestampMs + MIN_SAMPLE_INTERVAL_MS,
+                                  QJsonObject{{"MB/s", 0}}));
+    }
+    
+    // Hot-path events, at microsecond resolution
+    for (int i = from.fastEvents; i < to.fastEvents; ++i) {
+        const FastEvent &e = _fastEvents[i];
+        const int tid = traceTrackFor(e.type);
+        usedTracks[tid] = true;
+        
+        const QString label = labelName(e.label);
+        QJsonObject traceEvent;
+        traceEvent["name"] = label.isEmpty() ? eventTypeName(e.type) : eventTypeName(e.type) + ": " + label;
+        traceEvent["cat"] = traceTrackName(tid);
+        traceEvent["ph"] = "X";
+        traceEvent["pid"] = pid;
+        traceEvent["tid"] = tid;
+        traceEvent["ts"] = static_cast<qint64>(e.startUs);
+        traceEvent["dur"] = static_cast<qint64>(e.durationUs);
+        traceEvent["args"] = QJsonObject{{"payload", e.payload}};
+        trace.append(traceEvent);
+    }
+    
+    // Ring buffer occupancy, in filled slots
+    for (int i = from.occupancy; i < to.occupancy; ++i) {
+        const OccupancySample &s = _occupancySamples[i];
+        trace.append(traceCounter(QStringLiteral("Ring buffer occupancy"), pid, s.timestampMs,
+                                  QJsonObject{{"input", s.inputSlotsUsed}, {"write", s.writeSlotsUsed}}));
+    }
+    
+    // Name only the tracks that have something on them
+    for (int tid = TrackSession; tid < TrackCount; ++tid) {
+        if (!usedTracks[tid])
+            continue;
+        trace.append(traceMetadata("thread_name", pid, tid, QJsonObject{{"name", traceTrackName(tid)}}));
+        trace.append(traceMetadata("thread_sort_index", pid, tid, QJsonObject{{"sort_index", tid}}));
+    }
+}
+
+QJsonDocument PerformanceStats::exportToChromeTrace() const
+{
+    QMutexLocker locker(&_mutex);
+    
+    QJsonArray trace;
+    const CycleMark end = currentMark();
+    
+    // Background events from before the first cycle (OS list fetch, etc.)
+    const CycleMark first = _cycleMarks.isEmpty() ? end : _cycleMarks.first();
+    if (first.events > 0)
+        appendTraceCycle(trace, 1, QStringLiteral("Background"), CycleMark(), first);
+    
+    for (int c = 0; c < _cycleMarks.size(); ++c) {
+        const CycleMark &to = c + 1 < _cycleMarks.size() ? _cycleMarks[c + 1] : end;
+        QString name = QString("Cycle %1").arg(c + 1);
+        const CycleMark &from = _cycleMarks[c];
+        if (from.events < _events.size() && _events[from.events].type == EventType::CycleStart)
+            name += ": " + _events[from.events].metadata;
+        appendTraceCycle(trace, c + 2, name, from, to);
+    }
+    
+    QJsonObject root;
+    root["traceEvents"] = trace;
+    root["displayTimeUnit"] = "ms";
+    root["otherData"] = QJsonObject{
+        {"exportTime", QDateTime::currentDateTime().toString(Qt::ISODate)},
+        {"imagerVersion", _systemInfo.imagerVersion}
+    };
+    return QJsonDocument(root);
+}
+
+bool PerformanceStats::exportTraceToFile(const QString &filePath) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "PerformanceStats: Failed to open file for writing:" << filePath;
+        return false;
+    }
+    
+    QJsonDocument doc = exportToChromeTrace();
+    file.write(doc.toJson(QJsonDocument::Compact));
+    file.close();
+    
+    qDebug() << "PerformanceStats: Exported trace to" << filePath;
+    return true;
+}
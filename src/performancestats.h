@@ -15,7 +15,9 @@
 #include <QVector>
 #include <QMap>
 #include <QMutex>
+#include <QTimer>
 #include <array>
+#include <vector>
 
 /**
  * @brief Lightweight performance data capture for all imaging operations
@@ -26,6 +28,9 @@
  * Captures:
  * - Discrete events: OS list fetch, drive open, customisation, etc.
  * - Raw progress samples: Timestamp + bytes (processing deferred to export)
+ * - Ring buffer occupancy: Filled slots per buffer, sampled with progress
+ * - Hot-path events (e.g. each write call): pushed lock-free onto a
+ *   per-thread PerfEventRing and drained on the UI thread
  */
 class PerformanceStats : public QObject
 {
@@ -54,6 +59,10 @@ public:
         DriveDiskClean,        // Time to clean disk/remove partitions (Windows)
         DriveRescan,           // Time to rescan disk after cleaning (Windows)
         DriveFormat,           // Time to format drive (for multi-file zips)
+        DriveErase,            // Time to discard/unmap the whole drive before writing
+        DriveCapacityProbe,    // Fake-capacity probe before writing (metadata: reported and detected size)
+        DriveQueueTuning,      // Block queue settings changed for the write (metadata: before and after)
+        DriveUsbPower,         // USB autosuspend/LPM held off for the write (metadata: changes, sync latency)
         
         // Cache operations
         CacheLookup,           // Time to look up file in cache
@@ -84,6 +93,8 @@ public:
         WriteAfterSyncImpact,      // Throughput comparison before/after sync calls
         AsyncIOConfig,             // Async I/O configuration (enabled, supported, queue depth)
         AsyncIOTiming,             // Async I/O wall-clock time and per-write latency stats
+        WriteOperation,            // One write call (fast path; payload: bytes, label: write mode)
+        WriteTuning,               // Write auto-tuner probe or decision (metadata: depth, write size, throughput)
         
         // Cycle boundaries (for multi-write sessions)
         CycleStart,            // Start of a new imaging cycle (metadata: image name, device)
@@ -97,6 +108,7 @@ public:
         SyncFallbackActivated, // Switched from async to sync I/O mode
         DrainAndHotSwap,       // Drained async queue and hot-swapped to sync (metadata: pending count, drain time)
         WatchdogRecovery,      // Watchdog triggered recovery action (metadata: action taken)
+        WriteCancellation,     // From cancelling a write until its thread finished (success: within kCancelTargetMs)
         
         // Customisation
         Customisation,         // Time to apply customisation (config, firstrun, etc.)
@@ -109,15 +121,18 @@ public:
         FatPartitionSetup,     // Time to set up FAT partition
         FinalSync,             // Time for final sync/flush
         DeviceClose,           // Time to close device handles
+        AdditionalTargetResult,// Outcome of an additional (multi-target) device write
         
         // UI operations
         FileDialogOpen,        // Time to open native file dialog (with detailed breakdown)
+        StartupPhase,          // One phase of application startup (metadata: phase, start; see StartupProfile)
 
         // Rpiboot / Fastboot
         RpibootFirmwareSetup,    // Firmware download/cache lookup (FirmwareManager)
         RpibootProtocol,         // USB sideload protocol execution
         RpibootFastbootWait,     // Polling for fastboot device to appear
         FastbootDeviceOpen,      // Opening fastboot USB device
+        FastbootPipelineStats,   // Stalls between fastboot pipeline stages, and the bottleneck
 
         _Count                 // Sentinel for array sizing
     };
@@ -164,6 +179,15 @@ public:
         uint64_t bytesProcessed;   // Total bytes at this point
     };
 
+    /**
+     * @brief Ring buffer fill level (8 bytes)
+     */
+    struct OccupancySample {
+        uint32_t timestampMs;      // Milliseconds from session start
+        uint16_t inputSlotsUsed;
+        uint16_t writeSlotsUsed;
+    };
+
     /**
      * @brief Timed event record
      */
@@ -196,6 +220,8 @@ public:
         QString osVersion;
         QString cpuArchitecture;
         int cpuCoreCount;
+        QString hashBackend;            // SHA256 implementation, e.g. "SHA-NI (internal)"
+        QString threadPlacement;        // Pinning and I/O priorities, see ThreadPlacement::describe()
         
         // Imager version and build info
         QString imagerVersion;          // e.g., "v1.9.2" or "v1.9.2-15-gabcdef0"
@@ -329,6 +355,61 @@ public:
      * @brief Mark operation as finalising
      */
     void recordFinalising();
+    
+    // ===== Lock-free Hot Path Recording =====
+    // For events too frequent for beginEvent()/recordEvent(), such as single
+    // write calls. Safe from any thread; no locks or allocation once the
+    // calling thread has recorded its first event.
+    
+    /**
+     * @brief Intern a label for recordFastEvent(), once per call site:
+     *   static const quint16 label = PerformanceStats::internLabel("sync");
+     * Thread-safe. Returns 0 (no label) once the table is full.
+     */
+    static quint16 internLabel(const char *label);
+    
+    /**
+     * @brief Get an interned label as a string
+     */
+    static QString labelName(quint16 label);
+    
+    /**
+     * @brief Record a finished event on the calling thread's ring
+     * @param durationUs Duration in microseconds, ending now
+     * @param payload Event specific value (e.g. bytes)
+     * @param label From internLabel(), or 0
+     */
+    static void recordFastEvent(EventType type, uint32_t durationUs, qint64 payload = 0, quint16 label = 0) noexcept;
+    
+    /**
+     * @brief Move events from every thread's ring into the session
+     * Runs periodically during a session; call on the UI thread before exporting.
+     */
+    void drainEventRings();
+    
+    /**
+     * @brief Record how many ring buffer slots are filled (lightweight - rate limited)
+     * @param inputSlotsUsed Input buffer (download -> decompress)
+     * @param writeSlotsUsed Write buffer (decompress -> write)
+     */
+    void recordRingBufferOccupancy(quint32 inputSlotsUsed, quint32 writeSlotsUsed);
+    
+    /**
+     * @brief Keep a latency distribution for this cycle, replacing any earlier one of the same name
+     * @param name Operation measured, e.g. "write", "sync" or "verifyRead"
+     * @param buckets rpi_imager::LatencyHistogram counts, one per bucket
+     * @param maxUs Largest latency seen
+     */
+    void recordLatencyHistogram(const QString &name, const QList<quint64> &buckets, quint64 maxUs);
+    
+    /**
+     * @brief Keep a pipeline stage's CPU time for this cycle, replacing any earlier one for the stage
+     * @param stage ThreadCpuTime stage name, e.g. "decompress"
+     * @param cpuMs User and system time of the stage's threads
+     * @param activeMs Time the stage's threads were alive, summed over threads
+     * @param wallMs Wall time of the write
+     */
+    void recordStageCpuTime(const QString &stage, quint32 cpuMs, quint32 activeMs, quint32 wallMs);
 
     // ===== Export (Complex processing happens here) =====
     
@@ -345,6 +426,11 @@ public:
      * and having actual imaging operation data.
      */
     bool hasImagingData() const;
+
+    /**
+     * @brief Number of events of a type recorded so far
+     */
+    int eventCount(EventType type) const;
     
     /**
      * @brief Export performance data to JSON format
@@ -357,6 +443,20 @@ public:
      */
     bool exportToFile(const QString &filePath) const;
     
+    /**
+     * @brief Export as a Chrome Trace Event document (opens in ui.perfetto.dev)
+     * 
+     * Each imaging cycle is a process. Download, decompress, hash, write,
+     * sync and verify each get a track, with throughput and ring buffer
+     * occupancy as counters, so pipeline bubbles show up as gaps.
+     */
+    QJsonDocument exportToChromeTrace() const;
+    
+    /**
+     * @brief Export the Chrome trace to a file
+     */
+    bool exportTraceToFile(const QString &filePath) const;
+    
     /**
      * @brief Get current phase
      */
@@ -375,21 +475,44 @@ public:
 private:
     // Minimum interval between samples (ms) to limit data volume
     static constexpr int MIN_SAMPLE_INTERVAL_MS = 100;
-    // Maximum raw samples per phase
-    static constexpr int MAX_SAMPLES_PER_PHASE = 6000;  // ~10 minutes at 100ms intervals
+    // Maximum raw samples per phase. A phase that reaches it is halved
+    // with Downsample::lttb() and sampled half as often from then on, so a
+    // session of any length keeps its shape (~10 minutes at 100ms before
+    // the first halving, ~1.3 hours at 800ms after three)
+    static constexpr int MAX_SAMPLES_PER_PHASE = 6000;
     
     // Histogram constants (used only at export time)
     static constexpr int HISTOGRAM_BUCKETS = 12;
     static constexpr int HISTOGRAM_WINDOW_MS = 1000;
     
     void addRawSample(Phase phase, quint64 bytesNow, quint64 bytesTotal);
+
+    // Halve a sample series, keeping each cycle's first and last samples
+    // and moving the cycle marks into it along
+    template <typename T, typename Y, typename MarkIndex>
+    void downsampleSeries(QVector<T> &series, Y y, MarkIndex markIndex);
     
     // These are called only during export - complex processing deferred
     QJsonObject buildSummary() const;
     QJsonObject buildHistograms() const;
     QJsonArray buildHistogramForPhase(const QVector<RawSample> &samples) const;
+    QJsonObject buildFastEventStats() const;
+    QJsonArray buildLatencyHistograms() const;
+    QJsonArray buildStageCpuTimes() const;
     int getThroughputBucket(uint32_t kbps) const;
     
+    // Where each cycle starts in the event and sample vectors (cycles
+    // restart the session timer, so they are exported separately)
+    struct CycleMark {
+        int events = 0;
+        int samples[4] = {0, 0, 0, 0};  // download, decompress, write, verify
+        int occupancy = 0;
+        int fastEvents = 0;
+    };
+    CycleMark currentMark() const;
+    void appendTraceCycle(QJsonArray &trace, int pid, const QString &name,
+                          const CycleMark &from, const CycleMark &to) const;
+    
     mutable QMutex _mutex;
     QElapsedTimer _sessionTimer;
     bool _sessionActive;
@@ -433,8 +556,51 @@ private:
     quint64 _writeTotal;
     quint64 _verifyTotal;
 
+    // Ring buffer occupancy samples
+    QVector<OccupancySample> _occupancySamples;
+    
+    // Hot-path events drained from the per-thread rings (24 bytes each)
+    struct FastEvent {
+        uint64_t startUs;      // Microseconds from session start
+        uint32_t durationUs;
+        quint16 label;
+        EventType type;
+        qint64 payload;
+    };
+    static constexpr int MAX_FAST_EVENTS = 131072;
+    static constexpr int DRAIN_INTERVAL_MS = 250;
+    QVector<FastEvent> _fastEvents;
+    quint64 _fastEventsDropped;
+    qint64 _sessionOriginNs;  // steady_clock at startSession(), 0 before the first
+    QTimer _drainTimer;
+    
+    // Per-operation latency distributions, one per name and cycle
+    struct LatencyRecord {
+        int cycle;
+        QString name;
+        std::vector<uint64_t> buckets;
+        quint64 maxUs;
+    };
+    QVector<LatencyRecord> _latencyHistograms;
+    
+    // CPU time by pipeline stage, one per stage and cycle
+    struct StageCpuRecord {
+        int cycle;
+        QString stage;
+        quint32 cpuMs;
+        quint32 activeMs;
+        quint32 wallMs;
+    };
+    QVector<StageCpuRecord> _stageCpuTimes;
+    
+    // Cycle boundaries, one per startSession()
+    QVector<CycleMark> _cycleMarks;
+
     // Rate limiting state
     qint64 _lastSampleTime[4];  // Per-phase last sample time (download, decompress, write, verify)
+    qint64 _lastOccupancySampleTime;
+    int _sampleIntervalMs[4];   // Per-phase, doubled each time the phase is downsampled
+    int _occupancyIntervalMs;
 };
 
 #endif // PERFORMANCESTATS_H
@@ -0,0 +1,53 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "pipelinebalancer.h"
+
+#include <algorithm>
+
+PipelineBalancer::PipelineBalancer(int workers, int maxDecodeThreads)
+    : _workers(std::max(2, workers))
+    , _maxDecode(std::clamp(maxDecodeThreads, 1, _workers - 1))
+    // Decompression feeds everything else, so it starts with all it can
+    // use, leaving at least one core for hashing
+    , _decode(_maxDecode)
+{
+}
+
+bool PipelineBalancer::update(const Sample &totals, int64_t elapsedMs)
+{
+    const uint64_t writerWait = totals.writerWaitMs - _last.writerWaitMs;
+    const uint64_t inputWait = totals.decoderInputWaitMs - _last.decoderInputWaitMs;
+    const uint64_t hashWait = totals.preHashWaitMs - _last.preHashWaitMs;
+    _last = totals;
+
+    if (elapsedMs <= 0)
+        return false;
+    const uint64_t threshold = static_cast<uint64_t>(elapsedMs) * StallPercent / 100;
+
+    const bool decodeBound = writerWait >= threshold && inputWait < threshold;
+    const bool hashBound = hashWait >= threshold;
+
+    // When both hold the write up, the longer wait wins
+    if (decodeBound && (!hashBound || writerWait > hashWait))
+    {
+        if (_decode >= _maxDecode)
+            return false;
+        ++_decode;
+    }
+    else if (hashBound)
+    {
+        if (_decode <= 1)
+            return false;
+        --_decode;
+    }
+    else
+    {
+        return false;
+    }
+
+    ++_shifts;
+    return true;
+}
@@ -0,0 +1,77 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef PIPELINEBALANCER_H
+#define PIPELINEBALANCER_H
+
+#include <cstdint>
+
+/**
+ * @brief Splits the host's cores between parallel decompression and tree hashing
+ *
+ * With verification on, a write of a compressed image keeps two thread
+ * pools busy: the decoder's, decompressing blocks or frames in parallel,
+ * and the tree hash's, hashing the written data for the read-back check.
+ * Sized independently, each would take every core and they would compete.
+ * This balancer shares one budget of workers between them and moves one
+ * worker at a time to whichever stage holds the write up:
+ *
+ *   - Decompression, when the writer waits for decoded data (consumer
+ *     stalls of the write ring buffer) while the decoder itself is not
+ *     waiting for compressed input; more decode threads would not help a
+ *     slow download.
+ *   - Hashing, when writes wait for the hashing thread (pre-hash wait),
+ *     whose tree hash submissions block once its pool falls behind.
+ *
+ * A stage counts as holding the write up if it cost at least
+ * StallPercent of the interval. Each stage keeps at least one worker; the
+ * decoder never gets more than it was created with.
+ *
+ * The caller samples its cumulative counters every IntervalMs and applies
+ * decodeThreads() and hashThreads() to the pools when update() returns
+ * true. Not thread-safe; used from the writing thread.
+ */
+class PipelineBalancer
+{
+public:
+    /**
+     * @brief Cumulative wait times, in milliseconds, since the write started
+     */
+    struct Sample {
+        uint64_t writerWaitMs = 0;        // Writer waiting for decoded data
+        uint64_t decoderInputWaitMs = 0;  // Decoder waiting for compressed data
+        uint64_t preHashWaitMs = 0;       // Writes waiting for the hashing thread
+    };
+
+    static constexpr int64_t IntervalMs = 500;
+    static constexpr int StallPercent = 10;
+
+    /**
+     * @param workers Cores to share out (QThread::idealThreadCount())
+     * @param maxDecodeThreads Threads the decoder was created with
+     */
+    PipelineBalancer(int workers, int maxDecodeThreads);
+
+    /**
+     * @brief Look at the waits since the previous update
+     * @param totals Counters at this point
+     * @param elapsedMs Time since the previous update (or the start)
+     * @return true if the split changed
+     */
+    bool update(const Sample &totals, int64_t elapsedMs);
+
+    int decodeThreads() const { return _decode; }
+    int hashThreads() const { return _workers - _decode; }
+    int shifts() const { return _shifts; }
+
+private:
+    int _workers;
+    int _maxDecode;
+    int _decode;
+    int _shifts = 0;
+    Sample _last;
+};
+
+#endif // PIPELINEBALANCER_H
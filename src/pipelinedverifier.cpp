@@ -0,0 +1,106 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "pipelinedverifier.h"
+#include "threadplacement.h"
+#include "threadcputime.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QtGlobal>
+
+PipelinedVerifier::PipelinedVerifier(rpi_imager::FileOperations *file, AcceleratedCryptographicHash &hash,
+                                     const char *firstBlock, size_t firstBlockSize, size_t bufferSize,
+                                     QObject *parent)
+    : QThread(parent)
+    , _file(file)
+    , _hash(hash)
+    , _firstBlock(firstBlock)
+    , _firstBlockSize(firstBlockSize)
+    , _bufferSize(bufferSize)
+    , _committed(0)
+    , _verified(0)
+    , _stopping(false)
+    , _failed(false)
+{
+}
+
+PipelinedVerifier::~PipelinedVerifier()
+{
+    stop();
+}
+
+void PipelinedVerifier::commit(std::uint64_t offset)
+{
+    QMutexLocker lock(&_mutex);
+    if (offset > _committed)
+    {
+        _committed = offset;
+        _committedChanged.wakeOne();
+    }
+}
+
+std::uint64_t PipelinedVerifier::stop()
+{
+    {
+        QMutexLocker lock(&_mutex);
+        _stopping = true;
+        _committedChanged.wakeOne();
+    }
+    wait();
+    return _verified;
+}
+
+void PipelinedVerifier::run()
+{
+    ThreadPlacement::apply(ThreadPlacement::Role::DeviceIo);
+    ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::Verify);
+    char *buf = static_cast<char *>(qMallocAligned(_bufferSize, 4096));
+    if (!buf)
+    {
+        _failed = true;
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    _hash.addData(_firstBlock, static_cast<int>(_firstBlockSize));
+    _verified = _firstBlockSize;
+
+    while (!_stopping)
+    {
+        std::uint64_t end;
+        {
+            QMutexLocker lock(&_mutex);
+            while (!_stopping && _committed <= _verified)
+                _committedChanged.wait(&_mutex);
+            if (_stopping)
+                break;
+            end = _committed;
+        }
+
+        while (_verified < end && !_stopping)
+        {
+            std::uint64_t pos = _verified;
+            size_t toRead = static_cast<size_t>(qMin(static_cast<std::uint64_t>(_bufferSize), end - pos));
+            size_t lenRead = 0;
+            if (_file->ReadAtOffset(pos, reinterpret_cast<std::uint8_t *>(buf), toRead, lenRead) != rpi_imager::FileError::kSuccess
+                || lenRead != toRead)
+            {
+                qDebug() << "Pipelined verify: read failed at offset" << pos;
+                _failed = true;
+                _stopping = true;
+                break;
+            }
+            _hash.addData(buf, static_cast<int>(lenRead));
+            _verified = pos + lenRead;
+        }
+    }
+
+    qFreeAligned(buf);
+    qDebug() << "Pipelined verify: read back" << _verified / (1024 * 1024) << "MB while writing in"
+             << timer.elapsed() / 1000.0 << "seconds";
+}
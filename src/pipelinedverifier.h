@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef PIPELINEDVERIFIER_H
+#define PIPELINEDVERIFIER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <cstdint>
+#include "acceleratedcryptographichash.h"
+#include "file_operations.h"
+
+/**
+ * @brief Verify-while-writing: reads back committed data behind the write cursor
+ *
+ * DownloadThread calls commit() whenever a region is known to be on the
+ * device (after a periodic sync, or once direct I/O writes have completed)
+ * and has been evicted from the page cache with PrepareForSequentialRead().
+ * The verifier thread reads that region back with ReadAtOffset(), which
+ * does not disturb the write position, and adds it to the verify hash.
+ *
+ * When writing is done, stop() returns how far verification got; the
+ * regular verify pass then only has to read the remaining tail into the
+ * same hash.
+ *
+ * The first block is held back by DownloadThread until the very end, so
+ * it is hashed from memory, as in DownloadThread::_verify().
+ */
+class PipelinedVerifier : public QThread
+{
+    Q_OBJECT
+
+public:
+    PipelinedVerifier(rpi_imager::FileOperations *file, AcceleratedCryptographicHash &hash,
+                      const char *firstBlock, size_t firstBlockSize, size_t bufferSize,
+                      QObject *parent = nullptr);
+    ~PipelinedVerifier() override;
+
+    /**
+     * @brief Mark everything before offset as durable and safe to read back
+     */
+    void commit(std::uint64_t offset);
+
+    /**
+     * @brief Stop after the current read and wait for the thread
+     * @return Offset up to which data has been added to the hash
+     */
+    std::uint64_t stop();
+
+    bool hasFailed() const { return _failed; }
+    std::uint64_t verifiedOffset() const { return _verified; }
+
+protected:
+    void run() override;
+
+private:
+    rpi_imager::FileOperations *_file;
+    AcceleratedCryptographicHash &_hash;
+    const char *_firstBlock;
+    size_t _firstBlockSize;
+    size_t _bufferSize;
+
+    QMutex _mutex;
+    QWaitCondition _committedChanged;
+    std::uint64_t _committed;
+
+    std::atomic<std::uint64_t> _verified;
+    std::atomic<bool> _stopping;
+    std::atomic<bool> _failed;
+};
+
+#endif // PIPELINEDVERIFIER_H
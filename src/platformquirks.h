@@ -153,6 +153,26 @@ namespace PlatformQuirks {
      */
     DiskResult ejectDisk(const QString& device);
 
+    /**
+     * Keep the USB device a disk is attached through awake while it is
+     * written and verified.
+     *
+     * Card readers go into autosuspend or link power management between
+     * bursts, and waking them shows up as latency at the periodic syncs.
+     * On Linux this sets the USB device's power/control to "on" and turns
+     * off USB 2 hardware LPM and USB 3 U1/U2 on its port where the kernel
+     * allows it. On Windows it turns off USB selective suspend in the
+     * active power scheme, which covers all USB devices. Does nothing on
+     * other platforms or for disks that are not on USB.
+     *
+     * @param device The device path (e.g., "/dev/sda", "\\.\PhysicalDrive1")
+     * @return What was changed (e.g., "power/control auto -> on"), empty if nothing
+     */
+    QString holdDevicePowerOn(const QString& device);
+
+    /** Put back what holdDevicePowerOn() changed for device. */
+    void releaseDevicePower(const QString& device);
+
 #ifdef Q_OS_LINUX
     /**
      * Find the system's CA certificate bundle for libcurl.
@@ -0,0 +1,175 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "primedimage.h"
+#include "imagechunkstore.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QStorageInfo>
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+    constexpr qint64 COPY_BLOCK_SIZE = 4 * 1024 * 1024;
+
+    bool isRecipe(const QString &source)
+    {
+        return source.endsWith(QLatin1String(".recipe"));
+    }
+
+    qint64 sourceSize(const QString &source)
+    {
+        if (!isRecipe(source))
+            return QFileInfo(source).size();
+        ImageChunkStore::Reader reader;
+        return reader.open(source) ? reader.size() : 0;
+    }
+
+    bool fitsIn(const QString &directory, qint64 size)
+    {
+        if (directory.isEmpty() || !QDir().mkpath(directory))
+            return false;
+        const QStorageInfo storage(directory);
+        return storage.isValid() && storage.bytesAvailable() >= size;
+    }
+}
+
+PrimedImage::PrimedImage(const QString &ramDirectory, const QString &diskDirectory)
+    : _ramDirectory(ramDirectory), _diskDirectory(diskDirectory)
+{
+}
+
+PrimedImage::~PrimedImage()
+{
+    release();
+}
+
+QString PrimedImage::defaultRamDirectory()
+{
+#ifdef Q_OS_LINUX
+    if (QFileInfo(QStringLiteral("/dev/shm")).isWritable())
+        return QStringLiteral("/dev/shm/rpi-imager");
+#endif
+    return QString();
+}
+
+QString PrimedImage::defaultDiskDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           QDir::separator() + "primed";
+}
+
+bool PrimedImage::prime(const QString &source, const QByteArray &imageHash, qint64 memoryBudget,
+                        const std::atomic<bool> &cancelled)
+{
+    release();
+
+    const qint64 size = sourceSize(source);
+    if (size <= 0 || imageHash.isEmpty())
+        return false;
+
+    // Holes take no space, but the worst case has to fit
+    const QString fileName = QString::fromLatin1(imageHash.left(64)) + QLatin1String(".img");
+    Location location = Location::None;
+    QString target;
+    if (size <= memoryBudget && fitsIn(_ramDirectory, size))
+    {
+        location = Location::Memory;
+        target = _ramDirectory + QDir::separator() + fileName;
+    }
+    else if (fitsIn(_diskDirectory, size))
+    {
+        location = Location::Disk;
+        target = _diskDirectory + QDir::separator() + fileName;
+    }
+    else
+    {
+        qDebug() << "PrimedImage: no room for" << size << "bytes in memory or on disk";
+        return false;
+    }
+
+    if (!copyTo(source, target, cancelled))
+    {
+        QFile::remove(target);
+        return false;
+    }
+
+    _path = target;
+    _location = location;
+    _size = size;
+    qDebug() << "PrimedImage:" << size / (1024 * 1024) << "MB image ready"
+             << (location == Location::Memory ? "in memory at" : "on disk at") << target;
+    return true;
+}
+
+bool PrimedImage::copyTo(const QString &source, const QString &target, const std::atomic<bool> &cancelled)
+{
+    QFile in;
+    ImageChunkStore::Reader reader;
+    std::function<qint64(char *, qint64)> read;
+    if (isRecipe(source))
+    {
+        if (!reader.open(source))
+            return false;
+        read = [&reader](char *buf, qint64 len) { return reader.read(buf, len); };
+    }
+    else
+    {
+        in.setFileName(source);
+        if (!in.open(QIODevice::ReadOnly))
+            return false;
+        read = [&in](char *buf, qint64 len) { return in.read(buf, len); };
+    }
+
+    QFile out(target);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "PrimedImage: cannot create" << target << out.errorString();
+        return false;
+    }
+
+    QByteArray buf(COPY_BLOCK_SIZE, Qt::Uninitialized);
+    qint64 pos = 0;
+    while (!cancelled.load())
+    {
+        // A short read is only the end of the source
+        qint64 len = 0;
+        while (len < buf.size())
+        {
+            const qint64 n = read(buf.data() + len, buf.size() - len);
+            if (n < 0)
+                return false;
+            if (n == 0)
+                break;
+            len += n;
+        }
+        if (len == 0)
+            return out.resize(pos);
+
+        // Zero blocks stay holes, as they are in the cache file
+        const bool zero = std::all_of(buf.constData(), buf.constData() + len, [](char c) { return c == 0; });
+        if (!zero && (!out.seek(pos) || out.write(buf.constData(), len) != len))
+        {
+            qWarning() << "PrimedImage: cannot write" << target << out.errorString();
+            return false;
+        }
+        pos += len;
+    }
+    return false;
+}
+
+void PrimedImage::release()
+{
+    if (!_path.isEmpty())
+        QFile::remove(_path);
+    _path.clear();
+    _location = Location::None;
+    _size = 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef PRIMEDIMAGE_H
+#define PRIMEDIMAGE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <atomic>
+
+/**
+ * @brief A decompressed image kept ready for the daemon's station mode
+ *
+ * Copied from the decompressed image cache, whole, into a RAM-backed
+ * directory (tmpfs) when it fits in memoryBudget, or else into a directory
+ * on the local disk. Writes then read the copy as they would the image
+ * cache, without going to the chunk store, which the cache moves images
+ * into. The copy keeps the holes of the sparse cache file.
+ *
+ * The copy is removed by release() and by the destructor. prime() blocks
+ * for as long as the copy takes, so callers run it on a worker thread.
+ */
+class PrimedImage
+{
+public:
+    enum class Location { None, Memory, Disk };
+
+    PrimedImage(const QString &ramDirectory = defaultRamDirectory(),
+                const QString &diskDirectory = defaultDiskDirectory());
+    ~PrimedImage();
+
+    PrimedImage(const PrimedImage &) = delete;
+    PrimedImage &operator=(const PrimedImage &) = delete;
+
+    // /dev/shm where there is one, otherwise empty (no RAM copy)
+    static QString defaultRamDirectory();
+    static QString defaultDiskDirectory();
+
+    /**
+     * @brief Copy the image to where it is kept ready
+     * @param source Whole decompressed image, or an ImageChunkStore recipe
+     * @param imageHash Names the copy
+     * @param memoryBudget Largest image to keep in RAM, in bytes
+     * @param cancelled Polled between blocks
+     * @return false if it could not be copied anywhere, or was cancelled
+     */
+    bool prime(const QString &source, const QByteArray &imageHash, qint64 memoryBudget,
+               const std::atomic<bool> &cancelled);
+
+    void release();
+
+    QString path() const { return _path; }
+    Location location() const { return _location; }
+    qint64 size() const { return _size; }
+
+private:
+    bool copyTo(const QString &source, const QString &target, const std::atomic<bool> &cancelled);
+
+    QString _ramDirectory;
+    QString _diskDirectory;
+    QString _path;
+    Location _location = Location::None;
+    qint64 _size = 0;
+};
+
+#endif // PRIMEDIMAGE_H
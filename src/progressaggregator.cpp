@@ -0,0 +1,83 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "progressaggregator.h"
+#include "downloadthread.h"
+
+ProgressAggregator::ProgressAggregator(QObject *parent)
+    : QObject(parent)
+{
+    _timer.setInterval(DEFAULT_INTERVAL_MS);
+    connect(&_timer, &QTimer::timeout, this, &ProgressAggregator::_tick);
+}
+
+void ProgressAggregator::start(DownloadThread *thread)
+{
+    _thread = thread;
+    _reported = ProgressSnapshot();
+    if (_snapshot != ProgressSnapshot())
+    {
+        _snapshot = ProgressSnapshot();
+        emit snapshotChanged();
+    }
+    _timer.start();
+}
+
+void ProgressAggregator::stop()
+{
+    if (!_timer.isActive())
+        return;
+    _tick();
+    _timer.stop();
+    _thread = nullptr;
+}
+
+void ProgressAggregator::report(Phase phase, quint64 now, quint64 total)
+{
+    switch (phase)
+    {
+    case Phase::Download:
+        _reported.downloadNow = now;
+        _reported.downloadTotal = total;
+        break;
+    case Phase::Write:
+        _reported.writeNow = now;
+        _reported.writeTotal = total;
+        break;
+    case Phase::Verify:
+        _reported.verifyNow = now;
+        _reported.verifyTotal = total;
+        break;
+    }
+
+    if (!_timer.isActive())
+        _timer.start();
+}
+
+void ProgressAggregator::_tick()
+{
+    ProgressSnapshot next = _reported;
+
+    if (_thread)
+    {
+        // Each counter is atomic on its own; a sample need not be consistent
+        // across them, only recent
+        next.downloadNow = _thread->dlNow();
+        next.downloadTotal = _thread->dlTotal();
+        next.decompressNow = _thread->bytesDecompressed();
+        next.writeNow = _thread->bytesWritten();
+        const quint64 extractTotal = _thread->extractTotal();
+        next.writeTotal = extractTotal > 0 ? extractTotal : next.downloadTotal;
+        next.verifyNow = _thread->verifyNow();
+        next.verifyTotal = _thread->verifyTotal();
+        emit sampled(next);
+    }
+
+    if (next != _snapshot)
+    {
+        _snapshot = next;
+        emit snapshotChanged();
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef PROGRESSAGGREGATOR_H
+#define PROGRESSAGGREGATOR_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#ifndef CLI_ONLY_BUILD
+#include <QQmlEngine>
+#endif
+
+class DownloadThread;
+
+/**
+ * Every progress counter of a write at one point in time, as shown by the UI.
+ * Totals are 0 while not known.
+ */
+struct ProgressSnapshot
+{
+    Q_GADGET
+#ifndef CLI_ONLY_BUILD
+    QML_VALUE_TYPE(progressSnapshot)
+#endif
+    Q_PROPERTY(quint64 downloadNow MEMBER downloadNow)
+    Q_PROPERTY(quint64 downloadTotal MEMBER downloadTotal)
+    Q_PROPERTY(quint64 decompressNow MEMBER decompressNow)
+    Q_PROPERTY(quint64 writeNow MEMBER writeNow)
+    Q_PROPERTY(quint64 writeTotal MEMBER writeTotal)
+    Q_PROPERTY(quint64 verifyNow MEMBER verifyNow)
+    Q_PROPERTY(quint64 verifyTotal MEMBER verifyTotal)
+
+public:
+    quint64 downloadNow = 0;
+    quint64 downloadTotal = 0;
+    quint64 decompressNow = 0;
+    quint64 writeNow = 0;
+    quint64 writeTotal = 0;   // Extract size if known, otherwise download size
+    quint64 verifyNow = 0;
+    quint64 verifyTotal = 0;
+
+    bool operator==(const ProgressSnapshot &other) const = default;
+};
+
+/**
+ * ProgressAggregator - Coalesces write progress to the display rate
+ *
+ * The pipeline threads count progress in atomics. Forwarding every change as
+ * a queued signal wakes the UI thread for each chunk written (and for every
+ * async write completion). Instead this samples the counters of a
+ * DownloadThread on a timer in the UI thread and publishes one snapshot when
+ * something has changed since the last one.
+ *
+ * Sources without such counters (fastboot, cache verification) report()
+ * their progress instead; it is published on the next tick in the same way.
+ *
+ * Usage:
+ *   _progress = new ProgressAggregator(this);
+ *   connect(_progress, &ProgressAggregator::snapshotChanged, this, &MyClass::onProgress);
+ *   _progress->start(thread);
+ */
+class ProgressAggregator : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Phase { Download, Write, Verify };
+
+    static constexpr int DEFAULT_INTERVAL_MS = 100;
+
+    explicit ProgressAggregator(QObject *parent = nullptr);
+
+    void setInterval(int ms) { _timer.setInterval(ms); }
+
+    /// Start from zero, sampling thread's counters if given
+    void start(DownloadThread *thread = nullptr);
+
+    /// Publish the final values and stop sampling
+    void stop();
+
+    /// Progress of a source that is not sampled; starts the timer if needed
+    void report(Phase phase, quint64 now, quint64 total);
+
+    ProgressSnapshot snapshot() const { return _snapshot; }
+
+signals:
+    /// The published snapshot changed
+    void snapshotChanged();
+
+    /// Counters of the sampled thread, on every tick while it runs
+    void sampled(const ProgressSnapshot &sample);
+
+private slots:
+    void _tick();
+
+private:
+    QTimer _timer;
+    QPointer<DownloadThread> _thread;
+    ProgressSnapshot _reported;   // Latest values from report()
+    ProgressSnapshot _snapshot;   // Last published
+};
+
+#endif // PROGRESSAGGREGATOR_H
@@ -47,6 +47,9 @@ ComboBox {
     property string searchString: ""
     property int originalIndex: -1
     property var fullModelData: []
+    // Optional search index parallel to the model: for each item, its
+    // lowercased text from every word start, each preceded by "\n"
+    property var searchKeys: []
     
     // Scroll settings for native-like wheel behavior
     readonly property int itemHeight: 40
@@ -76,11 +79,13 @@ ComboBox {
     function rebuildFilteredModel() {
         filteredModel.clear()
         var search = searchString.toLowerCase()
+        var indexed = searchKeys.length === fullModelData.length
+        var needle = "\n" + search
         for (var i = 0; i < fullModelData.length; i++) {
             var text = fullModelData[i]
             if (search.length === 0 ||
-                text.toLowerCase().startsWith(search) ||
-                wordBoundaryMatch(text, search)) {
+                (indexed ? searchKeys[i].indexOf(needle) !== -1
+                         : (text.toLowerCase().startsWith(search) || wordBoundaryMatch(text, search)))) {
                 filteredModel.append({displayText: text, originalIndex: i})
             }
         }
@@ -14,6 +14,8 @@ SelectionListView {
     // Additional signals for OS-specific navigation
     signal rightPressed(int index, var item, var modelData)
     signal leftPressed()
+    // Icons of the rows on screen and of the page below, reported while scrolling
+    signal iconsInView(var visibleIcons, var upcomingIcons)
     
     // Additional properties for OS selection
     property var osSelectionHandler: null
@@ -23,6 +25,75 @@ SelectionListView {
     property bool lastSelectionWasKeyboard: false
     property bool currentSelectionIsFromMouse: false
     
+    // Role id of "icon" in a C++ model, looked up on first use
+    property int iconRole: -1
+    
+    function iconAt(index) {
+        if (typeof model.get === "function") {
+            var entry = model.get(index)
+            return entry && typeof(entry.icon) === "string" ? entry.icon : ""
+        }
+        if (iconRole === -1 && model.roleNames) {
+            var roles = model.roleNames()
+            for (var roleKey in roles) {
+                if (roles[roleKey] === "icon") {
+                    iconRole = parseInt(roleKey)
+                    break
+                }
+            }
+        }
+        if (iconRole === -1) {
+            return ""
+        }
+        var value = model.data(model.index(index, 0), iconRole)
+        return typeof(value) === "string" ? value : ""
+    }
+    
+    function reportIconsInView() {
+        if (!visible || count === 0 || height <= 0) {
+            return
+        }
+        var first = indexAt(contentX + width / 2, contentY)
+        var last = indexAt(contentX + width / 2, contentY + height - 1)
+        if (first < 0) {
+            first = 0
+        }
+        if (last < 0) {
+            last = count - 1
+        }
+        var visibleIcons = []
+        for (var i = first; i <= last; i++) {
+            visibleIcons.push(iconAt(i))
+        }
+        var upcomingIcons = []
+        var end = Math.min(count - 1, last + (last - first + 1))
+        for (var j = last + 1; j <= end; j++) {
+            upcomingIcons.push(iconAt(j))
+        }
+        root.iconsInView(visibleIcons, upcomingIcons)
+    }
+    
+    // Throttled rather than restarted, so a long fling still reports as it goes
+    Timer {
+        id: iconsInViewTimer
+        interval: 100
+        onTriggered: root.reportIconsInView()
+    }
+    
+    function scheduleIconsInView() {
+        if (!iconsInViewTimer.running) {
+            iconsInViewTimer.start()
+        }
+    }
+    
+    Connections {
+        target: root
+        function onContentYChanged() { root.scheduleIconsInView() }
+        function onHeightChanged() { root.scheduleIconsInView() }
+        function onCountChanged() { root.scheduleIconsInView() }
+        function onVisibleChanged() { root.scheduleIconsInView() }
+    }
+    
     // Override keyboard navigation to add OS-specific features
     Keys.onRightPressed: {
         if (currentIndex !== -1) {
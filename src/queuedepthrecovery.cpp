@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "queuedepthrecovery.h"
+#include <algorithm>
+
+QueueDepthRecovery::Step QueueDepthRecovery::onReduced(int fromDepth, int toDepth, int64_t nowMs)
+{
+    Step step;
+    step.fromDepth = fromDepth;
+    step.toDepth = toDepth;
+    step.resetWindow = true;
+    _steadySinceMs = nowMs;
+
+    switch (_state)
+    {
+    case State::Normal:
+        _targetDepth = fromDepth;
+        _state = State::Degraded;
+        break;
+    case State::Probing:
+        // The last step was too much: back off before trying again
+        if (++_failedProbes >= MaxFailedProbes)
+        {
+            _state = State::GaveUp;
+            step.transition = Transition::GaveUp;
+            break;
+        }
+        _steadyMs *= 2;
+        _state = State::Degraded;
+        step.transition = Transition::ProbeFailed;
+        break;
+    case State::Degraded:
+    case State::GaveUp:
+        break;
+    }
+    return step;
+}
+
+QueueDepthRecovery::Step QueueDepthRecovery::onCheck(int depth, bool progress, uint64_t tailUs,
+                                                     uint64_t samples, int64_t nowMs)
+{
+    Step step;
+    step.fromDepth = depth;
+
+    if (_state == State::Normal)
+    {
+        // The window runs from the start or the last recovery
+        if (samples >= MinWindowSamples)
+            _baselineUs = tailUs;
+        return step;
+    }
+    if (_state == State::GaveUp)
+        return step;
+
+    if (!progress)
+    {
+        // Stalls must not count towards a healthy window
+        _steadySinceMs = nowMs;
+        step.resetWindow = true;
+        return step;
+    }
+
+    if (_state == State::Probing)
+    {
+        if (depth < _stepDepth)
+            return onReduced(_stepDepth, depth, nowMs);  // Reduced by someone else
+        if (nowMs - _stepMs < ProbeMs)
+            return step;
+
+        _failedProbes = 0;
+        _steadySinceMs = nowMs;
+        step.resetWindow = true;
+        if (depth >= _targetDepth)
+        {
+            _state = State::Normal;
+            _steadyMs = _baseSteadyMs;
+            step.transition = Transition::Recovered;
+            step.toDepth = depth;
+            return step;
+        }
+        _state = State::Degraded;
+        return step;
+    }
+
+    // Degraded
+    if (depth >= _targetDepth)
+    {
+        _state = State::Normal;
+        _steadyMs = _baseSteadyMs;
+        step.transition = Transition::Recovered;
+        step.toDepth = depth;
+        step.resetWindow = true;
+        return step;
+    }
+    if (nowMs - _steadySinceMs < _steadyMs)
+        return step;
+
+    _steadySinceMs = nowMs;
+    step.resetWindow = true;
+    const uint64_t healthyUs = std::max(HealthyFloorUs, _baselineUs * HealthyFactor);
+    if (samples < MinWindowSamples || tailUs > healthyUs)
+        return step;  // Progressing, but not normal yet: wait another period
+
+    if (depth <= 1)
+    {
+        step.transition = Transition::ResumeAsync;
+        step.toDepth = std::min(MinDepth, _targetDepth);
+    }
+    else
+    {
+        step.transition = Transition::StepUp;
+        step.toDepth = std::min(_targetDepth, depth * 2);
+    }
+    _state = State::Probing;
+    _stepMs = nowMs;
+    _stepDepth = step.toDepth;
+    return step;
+}
@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef QUEUEDEPTHRECOVERY_H
+#define QUEUEDEPTHRECOVERY_H
+
+#include <cstdint>
+
+/**
+ * @brief Steps the async queue back up after WriteProgressWatchdog degraded it
+ *
+ * A watchdog reduction, or a drain to synchronous writes, used to last for
+ * the rest of the write, so one transient USB hiccup could triple the write
+ * time. This decides when to undo it:
+ *
+ *   Normal --onReduced()--> Degraded --steady and healthy--> Probing
+ *   Probing --ProbeMs without a reduction--> Degraded (next step) or Normal
+ *   Probing --reduced again--> Degraded, with twice the wait (GaveUp after
+ *   MaxFailedProbes in a row)
+ *
+ * In Degraded, a step is only taken after steadyMs in which every check saw
+ * progress and the p99 write latency over that time was at most
+ * HealthyFactor times the p99 seen before the trouble (or HealthyFloorUs).
+ * Synchronous writes resume async at MinDepth; after that each step doubles
+ * the depth, up to the depth before the first reduction.
+ *
+ * The caller measures write latency over a window it restarts whenever a
+ * Step says so, and applies each step to the device.
+ */
+class QueueDepthRecovery
+{
+public:
+    enum class State { Normal, Degraded, Probing, GaveUp };
+    enum class Transition { None, StepUp, ResumeAsync, Recovered, ProbeFailed, GaveUp };
+
+    static constexpr int MinDepth = 2;             // Same floor as recovery reductions
+    static constexpr int64_t ProbeMs = 10000;      // A step that lasts this long without a reduction held
+    static constexpr int MaxFailedProbes = 3;
+    static constexpr uint64_t HealthyFloorUs = 100 * 1000;
+    static constexpr uint64_t HealthyFactor = 2;
+    static constexpr uint64_t MinWindowSamples = 16;
+
+    struct Step {
+        Transition transition = Transition::None;
+        int fromDepth = 0;
+        int toDepth = 0;            // Apply this depth for StepUp and ResumeAsync
+        bool resetWindow = false;   // Restart the latency window
+    };
+
+    explicit QueueDepthRecovery(int64_t steadyMs) : _baseSteadyMs(steadyMs), _steadyMs(steadyMs) {}
+
+    /**
+     * @brief The watchdog reduced the depth
+     * @param toDepth New depth; 1 when drained to synchronous writes
+     * @return ProbeFailed or GaveUp if this undid a step, else None
+     */
+    Step onReduced(int fromDepth, int toDepth, int64_t nowMs);
+
+    /**
+     * @brief One watchdog check
+     * @param depth Effective depth now; 1 while writing synchronously
+     * @param progress Whether anything completed since the last check
+     * @param tailUs p99 write latency over the current window
+     * @param samples Writes in the current window
+     */
+    Step onCheck(int depth, bool progress, uint64_t tailUs, uint64_t samples, int64_t nowMs);
+
+    State state() const { return _state; }
+    int targetDepth() const { return _targetDepth; }
+    int64_t steadyMs() const { return _steadyMs; }
+
+private:
+    State _state = State::Normal;
+    int64_t _baseSteadyMs;
+    int64_t _steadyMs;
+    int64_t _steadySinceMs = 0;
+    int64_t _stepMs = 0;
+    int _targetDepth = 0;
+    int _stepDepth = 0;             // Depth set by the last step
+    int _failedProbes = 0;
+    uint64_t _baselineUs = 0;       // p99 before the first reduction
+};
+
+#endif // QUEUEDEPTHRECOVERY_H
@@ -0,0 +1,269 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "remotesizeprobe.h"
+#include <QDebug>
+#include <QtEndian>
+#include <cstring>
+#include <lzma.h>
+#include <zstd.h>
+
+namespace {
+
+struct Fetch {
+    QByteArray data;
+    qint64 limit = 0;
+    qint64 totalSize = -1;
+};
+
+size_t fetchWrite(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    auto *f = static_cast<Fetch *>(userdata);
+    const size_t n = size * nmemb;
+    // A server that ignores the range sends the whole file
+    if (f->data.size() + static_cast<qint64>(n) > f->limit)
+        return 0;
+    f->data.append(ptr, static_cast<qsizetype>(n));
+    return n;
+}
+
+size_t fetchHeader(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    auto *f = static_cast<Fetch *>(userdata);
+    const QByteArray line = QByteArray(ptr, static_cast<qsizetype>(size * nmemb)).trimmed();
+    const QByteArray lower = line.toLower();
+
+    if (lower.startsWith("http/"))
+    {
+        // New response (e.g. after a redirect) - only the final one counts
+        f->totalSize = -1;
+    }
+    else if (lower.startsWith("content-range:"))
+    {
+        const int slash = line.lastIndexOf('/');
+        bool ok = false;
+        const qint64 total = slash < 0 ? -1 : line.mid(slash + 1).trimmed().toLongLong(&ok);
+        f->totalSize = ok ? total : -1;
+    }
+    return size * nmemb;
+}
+
+// Bytes first to last of url; false unless the server sent just those
+bool fetchRange(const QByteArray &url, const RemoteSizeProbe::HandleFactory &makeHandle,
+                qint64 first, qint64 last, QByteArray &data, qint64 &totalSize)
+{
+    CURL *easy = makeHandle();
+    if (!easy)
+        return false;
+
+    Fetch f;
+    f.limit = last - first + 1;
+    const QByteArray range = QByteArray::number(first) + "-" + QByteArray::number(last);
+    curl_easy_setopt(easy, CURLOPT_URL, url.constData());
+    curl_easy_setopt(easy, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(easy, CURLOPT_RESUME_FROM_LARGE, static_cast<curl_off_t>(0));
+    curl_easy_setopt(easy, CURLOPT_RANGE, range.constData());
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &fetchWrite);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &f);
+    curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, &fetchHeader);
+    curl_easy_setopt(easy, CURLOPT_HEADERDATA, &f);
+    curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, RemoteSizeProbe::kTimeoutMs);
+
+    CURLcode ret = curl_easy_perform(easy);
+    long responseCode = 0;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &responseCode);
+    curl_easy_cleanup(easy);
+
+    if (ret != CURLE_OK || responseCode != 206 || f.data.size() != f.limit)
+    {
+        qDebug() << "Size probe: range" << range << ":" << curl_easy_strerror(ret) << "HTTP" << responseCode;
+        return false;
+    }
+    data = f.data;
+    totalSize = f.totalSize;
+    return true;
+}
+
+quint16 le16(const QByteArray &data, qsizetype pos)
+{
+    return qFromLittleEndian<quint16>(data.constData() + pos);
+}
+
+quint32 le32(const QByteArray &data, qsizetype pos)
+{
+    return qFromLittleEndian<quint32>(data.constData() + pos);
+}
+
+quint64 le64(const QByteArray &data, qsizetype pos)
+{
+    return qFromLittleEndian<quint64>(data.constData() + pos);
+}
+
+} // namespace
+
+quint64 RemoteSizeProbe::probe(const QByteArray &url, const HandleFactory &makeHandle)
+{
+    QByteArray head;
+    qint64 fileSize = -1;
+    if (!fetchRange(url, makeHandle, 0, kHeadBytes - 1, head, fileSize) || fileSize <= 0)
+        return 0;
+
+    static const char xzMagic[6] = { '\xFD', '7', 'z', 'X', 'Z', '\x00' };
+    const bool xz = ::memcmp(head.constData(), xzMagic, sizeof(xzMagic)) == 0;
+    const bool zip = head.startsWith("PK\x03\x04");
+    if (head.startsWith("\x28\xB5\x2F\xFD"))
+        return zstdContentSize(head, fileSize);
+    if (!xz && !zip)
+        return 0;
+
+    // Index or end of central directory, and usually all of the directory
+    QByteArray tail;
+    qint64 total = -1;
+    const qint64 tailSize = qMin(kTailBytes, fileSize);
+    if (!fetchRange(url, makeHandle, fileSize - tailSize, fileSize - 1, tail, total) || total != fileSize)
+        return 0;
+
+    if (xz)
+    {
+        const qint64 indexSize = xzIndexSize(tail.right(LZMA_STREAM_HEADER_SIZE));
+        if (!indexSize || indexSize > kMaxDirectoryBytes || indexSize > fileSize)
+            return 0;
+        if (indexSize > tail.size()
+            && !fetchRange(url, makeHandle, fileSize - indexSize, fileSize - 1, tail, total))
+            return 0;
+        return xzUncompressedSize(tail.right(indexSize));
+    }
+
+    qint64 offset = 0, size = 0;
+    if (!zipCentralDirectory(tail, fileSize, offset, size) || size > kMaxDirectoryBytes)
+        return 0;
+    QByteArray directory;
+    const qint64 tailStart = fileSize - tail.size();
+    if (offset >= tailStart)
+        directory = tail.mid(offset - tailStart, size);
+    else if (!fetchRange(url, makeHandle, offset, offset + size - 1, directory, total))
+        return 0;
+    return zipImageSize(directory);
+}
+
+quint64 RemoteSizeProbe::zstdContentSize(const QByteArray &head, qint64 fileSize)
+{
+    unsigned long long size = ZSTD_getFrameContentSize(head.constData(), static_cast<size_t>(head.size()));
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN)
+        return 0;
+    // Multi-frame files record each frame's size on its own
+    if (size < static_cast<unsigned long long>(fileSize))
+        return 0;
+    return size;
+}
+
+qint64 RemoteSizeProbe::xzIndexSize(const QByteArray &footer)
+{
+    if (footer.size() != LZMA_STREAM_HEADER_SIZE)
+        return 0;
+    lzma_stream_flags flags;
+    if (lzma_stream_footer_decode(&flags, reinterpret_cast<const uint8_t *>(footer.constData())) != LZMA_OK)
+        return 0;
+    return static_cast<qint64>(flags.backward_size) + LZMA_STREAM_HEADER_SIZE;
+}
+
+quint64 RemoteSizeProbe::xzUncompressedSize(const QByteArray &index)
+{
+    const qint64 indexSize = xzIndexSize(index.right(LZMA_STREAM_HEADER_SIZE));
+    if (!indexSize || indexSize != index.size())
+        return 0;
+
+    lzma_index *idx = nullptr;
+    uint64_t memlimit = UINT64_MAX;
+    size_t pos = 0;
+    const size_t len = static_cast<size_t>(index.size() - LZMA_STREAM_HEADER_SIZE);
+    if (lzma_index_buffer_decode(&idx, &memlimit, nullptr, reinterpret_cast<const uint8_t *>(index.constData()),
+                                 &pos, len) != LZMA_OK)
+        return 0;
+
+    quint64 size = pos == len ? lzma_index_uncompressed_size(idx) : 0;
+    lzma_index_end(idx, nullptr);
+    return size;
+}
+
+bool RemoteSizeProbe::zipCentralDirectory(const QByteArray &tail, qint64 fileSize, qint64 &offset, qint64 &size)
+{
+    // The end of central directory record is 22 bytes plus a comment
+    qsizetype eocd = -1;
+    for (qsizetype i = tail.size() - 22; i >= 0; --i)
+    {
+        if (le32(tail, i) == 0x06054b50 && i + 22 + le16(tail, i + 20) == tail.size())
+        {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0)
+        return false;
+
+    const quint16 entries = le16(tail, eocd + 10);
+    size = le32(tail, eocd + 12);
+    offset = le32(tail, eocd + 16);
+    if (entries == 0xFFFF || size == 0xFFFFFFFF || offset == 0xFFFFFFFF)
+    {
+        // zip64: the locator just before points at the zip64 record
+        const qsizetype locator = eocd - 20;
+        if (locator < 0 || le32(tail, locator) != 0x07064b50)
+            return false;
+        const qint64 record = static_cast<qint64>(le64(tail, locator + 8)) - (fileSize - tail.size());
+        if (record < 0 || record + 56 > locator || le32(tail, record) != 0x06064b50)
+            return false;
+        size = static_cast<qint64>(le64(tail, record + 40));
+        offset = static_cast<qint64>(le64(tail, record + 48));
+    }
+    return size > 0 && offset >= 0 && offset <= fileSize - size;
+}
+
+quint64 RemoteSizeProbe::zipImageSize(const QByteArray &centralDirectory)
+{
+    const QByteArray &cd = centralDirectory;
+    quint64 imageSize = 0;
+    int files = 0;
+    qsizetype pos = 0;
+    while (pos < cd.size())
+    {
+        if (pos + 46 > cd.size() || le32(cd, pos) != 0x02014b50)
+            return 0;
+        quint64 uncompressed = le32(cd, pos + 24);
+        const quint16 nameLen = le16(cd, pos + 28);
+        const quint16 extraLen = le16(cd, pos + 30);
+        const quint16 commentLen = le16(cd, pos + 32);
+        const qsizetype extra = pos + 46 + nameLen;
+        const qsizetype next = extra + extraLen + commentLen;
+        if (next > cd.size())
+            return 0;
+
+        if (uncompressed == 0xFFFFFFFF)
+        {
+            // The zip64 extra field starts with the sizes that did not fit
+            uncompressed = 0;
+            for (qsizetype e = extra; e + 4 <= extra + extraLen;)
+            {
+                const quint16 id = le16(cd, e);
+                const quint16 len = le16(cd, e + 2);
+                if (id == 0x0001 && len >= 8 && e + 4 + 8 <= extra + extraLen)
+                {
+                    uncompressed = le64(cd, e + 4);
+                    break;
+                }
+                e += 4 + len;
+            }
+        }
+
+        if (!cd.mid(pos + 46, nameLen).endsWith('/') && uncompressed > 0)
+        {
+            files++;
+            imageSize = uncompressed;
+        }
+        pos = next;
+    }
+    return files == 1 ? imageSize : 0;
+}
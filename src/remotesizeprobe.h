@@ -0,0 +1,82 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef REMOTESIZEPROBE_H
+#define REMOTESIZEPROBE_H
+
+#include <QByteArray>
+#include <functional>
+#include <curl/curl.h>
+
+/**
+ * @brief Reads the uncompressed size of a remote image from its metadata
+ *
+ * Custom URLs come without the OS list's extract_size. Most formats record
+ * the size somewhere other than where decompression would find it:
+ * - xz has it in the index at the end of the file.
+ * - zip has it in the central directory at the end.
+ * - zstd may have it in the frame header at the start.
+ *
+ * A few small range requests fetch those parts before the download
+ * starts. A server that does not take range requests, or a format without
+ * a recorded size (gzip's is only modulo 4 GiB), gives 0: size unknown.
+ */
+class RemoteSizeProbe
+{
+public:
+    static constexpr qint64 kHeadBytes = 64;
+    // Largest zip end of central directory (with a 64 KiB comment) plus
+    // the zip64 locator and record, and xz indexes of a few thousand blocks
+    static constexpr qint64 kTailBytes = 128 * 1024;
+    // Largest xz index or zip central directory fetched separately
+    static constexpr qint64 kMaxDirectoryBytes = 16 * 1024 * 1024;
+    static constexpr long kTimeoutMs = 5000;
+
+    // Returns a handle with the download's settings (proxy, CA bundle, ...)
+    using HandleFactory = std::function<CURL *()>;
+
+    /**
+     * @brief Uncompressed size of the image at url
+     * @return 0 if it cannot be told
+     */
+    static quint64 probe(const QByteArray &url, const HandleFactory &makeHandle);
+
+    /**
+     * @brief Content size from the header of a single-frame zstd file
+     * @param head Start of the file
+     * @param fileSize Compressed size; a first frame that decodes to less
+     *                 is taken for one of many, and gives 0
+     */
+    static quint64 zstdContentSize(const QByteArray &head, qint64 fileSize);
+
+    /**
+     * @brief Bytes of index plus stream footer at the end of an xz file
+     * @param footer Last 12 bytes of the file
+     * @return 0 if footer is not an xz stream footer
+     */
+    static qint64 xzIndexSize(const QByteArray &footer);
+
+    /**
+     * @brief Uncompressed size from the index of the last xz stream
+     * @param index The last xzIndexSize() bytes of the file
+     */
+    static quint64 xzUncompressedSize(const QByteArray &index);
+
+    /**
+     * @brief Find the central directory of a zip file from its end
+     * @param tail Last bytes of the file, at least the end of central
+     *             directory record (and zip64 locator and record if used)
+     * @return false if there is no end of central directory record
+     */
+    static bool zipCentralDirectory(const QByteArray &tail, qint64 fileSize, qint64 &offset, qint64 &size);
+
+    /**
+     * @brief Uncompressed size of the only file in a zip central directory
+     * @return 0 unless exactly one entry has data
+     */
+    static quint64 zipImageSize(const QByteArray &centralDirectory);
+};
+
+#endif // REMOTESIZEPROBE_H
@@ -4,10 +4,11 @@
  */
 
 #include "ringbuffer.h"
+#include "tracepoints.h"
 #include <QtGlobal>
 #include <QString>
+#include <algorithm>
 #include <chrono>
-
 RingBuffer::RingBuffer(size_t numSlots, size_t slotSize, size_t alignment)
     : _numSlots(numSlots)
     , _slotSize(slotSize)
@@ -16,6 +17,8 @@ RingBuffer::RingBuffer(size_t numSlots, size_t slotSize, size_t alignment)
     , _readIndex(0)
     , _committedCount(0)
     , _availableCount(numSlots)
+    , _producerWaiting(false)
+    , _consumerWaiting(false)
     , _producerDone(false)
     , _cancelled(false)
     , _stallTimeoutExceeded(false)
@@ -25,30 +28,42 @@ RingBuffer::RingBuffer(size_t numSlots, size_t slotSize, size_t alignment)
     , _producerWaitMs(0)
     , _consumerWaitMs(0)
     , _sessionTimer(nullptr)
+    , _hugePageSlots(0)
+    , _slotRefs(std::make_unique<std::atomic<int>[]>(numSlots))
+    , _retaining(false)
+    , _releaseIndex(0)
+    , _released(numSlots, 0)
+    , _slotLimit(numSlots)
+    , _parkedCount(0)
+    , _parked(numSlots, 0)
 {
     _slots.resize(numSlots);
     _memory.reserve(numSlots);
     
-    // Pre-allocate aligned memory for each slot
+    // Slot memory is borrowed from the process-wide pool, which backs
+    // multi-megabyte slots with huge pages where possible
     for (size_t i = 0; i < numSlots; ++i) {
-        char* mem = static_cast<char*>(qMallocAligned(slotSize, alignment));
+        BufferPool::Buffer mem = BufferPool::instance().acquire(slotSize, alignment, SLOT_ALLOCATION_WAIT_MS);
         if (!mem) {
             qDebug() << "RingBuffer: Failed to allocate slot" << i;
-            // Clean up already allocated
-            for (char* ptr : _memory) {
-                qFreeAligned(ptr);
-            }
+            // Already allocated slots go back to the pool
             _memory.clear();
             throw std::bad_alloc();
         }
-        _memory.push_back(mem);
-        _slots[i].data = mem;
+        if (mem.isHugePage()) {
+            _hugePageSlots++;
+        }
+        _slots[i].data = mem.data();
         _slots[i].capacity = slotSize;
         _slots[i].size = 0;
+        _memory.push_back(std::move(mem));
     }
     
     qDebug() << "RingBuffer: Allocated" << numSlots << "slots of" 
              << slotSize / 1024 << "KB each (" << (numSlots * slotSize) / (1024 * 1024) << "MB total)";
+    if (_hugePageSlots > 0) {
+        qDebug() << "RingBuffer:" << _hugePageSlots << "of" << numSlots << "slots backed by huge pages";
+    }
 }
 
 RingBuffer::~RingBuffer()
@@ -72,17 +87,96 @@ RingBuffer::~RingBuffer()
         }
     }
     
-    // Free all allocated memory
-    for (char* ptr : _memory) {
-        qFreeAligned(ptr);
-    }
+    // Slot memory goes back to the pool
     _memory.clear();
 }
 
+bool RingBuffer::_tryTake(std::atomic<size_t>& count)
+{
+    size_t current = count.load();
+    while (current > 0) {
+        if (count.compare_exchange_weak(current, current - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+RingBuffer::Slot* RingBuffer::_takeWriteSlot()
+{
+    const size_t index = _writeIndex.fetch_add(1) % _numSlots;
+    _slotRefs[index] = 1;
+    return &_slots[index];
+}
+
 RingBuffer::Slot* RingBuffer::acquireWriteSlot(int timeoutMs)
 {
+    for (;;) {
+        Slot* slot = _acquireWriteSlot(timeoutMs);
+        if (!slot || !_applySlotLimit(slot)) {
+            RPI_TRACE1(ring_write_acquire, slot ? slot - _slots.data() : -1);
+            return slot;
+        }
+        // Parked: passes through the ring empty, the consumer skips it
+        commitWriteSlot(slot, 0);
+    }
+}
+
+bool RingBuffer::_applySlotLimit(Slot* slot)
+{
+    const size_t index = static_cast<size_t>(slot - _slots.data());
+    const size_t active = _numSlots - _parkedCount.load(std::memory_order_relaxed);
+    const size_t limit = _slotLimit.load(std::memory_order_relaxed);
+    
+    if (!_parked[index] && active > limit) {
+        if (_memory[index].isHugePage()) {
+            _hugePageSlots--;
+        }
+        _memory[index].release();
+        slot->data = nullptr;
+        _parked[index] = 1;
+        _parkedCount.fetch_add(1);
+    } else if (_parked[index] && active < limit) {
+        BufferPool::Buffer mem = BufferPool::instance().acquire(_slotSize, _alignment);
+        if (mem) {
+            if (mem.isHugePage()) {
+                _hugePageSlots++;
+            }
+            slot->data = mem.data();
+            _memory[index] = std::move(mem);
+            _parked[index] = 0;
+            _parkedCount.fetch_sub(1);
+        }
+    }
+    return _parked[index] != 0;
+}
+
+void RingBuffer::setSlotLimit(size_t slots)
+{
+    slots = std::clamp(slots, std::min(MIN_ACTIVE_SLOTS, _numSlots), _numSlots);
+    if (_slotLimit.exchange(slots) != slots) {
+        qDebug() << "RingBuffer: slot limit" << slots << "of" << _numSlots;
+    }
+}
+
+RingBuffer::Slot* RingBuffer::_acquireWriteSlot(int timeoutMs)
+{
+    // Fast path: a slot is free. Only the producer advances _writeIndex,
+    // so no lock is needed.
+    if (!_cancelled && !_stallTimeoutExceeded && _tryTake(_availableCount)) {
+        return _takeWriteSlot();
+    }
+    
     std::unique_lock<std::mutex> lock(_mutex);
     
+    // Waiting flag tells releaseReadSlot() to take the mutex and notify.
+    // Set before the count is re-checked so a release cannot be missed.
+    _producerWaiting = true;
+    struct ClearOnExit {
+        std::atomic<bool>& flag;
+        ~ClearOnExit() { flag = false; }
+    } clearWaiting{_producerWaiting};
+    
     auto waitPred = [this] {
         return _availableCount > 0 || _cancelled || _stallTimeoutExceeded;
     };
@@ -124,6 +218,7 @@ RingBuffer::Slot* RingBuffer::acquireWriteSlot(int timeoutMs)
         auto waitEnd = std::chrono::steady_clock::now();
         auto waitDuration = std::chrono::duration_cast<std::chrono::milliseconds>(waitEnd - waitStart).count();
         _producerWaitMs += (waitDuration - cumulativeWaitMs);  // Add remaining time not counted in loop
+        RPI_TRACE1(ring_producer_stall, waitDuration);
         
         // Record significant stalls for time-series correlation
         if (waitDuration >= STALL_EVENT_THRESHOLD_MS) {
@@ -140,15 +235,11 @@ RingBuffer::Slot* RingBuffer::acquireWriteSlot(int timeoutMs)
         return nullptr;
     }
     
-    // Get the next write slot
-    size_t index = _writeIndex % _numSlots;
-    Slot* slot = &_slots[index];
-    
-    // Advance write index and decrement available count
-    _writeIndex++;
-    _availableCount--;
-    
-    return slot;
+    // Only releases can change the count now, so this cannot fail
+    if (!_tryTake(_availableCount)) {
+        return nullptr;
+    }
+    return _takeWriteSlot();
 }
 
 void RingBuffer::commitWriteSlot(Slot* slot, size_t dataSize)
@@ -156,20 +247,43 @@ void RingBuffer::commitWriteSlot(Slot* slot, size_t dataSize)
     if (!slot) return;
     
     slot->size = dataSize;
+    _committedCount.fetch_add(1);
+    RPI_TRACE2(ring_write_commit, slot - _slots.data(), dataSize);
     
-    {
+    // Signal consumer that data is available (only if it is blocked)
+    if (_consumerWaiting) {
         std::lock_guard<std::mutex> lock(_mutex);
-        _committedCount++;
+        _readAvailable.notify_one();
     }
-    
-    // Signal consumer that data is available
-    _readAvailable.notify_one();
 }
 
 RingBuffer::Slot* RingBuffer::acquireReadSlot(int timeoutMs)
 {
+    for (;;) {
+        Slot* slot = _acquireReadSlot(timeoutMs);
+        if (!slot || !_parked[static_cast<size_t>(slot - _slots.data())]) {
+            RPI_TRACE2(ring_read_acquire, slot ? slot - _slots.data() : -1, slot ? slot->size : 0);
+            return slot;
+        }
+        releaseReadSlot(slot);
+    }
+}
+
+RingBuffer::Slot* RingBuffer::_acquireReadSlot(int timeoutMs)
+{
+    // Fast path: data is ready. Only the consumer advances _readIndex.
+    if (!_cancelled && !_stallTimeoutExceeded && _tryTake(_committedCount)) {
+        return &_slots[_readIndex.fetch_add(1) % _numSlots];
+    }
+    
     std::unique_lock<std::mutex> lock(_mutex);
     
+    _consumerWaiting = true;
+    struct ClearOnExit {
+        std::atomic<bool>& flag;
+        ~ClearOnExit() { flag = false; }
+    } clearWaiting{_consumerWaiting};
+    
     auto waitPred = [this] {
         return _committedCount > 0 || _producerDone || _cancelled || _stallTimeoutExceeded;
     };
@@ -211,6 +325,7 @@ RingBuffer::Slot* RingBuffer::acquireReadSlot(int timeoutMs)
         auto waitEnd = std::chrono::steady_clock::now();
         auto waitDuration = std::chrono::duration_cast<std::chrono::milliseconds>(waitEnd - waitStart).count();
         _consumerWaitMs += (waitDuration - cumulativeWaitMs);  // Add remaining time not counted in loop
+        RPI_TRACE1(ring_consumer_stall, waitDuration);
         
         // Record significant stalls for time-series correlation
         if (waitDuration >= STALL_EVENT_THRESHOLD_MS) {
@@ -228,23 +343,16 @@ RingBuffer::Slot* RingBuffer::acquireReadSlot(int timeoutMs)
     }
     
     // Check if producer is done and no more data
-    if (_committedCount == 0) {
+    if (!_tryTake(_committedCount)) {
         if (_producerDone) {
             return nullptr;  // EOF
         }
         // Spurious wakeup, try again
-        return acquireReadSlot(timeoutMs);
+        lock.unlock();
+        return _acquireReadSlot(timeoutMs);
     }
     
-    // Get the next read slot
-    size_t index = _readIndex % _numSlots;
-    Slot* slot = &_slots[index];
-    
-    // Advance read index and decrement committed count
-    _readIndex++;
-    _committedCount--;
-    
-    return slot;
+    return &_slots[_readIndex.fetch_add(1) % _numSlots];
 }
 
 RingBuffer::StallType RingBuffer::getStallType() const
@@ -256,15 +364,50 @@ void RingBuffer::releaseReadSlot(Slot* slot)
 {
     if (!slot) return;
     
+    const size_t index = static_cast<size_t>(slot - _slots.data());
+    if (_slotRefs[index].fetch_sub(1) > 1) {
+        return;  // Still held by another reader
+    }
+    RPI_TRACE1(ring_read_release, index);
+    
     slot->size = 0;  // Reset size
     
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        _availableCount++;
+    if (!_retaining) {
+        // Single consumer: slots come back in ring order
+        _releaseIndex.fetch_add(1);
+        _availableCount.fetch_add(1);
+        
+        // Signal producer that slot is available (only if it is blocked)
+        if (_producerWaiting) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _writeAvailable.notify_one();
+        }
+        return;
+    }
+    
+    // With a second reader a newer slot can be done before an older one;
+    // the producer reuses slots in ring order, so only hand back the run
+    // of released slots starting at the oldest
+    std::lock_guard<std::mutex> lock(_mutex);
+    _released[index] = 1;
+    size_t freed = 0;
+    while (_released[_releaseIndex % _numSlots]) {
+        _released[_releaseIndex % _numSlots] = 0;
+        _releaseIndex.fetch_add(1);
+        ++freed;
     }
+    if (freed > 0) {
+        _availableCount.fetch_add(freed);
+        _writeAvailable.notify_one();
+    }
+}
+
+void RingBuffer::retainSlot(Slot* slot)
+{
+    if (!slot) return;
     
-    // Signal producer that slot is available
-    _writeAvailable.notify_one();
+    _retaining = true;
+    _slotRefs[static_cast<size_t>(slot - _slots.data())].fetch_add(1);
 }
 
 void RingBuffer::producerDone()
@@ -312,6 +455,12 @@ void RingBuffer::reset()
     _readIndex = 0;
     _committedCount = 0;
     _availableCount = _numSlots;
+    _retaining = false;
+    _releaseIndex = 0;
+    std::fill(_released.begin(), _released.end(), 0);
+    for (size_t i = 0; i < _numSlots; ++i) {
+        _slotRefs[i] = 0;
+    }
     _producerDone = false;
     _cancelled = false;
     _stallTimeoutExceeded = false;
@@ -12,11 +12,13 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <memory>
 #include <vector>
 #include <queue>
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QString>
+#include "bufferpool.h"
 
 /**
  * @brief Lock-free (for single producer/consumer) ring buffer with pre-allocated slots
@@ -30,6 +32,9 @@
  * - Zero-copy: producer writes directly to buffer, consumer reads directly
  * - Blocking acquire with timeout for graceful shutdown
  * - Thread-safe for single producer / single consumer pattern
+ * - Acquire, commit and release are plain atomic operations while the
+ *   buffer is neither full nor empty; the mutex and condition variables
+ *   are only used when a side actually has to wait
  */
 class RingBuffer
 {
@@ -131,6 +136,20 @@ public:
      */
     void releaseReadSlot(Slot* slot);
 
+    /**
+     * @brief Keep a slot's data alive for a second reader (producer side)
+     *
+     * Called on an acquired slot before commitWriteSlot(). The slot is only
+     * handed back to the producer after releaseReadSlot() has been called
+     * once more for every retain, so e.g. the cache writer can consume the
+     * same slots as the extractor without its own copy. Slots are still
+     * recycled in ring order: if the second reader lags, the producer
+     * waits for it.
+     *
+     * @param slot The slot to retain
+     */
+    void retainSlot(Slot* slot);
+
     /**
      * @brief Signal that producer is done (no more data will be written)
      */
@@ -173,6 +192,54 @@ public:
      */
     size_t numSlots() const { return _numSlots; }
 
+    /**
+     * @brief Get number of slots filled and waiting for the consumer
+     */
+    size_t committedSlots() const { return _committedCount.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Check if the consumer is blocked waiting for a committed slot
+     *
+     * A producer that fills a slot in pieces can keep adding to it while
+     * the consumer is busy, and commit it as soon as the consumer runs dry.
+     */
+    bool isConsumerWaiting() const { return _consumerWaiting.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Get a slot by index (e.g. to register slot memory for I/O)
+     */
+    const Slot& slotAt(size_t index) const { return _slots[index]; }
+
+    /**
+     * @brief Get number of slots backed by huge (large) pages
+     */
+    size_t hugePageSlots() const { return _hugePageSlots; }
+
+    /**
+     * @brief Limit how many slots hold memory, e.g. under memory pressure
+     *
+     * As the producer comes round to a slot above the limit, its memory goes
+     * back to the buffer pool and the slot passes through the ring empty,
+     * without the consumer seeing it. Raising the limit brings slots back
+     * the same way, as far as the pool can serve them. Not for rings whose
+     * slot memory is registered for I/O (see slotAt()).
+     *
+     * @param slots At least MIN_ACTIVE_SLOTS; numSlots() for no limit
+     */
+    void setSlotLimit(size_t slots);
+
+    /**
+     * @brief Get the slot limit set by setSlotLimit()
+     */
+    size_t slotLimit() const { return _slotLimit.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Get number of slots whose memory has gone back to the pool
+     */
+    size_t parkedSlots() const { return _parkedCount.load(std::memory_order_relaxed); }
+
+    static constexpr size_t MIN_ACTIVE_SLOTS = 2;
+
     /**
      * @brief Reset the ring buffer for reuse
      */
@@ -206,7 +273,8 @@ private:
     size_t _alignment;
     
     std::vector<Slot> _slots;
-    std::vector<char*> _memory;  // Raw memory blocks for cleanup
+    std::vector<BufferPool::Buffer> _memory;  // Slot memory borrowed from the pool
+    size_t _hugePageSlots;
     
     // Ring buffer indices
     std::atomic<size_t> _writeIndex;  // Next slot to write
@@ -214,7 +282,12 @@ private:
     std::atomic<size_t> _committedCount;  // Number of committed (readable) slots
     std::atomic<size_t> _availableCount;  // Number of available (writable) slots
     
-    // Synchronization
+    // Set while a side is blocked in the slow path, so the other side only
+    // takes the mutex to notify when someone is waiting
+    std::atomic<bool> _producerWaiting;
+    std::atomic<bool> _consumerWaiting;
+    
+    // Synchronization (slow path only)
     std::mutex _mutex;
     std::condition_variable _writeAvailable;  // Signaled when slot available for writing
     std::condition_variable _readAvailable;   // Signaled when data available for reading
@@ -242,6 +315,36 @@ private:
     // low-level data structure, but values should be kept in sync.
     static const uint32_t STALL_EVENT_THRESHOLD_MS = 50;   // = TimeoutDefaults::kRingBufferStallEventThresholdMs
     static const uint32_t STALL_TIMEOUT_MS = 30000;        // = TimeoutDefaults::kRingBufferStallTimeoutMs
+    
+    // How long to wait for other stages to return pool memory for a slot
+    static const int SLOT_ALLOCATION_WAIT_MS = 2000;
+
+    // Outstanding references per slot: one for the consumer plus retains
+    std::unique_ptr<std::atomic<int>[]> _slotRefs;
+    // Set by the first retainSlot(); from then on slots may be fully
+    // released out of ring order and are recycled under _mutex
+    std::atomic<bool> _retaining;
+    std::atomic<size_t> _releaseIndex;    // Next slot to hand back to the producer
+    std::vector<char> _released;          // Fully released, waiting for older slots (under _mutex)
+
+    // Slots holding no memory, see setSlotLimit(). Changed by the producer
+    // while it owns the slot; the consumer reads it for slots it acquired.
+    std::atomic<size_t> _slotLimit;
+    std::atomic<size_t> _parkedCount;
+    std::vector<char> _parked;
+
+    // Decrement count if non-zero
+    static bool _tryTake(std::atomic<size_t>& count);
+
+    // Hand the slot at _writeIndex to the producer
+    Slot* _takeWriteSlot();
+
+    Slot* _acquireWriteSlot(int timeoutMs);
+    Slot* _acquireReadSlot(int timeoutMs);
+
+    // Park or unpark a slot the producer owns to meet the slot limit.
+    // Returns whether it is parked.
+    bool _applySlotLimit(Slot* slot);
 };
 
 #endif // RINGBUFFER_H
@@ -8,13 +8,22 @@
 #include <archive.h>
 #include <archive_entry.h>
 
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 
 namespace rpiboot {
 
 bool Bootfiles::extractFromMemory(const std::vector<uint8_t>& tarData)
 {
-    _files.clear();
+    return extractFromData(std::make_shared<const std::vector<uint8_t>>(tarData));
+}
+
+bool Bootfiles::extractFromData(FileData tarData)
+{
+    _entries.clear();
+    _owner.reset();
+    _archive = {};
 
     if (tarData.empty()) {
         _lastError = "Empty archive data";
@@ -26,56 +35,56 @@ bool Bootfiles::extractFromMemory(const std::vector<uint8_t>& tarData)
     archive_read_support_format_raw(a);
     archive_read_support_filter_none(a);
 
-    int rc = archive_read_open_memory(a, tarData.data(), tarData.size());
+    const auto bytes = tarData.bytes();
+    int rc = archive_read_open_memory(a, bytes.data(), bytes.size());
     if (rc != ARCHIVE_OK) {
         _lastError = std::string("Failed to open tar from memory: ") + archive_error_string(a);
         archive_read_free(a);
         return false;
     }
 
-    bool ok = extractFromArchive(a);
+    _archive = bytes;
+    _owner = std::make_shared<FileData>(std::move(tarData));
+    bool ok = indexArchive(a);
     archive_read_free(a);
     return ok;
 }
 
 bool Bootfiles::extractFromFile(const std::string& path)
 {
-    _files.clear();
-
-    ::archive* a = archive_read_new();
-    archive_read_support_format_tar(a);
-    archive_read_support_format_raw(a);
-    archive_read_support_filter_none(a);
-
-    int rc = archive_read_open_filename(a, path.c_str(), 16384);
-    if (rc != ARCHIVE_OK) {
-        _lastError = std::string("Failed to open tar file: ") + archive_error_string(a);
-        archive_read_free(a);
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f) {
+        _entries.clear();
+        _lastError = "Failed to open tar file: " + path;
         return false;
     }
-
-    bool ok = extractFromArchive(a);
-    archive_read_free(a);
-    return ok;
+    auto data = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(f.tellg()));
+    f.seekg(0);
+    if (!f.read(reinterpret_cast<char*>(data->data()), static_cast<std::streamsize>(data->size()))) {
+        _entries.clear();
+        _lastError = "Failed to read tar file: " + path;
+        return false;
+    }
+    return extractFromData(std::shared_ptr<const std::vector<uint8_t>>(std::move(data)));
 }
 
-const std::vector<uint8_t>* Bootfiles::find(const std::string& name,
-                                              std::string_view chipPrefix) const
+const Bootfiles::Entry* Bootfiles::lookup(const std::string& name,
+                                          std::string_view chipPrefix) const
 {
-    auto it = _files.find(name);
-    if (it != _files.end())
+    auto it = _entries.find(name);
+    if (it != _entries.end())
         return &it->second;
 
     // Try stripping a leading "./" which tar may add
     if (name.size() > 2 && name[0] == '.' && name[1] == '/') {
-        it = _files.find(name.substr(2));
-        if (it != _files.end())
+        it = _entries.find(name.substr(2));
+        if (it != _entries.end())
             return &it->second;
     }
 
     // Try with a leading "./" added
-    it = _files.find("./" + name);
-    if (it != _files.end())
+    it = _entries.find("./" + name);
+    if (it != _entries.end())
         return &it->second;
 
     // Chip-specific subdirectory lookup: the TAR may store files in
@@ -83,43 +92,71 @@ const std::vector<uint8_t>* Bootfiles::find(const std::string& name,
     // filename "mcb.bin".  Try "<chipPrefix>/<name>" directly.
     if (!chipPrefix.empty() && name.find('/') == std::string::npos) {
         std::string prefixed = std::string(chipPrefix) + "/" + name;
-        it = _files.find(prefixed);
-        if (it != _files.end())
+        it = _entries.find(prefixed);
+        if (it != _entries.end())
             return &it->second;
     }
 
     return nullptr;
 }
 
+FileData Bootfiles::contents(const Entry& entry) const
+{
+    if (entry.data)
+        return FileData(entry.data);
+    return FileData(_owner, _archive.subspan(entry.offset, entry.length));
+}
+
+FileData Bootfiles::find(const std::string& name, std::string_view chipPrefix) const
+{
+    const Entry* entry = lookup(name, chipPrefix);
+    return entry ? contents(*entry) : FileData();
+}
+
+std::vector<std::string> Bootfiles::names() const
+{
+    std::vector<std::string> result;
+    result.reserve(_entries.size());
+    for (const auto& [name, entry] : _entries)
+        result.push_back(name);
+    return result;
+}
+
 bool Bootfiles::replaceEntry(const std::string& name, std::vector<uint8_t> data)
 {
-    auto it = _files.find(name);
-    if (it == _files.end()) {
+    auto it = _entries.find(name);
+    if (it == _entries.end()) {
         // Try with leading "./" too, mirroring find()
-        it = _files.find("./" + name);
-        if (it == _files.end()) {
+        it = _entries.find("./" + name);
+        if (it == _entries.end()) {
             _lastError = "replaceEntry: entry not found: " + name;
             return false;
         }
     }
-    it->second = std::move(data);
+    it->second.length = data.size();
+    it->second.data = std::make_shared<const std::vector<uint8_t>>(std::move(data));
     return true;
 }
 
 bool Bootfiles::writeToFile(const std::string& path)
 {
+    // Written next to `path` and renamed over it: the old archive may be
+    // memory-mapped by SharedFileCache, and this object's own entries may
+    // point into it
+    const std::string tmpPath = path + ".tmp";
     ::archive* a = archive_write_new();
     // USTAR is the most portable / minimal tar format; it's what the
     // upstream `tar -vcf` produces by default on most Linux distros and
     // what the BCM2712 bootloader is happy to parse.
     archive_write_set_format_ustar(a);
-    if (archive_write_open_filename(a, path.c_str()) != ARCHIVE_OK) {
+    if (archive_write_open_filename(a, tmpPath.c_str()) != ARCHIVE_OK) {
         _lastError = std::string("writeToFile: ") + archive_error_string(a);
         archive_write_free(a);
         return false;
     }
 
-    for (const auto& [name, data] : _files) {
+    for (const auto& [name, entry] : _entries) {
+        const auto data = contents(entry).bytes();
         ::archive_entry* e = archive_entry_new();
         archive_entry_set_pathname(e, name.c_str());
         archive_entry_set_size(e, static_cast<la_int64_t>(data.size()));
@@ -158,12 +195,21 @@ bool Bootfiles::writeToFile(const std::string& path)
         return false;
     }
     archive_write_free(a);
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        _lastError = "writeToFile rename: " + ec.message();
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
     return true;
 }
 
-bool Bootfiles::extractFromArchive(::archive* a)
+bool Bootfiles::indexArchive(::archive* a)
 {
     ::archive_entry* entry;
+    const uint8_t* base = _archive.data();
 
     while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
         // Skip directories
@@ -171,44 +217,58 @@ bool Bootfiles::extractFromArchive(::archive* a)
             continue;
 
         std::string name = archive_entry_pathname(entry);
-        int64_t entrySize = archive_entry_size(entry);
-
-        if (entrySize < 0) {
+        if (archive_entry_size(entry) < 0) {
             // Skip entries with unknown size
             archive_read_data_skip(a);
             continue;
         }
 
-        std::vector<uint8_t> data(static_cast<size_t>(entrySize));
-
-        if (entrySize > 0) {
-            // Read in chunks to handle large files without requiring
-            // the entire file in a single read call
-            size_t offset = 0;
-            size_t remaining = static_cast<size_t>(entrySize);
-
-            while (remaining > 0) {
-                la_ssize_t bytesRead = archive_read_data(a, data.data() + offset, remaining);
-                if (bytesRead < 0) {
-                    _lastError = std::string("Error reading archive entry '") + name + "': " + archive_error_string(a);
-                    return false;
+        // For a plain tar read from memory, libarchive hands out the entry
+        // as one or more blocks pointing straight into the archive; record
+        // where they start.  Anything else (a sparse entry, or data that
+        // libarchive had to copy) is materialised block by block.
+        Entry indexed;
+        std::vector<uint8_t> copy;
+        bool contiguous = true;
+        const void* block;
+        size_t blockSize;
+        la_int64_t blockOffset;
+        int rc;
+        while ((rc = archive_read_data_block(a, &block, &blockSize, &blockOffset)) == ARCHIVE_OK) {
+            const auto* p = static_cast<const uint8_t*>(block);
+            const auto offset = static_cast<size_t>(blockOffset);
+            if (contiguous) {
+                const bool inArchive = p >= base && p < base + _archive.size()
+                                    && blockSize <= static_cast<size_t>(base + _archive.size() - p);
+                const size_t at = inArchive ? static_cast<size_t>(p - base) : 0;
+                if (inArchive && offset == indexed.length
+                    && (indexed.length == 0 || at == indexed.offset + indexed.length)) {
+                    if (indexed.length == 0)
+                        indexed.offset = at;
+                    indexed.length += blockSize;
+                    continue;
                 }
-                if (bytesRead == 0)
-                    break;
-
-                offset += static_cast<size_t>(bytesRead);
-                remaining -= static_cast<size_t>(bytesRead);
+                contiguous = false;
+                copy.assign(base + indexed.offset, base + indexed.offset + indexed.length);
             }
-
-            // Trim if we got fewer bytes than expected
-            data.resize(offset);
+            if (copy.size() < offset + blockSize)
+                copy.resize(offset + blockSize);
+            std::memcpy(copy.data() + offset, p, blockSize);
+        }
+        if (rc != ARCHIVE_EOF) {
+            _lastError = std::string("Error reading archive entry '") + name + "': " + archive_error_string(a);
+            return false;
+        }
+        if (!contiguous) {
+            indexed.length = copy.size();
+            indexed.data = std::make_shared<const std::vector<uint8_t>>(std::move(copy));
         }
 
         // Strip leading "./" from the entry name for cleaner lookups
         if (name.size() > 2 && name[0] == '.' && name[1] == '/')
             name = name.substr(2);
 
-        _files[std::move(name)] = std::move(data);
+        _entries[std::move(name)] = std::move(indexed);
     }
 
     return true;
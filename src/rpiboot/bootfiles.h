@@ -2,20 +2,28 @@
  * SPDX-License-Identifier: Apache-2.0
  * Copyright (C) 2025 Raspberry Pi Ltd
  *
- * In-memory tar extraction for bootfiles.bin.
+ * In-memory tar index for bootfiles.bin.
  *
  * The sideload firmware packages its boot files as a tar
  * archive (bootfiles.bin).  This class uses libarchive (already bundled)
- * to extract files on demand into an in-memory map, which is then used
- * by the file server when the device requests individual files.
+ * to index the archive once — offset and length of each entry — and hands
+ * out entries as views into the archive bytes, which the file server sends
+ * when the device requests individual files.  The device only asks for a
+ * handful of entries, so nothing is copied out of the archive except
+ * entries replaced with replaceEntry().
  */
 
 #ifndef RPIBOOT_BOOTFILES_H
 #define RPIBOOT_BOOTFILES_H
 
+#include "file_server.h"
+
 #include <cstdint>
 #include <map>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // Forward-declare libarchive's archive type at global scope
@@ -26,45 +34,60 @@ namespace rpiboot {
 
 class Bootfiles {
 public:
-    // Extract all entries from a tar archive stored in memory.
+    // Index a tar archive stored in memory.  The data is copied once; use
+    // extractFromData() to share a buffer or mapping instead.
     // Returns true on success.
     bool extractFromMemory(const std::vector<uint8_t>& tarData);
 
-    // Extract from a tar file on disk.
+    // Index a tar archive held by `tarData`, which is kept alive for as
+    // long as this object or any entry returned by find().
+    bool extractFromData(FileData tarData);
+
+    // Index a tar file on disk (read into memory once).
     bool extractFromFile(const std::string& path);
 
     // Look up a file by name (path within the archive).
-    // Returns a pointer to the data, or nullptr if not found.
+    // Returns the entry's contents, sharing ownership of the archive, or
+    // an empty FileData if not found.
     // If chipPrefix is non-empty and the exact name isn't found,
     // tries "<chipPrefix>/<name>" to resolve chip-specific subdirectories
     // (e.g. chipPrefix="2712" resolves "mcb.bin" → "2712/mcb.bin").
-    const std::vector<uint8_t>* find(const std::string& name,
-                                      std::string_view chipPrefix = {}) const;
+    FileData find(const std::string& name, std::string_view chipPrefix = {}) const;
 
-    // Replace (or insert) the contents of a single entry in the in-memory
-    // archive.  Used to splice a customer-counter-signed bootcode into the
-    // bootfiles.bin we serve to the device.  Returns false if the entry
-    // doesn't exist (use append-style writeToFile for new entries instead).
+    // Replace the contents of a single entry.  Used to splice a
+    // customer-counter-signed bootcode into the bootfiles.bin we serve
+    // to the device; only replaced entries are held outside the archive.
+    // Returns false if the entry doesn't exist.
     bool replaceEntry(const std::string& name, std::vector<uint8_t> data);
 
-    // Re-pack the current in-memory entries as a USTAR archive at `path`.
+    // Re-pack the current entries as a USTAR archive at `path`.
     // Entries are written in alphabetical order (the upstream bootloader
     // doesn't depend on tar ordering).  Returns false on I/O / libarchive
     // error; details in lastError().
     bool writeToFile(const std::string& path);
 
-    // Number of entries extracted
-    size_t size() const { return _files.size(); }
+    // Number of entries indexed
+    size_t size() const { return _entries.size(); }
 
-    // Access the entire file map (for iteration / debugging)
-    const std::map<std::string, std::vector<uint8_t>>& files() const { return _files; }
+    // Entry names in alphabetical order (for iteration / debugging)
+    std::vector<std::string> names() const;
 
     const std::string& lastError() const { return _lastError; }
 
 private:
-    bool extractFromArchive(::archive* a);
-
-    std::map<std::string, std::vector<uint8_t>> _files;
+    struct Entry {
+        size_t offset = 0;  // Into _archive, unless `data` is set
+        size_t length = 0;
+        std::shared_ptr<const std::vector<uint8_t>> data;  // Replaced or non-contiguous
+    };
+
+    bool indexArchive(::archive* a);
+    const Entry* lookup(const std::string& name, std::string_view chipPrefix) const;
+    FileData contents(const Entry& entry) const;
+
+    std::map<std::string, Entry> _entries;
+    std::shared_ptr<const void> _owner;
+    std::span<const uint8_t> _archive;
     std::string _lastError;
 };
 
@@ -46,8 +46,14 @@ bool BootloaderImage::load(const QString &filename)
         _lastError = "Cannot open EEPROM image: " + filename;
         return false;
     }
-    _bytes = f.readAll();
+    const QByteArray bytes = f.readAll();
     f.close();
+    return loadFromBytes(bytes);
+}
+
+bool BootloaderImage::loadFromBytes(const QByteArray &bytes)
+{
+    _bytes = bytes;
 
     // The upstream tool accepts 512 KiB or 2 MiB images; accept the same
     // sizes and reject anything else as corruption.
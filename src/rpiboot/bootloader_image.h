@@ -42,6 +42,10 @@ public:
     // Load an EEPROM image from disk.  Returns false on parse / size error.
     bool load(const QString &filename);
 
+    // Parse an EEPROM image already in memory.  Copies are cheap: the
+    // bytes are shared until the image is modified.
+    bool loadFromBytes(const QByteArray &bytes);
+
     // Write the (possibly modified) image to a file.  Returns false on I/O error.
     bool save(const QString &filename) const;
 
@@ -4,6 +4,7 @@
  */
 
 #include "file_server.h"
+#include "shared_file_cache.h"
 
 #include <QDebug>
 
@@ -27,10 +28,30 @@ bool FileServer::run(IUsbTransport& transport,
                       const std::atomic<bool>& cancelled,
                       FileResolver resolver)
 {
-    // Use the disk-based resolver as default
-    FileResolver resolverFn = resolver ? std::move(resolver)
-        : [&firmwareDir](const std::string& name) {
-              return readFileFromDisk(firmwareDir, name);
+    SharedFileResolver shared;
+    if (resolver) {
+        shared = [resolver = std::move(resolver)](const std::string& name) -> FileData {
+            auto data = resolver(name);
+            if (data.empty())
+                return nullptr;
+            return std::make_shared<const std::vector<uint8_t>>(std::move(data));
+        };
+    }
+    return run(transport, firmwareDir, std::move(progress), cancelled, std::move(shared));
+}
+
+bool FileServer::run(IUsbTransport& transport,
+                      const std::filesystem::path& firmwareDir,
+                      ProgressCallback progress,
+                      const std::atomic<bool>& cancelled,
+                      SharedFileResolver resolver)
+{
+    // Default: the firmware directory on disk, shared with other sessions
+    SharedFileResolver resolverFn = resolver ? std::move(resolver)
+        : [&firmwareDir](const std::string& name) -> FileData {
+              if (name.empty() || name[0] == '*')
+                  return nullptr;
+              return SharedFileCache::instance().file(firmwareDir / name);
           };
 
     uint64_t filesServed = 0;
@@ -199,13 +220,13 @@ bool FileServer::run(IUsbTransport& transport,
 
 bool FileServer::handleGetFileSize(IUsbTransport& transport,
                                     const std::string& filename,
-                                    const FileResolver& resolver,
+                                    const SharedFileResolver& resolver,
                                     const std::filesystem::path& firmwareDir)
 {
     // Star-prefixed filenames are metadata -- the device is reporting info, not requesting a real file
     bool isMetadata = !filename.empty() && filename[0] == '*';
 
-    std::vector<uint8_t> data;
+    FileData data;
     if (!isMetadata) {
         data = resolver(filename);
     }
@@ -214,7 +235,7 @@ bool FileServer::handleGetFileSize(IUsbTransport& transport,
     // Size is encoded in wValue (low 16) and wIndex (high 16), matching
     // the upstream pattern where ep_write(NULL, 0) or a direct
     // libusb_control_transfer sends no data payload.
-    int32_t size = isMetadata ? 0 : static_cast<int32_t>(data.size());
+    int32_t size = static_cast<int32_t>(data.size());
     uint16_t wValue = static_cast<uint16_t>(size & 0xFFFF);
     uint16_t wIndex = static_cast<uint16_t>((size >> 16) & 0xFFFF);
 
@@ -230,7 +251,7 @@ bool FileServer::handleGetFileSize(IUsbTransport& transport,
 
 bool FileServer::handleReadFile(IUsbTransport& transport,
                                  const std::string& filename,
-                                 const FileResolver& resolver,
+                                 const SharedFileResolver& resolver,
                                  const std::filesystem::path& firmwareDir,
                                  const std::atomic<bool>& cancelled)
 {
@@ -246,9 +267,9 @@ bool FileServer::handleReadFile(IUsbTransport& transport,
         return true;
     }
 
-    std::vector<uint8_t> data = resolver(filename);
+    FileData file = resolver(filename);
 
-    if (data.empty()) {
+    if (file.empty()) {
         // File not found: zero-length ep_write response
         transport.controlTransfer(VENDOR_REQUEST_TYPE, VENDOR_REQUEST,
                                   0, 0, {}, DEFAULT_TIMEOUT_MS);
@@ -258,6 +279,7 @@ bool FileServer::handleReadFile(IUsbTransport& transport,
     // Send file data via ep_write protocol:
     // 1. Control transfer announces the total size (no data payload)
     // 2. Bulk OUT sends the entire file in a single transfer
+    const std::span<const uint8_t> data = file.bytes();
     int32_t totalSize = static_cast<int32_t>(data.size());
     uint16_t wValue = static_cast<uint16_t>(totalSize & 0xFFFF);
     uint16_t wIndex = static_cast<uint16_t>((totalSize >> 16) & 0xFFFF);
@@ -272,34 +294,32 @@ bool FileServer::handleReadFile(IUsbTransport& transport,
     if (cancelled.load())
         return false;
 
-    // Chunk the bulk transfer into BULK_CHUNK_SIZE (16 KB) pieces with a
-    // generous per-chunk timeout, matching upstream usbboot's ep_write().
-    // A single 56 MB libusb_bulk_transfer call is rejected by the macOS
-    // USB stack (LIBUSB_ERROR_IO -1) for oversized requests; the upstream
-    // tool avoids that by issuing many small calls in sequence.
+    // Chunk the bulk transfer with a generous per-chunk timeout, matching
+    // upstream usbboot's ep_write().  A single 56 MB libusb_bulk_transfer
+    // call is rejected by the macOS USB stack (LIBUSB_ERROR_IO -1) for
+    // oversized requests; the upstream tool avoids that by issuing many
+    // small calls.  On USB 2 these are BULK_CHUNK_SIZE (16 KB) pieces; a
+    // SuperSpeed link gets multi-MB pieces (bulkChunkSizeFor()).  The
+    // transport keeps several of them in flight so the link does not idle
+    // between chunks.
     constexpr int CHUNK_TIMEOUT_MS = 5000;
     const uint8_t outEp = transport.outEndpoint();
-    size_t offset = 0;
-    while (offset < data.size()) {
-        if (cancelled.load())
-            return false;
-
-        size_t chunkSize = std::min(BULK_CHUNK_SIZE, data.size() - offset);
-        auto chunk = std::span<const uint8_t>(data.data() + offset, chunkSize);
-
-        int transferred = transport.bulkWrite(outEp, chunk, CHUNK_TIMEOUT_MS);
-        if (transferred < 0 || static_cast<size_t>(transferred) != chunkSize) {
-            _lastError = "Bulk write failed sending file: " + filename
-                + " (transferred " + std::to_string(offset + std::max(transferred, 0))
-                + " of " + std::to_string(data.size()) + " bytes";
-            if (transferred < 0)
-                _lastError += ", libusb error " + std::to_string(transferred);
-            _lastError += ")";
-            qDebug() << "rpiboot:" << _lastError.c_str()
-                     << "ep=0x" << Qt::hex << (int)outEp;
-            return false;
-        }
-        offset += static_cast<size_t>(transferred);
+    size_t sent = 0;
+    int64_t transferred = transport.bulkWriteStream(
+        outEp, data, bulkChunkSizeFor(transport.speed()), CHUNK_TIMEOUT_MS, cancelled,
+        [&sent](size_t done) { sent = done; });
+    if (cancelled.load())
+        return false;
+    if (transferred < 0 || static_cast<size_t>(transferred) != data.size()) {
+        _lastError = "Bulk write failed sending file: " + filename
+            + " (transferred " + std::to_string(sent)
+            + " of " + std::to_string(data.size()) + " bytes";
+        if (transferred < 0)
+            _lastError += ", libusb error " + std::to_string(transferred);
+        _lastError += ")";
+        qDebug() << "rpiboot:" << _lastError.c_str()
+                 << "ep=0x" << Qt::hex << (int)outEp;
+        return false;
     }
 
     return true;
@@ -19,6 +19,8 @@
 #include <filesystem>
 #include <functional>
 #include <map>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -28,13 +30,39 @@ namespace rpiboot {
 // Returns the file data, or an empty vector if not found.
 using FileResolver = std::function<std::vector<uint8_t>(const std::string& filename)>;
 
+// Immutable file contents that can be shared between concurrent sessions.
+// The owner keeps the bytes alive: a heap buffer, an entry of a shared
+// bootfiles.bin archive or a memory mapping of the file on disk.
+class FileData {
+public:
+    FileData() = default;
+    FileData(std::nullptr_t) {}
+    FileData(std::shared_ptr<const std::vector<uint8_t>> buffer)
+        : _bytes(buffer ? std::span<const uint8_t>(*buffer) : std::span<const uint8_t>()),
+          _owner(std::move(buffer)) {}
+    FileData(std::shared_ptr<const void> owner, std::span<const uint8_t> bytes)
+        : _bytes(bytes), _owner(std::move(owner)) {}
+
+    explicit operator bool() const { return _owner != nullptr; }
+    std::span<const uint8_t> bytes() const { return _bytes; }
+    size_t size() const { return _bytes.size(); }
+    bool empty() const { return _bytes.empty(); }
+
+private:
+    std::span<const uint8_t> _bytes;
+    std::shared_ptr<const void> _owner;
+};
+
+// Resolver returning shared contents, or nullptr if not found
+using SharedFileResolver = std::function<FileData(const std::string& filename)>;
+
 class FileServer {
 public:
     // Run the file-server loop until the device sends Done (or an error
     // occurs, or the operation is cancelled).
     //
     // resolver is called to look up each requested file.  The default
-    // implementation reads from firmwareDir on disk.
+    // implementation reads from firmwareDir through SharedFileCache.
     //
     // Returns true on clean Done, false on error/cancel.
     bool run(IUsbTransport& transport,
@@ -43,6 +71,13 @@ public:
              const std::atomic<bool>& cancelled,
              FileResolver resolver = nullptr);
 
+    // As above, with a resolver that returns shared buffers
+    bool run(IUsbTransport& transport,
+             const std::filesystem::path& firmwareDir,
+             ProgressCallback progress,
+             const std::atomic<bool>& cancelled,
+             SharedFileResolver resolver);
+
     // Metadata collected during the file-server phase
     const DeviceMetadata& metadata() const { return _metadata; }
 
@@ -51,12 +86,12 @@ public:
 private:
     bool handleGetFileSize(IUsbTransport& transport,
                            const std::string& filename,
-                           const FileResolver& resolver,
+                           const SharedFileResolver& resolver,
                            const std::filesystem::path& firmwareDir);
 
     bool handleReadFile(IUsbTransport& transport,
                         const std::string& filename,
-                        const FileResolver& resolver,
+                        const SharedFileResolver& resolver,
                         const std::filesystem::path& firmwareDir,
                         const std::atomic<bool>& cancelled);
 
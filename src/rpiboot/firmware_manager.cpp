@@ -7,21 +7,89 @@
 #include "bootcode_loader.h"
 #include "bootfiles.h"
 #include "secure_boot_provisioner.h"
+#include "shared_file_cache.h"
 
 #include "../curlnetworkconfig.h"
 #include "../secureboot.h"
 
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
 #include <QStandardPaths>
 #include <QString>
 
 #include <curl/curl.h>
 
+#include <cctype>
+#include <chrono>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <string_view>
 
 namespace rpiboot {
 
+// Sessions booting several devices at once share one cache directory.
+// Only one of them may download, extract or sign into it at a time; the
+// rest wait and then take the cache hit.
+static std::timed_mutex s_cacheMutex;
+
+// Configurations whose firmware this process has already prepared
+// (downloaded, extracted and signed), keyed by preparationKey().  Guarded
+// by s_cacheMutex.  A later device with the same configuration is served
+// straight from here: no revalidation, re-extraction or signing.
+struct PreparedFirmware {
+    std::filesystem::path dir;
+    std::map<std::string, FileData> memoryFiles;
+    int64_t preparedAt = 0;  // seconds since epoch
+};
+static std::map<std::string, PreparedFirmware> s_prepared;
+
+// Identifies everything a preparation depends on.  Local inputs are
+// fingerprinted by size and mtime so that editing the gadget or replacing
+// the key is noticed.
+static std::string preparationKey(SideloadMode mode, ChipGeneration chip,
+                                  const std::string& customGadget,
+                                  const std::string& signKey)
+{
+    std::string key = std::to_string(static_cast<int>(mode)) + "|"
+                    + std::to_string(static_cast<int>(chip));
+    for (const auto& path : {customGadget, signKey}) {
+        key += "|";
+        if (path.empty())
+            continue;
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(path, ec);
+        const auto mtime = std::filesystem::last_write_time(path, ec);
+        key += path + ":" + std::to_string(size) + ":"
+             + std::to_string(mtime.time_since_epoch().count());
+    }
+    return key;
+}
+
+// Replace `dest` with a copy of `src` by renaming a complete copy over it.
+// SharedFileCache may still have the old file mapped for a session that is
+// serving it; rewriting it in place would change the bytes under that
+// mapping (or truncate it).
+static void replaceWithCopy(const std::filesystem::path& src,
+                            const std::filesystem::path& dest,
+                            std::error_code& ec)
+{
+    auto tmpPath = dest;
+    tmpPath += ".tmp";
+    std::filesystem::copy_file(src, tmpPath,
+                                std::filesystem::copy_options::overwrite_existing, ec);
+    if (!ec)
+        std::filesystem::rename(tmpPath, dest, ec);
+    if (ec) {
+        std::error_code ignored;
+        std::filesystem::remove(tmpPath, ignored);
+    }
+}
+
 FirmwareManager::FirmwareManager() = default;
 
 std::filesystem::path FirmwareManager::cacheRoot() const
@@ -105,9 +173,35 @@ std::filesystem::path FirmwareManager::ensureAvailable(SideloadMode mode,
                                                         ProgressCallback progress,
                                                         std::atomic<bool>& cancelled)
 {
+    std::unique_lock<std::timed_mutex> cacheLock(s_cacheMutex, std::defer_lock);
+    while (!cacheLock.try_lock_for(std::chrono::milliseconds(100))) {
+        if (cancelled.load()) {
+            _lastError = "Cancelled";
+            return {};
+        }
+    }
+    _memoryFiles.clear();
+
     auto root = cacheRoot();
     auto versionDir = root / "master";
 
+    const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // 0. Already prepared for this configuration (by an earlier device or
+    // by a prefetch that ran while the device was being discovered)
+    const std::string prepKey = preparationKey(mode, chip, _customFastbootGadget,
+                                               _signFastbootGadgetKey);
+    if (auto it = s_prepared.find(prepKey); it != s_prepared.end()) {
+        if (now - it->second.preparedAt < std::chrono::seconds(REVALIDATE_INTERVAL).count() &&
+            validateCacheForDevice(it->second.dir, mode, chip)) {
+            qDebug() << "FirmwareManager: reusing prepared firmware";
+            _memoryFiles = it->second.memoryFiles;
+            return it->second.dir;
+        }
+        s_prepared.erase(it);
+    }
+
     // 1. Build the file manifest
     auto manifest = buildManifest(mode, chip);
     if (manifest.empty()) {
@@ -126,17 +220,25 @@ std::filesystem::path FirmwareManager::ensureAvailable(SideloadMode mode,
          (chip == ChipGeneration::BCM2711 || chip == ChipGeneration::BCM2712));
 
     // 2. Cache hit — all manifest files already exist (and no stale .tmp files)
-    bool allExist = true;
+    bool allDownloaded = true;
     for (const auto& entry : manifest) {
         auto filePath = versionDir / entry.localPath;
         if (!std::filesystem::exists(filePath)) {
-            allExist = false;
+            allDownloaded = false;
             // Clean up any leftover .tmp file from an interrupted download
             std::error_code ec;
             std::filesystem::remove(std::filesystem::path(filePath).concat(".tmp"), ec);
             break;
         }
     }
+    bool allExist = allDownloaded;
+
+    // Revalidate the cached files with the server at most once per
+    // REVALIDATE_INTERVAL; in between, a cache hit needs no network
+    CacheIndex index = loadCacheIndex(versionDir);
+    const bool revalidationDue = allDownloaded &&
+        now - index.lastRevalidated >= std::chrono::seconds(REVALIDATE_INTERVAL).count();
+
     // When fastboot-gadget signing is requested, also require boot.sig to be
     // present in the cache (otherwise we need to re-run the post-download
     // signing step below).
@@ -148,20 +250,27 @@ std::filesystem::path FirmwareManager::ensureAvailable(SideloadMode mode,
     }
     // When re-provisioning signing is enabled (any mode), force a cache miss
     // so that the post-download signing steps run.  We don't track which key
-    // the cached output was signed with, and re-signing is cheap (~100 ms of
-    // RSA + file copies) — much simpler and more correct than introducing
-    // sentinel marker files keyed by the user's PEM path.
+    // the cached output was signed with; SecureBootProvisioner keeps the
+    // signed image in memory keyed by the key and original image, so only
+    // the first device of a batch pays for the RSA work — much simpler and
+    // more correct than introducing sentinel marker files keyed by the
+    // user's PEM path.
     const bool needsRecoverySigning =
         (mode == SideloadMode::SecureBootRecovery && !_signFastbootGadgetKey.empty());
     if (needsRecoverySigning) {
         allExist = false;
     }
-    if (allExist && !needsBootcodeExtraction) {
+    if (allExist && !needsBootcodeExtraction && !revalidationDue) {
         qDebug() << "FirmwareManager: cache hit for master";
         return versionDir;
     }
 
-    // 3. Download each missing file
+    // Everything below may rewrite files that other configurations share
+    // (bootfiles.bin, bootcode5.bin, boot.img), so only the configuration
+    // prepared last is known to be intact on disk
+    s_prepared.clear();
+
+    // 3. Download missing files and revalidate cached ones
     if (progress)
         progress(0, 100, "Downloading rpiboot firmware...");
 
@@ -172,32 +281,50 @@ std::filesystem::path FirmwareManager::ensureAvailable(SideloadMode mode,
         return {};
     }
 
-    size_t totalFiles = manifest.size();
-    for (size_t i = 0; i < totalFiles; ++i) {
-        if (cancelled.load()) {
+    // Missing files are required; a revalidation that fails (offline
+    // factory line, GitHub outage) keeps using the cached copy.  All
+    // fetches run concurrently.
+    std::vector<FetchJob> jobs;
+    for (const auto& entry : manifest) {
+        auto destPath = versionDir / entry.localPath;
+        const bool cached = std::filesystem::exists(destPath);
+        if (cached && !revalidationDue)
+            continue;
+        FetchJob job;
+        job.entry = &entry;
+        job.destPath = destPath;
+        job.conditional = cached;
+        jobs.push_back(std::move(job));
+    }
+
+    if (!jobs.empty()) {
+        if (!fetchFiles(jobs, index, progress, cancelled)) {
             _lastError = "Cancelled";
             return {};
         }
 
-        const auto& entry = manifest[i];
-        auto destPath = versionDir / entry.localPath;
-
-        // Skip files already downloaded
-        if (std::filesystem::exists(destPath))
-            continue;
-
-        // Wrap progress callback to map per-file progress to overall progress
-        auto fileProgress = [&progress, i, totalFiles](uint64_t current, uint64_t total,
-                                                        const std::string&) {
-            if (progress && total > 0) {
-                uint64_t overallPct = (i * 100 + current * 100 / total) / totalFiles;
-                progress(overallPct, 100, "Downloading rpiboot firmware...");
+        for (const auto& job : jobs) {
+            if (!job.ok && !job.conditional) {
+                _lastError = job.error;
+                return {};
+            }
+            if (!job.ok) {
+                qWarning() << "FirmwareManager: could not revalidate" << job.entry->localPath.c_str()
+                           << "(" << job.error.c_str() << "), using cached copy";
+            }
+            // bootfiles.bin.original is the pristine copy of the previous
+            // upstream tar; drop it so step 3c re-baselines on the new one
+            if (job.changed && job.entry->localPath == "fastboot/bootfiles.bin") {
+                std::error_code removeEc;
+                std::filesystem::remove(versionDir / "fastboot" / "bootfiles.bin.original", removeEc);
             }
-        };
-
-        if (!downloadFile(entry.url, destPath, fileProgress, cancelled)) {
-            return {};  // _lastError already set by downloadFile
         }
+
+        // Also after a failed revalidation, so an offline machine does not
+        // wait on the network again until the next interval
+        index.lastRevalidated = now;
+        if (!saveCacheIndex(versionDir, index))
+            qWarning() << "FirmwareManager: could not write cache index";
     }
 
     // 3b. If a custom fastboot gadget was provided, copy it into the cache
@@ -208,8 +335,7 @@ std::filesystem::path FirmwareManager::ensureAvailable(SideloadMode mode,
         qDebug() << "FirmwareManager: using custom fastboot gadget:"
                  << QString::fromStdString(_customFastbootGadget);
         std::error_code copyEc;
-        std::filesystem::copy_file(_customFastbootGadget, gadgetDest,
-                                    std::filesystem::copy_options::overwrite_existing, copyEc);
+        replaceWithCopy(_customFastbootGadget, gadgetDest, copyEc);
         if (copyEc) {
             _lastError = "Failed to copy custom fastboot gadget: " + copyEc.message();
             return {};
@@ -405,11 +531,14 @@ std::filesystem::path FirmwareManager::ensureAvailable(SideloadMode mode,
         const bool counterSign = (chip == ChipGeneration::BCM2712);
         qDebug() << "FirmwareManager: preparing signed recovery firmware in"
                  << QString::fromStdString(recoveryDir.string());
+        SecureBootProvisioner::SignedRecovery recovery;
         if (!SecureBootProvisioner::prepareSignedRecovery(
-                chip, recoveryDir, _signFastbootGadgetKey, counterSign, err)) {
+                chip, recoveryDir, _signFastbootGadgetKey, counterSign, err, &recovery)) {
             _lastError = "Failed to prepare signed recovery firmware: " + err;
             return {};
         }
+        _memoryFiles["pieeprom.bin"] = FileData(recovery.pieeprom);
+        _memoryFiles["pieeprom.sig"] = FileData(recovery.pieepromSig);
     }
 
     // 4. Validate cache
@@ -419,116 +548,314 @@ std::filesystem::path FirmwareManager::ensureAvailable(SideloadMode mode,
         return {};
     }
 
+    s_prepared[prepKey] = {versionDir, _memoryFiles, now};
+
     if (progress)
         progress(100, 100, "Firmware ready");
 
     return versionDir;
 }
 
-// ── Curl helpers for file download ──────────────────────────────────────
+// ── Cache index ─────────────────────────────────────────────────────────
 
-static size_t curlWriteToFile(char *ptr, size_t size, size_t nmemb, void *userdata)
+static std::filesystem::path cacheIndexPath(const std::filesystem::path& versionDir)
 {
-    auto *out = static_cast<std::ofstream*>(userdata);
-    size_t totalSize = size * nmemb;
-    out->write(ptr, static_cast<std::streamsize>(totalSize));
-    return out->good() ? totalSize : 0;
+    return versionDir / "index.json";
 }
 
-struct FirmwareProgressData {
-    ProgressCallback* progress;
-    std::atomic<bool>* cancelled;
-};
+FirmwareManager::CacheIndex FirmwareManager::loadCacheIndex(const std::filesystem::path& versionDir)
+{
+    CacheIndex index;
+    QFile f(QString::fromStdString(cacheIndexPath(versionDir).string()));
+    if (!f.open(QIODevice::ReadOnly))
+        return index;
+
+    const QJsonObject root = QJsonDocument::fromJson(f.readAll()).object();
+    index.lastRevalidated = static_cast<int64_t>(root.value("lastRevalidated").toDouble());
+    const QJsonObject files = root.value("files").toObject();
+    for (auto it = files.begin(); it != files.end(); ++it) {
+        const QJsonObject o = it.value().toObject();
+        CacheRecord record;
+        record.etag = o.value("etag").toString().toStdString();
+        record.lastModified = o.value("lastModified").toString().toStdString();
+        record.sha256 = o.value("sha256").toString().toStdString();
+        record.size = static_cast<uint64_t>(o.value("size").toDouble());
+        index.files[it.key().toStdString()] = record;
+    }
+    return index;
+}
 
-static int curlProgressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow,
-                                 curl_off_t /*ultotal*/, curl_off_t /*ulnow*/)
+bool FirmwareManager::saveCacheIndex(const std::filesystem::path& versionDir,
+                                     const CacheIndex& index)
 {
-    auto *data = static_cast<FirmwareProgressData*>(clientp);
-    if (data->cancelled->load())
-        return 1;  // Abort
-    if (data->progress && *data->progress && dltotal > 0) {
-        (*data->progress)(static_cast<uint64_t>(dlnow), static_cast<uint64_t>(dltotal),
-                          "Downloading rpiboot firmware...");
-    }
-    return 0;
+    QJsonObject files;
+    for (const auto& [localPath, record] : index.files) {
+        QJsonObject o;
+        o.insert("etag", QString::fromStdString(record.etag));
+        o.insert("lastModified", QString::fromStdString(record.lastModified));
+        o.insert("sha256", QString::fromStdString(record.sha256));
+        o.insert("size", static_cast<double>(record.size));
+        files.insert(QString::fromStdString(localPath), o);
+    }
+    QJsonObject root;
+    root.insert("lastRevalidated", static_cast<double>(index.lastRevalidated));
+    root.insert("files", files);
+
+    QSaveFile f(QString::fromStdString(cacheIndexPath(versionDir).string()));
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    f.write(QJsonDocument(root).toJson());
+    return f.commit();
 }
 
-// ── downloadFile ────────────────────────────────────────────────────────
+// ── Curl helpers for file download ──────────────────────────────────────
+
+namespace {
+
+// Connect timeout when revalidating: the session already has usable
+// files, so don't keep it waiting on an unreachable server
+constexpr long REVALIDATE_CONNECT_TIMEOUT_S = 5;
+
+constexpr long MAX_PARALLEL_FETCHES = 6;
+
+struct FirmwareTransfer {
+    size_t job = 0;
+    CURL* curl = nullptr;
+    curl_slist* headers = nullptr;
+    std::filesystem::path tmpPath;
+    std::ofstream out;
+    QCryptographicHash hash{QCryptographicHash::Sha256};
+    uint64_t bytes = 0;
+    std::string etag;
+    std::string lastModified;
+    std::atomic<bool>* cancelled = nullptr;
+    std::atomic<curl_off_t> now{0};
+    std::atomic<curl_off_t> total{0};
+    bool done = false;
+    CURLcode result = CURLE_OK;
+    long responseCode = 0;
+    char errorBuffer[CURL_ERROR_SIZE] = {0};
+};
+
+size_t transferWrite(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+    auto* t = static_cast<FirmwareTransfer*>(userdata);
+    const size_t totalSize = size * nmemb;
+    t->out.write(ptr, static_cast<std::streamsize>(totalSize));
+    t->hash.addData(QByteArrayView(ptr, static_cast<qsizetype>(totalSize)));
+    t->bytes += totalSize;
+    return t->out.good() ? totalSize : 0;
+}
 
-bool FirmwareManager::downloadFile(const std::string& url,
-                                    const std::filesystem::path& destPath,
-                                    ProgressCallback progress,
-                                    std::atomic<bool>& cancelled)
+// Value of header `name` (lower case) in `line`, without surrounding
+// whitespace, or nullopt if the line is another header
+std::optional<std::string> headerValue(std::string_view line, std::string_view name)
 {
-    qDebug() << "FirmwareManager: downloading" << url.c_str();
+    if (line.size() <= name.size() || line[name.size()] != ':')
+        return std::nullopt;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(line[i])) != name[i])
+            return std::nullopt;
+    }
+    std::string_view value = line.substr(name.size() + 1);
+    const auto first = value.find_first_not_of(" \t");
+    const auto last = value.find_last_not_of(" \t\r\n");
+    if (first == std::string_view::npos)
+        return std::string();
+    return std::string(value.substr(first, last - first + 1));
+}
 
-    // Ensure parent directory exists
-    std::error_code ec;
-    std::filesystem::create_directories(destPath.parent_path(), ec);
-    if (ec) {
-        _lastError = "Cannot create directory: " + ec.message();
-        return false;
+size_t transferHeader(char* buffer, size_t size, size_t nitems, void* userdata)
+{
+    auto* t = static_cast<FirmwareTransfer*>(userdata);
+    const std::string_view line(buffer, size * nitems);
+    // Redirect responses come first; keep only the final response's headers
+    if (line.starts_with("HTTP/")) {
+        t->etag.clear();
+        t->lastModified.clear();
+    } else if (auto etag = headerValue(line, "etag")) {
+        t->etag = *etag;
+    } else if (auto lastModified = headerValue(line, "last-modified")) {
+        t->lastModified = *lastModified;
     }
+    return size * nitems;
+}
 
-    // Write to a temporary file and rename on success to prevent partial
-    // downloads from poisoning the cache (crash, network drop, SIGKILL).
-    auto tmpPath = std::filesystem::path(destPath).concat(".tmp");
+int transferProgress(void* clientp, curl_off_t dltotal, curl_off_t dlnow,
+                     curl_off_t /*ultotal*/, curl_off_t /*ulnow*/)
+{
+    auto* t = static_cast<FirmwareTransfer*>(clientp);
+    t->now = dlnow;
+    t->total = dltotal;
+    return t->cancelled->load() ? 1 : 0;  // non-zero aborts
+}
 
-    std::ofstream out(tmpPath, std::ios::binary);
-    if (!out) {
-        _lastError = "Cannot create file: " + tmpPath.string();
-        return false;
-    }
+} // namespace
 
-    CURL *curl = curl_easy_init();
-    if (!curl) {
-        _lastError = "Failed to initialize curl";
-        out.close();
-        std::filesystem::remove(tmpPath, ec);
-        return false;
+// ── fetchFiles ──────────────────────────────────────────────────────────
+
+bool FirmwareManager::fetchFiles(std::vector<FetchJob>& jobs,
+                                 CacheIndex& index,
+                                 ProgressCallback progress,
+                                 std::atomic<bool>& cancelled)
+{
+    CURLM* multi = curl_multi_init();
+    if (!multi) {
+        for (auto& job : jobs)
+            job.error = "Failed to initialize curl";
+        return !cancelled.load();
     }
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, MAX_PARALLEL_FETCHES);
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
 
-    char errorBuffer[CURL_ERROR_SIZE] = {0};
-    CurlNetworkConfig::instance().applyCurlSettings(
-        curl, CurlNetworkConfig::FetchProfile::LargeFile, errorBuffer);
+    std::vector<std::unique_ptr<FirmwareTransfer>> transfers;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        auto& job = jobs[i];
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curlWriteToFile);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &out);
+        std::error_code ec;
+        std::filesystem::create_directories(job.destPath.parent_path(), ec);
+        if (ec) {
+            job.error = "Cannot create directory: " + ec.message();
+            continue;
+        }
 
-    FirmwareProgressData progressData{&progress, &cancelled};
-    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, curlProgressCallback);
-    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &progressData);
-    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        // Write to a temporary file and rename on success to prevent partial
+        // downloads from poisoning the cache (crash, network drop, SIGKILL).
+        auto t = std::make_unique<FirmwareTransfer>();
+        t->job = i;
+        t->cancelled = &cancelled;
+        t->tmpPath = std::filesystem::path(job.destPath).concat(".tmp");
+        t->out.open(t->tmpPath, std::ios::binary);
+        if (!t->out) {
+            job.error = "Cannot create file: " + t->tmpPath.string();
+            continue;
+        }
 
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
+        t->curl = curl_easy_init();
+        if (!t->curl) {
+            job.error = "Failed to initialize curl";
+            t->out.close();
+            std::filesystem::remove(t->tmpPath, ec);
+            continue;
+        }
 
-    out.close();
+        CurlNetworkConfig::instance().applyCurlSettings(
+            t->curl, CurlNetworkConfig::FetchProfile::LargeFile, t->errorBuffer);
+        curl_easy_setopt(t->curl, CURLOPT_URL, job.entry->url.c_str());
+        curl_easy_setopt(t->curl, CURLOPT_WRITEFUNCTION, transferWrite);
+        curl_easy_setopt(t->curl, CURLOPT_WRITEDATA, t.get());
+        curl_easy_setopt(t->curl, CURLOPT_HEADERFUNCTION, transferHeader);
+        curl_easy_setopt(t->curl, CURLOPT_HEADERDATA, t.get());
+        curl_easy_setopt(t->curl, CURLOPT_XFERINFOFUNCTION, transferProgress);
+        curl_easy_setopt(t->curl, CURLOPT_XFERINFODATA, t.get());
+        curl_easy_setopt(t->curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(t->curl, CURLOPT_PRIVATE, t.get());
+
+        if (job.conditional) {
+            auto record = index.files.find(job.entry->localPath);
+            if (record != index.files.end()) {
+                if (!record->second.etag.empty())
+                    t->headers = curl_slist_append(t->headers, ("If-None-Match: " + record->second.etag).c_str());
+                if (!record->second.lastModified.empty())
+                    t->headers = curl_slist_append(t->headers, ("If-Modified-Since: " + record->second.lastModified).c_str());
+            }
+            if (t->headers)
+                curl_easy_setopt(t->curl, CURLOPT_HTTPHEADER, t->headers);
+            curl_easy_setopt(t->curl, CURLOPT_CONNECTTIMEOUT, REVALIDATE_CONNECT_TIMEOUT_S);
+        }
 
-    if (cancelled.load()) {
-        _lastError = "Download cancelled";
-        std::filesystem::remove(tmpPath, ec);
-        return false;
+        qDebug() << "FirmwareManager:" << (job.conditional ? "revalidating" : "downloading")
+                 << job.entry->url.c_str();
+        curl_multi_add_handle(multi, t->curl);
+        transfers.push_back(std::move(t));
     }
 
-    if (res != CURLE_OK) {
-        _lastError = "Download failed: ";
-        _lastError += errorBuffer[0] ? errorBuffer : curl_easy_strerror(res);
-        std::filesystem::remove(tmpPath, ec);
-        return false;
+    int running = static_cast<int>(transfers.size());
+    while (running > 0 && !cancelled.load()) {
+        CURLMcode mc = curl_multi_perform(multi, &running);
+        if (mc == CURLM_OK && running > 0)
+            mc = curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+        if (mc != CURLM_OK) {
+            qWarning() << "FirmwareManager: curl_multi error:" << curl_multi_strerror(mc);
+            break;
+        }
+
+        CURLMsg* msg;
+        int msgsLeft;
+        while ((msg = curl_multi_info_read(multi, &msgsLeft))) {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+            FirmwareTransfer* t = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&t));
+            t->done = true;
+            t->result = msg->data.result;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &t->responseCode);
+        }
+
+        if (progress) {
+            curl_off_t now = 0, total = 0;
+            for (const auto& t : transfers) {
+                now += t->now;
+                total += t->total;
+            }
+            if (total > 0)
+                progress(static_cast<uint64_t>(now * 100 / total), 100, "Downloading rpiboot firmware...");
+        }
     }
 
-    // Atomic rename: only a complete download becomes visible to the cache
-    std::filesystem::rename(tmpPath, destPath, ec);
-    if (ec) {
-        _lastError = "Failed to rename downloaded file: " + ec.message();
-        std::filesystem::remove(tmpPath, ec);
-        return false;
+    for (auto& t : transfers) {
+        curl_multi_remove_handle(multi, t->curl);
+        curl_easy_cleanup(t->curl);
+        curl_slist_free_all(t->headers);
+        t->out.close();
+
+        auto& job = jobs[t->job];
+        std::error_code ec;
+        if (!t->done || cancelled.load()) {
+            job.error = "Download cancelled";
+            std::filesystem::remove(t->tmpPath, ec);
+            continue;
+        }
+        if (t->result != CURLE_OK) {
+            job.error = "Download failed: ";
+            job.error += t->errorBuffer[0] ? t->errorBuffer : curl_easy_strerror(t->result);
+            std::filesystem::remove(t->tmpPath, ec);
+            continue;
+        }
+
+        const std::string sha256 = t->hash.result().toHex().toStdString();
+        auto record = index.files.find(job.entry->localPath);
+        const bool unchanged = t->responseCode == 304 ||
+            (record != index.files.end() && record->second.sha256 == sha256);
+        if (job.conditional && unchanged) {
+            // Keep the cached copy; it may have been re-signed locally
+            std::filesystem::remove(t->tmpPath, ec);
+            if (t->responseCode != 304) {
+                record->second.etag = t->etag;
+                record->second.lastModified = t->lastModified;
+            }
+            qDebug() << "FirmwareManager: unchanged" << job.entry->localPath.c_str();
+            job.ok = true;
+            continue;
+        }
+
+        // Atomic rename: only a complete download becomes visible to the cache
+        std::filesystem::rename(t->tmpPath, job.destPath, ec);
+        if (ec) {
+            job.error = "Failed to rename downloaded file: " + ec.message();
+            std::filesystem::remove(t->tmpPath, ec);
+            continue;
+        }
+
+        index.files[job.entry->localPath] = {t->etag, t->lastModified, sha256, t->bytes};
+        job.ok = true;
+        job.changed = true;
+        qDebug() << "FirmwareManager: saved" << QString::fromStdString(job.destPath.string())
+                 << "sha256" << sha256.c_str();
     }
 
-    qDebug() << "FirmwareManager: saved" << QString::fromStdString(destPath.string());
-    return true;
+    curl_multi_cleanup(multi);
+    return !cancelled.load();
 }
 
 // ── validateCacheForDevice ──────────────────────────────────────────────
@@ -578,6 +905,9 @@ std::optional<std::filesystem::path> FirmwareManager::findCachedVersion(Sideload
 
 void FirmwareManager::clearCache()
 {
+    std::lock_guard<std::timed_mutex> cacheLock(s_cacheMutex);
+    s_prepared.clear();
+    SharedFileCache::instance().clear();
     std::error_code ec;
     std::filesystem::remove_all(cacheRoot(), ec);
 }
@@ -604,10 +934,10 @@ bool FirmwareManager::extractBootcodeFromBootfiles(const std::filesystem::path&
 
     // Try chip-prefixed path first (e.g. "2711/bootcode4.bin"),
     // then fall back to the bare filename at the TAR root.
-    const auto* data = bootfiles.find(prefix + "/" + bootcodeFilename);
-    if (!data || data->empty())
+    auto data = bootfiles.find(prefix + "/" + bootcodeFilename);
+    if (data.empty())
         data = bootfiles.find(bootcodeFilename);
-    if (!data || data->empty()) {
+    if (data.empty()) {
         _lastError = bootcodeFilename + " not found inside fastboot/bootfiles.bin "
                      "(tried " + prefix + "/" + bootcodeFilename + " and " + bootcodeFilename + ")";
         return false;
@@ -619,15 +949,15 @@ bool FirmwareManager::extractBootcodeFromBootfiles(const std::filesystem::path&
         _lastError = "Cannot write " + bootcodeFilename + ": " + destPath.string();
         return false;
     }
-    out.write(reinterpret_cast<const char*>(data->data()),
-              static_cast<std::streamsize>(data->size()));
+    out.write(reinterpret_cast<const char*>(data.bytes().data()),
+              static_cast<std::streamsize>(data.size()));
     if (!out) {
         _lastError = "Write failed for " + bootcodeFilename;
         return false;
     }
 
     qDebug() << "FirmwareManager: extracted" << bootcodeFilename.c_str()
-             << "(" << data->size() << "bytes) from fastboot/bootfiles.bin";
+             << "(" << data.size() << "bytes) from fastboot/bootfiles.bin";
     return true;
 }
 
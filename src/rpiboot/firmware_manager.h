@@ -5,18 +5,26 @@
  * Downloads and caches rpiboot firmware (fastboot gadget, bootcode
  * binaries, secure-boot-recovery, etc.) from GitHub raw URLs.
  *
- * Files are fetched individually from the master/main branches of
- * the usbboot and rpi-sb-provisioner repositories and cached
- * locally under a single "master/" directory.
+ * Files are fetched from the master/main branches of the usbboot and
+ * rpi-sb-provisioner repositories and cached locally under a single
+ * "master/" directory.  An index next to them records each file's ETag,
+ * Last-Modified and SHA-256; cache hits make no network requests, and at
+ * most once per REVALIDATE_INTERVAL the cached files are revalidated with
+ * conditional requests.  A failed revalidation keeps the cache in use, so
+ * offline machines keep working.
  */
 
 #ifndef RPIBOOT_FIRMWARE_MANAGER_H
 #define RPIBOOT_FIRMWARE_MANAGER_H
 
 #include "rpiboot_types.h"
+#include "file_server.h"
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <map>
 #include <optional>
 #include <string>
 #include <vector>
@@ -29,7 +37,11 @@ public:
 
     // Ensure that firmware for the given mode and chip generation is
     // available in the local cache.  Downloads on first use; subsequent
-    // calls return the cached path.
+    // calls return the cached path.  Safe to call from several threads;
+    // calls are serialised on the shared cache directory.  Once a mode,
+    // chip, gadget and signing key combination has been prepared, further
+    // calls for it return at once, so firmware can be prepared ahead of
+    // the device turning up.
     // Returns the path to the firmware directory, or empty on failure.
     std::filesystem::path ensureAvailable(SideloadMode mode,
                                            ChipGeneration chip,
@@ -53,6 +65,12 @@ public:
     void setSignFastbootGadgetKey(const std::string& keyPath) { _signFastbootGadgetKey = keyPath; }
     const std::string& signFastbootGadgetKey() const { return _signFastbootGadgetKey; }
 
+    // Files that the last ensureAvailable() built in memory and that the
+    // file server should send in place of the disk copies, keyed by file
+    // name: the signed pieeprom.bin and pieeprom.sig in SecureBootRecovery
+    // mode, shared by every device signed with the same key.
+    const std::map<std::string, FileData>& memoryFiles() const { return _memoryFiles; }
+
     // Clear all cached firmware
     void clearCache();
 
@@ -63,6 +81,10 @@ public:
     static constexpr const char* PROVISIONER_RAW_BASE =
         "https://github.com/raspberrypi/rpi-sb-provisioner/raw/refs/heads/main/";
 
+    // How long cached files are used without asking the server whether
+    // they changed
+    static constexpr std::chrono::hours REVALIDATE_INTERVAL{24};
+
 private:
     struct ManifestEntry {
         std::string url;
@@ -73,11 +95,39 @@ private:
     std::vector<ManifestEntry> buildManifest(SideloadMode mode,
                                               ChipGeneration chip) const;
 
-    // Download a single file via curl
-    bool downloadFile(const std::string& url,
-                       const std::filesystem::path& destPath,
-                       ProgressCallback progress,
-                       std::atomic<bool>& cancelled);
+    // What the server told us about a cached file (index.json)
+    struct CacheRecord {
+        std::string etag;
+        std::string lastModified;
+        std::string sha256;     // hex, computed once while downloading
+        uint64_t size = 0;
+    };
+
+    struct CacheIndex {
+        std::map<std::string, CacheRecord> files;  // keyed by localPath
+        int64_t lastRevalidated = 0;               // seconds since epoch
+    };
+
+    static CacheIndex loadCacheIndex(const std::filesystem::path& versionDir);
+    static bool saveCacheIndex(const std::filesystem::path& versionDir,
+                               const CacheIndex& index);
+
+    struct FetchJob {
+        const ManifestEntry* entry = nullptr;
+        std::filesystem::path destPath;
+        bool conditional = false;  // revalidating a cached copy
+        bool ok = false;
+        bool changed = false;      // destPath was replaced with new content
+        std::string error;
+    };
+
+    // Fetch all jobs concurrently via curl_multi, updating `index` for the
+    // ones that succeed.  Each job reports its own outcome; returns false
+    // only if cancelled.
+    bool fetchFiles(std::vector<FetchJob>& jobs,
+                    CacheIndex& index,
+                    ProgressCallback progress,
+                    std::atomic<bool>& cancelled);
 
     // Check that a cached version directory contains the required files
     // for the given chip generation and sideload mode.
@@ -97,6 +147,7 @@ private:
     std::string _lastError;
     std::string _customFastbootGadget;
     std::string _signFastbootGadgetKey;
+    std::map<std::string, FileData> _memoryFiles;
 };
 
 } // namespace rpiboot
@@ -5,7 +5,10 @@
 
 #include "libusb_transport.h"
 #include <libusb.h>
+#include <algorithm>
+#include <condition_variable>
 #include <cstring>
+#include <mutex>
 #include <stdexcept>
 #include <thread>
 #include <QDebug>
@@ -131,13 +134,212 @@ std::unique_ptr<LibusbTransport> LibusbContext::openDevice(const UsbDeviceInfo&
     if (!handle)
         return nullptr;
 
-    return std::make_unique<LibusbTransport>(handle);
+    return std::make_unique<LibusbTransport>(handle, _ctx);
+}
+
+// ── LibusbTransport::AsyncEngine ───────────────────────────────────────
+//
+// Runs libusb's event loop on its own thread for the lifetime of the
+// transport and lets stream calls keep a window of transfers queued.
+// Transfer slots are reused round-robin: transfer i uses slot i % depth,
+// and completions are consumed in submission order, so a slot is only
+// refilled after its previous transfer has been accounted for.
+
+class LibusbTransport::AsyncEngine {
+public:
+    AsyncEngine(libusb_context* ctx, libusb_device_handle* handle)
+        : _ctx(ctx), _handle(handle)
+    {
+        _thread = std::thread([this] { eventLoop(); });
+    }
+
+    ~AsyncEngine()
+    {
+        _stop = true;
+        _thread.join();
+        for (auto& slot : _slots)
+            libusb_free_transfer(slot.transfer);
+    }
+
+    int64_t run(uint8_t endpoint, uint8_t* data, size_t size,
+                size_t chunkSize, int depthLimit, int chunkTimeoutMs,
+                const std::atomic<bool>& cancelled,
+                const BulkProgressFn& progress);
+
+private:
+    struct Slot {
+        AsyncEngine* engine = nullptr;
+        libusb_transfer* transfer = nullptr;
+        bool inFlight = false;
+    };
+
+    static void LIBUSB_CALL onComplete(libusb_transfer* transfer)
+    {
+        auto* slot = static_cast<Slot*>(transfer->user_data);
+        {
+            std::lock_guard<std::mutex> lock(slot->engine->_mutex);
+            slot->inFlight = false;
+        }
+        slot->engine->_completed.notify_all();
+    }
+
+    void eventLoop()
+    {
+        while (!_stop.load()) {
+            timeval tv{0, 100 * 1000};
+            libusb_handle_events_timeout_completed(_ctx, &tv, nullptr);
+        }
+    }
+
+    bool ensureSlots(size_t count)
+    {
+        while (_slots.size() < count) {
+            libusb_transfer* transfer = libusb_alloc_transfer(0);
+            if (!transfer)
+                return false;
+            _slots.push_back(std::make_unique<Slot>());
+            _slots.back()->engine = this;
+            _slots.back()->transfer = transfer;
+        }
+        return true;
+    }
+
+    libusb_context* _ctx;
+    libusb_device_handle* _handle;
+    std::thread _thread;
+    std::atomic<bool> _stop{false};
+    std::mutex _mutex;
+    std::condition_variable _completed;
+    std::vector<std::unique_ptr<Slot>> _slots;  // stable addresses for user_data
+};
+
+static int transferStatusToError(int status)
+{
+    switch (status) {
+    case LIBUSB_TRANSFER_TIMED_OUT: return LIBUSB_ERROR_TIMEOUT;
+    case LIBUSB_TRANSFER_STALL:     return LIBUSB_ERROR_PIPE;
+    case LIBUSB_TRANSFER_NO_DEVICE: return LIBUSB_ERROR_NO_DEVICE;
+    case LIBUSB_TRANSFER_OVERFLOW:  return LIBUSB_ERROR_OVERFLOW;
+    case LIBUSB_TRANSFER_CANCELLED: return LIBUSB_ERROR_INTERRUPTED;
+    default:                        return LIBUSB_ERROR_IO;
+    }
+}
+
+int64_t LibusbTransport::AsyncEngine::run(uint8_t endpoint, uint8_t* data, size_t size,
+                                          size_t chunkSize, int depthLimit, int chunkTimeoutMs,
+                                          const std::atomic<bool>& cancelled,
+                                          const BulkProgressFn& progress)
+{
+    const bool in = (endpoint & LIBUSB_ENDPOINT_IN) != 0;
+    const size_t count = (size + chunkSize - 1) / chunkSize;
+    const size_t depth = std::min<size_t>(static_cast<size_t>(depthLimit), count);
+    if (!ensureSlots(depth))
+        return LIBUSB_ERROR_NO_MEM;
+
+    auto submit = [&](size_t index) -> int {
+        Slot& slot = *_slots[index % depth];
+        const size_t offset = index * chunkSize;
+        const size_t length = std::min(chunkSize, size - offset);
+        libusb_fill_bulk_transfer(slot.transfer, _handle, endpoint,
+                                  data + offset, static_cast<int>(length),
+                                  onComplete, &slot,
+                                  static_cast<unsigned int>(chunkTimeoutMs));
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            slot.inFlight = true;
+        }
+        int rc = libusb_submit_transfer(slot.transfer);
+        if (rc != LIBUSB_SUCCESS) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            slot.inFlight = false;
+        }
+        return rc;
+    };
+
+    // Wait for a slot; returns false if cancelled first
+    auto waitFor = [&](Slot& slot, bool honourCancel) -> bool {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (slot.inFlight) {
+            if (honourCancel && cancelled.load())
+                return false;
+            _completed.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        return true;
+    };
+
+    size_t submitted = 0;
+    size_t completed = 0;
+    size_t transferred = 0;   // contiguous bytes before the first failure
+    int error = 0;
+    bool endOfData = false;
+
+    while (submitted < depth && !error) {
+        error = submit(submitted);
+        if (!error)
+            ++submitted;
+    }
+
+    while (completed < submitted && !error && !endOfData) {
+        Slot& slot = *_slots[completed % depth];
+        if (!waitFor(slot, true)) {
+            error = LIBUSB_ERROR_INTERRUPTED;
+            break;
+        }
+        ++completed;
+
+        const libusb_transfer* t = slot.transfer;
+        transferred += static_cast<size_t>(t->actual_length);
+        if (t->status != LIBUSB_TRANSFER_COMPLETED) {
+            error = transferStatusToError(t->status);
+            break;
+        }
+        if (t->actual_length != t->length) {
+            // A short IN transfer is the device ending its data; a short
+            // OUT transfer should not happen without an error status.
+            if (in)
+                endOfData = true;
+            else
+                error = LIBUSB_ERROR_IO;
+        }
+        if (progress)
+            progress(transferred);
+
+        if (!error && !endOfData && submitted < count) {
+            error = submit(submitted);
+            if (!error)
+                ++submitted;
+        }
+    }
+
+    // Cancel whatever is still queued.  If any of it moved data, the
+    // stream has a hole and the caller cannot resume at a known offset.
+    bool hole = false;
+    if (completed < submitted) {
+        for (size_t i = completed; i < submitted; ++i)
+            libusb_cancel_transfer(_slots[i % depth]->transfer);
+        for (size_t i = completed; i < submitted; ++i) {
+            waitFor(*_slots[i % depth], false);
+            if (_slots[i % depth]->transfer->actual_length > 0)
+                hole = true;
+        }
+    }
+
+    if (error || hole) {
+        qDebug() << "rpiboot: async bulk" << (in ? "read" : "write") << "stopped after"
+                 << (qulonglong)transferred << "of" << (qulonglong)size << "bytes:"
+                 << libusb_strerror(static_cast<libusb_error>(error ? error : LIBUSB_ERROR_IO))
+                 << "(ep=0x" << Qt::hex << (int)endpoint << ")";
+        if (error == LIBUSB_ERROR_PIPE)
+            libusb_clear_halt(_handle, endpoint);
+        return hole || !error ? LIBUSB_ERROR_IO : error;
+    }
+    return static_cast<int64_t>(transferred);
 }
 
 // ── LibusbTransport ────────────────────────────────────────────────────
 
-LibusbTransport::LibusbTransport(libusb_device_handle* handle)
-    : _handle(handle)
+LibusbTransport::LibusbTransport(libusb_device_handle* handle, libusb_context* ctx)
+    : _ctx(ctx), _handle(handle)
 {
     // Read the active config descriptor to determine the correct interface
     // and bulk endpoints, matching the upstream rpiboot Initialize_Device() logic.
@@ -164,6 +366,16 @@ LibusbTransport::LibusbTransport(libusb_device_handle* handle)
                  << "interface=" << _interface << "outEp=0x" << Qt::hex << (int)_outEp;
     }
 
+    switch (libusb_get_device_speed(libusb_get_device(_handle))) {
+    case LIBUSB_SPEED_LOW:        _speed = UsbSpeed::Low; break;
+    case LIBUSB_SPEED_FULL:       _speed = UsbSpeed::Full; break;
+    case LIBUSB_SPEED_HIGH:       _speed = UsbSpeed::High; break;
+    case LIBUSB_SPEED_SUPER:      _speed = UsbSpeed::Super; break;
+    case LIBUSB_SPEED_SUPER_PLUS: _speed = UsbSpeed::SuperPlus; break;
+    default:                      _speed = UsbSpeed::Unknown; break;
+    }
+    _initDiag += QStringLiteral("speed=%1; ").arg(static_cast<int>(_speed));
+
     // Enable automatic kernel driver detach on Linux if a driver is attached
     // when claim_interface is called.  This is a no-op on macOS.
     libusb_set_auto_detach_kernel_driver(_handle, 1);
@@ -203,6 +415,7 @@ LibusbTransport::LibusbTransport(libusb_device_handle* handle)
 
 LibusbTransport::~LibusbTransport()
 {
+    _async.reset();  // stops the event thread before the handle goes away
     if (_handle) {
         if (_interfaceClaimed)
             libusb_release_interface(_handle, _interface);
@@ -321,6 +534,47 @@ int LibusbTransport::bulkRead(uint8_t endpoint,
     return rc;
 }
 
+int64_t LibusbTransport::streamAsync(uint8_t endpoint, uint8_t* data, size_t size,
+                                     size_t chunkSize, int chunkTimeoutMs,
+                                     const std::atomic<bool>& cancelled,
+                                     const BulkProgressFn& progress)
+{
+    if (!_async)
+        _async = std::make_unique<AsyncEngine>(_ctx, _handle);
+    return _async->run(endpoint, data, size, chunkSize, _maxInFlight,
+                       chunkTimeoutMs, cancelled, progress);
+}
+
+int64_t LibusbTransport::bulkWriteStream(uint8_t endpoint,
+                                         std::span<const uint8_t> data,
+                                         size_t chunkSize, int chunkTimeoutMs,
+                                         const std::atomic<bool>& cancelled,
+                                         const BulkProgressFn& progress)
+{
+    if (!_handle)
+        return -1;
+    if (!_ctx || _maxInFlight <= 1 || data.size() <= chunkSize || chunkSize == 0)
+        return IUsbTransport::bulkWriteStream(endpoint, data, chunkSize ? chunkSize : data.size(),
+                                              chunkTimeoutMs, cancelled, progress);
+    return streamAsync(static_cast<uint8_t>(endpoint & ~LIBUSB_ENDPOINT_IN), const_cast<uint8_t*>(data.data()), data.size(),
+                       chunkSize, chunkTimeoutMs, cancelled, progress);
+}
+
+int64_t LibusbTransport::bulkReadStream(uint8_t endpoint,
+                                        std::span<uint8_t> buffer,
+                                        size_t chunkSize, int chunkTimeoutMs,
+                                        const std::atomic<bool>& cancelled,
+                                        const BulkProgressFn& progress)
+{
+    if (!_handle)
+        return -1;
+    if (!_ctx || _maxInFlight <= 1 || buffer.size() <= chunkSize || chunkSize == 0)
+        return IUsbTransport::bulkReadStream(endpoint, buffer, chunkSize ? chunkSize : buffer.size(),
+                                             chunkTimeoutMs, cancelled, progress);
+    return streamAsync(static_cast<uint8_t>(endpoint | LIBUSB_ENDPOINT_IN), buffer.data(), buffer.size(),
+                       chunkSize, chunkTimeoutMs, cancelled, progress);
+}
+
 bool LibusbTransport::isOpen() const
 {
     return _handle != nullptr;
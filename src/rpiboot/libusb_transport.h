@@ -64,8 +64,10 @@ private:
 // Real IUsbTransport implementation backed by libusb
 class LibusbTransport : public IUsbTransport {
 public:
-    // Takes ownership of the handle; claims interface 0
-    explicit LibusbTransport(libusb_device_handle* handle);
+    // Takes ownership of the handle; claims interface 0.  `ctx` is the
+    // context the handle was opened on; without it the stream transfers
+    // fall back to one synchronous transfer at a time.
+    explicit LibusbTransport(libusb_device_handle* handle, libusb_context* ctx = nullptr);
     ~LibusbTransport() override;
 
     LibusbTransport(const LibusbTransport&) = delete;
@@ -89,8 +91,31 @@ public:
                  std::span<uint8_t> buffer,
                  int timeoutMs) override;
 
+    // Asynchronous: up to maxTransfersInFlight() transfers are queued at
+    // once and completed by a dedicated libusb event thread, so the bus
+    // never idles waiting for the host between transfers.
+    int64_t bulkWriteStream(uint8_t endpoint,
+                            std::span<const uint8_t> data,
+                            size_t chunkSize, int chunkTimeoutMs,
+                            const std::atomic<bool>& cancelled,
+                            const BulkProgressFn& progress = {}) override;
+
+    int64_t bulkReadStream(uint8_t endpoint,
+                           std::span<uint8_t> buffer,
+                           size_t chunkSize, int chunkTimeoutMs,
+                           const std::atomic<bool>& cancelled,
+                           const BulkProgressFn& progress = {}) override;
+
     bool isOpen() const override;
 
+    UsbSpeed speed() const override { return _speed; }
+
+    // Transfers kept in flight by the stream calls (1 = synchronous)
+    void setMaxTransfersInFlight(int count) { _maxInFlight = count < 1 ? 1 : count; }
+    int maxTransfersInFlight() const { return _maxInFlight; }
+
+    static constexpr int DEFAULT_TRANSFERS_IN_FLIGHT = 8;
+
     uint8_t outEndpoint() const override { return _outEp; }
     uint8_t inEndpoint() const override { return _inEp; }
 
@@ -99,11 +124,22 @@ public:
     const QString& initDiagnostics() const { return _initDiag; }
 
 private:
+    class AsyncEngine;
+
+    int64_t streamAsync(uint8_t endpoint, uint8_t* data, size_t size,
+                        size_t chunkSize, int chunkTimeoutMs,
+                        const std::atomic<bool>& cancelled,
+                        const BulkProgressFn& progress);
+
+    libusb_context* _ctx = nullptr;
+    std::unique_ptr<AsyncEngine> _async;
+    int _maxInFlight = DEFAULT_TRANSFERS_IN_FLIGHT;
     libusb_device_handle* _handle = nullptr;
     bool _interfaceClaimed = false;
     uint8_t _interface = 0;
     uint8_t _outEp = 0x01;
     uint8_t _inEp = 0x82;
+    UsbSpeed _speed = UsbSpeed::Unknown;
     QString _initDiag;
 };
 
@@ -4,6 +4,7 @@
  */
 
 #include "rpiboot_protocol.h"
+#include "shared_file_cache.h"
 
 #include <thread>
 
@@ -44,25 +45,36 @@ bool RpibootProtocol::serveFiles(IUsbTransport& transport,
     bool haveBootfiles = false;
 
     if (std::filesystem::exists(bootfilesTar)) {
-        if (!_bootfiles.extractFromFile(bootfilesTar.string())) {
-            _lastError = "Failed to extract bootfiles.bin: " + _bootfiles.lastError();
+        std::string error;
+        _bootfiles = SharedFileCache::instance().bootfiles(bootfilesTar, &error);
+        if (!_bootfiles) {
+            _lastError = "Failed to extract bootfiles.bin: " + error;
             return false;
         }
         haveBootfiles = true;
     }
 
-    // Custom file resolver that first checks the extracted tar, then disk
-    FileResolver resolver;
-    if (haveBootfiles) {
+    // Custom file resolver that first checks the in-memory overrides, then
+    // the tar, then disk.  Archive entries are handed out as views into the
+    // shared archive.
+    SharedFileResolver resolver;
+    if (haveBootfiles || !_fileOverrides.empty()) {
         auto prefix = chipDirectoryPrefix(gen);
-        resolver = [this, &sideloadDir, prefix](const std::string& filename) -> std::vector<uint8_t> {
-            // Try the tar archive first (with chip-specific prefix fallback)
-            const auto* data = _bootfiles.find(filename, prefix);
-            if (data)
-                return *data;
+        auto archive = haveBootfiles ? _bootfiles : nullptr;
+        resolver = [archive, overrides = _fileOverrides, &sideloadDir, prefix](const std::string& filename) -> FileData {
+            if (auto it = overrides.find(filename); it != overrides.end())
+                return it->second;
+
+            // Try the tar archive (with chip-specific prefix fallback)
+            if (archive) {
+                if (auto data = archive->find(filename, prefix))
+                    return data;
+            }
 
             // Fall back to on-disk files
-            return FileServer::readFileFromDisk(sideloadDir, filename);
+            if (filename.empty() || filename[0] == '*')
+                return nullptr;
+            return SharedFileCache::instance().file(sideloadDir / filename);
         };
     }
 
@@ -21,6 +21,8 @@
 
 #include <atomic>
 #include <filesystem>
+#include <map>
+#include <memory>
 #include <string>
 
 namespace rpiboot {
@@ -62,6 +64,11 @@ public:
                     ProgressCallback progress,
                     std::atomic<bool>& cancelled);
 
+    // Serve `bytes` for requests of `filename` instead of the file in the
+    // sideload directory or bootfiles.bin (e.g. a signed EEPROM image held
+    // in memory).
+    void setFileOverride(const std::string& filename, FileData bytes) { _fileOverrides[filename] = std::move(bytes); }
+
     // Device metadata collected during the protocol run
     const DeviceMetadata& metadata() const { return _fileServer.metadata(); }
 
@@ -76,7 +83,8 @@ private:
 
     BootcodeLoader _bootcodeLoader;
     FileServer _fileServer;
-    Bootfiles _bootfiles;
+    std::shared_ptr<const Bootfiles> _bootfiles;  // shared via SharedFileCache
+    std::map<std::string, FileData> _fileOverrides;
     std::string _lastError;
 };
 
@@ -127,6 +127,23 @@ constexpr uint8_t VENDOR_REQUEST_TYPE   = 0x40;         // bmRequestType for ven
 constexpr uint8_t VENDOR_REQUEST        = 0;             // bRequest
 constexpr int     DEFAULT_TIMEOUT_MS    = 3000;
 
+// Negotiated link speed of an open device
+enum class UsbSpeed { Unknown, Low, Full, High, Super, SuperPlus };
+
+// Transfer size for streaming a payload over bulk OUT/IN.  USB 2 keeps
+// `baseChunkSize` (what upstream usbboot uses, and what the macOS stack
+// is known to accept); a SuperSpeed link moves a 16 KiB transfer in
+// microseconds, so it gets multi-MiB transfers to cut per-transfer
+// overhead.
+inline size_t bulkChunkSizeFor(UsbSpeed speed, size_t baseChunkSize = BULK_CHUNK_SIZE)
+{
+    switch (speed) {
+    case UsbSpeed::Super:     return std::max<size_t>(baseChunkSize, 1024 * 1024);
+    case UsbSpeed::SuperPlus: return std::max<size_t>(baseChunkSize, 4 * 1024 * 1024);
+    default:                  return baseChunkSize;
+    }
+}
+
 // Fastboot USB VID/PID used by the RPi fastboot gadget after rpiboot
 // sideloads it.  Note: the standard Android fastboot PID is 0x4ee0;
 // the RPi gadget uses 0x4e40.
@@ -11,9 +11,12 @@
 
 #include <QFile>
 #include <QProcess>
+#include <QSaveFile>
 #include <QDebug>
 
 #include <cstring>
+#include <map>
+#include <mutex>
 
 namespace rpiboot {
 
@@ -142,67 +145,88 @@ static QByteArray defaultBootConf2711()
     return b;
 }
 
-// Generate the pieeprom.sig file alongside a signed pieeprom.bin.  Format
-// matches rpi-eeprom-digest run *without* -k: just sha256 + ts.  The RSA
-// proof for the bootloader lives inside pieeprom.bin as bootconf.sig.
-static bool writePieepromSig(const std::filesystem::path& bootImgPath,
-                              const std::filesystem::path& sigPath,
-                              std::string& errOut)
+// pieeprom.sig for a signed pieeprom.bin.  Format matches rpi-eeprom-digest
+// run *without* -k: just sha256 + ts.  The RSA proof for the bootloader
+// lives inside pieeprom.bin as bootconf.sig.
+static QByteArray pieepromSig(const QByteArray& pieeprom)
 {
-    QString imgQStr = QString::fromStdString(bootImgPath.string());
-    QByteArray hashHex = SecureBoot::sha256File(imgQStr);
-    if (hashHex.isEmpty()) {
-        errOut = "Failed to hash signed pieeprom.bin";
-        return false;
-    }
-    QFile f(QString::fromStdString(sigPath.string()));
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
-        errOut = "Cannot write " + sigPath.string();
-        return false;
+    AcceleratedCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(pieeprom);
+    return hash.result().toHex() + "\n"
+         + "ts: " + QByteArray::number(SecureBoot::getCurrentTimestamp()) + "\n";
+}
+
+static std::shared_ptr<const std::vector<uint8_t>> toSharedBytes(const QByteArray& ba)
+{
+    return std::make_shared<const std::vector<uint8_t>>(
+        reinterpret_cast<const uint8_t*>(ba.constData()),
+        reinterpret_cast<const uint8_t*>(ba.constData()) + ba.size());
+}
+
+// Identifies the inputs of one signing: a changed key or original image
+// (same path, new contents) misses the cache
+static std::string signingCacheKey(ChipGeneration gen,
+                                   const std::filesystem::path& original,
+                                   const std::filesystem::path& privateKeyPath,
+                                   bool counterSignFirmware)
+{
+    std::string key = std::to_string(static_cast<int>(gen)) + (counterSignFirmware ? "|cs" : "|");
+    for (const auto& path : {original, privateKeyPath}) {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(path, ec);
+        const auto mtime = std::filesystem::last_write_time(path, ec);
+        key += "|" + path.string() + ":" + std::to_string(size) + ":"
+             + std::to_string(mtime.time_since_epoch().count());
     }
-    f.write(hashHex);
-    f.write("\n");
-    f.write("ts: ");
-    f.write(QByteArray::number(SecureBoot::getCurrentTimestamp()));
-    f.write("\n");
-    f.close();
-    return true;
+    return key;
 }
 
-bool SecureBootProvisioner::prepareSignedRecovery(ChipGeneration gen,
-                                                    const std::filesystem::path& recoveryDir,
-                                                    const std::filesystem::path& privateKeyPath,
-                                                    bool counterSignFirmware,
-                                                    std::string& errOut)
+std::optional<SecureBootProvisioner::SignedRecovery> SecureBootProvisioner::signedRecovery(
+    ChipGeneration gen,
+    const std::filesystem::path& recoveryDir,
+    const std::filesystem::path& privateKeyPath,
+    bool counterSignFirmware,
+    std::string& errOut)
 {
     if (!std::filesystem::exists(recoveryDir)) {
         errOut = "Recovery firmware directory not found: " + recoveryDir.string();
-        return false;
+        return std::nullopt;
     }
     if (!std::filesystem::exists(privateKeyPath)) {
         errOut = "Private key not found: " + privateKeyPath.string();
-        return false;
+        return std::nullopt;
     }
     if (gen != ChipGeneration::BCM2711 && gen != ChipGeneration::BCM2712) {
         errOut = "Secure-boot signing is only supported for BCM2711/BCM2712";
-        return false;
+        return std::nullopt;
     }
 
     const auto pieepromOriginal = recoveryDir / "pieeprom.original.bin";
-    const auto pieepromOut      = recoveryDir / "pieeprom.bin";
-    const auto pieepromSig      = recoveryDir / "pieeprom.sig";
     if (!std::filesystem::exists(pieepromOriginal)) {
         errOut = "pieeprom.original.bin not found in " + recoveryDir.string();
-        return false;
+        return std::nullopt;
     }
 
+    static std::mutex cacheMutex;
+    static std::map<std::string, SignedRecovery> cache;
+    const std::string cacheKey = signingCacheKey(gen, pieepromOriginal, privateKeyPath,
+                                                 counterSignFirmware);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (auto it = cache.find(cacheKey); it != cache.end())
+        return it->second;
+
     QString keyQStr = QString::fromStdString(privateKeyPath.string());
 
     // 1. Load pieeprom.original.bin into the TLV editor.
+    QFile originalFile(QString::fromStdString(pieepromOriginal.string()));
+    if (!originalFile.open(QIODevice::ReadOnly)) {
+        errOut = "Cannot read " + pieepromOriginal.string();
+        return std::nullopt;
+    }
     BootloaderImage img;
-    if (!img.load(QString::fromStdString(pieepromOriginal.string()))) {
+    if (!img.loadFromBytes(originalFile.readAll())) {
         errOut = "Failed to parse pieeprom.original.bin: " + img.lastError().toStdString();
-        return false;
+        return std::nullopt;
     }
 
     // 2. Build bootconf.txt and its RSA signature blob.
@@ -211,7 +235,7 @@ bool SecureBootProvisioner::prepareSignedRecovery(ChipGeneration gen,
     const QByteArray bootConfSig = SecureBoot::generateConfigSig(bootConf, keyQStr);
     if (bootConfSig.isEmpty()) {
         errOut = "Failed to sign bootconf.txt with " + privateKeyPath.string();
-        return false;
+        return std::nullopt;
     }
 
     // 3. Extract the bootloader's public key in the 264-byte format the
@@ -219,7 +243,7 @@ bool SecureBootProvisioner::prepareSignedRecovery(ChipGeneration gen,
     const QByteArray pubkeyBin = SecureBoot::extractRsaPubkeyBin(keyQStr);
     if (pubkeyBin.size() != 264) {
         errOut = "Failed to extract RSA pubkey from " + privateKeyPath.string();
-        return false;
+        return std::nullopt;
     }
 
     // 4. (Optional) Counter-sign the bootcode embedded in pieeprom for
@@ -230,54 +254,90 @@ bool SecureBootProvisioner::prepareSignedRecovery(ChipGeneration gen,
         QByteArray bootcode = img.getFile(QStringLiteral("bootcode.bin"));
         if (bootcode.isEmpty()) {
             errOut = "Failed to extract bootcode.bin from pieeprom.original.bin";
-            return false;
+            return std::nullopt;
         }
         QByteArray signedBootcode = SecureBoot::signBootcode2712(bootcode, keyQStr);
         if (signedBootcode.isEmpty()) {
             errOut = "Failed to counter-sign bootcode.bin";
-            return false;
+            return std::nullopt;
         }
         if (!img.updateBootcode(signedBootcode)) {
             errOut = "Failed to embed signed bootcode in pieeprom.bin: "
                    + img.lastError().toStdString();
-            return false;
+            return std::nullopt;
         }
     }
 
     // 5. Splice bootconf.txt, bootconf.sig and pubkey.bin into the EEPROM.
     if (!img.updateFile(QStringLiteral("bootconf.txt"), bootConf)) {
         errOut = "Failed to update bootconf.txt: " + img.lastError().toStdString();
-        return false;
+        return std::nullopt;
     }
     if (!img.updateFile(QStringLiteral("bootconf.sig"), bootConfSig)) {
         errOut = "Failed to update bootconf.sig: " + img.lastError().toStdString();
-        return false;
+        return std::nullopt;
     }
     if (!img.updateFile(QStringLiteral("pubkey.bin"), pubkeyBin)) {
         errOut = "Failed to update pubkey.bin: " + img.lastError().toStdString();
-        return false;
+        return std::nullopt;
     }
 
-    if (!img.save(QString::fromStdString(pieepromOut.string()))) {
-        errOut = "Failed to write " + pieepromOut.string();
+    // 6. pieeprom.sig (SHA-256 + timestamp; no rsa2048 line — the RSA
+    //    proof lives inside pieeprom.bin as bootconf.sig).
+    SignedRecovery result;
+    result.pieeprom = toSharedBytes(img.bytes());
+    result.pieepromSig = toSharedBytes(pieepromSig(img.bytes()));
+    cache[cacheKey] = result;
+
+    qDebug() << "SecureBootProvisioner: signed pieeprom.bin for"
+             << QString::fromStdString(recoveryDir.string())
+             << "(counter-sign firmware:" << counterSignFirmware << ")";
+    return result;
+}
+
+// Write `bytes` to `path` unless it already holds them.  Replaces the file
+// by renaming, as SharedFileCache may have the old one mapped.
+static bool writeIfChanged(const std::filesystem::path& path,
+                           const std::vector<uint8_t>& bytes,
+                           std::string& errOut)
+{
+    const QString qpath = QString::fromStdString(path.string());
+    const QByteArray wanted = QByteArray::fromRawData(
+        reinterpret_cast<const char*>(bytes.data()), static_cast<qsizetype>(bytes.size()));
+
+    QFile existing(qpath);
+    if (existing.size() == wanted.size() && existing.open(QIODevice::ReadOnly)
+        && existing.readAll() == wanted)
+        return true;
+
+    QSaveFile f(qpath);
+    if (!f.open(QIODevice::WriteOnly) || f.write(wanted) != wanted.size() || !f.commit()) {
+        errOut = "Cannot write " + path.string();
         return false;
     }
+    return true;
+}
 
-    // 6. Generate pieeprom.sig (SHA-256 + timestamp; no rsa2048 line — the
-    //    RSA proof lives inside pieeprom.bin as bootconf.sig).
-    if (!writePieepromSig(pieepromOut, pieepromSig, errOut))
+bool SecureBootProvisioner::prepareSignedRecovery(ChipGeneration gen,
+                                                    const std::filesystem::path& recoveryDir,
+                                                    const std::filesystem::path& privateKeyPath,
+                                                    bool counterSignFirmware,
+                                                    std::string& errOut,
+                                                    SignedRecovery* recoveryOut)
+{
+    auto recovery = signedRecovery(gen, recoveryDir, privateKeyPath, counterSignFirmware, errOut);
+    if (!recovery)
         return false;
+    if (recoveryOut)
+        *recoveryOut = *recovery;
 
     // Note: counter-signing the second-stage bootcode that gets uploaded to
     // the ROM (versionDir/bootcode5.bin) is handled by FirmwareManager — it
     // owns the top-level cache directory that BootcodeLoader reads from,
     // and the same logic applies for both Fastboot and SecureBootRecovery
     // modes on BCM2712.  BCM2711 doesn't require that step.
-
-    qDebug() << "SecureBootProvisioner: signed pieeprom.bin written to"
-             << QString::fromStdString(pieepromOut.string())
-             << "(counter-sign firmware:" << counterSignFirmware << ")";
-    return true;
+    return writeIfChanged(recoveryDir / "pieeprom.bin", *recovery->pieeprom, errOut)
+        && writeIfChanged(recoveryDir / "pieeprom.sig", *recovery->pieepromSig, errOut);
 }
 
 bool SecureBootProvisioner::provision(IUsbTransport& transport,
@@ -17,9 +17,12 @@
 
 #include <array>
 #include <atomic>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace rpiboot {
 
@@ -35,6 +38,21 @@ public:
     static std::optional<std::array<uint8_t, 32>> calculateOtpKeyHash(
         const std::filesystem::path& publicKeyPath);
 
+    // The signed pieeprom.bin and pieeprom.sig that prepareSignedRecovery()
+    // writes, built in memory.  Signing runs once per chip, key and
+    // pieeprom.original.bin: later calls with the same inputs (the next
+    // device of a provisioning batch) return the same shared buffers, which
+    // can be served to the device as they are (FileServer's FileData).
+    struct SignedRecovery {
+        std::shared_ptr<const std::vector<uint8_t>> pieeprom;
+        std::shared_ptr<const std::vector<uint8_t>> pieepromSig;
+    };
+    static std::optional<SignedRecovery> signedRecovery(ChipGeneration gen,
+                                                        const std::filesystem::path& recoveryDir,
+                                                        const std::filesystem::path& privateKeyPath,
+                                                        bool counterSignFirmware,
+                                                        std::string& errOut);
+
     // Prepare a secure-boot-recovery firmware directory for re-provisioning
     // an already-fused CM5 (or CM4).  Operates in-place in `recoveryDir`,
     // which must already contain `pieeprom.original.bin` and (for BCM2712)
@@ -52,11 +70,14 @@ public:
     // counterSignFirmware should be true when the device already has
     // secure-boot fused; on a fresh board, ROM verifies recovery against
     // a key hash of zero and a counter-signed bootcode will not boot.
+    // The files are only rewritten when their contents change, and the
+    // in-memory copies are returned through `recoveryOut` when given.
     static bool prepareSignedRecovery(ChipGeneration gen,
                                        const std::filesystem::path& recoveryDir,
                                        const std::filesystem::path& privateKeyPath,
                                        bool counterSignFirmware,
-                                       std::string& errOut);
+                                       std::string& errOut,
+                                       SignedRecovery* recoveryOut = nullptr);
 
     // Execute OTP provisioning via the rpiboot protocol.
     // This sideloads the recovery firmware which programs the key hash.
@@ -0,0 +1,149 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "shared_file_cache.h"
+
+#include <QDebug>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rpiboot {
+
+namespace {
+
+#ifndef _WIN32
+// Owner of a read-only mapping; unmapped when the last FileData goes away
+struct Mapping {
+    void* addr = nullptr;
+    size_t length = 0;
+    ~Mapping() { if (addr) ::munmap(addr, length); }
+};
+#endif
+
+} // namespace
+
+SharedFileCache& SharedFileCache::instance()
+{
+    static SharedFileCache cache;
+    return cache;
+}
+
+bool SharedFileCache::stampOf(const std::filesystem::path& path, Stamp& stamp)
+{
+    std::error_code ec;
+    stamp.size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return false;
+    stamp.mtime = std::filesystem::last_write_time(path, ec);
+    return !ec;
+}
+
+FileData SharedFileCache::mapFile(const std::filesystem::path& path)
+{
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+    // The file may have been replaced since it was stat()ed; map what was
+    // actually opened
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    const size_t length = static_cast<size_t>(st.st_size);
+    void* addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return nullptr;
+
+    // Served front to back over USB
+    ::madvise(addr, length, MADV_SEQUENTIAL);
+
+    auto mapping = std::make_shared<Mapping>();
+    mapping->addr = addr;
+    mapping->length = length;
+    return FileData(mapping, std::span<const uint8_t>(static_cast<const uint8_t*>(addr), mapping->length));
+#else
+    // A mapped file cannot be replaced on Windows, which would break
+    // FirmwareManager refreshing the cache; read these files instead
+    (void)path;
+    return nullptr;
+#endif
+}
+
+FileData SharedFileCache::file(const std::filesystem::path& path)
+{
+    Stamp stamp;
+    if (!stampOf(path, stamp) || stamp.size == 0)
+        return nullptr;
+
+    // Held while loading so concurrent sessions asking for the same file
+    // wait for the first read instead of each reading it
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _files.find(path);
+    if (it != _files.end() && it->second.first == stamp)
+        return it->second.second;
+
+    FileData contents;
+    if (stamp.size >= MAP_THRESHOLD)
+        contents = mapFile(path);
+    if (!contents) {
+        auto data = FileServer::readFileFromDisk(path.parent_path(), path.filename().string());
+        if (data.empty())
+            return nullptr;
+        contents = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+    }
+
+    _files[path] = {stamp, contents};
+    return contents;
+}
+
+std::shared_ptr<const Bootfiles> SharedFileCache::bootfiles(const std::filesystem::path& path,
+                                                            std::string* error)
+{
+    Stamp stamp;
+    if (!stampOf(path, stamp)) {
+        if (error)
+            *error = "Cannot stat " + path.string();
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _bootfiles.find(path);
+    if (it != _bootfiles.end() && it->second.stamp == stamp)
+        return it->second.value;
+
+    // Indexed in place: entries are served straight from the mapping (or
+    // a single read of the file), never copied out
+    FileData tar;
+    if (stamp.size >= MAP_THRESHOLD)
+        tar = mapFile(path);
+    auto archive = std::make_shared<Bootfiles>();
+    if (!(tar ? archive->extractFromData(std::move(tar)) : archive->extractFromFile(path.string()))) {
+        if (error)
+            *error = archive->lastError();
+        return nullptr;
+    }
+    qDebug() << "rpiboot: indexed" << archive->size() << "entries in" << path.string().c_str();
+
+    std::shared_ptr<const Bootfiles> shared = std::move(archive);
+    _bootfiles[path] = {stamp, shared};
+    return shared;
+}
+
+void SharedFileCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _files.clear();
+    _bootfiles.clear();
+}
+
+} // namespace rpiboot
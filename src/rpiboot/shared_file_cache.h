@@ -0,0 +1,79 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Process-wide read-only cache of rpiboot firmware contents.
+ *
+ * When several devices are booted at once (e.g. a hub full of Compute
+ * Modules), every session serves the same bootfiles.bin entries and
+ * start files.  This cache loads each file once and hands out shared,
+ * immutable buffers, so sessions neither re-read nor copy them.
+ *
+ * Files of MAP_THRESHOLD bytes or more (boot.img, start*.elf) are
+ * memory-mapped instead of read, so serving them does not hold a heap
+ * copy and pages come straight from the page cache.  Writers must replace
+ * these files by renaming a new file over them, never by rewriting them
+ * in place, or a live mapping would see the file change underneath it.
+ */
+
+#ifndef RPIBOOT_SHARED_FILE_CACHE_H
+#define RPIBOOT_SHARED_FILE_CACHE_H
+
+#include "bootfiles.h"
+#include "file_server.h"
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace rpiboot {
+
+class SharedFileCache {
+public:
+    static constexpr std::uintmax_t MAP_THRESHOLD = 1024 * 1024;
+
+    static SharedFileCache& instance();
+
+    // Contents of the file at `path`, or nullptr if it is missing or
+    // empty.  Reloaded when the file's size or modification time changes
+    // (e.g. after FirmwareManager re-signs it).
+    FileData file(const std::filesystem::path& path);
+
+    // The indexed bootfiles.bin archive at `path`, or nullptr on failure
+    // with the reason in `error`.  Same reload rule as file(), and the
+    // same memory mapping for large archives.
+    std::shared_ptr<const Bootfiles> bootfiles(const std::filesystem::path& path,
+                                               std::string* error = nullptr);
+
+    // Drop everything; buffers still held by sessions stay valid
+    void clear();
+
+    // A read-only mapping of the file at `path`, uncached, or nullptr if
+    // it cannot be mapped (always on Windows); callers then read it
+    static FileData mapFile(const std::filesystem::path& path);
+
+private:
+    struct Stamp {
+        std::uintmax_t size = 0;
+        std::filesystem::file_time_type mtime{};
+        bool operator==(const Stamp&) const = default;
+    };
+
+    template <typename T>
+    struct Entry {
+        Stamp stamp;
+        std::shared_ptr<const T> value;
+    };
+
+    static bool stampOf(const std::filesystem::path& path, Stamp& stamp);
+
+    std::mutex _mutex;
+    std::map<std::filesystem::path, std::pair<Stamp, FileData>> _files;
+    std::map<std::filesystem::path, Entry<Bootfiles>> _bootfiles;
+};
+
+} // namespace rpiboot
+
+#endif // RPIBOOT_SHARED_FILE_CACHE_H
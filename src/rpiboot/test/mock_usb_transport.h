@@ -47,6 +47,9 @@ public:
     // Configure a simulated failure on the next N control transfers
     void failNextControlTransfers(int count) { _failControlCount = count; }
 
+    // Link speed reported to the protocol
+    void setSpeed(UsbSpeed speed) { _speed = speed; }
+
     // ── Captured output ────────────────────────────────────────────────
 
     const std::vector<std::vector<uint8_t>>& capturedBulkWrites() const
@@ -127,8 +130,11 @@ public:
 
     bool isOpen() const override { return _isOpen; }
 
+    UsbSpeed speed() const override { return _speed; }
+
 private:
     bool _isOpen = true;
+    UsbSpeed _speed = UsbSpeed::Unknown;
     int _failBulkWriteCount = 0;
     int _failControlCount = 0;
     std::deque<std::vector<uint8_t>> _bulkReadQueue;
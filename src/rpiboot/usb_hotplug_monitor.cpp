@@ -0,0 +1,136 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "usb_hotplug_monitor.h"
+#include "libusb_transport.h"
+#include "rpiboot_types.h"
+
+#include <libusb.h>
+#include <chrono>
+#include <stdexcept>
+#include <QDebug>
+
+namespace rpiboot {
+
+// Bridges the C callback to the monitor's private notify()
+class HotplugCallback {
+public:
+    static int LIBUSB_CALL fn(libusb_context*, libusb_device*,
+                              libusb_hotplug_event, void* userData)
+    {
+        static_cast<UsbHotplugMonitor*>(userData)->notify();
+        return 0;  // Stay registered
+    }
+};
+
+UsbHotplugMonitor::UsbHotplugMonitor(std::function<void()> onChange)
+    : _onChange(std::move(onChange))
+{
+}
+
+UsbHotplugMonitor::~UsbHotplugMonitor()
+{
+    stop();
+}
+
+bool UsbHotplugMonitor::start()
+{
+    if (active())
+        return true;
+
+    // libusb's Windows backend has no hotplug support; this check is how
+    // that (and libusb builds without it) fall back to polling
+    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+        return false;
+
+    try {
+        _ctx = std::make_unique<LibusbContext>();
+    } catch (const std::runtime_error& e) {
+        qWarning() << "UsbHotplugMonitor:" << e.what();
+        return false;
+    }
+
+    const auto events = static_cast<libusb_hotplug_event>(
+        LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT);
+    const int vendors[] = {BROADCOM_VID, FASTBOOT_VID};
+    _handleCount = 0;
+    for (int vendor : vendors) {
+        libusb_hotplug_callback_handle handle = 0;
+        int rc = libusb_hotplug_register_callback(
+            _ctx->raw(), events, LIBUSB_HOTPLUG_NO_FLAGS, vendor,
+            LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+            &HotplugCallback::fn, this, &handle);
+        if (rc != LIBUSB_SUCCESS) {
+            qWarning() << "UsbHotplugMonitor: registering callback failed:"
+                       << libusb_strerror(static_cast<libusb_error>(rc));
+            for (int i = 0; i < _handleCount; ++i)
+                libusb_hotplug_deregister_callback(_ctx->raw(), _handles[i]);
+            _handleCount = 0;
+            _ctx.reset();
+            return false;
+        }
+        _handles[_handleCount++] = handle;
+    }
+
+    _stop.store(false);
+    _thread = std::thread(&UsbHotplugMonitor::eventLoop, this);
+    return true;
+}
+
+void UsbHotplugMonitor::stop()
+{
+    if (!active())
+        return;
+
+    _stop.store(true);
+    // Deregistering wakes the event thread out of libusb_handle_events
+    for (int i = 0; i < _handleCount; ++i)
+        libusb_hotplug_deregister_callback(_ctx->raw(), _handles[i]);
+    _handleCount = 0;
+    _thread.join();
+    _ctx.reset();
+}
+
+void UsbHotplugMonitor::eventLoop()
+{
+    // The timeout bounds how long stop() waits if the wake-up is missed
+    timeval tv{0, 100 * 1000};
+    while (!_stop.load()) {
+        int rc = libusb_handle_events_timeout_completed(_ctx->raw(), &tv, nullptr);
+        if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED && rc != LIBUSB_ERROR_TIMEOUT) {
+            qWarning() << "UsbHotplugMonitor: handling events failed:"
+                       << libusb_strerror(static_cast<libusb_error>(rc));
+            break;
+        }
+    }
+}
+
+void UsbHotplugMonitor::notify()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_generation;
+    }
+    _changed.notify_all();
+    if (_onChange)
+        _onChange();
+}
+
+bool UsbHotplugMonitor::waitForChange(int timeoutMs)
+{
+    if (!active()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _changed.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                      [this] { return _generation != _seenGeneration; });
+    const bool changed = _generation != _seenGeneration;
+    _seenGeneration = _generation;
+    return changed;
+}
+
+} // namespace rpiboot
@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * libusb hotplug notifications for rpiboot and fastboot devices.
+ * Lets callers rescan the bus as soon as a Compute Module enumerates or
+ * drops off, instead of polling it every 500 ms.
+ */
+
+#ifndef RPIBOOT_USB_HOTPLUG_MONITOR_H
+#define RPIBOOT_USB_HOTPLUG_MONITOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace rpiboot {
+
+class LibusbContext;
+
+// Reports arrivals and departures of Broadcom boot-mode and fastboot
+// devices.  Notifications only say that *something* changed; callers
+// rescan with LibusbContext::scanBootDevices()/scanFastbootDevices().
+//
+// Where libusb has no hotplug support (its Windows backend, or a build
+// without it) start() returns false and waitForChange() degrades to a
+// plain sleep, so a wait-then-rescan loop polls as before.
+class UsbHotplugMonitor {
+public:
+    // onChange, if set, is called on the monitor's event thread and must
+    // be cheap and thread-safe.
+    explicit UsbHotplugMonitor(std::function<void()> onChange = {});
+    ~UsbHotplugMonitor();
+
+    UsbHotplugMonitor(const UsbHotplugMonitor&) = delete;
+    UsbHotplugMonitor& operator=(const UsbHotplugMonitor&) = delete;
+
+    // Start delivering notifications.  Returns false if hotplug events
+    // are unavailable; callers should then rely on polling.
+    bool start();
+
+    // Stop delivering notifications.  After this returns the callback is
+    // no longer running.  Also called by the destructor.
+    void stop();
+
+    bool active() const { return _thread.joinable(); }
+
+    // Block until a device arrives or leaves, or timeoutMs passes.  Returns
+    // true if something changed since the previous call.  Without hotplug
+    // support this sleeps for timeoutMs and returns false.
+    bool waitForChange(int timeoutMs);
+
+    // How long a wait-then-rescan loop should wait before rescanning
+    // anyway: long with hotplug events (a safety net for a missed one),
+    // the old 500 ms poll without them.
+    int rescanIntervalMs() const { return active() ? HOTPLUG_RESCAN_MS : POLL_INTERVAL_MS; }
+
+    static constexpr int POLL_INTERVAL_MS = 500;
+    static constexpr int HOTPLUG_RESCAN_MS = 1000;
+
+private:
+    friend class HotplugCallback;
+
+    void notify();
+    void eventLoop();
+
+    std::function<void()> _onChange;
+    std::unique_ptr<LibusbContext> _ctx;
+    std::thread _thread;
+    std::atomic<bool> _stop{false};
+    int _handles[2] = {0, 0};
+    int _handleCount = 0;
+
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    uint64_t _generation = 0;
+    uint64_t _seenGeneration = 0;
+};
+
+} // namespace rpiboot
+
+#endif // RPIBOOT_USB_HOTPLUG_MONITOR_H
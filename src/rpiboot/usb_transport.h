@@ -9,11 +9,19 @@
 #ifndef RPIBOOT_USB_TRANSPORT_H
 #define RPIBOOT_USB_TRANSPORT_H
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <span>
 
+#include "rpiboot_types.h"
+
 namespace rpiboot {
 
+// Reports the number of contiguous bytes transferred so far
+using BulkProgressFn = std::function<void(size_t transferred)>;
+
 class IUsbTransport {
 public:
     virtual ~IUsbTransport() = default;
@@ -42,9 +50,64 @@ public:
                          std::span<uint8_t> buffer,
                          int timeoutMs) = 0;
 
+    // Bulk OUT of an entire payload, split into `chunkSize` transfers with
+    // `chunkTimeoutMs` each.  Implementations may keep several transfers in
+    // flight; this default issues them one at a time via bulkWrite().
+    // Returns the number of bytes written (data.size() on success) or a
+    // negative error.  Stops with an error when `cancelled` is set.
+    virtual int64_t bulkWriteStream(uint8_t endpoint,
+                                    std::span<const uint8_t> data,
+                                    size_t chunkSize, int chunkTimeoutMs,
+                                    const std::atomic<bool>& cancelled,
+                                    const BulkProgressFn& progress = {})
+    {
+        size_t offset = 0;
+        while (offset < data.size()) {
+            if (cancelled.load())
+                return -1;
+            auto chunk = data.subspan(offset, std::min(chunkSize, data.size() - offset));
+            int written = bulkWrite(endpoint, chunk, chunkTimeoutMs);
+            if (written <= 0)
+                return written < 0 ? written : -1;
+            offset += static_cast<size_t>(written);
+            if (progress)
+                progress(offset);
+        }
+        return static_cast<int64_t>(offset);
+    }
+
+    // Bulk IN into `buffer`, split into `chunkSize` transfers.  Ends early
+    // at a short transfer (the device sent less than was asked for).
+    // Returns the number of bytes read or a negative error.
+    virtual int64_t bulkReadStream(uint8_t endpoint,
+                                   std::span<uint8_t> buffer,
+                                   size_t chunkSize, int chunkTimeoutMs,
+                                   const std::atomic<bool>& cancelled,
+                                   const BulkProgressFn& progress = {})
+    {
+        size_t offset = 0;
+        while (offset < buffer.size()) {
+            if (cancelled.load())
+                return -1;
+            const size_t toRead = std::min(chunkSize, buffer.size() - offset);
+            int got = bulkRead(endpoint, buffer.subspan(offset, toRead), chunkTimeoutMs);
+            if (got < 0)
+                return got;
+            offset += static_cast<size_t>(got);
+            if (progress)
+                progress(offset);
+            if (static_cast<size_t>(got) < toRead)
+                break;
+        }
+        return static_cast<int64_t>(offset);
+    }
+
     // True if the underlying device handle is still valid
     virtual bool isOpen() const = 0;
 
+    // Negotiated link speed, for sizing stream transfers (bulkChunkSizeFor())
+    virtual UsbSpeed speed() const { return UsbSpeed::Unknown; }
+
     // Bulk OUT endpoint address (e.g. 0x01).  Determined from the device's
     // active configuration descriptor; falls back to EP 1 if unknown.
     virtual uint8_t outEndpoint() const { return 0x01; }
@@ -0,0 +1,176 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "rpibootscheduler.h"
+#include "rpiboot/libusb_transport.h"
+
+#include <QDebug>
+
+#include <stdexcept>
+
+RpibootScheduler::RpibootScheduler(rpiboot::SideloadMode mode, QObject *parent)
+    : QObject(parent), _mode(mode)
+{
+}
+
+RpibootScheduler::~RpibootScheduler()
+{
+    cancelAll();
+    // RpibootThread's destructor cancels and waits for its own thread
+    for (auto &entry : _entries)
+        delete entry.thread;
+}
+
+QString RpibootScheduler::portPathKey(const std::vector<uint8_t> &portPath)
+{
+    QString key;
+    for (size_t i = 0; i < portPath.size(); ++i) {
+        if (i > 0) key += '.';
+        key += QString::number(portPath[i]);
+    }
+    return key;
+}
+
+void RpibootScheduler::setMaxConcurrent(int max)
+{
+    _maxConcurrent = max < 0 ? 0 : max;
+    startPending();
+}
+
+bool RpibootScheduler::enqueue(const RpibootThread::DeviceInfo &device)
+{
+    const QString key = portPathKey(device.portPath);
+    if (_entries.contains(key))
+        return false;
+
+    Entry entry;
+    entry.device = device;
+    _entries.insert(key, entry);
+    _pending.append(key);
+    qDebug() << "RpibootScheduler: queued" << key;
+
+    startPending();
+    emitProgress();
+    return true;
+}
+
+int RpibootScheduler::enqueueAllDetected()
+{
+    std::vector<rpiboot::UsbDeviceInfo> found;
+    try {
+        rpiboot::LibusbContext ctx;
+        found = ctx.scanBootDevices();
+    } catch (const std::runtime_error &e) {
+        qWarning() << "RpibootScheduler: USB scan failed:" << e.what();
+        return 0;
+    }
+
+    int queued = 0;
+    for (const auto &usb : found) {
+        RpibootThread::DeviceInfo device;
+        device.busNumber = usb.busNumber;
+        device.deviceAddress = usb.deviceAddress;
+        device.productId = usb.productId;
+        device.portPath = usb.portPath;
+        device.chipGeneration = usb.chipGeneration;
+        if (enqueue(device))
+            ++queued;
+    }
+    return queued;
+}
+
+void RpibootScheduler::cancelAll()
+{
+    _pending.clear();
+    for (auto &entry : _entries) {
+        if (entry.thread)
+            entry.thread->cancel();
+    }
+}
+
+void RpibootScheduler::startPending()
+{
+    while (!_pending.isEmpty() && (_maxConcurrent == 0 || _running < _maxConcurrent)) {
+        const QString key = _pending.takeFirst();
+        auto it = _entries.find(key);
+        if (it == _entries.end())
+            continue;
+
+        auto *thread = new RpibootThread(it->device, _mode);
+        if (!_customFastbootGadget.isEmpty())
+            thread->setCustomFastbootGadget(_customFastbootGadget);
+        if (!_signFastbootGadgetKey.isEmpty())
+            thread->setSignFastbootGadgetKey(_signFastbootGadgetKey);
+
+        connect(thread, &RpibootThread::fastbootDeviceReady, this,
+                [this, key](const QString &fastbootId) { finish(key, true, fastbootId); });
+        connect(thread, &RpibootThread::error, this,
+                [this, key](const QString &msg) { finish(key, false, msg); });
+        connect(thread, &RpibootThread::progressChanged, this,
+                [this, key](quint64 current, quint64 total) { onDeviceProgress(key, current, total); });
+        connect(thread, &RpibootThread::preparationStatusUpdate, this, &RpibootScheduler::preparationStatusUpdate);
+
+        it->thread = thread;
+        ++_running;
+        qDebug() << "RpibootScheduler: starting" << key << "(" << _running << "running)";
+        emit deviceStarted(key);
+        thread->start();
+    }
+}
+
+void RpibootScheduler::onDeviceProgress(const QString &key, quint64 current, quint64 total)
+{
+    auto it = _entries.find(key);
+    if (it == _entries.end() || total == 0)
+        return;
+
+    // Firmware setup is the only phase with byte progress; cap below 1000
+    // so a device only counts as done once it has reached fastboot
+    it->permille = qMin<quint64>(999, current * 1000 / total);
+    emitProgress();
+}
+
+void RpibootScheduler::finish(const QString &key, bool ok, const QString &detail)
+{
+    auto it = _entries.find(key);
+    if (it == _entries.end())
+        return;
+
+    if (it->thread) {
+        it->thread->deleteLater();
+        --_running;
+    }
+    _entries.erase(it);
+
+    if (ok) {
+        ++_succeeded;
+        qDebug() << "RpibootScheduler:" << key << "ready as" << detail;
+        emit deviceReady(key, detail);
+    } else {
+        ++_failed;
+        qWarning() << "RpibootScheduler:" << key << "failed:" << detail;
+        emit deviceFailed(key, detail);
+    }
+
+    emitProgress();
+    startPending();
+
+    if (_entries.isEmpty()) {
+        const int succeeded = _succeeded;
+        const int failed = _failed;
+        _succeeded = 0;
+        _failed = 0;
+        emit allFinished(succeeded, failed);
+    }
+}
+
+void RpibootScheduler::emitProgress()
+{
+    const quint64 finished = static_cast<quint64>(_succeeded + _failed);
+    quint64 current = finished * 1000;
+    for (const auto &entry : _entries)
+        current += entry.permille;
+    emit aggregateProgress(current, (finished + static_cast<quint64>(_entries.size())) * 1000);
+}
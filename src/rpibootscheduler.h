@@ -0,0 +1,93 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Runs rpiboot for several devices at once from one process.
+ */
+
+#ifndef RPIBOOTSCHEDULER_H
+#define RPIBOOTSCHEDULER_H
+
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include "rpibootthread.h"
+
+/**
+ * @brief Boots every queued rpiboot device on its own RpibootThread
+ *
+ * Devices are keyed by USB port path, so a device that re-enumerates
+ * during boot is not queued a second time. Firmware and boot files are
+ * shared between the threads through FirmwareManager's serialised cache
+ * and rpiboot::SharedFileCache, so N devices cost one download and one
+ * read of each file.
+ *
+ * Progress is reported as an aggregate over all devices started since the
+ * scheduler was last idle, on a scale of 1000 per device.
+ */
+class RpibootScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RpibootScheduler(rpiboot::SideloadMode mode, QObject *parent = nullptr);
+    ~RpibootScheduler() override;
+
+    static QString portPathKey(const std::vector<uint8_t> &portPath);
+
+    void setMode(rpiboot::SideloadMode mode) { _mode = mode; }
+    void setCustomFastbootGadget(const QString &path) { _customFastbootGadget = path; }
+    void setSignFastbootGadgetKey(const QString &keyPath) { _signFastbootGadgetKey = keyPath; }
+
+    // Limit on devices booting at the same time; 0 means no limit
+    void setMaxConcurrent(int max);
+
+    // Queue a device; returns false if it is already queued or booting
+    bool enqueue(const RpibootThread::DeviceInfo &device);
+
+    // Scan the bus and queue every device in USB boot mode; returns the
+    // number of devices newly queued
+    int enqueueAllDetected();
+
+    bool contains(const QString &key) const { return _entries.contains(key); }
+    bool isIdle() const { return _entries.isEmpty(); }
+    int activeCount() const { return _running; }
+
+    void cancelAll();
+
+signals:
+    void deviceStarted(const QString &key);
+    void deviceReady(const QString &key, const QString &fastbootId);
+    void deviceFailed(const QString &key, const QString &msg);
+    void preparationStatusUpdate(const QString &msg);
+    void aggregateProgress(quint64 current, quint64 total);
+    void allFinished(int succeeded, int failed);
+
+private:
+    struct Entry {
+        RpibootThread::DeviceInfo device;
+        RpibootThread *thread = nullptr;
+        quint64 permille = 0;
+    };
+
+    void startPending();
+    void onDeviceProgress(const QString &key, quint64 current, quint64 total);
+    void finish(const QString &key, bool ok, const QString &detail);
+    void emitProgress();
+
+    rpiboot::SideloadMode _mode;
+    QString _customFastbootGadget;
+    QString _signFastbootGadgetKey;
+    int _maxConcurrent = 0;
+
+    QMap<QString, Entry> _entries;
+    QStringList _pending;
+    int _running = 0;
+
+    // Totals for the current batch, reset once the scheduler goes idle
+    int _succeeded = 0;
+    int _failed = 0;
+};
+
+#endif // RPIBOOTSCHEDULER_H
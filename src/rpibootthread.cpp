@@ -7,11 +7,13 @@
 #include "rpiboot/libusb_transport.h"
 #include "rpiboot/rpiboot_protocol.h"
 #include "rpiboot/firmware_manager.h"
+#include "rpiboot/usb_hotplug_monitor.h"
 
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QThread>
 
+#include <algorithm>
 #include <thread>
 
 RpibootThread::RpibootThread(const DeviceInfo& device,
@@ -78,6 +80,8 @@ void RpibootThread::run()
     phaseTimer.restart();
 
     RpibootProtocol protocol;
+    for (const auto& [name, data] : fwMgr.memoryFiles())
+        protocol.setFileOverride(name, data);
     auto progressCb = [this](uint64_t current, uint64_t total, const std::string& status) {
         emit preparationStatusUpdate(QString::fromStdString(status));
         emit progressChanged(current, total);
@@ -321,18 +325,28 @@ bool RpibootThread::waitForBootDeviceReEnum(rpiboot::UsbDeviceInfo& outDevice)
     };
 
     // Create a single libusb context for the entire polling sequence to
-    // avoid the overhead of libusb_init/libusb_exit on every 500ms poll.
+    // avoid the overhead of libusb_init/libusb_exit on every rescan.  The
+    // bus is rescanned as soon as a boot device arrives or leaves, or every
+    // 500 ms where libusb has no hotplug events (Windows).
     LibusbContext pollCtx;
+    UsbHotplugMonitor monitor;
+    monitor.start();
+    QElapsedTimer waited;
+    auto waitForChange = [&](int timeoutMs) {
+        monitor.waitForChange(static_cast<int>(std::clamp<qint64>(
+            timeoutMs - waited.elapsed(), 0, monitor.rescanIntervalMs())));
+    };
 
     // Phase 1: Wait for the device to disconnect from the bus (up to 3s).
     // For chips that don't re-enumerate (BCM2835), this times out
     // harmlessly and we find the device immediately in phase 2.
-    constexpr int DISCONNECT_POLLS = 6;
-    for (int i = 0; i < DISCONNECT_POLLS; ++i) {
+    constexpr int DISCONNECT_TIMEOUT_MS = 3000;
+    waited.start();
+    while (waited.elapsed() < DISCONNECT_TIMEOUT_MS) {
         if (_cancelled.load()) return false;
         emit preparationStatusUpdate(tr("Waiting for device to disconnect (%1/%2)...")
-                                         .arg(i + 1).arg(DISCONNECT_POLLS));
-        QThread::msleep(500);
+                                         .arg(waited.elapsed() / 1000 + 1).arg(DISCONNECT_TIMEOUT_MS / 1000));
+        waitForChange(DISCONNECT_TIMEOUT_MS);
 
         try {
             auto devices = pollCtx.scanBootDevices();
@@ -360,12 +374,13 @@ bool RpibootThread::waitForBootDeviceReEnum(rpiboot::UsbDeviceInfo& outDevice)
 
     // Phase 2: Wait for a Broadcom boot device to appear on the same
     // physical port (up to 15s).
-    constexpr int RECONNECT_POLLS = 30;
-    for (int i = 0; i < RECONNECT_POLLS; ++i) {
+    constexpr int RECONNECT_TIMEOUT_MS = 15000;
+    waited.restart();
+    while (waited.elapsed() < RECONNECT_TIMEOUT_MS) {
         if (_cancelled.load()) return false;
 
         emit preparationStatusUpdate(tr("Waiting for device to reconnect (%1/%2s)...")
-                                         .arg((i + 1) / 2).arg(RECONNECT_POLLS / 2));
+                                         .arg(waited.elapsed() / 1000).arg(RECONNECT_TIMEOUT_MS / 1000));
 
         try {
             auto devices = pollCtx.scanBootDevices();
@@ -388,11 +403,11 @@ bool RpibootThread::waitForBootDeviceReEnum(rpiboot::UsbDeviceInfo& outDevice)
             qWarning() << "rpiboot: USB scan failed during reconnect wait:" << e.what();
         }
 
-        QThread::msleep(500);
+        waitForChange(RECONNECT_TIMEOUT_MS);
     }
 
     emit error(tr("Timed out waiting for device to re-enumerate after bootcode upload (waited %1s).")
-               .arg(RECONNECT_POLLS / 2));
+               .arg(RECONNECT_TIMEOUT_MS / 1000));
     return false;
 }
 
@@ -402,14 +417,19 @@ bool RpibootThread::pollForFastbootDevice(std::atomic<bool>& found, QString& fas
 
     // Poll for a fastboot device on the same physical USB port.
     // Sets `found` to true and writes the bus:addr string to `fastbootId`.
-    // Respects _cancelled for clean shutdown.
+    // Respects _cancelled for clean shutdown.  Rescans as soon as a
+    // fastboot device enumerates, or every 500 ms without hotplug events.
     LibusbContext pollCtx;
+    UsbHotplugMonitor monitor;
+    monitor.start();
 
-    constexpr int FB_POLLS = 120;  // 60s — device may take 20s+ to reboot into fastboot
-    for (int attempt = 0; attempt < FB_POLLS; ++attempt) {
+    constexpr int FB_TIMEOUT_MS = 60000;  // device may take 20s+ to reboot into fastboot
+    QElapsedTimer waited;
+    waited.start();
+    while (waited.elapsed() < FB_TIMEOUT_MS) {
         if (_cancelled.load()) return false;
 
-        QThread::msleep(500);
+        monitor.waitForChange(monitor.rescanIntervalMs());
 
         try {
             auto devices = pollCtx.scanFastbootDevices();
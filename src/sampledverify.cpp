@@ -0,0 +1,96 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "sampledverify.h"
+#include <algorithm>
+#include <cmath>
+#include <zlib.h>
+
+namespace {
+
+// splitmix64: a cheap, well mixed hash of the block index
+std::uint64_t mix(std::uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+quint32 crcOf(const char *data, size_t len, quint32 crc)
+{
+    // crc32() takes a 32-bit length
+    while (len > 0)
+    {
+        const uInt n = static_cast<uInt>(std::min<size_t>(len, 1u << 30));
+        crc = static_cast<quint32>(crc32(crc, reinterpret_cast<const Bytef *>(data), n));
+        data += n;
+        len -= n;
+    }
+    return crc;
+}
+
+} // namespace
+
+SampledVerify::SampledVerify(double coveragePercent, std::uint64_t seed)
+    : _seed(seed)
+{
+    const double share = std::clamp(coveragePercent, 0.0, 100.0) / 100.0;
+    _threshold = static_cast<std::uint64_t>(std::llround(share * 4294967296.0));
+}
+
+void SampledVerify::addRequiredRange(std::uint64_t offset, std::uint64_t length)
+{
+    if (length)
+        _required.emplace_back(offset, offset + length);
+}
+
+bool SampledVerify::isSampled(std::uint64_t blockIndex) const
+{
+    if ((blockIndex & (blockIndex - 1)) == 0)
+        return true;
+
+    const std::uint64_t start = blockIndex * kBlockSize;
+    const std::uint64_t end = start + kBlockSize;
+    for (const auto &range : _required)
+    {
+        if (range.first < end && start < range.second)
+            return true;
+    }
+
+    return (mix(_seed ^ blockIndex) & 0xFFFFFFFFu) < _threshold;
+}
+
+void SampledVerify::addData(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        const std::uint64_t fill = _size % kBlockSize;
+        if (fill == 0)
+        {
+            _current = isSampled(_size / kBlockSize);
+            _crc = static_cast<quint32>(crc32(0L, Z_NULL, 0));
+        }
+
+        const size_t n = static_cast<size_t>(std::min<std::uint64_t>(len, kBlockSize - fill));
+        if (_current)
+            _crc = crcOf(data, n, _crc);
+        _size += n;
+        data += n;
+        len -= n;
+
+        if (_current && _size % kBlockSize == 0)
+            _blocks.push_back(Block{_size - kBlockSize, static_cast<std::uint32_t>(kBlockSize), _crc});
+    }
+}
+
+std::vector<SampledVerify::Block> SampledVerify::blocks() const
+{
+    std::vector<Block> result = _blocks;
+    const std::uint64_t fill = _size % kBlockSize;
+    if (_current && fill)
+        result.push_back(Block{_size - fill, static_cast<std::uint32_t>(fill), _crc});
+    return result;
+}
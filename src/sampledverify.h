@@ -0,0 +1,81 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef SAMPLEDVERIFY_H
+#define SAMPLEDVERIFY_H
+
+#include <QtGlobal>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Checksums of a sample of the image, for a quick read-back check
+ *
+ * A full verify reads back the whole image. For bulk provisioning, where
+ * the OS is also checked at first boot, reading back a sample catches the
+ * usual failures in a fraction of the time: writes that did not reach the
+ * card, and fake-capacity cards that wrap writes past their real size
+ * around onto earlier data.
+ *
+ * The image is cut into kBlockSize blocks. A block is sampled if:
+ *  - it overlaps a required range (e.g. the boot partition), or
+ *  - its index is a power of two (or 0), so there is a block at every
+ *    power-of-two capacity a fake card might really have, or
+ *  - a hash of the seed and its index falls within the coverage
+ *    percentage, which spreads the rest of the sample evenly and
+ *    deterministically over the image.
+ *
+ * The data is fed in stream order from offset 0, as it is written, and a
+ * CRC32 of each sampled block is kept for reading back against later.
+ * The stream must match the device contiguously (no block map, no plain
+ * zero skipping).
+ *
+ * addData() runs on the hash thread; required ranges must be added before
+ * the data reaches them, and blocks() only read once hashing is done.
+ */
+class SampledVerify
+{
+public:
+    static constexpr std::uint64_t kBlockSize = 1024 * 1024;
+
+    struct Block {
+        std::uint64_t offset;
+        std::uint32_t length;  // Less than kBlockSize only at the end of the image
+        quint32 crc;
+    };
+
+    /**
+     * @param coveragePercent Share of the other blocks to sample, 0-100
+     * @param seed Picks which blocks; the same seed picks the same ones
+     */
+    explicit SampledVerify(double coveragePercent, std::uint64_t seed = 0);
+
+    // Always checked in full
+    void addRequiredRange(std::uint64_t offset, std::uint64_t length);
+
+    bool isSampled(std::uint64_t blockIndex) const;
+
+    // Feed the image data, in order from offset 0
+    void addData(const char *data, size_t len);
+
+    // The sampled blocks fed so far, including a sampled partial last block
+    std::vector<Block> blocks() const;
+
+    // Bytes fed so far
+    std::uint64_t size() const { return _size; }
+
+private:
+    std::uint64_t _threshold;  // Out of 2^32
+    std::uint64_t _seed;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> _required;  // [start, end)
+    std::vector<Block> _blocks;
+    std::uint64_t _size = 0;
+    quint32 _crc = 0;          // Of the block being fed, if it is sampled
+    bool _current = false;     // Whether the block being fed is sampled
+};
+
+#endif // SAMPLEDVERIFY_H
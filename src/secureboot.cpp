@@ -12,12 +12,13 @@
 #include <QDebug>
 #include <QDateTime>
 #include <QProcess>
-#include <QTemporaryDir>
 #include <QTextStream>
 #include <QFileInfo>
 #include <QDir>
 #include <QThread>
 #include <QSet>
+#include <QHash>
+#include <QMutex>
 #include <ctime>
 
 #ifdef __APPLE__
@@ -32,6 +33,59 @@
 #include <QCryptographicHash>
 #endif
 
+namespace {
+
+/*
+ * Signatures and public keys are cached per key file, for batches of
+ * devices. The size and modification time are part of the cache key, so
+ * a key file that is replaced is read again.
+ */
+constexpr int kMaxCachedSignatures = 64;
+
+QMutex cacheMutex;
+QHash<QByteArray, QByteArray> signatureCache;  // key id + digest -> hex signature
+QHash<QByteArray, QByteArray> pubkeyCache;     // key id -> pubkey.bin
+
+QByteArray keyCacheId(const QString &rsaKeyPath)
+{
+    QFileInfo info(rsaKeyPath);
+    if (!info.isFile())
+        return {};
+    return info.canonicalFilePath().toUtf8() + '\n'
+         + QByteArray::number(info.size()) + '\n'
+         + QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+}
+
+/*
+ * Signature file for a SHA-256 digest, in the format of rpi-eeprom-digest:
+ * hex sha256, "ts: <epoch>", "rsa2048: <hex sig>", separated by newlines
+ */
+QByteArray signatureFile(const QByteArray &digest, const QString &rsaKeyPath)
+{
+    if (digest.size() != 32) {
+        qDebug() << "SecureBoot: invalid digest size:" << digest.size();
+        return {};
+    }
+
+    // rsaSign wraps the raw digest in a DigestInfo structure
+    QByteArray sigHex = SecureBoot::rsaSign(digest, rsaKeyPath);
+    if (sigHex.isEmpty())
+        return {};
+
+    QByteArray sig;
+    sig.append(digest.toHex());
+    sig.append('\n');
+    sig.append("ts: ");
+    sig.append(QByteArray::number(SecureBoot::getCurrentTimestamp()));
+    sig.append('\n');
+    sig.append("rsa2048: ");
+    sig.append(sigHex);
+    sig.append('\n');
+    return sig;
+}
+
+} // namespace
+
 SecureBoot::SecureBoot()
 {
 }
@@ -86,11 +140,11 @@ QMap<QString, QByteArray> SecureBoot::extractFatPartitionFiles(DeviceWrapperFatP
     return files;
 }
 
-bool SecureBoot::createBootImg(const QMap<QString, QByteArray> &files, const QString &outputPath)
+QByteArray SecureBoot::createBootImg(const QMap<QString, QByteArray> &files)
 {
     if (files.isEmpty()) {
         qDebug() << "SecureBoot::createBootImg: no files to pack";
-        return false;
+        return QByteArray();
     }
 
     // Calculate required size for FAT32 image (with overhead)
@@ -109,8 +163,24 @@ bool SecureBoot::createBootImg(const QMap<QString, QByteArray> &files, const QSt
 
     qDebug() << "SecureBoot: creating boot.img of size" << imgSize << "bytes for" << files.size() << "files";
     
-    // Delegate to platform-specific helper
-    return BootImgCreator::createBootImg(files, outputPath, imgSize);
+    return BootImgCreator::createBootImg(files, imgSize);
+}
+
+bool SecureBoot::createBootImg(const QMap<QString, QByteArray> &files, const QString &outputPath)
+{
+    QByteArray image = createBootImg(files);
+    if (image.isEmpty()) {
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(outputPath).absolutePath());
+    QFile imgFile(outputPath);
+    if (!imgFile.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || imgFile.write(image) != image.size()) {
+        qDebug() << "SecureBoot::createBootImg: failed to write" << outputPath;
+        return false;
+    }
+    return true;
 }
 
 QByteArray SecureBoot::sha256File(const QString &filePath)
@@ -133,15 +203,27 @@ QByteArray SecureBoot::sha256File(const QString &filePath)
     return hash.result().toHex();
 }
 
-QByteArray SecureBoot::rsaSign(const QByteArray &data, const QString &rsaKeyPath)
-{
 #ifdef __APPLE__
-    // On macOS, use Security framework (modern API with SecKeyCreateSignature)
+// Imports the PEM private key, keeping the last one imported.  Returns a
+// retained key, or nullptr on error
+static SecKeyRef importPrivateKey(const QString &rsaKeyPath, const QByteArray &keyId)
+{
+    static SecKeyRef cachedKey = nullptr;
+    static QByteArray cachedKeyId;
+
+    if (!keyId.isEmpty()) {
+        QMutexLocker lock(&cacheMutex);
+        if (cachedKey && cachedKeyId == keyId) {
+            CFRetain(cachedKey);
+            return cachedKey;
+        }
+    }
+
     // Read the PEM key file
     QFile keyFile(rsaKeyPath);
     if (!keyFile.open(QIODevice::ReadOnly)) {
         qDebug() << "SecureBoot::rsaSign: failed to open key file" << rsaKeyPath;
-        return QByteArray();
+        return nullptr;
     }
     QByteArray pemData = keyFile.readAll();
     keyFile.close();
@@ -150,7 +232,7 @@ QByteArray SecureBoot::rsaSign(const QByteArray &data, const QString &rsaKeyPath
     CFDataRef keyData = CFDataCreate(nullptr, reinterpret_cast<const UInt8*>(pemData.constData()), pemData.size());
     if (!keyData) {
         qDebug() << "SecureBoot::rsaSign: failed to create CFData from key";
-        return QByteArray();
+        return nullptr;
     }
 
     // Set import parameters
@@ -168,13 +250,34 @@ QByteArray SecureBoot::rsaSign(const QByteArray &data, const QString &rsaKeyPath
     if (status != errSecSuccess || !items || CFArrayGetCount(items) == 0) {
         qDebug() << "SecureBoot::rsaSign: failed to import private key, status:" << status;
         if (items) CFRelease(items);
-        return QByteArray();
+        return nullptr;
     }
 
     SecKeyRef privateKey = (SecKeyRef)CFArrayGetValueAtIndex(items, 0);
     CFRetain(privateKey); // Retain before releasing the array
     CFRelease(items);
 
+    if (!keyId.isEmpty()) {
+        QMutexLocker lock(&cacheMutex);
+        if (cachedKey)
+            CFRelease(cachedKey);
+        CFRetain(privateKey);
+        cachedKey = privateKey;
+        cachedKeyId = keyId;
+    }
+    return privateKey;
+}
+#endif
+
+static QByteArray rsaSignUncached(const QByteArray &data, const QString &rsaKeyPath, const QByteArray &keyId)
+{
+#ifdef __APPLE__
+    // On macOS, use Security framework (modern API with SecKeyCreateSignature)
+    SecKeyRef privateKey = importPrivateKey(rsaKeyPath, keyId);
+    if (!privateKey) {
+        return QByteArray();
+    }
+
     // Create CFData from the data to sign
     CFDataRef dataToSign = CFDataCreate(nullptr, reinterpret_cast<const UInt8*>(data.constData()), data.size());
     if (!dataToSign) {
@@ -214,6 +317,8 @@ QByteArray SecureBoot::rsaSign(const QByteArray &data, const QString &rsaKeyPath
     
     return result.toHex();
 #else
+    Q_UNUSED(keyId);
+
     // On Linux/Windows, use openssl rsautl to sign the pre-computed digest
     // We need to wrap the 32-byte SHA-256 digest in PKCS#1 DigestInfo DER structure
     QByteArray derWrapped;
@@ -260,6 +365,29 @@ QByteArray SecureBoot::rsaSign(const QByteArray &data, const QString &rsaKeyPath
 #endif
 }
 
+QByteArray SecureBoot::rsaSign(const QByteArray &data, const QString &rsaKeyPath)
+{
+    const QByteArray keyId = keyCacheId(rsaKeyPath);
+    const QByteArray cacheKey = keyId.isEmpty() ? QByteArray() : keyId + '\n' + data;
+    if (!cacheKey.isEmpty()) {
+        QMutexLocker lock(&cacheMutex);
+        auto it = signatureCache.constFind(cacheKey);
+        if (it != signatureCache.constEnd()) {
+            return it.value();
+        }
+    }
+
+    QByteArray signature = rsaSignUncached(data, rsaKeyPath, keyId);
+    if (!signature.isEmpty() && !cacheKey.isEmpty()) {
+        QMutexLocker lock(&cacheMutex);
+        if (signatureCache.size() >= kMaxCachedSignatures) {
+            signatureCache.clear();
+        }
+        signatureCache.insert(cacheKey, signature);
+    }
+    return signature;
+}
+
 bool SecureBoot::generateBootSig(const QString &bootImgPath, const QString &rsaKeyPath, const QString &bootSigPath)
 {
     qDebug() << "SecureBoot: generating boot.sig for" << bootImgPath;
@@ -273,52 +401,39 @@ bool SecureBoot::generateBootSig(const QString &bootImgPath, const QString &rsaK
 
     qDebug() << "SecureBoot: boot.img SHA-256:" << hashHex;
 
-    // Convert hex hash to raw bytes for signing
-    QByteArray hashBytes = QByteArray::fromHex(hashHex);
-    if (hashBytes.size() != 32) {
-        qDebug() << "SecureBoot::generateBootSig: invalid hash size:" << hashBytes.size();
-        return false;
-    }
-
-    // Get current timestamp
-    qint64 timestamp = getCurrentTimestamp();
-    qDebug() << "SecureBoot: timestamp:" << timestamp;
-
-    // Sign the raw hash bytes with RSA key
     // The signature is computed over the raw 32-byte SHA-256 hash
-    QByteArray signature = rsaSign(hashBytes, rsaKeyPath);
-    if (signature.isEmpty()) {
+    QByteArray sig = signatureFile(QByteArray::fromHex(hashHex), rsaKeyPath);
+    if (sig.isEmpty()) {
         qDebug() << "SecureBoot::generateBootSig: failed to sign boot.img";
         return false;
     }
 
-    qDebug() << "SecureBoot: RSA signature:" << signature;
-
-    // Create boot.sig file
     QFile sigFile(bootSigPath);
     if (!sigFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
         qDebug() << "SecureBoot::generateBootSig: failed to create" << bootSigPath;
         return false;
     }
-
-    // Write boot.sig in the format expected by Raspberry Pi secure boot:
-    // SHA-256 hash (hex)
-    // ts: timestamp
-    // rsa2048: signature (hex)
-    sigFile.write(hashHex);
-    sigFile.write("\n");
-    sigFile.write("ts: ");
-    sigFile.write(QByteArray::number(timestamp));
-    sigFile.write("\n");
-    sigFile.write("rsa2048: ");
-    sigFile.write(signature);
-    sigFile.write("\n");
+    sigFile.write(sig);
     sigFile.close();
 
     qDebug() << "SecureBoot: boot.sig created successfully at" << bootSigPath;
     return true;
 }
 
+QByteArray SecureBoot::generateBootSig(const QByteArray &bootImg, const QString &rsaKeyPath)
+{
+    AcceleratedCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(bootImg);
+    QByteArray digest = hash.result();
+    qDebug() << "SecureBoot: boot.img SHA-256:" << digest.toHex();
+
+    QByteArray sig = signatureFile(digest, rsaKeyPath);
+    if (sig.isEmpty()) {
+        qDebug() << "SecureBoot::generateBootSig: failed to sign boot.img";
+    }
+    return sig;
+}
+
 qint64 SecureBoot::getCurrentTimestamp()
 {
     return QDateTime::currentSecsSinceEpoch();
@@ -329,28 +444,11 @@ QByteArray SecureBoot::generateConfigSig(const QByteArray &configText, const QSt
     // SHA-256 over the raw config text (matches rpi-eeprom-digest behaviour).
     AcceleratedCryptographicHash hash(QCryptographicHash::Sha256);
     hash.addData(configText);
-    QByteArray digest = hash.result();
-    if (digest.size() != 32) {
-        qDebug() << "SecureBoot::generateConfigSig: SHA-256 produced" << digest.size() << "bytes";
-        return {};
-    }
 
-    // RSA sign the raw 32-byte digest (rsaSign internally wraps it in DigestInfo).
-    QByteArray sigHex = rsaSign(digest, rsaKeyPath);
-    if (sigHex.isEmpty()) {
+    QByteArray sig = signatureFile(hash.result(), rsaKeyPath);
+    if (sig.isEmpty()) {
         qDebug() << "SecureBoot::generateConfigSig: rsaSign failed";
-        return {};
     }
-
-    QByteArray sig;
-    sig.append(digest.toHex());
-    sig.append('\n');
-    sig.append("ts: ");
-    sig.append(QByteArray::number(getCurrentTimestamp()));
-    sig.append('\n');
-    sig.append("rsa2048: ");
-    sig.append(sigHex);
-    sig.append('\n');
     return sig;
 }
 
@@ -372,6 +470,15 @@ static int asn1ParseLength(const uint8_t *d, int len, int *off)
 
 QByteArray SecureBoot::extractRsaPubkeyBin(const QString &rsaKeyPath)
 {
+    const QByteArray keyId = keyCacheId(rsaKeyPath);
+    if (!keyId.isEmpty()) {
+        QMutexLocker lock(&cacheMutex);
+        auto it = pubkeyCache.constFind(keyId);
+        if (it != pubkeyCache.constEnd()) {
+            return it.value();
+        }
+    }
+
     // Run openssl to extract a DER-encoded SubjectPublicKeyInfo for the
     // RSA key.  `openssl pkey -pubout` works with both private and public
     // keys, so callers can pass either.
@@ -459,6 +566,10 @@ QByteArray SecureBoot::extractRsaPubkeyBin(const QString &rsaKeyPath)
     eLE.resize(8);
     result.append(eLE);
 
+    if (!keyId.isEmpty()) {
+        QMutexLocker lock(&cacheMutex);
+        pubkeyCache.insert(keyId, result);
+    }
     return result;
 }
 
@@ -33,6 +33,13 @@ public:
      */
     static bool createBootImg(const QMap<QString, QByteArray> &files, const QString &outputPath);
 
+    /**
+     * Create a FAT32 boot.img in memory from a map of files
+     * @param files Map of filename -> file contents
+     * @return The image, or empty on error
+     */
+    static QByteArray createBootImg(const QMap<QString, QByteArray> &files);
+
     /**
      * Generate boot.sig signature file for a boot.img
      * @param bootImgPath Path to the boot.img file
@@ -42,6 +49,14 @@ public:
      */
     static bool generateBootSig(const QString &bootImgPath, const QString &rsaKeyPath, const QString &bootSigPath);
 
+    /**
+     * Generate the contents of boot.sig for an in-memory boot.img
+     * @param bootImg The boot.img contents
+     * @param rsaKeyPath Path to RSA 2048-bit private key (PEM format)
+     * @return boot.sig contents, or empty on error
+     */
+    static QByteArray generateBootSig(const QByteArray &bootImg, const QString &rsaKeyPath);
+
     /**
      * Build a bootconf.sig blob for an in-memory config buffer.  The
      * format matches rpi-eeprom-digest output: hex sha256, "ts: <epoch>",
@@ -54,7 +69,8 @@ public:
      * Extract the public-key components (N, E) from a PEM-encoded RSA-2048
      * private (or public) key and return them in the 264-byte little-endian
      * format used by the Pi bootloader: 256 bytes of N || 8 bytes of E.
-     * Returns empty on error.
+     * Returns empty on error.  Results are cached per key file, so that
+     * provisioning a batch of devices runs openssl once.
      */
     static QByteArray extractRsaPubkeyBin(const QString &rsaKeyPath);
 
@@ -79,6 +95,9 @@ public:
 
     /**
      * Sign data with RSA PKCS#1 v1.5 using a private key
+     *
+     * PKCS#1 v1.5 signatures are deterministic, so signatures are cached
+     * per key file and digest: identical images in a batch are signed once.
      * @param data Data to sign
      * @param rsaKeyPath Path to RSA private key (PEM format)
      * @return Hex-encoded signature, or empty on error
@@ -0,0 +1,295 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "sessioncomparison.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+const char *const kPhases[] = {"download", "decompress", "write", "verify"};
+const char *const kStallEvents[] = {"progressStall", "deviceIOTimeout", "watchdogRecovery"};
+
+// Index of avgKBps in a histogram slice (see PerformanceStats::buildHistogramForPhase)
+constexpr int kSliceAvgKBps = 3;
+
+void flatten(const QJsonObject &object, const QString &prefix, QMap<QString, QString> &out)
+{
+    for (auto it = object.begin(); it != object.end(); ++it)
+    {
+        const QString key = prefix.isEmpty() ? it.key() : prefix + "." + it.key();
+        if (it.value().isObject())
+            flatten(it.value().toObject(), key, out);
+        else
+            out.insert(key, it.value().toVariant().toString());
+    }
+}
+
+double mean(const QVector<double> &values)
+{
+    double sum = 0;
+    for (double v : values)
+        sum += v;
+    return values.isEmpty() ? 0 : sum / values.size();
+}
+
+double rounded(double value, int decimals = 1)
+{
+    const double scale = std::pow(10.0, decimals);
+    return std::round(value * scale) / scale;
+}
+
+} // namespace
+
+bool SessionComparison::load(const QString &path)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+    {
+        _error = QString("Cannot open session %1: %2").arg(path, f.errorString());
+        return false;
+    }
+    return parse(f.readAll(), QFileInfo(path).fileName());
+}
+
+bool SessionComparison::parse(const QByteArray &json, const QString &name)
+{
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(json, &parseError);
+    if (doc.isNull())
+    {
+        _error = QString("Invalid session %1: %2").arg(name, parseError.errorString());
+        return false;
+    }
+    const QJsonObject root = doc.object();
+    const QJsonObject summary = root.value("summary").toObject();
+    if (summary.isEmpty())
+    {
+        _error = QString("%1 is not a performance stats export").arg(name);
+        return false;
+    }
+
+    Session session;
+    session.name = name;
+
+    const QJsonObject histograms = root.value("histograms").toObject();
+    const QJsonObject phases = summary.value("phases").toObject();
+    for (const char *phase : kPhases)
+    {
+        QVector<double> kbps;
+        for (const QJsonValue &slice : histograms.value(phase).toArray())
+        {
+            const QJsonArray values = slice.toArray();
+            if (values.size() > kSliceAvgKBps)
+                kbps.append(values.at(kSliceAvgKBps).toDouble());
+        }
+        if (!kbps.isEmpty())
+            session.throughputKBps.insert(phase, kbps);
+
+        const QJsonObject stats = phases.value(phase).toObject();
+        if (stats.contains("durationMs"))
+            session.phaseDurationMs.insert(phase, stats.value("durationMs").toInteger());
+    }
+
+    const QJsonObject events = summary.value("events").toObject();
+    for (const char *type : kStallEvents)
+        session.stalls.insert(type, events.value(type).toObject().value("count").toInt());
+
+    static const QRegularExpression impactPattern("impactPercent: (-?\\d+)");
+    for (const QJsonValue &value : root.value("events").toArray())
+    {
+        const QJsonObject event = value.toObject();
+        if (event.value("type").toString() != "writeAfterSyncImpact")
+            continue;
+        const QRegularExpressionMatch match = impactPattern.match(event.value("metadata").toString());
+        if (match.hasMatch())
+            session.syncImpactPercent.append(match.captured(1).toDouble());
+    }
+
+    flatten(root.value("system").toObject(), QString(), session.system);
+
+    _sessions.append(std::move(session));
+    return true;
+}
+
+double SessionComparison::percentile(QVector<double> values, double fraction)
+{
+    if (values.isEmpty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    const double position = std::clamp(fraction, 0.0, 1.0) * (values.size() - 1);
+    const int below = static_cast<int>(position);
+    if (below + 1 >= values.size())
+        return values.last();
+    return values[below] + (values[below + 1] - values[below]) * (position - below);
+}
+
+double SessionComparison::mannWhitneyP(const QVector<double> &a, const QVector<double> &b)
+{
+    const qint64 n1 = a.size();
+    const qint64 n2 = b.size();
+    if (n1 == 0 || n2 == 0)
+        return 1.0;
+
+    // Rank both together; tied values share the average of their ranks
+    QVector<std::pair<double, bool>> all;  // Value, from a
+    all.reserve(n1 + n2);
+    for (double v : a)
+        all.append({v, true});
+    for (double v : b)
+        all.append({v, false});
+    std::sort(all.begin(), all.end(), [](const auto &x, const auto &y) { return x.first < y.first; });
+
+    const qint64 n = n1 + n2;
+    double rankSumA = 0;
+    double tieTerm = 0;
+    for (qint64 i = 0; i < n;)
+    {
+        qint64 j = i;
+        while (j < n && all[j].first == all[i].first)
+            ++j;
+        const double rank = (i + 1 + j) / 2.0;
+        for (qint64 k = i; k < j; ++k)
+            if (all[k].second)
+                rankSumA += rank;
+        const double ties = static_cast<double>(j - i);
+        tieTerm += ties * ties * ties - ties;
+        i = j;
+    }
+
+    const double u = rankSumA - n1 * (n1 + 1) / 2.0;
+    const double meanU = n1 * n2 / 2.0;
+    const double variance = n1 * n2 / 12.0 * ((n + 1) - tieTerm / (static_cast<double>(n) * (n - 1)));
+    if (variance <= 0)
+        return 1.0;
+
+    // With continuity correction
+    const double z = std::max(0.0, std::abs(u - meanU) - 0.5) / std::sqrt(variance);
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+QJsonObject SessionComparison::_compare(const Session &baseline, const Session &session, QStringList &regressions) const
+{
+    QJsonObject result;
+    result["session"] = session.name;
+
+    // Phases both sessions went through
+    QJsonObject phases;
+    for (auto it = session.throughputKBps.cbegin(); it != session.throughputKBps.cend(); ++it)
+    {
+        const QString &phase = it.key();
+        if (!baseline.throughputKBps.contains(phase))
+            continue;
+        const QVector<double> &before = baseline.throughputKBps[phase];
+        const QVector<double> &after = it.value();
+
+        const double baselineMedian = percentile(before, 0.5);
+        const double median = percentile(after, 0.5);
+        const double change = baselineMedian > 0 ? 100.0 * (median - baselineMedian) / baselineMedian : 0;
+
+        QJsonObject stats;
+        stats["baselineSamples"] = before.size();
+        stats["samples"] = after.size();
+        stats["baselineMedianKBps"] = qRound64(baselineMedian);
+        stats["medianKBps"] = qRound64(median);
+        stats["baselineP10KBps"] = qRound64(percentile(before, 0.1));
+        stats["p10KBps"] = qRound64(percentile(after, 0.1));
+        stats["changePercent"] = rounded(change);
+        if (baseline.phaseDurationMs.contains(phase) && session.phaseDurationMs.contains(phase))
+        {
+            stats["baselineDurationMs"] = baseline.phaseDurationMs[phase];
+            stats["durationMs"] = session.phaseDurationMs[phase];
+        }
+
+        if (before.size() >= kMinSamples && after.size() >= kMinSamples)
+        {
+            const double p = mannWhitneyP(before, after);
+            const bool significant = p < kSignificance && std::abs(change) >= kMinChangePercent;
+            stats["pValue"] = p;
+            stats["significant"] = significant;
+            if (significant && change < 0)
+            {
+                regressions.append(QString("%1: median throughput %2 KB/s, %3% below %4 KB/s (p = %5)")
+                    .arg(phase).arg(qRound64(median)).arg(rounded(-change)).arg(qRound64(baselineMedian))
+                    .arg(p, 0, 'g', 2));
+            }
+        }
+        phases[phase] = stats;
+    }
+    result["phases"] = phases;
+
+    QJsonObject stalls;
+    for (auto it = session.stalls.cbegin(); it != session.stalls.cend(); ++it)
+    {
+        const int before = baseline.stalls.value(it.key());
+        if (before == 0 && it.value() == 0)
+            continue;
+        stalls[it.key()] = QJsonObject{{"baseline", before}, {"count", it.value()}};
+        if (it.value() > before)
+            regressions.append(QString("%1: %2, baseline %3").arg(it.key()).arg(it.value()).arg(before));
+    }
+    result["stalls"] = stalls;
+
+    if (!baseline.syncImpactPercent.isEmpty() && !session.syncImpactPercent.isEmpty())
+    {
+        const double before = mean(baseline.syncImpactPercent);
+        const double after = mean(session.syncImpactPercent);
+        result["syncImpactPercent"] = QJsonObject{{"baseline", rounded(before)}, {"value", rounded(after)}};
+        if (after - before >= kMinChangePercent)
+        {
+            regressions.append(QString("writeAfterSyncImpact: throughput %1% lower after a sync, baseline %2%")
+                .arg(rounded(after)).arg(rounded(before)));
+        }
+    }
+
+    // Differences in the system, including values only one session has
+    QJsonArray system;
+    QStringList keys = baseline.system.keys() + session.system.keys();
+    keys.removeDuplicates();
+    std::sort(keys.begin(), keys.end());
+    for (const QString &key : keys)
+    {
+        const QString before = baseline.system.value(key);
+        const QString after = session.system.value(key);
+        if (before != after)
+            system.append(QJsonObject{{"key", key}, {"baseline", before}, {"value", after}});
+    }
+    result["system"] = system;
+
+    return result;
+}
+
+QJsonObject SessionComparison::report() const
+{
+    QJsonObject report;
+    if (_sessions.isEmpty())
+        return report;
+
+    report["baseline"] = _sessions.first().name;
+    QJsonArray comparisons;
+    int regressionCount = 0;
+    for (int i = 1; i < _sessions.size(); ++i)
+    {
+        QStringList regressions;
+        QJsonObject comparison = _compare(_sessions.first(), _sessions[i], regressions);
+        comparison["regressions"] = QJsonArray::fromStringList(regressions);
+        regressionCount += regressions.size();
+        comparisons.append(comparison);
+    }
+    report["comparisons"] = comparisons;
+    report["regressionCount"] = regressionCount;
+    return report;
+}
+
+int SessionComparison::regressionCount() const
+{
+    return report().value("regressionCount").toInt();
+}
@@ -0,0 +1,85 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef SESSIONCOMPARISON_H
+#define SESSIONCOMPARISON_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief Compares PerformanceStats exports, for the CLI's --compare-sessions
+ *
+ * The first session added is the baseline, and every other one is
+ * compared with it phase by phase:
+ *
+ * - Throughput: the per-second averages of each phase's histogram are
+ *   compared with a Mann-Whitney U test. A phase regressed when its median
+ *   dropped by at least kMinChangePercent and p < kSignificance. Seconds
+ *   of one write are not independent, so p is a guide to how clear the
+ *   difference is rather than an exact probability.
+ * - Stalls: progress stalls, device I/O timeouts and watchdog recoveries
+ *   counted by type. Any more than the baseline had is a regression.
+ * - Sync impact: the average throughput drop after a sync, from the
+ *   writeAfterSyncImpact events. A regression when it grew by at least
+ *   kMinChangePercent points.
+ * - System: every value under "system" that differs, e.g. the OS version
+ *   or buffer sizes, to explain the above.
+ */
+class SessionComparison
+{
+public:
+    struct Session {
+        QString name;
+        QMap<QString, QVector<double>> throughputKBps;  // Per phase, one per histogram window
+        QMap<QString, qint64> phaseDurationMs;
+        QMap<QString, int> stalls;                      // By event type
+        QVector<double> syncImpactPercent;              // One per writeAfterSyncImpact event
+        QMap<QString, QString> system;                  // Flattened, e.g. "platform.osVersion"
+    };
+
+    static constexpr double kSignificance = 0.01;
+    static constexpr double kMinChangePercent = 10.0;
+    static constexpr int kMinSamples = 5;  // Windows per phase for a throughput test
+
+    bool load(const QString &path);
+    bool parse(const QByteArray &json, const QString &name);
+
+    /**
+     * @brief Every session compared with the first
+     */
+    QJsonObject report() const;
+
+    /**
+     * @brief Regressions found by report()
+     */
+    int regressionCount() const;
+
+    const QList<Session> &sessions() const { return _sessions; }
+    QString errorString() const { return _error; }
+
+    /**
+     * @brief Two-sided p-value of the Mann-Whitney U test, with tie correction
+     *
+     * Uses the normal approximation, so it needs a few values on each side.
+     * 1 when either side is empty or all values are equal.
+     */
+    static double mannWhitneyP(const QVector<double> &a, const QVector<double> &b);
+
+    static double percentile(QVector<double> values, double fraction);
+
+private:
+    QJsonObject _compare(const Session &baseline, const Session &session, QStringList &regressions) const;
+
+    QList<Session> _sessions;
+    QString _error;
+};
+
+#endif // SESSIONCOMPARISON_H
@@ -0,0 +1,122 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "startupprofile.h"
+#include <QJsonArray>
+#include <QMutexLocker>
+
+StartupProfile &StartupProfile::instance()
+{
+    static StartupProfile profile;
+    return profile;
+}
+
+void StartupProfile::start()
+{
+    QMutexLocker locker(&_mutex);
+    _timer.start();
+    _phases.clear();
+    _milestones.clear();
+}
+
+qint64 StartupProfile::elapsedMs() const
+{
+    return _timer.isValid() ? _timer.elapsed() : 0;
+}
+
+void StartupProfile::mark(const QString &phase)
+{
+    markAt(phase, elapsedMs());
+}
+
+void StartupProfile::markAt(const QString &phase, qint64 atMs)
+{
+    QMutexLocker locker(&_mutex);
+    for (const Phase &p : std::as_const(_phases))
+    {
+        if (p.name == phase)
+            return;
+    }
+
+    Phase p;
+    p.name = phase;
+    p.startMs = _phases.isEmpty() ? 0 : _phases.last().endMs;
+    p.endMs = qMax(atMs, p.startMs);
+    _phases.append(p);
+}
+
+void StartupProfile::milestone(const QString &name)
+{
+    milestoneAt(name, elapsedMs());
+}
+
+void StartupProfile::milestoneAt(const QString &name, qint64 atMs)
+{
+    QMutexLocker locker(&_mutex);
+    for (const Milestone &m : std::as_const(_milestones))
+    {
+        if (m.name == name)
+            return;
+    }
+    _milestones.append({name, atMs});
+}
+
+bool StartupProfile::isMarked(const QString &name) const
+{
+    QMutexLocker locker(&_mutex);
+    for (const Phase &p : _phases)
+    {
+        if (p.name == name)
+            return true;
+    }
+    for (const Milestone &m : _milestones)
+    {
+        if (m.name == name)
+            return true;
+    }
+    return false;
+}
+
+QList<StartupProfile::Phase> StartupProfile::phases() const
+{
+    QMutexLocker locker(&_mutex);
+    return _phases;
+}
+
+QList<StartupProfile::Milestone> StartupProfile::milestones() const
+{
+    QMutexLocker locker(&_mutex);
+    return _milestones;
+}
+
+QJsonObject StartupProfile::report(qint64 budgetMs) const
+{
+    QMutexLocker locker(&_mutex);
+    QJsonArray phases;
+    for (const Phase &p : _phases)
+    {
+        QJsonObject phase;
+        phase["name"] = p.name;
+        phase["startMs"] = p.startMs;
+        phase["durationMs"] = p.endMs - p.startMs;
+        phases.append(phase);
+    }
+
+    QJsonObject milestones;
+    for (const Milestone &m : _milestones)
+        milestones[m.name] = m.atMs;
+
+    const qint64 totalMs = _phases.isEmpty() ? 0 : _phases.last().endMs;
+    QJsonObject report;
+    report["totalMs"] = totalMs;
+    report["phases"] = phases;
+    report["milestones"] = milestones;
+    if (budgetMs > 0)
+    {
+        report["budgetMs"] = budgetMs;
+        report["withinBudget"] = totalMs <= budgetMs;
+    }
+    return report;
+}
@@ -0,0 +1,74 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef STARTUPPROFILE_H
+#define STARTUPPROFILE_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+/**
+ * @brief Where the time goes between main() and an interactive window
+ *
+ * main() calls start() first thing, then mark() at the end of each step on
+ * the critical path (Qt init, translator, QML load, first frame, ...);
+ * each phase runs from the previous mark to its own. Things that happen
+ * alongside, such as the first drive scan, are milestone()s: just the time
+ * they were reached.
+ *
+ * The phases also go into the performance data as startupPhase events,
+ * and --startup-profile writes report() as JSON, to hold kiosk images to a
+ * startup budget (--startup-budget).
+ *
+ * PerformanceStats only exists once ImageWriter does, which is part way
+ * through startup, hence a separate tracer.
+ */
+class StartupProfile
+{
+public:
+    struct Phase {
+        QString name;
+        qint64 startMs = 0;
+        qint64 endMs = 0;
+    };
+    struct Milestone {
+        QString name;
+        qint64 atMs = 0;
+    };
+
+    static StartupProfile &instance();
+
+    void start();
+    qint64 elapsedMs() const;
+
+    // End the current phase now; later marks of the same name are ignored
+    void mark(const QString &phase);
+    void markAt(const QString &phase, qint64 atMs);
+    // Something reached off the critical path; only the first time counts
+    void milestone(const QString &name);
+    void milestoneAt(const QString &name, qint64 atMs);
+
+    bool isMarked(const QString &name) const;
+    QList<Phase> phases() const;
+    QList<Milestone> milestones() const;
+
+    /**
+     * @brief JSON report: totalMs (the last mark), phases with their
+     * durations, milestones, and with budgetMs > 0, whether totalMs is
+     * within it
+     */
+    QJsonObject report(qint64 budgetMs = 0) const;
+
+private:
+    QElapsedTimer _timer;
+    mutable QMutex _mutex;
+    QList<Phase> _phases;
+    QList<Milestone> _milestones;
+};
+
+#endif // STARTUPPROFILE_H
@@ -0,0 +1,44 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "staticdata.h"
+#include "staticdata_tables.h"
+#include <algorithm>
+
+namespace StaticData {
+
+std::span<const Entry> timezones()
+{
+    return kTimezones;
+}
+
+std::span<const Entry> countries()
+{
+    return kCountries;
+}
+
+std::span<const Entry> keymapLayouts()
+{
+    return kKeymapLayouts;
+}
+
+std::span<const CapitalCity> capitalCities()
+{
+    return kCapitalCities;
+}
+
+std::span<const std::uint8_t> wordStarts(const Entry &entry)
+{
+    return std::span<const std::uint8_t>(kWordStarts).subspan(entry.firstWordStart, entry.wordStartCount);
+}
+
+const CapitalCity *findCapital(std::string_view city)
+{
+    const auto it = std::find_if(std::begin(kCapitalCities), std::end(kCapitalCities),
+                                 [city](const CapitalCity &c) { return c.city == city; });
+    return it == std::end(kCapitalCities) ? nullptr : it;
+}
+
+} // namespace StaticData
@@ -0,0 +1,52 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef STATICDATA_H
+#define STATICDATA_H
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+/**
+ * @brief Timezone, country, keymap and capital city lists, compiled in
+ *
+ * GenerateStaticDataTables.cmake turns the text lists (downloaded or from
+ * the source tree) into constexpr tables at build time, so nothing is read
+ * or split at run time. Each entry also records where its words start,
+ * which is where the filter-as-you-type combo boxes match.
+ */
+namespace StaticData {
+
+struct Entry {
+    std::string_view text;      // UTF-8
+    std::uint16_t firstWordStart;  // Index into the word start table
+    std::uint8_t wordStartCount;
+};
+
+struct CapitalCity {
+    Entry display;  // "City (Country)"
+    std::string_view city;
+    std::string_view country;
+    std::string_view countryCode;
+    std::string_view timezone;
+    std::string_view language;
+    std::string_view keyboard;
+};
+
+std::span<const Entry> timezones();
+std::span<const Entry> countries();
+std::span<const Entry> keymapLayouts();
+std::span<const CapitalCity> capitalCities();
+
+// Byte offsets into entry.text at which its words start; the first is 0
+std::span<const std::uint8_t> wordStarts(const Entry &entry);
+
+// The capital with this city name, or nullptr
+const CapitalCity *findCapital(std::string_view city);
+
+} // namespace StaticData
+
+#endif // STATICDATA_H
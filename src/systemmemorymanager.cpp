@@ -5,10 +5,14 @@
 
 #include "systemmemorymanager.h"
 #include "config.h"
+#include "deviceprofile.h"
+#include "bufferpool.h"
+#include "containerlimits.h"
 #include <QDebug>
 #include <QFile>
 #include <QTextStream>
 #include <QRegularExpression>
+#include <chrono>
 #include <cmath>
 
 // Platform-specific includes
@@ -37,12 +41,20 @@ SystemMemoryManager& SystemMemoryManager::instance()
 qint64 SystemMemoryManager::getTotalMemoryMB()
 {
     if (_cachedTotalMemoryMB == -1) {
-        _cachedTotalMemoryMB = getPlatformTotalMemoryMB();
-        if (_cachedTotalMemoryMB <= 0) {
+        qint64 totalMB = getPlatformTotalMemoryMB();
+        if (totalMB <= 0) {
             qDebug() << "Warning: Could not detect system memory, assuming 4GB";
-            _cachedTotalMemoryMB = 4096;
+            totalMB = 4096;
+        }
+        const qint64 limitMB = getContainerMemoryLimitMB();
+        if (limitMB > 0 && limitMB < totalMB) {
+            qDebug() << "Container memory limit:" << limitMB << "MB of" << totalMB << "MB";
+            totalMB = limitMB;
+        }
+        qint64 unset = -1;
+        if (_cachedTotalMemoryMB.compare_exchange_strong(unset, totalMB)) {
+            qDebug() << "Detected total system memory:" << totalMB << "MB on" << getPlatformName();
         }
-        qDebug() << "Detected total system memory:" << _cachedTotalMemoryMB << "MB on" << getPlatformName();
     }
     return _cachedTotalMemoryMB;
 }
@@ -50,11 +62,20 @@ qint64 SystemMemoryManager::getTotalMemoryMB()
 qint64 SystemMemoryManager::getAvailableMemoryMB()
 {
     // Use cached value if available (cache for short period to avoid constant syscalls)
-    if (_cachedAvailableMemoryMB > 0) {
-        return _cachedAvailableMemoryMB;
+    const qint64 nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    const qint64 cachedMB = _cachedAvailableMemoryMB;
+    if (cachedMB > 0 && nowMs - _availableSampledMs < AVAILABLE_MEMORY_CACHE_MS) {
+        return cachedMB;
     }
     
     qint64 availableMB = getPlatformAvailableMemoryMB();
+    const qint64 containerMB = getContainerAvailableMemoryMB();
+    if (containerMB >= 0 && (availableMB <= 0 || containerMB < availableMB)) {
+        // Free host memory the container may not use is not available;
+        // 0 here is genuinely nothing left, not a failed detection
+        availableMB = qMax<qint64>(containerMB, 1);
+    }
     
     // Fall back to total memory if platform detection failed
     if (availableMB <= 0) {
@@ -62,6 +83,7 @@ qint64 SystemMemoryManager::getAvailableMemoryMB()
     }
     
     _cachedAvailableMemoryMB = availableMB;
+    _availableSampledMs = nowMs;
     return availableMB;
 }
 
@@ -103,6 +125,23 @@ SystemMemoryManager::SyncConfiguration SystemMemoryManager::calculateSyncConfigu
     return config;
 }
 
+SystemMemoryManager::SyncConfiguration SystemMemoryManager::calculateSyncConfiguration(const DeviceProfile &profile)
+{
+    SyncConfiguration config = calculateSyncConfiguration();
+    if (profile.isEmpty())
+        return config;
+
+    profile.seedSyncInterval(config.syncIntervalBytes, config.syncIntervalMs, MIN_SYNC_INTERVAL_BYTES);
+    config.memoryTier += QString(", device profile (%1 KB/s, sync %2 ms)")
+                             .arg(profile.writeKBps).arg(profile.periodicSyncMs);
+
+    qDebug() << "Device-seeded sync configuration:"
+             << "- Sync interval:" << (config.syncIntervalBytes / 1024 / 1024) << "MB"
+             << "- Time interval:" << config.syncIntervalMs << "ms";
+
+    return config;
+}
+
 QString SystemMemoryManager::getPlatformName()
 {
 #ifdef Q_OS_WIN
@@ -116,6 +155,26 @@ QString SystemMemoryManager::getPlatformName()
 #endif
 }
 
+qint64 SystemMemoryManager::getContainerMemoryLimitMB()
+{
+#ifdef Q_OS_LINUX
+    const int64_t limit = ContainerLimits::read().memoryLimitBytes;
+    return limit == ContainerLimits::Unlimited ? -1 : static_cast<qint64>(limit / (1024 * 1024));
+#else
+    return -1;
+#endif
+}
+
+qint64 SystemMemoryManager::getContainerAvailableMemoryMB()
+{
+#ifdef Q_OS_LINUX
+    const int64_t available = ContainerLimits::read().memoryAvailableBytes();
+    return available == ContainerLimits::Unlimited ? -1 : static_cast<qint64>(available / (1024 * 1024));
+#else
+    return -1;
+#endif
+}
+
 // Platform-specific implementations
 
 #ifdef Q_OS_WIN
@@ -477,14 +536,63 @@ void SystemMemoryManager::logConfigurationSummary()
     qDebug() << "Platform:" << getPlatformName();
     qDebug() << "System Memory:" << totalMemMB << "MB";
     qDebug() << "Memory Tier:" << syncConfig.memoryTier;
+    qDebug() << "CPUs:" << ContainerLimits::cpuCount();
     qDebug() << "Input Buffer:" << (inputBuf / 1024) << "KB";
     qDebug() << "Write Buffer:" << (writeBuf / 1024) << "KB";
     qDebug() << "Async Queue Depth:" << asyncDepth;
     qDebug() << "Sync Interval:" << (syncConfig.syncIntervalBytes / (1024 * 1024)) << "MB /" 
              << syncConfig.syncIntervalMs << "ms";
+    BufferPool::Stats pool = BufferPool::instance().stats();
+    qDebug() << "Huge Pages:" << BufferPool::hugePageSupport();
+    qDebug() << "Buffer Pool:" << (pool.inUse / (1024 * 1024)) << "MB in use of"
+             << (pool.limit / (1024 * 1024)) << "MB,"
+             << (pool.hugePage / (1024 * 1024)) << "MB on huge pages";
     qDebug() << "=============================================";
 }
 
+uint64_t SystemMemoryManager::getBufferPoolLimit()
+{
+    // Half of what is available covers the ring buffers (budgeted at 30%),
+    // verification and cache chunks while leaving room for the page cache
+    const uint64_t minLimit = 64ULL * 1024 * 1024;
+    uint64_t limit = static_cast<uint64_t>(qMax<qint64>(getAvailableMemoryMB(), 0)) * 1024 * 1024 / 2;
+    return qMax(limit, minLimit);
+}
+
+bool SystemMemoryManager::getWritebackState(qint64 &dirtyKB, qint64 &writebackKB)
+{
+    dirtyKB = 0;
+    writebackKB = 0;
+#ifdef Q_OS_LINUX
+    QFile meminfo("/proc/meminfo");
+    if (!meminfo.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    QTextStream in(&meminfo);
+    QString line;
+    int found = 0;
+    while (found < 2 && !(line = in.readLine()).isNull()) {
+        qint64 *field = nullptr;
+        if (line.startsWith("Dirty:")) {
+            field = &dirtyKB;
+        } else if (line.startsWith("Writeback:")) {
+            field = &writebackKB;
+        }
+        if (field) {
+            QStringList parts = line.split(QRegularExpression("\\s+"));
+            if (parts.size() >= 2) {
+                *field = parts[1].toLongLong();
+            }
+            found++;
+        }
+    }
+    return found == 2;
+#else
+    return false;
+#endif
+}
+
 int SystemMemoryManager::getOptimalAsyncQueueDepth(size_t writeBlockSize)
 {
     qint64 totalMemMB = getTotalMemoryMB();
@@ -664,3 +772,32 @@ size_t SystemMemoryManager::getCoordinatedRingBufferConfig(size_t inputSlotSizeH
     return totalActual;
 }
 
+int SystemMemoryManager::getOptimalDownloadConnections(size_t segmentSize)
+{
+    qint64 availableMemMB = getAvailableMemoryMB();
+    
+    // Reorder buffer budget: 10% of available memory, on top of the ring
+    // buffers (which take up to 30%). Out-of-order segments are held here
+    // until all earlier segments have been handed to the ring buffer.
+    size_t budget = static_cast<size_t>(availableMemMB) * 1024 * 1024 * 10 / 100;
+    int connectionsFromMemory = static_cast<int>(budget / (2 * segmentSize));
+    
+    // More connections than this gives diminishing returns and is unfriendly
+    // towards mirrors; a handful is enough to fill long-RTT links
+    int baselineConnections;
+    if (availableMemMB < 1024) {
+        baselineConnections = 2;
+    } else if (availableMemMB < 4096) {
+        baselineConnections = 4;
+    } else {
+        baselineConnections = 6;
+    }
+    
+    int connections = qBound(1, qMin(connectionsFromMemory, baselineConnections), 8);
+    
+    qDebug() << "Parallel download connections:" << connections
+             << "(available:" << availableMemMB << "MB,"
+             << "segment size:" << (segmentSize / (1024 * 1024)) << "MB)";
+    
+    return connections;
+}
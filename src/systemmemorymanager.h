@@ -8,6 +8,9 @@
 
 #include <QtGlobal>
 #include <QString>
+#include <atomic>
+
+struct DeviceProfile;
 
 /**
  * @brief Platform-agnostic system memory management interface
@@ -34,12 +37,20 @@ public:
 
     /**
      * @brief Get total system memory in MB
+     *
+     * Inside a container with a memory limit (cgroup memory.max or
+     * memory.limit_in_bytes), the limit if it is lower.
+     *
      * @return Total system memory in megabytes, or 0 if detection failed
      */
     qint64 getTotalMemoryMB();
 
     /**
      * @brief Get available system memory in MB
+     *
+     * Re-read at most once a second, so callers see it change during a write.
+     * Inside a container, no more than what is left under its memory limit.
+     *
      * @return Available system memory in megabytes, or 0 if detection failed
      */
     qint64 getAvailableMemoryMB();
@@ -50,6 +61,13 @@ public:
      */
     SyncConfiguration calculateSyncConfiguration();
 
+    /**
+     * @brief Sync configuration for a device measured on an earlier write
+     * @param profile Stored measurements; an empty profile gives the memory-based configuration
+     * @return SyncConfiguration sized to the device's write rate and sync cost
+     */
+    SyncConfiguration calculateSyncConfiguration(const DeviceProfile &profile);
+
     /**
      * @brief Get platform name for logging
      * @return Platform identifier string
@@ -92,6 +110,28 @@ public:
      */
     size_t getOptimalRingBufferSlots(size_t slotSize);
 
+    /**
+     * @brief Limit for the process-wide buffer pool
+     * 
+     * About half of available RAM, at least 64 MB. Ring buffers, verify
+     * buffers and cache chunks all borrow from the pool under this limit.
+     * 
+     * @return Limit in bytes
+     */
+    uint64_t getBufferPoolLimit();
+
+    /**
+     * @brief Read how much page cache data is waiting to reach storage
+     * 
+     * System-wide Dirty and Writeback from /proc/meminfo. Used to decide
+     * when buffered writes should wait for ranged writeback to catch up.
+     * 
+     * @param dirtyKB Output: modified pages not yet queued for writeback
+     * @param writebackKB Output: pages currently being written back
+     * @return false if not available on this platform
+     */
+    bool getWritebackState(qint64 &dirtyKB, qint64 &writebackKB);
+
     /**
      * @brief Log a summary of all memory-based configuration
      * 
@@ -138,6 +178,21 @@ public:
      */
     int getOptimalAsyncQueueDepth(size_t writeBlockSize = 1024 * 1024);
 
+    static constexpr size_t DOWNLOAD_SEGMENT_SIZE = 8 * 1024 * 1024;  // 8MB per range request
+
+    /**
+     * @brief Calculate connection count for parallel HTTP range downloads
+     * 
+     * Sized alongside the ring buffers: each connection fetches one segment
+     * at a time, and up to twice as many segments may be buffered while
+     * waiting to be delivered in order, so memory use is
+     * 2 * connections * segmentSize.
+     * 
+     * @param segmentSize Size of each range request in bytes
+     * @return Number of connections (1 = parallel download not worthwhile)
+     */
+    int getOptimalDownloadConnections(size_t segmentSize = DOWNLOAD_SEGMENT_SIZE);
+
 private:
     SystemMemoryManager() = default;
     ~SystemMemoryManager() = default;
@@ -148,6 +203,10 @@ private:
     qint64 getPlatformTotalMemoryMB();
     qint64 getPlatformAvailableMemoryMB();
 
+    // The cgroup (container) the process runs in, -1 without a memory limit
+    qint64 getContainerMemoryLimitMB();
+    qint64 getContainerAvailableMemoryMB();
+
     // Configuration constants
     static constexpr qint64 MIN_SYNC_INTERVAL_BYTES = 16LL * 1024 * 1024;   // 16MB minimum
     static constexpr qint64 MAX_SYNC_INTERVAL_BYTES = 256LL * 1024 * 1024;  // 256MB maximum
@@ -157,9 +216,14 @@ private:
     static constexpr qint64 LOW_MEMORY_THRESHOLD_MB = 2048;     // 2GB
     static constexpr qint64 HIGH_MEMORY_THRESHOLD_MB = 8192;    // 8GB
 
-    // Cached values to avoid repeated system calls
-    mutable qint64 _cachedTotalMemoryMB = -1;
-    mutable qint64 _cachedAvailableMemoryMB = -1;
+    // How long an available memory reading is reused
+    static constexpr qint64 AVAILABLE_MEMORY_CACHE_MS = 1000;
+
+    // Cached values to avoid repeated system calls; read from several
+    // threads, e.g. MemoryPressureMonitor's
+    mutable std::atomic<qint64> _cachedTotalMemoryMB{-1};
+    mutable std::atomic<qint64> _cachedAvailableMemoryMB{-1};
+    mutable std::atomic<qint64> _availableSampledMs{0};
 };
 
 #endif // SYSTEMMEMORYMANAGER_H
@@ -0,0 +1,88 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the shared download rate limit and its priorities
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "bandwidthscheduler.h"
+
+namespace {
+
+using Priority = BandwidthScheduler::Priority;
+constexpr qint64 kSecondNs = 1000000000;
+
+// Bytes let through in one second when asking for chunk bytes as soon as allowed
+qint64 throughputOverOneSecond(BandwidthScheduler &scheduler, Priority priority, qint64 chunk)
+{
+    qint64 now = 10 * kSecondNs, received = 0;
+    // Drain the initial burst first
+    while (scheduler.reserve(priority, chunk, now) == 0)
+        ;
+    const qint64 start = now;
+    while (now < start + kSecondNs)
+    {
+        now += scheduler.reserve(priority, chunk, now);
+        received += chunk;
+    }
+    return received;
+}
+
+} // namespace
+
+TEST_CASE("No limit never waits", "[bandwidthscheduler]") {
+    BandwidthScheduler scheduler;
+    BandwidthScheduler::Transfer foreground(Priority::Foreground, scheduler);
+    CHECK(scheduler.reserve(Priority::Prefetch, 100 * 1024 * 1024, 0) == 0);
+    CHECK(scheduler.rateFor(Priority::Prefetch) == 0);
+}
+
+TEST_CASE("Transfers are held to the limit after the burst", "[bandwidthscheduler]") {
+    BandwidthScheduler scheduler;
+    scheduler.setLimit(1024 * 1024);
+
+    // The burst is let through straight away
+    CHECK(scheduler.reserve(Priority::Foreground, 200 * 1024, 0) == 0);
+    // Then 1 MB more takes a second
+    const qint64 wait = scheduler.reserve(Priority::Foreground, 1024 * 1024, 0);
+    CHECK(wait > kSecondNs * 9 / 10);
+    CHECK(wait < kSecondNs * 11 / 10);
+
+    const qint64 bytes = throughputOverOneSecond(scheduler, Priority::Foreground, 16 * 1024);
+    CHECK(bytes >= 1024 * 1024 * 95 / 100);
+    CHECK(bytes <= 1024 * 1024 * 105 / 100);
+}
+
+TEST_CASE("Lower priorities yield while a higher one transfers", "[bandwidthscheduler]") {
+    BandwidthScheduler scheduler;
+    const qint64 limit = 10 * 1024 * 1024;
+    scheduler.setLimit(limit);
+
+    CHECK(scheduler.rateFor(Priority::Prefetch) == limit);
+    {
+        BandwidthScheduler::Transfer foreground(Priority::Foreground, scheduler);
+        CHECK(scheduler.rateFor(Priority::Foreground) == limit);
+        CHECK(scheduler.rateFor(Priority::Interactive) == limit / 20);
+        CHECK(scheduler.rateFor(Priority::Telemetry) == limit / 20);
+
+        const qint64 bytes = throughputOverOneSecond(scheduler, Priority::Prefetch, 4096);
+        CHECK(bytes <= limit / 20 * 105 / 100);
+    }
+    CHECK(scheduler.rateFor(Priority::Prefetch) == limit);
+
+    // Only priorities above count
+    BandwidthScheduler::Transfer prefetch(Priority::Prefetch, scheduler);
+    CHECK(scheduler.rateFor(Priority::Interactive) == limit);
+    CHECK(scheduler.rateFor(Priority::Telemetry) == limit / 20);
+}
+
+TEST_CASE("A yielding priority keeps a minimum rate", "[bandwidthscheduler]") {
+    BandwidthScheduler scheduler;
+    scheduler.setLimit(32 * 1024);
+    BandwidthScheduler::Transfer foreground(Priority::Foreground, scheduler);
+    CHECK(scheduler.rateFor(Priority::Prefetch) == BandwidthScheduler::kMinYieldBytesPerSecond);
+
+    scheduler.setLimit(4 * 1024);
+    CHECK(scheduler.rateFor(Priority::Prefetch) == 4 * 1024);
+}
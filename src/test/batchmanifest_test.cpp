@@ -0,0 +1,156 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the CLI batch manifest: parsing, device rules and grouping
+ * jobs into writes
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "batchmanifest.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+namespace {
+
+void writeFile(const QString &path, const QByteArray &contents)
+{
+    QFile f(path);
+    REQUIRE(f.open(QIODevice::WriteOnly));
+    f.write(contents);
+}
+
+struct ManifestDir {
+    QTemporaryDir dir;
+
+    ManifestDir()
+    {
+        REQUIRE(dir.isValid());
+        writeFile(dir.filePath("a.img"), QByteArray(4096, 'a'));
+        writeFile(dir.filePath("b.img"), QByteArray(4096, 'b'));
+        writeFile(dir.filePath("firstrun.sh"), "#!/bin/sh\n");
+    }
+
+    BatchManifest parse(const QByteArray &json)
+    {
+        BatchManifest manifest;
+        const bool ok = manifest.parse(json, dir.path());
+        INFO(manifest.errorString().toStdString());
+        REQUIRE(ok);
+        return manifest;
+    }
+};
+
+const QList<BatchManifest::Drive> kDrives = {
+    {"/dev/sdb", "Generic SD Card Reader", 32000000000ULL},
+    {"/dev/sdc", "Generic SD Card Reader", 8000000000ULL},
+    {"/dev/sdd", "USB Flash Drive", 64000000000ULL},
+    {"/dev/sde", "Generic SD Card Reader", 16000000000ULL},
+};
+
+} // namespace
+
+TEST_CASE("Manifest jobs are read with files relative to the manifest", "[batchmanifest]") {
+    ManifestDir d;
+    BatchManifest manifest = d.parse(R"({"jobs": [
+        {"name": "lab", "image": "a.img", "sha256": "abc", "devices": ["/dev/sdb"], "first-run-script": "firstrun.sh"},
+        {"image": "https://example.com/os.img.xz", "devices": ["/dev/sdc"], "verify": false},
+        {"image": "a.img", "devices": ["/dev/sdd"], "verify-coverage": 5}
+    ]})");
+
+    REQUIRE(manifest.jobs().size() == 3);
+    const auto &lab = manifest.jobs()[0];
+    CHECK(lab.name == "lab");
+    CHECK(lab.image == QDir(d.dir.path()).absoluteFilePath("a.img"));
+    CHECK_FALSE(lab.isUrl());
+    CHECK(lab.sha256 == "abc");
+    CHECK(lab.firstRunScript == "#!/bin/sh\n");
+    CHECK(lab.verify);
+    CHECK(lab.verifyCoverage == 100.0);
+
+    const auto &download = manifest.jobs()[1];
+    CHECK(download.name == "job 2");
+    CHECK(download.isUrl());
+    CHECK_FALSE(download.verify);
+
+    CHECK(manifest.jobs()[2].verify);
+    CHECK(manifest.jobs()[2].verifyCoverage == 5.0);
+}
+
+TEST_CASE("Manifest errors are reported", "[batchmanifest]") {
+    ManifestDir d;
+    BatchManifest manifest;
+    CHECK_FALSE(manifest.parse("{", d.dir.path()));
+    CHECK_FALSE(manifest.parse(R"({"jobs": []})", d.dir.path()));
+    CHECK_FALSE(manifest.parse(R"({"jobs": [{"image": "missing.img", "devices": ["/dev/sdb"]}]})", d.dir.path()));
+    CHECK_FALSE(manifest.parse(R"({"jobs": [{"image": "a.img"}]})", d.dir.path()));
+    CHECK_FALSE(manifest.parse(R"({"jobs": [{"image": "a.img", "devices": ["/dev/sdb"], "first-run-script": "none.sh"}]})", d.dir.path()));
+    CHECK_FALSE(manifest.parse(R"({"jobs": [{"image": "a.img", "match": {"description": "("}}]})", d.dir.path()));
+    CHECK_FALSE(manifest.errorString().isEmpty());
+
+    BatchManifest twice = d.parse(R"({"jobs": [
+        {"image": "a.img", "devices": ["/dev/sdb"]},
+        {"image": "b.img", "devices": ["/dev/sdb"]}
+    ]})");
+    CHECK(twice.plan(kDrives).isEmpty());
+}
+
+TEST_CASE("Device rules pick free matching drives", "[batchmanifest]") {
+    ManifestDir d;
+    BatchManifest manifest = d.parse(R"({"jobs": [
+        {"name": "named", "image": "a.img", "devices": ["/dev/sdb"]},
+        {"name": "cards", "image": "b.img", "match": {"description": "sd card", "min-size": 10000000000}}
+    ]})");
+
+    const auto writes = manifest.plan(kDrives);
+    REQUIRE(writes.size() == 2);
+    // sdb is named by the other job and sdc is too small
+    CHECK(writes[1].devices == QStringList({"/dev/sde"}));
+
+    BatchManifest tooMany = d.parse(R"({"jobs": [
+        {"image": "a.img", "match": {"description": "sd card", "count": 4}}
+    ]})");
+    CHECK(tooMany.plan(kDrives).isEmpty());
+
+    BatchManifest noMatch = d.parse(R"({"jobs": [
+        {"image": "a.img", "match": {"description": "nvme"}}
+    ]})");
+    CHECK(noMatch.plan(kDrives).isEmpty());
+}
+
+TEST_CASE("A device rule matches one drive at a time, as station mode checks them", "[batchmanifest]") {
+    ManifestDir d;
+    BatchManifest manifest = d.parse(R"({"jobs": [
+        {"image": "a.img", "match": {"description": "sd card", "min-size": 1000, "max-size": 2000}}
+    ]})");
+    const BatchManifest::DeviceRule &rule = manifest.jobs().first().rule;
+
+    CHECK(rule.matches("Generic SD Card Reader", 1500));
+    CHECK_FALSE(rule.matches("Generic SD Card Reader", 999));
+    CHECK_FALSE(rule.matches("Generic SD Card Reader", 2001));
+    CHECK_FALSE(rule.matches("USB Stick", 1500));
+}
+
+TEST_CASE("Jobs with the same image and customisation share a write", "[batchmanifest]") {
+    ManifestDir d;
+    BatchManifest manifest = d.parse(R"({"jobs": [
+        {"name": "one", "image": "a.img", "devices": ["/dev/sdb"]},
+        {"name": "other", "image": "b.img", "devices": ["/dev/sdc"]},
+        {"name": "custom", "image": "a.img", "devices": ["/dev/sdd"], "first-run-script": "firstrun.sh"},
+        {"name": "two", "image": "a.img", "devices": ["/dev/sde"]}
+    ]})");
+
+    const auto writes = manifest.plan(kDrives);
+    REQUIRE(writes.size() == 3);
+
+    // Both plain a.img jobs are written at once, and the customised a.img
+    // write runs right after it, for the decompressed image cache
+    CHECK(writes[0].devices == QStringList({"/dev/sdb", "/dev/sde"}));
+    CHECK(writes[0].jobOfDevice == QStringList({"one", "two"}));
+    CHECK(writes[1].devices == QStringList({"/dev/sdd"}));
+    CHECK(writes[1].job.firstRunScript == "#!/bin/sh\n");
+    CHECK(writes[2].devices == QStringList({"/dev/sdc"}));
+    CHECK(writes[2].job.name == "other");
+}
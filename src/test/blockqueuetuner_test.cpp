@@ -0,0 +1,122 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for BlockQueueTuner against a fake sysfs tree
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "blockqueuetuner.h"
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QTemporaryDir>
+
+namespace {
+
+void writeFile(const QString &path, const QByteArray &content)
+{
+    QFile file(path);
+    REQUIRE(file.open(QIODevice::WriteOnly));
+    file.write(content);
+}
+
+QByteArray readFile(const QString &path)
+{
+    QFile file(path);
+    REQUIRE(file.open(QIODevice::ReadOnly));
+    return file.readAll().trimmed();
+}
+
+// A USB card reader as it comes up
+QString makeQueue(const QTemporaryDir &dir, const QString &device)
+{
+    const QString queue = dir.filePath(device + "/queue/");
+    REQUIRE(QDir().mkpath(queue));
+    writeFile(queue + "scheduler", "[mq-deadline] kyber none\n");
+    writeFile(queue + "max_sectors_kb", "240\n");
+    writeFile(queue + "max_hw_sectors_kb", "32767\n");
+    writeFile(queue + "nr_requests", "2\n");
+    return queue;
+}
+
+} // namespace
+
+TEST_CASE("Tuning raises the queue limits and restore puts them back", "[blockqueuetuner]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString queue = makeQueue(dir, "sda");
+    QSettings settings(dir.filePath("settings.ini"), QSettings::IniFormat);
+
+    BlockQueueTuner tuner(dir.path());
+    REQUIRE(tuner.tune("sda", settings));
+    CHECK(tuner.isTuned());
+    CHECK(readFile(queue + "scheduler") == "none");
+    CHECK(readFile(queue + "max_sectors_kb") == QByteArray::number(BlockQueueTuner::kMaxSectorsKbLimit));
+    CHECK(readFile(queue + "nr_requests") == QByteArray::number(BlockQueueTuner::kNrRequests));
+
+    CHECK(tuner.before().scheduler == "mq-deadline");
+    CHECK(tuner.before().maxSectorsKb == 240);
+    CHECK(tuner.before().nrRequests == 2);
+    CHECK(tuner.after().scheduler == "none");
+    CHECK(settings.childGroups().contains("queuetuning"));
+
+    tuner.restore(settings);
+    CHECK_FALSE(tuner.isTuned());
+    CHECK(readFile(queue + "scheduler") == "mq-deadline");
+    CHECK(readFile(queue + "max_sectors_kb") == "240");
+    CHECK(readFile(queue + "nr_requests") == "2");
+    settings.beginGroup("queuetuning/journal");
+    CHECK(settings.childGroups().isEmpty());
+    settings.endGroup();
+}
+
+TEST_CASE("A queue left tuned by a crash is restored from the journal", "[blockqueuetuner]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString queue = makeQueue(dir, "sdb");
+
+    {
+        QSettings settings(dir.filePath("settings.ini"), QSettings::IniFormat);
+        BlockQueueTuner tuner(dir.path());
+        REQUIRE(tuner.tune("sdb", settings));
+        // Never restored
+    }
+    CHECK(readFile(queue + "scheduler") == "none");
+
+    QSettings settings(dir.filePath("settings.ini"), QSettings::IniFormat);
+    BlockQueueTuner::restorePending(settings, dir.path());
+    CHECK(readFile(queue + "scheduler") == "mq-deadline");
+    CHECK(readFile(queue + "max_sectors_kb") == "240");
+    CHECK(readFile(queue + "nr_requests") == "2");
+    settings.beginGroup("queuetuning/journal");
+    CHECK(settings.childGroups().isEmpty());
+    settings.endGroup();
+}
+
+TEST_CASE("A queue that is already tuned is left alone", "[blockqueuetuner]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString queue = dir.filePath("nvme0n1/queue/");
+    REQUIRE(QDir().mkpath(queue));
+    writeFile(queue + "scheduler", "[none] mq-deadline\n");
+    writeFile(queue + "max_sectors_kb", "128\n");
+    writeFile(queue + "max_hw_sectors_kb", "128\n");
+    writeFile(queue + "nr_requests", "1023\n");
+    QSettings settings(dir.filePath("settings.ini"), QSettings::IniFormat);
+
+    BlockQueueTuner tuner(dir.path());
+    CHECK_FALSE(tuner.tune("nvme0n1", settings));
+    CHECK_FALSE(tuner.isTuned());
+    CHECK(settings.allKeys().isEmpty());
+}
+
+TEST_CASE("A device without a queue is not tuned", "[blockqueuetuner]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    QSettings settings(dir.filePath("settings.ini"), QSettings::IniFormat);
+
+    BlockQueueTuner tuner(dir.path());
+    CHECK_FALSE(tuner.tune("loop0", settings));
+    CHECK_FALSE(tuner.isTuned());
+}
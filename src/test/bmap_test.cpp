@@ -0,0 +1,125 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for BlockMap extent queries
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "fastboot/bmap.h"
+
+using fastboot::BlockMap;
+using fastboot::BlockRange;
+
+namespace {
+
+// Blocks 10-19 and 30-39 of 50
+BlockMap twoRanges()
+{
+    BlockMap map;
+    map.assign(4096, 50, {BlockRange{10, 20}, BlockRange{30, 40}});
+    return map;
+}
+
+void checkExtent(const BlockMap::Extent &extent, uint64_t begin, uint64_t end, bool mapped, size_t range)
+{
+    CHECK(extent.begin == begin);
+    CHECK(extent.end == end);
+    CHECK(extent.mapped == mapped);
+    CHECK(extent.range == range);
+}
+
+} // namespace
+
+TEST_CASE("extentAt returns the run a block is in", "[bmap]") {
+    const BlockMap map = twoRanges();
+
+    checkExtent(map.extentAt(0), 0, 10, false, 0);
+    checkExtent(map.extentAt(9), 0, 10, false, 0);
+    checkExtent(map.extentAt(10), 10, 20, true, 0);
+    checkExtent(map.extentAt(19), 10, 20, true, 0);
+    checkExtent(map.extentAt(20), 20, 30, false, 1);
+    checkExtent(map.extentAt(35), 30, 40, true, 1);
+    checkExtent(map.extentAt(40), 40, BlockMap::kNoEnd, false, 2);
+    checkExtent(map.extentAt(1000), 40, BlockMap::kNoEnd, false, 2);
+}
+
+TEST_CASE("An empty map is one unmapped extent", "[bmap]") {
+    BlockMap map;
+    checkExtent(map.extentAt(0), 0, BlockMap::kNoEnd, false, 0);
+    checkExtent(map.extentAtSequential(5), 0, BlockMap::kNoEnd, false, 0);
+}
+
+TEST_CASE("Walking extents covers every block once", "[bmap]") {
+    BlockMap map = twoRanges();
+
+    std::vector<std::pair<uint64_t, bool>> runs;
+    for (uint64_t block = 0; block < map.blockCount();) {
+        const auto extent = map.extentAtSequential(block);
+        REQUIRE(extent.begin <= block);
+        REQUIRE(extent.end > block);
+        runs.emplace_back(block, extent.mapped);
+        block = std::min<uint64_t>(extent.end, map.blockCount());
+    }
+    CHECK(runs == std::vector<std::pair<uint64_t, bool>>{{0, false}, {10, true}, {20, false}, {30, true}, {40, false}});
+}
+
+TEST_CASE("extentAtSequential agrees with extentAt", "[bmap]") {
+    BlockMap map = twoRanges();
+    const BlockMap reference = twoRanges();
+
+    // Forwards, with repeats, then backwards
+    for (uint64_t block : {0, 5, 10, 10, 25, 39, 41, 12, 3, 30}) {
+        INFO("block " << block);
+        const auto sequential = map.extentAtSequential(block);
+        const auto direct = reference.extentAt(block);
+        CHECK(sequential.begin == direct.begin);
+        CHECK(sequential.end == direct.end);
+        CHECK(sequential.mapped == direct.mapped);
+        CHECK(sequential.range == direct.range);
+        CHECK(map.isMapped(block) == sequential.mapped);
+    }
+}
+
+TEST_CASE("A growing map extends the extents past its end", "[bmap]") {
+    BlockMap map;
+    map.append(0, 8);
+    checkExtent(map.extentAtSequential(4), 0, 8, true, 0);
+    checkExtent(map.extentAtSequential(8), 8, BlockMap::kNoEnd, false, 1);
+
+    map.append(8, 16);  // Joins the first range
+    checkExtent(map.extentAtSequential(8), 0, 16, true, 0);
+
+    map.append(20, 24);
+    checkExtent(map.extentAtSequential(16), 16, 20, false, 1);
+    checkExtent(map.extentAtSequential(20), 20, 24, true, 1);
+}
+
+TEST_CASE("toXml writes a map that parses back the same", "[bmap]") {
+    BlockMap map = twoRanges();
+    std::array<uint8_t, 32> sha256{};
+    for (size_t i = 0; i < sha256.size(); ++i)
+        sha256[i] = static_cast<uint8_t>(i);
+    map.setChecksum(0, sha256);
+
+    // The last block is partly past the end of the image
+    const std::string xml = map.toXml(50 * 4096 - 512);
+    CHECK(xml.find("<ImageSize>204288</ImageSize>") != std::string::npos);
+    CHECK(xml.find("<ChecksumType>sha256</ChecksumType>") != std::string::npos);
+    CHECK(xml.find("<BmapFileChecksum>0000") == std::string::npos);
+
+    BlockMap parsed;
+    std::string error;
+    REQUIRE(parsed.parse(xml, &error));
+    CHECK(parsed.blockSize() == 4096);
+    CHECK(parsed.blockCount() == 50);
+    CHECK(parsed.mappedBlockCount() == 20);
+    REQUIRE(parsed.ranges().size() == 2);
+    CHECK(parsed.ranges()[0].begin == 10);
+    CHECK(parsed.ranges()[0].end == 20);
+    CHECK(parsed.ranges()[0].hasSha256);
+    CHECK(parsed.ranges()[0].sha256 == sha256);
+    CHECK(parsed.ranges()[1].begin == 30);
+    CHECK(parsed.ranges()[1].end == 40);
+    CHECK_FALSE(parsed.ranges()[1].hasSha256);
+}
@@ -0,0 +1,120 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the in-memory boot.img builder: images are read back with
+ * DeviceWrapperFatPartition, as the secure boot path does with the card
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "bootimgcreator.h"
+#include "devicewrapper.h"
+#include "devicewrapperfatpartition.h"
+#include "file_operations_memory.h"
+
+#include <QStringList>
+
+using rpi_imager::FileError;
+using rpi_imager::MemoryFileOperations;
+
+namespace {
+
+constexpr qint64 kImageSize = 33LL * 1024 * 1024;
+
+QByteArray pattern(int size, char seed)
+{
+    QByteArray data(size, 0);
+    for (int i = 0; i < size; i++)
+        data[i] = char(seed + i * 7);
+    return data;
+}
+
+struct MountedImage {
+    MemoryFileOperations disk;
+    std::unique_ptr<DeviceWrapper> wrapper;
+    std::unique_ptr<DeviceWrapperFatPartition> fat;
+
+    explicit MountedImage(const QByteArray &image)
+    {
+        REQUIRE(disk.CreateTestFile("boot.img", quint64(image.size())) == FileError::kSuccess);
+        REQUIRE(disk.WriteAtOffset(0, reinterpret_cast<const std::uint8_t *>(image.constData()),
+                                   size_t(image.size())) == FileError::kSuccess);
+        wrapper = std::make_unique<DeviceWrapper>(&disk);
+        fat = std::make_unique<DeviceWrapperFatPartition>(wrapper.get(), 0, quint64(image.size()));
+    }
+};
+
+} // namespace
+
+TEST_CASE("boot.img files read back with their names and contents", "[bootimgcreator]") {
+    QMap<QString, QByteArray> files;
+    files["config.txt"] = "dtparam=audio=on\n";
+    files["start4.elf"] = pattern(300 * 1024, 1);  // Many clusters
+    files["kernel_2712.img"] = pattern(5000, 2);   // Long name
+    files["Cmdline.txt"] = "console=serial0\n";    // Mixed case needs a long name
+    files["overlays/README"] = "overlays\n";
+    files["overlays/vc4-kms-v3d-pi5.dtbo"] = pattern(2000, 3);
+    files["overlays/sub dir/deeper.txt"] = "deep\n";
+
+    const QByteArray image = BootImgCreator::createBootImg(files, kImageSize);
+    REQUIRE(image.size() == kImageSize);
+
+    MountedImage mounted(image);
+    QStringList listed = mounted.fat->listAllFilesRecursive();
+    listed.sort();
+    // Plain 8.3 names are listed in lower case, like any other FAT reader here
+    CHECK(listed == QStringList({"Cmdline.txt", "config.txt", "kernel_2712.img",
+                                 "overlays/readme", "overlays/sub dir/deeper.txt",
+                                 "overlays/vc4-kms-v3d-pi5.dtbo", "start4.elf"}));
+
+    CHECK(mounted.fat->readFile("config.txt") == files["config.txt"]);
+    CHECK(mounted.fat->readFile("start4.elf") == files["start4.elf"]);
+    CHECK(mounted.fat->readFile("kernel_2712.img") == files["kernel_2712.img"]);
+    CHECK(mounted.fat->readFile("Cmdline.txt") == files["Cmdline.txt"]);
+    CHECK(mounted.fat->readFile("overlays/vc4-kms-v3d-pi5.dtbo") == files["overlays/vc4-kms-v3d-pi5.dtbo"]);
+}
+
+TEST_CASE("boot.img directories that span clusters get unique short names", "[bootimgcreator]") {
+    // Shared prefixes need numeric tails, and the LFN entries fill several
+    // 512-byte clusters of the directory
+    QMap<QString, QByteArray> files;
+    for (int i = 0; i < 40; i++)
+        files[QString("overlays/overlay-number-%1.dtbo").arg(i)] = pattern(100 + i, char(i));
+
+    MountedImage mounted(BootImgCreator::createBootImg(files, kImageSize));
+    QStringList listed = mounted.fat->listAllFilesRecursive();
+    CHECK(listed.size() == files.size());
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        CHECK(listed.contains(it.key()));
+        CHECK(mounted.fat->readFile(it.key()) == it.value());
+    }
+}
+
+TEST_CASE("boot.img is deterministic", "[bootimgcreator]") {
+    QMap<QString, QByteArray> files;
+    files["config.txt"] = "arm_64bit=1\n";
+    files["overlays/disable-bt.dtbo"] = pattern(1500, 4);
+
+    CHECK(BootImgCreator::createBootImg(files, kImageSize) == BootImgCreator::createBootImg(files, kImageSize));
+}
+
+TEST_CASE("boot.img rejects bad input", "[bootimgcreator]") {
+    QMap<QString, QByteArray> files;
+    files["config.txt"] = "x";
+
+    CHECK(BootImgCreator::createBootImg({}, kImageSize).isEmpty());
+    CHECK(BootImgCreator::createBootImg(files, 16LL * 1024 * 1024).isEmpty());  // Too small for FAT32
+    CHECK(BootImgCreator::createBootImg(files, kImageSize + 1).isEmpty());     // Not whole sectors
+
+    QMap<QString, QByteArray> clash = files;
+    clash["CONFIG.TXT"] = "y";  // Same name on FAT
+    CHECK(BootImgCreator::createBootImg(clash, kImageSize).isEmpty());
+
+    QMap<QString, QByteArray> fileAsDir = files;
+    fileAsDir["config.txt/x"] = "z";
+    CHECK(BootImgCreator::createBootImg(fileAsDir, kImageSize).isEmpty());
+
+    QMap<QString, QByteArray> tooBig;
+    tooBig["big.bin"] = QByteArray(int(kImageSize), 'a');
+    CHECK(BootImgCreator::createBootImg(tooBig, kImageSize).isEmpty());
+}
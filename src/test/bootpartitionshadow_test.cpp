@@ -0,0 +1,115 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the in-memory copy of the boot partition used for in-flight
+ * customisation: an MBR image with a FAT boot partition is streamed in
+ * pieces, as DownloadThread sees it, customised and read back
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "bootpartitionshadow.h"
+#include "bootimgcreator.h"
+#include "devicewrapper.h"
+#include "devicewrapperfatpartition.h"
+#include "devicewrapperstructs.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kFirstBlockSize = 64 * 1024;
+constexpr quint32 kPartitionStartSector = 8192;  // 4 MiB
+constexpr qint64 kPartitionSize = 33LL * 1024 * 1024;
+
+QByteArray firstBlock(quint32 startSector, quint32 sectors)
+{
+    QByteArray block(int(kFirstBlockSize), 0);
+    mbr_table mbr;
+    std::memset(&mbr, 0, sizeof(mbr));
+    mbr.part[0].id = 0x0c;
+    mbr.part[0].starting_sector = startSector;
+    mbr.part[0].nr_of_sectors = sectors;
+    mbr.signature[0] = 0x55;
+    mbr.signature[1] = 0xAA;
+    std::memcpy(block.data(), &mbr, sizeof(mbr));
+    return block;
+}
+
+QByteArray bootPartition()
+{
+    QMap<QString, QByteArray> files;
+    files["config.txt"] = "dtparam=audio=on\n";
+    files["cmdline.txt"] = "console=serial0,115200 root=PARTUUID=1234-02\n";
+    return BootImgCreator::createBootImg(files, kPartitionSize);
+}
+
+} // namespace
+
+TEST_CASE("Boot partition is found in the first block", "[bootpartitionshadow]") {
+    BootPartitionShadow shadow;
+    const QByteArray block = firstBlock(kPartitionStartSector, kPartitionSize / 512);
+    REQUIRE(shadow.open(block.constData(), size_t(block.size())));
+    CHECK(shadow.start() == quint64(kPartitionStartSector) * 512);
+    CHECK(shadow.end() == shadow.start() + quint64(kPartitionSize));
+    CHECK(shadow.captured() == 0);
+    CHECK_FALSE(shadow.complete());
+}
+
+TEST_CASE("Unsuitable partitions are not held back", "[bootpartitionshadow]") {
+    BootPartitionShadow shadow;
+
+    QByteArray noTable(int(kFirstBlockSize), 0);
+    CHECK_FALSE(shadow.open(noTable.constData(), size_t(noTable.size())));
+
+    // Starts inside the first block, which is written last
+    QByteArray early = firstBlock(8, kPartitionSize / 512);
+    CHECK_FALSE(shadow.open(early.constData(), size_t(early.size())));
+
+    QByteArray huge = firstBlock(kPartitionStartSector, quint32((BootPartitionShadow::kMaxPartitionSize / 512) + 1));
+    CHECK_FALSE(shadow.open(huge.constData(), size_t(huge.size())));
+}
+
+TEST_CASE("Captured boot partition is customised in memory", "[bootpartitionshadow]") {
+    BootPartitionShadow shadow;
+    const QByteArray block = firstBlock(kPartitionStartSector, kPartitionSize / 512);
+    REQUIRE(shadow.open(block.constData(), size_t(block.size())));
+
+    // Streamed in uneven pieces, as decompressed data arrives
+    const QByteArray partition = bootPartition();
+    REQUIRE(partition.size() == kPartitionSize);
+    const size_t pieceSize = 3 * 1024 * 1024 + 512;
+    for (size_t done = 0; done < size_t(partition.size()); done += pieceSize)
+    {
+        CHECK_FALSE(shadow.complete());
+        const size_t len = std::min(pieceSize, size_t(partition.size()) - done);
+        REQUIRE(shadow.capture(partition.constData() + done, len));
+    }
+    CHECK(shadow.complete());
+    CHECK_FALSE(shadow.capture("x", 1));  // Past the end of the partition
+
+    {
+        DeviceWrapper dw(shadow.file());
+        DeviceWrapperFatPartition *fat = dw.fatPartition(1);
+        QByteArray cmdline = fat->readFile("cmdline.txt").trimmed();
+        fat->writeFile("cmdline.txt", cmdline + " cfg80211.ieee80211_regdom=GB\n");
+        fat->writeFile("firstrun.sh", "#!/bin/bash\n");
+        dw.sync();
+    }
+
+    // Read back as DownloadThread writes it out, and mount the result
+    QByteArray customised(int(kPartitionSize), 0);
+    REQUIRE(shadow.read(shadow.start(), customised.data(), size_t(customised.size())));
+    CHECK(customised != partition);
+
+    rpi_imager::MemoryFileOperations disk;
+    REQUIRE(disk.CreateTestFile("boot.img", quint64(kPartitionSize)) == rpi_imager::FileError::kSuccess);
+    REQUIRE(disk.WriteAtOffset(0, reinterpret_cast<const std::uint8_t *>(customised.constData()),
+                               size_t(customised.size())) == rpi_imager::FileError::kSuccess);
+    DeviceWrapper dw(&disk);
+    DeviceWrapperFatPartition fat(&dw, 0, quint64(kPartitionSize));
+    CHECK(fat.readFile("cmdline.txt") == "console=serial0,115200 root=PARTUUID=1234-02 cfg80211.ieee80211_regdom=GB\n");
+    CHECK(fat.readFile("firstrun.sh") == "#!/bin/bash\n");
+    CHECK(fat.readFile("config.txt") == "dtparam=audio=on\n");
+}
@@ -0,0 +1,199 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Unit tests for the one producer / many consumers BroadcastRingBuffer.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "broadcastringbuffer.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+TEST_CASE("BroadcastRingBuffer gives every consumer every slot", "[broadcastringbuffer]")
+{
+    BroadcastRingBuffer rb(4, 64, 64);
+    const int a = rb.addConsumer("hasher");
+    const int b = rb.addConsumer("device");
+    REQUIRE(a == 0);
+    REQUIRE(b == 1);
+
+    for (int i = 0; i < 4; ++i) {
+        BroadcastRingBuffer::Slot* slot = rb.acquireWriteSlot(10);
+        REQUIRE(slot != nullptr);
+        slot->data[0] = static_cast<char>(i);
+        rb.commitWriteSlot(slot, 1);
+    }
+
+    // One consumer reading everything frees nothing
+    for (int i = 0; i < 4; ++i) {
+        const BroadcastRingBuffer::Slot* slot = rb.acquireReadSlot(a, 10);
+        REQUIRE(slot != nullptr);
+        CHECK(slot->data[0] == static_cast<char>(i));
+        rb.releaseReadSlot(a, slot);
+    }
+    CHECK(rb.acquireReadSlot(a, 10) == nullptr);
+    CHECK(rb.acquireWriteSlot(10) == nullptr);
+    CHECK(rb.slowestConsumer() == b);
+
+    // The other consumer's release hands the slot back
+    const BroadcastRingBuffer::Slot* slot = rb.acquireReadSlot(b, 10);
+    REQUIRE(slot != nullptr);
+    CHECK(slot->data[0] == 0);
+    rb.releaseReadSlot(b, slot);
+    CHECK(rb.acquireWriteSlot(10) != nullptr);
+
+    auto stats = rb.getConsumerStats();
+    REQUIRE(stats.size() == 2);
+    CHECK(stats[0].name == QString("hasher"));
+    CHECK(stats[0].slotsRead == 4);
+    CHECK(stats[0].bytesRead == 4);
+    CHECK(stats[0].lagSlots == 0);
+    CHECK(stats[1].lagSlots == 3);
+    CHECK(stats[1].maxLagSlots == 4);
+    CHECK(stats[1].blockingStalls == 1);
+    CHECK(stats[0].blockingStalls == 0);
+}
+
+TEST_CASE("BroadcastRingBuffer carries on without a detached consumer", "[broadcastringbuffer]")
+{
+    BroadcastRingBuffer rb(2, 64, 64);
+    const int ok = rb.addConsumer("cache");
+    const int failed = rb.addConsumer("device");
+
+    for (int i = 0; i < 2; ++i) {
+        BroadcastRingBuffer::Slot* slot = rb.acquireWriteSlot(10);
+        REQUIRE(slot != nullptr);
+        rb.commitWriteSlot(slot, 8);
+    }
+
+    const BroadcastRingBuffer::Slot* slot = rb.acquireReadSlot(ok, 10);
+    REQUIRE(slot != nullptr);
+    rb.releaseReadSlot(ok, slot);
+    REQUIRE(rb.acquireReadSlot(failed, 10) != nullptr);
+
+    // The producer is blocked on the failed consumer until it is detached
+    bool produced = false;
+    std::thread producer([&rb, &produced] {
+        BroadcastRingBuffer::Slot* slot = rb.acquireWriteSlot();
+        if (slot) {
+            rb.commitWriteSlot(slot, 8);
+            produced = true;
+        }
+        rb.producerDone();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    rb.detachConsumer(failed);
+    producer.join();
+
+    CHECK(produced);
+    CHECK(rb.acquireReadSlot(failed, 10) == nullptr);
+    CHECK(rb.attachedConsumers() == 1);
+
+    int read = 0;
+    while ((slot = rb.acquireReadSlot(ok, 10)) != nullptr) {
+        rb.releaseReadSlot(ok, slot);
+        ++read;
+    }
+    CHECK(read == 2);
+    CHECK(rb.isComplete(ok));
+
+    auto stats = rb.getConsumerStats();
+    CHECK(stats[failed].detached);
+    CHECK(stats[failed].blockingStalls == 1);
+    CHECK(stats[failed].blockingMs >= 50);
+
+    // Long enough to be a stall event, blamed on the consumer that held it up
+    auto events = rb.getPendingStallEvents();
+    REQUIRE(events.size() == 1);
+    CHECK(events[0].isProducer);
+    CHECK(events[0].consumer == failed);
+}
+
+TEST_CASE("BroadcastRingBuffer stops producing without consumers", "[broadcastringbuffer]")
+{
+    BroadcastRingBuffer rb(2, 64, 64);
+    const int only = rb.addConsumer("device");
+    rb.detachConsumer(only);
+    CHECK(rb.acquireWriteSlot(10) == nullptr);
+    CHECK(rb.slowestConsumer() == -1);
+
+    // Too late to join once the producer has started
+    CHECK(rb.addConsumer("late") == -1);
+}
+
+TEST_CASE("BroadcastRingBuffer cancel wakes blocked consumers", "[broadcastringbuffer]")
+{
+    BroadcastRingBuffer rb(2, 64, 64);
+    const int a = rb.addConsumer("a");
+    const int b = rb.addConsumer("b");
+
+    const BroadcastRingBuffer::Slot* first = nullptr;
+    const BroadcastRingBuffer::Slot* second = nullptr;
+    std::thread firstReader([&] { first = rb.acquireReadSlot(a); });
+    std::thread secondReader([&] { second = rb.acquireReadSlot(b); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    rb.cancel();
+    firstReader.join();
+    secondReader.join();
+    CHECK(first == nullptr);
+    CHECK(second == nullptr);
+    CHECK(rb.isCancelled());
+}
+
+TEST_CASE("BroadcastRingBuffer transfers data to consumers at different speeds", "[broadcastringbuffer]")
+{
+    constexpr int Blocks = 500;
+    constexpr size_t SlotSize = 4096;
+    BroadcastRingBuffer rb(8, SlotSize, 4096);
+    const int consumers[] = {rb.addConsumer("fast"), rb.addConsumer("slow"), rb.addConsumer("sparse")};
+
+    std::thread producer([&rb] {
+        for (int i = 0; i < Blocks; ++i) {
+            BroadcastRingBuffer::Slot* slot = rb.acquireWriteSlot();
+            if (!slot) {
+                break;
+            }
+            std::memset(slot->data, i & 0xFF, SlotSize);
+            rb.commitWriteSlot(slot, SlotSize - static_cast<size_t>(i % 7));
+        }
+        rb.producerDone();
+    });
+
+    int counts[3] = {0, 0, 0};
+    bool intact[3] = {true, true, true};
+    std::vector<std::thread> readers;
+    for (int c = 0; c < 3; ++c) {
+        readers.emplace_back([&, c] {
+            const BroadcastRingBuffer::Slot* slot;
+            while ((slot = rb.acquireReadSlot(consumers[c])) != nullptr) {
+                const int i = counts[c]++;
+                if (slot->size != SlotSize - static_cast<size_t>(i % 7) ||
+                    static_cast<unsigned char>(slot->data[slot->size - 1]) != (i & 0xFF)) {
+                    intact[c] = false;
+                }
+                if (c == 1 && i % 50 == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                rb.releaseReadSlot(consumers[c], slot);
+            }
+        });
+    }
+
+    producer.join();
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        CHECK(counts[c] == Blocks);
+        CHECK(intact[c]);
+        CHECK(rb.isComplete(consumers[c]));
+    }
+    CHECK_FALSE(rb.isStallTimeoutExceeded());
+}
@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Unit tests for the process-wide BufferPool.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "bufferpool.h"
+
+#include <cstring>
+#include <thread>
+
+namespace {
+
+constexpr size_t KB = 1024;
+constexpr size_t MB = 1024 * 1024;
+
+} // namespace
+
+TEST_CASE("BufferPool rounds sizes up to quarter power of two classes", "[bufferpool]")
+{
+    CHECK(BufferPool::sizeClass(1) == 4 * KB);
+    CHECK(BufferPool::sizeClass(4 * KB) == 4 * KB);
+    CHECK(BufferPool::sizeClass(4 * KB + 1) == 5 * KB);
+    CHECK(BufferPool::sizeClass(3 * MB) == 3 * MB);
+    CHECK(BufferPool::sizeClass(4 * MB) == 4 * MB);
+    CHECK(BufferPool::sizeClass(4 * MB + 1) == 5 * MB);
+    CHECK(BufferPool::sizeClass(9 * MB) == 10 * MB);
+}
+
+TEST_CASE("BufferPool reuses returned buffers of the same class", "[bufferpool]")
+{
+    BufferPool pool(16 * MB);
+
+    char* first = nullptr;
+    {
+        BufferPool::Buffer buffer = pool.acquire(MB, 4096);
+        REQUIRE(buffer);
+        CHECK(buffer.capacity() == MB);
+        CHECK(reinterpret_cast<uintptr_t>(buffer.data()) % 4096 == 0);
+        std::memset(buffer.data(), 0x5A, buffer.capacity());
+        first = buffer.data();
+        CHECK(pool.stats().inUse == MB);
+    }
+    CHECK(pool.stats().inUse == 0);
+    CHECK(pool.stats().cached == MB);
+
+    BufferPool::Buffer again = pool.acquire(MB - 100, 4096);
+    REQUIRE(again);
+    CHECK(again.data() == first);
+    CHECK(pool.stats().reused == 1);
+
+    pool.trim();
+    CHECK(pool.stats().cached == 0);
+}
+
+TEST_CASE("BufferPool keeps borrowed and cached memory under the limit", "[bufferpool]")
+{
+    BufferPool pool(4 * MB);
+
+    BufferPool::Buffer a = pool.acquire(2 * MB);
+    BufferPool::Buffer b = pool.acquire(MB);
+    REQUIRE(a);
+    REQUIRE(b);
+
+    // Over the limit and nothing to give back
+    CHECK_FALSE(pool.acquire(2 * MB));
+    CHECK(pool.stats().failures == 1);
+
+    // A cached buffer of another class is freed to make room
+    b.release();
+    CHECK(pool.stats().cached == MB);
+    BufferPool::Buffer c = pool.acquire(2 * MB);
+    REQUIRE(c);
+    CHECK(pool.stats().cached == 0);
+    CHECK(pool.stats().inUse == 4 * MB);
+    CHECK(pool.stats().peak <= 4 * MB);
+}
+
+TEST_CASE("BufferPool waits for another stage to return memory", "[bufferpool]")
+{
+    BufferPool pool(2 * MB);
+    BufferPool::Buffer held = pool.acquire(2 * MB);
+    REQUIRE(held);
+
+    std::thread returner([&held]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        held.release();
+    });
+
+    BufferPool::Buffer waited = pool.acquire(2 * MB, 4096, 5000);
+    returner.join();
+    CHECK(waited);
+    CHECK(pool.stats().waits == 1);
+}
+
+TEST_CASE("BufferPool without a limit does not cache", "[bufferpool]")
+{
+    BufferPool pool;
+    {
+        BufferPool::Buffer buffer = pool.acquire(64 * KB);
+        REQUIRE(buffer);
+    }
+    CHECK(pool.stats().cached == 0);
+    CHECK(pool.stats().inUse == 0);
+}
@@ -0,0 +1,168 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for sharing the download cache on the LAN: the mDNS messages
+ * peers are found with, and the HTTP server they download from
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "cachepeer.h"
+#include "mdnsmessage.h"
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QTcpSocket>
+#include <QTemporaryFile>
+#include <QTimer>
+
+namespace {
+
+QCoreApplication *app()
+{
+    static int argc = 1;
+    static char name[] = "cachepeer_test";
+    static char *argv[] = {name, nullptr};
+    static QCoreApplication *instance = new QCoreApplication(argc, argv);
+    return instance;
+}
+
+// Send a raw request and read until the server closes the connection
+QByteArray request(quint16 port, const QByteArray &raw)
+{
+    QTcpSocket socket;
+    QByteArray response;
+    QEventLoop loop;
+    QObject::connect(&socket, &QTcpSocket::connected, [&]() { socket.write(raw); });
+    QObject::connect(&socket, &QTcpSocket::readyRead, [&]() { response += socket.readAll(); });
+    QObject::connect(&socket, &QTcpSocket::disconnected, &loop, &QEventLoop::quit);
+    QTimer::singleShot(5000, &loop, &QEventLoop::quit);
+    socket.connectToHost(QHostAddress::LocalHost, port);
+    loop.exec();
+    return response;
+}
+
+QByteArray body(const QByteArray &response)
+{
+    return response.mid(response.indexOf("\r\n\r\n") + 4);
+}
+
+const QByteArray kHash = QByteArray(64, 'a');
+
+} // namespace
+
+TEST_CASE("mDNS service announcement round trip", "[cachepeer]") {
+    QList<MdnsMessage::Record> records;
+    MdnsMessage::Record ptr;
+    ptr.name = CachePeer::kServiceType;
+    ptr.type = MdnsMessage::PTR;
+    ptr.target = QByteArray("station-1.") + CachePeer::kServiceType;
+    records.append(ptr);
+
+    MdnsMessage::Record srv;
+    srv.name = ptr.target;
+    srv.type = MdnsMessage::SRV;
+    srv.port = 8123;
+    srv.target = "station-1.local";
+    records.append(srv);
+
+    MdnsMessage::Record txt;
+    txt.name = ptr.target;
+    txt.type = MdnsMessage::TXT;
+    txt.text = {"path=/cache/"};
+    records.append(txt);
+
+    MdnsMessage::Record a;
+    a.name = "station-1.local";
+    a.type = MdnsMessage::A;
+    a.address = QHostAddress("192.168.1.20");
+    records.append(a);
+
+    MdnsMessage::Message message;
+    REQUIRE(MdnsMessage::parse(MdnsMessage::response(records, 77), message));
+    CHECK(message.response);
+    CHECK(message.id == 77);
+    REQUIRE(message.records.size() == 4);
+    CHECK(message.records[0].target == ptr.target);
+    CHECK(message.records[1].port == 8123);
+    CHECK(message.records[1].target == "station-1.local");
+    CHECK(message.records[2].text == QList<QByteArray>{"path=/cache/"});
+    CHECK(message.records[3].address == QHostAddress("192.168.1.20"));
+
+    REQUIRE(MdnsMessage::parse(MdnsMessage::query(CachePeer::kServiceType, MdnsMessage::PTR, 5), message));
+    CHECK_FALSE(message.response);
+    CHECK(message.questions == QList<QByteArray>{CachePeer::kServiceType});
+}
+
+TEST_CASE("mDNS names are decompressed and bad packets rejected", "[cachepeer]") {
+    // Answer to "_x._tcp.local" PTR "a._x._tcp.local", the target
+    // compressed to a pointer to the record name at offset 12
+    QByteArray packet = QByteArray::fromHex("000084000000000100000000");
+    packet += QByteArray::fromHex("025f78045f746370056c6f63616c00");  // _x._tcp.local
+    packet += QByteArray::fromHex("000c0001000000780004");             // PTR IN ttl 120, 4 bytes
+    packet += QByteArray::fromHex("0161c00c");                         // a + pointer
+    MdnsMessage::Message message;
+    REQUIRE(MdnsMessage::parse(packet, message));
+    REQUIRE(message.records.size() == 1);
+    CHECK(message.records[0].name == "_x._tcp.local");
+    CHECK(message.records[0].target == "a._x._tcp.local");
+
+    CHECK_FALSE(MdnsMessage::parse(packet.left(packet.size() - 2), message));
+
+    // A pointer to itself
+    QByteArray loop = QByteArray::fromHex("000084000000000100000000");
+    loop += QByteArray::fromHex("c00c");
+    CHECK_FALSE(MdnsMessage::parse(loop, message));
+}
+
+TEST_CASE("Range headers", "[cachepeer]") {
+    using Range = CachePeerServer::Range;
+    qint64 first = -1, last = -1;
+    CHECK(CachePeerServer::parseRange("", 1000, first, last) == Range::None);
+    CHECK(CachePeerServer::parseRange("bytes=0-99,200-299", 1000, first, last) == Range::None);
+
+    REQUIRE(CachePeerServer::parseRange("bytes=100-199", 1000, first, last) == Range::Valid);
+    CHECK((first == 100 && last == 199));
+    REQUIRE(CachePeerServer::parseRange("bytes=900-", 1000, first, last) == Range::Valid);
+    CHECK((first == 900 && last == 999));
+    REQUIRE(CachePeerServer::parseRange("bytes=-10", 1000, first, last) == Range::Valid);
+    CHECK((first == 990 && last == 999));
+    REQUIRE(CachePeerServer::parseRange("bytes=500-5000", 1000, first, last) == Range::Valid);
+    CHECK((first == 500 && last == 999));
+
+    CHECK(CachePeerServer::parseRange("bytes=1000-", 1000, first, last) == Range::Unsatisfiable);
+    CHECK(CachePeerServer::parseRange("bytes=20-10", 1000, first, last) == Range::Unsatisfiable);
+}
+
+TEST_CASE("Cache entries are served with ranges", "[cachepeer]") {
+    app();
+    QTemporaryFile file;
+    REQUIRE(file.open());
+    QByteArray data;
+    for (int i = 0; i < 1024 * 1024; i++)
+        data.append(char(i * 7));
+    file.write(data);
+    file.flush();
+
+    CachePeerServer server([&](const QByteArray &sha256) {
+        return sha256 == kHash ? file.fileName() : QString();
+    });
+    REQUIRE(server.listen());
+
+    QByteArray response = request(server.port(), "GET /cache/" + kHash + " HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK(response.startsWith("HTTP/1.1 200 OK\r\n"));
+    CHECK(body(response) == data);
+
+    response = request(server.port(), "GET /cache/" + kHash + " HTTP/1.1\r\nRange: bytes=1000-\r\n\r\n");
+    CHECK(response.startsWith("HTTP/1.1 206 Partial Content\r\n"));
+    CHECK(response.contains("Content-Range: bytes 1000-1048575/1048576\r\n"));
+    CHECK(body(response) == data.mid(1000));
+
+    response = request(server.port(), "HEAD /cache/" + kHash + " HTTP/1.1\r\n\r\n");
+    CHECK(response.contains("Content-Length: 1048576\r\n"));
+    CHECK(body(response).isEmpty());
+
+    CHECK(request(server.port(), "GET /cache/" + QByteArray(64, 'b') + " HTTP/1.1\r\n\r\n").startsWith("HTTP/1.1 404"));
+    CHECK(request(server.port(), "GET /etc/passwd HTTP/1.1\r\n\r\n").startsWith("HTTP/1.1 404"));
+    CHECK(request(server.port(), "POST /cache/" + kHash + " HTTP/1.1\r\n\r\n").startsWith("HTTP/1.1 405"));
+}
@@ -0,0 +1,102 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the fake-capacity probe run before writing
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "capacityprobe.h"
+#include "file_operations_memory.h"
+
+#include <vector>
+
+using rpi_imager::FileError;
+using rpi_imager::MemoryFileOperations;
+
+namespace {
+
+constexpr std::size_t kTag = 4096;
+constexpr std::uint64_t MiB = 1024 * 1024;
+
+// A fake card: reports the ramdisk size but only holds realSize bytes
+class FakeCapacityDevice : public MemoryFileOperations {
+ public:
+  enum class Behaviour { kWrap, kRejectWrites };
+
+  FakeCapacityDevice(std::uint64_t realSize, Behaviour behaviour)
+      : real_size_(realSize), behaviour_(behaviour) {}
+
+  FileError WriteAtOffset(std::uint64_t offset, const std::uint8_t* data, std::size_t size) override {
+    if (offset >= real_size_ && behaviour_ == Behaviour::kRejectWrites)
+      return FileError::kWriteError;
+    return MemoryFileOperations::WriteAtOffset(offset % real_size_, data, size);
+  }
+
+  FileError ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                         std::size_t size, std::size_t& bytes_read) override {
+    return MemoryFileOperations::ReadAtOffset(offset % real_size_, data, size, bytes_read);
+  }
+
+ private:
+  std::uint64_t real_size_;
+  Behaviour behaviour_;
+};
+
+} // namespace
+
+TEST_CASE("Probe offsets are powers of two and the end of the device", "[capacityprobe]") {
+    const auto offsets = CapacityProbe::offsets(1024 * MiB, kTag);
+    const std::vector<std::uint64_t> expected = {16 * MiB, 32 * MiB, 64 * MiB, 128 * MiB, 256 * MiB,
+                                                 512 * MiB, 1024 * MiB - kTag};
+    CHECK(offsets == expected);
+
+    // Too small to probe
+    CHECK(CapacityProbe::offsets(16 * MiB, kTag).empty());
+}
+
+TEST_CASE("Tags differ by offset and nonce", "[capacityprobe]") {
+    std::vector<std::uint8_t> a(kTag), b(kTag), c(kTag);
+    CapacityProbe::fillTag(a.data(), kTag, 16 * MiB, 1);
+    CapacityProbe::fillTag(b.data(), kTag, 32 * MiB, 1);
+    CapacityProbe::fillTag(c.data(), kTag, 16 * MiB, 2);
+    CHECK(a != b);
+    CHECK(a != c);
+
+    CapacityProbe::fillTag(b.data(), kTag, 16 * MiB, 1);
+    CHECK(a == b);
+}
+
+TEST_CASE("A genuine device passes", "[capacityprobe]") {
+    MemoryFileOperations file;
+    REQUIRE(file.OpenDevice("ramdisk:1G") == FileError::kSuccess);
+
+    const auto result = CapacityProbe::run(file, 1024 * MiB, kTag, 42);
+    CHECK(result.ok);
+    CHECK_FALSE(result.ioError);
+    CHECK(result.capacity == 1024 * MiB);
+    CHECK(result.probes == 7);
+    CHECK(result.failed == 0);
+}
+
+TEST_CASE("A device that wraps at its real size is caught", "[capacityprobe]") {
+    FakeCapacityDevice file(128 * MiB, FakeCapacityDevice::Behaviour::kWrap);
+    REQUIRE(file.OpenDevice("ramdisk:1G") == FileError::kSuccess);
+
+    const auto result = CapacityProbe::run(file, 1024 * MiB, kTag, 42);
+    CHECK_FALSE(result.ok);
+    CHECK_FALSE(result.ioError);
+    CHECK(result.capacity == 128 * MiB);
+    // 128, 256 and 512 MB all land on offset 0; only the last of them survives
+    CHECK(result.failed == 2);
+}
+
+TEST_CASE("A device that refuses writes past its real size is caught", "[capacityprobe]") {
+    FakeCapacityDevice file(100 * MiB, FakeCapacityDevice::Behaviour::kRejectWrites);
+    REQUIRE(file.OpenDevice("ramdisk:1G") == FileError::kSuccess);
+
+    const auto result = CapacityProbe::run(file, 1024 * MiB, kTag, 42);
+    CHECK_FALSE(result.ok);
+    CHECK(result.capacity == 128 * MiB);
+    CHECK(result.failed == 4);
+}
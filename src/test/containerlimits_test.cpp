@@ -0,0 +1,144 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for reading container (cgroup) memory and CPU limits
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "containerlimits.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace {
+
+// A cgroup filesystem laid out under a temporary directory
+struct FakeCgroupFs {
+    std::filesystem::path root;
+
+    FakeCgroupFs()
+    {
+        root = std::filesystem::temp_directory_path()
+             / ("containerlimits_test_" + std::to_string(std::random_device{}()));
+        std::filesystem::create_directories(root);
+    }
+    ~FakeCgroupFs() { std::filesystem::remove_all(root); }
+
+    void write(const std::string &relative, const std::string &text) const
+    {
+        const std::filesystem::path path = root / relative;
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path) << text;
+    }
+    std::string cgroupRoot() const { return (root / "sys").string(); }
+    std::string procCgroup() const { return (root / "proc_self_cgroup").string(); }
+};
+
+} // namespace
+
+TEST_CASE("Limit files parse", "[containerlimits]") {
+    CHECK(ContainerLimits::parseMemoryLimit("max\n") == ContainerLimits::Unlimited);
+    CHECK(ContainerLimits::parseMemoryLimit("2147483648\n") == 2147483648LL);
+    // cgroup v1 without a limit
+    CHECK(ContainerLimits::parseMemoryLimit("9223372036854771712\n") == ContainerLimits::Unlimited);
+    CHECK(ContainerLimits::parseMemoryLimit("") == ContainerLimits::Unlimited);
+
+    CHECK(ContainerLimits::parseCpuMax("max 100000\n") == 0);
+    CHECK(ContainerLimits::parseCpuMax("200000 100000\n") == 2.0);
+    CHECK(ContainerLimits::parseCpuMax("150000 100000\n") == 1.5);
+    CHECK(ContainerLimits::parseCpuMax("") == 0);
+
+    CHECK(ContainerLimits::parseMemoryStat("anon 100\nfile 300\ninactive_file 200\n", "inactive_file") == 200);
+    CHECK(ContainerLimits::parseMemoryStat("anon 100\n", "inactive_file") == 0);
+}
+
+TEST_CASE("CPU count honours affinity and quota", "[containerlimits]") {
+    ContainerLimits::Limits limits;
+    CHECK(ContainerLimits::cpuCount(limits, 16) == 16);
+    CHECK(ContainerLimits::cpuCount(limits, 0) == 1);
+
+    limits.affinityCpus = 8;
+    CHECK(ContainerLimits::cpuCount(limits, 16) == 8);
+    limits.cpuQuota = 2.0;
+    CHECK(ContainerLimits::cpuCount(limits, 16) == 2);
+    // Part of a CPU still gets a thread
+    limits.cpuQuota = 1.5;
+    CHECK(ContainerLimits::cpuCount(limits, 16) == 2);
+    limits.cpuQuota = 0.25;
+    CHECK(ContainerLimits::cpuCount(limits, 16) == 1);
+}
+
+TEST_CASE("Available memory is what is left under the limit", "[containerlimits]") {
+    ContainerLimits::Limits limits;
+    CHECK(limits.memoryAvailableBytes() == ContainerLimits::Unlimited);
+
+    limits.memoryLimitBytes = 1000;
+    CHECK(limits.memoryAvailableBytes() == 1000);
+    limits.memoryUsageBytes = 800;
+    CHECK(limits.memoryAvailableBytes() == 200);
+    limits.memoryReclaimableBytes = 300;
+    CHECK(limits.memoryAvailableBytes() == 500);
+    limits.memoryUsageBytes = 1500;
+    limits.memoryReclaimableBytes = 0;
+    CHECK(limits.memoryAvailableBytes() == 0);
+}
+
+TEST_CASE("cgroup v2 limits are the lowest on the path to the root", "[containerlimits]") {
+    FakeCgroupFs fs;
+    fs.write("proc_self_cgroup", "0::/ci.slice/job.scope\n");
+    fs.write("sys/cgroup.controllers", "cpu memory\n");
+    fs.write("sys/ci.slice/memory.max", "4294967296\n");
+    fs.write("sys/ci.slice/cpu.max", "200000 100000\n");
+    fs.write("sys/ci.slice/memory.current", "1073741824\n");
+    fs.write("sys/ci.slice/memory.stat", "anon 805306368\ninactive_file 268435456\n");
+    fs.write("sys/ci.slice/job.scope/memory.max", "max\n");
+    fs.write("sys/ci.slice/job.scope/cpu.max", "max 100000\n");
+
+    const ContainerLimits::Limits limits = ContainerLimits::read(fs.cgroupRoot(), fs.procCgroup());
+    CHECK(limits.memoryLimitBytes == 4294967296LL);
+    CHECK(limits.memoryUsageBytes == 1073741824LL);
+    CHECK(limits.memoryReclaimableBytes == 268435456LL);
+    CHECK(limits.memoryAvailableBytes() == 3489660928LL);
+    CHECK(limits.cpuQuota == 2.0);
+}
+
+TEST_CASE("cgroup v2 path outside a cgroup namespace falls back to the mount", "[containerlimits]") {
+    FakeCgroupFs fs;
+    fs.write("proc_self_cgroup", "0::/system.slice/docker-abc.scope\n");
+    fs.write("sys/cgroup.controllers", "cpu memory\n");
+    fs.write("sys/memory.max", "536870912\n");
+    fs.write("sys/cpu.max", "100000 100000\n");
+
+    const ContainerLimits::Limits limits = ContainerLimits::read(fs.cgroupRoot(), fs.procCgroup());
+    CHECK(limits.memoryLimitBytes == 536870912LL);
+    CHECK(limits.memoryUsageBytes == -1);
+    CHECK(limits.cpuQuota == 1.0);
+}
+
+TEST_CASE("cgroup v1 limits", "[containerlimits]") {
+    FakeCgroupFs fs;
+    fs.write("proc_self_cgroup", "5:memory:/docker/abc\n4:cpu,cpuacct:/docker/abc\n1:name=systemd:/docker/abc\n");
+    fs.write("sys/memory/memory.limit_in_bytes", "9223372036854771712\n");
+    fs.write("sys/memory/docker/abc/memory.limit_in_bytes", "2147483648\n");
+    fs.write("sys/memory/docker/abc/memory.usage_in_bytes", "1073741824\n");
+    fs.write("sys/memory/docker/abc/memory.stat", "cache 0\ntotal_inactive_file 0\n");
+    fs.write("sys/cpu,cpuacct/cpu.cfs_quota_us", "-1\n");
+    fs.write("sys/cpu,cpuacct/docker/abc/cpu.cfs_quota_us", "50000\n");
+    fs.write("sys/cpu,cpuacct/docker/abc/cpu.cfs_period_us", "100000\n");
+
+    const ContainerLimits::Limits limits = ContainerLimits::read(fs.cgroupRoot(), fs.procCgroup());
+    CHECK(limits.memoryLimitBytes == 2147483648LL);
+    CHECK(limits.memoryAvailableBytes() == 1073741824LL);
+    CHECK(limits.cpuQuota == 0.5);
+    CHECK(ContainerLimits::cpuCount(limits, 8) == 1);
+}
+
+TEST_CASE("No cgroup filesystem means no limits", "[containerlimits]") {
+    FakeCgroupFs fs;
+    const ContainerLimits::Limits limits = ContainerLimits::read(fs.cgroupRoot(), fs.procCgroup());
+    CHECK(limits.memoryLimitBytes == ContainerLimits::Unlimited);
+    CHECK(limits.cpuQuota == 0);
+    CHECK(ContainerLimits::cpuCount() >= 1);
+}
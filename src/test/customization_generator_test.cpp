@@ -1637,3 +1637,60 @@ TEST_CASE("CustomisationGenerator cloud-init handles empty Pi Connect token", "[
     REQUIRE_FALSE(yaml.contains(PI_CONNECT_CONFIG_PATH));
 }
 
+
+TEST_CASE("CustomisationBundle stamps the same systemd script as the generator", "[customization][bundle]") {
+    QVariantMap settings;
+    settings["hostname"] = "first-pi";
+    settings["sshUserName"] = "testuser";
+    settings["sshEnabled"] = true;
+    settings["wifiSSID"] = "TestNet";
+    settings["wifiPassword"] = "legacy-passphrase";  // Derived with pbkdf2 once, in prepare()
+    settings["piConnectEnabled"] = true;
+
+    const auto bundle = CustomisationBundle::prepare(CustomisationBundle::Format::Systemd, settings, true);
+
+    for (const QString hostname : {QStringLiteral("first-pi"), QStringLiteral("second-pi")}) {
+        QVariantMap perDevice = settings;
+        perDevice["hostname"] = hostname;
+        REQUIRE(bundle.matches(CustomisationBundle::Format::Systemd, perDevice, true));
+        const QString token = "token-for-" + hostname;
+        REQUIRE(bundle.stamp(hostname, token).firstrun ==
+                CustomisationGenerator::generateSystemdScript(perDevice, token));
+    }
+}
+
+TEST_CASE("CustomisationBundle stamps the same cloud-init files as the generator", "[cloudinit][bundle]") {
+    QVariantMap settings;
+    settings["hostname"] = "cloud-pi";
+    settings["sshUserName"] = "testuser";
+    settings["wifiSSID"] = "TestNet";
+    settings["wifiPasswordCrypt"] = "0123456789abcdef";
+    settings["piConnectEnabled"] = true;
+
+    const auto bundle = CustomisationBundle::prepare(CustomisationBundle::Format::CloudInit, settings, true, true, true, "testuser");
+    const QString token = "it's-a-token";  // Quoted for the shell in runcmd
+
+    const auto payload = bundle.stamp("cloud-pi", token);
+    REQUIRE(payload.userData == CustomisationGenerator::generateCloudInitUserData(settings, token, true, true, "testuser"));
+    REQUIRE(payload.networkConfig == CustomisationGenerator::generateCloudInitNetworkConfig(settings, true));
+}
+
+TEST_CASE("CustomisationBundle is regenerated for other settings", "[customization][bundle]") {
+    QVariantMap settings;
+    settings["hostname"] = "testpi";
+    settings["timezone"] = "Europe/London";
+
+    const auto bundle = CustomisationBundle::prepare(CustomisationBundle::Format::Systemd, settings, false);
+    REQUIRE_FALSE(CustomisationBundle().matches(CustomisationBundle::Format::Systemd, settings, false));
+    REQUIRE_FALSE(bundle.matches(CustomisationBundle::Format::CloudInit, settings, false));
+    REQUIRE_FALSE(bundle.matches(CustomisationBundle::Format::Systemd, settings, true));
+
+    QVariantMap otherTimezone = settings;
+    otherTimezone["timezone"] = "Europe/Paris";
+    REQUIRE_FALSE(bundle.matches(CustomisationBundle::Format::Systemd, otherTimezone, false));
+
+    // With no hostname the script has no hostname section at all
+    QVariantMap noHostname = settings;
+    noHostname.remove("hostname");
+    REQUIRE_FALSE(bundle.matches(CustomisationBundle::Format::Systemd, noHostname, false));
+}
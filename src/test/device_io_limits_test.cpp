@@ -147,3 +147,61 @@ TEST_CASE("DeviceIOLimits reports values for connected drives", "[device_io_limi
     CHECK(limits.suggested_queue_depth == 0);
 #endif
 }
+
+TEST_CASE("NativeIOSize rounds to whole device requests", "[device_io_limits]") {
+    FileOperations::DeviceIOLimits limits;
+
+    SECTION("Unknown limits keep the alignment") {
+        CHECK(limits.BufferAlignment(4096) == 4096);
+        CHECK(limits.NativeIOSize(1000 * 1000, 4096) == 1000 * 1000 / 4096 * 4096);
+        CHECK(limits.NativeIOSize(100, 4096) == 4096);
+    }
+
+    SECTION("Larger sizes become whole max transfers") {
+        limits.max_transfer_bytes = 512 * 1024;
+        CHECK(limits.NativeIOSize(8 * 1024 * 1024, 4096) == 8 * 1024 * 1024);
+        CHECK(limits.NativeIOSize(3 * 1024 * 1024 + 4096, 4096) == 3 * 1024 * 1024);
+        // Below one request, the alignment is all that applies
+        CHECK(limits.NativeIOSize(300 * 1024, 4096) == 300 * 1024);
+    }
+
+    SECTION("Smaller sizes become whole optimal I/O units") {
+        limits.max_transfer_bytes = 4 * 1024 * 1024;
+        limits.optimal_io_bytes = 192 * 1024;
+        CHECK(limits.NativeIOSize(1024 * 1024, 4096) == 5 * 192 * 1024);
+        // Smaller than one optimal unit
+        CHECK(limits.NativeIOSize(64 * 1024, 4096) == 64 * 1024);
+    }
+
+    SECTION("Physical sectors larger than a page raise the alignment") {
+        limits.io_alignment_bytes = 512;
+        limits.physical_sector_bytes = 16384;
+        CHECK(limits.BufferAlignment(4096) == 16384);
+        CHECK(limits.NativeIOSize(100 * 1024, 4096) == 96 * 1024);
+    }
+}
+
+TEST_CASE("EraseAlignedSize keeps writes inside erase units", "[device_io_limits]") {
+    FileOperations::DeviceIOLimits limits;
+
+    SECTION("Unknown erase unit leaves the size alone") {
+        CHECK(limits.EraseAlignedSize(1280 * 1024, 4096) == 1280 * 1024);
+    }
+
+    SECTION("Smaller sizes divide the erase unit") {
+        limits.erase_unit_bytes = 4 * 1024 * 1024;
+        CHECK(limits.EraseAlignedSize(1280 * 1024, 4096) == 1024 * 1024);
+        CHECK(limits.EraseAlignedSize(1024 * 1024, 4096) == 1024 * 1024);
+        CHECK(limits.EraseAlignedSize(4096, 4096) == 4096);
+    }
+
+    SECTION("Larger sizes are whole erase units") {
+        limits.erase_unit_bytes = 4 * 1024 * 1024;
+        CHECK(limits.EraseAlignedSize(10 * 1024 * 1024, 4096) == 8 * 1024 * 1024);
+    }
+
+    SECTION("Erase units that are not a power of two") {
+        limits.erase_unit_bytes = 12 * 1024 * 1024;
+        CHECK(limits.EraseAlignedSize(5 * 1024 * 1024, 4096) == 4 * 1024 * 1024);
+    }
+}
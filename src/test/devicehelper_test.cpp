@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the privileged device helper's protocol and request checks
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "linux/devicehelper.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+using rpi_imager::DeviceHelper;
+
+TEST_CASE("Only block devices under /dev are opened, with no extra flags", "[devicehelper]") {
+    CHECK_FALSE(DeviceHelper::IsAllowedOpen("/etc/passwd", O_RDONLY));
+    CHECK_FALSE(DeviceHelper::IsAllowedOpen("/dev/../etc/passwd", O_RDONLY));
+    CHECK_FALSE(DeviceHelper::IsAllowedOpen("/dev/null", O_RDWR));  // Character device
+    CHECK_FALSE(DeviceHelper::IsAllowedOpen("/dev/does-not-exist", O_RDWR));
+    CHECK_FALSE(DeviceHelper::IsAllowedOpen("relative", O_RDWR));
+    CHECK_FALSE(DeviceHelper::IsAllowedOpen("/dev/sda", O_RDWR | O_CREAT));
+    CHECK_FALSE(DeviceHelper::IsAllowedOpen("/dev/sda", O_RDWR | O_TRUNC));
+}
+
+TEST_CASE("Requests round trip and the helper ends with the client", "[devicehelper]") {
+    int sv[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == 0);
+
+    std::atomic<int> unmounts{0};
+    int status = -1;
+    std::thread helper([&]() {
+        status = DeviceHelper::Serve(sv[1], [&](const std::string&) {
+            ++unmounts;
+            return 0;
+        });
+        close(sv[1]);
+    });
+
+    REQUIRE(DeviceHelper::Attach(sv[0]));
+    CHECK(DeviceHelper::IsRunning());
+
+    // Refused requests come back as EACCES, without a descriptor
+    int error = 0;
+    CHECK(DeviceHelper::Open("/dev/null", O_RDWR, error) == -1);
+    CHECK(error == EACCES);
+    CHECK(DeviceHelper::Open("/etc/passwd", O_RDONLY, error) == -1);
+    CHECK(error == EACCES);
+    CHECK(DeviceHelper::Unmount("/etc") == -1);
+    CHECK(unmounts == 0);
+
+    // Paths that do not fit a request are not sent
+    CHECK(DeviceHelper::Open("/dev/" + std::string(300, 'a'), O_RDWR, error) == -1);
+    CHECK(DeviceHelper::IsRunning());
+
+    DeviceHelper::Stop();
+    helper.join();
+    CHECK(status == 0);
+    CHECK_FALSE(DeviceHelper::IsRunning());
+}
+
+TEST_CASE("A client whose helper went away stops using it", "[devicehelper]") {
+    int sv[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == 0);
+
+    // A helper that is ready and then exits
+    std::thread helper([&]() {
+        DeviceHelper::Serve(sv[1], nullptr);
+    });
+    REQUIRE(DeviceHelper::Attach(sv[0]));
+    shutdown(sv[1], SHUT_RDWR);
+    helper.join();
+    close(sv[1]);
+
+    int error = 0;
+    CHECK(DeviceHelper::Open("/dev/sda", O_RDWR, error) == -1);
+    CHECK_FALSE(DeviceHelper::IsRunning());
+}
+
+TEST_CASE("A helper that never becomes ready is not used", "[devicehelper]") {
+    int sv[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == 0);
+    close(sv[1]);  // As when pkexec exits without starting it
+    CHECK_FALSE(DeviceHelper::Attach(sv[0]));
+    CHECK_FALSE(DeviceHelper::IsRunning());
+}
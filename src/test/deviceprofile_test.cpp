@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for DeviceProfile merging and seeding
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "deviceprofile.h"
+
+namespace {
+
+constexpr int64_t MB = 1024 * 1024;
+
+} // namespace
+
+TEST_CASE("First session is taken as measured", "[deviceprofile]") {
+    DeviceProfile session;
+    session.writeKBps = 20000;
+    session.verifyKBps = 40000;
+    session.queueDepth = 8;
+    session.blockSize = 2 * MB;
+    session.directIO = DeviceProfile::DirectIO::Worked;
+    session.finalSyncMs = 1200;
+
+    DeviceProfile profile;
+    REQUIRE(profile.isEmpty());
+    profile.merge(session);
+
+    CHECK(profile.sessions == 1);
+    CHECK(profile.writeKBps == 20000);
+    CHECK(profile.verifyKBps == 40000);
+    CHECK(profile.queueDepth == 8);
+    CHECK(profile.blockSize == 2 * MB);
+    CHECK(profile.directIO == DeviceProfile::DirectIO::Worked);
+    CHECK(profile.finalSyncMs == 1200);
+    CHECK(profile.periodicSyncMs == 0);
+}
+
+TEST_CASE("Later sessions move the profile part of the way", "[deviceprofile]") {
+    DeviceProfile profile;
+    profile.sessions = 3;
+    profile.writeKBps = 30000;
+    profile.unmountMs = 90;
+    profile.queueDepth = 16;
+    profile.directIO = DeviceProfile::DirectIO::Worked;
+    profile.probedCapacity = 64000000000ULL;
+
+    DeviceProfile session;
+    session.writeKBps = 15000;  // e.g. the card was garbage collecting
+    session.directIO = DeviceProfile::DirectIO::Failed;
+    profile.merge(session);
+
+    CHECK(profile.sessions == 4);
+    CHECK(profile.writeKBps == 25000);
+    // Unmeasured fields keep what was stored
+    CHECK(profile.unmountMs == 90);
+    CHECK(profile.queueDepth == 16);
+    CHECK(profile.probedCapacity == 64000000000ULL);
+    CHECK(profile.directIO == DeviceProfile::DirectIO::Failed);
+
+    // A probe replaces the stored capacity
+    session.probedCapacity = 8ULL << 30;
+    profile.merge(session);
+    CHECK(profile.probedCapacity == 8ULL << 30);
+}
+
+TEST_CASE("Sync interval follows the device write rate", "[deviceprofile]") {
+    DeviceProfile profile;
+    profile.sessions = 1;
+    profile.writeKBps = 10 * 1024;  // 10 MB/s
+
+    int64_t bytes = 128 * MB;
+    int64_t ms = 5000;
+    profile.seedSyncInterval(bytes, ms, 16 * MB);
+    CHECK(ms == 5000);
+    CHECK(bytes == 50 * MB);
+
+    // Never below the minimum, never above the memory tier
+    profile.writeKBps = 1024;
+    bytes = 128 * MB;
+    profile.seedSyncInterval(bytes, ms, 16 * MB);
+    CHECK(bytes == 16 * MB);
+
+    profile.writeKBps = 200 * 1024;
+    bytes = 128 * MB;
+    profile.seedSyncInterval(bytes, ms, 16 * MB);
+    CHECK(bytes == 128 * MB);
+}
+
+TEST_CASE("Expensive syncs widen the time interval", "[deviceprofile]") {
+    DeviceProfile profile;
+    profile.sessions = 1;
+    profile.periodicSyncMs = 1500;
+
+    int64_t bytes = 128 * MB;
+    int64_t ms = 5000;
+    profile.seedSyncInterval(bytes, ms, 16 * MB);
+    CHECK(ms == 15000);
+    CHECK(bytes == 128 * MB);  // Write rate unknown
+
+    profile.periodicSyncMs = 10000;
+    ms = 5000;
+    profile.seedSyncInterval(bytes, ms, 16 * MB);
+    CHECK(ms == DeviceProfile::MaxSyncIntervalMs);
+
+    // Cheap syncs leave the memory tier's interval alone
+    profile.periodicSyncMs = 100;
+    ms = 7000;
+    profile.seedSyncInterval(bytes, ms, 16 * MB);
+    CHECK(ms == 7000);
+}
+
+TEST_CASE("Live rate takes over from the profile", "[deviceprofile]") {
+    CHECK(DeviceProfile::blendRateKBps(0, 0, 0) == 0);
+    CHECK(DeviceProfile::blendRateKBps(20000, 0, 0) == 20000);
+    CHECK(DeviceProfile::blendRateKBps(0, 10000, 0) == 10000);
+    CHECK(DeviceProfile::blendRateKBps(20000, 10000, 0) == 20000);
+    CHECK(DeviceProfile::blendRateKBps(20000, 10000, DeviceProfile::LiveRateBytes / 2) == 15000);
+    CHECK(DeviceProfile::blendRateKBps(20000, 10000, DeviceProfile::LiveRateBytes * 4) == 10000);
+}
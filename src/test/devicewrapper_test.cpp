@@ -0,0 +1,120 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for reads that bypass DeviceWrapper's block cache, against a FAT
+ * image in a temporary file rather than a real device
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "bootimgcreator.h"
+#include "devicewrapper.h"
+#include "devicewrapperfatpartition.h"
+#include "file_operations.h"
+
+#include <QTemporaryDir>
+
+#include <memory>
+
+using rpi_imager::FileError;
+using rpi_imager::FileOperations;
+
+namespace {
+
+constexpr qint64 kImageSize = 33LL * 1024 * 1024;
+
+QByteArray pattern(int size, char seed)
+{
+    QByteArray data(size, 0);
+    for (int i = 0; i < size; i++)
+        data[i] = char(seed + i * 7);
+    return data;
+}
+
+struct ImageFile {
+    QTemporaryDir dir;
+    std::unique_ptr<FileOperations> file;
+    std::unique_ptr<DeviceWrapper> wrapper;
+
+    explicit ImageFile(const QByteArray &image)
+        : file(FileOperations::Create())
+    {
+        REQUIRE(dir.isValid());
+        const std::string path = dir.filePath("boot.img").toStdString();
+        REQUIRE(file->CreateTestFile(path, quint64(image.size())) == FileError::kSuccess);
+        REQUIRE(file->WriteAtOffset(0, reinterpret_cast<const std::uint8_t *>(image.constData()),
+                                    size_t(image.size())) == FileError::kSuccess);
+        wrapper = std::make_unique<DeviceWrapper>(file.get());
+    }
+
+    ~ImageFile()
+    {
+        wrapper.reset();
+        file->Close();
+    }
+};
+
+} // namespace
+
+TEST_CASE("Long cluster runs read back from an image file", "[devicewrapper]") {
+    // Over 64 KB runs go around the cache; past 4 MB in more than one chunk
+    QMap<QString, QByteArray> files;
+    files["kernel8.img"] = pattern(6 * 1024 * 1024 + 321, 1);
+    files["initramfs8"] = pattern(200 * 1024, 2);
+    files["config.txt"] = "arm_64bit=1\n";
+
+    ImageFile image(BootImgCreator::createBootImg(files, kImageSize));
+    DeviceWrapperFatPartition fat(image.wrapper.get(), 0, quint64(kImageSize));
+
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        INFO(it.key().toStdString());
+        CHECK(fat.readFile(it.key()) == it.value());
+    }
+}
+
+TEST_CASE("Uncached reads see blocks written but not synced", "[devicewrapper]") {
+    QMap<QString, QByteArray> files;
+    files["config.txt"] = "x";
+    QByteArray expected = BootImgCreator::createBootImg(files, kImageSize);
+    ImageFile image(expected);
+    DeviceWrapper &dw = *image.wrapper;
+
+    // Dirty blocks at both ends of a chunk and one straddling a block boundary
+    const quint64 offsets[] = {4096, 4 * 1024 * 1024 - 10, 5 * 1024 * 1024 + 4000};
+    for (quint64 offset : offsets) {
+        const QByteArray data = pattern(300, char(offset));
+        dw.pwrite(data.constData(), quint64(data.size()), offset);
+        expected.replace(qsizetype(offset), data.size(), data);
+    }
+
+    // Neither start nor length block aligned
+    const quint64 from = 1234;
+    const quint64 size = 6 * 1024 * 1024 + 777;
+    QByteArray uncached(qsizetype(size), 0);
+    dw.preadUncached(uncached.data(), size, from);
+    CHECK(uncached == expected.mid(qsizetype(from), qsizetype(size)));
+
+    QByteArray cached(qsizetype(size), 0);
+    dw.pread(cached.data(), size, from);
+    CHECK(cached == uncached);
+
+    dw.sync();
+    QByteArray synced(qsizetype(size), 0);
+    dw.preadUncached(synced.data(), size, from);
+    CHECK(synced == uncached);
+}
+
+TEST_CASE("Rewritten large files read back before and after sync", "[devicewrapper]") {
+    QMap<QString, QByteArray> files;
+    files["kernel8.img"] = pattern(1024 * 1024 + 123, 3);
+    ImageFile image(BootImgCreator::createBootImg(files, kImageSize));
+    DeviceWrapperFatPartition fat(image.wrapper.get(), 0, quint64(kImageSize));
+
+    // Still only in the block cache, which the uncached read must overlay
+    const QByteArray updated = pattern(1024 * 1024 + 123, 4);
+    fat.writeFile("kernel8.img", updated);
+    CHECK(fat.readFile("kernel8.img") == updated);
+
+    image.wrapper->sync();
+    CHECK(fat.readFile("kernel8.img") == updated);
+}
@@ -0,0 +1,107 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for Largest-Triangle-Three-Buckets downsampling
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "downsample.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+struct Point {
+    uint32_t ms;
+    uint64_t bytes;
+};
+
+std::vector<int> halve(const std::vector<Point> &points)
+{
+    const int count = static_cast<int>(points.size());
+    return Downsample::lttb(0, count - 1, count / 2,
+                            [&points](int i) { return points[i].ms; },
+                            [&points](int i) { return points[i].bytes; });
+}
+
+bool contains(const std::vector<int> &kept, int index)
+{
+    return std::find(kept.begin(), kept.end(), index) != kept.end();
+}
+
+} // namespace
+
+TEST_CASE("Short series are kept whole", "[downsample]") {
+    auto x = [](int i) { return i; };
+    CHECK(Downsample::lttb(0, 1, 2, x, x) == std::vector<int>{0, 1});
+    CHECK(Downsample::lttb(3, 6, 10, x, x) == std::vector<int>{3, 4, 5, 6});
+    CHECK(Downsample::lttb(5, 4, 2, x, x).empty());
+    // A target below two still keeps both ends
+    CHECK(Downsample::lttb(0, 9, 1, x, x) == std::vector<int>{0, 9});
+}
+
+TEST_CASE("Downsampling keeps the ends, the order and the target count", "[downsample]") {
+    std::vector<Point> points;
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < 6000; ++i) {
+        bytes += 1000 + (i * 7919) % 500;
+        points.push_back({i * 100, bytes});
+    }
+    const std::vector<int> kept = halve(points);
+    CHECK(kept.size() == 3000);
+    CHECK(kept.front() == 0);
+    CHECK(kept.back() == 5999);
+    CHECK(std::is_sorted(kept.begin(), kept.end()));
+    CHECK(std::adjacent_find(kept.begin(), kept.end()) == kept.end());
+}
+
+TEST_CASE("A stall in the byte count survives repeated halving", "[downsample]") {
+    // Steady 10 MB/s, a 3 s stall from 300 s, then steady again
+    std::vector<Point> points;
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < 6000; ++i) {
+        const uint32_t ms = i * 100;
+        if (ms <= 300000 || ms > 303000)
+            bytes += 1024 * 1024;
+        points.push_back({ms, bytes});
+    }
+
+    for (int round = 0; round < 4; ++round) {
+        const std::vector<int> kept = halve(points);
+        std::vector<Point> next;
+        for (int i : kept)
+            next.push_back(points[i]);
+        points.swap(next);
+    }
+    REQUIRE(points.size() == 375);
+
+    // Both corners of the flat run are still there, so the stall still
+    // shows as an interval without progress
+    bool stallStart = false, stallEnd = false;
+    for (size_t i = 1; i < points.size(); ++i) {
+        if (points[i].bytes == points[i - 1].bytes) {
+            stallStart |= points[i - 1].ms == 300000;
+            stallEnd |= points[i].ms == 303000;
+        }
+    }
+    CHECK(stallStart);
+    CHECK(stallEnd);
+}
+
+TEST_CASE("A step in throughput keeps its corner", "[downsample]") {
+    // An SLC cache filling: fast, then a tenth of the rate
+    std::vector<Point> points;
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        bytes += i < 400 ? 10'000'000 : 1'000'000;
+        points.push_back({i * 100, bytes});
+    }
+    const std::vector<int> kept = Downsample::lttb(0, 999, 10,
+                                                   [&points](int i) { return points[i].ms; },
+                                                   [&points](int i) { return points[i].bytes; });
+    REQUIRE(kept.size() == 10);
+    CHECK((contains(kept, 398) || contains(kept, 399) || contains(kept, 400)));
+}
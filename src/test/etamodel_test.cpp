@@ -0,0 +1,102 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the pipeline time estimate
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "etamodel.h"
+
+using Stage = EtaModel::Stage;
+
+namespace {
+
+constexpr uint64_t MB = 1024 * 1024;
+
+DeviceProfile knownCard()
+{
+    DeviceProfile profile;
+    profile.sessions = 2;
+    profile.writeKBps = 20 * 1024;
+    profile.verifyKBps = 80 * 1024;
+    profile.finalSyncMs = 3000;
+    profile.ejectMs = 500;
+    return profile;
+}
+
+} // namespace
+
+TEST_CASE("Nothing known and nothing measured gives no estimate", "[etamodel]") {
+    EtaModel model;
+    model.update(Stage::Write, 0, 1024 * MB, 0);
+    model.update(Stage::Verify, 0, 1024 * MB, 0);
+    CHECK_FALSE(model.estimate().known);
+}
+
+TEST_CASE("Profile covers write, final sync, verify and eject", "[etamodel]") {
+    EtaModel model;
+    model.setProfile(knownCard(), false);
+    model.update(Stage::Write, 0, 1024 * MB, 0);
+    model.update(Stage::Verify, 0, 1024 * MB, 0);
+
+    // 1 GB at 20 MB/s + sync + 1 GB at 80 MB/s
+    auto eta = model.estimate();
+    REQUIRE(eta.known);
+    CHECK(eta.ms == 51200 + 3000 + 12800);
+    CHECK(eta.limitedBy == Stage::Write);
+
+    model.setProfile(knownCard(), true);
+    CHECK(model.estimate().ms == 51200 + 3000 + 12800 + 500);
+
+    // Verifying: only the read-back is left
+    model.setProfile(knownCard(), false);
+    model.update(Stage::Write, 1024 * MB, 1024 * MB, 0);
+    model.update(Stage::Verify, 512 * MB, 1024 * MB, 0);
+    eta = model.estimate();
+    CHECK(eta.ms == 6400);
+    CHECK(eta.limitedBy == Stage::Verify);
+
+    // No verify rate stored: fall back to the write rate
+    DeviceProfile noVerify = knownCard();
+    noVerify.verifyKBps = 0;
+    model.setProfile(noVerify, false);
+    CHECK(model.estimate().ms == 25600);
+}
+
+TEST_CASE("A slow download limits the write phase", "[etamodel]") {
+    EtaModel model;
+    model.setProfile(knownCard(), false);
+
+    // The card could take 20 MB/s but the network only delivers 5 MB/s
+    for (int64_t ms = 0; ms <= 10000; ms += 500)
+    {
+        const uint64_t done = static_cast<uint64_t>(ms) * 5 * MB / 1000;
+        model.update(Stage::Download, done, 1024 * MB, ms);
+        model.update(Stage::Write, done, 1024 * MB, ms);
+    }
+
+    CHECK(model.rateKBps(Stage::Download) == 5 * 1024);
+    const auto eta = model.estimate();
+    REQUIRE(eta.known);
+    CHECK(eta.limitedBy == Stage::Download);
+    // 974 MB at 5 MB/s, then the sync
+    CHECK(eta.ms == 974 * 1000 / 5 + 3000);
+}
+
+TEST_CASE("Rates are smoothed over stalls", "[etamodel]") {
+    EtaModel model;
+    model.update(Stage::Write, 0, 1024 * MB, 0);
+    model.update(Stage::Write, 10 * MB, 1024 * MB, 1000);
+    CHECK(model.rateKBps(Stage::Write) == 10 * 1024);
+
+    // A one-second sync stall only moves the rate part of the way down
+    model.update(Stage::Write, 10 * MB, 1024 * MB, 2000);
+    const uint32_t afterStall = model.rateKBps(Stage::Write);
+    CHECK(afterStall < 10 * 1024);
+    CHECK(afterStall > 9 * 1024);
+
+    // Samples closer together than kMinSampleMs are folded into the next one
+    model.update(Stage::Write, 20 * MB, 1024 * MB, 2100);
+    CHECK(model.rateKBps(Stage::Write) == afterStall);
+}
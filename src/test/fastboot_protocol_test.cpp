@@ -182,6 +182,17 @@ TEST_CASE("FastbootProtocol getVar returns nullopt on FAIL", "[fastboot][protoco
     CHECK_FALSE(val.has_value());
 }
 
+TEST_CASE("FastbootProtocol parseSize accepts hex and decimal sizes", "[fastboot][protocol]")
+{
+    CHECK(FastbootProtocol::parseSize("0x10000000") == 0x10000000u);
+    CHECK(FastbootProtocol::parseSize("0X400") == 0x400u);
+    CHECK(FastbootProtocol::parseSize("268435456") == 268435456u);
+    CHECK_FALSE(FastbootProtocol::parseSize("").has_value());
+    CHECK_FALSE(FastbootProtocol::parseSize("0x").has_value());
+    CHECK_FALSE(FastbootProtocol::parseSize("256M").has_value());
+    CHECK_FALSE(FastbootProtocol::parseSize("0x100000000").has_value());
+}
+
 // ────────────────────────────────────────────────────────────────────────
 // Transport failure tests
 // ────────────────────────────────────────────────────────────────────────
@@ -1057,3 +1068,127 @@ TEST_CASE("Customisation pattern: readDeviceFile failure aborts before write", "
         CHECK_FALSE(s.starts_with("oem download-file"));
     }
 }
+
+// ────────────────────────────────────────────────────────────────────────
+// Batches
+// ────────────────────────────────────────────────────────────────────────
+
+TEST_CASE("FastbootProtocol runBatch reads files back to back", "[fastboot][protocol][batch]")
+{
+    MockUsbTransport mock;
+    std::vector<uint8_t> config = {'a', '=', '1', '\n'};
+    std::vector<uint8_t> cmdline = {'q', 'u', 'i', 'e', 't'};
+    queueReadFile(mock, config);
+    queueReadFile(mock, cmdline);
+
+    using BatchOp = FastbootProtocol::BatchOp;
+    std::vector<BatchOp> ops = {
+        BatchOp::cmd("oem upload-file /mnt/bootfs/config.txt"), BatchOp::upload(),
+        BatchOp::cmd("oem upload-file /mnt/bootfs/cmdline.txt"), BatchOp::upload(),
+    };
+
+    FastbootProtocol fb;
+    std::atomic<bool> cancelled{false};
+    auto result = fb.runBatch(mock, ops, cancelled);
+
+    REQUIRE(result.ok(ops.size()));
+    CHECK(fb.lastError().empty());
+    REQUIRE(result.uploads.size() == 2);
+    CHECK(result.uploads[0] == config);
+    CHECK(result.uploads[1] == cmdline);
+
+    std::vector<std::string> sent;
+    for (const auto& w : mock.capturedBulkWrites())
+        sent.emplace_back(w.begin(), w.end());
+    CHECK(sent == std::vector<std::string>{"oem upload-file /mnt/bootfs/config.txt", "upload",
+                                           "oem upload-file /mnt/bootfs/cmdline.txt", "upload"});
+}
+
+TEST_CASE("FastbootProtocol runBatch writes staged files in order", "[fastboot][protocol][batch]")
+{
+    MockUsbTransport mock;
+    std::vector<uint8_t> metadata(20, 'm');
+    std::vector<uint8_t> userData(40, 'u');
+    queueWriteFile(mock, metadata.size());
+    queueWriteFile(mock, userData.size());
+
+    using BatchOp = FastbootProtocol::BatchOp;
+    std::vector<BatchOp> ops = {
+        BatchOp::stage(metadata), BatchOp::cmd("oem download-file /mnt/bootfs/meta-data"),
+        BatchOp::stage(userData), BatchOp::cmd("oem download-file /mnt/bootfs/user-data"),
+    };
+
+    FastbootProtocol fb;
+    std::atomic<bool> cancelled{false};
+    auto result = fb.runBatch(mock, ops, cancelled);
+    CHECK(result.ok(ops.size()));
+
+    std::vector<std::string> commands;
+    for (const auto& w : mock.capturedBulkWrites()) {
+        std::string s(w.begin(), w.end());
+        if (s.starts_with("download:") || s.starts_with("oem "))
+            commands.push_back(s);
+    }
+    CHECK(commands == std::vector<std::string>{"download:00000014", "oem download-file /mnt/bootfs/meta-data",
+                                               "download:00000028", "oem download-file /mnt/bootfs/user-data"});
+}
+
+TEST_CASE("FastbootProtocol runBatch stops at the first failure", "[fastboot][protocol][batch][negative]")
+{
+    MockUsbTransport mock;
+    std::vector<uint8_t> data(8, 'x');
+    queueWriteFile(mock, data.size());
+    mock.queueBulkReadResponse(makeResponse("FAIL", "no space"));
+
+    using BatchOp = FastbootProtocol::BatchOp;
+    std::vector<BatchOp> ops = {
+        BatchOp::stage(data), BatchOp::cmd("oem download-file /mnt/bootfs/a"),
+        BatchOp::stage(data), BatchOp::cmd("oem download-file /mnt/bootfs/b"),
+    };
+
+    FastbootProtocol fb;
+    std::atomic<bool> cancelled{false};
+    auto result = fb.runBatch(mock, ops, cancelled);
+
+    CHECK_FALSE(result.ok(ops.size()));
+    CHECK(result.completed == 2);
+    CHECK_THAT(fb.lastError(), Catch::Matchers::ContainsSubstring("DATA"));
+
+    // Nothing after the failed stage was sent
+    for (const auto& w : mock.capturedBulkWrites()) {
+        std::string s(w.begin(), w.end());
+        CHECK(s != "oem download-file /mnt/bootfs/b");
+    }
+}
+
+TEST_CASE("FastbootProtocol runBatch does not start when cancelled", "[fastboot][protocol][batch][negative]")
+{
+    MockUsbTransport mock;
+    using BatchOp = FastbootProtocol::BatchOp;
+    std::vector<BatchOp> ops = {BatchOp::cmd("oem umount /mnt/bootfs")};
+
+    FastbootProtocol fb;
+    std::atomic<bool> cancelled{true};
+    auto result = fb.runBatch(mock, ops, cancelled);
+
+    CHECK(result.completed == 0);
+    CHECK(mock.capturedBulkWrites().empty());
+    CHECK_THAT(fb.lastError(), Catch::Matchers::ContainsSubstring("Cancelled"));
+}
+
+TEST_CASE("FastbootProtocol getVars keeps going past unknown variables", "[fastboot][protocol][batch]")
+{
+    MockUsbTransport mock;
+    mock.queueBulkReadResponse(makeResponse("OKAY", "0x10000000"));
+    mock.queueBulkReadResponse(makeResponse("FAIL", "unknown variable"));
+    mock.queueBulkReadResponse(makeResponse("OKAY", "10000000abcdef01"));
+
+    FastbootProtocol fb;
+    std::vector<std::string_view> names = {"max-download-size", "product", "serialno"};
+    auto values = fb.getVars(mock, names);
+
+    REQUIRE(values.size() == 3);
+    CHECK(values[0] == "0x10000000");
+    CHECK_FALSE(values[1].has_value());
+    CHECK(values[2] == "10000000abcdef01");
+}
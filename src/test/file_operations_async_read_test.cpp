@@ -0,0 +1,152 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for FileOperations::AsyncReadSequential on the platform backend
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "file_operations.h"
+#include "aligned_buffer.h"
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+using rpi_imager::AlignedBuffer;
+using rpi_imager::FileError;
+using rpi_imager::FileOperations;
+
+namespace {
+
+constexpr std::size_t ChunkSize = 256 * 1024;
+constexpr int Chunks = 8;
+
+std::uint8_t patternByte(std::uint64_t offset)
+{
+    return static_cast<std::uint8_t>((offset / 4096) * 7 + offset);
+}
+
+// A test file filled with an offset-dependent pattern
+struct PatternFile
+{
+    std::string path;
+    std::unique_ptr<FileOperations> file = FileOperations::Create();
+
+    PatternFile()
+    {
+        path = (std::filesystem::temp_directory_path() / "rpi_imager_async_read_test.img").string();
+        REQUIRE(file->CreateTestFile(path, ChunkSize * Chunks) == FileError::kSuccess);
+
+        AlignedBuffer chunk(ChunkSize);
+        REQUIRE(chunk);
+        for (int i = 0; i < Chunks; ++i)
+        {
+            const std::uint64_t base = static_cast<std::uint64_t>(i) * ChunkSize;
+            for (std::size_t j = 0; j < ChunkSize; ++j)
+                chunk.data()[j] = patternByte(base + j);
+            REQUIRE(file->WriteAtOffset(base, chunk.data(), ChunkSize) == FileError::kSuccess);
+        }
+    }
+
+    ~PatternFile()
+    {
+        file->Close();
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+};
+
+bool matchesPattern(const std::uint8_t *data, std::size_t size, std::uint64_t offset)
+{
+    for (std::size_t i = 0; i < size; ++i)
+        if (data[i] != patternByte(offset + i))
+            return false;
+    return true;
+}
+
+struct Completion
+{
+    std::atomic<bool> done{false};
+    FileError result = FileError::kSuccess;
+    std::size_t bytesRead = 0;
+};
+
+} // namespace
+
+TEST_CASE("Queued reads cover consecutive offsets", "[file_operations][async_read]") {
+    PatternFile pf;
+    REQUIRE(pf.file->Seek(0) == FileError::kSuccess);
+
+    std::vector<std::unique_ptr<AlignedBuffer>> buffers;
+    Completion completions[Chunks];
+    for (int i = 0; i < Chunks; ++i)
+    {
+        buffers.push_back(std::make_unique<AlignedBuffer>(ChunkSize));
+        Completion *c = &completions[i];
+        REQUIRE(pf.file->AsyncReadSequential(buffers.back()->data(), ChunkSize,
+            [c](FileError result, std::size_t bytesRead) {
+                c->result = result;
+                c->bytesRead = bytesRead;
+                c->done.store(true);
+            }) == FileError::kSuccess);
+    }
+
+    REQUIRE(pf.file->WaitForPendingReads(0) == FileError::kSuccess);
+    CHECK(pf.file->GetPendingReadCount() == 0);
+
+    for (int i = 0; i < Chunks; ++i)
+    {
+        REQUIRE(completions[i].done.load());
+        CHECK(completions[i].result == FileError::kSuccess);
+        CHECK(completions[i].bytesRead == ChunkSize);
+        CHECK(matchesPattern(buffers[i]->data(), ChunkSize, static_cast<std::uint64_t>(i) * ChunkSize));
+    }
+}
+
+TEST_CASE("Async reads continue from Seek and ReadSequential", "[file_operations][async_read]") {
+    PatternFile pf;
+    AlignedBuffer first(ChunkSize);
+    AlignedBuffer second(ChunkSize);
+
+    REQUIRE(pf.file->Seek(2 * ChunkSize) == FileError::kSuccess);
+    std::size_t bytesRead = 0;
+    REQUIRE(pf.file->ReadSequential(first.data(), ChunkSize, bytesRead) == FileError::kSuccess);
+    REQUIRE(bytesRead == ChunkSize);
+    CHECK(matchesPattern(first.data(), ChunkSize, 2 * ChunkSize));
+
+    Completion c;
+    REQUIRE(pf.file->AsyncReadSequential(second.data(), ChunkSize,
+        [&c](FileError result, std::size_t n) {
+            c.result = result;
+            c.bytesRead = n;
+            c.done.store(true);
+        }) == FileError::kSuccess);
+    REQUIRE(pf.file->WaitForPendingReads(0) == FileError::kSuccess);
+
+    REQUIRE(c.done.load());
+    CHECK(c.bytesRead == ChunkSize);
+    CHECK(matchesPattern(second.data(), ChunkSize, 3 * ChunkSize));
+}
+
+TEST_CASE("Waiting for some reads leaves the rest queued", "[file_operations][async_read]") {
+    PatternFile pf;
+    REQUIRE(pf.file->Seek(0) == FileError::kSuccess);
+
+    std::vector<std::unique_ptr<AlignedBuffer>> buffers;
+    std::atomic<int> completed{0};
+    for (int i = 0; i < 4; ++i)
+    {
+        buffers.push_back(std::make_unique<AlignedBuffer>(ChunkSize));
+        REQUIRE(pf.file->AsyncReadSequential(buffers.back()->data(), ChunkSize,
+            [&completed](FileError, std::size_t) { completed.fetch_add(1); }) == FileError::kSuccess);
+    }
+
+    REQUIRE(pf.file->WaitForPendingReads(2) == FileError::kSuccess);
+    CHECK(pf.file->GetPendingReadCount() <= 2);
+    CHECK(completed.load() >= 2);
+
+    REQUIRE(pf.file->WaitForPendingReads(0) == FileError::kSuccess);
+    CHECK(completed.load() == 4);
+}
@@ -0,0 +1,153 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for FileOperations on image file (regular file) targets
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "file_operations.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using rpi_imager::FileError;
+using rpi_imager::FileOperations;
+
+#ifdef __linux__
+
+namespace {
+
+constexpr std::uint64_t MiB = 1024 * 1024;
+
+std::string tempPath(const char *name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::vector<std::uint8_t> pattern(std::size_t size, std::uint8_t seed)
+{
+    std::vector<std::uint8_t> data(size);
+    for (std::size_t i = 0; i < size; ++i)
+        data[i] = static_cast<std::uint8_t>(i * 13 + seed);
+    return data;
+}
+
+std::vector<std::uint8_t> readBack(FileOperations &file, std::uint64_t offset, std::size_t size)
+{
+    std::vector<std::uint8_t> data(size);
+    std::size_t bytesRead = 0;
+    REQUIRE(file.ReadAtOffset(offset, data.data(), size, bytesRead) == FileError::kSuccess);
+    REQUIRE(bytesRead == size);
+    return data;
+}
+
+} // namespace
+
+TEST_CASE("Zero ranges on an image file become holes and extend it", "[file_operations][image_file]") {
+    const std::string path = tempPath("rpi_imager_image_file_test.img");
+    auto file = FileOperations::Create();
+    REQUIRE(file->CreateTestFile(path, MiB) == FileError::kSuccess);
+    CHECK(file->IsRegularFile());
+    REQUIRE(file->GetZeroRangeMethod() == FileOperations::ZeroRangeMethod::kPunchHole);
+
+    const auto data = pattern(MiB, 1);
+    REQUIRE(file->WriteAtOffset(0, data.data(), data.size()) == FileError::kSuccess);
+
+    // Inside the file, and past its end; neither has to be block aligned
+    REQUIRE(file->ZeroRange(256 * 1024 + 100, 100 * 1024) == FileError::kSuccess);
+    REQUIRE(file->ZeroRange(MiB, MiB + 512) == FileError::kSuccess);
+
+    std::uint64_t size = 0;
+    REQUIRE(file->GetSize(size) == FileError::kSuccess);
+    CHECK(size == 2 * MiB + 512);
+
+    auto expected = data;
+    std::fill(expected.begin() + 256 * 1024 + 100, expected.begin() + 356 * 1024 + 100, 0);
+    CHECK(readBack(*file, 0, MiB) == expected);
+    CHECK(readBack(*file, MiB, MiB + 512) == std::vector<std::uint8_t>(MiB + 512, 0));
+
+    file->Close();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("CloneFrom copies the data and leaves holes", "[file_operations][image_file]") {
+    const std::string srcPath = tempPath("rpi_imager_clone_src_test.img");
+    const std::string dstPath = tempPath("rpi_imager_clone_dst_test.img");
+
+    // 4 MiB with data at the start and in the middle only
+    const auto head = pattern(64 * 1024, 2);
+    const auto middle = pattern(128 * 1024, 3);
+    const int src = ::open(srcPath.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    REQUIRE(src >= 0);
+    REQUIRE(::ftruncate(src, 4 * MiB) == 0);
+    REQUIRE(::pwrite(src, head.data(), head.size(), 0) == static_cast<ssize_t>(head.size()));
+    REQUIRE(::pwrite(src, middle.data(), middle.size(), 2 * MiB) == static_cast<ssize_t>(middle.size()));
+
+    auto file = FileOperations::Create();
+    REQUIRE(file->CreateTestFile(dstPath, 0) == FileError::kSuccess);
+    REQUIRE(file->CloneFrom(src, 4 * MiB) == FileError::kSuccess);
+    CHECK(file->Tell() == 0);
+
+    std::uint64_t size = 0;
+    REQUIRE(file->GetSize(size) == FileError::kSuccess);
+    CHECK(size == 4 * MiB);
+
+    std::vector<std::uint8_t> expected(4 * MiB, 0);
+    std::copy(head.begin(), head.end(), expected.begin());
+    std::copy(middle.begin(), middle.end(), expected.begin() + 2 * MiB);
+    CHECK(readBack(*file, 0, 4 * MiB) == expected);
+
+    file->Close();
+    ::close(src);
+    std::filesystem::remove(srcPath);
+    std::filesystem::remove(dstPath);
+}
+
+TEST_CASE("CloneFrom needs an image file target", "[file_operations][image_file]") {
+    auto file = FileOperations::Create();
+    CHECK_FALSE(file->IsRegularFile());
+    CHECK(file->CloneFrom(0, MiB) != FileError::kSuccess);
+}
+
+TEST_CASE("SpliceFrom writes a range of the source at the file position", "[file_operations][image_file]") {
+    const std::string srcPath = tempPath("rpi_imager_splice_src_test.img");
+    const std::string dstPath = tempPath("rpi_imager_splice_dst_test.img");
+
+    const auto data = pattern(3 * MiB, 5);
+    const int src = ::open(srcPath.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    REQUIRE(src >= 0);
+    REQUIRE(::pwrite(src, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size()));
+    const off_t srcPos = ::lseek(src, 4096, SEEK_SET);
+
+    auto file = FileOperations::Create();
+    REQUIRE(file->CreateTestFile(dstPath, 0) == FileError::kSuccess);
+    const auto first = pattern(MiB, 9);
+    REQUIRE(file->WriteSequential(first.data(), first.size()) == FileError::kSuccess);
+
+    // More than one pipe's worth, from an offset in the source
+    REQUIRE(file->SpliceFrom(src, MiB, 2 * MiB) == FileError::kSuccess);
+    CHECK(file->Tell() == 3 * MiB);
+    CHECK(::lseek(src, 0, SEEK_CUR) == srcPos);
+
+    std::vector<std::uint8_t> expected(first);
+    expected.insert(expected.end(), data.begin() + MiB, data.end());
+    CHECK(readBack(*file, 0, 3 * MiB) == expected);
+
+    // Past the end of the source
+    CHECK(file->SpliceFrom(src, 2 * MiB, 2 * MiB) != FileError::kSuccess);
+
+    file->Close();
+    ::close(src);
+    std::filesystem::remove(srcPath);
+    std::filesystem::remove(dstPath);
+}
+
+#endif
@@ -0,0 +1,141 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the null: and ramdisk: FileOperations backends
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "file_operations_memory.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+using rpi_imager::FileError;
+using rpi_imager::MemoryFileOperations;
+
+TEST_CASE("Memory target paths are parsed", "[file_operations_memory]") {
+    MemoryFileOperations::Mode mode;
+    std::uint64_t size = 0;
+
+    CHECK(MemoryFileOperations::IsMemoryTarget("null:"));
+    CHECK(MemoryFileOperations::IsMemoryTarget("ramdisk:8G"));
+    CHECK(MemoryFileOperations::IsMemoryTarget("replay:/tmp/card.trace"));
+    CHECK(MemoryFileOperations::IsMemoryTarget("emulate:gc"));
+    CHECK_FALSE(MemoryFileOperations::IsMemoryTarget("/dev/sda"));
+    CHECK_FALSE(MemoryFileOperations::IsMemoryTarget("nullish"));
+
+    REQUIRE(MemoryFileOperations::ParseTarget("null:", mode, size));
+    CHECK(mode == MemoryFileOperations::Mode::kNull);
+    CHECK(size == MemoryFileOperations::kDefaultSize);
+
+    REQUIRE(MemoryFileOperations::ParseTarget("ramdisk:512M", mode, size));
+    CHECK(mode == MemoryFileOperations::Mode::kRamdisk);
+    CHECK(size == 512ULL * 1024 * 1024);
+
+    REQUIRE(MemoryFileOperations::ParseTarget("null:2t", mode, size));
+    CHECK(size == 2ULL << 40);
+
+    CHECK_FALSE(MemoryFileOperations::ParseTarget("ramdisk:0", mode, size));
+    CHECK_FALSE(MemoryFileOperations::ParseTarget("ramdisk:12X", mode, size));
+    CHECK_FALSE(MemoryFileOperations::ParseTarget("replay:/tmp/card.trace", mode, size));
+    CHECK_FALSE(MemoryFileOperations::ParseTarget("emulate:gc", mode, size));
+    CHECK_FALSE(MemoryFileOperations::ParseTarget("ramdisk:1GB", mode, size));
+    CHECK_FALSE(MemoryFileOperations::ParseTarget("/dev/sda", mode, size));
+}
+
+TEST_CASE("Null target discards writes and reads a stable pattern", "[file_operations_memory]") {
+    MemoryFileOperations file;
+    REQUIRE(file.OpenDevice("null:16M") == FileError::kSuccess);
+
+    std::uint64_t size = 0;
+    REQUIRE(file.GetSize(size) == FileError::kSuccess);
+    CHECK(size == 16ULL * 1024 * 1024);
+
+    std::vector<std::uint8_t> data(1024 * 1024, 0xAB);
+    REQUIRE(file.WriteSequential(data.data(), data.size()) == FileError::kSuccess);
+    CHECK(file.Tell() == data.size());
+    CHECK(file.GetResidentBytes() == 0);
+
+    // The same range read whole and in odd-sized pieces matches
+    std::vector<std::uint8_t> whole(4096), pieces(4096);
+    std::size_t n = 0;
+    REQUIRE(file.ReadAtOffset(1001, whole.data(), whole.size(), n) == FileError::kSuccess);
+    CHECK(n == whole.size());
+    for (std::size_t off = 0; off < pieces.size(); off += 13) {
+        const std::size_t len = std::min<std::size_t>(13, pieces.size() - off);
+        REQUIRE(file.ReadAtOffset(1001 + off, pieces.data() + off, len, n) == FileError::kSuccess);
+    }
+    CHECK(whole == pieces);
+    CHECK(std::count(whole.begin(), whole.end(), 0xAB) < 100);
+
+    // Writes past the end fail like a full device
+    REQUIRE(file.Seek(size - 512) == FileError::kSuccess);
+    CHECK(file.WriteSequential(data.data(), 1024) == FileError::kWriteError);
+}
+
+TEST_CASE("Ramdisk target keeps written data sparsely", "[file_operations_memory]") {
+    MemoryFileOperations file;
+    REQUIRE(file.OpenDevice("ramdisk:64M") == FileError::kSuccess);
+
+    // Zeros over unwritten space take no memory
+    std::vector<std::uint8_t> zeros(4 * MemoryFileOperations::kChunkSize, 0);
+    REQUIRE(file.WriteSequential(zeros.data(), zeros.size()) == FileError::kSuccess);
+    CHECK(file.GetResidentBytes() == 0);
+
+    // A write straddling two chunks allocates both and reads back intact
+    std::vector<std::uint8_t> data(8192);
+    std::iota(data.begin(), data.end(), static_cast<std::uint8_t>(1));
+    const std::uint64_t offset = 10 * MemoryFileOperations::kChunkSize - 4096;
+    REQUIRE(file.WriteAtOffset(offset, data.data(), data.size()) == FileError::kSuccess);
+    CHECK(file.GetResidentBytes() == 2 * MemoryFileOperations::kChunkSize);
+
+    std::vector<std::uint8_t> readBack(data.size() + 1024);
+    std::size_t n = 0;
+    REQUIRE(file.ReadAtOffset(offset - 512, readBack.data(), readBack.size(), n) == FileError::kSuccess);
+    CHECK(n == readBack.size());
+    CHECK(std::all_of(readBack.begin(), readBack.begin() + 512, [](std::uint8_t b) { return b == 0; }));
+    CHECK(std::memcmp(readBack.data() + 512, data.data(), data.size()) == 0);
+    CHECK(std::all_of(readBack.begin() + 512 + data.size(), readBack.end(), [](std::uint8_t b) { return b == 0; }));
+
+    // Data survives Close(); opening again starts a fresh image
+    REQUIRE(file.Close() == FileError::kSuccess);
+    CHECK_FALSE(file.IsOpen());
+    CHECK(file.GetResidentBytes() == 2 * MemoryFileOperations::kChunkSize);
+    REQUIRE(file.CreateTestFile("unused", 64ULL * 1024 * 1024) == FileError::kSuccess);
+    CHECK(file.GetResidentBytes() == 0);
+
+    // Reads stop at the end of the image
+    REQUIRE(file.Seek(64ULL * 1024 * 1024 - 100) == FileError::kSuccess);
+    REQUIRE(file.ReadSequential(readBack.data(), readBack.size(), n) == FileError::kSuccess);
+    CHECK(n == 100);
+}
+
+TEST_CASE("Ramdisk ZeroRange and EraseDevice release chunks", "[file_operations_memory]") {
+    MemoryFileOperations file;
+    REQUIRE(file.OpenDevice("ramdisk:16M") == FileError::kSuccess);
+    const std::size_t chunk = MemoryFileOperations::kChunkSize;
+
+    std::vector<std::uint8_t> ones(3 * chunk, 1);
+    REQUIRE(file.WriteAtOffset(0, ones.data(), ones.size()) == FileError::kSuccess);
+    CHECK(file.GetResidentBytes() == 3 * chunk);
+
+    // Whole middle chunk dropped, partial ranges zeroed in place
+    REQUIRE(file.ZeroRange(chunk - 512, chunk + 1024) == FileError::kSuccess);
+    CHECK(file.GetResidentBytes() == 2 * chunk);
+
+    std::vector<std::uint8_t> readBack(3 * chunk);
+    std::size_t n = 0;
+    REQUIRE(file.ReadAtOffset(0, readBack.data(), readBack.size(), n) == FileError::kSuccess);
+    for (std::size_t i = 0; i < readBack.size(); ++i) {
+        const bool zeroed = i >= chunk - 512 && i < 2 * chunk + 512;
+        if (readBack[i] != (zeroed ? 0 : 1)) {
+            FAIL("Unexpected byte at offset " << i);
+        }
+    }
+
+    REQUIRE(file.EraseDevice() == FileError::kSuccess);
+    CHECK(file.GetResidentBytes() == 0);
+}
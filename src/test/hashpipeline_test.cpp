@@ -0,0 +1,84 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the ordered hashing thread used while writing
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "hashpipeline.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("HashPipeline hashes buffers in submission order", "[hashpipeline]")
+{
+    std::vector<std::string> buffers;
+    for (int i = 0; i < 200; i++)
+        buffers.push_back("buffer" + std::to_string(i));
+
+    std::string hashed;
+    std::atomic<int> doneCount{0};
+    HashPipeline::Ticket last = 0;
+    {
+        HashPipeline hasher([&hashed](const char *buf, size_t len) { hashed.append(buf, len); });
+        // Many more buffers than kDepth, so submit() has to wait for room
+        for (const std::string &b : buffers)
+            last = hasher.submit(b.data(), b.size(), [&doneCount]() { doneCount++; });
+        hasher.waitAll();
+        CHECK(hasher.isDone(last));
+        CHECK(doneCount == 200);
+    }
+
+    std::string expected;
+    for (const std::string &b : buffers)
+        expected += b;
+    CHECK(hashed == expected);
+    CHECK(last == 200);
+}
+
+TEST_CASE("HashPipeline runs done only after the buffer is hashed", "[hashpipeline]")
+{
+    std::atomic<bool> release{false};
+    std::atomic<int> hashedCount{0};
+    auto order = std::make_shared<std::vector<std::string>>();
+
+    HashPipeline hasher([&](const char *, size_t) {
+        while (!release)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        hashedCount++;
+        order->push_back("hash");
+    });
+
+    char buf[16] = {};
+    const HashPipeline::Ticket ticket = hasher.submit(buf, sizeof(buf), [order]() { order->push_back("done"); });
+    const HashPipeline::Ticket next = hasher.submit(buf, sizeof(buf));
+    CHECK_FALSE(hasher.isDone(ticket));
+
+    release = true;
+    hasher.wait(ticket);
+    CHECK(hashedCount >= 1);
+    hasher.wait(next);
+    CHECK(hasher.isDone(next));
+    CHECK(*order == std::vector<std::string>{"hash", "done", "hash"});
+}
+
+TEST_CASE("HashPipeline finishes queued buffers when destroyed", "[hashpipeline]")
+{
+    std::atomic<int> hashedCount{0};
+    char buf[8] = {};
+    {
+        HashPipeline hasher([&hashedCount](const char *, size_t) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            hashedCount++;
+        });
+        for (int i = 0; i < 10; i++)
+            hasher.submit(buf, sizeof(buf));
+    }
+    CHECK(hashedCount == 10);
+}
@@ -0,0 +1,178 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the deduplicating decompressed image chunk store
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "imagechunkstore.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr qint64 kBlock = ImageChunkStore::kBlockSize;
+
+std::vector<char> randomData(qint64 size, std::uint64_t seed)
+{
+    std::vector<char> data(static_cast<size_t>(size));
+    std::uint64_t x = 0x9E3779B97F4A7C15ull ^ seed;
+    for (auto &c : data)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        c = static_cast<char>(x >> 56);
+    }
+    return data;
+}
+
+QString writeImage(const QTemporaryDir &dir, const QString &name, const std::vector<char> &data)
+{
+    const QString path = dir.filePath(name);
+    QFile file(path);
+    REQUIRE(file.open(QIODevice::WriteOnly));
+    REQUIRE(file.write(data.data(), static_cast<qint64>(data.size())) == static_cast<qint64>(data.size()));
+    return path;
+}
+
+std::vector<char> readBack(const ImageChunkStore &store, const QByteArray &hash, qint64 pieceSize = 1024 * 1024)
+{
+    ImageChunkStore::Reader reader;
+    REQUIRE(reader.open(store.recipePath(hash)));
+    std::vector<char> data(static_cast<size_t>(reader.size()));
+    qint64 pos = 0;
+    while (true)
+    {
+        const qint64 len = reader.read(data.data() + pos, qMin(pieceSize, reader.size() - pos));
+        REQUIRE(len >= 0);
+        if (len == 0)
+            break;
+        pos += len;
+    }
+    REQUIRE(pos == reader.size());
+    return data;
+}
+
+} // namespace
+
+TEST_CASE("Images are read back exactly as added", "[imagechunkstore]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    ImageChunkStore store(dir.filePath("store"));
+
+    // Data, a run of zeros, more data and a trailing partial block
+    auto image = randomData(3 * 1024 * 1024 + 1000, 1);
+    std::fill(image.begin() + 1024 * 1024, image.begin() + 2 * 1024 * 1024 + 100, 0);
+    const QString path = writeImage(dir, "a.img", image);
+
+    REQUIRE(store.addImage(path, "aaaa"));
+    CHECK(store.contains("aaaa"));
+    CHECK_FALSE(store.contains("bbbb"));
+    CHECK(readBack(store, "aaaa") == image);
+    CHECK(readBack(store, "aaaa", 777) == image);
+
+    // The zero run is not stored
+    CHECK(store.storedBytes() < static_cast<qint64>(image.size()) - 1024 * 1024 + 2 * kBlock);
+}
+
+TEST_CASE("An image of zeros takes no space", "[imagechunkstore]") {
+    QTemporaryDir dir;
+    ImageChunkStore store(dir.filePath("store"));
+    const std::vector<char> image(8 * 1024 * 1024, 0);
+
+    REQUIRE(store.addImage(writeImage(dir, "zero.img", image), "zero"));
+    CHECK(store.storedBytes() == 0);
+    CHECK(readBack(store, "zero") == image);
+}
+
+TEST_CASE("Versions share the chunks they have in common", "[imagechunkstore]") {
+    QTemporaryDir dir;
+    ImageChunkStore store(dir.filePath("store"));
+
+    const auto v1 = randomData(16 * 1024 * 1024, 2);
+    REQUIRE(store.addImage(writeImage(dir, "v1.img", v1), "v1"));
+    const qint64 afterV1 = store.storedBytes();
+    CHECK(afterV1 == static_cast<qint64>(v1.size()));
+
+    // Insert a block and change a few others; the chunk boundaries find
+    // their way back after each change
+    auto v2 = v1;
+    const auto inserted = randomData(kBlock, 3);
+    v2.insert(v2.begin() + 5 * 1024 * 1024, inserted.begin(), inserted.end());
+    for (qint64 offset : {qint64(1024 * 1024), qint64(9 * 1024 * 1024), qint64(13 * 1024 * 1024)})
+        v2[static_cast<size_t>(offset)] ^= 0x5a;
+
+    ImageChunkStore::Builder builder(store);
+    REQUIRE(builder.addData(v2.data(), static_cast<qint64>(v2.size())));
+    REQUIRE(builder.finish("v2"));
+    CHECK(builder.totalBytes() == static_cast<qint64>(v2.size()));
+    // Four changes, each costing at most a couple of maximum size chunks
+    CHECK(builder.storedBytes() <= 8 * ImageChunkStore::kMaxChunkBlocks * kBlock);
+    CHECK(store.storedBytes() == afterV1 + builder.storedBytes());
+
+    CHECK(readBack(store, "v1") == v1);
+    CHECK(readBack(store, "v2") == v2);
+}
+
+TEST_CASE("Pruning drops the least recently used images and their chunks", "[imagechunkstore]") {
+    QTemporaryDir dir;
+    ImageChunkStore store(dir.filePath("store"));
+
+    const auto first = randomData(2 * 1024 * 1024, 4);
+    const auto second = randomData(2 * 1024 * 1024, 5);
+    REQUIRE(store.addImage(writeImage(dir, "first.img", first), "first"));
+    REQUIRE(store.addImage(writeImage(dir, "second.img", second), "second"));
+
+    // Make "first" the most recently used
+    QFile recipe(store.recipePath("second"));
+    REQUIRE(recipe.open(QIODevice::ReadWrite));
+    recipe.setFileTime(QDateTime::currentDateTimeUtc().addSecs(-3600), QFileDevice::FileModificationTime);
+    recipe.close();
+    store.touch("first");
+    CHECK(store.images() == QList<QByteArray>({"first", "second"}));
+
+    store.prune(1);
+    CHECK(store.contains("first"));
+    CHECK_FALSE(store.contains("second"));
+    CHECK(store.storedBytes() == static_cast<qint64>(first.size()));
+    CHECK(readBack(store, "first") == first);
+}
+
+TEST_CASE("A missing chunk is a read error", "[imagechunkstore]") {
+    QTemporaryDir dir;
+    ImageChunkStore store(dir.filePath("store"));
+    const auto image = randomData(1024 * 1024, 6);
+    REQUIRE(store.addImage(writeImage(dir, "a.img", image), "aaaa"));
+
+    QDirIterator it(dir.filePath("store/chunks"), QDir::Files, QDirIterator::Subdirectories);
+    REQUIRE(it.hasNext());
+    REQUIRE(QFile::remove(it.next()));
+
+    ImageChunkStore::Reader reader;
+    REQUIRE(reader.open(store.recipePath("aaaa")));
+    std::vector<char> buffer(image.size());
+    qint64 result = 0;
+    qint64 pos = 0;
+    while ((result = reader.read(buffer.data() + pos, static_cast<qint64>(buffer.size()) - pos)) > 0)
+        pos += result;
+    CHECK(result == -1);
+}
+
+TEST_CASE("Garbage collection removes unreferenced chunks only", "[imagechunkstore]") {
+    QTemporaryDir dir;
+    ImageChunkStore store(dir.filePath("store"));
+    const auto image = randomData(1024 * 1024, 7);
+    REQUIRE(store.addImage(writeImage(dir, "a.img", image), "aaaa"));
+    CHECK(store.collectGarbage() == 0);
+
+    store.remove("aaaa");
+    CHECK(store.collectGarbage() == static_cast<qint64>(image.size()));
+    CHECK(store.storedBytes() == 0);
+}
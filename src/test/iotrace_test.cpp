@@ -0,0 +1,246 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for I/O trace recording (TracingFileOperations) and replay
+ * (ReplayFileOperations)
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "file_operations_replay.h"
+#include "file_operations_tracing.h"
+#include "iotrace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using rpi_imager::FileError;
+using rpi_imager::IoTraceOp;
+using rpi_imager::IoTraceRecord;
+using rpi_imager::IoTraceWriter;
+using rpi_imager::MemoryFileOperations;
+using rpi_imager::ReplayFileOperations;
+using rpi_imager::TracingFileOperations;
+
+namespace {
+
+constexpr std::size_t Block = 64 * 1024;
+
+std::string tempPath(const char *name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// A ramdisk that is fast for its first cacheBytes of writes and then
+// takes slowMs per write, and fails one write at failOffset
+class SlowDevice : public MemoryFileOperations
+{
+public:
+    std::uint64_t cacheBytes = 2 * Block;
+    int slowMs = 30;
+    std::uint64_t failOffset = UINT64_MAX;
+
+    FileError WriteAtOffset(std::uint64_t offset, const std::uint8_t *data, std::size_t size) override
+    {
+        written_ += size;
+        if (written_ > cacheBytes)
+            std::this_thread::sleep_for(std::chrono::milliseconds(slowMs));
+        if (offset == failOffset) {
+            failOffset = UINT64_MAX;
+            return FileError::kWriteError;
+        }
+        return MemoryFileOperations::WriteAtOffset(offset, data, size);
+    }
+
+private:
+    std::uint64_t written_ = 0;
+};
+
+std::vector<std::uint8_t> pattern(std::size_t size, std::uint8_t seed)
+{
+    std::vector<std::uint8_t> data(size);
+    for (std::size_t i = 0; i < size; ++i)
+        data[i] = static_cast<std::uint8_t>(seed + i * 7);
+    return data;
+}
+
+int64_t elapsedMs(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Record four sequential writes, a failed retry pair and a sync
+std::string recordTrace(const char *name, std::uint64_t failOffset = UINT64_MAX)
+{
+    const std::string path = tempPath(name);
+    auto device = std::make_unique<SlowDevice>();
+    device->failOffset = failOffset;
+    TracingFileOperations tracing(std::move(device), path);
+    REQUIRE(tracing.IsRecording());
+    REQUIRE(tracing.OpenDevice("ramdisk:4M") == FileError::kSuccess);
+
+    const auto data = pattern(Block, 1);
+    for (int i = 0; i < 4; ++i) {
+        const std::uint64_t offset = tracing.Tell();
+        if (tracing.WriteSequential(data.data(), data.size()) != FileError::kSuccess) {
+            REQUIRE(tracing.Seek(offset) == FileError::kSuccess);
+            REQUIRE(tracing.WriteSequential(data.data(), data.size()) == FileError::kSuccess);
+        }
+    }
+    REQUIRE(tracing.ForceSync() == FileError::kSuccess);
+    REQUIRE(tracing.Close() == FileError::kSuccess);
+    return path;
+}
+
+} // namespace
+
+TEST_CASE("Trace records round trip and a torn last record is dropped", "[iotrace]") {
+    const std::string path = tempPath("rpi_imager_iotrace_roundtrip.trace");
+    {
+        IoTraceWriter writer;
+        REQUIRE(writer.Open(path));
+        IoTraceRecord record;
+        record.op = IoTraceOp::kWrite;
+        record.result = FileError::kWriteError;
+        record.async = true;
+        record.offset = 1ULL << 40;
+        record.length = Block;
+        record.submitUs = 5;
+        record.completeUs = 123456789;
+        writer.Append(record);
+        record.op = IoTraceOp::kQueueDepth;
+        record.value = 8;
+        writer.Append(record);
+        CHECK(writer.RecordCount() == 2);
+    }
+
+    std::vector<IoTraceRecord> records;
+    std::string error;
+    REQUIRE(rpi_imager::ReadIoTrace(path, records, error));
+    REQUIRE(records.size() == 2);
+    CHECK(records[0].op == IoTraceOp::kWrite);
+    CHECK(records[0].result == FileError::kWriteError);
+    CHECK(records[0].async);
+    CHECK(records[0].offset == 1ULL << 40);
+    CHECK(records[0].length == Block);
+    CHECK(records[0].submitUs == 5);
+    CHECK(records[0].completeUs == 123456789);
+    CHECK(records[1].value == 8);
+
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+    REQUIRE(rpi_imager::ReadIoTrace(path, records, error));
+    CHECK(records.size() == 1);
+
+    std::FILE *f = std::fopen(path.c_str(), "r+b");
+    REQUIRE(f);
+    std::fputc('X', f);
+    std::fclose(f);
+    CHECK_FALSE(rpi_imager::ReadIoTrace(path, records, error));
+    CHECK_FALSE(error.empty());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Tracing records each operation and passes it through", "[iotrace]") {
+    const std::string path = recordTrace("rpi_imager_iotrace_record.trace", 2 * Block);
+
+    std::vector<IoTraceRecord> records;
+    std::string error;
+    REQUIRE(rpi_imager::ReadIoTrace(path, records, error));
+    REQUIRE(records.size() == 7);
+    CHECK(records[0].op == IoTraceOp::kOpen);
+    CHECK(records[0].length == 4ULL * 1024 * 1024);
+
+    const std::uint64_t offsets[] = {0, Block, 2 * Block, 2 * Block, 3 * Block};
+    for (int i = 0; i < 5; ++i) {
+        const IoTraceRecord &write = records[1 + i];
+        CHECK(write.op == IoTraceOp::kWrite);
+        CHECK(write.offset == offsets[i]);
+        CHECK(write.length == Block);
+        CHECK(write.completeUs >= write.submitUs);
+        CHECK(write.result == (i == 2 ? FileError::kWriteError : FileError::kSuccess));
+    }
+    // Past the device's cache
+    CHECK(records[4].completeUs - records[4].submitUs >= 30000);
+    CHECK(records[6].op == IoTraceOp::kSync);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Replay reproduces the device's timing and keeps the data", "[iotrace]") {
+    const std::string path = recordTrace("rpi_imager_iotrace_timing.trace");
+
+    ReplayFileOperations replay;
+    CHECK(ReplayFileOperations::IsReplayTarget("replay:" + path));
+    CHECK_FALSE(ReplayFileOperations::IsReplayTarget("ramdisk:4M"));
+    REQUIRE(replay.OpenDevice("replay:" + path) == FileError::kSuccess);
+    CHECK(replay.GetTraceOperationCount() == 5);
+    std::uint64_t size = 0;
+    REQUIRE(replay.GetSize(size) == FileError::kSuccess);
+    CHECK(size == 4ULL * 1024 * 1024);
+
+    const auto data = pattern(Block, 9);
+    std::vector<int64_t> ms;
+    for (int i = 0; i < 4; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        REQUIRE(replay.WriteSequential(data.data(), data.size()) == FileError::kSuccess);
+        ms.push_back(elapsedMs(start));
+    }
+    // The first two writes went to the recorded device's cache
+    CHECK(ms[0] < 25);
+    CHECK(ms[1] < 25);
+    CHECK(ms[2] >= 29);
+    CHECK(ms[3] >= 29);
+
+    std::vector<std::uint8_t> back(Block);
+    std::size_t bytesRead = 0;
+    REQUIRE(replay.ReadAtOffset(3 * Block, back.data(), back.size(), bytesRead) == FileError::kSuccess);
+    CHECK(back == data);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Replay fails a recorded write once, over the same offsets", "[iotrace]") {
+    const std::string path = recordTrace("rpi_imager_iotrace_fail.trace", 2 * Block);
+
+    ReplayFileOperations replay;
+    REQUIRE(replay.OpenDevice("replay:" + path) == FileError::kSuccess);
+    const auto data = pattern(Block, 3);
+    CHECK(replay.WriteAtOffset(0, data.data(), data.size()) == FileError::kSuccess);
+    CHECK(replay.WriteAtOffset(2 * Block + 512, data.data(), 512) == FileError::kWriteError);
+    CHECK(replay.WriteAtOffset(2 * Block, data.data(), data.size()) == FileError::kSuccess);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Replayed async writes complete in order at the device's pace", "[iotrace]") {
+    const std::string path = recordTrace("rpi_imager_iotrace_async.trace");
+
+    ReplayFileOperations replay;
+    REQUIRE(replay.OpenDevice("replay:" + path) == FileError::kSuccess);
+    REQUIRE(replay.SetAsyncQueueDepth(8));
+
+    const auto data = pattern(Block, 5);
+    // Use up the fast part of the trace first
+    REQUIRE(replay.WriteSequential(data.data(), data.size()) == FileError::kSuccess);
+    REQUIRE(replay.WriteSequential(data.data(), data.size()) == FileError::kSuccess);
+
+    std::vector<int> completed;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(replay.AsyncWriteSequential(data.data(), data.size(), [&completed, i](FileError r, std::size_t n) {
+            CHECK(r == FileError::kSuccess);
+            CHECK(n == Block);
+            completed.push_back(i);
+        }) == FileError::kSuccess);
+    }
+    CHECK(elapsedMs(start) < 25);
+    CHECK(replay.GetPendingWriteCount() == 3);
+    CHECK(replay.Tell() == 5 * Block);
+
+    REQUIRE(replay.WaitForPendingWrites() == FileError::kSuccess);
+    CHECK(elapsedMs(start) >= 70);
+    CHECK(completed == std::vector<int>{0, 1, 2});
+    CHECK(replay.GetPendingWriteCount() == 0);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,109 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the daemon's job queue: which queued writes may start
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "jobqueue.h"
+
+namespace {
+
+BatchManifest::Write makeWrite(const QString &image, const QStringList &devices)
+{
+    BatchManifest::Write write;
+    write.job.image = image;
+    write.devices = devices;
+    for (int i = 0; i < devices.size(); i++)
+        write.jobOfDevice.append(QStringLiteral("job"));
+    return write;
+}
+
+} // namespace
+
+TEST_CASE("Writes to different devices run at the same time", "[jobqueue]") {
+    JobQueue queue(4);
+    const int a = queue.enqueue(makeWrite("a.img", {"/dev/sda"}));
+    const int b = queue.enqueue(makeWrite("b.img", {"/dev/sdb", "/dev/sdc"}));
+
+    CHECK(queue.startNext() == a);
+    CHECK(queue.startNext() == b);
+    CHECK(queue.startNext() == 0);
+    CHECK(queue.runningCount() == 2);
+}
+
+TEST_CASE("A write waits for running writes to its devices", "[jobqueue]") {
+    JobQueue queue(4);
+    const int a = queue.enqueue(makeWrite("a.img", {"/dev/sda", "/dev/sdb"}));
+    const int b = queue.enqueue(makeWrite("b.img", {"/dev/sdb"}));
+
+    CHECK(queue.startNext() == a);
+    CHECK(queue.startNext() == 0);
+
+    CHECK(queue.remove(a));
+    CHECK(queue.startNext() == b);
+}
+
+TEST_CASE("A write does not overtake an earlier one wanting its devices", "[jobqueue]") {
+    JobQueue queue(4);
+    const int a = queue.enqueue(makeWrite("a.img", {"/dev/sda"}));
+    const int b = queue.enqueue(makeWrite("b.img", {"/dev/sda", "/dev/sdb"}));
+    const int c = queue.enqueue(makeWrite("c.img", {"/dev/sdb"}));
+    const int d = queue.enqueue(makeWrite("d.img", {"/dev/sdd"}));
+
+    CHECK(queue.startNext() == a);
+    // b waits for sda; c must not take sdb from it, d is independent
+    CHECK(queue.startNext() == d);
+    CHECK(queue.startNext() == 0);
+
+    queue.remove(a);
+    CHECK(queue.startNext() == b);
+    queue.remove(b);
+    CHECK(queue.startNext() == c);
+}
+
+TEST_CASE("Writes of a running image wait for it, so they use the cache", "[jobqueue]") {
+    JobQueue queue(4);
+    const int a = queue.enqueue(makeWrite("os.img", {"/dev/sda"}));
+    const int b = queue.enqueue(makeWrite("os.img", {"/dev/sdb"}));
+    const int c = queue.enqueue(makeWrite("other.img", {"/dev/sdc"}));
+
+    CHECK(queue.startNext() == a);
+    CHECK(queue.startNext() == c);
+    CHECK(queue.startNext() == 0);
+
+    queue.remove(a);
+    CHECK(queue.startNext() == b);
+}
+
+TEST_CASE("No more writes run than there are slots", "[jobqueue]") {
+    JobQueue queue(2);
+    const int a = queue.enqueue(makeWrite("a.img", {"/dev/sda"}));
+    const int b = queue.enqueue(makeWrite("b.img", {"/dev/sdb"}));
+    const int c = queue.enqueue(makeWrite("c.img", {"/dev/sdc"}));
+
+    CHECK(queue.startNext() == a);
+    CHECK(queue.startNext() == b);
+    CHECK(queue.startNext() == 0);
+
+    queue.remove(b);
+    CHECK(queue.startNext() == c);
+}
+
+TEST_CASE("Queued and running writes claim their devices", "[jobqueue]") {
+    JobQueue queue(1);
+    const int a = queue.enqueue(makeWrite("a.img", {"/dev/sda"}));
+    const int b = queue.enqueue(makeWrite("b.img", {"/dev/sdb"}));
+    CHECK(queue.startNext() == a);
+
+    CHECK(queue.claimedDevices() == QSet<QString>{"/dev/sda", "/dev/sdb"});
+    REQUIRE(queue.find(b));
+    CHECK_FALSE(queue.find(b)->running);
+
+    // A queued write that is cancelled is simply removed
+    CHECK(queue.remove(b));
+    CHECK_FALSE(queue.remove(b));
+    CHECK(queue.find(b) == nullptr);
+    CHECK(queue.claimedDevices() == QSet<QString>{"/dev/sda"});
+}
@@ -0,0 +1,102 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Unit tests for the log-linear LatencyHistogram used for per-I/O latencies.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "latencyhistogram.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using rpi_imager::LatencyHistogram;
+
+TEST_CASE("LatencyHistogram buckets cover every value exactly once", "[latencyhistogram]")
+{
+    REQUIRE(LatencyHistogram::BucketLowerBound(0) == 0);
+    for (int b = 0; b < LatencyHistogram::kBucketCount - 1; ++b) {
+        REQUIRE(LatencyHistogram::BucketUpperBound(b) + 1 == LatencyHistogram::BucketLowerBound(b + 1));
+        REQUIRE(LatencyHistogram::BucketFor(LatencyHistogram::BucketLowerBound(b)) == b);
+        REQUIRE(LatencyHistogram::BucketFor(LatencyHistogram::BucketUpperBound(b)) == b);
+    }
+    REQUIRE(LatencyHistogram::BucketFor(UINT64_MAX) == LatencyHistogram::kBucketCount - 1);
+}
+
+TEST_CASE("LatencyHistogram bucket width stays within 1/16 of its value", "[latencyhistogram]")
+{
+    for (int b = LatencyHistogram::kSubBuckets; b < LatencyHistogram::kBucketCount - 1; ++b) {
+        const uint64_t lower = LatencyHistogram::BucketLowerBound(b);
+        const uint64_t width = LatencyHistogram::BucketUpperBound(b) - lower + 1;
+        REQUIRE(width * LatencyHistogram::kSubBuckets <= lower);
+    }
+}
+
+TEST_CASE("LatencyHistogram quantiles find the tail", "[latencyhistogram]")
+{
+    auto histogram = std::make_unique<LatencyHistogram>();
+    // 990 fast writes and 10 GC pauses of 250ms
+    for (int i = 0; i < 990; ++i)
+        histogram->Record(100);
+    for (int i = 0; i < 10; ++i)
+        histogram->Record(250000);
+
+    REQUIRE(histogram->Count() == 1000);
+    REQUIRE(histogram->MaxUs() == 250000);
+
+    const auto counts = histogram->Snapshot();
+    const uint64_t p50 = LatencyHistogram::ValueAtQuantile(counts, 0.50, histogram->MaxUs());
+    const uint64_t p99 = LatencyHistogram::ValueAtQuantile(counts, 0.99, histogram->MaxUs());
+    const uint64_t p999 = LatencyHistogram::ValueAtQuantile(counts, 0.999, histogram->MaxUs());
+    REQUIRE(p50 >= 100);
+    REQUIRE(p50 < 107);
+    REQUIRE(p99 < 107);
+    REQUIRE(p999 == 250000);
+}
+
+TEST_CASE("LatencyHistogram quantile of an empty snapshot is zero", "[latencyhistogram]")
+{
+    auto histogram = std::make_unique<LatencyHistogram>();
+    REQUIRE(LatencyHistogram::ValueAtQuantile(histogram->Snapshot(), 0.99, 0) == 0);
+}
+
+TEST_CASE("LatencyHistogram merges and resets", "[latencyhistogram]")
+{
+    auto a = std::make_unique<LatencyHistogram>();
+    auto b = std::make_unique<LatencyHistogram>();
+    a->Record(5);
+    b->Record(5);
+    b->Record(5000);
+
+    a->MergeFrom(*b);
+    REQUIRE(a->Count() == 3);
+    REQUIRE(a->MaxUs() == 5000);
+    REQUIRE(a->Snapshot()[static_cast<size_t>(LatencyHistogram::BucketFor(5))] == 2);
+
+    a->Reset();
+    REQUIRE(a->Count() == 0);
+    REQUIRE(a->MaxUs() == 0);
+}
+
+TEST_CASE("LatencyHistogram records from several threads", "[latencyhistogram]")
+{
+    auto histogram = std::make_unique<LatencyHistogram>();
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 10000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&histogram, t] {
+            for (int i = 0; i < kPerThread; ++i)
+                histogram->Record(static_cast<uint64_t>(t * kPerThread + i));
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    REQUIRE(histogram->Count() == kThreads * kPerThread);
+    REQUIRE(histogram->MaxUs() == kThreads * kPerThread - 1);
+}
@@ -0,0 +1,110 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the live metrics rendered for Prometheus
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "livemetrics.h"
+#include "latencyhistogram.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+bool has(const std::string &text, const std::string &line)
+{
+    return text.find(line + "\n") != std::string::npos;
+}
+
+std::vector<uint64_t> snapshotOf(const std::vector<uint64_t> &latenciesUs)
+{
+    rpi_imager::LatencyHistogram histogram;
+    for (uint64_t us : latenciesUs)
+        histogram.Record(us);
+    return histogram.Snapshot();
+}
+
+} // namespace
+
+TEST_CASE("Counters and gauges render in OpenMetrics text", "[livemetrics]") {
+    LiveMetrics metrics;
+    metrics.addPhaseBytes(LiveMetrics::Phase::Download, 1000);
+    metrics.addPhaseBytes(LiveMetrics::Phase::Download, 24);
+    metrics.addPhaseBytes(LiveMetrics::Phase::Write, 4096);
+    metrics.setWriteThroughput(20 * 1024 * 1024);
+    metrics.setRingOccupancy(3, 7);
+    metrics.setAsyncQueue(32, 30);
+    metrics.addRecovery(LiveMetrics::Recovery::QueueDepth);
+    metrics.addRecovery(LiveMetrics::Recovery::QueueDepth);
+
+    const std::string text = metrics.render();
+    CHECK(has(text, "# TYPE rpi_imager_phase_bytes counter"));
+    CHECK(has(text, "# UNIT rpi_imager_phase_bytes bytes"));
+    CHECK(has(text, "rpi_imager_phase_bytes_total{phase=\"download\"} 1024"));
+    CHECK(has(text, "rpi_imager_phase_bytes_total{phase=\"write\"} 4096"));
+    CHECK(has(text, "rpi_imager_phase_bytes_total{phase=\"verify\"} 0"));
+    CHECK(has(text, "rpi_imager_write_throughput_bytes_per_second 20971520"));
+    CHECK(has(text, "rpi_imager_ring_buffer_slots_used{ring=\"input\"} 3"));
+    CHECK(has(text, "rpi_imager_ring_buffer_slots_used{ring=\"write\"} 7"));
+    CHECK(has(text, "rpi_imager_async_queue_depth 32"));
+    CHECK(has(text, "rpi_imager_async_pending_writes 30"));
+    CHECK(has(text, "rpi_imager_watchdog_recoveries_total{action=\"queueDepth\"} 2"));
+    CHECK(has(text, "rpi_imager_watchdog_recoveries_total{action=\"restart\"} 0"));
+    // The exposition must end with EOF
+    CHECK(text.size() >= 6);
+    CHECK(text.compare(text.size() - 6, 6, "# EOF\n") == 0);
+
+    metrics.reset();
+    CHECK(has(metrics.render(), "rpi_imager_phase_bytes_total{phase=\"download\"} 0"));
+}
+
+TEST_CASE("Latency histograms are cumulative over fixed bounds", "[livemetrics]") {
+    LiveMetrics metrics;
+    metrics.publishLatency("/dev/sda", "write", snapshotOf({50, 800, 900, 3000, 20000000}));
+
+    const std::string text = metrics.render();
+    const std::string labels = "device=\"/dev/sda\",operation=\"write\"";
+    CHECK(has(text, "# TYPE rpi_imager_io_latency_seconds histogram"));
+    CHECK(has(text, "rpi_imager_io_latency_seconds_bucket{" + labels + ",le=\"0.0001\"} 1"));
+    CHECK(has(text, "rpi_imager_io_latency_seconds_bucket{" + labels + ",le=\"0.00025\"} 1"));
+    CHECK(has(text, "rpi_imager_io_latency_seconds_bucket{" + labels + ",le=\"0.001\"} 3"));
+    CHECK(has(text, "rpi_imager_io_latency_seconds_bucket{" + labels + ",le=\"0.0025\"} 3"));
+    // 3 ms is counted under 5 ms, the first bound its histogram bucket fits in
+    CHECK(has(text, "rpi_imager_io_latency_seconds_bucket{" + labels + ",le=\"0.005\"} 4"));
+    CHECK(has(text, "rpi_imager_io_latency_seconds_bucket{" + labels + ",le=\"10\"} 4"));
+    CHECK(has(text, "rpi_imager_io_latency_seconds_bucket{" + labels + ",le=\"+Inf\"} 5"));
+    CHECK(has(text, "rpi_imager_io_latency_seconds_count{" + labels + "} 5"));
+}
+
+TEST_CASE("Republishing counts only what was added", "[livemetrics]") {
+    LiveMetrics metrics;
+    rpi_imager::LatencyHistogram histogram;
+    histogram.Record(800);
+    metrics.publishLatency("/dev/sda", "write", histogram.Snapshot());
+    histogram.Record(800);
+    histogram.Record(800);
+    metrics.publishLatency("/dev/sda", "write", histogram.Snapshot());
+    metrics.publishLatency("/dev/sda", "write", histogram.Snapshot());
+
+    const std::string labels = "device=\"/dev/sda\",operation=\"write\"";
+    CHECK(has(metrics.render(), "rpi_imager_io_latency_seconds_count{" + labels + "} 3"));
+
+    // The next write to the device starts a new histogram; the series carries on
+    metrics.publishLatency("/dev/sda", "write", snapshotOf({800}));
+    CHECK(has(metrics.render(), "rpi_imager_io_latency_seconds_count{" + labels + "} 4"));
+
+    // Devices and operations are series of their own
+    metrics.publishLatency("/dev/sdb", "sync", snapshotOf({500000}));
+    const std::string text = metrics.render();
+    CHECK(has(text, "rpi_imager_io_latency_seconds_count{" + labels + "} 4"));
+    CHECK(has(text, "rpi_imager_io_latency_seconds_count{device=\"/dev/sdb\",operation=\"sync\"} 1"));
+}
+
+TEST_CASE("Label values are escaped", "[livemetrics]") {
+    CHECK(LiveMetrics::escapeLabel("/dev/sda") == "/dev/sda");
+    CHECK(LiveMetrics::escapeLabel("\\\\.\\PhysicalDrive1") == "\\\\\\\\.\\\\PhysicalDrive1");
+    CHECK(LiveMetrics::escapeLabel("a\"b\nc") == "a\\\"b\\nc");
+}
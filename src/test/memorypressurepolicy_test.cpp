@@ -0,0 +1,92 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for sizing buffers and caches by memory pressure
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "memorypressurepolicy.h"
+
+using Level = MemoryPressurePolicy::Level;
+
+TEST_CASE("Pressure shrinks at once and recovers in steps", "[memorypressurepolicy]") {
+    MemoryPressurePolicy policy(1000);
+    CHECK(policy.scalePercent() == 100);
+    CHECK_FALSE(policy.onLevel(Level::Normal, 0));
+
+    CHECK(policy.onLevel(Level::Warning, 100));
+    CHECK(policy.scalePercent() == MemoryPressurePolicy::WarningPercent);
+    CHECK(policy.onLevel(Level::Critical, 200));
+    CHECK(policy.scalePercent() == MemoryPressurePolicy::CriticalPercent);
+
+    // A warning after critical does not grow anything
+    CHECK_FALSE(policy.onLevel(Level::Warning, 300));
+    CHECK(policy.scalePercent() == MemoryPressurePolicy::CriticalPercent);
+
+    // Calm for less than a step changes nothing
+    CHECK_FALSE(policy.onLevel(Level::Normal, 1000));
+    CHECK(policy.onLevel(Level::Normal, 1300));
+    CHECK(policy.scalePercent() == 50);
+
+    // Pressure coming back restarts the calm period
+    CHECK_FALSE(policy.onLevel(Level::Warning, 1500));
+    CHECK_FALSE(policy.onLevel(Level::Normal, 2400));
+    CHECK(policy.onLevel(Level::Normal, 2500));
+    CHECK(policy.scalePercent() == 100);
+    CHECK_FALSE(policy.onLevel(Level::Normal, 10000));
+    CHECK(policy.level() == Level::Normal);
+}
+
+TEST_CASE("PSI averages map to levels", "[memorypressurepolicy]") {
+    Level level = Level::Critical;
+    CHECK(MemoryPressurePolicy::levelFromPsi(
+        "some avg10=0.50 avg60=0.20 avg300=0.05 total=1234\n"
+        "full avg10=0.00 avg60=0.00 avg300=0.00 total=10\n", level));
+    CHECK(level == Level::Normal);
+
+    CHECK(MemoryPressurePolicy::levelFromPsi(
+        "some avg10=12.00 avg60=3.00 avg300=1.00 total=1234\n"
+        "full avg10=1.00 avg60=0.00 avg300=0.00 total=10\n", level));
+    CHECK(level == Level::Warning);
+
+    // Every task stalled is worse than a high share of some stalling
+    CHECK(MemoryPressurePolicy::levelFromPsi(
+        "some avg10=8.00 avg60=3.00 avg300=1.00 total=1234\n"
+        "full avg10=6.50 avg60=0.00 avg300=0.00 total=10\n", level));
+    CHECK(level == Level::Critical);
+
+    // Kernels before 5.13 report no "full" line for the system
+    CHECK(MemoryPressurePolicy::levelFromPsi("some avg10=45.00 avg60=3.00 avg300=1.00 total=1234\n", level));
+    CHECK(level == Level::Critical);
+
+    CHECK_FALSE(MemoryPressurePolicy::levelFromPsi("", level));
+}
+
+TEST_CASE("cgroup memory events map to levels", "[memorypressurepolicy]") {
+    MemoryPressurePolicy::MemoryEvents before;
+    REQUIRE(MemoryPressurePolicy::parseMemoryEvents("low 0\nhigh 3\nmax 1\noom 0\noom_kill 0\n", before));
+    CHECK(before.high == 3);
+    CHECK(before.max == 1);
+    CHECK(before.oomKill == 0);
+    CHECK_FALSE(MemoryPressurePolicy::parseMemoryEvents("", before));
+
+    MemoryPressurePolicy::MemoryEvents after = before;
+    CHECK(MemoryPressurePolicy::levelFromMemoryEvents(before, after) == Level::Normal);
+    after.high = 5;
+    CHECK(MemoryPressurePolicy::levelFromMemoryEvents(before, after) == Level::Warning);
+    after.max = 2;
+    CHECK(MemoryPressurePolicy::levelFromMemoryEvents(before, after) == Level::Critical);
+    after = before;
+    after.oomKill = 1;
+    CHECK(MemoryPressurePolicy::levelFromMemoryEvents(before, after) == Level::Critical);
+}
+
+TEST_CASE("Available memory maps to levels", "[memorypressurepolicy]") {
+    CHECK(MemoryPressurePolicy::levelFromAvailable(4096, 8192) == Level::Normal);
+    CHECK(MemoryPressurePolicy::levelFromAvailable(700, 8192) == Level::Warning);
+    CHECK(MemoryPressurePolicy::levelFromAvailable(300, 8192) == Level::Critical);
+    // The fixed floor matters on small boards
+    CHECK(MemoryPressurePolicy::levelFromAvailable(200, 1024) == Level::Critical);
+    CHECK(MemoryPressurePolicy::levelFromAvailable(0, 0) == Level::Normal);
+}
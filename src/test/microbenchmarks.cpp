@@ -0,0 +1,383 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Microbenchmarks for the hot paths of the write pipeline and customisation.
+ *
+ * Tagged [.benchmark] so a plain run does nothing; run with
+ *   ./microbenchmarks "[benchmark]"
+ * Results are also written as JSON to $RPI_IMAGER_BENCHMARK_JSON
+ * (default microbenchmarks.json) for regression tracking.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark_all.hpp>
+#include <catch2/reporters/catch_reporter_event_listener.hpp>
+#include <catch2/reporters/catch_reporter_registrars.hpp>
+
+#include "acceleratedcryptographichash.h"
+#include "customization_generator.h"
+#include "devicewrapper.h"
+#include "devicewrapperfatpartition.h"
+#include "disk_formatter.h"
+#include "fastboot/sparse_encoder.h"
+#include "file_operations.h"
+#include "ringbuffer.h"
+#include "xxhash64.h"
+#ifdef __linux__
+#include "linux/sha256_kernel.h"
+#include <gnutls/crypto.h>
+#endif
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QTemporaryDir>
+#include <QVariantMap>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ── Regression JSON ─────────────────────────────────────────────────────
+
+namespace {
+    // Bytes each benchmark processes per iteration, for MB/s in the JSON
+    std::map<std::string, double> &throughputBytes()
+    {
+        static std::map<std::string, double> bytes;
+        return bytes;
+    }
+
+    // Name a benchmark and record how much data one iteration handles
+    std::string named(const std::string &name, double bytesPerIteration)
+    {
+        throughputBytes()[name] = bytesPerIteration;
+        return name;
+    }
+
+    std::string jsonString(const std::string &s)
+    {
+        std::string out = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    class BenchmarkJsonListener : public Catch::EventListenerBase
+    {
+    public:
+        using Catch::EventListenerBase::EventListenerBase;
+
+        void benchmarkEnded(Catch::BenchmarkStats<> const &stats) override
+        {
+            Result r;
+            r.name = stats.info.name;
+            r.meanNs = stats.mean.point.count();
+            r.lowMeanNs = stats.mean.lower_bound.count();
+            r.highMeanNs = stats.mean.upper_bound.count();
+            r.stddevNs = stats.standardDeviation.point.count();
+            r.samples = stats.samples.size();
+            r.iterations = stats.info.iterations;
+            _results.push_back(r);
+        }
+
+        void testRunEnded(Catch::TestRunStats const &) override
+        {
+            if (_results.empty())
+                return;
+
+            const char *env = std::getenv("RPI_IMAGER_BENCHMARK_JSON");
+            const std::string path = env && *env ? env : "microbenchmarks.json";
+            std::ofstream out(path);
+            if (!out)
+                return;
+
+            const std::time_t now = std::time(nullptr);
+            char timestamp[32];
+            std::strftime(timestamp, sizeof timestamp, "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+            out << "{\n  \"version\": 1,\n"
+                << "  \"timestamp\": " << jsonString(timestamp) << ",\n"
+                << "  \"context\": {\n"
+                << "    \"sha256Backend\": " << jsonString(AcceleratedCryptographicHash::backendName().toStdString()) << ",\n"
+                << "    \"blockClassifier\": " << jsonString(fastboot::blockClassifierName()) << ",\n"
+                << "    \"crc32Kernel\": " << jsonString(fastboot::crc32KernelName()) << ",\n"
+                << "    \"hardwareThreads\": " << std::thread::hardware_concurrency() << "\n"
+                << "  },\n  \"benchmarks\": [\n";
+            for (size_t i = 0; i < _results.size(); ++i) {
+                const Result &r = _results[i];
+                out << "    {\"name\": " << jsonString(r.name)
+                    << ", \"meanNs\": " << r.meanNs
+                    << ", \"lowMeanNs\": " << r.lowMeanNs
+                    << ", \"highMeanNs\": " << r.highMeanNs
+                    << ", \"stddevNs\": " << r.stddevNs
+                    << ", \"samples\": " << r.samples
+                    << ", \"iterations\": " << r.iterations;
+                const auto bytes = throughputBytes().find(r.name);
+                if (bytes != throughputBytes().end() && r.meanNs > 0) {
+                    out << ", \"bytesPerIteration\": " << bytes->second
+                        << ", \"MBps\": " << bytes->second / r.meanNs * 1e9 / (1024.0 * 1024.0);
+                }
+                out << "}" << (i + 1 < _results.size() ? "," : "") << "\n";
+            }
+            out << "  ]\n}\n";
+        }
+
+    private:
+        struct Result {
+            std::string name;
+            double meanNs, lowMeanNs, highMeanNs, stddevNs;
+            size_t samples;
+            int iterations;
+        };
+        std::vector<Result> _results;
+    };
+}
+
+CATCH_REGISTER_LISTENER(BenchmarkJsonListener)
+
+// ── Test data ───────────────────────────────────────────────────────────
+
+namespace {
+    constexpr size_t MB = 1024 * 1024;
+
+    std::vector<uint8_t> randomData(size_t size)
+    {
+        std::vector<uint8_t> data(size);
+        std::mt19937_64 rng(42);
+        for (size_t i = 0; i + 8 <= size; i += 8) {
+            const uint64_t v = rng();
+            std::memcpy(data.data() + i, &v, 8);
+        }
+        return data;
+    }
+
+    std::vector<uint8_t> fillData(size_t size, uint32_t pattern)
+    {
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i + 4 <= size; i += 4)
+            std::memcpy(data.data() + i, &pattern, 4);
+        return data;
+    }
+}
+
+// ── RingBuffer ──────────────────────────────────────────────────────────
+
+TEST_CASE("RingBuffer acquire/commit throughput", "[.benchmark][ringbuffer]")
+{
+    constexpr size_t SLOT_SIZE = 64 * 1024;
+    constexpr int SLOTS = 16;
+    constexpr int HANDOFFS = 4096;
+
+    RingBuffer rb(SLOTS, SLOT_SIZE);
+    BENCHMARK(named("RingBuffer handoff, one thread", SLOT_SIZE))
+    {
+        RingBuffer::Slot *w = rb.acquireWriteSlot(1000);
+        rb.commitWriteSlot(w, SLOT_SIZE);
+        RingBuffer::Slot *r = rb.acquireReadSlot(1000);
+        rb.releaseReadSlot(r);
+        return r;
+    };
+
+    BENCHMARK_ADVANCED(named("RingBuffer handoff x4096, two threads", HANDOFFS * double(SLOT_SIZE)))(Catch::Benchmark::Chronometer meter)
+    {
+        meter.measure([] {
+            RingBuffer shared(SLOTS, SLOT_SIZE);
+            std::thread consumer([&shared] {
+                while (RingBuffer::Slot *slot = shared.acquireReadSlot(1000))
+                    shared.releaseReadSlot(slot);
+            });
+            for (int i = 0; i < HANDOFFS; ++i) {
+                RingBuffer::Slot *slot = shared.acquireWriteSlot(1000);
+                if (!slot)
+                    break;
+                shared.commitWriteSlot(slot, SLOT_SIZE);
+            }
+            shared.producerDone();
+            consumer.join();
+            return shared.isComplete();
+        });
+    };
+}
+
+// ── SparseEncoder ───────────────────────────────────────────────────────
+
+namespace {
+    size_t encodeAll(const std::vector<uint8_t> &image, unsigned threads, bool checksums = false)
+    {
+        fastboot::SparseEncoder enc(64 * MB, image.size());
+        enc.setClassifyThreads(threads);
+        enc.setChecksums(checksums);
+        std::vector<uint8_t> segment;
+        size_t wire = 0;
+        size_t off = 0;
+        while (off < image.size()) {
+            off += enc.feed(image.data() + off, std::min<size_t>(4 * MB, image.size() - off));
+            while (enc.takeSegment(segment))
+                wire += segment.size();
+        }
+        while (true) {
+            enc.finish();
+            if (!enc.takeSegment(segment))
+                break;
+            wire += segment.size();
+        }
+        return wire;
+    }
+}
+
+TEST_CASE("SparseEncoder feed throughput", "[.benchmark][sparse]")
+{
+    constexpr size_t IMAGE_SIZE = 128 * MB;
+    const auto zero = fillData(IMAGE_SIZE, 0);
+    const auto fill = fillData(IMAGE_SIZE, 0xdeadbeef);
+    const auto random = randomData(IMAGE_SIZE);
+    const unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+
+    BENCHMARK(named("SparseEncoder 128 MB zero", IMAGE_SIZE)) { return encodeAll(zero, 0); };
+    BENCHMARK(named("SparseEncoder 128 MB fill", IMAGE_SIZE)) { return encodeAll(fill, 0); };
+    BENCHMARK(named("SparseEncoder 128 MB random", IMAGE_SIZE)) { return encodeAll(random, 0); };
+    BENCHMARK(named("SparseEncoder 128 MB random, parallel classify", IMAGE_SIZE)) { return encodeAll(random, threads); };
+    BENCHMARK(named("SparseEncoder 128 MB random, CRC32 chunks", IMAGE_SIZE)) { return encodeAll(random, 0, true); };
+    BENCHMARK(named("SparseEncoder 128 MB zero, CRC32 chunks", IMAGE_SIZE)) { return encodeAll(zero, 0, true); };
+}
+
+// ── Hashing ─────────────────────────────────────────────────────────────
+
+TEST_CASE("SHA256 throughput per backend", "[.benchmark][hash]")
+{
+    constexpr size_t SIZE = 64 * MB;
+    const auto data = randomData(SIZE);
+    const char *bytes = reinterpret_cast<const char *>(data.data());
+    const std::string backend = AcceleratedCryptographicHash::backendName().toStdString();
+
+    BENCHMARK(named("AcceleratedCryptographicHash 64 MB sequential (" + backend + ")", SIZE))
+    {
+        AcceleratedCryptographicHash hash(QCryptographicHash::Sha256);
+        for (size_t off = 0; off < SIZE; off += MB)
+            hash.addData(bytes + off, static_cast<int>(MB));
+        return hash.result();
+    };
+
+    BENCHMARK(named("AcceleratedCryptographicHash 64 MB tree (" + backend + ")", SIZE))
+    {
+        AcceleratedCryptographicHash hash(QCryptographicHash::Sha256, AcceleratedCryptographicHash::Mode::Tree);
+        for (size_t off = 0; off < SIZE; off += MB)
+            hash.addData(bytes + off, static_cast<int>(MB));
+        return hash.result();
+    };
+
+    BENCHMARK(named("AcceleratedCryptographicHash 64 MB comparison (XXH64 blocks)", SIZE))
+    {
+        AcceleratedCryptographicHash hash(QCryptographicHash::Sha256, AcceleratedCryptographicHash::Mode::Comparison);
+        for (size_t off = 0; off < SIZE; off += MB)
+            hash.addData(bytes + off, static_cast<int>(MB));
+        return hash.result();
+    };
+
+    BENCHMARK(named("xxhash64 64 MB", SIZE))
+    {
+        return xxhash64(bytes, SIZE);
+    };
+
+    BENCHMARK(named("QCryptographicHash 64 MB", SIZE))
+    {
+        return QCryptographicHash::hash(QByteArrayView(bytes, static_cast<qsizetype>(SIZE)), QCryptographicHash::Sha256);
+    };
+
+#ifdef __linux__
+    // The two backends AcceleratedCryptographicHash chooses between
+    if (Sha256Kernel::backend() != Sha256Kernel::Backend::None) {
+        BENCHMARK(named(std::string("Sha256Kernel 64 MB (") + Sha256Kernel::backendName(Sha256Kernel::backend()) + ")", SIZE))
+        {
+            Sha256Kernel kernel;
+            kernel.addData(bytes, SIZE);
+            uint8_t digest[32];
+            kernel.result(digest);
+            return digest[0];
+        };
+    }
+
+    BENCHMARK(named("GnuTLS 64 MB", SIZE))
+    {
+        uint8_t digest[32];
+        gnutls_hash_fast(GNUTLS_DIG_SHA256, bytes, SIZE, digest);
+        return digest[0];
+    };
+#endif
+}
+
+// ── FAT ─────────────────────────────────────────────────────────────────
+
+TEST_CASE("DeviceWrapperFatPartition::writeFile", "[.benchmark][fat]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const std::string imagePath = dir.filePath("fat.img").toStdString();
+
+    rpi_imager::DiskFormatter formatter;
+    REQUIRE(static_cast<bool>(formatter.FormatFile(imagePath, 256 * MB)));
+
+    auto fileOps = rpi_imager::FileOperations::Create();
+    REQUIRE(fileOps->OpenDevice(imagePath) == rpi_imager::FileError::kSuccess);
+    DeviceWrapper dw(fileOps.get());
+    DeviceWrapperFatPartition *fat = dw.fatPartition(1);
+    REQUIRE(fat != nullptr);
+
+    const QByteArray config(4 * 1024, 'c');
+    const QByteArray firstrun(64 * 1024, 'f');
+    const QByteArray large(4 * MB, 'l');
+
+    BENCHMARK(named("FAT writeFile 4 KB", config.size())) { fat->writeFile("config.txt", config); };
+    BENCHMARK(named("FAT writeFile 64 KB", firstrun.size())) { fat->writeFile("firstrun.sh", firstrun); };
+    BENCHMARK(named("FAT writeFile 4 MB", large.size())) { fat->writeFile("kernel.img", large); };
+    BENCHMARK(named("FAT writeFile 4 KB + sync", config.size()))
+    {
+        fat->writeFile("cmdline.txt", config);
+        dw.sync();
+    };
+
+    dw.sync();
+    fileOps->Close();
+}
+
+// ── CustomisationGenerator ──────────────────────────────────────────────
+
+TEST_CASE("CustomisationGenerator", "[.benchmark][customization]")
+{
+    QVariantMap settings;
+    settings["hostname"] = "benchpi";
+    settings["sshEnabled"] = true;
+    settings["sshUserName"] = "pi";
+    settings["sshUserPassword"] = "$5$abcdefgh$0123456789012345678901234567890123456789012";
+    settings["sshAuthorizedKeys"] = "ssh-ed25519 AAAAC3NzaC1lZDI1NTE5AAAAIBenchmarkKeyOne\nssh-ed25519 AAAAC3NzaC1lZDI1NTE5AAAAIBenchmarkKeyTwo";
+    settings["wifiSSID"] = "BenchNet";
+    settings["recommendedWifiCountry"] = "GB";
+    settings["timezone"] = "Europe/London";
+    settings["keyboard"] = "gb";
+    settings["enableSerial"] = true;
+
+    QVariantMap precomputed = settings;
+    precomputed["wifiPasswordCrypt"] = QString(64, 'a');
+
+    QVariantMap passphrase = settings;
+    passphrase["wifiPassword"] = "correct horse battery staple";
+
+    using rpi_imager::CustomisationGenerator;
+
+    BENCHMARK("generateSystemdScript, precomputed PSK") { return CustomisationGenerator::generateSystemdScript(precomputed); };
+    BENCHMARK("generateSystemdScript, passphrase (PBKDF2)") { return CustomisationGenerator::generateSystemdScript(passphrase); };
+    BENCHMARK("generateCloudInitUserData") { return CustomisationGenerator::generateCloudInitUserData(precomputed, QString(), true, true, "pi"); };
+    BENCHMARK("generateCloudInitNetworkConfig") { return CustomisationGenerator::generateCloudInitNetworkConfig(precomputed, true); };
+}
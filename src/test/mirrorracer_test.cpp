@@ -0,0 +1,58 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for choosing between mirrors of an image download
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "mirrorracer.h"
+
+namespace {
+
+MirrorRacer::Probe probe(qint64 ttfbMs, qint64 bytesPerSecond, bool ok = true)
+{
+    MirrorRacer::Probe p;
+    p.ok = ok;
+    p.ttfbMs = ttfbMs;
+    p.bytesPerSecond = bytesPerSecond;
+    return p;
+}
+
+constexpr qint64 kMB = 1024 * 1024;
+
+} // namespace
+
+TEST_CASE("Link rel=duplicate headers", "[mirrorracer]") {
+    CHECK(MirrorRacer::parseDuplicateLinks("Content-Type: text/plain").isEmpty());
+
+    // As sent by MirrorBrain, best mirror (lowest pri) first
+    const QByteArray header =
+        "Link: <https://b.example/img.xz>; rel=duplicate; pri=2; geo=de, "
+        "<https://a.example/img.xz>; rel=duplicate; pri=1; geo=gb, "
+        "<https://example/img.xz.meta4>; rel=describedby; type=\"application/metalink4+xml\"\r\n";
+    CHECK(MirrorRacer::parseDuplicateLinks(header) ==
+          QList<QByteArray>{"https://a.example/img.xz", "https://b.example/img.xz"});
+
+    CHECK(MirrorRacer::parseDuplicateLinks("link: <http://c.example/x>; rel=\"duplicate\"") ==
+          QList<QByteArray>{"http://c.example/x"});
+    CHECK(MirrorRacer::parseDuplicateLinks("Link: <ftp://d.example/x>; rel=duplicate").isEmpty());
+    CHECK(MirrorRacer::parseDuplicateLinks("Link: <https://e.example/x").isEmpty());
+}
+
+TEST_CASE("The mirror predicted to finish first is picked", "[mirrorracer]") {
+    // Throughput decides for a large download, latency for a small one
+    const QList<MirrorRacer::Probe> probes{probe(300, 2 * kMB), probe(20, 1 * kMB), probe(100, 10 * kMB)};
+    CHECK(MirrorRacer::pickBest(probes, 1024 * kMB) == 2);
+    CHECK(MirrorRacer::pickBest(probes, 0) == 1);
+    CHECK(MirrorRacer::predictedMs(probes[2], 10 * kMB) == 1100);
+
+    // Failed probes are skipped
+    CHECK(MirrorRacer::pickBest({probe(10, 0, false), probe(50, kMB)}, kMB) == 1);
+    CHECK(MirrorRacer::pickBest({probe(10, kMB, false)}, kMB) == -1);
+}
+
+TEST_CASE("The first candidate is kept unless another is clearly faster", "[mirrorracer]") {
+    CHECK(MirrorRacer::pickBest({probe(0, 10 * kMB), probe(0, 11 * kMB)}, 1024 * kMB) == 0);
+    CHECK(MirrorRacer::pickBest({probe(0, 10 * kMB), probe(0, 13 * kMB)}, 1024 * kMB) == 1);
+}
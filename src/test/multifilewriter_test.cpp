@@ -0,0 +1,181 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for writing multi-file archives with parallel small file writes
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "multifilewriter.h"
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+struct TestEntry {
+    std::string name;
+    std::size_t size;
+    bool directory = false;
+};
+
+char byteAt(const std::string &name, std::size_t offset)
+{
+    return static_cast<char>(offset * 31 + name.size());
+}
+
+std::vector<char> createZipInMemory(const std::vector<TestEntry> &entries)
+{
+    std::vector<char> buf(32 * 1024 * 1024);
+    size_t used = 0;
+    ::archive *a = archive_write_new();
+    archive_write_set_format_zip(a);
+    archive_write_open_memory(a, buf.data(), buf.size(), &used);
+
+    for (const TestEntry &e : entries)
+    {
+        ::archive_entry *entry = archive_entry_new();
+        archive_entry_set_pathname(entry, e.name.c_str());
+        archive_entry_set_filetype(entry, e.directory ? AE_IFDIR : AE_IFREG);
+        archive_entry_set_perm(entry, e.directory ? 0755 : 0644);
+        archive_entry_set_size(entry, static_cast<la_int64_t>(e.size));
+        archive_write_header(a, entry);
+        std::vector<char> data(e.size);
+        for (std::size_t i = 0; i < e.size; i++)
+            data[i] = byteAt(e.name, i);
+        if (!data.empty())
+            archive_write_data(a, data.data(), data.size());
+        archive_entry_free(entry);
+    }
+    archive_write_close(a);
+    archive_write_free(a);
+
+    buf.resize(used);
+    return buf;
+}
+
+// Extracts zip into the current directory; returns the bytes written
+std::uint64_t extractAll(const std::vector<char> &zip, int workers, QStringList *files = nullptr, QStringList *dirs = nullptr)
+{
+    std::atomic<std::uint64_t> bytesWritten{0};
+    std::atomic<bool> cancelled{false};
+    ::archive *a = archive_read_new();
+    archive_read_support_format_zip(a);
+    archive_read_open_memory(a, zip.data(), zip.size());
+    {
+        MultiFileWriter writer(ARCHIVE_EXTRACT_TIME | ARCHIVE_EXTRACT_SECURE_NODOTDOT | ARCHIVE_EXTRACT_NO_OVERWRITE,
+                               bytesWritten, cancelled, workers);
+        ::archive_entry *entry;
+        while (archive_read_next_header(a, &entry) == ARCHIVE_OK)
+            writer.extract(a, entry);
+        writer.finish();
+        CHECK(writer.close());
+        if (files)
+            *files = writer.files();
+        if (dirs)
+            *dirs = writer.directories();
+    }
+    archive_read_free(a);
+    return bytesWritten;
+}
+
+bool hasContents(const TestEntry &e)
+{
+    QFile f(QString::fromStdString(e.name));
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = f.readAll();
+    if (static_cast<std::size_t>(data.size()) != e.size)
+        return false;
+    for (std::size_t i = 0; i < e.size; i++)
+    {
+        if (data[static_cast<qsizetype>(i)] != byteAt(e.name, i))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("Small and large files are all written", "[multifilewriter]") {
+    std::vector<TestEntry> entries;
+    entries.push_back({"overlays/", 0, true});
+    std::uint64_t total = 0;
+    // More than a batch of small files, some of them empty
+    for (int i = 0; i < 300; i++)
+    {
+        entries.push_back({"overlays/file" + std::to_string(i), static_cast<std::size_t>(i) * 211});
+        total += static_cast<std::uint64_t>(i) * 211;
+    }
+    // Larger than a chunk, so written on the calling thread in pieces
+    entries.push_back({"os/root.tar.xz", MultiFileWriter::kChunkSize * 2 + 12345});
+    total += MultiFileWriter::kChunkSize * 2 + 12345;
+    // The parent directory is not in the archive
+    entries.push_back({"os/partitions.json", 1000});
+    total += 1000;
+
+    const std::vector<char> zip = createZipInMemory(entries);
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString previous = QDir::currentPath();
+    REQUIRE(QDir::setCurrent(dir.path()));
+
+    for (int workers : {1, 4})
+    {
+        QDir(dir.path()).removeRecursively();
+        QDir().mkpath(dir.path());
+        REQUIRE(QDir::setCurrent(dir.path()));
+
+        QStringList files, dirs;
+        CHECK(extractAll(zip, workers, &files, &dirs) == total);
+        CHECK(files.size() == 302);
+        CHECK(dirs == QStringList{"overlays/"});
+        for (const TestEntry &e : entries)
+        {
+            if (!e.directory)
+                CHECK(hasContents(e));
+        }
+    }
+
+    QDir::setCurrent(previous);
+}
+
+TEST_CASE("Abort drops queued files", "[multifilewriter]") {
+    std::vector<TestEntry> entries;
+    for (int i = 0; i < 500; i++)
+        entries.push_back({"f" + std::to_string(i), 100});
+    const std::vector<char> zip = createZipInMemory(entries);
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString previous = QDir::currentPath();
+    REQUIRE(QDir::setCurrent(dir.path()));
+
+    std::atomic<std::uint64_t> bytesWritten{0};
+    std::atomic<bool> cancelled{true};
+    ::archive *a = archive_read_new();
+    archive_read_support_format_zip(a);
+    archive_read_open_memory(a, zip.data(), zip.size());
+    {
+        MultiFileWriter writer(0, bytesWritten, cancelled, 2);
+        ::archive_entry *entry;
+        while (archive_read_next_header(a, &entry) == ARCHIVE_OK)
+            writer.extract(a, entry);
+        writer.abort();
+        CHECK(writer.close());
+    }
+    archive_read_free(a);
+
+    // Once cancelled, the workers write nothing more
+    CHECK(bytesWritten == 0);
+    CHECK(QDir(dir.path()).entryList(QDir::Files).isEmpty());
+
+    QDir::setCurrent(previous);
+}
@@ -0,0 +1,110 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for reading OS list entries as the list downloads
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "osliststreamparser.h"
+#include "oslisttree.h"
+
+#include <algorithm>
+
+namespace {
+
+const QByteArray kList = R"({
+    "imager": {"latest_version": "2.0.0", "devices": [{"name": "Pi 5", "tags": ["pi5"]}]},
+    "unused": ["os_list", {"os_list": []}],
+    "os_list": [
+        {"name": "Raspberry Pi OS", "description": "Brace } and \"quote\" in a string", "devices": ["pi5"]},
+        {"name": "Other", "subitems": [{"name": "Nested", "subitems": []}]},
+        {"name": "Media", "subitems_url": "https://example.com/media.json"}
+    ]
+})";
+
+QStringList names(const QList<QJsonObject> &entries)
+{
+    QStringList list;
+    for (const auto &entry : entries)
+        list.append(entry.value("name").toString());
+    return list;
+}
+
+} // namespace
+
+TEST_CASE("Stream parser hands out top-level entries and the imager metadata", "[osliststreamparser]") {
+    OsListStreamParser parser;
+    const QList<QJsonObject> entries = parser.feed(kList);
+
+    CHECK(names(entries) == QStringList{"Raspberry Pi OS", "Other", "Media"});
+    CHECK(entries[0].value("description").toString() == "Brace } and \"quote\" in a string");
+    CHECK(entries[1].value("subitems").toArray().size() == 1);
+    CHECK(parser.imagerMetadata().value("latest_version").toString() == "2.0.0");
+    CHECK(parser.isComplete());
+    CHECK(parser.entryCount() == 3);
+}
+
+TEST_CASE("Stream parser gives the same entries however the body is split", "[osliststreamparser]") {
+    for (qsizetype split = 1; split < kList.size(); ++split) {
+        OsListStreamParser parser;
+        QList<QJsonObject> entries = parser.feed(QByteArrayView(kList).first(split));
+        entries += parser.feed(QByteArrayView(kList).sliced(split));
+
+        INFO("split at " << split);
+        REQUIRE(names(entries) == QStringList{"Raspberry Pi OS", "Other", "Media"});
+        REQUIRE(parser.isComplete());
+    }
+}
+
+TEST_CASE("Entries complete before the rest of the list arrives", "[osliststreamparser]") {
+    const qsizetype secondEntry = kList.indexOf("{\"name\": \"Other\"");
+    OsListStreamParser parser;
+
+    CHECK(names(parser.feed(QByteArrayView(kList).first(secondEntry))) == QStringList{"Raspberry Pi OS"});
+    CHECK_FALSE(parser.isComplete());
+    CHECK(names(parser.feed(QByteArrayView(kList).sliced(secondEntry))) == QStringList{"Other", "Media"});
+}
+
+TEST_CASE("Stream parser stops at malformed input", "[osliststreamparser]") {
+    SECTION("Root is not an object") {
+        OsListStreamParser parser;
+        CHECK(parser.feed("[{\"os_list\": []}]").isEmpty());
+        CHECK(parser.hasError());
+    }
+
+    SECTION("Entry does not parse") {
+        OsListStreamParser parser;
+        CHECK(names(parser.feed("{\"os_list\": [{\"name\": \"a\"}, {\"name\": }]}")) == QStringList{"a"});
+        CHECK(parser.hasError());
+        CHECK_FALSE(parser.isComplete());
+    }
+
+    SECTION("Body is cut short") {
+        OsListStreamParser parser;
+        parser.feed(kList.left(kList.size() - 3));
+        CHECK_FALSE(parser.hasError());
+        CHECK_FALSE(parser.isComplete());
+    }
+}
+
+TEST_CASE("A tree built from streamed entries matches one built from the document", "[osliststreamparser]") {
+    OsListStreamParser parser;
+    OsListTree streamed;
+    for (qsizetype offset = 0; offset < kList.size(); offset += 16) {
+        for (const QJsonObject &entry : parser.feed(QByteArrayView(kList).sliced(offset, std::min<qsizetype>(16, kList.size() - offset))))
+            streamed.appendTopLevel(entry);
+    }
+    streamed.setImagerMetadata(parser.imagerMetadata());
+
+    const OsListTree whole(QJsonDocument::fromJson(kList));
+    CHECK(streamed.toDocument() == whole.toDocument());
+
+    // Filters cached before an append cover the new rows
+    const QJsonArray tags{"pi5"};
+    OsListTree growing;
+    growing.appendTopLevel(QJsonObject{{"name", "First"}, {"devices", QJsonArray{"pi4"}}});
+    CHECK(growing.filteredList(tags, false).isEmpty());
+    growing.appendTopLevel(QJsonObject{{"name", "Second"}, {"devices", tags}});
+    CHECK(growing.filteredList(tags, false).size() == 1);
+}
@@ -0,0 +1,97 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for full-text search over the OS list
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "ossearchindex.h"
+#include "oslisttree.h"
+
+namespace {
+
+QJsonObject leaf(const QString &name, const QString &description, const QStringList &devices = {})
+{
+    QJsonObject entry{{"name", name}, {"description", description}, {"url", "https://example.com/" + name}};
+    if (!devices.isEmpty())
+        entry.insert("devices", QJsonArray::fromStringList(devices));
+    return entry;
+}
+
+QStringList names(const QJsonArray &results)
+{
+    QStringList list;
+    for (const auto &value : results)
+        list.append(value.toObject().value("name").toString());
+    return list;
+}
+
+} // namespace
+
+TEST_CASE("Search index matches every word anywhere in a document", "[ossearchindex]") {
+    OsSearchIndex index;
+    REQUIRE(index.add("Raspberry Pi OS (64-bit)", "A port of Debian Bookworm") == 0);
+    REQUIRE(index.add("Ubuntu Server 24.04", "Server OS for arm64 Raspberry Pi computers") == 1);
+    REQUIRE(index.add("LibreELEC", "Kodi media centre") == 2);
+
+    CHECK(index.search("bookworm", 10) == QList<int>{0});
+    CHECK(index.search("RASPBERRY", 10) == QList<int>({0, 1}));
+    CHECK(index.search("server raspberry", 10) == QList<int>{1});
+    CHECK(index.search("kodi debian", 10).isEmpty());
+    CHECK(index.search("   ", 10).isEmpty());
+}
+
+TEST_CASE("Search index ranks name matches first", "[ossearchindex]") {
+    OsSearchIndex index;
+    index.add("Emulation", "Retro gaming with RetroPie");
+    index.add("RetroPie", "Turn your Pi into a retro console");
+
+    CHECK(index.search("retropie", 10) == QList<int>({1, 0}));
+    CHECK(index.search("retropie", 1) == QList<int>{1});
+}
+
+TEST_CASE("Short words match word prefixes", "[ossearchindex]") {
+    OsSearchIndex index;
+    index.add("Ubuntu Desktop", "");
+    index.add("Raspberry Pi OS Lite", "");
+
+    CHECK(index.search("u", 10) == QList<int>{0});
+    CHECK(index.search("pi", 10) == QList<int>{1});
+    // "pi" is not at the start of a word in "Ubuntu Desktop"
+    CHECK(index.search("de pi", 10).isEmpty());
+}
+
+TEST_CASE("Trigrams alone do not make a match", "[ossearchindex]") {
+    OsSearchIndex index;
+    // Has "abc" and "bcd" but not "abcd"
+    index.add("abc bcd", "");
+    CHECK(index.search("abcd", 10).isEmpty());
+    CHECK(index.search("abc", 10) == QList<int>{0});
+}
+
+TEST_CASE("Tree search covers sublists as they arrive", "[ossearchindex]") {
+    QJsonObject category{{"name", "Media"}, {"description", "Media centres"}, {"subitems_url", "https://example.com/media.json"}};
+    QJsonArray list{leaf("Raspberry Pi OS", "Debian Bookworm", {"pi5-64bit"}), category};
+    OsListTree tree(QJsonDocument(QJsonObject{{"os_list", list}}));
+
+    CHECK(tree.search("kodi", {}, true, 10).isEmpty());
+
+    tree.insertSublist("https://example.com/media.json", QJsonArray{
+        leaf("LibreELEC", "Kodi for Pi 5", {"pi5-64bit"}),
+        leaf("OSMC", "Kodi for Pi 4", {"pi4-64bit"}),
+    });
+
+    CHECK(names(tree.search("kodi", {}, true, 10)) == QStringList({"LibreELEC", "OSMC"}));
+    CHECK(names(tree.search("kodi", QJsonArray{"pi4-64bit"}, false, 10)) == QStringList{"OSMC"});
+    // Device tags are searchable too
+    CHECK(names(tree.search("pi5", {}, true, 10)) == QStringList({"Raspberry Pi OS", "LibreELEC"}));
+
+    // A category comes with its filtered subitems
+    const QJsonArray media = tree.search("media", QJsonArray{"pi4-64bit"}, false, 10);
+    REQUIRE(media.size() == 1);
+    CHECK(names(media.first().toObject().value("subitems").toArray()) == QStringList{"OSMC"});
+
+    tree.clear();
+    CHECK(tree.search("kodi", {}, true, 10).isEmpty());
+}
@@ -0,0 +1,97 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Unit tests for the lock-free PerfEventRing used by PerformanceStats.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "perfeventring.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    PerfEventRing::Record makeRecord(int64_t n)
+    {
+        PerfEventRing::Record r{};
+        r.timestampNs = n;
+        r.durationUs = static_cast<uint32_t>(n);
+        r.payload = n * 2;
+        return r;
+    }
+}
+
+TEST_CASE("PerfEventRing drains records in order", "[perfeventring]")
+{
+    auto ring = std::make_unique<PerfEventRing>();
+
+    for (int round = 0; round < 3; ++round) {
+        for (int64_t i = 0; i < 100; ++i)
+            REQUIRE(ring->push(makeRecord(round * 100 + i)));
+
+        std::vector<int64_t> seen;
+        CHECK(ring->drain([&seen](const PerfEventRing::Record &r) { seen.push_back(r.timestampNs); }) == 100);
+        REQUIRE(seen.size() == 100);
+        for (int64_t i = 0; i < 100; ++i)
+            CHECK(seen[static_cast<size_t>(i)] == round * 100 + i);
+
+        CHECK(ring->drain([](const PerfEventRing::Record &) {}) == 0);
+    }
+}
+
+TEST_CASE("PerfEventRing drops records when full", "[perfeventring]")
+{
+    auto ring = std::make_unique<PerfEventRing>();
+
+    for (size_t i = 0; i < PerfEventRing::Capacity; ++i)
+        REQUIRE(ring->push(makeRecord(static_cast<int64_t>(i))));
+    CHECK_FALSE(ring->push(makeRecord(-1)));
+    CHECK_FALSE(ring->push(makeRecord(-1)));
+    CHECK(ring->takeDropped() == 2);
+    CHECK(ring->takeDropped() == 0);
+
+    // Draining makes room again
+    CHECK(ring->drain([](const PerfEventRing::Record &) {}) == PerfEventRing::Capacity);
+    CHECK(ring->push(makeRecord(0)));
+}
+
+TEST_CASE("PerfEventRing has one producer at a time", "[perfeventring]")
+{
+    auto ring = std::make_unique<PerfEventRing>();
+
+    CHECK(ring->claim());
+    CHECK_FALSE(ring->claim());
+    ring->release();
+    CHECK(ring->claim());
+}
+
+TEST_CASE("PerfEventRing transfers records between threads without loss", "[perfeventring]")
+{
+    auto ring = std::make_unique<PerfEventRing>();
+    constexpr int64_t total = 200000;
+
+    std::thread producer([&ring]() {
+        for (int64_t i = 0; i < total; ) {
+            if (ring->push(makeRecord(i)))
+                ++i;
+            else
+                std::this_thread::yield();
+        }
+    });
+
+    int64_t expected = 0;
+    bool ordered = true;
+    while (expected < total) {
+        ring->drain([&](const PerfEventRing::Record &r) {
+            ordered = ordered && r.timestampNs == expected && r.payload == expected * 2;
+            ++expected;
+        });
+    }
+    producer.join();
+
+    CHECK(ordered);
+    CHECK(expected == total);
+}
@@ -0,0 +1,101 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for PipelineBalancer
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "pipelinebalancer.h"
+
+namespace {
+
+constexpr int64_t Interval = PipelineBalancer::IntervalMs;
+
+// Adds one interval's waits to the running totals
+struct Waits
+{
+    PipelineBalancer &balancer;
+    PipelineBalancer::Sample totals;
+
+    bool step(uint64_t writerWaitMs, uint64_t inputWaitMs, uint64_t preHashWaitMs)
+    {
+        totals.writerWaitMs += writerWaitMs;
+        totals.decoderInputWaitMs += inputWaitMs;
+        totals.preHashWaitMs += preHashWaitMs;
+        return balancer.update(totals, Interval);
+    }
+};
+
+} // namespace
+
+TEST_CASE("Decompression starts with all it can use, leaving a core for hashing", "[pipelinebalancer]") {
+    PipelineBalancer four(4, 4);
+    CHECK(four.decodeThreads() == 3);
+    CHECK(four.hashThreads() == 1);
+
+    PipelineBalancer many(16, 8);
+    CHECK(many.decodeThreads() == 8);
+    CHECK(many.hashThreads() == 8);
+
+    PipelineBalancer single(1, 8);
+    CHECK(single.decodeThreads() == 1);
+    CHECK(single.hashThreads() == 1);
+}
+
+TEST_CASE("Hash stalls move workers to hashing, one per interval", "[pipelinebalancer]") {
+    PipelineBalancer balancer(8, 8);
+    Waits waits{balancer, {}};
+    REQUIRE(balancer.decodeThreads() == 7);
+
+    CHECK(waits.step(0, 0, 100));
+    CHECK(balancer.decodeThreads() == 6);
+    CHECK(balancer.hashThreads() == 2);
+
+    for (int i = 0; i < 10; ++i)
+        waits.step(0, 0, 100);
+    CHECK(balancer.decodeThreads() == 1);
+    CHECK(balancer.hashThreads() == 7);
+    CHECK_FALSE(waits.step(0, 0, 100));
+}
+
+TEST_CASE("Decode stalls move workers back, up to the decoder's threads", "[pipelinebalancer]") {
+    PipelineBalancer balancer(8, 4);
+    Waits waits{balancer, {}};
+    waits.step(0, 0, 200);
+    waits.step(0, 0, 200);
+    REQUIRE(balancer.decodeThreads() == 2);
+
+    CHECK(waits.step(200, 0, 0));
+    CHECK(waits.step(200, 0, 0));
+    CHECK(balancer.decodeThreads() == 4);
+    CHECK_FALSE(waits.step(200, 0, 0));
+    CHECK(balancer.hashThreads() == 4);
+    CHECK(balancer.shifts() == 4);
+}
+
+TEST_CASE("A slow download or short waits change nothing", "[pipelinebalancer]") {
+    PipelineBalancer balancer(8, 8);
+    Waits waits{balancer, {}};
+    waits.step(0, 0, 100);
+    REQUIRE(balancer.decodeThreads() == 6);
+
+    // The decoder waits for input too: more decode threads would not help
+    CHECK_FALSE(waits.step(300, 300, 0));
+    // Below StallPercent of the interval
+    CHECK_FALSE(waits.step(40, 0, 40));
+    CHECK(balancer.decodeThreads() == 6);
+}
+
+TEST_CASE("The longer wait wins when both stages stall", "[pipelinebalancer]") {
+    PipelineBalancer balancer(8, 8);
+    Waits waits{balancer, {}};
+    waits.step(0, 0, 100);
+    waits.step(0, 0, 100);
+    REQUIRE(balancer.decodeThreads() == 5);
+
+    CHECK(waits.step(300, 0, 100));
+    CHECK(balancer.decodeThreads() == 6);
+    CHECK(waits.step(100, 0, 300));
+    CHECK(balancer.decodeThreads() == 5);
+}
@@ -126,6 +126,86 @@ TEST_CASE("Windows parseDeviceNumber parses PhysicalDrive paths", "[platformquir
 
 #endif // Q_OS_WIN && PLATFORMQUIRKS_ENABLE_TEST_API
 
+// ============================================================================
+// Linux-specific tests (enabled via test API)
+// ============================================================================
+
+#if defined(Q_OS_LINUX) && defined(PLATFORMQUIRKS_ENABLE_TEST_API)
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+// Declared in platformquirks_linux.cpp when test API is enabled
+namespace PlatformQuirks {
+namespace TestAPI {
+    QString holdDevicePowerOn(const QString& sysRoot, const QString& device);
+}
+}
+
+static void writeSysfsFile(const QString& path, const QByteArray& content) {
+    QFile f(path);
+    REQUIRE(f.open(QIODevice::WriteOnly));
+    f.write(content);
+}
+
+static QByteArray readSysfsFile(const QString& path) {
+    QFile f(path);
+    REQUIRE(f.open(QIODevice::ReadOnly));
+    return f.readAll().trimmed();
+}
+
+TEST_CASE("Linux holdDevicePowerOn keeps a USB card reader awake", "[platformquirks][linux]") {
+    QTemporaryDir sys;
+    REQUIRE(sys.isValid());
+
+    // sda behind a mass storage interface of USB device 2-1, on port 1 of bus 2
+    const QString usbDev = sys.filePath("devices/pci0/usb2/2-1");
+    const QString port = sys.filePath("devices/pci0/usb2/2-0:1.0/usb2-port1");
+    const QString scsiDev = usbDev + "/2-1:1.0/host0/target0:0:0/0:0:0:0";
+    REQUIRE(QDir().mkpath(usbDev + "/power"));
+    REQUIRE(QDir().mkpath(port));
+    REQUIRE(QDir().mkpath(scsiDev));
+    REQUIRE(QDir().mkpath(sys.filePath("block/sda")));
+    REQUIRE(QFile::link(scsiDev, sys.filePath("block/sda/device")));
+    REQUIRE(QFile::link(port, usbDev + "/port"));
+    writeSysfsFile(usbDev + "/idVendor", "05e3\n");
+    writeSysfsFile(usbDev + "/power/control", "auto\n");
+    writeSysfsFile(usbDev + "/power/usb2_hardware_lpm", "y\n");
+    writeSysfsFile(port + "/usb3_lpm_permit", "u1_u2\n");
+
+    const QString changed = PlatformQuirks::TestAPI::holdDevicePowerOn(sys.path(), "/dev/sda");
+    CHECK(changed.contains("power/control auto -> on"));
+    CHECK(readSysfsFile(usbDev + "/power/control") == "on");
+    CHECK(readSysfsFile(usbDev + "/power/usb2_hardware_lpm") == "0");
+    CHECK(readSysfsFile(port + "/usb3_lpm_permit") == "0");
+
+    // Held already
+    CHECK(PlatformQuirks::TestAPI::holdDevicePowerOn(sys.path(), "/dev/sda").isEmpty());
+
+    PlatformQuirks::releaseDevicePower("/dev/sda");
+    CHECK(readSysfsFile(usbDev + "/power/control") == "auto");
+    CHECK(readSysfsFile(usbDev + "/power/usb2_hardware_lpm") == "y");
+    CHECK(readSysfsFile(port + "/usb3_lpm_permit") == "u1_u2");
+}
+
+TEST_CASE("Linux holdDevicePowerOn leaves disks not on USB alone", "[platformquirks][linux]") {
+    QTemporaryDir sys;
+    REQUIRE(sys.isValid());
+
+    const QString mmcDev = sys.filePath("devices/platform/mmc0/mmc0:0001");
+    REQUIRE(QDir().mkpath(mmcDev + "/power"));
+    REQUIRE(QDir().mkpath(sys.filePath("block/mmcblk0")));
+    REQUIRE(QFile::link(mmcDev, sys.filePath("block/mmcblk0/device")));
+    writeSysfsFile(mmcDev + "/power/control", "auto\n");
+
+    CHECK(PlatformQuirks::TestAPI::holdDevicePowerOn(sys.path(), "/dev/mmcblk0").isEmpty());
+    CHECK(readSysfsFile(mmcDev + "/power/control") == "auto");
+    CHECK(PlatformQuirks::TestAPI::holdDevicePowerOn(sys.path(), "/tmp/image.img").isEmpty());
+}
+
+#endif // Q_OS_LINUX && PLATFORMQUIRKS_ENABLE_TEST_API
+
 // ============================================================================
 // Basic sanity tests (should not crash, return reasonable values)
 // ============================================================================
@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the image primed for station mode
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "primedimage.h"
+#include "imagechunkstore.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+namespace {
+
+// Data, then a long run of zeros, then data again
+QByteArray imageData()
+{
+    QByteArray data;
+    for (int i = 0; i < 3 * 1024 * 1024; i++)
+        data.append(static_cast<char>(i * 7 + i / 4096));
+    data.append(QByteArray(6 * 1024 * 1024, '\0'));
+    data.append(QByteArray(5000, 'x'));
+    return data;
+}
+
+QByteArray readFile(const QString &path)
+{
+    QFile f(path);
+    REQUIRE(f.open(QIODevice::ReadOnly));
+    return f.readAll();
+}
+
+} // namespace
+
+TEST_CASE("An image that fits the budget is primed in RAM, otherwise on disk", "[primedimage]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QByteArray data = imageData();
+    const QString source = dir.filePath("cache.img");
+    {
+        QFile f(source);
+        REQUIRE(f.open(QIODevice::WriteOnly));
+        f.write(data);
+    }
+    std::atomic<bool> cancelled{false};
+
+    PrimedImage image(dir.filePath("ram"), dir.filePath("disk"));
+    REQUIRE(image.prime(source, "abcd", data.size(), cancelled));
+    CHECK(image.location() == PrimedImage::Location::Memory);
+    CHECK(image.path().startsWith(dir.filePath("ram")));
+    CHECK(image.size() == data.size());
+    CHECK(readFile(image.path()) == data);
+
+    REQUIRE(image.prime(source, "abcd", data.size() - 1, cancelled));
+    CHECK(image.location() == PrimedImage::Location::Disk);
+    CHECK(image.path().startsWith(dir.filePath("disk")));
+    CHECK(readFile(image.path()) == data);
+
+    const QString path = image.path();
+    image.release();
+    CHECK_FALSE(QFile::exists(path));
+    CHECK(image.location() == PrimedImage::Location::None);
+
+    cancelled = true;
+    CHECK_FALSE(image.prime(source, "abcd", data.size(), cancelled));
+    CHECK(image.path().isEmpty());
+}
+
+TEST_CASE("An image in the chunk store is primed whole", "[primedimage]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QByteArray data = imageData();
+    const QString source = dir.filePath("cache.img");
+    {
+        QFile f(source);
+        REQUIRE(f.open(QIODevice::WriteOnly));
+        f.write(data);
+    }
+    ImageChunkStore store(dir.filePath("store"));
+    REQUIRE(store.addImage(source, "abcd"));
+    QFile::remove(source);
+
+    std::atomic<bool> cancelled{false};
+    PrimedImage image(QString(), dir.filePath("disk"));
+    REQUIRE(image.prime(store.recipePath("abcd"), "abcd", data.size(), cancelled));
+    // No RAM directory
+    CHECK(image.location() == PrimedImage::Location::Disk);
+    CHECK(readFile(image.path()) == data);
+}
@@ -0,0 +1,154 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for stepping the async queue back up after watchdog reductions
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "queuedepthrecovery.h"
+
+#include <vector>
+
+using State = QueueDepthRecovery::State;
+using Transition = QueueDepthRecovery::Transition;
+
+namespace {
+
+constexpr int64_t kSteadyMs = 15000;
+constexpr uint64_t kHealthyUs = 20 * 1000;
+constexpr uint64_t kSlowUs = 5 * 1000 * 1000;
+
+// Checks once a second with progress and the given latency until a
+// transition, or for at most maxMs
+QueueDepthRecovery::Step runUntilTransition(QueueDepthRecovery &recovery, int &depth, int64_t &nowMs,
+                                            uint64_t tailUs, int64_t maxMs = 120000)
+{
+    const int64_t end = nowMs + maxMs;
+    while (nowMs < end)
+    {
+        nowMs += 1000;
+        const auto step = recovery.onCheck(depth, true, tailUs, 100, nowMs);
+        if (step.transition != Transition::None)
+        {
+            if (step.transition == Transition::StepUp || step.transition == Transition::ResumeAsync)
+                depth = step.toDepth;
+            return step;
+        }
+    }
+    return {};
+}
+
+} // namespace
+
+TEST_CASE("Nothing happens without a reduction", "[queuedepthrecovery]") {
+    QueueDepthRecovery recovery(kSteadyMs);
+    int depth = 16;
+    int64_t now = 0;
+    CHECK(runUntilTransition(recovery, depth, now, kHealthyUs).transition == Transition::None);
+    CHECK(recovery.state() == State::Normal);
+}
+
+TEST_CASE("A drained queue resumes async and doubles back to full depth", "[queuedepthrecovery]") {
+    QueueDepthRecovery recovery(kSteadyMs);
+    int depth = 16;
+    int64_t now = 0;
+    runUntilTransition(recovery, depth, now, kHealthyUs, 5000);
+
+    recovery.onReduced(16, 8, now);
+    recovery.onReduced(8, 1, now);
+    depth = 1;
+    CHECK(recovery.targetDepth() == 16);
+
+    const int64_t reducedAt = now;
+    auto step = runUntilTransition(recovery, depth, now, kHealthyUs);
+    CHECK(step.transition == Transition::ResumeAsync);
+    CHECK(step.toDepth == QueueDepthRecovery::MinDepth);
+    CHECK(now - reducedAt >= kSteadyMs);
+
+    std::vector<int> depths;
+    for (int i = 0; i < 10 && recovery.state() != State::Normal; ++i)
+    {
+        step = runUntilTransition(recovery, depth, now, kHealthyUs);
+        depths.push_back(step.toDepth);
+    }
+    CHECK(depths == std::vector<int>{4, 8, 16, 16});
+    CHECK(step.transition == Transition::Recovered);
+}
+
+TEST_CASE("No step while latency is still high", "[queuedepthrecovery]") {
+    QueueDepthRecovery recovery(kSteadyMs);
+    int depth = 16;
+    int64_t now = 0;
+    runUntilTransition(recovery, depth, now, kHealthyUs, 5000);
+    recovery.onReduced(16, 8, now);
+    depth = 8;
+
+    CHECK(runUntilTransition(recovery, depth, now, kSlowUs, 60000).transition == Transition::None);
+    CHECK(recovery.state() == State::Degraded);
+
+    // Latency back to normal: step up after one more steady period
+    CHECK(runUntilTransition(recovery, depth, now, kHealthyUs).transition == Transition::StepUp);
+    CHECK(depth == 16);
+}
+
+TEST_CASE("Stalls restart the steady period", "[queuedepthrecovery]") {
+    QueueDepthRecovery recovery(kSteadyMs);
+    int depth = 8;
+    int64_t now = 0;
+    recovery.onReduced(8, 4, now);
+    depth = 4;
+
+    for (int i = 0; i < 30; ++i)
+    {
+        now += 1000;
+        // One check in three without progress
+        const auto step = recovery.onCheck(depth, i % 3 != 0, kHealthyUs, 100, now);
+        CHECK(step.transition == Transition::None);
+    }
+}
+
+TEST_CASE("Failed probes back off and then give up", "[queuedepthrecovery]") {
+    QueueDepthRecovery recovery(kSteadyMs);
+    int depth = 16;
+    int64_t now = 0;
+    recovery.onReduced(16, 8, now);
+    depth = 8;
+
+    for (int attempt = 1; attempt <= QueueDepthRecovery::MaxFailedProbes; ++attempt)
+    {
+        const auto step = runUntilTransition(recovery, depth, now, kHealthyUs, 1000000);
+        REQUIRE(step.transition == Transition::StepUp);
+
+        // The device stalls again at the higher depth
+        const auto failed = recovery.onReduced(depth, 8, now);
+        depth = 8;
+        if (attempt < QueueDepthRecovery::MaxFailedProbes)
+        {
+            CHECK(failed.transition == Transition::ProbeFailed);
+            CHECK(recovery.steadyMs() == kSteadyMs << attempt);
+        }
+        else
+        {
+            CHECK(failed.transition == Transition::GaveUp);
+        }
+    }
+
+    CHECK(recovery.state() == State::GaveUp);
+    CHECK(runUntilTransition(recovery, depth, now, kHealthyUs, 600000).transition == Transition::None);
+}
+
+TEST_CASE("A reduction by someone else during a probe counts as failed", "[queuedepthrecovery]") {
+    QueueDepthRecovery recovery(kSteadyMs);
+    int depth = 16;
+    int64_t now = 0;
+    recovery.onReduced(16, 4, now);
+    depth = 4;
+    REQUIRE(runUntilTransition(recovery, depth, now, kHealthyUs).transition == Transition::StepUp);
+    REQUIRE(depth == 8);
+
+    now += 1000;
+    const auto step = recovery.onCheck(4, true, kHealthyUs, 100, now);
+    CHECK(step.transition == Transition::ProbeFailed);
+    CHECK(recovery.state() == State::Degraded);
+}
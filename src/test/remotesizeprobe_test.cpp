@@ -0,0 +1,185 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for reading the uncompressed size of remote images from their metadata
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "remotesizeprobe.h"
+#include <QtEndian>
+#include <lzma.h>
+#include <zstd.h>
+
+namespace {
+
+constexpr qint64 kMB = 1024 * 1024;
+
+QByteArray imageData(qint64 size)
+{
+    QByteArray data(size, '\0');
+    for (qint64 i = 0; i < size; i += 4096)
+        data[i] = static_cast<char>(i / 4096);
+    return data;
+}
+
+void append16(QByteArray &out, quint16 v)
+{
+    char buf[2];
+    qToLittleEndian(v, buf);
+    out.append(buf, 2);
+}
+
+void append32(QByteArray &out, quint32 v)
+{
+    char buf[4];
+    qToLittleEndian(v, buf);
+    out.append(buf, 4);
+}
+
+void append64(QByteArray &out, quint64 v)
+{
+    char buf[8];
+    qToLittleEndian(v, buf);
+    out.append(buf, 8);
+}
+
+// Central directory file header; sizes over 4 GiB go in a zip64 extra field
+QByteArray centralEntry(const QByteArray &name, quint64 uncompressed)
+{
+    const bool zip64 = uncompressed >= 0xFFFFFFFF;
+    QByteArray extra;
+    if (zip64)
+    {
+        append16(extra, 0x0001);
+        append16(extra, 8);
+        append64(extra, uncompressed);
+    }
+
+    QByteArray e;
+    append32(e, 0x02014b50);
+    append16(e, 45);                     // Version made by
+    append16(e, 45);                     // Version needed
+    append16(e, 0);                      // Flags
+    append16(e, 8);                      // Deflate
+    append32(e, 0);                      // Time and date
+    append32(e, 0);                      // CRC32
+    append32(e, 1000);                   // Compressed size
+    append32(e, zip64 ? 0xFFFFFFFF : static_cast<quint32>(uncompressed));
+    append16(e, static_cast<quint16>(name.size()));
+    append16(e, static_cast<quint16>(extra.size()));
+    append16(e, 0);                      // Comment length
+    append16(e, 0);                      // Disk
+    append16(e, 0);                      // Internal attributes
+    append32(e, 0);                      // External attributes
+    append32(e, 0);                      // Local header offset
+    return e + name + extra;
+}
+
+QByteArray endOfCentralDirectory(quint16 entries, quint32 size, quint32 offset, const QByteArray &comment = {})
+{
+    QByteArray e;
+    append32(e, 0x06054b50);
+    append16(e, 0);
+    append16(e, 0);
+    append16(e, entries);
+    append16(e, entries);
+    append32(e, size);
+    append32(e, offset);
+    append16(e, static_cast<quint16>(comment.size()));
+    return e + comment;
+}
+
+} // namespace
+
+TEST_CASE("zstd frame content size", "[remotesizeprobe]") {
+    const QByteArray image = imageData(4 * kMB);
+    QByteArray file(static_cast<qsizetype>(ZSTD_compressBound(image.size())), '\0');
+    size_t len = ZSTD_compress(file.data(), file.size(), image.constData(), image.size(), 3);
+    REQUIRE(!ZSTD_isError(len));
+    file.resize(static_cast<qsizetype>(len));
+    const QByteArray head = file.left(RemoteSizeProbe::kHeadBytes);
+
+    CHECK(RemoteSizeProbe::zstdContentSize(head, file.size()) == static_cast<quint64>(image.size()));
+    // A first frame smaller than the file is one of several
+    CHECK(RemoteSizeProbe::zstdContentSize(head, 8 * kMB) == 0);
+    CHECK(RemoteSizeProbe::zstdContentSize("not zstd at all", file.size()) == 0);
+}
+
+TEST_CASE("xz index size", "[remotesizeprobe]") {
+    const QByteArray image = imageData(4 * kMB);
+    QByteArray file(static_cast<qsizetype>(lzma_stream_buffer_bound(image.size())), '\0');
+    size_t len = 0;
+    REQUIRE(lzma_easy_buffer_encode(6, LZMA_CHECK_CRC64, nullptr,
+                                    reinterpret_cast<const uint8_t *>(image.constData()), image.size(),
+                                    reinterpret_cast<uint8_t *>(file.data()), &len, file.size()) == LZMA_OK);
+    file.resize(static_cast<qsizetype>(len));
+
+    const qint64 indexSize = RemoteSizeProbe::xzIndexSize(file.right(LZMA_STREAM_HEADER_SIZE));
+    REQUIRE(indexSize > LZMA_STREAM_HEADER_SIZE);
+    CHECK(RemoteSizeProbe::xzUncompressedSize(file.right(indexSize)) == static_cast<quint64>(image.size()));
+
+    // Wrong length, or not a footer
+    CHECK(RemoteSizeProbe::xzUncompressedSize(file.right(indexSize + 4)) == 0);
+    CHECK(RemoteSizeProbe::xzIndexSize(file.left(LZMA_STREAM_HEADER_SIZE)) == 0);
+}
+
+TEST_CASE("zip central directory", "[remotesizeprobe]") {
+    const QByteArray directory = centralEntry("images/", 0) + centralEntry("images/os.img", 3 * kMB);
+    const qint64 fileSize = 50 * kMB;
+    const qint64 cdOffset = fileSize - directory.size() - 22 - 5;
+    const QByteArray tail = QByteArray(1000, 'x') + directory
+        + endOfCentralDirectory(2, static_cast<quint32>(directory.size()), static_cast<quint32>(cdOffset), "hello");
+
+    qint64 offset = 0, size = 0;
+    REQUIRE(RemoteSizeProbe::zipCentralDirectory(tail, fileSize, offset, size));
+    CHECK(offset == cdOffset);
+    CHECK(size == directory.size());
+    CHECK(RemoteSizeProbe::zipImageSize(directory) == static_cast<quint64>(3 * kMB));
+
+    CHECK_FALSE(RemoteSizeProbe::zipCentralDirectory(QByteArray(1000, 'x'), fileSize, offset, size));
+    // Directory would extend past the end of the file
+    const QByteArray broken = endOfCentralDirectory(1, 100, static_cast<quint32>(fileSize - 50));
+    CHECK_FALSE(RemoteSizeProbe::zipCentralDirectory(broken, fileSize, offset, size));
+}
+
+TEST_CASE("zip with several files has no image size", "[remotesizeprobe]") {
+    const QByteArray directory = centralEntry("a.img", kMB) + centralEntry("b.img", kMB);
+    CHECK(RemoteSizeProbe::zipImageSize(directory) == 0);
+    CHECK(RemoteSizeProbe::zipImageSize(directory.left(directory.size() - 1)) == 0);
+}
+
+TEST_CASE("zip64 central directory", "[remotesizeprobe]") {
+    const quint64 imageSize = Q_UINT64_C(6) * 1024 * kMB;
+    const QByteArray directory = centralEntry("os.img", imageSize);
+    CHECK(RemoteSizeProbe::zipImageSize(directory) == imageSize);
+
+    const qint64 cdOffset = Q_INT64_C(4) * 1024 * kMB + 7;
+    const qint64 recordOffset = cdOffset + directory.size();
+
+    QByteArray record;
+    append32(record, 0x06064b50);
+    append64(record, 44);                // Size of the rest of the record
+    append16(record, 45);
+    append16(record, 45);
+    append32(record, 0);
+    append32(record, 0);
+    append64(record, 1);
+    append64(record, 1);
+    append64(record, static_cast<quint64>(directory.size()));
+    append64(record, static_cast<quint64>(cdOffset));
+
+    QByteArray locator;
+    append32(locator, 0x07064b50);
+    append32(locator, 0);
+    append64(locator, static_cast<quint64>(recordOffset));
+    append32(locator, 1);
+
+    const QByteArray tail = directory + record + locator + endOfCentralDirectory(0xFFFF, 0xFFFFFFFF, 0xFFFFFFFF);
+    const qint64 fileSize = cdOffset + tail.size();
+
+    qint64 offset = 0, size = 0;
+    REQUIRE(RemoteSizeProbe::zipCentralDirectory(tail, fileSize, offset, size));
+    CHECK(offset == cdOffset);
+    CHECK(size == directory.size());
+}
@@ -0,0 +1,245 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Unit tests for the single producer / single consumer RingBuffer.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "ringbuffer.h"
+
+#include <cstring>
+#include <thread>
+
+TEST_CASE("RingBuffer hands slots over in order", "[ringbuffer]")
+{
+    RingBuffer rb(4, 64, 64);
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            RingBuffer::Slot* slot = rb.acquireWriteSlot(10);
+            REQUIRE(slot != nullptr);
+            slot->data[0] = static_cast<char>(round * 4 + i);
+            rb.commitWriteSlot(slot, 1);
+        }
+
+        // All slots committed: the producer has to wait
+        REQUIRE(rb.acquireWriteSlot(10) == nullptr);
+
+        for (int i = 0; i < 4; ++i) {
+            RingBuffer::Slot* slot = rb.acquireReadSlot(10);
+            REQUIRE(slot != nullptr);
+            CHECK(slot->size == 1);
+            CHECK(slot->data[0] == static_cast<char>(round * 4 + i));
+            rb.releaseReadSlot(slot);
+        }
+
+        // Nothing committed: the consumer has to wait
+        REQUIRE(rb.acquireReadSlot(10) == nullptr);
+    }
+}
+
+TEST_CASE("RingBuffer reports EOF after producerDone", "[ringbuffer]")
+{
+    RingBuffer rb(2, 64, 64);
+
+    RingBuffer::Slot* slot = rb.acquireWriteSlot(10);
+    REQUIRE(slot != nullptr);
+    rb.commitWriteSlot(slot, 8);
+    rb.producerDone();
+
+    CHECK_FALSE(rb.isComplete());
+    RingBuffer::Slot* read = rb.acquireReadSlot(10);
+    REQUIRE(read != nullptr);
+    CHECK(read->size == 8);
+    rb.releaseReadSlot(read);
+
+    CHECK(rb.isComplete());
+    CHECK(rb.acquireReadSlot(10) == nullptr);
+}
+
+TEST_CASE("RingBuffer recycles retained slots in ring order", "[ringbuffer]")
+{
+    RingBuffer rb(2, 64, 64);
+
+    RingBuffer::Slot* first = rb.acquireWriteSlot(10);
+    REQUIRE(first != nullptr);
+    rb.retainSlot(first);
+    rb.commitWriteSlot(first, 1);
+
+    RingBuffer::Slot* second = rb.acquireWriteSlot(10);
+    REQUIRE(second != nullptr);
+    rb.retainSlot(second);
+    rb.commitWriteSlot(second, 1);
+
+    // The consumer is done with both, the second reader with neither
+    REQUIRE(rb.acquireReadSlot(10) == first);
+    rb.releaseReadSlot(first);
+    REQUIRE(rb.acquireReadSlot(10) == second);
+    rb.releaseReadSlot(second);
+    CHECK(rb.acquireWriteSlot(10) == nullptr);
+
+    // The second reader finishing the newer slot must not free the older one
+    rb.releaseReadSlot(second);
+    CHECK(rb.acquireWriteSlot(10) == nullptr);
+
+    rb.releaseReadSlot(first);
+    CHECK(rb.acquireWriteSlot(10) == first);
+    CHECK(rb.acquireWriteSlot(10) == second);
+}
+
+TEST_CASE("RingBuffer cancel wakes a blocked consumer", "[ringbuffer]")
+{
+    RingBuffer rb(2, 64, 64);
+
+    std::thread canceller([&rb]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        rb.cancel();
+    });
+
+    // No timeout: only cancel() can end this wait
+    CHECK(rb.acquireReadSlot() == nullptr);
+    CHECK(rb.isCancelled());
+    CHECK(rb.acquireWriteSlot() == nullptr);
+    canceller.join();
+}
+
+TEST_CASE("RingBuffer reports a consumer waiting for data", "[ringbuffer]")
+{
+    RingBuffer rb(2, 64, 64);
+    CHECK_FALSE(rb.isConsumerWaiting());
+
+    RingBuffer::Slot* slot = rb.acquireWriteSlot(10);
+    REQUIRE(slot != nullptr);
+
+    std::thread consumer([&rb]() {
+        RingBuffer::Slot* read = rb.acquireReadSlot();
+        if (read) {
+            rb.releaseReadSlot(read);
+        }
+    });
+
+    // The producer goes on filling its slot until the consumer runs dry
+    while (!rb.isConsumerWaiting()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    rb.commitWriteSlot(slot, 8);
+    consumer.join();
+    CHECK_FALSE(rb.isConsumerWaiting());
+}
+
+TEST_CASE("RingBuffer transfers data between threads without loss", "[ringbuffer]")
+{
+    // Small slots and few of them, so both the lock-free fast path and the
+    // blocking slow path are exercised many times
+    constexpr uint32_t kCount = 200000;
+    RingBuffer rb(3, 64, 64);
+
+    std::thread producer([&rb]() {
+        for (uint32_t i = 0; i < kCount; ++i) {
+            RingBuffer::Slot* slot = rb.acquireWriteSlot(100);
+            while (!slot && !rb.isCancelled()) {
+                slot = rb.acquireWriteSlot(100);
+            }
+            if (!slot) {
+                return;
+            }
+            std::memcpy(slot->data, &i, sizeof(i));
+            rb.commitWriteSlot(slot, sizeof(i));
+        }
+        rb.producerDone();
+    });
+
+    uint32_t expected = 0;
+    bool inOrder = true;
+    while (true) {
+        RingBuffer::Slot* slot = rb.acquireReadSlot(100);
+        if (!slot) {
+            if (rb.isComplete() || rb.isCancelled() || rb.isStallTimeoutExceeded()) {
+                break;
+            }
+            continue;
+        }
+        uint32_t value = 0;
+        std::memcpy(&value, slot->data, sizeof(value));
+        if (value != expected || slot->size != sizeof(value)) {
+            inOrder = false;
+        }
+        ++expected;
+        rb.releaseReadSlot(slot);
+    }
+    producer.join();
+
+    CHECK(inOrder);
+    CHECK(expected == kCount);
+    CHECK_FALSE(rb.isStallTimeoutExceeded());
+}
+
+TEST_CASE("RingBuffer slots of huge page size are usable", "[ringbuffer]")
+{
+    // Backed by huge pages where the system allows it, regular pages otherwise
+    constexpr size_t kSlotSize = 4 * 1024 * 1024;
+    const uint64_t inUseBefore = BufferPool::instance().stats().inUse;
+    {
+        RingBuffer rb(2, kSlotSize, 4096);
+        CHECK(rb.hugePageSlots() <= rb.numSlots());
+        CHECK(BufferPool::instance().stats().inUse == inUseBefore + 2 * kSlotSize);
+
+        RingBuffer::Slot* slot = rb.acquireWriteSlot(10);
+        REQUIRE(slot != nullptr);
+        CHECK(reinterpret_cast<uintptr_t>(slot->data) % 4096 == 0);
+        std::memset(slot->data, 0xA5, kSlotSize);
+        rb.commitWriteSlot(slot, kSlotSize);
+
+        RingBuffer::Slot* read = rb.acquireReadSlot(10);
+        REQUIRE(read == slot);
+        CHECK(static_cast<unsigned char>(read->data[kSlotSize - 1]) == 0xA5);
+        rb.releaseReadSlot(read);
+    }
+    // Slot memory went back to the pool
+    CHECK(BufferPool::instance().stats().inUse == inUseBefore);
+}
+
+TEST_CASE("RingBuffer slot limit parks and restores slot memory", "[ringbuffer]")
+{
+    RingBuffer rb(4, 64, 64);
+    const uint64_t inUseFull = BufferPool::instance().stats().inUse;
+
+    uint32_t written = 0;
+    uint32_t expected = 0;
+    bool inOrder = true;
+    auto cycle = [&](int blocks) {
+        for (int i = 0; i < blocks; ++i) {
+            RingBuffer::Slot* slot = rb.acquireWriteSlot(10);
+            REQUIRE(slot != nullptr);
+            REQUIRE(slot->data != nullptr);
+            std::memcpy(slot->data, &written, sizeof(written));
+            ++written;
+            rb.commitWriteSlot(slot, sizeof(written));
+
+            // Parked slots pass by unseen
+            RingBuffer::Slot* read = rb.acquireReadSlot(10);
+            REQUIRE(read != nullptr);
+            uint32_t value = 0;
+            std::memcpy(&value, read->data, sizeof(value));
+            if (value != expected++ || read->size != sizeof(value)) {
+                inOrder = false;
+            }
+            rb.releaseReadSlot(read);
+        }
+    };
+
+    rb.setSlotLimit(1);
+    CHECK(rb.slotLimit() == RingBuffer::MIN_ACTIVE_SLOTS);
+    cycle(8);
+    CHECK(rb.parkedSlots() == 2);
+    CHECK(BufferPool::instance().stats().inUse < inUseFull);
+
+    rb.setSlotLimit(rb.numSlots());
+    cycle(8);
+    CHECK(rb.parkedSlots() == 0);
+    CHECK(BufferPool::instance().stats().inUse == inUseFull);
+    CHECK(inOrder);
+    CHECK(expected == 16);
+}
@@ -56,6 +56,11 @@ static std::vector<uint8_t> createTarInMemory(
     return result;
 }
 
+static std::vector<uint8_t> bytesOf(const FileData& data)
+{
+    return {data.bytes().begin(), data.bytes().end()};
+}
+
 TEST_CASE("Bootfiles extracts tar from memory", "[rpiboot][bootfiles]")
 {
     std::vector<uint8_t> contentA = {'H', 'e', 'l', 'l', 'o'};
@@ -70,13 +75,13 @@ TEST_CASE("Bootfiles extracts tar from memory", "[rpiboot][bootfiles]")
     REQUIRE(bf.extractFromMemory(tar));
     CHECK(bf.size() == 2);
 
-    auto* a = bf.find("config.txt");
-    REQUIRE(a != nullptr);
-    CHECK(*a == contentA);
+    auto a = bf.find("config.txt");
+    REQUIRE(a);
+    CHECK(bytesOf(a) == contentA);
 
-    auto* b = bf.find("kernel.img");
-    REQUIRE(b != nullptr);
-    CHECK(*b == contentB);
+    auto b = bf.find("kernel.img");
+    REQUIRE(b);
+    CHECK(bytesOf(b) == contentB);
 }
 
 TEST_CASE("Bootfiles handles empty archive", "[rpiboot][bootfiles]")
@@ -86,15 +91,15 @@ TEST_CASE("Bootfiles handles empty archive", "[rpiboot][bootfiles]")
     CHECK_FALSE(bf.extractFromMemory({}));
 }
 
-TEST_CASE("Bootfiles returns nullptr for missing file", "[rpiboot][bootfiles]")
+TEST_CASE("Bootfiles finds nothing for a missing file", "[rpiboot][bootfiles]")
 {
     auto tar = createTarInMemory({{"exists.txt", {1, 2, 3}}});
 
     Bootfiles bf;
     REQUIRE(bf.extractFromMemory(tar));
 
-    CHECK(bf.find("exists.txt") != nullptr);
-    CHECK(bf.find("missing.txt") == nullptr);
+    CHECK(bf.find("exists.txt"));
+    CHECK_FALSE(bf.find("missing.txt"));
 }
 
 TEST_CASE("Bootfiles strips leading ./ from entry names", "[rpiboot][bootfiles]")
@@ -105,7 +110,7 @@ TEST_CASE("Bootfiles strips leading ./ from entry names", "[rpiboot][bootfiles]"
     REQUIRE(bf.extractFromMemory(tar));
 
     // Should be findable without the "./" prefix
-    CHECK(bf.find("config.txt") != nullptr);
+    CHECK(bf.find("config.txt"));
 }
 
 TEST_CASE("Bootfiles handles large file without OOM", "[rpiboot][bootfiles]")
@@ -117,11 +122,11 @@ TEST_CASE("Bootfiles handles large file without OOM", "[rpiboot][bootfiles]")
     Bootfiles bf;
     REQUIRE(bf.extractFromMemory(tar));
 
-    auto* data = bf.find("large.bin");
-    REQUIRE(data != nullptr);
-    CHECK(data->size() == largeContent.size());
-    CHECK((*data)[0] == 0xAA);
-    CHECK((*data)[data->size() - 1] == 0xAA);
+    auto data = bf.find("large.bin");
+    REQUIRE(data);
+    CHECK(data.size() == largeContent.size());
+    CHECK(data.bytes()[0] == 0xAA);
+    CHECK(data.bytes()[data.size() - 1] == 0xAA);
 }
 
 // ────────────────────────────────────────────────────────────────────────
@@ -144,8 +149,8 @@ TEST_CASE("Bootfiles does not crash on corrupt data", "[rpiboot][bootfiles][nega
     // Should not crash. If it "succeeds", no named files from a real
     // tar should be present.
     if (ok) {
-        CHECK(bf.find("config.txt") == nullptr);
-        CHECK(bf.find("kernel.img") == nullptr);
+        CHECK_FALSE(bf.find("config.txt"));
+        CHECK_FALSE(bf.find("kernel.img"));
     }
 }
 
@@ -161,7 +166,7 @@ TEST_CASE("Bootfiles does not crash on truncated data", "[rpiboot][bootfiles][ne
     // Should not crash. The raw format handler may produce an entry,
     // but no real tar filenames should be resolvable.
     if (ok) {
-        CHECK(bf.find("config.txt") == nullptr);
+        CHECK_FALSE(bf.find("config.txt"));
     }
 }
 
@@ -181,9 +186,9 @@ TEST_CASE("Bootfiles find with ./ prefix and without are equivalent", "[rpiboot]
     REQUIRE(bf.extractFromMemory(tar));
 
     // Direct lookup
-    CHECK(bf.find("kernel.img") != nullptr);
+    CHECK(bf.find("kernel.img"));
     // With ./ prefix — should still find via the fallback logic in find()
-    CHECK(bf.find("./kernel.img") != nullptr);
+    CHECK(bf.find("./kernel.img"));
 }
 
 TEST_CASE("Bootfiles extracts multiple files and iterates", "[rpiboot][bootfiles]")
@@ -198,12 +203,8 @@ TEST_CASE("Bootfiles extracts multiple files and iterates", "[rpiboot][bootfiles
     REQUIRE(bf.extractFromMemory(tar));
     CHECK(bf.size() == 3);
 
-    // Verify files() accessor gives the full map
-    const auto& map = bf.files();
-    CHECK(map.size() == 3);
-    CHECK(map.count("a.txt") == 1);
-    CHECK(map.count("b.txt") == 1);
-    CHECK(map.count("c.txt") == 1);
+    // Verify names() lists every entry
+    CHECK(bf.names() == std::vector<std::string>{"a.txt", "b.txt", "c.txt"});
 }
 
 TEST_CASE("Bootfiles find resolves chip-specific subdirectory via prefix", "[rpiboot][bootfiles]")
@@ -220,21 +221,21 @@ TEST_CASE("Bootfiles find resolves chip-specific subdirectory via prefix", "[rpi
     REQUIRE(bf.extractFromMemory(tar));
 
     // Exact name works for top-level files
-    CHECK(bf.find("config.txt") != nullptr);
+    CHECK(bf.find("config.txt"));
 
     // Bare name without prefix → not found
-    CHECK(bf.find("mcb.bin") == nullptr);
+    CHECK_FALSE(bf.find("mcb.bin"));
 
     // With correct chip prefix → found via "2712/mcb.bin"
-    auto* found = bf.find("mcb.bin", "2712");
-    REQUIRE(found != nullptr);
-    CHECK(*found == mcbContent);
+    auto found = bf.find("mcb.bin", "2712");
+    REQUIRE(found);
+    CHECK(bytesOf(found) == mcbContent);
 
     // Wrong chip prefix → not found
-    CHECK(bf.find("mcb.bin", "2711") == nullptr);
+    CHECK_FALSE(bf.find("mcb.bin", "2711"));
 
     // Exact path still works regardless of prefix
-    CHECK(bf.find("2712/mcb.bin") != nullptr);
+    CHECK(bf.find("2712/mcb.bin"));
 }
 
 TEST_CASE("Bootfiles extractFromMemory clears previous state", "[rpiboot][bootfiles]")
@@ -244,11 +245,64 @@ TEST_CASE("Bootfiles extractFromMemory clears previous state", "[rpiboot][bootfi
 
     Bootfiles bf;
     REQUIRE(bf.extractFromMemory(tar1));
-    CHECK(bf.find("first.txt") != nullptr);
+    CHECK(bf.find("first.txt"));
 
     // Extract a second archive — should clear the first
     REQUIRE(bf.extractFromMemory(tar2));
-    CHECK(bf.find("first.txt") == nullptr);
-    CHECK(bf.find("second.txt") != nullptr);
+    CHECK_FALSE(bf.find("first.txt"));
+    CHECK(bf.find("second.txt"));
     CHECK(bf.size() == 1);
 }
+
+TEST_CASE("Bootfiles serves entries from the archive buffer", "[rpiboot][bootfiles]")
+{
+    std::vector<uint8_t> content(3000, 0x5A);
+    auto tar = std::make_shared<const std::vector<uint8_t>>(createTarInMemory({
+        {"start.elf", content},
+        {"config.txt", {'a', 'b'}},
+    }));
+
+    Bootfiles bf;
+    REQUIRE(bf.extractFromData(FileData(tar)));
+
+    // No copy: the entry is a view into the tar bytes
+    auto data = bf.find("start.elf");
+    REQUIRE(data);
+    CHECK(bytesOf(data) == content);
+    CHECK(data.bytes().data() >= tar->data());
+    CHECK(data.bytes().data() + data.size() <= tar->data() + tar->size());
+}
+
+TEST_CASE("Bootfiles entries outlive the archive object", "[rpiboot][bootfiles]")
+{
+    FileData data;
+    {
+        Bootfiles bf;
+        REQUIRE(bf.extractFromMemory(createTarInMemory({{"bootcode5.bin", {1, 2, 3}}})));
+        data = bf.find("bootcode5.bin");
+    }
+    REQUIRE(data);
+    CHECK(bytesOf(data) == std::vector<uint8_t>{1, 2, 3});
+}
+
+TEST_CASE("Bootfiles replaceEntry only materialises the replaced entry", "[rpiboot][bootfiles]")
+{
+    auto tar = std::make_shared<const std::vector<uint8_t>>(createTarInMemory({
+        {"bootcode5.bin", {1, 2, 3}},
+        {"config.txt", {4, 5}},
+    }));
+
+    Bootfiles bf;
+    REQUIRE(bf.extractFromData(FileData(tar)));
+    REQUIRE(bf.replaceEntry("bootcode5.bin", {9, 9, 9, 9}));
+    CHECK_FALSE(bf.replaceEntry("missing.bin", {1}));
+
+    auto replaced = bf.find("bootcode5.bin");
+    CHECK(bytesOf(replaced) == std::vector<uint8_t>{9, 9, 9, 9});
+    CHECK((replaced.bytes().data() < tar->data() ||
+           replaced.bytes().data() >= tar->data() + tar->size()));
+
+    auto untouched = bf.find("config.txt");
+    CHECK(bytesOf(untouched) == std::vector<uint8_t>{4, 5});
+    CHECK(untouched.bytes().data() >= tar->data());
+}
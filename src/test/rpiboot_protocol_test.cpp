@@ -14,7 +14,9 @@
 #include "rpiboot/bootcode_loader.h"
 #include "rpiboot/file_server.h"
 #include "rpiboot/rpiboot_protocol.h"
+#include "rpiboot/shared_file_cache.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cstring>
 #include <filesystem>
@@ -35,6 +37,9 @@ public:
     ~TempFirmwareDir() {
         std::error_code ec;
         std::filesystem::remove_all(_path, ec);
+        // The next test may reuse this path with same-sized files written
+        // within the same timestamp tick
+        SharedFileCache::instance().clear();
     }
 
     void writeFile(const std::string& name, const std::vector<uint8_t>& data) {
@@ -201,6 +206,73 @@ TEST_CASE("FileServer handles ReadFile request", "[rpiboot][fileserver]")
     CHECK(totalBulkBytes == content.size());
 }
 
+TEST_CASE("FileServer sizes ReadFile transfers by link speed", "[rpiboot][fileserver]")
+{
+    TempFirmwareDir fw;
+    fw.writeFile("initramfs", std::vector<uint8_t>(3 * 1024 * 1024 + 5, 0x42));
+
+    auto bulkWriteSizes = [&](UsbSpeed speed) {
+        MockUsbTransport mock;
+        mock.setSpeed(speed);
+        mock.queueBulkReadResponse(makeFileMessage(FileCommand::ReadFile, "initramfs"));
+        mock.queueBulkReadResponse(makeFileMessage(FileCommand::Done, ""));
+
+        std::atomic<bool> cancelled{false};
+        FileServer server;
+        REQUIRE(server.run(mock, fw.path(), nullptr, cancelled));
+
+        std::vector<size_t> sizes;
+        for (const auto& w : mock.capturedBulkWrites())
+            sizes.push_back(w.size());
+        return sizes;
+    };
+
+    // USB 2: upstream usbboot's 16 KB transfers
+    auto high = bulkWriteSizes(UsbSpeed::High);
+    CHECK(high.size() == (3 * 1024 * 1024) / BULK_CHUNK_SIZE + 1);
+    CHECK(high.front() == BULK_CHUNK_SIZE);
+
+    // USB 3: 1 MB transfers
+    auto super = bulkWriteSizes(UsbSpeed::Super);
+    CHECK(super == std::vector<size_t>{1024 * 1024, 1024 * 1024, 1024 * 1024, 5});
+}
+
+TEST_CASE("SharedFileCache shares contents and reloads replaced files", "[rpiboot][fileserver]")
+{
+    TempFirmwareDir fw;
+    auto& cache = SharedFileCache::instance();
+
+    const std::string small = "dtparam=audio=on\n";
+    std::vector<uint8_t> large(SharedFileCache::MAP_THRESHOLD + 4096);
+    for (size_t i = 0; i < large.size(); ++i)
+        large[i] = static_cast<uint8_t>(i * 31);
+    fw.writeFile("config.txt", small);
+    fw.writeFile("boot.img", large);
+
+    FileData first = cache.file(fw.path() / "config.txt");
+    FileData again = cache.file(fw.path() / "config.txt");
+    REQUIRE(first);
+    CHECK(first.bytes().data() == again.bytes().data());
+    CHECK(std::string(first.bytes().begin(), first.bytes().end()) == small);
+
+    FileData mapped = cache.file(fw.path() / "boot.img");
+    REQUIRE(mapped.size() == large.size());
+    CHECK(std::equal(large.begin(), large.end(), mapped.bytes().begin()));
+
+    CHECK_FALSE(cache.file(fw.path() / "missing.bin"));
+
+    // Replace boot.img the way FirmwareManager does (rename over it); the
+    // old contents stay valid for whoever still holds them
+    std::vector<uint8_t> replacement(large.size() + 1, 0x5a);
+    fw.writeFile("boot.img.tmp", replacement);
+    std::filesystem::rename(fw.path() / "boot.img.tmp", fw.path() / "boot.img");
+
+    FileData reloaded = cache.file(fw.path() / "boot.img");
+    REQUIRE(reloaded.size() == replacement.size());
+    CHECK(reloaded.bytes()[0] == 0x5a);
+    CHECK(std::equal(large.begin(), large.end(), mapped.bytes().begin()));
+}
+
 TEST_CASE("FileServer handles Done command cleanly", "[rpiboot][fileserver]")
 {
     MockUsbTransport mock;
@@ -605,6 +677,39 @@ TEST_CASE("resolveSideloadDir falls back to base dir when subdir missing", "[rpi
     CHECK(foundFile);
 }
 
+TEST_CASE("RpibootProtocol serves file overrides instead of disk files", "[rpiboot][protocol]")
+{
+    TempFirmwareDir fw;
+    std::filesystem::create_directories(fw.path() / "secure-boot-recovery5");
+    fw.writeFile("secure-boot-recovery5/pieeprom.bin", "unsigned");
+    fw.writeFile("bootcode5.bin", std::vector<uint8_t>(64, 0xBB));
+
+    MockUsbTransport mock;
+    mock.queueBulkReadResponse({0, 0, 0, 0});  // bootcode return value
+    mock.queueBulkReadResponse(makeFileMessage(FileCommand::GetFileSize, "pieeprom.bin"));
+    mock.queueBulkReadResponse(makeFileMessage(FileCommand::Done, ""));
+
+    std::atomic<bool> cancelled{false};
+    RpibootProtocol protocol;
+    const std::string signedImage = "signed-in-memory";
+    protocol.setFileOverride("pieeprom.bin", FileData(std::make_shared<const std::vector<uint8_t>>(
+        signedImage.begin(), signedImage.end())));
+
+    bool ok = protocol.execute(mock, ChipGeneration::BCM2712,
+                                SideloadMode::SecureBootRecovery, fw.path(),
+                                nullptr, cancelled);
+    CHECK(ok);
+
+    // The size served is that of the override (16 bytes), not the disk file (8)
+    bool foundOverride = false;
+    for (const auto& ct : mock.capturedControlTransfers()) {
+        CHECK_FALSE((ct.data.empty() && ct.wValue == 8));
+        if (ct.data.empty() && ct.wValue == 16)
+            foundOverride = true;
+    }
+    CHECK(foundOverride);
+}
+
 // ────────────────────────────────────────────────────────────────────────
 // RpibootProtocol execute() error paths
 // ────────────────────────────────────────────────────────────────────────
@@ -0,0 +1,109 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the block sample used by the fast read-back verify
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "sampledverify.h"
+#include <zlib.h>
+#include <vector>
+
+namespace {
+
+constexpr std::uint64_t kBlock = SampledVerify::kBlockSize;
+
+std::vector<char> imageData(std::uint64_t size)
+{
+    std::vector<char> data(static_cast<size_t>(size));
+    std::uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (auto &c : data)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        c = static_cast<char>(x >> 56);
+    }
+    return data;
+}
+
+quint32 crcOf(const char *data, size_t len)
+{
+    return static_cast<quint32>(crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(data), static_cast<uInt>(len)));
+}
+
+} // namespace
+
+TEST_CASE("Sampled blocks are checksummed whatever the write sizes", "[sampledverify]") {
+    const auto data = imageData(20 * kBlock + 4096);
+
+    SampledVerify whole(25.0, 7);
+    whole.addData(data.data(), data.size());
+
+    // Writes that do not line up with blocks give the same result
+    SampledVerify pieces(25.0, 7);
+    size_t pos = 0;
+    size_t piece = 12345;
+    while (pos < data.size())
+    {
+        const size_t n = std::min(piece, data.size() - pos);
+        pieces.addData(data.data() + pos, n);
+        pos += n;
+        piece = piece * 3 % (3 * kBlock) + 1;
+    }
+
+    const auto blocks = whole.blocks();
+    const auto other = pieces.blocks();
+    REQUIRE(blocks.size() == other.size());
+    CHECK(whole.size() == data.size());
+
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+        const auto &b = blocks[i];
+        CHECK(b.offset == other[i].offset);
+        CHECK(b.crc == other[i].crc);
+        CHECK(b.offset % kBlock == 0);
+        CHECK(whole.isSampled(b.offset / kBlock));
+        CHECK(b.crc == crcOf(data.data() + b.offset, b.length));
+    }
+}
+
+TEST_CASE("Capacity probes and required ranges are always sampled", "[sampledverify]") {
+    SampledVerify none(0.0);
+    none.addRequiredRange(40 * kBlock + 100, 2 * kBlock);
+
+    for (std::uint64_t i : {0, 1, 2, 4, 8, 1024, 8192})
+        CHECK(none.isSampled(i));
+    for (std::uint64_t i : {40, 41, 42})
+        CHECK(none.isSampled(i));
+    for (std::uint64_t i : {3, 5, 39, 43, 1023})
+        CHECK_FALSE(none.isSampled(i));
+
+    // The partial last block is kept when it is sampled
+    const auto data = imageData(4 * kBlock + 512);
+    none.addData(data.data(), data.size());
+    const auto blocks = none.blocks();
+    REQUIRE(blocks.size() == 4);  // 0, 1, 2 and the partial block 4
+    CHECK(blocks.back().offset == 4 * kBlock);
+    CHECK(blocks.back().length == 512);
+}
+
+TEST_CASE("Coverage sets the share of blocks sampled", "[sampledverify]") {
+    SampledVerify all(100.0);
+    SampledVerify some(10.0, 1);
+    SampledVerify same(10.0, 1);
+    SampledVerify otherSeed(10.0, 2);
+
+    int sampled = 0, differ = 0;
+    for (std::uint64_t i = 0; i < 100000; i++)
+    {
+        CHECK(all.isSampled(i));
+        sampled += some.isSampled(i);
+        CHECK(some.isSampled(i) == same.isSampled(i));
+        differ += some.isSampled(i) != otherSeed.isSampled(i);
+    }
+    CHECK(sampled > 9500);
+    CHECK(sampled < 10500);
+    CHECK(differ > 0);
+}
@@ -0,0 +1,152 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for comparing exported performance sessions
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "sessioncomparison.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+namespace {
+
+// A PerformanceStats export with a write phase at the given per-second rates
+QByteArray exportWith(const QVector<double> &writeKBps, int stalls = 0, int syncImpactPercent = -1,
+                      const QString &osVersion = "6.6")
+{
+    QJsonArray slices;
+    for (int i = 0; i < writeKBps.size(); ++i)
+        slices.append(QJsonArray({i * 1000, writeKBps[i], writeKBps[i], writeKBps[i]}));
+
+    QJsonObject events;
+    if (stalls > 0)
+        events["progressStall"] = QJsonObject{{"count", stalls}};
+
+    QJsonArray eventList;
+    if (syncImpactPercent >= 0)
+    {
+        eventList.append(QJsonObject{
+            {"type", "writeAfterSyncImpact"},
+            {"metadata", QString("beforeSyncKBps: 30000; afterSyncKBps: 20000; samples: 8; impactPercent: %1")
+                             .arg(syncImpactPercent)}});
+    }
+
+    QJsonObject root{
+        {"summary", QJsonObject{
+            {"events", events},
+            {"phases", QJsonObject{{"write", QJsonObject{{"durationMs", writeKBps.size() * 1000}}}}}}},
+        {"system", QJsonObject{
+            {"platform", QJsonObject{{"os", "linux"}, {"osVersion", osVersion}}}}},
+        {"events", eventList},
+        {"histograms", QJsonObject{{"write", slices}}},
+    };
+    return QJsonDocument(root).toJson();
+}
+
+QVector<double> around(double kbps, int count)
+{
+    QVector<double> values;
+    for (int i = 0; i < count; ++i)
+        values.append(kbps + (i % 5) * kbps / 50);
+    return values;
+}
+
+} // namespace
+
+TEST_CASE("Mann-Whitney p-values separate shifted distributions", "[sessioncomparison]") {
+    CHECK(SessionComparison::mannWhitneyP({}, {1, 2, 3}) == 1.0);
+    CHECK(SessionComparison::mannWhitneyP({5, 5, 5}, {5, 5, 5}) == 1.0);
+
+    // Identical samples are not different
+    CHECK(SessionComparison::mannWhitneyP(around(30000, 20), around(30000, 20)) > 0.5);
+
+    // Completely separated samples of 20 each: z is about 5.4
+    CHECK(SessionComparison::mannWhitneyP(around(30000, 20), around(15000, 20)) < 1e-6);
+
+    // Interleaved samples are not
+    CHECK(SessionComparison::mannWhitneyP({1, 3, 5, 7, 9, 11}, {2, 4, 6, 8, 10, 12}) > 0.3);
+}
+
+TEST_CASE("Percentiles interpolate between values", "[sessioncomparison]") {
+    CHECK(SessionComparison::percentile({}, 0.5) == 0);
+    CHECK(SessionComparison::percentile({4, 1, 3, 2}, 0.5) == 2.5);
+    CHECK(SessionComparison::percentile({4, 1, 3, 2}, 0.0) == 1);
+    CHECK(SessionComparison::percentile({4, 1, 3, 2}, 1.0) == 4);
+}
+
+TEST_CASE("Sessions are read from PerformanceStats exports", "[sessioncomparison]") {
+    SessionComparison comparison;
+    REQUIRE(comparison.parse(exportWith({100, 200, 300}, 2, 35), "a.json"));
+    REQUIRE_FALSE(comparison.parse("{", "b.json"));
+    REQUIRE_FALSE(comparison.parse("{\"traceEvents\": []}", "trace.json"));
+
+    REQUIRE(comparison.sessions().size() == 1);
+    const SessionComparison::Session &session = comparison.sessions().first();
+    CHECK(session.throughputKBps.value("write") == QVector<double>({100, 200, 300}));
+    CHECK_FALSE(session.throughputKBps.contains("download"));
+    CHECK(session.phaseDurationMs.value("write") == 3000);
+    CHECK(session.stalls.value("progressStall") == 2);
+    CHECK(session.stalls.value("watchdogRecovery") == 0);
+    CHECK(session.syncImpactPercent == QVector<double>({35}));
+    CHECK(session.system.value("platform.osVersion") == "6.6");
+}
+
+TEST_CASE("A clearly slower write is a regression", "[sessioncomparison]") {
+    SessionComparison comparison;
+    REQUIRE(comparison.parse(exportWith(around(30000, 30)), "good.json"));
+    REQUIRE(comparison.parse(exportWith(around(30000, 30)), "same.json"));
+    REQUIRE(comparison.parse(exportWith(around(20000, 30), 1, -1, "6.8"), "slow.json"));
+
+    const QJsonObject report = comparison.report();
+    CHECK(report["baseline"].toString() == "good.json");
+    const QJsonArray comparisons = report["comparisons"].toArray();
+    REQUIRE(comparisons.size() == 2);
+
+    const QJsonObject same = comparisons[0].toObject();
+    CHECK(same["regressions"].toArray().isEmpty());
+    CHECK_FALSE(same["phases"].toObject()["write"].toObject()["significant"].toBool());
+    CHECK(same["system"].toArray().isEmpty());
+
+    const QJsonObject slow = comparisons[1].toObject();
+    const QJsonObject write = slow["phases"].toObject()["write"].toObject();
+    CHECK(write["significant"].toBool());
+    CHECK(write["changePercent"].toDouble() == -33.3);  // Rounded to 0.1
+    CHECK(write["baselineDurationMs"].toInteger() == 30000);
+    // Slower throughput and a new stall
+    CHECK(slow["regressions"].toArray().size() == 2);
+    CHECK(slow["stalls"].toObject()["progressStall"].toObject()["count"].toInt() == 1);
+
+    const QJsonArray system = slow["system"].toArray();
+    REQUIRE(system.size() == 1);
+    CHECK(system[0].toObject()["key"].toString() == "platform.osVersion");
+    CHECK(system[0].toObject()["value"].toString() == "6.8");
+
+    CHECK(comparison.regressionCount() == 2);
+}
+
+TEST_CASE("Faster runs, short phases and small changes are not regressions", "[sessioncomparison]") {
+    SessionComparison comparison;
+    REQUIRE(comparison.parse(exportWith(around(30000, 30), 0, 10), "base.json"));
+    REQUIRE(comparison.parse(exportWith(around(40000, 30), 0, 15), "faster.json"));
+    REQUIRE(comparison.parse(exportWith(around(10000, 3)), "short.json"));
+    REQUIRE(comparison.parse(exportWith(around(28500, 30)), "slightly.json"));
+
+    const QJsonArray comparisons = comparison.report()["comparisons"].toArray();
+    REQUIRE(comparisons.size() == 3);
+    CHECK(comparisons[0].toObject()["phases"].toObject()["write"].toObject()["significant"].toBool());
+    CHECK(comparisons[0].toObject()["syncImpactPercent"].toObject()["value"].toDouble() == 15);
+    // Too few windows to test
+    CHECK_FALSE(comparisons[1].toObject()["phases"].toObject()["write"].toObject().contains("pValue"));
+    // 5% slower is below kMinChangePercent
+    CHECK_FALSE(comparisons[2].toObject()["phases"].toObject()["write"].toObject()["significant"].toBool());
+    CHECK(comparison.regressionCount() == 0);
+
+    // A larger drop after each sync is
+    SessionComparison syncs;
+    REQUIRE(syncs.parse(exportWith(around(30000, 30), 0, 10), "base.json"));
+    REQUIRE(syncs.parse(exportWith(around(30000, 30), 0, 40), "syncs.json"));
+    CHECK(syncs.regressionCount() == 1);
+}
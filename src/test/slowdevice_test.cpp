@@ -0,0 +1,424 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the emulated slow device (EmulatedFileOperations), and
+ * benchmark scenarios for the async write path's stall recovery.
+ *
+ * The scenarios are tagged [.benchmark] so a plain run skips them; run with
+ *   ./slowdevice_test "[benchmark]"
+ * Each drives an emulated device the way DownloadThread does, with the
+ * recovery ladder of WriteProgressWatchdog (poll, reduce queue depth, drain
+ * to sync, restart) and QueueDepthRecovery stepping back up, on a clock
+ * compressed TimeScale times: the watchdog's 30 s before reducing depth
+ * take 150 ms. Reported times are real; compare them between changes to
+ * the recovery logic.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "file_operations_emulated.h"
+#include "latencyhistogram.h"
+#include "queuedepthrecovery.h"
+#include "timeout_utils.h"
+#include "watchdogthresholds.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using rpi_imager::EmulatedDeviceModel;
+using rpi_imager::EmulatedFileOperations;
+using rpi_imager::FileError;
+
+namespace {
+
+constexpr std::size_t Block = 256 * 1024;
+constexpr std::uint64_t MiB = 1024 * 1024;
+
+using Clock = std::chrono::steady_clock;
+
+int64_t msSince(Clock::time_point since)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - since).count();
+}
+
+EmulatedDeviceModel quickModel(double mbPerS)
+{
+    EmulatedDeviceModel model;
+    model.write_rate = {{0, mbPerS}};
+    model.command_us = 0;
+    model.sync_base_us = 0;
+    return model;
+}
+
+// ── Recovery scenarios ─────────────────────────────────────────────────
+
+constexpr int64_t TimeScale = 200;
+
+struct ScenarioResult
+{
+    bool completed = false;
+    int64_t wallMs = 0;
+    int polls = 0;           // Polls that delivered completions
+    int reductions = 0;
+    int drains = 0;
+    int stepUps = 0;         // Including resuming async after a drain
+    int64_t worstRecoveryMs = 0;  // Longest stall from last progress to progress again
+    int finalDepth = 0;
+};
+
+// Writes totalBytes to device through async writes at depth while a
+// watchdog thread applies the recovery ladder
+ScenarioResult runScenario(EmulatedFileOperations &device, std::uint64_t totalBytes, int depth)
+{
+    using namespace rpi_imager;
+    REQUIRE(device.SetAsyncQueueDepth(depth));
+
+    ScenarioResult result;
+    std::vector<std::uint8_t> data(Block, 0x5A);
+    std::atomic<std::uint64_t> completedBytes{0};
+    std::atomic<bool> writerDone{false};
+    std::atomic<bool> failed{false};
+    const auto start = Clock::now();
+
+    std::thread writer([&] {
+        for (std::uint64_t queued = 0; queued < totalBytes && !failed; queued += Block) {
+            FileError r = device.AsyncWriteSequential(data.data(), data.size(),
+                [&completedBytes](FileError res, std::size_t n) {
+                    if (res == FileError::kSuccess)
+                        completedBytes += n;
+                });
+            if (r != FileError::kSuccess) {
+                failed = true;
+                break;
+            }
+        }
+        if (!failed && device.WaitForPendingWrites() != FileError::kSuccess)
+            failed = true;
+        writerDone = true;
+    });
+
+    // The watchdog, on the scaled clock
+    const WatchdogThresholds thresholds = WatchdogThresholds::defaults();
+    QueueDepthRecovery recovery(TimeoutDefaults::kWatchdogRampUpIntervalMs);
+    const auto checkInterval = std::chrono::milliseconds(TimeoutDefaults::kWatchdogCheckIntervalMs / TimeScale);
+    std::vector<uint64_t> windowStart;
+    std::uint64_t lastBytes = 0;
+    int lastPending = 0;
+    int64_t lastProgressMs = 0;
+    bool reduced = false;
+    bool drained = false;
+    int effectiveDepth = depth;
+
+    auto apply = [&](const QueueDepthRecovery::Step &step) {
+        using Transition = QueueDepthRecovery::Transition;
+        if (step.transition == Transition::StepUp) {
+            device.RestoreQueueDepthAfterRecovery(step.toDepth);
+            effectiveDepth = step.toDepth;
+            reduced = false;
+            result.stepUps++;
+        } else if (step.transition == Transition::ResumeAsync) {
+            if (device.ResumeAsyncAfterSyncFallback(step.toDepth)) {
+                effectiveDepth = step.toDepth;
+                result.stepUps++;
+            }
+            reduced = drained = false;
+        } else if (step.transition == Transition::Recovered) {
+            reduced = drained = false;
+        }
+        if (step.resetWindow)
+            windowStart = device.GetAsyncWriteLatencyHistogram().Snapshot();
+    };
+
+    while (!writerDone) {
+        std::this_thread::sleep_for(checkInterval);
+        const int64_t nowMs = msSince(start) * TimeScale;
+        const std::uint64_t bytes = completedBytes;
+        const int pending = device.GetPendingWriteCount();
+
+        const bool progress = bytes > lastBytes || pending < lastPending;
+        lastPending = pending;
+        if (progress) {
+            result.worstRecoveryMs = std::max(result.worstRecoveryMs, (nowMs - lastProgressMs) / TimeScale);
+            lastBytes = bytes;
+            lastProgressMs = nowMs;
+        }
+
+        std::vector<uint64_t> counts = device.GetAsyncWriteLatencyHistogram().Snapshot();
+        if (windowStart.size() == counts.size()) {
+            for (std::size_t i = 0; i < counts.size(); ++i)
+                counts[i] -= std::min(counts[i], windowStart[i]);
+        }
+        uint64_t samples = 0;
+        for (uint64_t c : counts)
+            samples += c;
+        apply(recovery.onCheck(device.IsInSyncFallbackMode() ? 1 : effectiveDepth, progress,
+                               LatencyHistogram::ValueAtQuantile(counts, 0.99, UINT64_MAX), samples, nowMs));
+        if (progress)
+            continue;
+
+        const int64_t stallMs = nowMs - lastProgressMs;
+        if (stallMs >= thresholds.timeoutMs) {
+            failed = true;
+            device.CancelAsyncIO();
+            break;
+        }
+        if (pending == 0)
+            continue;
+
+        device.PollAsyncCompletions();
+        if (device.GetPendingWriteCount() < pending) {
+            result.polls++;
+            continue;
+        }
+        if (stallMs >= thresholds.reduceDepthMs && !reduced && effectiveDepth > 2) {
+            const int newDepth = std::max(2, effectiveDepth / 2);
+            device.ReduceQueueDepthForRecovery(newDepth);
+            apply(recovery.onReduced(effectiveDepth, newDepth, nowMs));
+            effectiveDepth = newDepth;
+            reduced = true;
+            result.reductions++;
+        }
+        if (stallMs >= thresholds.drainMs && !drained) {
+            drained = true;
+            result.drains++;
+            if (device.DrainAndSwitchToSync(TimeoutDefaults::kAsyncDrainStallTimeoutSeconds / TimeScale + 1)) {
+                lastProgressMs = msSince(start) * TimeScale;
+                result.worstRecoveryMs = std::max(result.worstRecoveryMs, (lastProgressMs - nowMs + stallMs) / TimeScale);
+                apply(recovery.onReduced(effectiveDepth, 1, lastProgressMs));
+                continue;
+            }
+        }
+        if (stallMs >= thresholds.restartMs) {
+            failed = true;
+            device.CancelAsyncIO();
+            break;
+        }
+    }
+    writer.join();
+
+    result.completed = !failed && completedBytes >= totalBytes;
+    result.wallMs = msSince(start);
+    result.finalDepth = device.IsInSyncFallbackMode() ? 1 : effectiveDepth;
+    return result;
+}
+
+void report(const char *name, const ScenarioResult &r, std::uint64_t totalBytes)
+{
+    std::printf("%-22s %s %6lld ms %6.1f MB/s  polls %d  reductions %d  drains %d  step-ups %d  "
+                "worst recovery %lld ms  final depth %d\n",
+                name, r.completed ? "ok    " : "FAILED", static_cast<long long>(r.wallMs),
+                r.wallMs ? static_cast<double>(totalBytes) / MiB * 1000.0 / r.wallMs : 0.0,
+                r.polls, r.reductions, r.drains, r.stepUps, static_cast<long long>(r.worstRecoveryMs), r.finalDepth);
+}
+
+} // namespace
+
+TEST_CASE("Emulated writes follow the write rate curve", "[slowdevice]") {
+    EmulatedDeviceModel model = quickModel(200.0);
+    model.write_rate.push_back({2 * MiB, 20.0});
+    EmulatedFileOperations device(model);
+    REQUIRE(device.CreateTestFile("", 64 * MiB) == FileError::kSuccess);
+
+    std::vector<std::uint8_t> data(MiB, 1);
+    auto start = Clock::now();
+    REQUIRE(device.WriteSequential(data.data(), data.size()) == FileError::kSuccess);
+    REQUIRE(device.WriteSequential(data.data(), data.size()) == FileError::kSuccess);
+    const int64_t fastMs = msSince(start);
+
+    start = Clock::now();
+    REQUIRE(device.WriteSequential(data.data(), data.size()) == FileError::kSuccess);
+    const int64_t slowMs = msSince(start);
+
+    CHECK(fastMs >= 9);    // 2 MiB at 200 MB/s
+    CHECK(fastMs < 40);
+    CHECK(slowMs >= 49);   // 1 MiB at 20 MB/s
+
+    std::vector<std::uint8_t> back(MiB);
+    std::size_t bytesRead = 0;
+    REQUIRE(device.ReadAtOffset(2 * MiB, back.data(), back.size(), bytesRead) == FileError::kSuccess);
+    CHECK(back == data);
+}
+
+TEST_CASE("GC pauses depend only on the model and its seed", "[slowdevice]") {
+    EmulatedDeviceModel model = quickModel(100000.0);
+    model.gc_mean_interval_bytes = 512 * 1024;
+    model.gc_pause_min_ms = 1;
+    model.gc_pause_max_ms = 4;
+    model.seed = 42;
+
+    auto run = [&model](std::uint64_t &pauseMs) {
+        EmulatedFileOperations device(model);
+        REQUIRE(device.CreateTestFile("", 64 * MiB) == FileError::kSuccess);
+        std::vector<std::uint8_t> data(Block, 2);
+        for (int i = 0; i < 32; ++i)
+            REQUIRE(device.WriteSequential(data.data(), data.size()) == FileError::kSuccess);
+        pauseMs = device.GetGcPauseMs();
+        return device.GetGcPauseCount();
+    };
+
+    std::uint64_t firstMs = 0, secondMs = 0;
+    const std::uint64_t first = run(firstMs);
+    const std::uint64_t second = run(secondMs);
+    CHECK(first > 4);   // About 16 expected for 8 MiB
+    CHECK(first == second);
+    CHECK(firstMs == secondMs);
+    CHECK(firstMs >= first);
+
+    model.seed = 43;
+    std::uint64_t otherMs = 0;
+    run(otherMs);
+    CHECK(otherMs != firstMs);
+}
+
+TEST_CASE("A sync pays for flushing what was written since the last one", "[slowdevice]") {
+    EmulatedDeviceModel model = quickModel(100000.0);
+    model.sync_base_us = 2000;
+    model.sync_flush_mb_per_s = 32.0;
+    EmulatedFileOperations device(model);
+    REQUIRE(device.CreateTestFile("", 64 * MiB) == FileError::kSuccess);
+
+    std::vector<std::uint8_t> data(MiB, 3);
+    REQUIRE(device.WriteSequential(data.data(), data.size()) == FileError::kSuccess);
+    auto start = Clock::now();
+    REQUIRE(device.ForceSync() == FileError::kSuccess);
+    CHECK(msSince(start) >= 33);   // 2 ms + 1 MiB at 32 MB/s
+
+    start = Clock::now();
+    REQUIRE(device.ForceSync() == FileError::kSuccess);
+    CHECK(msSince(start) < 20);
+}
+
+TEST_CASE("A lost completion is only delivered by polling", "[slowdevice]") {
+    EmulatedDeviceModel model = quickModel(1000.0);
+    model.lost_completions = {2};
+    EmulatedFileOperations device(model);
+    REQUIRE(device.CreateTestFile("", 64 * MiB) == FileError::kSuccess);
+    REQUIRE(device.SetAsyncQueueDepth(4));
+
+    std::vector<std::uint8_t> data(Block, 4);
+    std::atomic<int> completed{0};
+    auto count = [&completed](FileError r, std::size_t) { if (r == FileError::kSuccess) completed++; };
+    for (int i = 0; i < 3; ++i)
+        REQUIRE(device.AsyncWriteSequential(data.data(), data.size(), count) == FileError::kSuccess);
+    CHECK(device.GetLostCompletionCount() == 1);
+
+    // The writer blocks behind the lost completion until the watchdog polls
+    std::atomic<bool> waited{false};
+    std::thread writer([&] {
+        CHECK(device.WaitForPendingWrites() == FileError::kSuccess);
+        waited = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK_FALSE(waited);
+    CHECK(completed == 1);
+    CHECK(device.GetPendingWriteCount() == 2);
+
+    device.PollAsyncCompletions();
+    writer.join();
+    CHECK(completed == 3);
+    CHECK(device.GetPendingWriteCount() == 0);
+}
+
+TEST_CASE("Draining to sync delivers lost completions and writes on synchronously", "[slowdevice]") {
+    EmulatedDeviceModel model = quickModel(1000.0);
+    model.lost_completions = {1};
+    EmulatedFileOperations device(model);
+    REQUIRE(device.CreateTestFile("", 64 * MiB) == FileError::kSuccess);
+    REQUIRE(device.SetAsyncQueueDepth(8));
+
+    std::vector<std::uint8_t> data(Block, 5);
+    for (int i = 0; i < 4; ++i)
+        REQUIRE(device.AsyncWriteSequential(data.data(), data.size()) == FileError::kSuccess);
+
+    REQUIRE(device.DrainAndSwitchToSync(1));
+    CHECK(device.IsInSyncFallbackMode());
+    CHECK(device.GetPendingWriteCount() == 0);
+
+    REQUIRE(device.AsyncWriteSequential(data.data(), data.size()) == FileError::kSuccess);
+    CHECK(device.GetPendingWriteCount() == 0);
+    CHECK(device.Tell() == 5 * Block);
+
+    REQUIRE(device.ResumeAsyncAfterSyncFallback(2));
+    CHECK_FALSE(device.IsInSyncFallbackMode());
+}
+
+TEST_CASE("Emulated targets are named by preset", "[slowdevice]") {
+    CHECK(EmulatedFileOperations::IsEmulatedTarget("emulate:gc"));
+    CHECK_FALSE(EmulatedFileOperations::IsEmulatedTarget("ramdisk:1G"));
+
+    EmulatedDeviceModel model;
+    CHECK(EmulatedDeviceModel::Preset("slc-cliff", model));
+    CHECK(model.write_rate.size() == 2);
+    CHECK_FALSE(EmulatedDeviceModel::Preset("floppy", model));
+
+    EmulatedFileOperations device;
+    CHECK(device.OpenDevice("emulate:lost-completion") == FileError::kSuccess);
+    CHECK(device.GetModel().lost_completions.size() == 2);
+    CHECK(device.OpenDevice("emulate:floppy") == FileError::kOpenError);
+}
+
+TEST_CASE("Recovery scenarios", "[.benchmark][slowdevice]") {
+    constexpr std::uint64_t Total = 128 * MiB;
+    constexpr int Depth = 16;
+
+    SECTION("healthy") {
+        EmulatedFileOperations device(quickModel(400.0));
+        REQUIRE(device.CreateTestFile("", 1024 * MiB) == FileError::kSuccess);
+        const ScenarioResult r = runScenario(device, Total, Depth);
+        report("healthy", r, Total);
+        CHECK(r.completed);
+        CHECK(r.reductions == 0);
+    }
+
+    SECTION("gc pauses") {
+        // Pauses of 20-40 s on the watchdog's clock
+        EmulatedDeviceModel model = quickModel(400.0);
+        model.gc_mean_interval_bytes = 32 * MiB;
+        model.gc_pause_min_ms = 100;
+        model.gc_pause_max_ms = 200;
+        EmulatedFileOperations device(model);
+        REQUIRE(device.CreateTestFile("", 1024 * MiB) == FileError::kSuccess);
+        const ScenarioResult r = runScenario(device, Total, Depth);
+        report("gc pauses", r, Total);
+        CHECK(r.completed);
+    }
+
+    SECTION("lost completions") {
+        EmulatedDeviceModel model = quickModel(400.0);
+        model.lost_completions = {50, 300};
+        EmulatedFileOperations device(model);
+        REQUIRE(device.CreateTestFile("", 1024 * MiB) == FileError::kSuccess);
+        const ScenarioResult r = runScenario(device, Total, Depth);
+        report("lost completions", r, Total);
+        CHECK(r.completed);
+        CHECK(r.polls >= 1);
+    }
+
+    SECTION("long stall") {
+        // One 90 s pause on the watchdog's clock: reduce, then drain to sync
+        EmulatedDeviceModel model = quickModel(400.0);
+        model.gc_mean_interval_bytes = 48 * MiB;
+        model.gc_pause_min_ms = 450;
+        model.gc_pause_max_ms = 450;
+        EmulatedFileOperations device(model);
+        REQUIRE(device.CreateTestFile("", 1024 * MiB) == FileError::kSuccess);
+        const ScenarioResult r = runScenario(device, Total, Depth);
+        report("long stall", r, Total);
+        CHECK(r.completed);
+        CHECK(r.reductions >= 1);
+    }
+
+    SECTION("slc cliff") {
+        EmulatedDeviceModel model = quickModel(800.0);
+        model.write_rate.push_back({32 * MiB, 80.0});
+        EmulatedFileOperations device(model);
+        REQUIRE(device.CreateTestFile("", 1024 * MiB) == FileError::kSuccess);
+        const ScenarioResult r = runScenario(device, Total, Depth);
+        report("slc cliff", r, Total);
+        CHECK(r.completed);
+    }
+}
@@ -0,0 +1,201 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Unit tests for the fastboot sparse artefact cache.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "fastboot/sparse_artefact_cache.h"
+
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace fastboot;
+
+// ── Helpers ─────────────────────────────────────────────────────────────
+
+namespace {
+
+// A fresh cache root, removed again at the end of the test
+struct TempRoot {
+    std::filesystem::path path;
+    TempRoot()
+    {
+        std::random_device rd;
+        path = std::filesystem::temp_directory_path() /
+               ("sparse-artefact-test-" + std::to_string(rd()));
+        std::filesystem::create_directories(path);
+    }
+    ~TempRoot()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+};
+
+std::shared_ptr<const std::vector<uint8_t>> makeSegment(size_t size, uint8_t seed)
+{
+    auto data = std::make_shared<std::vector<uint8_t>>(size);
+    for (size_t i = 0; i < size; ++i)
+        (*data)[i] = static_cast<uint8_t>(seed + i);
+    return data;
+}
+
+std::vector<uint8_t> readFile(const std::filesystem::path& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), {});
+}
+
+bool recordArtefact(const SparseArtefactCache& cache, const std::string& key, size_t segments)
+{
+    auto writer = cache.record(key);
+    REQUIRE(writer);
+    for (size_t i = 0; i < segments; ++i) {
+        auto segment = makeSegment(4096, static_cast<uint8_t>(i));
+        REQUIRE(writer->add(segment, *segment, (i + 1) * 1000));
+        // Stay under the queue limit, which would abandon the recording
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return writer->commit();
+}
+
+} // namespace
+
+// ── Keys ────────────────────────────────────────────────────────────────
+
+TEST_CASE("Artefact keys depend on every input", "[sparse_artefact_cache]") {
+    const auto base = SparseArtefactCache::key("abc123", 0x10000000, "usedblocks");
+    CHECK(base == "abc123-10000000-usedblocks");
+    CHECK(SparseArtefactCache::key("abc124", 0x10000000, "usedblocks") != base);
+    CHECK(SparseArtefactCache::key("abc123", 0x8000000, "usedblocks") != base);
+    CHECK(SparseArtefactCache::key("abc123", 0x10000000, "none") != base);
+}
+
+TEST_CASE("Artefact keys are safe directory names", "[sparse_artefact_cache]") {
+    const auto key = SparseArtefactCache::key("AB/../cd", 1, "x\\y:z");
+    CHECK(key == "abcd-1-xyz");
+}
+
+// ── Recording and lookup ────────────────────────────────────────────────
+
+TEST_CASE("A committed artefact is found with its segments", "[sparse_artefact_cache]") {
+    TempRoot root;
+    SparseArtefactCache cache(root.path);
+    const auto key = SparseArtefactCache::key("aa", 4096, "none");
+
+    CHECK_FALSE(cache.find(key));
+    REQUIRE(recordArtefact(cache, key, 3));
+
+    auto segments = cache.find(key);
+    REQUIRE(segments);
+    REQUIRE(segments->size() == 3);
+    for (size_t i = 0; i < segments->size(); ++i) {
+        const auto& segment = (*segments)[i];
+        CHECK(segment.size == 4096);
+        CHECK(segment.fedBytes == (i + 1) * 1000);
+        CHECK(readFile(segment.path) == *makeSegment(4096, static_cast<uint8_t>(i)));
+    }
+}
+
+TEST_CASE("An aborted or unfinished recording is not found", "[sparse_artefact_cache]") {
+    TempRoot root;
+    SparseArtefactCache cache(root.path);
+    const auto key = SparseArtefactCache::key("bb", 4096, "none");
+
+    {
+        auto writer = cache.record(key);
+        REQUIRE(writer);
+        auto segment = makeSegment(4096, 1);
+        writer->add(segment, *segment, 4096);
+        writer->abort();
+    }
+    CHECK_FALSE(cache.find(key));
+
+    {
+        auto writer = cache.record(key);
+        auto segment = makeSegment(4096, 1);
+        writer->add(segment, *segment, 4096);
+        CHECK_FALSE(cache.find(key));
+        // Dropped without commit()
+    }
+    CHECK_FALSE(cache.find(key));
+    CHECK(std::filesystem::is_empty(root.path));
+}
+
+TEST_CASE("A recording with no segments is not committed", "[sparse_artefact_cache]") {
+    TempRoot root;
+    SparseArtefactCache cache(root.path);
+    auto writer = cache.record("empty");
+    REQUIRE(writer);
+    CHECK_FALSE(writer->commit());
+    CHECK_FALSE(cache.find("empty"));
+}
+
+TEST_CASE("A truncated segment invalidates the artefact", "[sparse_artefact_cache]") {
+    TempRoot root;
+    SparseArtefactCache cache(root.path);
+    REQUIRE(recordArtefact(cache, "cc", 2));
+
+    auto segments = cache.find("cc");
+    REQUIRE(segments);
+    std::filesystem::resize_file(segments->back().path, 100);
+    CHECK_FALSE(cache.find("cc"));
+}
+
+TEST_CASE("A recording replaces an older artefact", "[sparse_artefact_cache]") {
+    TempRoot root;
+    SparseArtefactCache cache(root.path);
+    REQUIRE(recordArtefact(cache, "dd", 3));
+    REQUIRE(recordArtefact(cache, "dd", 1));
+
+    auto segments = cache.find("dd");
+    REQUIRE(segments);
+    CHECK(segments->size() == 1);
+}
+
+// ── Pruning ─────────────────────────────────────────────────────────────
+
+TEST_CASE("Pruning keeps the most recently used artefacts", "[sparse_artefact_cache]") {
+    TempRoot root;
+    SparseArtefactCache cache(root.path);
+    REQUIRE(recordArtefact(cache, "first", 1));
+    REQUIRE(recordArtefact(cache, "second", 1));
+    REQUIRE(recordArtefact(cache, "third", 1));
+
+    // Make "first" the most recent use, "second" the oldest
+    const auto now = std::filesystem::file_time_type::clock::now();
+    std::filesystem::last_write_time(root.path / "second" / "manifest", now - std::chrono::hours(2));
+    std::filesystem::last_write_time(root.path / "third" / "manifest", now - std::chrono::hours(1));
+    REQUIRE(cache.find("first"));
+
+    cache.prune(2);
+    CHECK(cache.find("first"));
+    CHECK_FALSE(cache.find("second"));
+    CHECK(cache.find("third"));
+}
+
+TEST_CASE("Pruning removes stale recordings but not current ones", "[sparse_artefact_cache]") {
+    TempRoot root;
+    SparseArtefactCache cache(root.path);
+
+    auto active = cache.record("active");
+    REQUIRE(active);
+
+    const auto stale = root.path / "old.partial-1-0";
+    std::filesystem::create_directories(stale);
+    std::filesystem::last_write_time(stale, std::filesystem::file_time_type::clock::now() - std::chrono::hours(48));
+
+    cache.prune(2);
+    CHECK_FALSE(std::filesystem::exists(stale));
+
+    auto segment = makeSegment(512, 7);
+    REQUIRE(active->add(segment, *segment, 512));
+    CHECK(active->commit());
+    CHECK(cache.find("active"));
+}
@@ -64,6 +64,11 @@ static std::vector<uint8_t> decodeSparse(std::span<const uint8_t> sparse)
             // Leave as zeros
             break;
 
+        case CHUNK_TYPE_CRC32:
+            REQUIRE(pos + 4 <= sparse.size());
+            pos += 4;
+            break;
+
         default:
             FAIL("Unknown chunk type: " << chdr.chunk_type);
         }
@@ -116,6 +121,11 @@ static void applySparse(std::span<const uint8_t> sparse, std::vector<uint8_t>& o
             // Leave existing content untouched (skip)
             break;
 
+        case CHUNK_TYPE_CRC32:
+            REQUIRE(pos + 4 <= sparse.size());
+            pos += 4;
+            break;
+
         default:
             FAIL("Unknown chunk type: " << chdr.chunk_type);
         }
@@ -424,6 +434,93 @@ TEST_CASE("isBlockFill correctly identifies fill blocks", "[sparse]")
     REQUIRE_FALSE(isBlockFill(block, &fillVal));
 }
 
+TEST_CASE("classifyBlockFill agrees with isBlockFill", "[sparse]")
+{
+    INFO("classifier: " << blockClassifierName());
+
+    alignas(8) uint8_t block[SPARSE_BLK_SZ] = {};
+    uint32_t fillVal = 1;
+    REQUIRE(classifyBlockFill(block, &fillVal));
+    REQUIRE(fillVal == 0);
+
+    uint32_t pattern = 0xDEADBEEF;
+    for (size_t i = 0; i < SPARSE_BLK_SZ; i += 4)
+        std::memcpy(block + i, &pattern, 4);
+    REQUIRE(classifyBlockFill(block, &fillVal));
+    REQUIRE(fillVal == pattern);
+
+    // A mismatch anywhere in the block, including each 512-byte stride
+    for (size_t pos : {size_t(4), size_t(511), size_t(512), size_t(2049), size_t(SPARSE_BLK_SZ - 1)}) {
+        block[pos] ^= 0x01;
+        REQUIRE_FALSE(classifyBlockFill(block, &fillVal));
+        REQUIRE_FALSE(isBlockFill(block, &fillVal));
+        block[pos] ^= 0x01;
+    }
+}
+
+// Feed the whole remaining input on each call so the parallel classifier
+// sees spans large enough to use its workers.
+static std::vector<std::vector<uint8_t>> feedWholeAndCollect(
+    SparseEncoder& enc, const std::vector<uint8_t>& data)
+{
+    std::vector<std::vector<uint8_t>> segments;
+    size_t off = 0;
+    while (off < data.size()) {
+        off += enc.feed(data.data() + off, data.size() - off);
+        auto seg = enc.takeSegment();
+        if (!seg.empty())
+            segments.emplace_back(seg.begin(), seg.end());
+    }
+    while (true) {
+        enc.finish();
+        auto seg = enc.takeSegment();
+        if (seg.empty())
+            break;
+        segments.emplace_back(seg.begin(), seg.end());
+    }
+    return segments;
+}
+
+TEST_CASE("Parallel classification matches sequential output", "[sparse]")
+{
+    // Alternating runs of random, zero and fill blocks, with segments
+    // small enough that feed() returns early many times mid-span.
+    constexpr size_t BLOCKS = 2048;
+    constexpr size_t IMAGE_SIZE = BLOCKS * SPARSE_BLK_SZ;
+    constexpr uint32_t MAX_SEG = 256 * 1024;
+
+    std::vector<uint8_t> image(IMAGE_SIZE, 0);
+    std::mt19937 rng(7);
+    for (size_t b = 0; b < BLOCKS; ) {
+        size_t run = rng() % 40 + 1;
+        unsigned kind = rng() % 3;
+        for (size_t i = 0; i < run && b < BLOCKS; ++i, ++b) {
+            uint8_t* blk = image.data() + b * SPARSE_BLK_SZ;
+            if (kind == 0) {
+                for (size_t j = 0; j < SPARSE_BLK_SZ; ++j)
+                    blk[j] = static_cast<uint8_t>(rng());
+            } else if (kind == 2) {
+                uint32_t pattern = 0x5A5A0000u | (b % 3);
+                for (size_t j = 0; j < SPARSE_BLK_SZ; j += 4)
+                    std::memcpy(blk + j, &pattern, 4);
+            }
+        }
+    }
+
+    SparseEncoder sequential(MAX_SEG, IMAGE_SIZE);
+    auto expected = feedWholeAndCollect(sequential, image);
+
+    SparseEncoder parallel(MAX_SEG, IMAGE_SIZE);
+    parallel.setClassifyThreads(4);
+    auto actual = feedWholeAndCollect(parallel, image);
+
+    REQUIRE(actual.size() > 1);
+    REQUIRE(actual == expected);
+    REQUIRE(parallel.fillBlockCount() == sequential.fillBlockCount());
+    REQUIRE(parallel.rawBlockCount() == sequential.rawBlockCount());
+    REQUIRE(decodeSegments(actual) == image);
+}
+
 TEST_CASE("Large zero regions produce compact sparse output", "[sparse]")
 {
     // 1 GB of zeros should produce a tiny sparse image
@@ -491,3 +588,231 @@ TEST_CASE("Feeding data in odd chunk sizes works correctly", "[sparse]")
     auto decoded = decodeSegments(segments);
     REQUIRE(decoded == image);
 }
+
+TEST_CASE("takeSegment into a buffer outlives later feed() calls", "[sparse]")
+{
+    constexpr uint32_t MAX_SEG = SPARSE_FILE_HDR_SZ + SPARSE_CHUNK_HDR_SZ + 2 * SPARSE_BLK_SZ;
+    constexpr size_t IMAGE_SIZE = 8 * SPARSE_BLK_SZ;
+
+    std::vector<uint8_t> image(IMAGE_SIZE);
+    std::mt19937 rng(5);
+    for (auto& b : image)
+        b = static_cast<uint8_t>(rng() % 254 + 1);
+
+    SparseEncoder reference(MAX_SEG, IMAGE_SIZE);
+    auto expected = feedAndCollect(reference, image);
+
+    // Hold every segment while encoding continues, recycling one buffer
+    // back into the encoder each time as a pipelined sender would.
+    SparseEncoder enc(MAX_SEG, IMAGE_SIZE);
+    std::vector<std::vector<uint8_t>> held;
+    std::vector<uint8_t> spare;
+    size_t off = 0;
+    while (off < IMAGE_SIZE) {
+        off += enc.feed(image.data() + off, IMAGE_SIZE - off);
+        if (enc.takeSegment(spare)) {
+            held.push_back(spare);
+            spare.assign(spare.size(), 0xEE);  // stale contents must not leak
+        }
+    }
+    while (true) {
+        enc.finish();
+        if (!enc.takeSegment(spare))
+            break;
+        held.push_back(spare);
+    }
+
+    REQUIRE(held == expected);
+    REQUIRE(decodeSegments(held) == image);
+}
+
+// ── Checksums ───────────────────────────────────────────────────────────
+
+// Bitwise CRC-32 as zlib computes it, to check the kernels against
+static uint32_t referenceCrc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; ++k)
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+    }
+    return ~crc;
+}
+
+TEST_CASE("sparseCrc32 matches the zlib CRC-32", "[sparse]")
+{
+    INFO("kernel: " << crc32KernelName());
+
+    const char* check = "123456789";
+    REQUIRE(sparseCrc32(0, reinterpret_cast<const uint8_t*>(check), 9) == 0xCBF43926);
+
+    // Every alignment and length around the 16- and 64-byte folding steps
+    std::vector<uint8_t> data(SPARSE_BLK_SZ + 64);
+    std::mt19937 rng(11);
+    for (auto& b : data)
+        b = static_cast<uint8_t>(rng());
+    for (size_t offset = 0; offset < 16; ++offset) {
+        for (size_t size : {size_t(0), size_t(15), size_t(63), size_t(64), size_t(65), size_t(200),
+                            size_t(SPARSE_BLK_SZ)}) {
+            const uint32_t seed = static_cast<uint32_t>(rng());
+            REQUIRE(sparseCrc32(seed, data.data() + offset, size)
+                    == referenceCrc32(seed, data.data() + offset, size));
+        }
+    }
+}
+
+TEST_CASE("Checksummed segments end with the CRC of their image range", "[sparse]")
+{
+    constexpr uint32_t MAX_SEG = 32 * 1024;
+    constexpr size_t BLOCKS = 200;
+
+    // RAW, FILL(0), other fills and a partial last block
+    std::vector<uint8_t> image(BLOCKS * SPARSE_BLK_SZ + 1000, 0);
+    std::mt19937 rng(13);
+    for (size_t b = 0; b < BLOCKS; ++b) {
+        uint8_t* block = image.data() + b * SPARSE_BLK_SZ;
+        switch (rng() % 4) {
+        case 0:
+            for (size_t i = 0; i < SPARSE_BLK_SZ; ++i)
+                block[i] = static_cast<uint8_t>(rng());
+            break;
+        case 1: {
+            const uint32_t pattern = 0xA5A5A5A5 + rng() % 2;
+            for (size_t i = 0; i < SPARSE_BLK_SZ; i += 4)
+                std::memcpy(block + i, &pattern, 4);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    SparseEncoder enc(MAX_SEG, image.size());
+    enc.setChecksums(true);
+
+    std::vector<std::vector<uint8_t>> segments;
+    std::vector<uint32_t> reported;
+    std::vector<uint8_t> buffer;
+    SparseEncoder::SegmentStats stats;
+    size_t off = 0;
+    while (off < image.size()) {
+        off += enc.feed(image.data() + off, std::min<size_t>(50000, image.size() - off));
+        if (enc.takeSegment(buffer, &stats)) {
+            segments.push_back(buffer);
+            reported.push_back(stats.crc32);
+        }
+    }
+    while (true) {
+        enc.finish();
+        if (!enc.takeSegment(buffer, &stats))
+            break;
+        segments.push_back(buffer);
+        reported.push_back(stats.crc32);
+    }
+
+    REQUIRE(segments.size() > 4);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const auto& seg = segments[i];
+        REQUIRE(seg.size() <= MAX_SEG);
+
+        SparseChunkHeader last;
+        std::memcpy(&last, seg.data() + seg.size() - SPARSE_CHUNK_HDR_SZ - 4, sizeof(last));
+        REQUIRE(last.chunk_type == CHUNK_TYPE_CRC32);
+        uint32_t crc;
+        std::memcpy(&crc, seg.data() + seg.size() - 4, 4);
+
+        // The whole range the segment covers, DONT_CARE read as zeros
+        const auto expanded = decodeSparse({seg.data(), seg.size()});
+        CHECK(crc == referenceCrc32(0, expanded.data(), expanded.size()));
+        CHECK(crc == reported[i]);
+    }
+
+    auto padded = image;
+    padded.resize((BLOCKS + 1) * SPARSE_BLK_SZ, 0);
+    REQUIRE(decodeSegments(segments) == padded);
+}
+
+// ── Segment sizing ──────────────────────────────────────────────────────
+
+TEST_CASE("Segment size limit caps segments below maxDownloadSize", "[sparse]")
+{
+    constexpr size_t IMAGE_SIZE = 64 * SPARSE_BLK_SZ;
+    std::vector<uint8_t> image(IMAGE_SIZE);
+    std::mt19937 rng(7);
+    for (auto& b : image)
+        b = static_cast<uint8_t>(rng() % 254 + 1);
+
+    constexpr uint32_t LIMIT = SPARSE_FILE_HDR_SZ + 3 * SPARSE_CHUNK_HDR_SZ + 8 * SPARSE_BLK_SZ;
+    SparseEncoder enc(1024 * 1024, IMAGE_SIZE);
+    enc.setSegmentSizeLimit(LIMIT);
+    CHECK(enc.segmentSizeLimit() == LIMIT);
+
+    auto segments = feedAndCollect(enc, image);
+    REQUIRE(segments.size() >= 8);
+    for (const auto& seg : segments)
+        REQUIRE(seg.size() <= LIMIT);
+    REQUIRE(decodeSegments(segments) == image);
+
+    // Never above the maximum, never too small to hold a block
+    enc.setSegmentSizeLimit(UINT32_MAX);
+    CHECK(enc.segmentSizeLimit() == 1024 * 1024);
+    enc.setSegmentSizeLimit(1);
+    CHECK(enc.segmentSizeLimit() > SPARSE_BLK_SZ);
+}
+
+TEST_CASE("A small segment still spans a large uniform region", "[sparse]")
+{
+    // RAW block, 100000 zero blocks, RAW block
+    constexpr size_t BLOCKS = 100002;
+    std::vector<uint8_t> image(BLOCKS * SPARSE_BLK_SZ, 0);
+    std::memset(image.data(), 0x11, SPARSE_BLK_SZ);
+    std::memset(image.data() + (BLOCKS - 1) * SPARSE_BLK_SZ, 0x22, SPARSE_BLK_SZ);
+    image[1] = 0x33;
+    image[(BLOCKS - 1) * SPARSE_BLK_SZ + 1] = 0x44;
+
+    SparseEncoder enc(256 * 1024 * 1024, image.size());
+    enc.setSegmentSizeLimit(64 * 1024);
+    auto segments = feedAndCollect(enc, image);
+
+    REQUIRE(segments.size() == 1);
+    REQUIRE(decodeSegments(segments) == image);
+}
+
+TEST_CASE("SegmentSizer starts small and grows with the link", "[sparse]")
+{
+    constexpr uint32_t MAX = 256 * 1024 * 1024;
+    SegmentSizer sizer(MAX);
+    CHECK(sizer.nextSize() == SegmentSizer::INITIAL_SEGMENT_SIZE);
+    CHECK(sizer.linkBytesPerSec() == 0);
+
+    // 40 MB/s: grows by at most 2x per segment towards 80 MB
+    for (int i = 0; i < 3; ++i) {
+        const uint32_t before = sizer.nextSize();
+        sizer.recordTransfer(before, before / 40000);
+        CHECK(sizer.nextSize() == 2 * before);
+    }
+    for (int i = 0; i < 10; ++i)
+        sizer.recordTransfer(sizer.nextSize(), sizer.nextSize() / 40000);
+    // Within millisecond rounding of 2 s at 40 MB/s
+    CHECK(sizer.nextSize() > 79 * 1000 * 1000);
+    CHECK(sizer.nextSize() < 81 * 1000 * 1000);
+
+    // A faster link is capped at max-download-size
+    for (int i = 0; i < 10; ++i)
+        sizer.recordTransfer(sizer.nextSize(), sizer.nextSize() / 400000);
+    CHECK(sizer.nextSize() == MAX);
+
+    // A slow link shrinks back, but not below the initial size
+    for (int i = 0; i < 20; ++i)
+        sizer.recordTransfer(1024 * 1024, 1000);
+    CHECK(sizer.nextSize() == SegmentSizer::INITIAL_SEGMENT_SIZE);
+}
+
+TEST_CASE("SegmentSizer never exceeds a small max-download-size", "[sparse]")
+{
+    SegmentSizer sizer(1024 * 1024);
+    CHECK(sizer.nextSize() == 1024 * 1024);
+    sizer.recordTransfer(1024 * 1024, 1);
+    CHECK(sizer.nextSize() == 1024 * 1024);
+}
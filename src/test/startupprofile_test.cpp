@@ -0,0 +1,77 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the startup phase tracer and its report
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "startupprofile.h"
+
+#include <QJsonArray>
+
+TEST_CASE("Phases run from one mark to the next", "[startupprofile]") {
+    StartupProfile profile;
+    profile.start();
+    profile.markAt("qt_application", 40);
+    profile.markAt("qml_load", 400);
+    profile.markAt("first_frame", 550);
+
+    const QList<StartupProfile::Phase> phases = profile.phases();
+    REQUIRE(phases.size() == 3);
+    CHECK(phases[0].startMs == 0);
+    CHECK(phases[0].endMs == 40);
+    CHECK(phases[1].startMs == 40);
+    CHECK(phases[1].endMs == 400);
+    CHECK(phases[2].startMs == 400);
+
+    const QJsonObject report = profile.report();
+    CHECK(report["totalMs"].toInteger() == 550);
+    const QJsonArray reported = report["phases"].toArray();
+    REQUIRE(reported.size() == 3);
+    CHECK(reported[1].toObject()["name"].toString() == "qml_load");
+    CHECK(reported[1].toObject()["durationMs"].toInteger() == 360);
+    CHECK_FALSE(report.contains("budgetMs"));
+}
+
+TEST_CASE("Only the first mark of a name counts", "[startupprofile]") {
+    StartupProfile profile;
+    profile.start();
+    profile.markAt("first_frame", 100);
+    profile.markAt("first_frame", 116);
+    profile.markAt("os_list_first_paint", 90);   // Cannot end before it started
+
+    const QList<StartupProfile::Phase> phases = profile.phases();
+    REQUIRE(phases.size() == 2);
+    CHECK(phases[0].endMs == 100);
+    CHECK(phases[1].startMs == 100);
+    CHECK(phases[1].endMs == 100);
+}
+
+TEST_CASE("Milestones are kept apart from the critical path", "[startupprofile]") {
+    StartupProfile profile;
+    profile.start();
+    profile.markAt("image_writer", 200);
+    profile.milestoneAt("drive_list_first_scan", 350);
+    profile.milestoneAt("drive_list_first_scan", 1350);
+    profile.markAt("qml_load", 600);
+
+    CHECK(profile.isMarked("drive_list_first_scan"));
+    CHECK(profile.isMarked("qml_load"));
+    CHECK_FALSE(profile.isMarked("os_list_ready"));
+
+    const QJsonObject report = profile.report();
+    CHECK(report["totalMs"].toInteger() == 600);
+    CHECK(report["phases"].toArray().size() == 2);
+    CHECK(report["milestones"].toObject()["drive_list_first_scan"].toInteger() == 350);
+}
+
+TEST_CASE("The report checks the budget", "[startupprofile]") {
+    StartupProfile profile;
+    profile.start();
+    profile.markAt("os_list_first_paint", 2500);
+
+    CHECK(profile.report(3000)["withinBudget"].toBool());
+    CHECK(profile.report(3000)["budgetMs"].toInteger() == 3000);
+    CHECK_FALSE(profile.report(2000)["withinBudget"].toBool());
+}
@@ -0,0 +1,125 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for per-stage thread CPU time accounting
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "threadcputime.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using Stage = ThreadCpuTime::Stage;
+
+namespace {
+
+// Busy for about the given CPU time
+void spin(int64_t us)
+{
+    const int64_t until = ThreadCpuTime::currentThreadUs() + us;
+    volatile uint64_t x = 0;
+    while (ThreadCpuTime::currentThreadUs() < until)
+        x = x + 1;
+}
+
+const ThreadCpuTime::StageTime &of(const ThreadCpuTime::Sample &sample, Stage stage)
+{
+    return sample[static_cast<size_t>(stage)];
+}
+
+} // namespace
+
+TEST_CASE("The calling thread's CPU time can be read", "[threadcputime]") {
+    const int64_t before = ThreadCpuTime::currentThreadUs();
+    REQUIRE(before >= 0);
+    spin(20000);
+    CHECK(ThreadCpuTime::currentThreadUs() - before >= 20000);
+}
+
+TEST_CASE("A busy thread is counted while it runs and after it ends", "[threadcputime]") {
+    const ThreadCpuTime::Sample start = ThreadCpuTime::sample();
+    std::atomic<bool> spun{false}, done{false};
+    std::thread worker([&]() {
+        ThreadCpuTime::Scope scope(Stage::Decompress);
+        spin(50000);
+        spun = true;
+        while (!done)
+            std::this_thread::yield();
+    });
+    while (!spun)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // Read from this thread through the worker's CPU clock
+    const ThreadCpuTime::Sample live = ThreadCpuTime::difference(ThreadCpuTime::sample(), start);
+    CHECK(of(live, Stage::Decompress).cpuUs >= 50000);
+    CHECK(of(live, Stage::Decompress).activeUs >= of(live, Stage::Decompress).cpuUs / 2);
+    CHECK(of(live, Stage::CacheWrite).cpuUs == 0);
+
+    done = true;
+    worker.join();
+    const ThreadCpuTime::Sample after = ThreadCpuTime::difference(ThreadCpuTime::sample(), start);
+    CHECK(of(after, Stage::Decompress).cpuUs >= of(live, Stage::Decompress).cpuUs);
+}
+
+TEST_CASE("A blocked thread is active without using CPU", "[threadcputime]") {
+    const ThreadCpuTime::Sample start = ThreadCpuTime::sample();
+    std::thread worker([]() {
+        ThreadCpuTime::Scope scope(Stage::CacheWrite);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    });
+    worker.join();
+
+    const ThreadCpuTime::Sample added = ThreadCpuTime::difference(ThreadCpuTime::sample(), start);
+    CHECK(of(added, Stage::CacheWrite).activeUs >= 100000);
+    CHECK(of(added, Stage::CacheWrite).cpuUs < 50000);
+}
+
+TEST_CASE("An inner Scope pauses the outer one", "[threadcputime]") {
+    const ThreadCpuTime::Sample start = ThreadCpuTime::sample();
+    std::thread worker([]() {
+        ThreadCpuTime::Scope write(Stage::Write);
+        spin(20000);
+        {
+            ThreadCpuTime::Scope verify(Stage::Verify);
+            spin(60000);
+        }
+        spin(20000);
+    });
+    worker.join();
+
+    const ThreadCpuTime::Sample added = ThreadCpuTime::difference(ThreadCpuTime::sample(), start);
+    CHECK(of(added, Stage::Verify).cpuUs >= 60000);
+    CHECK(of(added, Stage::Write).cpuUs >= 40000);
+    CHECK(of(added, Stage::Write).cpuUs < 60000);
+}
+
+TEST_CASE("Tasks count on threads without a Scope", "[threadcputime]") {
+    const ThreadCpuTime::Sample start = ThreadCpuTime::sample();
+    std::thread worker([]() {
+        for (int i = 0; i < 3; ++i)
+        {
+            ThreadCpuTime::Task task(Stage::Hash);
+            spin(10000);
+        }
+    });
+    worker.join();
+
+    const ThreadCpuTime::Sample added = ThreadCpuTime::difference(ThreadCpuTime::sample(), start);
+    CHECK(of(added, Stage::Hash).cpuUs >= 30000);
+    CHECK(of(added, Stage::Hash).activeUs >= of(added, Stage::Hash).cpuUs / 2);
+}
+
+TEST_CASE("Differences never go negative", "[threadcputime]") {
+    ThreadCpuTime::Sample earlier, later;
+    earlier[0].cpuUs = 100;
+    later[0].cpuUs = 50;
+    later[1].activeUs = 10;
+    const ThreadCpuTime::Sample added = ThreadCpuTime::difference(later, earlier);
+    CHECK(added[0].cpuUs == 0);
+    CHECK(added[1].activeUs == 10);
+    CHECK(std::string(ThreadCpuTime::stageName(Stage::CacheWrite)) == "cacheWrite");
+}
@@ -0,0 +1,45 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for placing pipeline threads on big cores
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "threadplacement.h"
+
+using ThreadPlacement::planFor;
+
+TEST_CASE("Cores that are all alike are left to the scheduler", "[threadplacement]") {
+    const auto plan = planFor({1024, 1024, 1024, 1024});
+    CHECK(plan.bigCores.isEmpty());
+    CHECK(plan.decompressCpu == -1);
+    CHECK(plan.hashCpu == -1);
+
+    CHECK(planFor({}).decompressCpu == -1);
+    CHECK(planFor({0, 0}).decompressCpu == -1);
+}
+
+TEST_CASE("Decompress and hash get separate big cores", "[threadplacement]") {
+    // Four little cores, then four big ones
+    const auto plan = planFor({446, 446, 446, 446, 1024, 1024, 1024, 1024});
+    CHECK(plan.bigCores == QList<int>({4, 5, 6, 7}));
+    CHECK(plan.decompressCpu == 4);
+    CHECK(plan.hashCpu == 5);
+}
+
+TEST_CASE("Only the fastest cores count as big", "[threadplacement]") {
+    // Little, mid and prime cores
+    const auto plan = planFor({325, 325, 828, 828, 1024});
+    CHECK(plan.bigCores == QList<int>{4});
+    CHECK(plan.decompressCpu == 4);
+    // Sharing the only prime core would slow both down
+    CHECK(plan.hashCpu == -1);
+}
+
+TEST_CASE("CPUs outside the affinity mask are skipped", "[threadplacement]") {
+    const auto plan = planFor({0, 512, 0, 1024, 1024});
+    CHECK(plan.bigCores == QList<int>({3, 4}));
+    CHECK(plan.decompressCpu == 3);
+    CHECK(plan.hashCpu == 4);
+}
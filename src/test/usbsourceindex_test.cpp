@@ -0,0 +1,79 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the index of images on USB source media
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "usbsourceindex.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+TEST_CASE("Index entries survive a round trip and stay per volume", "[usbsourceindex]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    UsbSourceIndex index(dir.path());
+
+    index.update("1234-ABCD", [](UsbSourceIndex::Entries &entries) {
+        UsbSourceIndex::Entry entry;
+        entry.size = 100;
+        entry.modified = 5000;
+        entry.sha256 = "abc123";
+        entry.extractSize = 400;
+        entries.insert("os.img.xz", entry);
+        return true;
+    });
+
+    const UsbSourceIndex::Entries loaded = UsbSourceIndex(dir.path()).load("1234-ABCD");
+    REQUIRE(loaded.size() == 1);
+    const UsbSourceIndex::Entry &entry = loaded.value("os.img.xz");
+    CHECK(entry.size == 100);
+    CHECK(entry.modified == 5000);
+    CHECK(entry.sha256 == "abc123");
+    CHECK(entry.extractSize == 400);
+
+    CHECK(index.load("other-volume").isEmpty());
+    // Not a file name
+    CHECK(index.load("../1234-ABCD").isEmpty());
+}
+
+TEST_CASE("Unchanged indexes are not written", "[usbsourceindex]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    UsbSourceIndex index(dir.path());
+
+    index.update("vol", [](UsbSourceIndex::Entries &entries) {
+        entries.insert("a.img", UsbSourceIndex::Entry{});
+        return false;
+    });
+    CHECK(index.load("vol").isEmpty());
+}
+
+TEST_CASE("An entry no longer matches a changed file", "[usbsourceindex]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString path = dir.filePath("image.img");
+    {
+        QFile f(path);
+        REQUIRE(f.open(QIODevice::WriteOnly));
+        f.write("abc");
+    }
+
+    const UsbSourceIndex::Entry entry = UsbSourceIndex::entryFor(QFileInfo(path));
+    CHECK(UsbSourceIndex::matches(entry, QFileInfo(path)));
+
+    {
+        QFile f(path);
+        REQUIRE(f.open(QIODevice::Append));
+        f.write("def");
+    }
+    CHECK_FALSE(UsbSourceIndex::matches(entry, QFileInfo(path)));
+
+    std::atomic<bool> cancelled{false};
+    CHECK(UsbSourceIndex::hashFile(path, cancelled) ==
+          "bef57ec7f53a6d40beb640a780a639c83bc29ac8a9816f1fc6c5c6dcd93c4721");
+    cancelled = true;
+    CHECK(UsbSourceIndex::hashFile(path, cancelled).isEmpty());
+}
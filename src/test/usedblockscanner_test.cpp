@@ -0,0 +1,402 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for UsedBlockScanner and StreamingBlockMapper on synthetic FAT32 and
+ * ext4 disks
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "usedblockscanner.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <map>
+
+namespace {
+
+constexpr std::uint64_t kMiB = 1024 * 1024;
+constexpr std::uint64_t kBlock = UsedBlockScanner::kBlockSize;
+
+// Disk image that only stores the blocks written to, the rest reads as zeros
+class SparseDisk
+{
+public:
+    explicit SparseDisk(std::uint64_t size) : _size(size) {}
+
+    std::uint64_t size() const { return _size; }
+
+    void write(std::uint64_t offset, const void *data, size_t len)
+    {
+        const char *src = static_cast<const char *>(data);
+        for (size_t i = 0; i < len; i++)
+            _blocks[(offset + i) / kBlock][(offset + i) % kBlock] = src[i];
+    }
+
+    void put16(std::uint64_t offset, std::uint16_t value)
+    {
+        const unsigned char bytes[2] = {static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8)};
+        write(offset, bytes, sizeof(bytes));
+    }
+
+    void put32(std::uint64_t offset, std::uint32_t value)
+    {
+        put16(offset, static_cast<std::uint16_t>(value));
+        put16(offset + 2, static_cast<std::uint16_t>(value >> 16));
+    }
+
+    void put64(std::uint64_t offset, std::uint64_t value)
+    {
+        put32(offset, static_cast<std::uint32_t>(value));
+        put32(offset + 4, static_cast<std::uint32_t>(value >> 32));
+    }
+
+    void setBit(std::uint64_t offset, std::uint64_t bit)
+    {
+        auto &byte = _blocks[(offset + bit / 8) / kBlock][(offset + bit / 8) % kBlock];
+        byte = static_cast<char>(byte | (1 << (bit % 8)));
+    }
+
+    bool read(std::uint64_t offset, char *buf, size_t len) const
+    {
+        if (offset + len > _size)
+            return false;
+        for (size_t i = 0; i < len;)
+        {
+            const std::uint64_t pos = offset + i;
+            const size_t n = std::min<size_t>(len - i, kBlock - pos % kBlock);
+            auto it = _blocks.find(pos / kBlock);
+            if (it == _blocks.end())
+                memset(buf + i, 0, n);
+            else
+                memcpy(buf + i, it->second.data() + pos % kBlock, n);
+            i += n;
+        }
+        return true;
+    }
+
+    UsedBlockScanner::ReadFunction reader() const
+    {
+        return [this](std::uint64_t offset, char *buf, size_t len) { return read(offset, buf, len); };
+    }
+
+private:
+    std::uint64_t _size;
+    std::map<std::uint64_t, std::array<char, kBlock>> _blocks;
+};
+
+void putMbrSignature(SparseDisk &disk)
+{
+    disk.put16(510, 0xAA55);
+}
+
+void putMbrEntry(SparseDisk &disk, int index, unsigned char type, std::uint32_t start, std::uint32_t sectors)
+{
+    const std::uint64_t entry = 446 + index * 16;
+    disk.write(entry + 4, &type, 1);
+    disk.put32(entry + 8, start);
+    disk.put32(entry + 12, sectors);
+}
+
+// MBR with one FAT32 partition of 300 MiB at 4 MiB
+constexpr std::uint32_t kFatPartSectors = 300 * kMiB / 512;
+constexpr std::uint64_t kFatPart = 8192 * 512;
+constexpr std::uint32_t kFatSectors = 601;
+
+void putFat32Disk(SparseDisk &disk)
+{
+    putMbrSignature(disk);
+    const std::uint32_t partSectors = kFatPartSectors;
+    putMbrEntry(disk, 0, 0x0C, 8192, partSectors);
+
+    // 4 KiB clusters; 38 reserved sectors put the data area on a block boundary
+    const std::uint64_t part = kFatPart;
+    const std::uint32_t fatSectors = kFatSectors;
+    const unsigned char jmp[3] = {0xEB, 0x58, 0x90};
+    disk.write(part, jmp, sizeof(jmp));
+    disk.put16(part + 11, 512);
+    const unsigned char sectorsPerCluster = 8, numFats = 2;
+    disk.write(part + 13, &sectorsPerCluster, 1);
+    disk.put16(part + 14, 38);
+    disk.write(part + 16, &numFats, 1);
+    disk.put32(part + 32, partSectors);
+    disk.put32(part + 36, fatSectors);
+    disk.put32(part + 44, 2);
+    disk.put16(part + 510, 0xAA55);
+
+    const std::uint64_t fat = part + 38 * 512;
+    disk.put32(fat + 0, 0x0FFFFFF8);
+    disk.put32(fat + 4, 0x0FFFFFFF);
+    disk.put32(fat + 2 * 4, 0x0FFFFFFF);   // Root directory
+    disk.put32(fat + 3 * 4, 4);
+    disk.put32(fat + 4 * 4, 0x0FFFFFFF);
+    disk.put32(fat + 100 * 4, 0x0FFFFFFF);
+}
+
+// GPT with one ext4 partition of 128 MiB at 1 MiB
+constexpr std::uint64_t kExtPart = kMiB;
+constexpr std::uint64_t kExtPartBlocks = 32768;  // 4 KiB blocks
+
+void putExt4Disk(SparseDisk &disk, std::uint64_t bitmapBlock = 9)
+{
+    // Protective MBR and a GPT with one partition at 1 MiB
+    putMbrSignature(disk);
+    putMbrEntry(disk, 0, 0xEE, 1, 256 * kMiB / 512 - 1);
+    disk.write(512, "EFI PART", 8);
+    disk.put64(512 + 72, 2);      // PartitionEntryLBA
+    disk.put32(512 + 80, 4);      // NumberOfPartitionEntries
+    disk.put32(512 + 84, 128);    // SizeOfPartitionEntry
+    const unsigned char linuxData[16] = {0xAF, 0x3D, 0xC6, 0x0F, 0x83, 0x84, 0x72, 0x47,
+                                         0x8E, 0x79, 0x3D, 0x69, 0xD8, 0x47, 0x7D, 0xE4};
+    disk.write(1024, linuxData, sizeof(linuxData));
+    const std::uint64_t part = kExtPart;
+    const std::uint64_t partBlocks = kExtPartBlocks;
+    disk.put64(1024 + 32, part / 512);
+    disk.put64(1024 + 40, (part + partBlocks * kBlock) / 512 - 1);
+
+    // Two groups: the second has an uninitialised bitmap and a superblock backup
+    const std::uint64_t sb = part + 1024;
+    disk.put32(sb + 0x04, partBlocks);
+    disk.put32(sb + 0x14, 0);         // s_first_data_block
+    disk.put32(sb + 0x18, 2);         // 4 KiB blocks
+    disk.put32(sb + 0x20, 16384);     // s_blocks_per_group
+    disk.put32(sb + 0x28, 1024);      // s_inodes_per_group
+    disk.put16(sb + 0x38, 0xEF53);
+    disk.put32(sb + 0x4C, 1);         // s_rev_level
+    disk.put16(sb + 0x58, 256);       // s_inode_size
+    disk.put32(sb + 0x64, 0x1 | 0x400);  // sparse_super, metadata_csum
+    disk.put16(sb + 0xCE, 7);         // s_reserved_gdt_blocks
+
+    // Group descriptors in block 1, group metadata packed into group 0
+    const std::uint64_t gdt = part + kBlock;
+    disk.put32(gdt + 0x00, bitmapBlock);
+    disk.put32(gdt + 0x04, 10);
+    disk.put32(gdt + 0x08, 11);       // Inode table: 64 blocks
+    disk.put32(gdt + 32 + 0x00, 75);
+    disk.put32(gdt + 32 + 0x04, 76);
+    disk.put32(gdt + 32 + 0x08, 77);
+    disk.put16(gdt + 32 + 0x12, 0x2); // BLOCK_UNINIT
+
+    const std::uint64_t bitmap = part + bitmapBlock * kBlock;
+    for (std::uint64_t bit = 0; bit <= 140; bit++)
+        disk.setBit(bitmap, bit);
+    for (std::uint64_t bit = 1000; bit < 1010; bit++)
+        disk.setBit(bitmap, bit);
+}
+
+// Passes the disk to a StreamingBlockMapper in chunks of chunkSize bytes
+std::unique_ptr<fastboot::BlockMap> streamDisk(const SparseDisk &disk, size_t chunkSize)
+{
+    auto map = std::make_unique<fastboot::BlockMap>();
+    StreamingBlockMapper mapper(map.get(), disk.size());
+
+    // Blocks decided after each chunk must not change later
+    std::vector<std::pair<std::uint64_t, bool>> decided;
+    std::vector<char> chunk;
+    for (std::uint64_t pos = 0; pos < disk.size(); pos += chunk.size())
+    {
+        chunk.resize(static_cast<size_t>(std::min<std::uint64_t>(chunkSize, disk.size() - pos)));
+        disk.read(pos, chunk.data(), chunk.size());
+        mapper.addData(chunk.data(), chunk.size());
+
+        const std::uint64_t lastBlock = std::min(pos + chunk.size(), disk.size() - 1) / kBlock;
+        decided.emplace_back(lastBlock, map->isMapped(lastBlock));
+    }
+    const auto changed = std::count_if(decided.begin(), decided.end(), [&](const auto &block) {
+        return map->isMapped(block.first) != block.second;
+    });
+    CHECK(changed == 0);
+    return map;
+}
+
+std::vector<std::pair<std::uint64_t, std::uint64_t>> rangesOf(const fastboot::BlockMap &map)
+{
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;
+    for (const auto &range : map.ranges())
+        ranges.emplace_back(range.begin, range.end);
+    return ranges;
+}
+
+} // namespace
+
+TEST_CASE("Disks without a partition table are not mapped", "[usedblockscanner]") {
+    SparseDisk disk(16 * kMiB);
+    UsedBlockScanner scanner(disk.reader(), disk.size());
+    CHECK(scanner.scan() == nullptr);
+}
+
+TEST_CASE("Unknown partitions and gaps are mapped in full", "[usedblockscanner]") {
+    SparseDisk disk(16 * kMiB);
+    putMbrSignature(disk);
+    putMbrEntry(disk, 0, 0x83, 2048, 8192);  // Empty, no file system
+
+    UsedBlockScanner scanner(disk.reader(), disk.size());
+    auto map = scanner.scan();
+    REQUIRE(map);
+    CHECK(map->blockCount() == 16 * kMiB / kBlock);
+    CHECK(map->mappedBlockCount() == map->blockCount());
+    CHECK(map->ranges().size() == 1);
+    CHECK_FALSE(map->hasChecksums());
+}
+
+TEST_CASE("Partitions keep their numbers when sorted by start", "[usedblockscanner]") {
+    SparseDisk disk(16 * kMiB);
+    putMbrSignature(disk);
+    putMbrEntry(disk, 0, 0x83, 16384, 8192);
+    putMbrEntry(disk, 2, 0x0C, 2048, 8192);   // Slot 2 left empty
+
+    std::vector<UsedBlockScanner::Partition> partitions;
+    REQUIRE(UsedBlockScanner::readPartitions(disk.reader(), disk.size(), partitions));
+    REQUIRE(partitions.size() == 2);
+    CHECK(partitions[0].start == 2048 * 512);
+    CHECK(partitions[0].number == 3);
+    CHECK(partitions[1].start == 16384 * 512);
+    CHECK(partitions[1].number == 1);
+
+    SparseDisk gptDisk(256 * kMiB);
+    putExt4Disk(gptDisk);
+    partitions.clear();
+    REQUIRE(UsedBlockScanner::readPartitions(gptDisk.reader(), gptDisk.size(), partitions));
+    REQUIRE(partitions.size() == 1);
+    CHECK(partitions[0].start == kExtPart);
+    CHECK(partitions[0].number == 1);
+}
+
+TEST_CASE("Only allocated FAT32 clusters are mapped", "[usedblockscanner]") {
+    SparseDisk disk(512 * kMiB);
+    putFat32Disk(disk);
+    const std::uint32_t partSectors = kFatPartSectors;
+    const std::uint64_t part = kFatPart;
+    const std::uint32_t fatSectors = kFatSectors;
+
+    UsedBlockScanner scanner(disk.reader(), disk.size());
+    auto map = scanner.scan();
+    REQUIRE(map);
+
+    const std::uint64_t partBlock = part / kBlock;
+    const std::uint64_t dataBlock = (part + (38 + 2 * fatSectors) * 512) / kBlock;
+    auto cluster = [&](std::uint64_t n) { return dataBlock + n - 2; };
+
+    // Space before the partition, boot sector and FATs
+    CHECK(map->isMapped(0));
+    CHECK(map->isMapped(partBlock - 1));
+    CHECK(map->isMapped(partBlock));
+    CHECK(map->isMapped(dataBlock - 1));
+
+    CHECK(map->isMapped(cluster(2)));
+    CHECK(map->isMapped(cluster(4)));
+    CHECK_FALSE(map->isMapped(cluster(5)));
+    CHECK_FALSE(map->isMapped(cluster(99)));
+    CHECK(map->isMapped(cluster(100)));
+    CHECK_FALSE(map->isMapped(cluster(101)));
+
+    // Space after the partition
+    const std::uint64_t partEndBlock = (part + std::uint64_t(partSectors) * 512) / kBlock;
+    CHECK_FALSE(map->isMapped(partEndBlock - 1));
+    CHECK(map->isMapped(partEndBlock));
+    CHECK(map->isMapped(map->blockCount() - 1));
+}
+
+TEST_CASE("Only allocated ext4 blocks are mapped", "[usedblockscanner]") {
+    SparseDisk disk(256 * kMiB);
+    putExt4Disk(disk);
+    const std::uint64_t part = kExtPart;
+    const std::uint64_t partBlocks = kExtPartBlocks;
+
+    UsedBlockScanner scanner(disk.reader(), disk.size());
+    auto map = scanner.scan();
+    REQUIRE(map);
+
+    const std::uint64_t partBlock = part / kBlock;
+    CHECK(map->isMapped(partBlock - 1));
+    CHECK(map->isMapped(partBlock));
+    CHECK(map->isMapped(partBlock + 140));
+    CHECK_FALSE(map->isMapped(partBlock + 141));
+    CHECK_FALSE(map->isMapped(partBlock + 999));
+    CHECK(map->isMapped(partBlock + 1000));
+    CHECK(map->isMapped(partBlock + 1009));
+    CHECK_FALSE(map->isMapped(partBlock + 1010));
+
+    // Group 1: superblock backup, descriptors and reserved descriptor blocks only
+    CHECK(map->isMapped(partBlock + 16384));
+    CHECK(map->isMapped(partBlock + 16384 + 8));
+    CHECK_FALSE(map->isMapped(partBlock + 16384 + 9));
+    CHECK_FALSE(map->isMapped(partBlock + 20000));
+
+    // Backup GPT after the partition
+    CHECK(map->isMapped(partBlock + partBlocks));
+    CHECK(map->isMapped(map->blockCount() - 1));
+}
+
+TEST_CASE("Range checksums can be added to a built map", "[usedblockscanner]") {
+    SparseDisk disk(16 * kMiB);
+    putMbrSignature(disk);
+    putMbrEntry(disk, 0, 0x83, 2048, 8192);
+
+    UsedBlockScanner scanner(disk.reader(), disk.size());
+    auto map = scanner.scan();
+    REQUIRE(map);
+    REQUIRE_FALSE(map->ranges().empty());
+
+    std::array<std::uint8_t, 32> sha256{};
+    sha256[0] = 0x42;
+    map->setChecksum(0, sha256);
+    CHECK(map->hasChecksums());
+    CHECK(map->ranges()[0].hasSha256);
+    CHECK(map->ranges()[0].sha256 == sha256);
+}
+
+TEST_CASE("Streamed FAT32 images map the same blocks as a scan", "[usedblockscanner]") {
+    SparseDisk disk(512 * kMiB);
+    putFat32Disk(disk);
+
+    UsedBlockScanner scanner(disk.reader(), disk.size());
+    auto scanned = scanner.scan();
+    REQUIRE(scanned);
+
+    for (size_t chunkSize : {size_t(1000), size_t(4 * kMiB)})
+    {
+        auto streamed = streamDisk(disk, chunkSize);
+        CHECK(streamed->blockCount() == scanned->blockCount());
+        CHECK(rangesOf(*streamed) == rangesOf(*scanned));
+    }
+}
+
+TEST_CASE("Streamed ext4 images map the same blocks as a scan", "[usedblockscanner]") {
+    SparseDisk disk(256 * kMiB);
+    putExt4Disk(disk);
+
+    UsedBlockScanner scanner(disk.reader(), disk.size());
+    auto scanned = scanner.scan();
+    REQUIRE(scanned);
+
+    for (size_t chunkSize : {size_t(1000), size_t(4 * kMiB)})
+    {
+        auto streamed = streamDisk(disk, chunkSize);
+        CHECK(rangesOf(*streamed) == rangesOf(*scanned));
+    }
+}
+
+TEST_CASE("Streamed blocks described by later metadata stay mapped", "[usedblockscanner]") {
+    // The bitmap of group 0 is in group 1, after the blocks it describes
+    SparseDisk disk(256 * kMiB);
+    putExt4Disk(disk, 16384 + 100);
+    const std::uint64_t partBlock = kExtPart / kBlock;
+
+    UsedBlockScanner scanner(disk.reader(), disk.size());
+    auto scanned = scanner.scan();
+    REQUIRE(scanned);
+    CHECK_FALSE(scanned->isMapped(partBlock + 500));
+
+    auto streamed = streamDisk(disk, 64 * 1024);
+    CHECK(streamed->isMapped(partBlock + 500));
+    CHECK(streamed->isMapped(partBlock + 16384 + 100));
+    CHECK_FALSE(streamed->isMapped(partBlock + 20000));
+}
+
+TEST_CASE("Streamed images without a partition table are mapped in full", "[usedblockscanner]") {
+    SparseDisk disk(16 * kMiB);
+    auto streamed = streamDisk(disk, 64 * 1024);
+    CHECK(streamed->mappedBlockCount() == streamed->blockCount());
+    CHECK(streamed->ranges().size() == 1);
+}
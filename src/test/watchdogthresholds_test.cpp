@@ -0,0 +1,51 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the latency-scaled write watchdog thresholds
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "watchdogthresholds.h"
+#include "timeout_utils.h"
+
+using namespace rpi_imager::TimeoutDefaults;
+
+TEST_CASE("Defaults match the timeout constants", "[watchdogthresholds]") {
+    const auto t = WatchdogThresholds::defaults();
+    CHECK(t.reduceDepthMs == kWatchdogReduceDepthThresholdMs);
+    CHECK(t.drainMs == kWatchdogReduceDepthThresholdMs * 2);
+    CHECK(t.restartMs == kWatchdogRestartThresholdMs);
+    CHECK(t.timeoutMs == kWatchdogAsyncTimeoutMs);
+    CHECK(t.syncTimeoutMs == kWatchdogStallTimeoutMs);
+    CHECK(t.scalePercent == 100);
+}
+
+TEST_CASE("Too few completions keep the defaults", "[watchdogthresholds]") {
+    const auto t = WatchdogThresholds::forTailLatency(20'000'000, WatchdogThresholds::MinSamples - 1);
+    CHECK(t.scalePercent == 100);
+    CHECK(t.reduceDepthMs == kWatchdogReduceDepthThresholdMs);
+}
+
+TEST_CASE("A fast card never gets shorter thresholds", "[watchdogthresholds]") {
+    const auto t = WatchdogThresholds::forTailLatency(50'000, 100'000);
+    CHECK(t.scalePercent == 100);
+    CHECK(t.reduceDepthMs == kWatchdogReduceDepthThresholdMs);
+    CHECK(t.timeoutMs == kWatchdogAsyncTimeoutMs);
+}
+
+TEST_CASE("Long garbage collection pauses stretch every threshold", "[watchdogthresholds]") {
+    // 10 s pauses: a stall has to last 40 s before it counts
+    const auto t = WatchdogThresholds::forTailLatency(10'000'000, 100'000);
+    CHECK(t.scalePercent == 133);
+    CHECK(t.reduceDepthMs == kWatchdogReduceDepthThresholdMs * 133 / 100);
+    CHECK(t.drainMs == t.reduceDepthMs * 2);
+    CHECK(t.restartMs > t.drainMs);
+    CHECK(t.timeoutMs > t.restartMs);
+}
+
+TEST_CASE("Scaling is capped", "[watchdogthresholds]") {
+    const auto t = WatchdogThresholds::forTailLatency(120'000'000, 100'000);
+    CHECK(t.scalePercent == kWatchdogMaxScalePercent);
+    CHECK(t.timeoutMs == kWatchdogAsyncTimeoutMs * kWatchdogMaxScalePercent / 100);
+}
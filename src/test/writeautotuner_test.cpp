@@ -0,0 +1,200 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for WriteAutoTuner against simulated devices
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "writeautotuner.h"
+
+#include <functional>
+
+namespace {
+
+constexpr size_t MB = 1024 * 1024;
+constexpr size_t BufferSize = 8 * MB;
+
+// Feeds the tuner as a writer that is always blocked on a device whose
+// throughput (bytes per second) depends on the current setting
+struct SimulatedWrite
+{
+    WriteAutoTuner &tuner;
+    std::function<uint64_t(const WriteAutoTuner::Setting &)> deviceBps;
+    uint64_t completed = 0;
+    int64_t nowUs = 0;
+    int persisted = 0;
+    int reductions = 0;
+
+    WriteAutoTuner::Decision step(uint64_t extraLatencyUs = 0, uint64_t idleUs = 0)
+    {
+        const uint64_t latencyUs = BufferSize * 1000000 / deviceBps(tuner.setting()) + extraLatencyUs;
+        nowUs += static_cast<int64_t>(latencyUs + idleUs);
+        completed += BufferSize;
+        auto decision = tuner.onWrite(completed, latencyUs, nowUs / 1000);
+        if (decision.persist) persisted++;
+        if (decision.reduceDepth) reductions++;
+        return decision;
+    }
+
+    void runUntilSettled(int maxSteps = 10000)
+    {
+        for (int i = 0; i < maxSteps && tuner.isProbing(); ++i)
+            step();
+    }
+};
+
+} // namespace
+
+TEST_CASE("Tuner settles on the fastest queue depth", "[writeautotuner]") {
+    WriteAutoTuner tuner;
+    tuner.begin(16, BufferSize, 0);
+    REQUIRE(tuner.isProbing());
+    CHECK(tuner.setting().queueDepth == 16);
+    CHECK(tuner.setting().blockSize == 0);
+
+    SimulatedWrite sim{tuner, [](const WriteAutoTuner::Setting &s) -> uint64_t {
+        return (s.queueDepth == 8 ? 30 : (s.queueDepth == 4 ? 24 : 20)) * MB;
+    }};
+    sim.runUntilSettled();
+
+    REQUIRE(tuner.state() == WriteAutoTuner::State::Settled);
+    CHECK(tuner.setting().queueDepth == 8);
+    CHECK(tuner.setting().blockSize == 0);  // Smaller writes were no faster
+    CHECK(sim.persisted == 1);
+
+    // Three depths, then two write sizes at depth 8
+    REQUIRE(tuner.probes().size() == 5);
+    CHECK(tuner.probes()[3].setting.queueDepth == 8);
+    CHECK(tuner.probes()[3].setting.blockSize == BufferSize / 2);
+    CHECK(tuner.probes()[4].setting.blockSize == BufferSize / 4);
+    CHECK(tuner.best().throughputBps > 29 * MB);
+}
+
+TEST_CASE("Tuner picks a smaller write size when it is faster", "[writeautotuner]") {
+    WriteAutoTuner tuner;
+    tuner.begin(8, BufferSize, 0);
+
+    SimulatedWrite sim{tuner, [](const WriteAutoTuner::Setting &s) -> uint64_t {
+        return (s.blockSize == 2 * MB ? 40 : 20) * MB;
+    }};
+    sim.runUntilSettled();
+
+    CHECK(tuner.setting().queueDepth == 8);
+    CHECK(tuner.setting().blockSize == 2 * MB);
+}
+
+TEST_CASE("Tuner keeps defaults on a flat device", "[writeautotuner]") {
+    WriteAutoTuner tuner;
+    tuner.begin(16, BufferSize, 0);
+
+    // Within the hysteresis margin everywhere
+    SimulatedWrite sim{tuner, [](const WriteAutoTuner::Setting &s) -> uint64_t {
+        return s.queueDepth == 4 ? 20 * MB + MB / 2 : 20 * MB;
+    }};
+    sim.runUntilSettled();
+
+    CHECK(tuner.setting().queueDepth == 16);
+    CHECK(tuner.setting().blockSize == 0);
+}
+
+TEST_CASE("Tuner does not learn when the source is the bottleneck", "[writeautotuner]") {
+    WriteAutoTuner tuner;
+    tuner.begin(16, BufferSize, 0);
+
+    SimulatedWrite sim{tuner, [](const WriteAutoTuner::Setting &) -> uint64_t { return 200 * MB; }};
+    // Writes are quick but data only arrives every 200ms
+    for (int i = 0; i < 1000 && tuner.isProbing(); ++i)
+        sim.step(0, 200000);
+
+    CHECK(tuner.state() == WriteAutoTuner::State::Settled);
+    CHECK(tuner.setting().queueDepth == 16);
+    REQUIRE(tuner.probes().size() == 1);
+    CHECK_FALSE(tuner.probes()[0].writerBound);
+    CHECK(sim.persisted == 0);
+}
+
+TEST_CASE("Synchronous writes only tune the write size", "[writeautotuner]") {
+    WriteAutoTuner tuner;
+    tuner.begin(1, BufferSize, 0);
+    CHECK(tuner.setting().queueDepth == 1);
+
+    SimulatedWrite sim{tuner, [](const WriteAutoTuner::Setting &) -> uint64_t { return 20 * MB; }};
+    sim.runUntilSettled();
+
+    REQUIRE(tuner.probes().size() == 3);
+    for (const auto &probe : tuner.probes())
+        CHECK(probe.setting.queueDepth == 1);
+}
+
+TEST_CASE("Watchdog reduction ends probing and caps the depth", "[writeautotuner]") {
+    WriteAutoTuner tuner;
+    tuner.begin(32, BufferSize, 0);
+
+    SimulatedWrite sim{tuner, [](const WriteAutoTuner::Setting &) -> uint64_t { return 20 * MB; }};
+    for (int i = 0; i < 5; ++i)
+        sim.step();
+    REQUIRE(tuner.isProbing());
+
+    tuner.capQueueDepth(12);
+    auto decision = sim.step();
+    CHECK(decision.apply);
+    CHECK(decision.persist);
+    CHECK(tuner.state() == WriteAutoTuner::State::Settled);
+    CHECK(tuner.setting().queueDepth == 12);
+
+    // A later, higher cap is ignored
+    tuner.capQueueDepth(24);
+    decision = sim.step();
+    CHECK_FALSE(decision.apply);
+    CHECK(tuner.setting().queueDepth == 12);
+
+    // Once the device has recovered, the watchdog lifts it again
+    tuner.restoreQueueDepth(24);
+    decision = sim.step();
+    CHECK(decision.apply);
+    CHECK_FALSE(decision.reduceDepth);
+    CHECK(tuner.setting().queueDepth == 24);
+    decision = sim.step();
+    CHECK_FALSE(decision.apply);
+
+    // And can cap it again
+    tuner.capQueueDepth(12);
+    decision = sim.step();
+    CHECK(decision.reduceDepth);
+    CHECK(tuner.setting().queueDepth == 12);
+}
+
+TEST_CASE("Latency spikes after settling halve the depth", "[writeautotuner]") {
+    WriteAutoTuner tuner;
+    tuner.beginLearned({16, 0}, 16, BufferSize, 0);
+    REQUIRE(tuner.state() == WriteAutoTuner::State::Settled);
+
+    SimulatedWrite sim{tuner, [](const WriteAutoTuner::Setting &) -> uint64_t { return 40 * MB; }};
+    for (int i = 0; i < 20; ++i)
+        sim.step();
+
+    auto decision = sim.step(3 * 1000 * 1000);  // A 3s stall, e.g. card garbage collection
+    CHECK(decision.reduceDepth);
+    CHECK(decision.persist);
+    CHECK(tuner.setting().queueDepth == 8);
+
+    // Within the cooldown a second spike is tolerated
+    decision = sim.step(3 * 1000 * 1000);
+    CHECK_FALSE(decision.apply);
+    CHECK(tuner.setting().queueDepth == 8);
+}
+
+TEST_CASE("Learned settings are clamped to the device", "[writeautotuner]") {
+    WriteAutoTuner tuner;
+    tuner.beginLearned({64, 3 * MB + 100}, 16, BufferSize, 0);
+    CHECK(tuner.setting().queueDepth == 16);
+    CHECK(tuner.setting().blockSize == 3 * MB);
+
+    tuner.beginLearned({1, 64 * 1024}, 16, BufferSize, 0);
+    CHECK(tuner.setting().queueDepth == WriteAutoTuner::MinQueueDepth);
+    CHECK(tuner.setting().blockSize == 0);  // Below MinBlockSize
+
+    tuner.beginLearned({8, BufferSize}, 16, BufferSize, 0);
+    CHECK(tuner.setting().blockSize == 0);  // Whole buffers
+}
@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for WriteJournal range tracking and persistence
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "writejournal.h"
+#include <QSettings>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr std::uint64_t kRange = WriteJournal::kRangeSize;
+const QString kGroup = QStringLiteral("writejournal/test_device");
+
+// Incompressible, so it also stands in for a first block too large to keep
+std::vector<char> imageData(std::uint64_t size)
+{
+    std::vector<char> data(static_cast<size_t>(size));
+    std::uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (auto &c : data)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        c = static_cast<char>(x >> 56);
+    }
+    return data;
+}
+
+} // namespace
+
+TEST_CASE("Ranges are checksummed in stream order", "[writejournal]") {
+    const auto data = imageData(2 * kRange + 4096);
+
+    WriteJournal journal;
+    journal.start("imagehash", "device");
+    // Feed in pieces that do not line up with the ranges
+    constexpr size_t piece = 3 * 1024 * 1024 + 512;
+    for (size_t pos = 0; pos < data.size(); pos += piece)
+        journal.addData(data.data() + pos, std::min(piece, data.size() - pos));
+
+    REQUIRE(journal.rangeCount() == 2);
+    CHECK(journal.rangeChecksum(0) == WriteJournal::checksum(data.data(), kRange));
+    CHECK(journal.rangeChecksum(1) == WriteJournal::checksum(data.data() + kRange, kRange));
+}
+
+TEST_CASE("Only durable ranges are saved", "[writejournal]") {
+    QTemporaryDir dir;
+    QSettings settings(dir.filePath("journal.ini"), QSettings::IniFormat);
+    const auto data = imageData(2 * kRange);
+
+    WriteJournal journal;
+    journal.start("imagehash", "device");
+    journal.addData(data.data(), data.size());
+
+    CHECK_FALSE(journal.hasUnsavedRanges(kRange - 1));
+    CHECK(journal.hasUnsavedRanges(kRange + 4096));
+    journal.save(settings, kGroup, kRange + 4096);
+    CHECK_FALSE(journal.hasUnsavedRanges(kRange + 4096));
+
+    WriteJournal loaded;
+    REQUIRE(loaded.load(settings, kGroup));
+    CHECK(loaded.matches("imagehash", "device"));
+    CHECK_FALSE(loaded.matches("otherimage", "device"));
+    CHECK_FALSE(loaded.matches("imagehash", "otherdevice"));
+    CHECK(loaded.matchesImage("imagehash"));
+    CHECK_FALSE(loaded.matchesImage("otherimage"));
+    REQUIRE(loaded.rangeCount() == 1);
+    CHECK(loaded.rangeChecksum(0) == journal.rangeChecksum(0));
+
+    journal.save(settings, kGroup, 2 * kRange);
+    REQUIRE(loaded.load(settings, kGroup));
+    CHECK(loaded.rangeCount() == 2);
+}
+
+TEST_CASE("First block is kept with the journal", "[writejournal]") {
+    QTemporaryDir dir;
+    QSettings settings(dir.filePath("journal.ini"), QSettings::IniFormat);
+    const auto data = imageData(kRange);
+
+    WriteJournal journal;
+    journal.start("imagehash", "device");
+    std::vector<char> firstBlock(4 * 1024 * 1024, 0);
+    firstBlock[510] = 0x55;
+    firstBlock[511] = static_cast<char>(0xaa);
+    REQUIRE(journal.setFirstBlock(firstBlock.data(), firstBlock.size()));
+    journal.addData(data.data(), data.size());
+    journal.save(settings, kGroup, kRange);
+
+    WriteJournal loaded;
+    REQUIRE(loaded.load(settings, kGroup));
+    CHECK(loaded.firstBlock() == QByteArray(firstBlock.data(), static_cast<qsizetype>(firstBlock.size())));
+
+    // Incompressible first blocks are not worth storing
+    const auto noise = imageData(4 * 1024 * 1024);
+    CHECK_FALSE(journal.setFirstBlock(noise.data(), noise.size()));
+    CHECK(journal.firstBlock().isEmpty());
+}
+
+TEST_CASE("Removed or inconsistent journals do not load", "[writejournal]") {
+    QTemporaryDir dir;
+    QSettings settings(dir.filePath("journal.ini"), QSettings::IniFormat);
+    const auto data = imageData(kRange);
+
+    WriteJournal journal;
+    journal.start("imagehash", "device");
+    journal.addData(data.data(), data.size());
+    journal.save(settings, kGroup, kRange);
+
+    settings.setValue(kGroup + "/synced", static_cast<quint64>(2 * kRange));
+    WriteJournal loaded;
+    CHECK_FALSE(loaded.load(settings, kGroup));
+
+    WriteJournal::remove(settings, kGroup);
+    CHECK_FALSE(loaded.load(settings, kGroup));
+}
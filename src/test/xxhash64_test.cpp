@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ *
+ * Tests for the XXH64 comparison hash
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "xxhash64.h"
+
+#include <cstring>
+#include <vector>
+
+TEST_CASE("XXH64 matches the reference values", "[xxhash64]") {
+    CHECK(xxhash64("", 0) == 0xEF46DB3751D8E999ULL);
+    CHECK(xxhash64("a", 1) == 0xD24EC4F1A98C6E5BULL);
+    CHECK(xxhash64("abc", 3) == 0x44BC2CF5AD770999ULL);
+    const char *text = "Nobody inspects the spammish repetition";
+    CHECK(xxhash64(text, std::strlen(text)) == 0xFBCEA83C8A378BF1ULL);
+}
+
+TEST_CASE("XXH64 depends on every byte, the length and the seed", "[xxhash64]") {
+    std::vector<unsigned char> data(4096 + 7);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<unsigned char>(i * 131 + 7);
+    const uint64_t base = xxhash64(data.data(), data.size());
+
+    // A flipped bit in the 32-byte stripes, the 8- and 4-byte tail and the last bytes
+    for (size_t at : {size_t(0), size_t(2047), size_t(4095), size_t(4099), size_t(4102)})
+    {
+        data[at] ^= 0x10;
+        CHECK(xxhash64(data.data(), data.size()) != base);
+        data[at] ^= 0x10;
+    }
+    CHECK(xxhash64(data.data(), data.size()) == base);
+    CHECK(xxhash64(data.data(), data.size() - 1) != base);
+    CHECK(xxhash64(data.data(), data.size(), 1) != base);
+
+    // Unaligned input hashes the same as aligned
+    std::vector<unsigned char> shifted(data.size() + 1);
+    std::memcpy(shifted.data() + 1, data.data(), data.size());
+    CHECK(xxhash64(shifted.data() + 1, data.size()) == base);
+}
@@ -0,0 +1,247 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "threadcputime.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <time.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadCpuTime::Scope *> live;
+    // Finished Scopes and Tasks
+    std::array<std::atomic<int64_t>, ThreadCpuTime::StageCount> cpuUs{};
+    std::array<std::atomic<int64_t>, ThreadCpuTime::StageCount> activeUs{};
+};
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+thread_local ThreadCpuTime::Scope *t_current = nullptr;
+
+int64_t wallNowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if defined(_WIN32)
+int64_t fileTimeUs(const FILETIME &time)
+{
+    ULARGE_INTEGER value;
+    value.LowPart = time.dwLowDateTime;
+    value.HighPart = time.dwHighDateTime;
+    return static_cast<int64_t>(value.QuadPart / 10);  // 100 ns units
+}
+
+int64_t threadTimesUs(HANDLE thread)
+{
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(thread, &creation, &exit, &kernel, &user))
+        return -1;
+    return fileTimeUs(kernel) + fileTimeUs(user);
+}
+#endif
+
+// A handle other threads can read the calling thread's CPU time through
+uintptr_t openThread()
+{
+#if defined(_WIN32)
+    return reinterpret_cast<uintptr_t>(OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId()));
+#elif defined(__APPLE__)
+    return static_cast<uintptr_t>(mach_thread_self());
+#else
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock) != 0)
+        return 0;
+    return static_cast<uintptr_t>(clock);
+#endif
+}
+
+void closeThread(uintptr_t thread)
+{
+#if defined(_WIN32)
+    if (thread)
+        CloseHandle(reinterpret_cast<HANDLE>(thread));
+#elif defined(__APPLE__)
+    mach_port_deallocate(mach_task_self(), static_cast<mach_port_t>(thread));
+#else
+    (void)thread;
+#endif
+}
+
+int64_t readThread(uintptr_t thread)
+{
+#if defined(_WIN32)
+    return thread ? threadTimesUs(reinterpret_cast<HANDLE>(thread)) : -1;
+#elif defined(__APPLE__)
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    if (thread_info(static_cast<mach_port_t>(thread), THREAD_BASIC_INFO,
+                    reinterpret_cast<thread_info_t>(&info), &count) != KERN_SUCCESS)
+        return -1;
+    return static_cast<int64_t>(info.user_time.seconds + info.system_time.seconds) * 1000000
+         + info.user_time.microseconds + info.system_time.microseconds;
+#else
+    if (!thread)
+        return -1;
+    timespec ts;
+    if (clock_gettime(static_cast<clockid_t>(thread), &ts) != 0)
+        return -1;
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+} // namespace
+
+int64_t ThreadCpuTime::currentThreadUs()
+{
+#if defined(_WIN32)
+    return threadTimesUs(GetCurrentThread());
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return -1;
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+const char *ThreadCpuTime::stageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::Download:   return "download";
+    case Stage::Decompress: return "decompress";
+    case Stage::Write:      return "write";
+    case Stage::Hash:       return "hash";
+    case Stage::CacheWrite: return "cacheWrite";
+    case Stage::Verify:     return "verify";
+    default:                return "unknown";
+    }
+}
+
+ThreadCpuTime::Scope::Scope(Stage stage)
+    : _stage(stage), _outer(t_current), _thread(openThread())
+{
+    const int64_t cpu = currentThreadUs();
+    const int64_t wall = wallNowUs();
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (_outer)
+        _outer->_close(cpu, wall);
+    _open(cpu, wall);
+    r.live.push_back(this);
+    t_current = this;
+}
+
+ThreadCpuTime::Scope::~Scope()
+{
+    const int64_t cpu = currentThreadUs();
+    const int64_t wall = wallNowUs();
+    Registry &r = registry();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        _close(cpu, wall);
+        r.cpuUs[static_cast<size_t>(_stage)].fetch_add(_cpuUs, std::memory_order_relaxed);
+        r.activeUs[static_cast<size_t>(_stage)].fetch_add(_activeUs, std::memory_order_relaxed);
+        r.live.erase(std::remove(r.live.begin(), r.live.end(), this), r.live.end());
+        if (_outer)
+            _outer->_open(cpu, wall);
+    }
+    t_current = _outer;
+    closeThread(_thread);
+}
+
+void ThreadCpuTime::Scope::_open(int64_t cpuUs, int64_t wallUs)
+{
+    // Stays paused where the CPU clock cannot be read
+    _segmentCpuUs = cpuUs;
+    _segmentWallUs = wallUs;
+}
+
+void ThreadCpuTime::Scope::_close(int64_t cpuUs, int64_t wallUs)
+{
+    if (_segmentCpuUs < 0 || cpuUs < 0)
+        return;
+    _cpuUs += std::max<int64_t>(0, cpuUs - _segmentCpuUs);
+    _activeUs += std::max<int64_t>(0, wallUs - _segmentWallUs);
+    _segmentCpuUs = -1;
+}
+
+int64_t ThreadCpuTime::Scope::_threadCpuUs() const
+{
+    return readThread(_thread);
+}
+
+ThreadCpuTime::Task::Task(Stage stage)
+    : _stage(stage), _cpuUs(currentThreadUs()), _wallUs(wallNowUs())
+{
+}
+
+ThreadCpuTime::Task::~Task()
+{
+    if (_cpuUs < 0)
+        return;
+    const int64_t cpu = currentThreadUs();
+    Registry &r = registry();
+    r.cpuUs[static_cast<size_t>(_stage)].fetch_add(std::max<int64_t>(0, cpu - _cpuUs), std::memory_order_relaxed);
+    r.activeUs[static_cast<size_t>(_stage)].fetch_add(std::max<int64_t>(0, wallNowUs() - _wallUs), std::memory_order_relaxed);
+}
+
+ThreadCpuTime::Sample ThreadCpuTime::sample()
+{
+    Sample sample;
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (size_t i = 0; i < StageCount; ++i)
+    {
+        sample[i].cpuUs = r.cpuUs[i].load(std::memory_order_relaxed);
+        sample[i].activeUs = r.activeUs[i].load(std::memory_order_relaxed);
+    }
+
+    const int64_t wall = wallNowUs();
+    for (const Scope *scope : r.live)
+    {
+        StageTime &time = sample[static_cast<size_t>(scope->_stage)];
+        time.cpuUs += scope->_cpuUs;
+        time.activeUs += scope->_activeUs;
+        if (scope->_segmentCpuUs < 0)
+            continue;
+        const int64_t cpu = scope->_threadCpuUs();
+        if (cpu < 0)
+            continue;
+        time.cpuUs += std::max<int64_t>(0, cpu - scope->_segmentCpuUs);
+        time.activeUs += std::max<int64_t>(0, wall - scope->_segmentWallUs);
+    }
+    return sample;
+}
+
+ThreadCpuTime::Sample ThreadCpuTime::difference(const Sample &later, const Sample &earlier)
+{
+    Sample added;
+    for (size_t i = 0; i < StageCount; ++i)
+    {
+        added[i].cpuUs = std::max<int64_t>(0, later[i].cpuUs - earlier[i].cpuUs);
+        added[i].activeUs = std::max<int64_t>(0, later[i].activeUs - earlier[i].activeUs);
+    }
+    return added;
+}
@@ -0,0 +1,119 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef THREADCPUTIME_H
+#define THREADCPUTIME_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief CPU time of the pipeline threads, by stage
+ *
+ * The pipeline's timing events are wall-clock: a decoder that took 40 s
+ * may have been busy for all of it or waiting on the network for most.
+ * Each pipeline thread holds a Scope for its stage while it runs, and
+ * sample() reads the CPU time (user and system) of every live thread from
+ * another thread - pthread_getcpuclockid() on Linux, thread_info() on
+ * macOS, GetThreadTimes() on Windows - and adds the threads that have
+ * finished. Work run on a thread pool or dispatch queue is counted per
+ * task with a Task instead.
+ *
+ * A stage's CPU time over the time its threads were alive is how busy they
+ * were: near 100% per thread is CPU bound and worth more threads, far
+ * below is blocked on something else. Over the wall time of the write it
+ * is the number of cores the stage used.
+ *
+ * The totals are for the whole process; DownloadThread reports what a
+ * write added by sampling before and after.
+ */
+class ThreadCpuTime
+{
+public:
+    enum class Stage {
+        Download,    // curl, or reading a local image
+        Decompress,  // Native decoders and their worker pools
+        Write,       // Extract thread: libarchive, writes and their completions
+        Hash,        // HashPipeline and tree hashing
+        CacheWrite,  // AsyncCacheWriter
+        Verify,      // Read back and hash, pipelined or after the write
+        Count
+    };
+    static constexpr size_t StageCount = static_cast<size_t>(Stage::Count);
+
+    struct StageTime {
+        int64_t cpuUs = 0;     // User and system time of the stage's threads
+        int64_t activeUs = 0;  // Wall time the stage's threads ran, summed over threads
+    };
+    using Sample = std::array<StageTime, StageCount>;
+
+    /**
+     * @brief Counts the calling thread towards a stage while in scope
+     *
+     * Scopes nest: an inner one (the verify run on the write thread)
+     * pauses the outer one until it ends.
+     */
+    class Scope
+    {
+    public:
+        explicit Scope(Stage stage);
+        ~Scope();
+
+    private:
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        friend class ThreadCpuTime;
+        void _open(int64_t cpuUs, int64_t wallUs);
+        void _close(int64_t cpuUs, int64_t wallUs);
+        int64_t _threadCpuUs() const;  // From any thread
+
+        Stage _stage;
+        Scope *_outer;
+        int64_t _cpuUs = 0;           // Of closed segments
+        int64_t _activeUs = 0;
+        int64_t _segmentCpuUs = -1;   // At the start of the open segment, -1 while paused
+        int64_t _segmentWallUs = 0;
+        uintptr_t _thread = 0;        // Platform handle for reading the CPU clock
+    };
+
+    /**
+     * @brief Counts one task on a thread without a Scope (pool or dispatch queue)
+     */
+    class Task
+    {
+    public:
+        explicit Task(Stage stage);
+        ~Task();
+
+    private:
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        Stage _stage;
+        int64_t _cpuUs;
+        int64_t _wallUs;
+    };
+
+    /**
+     * @brief CPU time by stage so far, of finished threads and tasks and live Scopes
+     */
+    static Sample sample();
+
+    /**
+     * @brief What later added to earlier
+     */
+    static Sample difference(const Sample &later, const Sample &earlier);
+
+    /**
+     * @brief CPU time of the calling thread, -1 where it cannot be read
+     */
+    static int64_t currentThreadUs();
+
+    static const char *stageName(Stage stage);
+};
+
+#endif // THREADCPUTIME_H
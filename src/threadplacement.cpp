@@ -0,0 +1,197 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "threadplacement.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+    // From linux/ioprio.h, which not every libc exposes
+    constexpr int IOPRIO_CLASS_SHIFT = 13;
+    constexpr int IOPRIO_CLASS_BE = 2;
+    constexpr int IOPRIO_CLASS_IDLE = 3;
+    constexpr int IOPRIO_WHO_PROCESS = 1;
+
+    constexpr int BACKGROUND_NICE = 10;
+
+    int readSysfsInt(const QString &path)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return -1;
+        bool ok = false;
+        const int value = file.readAll().trimmed().toInt(&ok);
+        return ok ? value : -1;
+    }
+
+    QList<int> hostCapacities()
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            return {};
+
+        QList<int> capacities;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed))
+                continue;
+            const QString base = QStringLiteral("/sys/devices/system/cpu/cpu%1/").arg(cpu);
+            // cpu_capacity is what the scheduler itself uses on arm; the
+            // maximum frequency is the next best thing elsewhere
+            int capacity = readSysfsInt(base + QStringLiteral("cpu_capacity"));
+            if (capacity <= 0)
+                capacity = readSysfsInt(base + QStringLiteral("cpufreq/cpuinfo_max_freq"));
+            if (capacity <= 0)
+                capacity = 1;
+            capacities.resize(cpu + 1, 0);
+            capacities[cpu] = capacity;
+        }
+        return capacities;
+    }
+
+    void setIoPriority(int ioClass, int level)
+    {
+        // who 0 is the calling thread, not the whole process
+        const int value = (ioClass << IOPRIO_CLASS_SHIFT) | level;
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, value) != 0)
+            qDebug() << "ThreadPlacement: ioprio_set failed:" << strerror(errno);
+    }
+
+    void pinTo(int cpu)
+    {
+        if (cpu < 0)
+            return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        const int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (ret != 0)
+            qDebug() << "ThreadPlacement: could not pin to cpu" << cpu << ":" << strerror(ret);
+    }
+
+    QString cpuRange(const QList<int> &cpus)
+    {
+        QStringList parts;
+        for (qsizetype i = 0; i < cpus.size();) {
+            qsizetype j = i;
+            while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+                ++j;
+            parts.append(i == j ? QString::number(cpus[i])
+                                : QStringLiteral("%1-%2").arg(cpus[i]).arg(cpus[j]));
+            i = j + 1;
+        }
+        return parts.join(QLatin1Char(','));
+    }
+#endif
+
+} // namespace
+
+ThreadPlacement::Plan ThreadPlacement::planFor(const QList<int> &capacities)
+{
+    Plan plan;
+    int highest = 0;
+    int lowest = 0;
+    for (int capacity : capacities) {
+        if (capacity <= 0)
+            continue;
+        highest = std::max(highest, capacity);
+        lowest = lowest == 0 ? capacity : std::min(lowest, capacity);
+    }
+    if (highest == lowest)
+        return plan;
+
+    for (int cpu = 0; cpu < capacities.size(); ++cpu) {
+        if (capacities[cpu] == highest)
+            plan.bigCores.append(cpu);
+    }
+    plan.decompressCpu = plan.bigCores.first();
+    // With a single big core the hasher is better off anywhere than sharing it
+    if (plan.bigCores.size() >= 2)
+        plan.hashCpu = plan.bigCores.at(1);
+    return plan;
+}
+
+const ThreadPlacement::Plan &ThreadPlacement::hostPlan()
+{
+#ifdef Q_OS_LINUX
+    static const Plan plan = planFor(hostCapacities());
+#else
+    static const Plan plan;
+#endif
+    return plan;
+}
+
+void ThreadPlacement::apply(Role role)
+{
+#ifdef Q_OS_LINUX
+    switch (role) {
+    case Role::Decompress:
+        pinTo(hostPlan().decompressCpu);
+        break;
+    case Role::Hash:
+        pinTo(hostPlan().hashCpu);
+        break;
+    case Role::DeviceIo:
+        setIoPriority(IOPRIO_CLASS_BE, 0);
+        break;
+    case Role::CacheWrite:
+        setIoPriority(IOPRIO_CLASS_BE, 7);
+        break;
+    case Role::Background:
+        // A thread id with PRIO_PROCESS renices just that thread on Linux
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), BACKGROUND_NICE) != 0)
+            qDebug() << "ThreadPlacement: setpriority failed:" << strerror(errno);
+        setIoPriority(IOPRIO_CLASS_IDLE, 0);
+        break;
+    }
+#else
+    switch (role) {
+    case Role::CacheWrite:
+        QThread::currentThread()->setPriority(QThread::LowPriority);
+        break;
+    case Role::Background:
+        QThread::currentThread()->setPriority(QThread::LowestPriority);
+        break;
+    default:
+        break;
+    }
+#endif
+}
+
+QString ThreadPlacement::describe()
+{
+#ifdef Q_OS_LINUX
+    const Plan &plan = hostPlan();
+    QString cpus;
+    if (plan.bigCores.isEmpty()) {
+        cpus = QStringLiteral("unpinned (cores alike)");
+    } else {
+        cpus = QStringLiteral("decompress cpu%1, hash %2 (big cores %3)")
+                   .arg(plan.decompressCpu)
+                   .arg(plan.hashCpu >= 0 ? QStringLiteral("cpu%1").arg(plan.hashCpu) : QStringLiteral("unpinned"))
+                   .arg(cpuRange(plan.bigCores));
+    }
+    return cpus + QStringLiteral("; I/O device be/0, cache be/7, background idle");
+#else
+    return QStringLiteral("unpinned; cache and background threads at low priority");
+#endif
+}
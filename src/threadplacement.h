@@ -0,0 +1,61 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <QList>
+#include <QString>
+
+/**
+ * Where the pipeline threads run, and how their I/O is ordered.
+ *
+ * On hosts with big and little cores the scheduler moves the decoder and
+ * the hasher around, and sometimes both end up on one big core or on a
+ * little one, which halves throughput for that stretch. Those two threads
+ * are therefore pinned to separate big cores. Hosts whose cores are all
+ * alike are left to the scheduler.
+ *
+ * The device writer and verify reads get the highest best-effort I/O
+ * priority, the cache writer the lowest, so a slow cache disk does not
+ * hold up the card. Icon and telemetry threads run niced with idle I/O.
+ *
+ * Everything here is Linux only (sched_setaffinity, ioprio_set); other
+ * platforms only lower the QThread priority of background and cache
+ * threads. Failures are logged and otherwise ignored.
+ */
+namespace ThreadPlacement {
+
+    enum class Role {
+        Decompress,   // Native decoders
+        Hash,         // HashPipeline
+        DeviceIo,     // Writes to and verify reads from the target device
+        CacheWrite,   // Copy of the download going to the cache file
+        Background,   // Icon fetching, telemetry
+    };
+
+    struct Plan {
+        int decompressCpu = -1;   // -1 leaves the thread to the scheduler
+        int hashCpu = -1;
+        QList<int> bigCores;      // Empty when the cores are all alike
+    };
+
+    /**
+     * Plan for the given per-CPU capacities, indexed by CPU number. A
+     * capacity of 0 marks a CPU that is offline or outside our affinity.
+     */
+    Plan planFor(const QList<int> &capacities);
+
+    /** Plan for this host, read from sysfs once. */
+    const Plan &hostPlan();
+
+    /** Place the calling thread according to its role. */
+    void apply(Role role);
+
+    /** One line summary of the host plan, for PerformanceStats::SystemInfo. */
+    QString describe();
+}
+
+#endif // THREADPLACEMENT_H
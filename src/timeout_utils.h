@@ -22,6 +22,7 @@
 #include <chrono>
 #include <functional>
 #include <future>
+#include <memory>
 #include <thread>
 #include <atomic>
 #include <type_traits>
@@ -83,7 +84,9 @@ struct TimeoutConfig {
  * - Timeout is exceeded (returns TimedOut, thread is detached)
  * - External cancellation is requested (returns Cancelled)
  * 
- * @note On TimedOut, the operation thread is detached and may continue running.
+ * @note On TimedOut or Cancelled, the operation thread is detached and may
+ *       continue running, so the operation must not capture anything by
+ *       reference that goes away when the caller returns.
  *       Use onTimeout to trigger an abort (e.g., close fd to unblock syscall).
  */
 template<typename Func>
@@ -91,14 +94,13 @@ TimeoutResult runWithTimeout(
     Func&& operation,
     const TimeoutConfig& config = {}
 ) {
-    std::atomic<bool> completed{false};
-    std::promise<void> promise;
-    auto future = promise.get_future();
+    // Shared with the worker, which outlives this call once detached
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
     
-    std::thread worker([&completed, &promise, op = std::forward<Func>(operation)]() {
+    std::thread worker([promise, op = std::forward<Func>(operation)]() mutable {
         op();
-        completed.store(true);
-        promise.set_value();
+        promise->set_value();
     });
     
     auto startTime = std::chrono::steady_clock::now();
@@ -143,9 +145,15 @@ TimeoutResult runWithTimeout(
     ResultType& result,
     const TimeoutConfig& config = {}
 ) {
-    return runWithTimeout([&]() {
-        result = operation();
+    // The worker writes to its own copy, which is only handed out once it completed
+    auto value = std::make_shared<ResultType>();
+    const TimeoutResult outcome = runWithTimeout([value, op = std::forward<Func>(operation)]() mutable {
+        *value = op();
     }, config);
+    if (outcome == TimeoutResult::Completed) {
+        result = *value;
+    }
+    return outcome;
 }
 
 /**
@@ -171,6 +179,10 @@ namespace TimeoutDefaults {
     constexpr int kWatchdogAsyncTimeoutMs = 180000;        // Extended timeout when async pending (180s)
     constexpr int kWatchdogReduceDepthThresholdMs = 30000; // Try reducing queue depth after 30s
     constexpr int kWatchdogRestartThresholdMs = 120000;    // Restart only if drain fails (120s)
+    // The four above are floors; slow-but-healthy cards stretch them (see WatchdogThresholds)
+    constexpr int kWatchdogTailLatencyMultiple = 4;        // Stall must outlast this many p99.9 completions
+    constexpr int kWatchdogMaxScalePercent = 300;          // Never stretch beyond 3x the floors
+    constexpr int kWatchdogRampUpIntervalMs = 15000;       // Steady progress before each queue depth step back up
     
     // === Ring buffer stall detection ===
     constexpr int kRingBufferStallTimeoutMs = 30000;  // Cumulative wait = stall timeout
@@ -185,8 +197,16 @@ namespace TimeoutDefaults {
     constexpr int kMemoryCheckIntervalMs = 2000;    // How often to check available memory
     constexpr int kCriticalMemoryMB = 256;          // Below this, reduce queue depth
     
+    // === Multi-target (fan-out) writing ===
+    constexpr int kFanOutLagTimeoutMs = 30000;  // Max producer wait on a lagging target before dropping it
+    constexpr int kFanOutPrepareTimeoutSeconds = 180;  // Max time for an additional target to unmount, clean and zero
+    
     // === Device preparation timeouts ===
     constexpr int kHardTimeoutSeconds = 120;  // Timeout for BLKDISCARD, end-of-device writes
+    
+    // === Cancellation ===
+    constexpr int kCancelPollIntervalMs = 50;  // How often a blocking sync checks for cancellation
+    constexpr int kCancelTargetMs = 1000;      // Cancelling should release the device within this
 }
 
 } // namespace rpi_imager
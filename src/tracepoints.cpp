@@ -0,0 +1,31 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "tracepoints.h"
+
+#if defined(RPI_TRACE_ETW)
+// The GUID is the one derived from the name, so tools can also enable the
+// provider as *RaspberryPi.Imager
+TRACELOGGING_DEFINE_PROVIDER(rpiImagerTraceProvider, "RaspberryPi.Imager",
+    (0x90e49406, 0x5ede, 0x5d13, 0x36, 0x81, 0xab, 0x12, 0xdb, 0xe5, 0x16, 0x85));
+#endif
+
+namespace rpi_imager {
+
+void registerTraceProvider()
+{
+#if defined(RPI_TRACE_ETW)
+    TraceLoggingRegister(rpiImagerTraceProvider);
+#endif
+}
+
+void unregisterTraceProvider()
+{
+#if defined(RPI_TRACE_ETW)
+    TraceLoggingUnregister(rpiImagerTraceProvider);
+#endif
+}
+
+} // namespace rpi_imager
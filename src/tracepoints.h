@@ -0,0 +1,119 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef TRACEPOINTS_H
+#define TRACEPOINTS_H
+
+/*
+ * Static tracepoints in the pipeline's hot paths, compiled into release
+ * builds so that a field issue can be profiled without rebuilding:
+ *
+ *   RPI_TRACE0(name)
+ *   RPI_TRACE1(name, arg0)
+ *   RPI_TRACE2(name, arg0, arg1)
+ *   RPI_TRACE3(name, arg0, arg1, arg2)
+ *
+ * name is a bare identifier; the arguments are integers, passed as int64.
+ * Each platform's native mechanism carries them:
+ *
+ *   Linux    USDT probes of provider rpi_imager (<sys/sdt.h>), for bpftrace,
+ *            perf and SystemTap. A disabled probe is a single nop.
+ *   Windows  TraceLogging (ETW) events of provider RaspberryPi.Imager,
+ *            registered by registerTraceProvider(), for WPR/WPA and
+ *            tracelog. A disabled event costs a load and a branch.
+ *   macOS    os_signpost events in subsystem com.raspberrypi.rpi-imager,
+ *            category "pipeline", for Instruments. Disabled, a load and a
+ *            branch.
+ *
+ * Where the headers are missing (e.g. no systemtap-sdt-dev) the macros
+ * expand to nothing, as they do when RPI_IMAGER_NO_TRACEPOINTS is defined.
+ * Probe names and arguments are listed in doc/performance/README.md.
+ */
+
+#include <cstdint>
+
+namespace rpi_imager {
+// Before the first tracepoint and after the last; no-ops except on Windows
+void registerTraceProvider();
+void unregisterTraceProvider();
+
+// Registers the provider for the lifetime of main()
+struct TraceProviderScope {
+    TraceProviderScope() { registerTraceProvider(); }
+    ~TraceProviderScope() { unregisterTraceProvider(); }
+    TraceProviderScope(const TraceProviderScope &) = delete;
+    TraceProviderScope &operator=(const TraceProviderScope &) = delete;
+};
+}
+
+#if !defined(RPI_IMAGER_NO_TRACEPOINTS) && defined(__linux__) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define RPI_TRACE_USDT 1
+#  endif
+#elif !defined(RPI_IMAGER_NO_TRACEPOINTS) && defined(_WIN32) && defined(__has_include)
+#  if __has_include(<TraceLoggingProvider.h>)
+#    ifndef NOMINMAX
+#      define NOMINMAX
+#    endif
+#    include <windows.h>
+#    include <TraceLoggingProvider.h>
+#    define RPI_TRACE_ETW 1
+#  endif
+#elif !defined(RPI_IMAGER_NO_TRACEPOINTS) && defined(__APPLE__)
+#  include <os/signpost.h>
+#  define RPI_TRACE_SIGNPOST 1
+#endif
+
+#define RPI_TRACE_ARG(x) static_cast<std::int64_t>(x)
+
+#if defined(RPI_TRACE_USDT)
+
+#define RPI_TRACE0(name) DTRACE_PROBE(rpi_imager, name)
+#define RPI_TRACE1(name, a) DTRACE_PROBE1(rpi_imager, name, RPI_TRACE_ARG(a))
+#define RPI_TRACE2(name, a, b) DTRACE_PROBE2(rpi_imager, name, RPI_TRACE_ARG(a), RPI_TRACE_ARG(b))
+#define RPI_TRACE3(name, a, b, c) DTRACE_PROBE3(rpi_imager, name, RPI_TRACE_ARG(a), RPI_TRACE_ARG(b), RPI_TRACE_ARG(c))
+
+#elif defined(RPI_TRACE_ETW)
+
+TRACELOGGING_DECLARE_PROVIDER(rpiImagerTraceProvider);
+
+#define RPI_TRACE0(name) TraceLoggingWrite(rpiImagerTraceProvider, #name)
+#define RPI_TRACE1(name, a) TraceLoggingWrite(rpiImagerTraceProvider, #name, \
+    TraceLoggingInt64(RPI_TRACE_ARG(a), "arg0"))
+#define RPI_TRACE2(name, a, b) TraceLoggingWrite(rpiImagerTraceProvider, #name, \
+    TraceLoggingInt64(RPI_TRACE_ARG(a), "arg0"), TraceLoggingInt64(RPI_TRACE_ARG(b), "arg1"))
+#define RPI_TRACE3(name, a, b, c) TraceLoggingWrite(rpiImagerTraceProvider, #name, \
+    TraceLoggingInt64(RPI_TRACE_ARG(a), "arg0"), TraceLoggingInt64(RPI_TRACE_ARG(b), "arg1"), \
+    TraceLoggingInt64(RPI_TRACE_ARG(c), "arg2"))
+
+#elif defined(RPI_TRACE_SIGNPOST)
+
+namespace rpi_imager {
+inline os_log_t traceLog()
+{
+    static const os_log_t log = os_log_create("com.raspberrypi.rpi-imager", "pipeline");
+    return log;
+}
+}
+
+#define RPI_TRACE0(name) os_signpost_event_emit(rpi_imager::traceLog(), OS_SIGNPOST_ID_EXCLUSIVE, #name)
+#define RPI_TRACE1(name, a) os_signpost_event_emit(rpi_imager::traceLog(), OS_SIGNPOST_ID_EXCLUSIVE, #name, \
+    "%lld", static_cast<long long>(a))
+#define RPI_TRACE2(name, a, b) os_signpost_event_emit(rpi_imager::traceLog(), OS_SIGNPOST_ID_EXCLUSIVE, #name, \
+    "%lld %lld", static_cast<long long>(a), static_cast<long long>(b))
+#define RPI_TRACE3(name, a, b, c) os_signpost_event_emit(rpi_imager::traceLog(), OS_SIGNPOST_ID_EXCLUSIVE, #name, \
+    "%lld %lld %lld", static_cast<long long>(a), static_cast<long long>(b), static_cast<long long>(c))
+
+#else
+
+#define RPI_TRACE0(name) ((void)0)
+#define RPI_TRACE1(name, a) ((void)0)
+#define RPI_TRACE2(name, a, b) ((void)0)
+#define RPI_TRACE3(name, a, b, c) ((void)0)
+
+#endif
+
+#endif // TRACEPOINTS_H
@@ -0,0 +1,175 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "usbsourceindex.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+    constexpr int FORMAT_VERSION = 1;
+    constexpr qint64 HASH_CHUNK_SIZE = 4 * 1024 * 1024;
+
+    // The GUI thread lists the media while the background hash job records
+    // digests; both read, change and write back the same files
+    QMutex indexMutex;
+
+    bool isSafeKey(const QString &volumeUuid)
+    {
+        if (volumeUuid.isEmpty())
+            return false;
+        for (const QChar c : volumeUuid)
+        {
+            if (!c.isLetterOrNumber() && c != QLatin1Char('-') && c != QLatin1Char('_'))
+                return false;
+        }
+        return true;
+    }
+}
+
+UsbSourceIndex::UsbSourceIndex(const QString &directory)
+    : _directory(directory)
+{
+}
+
+QString UsbSourceIndex::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           QDir::separator() + "usbsources";
+}
+
+QString UsbSourceIndex::volumeUuid(const QString &devname)
+{
+    QDir dir("/dev/disk/by-uuid");
+    const QFileInfoList links = dir.entryInfoList(QDir::System | QDir::Files | QDir::NoDotAndDotDot);
+    for (const QFileInfo &link : links)
+    {
+        if (QFileInfo(link.symLinkTarget()).fileName() == devname)
+            return link.fileName();
+    }
+    return {};
+}
+
+bool UsbSourceIndex::matches(const Entry &entry, const QFileInfo &file)
+{
+    return entry.size == file.size() && entry.modified == file.lastModified().toMSecsSinceEpoch();
+}
+
+UsbSourceIndex::Entry UsbSourceIndex::entryFor(const QFileInfo &file)
+{
+    Entry entry;
+    entry.size = file.size();
+    entry.modified = file.lastModified().toMSecsSinceEpoch();
+    return entry;
+}
+
+QString UsbSourceIndex::pathFor(const QString &volumeUuid) const
+{
+    return _directory + QDir::separator() + volumeUuid + QLatin1String(".json");
+}
+
+UsbSourceIndex::Entries UsbSourceIndex::load(const QString &volumeUuid) const
+{
+    if (!isSafeKey(volumeUuid))
+        return {};
+
+    QMutexLocker lock(&indexMutex);
+    return read(volumeUuid);
+}
+
+void UsbSourceIndex::update(const QString &volumeUuid, const std::function<bool(Entries &)> &change)
+{
+    if (!isSafeKey(volumeUuid))
+        return;
+
+    QMutexLocker lock(&indexMutex);
+    Entries entries = read(volumeUuid);
+    if (change(entries))
+        store(volumeUuid, entries);
+}
+
+UsbSourceIndex::Entries UsbSourceIndex::read(const QString &volumeUuid) const
+{
+    Entries entries;
+    QFile f(pathFor(volumeUuid));
+    if (!f.open(QIODevice::ReadOnly))
+        return entries;
+
+    const QJsonObject root = QJsonDocument::fromJson(f.readAll()).object();
+    if (root.value("version").toInt() != FORMAT_VERSION)
+        return entries;
+
+    const QJsonObject files = root.value("files").toObject();
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it)
+    {
+        const QJsonObject o = it.value().toObject();
+        Entry entry;
+        entry.size = o.value("size").toInteger();
+        entry.modified = o.value("modified").toInteger();
+        entry.sha256 = o.value("sha256").toString().toLatin1();
+        entry.extractSize = static_cast<quint64>(o.value("extract_size").toInteger());
+        entries.insert(it.key(), entry);
+    }
+    return entries;
+}
+
+void UsbSourceIndex::store(const QString &volumeUuid, const Entries &entries)
+{
+    QJsonObject files;
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it)
+    {
+        QJsonObject o = {
+            {"size", it->size},
+            {"modified", it->modified}
+        };
+        if (!it->sha256.isEmpty())
+            o.insert("sha256", QString::fromLatin1(it->sha256));
+        if (it->extractSize)
+            o.insert("extract_size", static_cast<qint64>(it->extractSize));
+        files.insert(it.key(), o);
+    }
+
+    QDir().mkpath(_directory);
+    QSaveFile f(pathFor(volumeUuid));
+    if (!f.open(QIODevice::WriteOnly))
+        return;
+
+    const QJsonObject root = {
+        {"version", FORMAT_VERSION},
+        {"files", files}
+    };
+    f.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!f.commit())
+        qWarning() << "UsbSourceIndex: could not write index for volume" << volumeUuid;
+}
+
+QByteArray UsbSourceIndex::hashFile(const QString &path, const std::atomic<bool> &cancelled)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return {};
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QByteArray buf(HASH_CHUNK_SIZE, Qt::Uninitialized);
+    while (!cancelled.load())
+    {
+        const qint64 len = f.read(buf.data(), buf.size());
+        if (len < 0)
+            return {};
+        if (len == 0)
+            return hash.result().toHex();
+        hash.addData(QByteArrayView(buf.constData(), len));
+    }
+    return {};
+}
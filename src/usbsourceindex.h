@@ -0,0 +1,73 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef USBSOURCEINDEX_H
+#define USBSOURCEINDEX_H
+
+#include <QByteArray>
+#include <QFileInfo>
+#include <QHash>
+#include <QString>
+
+#include <atomic>
+#include <functional>
+
+/**
+ * What is known about the images on USB source media in embedded mode.
+ *
+ * The media are mounted read-only, so the index for each one is kept in
+ * the cache directory, keyed by the volume UUID of its file system. For
+ * each image file it holds the size and modification time it was seen
+ * with, its SHA-256 once that has been computed in the background, and
+ * its extract size once known. An entry whose size or time no longer
+ * matches the file is stale and is replaced.
+ *
+ * load() and update() may be called from any thread; updates to one
+ * volume's index are serialized.
+ */
+class UsbSourceIndex
+{
+public:
+    struct Entry {
+        qint64 size = 0;
+        qint64 modified = 0;    // Milliseconds since the epoch
+        QByteArray sha256;      // Hex; empty until hashed
+        quint64 extractSize = 0;  // 0 = not known
+    };
+    using Entries = QHash<QString, Entry>;  // By file name
+
+    explicit UsbSourceIndex(const QString &directory = defaultDirectory());
+
+    static QString defaultDirectory();
+
+    // UUID of the file system on /dev/<devname>, or empty if it has none
+    static QString volumeUuid(const QString &devname);
+
+    // Whether entry still describes the file
+    static bool matches(const Entry &entry, const QFileInfo &file);
+    static Entry entryFor(const QFileInfo &file);
+
+    Entries load(const QString &volumeUuid) const;
+
+    // Apply change to the stored index of the volume, and write it back if
+    // change returns true
+    void update(const QString &volumeUuid, const std::function<bool(Entries &)> &change);
+
+    /**
+     * SHA-256 of a file, read in large chunks
+     * @return Hex digest, or empty if it cannot be read or cancelled is set
+     */
+    static QByteArray hashFile(const QString &path, const std::atomic<bool> &cancelled);
+
+private:
+    QString pathFor(const QString &volumeUuid) const;
+    // Callers hold the index lock
+    Entries read(const QString &volumeUuid) const;
+    void store(const QString &volumeUuid, const Entries &entries);
+
+    QString _directory;
+};
+
+#endif // USBSOURCEINDEX_H
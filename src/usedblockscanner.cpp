@@ -0,0 +1,832 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "usedblockscanner.h"
+#include "devicewrapperstructs.h"
+
+#include <QDebug>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// ext2/3/4 superblock feature flags we need to know about
+constexpr std::uint16_t EXT_MAGIC = 0xEF53;
+constexpr std::uint32_t EXT_COMPAT_SPARSE_SUPER2 = 0x200;
+constexpr std::uint32_t EXT_INCOMPAT_META_BG = 0x10;
+constexpr std::uint32_t EXT_INCOMPAT_64BIT = 0x80;
+constexpr std::uint32_t EXT_RO_COMPAT_SPARSE_SUPER = 0x1;
+constexpr std::uint32_t EXT_RO_COMPAT_GDT_CSUM = 0x10;
+constexpr std::uint32_t EXT_RO_COMPAT_BIGALLOC = 0x200;
+constexpr std::uint32_t EXT_RO_COMPAT_METADATA_CSUM = 0x400;
+constexpr std::uint16_t EXT_BG_BLOCK_UNINIT = 0x2;
+
+// Larger FATs are not worth reading into memory, the partition is copied whole
+constexpr std::uint64_t MAX_FAT_SIZE = 256 * 1024 * 1024;
+
+// Image bytes kept for the partition table, and partition bytes for the
+// FAT boot sector or ext superblock
+constexpr size_t TABLE_HEAD_SIZE = 1024 * 1024;
+constexpr size_t FS_HEAD_SIZE = 2048;
+
+std::uint16_t le16(const char *p) { return qFromLittleEndian<std::uint16_t>(p); }
+std::uint32_t le32(const char *p) { return qFromLittleEndian<std::uint32_t>(p); }
+
+bool isPowerOf(std::uint64_t n, std::uint64_t base)
+{
+    while (n > 1 && n % base == 0)
+        n /= base;
+    return n == 1;
+}
+
+// Layout of a FAT12/16/32 volume, from its boot sector
+struct FatGeometry
+{
+    std::uint64_t bytesPerSector;
+    std::uint64_t reservedSectors;
+    std::uint64_t fatSectors;
+    std::uint64_t totalSectors;
+    std::uint64_t firstDataSector;
+    std::uint64_t clusterBytes;
+    std::uint64_t clusters;
+    bool fat32;
+
+    bool parse(const fat_bpb &bpb, std::uint64_t partSize)
+    {
+        const fat16_bpb &common = bpb.fat16;
+        if (common.Signature[0] != 0x55 || common.Signature[1] != 0xAA)
+            return false;
+
+        bytesPerSector = qFromLittleEndian(common.BPB_BytsPerSec);
+        const std::uint64_t sectorsPerCluster = common.BPB_SecPerClus;
+        reservedSectors = qFromLittleEndian(common.BPB_RsvdSecCnt);
+        const std::uint64_t numFats = common.BPB_NumFATs;
+        const std::uint64_t rootEntries = qFromLittleEndian(common.BPB_RootEntCnt);
+        totalSectors = common.BPB_TotSec16 ? qFromLittleEndian(common.BPB_TotSec16)
+                                           : qFromLittleEndian(common.BPB_TotSec32);
+        fatSectors = common.BPB_FATSz16 ? qFromLittleEndian(common.BPB_FATSz16)
+                                        : qFromLittleEndian(bpb.fat32.BPB_FATSz32);
+
+        if (bytesPerSector < 512 || bytesPerSector > 4096 || (bytesPerSector & (bytesPerSector - 1))
+            || !sectorsPerCluster || (sectorsPerCluster & (sectorsPerCluster - 1))
+            || !reservedSectors || !numFats || !fatSectors || !totalSectors)
+            return false;
+
+        const std::uint64_t rootDirSectors = (rootEntries * 32 + bytesPerSector - 1) / bytesPerSector;
+        firstDataSector = reservedSectors + numFats * fatSectors + rootDirSectors;
+        if (firstDataSector >= totalSectors || totalSectors * bytesPerSector > partSize
+            || fatSectors * bytesPerSector > MAX_FAT_SIZE)
+            return false;
+
+        clusterBytes = sectorsPerCluster * bytesPerSector;
+        clusters = (totalSectors - firstDataSector) / sectorsPerCluster;
+        fat32 = clusters >= 65525;
+        return true;
+    }
+
+    // FAT12 volumes are tiny, they are copied whole
+    bool isFat12() const { return clusters < 4085; }
+    std::uint64_t fatOffset() const { return reservedSectors * bytesPerSector; }
+    std::uint64_t fatSize() const { return fatSectors * bytesPerSector; }
+    std::uint64_t dataOffset() const { return firstDataSector * bytesPerSector; }
+    std::uint64_t size() const { return totalSectors * bytesPerSector; }
+
+    // Clusters with an entry in a FAT of fatBytes bytes
+    std::uint64_t entries(std::uint64_t fatBytes) const
+    {
+        const std::uint64_t entrySize = fat32 ? 4 : 2;
+        return fatBytes / entrySize <= 2 ? 0 : std::min<std::uint64_t>(clusters, fatBytes / entrySize - 2);
+    }
+
+    // Entries 0 and 1 are reserved, entry n describes cluster n
+    bool isUsed(const char *fat, std::uint64_t index) const
+    {
+        return fat32 ? (le32(fat + (index + 2) * 4) & 0x0FFFFFFF) != 0 : le16(fat + (index + 2) * 2) != 0;
+    }
+};
+
+// Layout of an ext2/3/4 file system, from its superblock
+struct ExtGeometry
+{
+    std::uint64_t blockSize;
+    std::uint64_t blocksCount;
+    std::uint64_t firstDataBlock;
+    std::uint64_t blocksPerGroup;
+    std::uint64_t descSize;
+    std::uint64_t reservedGdtBlocks;
+    std::uint64_t groups;
+    std::uint64_t gdtBlocks;
+    std::uint64_t inodeTableBlocks;
+    bool is64Bit;
+    bool bitmapsMayBeUninit;
+    bool sparseSuper;
+    bool sparseSuper2;
+    std::uint64_t backupGroups[2];
+
+    struct Group
+    {
+        std::uint64_t blockBitmap;
+        std::uint64_t inodeBitmap;
+        std::uint64_t inodeTable;
+        bool blockUninit;
+    };
+
+    bool parse(const char *sb, std::uint64_t partSize)
+    {
+        if (le16(sb + 0x38) != EXT_MAGIC)
+            return false;
+
+        const std::uint32_t logBlockSize = le32(sb + 0x18);
+        const std::uint32_t compat = le32(sb + 0x5C);
+        const std::uint32_t incompat = le32(sb + 0x60);
+        const std::uint32_t roCompat = le32(sb + 0x64);
+        if (logBlockSize > 6 || (incompat & EXT_INCOMPAT_META_BG) || (roCompat & EXT_RO_COMPAT_BIGALLOC))
+            return false;
+
+        is64Bit = incompat & EXT_INCOMPAT_64BIT;
+        blockSize = 1024ULL << logBlockSize;
+        blocksCount = le32(sb + 0x04) | (is64Bit ? static_cast<std::uint64_t>(le32(sb + 0x150)) << 32 : 0);
+        firstDataBlock = le32(sb + 0x14);
+        blocksPerGroup = le32(sb + 0x20);
+        const std::uint64_t inodesPerGroup = le32(sb + 0x28);
+        const std::uint64_t inodeSize = le32(sb + 0x4C) == 0 ? 128 : le16(sb + 0x58);
+        descSize = is64Bit ? std::max<std::uint16_t>(le16(sb + 0xFE), 32) : 32;
+        reservedGdtBlocks = le16(sb + 0xCE);
+
+        if (!blocksPerGroup || blocksPerGroup > blockSize * 8 || !inodesPerGroup || !inodeSize
+            || blocksCount <= firstDataBlock || blocksCount * blockSize > partSize)
+            return false;
+
+        groups = (blocksCount - firstDataBlock + blocksPerGroup - 1) / blocksPerGroup;
+        gdtBlocks = (groups * descSize + blockSize - 1) / blockSize;
+        inodeTableBlocks = (inodesPerGroup * inodeSize + blockSize - 1) / blockSize;
+        bitmapsMayBeUninit = roCompat & (EXT_RO_COMPAT_GDT_CSUM | EXT_RO_COMPAT_METADATA_CSUM);
+        sparseSuper = roCompat & EXT_RO_COMPAT_SPARSE_SUPER;
+        sparseSuper2 = compat & EXT_COMPAT_SPARSE_SUPER2;
+        backupGroups[0] = le32(sb + 0x24C);
+        backupGroups[1] = le32(sb + 0x250);
+        return true;
+    }
+
+    std::uint64_t gdtOffset() const { return (firstDataBlock + 1) * blockSize; }
+    std::uint64_t gdtSize() const { return groups * descSize; }
+    std::uint64_t groupStart(std::uint64_t g) const { return firstDataBlock + g * blocksPerGroup; }
+    std::uint64_t groupBlocks(std::uint64_t g) const { return std::min(blocksPerGroup, blocksCount - groupStart(g)); }
+
+    // Superblock and descriptor copies at the start of the group
+    std::uint64_t superBlocks(std::uint64_t g) const
+    {
+        bool hasSuper;
+        if (g == 0)
+            hasSuper = true;
+        else if (sparseSuper2)
+            hasSuper = g == backupGroups[0] || g == backupGroups[1];
+        else
+            hasSuper = !sparseSuper || isPowerOf(g, 3) || isPowerOf(g, 5) || isPowerOf(g, 7);
+        return hasSuper ? 1 + gdtBlocks + reservedGdtBlocks : 0;
+    }
+
+    // Decodes the descriptor of group g; false if it points outside the file system
+    bool group(const char *gdt, std::uint64_t g, Group &out) const
+    {
+        const char *desc = gdt + g * descSize;
+        const bool hiWords = is64Bit && descSize >= 64;
+        out.blockBitmap = le32(desc) | (hiWords ? static_cast<std::uint64_t>(le32(desc + 0x20)) << 32 : 0);
+        out.inodeBitmap = le32(desc + 0x04) | (hiWords ? static_cast<std::uint64_t>(le32(desc + 0x24)) << 32 : 0);
+        out.inodeTable = le32(desc + 0x08) | (hiWords ? static_cast<std::uint64_t>(le32(desc + 0x28)) << 32 : 0);
+        out.blockUninit = bitmapsMayBeUninit && (le16(desc + 0x12) & EXT_BG_BLOCK_UNINIT);
+        return out.blockBitmap < blocksCount && out.inodeBitmap < blocksCount && out.inodeTable < blocksCount;
+    }
+};
+
+}
+
+UsedBlockScanner::UsedBlockScanner(ReadFunction read, std::uint64_t diskSize)
+    : _read(std::move(read)), _diskSize(diskSize)
+{
+}
+
+std::unique_ptr<fastboot::BlockMap> UsedBlockScanner::scan()
+{
+    _used.clear();
+
+    std::vector<Partition> partitions;
+    if (!readPartitions(_read, _diskSize, partitions))
+    {
+        qDebug() << "UsedBlockScanner: no partition table found";
+        return nullptr;
+    }
+
+    // Whatever lies outside the partitions we understand is copied as-is
+    std::uint64_t pos = 0;
+    for (const auto &part : partitions)
+    {
+        _addUsed(pos, part.start);
+        if (!_scanFat(part) && !_scanExt(part))
+            _addUsed(part.start, part.end);
+        pos = part.end;
+    }
+    _addUsed(pos, _diskSize);
+
+    std::sort(_used.begin(), _used.end());
+    std::vector<fastboot::BlockRange> ranges;
+    for (const auto &used : _used)
+    {
+        std::uint64_t first = used.first / kBlockSize;
+        std::uint64_t last = (used.second + kBlockSize - 1) / kBlockSize;
+        if (!ranges.empty() && first <= ranges.back().end)
+        {
+            ranges.back().end = std::max(ranges.back().end, last);
+        }
+        else
+        {
+            fastboot::BlockRange range{};
+            range.begin = first;
+            range.end = last;
+            ranges.push_back(range);
+        }
+    }
+
+    auto map = std::make_unique<fastboot::BlockMap>();
+    map->assign(kBlockSize, (_diskSize + kBlockSize - 1) / kBlockSize, std::move(ranges));
+    return map;
+}
+
+/*
+ * Partitions sorted by start, false without a partition table or if
+ * partitions overlap
+ */
+bool UsedBlockScanner::readPartitions(const ReadFunction &read, std::uint64_t diskSize, std::vector<Partition> &partitions)
+{
+    mbr_table mbr;
+    if (diskSize < sizeof(mbr) || !read(0, reinterpret_cast<char *>(&mbr), sizeof(mbr)))
+        return false;
+    if (mbr.signature[0] != 0x55 || mbr.signature[1] != 0xAA)
+        return false;
+
+    // Protective MBR
+    if (mbr.part[0].id == 0xEE)
+    {
+        if (!_readGpt(read, diskSize, partitions))
+            return false;
+    }
+    else
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            // Extended partitions are not followed, so they stay mapped in full
+            const auto &entry = mbr.part[i];
+            if (entry.id == 0 || entry.id == 0x05 || entry.id == 0x0F || entry.id == 0x85)
+                continue;
+
+            std::uint64_t start = static_cast<std::uint64_t>(qFromLittleEndian(entry.starting_sector)) * 512;
+            std::uint64_t end = std::min(start + static_cast<std::uint64_t>(qFromLittleEndian(entry.nr_of_sectors)) * 512, diskSize);
+            if (start < end)
+                partitions.push_back({start, end, i + 1});
+        }
+    }
+
+    std::sort(partitions.begin(), partitions.end(),
+              [](const Partition &a, const Partition &b) { return a.start < b.start; });
+    for (size_t i = 1; i < partitions.size(); i++)
+    {
+        if (partitions[i].start < partitions[i - 1].end)
+        {
+            qDebug() << "UsedBlockScanner: overlapping partitions";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UsedBlockScanner::_readGpt(const ReadFunction &read, std::uint64_t diskSize, std::vector<Partition> &partitions)
+{
+    gpt_header header;
+    if (diskSize < 512 + sizeof(header) || !read(512, reinterpret_cast<char *>(&header), sizeof(header)))
+        return false;
+    if (memcmp(header.Signature, "EFI PART", 8) != 0)
+        return false;
+
+    const std::uint32_t count = qFromLittleEndian(header.NumberOfPartitionEntries);
+    const std::uint32_t entrySize = qFromLittleEndian(header.SizeOfPartitionEntry);
+    if (entrySize < sizeof(gpt_partition) || count > 1024)
+        return false;
+
+    std::vector<char> table(static_cast<size_t>(count) * entrySize);
+    if (!read(qFromLittleEndian(header.PartitionEntryLBA) * 512, table.data(), table.size()))
+        return false;
+
+    static const unsigned char unusedType[16] = {};
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        gpt_partition entry;
+        memcpy(&entry, table.data() + static_cast<size_t>(i) * entrySize, sizeof(entry));
+        if (memcmp(entry.PartitionTypeGuid, unusedType, sizeof(unusedType)) == 0)
+            continue;
+
+        std::uint64_t start = qFromLittleEndian(entry.StartingLBA) * 512;
+        std::uint64_t end = std::min((qFromLittleEndian(entry.EndingLBA) + 1) * 512, diskSize);
+        if (start < end)
+            partitions.push_back({start, end, static_cast<int>(i) + 1});
+    }
+    return true;
+}
+
+/*
+ * FAT16/FAT32: the reserved sectors, the FATs and the FAT16 root directory,
+ * plus every cluster with a non-zero FAT entry
+ */
+bool UsedBlockScanner::_scanFat(const Partition &part)
+{
+    fat_bpb bpb;
+    if (part.end - part.start < sizeof(bpb) || !_read(part.start, reinterpret_cast<char *>(&bpb), sizeof(bpb)))
+        return false;
+
+    FatGeometry geometry;
+    if (!geometry.parse(bpb, part.end - part.start))
+        return false;
+
+    _addUsed(part.start, part.start + geometry.dataOffset());
+    if (geometry.isFat12())
+    {
+        _addUsed(part.start, part.start + geometry.size());
+        return true;
+    }
+
+    std::vector<char> fat(static_cast<size_t>(geometry.fatSize()));
+    if (!_read(part.start + geometry.fatOffset(), fat.data(), fat.size()))
+        return false;
+    const std::uint64_t numEntries = geometry.entries(fat.size());
+    if (!numEntries)
+        return false;
+
+    const std::uint64_t dataStart = part.start + geometry.dataOffset();
+    std::uint64_t runStart = 0;
+    bool inRun = false;
+    for (std::uint64_t i = 0; i < numEntries; i++)
+    {
+        bool used = geometry.isUsed(fat.data(), i);
+        if (used && !inRun)
+        {
+            runStart = i;
+            inRun = true;
+        }
+        else if (!used && inRun)
+        {
+            _addUsed(dataStart + runStart * geometry.clusterBytes, dataStart + i * geometry.clusterBytes);
+            inRun = false;
+        }
+    }
+    if (inRun)
+        _addUsed(dataStart + runStart * geometry.clusterBytes, dataStart + numEntries * geometry.clusterBytes);
+
+    return true;
+}
+
+/*
+ * ext2/3/4: superblock and descriptor copies, bitmaps and inode tables of
+ * every group, plus the blocks marked in the block bitmaps. Groups whose
+ * bitmap was never initialised only hold metadata.
+ */
+bool UsedBlockScanner::_scanExt(const Partition &part)
+{
+    char sb[1024];
+    if (part.end - part.start < 2048 || !_read(part.start + 1024, sb, sizeof(sb)))
+        return false;
+
+    ExtGeometry geometry;
+    if (!geometry.parse(sb, part.end - part.start))
+        return false;
+
+    std::vector<char> gdt(static_cast<size_t>(geometry.gdtSize()));
+    if (!_read(part.start + geometry.gdtOffset(), gdt.data(), gdt.size()))
+        return false;
+
+    const std::uint64_t blockSize = geometry.blockSize;
+    auto addBlocks = [&](std::uint64_t first, std::uint64_t count) {
+        _addUsed(part.start + first * blockSize, part.start + std::min(first + count, geometry.blocksCount) * blockSize);
+    };
+
+    // Boot sector and primary superblock, also with 1 KiB blocks
+    _addUsed(part.start, part.start + 2048);
+
+    std::vector<char> bitmap(static_cast<size_t>(blockSize));
+    for (std::uint64_t g = 0; g < geometry.groups; g++)
+    {
+        const std::uint64_t groupStart = geometry.groupStart(g);
+        const std::uint64_t groupBlocks = geometry.groupBlocks(g);
+
+        ExtGeometry::Group group;
+        if (!geometry.group(gdt.data(), g, group))
+            return false;
+        addBlocks(groupStart, geometry.superBlocks(g));
+        addBlocks(group.blockBitmap, 1);
+        addBlocks(group.inodeBitmap, 1);
+        addBlocks(group.inodeTable, geometry.inodeTableBlocks);
+
+        if (group.blockUninit)
+            continue;
+
+        if (!_read(part.start + group.blockBitmap * blockSize, bitmap.data(), bitmap.size()))
+            return false;
+
+        std::uint64_t runStart = 0;
+        bool inRun = false;
+        for (std::uint64_t i = 0; i < groupBlocks; i++)
+        {
+            bool used = (static_cast<unsigned char>(bitmap[i / 8]) >> (i % 8)) & 1;
+            if (used && !inRun)
+            {
+                runStart = i;
+                inRun = true;
+            }
+            else if (!used && inRun)
+            {
+                addBlocks(groupStart + runStart, i - runStart);
+                inRun = false;
+            }
+        }
+        if (inRun)
+            addBlocks(groupStart + runStart, groupBlocks - runStart);
+    }
+
+    return true;
+}
+
+void UsedBlockScanner::_addUsed(std::uint64_t begin, std::uint64_t end)
+{
+    end = std::min(end, _diskSize);
+    if (begin < end)
+        _used.emplace_back(begin, end);
+}
+
+
+/*
+ * File system of one partition, given its data in order from offset 0
+ */
+class StreamingBlockMapper::FileSystem
+{
+public:
+    virtual ~FileSystem() = default;
+    virtual void addData(std::uint64_t offset, const char *buf, size_t len) = 0;
+
+    // Whether partition bytes [begin, end) are known to be free; asked in order
+    virtual bool isFree(std::uint64_t begin, std::uint64_t end) = 0;
+};
+
+/*
+ * Keeps the first FAT, which is complete before the data area starts
+ */
+class StreamingBlockMapper::FatFileSystem : public StreamingBlockMapper::FileSystem
+{
+public:
+    explicit FatFileSystem(const FatGeometry &geometry)
+        : _geometry(geometry), _fatFilled(0), _entries(0)
+    {
+        if (!_geometry.isFat12())
+            _fat.resize(static_cast<size_t>(_geometry.fatSize()));
+    }
+
+    void addData(std::uint64_t offset, const char *buf, size_t len) override
+    {
+        const std::uint64_t next = _geometry.fatOffset() + _fatFilled;
+        if (_fatFilled == _fat.size() || offset > next || offset + len <= next)
+            return;
+
+        const size_t n = static_cast<size_t>(std::min<std::uint64_t>(offset + len - next, _fat.size() - _fatFilled));
+        memcpy(_fat.data() + _fatFilled, buf + (next - offset), n);
+        _fatFilled += n;
+        if (_fatFilled == _fat.size())
+            _entries = _geometry.entries(_fat.size());
+    }
+
+    bool isFree(std::uint64_t begin, std::uint64_t end) override
+    {
+        if (_geometry.isFat12())
+            return begin >= _geometry.size();
+        if (!_entries || _fatFilled < _fat.size() || begin < _geometry.dataOffset())
+            return false;
+
+        // Past the last cluster is not part of the file system
+        const std::uint64_t dataStart = _geometry.dataOffset();
+        const std::uint64_t dataEnd = std::min(end, dataStart + _entries * _geometry.clusterBytes);
+        for (std::uint64_t c = (begin - dataStart) / _geometry.clusterBytes;
+             dataStart + c * _geometry.clusterBytes < dataEnd; c++)
+        {
+            if (_geometry.isUsed(_fat.data(), c))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    FatGeometry _geometry;
+    std::vector<char> _fat;
+    size_t _fatFilled;
+    std::uint64_t _entries;
+};
+
+/*
+ * Keeps the group descriptors, then the block bitmaps that come after them.
+ * mke2fs puts the bitmaps before the groups they describe.
+ */
+class StreamingBlockMapper::ExtFileSystem : public StreamingBlockMapper::FileSystem
+{
+public:
+    explicit ExtFileSystem(const ExtGeometry &geometry)
+        : _geometry(geometry), _gdt(static_cast<size_t>(geometry.gdtSize())), _gdtFilled(0),
+          _ready(false), _bitmapCursor(0), _metadataCursor(0), _releasedGroups(0)
+    {
+    }
+
+    void addData(std::uint64_t offset, const char *buf, size_t len) override
+    {
+        if (!_ready)
+        {
+            const std::uint64_t next = _geometry.gdtOffset() + _gdtFilled;
+            if (_gdtFilled == _gdt.size() || offset > next || offset + len <= next)
+                return;
+
+            const size_t n = static_cast<size_t>(std::min<std::uint64_t>(offset + len - next, _gdt.size() - _gdtFilled));
+            memcpy(_gdt.data() + _gdtFilled, buf + (next - offset), n);
+            _gdtFilled += n;
+            if (_gdtFilled < _gdt.size() || !_prepare())
+                return;
+        }
+
+        const std::uint64_t blockSize = _geometry.blockSize;
+        const std::uint64_t end = offset + len;
+        while (_bitmapCursor < _bitmapBlocks.size())
+        {
+            const std::uint64_t blockStart = _bitmapBlocks[_bitmapCursor].first * blockSize;
+            std::vector<char> &bitmap = _bitmaps[_bitmapBlocks[_bitmapCursor].second];
+            const std::uint64_t next = blockStart + bitmap.size();
+            if (blockStart >= end)
+                break;
+            if (offset > next)
+            {
+                // Passed before the descriptors were known
+                _bitmapCursor++;
+                continue;
+            }
+
+            const std::uint64_t to = std::min(end, blockStart + blockSize);
+            bitmap.insert(bitmap.end(), buf + (next - offset), buf + (to - offset));
+            if (bitmap.size() < blockSize)
+                break;
+            _bitmapCursor++;
+        }
+    }
+
+    bool isFree(std::uint64_t begin, std::uint64_t end) override
+    {
+        // Boot sector and primary superblock, also with 1 KiB blocks
+        if (!_ready || begin < FS_HEAD_SIZE)
+            return false;
+
+        const std::uint64_t blockSize = _geometry.blockSize;
+        for (std::uint64_t block = begin / blockSize; block * blockSize < end; block++)
+        {
+            if (block >= _geometry.blocksCount)
+                continue;
+            if (block < _geometry.firstDataBlock || _isMetadata(block))
+                return false;
+
+            const std::uint64_t g = (block - _geometry.firstDataBlock) / _geometry.blocksPerGroup;
+            for (; _releasedGroups < g; _releasedGroups++)
+                std::vector<char>().swap(_bitmaps[_releasedGroups]);
+            if (_uninit[g])
+                continue;
+
+            const std::vector<char> &bitmap = _bitmaps[g];
+            const std::uint64_t i = block - _geometry.groupStart(g);
+            if (bitmap.size() < blockSize || ((static_cast<unsigned char>(bitmap[i / 8]) >> (i % 8)) & 1))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    ExtGeometry _geometry;
+    std::vector<char> _gdt;
+    size_t _gdtFilled;
+    bool _ready;
+
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> _metadata;       // [first, end) blocks, sorted
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> _bitmapBlocks;   // (block, group), sorted
+    std::vector<std::vector<char>> _bitmaps;
+    std::vector<bool> _uninit;
+    size_t _bitmapCursor;
+    size_t _metadataCursor;
+    std::uint64_t _releasedGroups;
+
+    bool _prepare()
+    {
+        _uninit.resize(static_cast<size_t>(_geometry.groups));
+        _bitmaps.resize(static_cast<size_t>(_geometry.groups));
+        for (std::uint64_t g = 0; g < _geometry.groups; g++)
+        {
+            ExtGeometry::Group group;
+            if (!_geometry.group(_gdt.data(), g, group))
+                return false;
+
+            const std::uint64_t groupStart = _geometry.groupStart(g);
+            _metadata.emplace_back(groupStart, groupStart + _geometry.superBlocks(g));
+            _metadata.emplace_back(group.blockBitmap, group.blockBitmap + 1);
+            _metadata.emplace_back(group.inodeBitmap, group.inodeBitmap + 1);
+            _metadata.emplace_back(group.inodeTable, group.inodeTable + _geometry.inodeTableBlocks);
+            _uninit[g] = group.blockUninit;
+            if (!group.blockUninit)
+                _bitmapBlocks.emplace_back(group.blockBitmap, g);
+        }
+        std::vector<char>().swap(_gdt);
+
+        std::sort(_bitmapBlocks.begin(), _bitmapBlocks.end());
+        std::sort(_metadata.begin(), _metadata.end());
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> merged;
+        for (const auto &range : _metadata)
+        {
+            if (range.first == range.second)
+                continue;
+            if (!merged.empty() && range.first <= merged.back().second)
+                merged.back().second = std::max(merged.back().second, range.second);
+            else
+                merged.push_back(range);
+        }
+        _metadata.swap(merged);
+
+        _ready = true;
+        return true;
+    }
+
+    bool _isMetadata(std::uint64_t block)
+    {
+        while (_metadataCursor < _metadata.size() && _metadata[_metadataCursor].second <= block)
+            _metadataCursor++;
+        return _metadataCursor < _metadata.size() && _metadata[_metadataCursor].first <= block;
+    }
+};
+
+StreamingBlockMapper::StreamingBlockMapper(fastboot::BlockMap *map, std::uint64_t imageSize)
+    : _map(map), _imageSize(imageSize), _pos(0), _nextBlock(0), _tableRead(false), _feedCursor(0), _classifyCursor(0)
+{
+    const std::uint64_t blockSize = UsedBlockScanner::kBlockSize;
+    _map->assign(blockSize, (imageSize + blockSize - 1) / blockSize, {});
+}
+
+StreamingBlockMapper::~StreamingBlockMapper() = default;
+
+void StreamingBlockMapper::addData(const char *buf, size_t len)
+{
+    if (!_tableRead)
+    {
+        const size_t want = static_cast<size_t>(_imageSize ? std::min<std::uint64_t>(TABLE_HEAD_SIZE, _imageSize) : TABLE_HEAD_SIZE);
+        const size_t n = std::min(len, want - _head.size());
+        _head.insert(_head.end(), buf, buf + n);
+        if (_head.size() == want)
+        {
+            _readTable();
+            _feedPartitions(0, _head.data(), _head.size());
+            std::vector<char>().swap(_head);
+            _feedPartitions(_pos + n, buf + n, len - n);
+        }
+    }
+    else
+    {
+        _feedPartitions(_pos, buf, len);
+    }
+
+    _pos += len;
+    _mapBlocks();
+}
+
+void StreamingBlockMapper::_readTable()
+{
+    _tableRead = true;
+
+    std::vector<UsedBlockScanner::Partition> partitions;
+    auto readHead = [this](std::uint64_t offset, char *buf, size_t len) {
+        if (offset > _head.size() || len > _head.size() - offset)
+            return false;
+        memcpy(buf, _head.data() + offset, len);
+        return true;
+    };
+    const std::uint64_t diskSize = _imageSize ? _imageSize : std::numeric_limits<std::uint64_t>::max();
+    if (!UsedBlockScanner::readPartitions(readHead, diskSize, partitions))
+    {
+        qDebug() << "StreamingBlockMapper: no partition table found, mapping every block";
+        return;
+    }
+
+    for (const auto &part : partitions)
+    {
+        PartitionState state;
+        state.part = part;
+        _partitions.push_back(std::move(state));
+    }
+}
+
+void StreamingBlockMapper::_feedPartitions(std::uint64_t offset, const char *buf, size_t len)
+{
+    const std::uint64_t end = offset + len;
+    while (_feedCursor < _partitions.size() && _partitions[_feedCursor].part.end <= offset)
+        _feedCursor++;
+
+    for (size_t i = _feedCursor; i < _partitions.size() && _partitions[i].part.start < end; i++)
+    {
+        PartitionState &state = _partitions[i];
+        const std::uint64_t from = std::max(offset, state.part.start);
+        const std::uint64_t to = std::min(end, state.part.end);
+        if (from < to)
+            _feedPartition(state, from - state.part.start, buf + (from - offset), static_cast<size_t>(to - from));
+    }
+}
+
+void StreamingBlockMapper::_feedPartition(PartitionState &state, std::uint64_t offset, const char *buf, size_t len)
+{
+    if (state.fs)
+    {
+        state.fs->addData(offset, buf, len);
+        return;
+    }
+    if (state.detected || offset != state.head.size())
+        return;
+
+    const size_t n = std::min(len, FS_HEAD_SIZE - state.head.size());
+    state.head.insert(state.head.end(), buf, buf + n);
+    if (state.head.size() < FS_HEAD_SIZE)
+        return;
+
+    state.detected = true;
+    const std::uint64_t partSize = state.part.end - state.part.start;
+    fat_bpb bpb;
+    memcpy(&bpb, state.head.data(), sizeof(bpb));
+    FatGeometry fat;
+    ExtGeometry ext;
+    const char *type = nullptr;
+    if (fat.parse(bpb, partSize))
+    {
+        state.fs = std::make_unique<FatFileSystem>(fat);
+        type = "FAT";
+    }
+    else if (ext.parse(state.head.data() + 1024, partSize))
+    {
+        state.fs = std::make_unique<ExtFileSystem>(ext);
+        type = "ext";
+    }
+
+    if (state.fs)
+    {
+        qDebug() << "StreamingBlockMapper:" << type << "file system at offset" << state.part.start;
+        state.fs->addData(0, state.head.data(), state.head.size());
+        if (len > n)
+            state.fs->addData(offset + n, buf + n, len - n);
+    }
+    std::vector<char>().swap(state.head);
+}
+
+/*
+ * Decide every block up to and including the one starting at _pos, so the
+ * map covers all data passed so far and the range the data ends in is
+ * never extended after it has been hashed
+ */
+void StreamingBlockMapper::_mapBlocks()
+{
+    const std::uint64_t blockSize = UsedBlockScanner::kBlockSize;
+    std::uint64_t last = _pos / blockSize + 1;
+    if (_imageSize)
+        last = std::min(last, (_imageSize + blockSize - 1) / blockSize);
+
+    std::uint64_t runStart = _nextBlock;
+    for (; _nextBlock < last; _nextBlock++)
+    {
+        const std::uint64_t begin = _nextBlock * blockSize;
+        const std::uint64_t end = _imageSize ? std::min(begin + blockSize, _imageSize) : begin + blockSize;
+        if (_isFree(begin, end))
+        {
+            _map->append(runStart, _nextBlock);
+            runStart = _nextBlock + 1;
+        }
+    }
+    _map->append(runStart, _nextBlock);
+}
+
+bool StreamingBlockMapper::_isFree(std::uint64_t begin, std::uint64_t end)
+{
+    if (!_tableRead)
+        return false;
+
+    while (_classifyCursor < _partitions.size() && _partitions[_classifyCursor].part.end <= begin)
+        _classifyCursor++;
+    if (_classifyCursor == _partitions.size())
+        return false;
+
+    PartitionState &state = _partitions[_classifyCursor];
+    if (begin < state.part.start || end > state.part.end || !state.fs)
+        return false;
+    return state.fs->isFree(begin - state.part.start, end - state.part.start);
+}
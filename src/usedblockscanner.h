@@ -0,0 +1,129 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef USEDBLOCKSCANNER_H
+#define USEDBLOCKSCANNER_H
+
+#include "fastboot/bmap.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Builds a block map of the parts of a disk that hold data
+ *
+ * Used when cloning a device, so that free space inside its file systems is
+ * skipped like the unmapped ranges of a .bmap. The partition table (MBR or
+ * GPT) is read, and for FAT16/FAT32 and ext2/3/4 partitions only the
+ * metadata and the clusters/blocks marked as allocated are mapped.
+ * Everything else (gaps, unknown partitions, the backup GPT) is mapped in
+ * full, so data the scan cannot account for is always copied.
+ *
+ * The file systems must not be mounted while the disk is being copied.
+ */
+class UsedBlockScanner
+{
+public:
+    static constexpr std::uint64_t kBlockSize = 4096;
+
+    /*
+     * Reads len bytes at offset into buf. Offsets and lengths are not
+     * aligned; returns false on error
+     */
+    using ReadFunction = std::function<bool(std::uint64_t offset, char *buf, size_t len)>;
+
+    UsedBlockScanner(ReadFunction read, std::uint64_t diskSize);
+
+    /**
+     * @brief Scan the disk
+     * @return the map (without checksums), or nullptr if there is no
+     * partition table or it could not be read
+     */
+    std::unique_ptr<fastboot::BlockMap> scan();
+
+    struct Partition {
+        std::uint64_t start;
+        std::uint64_t end;
+        int number = 0;   // As in /dev/sdX<number>: the MBR slot or GPT entry, from 1
+    };
+
+    /**
+     * @brief Read the MBR or GPT partition table
+     * @return false if there is none or partitions overlap. Partitions are
+     * sorted by start; extended MBR partitions are left out.
+     */
+    static bool readPartitions(const ReadFunction &read, std::uint64_t diskSize, std::vector<Partition> &partitions);
+
+private:
+    ReadFunction _read;
+    std::uint64_t _diskSize;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> _used;  // [begin, end) in bytes
+
+    static bool _readGpt(const ReadFunction &read, std::uint64_t diskSize, std::vector<Partition> &partitions);
+    bool _scanFat(const Partition &part);
+    bool _scanExt(const Partition &part);
+    void _addUsed(std::uint64_t begin, std::uint64_t end);
+};
+
+/**
+ * @brief Builds a block map of a disk image while it is being written
+ *
+ * For images without a .bmap, which can only be read once and in order.
+ * The partition table is read from the first MiB; the FAT, or the ext
+ * group descriptors and block bitmaps, are kept as they pass. Like
+ * UsedBlockScanner, everything but the free space of FAT16/FAT32 and
+ * ext2/3/4 file systems is mapped. A block is also mapped if the metadata
+ * saying it is free comes after it in the image.
+ */
+class StreamingBlockMapper
+{
+public:
+    /*
+     * Blocks in use are appended to map, which must outlive the mapper.
+     * imageSize is 0 if not known
+     */
+    StreamingBlockMapper(fastboot::BlockMap *map, std::uint64_t imageSize);
+    ~StreamingBlockMapper();
+
+    /**
+     * @brief Pass on the next len bytes of the image
+     *
+     * Call before using the map for the data: every block that starts
+     * before or right at the end of the data has been added if in use.
+     */
+    void addData(const char *buf, size_t len);
+
+private:
+    class FileSystem;
+    class FatFileSystem;
+    class ExtFileSystem;
+
+    struct PartitionState {
+        UsedBlockScanner::Partition part;
+        std::vector<char> head;  // Until the file system is known
+        bool detected = false;
+        std::unique_ptr<FileSystem> fs;
+    };
+
+    fastboot::BlockMap *_map;
+    std::uint64_t _imageSize;
+    std::uint64_t _pos;
+    std::uint64_t _nextBlock;  // First block not added or skipped yet
+    std::vector<char> _head;   // Start of the image, until the partition table is read
+    bool _tableRead;
+    std::vector<PartitionState> _partitions;
+    size_t _feedCursor;        // First partition that can still get data
+    size_t _classifyCursor;    // First partition that can still contain _nextBlock
+
+    void _readTable();
+    void _feedPartitions(std::uint64_t offset, const char *buf, size_t len);
+    void _feedPartition(PartitionState &state, std::uint64_t offset, const char *buf, size_t len);
+    void _mapBlocks();
+    bool _isFree(std::uint64_t begin, std::uint64_t end);
+};
+
+#endif // USEDBLOCKSCANNER_H
@@ -0,0 +1,40 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "watchdogthresholds.h"
+#include "timeout_utils.h"
+#include <algorithm>
+
+using namespace rpi_imager::TimeoutDefaults;
+
+namespace {
+
+int scaled(int ms, int percent)
+{
+    return static_cast<int>(static_cast<int64_t>(ms) * percent / 100);
+}
+
+} // namespace
+
+WatchdogThresholds WatchdogThresholds::defaults()
+{
+    return {kWatchdogReduceDepthThresholdMs, kWatchdogReduceDepthThresholdMs * 2,
+            kWatchdogRestartThresholdMs, kWatchdogAsyncTimeoutMs, kWatchdogStallTimeoutMs, 100};
+}
+
+WatchdogThresholds WatchdogThresholds::forTailLatency(uint64_t p999Us, uint64_t samples)
+{
+    if (samples < MinSamples)
+        return defaults();
+
+    const uint64_t stallMs = p999Us / 1000 * kWatchdogTailLatencyMultiple;
+    const int percent = static_cast<int>(std::clamp<uint64_t>(stallMs * 100 / kWatchdogReduceDepthThresholdMs,
+                                                              100, kWatchdogMaxScalePercent));
+
+    const WatchdogThresholds base = defaults();
+    return {scaled(base.reduceDepthMs, percent), scaled(base.drainMs, percent),
+            scaled(base.restartMs, percent), scaled(base.timeoutMs, percent),
+            scaled(base.syncTimeoutMs, percent), percent};
+}
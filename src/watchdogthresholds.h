@@ -0,0 +1,42 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef WATCHDOGTHRESHOLDS_H
+#define WATCHDOGTHRESHOLDS_H
+
+#include <cstdint>
+
+/**
+ * @brief Stall thresholds for WriteProgressWatchdog, scaled to the device
+ *
+ * The TimeoutDefaults watchdog constants suit a typical card. A slow but
+ * healthy one can pause for many seconds while it collects garbage; with a
+ * deep queue every write in flight waits behind the pause, so no progress
+ * is seen and the watchdog steps down the queue depth, or drains to sync,
+ * for the rest of the write.
+ *
+ * forTailLatency() takes the p99.9 async completion latency measured so
+ * far. A stall only counts once it outlasts kWatchdogTailLatencyMultiple
+ * of those, so every threshold is stretched by the same factor when that is
+ * longer than the reduce-depth floor, up to kWatchdogMaxScalePercent. The
+ * defaults are floors: a fast card never gets shorter thresholds. Below
+ * MinSamples completions the tail is not known and the defaults apply.
+ */
+struct WatchdogThresholds
+{
+    static constexpr uint64_t MinSamples = 1000;  // p99.9 means nothing with fewer
+
+    int reduceDepthMs;
+    int drainMs;
+    int restartMs;
+    int timeoutMs;      // Hard timeout with async writes pending
+    int syncTimeoutMs;  // Hard timeout with none pending
+    int scalePercent;   // Applied to the defaults, >= 100
+
+    static WatchdogThresholds defaults();
+    static WatchdogThresholds forTailLatency(uint64_t p999Us, uint64_t samples);
+};
+
+#endif // WATCHDOGTHRESHOLDS_H
@@ -27,9 +27,10 @@ add_custom_command(
 set(PLATFORM_SOURCES
     windows/acceleratedcryptographichash_cng.cpp
     drivelist/drivelist_windows.cpp
+    drivelist/devicemonitor.h
+    drivelist/devicemonitor_windows.cpp
     windows/winfile.cpp
     windows/winfile.h
-    windows/bootimgcreator_windows.cpp
     windows/rsakeyfingerprint_windows.cpp
     windows/diskpart_util.cpp
     windows/diskpart_util.h
@@ -56,7 +57,7 @@ set(DEPENDENCIES
     ${CMAKE_BINARY_DIR}/rpi-imager.rc
     wlanapi_delayed.lib
 )
-set(EXTRALIBS setupapi ${CMAKE_BINARY_DIR}/wlanapi_delayed.lib Bcrypt.dll ole32 oleaut32 wbemuuid)
+set(EXTRALIBS setupapi ${CMAKE_BINARY_DIR}/wlanapi_delayed.lib Bcrypt.dll ole32 oleaut32 wbemuuid powrprof)
 
 # Add winusb for rpiboot support
 set(EXTRALIBS ${EXTRALIBS} winusb)
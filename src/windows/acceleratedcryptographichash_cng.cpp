@@ -170,27 +170,37 @@ private:
     PBYTE                   pbHash          = NULL;
 };
 
-AcceleratedCryptographicHash::AcceleratedCryptographicHash(QCryptographicHash::Algorithm method)
-    : p_Impl(std::make_unique<impl>(method)), _algo(method) {}
+AcceleratedCryptographicHash::AcceleratedCryptographicHash(QCryptographicHash::Algorithm method, Mode mode)
+    : p_Impl(std::make_unique<impl>(method)), _tree(mode != Mode::Sequential ? _makeTree(method, mode) : nullptr), _algo(method) {}
 
 AcceleratedCryptographicHash::~AcceleratedCryptographicHash() = default;
 
 void AcceleratedCryptographicHash::addData(const char *data, int length) {
+    if (_tree)
+        return _treeAddData(data, length);
     p_Impl->addData(data, length);
 }
 void AcceleratedCryptographicHash::addData(const QByteArray &data) {
+    if (_tree)
+        return _treeAddData(data.constData(), data.size());
     p_Impl->addData(data);
 }
 QByteArray AcceleratedCryptographicHash::result() const {
     if (!_resultCached) {
-        _cachedResult = p_Impl->result();
+        _cachedResult = _tree ? _treeResult() : p_Impl->result();
         _resultCached = true;
     }
     return _cachedResult;
 }
 
+QString AcceleratedCryptographicHash::backendName() {
+    return QStringLiteral("CNG");
+}
+
 void AcceleratedCryptographicHash::reset() {
     p_Impl = std::make_unique<impl>(_algo);
+    if (_tree)
+        _resetTree();
     _cachedResult.clear();
     _resultCached = false;
 }
\ No newline at end of file
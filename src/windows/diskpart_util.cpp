@@ -4,15 +4,15 @@
  */
 
 #include "diskpart_util.h"
-#include "../drivelist/drivelist.h"
-#include "../platformquirks.h"
-#include "winfile.h"
 #include <QDebug>
 #include <QProcess>
 #include <QThread>
 #include <QElapsedTimer>
 #include <regex>
 #include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
 
 #include <windows.h>
 #include <winioctl.h>
@@ -66,6 +66,167 @@ static bool extractDiskNumber(const QByteArray &device, int &diskNumber)
     return true;
 }
 
+// A volume with an extent on the disk being cleaned
+struct DiskVolume {
+    QString name;             // \\?\Volume{GUID}, without the trailing backslash
+    QStringList mountPoints;  // Drive letters and mounted folders, e.g. "E:\"
+};
+
+// All volumes on a disk, found through the volume manager rather than a
+// full drive scan. This includes volumes without a drive letter, which
+// hold the disk open just the same.
+static std::vector<DiskVolume> volumesOnDisk(int diskNumber)
+{
+    std::vector<DiskVolume> volumes;
+    wchar_t volumeName[MAX_PATH];
+    HANDLE hFind = FindFirstVolumeW(volumeName, MAX_PATH);
+    if (hFind == INVALID_HANDLE_VALUE)
+    {
+        qDebug() << "FindFirstVolumeW failed with error" << GetLastError();
+        return volumes;
+    }
+
+    do
+    {
+        QString name = QString::fromWCharArray(volumeName);
+        if (name.endsWith("\\"))
+            name.chop(1);
+
+        // No access rights are needed to query the extents
+        HANDLE hVolume = CreateFileW(
+            reinterpret_cast<LPCWSTR>(name.utf16()),
+            0,
+            FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr,
+            OPEN_EXISTING,
+            0,
+            nullptr
+        );
+        if (hVolume == INVALID_HANDLE_VALUE)
+            continue;
+
+        // Spanned volumes have several extents; one on this disk is enough
+        alignas(VOLUME_DISK_EXTENTS) BYTE extentsBuffer[sizeof(VOLUME_DISK_EXTENTS) + 15 * sizeof(DISK_EXTENT)];
+        auto *extents = reinterpret_cast<VOLUME_DISK_EXTENTS *>(extentsBuffer);
+        DWORD bytesReturned;
+        bool onDisk = false;
+        if (DeviceIoControl(hVolume, IOCTL_VOLUME_GET_VOLUME_DISK_EXTENTS, nullptr, 0,
+                            extentsBuffer, sizeof(extentsBuffer), &bytesReturned, nullptr))
+        {
+            for (DWORD i = 0; i < extents->NumberOfDiskExtents; i++)
+            {
+                if (extents->Extents[i].DiskNumber == static_cast<DWORD>(diskNumber))
+                    onDisk = true;
+            }
+        }
+        CloseHandle(hVolume);
+        if (!onDisk)
+            continue;
+
+        DiskVolume volume;
+        volume.name = name;
+        wchar_t paths[1024];
+        DWORD pathsLength = 0;
+        if (GetVolumePathNamesForVolumeNameW(volumeName, paths, ARRAYSIZE(paths), &pathsLength))
+        {
+            for (const wchar_t *path = paths; *path; path += wcslen(path) + 1)
+                volume.mountPoints.append(QString::fromWCharArray(path));
+        }
+        volumes.push_back(volume);
+    } while (FindNextVolumeW(hFind, volumeName, MAX_PATH));
+
+    FindVolumeClose(hFind);
+    return volumes;
+}
+
+// Lock, dismount and remove the mount points of one volume
+static void dismountVolume(const DiskVolume &volume)
+{
+    const QString label = volume.mountPoints.isEmpty() ? volume.name : volume.mountPoints.join(", ");
+    qDebug() << "Unmounting volume" << label;
+
+    // Notify Explorer BEFORE we start - this helps prevent "Insert a disk" dialogs
+    // by telling Explorer to release handles and stop monitoring the drive
+    for (const QString &mountPoint : volume.mountPoints)
+        notifyShellDriveRemoved(mountPoint);
+
+    HANDLE hVolume = CreateFileW(
+        reinterpret_cast<LPCWSTR>(volume.name.utf16()),
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr,
+        OPEN_EXISTING,
+        0,
+        nullptr
+    );
+
+    if (hVolume == INVALID_HANDLE_VALUE)
+    {
+        qDebug() << "Could not open volume" << label << "- may already be unmounted";
+        return;
+    }
+
+    DWORD bytesReturned;
+
+    // Lock the volume (prevents other processes from accessing it)
+    // Use geometric backoff — Windows 11 25H2+ may hold handles longer
+    {
+        bool locked = false;
+        int lockDelayMs = 100;
+        for (int attempt = 0; attempt < 8; attempt++)
+        {
+            if (DeviceIoControl(hVolume, FSCTL_LOCK_VOLUME, nullptr, 0, nullptr, 0, &bytesReturned, nullptr))
+            {
+                qDebug() << "Locked volume" << label;
+                locked = true;
+                break;
+            }
+            qDebug() << "FSCTL_LOCK_VOLUME failed for" << label
+                     << "- retrying in" << lockDelayMs << "ms";
+            QThread::msleep(lockDelayMs);
+            lockDelayMs *= 2;
+        }
+        if (!locked)
+            qDebug() << "Could not lock volume" << label << "- proceeding with dismount anyway";
+    }
+
+    // Dismount the volume (flushes buffers and invalidates handles)
+    if (DeviceIoControl(hVolume, FSCTL_DISMOUNT_VOLUME, nullptr, 0, nullptr, 0, &bytesReturned, nullptr))
+    {
+        qDebug() << "Dismounted volume" << label;
+    }
+    else
+    {
+        qDebug() << "Failed to dismount volume" << label << "- continuing anyway";
+    }
+
+    // Unlock and close the volume handle BEFORE removing mount point
+    DeviceIoControl(hVolume, FSCTL_UNLOCK_VOLUME, nullptr, 0, nullptr, 0, &bytesReturned, nullptr);
+    CloseHandle(hVolume);
+
+    // Remove the drive letter assignment using DeleteVolumeMountPoint
+    // This is the KEY step that prevents "Insert a disk" dialogs!
+    // Unlike FSCTL_DISMOUNT_VOLUME which just unmounts the filesystem,
+    // DeleteVolumeMountPoint removes the drive letter entirely so
+    // Windows Explorer won't try to access it after we clean the disk.
+    for (const QString &mountPoint : volume.mountPoints)
+    {
+        if (DeleteVolumeMountPointW(reinterpret_cast<LPCWSTR>(mountPoint.utf16())))
+        {
+            qDebug() << "Removed mount point" << mountPoint;
+        }
+        else
+        {
+            DWORD error = GetLastError();
+            qDebug() << "Failed to remove mount point" << mountPoint << "error:" << error << "- continuing anyway";
+        }
+
+        // Notify Explorer that the drive has been removed
+        // This is a secondary notification to help Explorer update its view
+        notifyShellDriveRemoved(mountPoint);
+    }
+}
+
 DiskpartResult unmountVolumes(const QByteArray &device, TimingCallback timingCallback)
 {
     QElapsedTimer timer;
@@ -77,114 +238,15 @@ DiskpartResult unmountVolumes(const QByteArray &device, TimingCallback timingCal
         return DiskpartResult{false, QObject::tr("Invalid Windows physical drive path: %1").arg(QString(device))};
     }
     
-    // Get list of storage devices to find volumes on this disk
-    auto deviceList = Drivelist::ListStorageDevices();
-    QByteArray canonicalDevice = PlatformQuirks::getEjectDevicePath(device).toLower().toUtf8();
-    int volumesProcessed = 0;
-    
-    for (const auto &dev : deviceList)
-    {
-        if (QByteArray::fromStdString(dev.device).toLower() == canonicalDevice)
-        {
-            for (const auto &mountpoint : dev.mountpoints)
-            {
-                QString driveLetter = QString::fromStdString(mountpoint);
-                if (driveLetter.endsWith("\\"))
-                    driveLetter.chop(1);
-                
-                qDebug() << "Unmounting volume" << driveLetter;
-                
-                // Notify Explorer BEFORE we start - this helps prevent "Insert a disk" dialogs
-                // by telling Explorer to release handles and stop monitoring the drive
-                notifyShellDriveRemoved(driveLetter);
-                
-                // Open the volume
-                QString volumePath = "\\\\.\\" + driveLetter;
-                HANDLE hVolume = CreateFileW(
-                    reinterpret_cast<LPCWSTR>(volumePath.utf16()),
-                    GENERIC_READ | GENERIC_WRITE,
-                    FILE_SHARE_READ | FILE_SHARE_WRITE,
-                    nullptr,
-                    OPEN_EXISTING,
-                    0,
-                    nullptr
-                );
-                
-                if (hVolume == INVALID_HANDLE_VALUE)
-                {
-                    qDebug() << "Could not open volume" << driveLetter << "- may already be unmounted";
-                    continue;
-                }
-                
-                DWORD bytesReturned;
-                
-                // Lock the volume (prevents other processes from accessing it)
-                // Use geometric backoff — Windows 11 25H2+ may hold handles longer
-                {
-                    bool locked = false;
-                    int lockDelayMs = 100;
-                    for (int attempt = 0; attempt < 8; attempt++)
-                    {
-                        if (DeviceIoControl(hVolume, FSCTL_LOCK_VOLUME, nullptr, 0, nullptr, 0, &bytesReturned, nullptr))
-                        {
-                            qDebug() << "Locked volume" << driveLetter;
-                            locked = true;
-                            break;
-                        }
-                        qDebug() << "FSCTL_LOCK_VOLUME failed for" << driveLetter
-                                 << "- retrying in" << lockDelayMs << "ms";
-                        QThread::msleep(lockDelayMs);
-                        lockDelayMs *= 2;
-                    }
-                    if (!locked)
-                        qDebug() << "Could not lock volume" << driveLetter << "- proceeding with dismount anyway";
-                }
-                
-                // Dismount the volume (flushes buffers and invalidates handles)
-                if (DeviceIoControl(hVolume, FSCTL_DISMOUNT_VOLUME, nullptr, 0, nullptr, 0, &bytesReturned, nullptr))
-                {
-                    qDebug() << "Dismounted volume" << driveLetter;
-                }
-                else
-                {
-                    qDebug() << "Failed to dismount volume" << driveLetter << "- continuing anyway";
-                }
-                
-                // Unlock and close the volume handle BEFORE removing mount point
-                DeviceIoControl(hVolume, FSCTL_UNLOCK_VOLUME, nullptr, 0, nullptr, 0, &bytesReturned, nullptr);
-                CloseHandle(hVolume);
-                
-                // Remove the drive letter assignment using DeleteVolumeMountPoint
-                // This is the KEY step that prevents "Insert a disk" dialogs!
-                // Unlike FSCTL_DISMOUNT_VOLUME which just unmounts the filesystem,
-                // DeleteVolumeMountPoint removes the drive letter entirely so
-                // Windows Explorer won't try to access it after we clean the disk.
-                QString mountPoint = driveLetter + "\\";  // Must end with backslash
-                if (DeleteVolumeMountPointW(reinterpret_cast<LPCWSTR>(mountPoint.utf16())))
-                {
-                    qDebug() << "Removed drive letter" << driveLetter;
-                }
-                else
-                {
-                    DWORD error = GetLastError();
-                    qDebug() << "Failed to remove drive letter" << driveLetter << "error:" << error << "- continuing anyway";
-                }
-                
-                // Notify Explorer that the drive has been removed
-                // This is a secondary notification to help Explorer update its view
-                notifyShellDriveRemoved(driveLetter);
-                
-                volumesProcessed++;
-                
-                // Brief pause between volumes (reduced from 500ms)
-                if (volumesProcessed > 0)
-                {
-                    QThread::msleep(100);
-                }
-            }
-            break;
-        }
-    }
+    // Volumes are dismounted all at once: each may spend seconds waiting
+    // for the lock while Explorer or an antivirus scanner lets go of it
+    const std::vector<DiskVolume> volumes = volumesOnDisk(diskNumber);
+    std::vector<std::thread> workers;
+    workers.reserve(volumes.size());
+    for (const DiskVolume &volume : volumes)
+        workers.emplace_back(dismountVolume, std::cref(volume));
+    for (std::thread &worker : workers)
+        worker.join();
     
     quint32 elapsed = static_cast<quint32>(timer.elapsed());
     if (timingCallback)
@@ -192,7 +254,7 @@ DiskpartResult unmountVolumes(const QByteArray &device, TimingCallback timingCal
         timingCallback("driveUnmountVolumes", elapsed, true);
     }
     
-    qDebug() << "Unmounted" << volumesProcessed << "volumes in" << elapsed << "ms";
+    qDebug() << "Unmounted" << volumes.size() << "volumes in" << elapsed << "ms";
     return DiskpartResult{true, QString()};
 }
 
@@ -344,40 +406,7 @@ DiskpartResult cleanDisk(const QByteArray &device, std::chrono::milliseconds tim
     // Check for mounted volumes and optionally unmount them first
     if (volumeHandling == VolumeHandling::UnmountFirst)
     {
-        auto l = Drivelist::ListStorageDevices();
-        QByteArray canonicalDevice = PlatformQuirks::getEjectDevicePath(device).toLower().toUtf8();
-        
-        for (auto i : l)
-        {
-            if (QByteArray::fromStdString(i.device).toLower() == canonicalDevice)
-            {
-                for (const auto& mountpoint : i.mountpoints)
-                {
-                    QString driveLetter = QString::fromStdString(mountpoint);
-                    if (driveLetter.endsWith("\\"))
-                        driveLetter.chop(1);
-                    
-                    qDebug() << "Attempting to unmount drive" << driveLetter;
-                    
-                    // Try to lock and unlock the volume to force unmount
-                    WinFile tempFile;
-                    tempFile.setFileName("\\\\.\\" + driveLetter);
-                    if (tempFile.open(QIODevice::ReadWrite))
-                    {
-                        if (tempFile.lockVolume())
-                        {
-                            tempFile.unlockVolume();
-                            qDebug() << "Successfully unlocked volume" << driveLetter;
-                        }
-                        tempFile.close();
-                    }
-                    
-                    // Give the system time to process the unmount
-                    QThread::msleep(std::chrono::milliseconds(500).count());
-                }
-                break;
-            }
-        }
+        unmountVolumes(device);
     }
 
     // Run diskpart with retry logic
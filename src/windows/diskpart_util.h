@@ -58,6 +58,9 @@ DiskpartResult cleanDiskFast(const QByteArray &device, TimingCallback timingCall
 /**
  * Unmount and lock all volumes on a physical drive
  * 
+ * Volumes are found by their disk extents, so those without a drive letter
+ * are included, and are locked and dismounted in parallel.
+ * 
  * @param device - Windows physical drive path (e.g., "\\\\.\\PHYSICALDRIVE0")
  * @param timingCallback - Optional callback for performance event reporting
  * @return DiskpartResult with success status and error message if failed
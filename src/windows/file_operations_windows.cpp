@@ -5,6 +5,7 @@
 
 #include "file_operations_windows.h"
 #include "../timeout_utils.h"
+#include "../tracepoints.h"
 
 #include <winioctl.h>
 #include <sstream>
@@ -47,6 +48,7 @@ bool WindowsFileOperations::IsPhysicalDrivePath(const std::string& path) {
 }
 
 WindowsFileOperations::~WindowsFileOperations() {
+  WaitForPendingReads();
   WaitForPendingWrites();
   CleanupIOCP();
   Close();
@@ -160,6 +162,11 @@ void WindowsFileOperations::ProcessCompletions(bool wait) {
     auto completionTime = std::chrono::steady_clock::now();
     auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(completionTime - ctx->submit_time).count();
     write_latency_stats_.recordCompletion(ctx->submit_time);
+    // The offset identifies the request, as there is no id on this side
+    RPI_TRACE3(io_write_complete,
+               (static_cast<std::uint64_t>(ctx->overlapped.OffsetHigh) << 32) | ctx->overlapped.Offset,
+               success ? static_cast<std::int64_t>(bytes_transferred) : -1,
+               latency);
     
     // Adaptive recovery: if individual write latency is very high, reduce queue depth
     // This helps the system recover when conditions change (memory pressure, slow device)
@@ -372,7 +379,9 @@ FileError WindowsFileOperations::OpenDevice(const std::string& path) {
   if (device_io_limits_.max_transfer_bytes > 0 || device_io_limits_.suggested_queue_depth > 0) {
     std::ostringstream oss;
     oss << "Device I/O limits: max_transfer=" << device_io_limits_.max_transfer_bytes
-        << " bytes, suggested_queue_depth=" << device_io_limits_.suggested_queue_depth;
+        << " bytes, suggested_queue_depth=" << device_io_limits_.suggested_queue_depth
+        << ", alignment=" << device_io_limits_.io_alignment_bytes
+        << ", physical_sector=" << device_io_limits_.physical_sector_bytes;
     Log(oss.str());
   }
 
@@ -897,6 +906,59 @@ FileError WindowsFileOperations::ReadSequential(std::uint8_t* data, std::size_t
   return FileError::kSuccess;
 }
 
+FileError WindowsFileOperations::ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                                              std::size_t size, std::size_t& bytes_read) {
+  bytes_read = 0;
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+
+  while (bytes_read < size) {
+    if (cancelled_.load()) {
+      return FileError::kCancelled;
+    }
+
+    OVERLAPPED overlapped = {};
+    HANDLE event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    if (event == nullptr) {
+      return FileError::kReadError;
+    }
+    // Setting the low bit keeps the completion off the IOCP port, so the
+    // async write completion loop never sees this read
+    overlapped.hEvent = reinterpret_cast<HANDLE>(reinterpret_cast<ULONG_PTR>(event) | 1);
+
+    LARGE_INTEGER read_offset;
+    read_offset.QuadPart = static_cast<LONGLONG>(offset + bytes_read);
+    overlapped.Offset = read_offset.LowPart;
+    overlapped.OffsetHigh = read_offset.HighPart;
+
+    DWORD chunk_size = static_cast<DWORD>(std::min(size - bytes_read,
+                                                   static_cast<std::size_t>(MAXDWORD)));
+    DWORD win_bytes_read = 0;
+    BOOL result = ReadFile(handle_, data + bytes_read, chunk_size, &win_bytes_read, &overlapped);
+
+    if (!result) {
+      DWORD error = GetLastError();
+      if (error == ERROR_HANDLE_EOF) {
+        CloseHandle(event);
+        break;
+      }
+      if (error != ERROR_IO_PENDING || !WaitForOverlappedWithCancel(&overlapped, &win_bytes_read)) {
+        CloseHandle(event);
+        return cancelled_.load() ? FileError::kCancelled : FileError::kReadError;
+      }
+    }
+    CloseHandle(event);
+
+    if (win_bytes_read == 0) {
+      break;  // End of device
+    }
+    bytes_read += static_cast<std::size_t>(win_bytes_read);
+  }
+
+  return FileError::kSuccess;
+}
+
 FileError WindowsFileOperations::Seek(std::uint64_t position) {
   if (!IsOpen()) {
     return FileError::kOpenError;
@@ -1014,6 +1076,27 @@ FileError WindowsFileOperations::Flush() {
   return FileError::kSuccess;
 }
 
+FileError WindowsFileOperations::SyncToDevice() {
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+
+  if (cancelled_.load()) {
+    return FileError::kCancelled;
+  }
+
+  if (!FlushFileBuffers(handle_)) {
+    DWORD error = GetLastError();
+    // ERROR_INVALID_FUNCTION is returned by some devices that don't support flush
+    if (error == ERROR_INVALID_FUNCTION) {
+      return FileError::kSuccess;
+    }
+    return FileError::kSyncError;
+  }
+
+  return FileError::kSuccess;
+}
+
 void WindowsFileOperations::PrepareForSequentialRead(std::uint64_t offset, std::uint64_t length) {
   if (!IsOpen()) {
     return;
@@ -1044,6 +1127,56 @@ void WindowsFileOperations::PrepareForSequentialRead(std::uint64_t offset, std::
   (void)length;
 }
 
+// Trims the whole drive with a single data set management request.
+// FSCTL_FILE_LEVEL_TRIM only applies to files on a mounted volume, so the
+// physical drive handle uses the storage-level IOCTL instead.
+FileError WindowsFileOperations::EraseDevice() {
+  if (!IsOpen()) {
+    return FileError::kOpenError;
+  }
+
+  // Trim must not race queued writes to the same sectors
+  WaitForPendingWrites();
+
+  DEVICE_MANAGE_DATA_SET_ATTRIBUTES attributes = {};
+  attributes.Size = sizeof(attributes);
+  attributes.Action = DeviceDsmAction_Trim;
+  attributes.Flags = DEVICE_DSM_FLAG_ENTIRE_DATA_SET_RANGE;
+
+  OVERLAPPED overlapped = {};
+  overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+  if (overlapped.hEvent == nullptr) {
+    last_error_code_ = GetLastError();
+    Log("EraseDevice: Failed to create event");
+    return FileError::kWriteError;
+  }
+
+  DWORD bytes_returned = 0;
+  BOOL result = DeviceIoControl(handle_, IOCTL_STORAGE_MANAGE_DATA_SET_ATTRIBUTES,
+                                &attributes, sizeof(attributes), nullptr, 0,
+                                &bytes_returned, &overlapped);
+  if (!result) {
+    DWORD error = GetLastError();
+    if (error == ERROR_IO_PENDING) {
+      result = WaitForOverlappedWithCancel(&overlapped, &bytes_returned) ? TRUE : FALSE;
+    } else {
+      last_error_code_ = error;
+    }
+  }
+  CloseHandle(overlapped.hEvent);
+
+  if (!result) {
+    if (cancelled_.load()) {
+      return FileError::kCancelled;
+    }
+    std::ostringstream oss;
+    oss << "EraseDevice: trim failed, error=" << last_error_code_;
+    Log(oss.str());
+    return FileError::kWriteError;
+  }
+  return FileError::kSuccess;
+}
+
 int WindowsFileOperations::GetHandle() const {
   // Note: This is a compatibility method. Windows HANDLE cannot be safely cast to int.
   // For proper Windows code, use the handle_ member directly or add a GetWindowsHandle() method.
@@ -1177,6 +1310,7 @@ FileError WindowsFileOperations::AsyncWriteSequential(const std::uint8_t* data,
   ctx->overlapped.Offset = offset.LowPart;
   ctx->overlapped.OffsetHigh = offset.HighPart;
   
+  RPI_TRACE3(io_write_submit, async_write_offset_, async_write_offset_, size);
   async_write_offset_ += size;
   
   // Track the pending context
@@ -1208,6 +1342,11 @@ FileError WindowsFileOperations::AsyncWriteSequential(const std::uint8_t* data,
       
       std::ostringstream oss;
       oss << "Async WriteFile failed, error: " << error;
+      const size_t alignment = device_io_limits_.io_alignment_bytes;
+      if (error == ERROR_INVALID_PARAMETER && using_direct_io_ && alignment > 0 &&
+          ((reinterpret_cast<std::uintptr_t>(data) | size | static_cast<std::uint64_t>(offset.QuadPart)) % alignment) != 0) {
+        oss << " (buffer, size or offset not " << alignment << "-byte aligned as unbuffered I/O requires)";
+      }
       Log(oss.str());
       
       if (callback) callback(FileError::kWriteError, 0);
@@ -1228,6 +1367,130 @@ FileError WindowsFileOperations::AsyncWriteSequential(const std::uint8_t* data,
   return FileError::kSuccess;
 }
 
+FileError WindowsFileOperations::AsyncReadSequential(std::uint8_t* data, std::size_t size,
+                                                      AsyncReadCallback callback) {
+  if (!IsOpen()) {
+    if (callback) callback(FileError::kOpenError, 0);
+    return FileError::kOpenError;
+  }
+
+  if (cancelled_.load()) {
+    if (callback) callback(FileError::kCancelled, 0);
+    return FileError::kCancelled;
+  }
+
+  HANDLE event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+  if (event == nullptr) {
+    last_error_code_ = GetLastError();
+    if (callback) callback(FileError::kReadError, 0);
+    return FileError::kReadError;
+  }
+
+  AsyncReadContext* ctx = new AsyncReadContext();
+  ZeroMemory(&ctx->overlapped, sizeof(OVERLAPPED));
+  ctx->event = event;
+  ctx->callback = callback;
+  // As in ReadAtOffset(), the low bit keeps the completion off the IOCP
+  // port, so the async write completion loop never sees it
+  ctx->overlapped.hEvent = reinterpret_cast<HANDLE>(reinterpret_cast<ULONG_PTR>(event) | 1);
+
+  LARGE_INTEGER offset;
+  offset.QuadPart = static_cast<LONGLONG>(current_file_position_);
+  ctx->overlapped.Offset = offset.LowPart;
+  ctx->overlapped.OffsetHigh = offset.HighPart;
+  RPI_TRACE3(io_read_submit, current_file_position_, current_file_position_, size);
+  current_file_position_ += size;
+
+  if (!ReadFile(handle_, data, static_cast<DWORD>(size), nullptr, &ctx->overlapped)) {
+    DWORD error = GetLastError();
+    if (error != ERROR_IO_PENDING) {
+      CloseHandle(event);
+      delete ctx;
+      if (error == ERROR_HANDLE_EOF) {
+        if (callback) callback(FileError::kSuccess, 0);
+        return FileError::kSuccess;
+      }
+      last_error_code_ = error;
+      std::ostringstream oss;
+      oss << "Async ReadFile failed, error: " << error;
+      Log(oss.str());
+      if (callback) callback(FileError::kReadError, 0);
+      return FileError::kReadError;
+    }
+  }
+
+  // Also when ReadFile completed synchronously: the event is set either way
+  pending_reads_.push_back(ctx);
+  return FileError::kSuccess;
+}
+
+FileError WindowsFileOperations::WaitForPendingReads(int max_pending) {
+  if (max_pending < 0) max_pending = 0;
+  constexpr DWORD kWaitTimeoutMs = 100;  // Check for cancel every 100ms
+  bool cancel_issued = false;
+
+  while (static_cast<int>(pending_reads_.size()) > max_pending) {
+    if (cancelled_.load()) {
+      if (max_pending > 0) {
+        return FileError::kCancelled;
+      }
+      // The buffers are about to be freed: cancel, then drain every read
+      if (!cancel_issued) {
+        for (AsyncReadContext* ctx : pending_reads_) {
+          CancelIoEx(handle_, &ctx->overlapped);
+        }
+        cancel_issued = true;
+      }
+    }
+
+    bool completed_any = false;
+    for (auto it = pending_reads_.begin(); it != pending_reads_.end();) {
+      AsyncReadContext* ctx = *it;
+      if (!HasOverlappedIoCompleted(&ctx->overlapped)) {
+        ++it;
+        continue;
+      }
+      it = pending_reads_.erase(it);
+
+      DWORD bytes_read = 0;
+      FileError error = FileError::kSuccess;
+      if (!GetOverlappedResult(handle_, &ctx->overlapped, &bytes_read, FALSE)) {
+        DWORD err = GetLastError();
+        bytes_read = 0;
+        if (err == ERROR_OPERATION_ABORTED) {
+          error = FileError::kCancelled;
+        } else if (err != ERROR_HANDLE_EOF) {
+          error = FileError::kReadError;
+          last_error_code_ = err;
+          std::ostringstream oss;
+          oss << "Async read failed, error: " << err;
+          Log(oss.str());
+        }
+      }
+      CloseHandle(ctx->event);
+      RPI_TRACE2(io_read_complete,
+                 (static_cast<std::uint64_t>(ctx->overlapped.OffsetHigh) << 32) | ctx->overlapped.Offset,
+                 error == FileError::kSuccess ? static_cast<std::int64_t>(bytes_read) : -1);
+      if (ctx->callback) {
+        ctx->callback(error, static_cast<std::size_t>(bytes_read));
+      }
+      delete ctx;
+      completed_any = true;
+    }
+
+    if (!completed_any && !pending_reads_.empty()) {
+      HANDLE events[MAXIMUM_WAIT_OBJECTS];
+      DWORD count = static_cast<DWORD>(std::min<std::size_t>(pending_reads_.size(), MAXIMUM_WAIT_OBJECTS));
+      for (DWORD i = 0; i < count; ++i) {
+        events[i] = pending_reads_[i]->event;
+      }
+      WaitForMultipleObjects(count, events, FALSE, kWaitTimeoutMs);
+    }
+  }
+
+  return cancelled_.load() ? FileError::kCancelled : FileError::kSuccess;
+}
+
 void WindowsFileOperations::PollAsyncCompletions() {
   if (iocp_ != INVALID_HANDLE_VALUE && pending_writes_.load() > 0) {
     ProcessCompletions(false);  // Non-blocking poll
@@ -1661,10 +1924,37 @@ void WindowsFileOperations::ReduceQueueDepthForRecovery(int newDepth) {
   // This naturally throttles new writes until pending count drops.
 }
 
+bool WindowsFileOperations::ResumeAsyncAfterSyncFallback(int depth) {
+  if (!sync_fallback_mode_ || iocp_ == INVALID_HANDLE_VALUE || depth <= 1 ||
+      pending_writes_.load() > 0 || first_async_error_ != FileError::kSuccess) {
+    return false;
+  }
+
+  // Sync writes kept async_write_offset_ up to date, so queueing carries on from there
+  async_queue_depth_ = depth;
+  sync_fallback_mode_ = false;
+
+  Log("Resumed async writes after sync fallback at queue depth " + std::to_string(depth));
+  return true;
+}
+
+void WindowsFileOperations::RestoreQueueDepthAfterRecovery(int newDepth) {
+  int oldDepth = async_queue_depth_;
+  if (newDepth <= oldDepth || sync_fallback_mode_) {
+    return;
+  }
+
+  // The same queue-full check lets more writes through from now on
+  async_queue_depth_ = newDepth;
+
+  Log("Queue depth restored after recovery: " + std::to_string(oldDepth) + " -> " + std::to_string(newDepth));
+}
+
 // Query device I/O limits via IOCTL_STORAGE_QUERY_PROPERTY.
-// Opens the device read-only and queries up to two properties:
-//   1. StorageAdapterProperty — MaximumTransferLength, CommandQueueing, BusType
-//   2. StorageDeviceIoCapabilityProperty (Win10 1607+) — exact LunMaxIoCount
+// Opens the device read-only and queries up to three properties:
+//   1. StorageAdapterProperty — MaximumTransferLength, AlignmentMask, CommandQueueing, BusType
+//   2. StorageAccessAlignmentProperty — logical and physical sector size
+//   3. StorageDeviceIoCapabilityProperty (Win10 1607+) — exact LunMaxIoCount
 // The IoCapability query gives the real device queue depth when available;
 // BusType + CommandQueueing is the fallback heuristic on older Windows.
 FileOperations::DeviceIOLimits QueryPlatformDeviceIOLimits(const std::string& path) {
@@ -1703,6 +1993,26 @@ FileOperations::DeviceIOLimits QueryPlatformDeviceIOLimits(const std::string& pa
 
   if (haveAdapter && adapterDesc.MaximumTransferLength > 0)
     limits.max_transfer_bytes = static_cast<size_t>(adapterDesc.MaximumTransferLength);
+  if (haveAdapter)
+    limits.io_alignment_bytes = static_cast<size_t>(adapterDesc.AlignmentMask) + 1;
+
+  // --- Access alignment descriptor: sector sizes ---
+  // FILE_FLAG_NO_BUFFERING requires offsets and lengths in whole logical
+  // sectors, and buffers aligned to the larger of that and the adapter's
+  // AlignmentMask. Writing whole physical sectors avoids a read-modify-write
+  // inside 512e drives and card firmware.
+  query.PropertyId = StorageAccessAlignmentProperty;
+  query.QueryType = PropertyStandardQuery;
+  STORAGE_ACCESS_ALIGNMENT_DESCRIPTOR alignDesc = {};
+  if (DeviceIoControl(h, IOCTL_STORAGE_QUERY_PROPERTY,
+                      &query, sizeof(query),
+                      &alignDesc, sizeof(alignDesc),
+                      &bytesReturned, nullptr)
+      && bytesReturned >= offsetof(STORAGE_ACCESS_ALIGNMENT_DESCRIPTOR, BytesOffsetForCacheAlignment)) {
+    limits.io_alignment_bytes = std::max(limits.io_alignment_bytes,
+                                         static_cast<size_t>(alignDesc.BytesPerLogicalSector));
+    limits.physical_sector_bytes = static_cast<size_t>(alignDesc.BytesPerPhysicalSector);
+  }
 
   // --- IoCapability descriptor: exact device queue depth (Win10 1607+) ---
   // StorageDeviceIoCapabilityProperty = 48.  LunMaxIoCount is the actual max
@@ -14,6 +14,7 @@
 #include <chrono>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace rpi_imager {
 
@@ -42,6 +43,8 @@ class WindowsFileOperations : public FileOperations {
   // Streaming I/O operations
   FileError WriteSequential(const std::uint8_t* data, std::size_t size) override;
   FileError ReadSequential(std::uint8_t* data, std::size_t size, std::size_t& bytes_read) override;
+  FileError ReadAtOffset(std::uint64_t offset, std::uint8_t* data,
+                         std::size_t size, std::size_t& bytes_read) override;
   
   // File positioning
   FileError Seek(std::uint64_t position) override;
@@ -50,9 +53,13 @@ class WindowsFileOperations : public FileOperations {
   // Sync operations
   FileError ForceSync() override;
   FileError Flush() override;
+  FileError SyncToDevice() override;
   
   // Sequential read optimization
   void PrepareForSequentialRead(std::uint64_t offset, std::uint64_t length) override;
+
+  // Whole-device erase (IOCTL_STORAGE_MANAGE_DATA_SET_ATTRIBUTES trim)
+  FileError EraseDevice() override;
   
   // Handle access (Windows uses HANDLE, so we return a cast to int)
   int GetHandle() const override;
@@ -84,12 +91,18 @@ class WindowsFileOperations : public FileOperations {
   FileError AsyncWriteSequential(const std::uint8_t* data, std::size_t size, 
                                   AsyncWriteCallback callback = nullptr) override;
   int GetPendingWriteCount() const override { return pending_writes_.load(); }
+  FileError AsyncReadSequential(std::uint8_t* data, std::size_t size,
+                                AsyncReadCallback callback = nullptr) override;
+  FileError WaitForPendingReads(int max_pending = 0) override;
+  int GetPendingReadCount() const override { return static_cast<int>(pending_reads_.size()); }
   void PollAsyncCompletions() override;
   FileError WaitForPendingWrites() override;
   void CancelAsyncIO() override;
   void DiagnoseStuckWrites();  // Debug helper to check actual I/O state
   std::vector<PendingWriteInfo> GetPendingWritesSorted() const override;
   void ReduceQueueDepthForRecovery(int newDepth) override;
+  void RestoreQueueDepthAfterRecovery(int newDepth) override;
+  bool ResumeAsyncAfterSyncFallback(int depth) override;
   // GetAsyncIOStats() inherited from FileOperations base class
 
  private:
@@ -120,6 +133,15 @@ class WindowsFileOperations : public FileOperations {
   
   mutable std::mutex pending_mutex_;
   std::unordered_map<OVERLAPPED*, AsyncWriteContext*> pending_contexts_;
+
+  // Async reads signal a per-read event instead of the IOCP port and are
+  // collected by WaitForPendingReads() on the reading thread, oldest first
+  struct AsyncReadContext {
+    OVERLAPPED overlapped;
+    HANDLE event;
+    AsyncReadCallback callback;
+  };
+  std::vector<AsyncReadContext*> pending_reads_;
   
   // Note: write_latency_stats_ is inherited from FileOperations base class
   
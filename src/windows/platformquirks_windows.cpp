@@ -14,11 +14,13 @@
 #include <wbemidl.h>
 #include <oleauto.h>
 #include <iphlpapi.h>
+#include <powrprof.h>
 #include <string>
 #include <algorithm>
 #include <cctype>
 #include <cstdio>
 #include <iostream>
+#include <mutex>
 #include <QProcess>
 #include <QDebug>
 #include <QFont>
@@ -752,6 +754,70 @@ DiskResult ejectDisk(const QString& device) {
     return result;
 }
 
+// USB settings subgroup and its "USB selective suspend setting" in power schemes
+static const GUID kUsbPowerSubgroup = {0x2a737441, 0x1930, 0x4402, {0x8d, 0x77, 0xb2, 0xbe, 0xbb, 0xa3, 0x08, 0xa3}};
+static const GUID kUsbSelectiveSuspend = {0x48e6b7a6, 0x50f5, 0x4782, {0xa5, 0xd4, 0x53, 0xbb, 0x8f, 0x07, 0xe2, 0x26}};
+
+// Selective suspend is one setting for all devices, so it is turned off
+// for the first device held and back on when the last is released
+static std::mutex powerHoldMutex;
+static QStringList powerHoldDevices;
+static DWORD powerHoldAc = 0;
+static DWORD powerHoldDc = 0;
+
+static bool writeSelectiveSuspend(DWORD ac, DWORD dc) {
+    GUID* scheme = nullptr;
+    if (PowerGetActiveScheme(nullptr, &scheme) != ERROR_SUCCESS)
+        return false;
+    const bool ok = PowerWriteACValueIndex(nullptr, scheme, &kUsbPowerSubgroup, &kUsbSelectiveSuspend, ac) == ERROR_SUCCESS
+                 && PowerWriteDCValueIndex(nullptr, scheme, &kUsbPowerSubgroup, &kUsbSelectiveSuspend, dc) == ERROR_SUCCESS
+                 && PowerSetActiveScheme(nullptr, scheme) == ERROR_SUCCESS;  // Applies the new values
+    LocalFree(scheme);
+    return ok;
+}
+
+QString holdDevicePowerOn(const QString& device) {
+    if (!device.contains("PhysicalDrive", Qt::CaseInsensitive))
+        return {};
+
+    std::lock_guard<std::mutex> lock(powerHoldMutex);
+    if (powerHoldDevices.contains(device))
+        return {};
+    if (!powerHoldDevices.isEmpty()) {
+        powerHoldDevices.append(device);
+        return QStringLiteral("USB selective suspend off");
+    }
+
+    GUID* scheme = nullptr;
+    if (PowerGetActiveScheme(nullptr, &scheme) != ERROR_SUCCESS)
+        return {};
+    DWORD ac = 0, dc = 0;
+    const bool read = PowerReadACValueIndex(nullptr, scheme, &kUsbPowerSubgroup, &kUsbSelectiveSuspend, &ac) == ERROR_SUCCESS
+                   && PowerReadDCValueIndex(nullptr, scheme, &kUsbPowerSubgroup, &kUsbSelectiveSuspend, &dc) == ERROR_SUCCESS;
+    LocalFree(scheme);
+    if (!read || (ac == 0 && dc == 0))
+        return {};
+
+    if (!writeSelectiveSuspend(0, 0)) {
+        qDebug() << "holdDevicePowerOn: cannot turn off USB selective suspend";
+        writeSelectiveSuspend(ac, dc);
+        return {};
+    }
+    powerHoldAc = ac;
+    powerHoldDc = dc;
+    powerHoldDevices.append(device);
+    qDebug() << "holdDevicePowerOn: USB selective suspend off, was AC" << ac << "DC" << dc;
+    return QStringLiteral("USB selective suspend AC %1 DC %2 -> off").arg(ac).arg(dc);
+}
+
+void releaseDevicePower(const QString& device) {
+    std::lock_guard<std::mutex> lock(powerHoldMutex);
+    if (!powerHoldDevices.removeOne(device) || !powerHoldDevices.isEmpty())
+        return;
+    if (!writeSelectiveSuspend(powerHoldAc, powerHoldDc))
+        qDebug() << "releaseDevicePower: cannot restore USB selective suspend";
+}
+
 // Test API for unit testing internal functions
 #ifdef PLATFORMQUIRKS_ENABLE_TEST_API
 namespace TestAPI {
@@ -34,8 +34,11 @@ WizardStepBase {
     // Initialize the component
     Component.onCompleted: {
         // Load capital cities, timezones and keyboard layout data
+        comboCapitalCity.searchKeys = imageWriter.getCapitalCitiesSearchKeys()
         comboCapitalCity.model = imageWriter.getCapitalCitiesList()
+        comboTimezone.searchKeys = imageWriter.getTimezoneSearchKeys()
         comboTimezone.model = imageWriter.getTimezoneList()
+        comboKeyboard.searchKeys = imageWriter.getKeymapLayoutSearchKeys()
         comboKeyboard.model = imageWriter.getKeymapLayoutList()
 
         // Start with no selection so the user must make an active choice
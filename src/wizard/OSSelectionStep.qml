@@ -135,15 +135,16 @@ WizardStepBase {
             }
             
             // If model was loaded with just Erase/Use custom (2 items) but now we have more,
-            // we need a full reload, not just softRefresh
+            // treat it as the first load
             var needsFullReload = !root.modelLoaded || (root.osmodel && root.osmodel.rowCount() <= 2)
             
             if (needsFullReload) {
                 root.modelLoaded = false  // Reset so handler does full reload
                 onOsListPreparedHandler()
-            } else if (root.osmodel && typeof root.osmodel.softRefresh === "function") {
-                // Just updating existing data (e.g., sublist loaded)
-                root.osmodel.softRefresh()
+            } else if (root.osmodel) {
+                // A new list replaced the one shown; sublists that arrive
+                // later update their rows in the model directly
+                root.osmodel.reload()
             }
         }
         function onOsListUnavailableChanged() {
@@ -348,6 +349,10 @@ WizardStepBase {
                             root.handleOSNavigation(modelData)
                         }
                         
+                        onIconsInView: function(visibleIcons, upcomingIcons) {
+                            root.imageWriter.setVisibleOsIcons(visibleIcons, upcomingIcons)
+                        }
+                        
                         Component.onCompleted: {
                             root.initializeListViewFocus(oslist)
                         }
@@ -385,6 +390,15 @@ WizardStepBase {
             // Using ListView.view directly in bindings can be unreliable, so we cache it here.
             // This enables proper highlighting for both keyboard and mouse navigation in all lists.
             property var parentListView: ListView.view
+            property bool isHighlighted: (parentListView && parentListView.currentIndex === index) || osMouseArea.containsMouse
+            
+            // Connect to the image host while the user is still deciding, so
+            // the download does not start with DNS, TCP and TLS round trips
+            onIsHighlightedChanged: {
+                if (isHighlighted) {
+                    imageWriter.preconnect(url)
+                }
+            }
             
             width: parentListView ? parentListView.width : 200
             // Let content determine height for balanced vertical padding
@@ -595,6 +609,10 @@ WizardStepBase {
                 root.handleOSNavigation(modelData)
             }
             
+            onIconsInView: function(visibleIcons, upcomingIcons) {
+                root.imageWriter.setVisibleOsIcons(visibleIcons, upcomingIcons)
+            }
+            
             onLeftPressed: {
                 console.log("Sublist onLeftPressed handler called")
                 root.handleBackNavigation()
@@ -640,6 +658,10 @@ WizardStepBase {
         if (isOSsublist(model)) {
             // Navigate to sublist (whether navigateOnly is true or false)
             categorySelected = model.name
+            // Its list may still be queued behind other sublists; fetch it next
+            if (typeof(model.subitems_url) === "string" && model.subitems_url !== "") {
+                imageWriter.prioritizeSublist(model.subitems_url)
+            }
             var lm = newSublist()
             populateSublistInto(lm, model)
             // Navigate to sublist
@@ -727,9 +749,12 @@ WizardStepBase {
                     model.name,
                     typeof(model.init_format) != "undefined" ? model.init_format : "",
                     typeof(model.release_date) != "undefined" ? model.release_date : "",
-                    typeof(model.bmap_url) != "undefined" ? model.bmap_url : ""
+                    typeof(model.bmap_url) != "undefined" ? model.bmap_url : "",
+                    typeof(model.mirrors) != "undefined" ? model.mirrors : []
                 )
                 imageWriter.setSWCapabilitiesList(model.capabilities)
+                // Download in the background while the rest of the wizard is completed
+                imageWriter.startPrefetch()
 
                 root.wizardContainer.selectedOsName = model.name
                 root.wizardContainer.customizationSupported = imageWriter.imageSupportsCustomization()
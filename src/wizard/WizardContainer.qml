@@ -16,7 +16,6 @@ Item {
     
     required property ImageWriter imageWriter
     property int sidebarWidthValue: Style.sidebarWidth
-    property var optionsPopup: null
     // Show landing language selection step at startup
     property bool showLanguageSelection: false
     // Reference to the full-window overlay root for dialog parenting
@@ -145,6 +144,8 @@ Item {
     readonly property int stepDone: 12
     
     signal wizardCompleted()
+    // App Options button; the dialog is created by main.qml on first use
+    signal optionsRequested()
     signal updatePopupRequested(url updateUrl, string version)
     
     // Focus anchor for global keyboard navigation
@@ -697,17 +698,7 @@ Item {
                     text: qsTr("App Options")
                     accessibleDescription: qsTr("Open application settings to configure sound alerts, auto-eject, telemetry, and content repository")
                     activeFocusOnTab: true
-                    onClicked: {
-                        if (root.optionsPopup) {
-                            if (!root.optionsPopup.wizardContainer) {
-                                root.optionsPopup.wizardContainer = root
-                            }
-                            // TODO: actually duplicate
-                            // as onOpen in it already calls initialize()
-                            root.optionsPopup.initialize()
-                            root.optionsPopup.open()
-                        }
-                    }
+                    onClicked: root.optionsRequested()
                 }
             }
         }
@@ -1516,27 +1507,6 @@ Item {
         }
     }
     
-    function onDownloadProgress(now, total) {
-        // Forward to the WritingStep if currently active
-        if (currentStep === stepWriting && wizardStack.currentItem) {
-            wizardStack.currentItem.onDownloadProgress(now, total)
-        }
-    }
-    
-    function onWriteProgress(now, total) {
-        // Forward to the WritingStep if currently active
-        if (currentStep === stepWriting && wizardStack.currentItem) {
-            wizardStack.currentItem.onWriteProgress(now, total)
-        }
-    }
-    
-    function onVerifyProgress(now, total) {
-        // Forward to the WritingStep if currently active
-        if (currentStep === stepWriting && wizardStack.currentItem) {
-            wizardStack.currentItem.onVerifyProgress(now, total)
-        }
-    }
-    
     function onPreparationStatusUpdate(msg) {
         // Forward to the WritingStep if currently active
         if (currentStep === stepWriting && wizardStack.currentItem) {
@@ -71,6 +71,8 @@ WizardStepBase {
     readonly property bool isComplete: imageWriter.writeState === ImageWriter.Succeeded
     property string bottleneckStatus: ""
     property int writeThroughputKBps: 0
+    property int secondsRemaining: 0  // Estimate from the backend; 0 if not known
+    property string timeLimitedBy: ""  // Stage the estimate mostly waits on: "download", "decompress", "write" or "verify"
     property string operationWarning: ""  // Non-fatal warning message (e.g., sync fallback)
     property bool isIndeterminateProgress: false  // True when we can't determine accurate progress (e.g., gz files >4GB)
     readonly property bool anyCustomizationsApplied: (
@@ -327,8 +329,9 @@ WizardStepBase {
                 value: 0
                 from: 0
                 to: 100
+                // The indeterminate animation repaints every frame; the text shows the bytes written
                 indeterminate: root.isIndeterminateProgress && !root.isVerifying && !root.isFinalising
-                               && !PlatformHelper.prefersReducedMotion
+                               && !PlatformHelper.prefersReducedMotion && !imageWriter.lowRenderMode
 
                 Material.accent: Style.progressBarVerifyForegroundColor
                 Material.background: Style.progressBarBackgroundColor
@@ -338,24 +341,35 @@ WizardStepBase {
                 Accessible.description: progressText.text
             }
             
-            // Bottleneck status indicator - shows what's limiting progress
+            // Bottleneck status indicator - shows what's limiting progress and the time left
             Text {
                 id: bottleneckText
                 text: {
+                    var parts = []
                     if (root.bottleneckStatus !== "") {
                         if (root.writeThroughputKBps > 0) {
-                            return root.bottleneckStatus + " (" + Math.round(root.writeThroughputKBps / 1024) + " MB/s)"
+                            parts.push(root.bottleneckStatus + " (" + Math.round(root.writeThroughputKBps / 1024) + " MB/s)")
+                        } else {
+                            parts.push(root.bottleneckStatus)
                         }
-                        return root.bottleneckStatus
                     }
-                    return ""
+                    if (root.secondsRemaining > 0 && !root.isFinalising) {
+                        parts.push(root.formatTimeRemaining(root.secondsRemaining))
+                        // Writing or verifying is the usual limit; only call out the others
+                        if (root.timeLimitedBy === "download") {
+                            parts.push(qsTr("limited by download speed"))
+                        } else if (root.timeLimitedBy === "decompress") {
+                            parts.push(qsTr("limited by decompression"))
+                        }
+                    }
+                    return parts.join(" · ")
                 }
                 font.pointSize: Style.fontSizeSmall
                 font.family: Style.fontFamily
                 color: Style.formLabelDisabledColor
                 Layout.fillWidth: true
                 horizontalAlignment: Text.AlignHCenter
-                visible: root.isWriting && root.bottleneckStatus !== ""
+                visible: root.isWriting && text !== ""
             }
             
             // Operation warning (e.g., sync fallback due to slow device)
@@ -568,6 +582,8 @@ WizardStepBase {
             root.forceActiveFocus()
             root.bottleneckStatus = ""
             root.writeThroughputKBps = 0
+            root.secondsRemaining = 0
+            root.timeLimitedBy = ""
             root.operationWarning = ""
             // Check if extract size is known upfront (e.g., gz files can't reliably store sizes >4GB)
             root.isIndeterminateProgress = !imageWriter.isExtractSizeKnown()
@@ -577,32 +593,15 @@ WizardStepBase {
         }
     }
 
-    function onDownloadProgress(now, total) {
-        // Download progress is tracked for performance stats but not shown in UI
-        // (the write progress is more accurate as it reflects actual data written to disk)
-    }
-
-    function onWriteProgress(now, total) {
-        if (root.isWriting) {
-            if (root.isIndeterminateProgress) {
-                // Show indeterminate progress with bytes written (in human-readable format)
-                var bytesWrittenMB = Math.round(now / (1024 * 1024))
-                progressText.text = qsTr("Writing... %1 MB written").arg(bytesWrittenMB)
-            } else {
-                var progress = total > 0 ? (now / total) * 100 : 0
-                progressBar.value = progress
-                progressText.text = qsTr("Writing... %1%").arg(Math.round(progress))
-            }
+    function formatTimeRemaining(seconds) {
+        if (seconds < 60) {
+            return qsTr("Less than a minute left")
         }
-    }
-
-    function onVerifyProgress(now, total) {
-        if (root.isWriting) {
-            root.operationWarning = ""  // Clear write warnings during verification
-            var progress = total > 0 ? (now / total) * 100 : 0
-            progressBar.value = progress
-            progressText.text = qsTr("Verifying... %1%").arg(Math.round(progress))
+        var minutes = Math.round(seconds / 60)
+        if (minutes < 60) {
+            return qsTr("About %1 min left").arg(minutes)
         }
+        return qsTr("About %1 h %2 min left").arg(Math.floor(minutes / 60)).arg(minutes % 60)
     }
 
     function onPreparationStatusUpdate(msg) {
@@ -614,6 +613,32 @@ WizardStepBase {
     // Update isWriting state when write completes
     Connections {
         target: imageWriter
+        // Download progress is tracked for performance stats but not shown
+        // (the write progress reflects the data actually written to disk)
+        function onProgressChanged() {
+            var p = imageWriter.progress
+            // Until something is written, keep showing the preparation status
+            if (!root.isWriting || (p.writeNow === 0 && p.verifyTotal === 0))
+                return
+            var progress
+            // In low-render mode the bar moves in whole percent, so snapshots
+            // that change nothing visible do not repaint the scene
+            var lowRender = imageWriter.lowRenderMode
+            if (p.verifyTotal > 0) {
+                root.operationWarning = ""  // Clear write warnings during verification
+                progress = (p.verifyNow / p.verifyTotal) * 100
+                progressBar.value = lowRender ? Math.floor(progress) : progress
+                progressText.text = qsTr("Verifying... %1%").arg(Math.round(progress))
+            } else if (root.isIndeterminateProgress) {
+                // Show indeterminate progress with bytes written (in human-readable format)
+                var bytesWrittenMB = Math.round(p.writeNow / (1024 * 1024))
+                progressText.text = qsTr("Writing... %1 MB written").arg(bytesWrittenMB)
+            } else {
+                progress = p.writeTotal > 0 ? (p.writeNow / p.writeTotal) * 100 : 0
+                progressBar.value = lowRender ? Math.floor(progress) : progress
+                progressText.text = qsTr("Writing... %1%").arg(Math.round(progress))
+            }
+        }
         function onSuccess() {
             progressText.text = qsTr("Write completed successfully!")
 
@@ -635,6 +660,11 @@ WizardStepBase {
             root.bottleneckStatus = status
             root.writeThroughputKBps = throughputKBps
         }
+
+        function onTimeRemainingChanged(seconds, limitedBy) {
+            root.secondsRemaining = seconds
+            root.timeLimitedBy = limitedBy
+        }
         
         function onOperationWarning(message) {
             root.operationWarning = message
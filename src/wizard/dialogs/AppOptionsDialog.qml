@@ -35,6 +35,7 @@ BaseDialog {
     implicitWidth: Math.max(
         chkBeep.naturalWidth,
         chkEject.naturalWidth,
+        chkEraseBeforeWrite.naturalWidth,
         chkTelemetry.naturalWidth,
         chkDisableWarnings.naturalWidth,
         chkConnectOrg.naturalWidth,
@@ -53,7 +54,7 @@ BaseDialog {
             return []
         }, 0)
         registerFocusGroup("options", function(){
-            var items = [chkBeep.focusItem, chkEject.focusItem,
+            var items = [chkBeep.focusItem, chkEject.focusItem, chkEraseBeforeWrite.focusItem,
                          chkDisableWarnings.focusItem, editRepoButton.focusItem]
             // Only include secure boot key button if visible
             if (secureBootKeyButton.visible)
@@ -130,6 +131,16 @@ BaseDialog {
                 }
             }
 
+            ImOptionPill {
+                id: chkEraseBeforeWrite
+                text: qsTr("Erase storage device before writing")
+                accessibleDescription: qsTr("Discard all data on the storage device before writing, so it starts from a clean state. Skipped on devices that do not support it")
+                Layout.fillWidth: true
+                Component.onCompleted: {
+                    focusItem.activeFocusOnTab = true
+                }
+            }
+
             ImOptionPill {
                 id: chkDisableWarnings
                 text: qsTr("Disable warnings")
@@ -372,6 +383,8 @@ BaseDialog {
         // Only enable beep if it's both saved as enabled AND available on this system
         chkBeep.checked = imageWriter.getBoolSetting("beep") && imageWriter.isBeepAvailable();
         chkEject.checked = imageWriter.getBoolSetting("eject");
+        // Session-only, like disable warnings
+        chkEraseBeforeWrite.checked = imageWriter.getEraseBeforeWrite();
         chkTelemetry.checked = imageWriter.getBoolSetting("telemetry");
         // Do not load from QSettings; keep ephemeral
         chkDisableWarnings.checked = popup.wizardContainer ? popup.wizardContainer.disableWarnings : false;
@@ -402,6 +415,7 @@ BaseDialog {
         // Only save beep as enabled if it's actually available on this system
         imageWriter.setSetting("beep", chkBeep.checked && imageWriter.isBeepAvailable());
         imageWriter.setSetting("eject", chkEject.checked);
+        imageWriter.setEraseBeforeWrite(chkEraseBeforeWrite.checked);
         imageWriter.setSetting("telemetry", chkTelemetry.checked);
         imageWriter.setSetting("secureboot_rsa_key", rsaKeyPath.text);
         // Feature flag only — the stored organisation API key is
@@ -36,7 +36,7 @@ BaseDialog {
             return []
         }, 0)
         registerFocusGroup("options", function(){
-            return [chkDirectIO.focusItem, chkAsyncIO.focusItem, chkIgnoreDeviceLimits.focusItem, chkPeriodicSync.focusItem, chkVerboseLogging.focusItem, chkIPv4Only.focusItem, chkSkipEndOfDevice.focusItem, chkRpiboot.focusItem, browseGadgetButton, chkForceSecureBoot.focusItem, chkSignFastbootGadget.focusItem]
+            return [chkDirectIO.focusItem, chkAsyncIO.focusItem, chkIgnoreDeviceLimits.focusItem, chkPeriodicSync.focusItem, chkPipelinedVerify.focusItem, chkImageCache.focusItem, chkServeCache.focusItem, chkCachePeers.focusItem, chkPrefetch.focusItem, chkVerboseLogging.focusItem, chkIPv4Only.focusItem, chkParallelDownload.focusItem, chkHttp3.focusItem, chkSkipEndOfDevice.focusItem, chkRpiboot.focusItem, browseGadgetButton, chkForceSecureBoot.focusItem, chkSignFastbootGadget.focusItem]
         }, 1)
         registerFocusGroup("buttons", function(){ 
             return [cancelButton, applyButton]
@@ -210,6 +210,56 @@ BaseDialog {
                 }
             }
 
+            ImOptionPill {
+                id: chkPipelinedVerify
+                text: qsTr("Verify While Writing")
+                accessibleDescription: qsTr("Read back and check data that has already reached the storage device while the rest of the image is still being written. Needs Periodic Sync or Direct I/O.")
+                Layout.fillWidth: true
+                Component.onCompleted: {
+                    focusItem.activeFocusOnTab = true
+                }
+            }
+
+            ImOptionPill {
+                id: chkImageCache
+                text: qsTr("Cache Decompressed Image")
+                accessibleDescription: qsTr("Also keep the decompressed image in the cache, so writing the same image again skips downloading and decompressing. Uses up to the full image size of disk space.")
+                Layout.fillWidth: true
+                Component.onCompleted: {
+                    focusItem.activeFocusOnTab = true
+                }
+            }
+
+            ImOptionPill {
+                id: chkServeCache
+                text: qsTr("Share Cache on Local Network")
+                accessibleDescription: qsTr("Let other Raspberry Pi Imagers on the local network download cached images from this computer, so each image is only downloaded from the internet once.")
+                Layout.fillWidth: true
+                Component.onCompleted: {
+                    focusItem.activeFocusOnTab = true
+                }
+            }
+
+            ImOptionPill {
+                id: chkCachePeers
+                text: qsTr("Download From Local Network")
+                accessibleDescription: qsTr("Download images from other Raspberry Pi Imagers on the local network that share their cache, if they have them. Images are checked as usual, and downloaded from the internet otherwise.")
+                Layout.fillWidth: true
+                Component.onCompleted: {
+                    focusItem.activeFocusOnTab = true
+                }
+            }
+
+            ImOptionPill {
+                id: chkPrefetch
+                text: qsTr("Download in Background")
+                accessibleDescription: qsTr("Start downloading the selected operating system into the cache straight away, at limited speed, while you choose the storage device and customisation options.")
+                Layout.fillWidth: true
+                Component.onCompleted: {
+                    focusItem.activeFocusOnTab = true
+                }
+            }
+
             // Spacer
             Item {
                 Layout.preferredHeight: Style.spacingMedium
@@ -260,6 +310,29 @@ BaseDialog {
                 }
             }
 
+            ImOptionPill {
+                id: chkParallelDownload
+                text: qsTr("Parallel Downloads")
+                accessibleDescription: qsTr("Download images over several connections at once using HTTP range requests. Falls back to a single connection if the server does not support ranges.")
+                Layout.fillWidth: true
+                Component.onCompleted: {
+                    focusItem.activeFocusOnTab = true
+                }
+            }
+
+            ImOptionPill {
+                id: chkHttp3
+                text: qsTr("HTTP/3 (QUIC) Downloads")
+                accessibleDescription: imageWriter.isHttp3Available()
+                    ? qsTr("Download images over QUIC, which copes better with lossy cellular and satellite links. Falls back to HTTP/2 if the server or network does not allow it.")
+                    : qsTr("Not available: this build does not include HTTP/3 support.")
+                enabled: imageWriter.isHttp3Available()
+                Layout.fillWidth: true
+                Component.onCompleted: {
+                    focusItem.activeFocusOnTab = true
+                }
+            }
+
             // Spacer
             Item {
                 Layout.preferredHeight: Style.spacingMedium
@@ -461,7 +534,14 @@ BaseDialog {
                             lines.push("Direct I/O: " + (chkDirectIO.checked ? "Enabled" : "Disabled"));
                             lines.push("Async I/O: " + (chkAsyncIO.checked ? "Enabled (depth " + depth + ", ~" + depth + "-" + (depth * 8) + " MB)" : "Disabled"));
                             lines.push("Periodic Sync: " + (chkPeriodicSync.checked ? "Enabled" : "Disabled"));
+                            lines.push("Verify While Writing: " + (chkPipelinedVerify.checked ? "Enabled" : "Disabled"));
+                            lines.push("Decompressed Image Cache: " + (chkImageCache.checked ? "Enabled" : "Disabled"));
+                            lines.push("Share Cache on LAN: " + (chkServeCache.checked ? "Enabled" : "Disabled"));
+                            lines.push("Download From LAN: " + (chkCachePeers.checked ? "Enabled" : "Disabled"));
+                            lines.push("Background Download: " + (chkPrefetch.checked ? "Enabled" : "Disabled"));
                             lines.push("IPv4-only: " + (chkIPv4Only.checked ? "Enabled" : "Disabled"));
+                            lines.push("Parallel Downloads: " + (chkParallelDownload.checked ? "Enabled" : "Disabled"));
+                            lines.push("HTTP/3: " + (!imageWriter.isHttp3Available() ? "Not available" : (chkHttp3.checked ? "Enabled" : "Disabled")));
                             lines.push("Counterfeit Card Mode: " + (chkSkipEndOfDevice.checked ? "Enabled" : "Disabled"));
                             lines.push("Rpiboot/Fastboot: " + (chkRpiboot.checked ? "Enabled" : "Disabled"));
                             if (chkRpiboot.checked && gadgetPathText.gadgetPath)
@@ -543,9 +623,16 @@ BaseDialog {
             chkAsyncIO.checked = imageWriter.getDebugAsyncIO();
             asyncQueueDepthSlider.value = imageWriter.getDebugAsyncQueueDepth();
             chkPeriodicSync.checked = imageWriter.getDebugPeriodicSync();
+            chkPipelinedVerify.checked = imageWriter.getDebugPipelinedVerify();
+            chkImageCache.checked = imageWriter.getImageCacheEnabled();
+            chkServeCache.checked = imageWriter.getCachePeerServing();
+            chkCachePeers.checked = imageWriter.getCachePeersEnabled();
+            chkPrefetch.checked = imageWriter.getCachePrefetchEnabled();
             chkVerboseLogging.checked = imageWriter.getDebugVerboseLogging();
             chkIPv4Only.checked = imageWriter.getDebugIPv4Only();
             chkIgnoreDeviceLimits.checked = imageWriter.getDebugIgnoreDeviceLimits();
+            chkParallelDownload.checked = imageWriter.getDebugParallelDownload();
+            chkHttp3.checked = imageWriter.getHttp3Enabled();
             chkSkipEndOfDevice.checked = imageWriter.getDebugSkipEndOfDevice();
             chkRpiboot.checked = imageWriter.getDebugRpiboot();
             gadgetPathText.gadgetPath = imageWriter.getDebugCustomFastbootGadget();
@@ -563,9 +650,20 @@ BaseDialog {
         imageWriter.setDebugAsyncIO(chkAsyncIO.checked);
         imageWriter.setDebugAsyncQueueDepth(Math.round(asyncQueueDepthSlider.value));
         imageWriter.setDebugPeriodicSync(chkPeriodicSync.checked);
+        imageWriter.setDebugPipelinedVerify(chkPipelinedVerify.checked);
+        imageWriter.setImageCacheEnabled(chkImageCache.checked);
+        imageWriter.setCachePeerServing(chkServeCache.checked);
+        imageWriter.setSetting("cache/servePeers", chkServeCache.checked);
+        imageWriter.setCachePeersEnabled(chkCachePeers.checked);
+        imageWriter.setSetting("cache/usePeers", chkCachePeers.checked);
+        imageWriter.setCachePrefetchEnabled(chkPrefetch.checked);
+        imageWriter.setSetting("cache/prefetch", chkPrefetch.checked);
         imageWriter.setDebugVerboseLogging(chkVerboseLogging.checked);
         imageWriter.setDebugIPv4Only(chkIPv4Only.checked);
         imageWriter.setDebugIgnoreDeviceLimits(chkIgnoreDeviceLimits.checked);
+        imageWriter.setDebugParallelDownload(chkParallelDownload.checked);
+        imageWriter.setHttp3Enabled(chkHttp3.checked);
+        imageWriter.setSetting("network/http3", chkHttp3.checked);
         imageWriter.setDebugSkipEndOfDevice(chkSkipEndOfDevice.checked);
         imageWriter.setDebugRpiboot(chkRpiboot.checked);
         imageWriter.setDebugCustomFastbootGadget(gadgetPathText.gadgetPath || "");
@@ -576,8 +674,12 @@ BaseDialog {
                     ", AsyncIO=" + chkAsyncIO.checked +
                     ", AsyncQueueDepth=" + Math.round(asyncQueueDepthSlider.value) +
                     ", PeriodicSync=" + chkPeriodicSync.checked +
+                    ", PipelinedVerify=" + chkPipelinedVerify.checked +
+                    ", ImageCache=" + chkImageCache.checked +
                     ", VerboseLogging=" + chkVerboseLogging.checked +
                     ", IPv4Only=" + chkIPv4Only.checked +
+                    ", ParallelDownload=" + chkParallelDownload.checked +
+                    ", Http3=" + chkHttp3.checked +
                     ", SkipEndOfDevice=" + chkSkipEndOfDevice.checked +
                     ", Rpiboot=" + chkRpiboot.checked +
                     ", ForceSecureBoot=" + chkForceSecureBoot.checked +
@@ -0,0 +1,274 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "writeautotuner.h"
+
+#include <algorithm>
+
+namespace {
+
+// Write sizes must stay multiples of the largest direct I/O alignment
+constexpr size_t BlockAlignment = 4096;
+
+size_t alignBlock(size_t size)
+{
+    return size - (size % BlockAlignment);
+}
+
+} // namespace
+
+void WriteAutoTuner::begin(int maxQueueDepth, size_t maxBlockSize, int64_t nowMs)
+{
+    _maxQueueDepth = std::max(1, maxQueueDepth);
+    _maxBlockSize = maxBlockSize;
+    _probes.clear();
+    _best = Probe();
+    _learnable = true;
+    _blockPhase = false;
+    _averageLatencyUs = 0;
+    _lastBackoffMs = 0;
+
+    const int cap = _depthCap.load(std::memory_order_relaxed);
+    if (cap > 0)
+        _maxQueueDepth = std::min(_maxQueueDepth, cap);
+
+    // Phase 1: the configured depth first, as the baseline, then lower ones
+    _candidates.clear();
+    _candidates.push_back({_maxQueueDepth, 0});
+    if (_maxQueueDepth >= MinQueueDepth)
+    {
+        for (int divisor : {2, 4})
+        {
+            const int depth = _maxQueueDepth / divisor;
+            if (depth >= MinQueueDepth && depth != _candidates.back().queueDepth)
+                _candidates.push_back({depth, 0});
+        }
+    }
+
+    _state = State::Probing;
+    _setting = _candidates.front();
+    _candidates.erase(_candidates.begin());
+    _startCandidate(nowMs);
+}
+
+void WriteAutoTuner::beginLearned(const Setting &learned, int maxQueueDepth, size_t maxBlockSize, int64_t nowMs)
+{
+    (void)nowMs;
+    _maxQueueDepth = std::max(1, maxQueueDepth);
+    const int cap = _depthCap.load(std::memory_order_relaxed);
+    if (cap > 0)
+        _maxQueueDepth = std::min(_maxQueueDepth, cap);
+    _maxBlockSize = maxBlockSize;
+    _probes.clear();
+    _candidates.clear();
+    _averageLatencyUs = 0;
+    _lastBackoffMs = 0;
+
+    Setting setting;
+    setting.queueDepth = std::min(std::max(1, learned.queueDepth), _maxQueueDepth);
+    if (_maxQueueDepth >= MinQueueDepth)
+        setting.queueDepth = std::max(setting.queueDepth, MinQueueDepth);
+
+    const size_t block = alignBlock(learned.blockSize);
+    if (block >= MinBlockSize && block < maxBlockSize)
+        setting.blockSize = block;
+
+    _setting = setting;
+    _best = Probe();
+    _best.setting = setting;
+    _state = State::Settled;
+}
+
+void WriteAutoTuner::capQueueDepth(int depth)
+{
+    int current = _depthCap.load(std::memory_order_relaxed);
+    while ((current == 0 || depth < current) &&
+           !_depthCap.compare_exchange_weak(current, depth, std::memory_order_relaxed)) {}
+}
+
+void WriteAutoTuner::restoreQueueDepth(int depth)
+{
+    _depthCap.store(depth, std::memory_order_relaxed);
+    _depthRestore.store(depth, std::memory_order_relaxed);
+}
+
+WriteAutoTuner::Decision WriteAutoTuner::onWrite(uint64_t completedBytes, uint64_t callLatencyUs, int64_t nowMs)
+{
+    Decision decision;
+    if (_state == State::Idle)
+        return decision;
+
+    // A watchdog reduction wins over anything measured so far
+    const int cap = _depthCap.load(std::memory_order_relaxed);
+    if (cap > 0 && cap < _maxQueueDepth)
+    {
+        _maxQueueDepth = cap;
+        if (_state == State::Probing)
+        {
+            if (_best.throughputBps == 0)
+                _best.setting = _setting;
+            _settle();
+        }
+        if (_setting.queueDepth > cap)
+            _setting.queueDepth = cap;
+        decision.apply = true;
+        decision.reduceDepth = true;
+        decision.persist = true;
+        decision.reason = "capped by watchdog";
+        return decision;
+    }
+
+    const int restore = _depthRestore.exchange(0, std::memory_order_relaxed);
+    if (restore > _setting.queueDepth && _state == State::Settled)
+    {
+        _maxQueueDepth = std::max(_maxQueueDepth, restore);
+        _setting.queueDepth = restore;
+        _lastBackoffMs = nowMs;  // No spike back-off until the new depth has settled
+        decision.apply = true;
+        decision.persist = true;
+        decision.reason = "restored by watchdog";
+        return decision;
+    }
+
+    if (_state == State::Settled)
+    {
+        if (_setting.queueDepth <= MinQueueDepth)
+            return decision;
+
+        const bool spike = _averageLatencyUs > 0 &&
+                           callLatencyUs >= SpikeLatencyUs &&
+                           callLatencyUs >= _averageLatencyUs * SpikeFactor &&
+                           nowMs - _lastBackoffMs >= SpikeCooldownMs;
+        if (spike)
+        {
+            _setting.queueDepth = std::max(MinQueueDepth, _setting.queueDepth / 2);
+            _maxQueueDepth = _setting.queueDepth;
+            _lastBackoffMs = nowMs;
+            decision.apply = true;
+            decision.reduceDepth = true;
+            decision.persist = true;
+            decision.reason = "latency spike";
+            return decision;
+        }
+
+        _averageLatencyUs = _averageLatencyUs == 0 ? std::max<uint64_t>(1, callLatencyUs)
+                                                   : (_averageLatencyUs * 7 + callLatencyUs) / 8;
+        return decision;
+    }
+
+    // Probing: let the queue adjust to the candidate before measuring
+    if (!_windowOpen)
+    {
+        if (nowMs - _candidateStartMs >= WarmupMs)
+        {
+            _windowOpen = true;
+            _windowStartMs = nowMs;
+            _windowStartBytes = completedBytes;
+            _windowBusyUs = 0;
+            _windowMaxLatencyUs = 0;
+        }
+        return decision;
+    }
+
+    _windowBusyUs += callLatencyUs;
+    _windowMaxLatencyUs = std::max(_windowMaxLatencyUs, callLatencyUs);
+
+    const int64_t elapsedMs = nowMs - _windowStartMs;
+    const uint64_t bytes = completedBytes - _windowStartBytes;
+
+    if (elapsedMs >= ProbeMs * 10 && bytes < MinProbeBytes)
+    {
+        // Too little data arriving to tell candidates apart
+        _learnable = false;
+        if (_best.throughputBps == 0)
+            _best.setting = _probes.empty() ? _setting : _probes.front().setting;
+        _settle();
+        decision.apply = true;
+        decision.reduceDepth = true;
+        decision.reason = "too little data to measure";
+        return decision;
+    }
+
+    if (elapsedMs < ProbeMs || bytes < MinProbeBytes)
+        return decision;
+
+    Probe probe;
+    probe.setting = _setting;
+    probe.throughputBps = bytes * 1000 / static_cast<uint64_t>(elapsedMs);
+    probe.maxLatencyUs = _windowMaxLatencyUs;
+    probe.writerBound = _windowBusyUs * 100 >= static_cast<uint64_t>(elapsedMs) * 1000 * WriterBoundPercent;
+    probe.spiked = _windowMaxLatencyUs >= SpikeLatencyUs;
+    _probes.push_back(probe);
+    decision.probeDone = true;
+
+    if (_probes.size() == 1)
+    {
+        _best = probe;
+        if (!probe.writerBound)
+        {
+            // The source, not the device, set the pace; others would measure the same
+            _learnable = false;
+            _settle();
+            decision.reason = "writer not the bottleneck, keeping defaults";
+            return decision;
+        }
+    }
+    else if (_better(probe, _best))
+    {
+        _best = probe;
+    }
+
+    if (_candidates.empty() && !_blockPhase)
+    {
+        // Phase 2: smaller writes at the best depth
+        _blockPhase = true;
+        for (int divisor : {2, 4})
+        {
+            const size_t block = alignBlock(_maxBlockSize / divisor);
+            if (block >= MinBlockSize && block < _maxBlockSize)
+                _candidates.push_back({_best.setting.queueDepth, block});
+        }
+    }
+
+    if (!_candidates.empty())
+    {
+        _setting = _candidates.front();
+        _candidates.erase(_candidates.begin());
+        _startCandidate(nowMs);
+        decision.apply = true;
+        decision.reason = "probing";
+        return decision;
+    }
+
+    _settle();
+    decision.apply = true;
+    decision.reduceDepth = true;
+    decision.persist = _learnable;
+    decision.reason = "settled";
+    return decision;
+}
+
+void WriteAutoTuner::_startCandidate(int64_t nowMs)
+{
+    _candidateStartMs = nowMs;
+    _windowOpen = false;
+}
+
+bool WriteAutoTuner::_better(const Probe &candidate, const Probe &current) const
+{
+    if (candidate.spiked != current.spiked)
+        return !candidate.spiked;
+    return candidate.throughputBps * 100 > current.throughputBps * (100 + HysteresisPercent);
+}
+
+void WriteAutoTuner::_settle()
+{
+    _candidates.clear();
+    _setting = _best.setting;
+    if (_setting.queueDepth > _maxQueueDepth)
+        _setting.queueDepth = _maxQueueDepth;
+    _state = State::Settled;
+    _averageLatencyUs = 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef WRITEAUTOTUNER_H
+#define WRITEAUTOTUNER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Picks async queue depth and write size from measured throughput
+ *
+ * SystemMemoryManager's queue depth and write size are static guesses from
+ * RAM size and platform. During the first seconds of a write this tuner
+ * tries a few combinations, each for a short window, and settles on the
+ * one that moved the most bytes to the device:
+ *
+ *   1. Queue depth: the configured depth, half and a quarter of it (>= 2),
+ *      writing whole buffers.
+ *   2. Write size: at the best depth, buffers split into halves and quarters
+ *      (>= MinBlockSize).
+ *
+ * A candidate only replaces the current best if it is HysteresisPercent
+ * faster. If the writer was not the bottleneck during the first window
+ * (download or decompression gaps), all candidates would measure the same
+ * source rate, so the defaults are kept and not learned.
+ *
+ * Once settled, a single write taking SpikeFactor times the running average
+ * (and at least SpikeLatencyUs) halves the queue depth. Depth reductions by
+ * WriteProgressWatchdog arrive through capQueueDepth(); they end probing
+ * and cap the depth from then on, until the watchdog sees the device
+ * recover and raises it again with restoreQueueDepth().
+ *
+ * The caller owns the device: it applies setting() to its writes (waiting
+ * for a free slot below the probed depth, splitting buffers larger than the
+ * block size), shrinks the native queue when asked, and stores the learned
+ * setting per device model. All methods except capQueueDepth() and
+ * restoreQueueDepth() must be called from the writing thread.
+ */
+class WriteAutoTuner
+{
+public:
+    struct Setting {
+        int queueDepth = 1;      // Writes in flight; 1 = synchronous
+        size_t blockSize = 0;    // Largest single write; 0 = whole buffers
+    };
+
+    struct Probe {
+        Setting setting;
+        uint64_t throughputBps = 0;
+        uint64_t maxLatencyUs = 0;
+        bool writerBound = false;  // Writes were blocked most of the window
+        bool spiked = false;       // A write exceeded SpikeLatencyUs
+    };
+
+    enum class State { Idle, Probing, Settled };
+
+    /**
+     * @brief What the caller has to do after onWrite()
+     */
+    struct Decision {
+        bool apply = false;        // setting() changed; use it from the next write
+        bool reduceDepth = false;  // Shrink the device's queue to setting().queueDepth
+        bool persist = false;      // Store setting() as learned for this device model
+        bool probeDone = false;    // probes().back() was just measured
+        const char *reason = "";
+    };
+
+    static constexpr int64_t WarmupMs = 250;          // Settle time after a change, not measured
+    static constexpr int64_t ProbeMs = 1500;          // Measured time per candidate
+    static constexpr uint64_t MinProbeBytes = 16ULL * 1024 * 1024;
+    static constexpr size_t MinBlockSize = 256 * 1024;
+    static constexpr int MinQueueDepth = 2;           // Same floor as recovery reductions
+    static constexpr int HysteresisPercent = 5;
+    static constexpr int WriterBoundPercent = 50;     // Share of the window spent in writes
+    static constexpr uint64_t SpikeLatencyUs = 1000 * 1000;
+    static constexpr uint64_t SpikeFactor = 8;
+    static constexpr int64_t SpikeCooldownMs = 5000;  // Let a reduction take effect first
+
+    /**
+     * @brief Start probing from the configured defaults
+     * @param maxQueueDepth Depth the device was opened with (1 = synchronous I/O)
+     * @param maxBlockSize Largest buffer the writer is handed
+     * @param nowMs Monotonic time in milliseconds
+     */
+    void begin(int maxQueueDepth, size_t maxBlockSize, int64_t nowMs);
+
+    /**
+     * @brief Skip probing and use a setting learned on an earlier write
+     *
+     * The setting is clamped to what the device was opened with. Latency
+     * back-off still applies.
+     */
+    void beginLearned(const Setting &learned, int maxQueueDepth, size_t maxBlockSize, int64_t nowMs);
+
+    /**
+     * @brief Account for one write call
+     * @param completedBytes Total bytes the device has completed so far
+     * @param callLatencyUs How long the call blocked the writer
+     * @param nowMs Monotonic time in milliseconds
+     */
+    Decision onWrite(uint64_t completedBytes, uint64_t callLatencyUs, int64_t nowMs);
+
+    /**
+     * @brief Never exceed depth from now on (e.g. after a watchdog reduction)
+     *
+     * Safe to call from any thread; takes effect on the next onWrite().
+     */
+    void capQueueDepth(int depth);
+
+    /**
+     * @brief Lift a watchdog cap back up to depth once the device has recovered
+     *
+     * Safe to call from any thread; takes effect on the next onWrite().
+     */
+    void restoreQueueDepth(int depth);
+
+    Setting setting() const { return _setting; }
+    State state() const { return _state; }
+    bool isProbing() const { return _state == State::Probing; }
+    const std::vector<Probe> &probes() const { return _probes; }
+
+    /**
+     * @brief The measured best, once settled; throughputBps is 0 if not measured
+     */
+    Probe best() const { return _best; }
+
+private:
+    void _startCandidate(int64_t nowMs);
+    bool _better(const Probe &candidate, const Probe &current) const;
+    void _settle();
+
+    State _state = State::Idle;
+    Setting _setting;
+    int _maxQueueDepth = 1;
+    size_t _maxBlockSize = 0;
+
+    // Probing
+    std::vector<Setting> _candidates;  // Still to try in the current phase
+    bool _blockPhase = false;
+    std::vector<Probe> _probes;
+    Probe _best;
+    bool _learnable = true;             // First window was writer-bound
+    int64_t _candidateStartMs = 0;
+    bool _windowOpen = false;
+    int64_t _windowStartMs = 0;
+    uint64_t _windowStartBytes = 0;
+    uint64_t _windowBusyUs = 0;
+    uint64_t _windowMaxLatencyUs = 0;
+
+    // Settled
+    uint64_t _averageLatencyUs = 0;
+    int64_t _lastBackoffMs = 0;
+
+    std::atomic<int> _depthCap{0};      // 0 = no cap
+    std::atomic<int> _depthRestore{0};  // 0 = nothing to restore
+};
+
+#endif // WRITEAUTOTUNER_H
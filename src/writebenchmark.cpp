@@ -0,0 +1,944 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "writebenchmark.h"
+#include "acceleratedcryptographichash.h"
+#include "aligned_buffer.h"
+#include "broadcastringbuffer.h"
+#include "file_operations.h"
+#include "file_operations_emulated.h"
+#include "file_operations_memory.h"
+#include "file_operations_replay.h"
+#include "imagewriter.h"
+#include "latencyhistogram.h"
+#include "systemmemorymanager.h"
+#include "threadcputime.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    // Give up on an async write that has not completed in this long
+    constexpr qint64 ASYNC_SLOT_TIMEOUT_MS = 60000;
+    // Smallest write size worth sweeping
+    constexpr quint64 MIN_BUFFER_SIZE = 64 * 1024;
+    // Fan-out ring slots, at least: enough for targets to drift apart a little
+    constexpr size_t MIN_FANOUT_SLOTS = 8;
+
+    // Synthetic data or a raw image, looped if shorter than a run
+    class BenchmarkSource
+    {
+    public:
+        explicit BenchmarkSource(const QString &path) : _synthetic(path == WriteBenchmark::SyntheticSource), _file(path) {}
+
+        bool open()
+        {
+            if (_synthetic)
+                return true;
+            return _file.open(QFile::ReadOnly) && _file.size() > 0;
+        }
+
+        bool fill(std::uint8_t *data, size_t size)
+        {
+            if (_synthetic) {
+                // xorshift64*: incompressible, so neither the card's controller
+                // nor a compressing filesystem can shortcut the write
+                size_t i = 0;
+                for (; i + sizeof(quint64) <= size; i += sizeof(quint64)) {
+                    _state ^= _state >> 12;
+                    _state ^= _state << 25;
+                    _state ^= _state >> 27;
+                    const quint64 value = _state * 0x2545F4914F6CDD1DULL;
+                    std::memcpy(data + i, &value, sizeof(value));
+                }
+                for (; i < size; ++i)
+                    data[i] = static_cast<std::uint8_t>(i);
+                return true;
+            }
+
+            size_t filled = 0;
+            while (filled < size) {
+                const qint64 n = _file.read(reinterpret_cast<char *>(data + filled), static_cast<qint64>(size - filled));
+                if (n < 0)
+                    return false;
+                if (n == 0) {
+                    if (!_file.seek(0))
+                        return false;
+                    continue;
+                }
+                filled += static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+    private:
+        bool _synthetic;
+        QFile _file;
+        quint64 _state = 0x9E3779B97F4A7C15ULL;
+    };
+
+    QJsonObject latencyJson(const rpi_imager::LatencyHistogram &histogram)
+    {
+        using rpi_imager::LatencyHistogram;
+        const auto counts = histogram.Snapshot();
+        const quint64 max = histogram.MaxUs();
+        QJsonObject obj;
+        obj["count"] = static_cast<qint64>(histogram.Count());
+        obj["p50Us"] = static_cast<qint64>(LatencyHistogram::ValueAtQuantile(counts, 0.50, max));
+        obj["p90Us"] = static_cast<qint64>(LatencyHistogram::ValueAtQuantile(counts, 0.90, max));
+        obj["p99Us"] = static_cast<qint64>(LatencyHistogram::ValueAtQuantile(counts, 0.99, max));
+        obj["p999Us"] = static_cast<qint64>(LatencyHistogram::ValueAtQuantile(counts, 0.999, max));
+        obj["maxUs"] = static_cast<qint64>(max);
+        return obj;
+    }
+
+    QString fileErrorName(rpi_imager::FileError error)
+    {
+        switch (error) {
+        case rpi_imager::FileError::kSuccess: return "success";
+        case rpi_imager::FileError::kOpenError: return "open";
+        case rpi_imager::FileError::kWriteError: return "write";
+        case rpi_imager::FileError::kReadError: return "read";
+        case rpi_imager::FileError::kSeekError: return "seek";
+        case rpi_imager::FileError::kSizeError: return "size";
+        case rpi_imager::FileError::kCloseError: return "close";
+        case rpi_imager::FileError::kLockError: return "lock";
+        case rpi_imager::FileError::kSyncError: return "sync";
+        case rpi_imager::FileError::kFlushError: return "flush";
+        case rpi_imager::FileError::kCancelled: return "cancelled";
+        case rpi_imager::FileError::kTimeout: return "timeout";
+        }
+        return "unknown";
+    }
+
+    template <typename T>
+    void appendUnique(QList<T> &list, T value)
+    {
+        if (!list.contains(value))
+            list.append(value);
+    }
+
+    // The adaptive setting if it is among those to try, else the first
+    template <typename T>
+    T preferred(const QList<T> &list, T adaptive)
+    {
+        return list.contains(adaptive) ? adaptive : list.first();
+    }
+
+    // Targets that open a fresh device-less image each time, so one name
+    // can stand for as many targets as a run needs
+    bool isRepeatableTarget(const QString &target)
+    {
+        return target == WriteBenchmark::NullTarget
+            || rpi_imager::MemoryFileOperations::IsMemoryTarget(target.toStdString());
+    }
+
+    QJsonObject stageCpuJson(const ThreadCpuTime::StageTime &time, qint64 elapsedMs)
+    {
+        QJsonObject obj;
+        obj["cpuMs"] = time.cpuUs / 1000;
+        obj["activeMs"] = time.activeUs / 1000;
+        // How busy the stage's threads were while alive, and how many cores it used
+        if (time.activeUs > 0)
+            obj["busyPercent"] = static_cast<qint64>(time.cpuUs * 100 / time.activeUs);
+        if (elapsedMs > 0)
+            obj["cores"] = static_cast<double>(time.cpuUs) / 1000.0 / static_cast<double>(elapsedMs);
+        return obj;
+    }
+
+    // One target of a fan-out run and what its writer thread found
+    struct FanOutTarget {
+        QString name;
+        std::unique_ptr<rpi_imager::FileOperations> file;  // Null for the "null" target
+        QJsonObject result;
+        int consumer = -1;
+        quint64 written = 0;
+        qint64 elapsedMs = 0;
+        rpi_imager::FileError error = rpi_imager::FileError::kSuccess;
+    };
+
+    // Writes every slot the ring hands to target, as the extract thread
+    // does for a single device, and releases each once its write is done.
+    // A target that fails is detached so the others carry on.
+    void writeFanOutTarget(BroadcastRingBuffer &ring, FanOutTarget &target, quint64 syncInterval)
+    {
+        ThreadCpuTime::Scope cpu(ThreadCpuTime::Stage::Write);
+        QElapsedTimer elapsed;
+        elapsed.start();
+
+        rpi_imager::FileOperations *file = target.file.get();
+        const size_t depth = file ? static_cast<size_t>(qMax(1, file->GetAsyncQueueDepth())) : 1;
+        const bool async = depth > 1;
+        std::unique_ptr<std::atomic<bool>[]> busy(new std::atomic<bool>[depth]);
+        for (size_t i = 0; i < depth; ++i)
+            busy[i].store(false);
+        std::atomic<int> asyncError{static_cast<int>(rpi_imager::FileError::kSuccess)};
+        std::deque<const BroadcastRingBuffer::Slot *> inFlight;  // Oldest first
+
+        rpi_imager::LatencyHistogram writeLatency;
+        rpi_imager::LatencyHistogram syncLatency;
+        rpi_imager::FileError error = rpi_imager::FileError::kSuccess;
+        quint64 sinceSync = 0;
+
+        auto releaseInFlight = [&]() {
+            for (; !inFlight.empty(); inFlight.pop_front())
+                ring.releaseReadSlot(target.consumer, inFlight.front());
+        };
+        auto syncNow = [&]() {
+            QElapsedTimer t;
+            t.start();
+            rpi_imager::FileError r = file->WaitForPendingWrites();
+            if (r == rpi_imager::FileError::kSuccess)
+                r = file->Flush();
+            if (r == rpi_imager::FileError::kSuccess)
+                r = file->ForceSync();
+            syncLatency.Record(static_cast<quint64>(t.nsecsElapsed() / 1000));
+            releaseInFlight();
+            return r;
+        };
+
+        for (quint64 n = 0;; ++n) {
+            const size_t i = static_cast<size_t>(n % depth);
+            if (async) {
+                QElapsedTimer wait;
+                wait.start();
+                while (busy[i].load(std::memory_order_acquire)) {
+                    file->PollAsyncCompletions();
+                    if (wait.elapsed() > ASYNC_SLOT_TIMEOUT_MS) {
+                        error = rpi_imager::FileError::kTimeout;
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+                if (error != rpi_imager::FileError::kSuccess)
+                    break;
+                if (asyncError.load() != static_cast<int>(rpi_imager::FileError::kSuccess)) {
+                    error = static_cast<rpi_imager::FileError>(asyncError.load());
+                    break;
+                }
+                // The write that used this flag is done with its slot
+                if (inFlight.size() == depth) {
+                    ring.releaseReadSlot(target.consumer, inFlight.front());
+                    inFlight.pop_front();
+                }
+            }
+
+            const BroadcastRingBuffer::Slot *slot = ring.acquireReadSlot(target.consumer);
+            if (!slot)
+                break;
+            const auto *data = reinterpret_cast<const std::uint8_t *>(slot->data);
+
+            if (!file) {
+                ring.releaseReadSlot(target.consumer, slot);
+            } else if (async) {
+                busy[i].store(true, std::memory_order_relaxed);
+                inFlight.push_back(slot);
+                error = file->AsyncWriteSequential(data, slot->size,
+                    [&busy, &asyncError, i](rpi_imager::FileError r, size_t) {
+                        if (r != rpi_imager::FileError::kSuccess)
+                            asyncError.store(static_cast<int>(r));
+                        busy[i].store(false, std::memory_order_release);
+                    });
+            } else {
+                QElapsedTimer t;
+                t.start();
+                error = file->WriteSequential(data, slot->size);
+                writeLatency.Record(static_cast<quint64>(t.nsecsElapsed() / 1000));
+                ring.releaseReadSlot(target.consumer, slot);
+            }
+            if (error != rpi_imager::FileError::kSuccess)
+                break;
+
+            target.written += slot->size;
+            sinceSync += slot->size;
+            if (file && syncInterval && sinceSync >= syncInterval) {
+                error = syncNow();
+                if (error != rpi_imager::FileError::kSuccess)
+                    break;
+                sinceSync = 0;
+            }
+        }
+
+        // Don't hold the producer and the other targets up any longer
+        if (error != rpi_imager::FileError::kSuccess)
+            ring.detachConsumer(target.consumer);
+
+        if (file) {
+            if (async && error != rpi_imager::FileError::kSuccess)
+                file->CancelAsyncIO();
+
+            QElapsedTimer t;
+            t.start();
+            const rpi_imager::FileError syncResult = syncNow();
+            target.result["finalSyncMs"] = t.elapsed();
+            if (error == rpi_imager::FileError::kSuccess)
+                error = syncResult;
+            target.result["writeLatency"] = latencyJson(async ? file->GetAsyncWriteLatencyHistogram() : writeLatency);
+            if (syncLatency.Count() > 0)
+                target.result["syncLatency"] = latencyJson(syncLatency);
+            // Closed here, while the completion flags are still alive
+            file->Close();
+        }
+        releaseInFlight();
+
+        target.error = error;
+        target.elapsedMs = elapsed.elapsed();
+    }
+
+    QJsonObject consumerJson(const BroadcastRingBuffer::ConsumerStats &stats)
+    {
+        QJsonObject obj;
+        obj["maxLagSlots"] = static_cast<qint64>(stats.maxLagSlots);
+        obj["waitStalls"] = static_cast<qint64>(stats.waitStalls);
+        obj["waitMs"] = static_cast<qint64>(stats.waitMs);
+        obj["blockingStalls"] = static_cast<qint64>(stats.blockingStalls);
+        obj["blockingMs"] = static_cast<qint64>(stats.blockingMs);
+        return obj;
+    }
+}
+
+WriteBenchmark::Options WriteBenchmark::defaultOptions()
+{
+    SystemMemoryManager &mm = SystemMemoryManager::instance();
+    const quint64 pageSize = qMax<quint64>(4096, mm.getSystemPageSize());
+    const quint64 optimal = mm.getOptimalWriteBufferSize();
+
+    Options options;
+    // A quarter, all and four times the adaptive write size
+    for (quint64 size : {optimal / 4, optimal, optimal * 4}) {
+        size = qMax(MIN_BUFFER_SIZE, size / pageSize * pageSize);
+        appendUnique(options.bufferSizes, size);
+    }
+    appendUnique(options.queueDepths, 1);
+    appendUnique(options.queueDepths, mm.getOptimalAsyncQueueDepth(static_cast<size_t>(optimal)));
+    options.directIO = {true, false};
+    appendUnique(options.syncIntervals, static_cast<quint64>(mm.calculateSyncConfiguration().syncIntervalBytes));
+    appendUnique(options.syncIntervals, quint64(0));
+    return options;
+}
+
+quint64 WriteBenchmark::parseByteSize(const QString &text)
+{
+    static const QRegularExpression re(QStringLiteral("^\\s*(\\d+)\\s*([KMG]?)i?B?\\s*$"),
+                                       QRegularExpression::CaseInsensitiveOption);
+    const auto match = re.match(text);
+    if (!match.hasMatch())
+        return 0;
+
+    bool ok = false;
+    const quint64 value = match.captured(1).toULongLong(&ok);
+    if (!ok)
+        return 0;
+    const QString unit = match.captured(2).toUpper();
+    if (unit == "K")
+        return value * 1024;
+    if (unit == "M")
+        return value * 1024 * 1024;
+    if (unit == "G")
+        return value * 1024 * 1024 * 1024;
+    return value;
+}
+
+bool WriteBenchmark::isDeviceTarget(const QString &target)
+{
+    if (isRepeatableTarget(target))
+        return false;
+    const QFileInfo info(target);
+    // Windows physical drives do not show up as files at all
+    return info.exists() ? !info.isFile() : target.startsWith("\\\\.\\");
+}
+
+WriteBenchmark::WriteBenchmark(const Options &options)
+    : _options(options)
+{
+}
+
+bool WriteBenchmark::_isNullTarget() const
+{
+    return _options.target == NullTarget;
+}
+
+QList<WriteBenchmark::RunConfig> WriteBenchmark::_configurations() const
+{
+    QList<RunConfig> configs;
+    for (quint64 bufferSize : _options.bufferSizes) {
+        // Only the source and hash are exercised; the rest would repeat
+        if (_isNullTarget()) {
+            configs.append(RunConfig{bufferSize, 1, false, 0});
+            continue;
+        }
+        for (int queueDepth : _options.queueDepths) {
+            for (bool directIO : _options.directIO) {
+                for (quint64 syncInterval : _options.syncIntervals)
+                    configs.append(RunConfig{bufferSize, queueDepth, directIO, syncInterval});
+            }
+        }
+    }
+    return configs;
+}
+
+WriteBenchmark::RunConfig WriteBenchmark::_fanOutConfiguration() const
+{
+    // One configuration for every target count: what a real write would
+    // use where the sweep lists include it
+    SystemMemoryManager &mm = SystemMemoryManager::instance();
+    const quint64 pageSize = qMax<quint64>(4096, mm.getSystemPageSize());
+    const quint64 optimal = qMax(MIN_BUFFER_SIZE, mm.getOptimalWriteBufferSize() / pageSize * pageSize);
+    RunConfig config;
+    config.bufferSize = preferred(_options.bufferSizes, optimal);
+    config.queueDepth = preferred(_options.queueDepths, mm.getOptimalAsyncQueueDepth(static_cast<size_t>(optimal)));
+    config.directIO = preferred(_options.directIO, true);
+    config.syncInterval = preferred(_options.syncIntervals,
+                                    static_cast<quint64>(mm.calculateSyncConfiguration().syncIntervalBytes));
+    return config;
+}
+
+QString WriteBenchmark::_openTarget(const QString &target, const RunConfig &config, quint64 &bytesToWrite,
+                                    std::unique_ptr<rpi_imager::FileOperations> &file, QJsonObject &result)
+{
+    if (target == NullTarget)
+        return {};
+
+    const std::string path = target.toStdString();
+    const bool isDevice = isDeviceTarget(target);
+    // The same device stand-ins as a write to null:, ramdisk:, replay: or emulate:
+    const bool isMemory = rpi_imager::MemoryFileOperations::IsMemoryTarget(path);
+    if (rpi_imager::ReplayFileOperations::IsReplayTarget(path))
+        file = std::make_unique<rpi_imager::ReplayFileOperations>();
+    else if (rpi_imager::EmulatedFileOperations::IsEmulatedTarget(path))
+        file = std::make_unique<rpi_imager::EmulatedFileOperations>();
+    else if (isMemory)
+        file = std::make_unique<rpi_imager::MemoryFileOperations>();
+    else
+        file = rpi_imager::FileOperations::Create();
+
+    rpi_imager::FileError openResult = isDevice || isMemory ? file->OpenDevice(path)
+                                                            : file->CreateTestFile(path, bytesToWrite);
+    if (openResult != rpi_imager::FileError::kSuccess) {
+        file.reset();
+        return QStringLiteral("cannot open target (%1)").arg(fileErrorName(openResult));
+    }
+
+    std::uint64_t targetSize = 0;
+    if ((isDevice || isMemory) && file->GetSize(targetSize) == rpi_imager::FileError::kSuccess && targetSize > 0)
+        bytesToWrite = qMin<quint64>(bytesToWrite, targetSize / config.bufferSize * config.bufferSize);
+
+    if (file->IsDirectIOEnabled() != config.directIO)
+        file->SetDirectIOEnabled(config.directIO);
+    result["directIOActive"] = file->IsDirectIOEnabled();
+
+    // null: and ramdisk: writes complete on the spot, so they stay synchronous
+    if (config.queueDepth > 1 && (file->IsAsyncIOSupported() || !isMemory)) {
+        if (!file->IsAsyncIOSupported() || !file->SetAsyncQueueDepth(config.queueDepth)) {
+            file->Close();
+            file.reset();
+            return QStringLiteral("async I/O not supported on this target");
+        }
+    }
+    result["queueDepthActive"] = file->GetAsyncQueueDepth();
+    file->ResetAsyncIOStats();
+
+    const auto &limits = file->GetDeviceIOLimits();
+    if (limits.max_transfer_bytes > 0)
+        result["deviceMaxTransferBytes"] = static_cast<qint64>(limits.max_transfer_bytes);
+    if (limits.suggested_queue_depth > 0)
+        result["deviceSuggestedQueueDepth"] = limits.suggested_queue_depth;
+    return {};
+}
+
+QJsonObject WriteBenchmark::_hostInfo() const
+{
+    SystemMemoryManager &mm = SystemMemoryManager::instance();
+    QJsonObject host;
+    host["platform"] = mm.getPlatformName();
+    host["totalMemoryMB"] = mm.getTotalMemoryMB();
+    host["availableMemoryMB"] = mm.getAvailableMemoryMB();
+    host["pageSize"] = static_cast<qint64>(mm.getSystemPageSize());
+    host["optimalWriteBufferSize"] = static_cast<qint64>(mm.getOptimalWriteBufferSize());
+    host["optimalAsyncQueueDepth"] = mm.getOptimalAsyncQueueDepth();
+    host["syncIntervalBytes"] = mm.calculateSyncConfiguration().syncIntervalBytes;
+    host["sha256Backend"] = AcceleratedCryptographicHash::backendName();
+    return host;
+}
+
+QJsonDocument WriteBenchmark::run(const std::function<void(const QString &)> &progress)
+{
+    _error.clear();
+
+    const bool fanOut = !_options.fanOutTargets.isEmpty();
+    if (!fanOut && _options.target.isEmpty()) {
+        _error = QStringLiteral("no benchmark target given");
+        return {};
+    }
+    if (_options.bytesPerRun == 0 || _options.bufferSizes.isEmpty() || _options.queueDepths.isEmpty()
+        || _options.directIO.isEmpty() || _options.syncIntervals.isEmpty()) {
+        _error = QStringLiteral("nothing to benchmark");
+        return {};
+    }
+    for (quint64 size : std::as_const(_options.bufferSizes)) {
+        if (size == 0 || size % 4096 != 0) {
+            _error = QStringLiteral("write sizes must be multiples of 4096 bytes (for direct I/O)");
+            return {};
+        }
+    }
+    if (_options.source != SyntheticSource && !QFileInfo(_options.source).isFile()) {
+        _error = QStringLiteral("benchmark source is not a regular file: %1").arg(_options.source);
+        return {};
+    }
+
+    // Target lists for each fan-out run, the last target repeated where it can be
+    QList<QStringList> fanOutRuns;
+    if (fanOut) {
+        QList<int> counts = _options.fanOutCounts;
+        if (counts.isEmpty()) {
+            for (int count = 1; count <= _options.fanOutTargets.size(); ++count)
+                counts.append(count);
+        }
+        for (int count : std::as_const(counts)) {
+            if (count < 1) {
+                _error = QStringLiteral("fan-out target counts must be at least 1");
+                return {};
+            }
+            if (count > _options.fanOutTargets.size() && !isRepeatableTarget(_options.fanOutTargets.last())) {
+                _error = QStringLiteral("%1 targets needed but %2 given; only null:, ramdisk:, replay: and "
+                                        "emulate: targets can be repeated")
+                             .arg(count).arg(_options.fanOutTargets.size());
+                return {};
+            }
+            QStringList targets = _options.fanOutTargets.mid(0, count);
+            while (targets.size() < count)
+                targets.append(_options.fanOutTargets.last());
+            fanOutRuns.append(targets);
+        }
+    }
+
+    QJsonObject root;
+    root["version"] = 1;
+    root["imagerVersion"] = ImageWriter::staticVersion();
+    root["startTime"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    root["host"] = _hostInfo();
+    root["source"] = _options.source;
+    root["bytesPerRun"] = static_cast<qint64>(_options.bytesPerRun);
+    root["hash"] = _options.hash;
+
+    if (fanOut) {
+        const RunConfig config = _fanOutConfiguration();
+        root["targets"] = QJsonArray::fromStringList(_options.fanOutTargets);
+        root["bufferSize"] = static_cast<qint64>(config.bufferSize);
+        root["queueDepth"] = config.queueDepth;
+        root["directIO"] = config.directIO;
+        root["syncIntervalBytes"] = static_cast<qint64>(config.syncInterval);
+
+        QJsonArray runs;
+        qint64 singleTargetKBps = 0;
+        for (int index = 0; index < fanOutRuns.size(); ++index) {
+            const QStringList &targets = fanOutRuns[index];
+            if (progress) {
+                progress(QStringLiteral("Run %1/%2: %3 target(s) at once, %4 KB writes, queue depth %5")
+                             .arg(index + 1).arg(fanOutRuns.size()).arg(targets.size())
+                             .arg(config.bufferSize / 1024).arg(config.queueDepth));
+            }
+            QJsonObject result = _runFanOut(config, targets);
+            // Against N times what one target managed: where this falls
+            // away from 1 is where the station stops scaling
+            const qint64 aggregateKBps = result.value("aggregateThroughputKBps").toInteger();
+            if (targets.size() == 1 && result.value("success").toBool())
+                singleTargetKBps = aggregateKBps;
+            else if (singleTargetKBps > 0)
+                result["scalingEfficiency"] = static_cast<double>(aggregateKBps)
+                    / static_cast<double>(singleTargetKBps * targets.size());
+            runs.append(result);
+        }
+        root["runs"] = runs;
+        return QJsonDocument(root);
+    }
+
+    root["target"] = _options.target;
+    const QList<RunConfig> configs = _configurations();
+    QJsonArray runs;
+    int index = 0;
+    for (const RunConfig &config : configs) {
+        ++index;
+        if (progress) {
+            progress(QStringLiteral("Run %1/%2: %3 KB writes, queue depth %4, direct I/O %5, sync every %6")
+                         .arg(index).arg(configs.size())
+                         .arg(config.bufferSize / 1024).arg(config.queueDepth)
+                         .arg(config.directIO ? "on" : "off")
+                         .arg(config.syncInterval ? QString("%1 MB").arg(config.syncInterval / (1024 * 1024))
+                                                  : QStringLiteral("(final only)")));
+        }
+        runs.append(_runOne(config));
+    }
+    root["runs"] = runs;
+    return QJsonDocument(root);
+}
+
+QJsonObject WriteBenchmark::_runFanOut(const RunConfig &config, const QStringList &targetNames)
+{
+    QJsonObject result;
+    result["targetCount"] = targetNames.size();
+
+    auto fail = [&result](const QString &message) {
+        result["success"] = false;
+        result["error"] = message;
+        qDebug() << "Benchmark run failed:" << message;
+        return result;
+    };
+
+    BenchmarkSource source(_options.source);
+    if (!source.open())
+        return fail(QStringLiteral("cannot read source"));
+
+    std::vector<std::unique_ptr<FanOutTarget>> targets;
+    auto closeTargets = [&targets]() {
+        for (const auto &target : targets) {
+            if (target->file)
+                target->file->Close();
+        }
+    };
+
+    // Every target gets the same stream, so the smallest one sets its length
+    quint64 bytesToWrite = _options.bytesPerRun / config.bufferSize * config.bufferSize;
+    for (const QString &name : targetNames) {
+        auto target = std::make_unique<FanOutTarget>();
+        target->name = name;
+        const QString openError = _openTarget(name, config, bytesToWrite, target->file, target->result);
+        if (!openError.isEmpty()) {
+            closeTargets();
+            return fail(QStringLiteral("%1: %2").arg(name, openError));
+        }
+        targets.push_back(std::move(target));
+    }
+    if (bytesToWrite == 0) {
+        closeTargets();
+        return fail(QStringLiteral("a target is smaller than one write"));
+    }
+
+    const size_t numSlots = std::max(MIN_FANOUT_SLOTS, static_cast<size_t>(config.queueDepth) * 2);
+    std::unique_ptr<BroadcastRingBuffer> ring;
+    try {
+        ring = std::make_unique<BroadcastRingBuffer>(numSlots, static_cast<size_t>(config.bufferSize));
+    } catch (const std::bad_alloc &) {
+        closeTargets();
+        return fail(QStringLiteral("out of memory for the ring buffer"));
+    }
+    result["ringSlots"] = static_cast<qint64>(numSlots);
+
+    // The hasher reads every slot alongside the targets, as in a real write
+    const int hashConsumer = _options.hash ? ring->addConsumer(QStringLiteral("hash")) : -1;
+    for (const auto &target : targets)
+        target->consumer = ring->addConsumer(target->name);
+
+    AcceleratedCryptographicHash hash(QCryptographicHash::Sha256);
+    const ThreadCpuTime::Sample cpuBefore = ThreadCpuTime::sample();
+    QElapsedTimer total;
+    total.start();
+
+    std::vector<std::thread> threads;
+    if (hashConsumer >= 0) {
+        threads.emplace_back([&ring, &hash, hashConsumer]() {
+            ThreadCpuTime::Scope cpu(ThreadCpuTime::Stage::Hash);
+            while (const BroadcastRingBuffer::Slot *slot = ring->acquireReadSlot(hashConsumer)) {
+                hash.addData(slot->data, static_cast<int>(slot->size));
+                ring->releaseReadSlot(hashConsumer, slot);
+            }
+        });
+    }
+    for (const auto &target : targets) {
+        threads.emplace_back([&ring, target = target.get(), syncInterval = config.syncInterval]() {
+            writeFanOutTarget(*ring, *target, syncInterval);
+        });
+    }
+
+    // The producer stands in for the download, so it counts as that stage
+    qint64 sourceNs = 0;
+    quint64 produced = 0;
+    bool sourceFailed = false;
+    {
+        ThreadCpuTime::Scope cpu(ThreadCpuTime::Stage::Download);
+        while (produced < bytesToWrite) {
+            BroadcastRingBuffer::Slot *slot = ring->acquireWriteSlot();
+            if (!slot)
+                break;  // Stalled, or nobody is reading any more
+            QElapsedTimer t;
+            t.start();
+            if (!source.fill(reinterpret_cast<std::uint8_t *>(slot->data), static_cast<size_t>(config.bufferSize))) {
+                sourceFailed = true;
+                break;
+            }
+            sourceNs += t.nsecsElapsed();
+            ring->commitWriteSlot(slot, static_cast<size_t>(config.bufferSize));
+            produced += config.bufferSize;
+        }
+    }
+    ring->producerDone();
+    for (std::thread &thread : threads)
+        thread.join();
+    const qint64 elapsedMs = total.elapsed();
+    const ThreadCpuTime::Sample cpu = ThreadCpuTime::difference(ThreadCpuTime::sample(), cpuBefore);
+
+    const std::vector<BroadcastRingBuffer::ConsumerStats> consumers = ring->getConsumerStats();
+    QJsonArray targetResults;
+    quint64 aggregate = 0;
+    QStringList failed;
+    for (const auto &target : targets) {
+        QJsonObject r = target->result;
+        r["target"] = target->name;
+        r["bytesWritten"] = static_cast<qint64>(target->written);
+        r["elapsedMs"] = target->elapsedMs;
+        if (target->elapsedMs > 0)
+            r["throughputKBps"] = static_cast<qint64>(target->written * 1000 / static_cast<quint64>(target->elapsedMs) / 1024);
+        r["ring"] = consumerJson(consumers[static_cast<size_t>(target->consumer)]);
+        if (target->error != rpi_imager::FileError::kSuccess) {
+            r["success"] = false;
+            r["error"] = QStringLiteral("%1 error after %2 bytes").arg(fileErrorName(target->error)).arg(target->written);
+            failed.append(target->name);
+        } else {
+            r["success"] = true;
+        }
+        aggregate += target->written;
+        targetResults.append(r);
+    }
+    result["targets"] = targetResults;
+
+    result["bytesPerTarget"] = static_cast<qint64>(produced);
+    result["elapsedMs"] = elapsedMs;
+    result["sourceMs"] = sourceNs / 1000000;
+    if (elapsedMs > 0) {
+        result["aggregateThroughputKBps"] = static_cast<qint64>(aggregate * 1000 / static_cast<quint64>(elapsedMs) / 1024);
+        result["sourceThroughputKBps"] = static_cast<qint64>(produced * 1000 / static_cast<quint64>(elapsedMs) / 1024);
+    }
+
+    QJsonObject cpuJson;
+    for (size_t i = 0; i < ThreadCpuTime::StageCount; ++i) {
+        if (cpu[i].cpuUs > 0)
+            cpuJson[QString::fromLatin1(ThreadCpuTime::stageName(static_cast<ThreadCpuTime::Stage>(i)))] =
+                stageCpuJson(cpu[i], elapsedMs);
+    }
+    result["cpu"] = cpuJson;
+
+    uint64_t producerStalls = 0, producerWaitMs = 0;
+    ring->getProducerStats(producerStalls, producerWaitMs);
+    QJsonObject producer;
+    producer["waitStalls"] = static_cast<qint64>(producerStalls);
+    producer["waitMs"] = static_cast<qint64>(producerWaitMs);
+    result["producer"] = producer;
+    if (hashConsumer >= 0)
+        result["hashRing"] = consumerJson(consumers[static_cast<size_t>(hashConsumer)]);
+
+    // Whoever the producer waited on longest, or the source if it never waited
+    QString limitedBy = QStringLiteral("source");
+    uint64_t longestBlockingMs = 0;
+    for (const auto &stats : consumers) {
+        if (stats.blockingMs > longestBlockingMs) {
+            longestBlockingMs = stats.blockingMs;
+            limitedBy = stats.name;
+        }
+    }
+    result["limitedBy"] = limitedBy;
+
+    if (sourceFailed)
+        return fail(QStringLiteral("cannot read source after %1 bytes").arg(produced));
+    if (ring->isStallTimeoutExceeded()) {
+        const int stalled = ring->stalledConsumer();
+        return fail(stalled >= 0 ? QStringLiteral("stalled waiting for %1").arg(consumers[static_cast<size_t>(stalled)].name)
+                                 : QStringLiteral("stalled waiting for the source"));
+    }
+    if (!failed.isEmpty())
+        return fail(QStringLiteral("failed: %1").arg(failed.join(QStringLiteral(", "))));
+
+    result["success"] = true;
+    return result;
+}
+
+QJsonObject WriteBenchmark::_runOne(const RunConfig &config)
+{
+    QJsonObject result;
+    result["bufferSize"] = static_cast<qint64>(config.bufferSize);
+    result["queueDepth"] = config.queueDepth;
+    result["directIO"] = config.directIO;
+    result["syncIntervalBytes"] = static_cast<qint64>(config.syncInterval);
+
+    auto fail = [&result](const QString &message) {
+        result["success"] = false;
+        result["error"] = message;
+        qDebug() << "Benchmark run failed:" << message;
+        return result;
+    };
+
+    BenchmarkSource source(_options.source);
+    if (!source.open())
+        return fail(QStringLiteral("cannot read source"));
+
+    // A fresh FileOperations per run so direct I/O and async state do not carry over
+    std::unique_ptr<rpi_imager::FileOperations> file;
+    quint64 bytesToWrite = _options.bytesPerRun / config.bufferSize * config.bufferSize;
+    const QString openError = _openTarget(_options.target, config, bytesToWrite, file, result);
+    if (!openError.isEmpty())
+        return fail(openError);
+    if (bytesToWrite == 0) {
+        if (file)
+            file->Close();
+        return fail(QStringLiteral("target is smaller than one write"));
+    }
+
+    const bool async = file && file->GetAsyncQueueDepth() > 1;
+
+    // One buffer per write that may be in flight
+    const int slotCount = async ? config.queueDepth : 1;
+    std::vector<rpi_imager::AlignedBuffer> slots;
+    slots.reserve(static_cast<size_t>(slotCount));
+    for (int i = 0; i < slotCount; ++i) {
+        slots.emplace_back(static_cast<size_t>(config.bufferSize));
+        if (!slots.back()) {
+            if (file)
+                file->Close();
+            return fail(QStringLiteral("out of memory for write buffers"));
+        }
+    }
+    std::unique_ptr<std::atomic<bool>[]> busy(new std::atomic<bool>[static_cast<size_t>(slotCount)]);
+    for (int i = 0; i < slotCount; ++i)
+        busy[static_cast<size_t>(i)].store(false);
+    std::atomic<int> asyncError{static_cast<int>(rpi_imager::FileError::kSuccess)};
+
+    AcceleratedCryptographicHash hash(QCryptographicHash::Sha256);
+    rpi_imager::LatencyHistogram writeLatency;
+    rpi_imager::LatencyHistogram syncLatency;
+    qint64 sourceNs = 0, hashNs = 0;
+    quint64 written = 0, sinceSync = 0;
+    rpi_imager::FileError writeError = rpi_imager::FileError::kSuccess;
+
+    auto syncNow = [&]() {
+        QElapsedTimer t;
+        t.start();
+        rpi_imager::FileError r = file->WaitForPendingWrites();
+        if (r == rpi_imager::FileError::kSuccess)
+            r = file->Flush();
+        if (r == rpi_imager::FileError::kSuccess)
+            r = file->ForceSync();
+        syncLatency.Record(static_cast<quint64>(t.nsecsElapsed() / 1000));
+        return r;
+    };
+
+    QElapsedTimer total;
+    total.start();
+    for (quint64 n = 0; written < bytesToWrite; ++n) {
+        const size_t slot = static_cast<size_t>(n % static_cast<quint64>(slotCount));
+        std::uint8_t *data = slots[slot].data();
+
+        if (async) {
+            QElapsedTimer wait;
+            wait.start();
+            while (busy[slot].load(std::memory_order_acquire)) {
+                file->PollAsyncCompletions();
+                if (wait.elapsed() > ASYNC_SLOT_TIMEOUT_MS) {
+                    writeError = rpi_imager::FileError::kTimeout;
+                    break;
+                }
+                std::this_thread::yield();
+            }
+            if (writeError != rpi_imager::FileError::kSuccess)
+                break;
+            if (asyncError.load() != static_cast<int>(rpi_imager::FileError::kSuccess)) {
+                writeError = static_cast<rpi_imager::FileError>(asyncError.load());
+                break;
+            }
+        }
+
+        QElapsedTimer t;
+        t.start();
+        if (!source.fill(data, static_cast<size_t>(config.bufferSize))) {
+            writeError = rpi_imager::FileError::kReadError;
+            break;
+        }
+        sourceNs += t.nsecsElapsed();
+
+        if (_options.hash) {
+            t.restart();
+            hash.addData(reinterpret_cast<const char *>(data), static_cast<int>(config.bufferSize));
+            hashNs += t.nsecsElapsed();
+        }
+
+        if (file) {
+            if (async) {
+                busy[slot].store(true, std::memory_order_relaxed);
+                writeError = file->AsyncWriteSequential(data, static_cast<size_t>(config.bufferSize),
+                    [&busy, &asyncError, slot](rpi_imager::FileError r, size_t) {
+                        if (r != rpi_imager::FileError::kSuccess)
+                            asyncError.store(static_cast<int>(r));
+                        busy[slot].store(false, std::memory_order_release);
+                    });
+            } else {
+                t.restart();
+                writeError = file->WriteSequential(data, static_cast<size_t>(config.bufferSize));
+                writeLatency.Record(static_cast<quint64>(t.nsecsElapsed() / 1000));
+            }
+            if (writeError != rpi_imager::FileError::kSuccess)
+                break;
+        }
+
+        written += config.bufferSize;
+        sinceSync += config.bufferSize;
+        if (file && config.syncInterval && sinceSync >= config.syncInterval) {
+            writeError = syncNow();
+            if (writeError != rpi_imager::FileError::kSuccess)
+                break;
+            sinceSync = 0;
+        }
+    }
+
+    qint64 finalSyncMs = 0;
+    if (file) {
+        // Don't wait out writes that already failed or stalled
+        if (async && writeError != rpi_imager::FileError::kSuccess)
+            file->CancelAsyncIO();
+
+        QElapsedTimer t;
+        t.start();
+        const rpi_imager::FileError syncResult = syncNow();
+        finalSyncMs = t.elapsed();
+        if (writeError == rpi_imager::FileError::kSuccess)
+            writeError = syncResult;
+        if (async)
+            result["writeLatency"] = latencyJson(file->GetAsyncWriteLatencyHistogram());
+        file->Close();
+    }
+    const qint64 elapsedMs = total.elapsed();
+
+    if (!async && file)
+        result["writeLatency"] = latencyJson(writeLatency);
+    if (syncLatency.Count() > 0)
+        result["syncLatency"] = latencyJson(syncLatency);
+
+    result["bytesWritten"] = static_cast<qint64>(written);
+    result["elapsedMs"] = elapsedMs;
+    result["sourceMs"] = sourceNs / 1000000;
+    result["finalSyncMs"] = finalSyncMs;
+    if (_options.hash)
+        result["hashMs"] = hashNs / 1000000;
+    if (elapsedMs > 0)
+        result["throughputKBps"] = static_cast<qint64>(written * 1000 / static_cast<quint64>(elapsedMs) / 1024);
+
+    if (writeError != rpi_imager::FileError::kSuccess)
+        return fail(QStringLiteral("%1 error after %2 bytes").arg(fileErrorName(writeError)).arg(written));
+
+    result["success"] = true;
+    return result;
+}
@@ -0,0 +1,116 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef WRITEBENCHMARK_H
+#define WRITEBENCHMARK_H
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include <memory>
+
+namespace rpi_imager {
+class FileOperations;
+}
+
+/**
+ * WriteBenchmark - Sweeps write configurations against a target
+ *
+ * Writes the same amount of data once per combination of write size, async
+ * queue depth, direct I/O and sync interval, through the same FileOperations
+ * calls DownloadThread uses, and reports throughput and latency percentiles
+ * for each as JSON. Used by the CLI's --benchmark mode to qualify card
+ * batches and host hardware without writing real OS images.
+ *
+ * The source is either synthetic (incompressible pseudo-random data) or a raw
+ * image file, read from the start again if it is shorter than a run. The
+ * target may be a block device, a regular file (e.g. on a ramdisk; created or
+ * truncated) or "null", which discards the data so the source and hashing
+ * alone are measured.
+ *
+ * Defaults for every swept setting come from SystemMemoryManager, so a run
+ * with no overrides brackets what a real write on this host would use.
+ *
+ * Given fan-out targets instead, it writes one stream to 1..N of them at
+ * once, the way a multi-device write shares one download: a producer
+ * fills a BroadcastRingBuffer, and the hasher and each target read every
+ * slot on their own thread. Each run reports aggregate and per-target
+ * throughput, CPU time per stage and how far each consumer lagged, so the
+ * count at which throughput stops scaling - and what holds it - shows up.
+ * null:, ramdisk: and emulate: targets may be repeated to reach a count.
+ */
+class WriteBenchmark
+{
+public:
+    static constexpr const char *NullTarget = "null";
+    static constexpr const char *SyntheticSource = "synthetic";
+
+    struct Options {
+        QString source = SyntheticSource;
+        QString target;
+        quint64 bytesPerRun = 256ULL * 1024 * 1024;
+        QList<quint64> bufferSizes;
+        QList<int> queueDepths;
+        QList<bool> directIO;
+        QList<quint64> syncIntervals;  // Bytes between syncs, 0 = final sync only
+        bool hash = true;              // SHA256 each block, as the write path does
+        QStringList fanOutTargets;     // Non-empty: run the fan-out scenario instead of the sweep
+        QList<int> fanOutCounts;       // Targets written at once per run, empty = 1..fanOutTargets.size()
+    };
+
+    /**
+     * @brief Options with every sweep filled in from SystemMemoryManager
+     */
+    static Options defaultOptions();
+
+    /**
+     * @brief Parse a byte count with an optional K, M or G suffix (powers of 1024)
+     * @return 0 if the text is not a valid size
+     */
+    static quint64 parseByteSize(const QString &text);
+
+    /**
+     * @brief Whether target names a storage device rather than "null", a
+     *        null:/ramdisk:/replay:/emulate: target or a regular file
+     */
+    static bool isDeviceTarget(const QString &target);
+
+    explicit WriteBenchmark(const Options &options);
+
+    /**
+     * @brief Run every configuration in turn
+     * @param progress Called with a one-line status before each run (may be empty)
+     * @return The report, or a null document if the benchmark could not start
+     */
+    QJsonDocument run(const std::function<void(const QString &)> &progress = {});
+
+    QString errorString() const { return _error; }
+
+private:
+    struct RunConfig {
+        quint64 bufferSize;
+        int queueDepth;
+        bool directIO;
+        quint64 syncInterval;
+    };
+
+    QList<RunConfig> _configurations() const;
+    RunConfig _fanOutConfiguration() const;
+    QJsonObject _runOne(const RunConfig &config);
+    QJsonObject _runFanOut(const RunConfig &config, const QStringList &targets);
+    // Empty on success; file stays null for the "null" target
+    static QString _openTarget(const QString &target, const RunConfig &config, quint64 &bytesToWrite,
+                               std::unique_ptr<rpi_imager::FileOperations> &file, QJsonObject &result);
+    QJsonObject _hostInfo() const;
+    bool _isNullTarget() const;
+
+    Options _options;
+    QString _error;
+};
+
+#endif // WRITEBENCHMARK_H
@@ -0,0 +1,175 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "writejournal.h"
+#include <QSettings>
+#include <QtEndian>
+#include <algorithm>
+#include <zlib.h>
+
+void WriteJournal::start(const QByteArray &imageKey, const QByteArray &deviceId)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _imageKey = imageKey;
+    _deviceId = deviceId;
+    _firstBlock.clear();
+    _ranges.clear();
+    _crc = checksum(nullptr, 0);
+    _rangeFill = 0;
+    _savedRanges = 0;
+}
+
+void WriteJournal::addData(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        const size_t n = static_cast<size_t>(std::min<std::uint64_t>(len, kRangeSize - _rangeFill));
+        _crc = checksum(data, n, _crc);
+        _rangeFill += n;
+        data += n;
+        len -= n;
+
+        if (_rangeFill == kRangeSize)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ranges.append(_crc);
+            _crc = checksum(nullptr, 0);
+            _rangeFill = 0;
+        }
+    }
+}
+
+bool WriteJournal::load(QSettings &settings, const QString &group)
+{
+    settings.beginGroup(group);
+    const QByteArray imageKey = settings.value("image").toByteArray();
+    const QByteArray deviceId = settings.value("device").toByteArray();
+    const QByteArray ranges = settings.value("ranges").toByteArray();
+    const QByteArray firstBlock = settings.value("firstblock").toByteArray();
+    const quint64 synced = settings.value("synced").toULongLong();
+    settings.endGroup();
+
+    if (imageKey.isEmpty() || deviceId.isEmpty() || ranges.size() % 4 != 0 ||
+        static_cast<quint64>(ranges.size() / 4) * kRangeSize != synced)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _imageKey = imageKey;
+    _deviceId = deviceId;
+    _firstBlock = firstBlock;
+    _ranges.clear();
+    for (qsizetype i = 0; i < ranges.size(); i += 4)
+        _ranges.append(qFromLittleEndian<quint32>(ranges.constData() + i));
+    _crc = checksum(nullptr, 0);
+    _rangeFill = 0;
+    _savedRanges = _ranges.size();
+    return true;
+}
+
+void WriteJournal::save(QSettings &settings, const QString &group, std::uint64_t durableOffset)
+{
+    QByteArray ranges;
+    QByteArray imageKey, deviceId, firstBlock;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const int count = std::min(static_cast<int>(durableOffset / kRangeSize), static_cast<int>(_ranges.size()));
+        if (count <= _savedRanges)
+            return;
+
+        ranges.resize(count * 4);
+        for (int i = 0; i < count; i++)
+            qToLittleEndian<quint32>(_ranges[i], ranges.data() + i * 4);
+        imageKey = _imageKey;
+        deviceId = _deviceId;
+        firstBlock = _firstBlock;
+        _savedRanges = count;
+    }
+
+    settings.beginGroup(group);
+    settings.setValue("image", imageKey);
+    settings.setValue("device", deviceId);
+    settings.setValue("ranges", ranges);
+    if (firstBlock.isEmpty())
+        settings.remove("firstblock");
+    else
+        settings.setValue("firstblock", firstBlock);
+    settings.setValue("synced", static_cast<quint64>(ranges.size() / 4) * kRangeSize);
+    settings.endGroup();
+    settings.sync();
+}
+
+bool WriteJournal::hasUnsavedRanges(std::uint64_t durableOffset) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const int count = std::min(static_cast<int>(durableOffset / kRangeSize), static_cast<int>(_ranges.size()));
+    return count > _savedRanges;
+}
+
+void WriteJournal::remove(QSettings &settings, const QString &group)
+{
+    settings.remove(group);
+    settings.sync();
+}
+
+bool WriteJournal::setFirstBlock(const char *data, size_t len)
+{
+    QByteArray compressed = qCompress(reinterpret_cast<const uchar *>(data), static_cast<qsizetype>(len));
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (compressed.size() > kMaxFirstBlockSize)
+    {
+        _firstBlock.clear();
+        return false;
+    }
+    _firstBlock = compressed;
+    return true;
+}
+
+QByteArray WriteJournal::firstBlock() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _firstBlock.isEmpty() ? QByteArray() : qUncompress(_firstBlock);
+}
+
+bool WriteJournal::matches(const QByteArray &imageKey, const QByteArray &deviceId) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _imageKey == imageKey && _deviceId == deviceId;
+}
+
+bool WriteJournal::matchesImage(const QByteArray &imageKey) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _imageKey == imageKey;
+}
+
+int WriteJournal::rangeCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _ranges.size();
+}
+
+quint32 WriteJournal::rangeChecksum(int index) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _ranges.value(index);
+}
+
+quint32 WriteJournal::checksum(const char *data, size_t len, quint32 crc)
+{
+    if (!data)
+        return static_cast<quint32>(crc32(0L, Z_NULL, 0));
+
+    // crc32() takes a 32-bit length
+    while (len > 0)
+    {
+        const uInt n = static_cast<uInt>(std::min<size_t>(len, 1u << 30));
+        crc = static_cast<quint32>(crc32(crc, reinterpret_cast<const Bytef *>(data), n));
+        data += n;
+        len -= n;
+    }
+    return crc;
+}
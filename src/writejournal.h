@@ -0,0 +1,104 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef WRITEJOURNAL_H
+#define WRITEJOURNAL_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <cstdint>
+#include <mutex>
+
+class QSettings;
+
+/**
+ * @brief Progress record that lets an interrupted write be resumed
+ *
+ * Identifies the image and the device it was being written to, and holds
+ * a CRC32 of each kRangeSize range of the image as it was written. What
+ * is saved only covers ranges that had reached the device (see save()),
+ * so after a cancel, a crash or a restart requested by DownloadThread the
+ * next write of the same image to the same device can check the last few
+ * ranges against what is on the device and carry on from there.
+ *
+ * The checksums follow the image data in stream order, so the image must
+ * be written contiguously from offset 0 (no block map, no skipped zeros).
+ *
+ * If the download is the image itself, the first block (which is written
+ * last) is kept as well, so the download can restart at the resume offset
+ * rather than at the beginning.
+ *
+ * Stored in QSettings under a group per device model.
+ */
+class WriteJournal
+{
+public:
+    static constexpr std::uint64_t kRangeSize = 64 * 1024 * 1024;
+    static constexpr int kMaxFirstBlockSize = 1024 * 1024;  // Compressed
+
+    /**
+     * @brief Start a journal for a new write, dropping any ranges held
+     */
+    void start(const QByteArray &imageKey, const QByteArray &deviceId);
+
+    /**
+     * @brief Feed the image data, in order from offset 0
+     *
+     * Called from the hash thread; the other accessors may run concurrently.
+     */
+    void addData(const char *data, size_t len);
+
+    /**
+     * @brief Read a stored journal
+     * @return false if there is none or it is inconsistent
+     */
+    bool load(QSettings &settings, const QString &group);
+
+    /**
+     * @brief Store the ranges that are complete below durableOffset
+     *
+     * Does nothing if no new range has completed since the last call.
+     */
+    void save(QSettings &settings, const QString &group, std::uint64_t durableOffset);
+
+    /**
+     * @brief Whether save() with this offset would store anything new
+     */
+    bool hasUnsavedRanges(std::uint64_t durableOffset) const;
+
+    static void remove(QSettings &settings, const QString &group);
+
+    /**
+     * @brief Keep the first block of the image with the journal
+     * @return false if it is too large to be stored
+     */
+    bool setFirstBlock(const char *data, size_t len);
+    QByteArray firstBlock() const;
+
+    bool matches(const QByteArray &imageKey, const QByteArray &deviceId) const;
+    // Whether it is for this image, on whichever device
+    bool matchesImage(const QByteArray &imageKey) const;
+
+    /**
+     * @brief Number of complete ranges held, starting at offset 0
+     */
+    int rangeCount() const;
+    quint32 rangeChecksum(int index) const;
+
+    static quint32 checksum(const char *data, size_t len, quint32 crc = 0);
+
+private:
+    mutable std::mutex _mutex;
+    QByteArray _imageKey;
+    QByteArray _deviceId;
+    QByteArray _firstBlock;    // qCompress()ed, empty if not kept
+    QVector<quint32> _ranges;  // CRC32 of each complete range
+    quint32 _crc = 0;          // Of the partial range being fed
+    std::uint64_t _rangeFill = 0;
+    int _savedRanges = 0;
+};
+
+#endif // WRITEJOURNAL_H
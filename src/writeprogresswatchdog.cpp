@@ -5,6 +5,8 @@
 
 #include "writeprogresswatchdog.h"
 #include "downloadthread.h"
+#include "latencyhistogram.h"
+#include "tracepoints.h"
 #include <QDateTime>
 #include <QDebug>
 
@@ -23,6 +25,9 @@ void WriteProgressWatchdog::start(DownloadThread* thread)
 {
     _thread = thread;
     resetProgressTracking();
+    _thresholds = WatchdogThresholds::defaults();
+    _recovery = QueueDepthRecovery(RAMP_UP_INTERVAL_MS);
+    _latencyWindowStart.clear();
     _depthReductionAttempted = false;
     _drainAttempted = false;
     _restartAttempted = false;
@@ -78,7 +83,21 @@ int WriteProgressWatchdog::getEffectiveTimeoutMs()
 {
     // Use longer timeout when async writes are pending (slow device draining)
     int pending = _thread ? _thread->pendingAsyncWrites() : 0;
-    return (pending > 0) ? ASYNC_TIMEOUT_MS : STALL_TIMEOUT_MS;
+    return (pending > 0) ? _thresholds.timeoutMs : _thresholds.syncTimeoutMs;
+}
+
+void WriteProgressWatchdog::updateThresholds()
+{
+    if (!_thread) return;
+    
+    quint64 samples = 0;
+    quint64 p999Us = _thread->asyncWriteLatencyUs(0.999, samples);
+    WatchdogThresholds thresholds = WatchdogThresholds::forTailLatency(p999Us, samples);
+    if (thresholds.scalePercent != _thresholds.scalePercent) {
+        qDebug() << "WriteProgressWatchdog: p99.9 write latency" << p999Us / 1000 << "ms over"
+                 << samples << "writes - thresholds at" << thresholds.scalePercent << "% of defaults";
+    }
+    _thresholds = thresholds;
 }
 
 bool WriteProgressWatchdog::tryPollingRecovery()
@@ -119,6 +138,7 @@ bool WriteProgressWatchdog::tryQueueDepthReduction()
     
     if (_thread->reduceAsyncQueueDepth(newDepth)) {
         _depthReductionAttempted = true;
+        applyRecoveryStep(_recovery.onReduced(currentDepth, newDepth, QDateTime::currentMSecsSinceEpoch()));
         // Don't reset timer - let normal progress tracking handle drain
         // If pending count decreases, hasProgress() will see it
         return true;
@@ -127,12 +147,82 @@ bool WriteProgressWatchdog::tryQueueDepthReduction()
     return false;
 }
 
+quint64 WriteProgressWatchdog::latencyWindowP99Us(quint64& samples)
+{
+    std::vector<uint64_t> counts = _thread->writeLatencySnapshot();
+    if (_latencyWindowStart.size() == counts.size()) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            counts[i] = counts[i] >= _latencyWindowStart[i] ? counts[i] - _latencyWindowStart[i] : 0;
+        }
+    }
+    samples = 0;
+    for (uint64_t c : counts) samples += c;
+    return rpi_imager::LatencyHistogram::ValueAtQuantile(counts, 0.99, UINT64_MAX);
+}
+
+void WriteProgressWatchdog::updateQueueDepthRecovery(bool progress)
+{
+    int depth = _thread->effectiveAsyncQueueDepth();
+    if (depth <= 0) return;  // No async I/O to recover
+    
+    quint64 samples = 0;
+    quint64 tailUs = latencyWindowP99Us(samples);
+    applyRecoveryStep(_recovery.onCheck(depth, progress, tailUs, samples, QDateTime::currentMSecsSinceEpoch()));
+}
+
+void WriteProgressWatchdog::applyRecoveryStep(const QueueDepthRecovery::Step& step)
+{
+    using Transition = QueueDepthRecovery::Transition;
+    
+    QString name;
+    bool applied = true;
+    switch (step.transition) {
+    case Transition::None:
+        break;
+    case Transition::StepUp:
+        name = QStringLiteral("stepUp");
+        applied = _thread->restoreAsyncQueueDepth(step.toDepth);
+        _depthReductionAttempted = false;  // A stall at the new depth may reduce again
+        break;
+    case Transition::ResumeAsync:
+        name = QStringLiteral("resumeAsync");
+        applied = _thread->resumeAsyncWrites(step.toDepth);
+        _depthReductionAttempted = false;
+        _drainAttempted = false;
+        break;
+    case Transition::Recovered:
+        name = QStringLiteral("recovered");
+        _depthReductionAttempted = false;
+        _drainAttempted = false;
+        break;
+    case Transition::ProbeFailed:
+        name = QStringLiteral("probeFailed");
+        break;
+    case Transition::GaveUp:
+        name = QStringLiteral("gaveUp");
+        break;
+    }
+    
+    // After the step, so the window is over the histogram now in use
+    if (step.resetWindow) {
+        _latencyWindowStart = _thread->writeLatencySnapshot();
+    }
+    
+    if (!name.isEmpty()) {
+        RPI_TRACE3(watchdog_recovery, static_cast<int>(step.transition), step.fromDepth, step.toDepth);
+        qDebug() << "WriteProgressWatchdog: Queue depth recovery" << name << step.fromDepth << "->" << step.toDepth
+                 << (applied ? "" : "(not applied)") << "- next step after" << _recovery.steadyMs() / 1000 << "s steady";
+        emit queueDepthRecovery(name, step.fromDepth, step.toDepth);
+    }
+}
+
 bool WriteProgressWatchdog::tryDrainAndHotSwap()
 {
     if (!_thread) return false;
     
     _drainAttempted = true;
     int pendingBefore = _thread->pendingAsyncWrites();
+    int depthBefore = _thread->getAsyncQueueDepth();
     
     qDebug() << "WriteProgressWatchdog: Attempting drain + hot-swap (" 
              << pendingBefore << "pending writes)";
@@ -142,6 +232,7 @@ bool WriteProgressWatchdog::tryDrainAndHotSwap()
         // Success! All pending writes completed, now in sync mode
         qDebug() << "WriteProgressWatchdog: Hot-swap successful - continuing in sync mode";
         _lastProgressTime = QDateTime::currentMSecsSinceEpoch();  // Reset stall timer
+        applyRecoveryStep(_recovery.onReduced(depthBefore, 1, _lastProgressTime));
         
         emit switchedToSyncMode(tr("Switched to compatibility mode - write continuing..."));
         return true;
@@ -160,15 +251,19 @@ void WriteProgressWatchdog::check()
     if (!_thread) return;
     
     // Check for progress - includes pending writes decreasing (drain = progress)
-    if (hasProgress()) {
+    bool progress = hasProgress();
+    updateQueueDepthRecovery(progress);
+    if (progress) {
         return;  // All good - timer was reset in hasProgress()
     }
     
     // No progress at all (bytes AND pending count unchanged)
     qint64 now = QDateTime::currentMSecsSinceEpoch();
     qint64 stallMs = now - _lastProgressTime;
+    updateThresholds();
     int timeoutMs = getEffectiveTimeoutMs();
     int pendingWrites = _thread->pendingAsyncWrites();
+    RPI_TRACE2(watchdog_stall, stallMs, pendingWrites);
     
     // Hard timeout - truly stuck
     if (stallMs >= timeoutMs) {
@@ -186,9 +281,10 @@ void WriteProgressWatchdog::check()
         return;  // Polling retrieved completions
     }
     
-    // Recovery phase 2: Reduce queue depth (after 30s of no progress)
-    // This gives slow devices more time by reducing memory pressure
-    if (stallMs >= REDUCE_DEPTH_THRESHOLD_MS && pendingWrites > 0 && !_depthReductionAttempted) {
+    // Recovery phase 2: Reduce queue depth (after 30s of no progress, or longer
+    // on a device with long latency tails). This gives slow devices more time
+    // by reducing memory pressure
+    if (stallMs >= _thresholds.reduceDepthMs && pendingWrites > 0 && !_depthReductionAttempted) {
         tryQueueDepthReduction();
         // Don't return - let normal progress tracking handle drain
     }
@@ -196,7 +292,7 @@ void WriteProgressWatchdog::check()
     // Recovery phase 3: Try drain + hot-swap to sync (after 60s)
     // This waits for pending writes to complete naturally, then switches to sync
     // Much better than restart because we keep all progress!
-    if (stallMs >= (REDUCE_DEPTH_THRESHOLD_MS * 2) && pendingWrites > 0 && !_drainAttempted) {
+    if (stallMs >= _thresholds.drainMs && pendingWrites > 0 && !_drainAttempted) {
         if (tryDrainAndHotSwap()) {
             return;  // Success - now in sync mode, no restart needed
         }
@@ -204,7 +300,7 @@ void WriteProgressWatchdog::check()
     }
     
     // Recovery phase 4: Full restart (only if drain failed, after 120s)
-    if (stallMs >= RESTART_THRESHOLD_MS && pendingWrites > 0 && !_restartAttempted) {
+    if (stallMs >= _thresholds.restartMs && pendingWrites > 0 && !_restartAttempted) {
         _restartAttempted = true;
         qDebug() << "WriteProgressWatchdog: Drain failed, " << pendingWrites 
                  << "writes still stuck - recommending restart";
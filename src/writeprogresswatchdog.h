@@ -9,6 +9,9 @@
 #include <QObject>
 #include <QTimer>
 #include "timeout_utils.h"
+#include "watchdogthresholds.h"
+#include "queuedepthrecovery.h"
+#include <vector>
 
 class DownloadThread;
 
@@ -26,8 +29,11 @@ class DownloadThread;
  * 1. WriteProgressWatchdog (this class) - ORCHESTRATION LAYER
  *    - Owned by: ImageWriter
  *    - Monitors: Overall progress (bytes written, downloaded, verified, pending count)
- *    - Timeouts: 60s normal, 180s with async pending, 120s before restart
- *    - Actions: Emit signals for UI warning, hot-swap to sync, restart, hard timeout
+ *    - Timeouts: 30s before reducing depth, 120s before restart, 180s hard timeout,
+ *      stretched on devices whose p99.9 write latency is long (see WatchdogThresholds)
+ *    - Actions: Emit signals for UI warning, hot-swap to sync, restart, hard timeout;
+ *      resume async and step queue depth back up once the device has recovered
+ *      (see QueueDepthRecovery)
  *    - Authority: Decides WHEN to attempt recovery, delegates HOW to lower layers
  * 
  * 2. RingBuffer - DATA FLOW LAYER
@@ -90,18 +96,20 @@ signals:
     
     /// Emitted as a warning before timeout (for logging/UI feedback)
     void stallWarning(int secondsStalled, int pendingWrites);
+    
+    /// Emitted when queue depth recovery moves on: "stepUp", "resumeAsync",
+    /// "recovered", "probeFailed" or "gaveUp"
+    void queueDepthRecovery(QString transition, int fromDepth, int toDepth);
 
 private slots:
     void check();
 
 private:
-    // Configuration - uses centralized constants from timeout_utils.h
+    // Configuration - uses centralized constants from timeout_utils.h; the
+    // stall thresholds are in _thresholds, scaled to the device
     static constexpr int CHECK_INTERVAL_MS = rpi_imager::TimeoutDefaults::kWatchdogCheckIntervalMs;
-    static constexpr int STALL_TIMEOUT_MS = rpi_imager::TimeoutDefaults::kWatchdogStallTimeoutMs;
-    static constexpr int ASYNC_TIMEOUT_MS = rpi_imager::TimeoutDefaults::kWatchdogAsyncTimeoutMs;
-    static constexpr int REDUCE_DEPTH_THRESHOLD_MS = rpi_imager::TimeoutDefaults::kWatchdogReduceDepthThresholdMs;
     static constexpr int DRAIN_STALL_TIMEOUT_SECONDS = rpi_imager::TimeoutDefaults::kAsyncDrainStallTimeoutSeconds;
-    static constexpr int RESTART_THRESHOLD_MS = rpi_imager::TimeoutDefaults::kWatchdogRestartThresholdMs;
+    static constexpr int RAMP_UP_INTERVAL_MS = rpi_imager::TimeoutDefaults::kWatchdogRampUpIntervalMs;
     
     // State
     DownloadThread* _thread = nullptr;
@@ -115,6 +123,9 @@ private:
     qint64 _lastProgressTime = 0;
     
     // Recovery state
+    WatchdogThresholds _thresholds = WatchdogThresholds::defaults();
+    QueueDepthRecovery _recovery{RAMP_UP_INTERVAL_MS};
+    std::vector<uint64_t> _latencyWindowStart;  // Write latency counts when the window began
     bool _depthReductionAttempted = false;
     bool _drainAttempted = false;
     bool _restartAttempted = false;
@@ -123,8 +134,12 @@ private:
     bool hasProgress();
     void resetProgressTracking();
     int getEffectiveTimeoutMs();
+    void updateThresholds();
     bool tryPollingRecovery();
     bool tryQueueDepthReduction();
+    void updateQueueDepthRecovery(bool progress);
+    void applyRecoveryStep(const QueueDepthRecovery::Step& step);
+    quint64 latencyWindowP99Us(quint64& samples);
     bool tryDrainAndHotSwap();
 };
 
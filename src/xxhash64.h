@@ -0,0 +1,21 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief XXH64 of data, as in the reference xxHash
+ *
+ * Not cryptographic: for telling data that was written from data read
+ * back, where it runs many times faster than SHA-256 (several GB/s per
+ * core), never for checking where an image came from.
+ */
+uint64_t xxhash64(const void *data, size_t length, uint64_t seed = 0);
+
+#endif // XXHASH64_H
@@ -0,0 +1,463 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "xzdecoder.h"
+#include "threadplacement.h"
+#include "threadcputime.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QtConcurrent/qtconcurrentrun.h>
+#include <cstring>
+
+struct XzDecoder::BlockJob
+{
+    QByteArray compressed;  // Block header, compressed data, padding and check
+    lzma_check check;
+    quint64 cost;
+    QByteArray output;
+    QString error;
+    QFuture<void> future;
+};
+
+static QString lzmaError(lzma_ret ret)
+{
+    switch (ret)
+    {
+    case LZMA_MEM_ERROR:
+        return QStringLiteral("out of memory");
+    case LZMA_FORMAT_ERROR:
+        return QStringLiteral("not an xz stream");
+    case LZMA_OPTIONS_ERROR:
+        return QStringLiteral("unsupported xz options");
+    case LZMA_DATA_ERROR:
+        return QStringLiteral("xz data is corrupt");
+    case LZMA_BUF_ERROR:
+        return QStringLiteral("xz data is truncated");
+    default:
+        return QStringLiteral("xz decoder error %1").arg(static_cast<int>(ret));
+    }
+}
+
+// Decode one complete block into memory. Runs on the decoder's thread pool.
+static QString decodeBlock(const QByteArray &in, lzma_check check, QByteArray &out)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(in.constData());
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    lzma_block block;
+    ::memset(&block, 0, sizeof(block));
+    block.version = 0;
+    block.check = check;
+    block.filters = filters;
+    block.header_size = lzma_block_header_size_decode(data[0]);
+
+    lzma_ret ret = lzma_block_header_decode(&block, nullptr, data);
+    if (ret != LZMA_OK)
+        return lzmaError(ret);
+
+    out.resize(static_cast<qsizetype>(block.uncompressed_size));
+    size_t inPos = block.header_size;
+    size_t outPos = 0;
+    ret = lzma_block_buffer_decode(&block, nullptr, data, &inPos, static_cast<size_t>(in.size()),
+                                   reinterpret_cast<uint8_t *>(out.data()), &outPos, static_cast<size_t>(out.size()));
+    lzma_filters_free(filters, nullptr);
+
+    if (ret != LZMA_OK)
+        return lzmaError(ret);
+    if (outPos != static_cast<size_t>(out.size()) || inPos != static_cast<size_t>(in.size()))
+        return lzmaError(LZMA_DATA_ERROR);
+    return QString();
+}
+
+XzDecoder::XzDecoder(RingBuffer *input, RingBuffer::Slot *firstSlot,
+                     std::shared_ptr<RingBuffer> output, int threads,
+                     quint64 maxInFlightBytes, QObject *parent)
+    : DecoderThread(input, firstSlot, std::move(output), threads, parent)
+    , _maxInFlightBytes(maxInFlightBytes)
+    , _inFlightBytes(0)
+    , _state(State::StreamHeader)
+    , _pos(0)
+    , _indexHash(nullptr)
+{
+    lzma_stream init = LZMA_STREAM_INIT;
+    _strm = init;
+    ::memset(&_streamFlags, 0, sizeof(_streamFlags));
+    ::memset(&_seqBlock, 0, sizeof(_seqBlock));
+}
+
+XzDecoder::~XzDecoder()
+{
+    cancel();
+    wait();
+}
+
+bool XzDecoder::isXzStream(const char *data, size_t len)
+{
+    static const char magic[6] = { '\xFD', '7', 'z', 'X', 'Z', '\x00' };
+    return len >= sizeof(magic) && ::memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+bool XzDecoder::mayBeArchive(const char *data, size_t len)
+{
+    lzma_stream strm = LZMA_STREAM_INIT;
+    if (lzma_stream_decoder(&strm, UINT64_MAX, 0) != LZMA_OK)
+        return true;
+
+    uint8_t header[512];
+    strm.next_in = reinterpret_cast<const uint8_t *>(data);
+    strm.avail_in = len;
+    strm.next_out = header;
+    strm.avail_out = sizeof(header);
+    while (strm.avail_out && strm.avail_in)
+    {
+        if (lzma_code(&strm, LZMA_RUN) != LZMA_OK)
+            break;
+    }
+    size_t decoded = sizeof(header) - strm.avail_out;
+    lzma_end(&strm);
+
+    return _mayBeTarHeader(reinterpret_cast<const char *>(header), decoded);
+}
+
+bool XzDecoder::_deliverBlocks(size_t keepInFlight, quint64 reserveBytes)
+{
+    while (!_jobs.empty()
+           && (_jobs.size() > keepInFlight
+               || _inFlightBytes + reserveBytes > _maxInFlightBytes
+               || _jobs.front()->future.isFinished()))
+    {
+        BlockJob *job = _jobs.front().get();
+        job->future.waitForFinished();
+        if (!job->error.isEmpty())
+        {
+            _fail(job->error);
+            return false;
+        }
+        if (!_emit(job->output.constData(), static_cast<size_t>(job->output.size())))
+            return false;
+        _inFlightBytes -= job->cost;
+        _jobs.pop_front();
+    }
+    return true;
+}
+
+bool XzDecoder::_parseBlockHeader(const char *p, size_t avail, bool &needMore)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(p);
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    lzma_block block;
+    ::memset(&block, 0, sizeof(block));
+    block.version = 0;
+    block.check = _streamFlags.check;
+    block.filters = filters;
+    block.header_size = lzma_block_header_size_decode(data[0]);
+    if (avail < block.header_size)
+    {
+        needMore = true;
+        return true;
+    }
+
+    lzma_ret ret = lzma_block_header_decode(&block, nullptr, data);
+    if (ret != LZMA_OK)
+    {
+        _fail(lzmaError(ret));
+        return false;
+    }
+
+    bool sized = block.compressed_size != LZMA_VLI_UNKNOWN && block.uncompressed_size != LZMA_VLI_UNKNOWN;
+    quint64 totalSize = sized ? lzma_block_total_size(&block) : 0;
+    if (totalSize == LZMA_VLI_UNKNOWN)
+    {
+        lzma_filters_free(filters, nullptr);
+        _fail(lzmaError(LZMA_DATA_ERROR));
+        return false;
+    }
+    quint64 cost = totalSize + (sized ? block.uncompressed_size : 0);
+
+    if (!sized || cost > _maxInFlightBytes)
+    {
+        // Single-threaded xz leaves the sizes out of the block header
+        if (!_deliverBlocks(0, 0))
+        {
+            lzma_filters_free(filters, nullptr);
+            return false;
+        }
+
+        qDebug() << "XzDecoder:" << (sized ? "block exceeds memory budget," : "block has no size information,")
+                 << "decoding sequentially";
+
+        ::memcpy(&_seqBlock, &block, sizeof(block));
+        ret = lzma_block_decoder(&_strm, &_seqBlock);
+        // Filter options are only needed to set up the decoder
+        lzma_filters_free(filters, nullptr);
+        _seqBlock.filters = nullptr;
+        if (ret != LZMA_OK)
+        {
+            _fail(lzmaError(ret));
+            return false;
+        }
+
+        _pos += block.header_size;
+        _state = State::SequentialBlock;
+        return true;
+    }
+    lzma_filters_free(filters, nullptr);
+
+    if (avail < totalSize)
+    {
+        needMore = true;
+        return true;
+    }
+
+    ret = lzma_index_hash_append(_indexHash, lzma_block_unpadded_size(&block), block.uncompressed_size);
+    if (ret != LZMA_OK)
+    {
+        _fail(lzmaError(ret));
+        return false;
+    }
+
+    // Make room within the memory budget and thread limit, then queue
+    if (!_deliverBlocks(static_cast<size_t>(_threads) * 2 - 1, cost))
+        return false;
+
+    auto job = std::make_unique<BlockJob>();
+    job->compressed = _staging.mid(_pos, static_cast<qsizetype>(totalSize));
+    job->check = _streamFlags.check;
+    job->cost = cost;
+    BlockJob *j = job.get();
+    job->future = QtConcurrent::run(&_pool, [j]() {
+        ThreadCpuTime::Task cpuTask(ThreadCpuTime::Stage::Decompress);
+        j->error = decodeBlock(j->compressed, j->check, j->output);
+    });
+    _jobs.push_back(std::move(job));
+    _inFlightBytes += cost;
+    _parallelBlocks++;
+
+    _pos += static_cast<qsizetype>(totalSize);
+    return true;
+}
+
+bool XzDecoder::_decodeSequential(const char *p, size_t avail)
+{
+    _strm.next_in = reinterpret_cast<const uint8_t *>(p);
+    _strm.avail_in = avail;
+
+    while (!_cancelled)
+    {
+        if (!_acquireOutput())
+            return false;
+
+        // Decode directly into the write ring buffer slot
+        size_t room = _outSlot->capacity - _outUsed;
+        _strm.next_out = reinterpret_cast<uint8_t *>(_outSlot->data + _outUsed);
+        _strm.avail_out = room;
+        lzma_ret ret = lzma_code(&_strm, LZMA_RUN);
+        size_t produced = room - _strm.avail_out;
+        _advanceOutput(produced);
+
+        if (ret == LZMA_STREAM_END)
+        {
+            ret = lzma_index_hash_append(_indexHash, lzma_block_unpadded_size(&_seqBlock), _seqBlock.uncompressed_size);
+            if (ret != LZMA_OK)
+            {
+                _fail(lzmaError(ret));
+                return false;
+            }
+            _state = State::BlockHeader;
+            break;
+        }
+        if (ret != LZMA_OK)
+        {
+            _fail(lzmaError(ret));
+            return false;
+        }
+        if (_strm.avail_in == 0 && produced < room)
+            break;
+    }
+
+    _pos += static_cast<qsizetype>(avail - _strm.avail_in);
+    return !_cancelled;
+}
+
+bool XzDecoder::_parse()
+{
+    while (!_cancelled)
+    {
+        const char *p = _staging.constData() + _pos;
+        size_t avail = static_cast<size_t>(_staging.size() - _pos);
+
+        switch (_state)
+        {
+        case State::StreamHeader:
+        {
+            if (avail < LZMA_STREAM_HEADER_SIZE)
+                return true;
+            lzma_ret ret = lzma_stream_header_decode(&_streamFlags, reinterpret_cast<const uint8_t *>(p));
+            if (ret != LZMA_OK)
+            {
+                _fail(lzmaError(ret));
+                return false;
+            }
+            if (_indexHash)
+                lzma_index_hash_end(_indexHash, nullptr);
+            _indexHash = lzma_index_hash_init(nullptr, nullptr);
+            if (!_indexHash)
+            {
+                _fail(lzmaError(LZMA_MEM_ERROR));
+                return false;
+            }
+            _pos += LZMA_STREAM_HEADER_SIZE;
+            _state = State::BlockHeader;
+            break;
+        }
+
+        case State::BlockHeader:
+        {
+            if (avail < 1)
+                return true;
+            if (p[0] == 0x00)
+            {
+                // Index indicator: all blocks of this stream have been seen
+                _state = State::Index;
+                break;
+            }
+            bool needMore = false;
+            if (!_parseBlockHeader(p, avail, needMore))
+                return false;
+            if (needMore)
+                return true;
+            break;
+        }
+
+        case State::SequentialBlock:
+            if (avail < 1)
+                return true;
+            if (!_decodeSequential(p, avail))
+                return false;
+            if (_state == State::SequentialBlock)
+                return true;
+            break;
+
+        case State::Index:
+        {
+            if (avail < 1)
+                return true;
+            size_t inPos = 0;
+            lzma_ret ret = lzma_index_hash_decode(_indexHash, reinterpret_cast<const uint8_t *>(p), &inPos, avail);
+            _pos += static_cast<qsizetype>(inPos);
+            if (ret == LZMA_OK)
+                return true;
+            if (ret != LZMA_STREAM_END)
+            {
+                // Index does not match the blocks we decoded
+                _fail(lzmaError(ret));
+                return false;
+            }
+            _state = State::StreamFooter;
+            break;
+        }
+
+        case State::StreamFooter:
+        {
+            if (avail < LZMA_STREAM_HEADER_SIZE)
+                return true;
+            lzma_stream_flags footer;
+            lzma_ret ret = lzma_stream_footer_decode(&footer, reinterpret_cast<const uint8_t *>(p));
+            if (ret == LZMA_OK)
+                ret = lzma_stream_flags_compare(&_streamFlags, &footer);
+            if (ret == LZMA_OK && footer.backward_size != lzma_index_hash_size(_indexHash))
+                ret = LZMA_DATA_ERROR;
+            if (ret != LZMA_OK)
+            {
+                _fail(lzmaError(ret));
+                return false;
+            }
+            _pos += LZMA_STREAM_HEADER_SIZE;
+            _state = State::StreamPadding;
+            break;
+        }
+
+        case State::StreamPadding:
+            // Stream padding is a multiple of four zero bytes, optionally
+            // followed by another (concatenated) stream
+            if (avail < 4)
+                return true;
+            if (::memcmp(p, "\0\0\0\0", 4) == 0)
+                _pos += 4;
+            else
+                _state = State::StreamHeader;
+            break;
+        }
+    }
+    return false;
+}
+
+void XzDecoder::run()
+{
+    ThreadPlacement::apply(ThreadPlacement::Role::Decompress);
+    ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::Decompress);
+    QElapsedTimer decodeTimer;
+    bool ok = true;
+
+    while (ok && !_cancelled)
+    {
+        RingBuffer::Slot *slot = _nextInput();
+        if (!slot)
+            break;
+
+        decodeTimer.start();
+        if (_state == State::SequentialBlock && _pos == _staging.size())
+        {
+            // Nothing staged: decode straight from the input slot
+            _staging = QByteArray::fromRawData(slot->data, static_cast<qsizetype>(slot->size));
+            _pos = 0;
+            ok = _parse();
+            _staging = QByteArray(_staging.constData() + _pos, _staging.size() - _pos);
+        }
+        else
+        {
+            _staging.append(slot->data, static_cast<qsizetype>(slot->size));
+            ok = _parse();
+            _staging.remove(0, _pos);
+        }
+        _pos = 0;
+        _input->releaseReadSlot(slot);
+
+        if (ok)
+            ok = _deliverBlocks(static_cast<size_t>(_threads) * 2, 0);
+        _decodeMs += static_cast<quint64>(decodeTimer.elapsed());
+    }
+
+    if (ok && !_cancelled && !_failed)
+    {
+        if (_input->isStallTimeoutExceeded() || _input->isCancelled())
+            _fail(QStringLiteral("download interrupted"));
+        else if (_deliverBlocks(0, 0))
+        {
+            if (_state != State::StreamPadding || !_staging.isEmpty())
+                _fail(QStringLiteral("compressed data is truncated"));
+            else
+                _flushOutput();
+        }
+    }
+
+    // Block jobs reference the deque entries, so let them finish first
+    _pool.waitForDone();
+    _jobs.clear();
+    lzma_end(&_strm);
+    if (_indexHash)
+        lzma_index_hash_end(_indexHash, nullptr);
+    _indexHash = nullptr;
+
+    if (_cancelled && !_failed)
+        _fail(QStringLiteral("cancelled"));
+
+    // Unblock the writer
+    _output->producerDone();
+
+    qDebug() << "XzDecoder: consumed" << _bytesConsumed.load() / (1024 * 1024) << "MB,"
+             << _parallelBlocks.load() << "blocks decoded in parallel,"
+             << "decode" << _decodeMs.load() << "ms, input wait" << _inputWaitMs.load() << "ms";
+}
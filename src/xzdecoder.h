@@ -0,0 +1,88 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef XZDECODER_H
+#define XZDECODER_H
+
+#include <lzma.h>
+#include <QByteArray>
+#include <deque>
+#include "decoderthread.h"
+
+/**
+ * @brief Native xz decoder for raw .xz images
+ *
+ * xz -T (the default since xz 5.4, and how official images are made)
+ * splits the stream into independent blocks and records each block's
+ * compressed and uncompressed size in its header. The index at the end of
+ * the file is not available while downloading, so the decoder walks the
+ * block headers instead: as soon as a whole block has arrived it is
+ * decoded on the thread pool, and output is delivered in order.
+ *
+ * Blocks without sizes (single-threaded xz), or too large for the memory
+ * budget, are decoded sequentially straight into the write ring buffer.
+ * The index and stream footer are checked against the decoded blocks,
+ * and concatenated streams are supported.
+ */
+class XzDecoder : public DecoderThread
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param maxInFlightBytes Budget for blocks being decoded in parallel
+     *                         (compressed plus decompressed size)
+     */
+    XzDecoder(RingBuffer *input, RingBuffer::Slot *firstSlot,
+              std::shared_ptr<RingBuffer> output, int threads,
+              quint64 maxInFlightBytes, QObject *parent = nullptr);
+    ~XzDecoder() override;
+
+    /**
+     * @brief Check whether data starts with an xz stream header
+     */
+    static bool isXzStream(const char *data, size_t len);
+
+    /**
+     * @brief Decode the start of the stream to check for a tar header
+     *
+     * Used to leave .tar.xz to libarchive.
+     */
+    static bool mayBeArchive(const char *data, size_t len);
+
+protected:
+    void run() override;
+
+private:
+    enum class State {
+        StreamHeader,
+        BlockHeader,
+        SequentialBlock,
+        Index,
+        StreamFooter,
+        StreamPadding
+    };
+
+    struct BlockJob;
+
+    quint64 _maxInFlightBytes;
+    quint64 _inFlightBytes;
+    std::deque<std::unique_ptr<BlockJob>> _jobs;
+
+    State _state;
+    QByteArray _staging;    // Compressed input not yet consumed
+    qsizetype _pos;         // Parse position in _staging
+    lzma_stream_flags _streamFlags;
+    lzma_index_hash *_indexHash;
+    lzma_stream _strm;      // Sequential block decoder
+    lzma_block _seqBlock;
+
+    bool _parse();
+    bool _parseBlockHeader(const char *p, size_t avail, bool &needMore);
+    bool _decodeSequential(const char *p, size_t avail);
+    bool _deliverBlocks(size_t keepInFlight, quint64 reserveBytes);
+};
+
+#endif // XZDECODER_H
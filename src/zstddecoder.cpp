@@ -0,0 +1,292 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#include "zstddecoder.h"
+#include "threadplacement.h"
+#include "threadcputime.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QtConcurrent/qtconcurrentrun.h>
+#include <deque>
+
+// Frames with a larger decompressed size are decoded sequentially straight
+// into the write ring buffer rather than buffered whole in memory
+static constexpr unsigned long long MAX_PARALLEL_FRAME_OUTPUT = 256ULL * 1024 * 1024;
+
+// Compressed data buffered without finding the end of a frame before
+// treating the stream as one large frame and decoding it sequentially
+static constexpr qsizetype MAX_FRAME_STAGING = 32 * 1024 * 1024;
+
+struct ZstdDecoder::FrameJob
+{
+    QByteArray compressed;
+    QByteArray output;
+    QString error;
+    QFuture<void> future;
+};
+
+// Decode one complete frame into memory. Runs on the decoder's thread pool.
+static QString decodeFrame(const QByteArray &in, QByteArray &out)
+{
+    unsigned long long contentSize = ZSTD_getFrameContentSize(in.constData(), static_cast<size_t>(in.size()));
+    if (contentSize == ZSTD_CONTENTSIZE_ERROR)
+        return QStringLiteral("invalid zstd frame header");
+
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (!dctx)
+        return QStringLiteral("out of memory");
+
+    QString error;
+    if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN)
+    {
+        out.resize(static_cast<qsizetype>(contentSize));
+        size_t r = ZSTD_decompressDCtx(dctx, out.data(), static_cast<size_t>(out.size()),
+                                       in.constData(), static_cast<size_t>(in.size()));
+        if (ZSTD_isError(r))
+            error = QString::fromLatin1(ZSTD_getErrorName(r));
+        else if (r != contentSize)
+            error = QStringLiteral("frame size mismatch");
+    }
+    else
+    {
+        // Frame header without content size: grow the output as we go
+        QByteArray chunk(static_cast<qsizetype>(ZSTD_DStreamOutSize()), Qt::Uninitialized);
+        ZSTD_inBuffer zin = { in.constData(), static_cast<size_t>(in.size()), 0 };
+        size_t r = 1;
+        while (zin.pos < zin.size || r != 0)
+        {
+            ZSTD_outBuffer zout = { chunk.data(), static_cast<size_t>(chunk.size()), 0 };
+            r = ZSTD_decompressStream(dctx, &zout, &zin);
+            if (ZSTD_isError(r))
+            {
+                error = QString::fromLatin1(ZSTD_getErrorName(r));
+                break;
+            }
+            out.append(chunk.constData(), static_cast<qsizetype>(zout.pos));
+            if (zin.pos == zin.size && zout.pos < zout.size)
+                break;
+        }
+        if (error.isEmpty() && r != 0)
+            error = QStringLiteral("truncated zstd frame");
+    }
+
+    ZSTD_freeDCtx(dctx);
+    return error;
+}
+
+ZstdDecoder::ZstdDecoder(RingBuffer *input, RingBuffer::Slot *firstSlot,
+                         std::shared_ptr<RingBuffer> output, int threads, QObject *parent)
+    : DecoderThread(input, firstSlot, std::move(output), threads, parent)
+{
+}
+
+ZstdDecoder::~ZstdDecoder()
+{
+    cancel();
+    wait();
+}
+
+bool ZstdDecoder::isZstdFrame(const char *data, size_t len)
+{
+    if (len < 4)
+        return false;
+
+    unsigned int magic = static_cast<unsigned char>(data[0])
+                       | (static_cast<unsigned char>(data[1]) << 8)
+                       | (static_cast<unsigned char>(data[2]) << 16)
+                       | (static_cast<unsigned int>(static_cast<unsigned char>(data[3])) << 24);
+
+    // pzstd output starts with a skippable frame holding the frame size
+    return magic == ZSTD_MAGICNUMBER
+        || (magic & ZSTD_MAGIC_SKIPPABLE_MASK) == ZSTD_MAGIC_SKIPPABLE_START;
+}
+
+bool ZstdDecoder::mayBeArchive(const char *data, size_t len)
+{
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (!dctx)
+        return true;
+
+    char header[512];
+    ZSTD_inBuffer zin = { data, len, 0 };
+    ZSTD_outBuffer zout = { header, sizeof(header), 0 };
+    while (zout.pos < zout.size && zin.pos < zin.size)
+    {
+        size_t r = ZSTD_decompressStream(dctx, &zout, &zin);
+        if (ZSTD_isError(r))
+            break;
+    }
+    ZSTD_freeDCtx(dctx);
+
+    return _mayBeTarHeader(header, zout.pos);
+}
+
+bool ZstdDecoder::_streamDecode(ZSTD_DCtx *dctx, const char *data, size_t len, bool &frameEnded)
+{
+    ZSTD_inBuffer zin = { data, len, 0 };
+    while (!_cancelled)
+    {
+        if (!_acquireOutput())
+            return false;
+
+        // Decode directly into the write ring buffer slot
+        ZSTD_outBuffer zout = { _outSlot->data + _outUsed, _outSlot->capacity - _outUsed, 0 };
+        size_t r = ZSTD_decompressStream(dctx, &zout, &zin);
+        if (ZSTD_isError(r))
+        {
+            _fail(QString::fromLatin1(ZSTD_getErrorName(r)));
+            return false;
+        }
+        frameEnded = (r == 0);
+        _advanceOutput(zout.pos);
+
+        if (zin.pos == zin.size && zout.pos < zout.size)
+            break;
+    }
+    return !_cancelled;
+}
+
+void ZstdDecoder::run()
+{
+    ThreadPlacement::apply(ThreadPlacement::Role::Decompress);
+    ThreadCpuTime::Scope cpuScope(ThreadCpuTime::Stage::Decompress);
+    QElapsedTimer decodeTimer;
+    ZSTD_DCtx *stream = nullptr;   // Set once we decode sequentially
+    bool frameEnded = true;
+    QByteArray staging;            // Compressed data from the start of the next frame
+    std::deque<std::unique_ptr<FrameJob>> jobs;
+    bool ok = true;
+
+    // Hand finished frames to the writer in order, waiting until no more
+    // than keepInFlight frames are outstanding
+    auto deliverJobs = [&](size_t keepInFlight) -> bool {
+        while (!jobs.empty() && (jobs.size() > keepInFlight || jobs.front()->future.isFinished()))
+        {
+            FrameJob *job = jobs.front().get();
+            job->future.waitForFinished();
+            if (!job->error.isEmpty())
+            {
+                _fail(job->error);
+                return false;
+            }
+            if (!_emit(job->output.constData(), static_cast<size_t>(job->output.size())))
+                return false;
+            jobs.pop_front();
+        }
+        return true;
+    };
+
+    while (ok && !_cancelled)
+    {
+        RingBuffer::Slot *slot = _nextInput();
+        if (!slot)
+            break;
+
+        decodeTimer.start();
+
+        if (stream)
+            ok = _streamDecode(stream, slot->data, slot->size, frameEnded);
+        else
+            staging.append(slot->data, static_cast<qsizetype>(slot->size));
+        _input->releaseReadSlot(slot);
+
+        if (ok && !stream)
+        {
+            // Cut off every complete frame and queue it for parallel decoding
+            qsizetype offset = 0;
+            while (ok)
+            {
+                const char *frame = staging.constData() + offset;
+                size_t available = static_cast<size_t>(staging.size() - offset);
+                size_t frameSize = ZSTD_findFrameCompressedSize(frame, available);
+                if (ZSTD_isError(frameSize))
+                    break;  // Incomplete (corrupt data is reported by the sequential path)
+
+                unsigned long long contentSize = ZSTD_getFrameContentSize(frame, frameSize);
+                if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN && contentSize != ZSTD_CONTENTSIZE_ERROR
+                    && contentSize > MAX_PARALLEL_FRAME_OUTPUT)
+                {
+                    ok = deliverJobs(0);
+                    if (ok)
+                    {
+                        ZSTD_DCtx *dctx = ZSTD_createDCtx();
+                        ok = _streamDecode(dctx, frame, frameSize, frameEnded);
+                        ZSTD_freeDCtx(dctx);
+                    }
+                }
+                else
+                {
+                    auto job = std::make_unique<FrameJob>();
+                    job->compressed = staging.mid(offset, static_cast<qsizetype>(frameSize));
+                    FrameJob *j = job.get();
+                    job->future = QtConcurrent::run(&_pool, [j]() {
+                        ThreadCpuTime::Task cpuTask(ThreadCpuTime::Stage::Decompress);
+                        j->error = decodeFrame(j->compressed, j->output);
+                    });
+                    jobs.push_back(std::move(job));
+                    _parallelBlocks++;
+                    ok = deliverJobs(static_cast<size_t>(_threads) * 2);
+                }
+                offset += static_cast<qsizetype>(frameSize);
+            }
+            staging.remove(0, offset);
+
+            if (ok && staging.size() > MAX_FRAME_STAGING)
+            {
+                // A single large frame (regular zstd): decode as a stream from here on
+                qDebug() << "ZstdDecoder: no frame boundary within" << MAX_FRAME_STAGING / (1024 * 1024)
+                         << "MB, switching to sequential streaming decode";
+                ok = deliverJobs(0);
+                stream = ZSTD_createDCtx();
+                if (ok)
+                    ok = _streamDecode(stream, staging.constData(), static_cast<size_t>(staging.size()), frameEnded);
+                staging = QByteArray();
+            }
+        }
+
+        _decodeMs += static_cast<quint64>(decodeTimer.elapsed());
+    }
+
+    if (ok && !_cancelled && !_failed)
+    {
+        if (_input->isStallTimeoutExceeded() || _input->isCancelled())
+        {
+            _fail(QStringLiteral("download interrupted"));
+        }
+        else if (deliverJobs(0))
+        {
+            if (!stream && !staging.isEmpty())
+            {
+                // Trailing data that is not a complete frame: let the
+                // decoder report what is wrong with it
+                ZSTD_DCtx *dctx = ZSTD_createDCtx();
+                frameEnded = false;
+                _streamDecode(dctx, staging.constData(), static_cast<size_t>(staging.size()), frameEnded);
+                ZSTD_freeDCtx(dctx);
+            }
+            if (!_failed && !frameEnded)
+                _fail(QStringLiteral("compressed data is truncated"));
+            if (!_failed)
+                _flushOutput();
+        }
+    }
+
+    // Frame jobs reference the deque entries, so let them finish first
+    _pool.waitForDone();
+    jobs.clear();
+    if (stream)
+        ZSTD_freeDCtx(stream);
+
+    if (_cancelled && !_failed)
+        _fail(QStringLiteral("cancelled"));
+
+    // Unblock the writer
+    _output->producerDone();
+
+    qDebug() << "ZstdDecoder: consumed" << _bytesConsumed.load() / (1024 * 1024) << "MB,"
+             << _parallelBlocks.load() << "frames decoded in parallel,"
+             << "decode" << _decodeMs.load() << "ms, input wait" << _inputWaitMs.load() << "ms";
+}
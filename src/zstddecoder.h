@@ -0,0 +1,53 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2025 Raspberry Pi Ltd
+ */
+
+#ifndef ZSTDDECODER_H
+#define ZSTDDECODER_H
+
+#include <zstd.h>
+#include "decoderthread.h"
+
+/**
+ * @brief Native zstd decoder for raw .zst images
+ *
+ * Files made up of several independent frames (pzstd, or anything
+ * compressed in chunks and concatenated) are split on frame
+ * boundaries and the frames are decoded in parallel on a private thread
+ * pool, with output delivered in order. A stream that is one large frame
+ * is detected by the amount of input buffered without finding a frame end,
+ * and falls back to sequential streaming decode.
+ */
+class ZstdDecoder : public DecoderThread
+{
+    Q_OBJECT
+
+public:
+    ZstdDecoder(RingBuffer *input, RingBuffer::Slot *firstSlot,
+                std::shared_ptr<RingBuffer> output, int threads, QObject *parent = nullptr);
+    ~ZstdDecoder() override;
+
+    /**
+     * @brief Check whether data starts with a zstd (or skippable) frame
+     */
+    static bool isZstdFrame(const char *data, size_t len);
+
+    /**
+     * @brief Decode the start of the stream to check for a tar header
+     *
+     * Used to leave .tar.zst to libarchive. Returns true if too little data
+     * could be decoded to tell, so the caller errs on the side of libarchive.
+     */
+    static bool mayBeArchive(const char *data, size_t len);
+
+protected:
+    void run() override;
+
+private:
+    struct FrameJob;
+
+    bool _streamDecode(ZSTD_DCtx *dctx, const char *data, size_t len, bool &frameEnded);
+};
+
+#endif // ZSTDDECODER_H